@@ -27,6 +27,36 @@ macro ( ADD_FLUID_TEST _test )
 
 endmacro ( ADD_FLUID_TEST )
 
+macro ( ADD_FLUID_BENCH _bench )
+    ADD_EXECUTABLE(${_bench} ${_bench}.c $<TARGET_OBJECTS:libfluidsynth-OBJ> )
+
+    # only build this benchmark when explicitly requested by "make bench"
+    set_target_properties(${_bench} PROPERTIES EXCLUDE_FROM_ALL TRUE)
+
+    # import necessary compile flags and dependency libraries
+    if ( FLUID_CPPFLAGS )
+        set_target_properties ( ${_bench} PROPERTIES COMPILE_FLAGS ${FLUID_CPPFLAGS} )
+    endif ( FLUID_CPPFLAGS )
+    TARGET_LINK_LIBRARIES(${_bench} $<TARGET_PROPERTY:libfluidsynth,INTERFACE_LINK_LIBRARIES>)
+
+    # use the local include path to look for fluidsynth.h, as we cannot be sure fluidsynth is already installed
+    target_include_directories(${_bench}
+    PUBLIC
+    $<BUILD_INTERFACE:${CMAKE_BINARY_DIR}/include> # include auto generated headers
+    $<BUILD_INTERFACE:${CMAKE_SOURCE_DIR}/include> # include "normal" public (sub-)headers
+    $<BUILD_INTERFACE:${CMAKE_SOURCE_DIR}/src> # include private headers
+    $<TARGET_PROPERTY:libfluidsynth,INCLUDE_DIRECTORIES> # include all other header search paths needed by libfluidsynth (esp. glib)
+    )
+
+    # benchmarks measure time rather than correctness, so they are not added to ctest,
+    # but run one after the other by the bench-target
+    add_custom_command(TARGET bench POST_BUILD COMMAND ${_bench} VERBATIM)
+
+    # append the current benchmark to bench-target as dependency
+    add_dependencies(bench ${_bench})
+
+endmacro ( ADD_FLUID_BENCH )
+
 macro ( ADD_FLUID_DEMO _demo )
     ADD_EXECUTABLE(${_demo} ${_demo}.c )
 
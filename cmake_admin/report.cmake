@@ -73,18 +73,36 @@ else ( PULSE_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  PulseAudio:            no\n" )
 endif ( PULSE_SUPPORT )
 
+if ( PIPEWIRE_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  PipeWire:              yes\n" )
+else ( PIPEWIRE_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  PipeWire:              no\n" )
+endif ( PIPEWIRE_SUPPORT )
+
 if ( SDL2_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  SDL2:                  yes\n" )
 else ( SDL2_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  SDL2:                  no\n" )
 endif ( SDL2_SUPPORT )
 
+if ( NETWORK_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  UDP / RTP-MIDI:        yes\n" )
+else ( NETWORK_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  UDP / RTP-MIDI:        no\n" )
+endif ( NETWORK_SUPPORT )
+
 if ( WAVEOUT_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  WaveOut:               yes\n" )
 else ( WAVEOUT_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  WaveOut:               no\n" )
 endif ( WAVEOUT_SUPPORT )
 
+if ( WASAPI_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  WASAPI:                yes\n" )
+else ( WASAPI_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  WASAPI:                no\n" )
+endif ( WASAPI_SUPPORT )
+
 if ( WINMIDI_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  WinMidi:               yes\n" )
 else ( WINMIDI_SUPPORT )
@@ -95,13 +113,15 @@ endif ( WINMIDI_SUPPORT )
 set ( INPUTS_REPORT "\n" )
 
 set ( INPUTS_REPORT "${INPUTS_REPORT}Support for SF3 files:   " )
-if ( LIBSNDFILE_HASVORBIS )
+if ( LIBVORBIS_SUPPORT )
+    set ( INPUTS_REPORT "${INPUTS_REPORT}yes (libvorbisfile)\n" )
+elseif ( LIBSNDFILE_HASVORBIS )
     set ( INPUTS_REPORT "${INPUTS_REPORT}yes\n" )
 elseif ( NOT LIBSNDFILE_SUPPORT )
     set ( INPUTS_REPORT "${INPUTS_REPORT}no (libsndfile not found)\n" )
 elseif ( NOT LIBSNDFILE_HASVORBIS )
     set ( INPUTS_REPORT "${INPUTS_REPORT}no (libsndfile has no ogg vorbis support)\n" )
-endif ( LIBSNDFILE_HASVORBIS )
+endif ( LIBVORBIS_SUPPORT )
 
 
 set ( INPUTS_REPORT "${INPUTS_REPORT}Support for DLS files:   " )
@@ -180,6 +200,15 @@ else ( WITH_FLOAT )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  Samples type:          double\n" )
 endif ( WITH_FLOAT )
 
+set ( DEVEL_REPORT "${DEVEL_REPORT}  Block size:            ${FLUID_BUFSIZE} frames\n" )
+set ( DEVEL_REPORT "${DEVEL_REPORT}  Interpolation tables:  ${FLUID_INTERP_BITS} bits, 7th order ${FLUID_SINC_INTERP_BITS} bits\n" )
+
+if ( ENABLE_RUNTIME_TABLES )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Lookup tables:         computed at runtime\n" )
+else ( ENABLE_RUNTIME_TABLES )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Lookup tables:         generated at build time\n" )
+endif ( ENABLE_RUNTIME_TABLES )
+
 if ( ENABLE_MIXER_THREADS )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  Multithread rendering: yes\n" )
 else ( ENABLE_MIXER_THREADS )
@@ -192,6 +221,14 @@ else ( HAVE_OPENMP )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  OpenMP 4.0:            no\n" )
 endif ( HAVE_OPENMP )
 
+if ( EMSCRIPTEN )
+  if ( WITH_WASM_SIMD )
+    set ( DEVEL_REPORT "${DEVEL_REPORT}  WebAssembly SIMD128:   yes\n" )
+  else ( WITH_WASM_SIMD )
+    set ( DEVEL_REPORT "${DEVEL_REPORT}  WebAssembly SIMD128:   no\n" )
+  endif ( WITH_WASM_SIMD )
+endif ( EMSCRIPTEN )
+
 if ( WITH_PROFILING )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  Profiling:             yes\n" )
 else ( WITH_PROFILING )
@@ -216,6 +253,18 @@ else ( ENABLE_FPECHECK )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  Check FPE (debug):     no\n" )
 endif ( ENABLE_FPECHECK )
 
+if ( RT_ALLOC_CHECK )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Check RT allocations:  yes\n" )
+else ( RT_ALLOC_CHECK )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Check RT allocations:  no\n" )
+endif ( RT_ALLOC_CHECK )
+
+if ( WITH_TRACE )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Trace points:          yes\n" )
+else ( WITH_TRACE )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Trace points:          no\n" )
+endif ( WITH_TRACE )
+
 if ( ENABLE_UBSAN )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  UBSan (debug):         yes\n" )
 else ( ENABLE_UBSAN )
@@ -131,13 +131,34 @@ enum fluid_player_status
     FLUID_PLAYER_DONE             /**< Player is finished playing */
 };
 
+/**
+ * Callback function receiving the audio rendered by fluid_player_render() or
+ * fluid_player_render_segments().
+ * @param data User defined data pointer
+ * @param buf The rendered audio, as interleaved stereo frames of 32 bit floats
+ *   (left and right channel)
+ * @param frames Number of frames in \p buf
+ * @return Should return #FLUID_OK to continue rendering, #FLUID_FAILED to stop
+ *   it, e.g. if the audio could not be delivered
+ *
+ * \p buf belongs to the player and is only valid until the callback returns,
+ * so the audio has to be copied or sent away by the callback.
+ * @since 2.2.0
+ */
+typedef int (*fluid_player_render_func_t)(void *data, const float *buf, int frames);
+
 FLUIDSYNTH_API fluid_player_t *new_fluid_player(fluid_synth_t *synth);
 FLUIDSYNTH_API void delete_fluid_player(fluid_player_t *player);
 FLUIDSYNTH_API int fluid_player_add(fluid_player_t *player, const char *midifile);
 FLUIDSYNTH_API int fluid_player_add_mem(fluid_player_t *player, const void *buffer, size_t len);
+FLUIDSYNTH_API int fluid_player_add_mem_nocopy(fluid_player_t *player, const void *buffer, size_t len);
 FLUIDSYNTH_API int fluid_player_play(fluid_player_t *player);
 FLUIDSYNTH_API int fluid_player_stop(fluid_player_t *player);
 FLUIDSYNTH_API int fluid_player_join(fluid_player_t *player);
+FLUIDSYNTH_API int fluid_player_render(fluid_player_t *player, int frames,
+                                       fluid_player_render_func_t func, void *data);
+FLUIDSYNTH_API int fluid_player_render_segments(fluid_player_t *player, int frames, int jobs,
+        fluid_player_render_func_t func, void *data);
 FLUIDSYNTH_API int fluid_player_set_loop(fluid_player_t *player, int loop);
 FLUIDSYNTH_API int fluid_player_set_midi_tempo(fluid_player_t *player, int tempo);
 FLUIDSYNTH_API int fluid_player_set_bpm(fluid_player_t *player, int bpm);
@@ -64,6 +64,10 @@ FLUIDSYNTH_API int fluid_is_soundfont(const char *filename);
 FLUIDSYNTH_API int fluid_is_midifile(const char *filename);
 FLUIDSYNTH_API void fluid_free(void* ptr);
 
+FLUIDSYNTH_API int fluid_trace_start(void);
+FLUIDSYNTH_API void fluid_trace_stop(void);
+FLUIDSYNTH_API int fluid_trace_dump(const char *filename);
+
 
 #ifdef __cplusplus
 }
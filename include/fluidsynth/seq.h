@@ -59,10 +59,14 @@ FLUIDSYNTH_API
 int fluid_sequencer_send_at(fluid_sequencer_t *seq, fluid_event_t *evt,
                             unsigned int time, int absolute);
 FLUIDSYNTH_API
+int fluid_sequencer_send_batch(fluid_sequencer_t *seq, fluid_event_t **events,
+                               const unsigned int *times, int count, int absolute);
+FLUIDSYNTH_API
 void fluid_sequencer_remove_events(fluid_sequencer_t *seq, fluid_seq_id_t source, fluid_seq_id_t dest, int type);
 FLUIDSYNTH_API unsigned int fluid_sequencer_get_tick(fluid_sequencer_t *seq);
 FLUIDSYNTH_API void fluid_sequencer_set_time_scale(fluid_sequencer_t *seq, double scale);
 FLUIDSYNTH_API double fluid_sequencer_get_time_scale(fluid_sequencer_t *seq);
+FLUIDSYNTH_API void fluid_sequencer_get_queue_stats(fluid_sequencer_t *seq, int *capacity, int *queued, int *max_queued);
 
 #ifdef __cplusplus
 }
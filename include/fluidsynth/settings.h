@@ -181,6 +181,17 @@ FLUIDSYNTH_API
 void fluid_settings_foreach(fluid_settings_t *settings, void *data,
                             fluid_settings_foreach_t func);
 
+FLUIDSYNTH_API
+fluid_setting_handle_t *fluid_settings_get_handle(fluid_settings_t *settings, const char *name);
+FLUIDSYNTH_API
+int fluid_settings_handle_setnum(fluid_setting_handle_t *handle, double val);
+FLUIDSYNTH_API
+int fluid_settings_handle_getnum(fluid_setting_handle_t *handle, double *val);
+FLUIDSYNTH_API
+int fluid_settings_handle_setint(fluid_setting_handle_t *handle, int val);
+FLUIDSYNTH_API
+int fluid_settings_handle_getint(fluid_setting_handle_t *handle, int *val);
+
 #ifdef __cplusplus
 }
 #endif
@@ -68,7 +68,9 @@ enum
 {
     FLUID_PRESET_SELECTED,                /**< Preset selected notify */
     FLUID_PRESET_UNSELECTED,              /**< Preset unselected notify */
-    FLUID_SAMPLE_DONE                     /**< Sample no longer needed notify */
+    FLUID_SAMPLE_DONE,                    /**< Sample no longer needed notify */
+    FLUID_PRESET_PRELOAD,                 /**< Preset about to be selected notify, e.g. by a program change ahead in a MIDI file (see player.program-lookahead) @since 2.2.0 */
+    FLUID_PRESET_PRELOAD_DONE             /**< Preset no longer about to be selected notify, once selected or not played anymore, balancing #FLUID_PRESET_PRELOAD @since 2.2.0 */
 };
 
 /**
@@ -80,6 +80,7 @@ int fluid_synth_get_program(fluid_synth_t *synth, int chan, int *sfont_id,
 FLUIDSYNTH_API int fluid_synth_unset_program(fluid_synth_t *synth, int chan);
 FLUIDSYNTH_API int fluid_synth_program_reset(fluid_synth_t *synth);
 FLUIDSYNTH_API int fluid_synth_system_reset(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_reset_to_initial_state(fluid_synth_t *synth);
 
 FLUIDSYNTH_API int fluid_synth_all_notes_off(fluid_synth_t *synth, int chan);
 FLUIDSYNTH_API int fluid_synth_all_sounds_off(fluid_synth_t *synth, int chan);
@@ -108,6 +109,18 @@ FLUIDSYNTH_API int fluid_synth_stop(fluid_synth_t *synth, unsigned int id);
 
 FLUIDSYNTH_API
 int fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets);
+
+/**
+ * Callback function called when a SoundFont loaded by fluid_synth_sfload_async() is ready
+ *
+ * @param data User defined data pointer
+ * @param synth FluidSynth instance
+ * @param sfont_id ID of the loaded SoundFont, #FLUID_FAILED if it couldn't be loaded
+ */
+typedef void (*fluid_sfload_callback_t)(void *data, fluid_synth_t *synth, int sfont_id);
+
+FLUIDSYNTH_API int fluid_synth_sfload_async(fluid_synth_t *synth, const char *filename, int reset_presets,
+        fluid_sfload_callback_t callback, void *data);
 FLUIDSYNTH_API int fluid_synth_sfreload(fluid_synth_t *synth, int id);
 FLUIDSYNTH_API int fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets);
 FLUIDSYNTH_API int fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
@@ -137,6 +150,12 @@ FLUIDSYNTH_API double fluid_synth_get_reverb_damp(fluid_synth_t *synth);
 FLUIDSYNTH_API double fluid_synth_get_reverb_level(fluid_synth_t *synth);
 FLUIDSYNTH_API double fluid_synth_get_reverb_width(fluid_synth_t *synth);
 
+FLUIDSYNTH_API int fluid_synth_set_reverb_group_ir(fluid_synth_t *synth, int fx_group, const float *left,
+        const float *right, int frames);
+FLUIDSYNTH_API int fluid_synth_load_reverb_group_ir(fluid_synth_t *synth, int fx_group, const char *filename);
+FLUIDSYNTH_API int fluid_synth_set_reverb_group_send(fluid_synth_t *synth, int fx_group, double send);
+FLUIDSYNTH_API int fluid_synth_get_reverb_group_send(fluid_synth_t *synth, int fx_group, double *send);
+
 
 /* Chorus */
 
@@ -164,6 +183,9 @@ FLUIDSYNTH_API double fluid_synth_get_chorus_speed(fluid_synth_t *synth);
 FLUIDSYNTH_API double fluid_synth_get_chorus_depth(fluid_synth_t *synth);
 FLUIDSYNTH_API int fluid_synth_get_chorus_type(fluid_synth_t *synth); /* see fluid_chorus_mod */
 
+FLUIDSYNTH_API int fluid_synth_set_chorus_group_send(fluid_synth_t *synth, int fx_group, double send);
+FLUIDSYNTH_API int fluid_synth_get_chorus_group_send(fluid_synth_t *synth, int fx_group, double *send);
+
 
 /* Audio and MIDI channels */
 
@@ -182,6 +204,8 @@ FLUIDSYNTH_API float fluid_synth_get_gain(fluid_synth_t *synth);
 FLUIDSYNTH_API int fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony);
 FLUIDSYNTH_API int fluid_synth_get_polyphony(fluid_synth_t *synth);
 FLUIDSYNTH_API int fluid_synth_get_active_voice_count(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_set_voice_quota(fluid_synth_t *synth, int chan, int quota);
+FLUIDSYNTH_API int fluid_synth_get_voice_quota(fluid_synth_t *synth, int chan);
 FLUIDSYNTH_API int fluid_synth_get_internal_bufsize(fluid_synth_t *synth);
 
 FLUIDSYNTH_API
@@ -233,6 +257,124 @@ FLUIDSYNTH_API int fluid_synth_tuning_dump(fluid_synth_t *synth, int bank, int p
 /* Misc */
 
 FLUIDSYNTH_API double fluid_synth_get_cpu_load(fluid_synth_t *synth);
+FLUIDSYNTH_API void fluid_synth_get_event_queue_stats(fluid_synth_t *synth, int *capacity, int *queued, int *max_queued);
+
+/**
+ * Statistics about the audio rendering of a synth, see fluid_synth_get_stat()
+ * @since 2.2.0
+ */
+enum fluid_synth_stat
+{
+    FLUID_SYNTH_STAT_DSP_LOAD, /**< Time the latest rendering call took, in percent of the duration of the audio it rendered */
+    FLUID_SYNTH_STAT_PEAK_DSP_LOAD, /**< Highest DSP load of a rendering call */
+    FLUID_SYNTH_STAT_RENDER_CALLS, /**< Number of rendering calls */
+    FLUID_SYNTH_STAT_XRUNS, /**< Number of rendering calls with a DSP load of 100 percent or more, i.e. that took longer than the audio they rendered */
+    FLUID_SYNTH_STAT_PEAK_VOICES, /**< Highest number of voices rendered at once */
+    FLUID_SYNTH_STAT_STOLEN_VOICES, /**< Number of voices killed to start new ones, because the polyphony was exhausted */
+    FLUID_SYNTH_STAT_EVENT_QUEUE_DEPTH, /**< Number of voice event queue entries waiting to be rendered, events with many parameters like envelope updates take up several of them */
+    FLUID_SYNTH_STAT_PEAK_EVENT_QUEUE_DEPTH, /**< Highest number of voice event queue entries that have been waiting at once */
+    FLUID_SYNTH_STAT_MIXER_WAIT, /**< Share of the latest rendering call, in percent, the rendering thread spent waiting for the extra mixer threads of <a href="fluidsettings.xml#synth.cpu-cores">synth.cpu-cores</a> */
+    FLUID_SYNTH_STAT_VOICE_LIMIT, /**< Number of voices allowed at once, less than the polyphony while <a href="fluidsettings.xml#synth.dynamic-polyphony.active">synth.dynamic-polyphony.active</a> has lowered it */
+    FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, /**< Number of times sample data were found in the sample cache shared by all synths of the process, rather than loaded from the SoundFont file */
+    FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, /**< Number of times sample data had to be loaded from the SoundFont file into the sample cache shared by all synths of the process */
+    FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE, /**< Bytes of sample data no longer used but kept in the sample cache, see <a href="fluidsettings.xml#synth.sample-cache-size">synth.sample-cache-size</a> */
+    FLUID_SYNTH_STAT_LAST /**< @internal Value defines the count of statistics (#fluid_synth_stat) @warning This symbol is not part of the public API and ABI stability guarantee and may change at any time! */
+};
+
+/**
+ * Number of buckets of the histogram returned by fluid_synth_get_render_histogram()
+ * @since 2.2.0
+ */
+#define FLUID_SYNTH_RENDER_HISTOGRAM_SIZE 11
+
+FLUIDSYNTH_API double fluid_synth_get_stat(fluid_synth_t *synth, int stat);
+FLUIDSYNTH_API int fluid_synth_get_render_histogram(fluid_synth_t *synth, unsigned int *counts, int size);
+FLUIDSYNTH_API void fluid_synth_reset_stats(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_get_level(fluid_synth_t *synth, int fx, int chan, float *peak, float *rms);
+
+/**
+ * Memory used by a synth, see fluid_synth_get_memory_stats()
+ * @since 2.2.0
+ */
+enum fluid_synth_memory
+{
+    FLUID_SYNTH_MEMORY_SAMPLES_SHARED, /**< Bytes of sample data of the SoundFonts also used by other SoundFonts or processes through the sample cache, or mapped from files */
+    FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE, /**< Bytes of sample data of the SoundFonts only used by them, including the copies of the sample loops */
+    FLUID_SYNTH_MEMORY_SAMPLES_LOCKED, /**< Bytes of the shared and private sample data locked into RAM, see <a href="fluidsettings.xml#synth.lock-memory">synth.lock-memory</a> */
+    FLUID_SYNTH_MEMORY_SOUNDFONTS, /**< Bytes of the presets, instruments, zones and samples of the SoundFonts, and of their parsed files kept loaded */
+    FLUID_SYNTH_MEMORY_VOICES, /**< Bytes of the voices and of their rendering state, for the polyphony of the synth */
+    FLUID_SYNTH_MEMORY_MIXER, /**< Bytes of the buffers the voices are mixed into by the rendering thread, and of the note cache */
+    FLUID_SYNTH_MEMORY_MIXER_THREADS, /**< Bytes of the buffers of the extra mixer threads of <a href="fluidsettings.xml#synth.cpu-cores">synth.cpu-cores</a>, all threads together */
+    FLUID_SYNTH_MEMORY_REVERB, /**< Bytes of the reverb units, including their delay lines and the convolution reverbs */
+    FLUID_SYNTH_MEMORY_CHORUS, /**< Bytes of the chorus units, including their delay lines */
+    FLUID_SYNTH_MEMORY_LADSPA, /**< Bytes of the LADSPA nodes and effects, not counting the memory of the plugins */
+    FLUID_SYNTH_MEMORY_LAST /**< @internal Value defines the count of memory statistics (#fluid_synth_memory) @warning This symbol is not part of the public API and ABI stability guarantee and may change at any time! */
+};
+
+FLUIDSYNTH_API int fluid_synth_get_memory_stats(fluid_synth_t *synth, int sfont_id, size_t *bytes, int size);
+
+/**
+ * Stages of loading a SoundFont, see fluid_synth_get_sfont_load_stats()
+ * @since 2.2.0
+ */
+enum fluid_sfont_load_stage
+{
+    FLUID_SFONT_LOAD_PARSE, /**< Reading and parsing the RIFF chunks and the preset data of the file, or its index in <a href="fluidsettings.xml#synth.sample-cache-dir">synth.sample-cache-dir</a>. Bytes of the preset data. */
+    FLUID_SFONT_LOAD_PRESETS, /**< Creating the samples, presets, instruments and zones from the parsed data, also for the presets imported later by <a href="fluidsettings.xml#synth.lazy-preset-loading">synth.lazy-preset-loading</a>. Bytes allocated for the zones, instruments and modulators. */
+    FLUID_SFONT_LOAD_SAMPLE_IO, /**< Reading or mapping the sample data from the file, or reading the decoded samples from synth.sample-cache-dir. Bytes read or mapped. */
+    FLUID_SFONT_LOAD_SF3_DECODE, /**< Decoding the Ogg Vorbis samples of SF3 files. Bytes of the decoded sample data. */
+    FLUID_SFONT_LOAD_SAMPLE_OPTIMIZE, /**< Copying the sample loops and finding their peaks for the voices playing them. Bytes of the sample data of the samples. */
+    FLUID_SFONT_LOAD_SAMPLE_CACHE, /**< Looking the sample data up in the sample cache and in shared memory, storing them there, converting them to float and locking them into RAM. Bytes of sample data found in the cache. */
+    FLUID_SFONT_LOAD_LAST /**< @internal Value defines the count of SoundFont loading stages (#fluid_sfont_load_stage) @warning This symbol is not part of the public API and ABI stability guarantee and may change at any time! */
+};
+
+FLUIDSYNTH_API int fluid_synth_get_sfont_load_stats(fluid_synth_t *synth, int sfont_id, double *msec, size_t *bytes, int size);
+
+FLUIDSYNTH_API int fluid_synth_save_state(fluid_synth_t *synth, void *data, size_t *size);
+FLUIDSYNTH_API int fluid_synth_restore_state(fluid_synth_t *synth, const void *data, size_t size);
+
+/**
+ * Whether a voice has been started or stopped, see fluid_synth_pop_voice_activity()
+ * @since 2.2.0
+ */
+enum fluid_voice_activity_type
+{
+    FLUID_VOICE_ACTIVITY_START, /**< The voice has been started */
+    FLUID_VOICE_ACTIVITY_STOP, /**< The voice has finished playing or has been killed */
+};
+
+FLUIDSYNTH_API int fluid_synth_pop_voice_activity(fluid_synth_t *synth, int *type, int *chan, int *key,
+        unsigned int *id, int *active_voices);
+
+/**
+ * Stage of the volume envelope of a voice, see #fluid_voice_snapshot_t
+ * @since 2.2.0
+ */
+enum fluid_voice_envelope_stage
+{
+    FLUID_VOICE_ENVELOPE_DELAY,    /**< Delay before the attack */
+    FLUID_VOICE_ENVELOPE_ATTACK,   /**< Attack */
+    FLUID_VOICE_ENVELOPE_HOLD,     /**< Hold at the peak */
+    FLUID_VOICE_ENVELOPE_DECAY,    /**< Decay to the sustain level */
+    FLUID_VOICE_ENVELOPE_SUSTAIN,  /**< Sustain */
+    FLUID_VOICE_ENVELOPE_RELEASE,  /**< Release after the note off */
+    FLUID_VOICE_ENVELOPE_FINISHED, /**< The voice has finished playing */
+};
+
+/**
+ * State of a voice after a rendering call, see fluid_synth_get_voice_snapshot()
+ * @since 2.2.0
+ */
+struct _fluid_voice_snapshot_t
+{
+    int chan;        /**< MIDI channel */
+    int key;         /**< MIDI note */
+    int vel;         /**< MIDI velocity */
+    int stage;       /**< Stage of the volume envelope (#fluid_voice_envelope_stage) */
+    unsigned int id; /**< ID of the voice (see fluid_voice_get_id()), shared by the voices of a note */
+};
+
+FLUIDSYNTH_API int fluid_synth_get_voice_snapshot(fluid_synth_t *synth, fluid_voice_snapshot_t *voices, int size);
 FLUID_DEPRECATED FLUIDSYNTH_API const char *fluid_synth_error(fluid_synth_t *synth);
 
 
@@ -262,6 +404,14 @@ FLUIDSYNTH_API int fluid_synth_remove_default_mod(fluid_synth_t *synth, const fl
 FLUIDSYNTH_API int fluid_synth_write_s16(fluid_synth_t *synth, int len,
         void *lout, int loff, int lincr,
         void *rout, int roff, int rincr);
+FLUIDSYNTH_API int fluid_synth_write_interleaved(fluid_synth_t *synth, int len,
+        int nchannels, float *out);
+FLUIDSYNTH_API int fluid_synth_write_s24(fluid_synth_t *synth, int len,
+        void *lout, int loff, int lincr,
+        void *rout, int roff, int rincr);
+FLUIDSYNTH_API int fluid_synth_write_s32(fluid_synth_t *synth, int len,
+        void *lout, int loff, int lincr,
+        void *rout, int roff, int rincr);
 FLUIDSYNTH_API int fluid_synth_write_float(fluid_synth_t *synth, int len,
         void *lout, int loff, int lincr,
         void *rout, int roff, int rincr);
@@ -273,6 +423,30 @@ FLUIDSYNTH_API int fluid_synth_process(fluid_synth_t *synth, int len,
                                        int nout, float *out[]);
 
 
+
+/*
+ * Synth cluster
+ *
+ * A cluster spreads the MIDI channels over several synths, each rendered on
+ * its own thread, for setups with many channels. Route the MIDI events to
+ * fluid_synth_cluster_handle_midi_event() and render the cluster in place of
+ * a synth.
+ */
+
+FLUIDSYNTH_API fluid_synth_cluster_t *new_fluid_synth_cluster(fluid_settings_t *settings, int engines);
+FLUIDSYNTH_API void delete_fluid_synth_cluster(fluid_synth_cluster_t *cluster);
+FLUIDSYNTH_API int fluid_synth_cluster_count_engines(fluid_synth_cluster_t *cluster);
+FLUIDSYNTH_API fluid_synth_t *fluid_synth_cluster_get_engine(fluid_synth_cluster_t *cluster, int index);
+FLUIDSYNTH_API fluid_synth_t *fluid_synth_cluster_get_channel_engine(fluid_synth_cluster_t *cluster,
+        int chan, int *engine_chan);
+FLUIDSYNTH_API int fluid_synth_cluster_handle_midi_event(void *data, fluid_midi_event_t *event);
+FLUIDSYNTH_API int fluid_synth_cluster_sfload(fluid_synth_cluster_t *cluster, const char *filename,
+        int reset_presets);
+FLUIDSYNTH_API int fluid_synth_cluster_sfunload(fluid_synth_cluster_t *cluster, int id, int reset_presets);
+FLUIDSYNTH_API int fluid_synth_cluster_write_float(fluid_synth_cluster_t *cluster, int len,
+        void *lout, int loff, int lincr,
+        void *rout, int roff, int rincr);
+
 /* Synthesizer's interface to handle SoundFont loaders */
 
 FLUIDSYNTH_API void fluid_synth_add_sfloader(fluid_synth_t *synth, fluid_sfloader_t *loader);
@@ -283,6 +457,7 @@ FLUIDSYNTH_API void fluid_synth_start_voice(fluid_synth_t *synth, fluid_voice_t
 FLUIDSYNTH_API void fluid_synth_get_voicelist(fluid_synth_t *synth,
         fluid_voice_t *buf[], int bufsize, int ID);
 FLUIDSYNTH_API int fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event);
+FLUIDSYNTH_API int fluid_synth_handle_midi_events(fluid_synth_t *synth, fluid_midi_event_t **events, int n);
 
 /**
  * Specifies the type of filter to use for the custom IIR filter
@@ -35,7 +35,9 @@ extern "C" {
 
 typedef struct _fluid_hashtable_t fluid_settings_t;             /**< Configuration settings instance */
 typedef struct _fluid_synth_t fluid_synth_t;                    /**< Synthesizer instance */
+typedef struct _fluid_synth_cluster_t fluid_synth_cluster_t;    /**< Synthesizers sharing out the MIDI channels, see new_fluid_synth_cluster() */
 typedef struct _fluid_voice_t fluid_voice_t;                    /**< Synthesis voice instance */
+typedef struct _fluid_voice_snapshot_t fluid_voice_snapshot_t;  /**< State of a voice, see fluid_synth_get_voice_snapshot() */
 typedef struct _fluid_sfloader_t fluid_sfloader_t;              /**< SoundFont loader plugin */
 typedef struct _fluid_sfont_t fluid_sfont_t;                    /**< SoundFont */
 typedef struct _fluid_preset_t fluid_preset_t;                  /**< SoundFont preset */
@@ -58,6 +60,7 @@ typedef struct _fluid_rampreset_t fluid_rampreset_t;            /**< RAM SoundFo
 typedef struct _fluid_cmd_handler_t fluid_cmd_handler_t;        /**< Shell Command Handler */
 typedef struct _fluid_ladspa_fx_t fluid_ladspa_fx_t;            /**< LADSPA effects instance */
 typedef struct _fluid_file_callbacks_t fluid_file_callbacks_t;  /**< Callback struct to perform custom file loading of soundfonts */
+typedef struct _fluid_setting_node_t fluid_setting_handle_t;   /**< Handle of a numeric or integer setting, see fluid_settings_get_handle() */
 
 typedef int fluid_istream_t;    /**< Input stream descriptor */
 typedef int fluid_ostream_t;    /**< Output stream descriptor */
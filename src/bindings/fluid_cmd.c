@@ -43,6 +43,8 @@ struct _fluid_cmd_handler_t
 
     fluid_midi_router_rule_t *cmd_rule;        /* Rule currently being processed by shell command handler */
     int cmd_rule_type;                         /* Type of the rule (#fluid_midi_router_rule_type) */
+
+    int fast_commands;                         /* Bit i set if fluid_fast_commands[i] is registered with its own handler */
 };
 
 
@@ -67,6 +69,7 @@ void fluid_shell_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_str(settings, "shell.prompt", "", 0);
     fluid_settings_register_int(settings, "shell.port", 9800, 1, 65535, 0);
+    fluid_settings_register_int(settings, "shell.quiet", 0, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 
@@ -380,10 +383,186 @@ static const fluid_cmd_t fluid_commands[] =
     {
         "prof_start", "profile",      fluid_handle_prof_start,
         "prof_start [n_prof [dur]]      Starts n_prof measures of duration(ms) each"
-    }
+    },
+#endif
+#if WITH_TRACE
+    /* Tracing commands */
+    {
+        "trace_start", "trace", fluid_handle_trace_start,
+        "trace_start                Starts recording the trace points of the rendering"
+    },
+    {
+        "trace_stop", "trace", fluid_handle_trace_stop,
+        "trace_stop                 Stops recording the trace points"
+    },
+    {
+        "trace_dump", "trace", fluid_handle_trace_dump,
+        "trace_dump filename        Stops recording and writes the trace points as a Chrome trace"
+    },
 #endif
 };
 
+/* The most frequent commands, which fluid_command() parses without splitting them
+ * into arguments or looking them up, as long as they have exactly num_args integer
+ * arguments. Anything else is left to their regular handler. */
+enum
+{
+    FLUID_FAST_NOTEON,
+    FLUID_FAST_NOTEOFF,
+    FLUID_FAST_CC,
+    FLUID_FAST_PROG,
+    FLUID_FAST_PITCH_BEND,
+    FLUID_FAST_COMMAND_COUNT
+};
+
+static const struct
+{
+    const char *name;
+    int num_args;
+    fluid_cmd_func_t handler;
+} fluid_fast_commands[FLUID_FAST_COMMAND_COUNT] =
+{
+    { "noteon", 3, fluid_handle_noteon },
+    { "noteoff", 2, fluid_handle_noteoff },
+    { "cc", 3, fluid_handle_cc },
+    { "prog", 2, fluid_handle_prog },
+    { "pitch_bend", 2, fluid_handle_pitch_bend }
+};
+
+#define fluid_command_is_blank(c) ((c) == ' ' || (c) == '\t' || (c) == '\n')
+
+/* Finds out which of the fast commands still run their regular handler */
+static void
+fluid_cmd_handler_update_fast_commands(fluid_cmd_handler_t *handler)
+{
+    fluid_cmd_t *cmd;
+    int i;
+
+    handler->fast_commands = 0;
+
+    for(i = 0; i < FLUID_FAST_COMMAND_COUNT; i++)
+    {
+        cmd = fluid_hashtable_lookup(handler->commands, fluid_fast_commands[i].name);
+
+        if(cmd != NULL && cmd->handler == fluid_fast_commands[i].handler)
+        {
+            handler->fast_commands |= 1 << i;
+        }
+    }
+}
+
+/*
+ * Handles cmd in place if it is one of the fast commands with valid arguments.
+ * Returns TRUE and the result of the command in *result if so, FALSE if cmd has
+ * to go through the regular handler.
+ */
+static int
+fluid_command_fast(fluid_cmd_handler_t *handler, const char *cmd, int *result)
+{
+    int args[3];
+    const char *name;
+    int i, len, num_args = 0, val, neg;
+
+    while(fluid_command_is_blank(*cmd))
+    {
+        cmd++;
+    }
+
+    for(name = cmd; (*cmd >= 'a' && *cmd <= 'z') || *cmd == '_'; cmd++)
+    {
+    }
+
+    len = (int)(cmd - name);
+
+    for(i = 0; i < FLUID_FAST_COMMAND_COUNT; i++)
+    {
+        if((handler->fast_commands & (1 << i))
+                && FLUID_STRNCMP(name, fluid_fast_commands[i].name, len) == 0
+                && fluid_fast_commands[i].name[len] == '\0')
+        {
+            break;
+        }
+    }
+
+    if(i == FLUID_FAST_COMMAND_COUNT || !fluid_command_is_blank(*cmd))
+    {
+        return FALSE;
+    }
+
+    while(TRUE)
+    {
+        while(fluid_command_is_blank(*cmd))
+        {
+            cmd++;
+        }
+
+        if(*cmd == '\0')
+        {
+            break;
+        }
+
+        if(num_args == fluid_fast_commands[i].num_args)
+        {
+            return FALSE;
+        }
+
+        neg = (*cmd == '-');
+
+        if(*cmd == '-' || *cmd == '+')
+        {
+            cmd++;
+        }
+
+        if(*cmd < '0' || *cmd > '9')
+        {
+            return FALSE;
+        }
+
+        /* values too large for any of the commands are left to the usual checks */
+        for(val = 0; *cmd >= '0' && *cmd <= '9' && val < 100000000; cmd++)
+        {
+            val = val * 10 + (*cmd - '0');
+        }
+
+        if(*cmd != '\0' && !fluid_command_is_blank(*cmd))
+        {
+            return FALSE;
+        }
+
+        args[num_args++] = neg ? -val : val;
+    }
+
+    if(num_args != fluid_fast_commands[i].num_args)
+    {
+        return FALSE;
+    }
+
+    switch(i)
+    {
+    case FLUID_FAST_NOTEON:
+        *result = fluid_synth_noteon(handler->synth, args[0], args[1], args[2]);
+        break;
+
+    case FLUID_FAST_NOTEOFF:
+        *result = fluid_synth_noteoff(handler->synth, args[0], args[1]);
+        break;
+
+    case FLUID_FAST_CC:
+        *result = fluid_synth_cc(handler->synth, args[0], args[1], args[2]);
+        break;
+
+    case FLUID_FAST_PROG:
+        *result = fluid_synth_program_change(handler->synth, args[0], args[1]);
+        break;
+
+    default:
+        *result = fluid_synth_pitch_bend(handler->synth, args[0], args[1]);
+        break;
+    }
+
+    return TRUE;
+}
+
 /**
  * Process a string command.
  * NOTE: FluidSynth 1.0.8 and above no longer modifies the 'cmd' string.
@@ -404,6 +583,11 @@ fluid_command(fluid_cmd_handler_t *handler, const char *cmd, fluid_ostream_t out
         return 1;
     }
 
+    if(fluid_command_fast(handler, cmd, &result))
+    {
+        return result;
+    }
+
     if(!g_shell_parse_argv(cmd, &num_tokens, &tokens, NULL))
     {
         fluid_ostream_printf(out, "Error parsing command\n");
@@ -494,21 +678,34 @@ fluid_shell_run(void *data)
 {
     fluid_shell_t *shell = (fluid_shell_t *)data;
     char workline[FLUID_WORKLINELENGTH];
+    fluid_ostream_t out = shell->out;
     char *prompt = NULL;
     int cont = 1;
     int errors = FALSE;
+    int quiet = FALSE;
     int n;
 
     if(shell->settings)
     {
-        fluid_settings_dupstr(shell->settings, "shell.prompt", &prompt);    /* ++ alloc prompt */
+        fluid_settings_getint(shell->settings, "shell.quiet", &quiet);
+
+        if(!quiet)
+        {
+            fluid_settings_dupstr(shell->settings, "shell.prompt", &prompt);    /* ++ alloc prompt */
+        }
+    }
+
+    if(quiet)
+    {
+        /* neither prompt nor replies, only the commands matter */
+        out = FLUID_NULL_OSTREAM;
     }
 
     /* handle user input */
     while(cont)
     {
 
-        n = fluid_istream_readline(shell->in, shell->out, prompt ? prompt : "", workline, FLUID_WORKLINELENGTH);
+        n = fluid_istream_readline(shell->in, out, prompt ? prompt : "", workline, FLUID_WORKLINELENGTH);
 
         if(n < 0)
         {
@@ -517,7 +714,7 @@ fluid_shell_run(void *data)
         }
 
         /* handle the command */
-        switch(fluid_command(shell->handler, workline, shell->out))
+        switch(fluid_command(shell->handler, workline, out))
         {
 
         case 1: /* empty line or comment */
@@ -4054,6 +4251,45 @@ fluid_handle_prof_start(void *data, int ac, char **av, fluid_ostream_t out)
 }
 #endif /* WITH_PROFILING */
 
+#if WITH_TRACE
+int
+fluid_handle_trace_start(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    if(fluid_trace_start() != FLUID_OK)
+    {
+        fluid_ostream_printf(out, "trace_start: failed to start tracing.\n");
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
+int
+fluid_handle_trace_stop(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    fluid_trace_stop();
+    return FLUID_OK;
+}
+
+int
+fluid_handle_trace_dump(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    if(ac < 1)
+    {
+        fluid_ostream_printf(out, "trace_dump: too few arguments.\n");
+        return FLUID_FAILED;
+    }
+
+    if(fluid_trace_dump(av[0]) != FLUID_OK)
+    {
+        fluid_ostream_printf(out, "trace_dump: failed to write '%s'.\n", av[0]);
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+#endif /* WITH_TRACE */
+
 int
 fluid_is_number(char *a)
 {
@@ -4215,7 +4451,10 @@ int
 fluid_cmd_handler_register(fluid_cmd_handler_t *handler, const fluid_cmd_t *cmd)
 {
     fluid_cmd_t *copy = fluid_cmd_copy(cmd);
-    fluid_hashtable_insert(handler->commands, copy->name, copy);
+    /* the key is the name of the copy, so it has to be replaced together with
+     * the command registered before under the same name */
+    fluid_hashtable_replace(handler->commands, copy->name, copy);
+    fluid_cmd_handler_update_fast_commands(handler);
     return FLUID_OK;
 }
 
@@ -4228,7 +4467,9 @@ fluid_cmd_handler_register(fluid_cmd_handler_t *handler, const fluid_cmd_t *cmd)
 int
 fluid_cmd_handler_unregister(fluid_cmd_handler_t *handler, const char *cmd)
 {
-    return fluid_hashtable_remove(handler->commands, cmd);
+    int removed = fluid_hashtable_remove(handler->commands, cmd);
+    fluid_cmd_handler_update_fast_commands(handler);
+    return removed;
 }
 
 int
@@ -4265,33 +4506,70 @@ static void fluid_server_close(fluid_server_t *server)
 {
     fluid_list_t *list;
     fluid_list_t *clients;
-    fluid_client_t *client;
 
     fluid_return_if_fail(server != NULL);
 
+    /* stops the thread serving the clients */
+    if(server->socket)
+    {
+        delete_fluid_server_socket(server->socket);
+        server->socket = NULL;
+    }
+
     fluid_mutex_lock(server->mutex);
     clients = server->clients;
     server->clients = NULL;
     fluid_mutex_unlock(server->mutex);
 
-    list = clients;
-
-    while(list)
+    for(list = clients; list; list = fluid_list_next(list))
     {
-        client = fluid_list_get(list);
-        fluid_client_quit(client);
-        list = fluid_list_next(list);
+        delete_fluid_client(fluid_list_get(list));
     }
 
     delete_fluid_list(clients);
-
-    if(server->socket)
-    {
-        delete_fluid_server_socket(server->socket);
-        server->socket = NULL;
-    }
 }
 
+/*
+ * Binary protocol
+ *
+ * A client selects the binary protocol by sending the byte FLUID_CLIENT_BINARY_MAGIC
+ * first, any other first byte selects the text shell. After that, the connection
+ * carries a stream of events, which are never replied to. Each event is:
+ *
+ * - the status byte of a MIDI channel message, with the channel bits set to 0:
+ *   0x80 note off, 0x90 note on, 0xA0 key pressure, 0xB0 control change,
+ *   0xC0 program change, 0xD0 channel pressure or 0xE0 pitch bend
+ * - the channel, one byte, so that all 256 channels of a synth can be addressed
+ * - the data bytes of the MIDI message, two of them, or one for program change
+ *   and channel pressure. Pitch bend is sent LSB first.
+ *
+ * Any number of events may be sent at once, they are dispatched in order as soon
+ * as they are complete. An unknown status byte closes the connection.
+ */
+#define FLUID_CLIENT_BINARY_MAGIC 0xF5
+
+enum
+{
+    FLUID_CLIENT_NEW,
+    FLUID_CLIENT_TEXT,
+    FLUID_CLIENT_BINARY
+};
+
+struct _fluid_client_t
+{
+    fluid_server_t *server;
+    fluid_settings_t *settings;
+    fluid_cmd_handler_t *handler;
+    fluid_socket_t socket;
+    int protocol;
+    char *prompt;
+    int quiet;                      /* TRUE to send neither prompts nor replies to text commands */
+    int len;                        /* bytes received in buf, not handled yet */
+    char buf[FLUID_WORKLINELENGTH];
+};
+
+static int fluid_server_handle_input(fluid_server_t *server, fluid_socket_t client_socket);
+
 static int
 fluid_server_handle_connection(fluid_server_t *server, fluid_socket_t client_socket, char *addr)
 {
@@ -4306,6 +4584,11 @@ fluid_server_handle_connection(fluid_server_t *server, fluid_socket_t client_soc
 
     fluid_server_add_client(server, client);
 
+    if(client->prompt[0] != '\0' && !client->quiet)
+    {
+        fluid_ostream_printf(fluid_socket_get_ostream(client_socket), "%s", client->prompt);
+    }
+
     return 0;
 }
 
@@ -4323,33 +4606,225 @@ void fluid_server_remove_client(fluid_server_t *server, fluid_client_t *client)
     fluid_mutex_unlock(server->mutex);
 }
 
-struct _fluid_client_t
+static fluid_client_t *
+fluid_server_find_client(fluid_server_t *server, fluid_socket_t client_socket)
 {
-    fluid_server_t *server;
-    fluid_settings_t *settings;
-    fluid_cmd_handler_t *handler;
-    fluid_socket_t socket;
-    fluid_thread_t *thread;
-};
+    fluid_list_t *list;
+    fluid_client_t *client = NULL;
 
+    fluid_mutex_lock(server->mutex);
 
-static fluid_thread_return_t fluid_client_run(void *data)
+    for(list = server->clients; list; list = fluid_list_next(list))
+    {
+        if(((fluid_client_t *)fluid_list_get(list))->socket == client_socket)
+        {
+            client = fluid_list_get(list);
+            break;
+        }
+    }
+
+    fluid_mutex_unlock(server->mutex);
+
+    return client;
+}
+
+/* Handles a text command, returns -2 if the client quit */
+static int
+fluid_client_handle_line(fluid_client_t *client, char *line)
 {
-    fluid_shell_t shell;
-    fluid_client_t *client = (fluid_client_t *)data;
+    fluid_ostream_t out = client->quiet ? FLUID_NULL_OSTREAM : fluid_socket_get_ostream(client->socket);
+    int len = FLUID_STRLEN(line);
 
-    fluid_shell_init(&shell,
-                     client->settings,
-                     client->handler,
-                     fluid_socket_get_istream(client->socket),
-                     fluid_socket_get_ostream(client->socket));
-    fluid_shell_run(&shell);
-    fluid_server_remove_client(client->server, client);
-    delete_fluid_client(client);
+    if(len > 0 && line[len - 1] == '\r')
+    {
+        line[len - 1] = '\0';
+    }
+
+    if(fluid_command(client->handler, line, out) == -2)
+    {
+        return -2;
+    }
+
+    if(client->prompt[0] != '\0' && !client->quiet)
+    {
+        fluid_ostream_printf(out, "%s", client->prompt);
+    }
+
+    return FLUID_OK;
+}
+
+/* Handles all complete lines received, returns the count of bytes handled or -2 if the client quit */
+static int
+fluid_client_handle_text(fluid_client_t *client)
+{
+    int i, start = 0;
+
+    for(i = 0; i < client->len; i++)
+    {
+        if(client->buf[i] == '\n')
+        {
+            client->buf[i] = '\0';
+
+            if(fluid_client_handle_line(client, client->buf + start) == -2)
+            {
+                return -2;
+            }
+
+            start = i + 1;
+        }
+    }
+
+    /* a line longer than the buffer is cut */
+    if(start == 0 && client->len == FLUID_WORKLINELENGTH - 1)
+    {
+        client->buf[client->len] = '\0';
+        return (fluid_client_handle_line(client, client->buf) == -2) ? -2 : client->len;
+    }
+
+    return start;
+}
+
+/* Returns the size of a binary event with the given status byte, or -1 if it's unknown */
+static int
+fluid_client_binary_event_size(unsigned char status)
+{
+    switch(status)
+    {
+    case NOTE_OFF:
+    case NOTE_ON:
+    case KEY_PRESSURE:
+    case CONTROL_CHANGE:
+    case PITCH_BEND:
+        return 4;
+
+    case PROGRAM_CHANGE:
+    case CHANNEL_PRESSURE:
+        return 3;
+
+    default:
+        return -1;
+    }
+}
+
+/* Dispatches all complete events received, returns the count of bytes handled or -1 on a protocol error */
+static int
+fluid_client_handle_binary(fluid_client_t *client)
+{
+    fluid_synth_t *synth = client->server->synth;
+    const unsigned char *ev;
+    int size, pos = 0;
+
+    while(pos < client->len)
+    {
+        ev = (const unsigned char *)client->buf + pos;
+        size = fluid_client_binary_event_size(ev[0]);
+
+        if(size < 0)
+        {
+            FLUID_LOG(FLUID_WARN, "Unknown event 0x%02x received from binary client, closing the connection", ev[0]);
+            return -1;
+        }
 
-    return FLUID_THREAD_RETURN_VALUE;
+        if(pos + size > client->len)
+        {
+            break;
+        }
+
+        pos += size;
+
+        if(synth == NULL)
+        {
+            continue;
+        }
+
+        /* invalid values are refused by the synth, there is no one to tell */
+        switch(ev[0])
+        {
+        case NOTE_OFF:
+            fluid_synth_noteoff(synth, ev[1], ev[2]);
+            break;
+
+        case NOTE_ON:
+            fluid_synth_noteon(synth, ev[1], ev[2], ev[3]);
+            break;
+
+        case KEY_PRESSURE:
+            fluid_synth_key_pressure(synth, ev[1], ev[2], ev[3]);
+            break;
+
+        case CONTROL_CHANGE:
+            fluid_synth_cc(synth, ev[1], ev[2], ev[3]);
+            break;
+
+        case PROGRAM_CHANGE:
+            fluid_synth_program_change(synth, ev[1], ev[2]);
+            break;
+
+        case CHANNEL_PRESSURE:
+            fluid_synth_channel_pressure(synth, ev[1], ev[2]);
+            break;
+
+        case PITCH_BEND:
+            fluid_synth_pitch_bend(synth, ev[1], (ev[3] << 7) | ev[2]);
+            break;
+        }
+    }
+
+    return pos;
 }
 
+/* Called by the server thread whenever a client socket is readable */
+static int
+fluid_server_handle_input(fluid_server_t *server, fluid_socket_t client_socket)
+{
+    fluid_client_t *client = fluid_server_find_client(server, client_socket);
+    int n;
+
+    if(client == NULL)
+    {
+        /* the server is closing */
+        return 0;
+    }
+
+    n = fluid_socket_recv(client_socket, client->buf + client->len, FLUID_WORKLINELENGTH - 1 - client->len);
+
+    if(n > 0)
+    {
+        client->len += n;
+
+        if(client->protocol == FLUID_CLIENT_NEW)
+        {
+            client->protocol = ((unsigned char)client->buf[0] == FLUID_CLIENT_BINARY_MAGIC)
+                               ? FLUID_CLIENT_BINARY : FLUID_CLIENT_TEXT;
+
+            if(client->protocol == FLUID_CLIENT_BINARY)
+            {
+                FLUID_MEMMOVE(client->buf, client->buf + 1, --client->len);
+            }
+        }
+
+        n = (client->protocol == FLUID_CLIENT_BINARY) ? fluid_client_handle_binary(client)
+            : fluid_client_handle_text(client);
+
+        if(n >= 0)
+        {
+            client->len -= n;
+            FLUID_MEMMOVE(client->buf, client->buf + n, client->len);
+            return 0;
+        }
+    }
+    else if(n == 0 && client->protocol == FLUID_CLIENT_TEXT && client->len > 0)
+    {
+        /* the last line may lack its newline */
+        client->buf[client->len] = '\0';
+        fluid_client_handle_line(client, client->buf);
+    }
+
+    fluid_server_remove_client(server, client);
+    delete_fluid_client(client);
+
+    return -1;
+}
 
 fluid_client_t *
 new_fluid_client(fluid_server_t *server, fluid_settings_t *settings, fluid_socket_t sock)
@@ -4364,34 +4839,27 @@ new_fluid_client(fluid_server_t *server, fluid_settings_t *settings, fluid_socke
         return NULL;
     }
 
+    FLUID_MEMSET(client, 0, sizeof(*client));
+
     client->server = server;
     client->socket = sock;
     client->settings = settings;
+    client->protocol = FLUID_CLIENT_NEW;
     client->handler = new_fluid_cmd_handler(server->synth, server->router);
-    client->thread = new_fluid_thread("client", fluid_client_run, client,
-                                      0, FALSE);
+    fluid_settings_dupstr(settings, "shell.prompt", &client->prompt);    /* ++ alloc prompt */
+    fluid_settings_getint(settings, "shell.quiet", &client->quiet);
 
-    if(client->handler == NULL || client->thread == NULL)
+    if(client->handler == NULL || client->prompt == NULL)
     {
-        goto error_recovery;
+        /* the socket is closed by the server */
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_cmd_handler(client->handler);
+        FLUID_FREE(client->prompt);
+        FLUID_FREE(client);
+        return NULL;
     }
 
     return client;
-
-error_recovery:
-    FLUID_LOG(FLUID_ERR, "Out of memory");
-    delete_fluid_client(client);
-    return NULL;
-
-}
-
-void fluid_client_quit(fluid_client_t *client)
-{
-    fluid_socket_close(client->socket);
-
-    FLUID_LOG(FLUID_DBG, "fluid_client_quit: joining");
-    fluid_thread_join(client->thread);
-    FLUID_LOG(FLUID_DBG, "fluid_client_quit: done");
 }
 
 void delete_fluid_client(fluid_client_t *client)
@@ -4400,7 +4868,7 @@ void delete_fluid_client(fluid_client_t *client)
 
     delete_fluid_cmd_handler(client->handler);
     fluid_socket_close(client->socket);
-    delete_fluid_thread(client->thread);
+    FLUID_FREE(client->prompt);    /* -- free prompt */
 
     FLUID_FREE(client);
 }
@@ -4441,6 +4909,7 @@ new_fluid_server(fluid_settings_t *settings,
 
     server->socket = new_fluid_server_socket(port,
                      (fluid_server_func_t) fluid_server_handle_connection,
+                     (fluid_server_read_func_t) fluid_server_handle_input,
                      server);
 
     if(server->socket == NULL)
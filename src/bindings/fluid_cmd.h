@@ -91,6 +91,12 @@ int fluid_handle_prof_set_print(void *data, int ac, char **av, fluid_ostream_t o
 int fluid_handle_prof_start(void *data, int ac, char **av, fluid_ostream_t out);
 #endif
 
+#if WITH_TRACE
+int fluid_handle_trace_start(void *data, int ac, char **av, fluid_ostream_t out);
+int fluid_handle_trace_stop(void *data, int ac, char **av, fluid_ostream_t out);
+int fluid_handle_trace_dump(void *data, int ac, char **av, fluid_ostream_t out);
+#endif
+
 int fluid_handle_basicchannels(void *data, int ac, char **av, fluid_ostream_t out);
 int fluid_handle_resetbasicchannels(void *data, int ac, char **av, fluid_ostream_t out);
 int fluid_handle_setbasicchannels(void *data, int ac, char **av, fluid_ostream_t out);
@@ -156,7 +162,6 @@ fluid_client_t *new_fluid_client(fluid_server_t *server,
                                  fluid_socket_t sock);
 
 void delete_fluid_client(fluid_client_t *client);
-void fluid_client_quit(fluid_client_t *client);
 
 
 #endif /* _FLUID_CMD_H */
@@ -30,9 +30,26 @@
 #include <sndfile.h>
 #endif
 
+/* State shared with the thread writing the rendered audio to the file, while the next buffer is being synthesized */
+typedef struct
+{
+    fluid_file_renderer_t *dev;
+    void *buf[2];                 /* rendered to alternately, while the other one is written */
+    int frames[2];                /* number of frames to write from each buffer, 0 if it may be rendered to */
+    int buf_frames;               /* size of each buffer, in frames */
+    int cur;                      /* the buffer rendered to */
+    int pos;                      /* number of frames rendered to the current buffer so far */
+    int done;                     /* TRUE once no more buffers will be rendered */
+    int failed;                   /* TRUE if writing to the file failed */
+    fluid_cond_mutex_t *mutex;
+    fluid_cond_t *cond;
+    fluid_thread_t *thread;
+} fluid_file_writer_t;
+
 struct _fluid_file_renderer_t
 {
     fluid_synth_t *synth;
+    fluid_file_writer_t *writer;  /* writes the blocks of fluid_file_renderer_process_block() if audio.file.threaded is enabled */
 
 #if LIBSNDFILE_SUPPORT
     SNDFILE *sndfile;
@@ -46,6 +63,25 @@ struct _fluid_file_renderer_t
     int buf_size;
 };
 
+/* Number of frames rendered at once by fluid_file_renderer_process_player() */
+#define FLUID_FILE_RENDERER_BATCH_FRAMES (FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE)
+
+/* Size of a stereo frame, in the sample format written to the file */
+#if LIBSNDFILE_SUPPORT
+#define FLUID_FILE_RENDERER_FRAME_SIZE (2 * sizeof(float))
+#else
+#define FLUID_FILE_RENDERER_FRAME_SIZE (2 * sizeof(short))
+#endif
+
+static void fluid_file_renderer_render(fluid_file_renderer_t *dev, void *buf, int frames);
+static int fluid_file_renderer_write(fluid_file_renderer_t *dev, void *buf, int frames);
+static fluid_file_writer_t *new_fluid_file_writer(fluid_file_renderer_t *dev, int buf_frames);
+static int delete_fluid_file_writer(fluid_file_writer_t *writer);
+static int fluid_file_writer_acquire(fluid_file_writer_t *writer);
+static int fluid_file_writer_finish(fluid_file_renderer_t *dev, fluid_file_writer_t *writer);
+static void fluid_file_writer_submit(fluid_file_writer_t *writer);
+static fluid_thread_return_t fluid_file_renderer_writer_run(void *data);
+
 #if LIBSNDFILE_SUPPORT
 
 /* Default file type used, if none specified and auto extension search fails */
@@ -167,6 +203,8 @@ fluid_file_renderer_settings(fluid_settings_t *settings)
     fluid_settings_register_str(settings, "audio.file.endian", "cpu", 0);
     fluid_settings_add_option(settings, "audio.file.endian", "cpu");
 #endif
+
+    fluid_settings_register_int(settings, "audio.file.threaded", 0, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 /**
@@ -185,6 +223,8 @@ fluid_file_renderer_settings(fluid_settings_t *settings)
  *     extension with fallback to "wav".
  *   - audio.file.format: Audio format
  *   - audio.file.endian: Endian byte order, "auto" for file type's default byte order
+ *   - audio.file.threaded: Write the blocks of fluid_file_renderer_process_block()
+ *     to the file by a separate thread
  *   - audio.period-size: Size of audio blocks to process
  *   - synth.sample-rate: Sample rate to use
  */
@@ -199,6 +239,7 @@ new_fluid_file_renderer(fluid_synth_t *synth)
 #endif
     char *filename = NULL;
     fluid_file_renderer_t *dev;
+    int threaded = 0;
 
     fluid_return_val_if_fail(synth != NULL, NULL);
     fluid_return_val_if_fail(synth->settings != NULL, NULL);
@@ -308,6 +349,20 @@ new_fluid_file_renderer(fluid_synth_t *synth)
 
 #endif
 
+    fluid_settings_getint(synth->settings, "audio.file.threaded", &threaded);
+
+    if(threaded)
+    {
+        /* also large enough for the blocks of fluid_file_renderer_process_player() */
+        dev->writer = new_fluid_file_writer(dev, (dev->period_size > FLUID_FILE_RENDERER_BATCH_FRAMES)
+                                            ? dev->period_size : FLUID_FILE_RENDERER_BATCH_FRAMES);
+
+        if(dev->writer == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
     FLUID_FREE(filename);
     return dev;
 
@@ -350,6 +405,20 @@ void delete_fluid_file_renderer(fluid_file_renderer_t *dev)
 {
     fluid_return_if_fail(dev != NULL);
 
+    /* write the blocks still pending */
+    if(dev->writer != NULL)
+    {
+        if(dev->writer->pos > 0)
+        {
+            fluid_file_writer_submit(dev->writer);
+        }
+
+        if(delete_fluid_file_writer(dev->writer) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_WARN, "Not all audio has been written to the file");
+        }
+    }
+
 #if LIBSNDFILE_SUPPORT
 
     if(dev->sndfile != NULL)
@@ -380,18 +449,419 @@ void delete_fluid_file_renderer(fluid_file_renderer_t *dev)
  * @param dev File renderer instance
  * @return #FLUID_OK or #FLUID_FAILED if an error occurred
  * @since 1.1.0
+ *
+ * If "audio.file.threaded" is enabled, the block is only synthesized, and
+ * written to the file by a separate thread, together with the following
+ * ones, while they are being synthesized. An error writing to the file is
+ * then returned by one of the following calls, and the file is complete
+ * once the renderer has been deleted.
  */
 int
 fluid_file_renderer_process_block(fluid_file_renderer_t *dev)
 {
+    fluid_file_writer_t *writer = dev->writer;
+
+    if(writer == NULL)
+    {
+        fluid_file_renderer_render(dev, dev->buf, dev->period_size);
+        return fluid_file_renderer_write(dev, dev->buf, dev->period_size);
+    }
+
+    /* wait until the buffer has been written, before rendering its first block */
+    if(writer->pos == 0 && fluid_file_writer_acquire(writer) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    fluid_file_renderer_render(dev, (char *)writer->buf[writer->cur] + writer->pos * FLUID_FILE_RENDERER_FRAME_SIZE,
+                               dev->period_size);
+    writer->pos += dev->period_size;
+
+    if(writer->pos + dev->period_size > writer->buf_frames)
+    {
+        fluid_file_writer_submit(writer);
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Write the audio of a MIDI player to file until it has finished playing.
+ * @param dev File renderer instance
+ * @param player MIDI player that drives the synth of \p dev, using the sample timer
+ *   (i.e. "player.timing-source" is "sample")
+ * @return #FLUID_OK or #FLUID_FAILED if an error occurred
+ * @since 2.2.0
+ *
+ * Renders faster than fluid_file_renderer_process_block() called in a loop:
+ * the audio is synthesized in the largest blocks the synth can render at once,
+ * ignoring audio.period-size, and written to the file by a separate thread,
+ * while the next block is being synthesized. As the player is only checked
+ * between blocks, the file may end up to 8192 frames after the end of the song.
+ * With libsndfile, the rests of the song, once the reverb and chorus tails have
+ * decayed, are written as zero samples without being synthesized.
+ * The throughput is logged with #FLUID_INFO level.
+ */
+int
+fluid_file_renderer_process_player(fluid_file_renderer_t *dev, fluid_player_t *player)
+{
+    fluid_file_writer_t *writer;
+    double start, elapsed;
+    unsigned long total = 0;
+    int failed = FALSE;
+
+    fluid_return_val_if_fail(dev != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+
+    /* the blocks of fluid_file_renderer_process_block() queued so far come first */
+    if(dev->writer != NULL && dev->writer->pos > 0)
+    {
+        fluid_file_writer_submit(dev->writer);
+    }
+
+    writer = (dev->writer != NULL) ? dev->writer : new_fluid_file_writer(dev, FLUID_FILE_RENDERER_BATCH_FRAMES);
+
+    if(writer == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    start = fluid_utime();
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        if(fluid_file_writer_acquire(writer) != FLUID_OK)
+        {
+            failed = TRUE;
+            break;
+        }
+
+        fluid_file_renderer_render(dev, writer->buf[writer->cur], FLUID_FILE_RENDERER_BATCH_FRAMES);
+        total += FLUID_FILE_RENDERER_BATCH_FRAMES;
+
+        writer->pos = FLUID_FILE_RENDERER_BATCH_FRAMES;
+        fluid_file_writer_submit(writer);
+    }
+
+    if(fluid_file_writer_finish(dev, writer) != FLUID_OK)
+    {
+        failed = TRUE;
+    }
+
+    elapsed = (fluid_utime() - start) / 1000000.0;
+    FLUID_LOG(FLUID_INFO, "Rendered %.3f sec of audio in %.3f sec (%.1f times realtime)",
+              total / dev->synth->output_rate, elapsed,
+              (elapsed > 0) ? total / dev->synth->output_rate / elapsed : 0.0);
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* The writer of fluid_file_renderer_process_segments() and the number of frames written so far */
+typedef struct
+{
+    fluid_file_writer_t *writer;
+    unsigned long total;
+} fluid_file_segments_writer_t;
+
+/* Receives the audio of fluid_player_render_segments(), in chunks of up to FLUID_FILE_RENDERER_BATCH_FRAMES */
+static int
+fluid_file_renderer_write_segments(void *data, const float *buf, int frames)
+{
+    fluid_file_segments_writer_t *segments = data;
+    fluid_file_writer_t *writer = segments->writer;
+
+    if(fluid_file_writer_acquire(writer) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
 #if LIBSNDFILE_SUPPORT
-    int n;
+    FLUID_MEMCPY(writer->buf[writer->cur], buf, frames * FLUID_FILE_RENDERER_FRAME_SIZE);
+#else
+    {
+        short *out = writer->buf[writer->cur];
+        float v;
+        int i;
+
+        for(i = 0; i < 2 * frames; i++)
+        {
+            v = buf[i] * 32766.0f;
+            fluid_clip(v, -32768.0f, 32767.0f);
+            out[i] = (short)(v + ((v >= 0.0f) ? 0.5f : -0.5f));
+        }
+    }
+#endif
 
-    fluid_synth_write_float(dev->synth, dev->period_size, dev->buf, 0, 2, dev->buf, 1, 2);
+    segments->total += frames;
+    writer->pos = frames;
+    fluid_file_writer_submit(writer);
 
-    n = sf_writef_float(dev->sndfile, dev->buf, dev->period_size);
+    return FLUID_OK;
+}
 
-    if(n != dev->period_size)
+/**
+ * Write the audio of the first file of a MIDI player to file, rendered in
+ * time segments by several threads at once.
+ * @param dev File renderer instance
+ * @param player MIDI player of the synth of \p dev, see fluid_player_render_segments()
+ * @param jobs Number of threads rendering the segments
+ * @return #FLUID_OK or #FLUID_FAILED if an error occurred
+ * @since 2.2.0
+ *
+ * The segments are rendered by synths of their own with fluid_player_render_segments(),
+ * while a separate thread writes them to the file in order. The synth of \p dev
+ * only provides their SoundFonts and settings, it doesn't render anything itself.
+ * The throughput is logged with #FLUID_INFO level.
+ */
+int
+fluid_file_renderer_process_segments(fluid_file_renderer_t *dev, fluid_player_t *player, int jobs)
+{
+    fluid_file_segments_writer_t segments;
+    double start, elapsed;
+    int failed;
+
+    fluid_return_val_if_fail(dev != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+
+    /* the blocks of fluid_file_renderer_process_block() queued so far come first */
+    if(dev->writer != NULL && dev->writer->pos > 0)
+    {
+        fluid_file_writer_submit(dev->writer);
+    }
+
+    segments.writer = (dev->writer != NULL) ? dev->writer : new_fluid_file_writer(dev, FLUID_FILE_RENDERER_BATCH_FRAMES);
+    segments.total = 0;
+
+    if(segments.writer == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    start = fluid_utime();
+
+    failed = (fluid_player_render_segments(player, FLUID_FILE_RENDERER_BATCH_FRAMES, jobs,
+                                           fluid_file_renderer_write_segments, &segments) != FLUID_OK);
+
+    if(fluid_file_writer_finish(dev, segments.writer) != FLUID_OK)
+    {
+        failed = TRUE;
+    }
+
+    elapsed = (fluid_utime() - start) / 1000000.0;
+    FLUID_LOG(FLUID_INFO, "Rendered %.3f sec of audio in %.3f sec (%.1f times realtime)",
+              segments.total / dev->synth->output_rate, elapsed,
+              (elapsed > 0) ? segments.total / dev->synth->output_rate / elapsed : 0.0);
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Let the writer finish the remaining buffers, and delete it unless it is the one of dev.
+ * Returns #FLUID_FAILED if writing to the file failed. */
+static int
+fluid_file_writer_finish(fluid_file_renderer_t *dev, fluid_file_writer_t *writer)
+{
+    int i, failed = FALSE;
+
+    if(writer != dev->writer)
+    {
+        return delete_fluid_file_writer(writer);
+    }
+
+    /* both buffers are free again once written */
+    for(i = 0; i < 2 && !failed; i++)
+    {
+        failed = (fluid_file_writer_acquire(writer) != FLUID_OK);
+        writer->cur = 1 - writer->cur;
+    }
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Create the buffers and start the thread writing them to the file of dev, buf_frames in size */
+static fluid_file_writer_t *
+new_fluid_file_writer(fluid_file_renderer_t *dev, int buf_frames)
+{
+    fluid_file_writer_t *writer = FLUID_NEW(fluid_file_writer_t);
+
+    if(writer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(writer, 0, sizeof(*writer));
+    writer->dev = dev;
+    writer->buf_frames = buf_frames;
+    writer->buf[0] = FLUID_MALLOC(buf_frames * FLUID_FILE_RENDERER_FRAME_SIZE);
+    writer->buf[1] = FLUID_MALLOC(buf_frames * FLUID_FILE_RENDERER_FRAME_SIZE);
+    writer->mutex = new_fluid_cond_mutex();
+    writer->cond = new_fluid_cond();
+
+    if(writer->buf[0] == NULL || writer->buf[1] == NULL || writer->mutex == NULL || writer->cond == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_file_writer(writer);
+        return NULL;
+    }
+
+    writer->thread = new_fluid_thread("file-writer", fluid_file_renderer_writer_run, writer, 0, FALSE);
+
+    if(writer->thread == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the file writer thread");
+        delete_fluid_file_writer(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+/* Let the writer thread finish the buffers submitted, and free the writer.
+ * Returns #FLUID_FAILED if writing to the file failed. */
+static int
+delete_fluid_file_writer(fluid_file_writer_t *writer)
+{
+    int failed;
+
+    if(writer->thread != NULL)
+    {
+        fluid_cond_mutex_lock(writer->mutex);
+        writer->done = TRUE;
+        fluid_cond_signal(writer->cond);
+        fluid_cond_mutex_unlock(writer->mutex);
+
+        fluid_thread_join(writer->thread);
+        delete_fluid_thread(writer->thread);
+    }
+
+    failed = writer->failed;
+
+    if(writer->cond != NULL)
+    {
+        delete_fluid_cond(writer->cond);
+    }
+
+    if(writer->mutex != NULL)
+    {
+        delete_fluid_cond_mutex(writer->mutex);
+    }
+
+    FLUID_FREE(writer->buf[0]);
+    FLUID_FREE(writer->buf[1]);
+    FLUID_FREE(writer);
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Wait until the current buffer of the writer has been written and may be rendered to.
+ * Returns #FLUID_FAILED if writing to the file failed. */
+static int
+fluid_file_writer_acquire(fluid_file_writer_t *writer)
+{
+    int failed;
+
+    fluid_cond_mutex_lock(writer->mutex);
+
+    while(writer->frames[writer->cur] != 0 && !writer->failed)
+    {
+        fluid_cond_wait(writer->cond, writer->mutex);
+    }
+
+    failed = writer->failed;
+    fluid_cond_mutex_unlock(writer->mutex);
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Hand the frames rendered to the current buffer over to the writer thread, and render to the other one */
+static void
+fluid_file_writer_submit(fluid_file_writer_t *writer)
+{
+    fluid_cond_mutex_lock(writer->mutex);
+    writer->frames[writer->cur] = writer->pos;
+    fluid_cond_signal(writer->cond);
+    fluid_cond_mutex_unlock(writer->mutex);
+
+    writer->cur = 1 - writer->cur;
+    writer->pos = 0;
+}
+
+/* Thread writing the buffers of a fluid_file_writer_t in turn, until there are no more */
+static fluid_thread_return_t
+fluid_file_renderer_writer_run(void *data)
+{
+    fluid_file_writer_t *writer = data;
+    int i = 0, frames, failed;
+
+    while(1)
+    {
+        fluid_cond_mutex_lock(writer->mutex);
+
+        while(writer->frames[i] == 0 && !writer->done)
+        {
+            fluid_cond_wait(writer->cond, writer->mutex);
+        }
+
+        frames = writer->frames[i];
+        fluid_cond_mutex_unlock(writer->mutex);
+
+        if(frames == 0)
+        {
+            /* done */
+            break;
+        }
+
+        failed = (fluid_file_renderer_write(writer->dev, writer->buf[i], frames) != FLUID_OK);
+
+        fluid_cond_mutex_lock(writer->mutex);
+        writer->frames[i] = 0;
+        writer->failed = failed;
+        fluid_cond_signal(writer->cond);
+        fluid_cond_mutex_unlock(writer->mutex);
+
+        if(failed)
+        {
+            break;
+        }
+
+        i = 1 - i;
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Synthesize frames of audio to buf, in the sample format written to the file.
+ * The rests between the notes are skipped rather than rendered, they come out as
+ * zero samples either way, see fluid_synth_skip_silence(). The 16 bit samples of
+ * fluid_synth_write_s16() are dithered even during rests, they are always rendered. */
+static void
+fluid_file_renderer_render(fluid_file_renderer_t *dev, void *buf, int frames)
+{
+#if LIBSNDFILE_SUPPORT
+    int skipped = fluid_synth_skip_silence(dev->synth, frames);
+
+    FLUID_MEMSET(buf, 0, skipped * FLUID_FILE_RENDERER_FRAME_SIZE);
+
+    if(skipped < frames)
+    {
+        fluid_synth_write_float(dev->synth, frames - skipped, buf, 2 * skipped, 2, buf, 2 * skipped + 1, 2);
+    }
+
+#else
+    fluid_synth_write_s16(dev->synth, frames, buf, 0, 2, buf, 1, 2);
+#endif
+}
+
+/* Write frames of audio rendered by fluid_file_renderer_render() from buf to the file */
+static int
+fluid_file_renderer_write(fluid_file_renderer_t *dev, void *buf, int frames)
+{
+#if LIBSNDFILE_SUPPORT
+    int n;
+
+    n = sf_writef_float(dev->sndfile, buf, frames);
+
+    if(n != frames)
     {
         FLUID_LOG(FLUID_ERR, "Audio file write error: %s",
                   sf_strerror(dev->sndfile));
@@ -402,11 +872,9 @@ fluid_file_renderer_process_block(fluid_file_renderer_t *dev)
 
 #else   /* No libsndfile support */
 
-    size_t res, nmemb = dev->buf_size;
-
-    fluid_synth_write_s16(dev->synth, dev->period_size, dev->buf, 0, 2, dev->buf, 1, 2);
+    size_t res, nmemb = frames * 2 * sizeof(short);
 
-    res = fwrite(dev->buf, 1, nmemb, dev->file);
+    res = fwrite(buf, 1, nmemb, dev->file);
 
     if(res < nmemb)
     {
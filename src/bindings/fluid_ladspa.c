@@ -77,6 +77,12 @@ typedef struct _fluid_ladspa_node_t
     int num_inputs;
     int num_outputs;
 
+    /* Only used for audio nodes: TRUE if the first effect accessing the node in a run
+     * reads from it or adds to it, so that the node has to be cleared (user nodes) or
+     * copied from the host buffer (host nodes) before. Otherwise the first effect
+     * overwrites the node anyway. Updated on activation and mix mode changes. */
+    int needs_init;
+
 } fluid_ladspa_node_t;
 
 typedef struct _fluid_ladspa_effect_t
@@ -131,6 +137,19 @@ struct _fluid_ladspa_fx_t
     fluid_cond_mutex_t *run_finished_mutex;
     fluid_cond_t *run_finished_cond;
 
+    /* The effects grouped into stages, computed on activation. An effect is put into
+     * a later stage than all effects added before it that write to a node it reads or
+     * writes, or read a node it writes. So the effects of a stage can run concurrently,
+     * while running the stages one after the other gives the same result as running all
+     * effects in the order they were added. Stage i consists of stage_effects[stage_start[i]]
+     * up to (excluding) stage_effects[stage_start[i + 1]]. */
+    fluid_ladspa_effect_t *stage_effects[FLUID_LADSPA_MAX_EFFECTS];
+    int stage_start[FLUID_LADSPA_MAX_EFFECTS + 1];
+    int num_stages;
+
+    /* Number of samples processed by the current run */
+    int run_samples;
+
 };
 
 #define LADSPA_API_ENTER(_fx) (fluid_rec_mutex_lock((_fx)->api_mutex))
@@ -171,6 +190,9 @@ static int check_host_output_used(fluid_ladspa_fx_t *fx);
 static int check_all_audio_nodes_connected(fluid_ladspa_fx_t *fx, const char **name);
 
 #ifndef WITH_FLOAT
+static void build_stages(fluid_ladspa_fx_t *fx);
+static void update_nodes_needs_init(fluid_ladspa_fx_t *fx);
+
 static FLUID_INLINE void copy_host_to_effect_buffers(fluid_ladspa_fx_t *fx, int num_samples);
 static FLUID_INLINE void copy_effect_to_host_buffers(fluid_ladspa_fx_t *fx, int num_samples);
 #endif
@@ -378,6 +400,46 @@ int fluid_ladspa_is_active(fluid_ladspa_fx_t *fx)
     LADSPA_API_RETURN(fx, is_active);
 }
 
+/**
+ * Get the memory taken by the LADSPA fx instance, its nodes and effects, not
+ * counting the memory allocated by the plugins themselves.
+ *
+ * @param fx LADSPA fx instance
+ * @return the bytes of the instance
+ */
+size_t fluid_ladspa_get_size(fluid_ladspa_fx_t *fx)
+{
+    size_t size = sizeof(*fx);
+    int i;
+
+    fluid_return_val_if_fail(fx != NULL, 0);
+
+    LADSPA_API_ENTER(fx);
+
+    for(i = 0; i < fx->num_nodes; i++)
+    {
+        fluid_ladspa_node_t *node = fx->nodes[i];
+
+        size += sizeof(*node) + FLUID_STRLEN(node->name) + 1;
+
+        /* see new_fluid_ladspa_node() */
+        if((void *)node->effect_buffer != (void *)node->host_buffer)
+        {
+            size += ((node->type & FLUID_LADSPA_NODE_CONTROL) ? 1 : fx->buffer_size) * sizeof(LADSPA_Data);
+        }
+    }
+
+    for(i = 0; i < fx->num_effects; i++)
+    {
+        fluid_ladspa_effect_t *effect = fx->effects[i];
+
+        size += sizeof(*effect) + FLUID_STRLEN(effect->name) + 1
+                + effect->desc->PortCount * sizeof(fluid_ladspa_node_t *);
+    }
+
+    LADSPA_API_RETURN(fx, size);
+}
+
 /**
  * Activate the LADSPA fx instance and each configured effect.
  *
@@ -408,6 +470,10 @@ int fluid_ladspa_activate(fluid_ladspa_fx_t *fx)
         activate_effect(fx->effects[i]);
     }
 
+    /* The connections can't change while active */
+    build_stages(fx);
+    update_nodes_needs_init(fx);
+
     if(!fluid_atomic_int_compare_and_exchange(&fx->state, FLUID_LADSPA_INACTIVE, FLUID_LADSPA_ACTIVE))
     {
         for(i = 0; i < fx->num_effects; i++)
@@ -507,53 +573,119 @@ int fluid_ladspa_reset(fluid_ladspa_fx_t *fx)
  * @param block_size number of samples in a block
  */
 void fluid_ladspa_run(fluid_ladspa_fx_t *fx, int block_count, int block_size)
+{
+    int stage, i, num_stages;
+
+    num_stages = fluid_ladspa_run_begin(fx, block_count, block_size);
+
+    if(num_stages == 0)
+    {
+        return;
+    }
+
+    /* Without threads to share the work with, running the stages one effect after
+     * another is the order that the effects were added in */
+    for(stage = 0; stage < num_stages; stage++)
+    {
+        for(i = 0; i < fluid_ladspa_get_stage_size(fx, stage); i++)
+        {
+            fluid_ladspa_run_effect(fx, stage, i);
+        }
+    }
+
+    fluid_ladspa_run_end(fx);
+}
+
+/**
+ * Start processing audio data via the LADSPA effects unit, to run the effects
+ * of each stage with fluid_ladspa_run_effect(), possibly on several threads, and
+ * finish with fluid_ladspa_run_end().
+ *
+ * @param fx LADSPA effects instance
+ * @param block_count number of blocks to render
+ * @param block_size number of samples in a block
+ * @return the number of stages to run, 0 if the effects are not to be run
+ *   and fluid_ladspa_run_end() must not be called
+ */
+int fluid_ladspa_run_begin(fluid_ladspa_fx_t *fx, int block_count, int block_size)
 {
     int i;
-    int num_samples;
-    fluid_ladspa_effect_t *effect;
 
     /* Somebody wants to deactivate the engine, so let's give them a chance to do that.
      * And check that there is at least one effect, to avoid the overhead of the
      * atomic compare and exchange on an unconfigured LADSPA engine. */
     if(fx->pending_deactivation || fx->num_effects == 0)
     {
-        return;
+        return 0;
     }
 
     /* Inform the engine that we are now running pluings, and bail out if it's not active */
     if(!fluid_atomic_int_compare_and_exchange(&fx->state, FLUID_LADSPA_ACTIVE, FLUID_LADSPA_RUNNING))
     {
-        return;
+        return 0;
     }
 
-    num_samples = block_count * block_size;
+    fx->run_samples = block_count * block_size;
 
 #ifndef WITH_FLOAT
-    copy_host_to_effect_buffers(fx, num_samples);
+    copy_host_to_effect_buffers(fx, fx->run_samples);
 #endif
 
+    /* User audio nodes start silent, unless the first effect overwrites them anyway */
     for(i = 0; i < fx->num_audio_nodes; i++)
     {
-        FLUID_MEMSET(fx->audio_nodes[i]->effect_buffer, 0, fx->buffer_size * sizeof(LADSPA_Data));
+        if(fx->audio_nodes[i]->needs_init)
+        {
+            FLUID_MEMSET(fx->audio_nodes[i]->effect_buffer, 0, fx->run_samples * sizeof(LADSPA_Data));
+        }
     }
 
-    /* Run each effect in the order that they were added */
-    for(i = 0; i < fx->num_effects; i++)
-    {
-        effect = fx->effects[i];
+    return fx->num_stages;
+}
 
-        if(effect->mix)
-        {
-            effect->desc->run_adding(effect->handle, num_samples);
-        }
-        else
-        {
-            effect->desc->run(effect->handle, num_samples);
-        }
+/**
+ * Get the number of effects of a stage, which may run concurrently.
+ *
+ * @param fx LADSPA effects instance
+ * @param stage the stage, less than the number returned by fluid_ladspa_run_begin()
+ * @return the number of effects of the stage
+ */
+int fluid_ladspa_get_stage_size(fluid_ladspa_fx_t *fx, int stage)
+{
+    return fx->stage_start[stage + 1] - fx->stage_start[stage];
+}
+
+/**
+ * Run an effect of a stage on the block started by fluid_ladspa_run_begin().
+ *
+ * @param fx LADSPA effects instance
+ * @param stage the stage of the effect
+ * @param index the effect within the stage, less than fluid_ladspa_get_stage_size()
+ */
+void fluid_ladspa_run_effect(fluid_ladspa_fx_t *fx, int stage, int index)
+{
+    fluid_ladspa_effect_t *effect = fx->stage_effects[fx->stage_start[stage] + index];
+
+    if(effect->mix)
+    {
+        effect->desc->run_adding(effect->handle, fx->run_samples);
+    }
+    else
+    {
+        effect->desc->run(effect->handle, fx->run_samples);
     }
+}
 
+/**
+ * Finish processing the block started by fluid_ladspa_run_begin(), once all its
+ * stages have been run, and copy the resulting audio back into the host buffers.
+ *
+ * @param fx LADSPA effects instance
+ */
+void fluid_ladspa_run_end(fluid_ladspa_fx_t *fx)
+{
 #ifndef WITH_FLOAT
-    copy_effect_to_host_buffers(fx, num_samples);
+    copy_effect_to_host_buffers(fx, fx->run_samples);
 #endif
 
     if(!fluid_atomic_int_compare_and_exchange(&fx->state, FLUID_LADSPA_RUNNING, FLUID_LADSPA_ACTIVE))
@@ -641,6 +773,12 @@ int fluid_ladspa_effect_set_mix(fluid_ladspa_fx_t *fx, const char *name, int mix
 
     effect->mix = mix;
 
+    /* Adding to a node may need it to be cleared first, or not anymore */
+    if(fluid_ladspa_is_active(fx))
+    {
+        update_nodes_needs_init(fx);
+    }
+
     LADSPA_API_RETURN(fx, FLUID_OK);
 }
 
@@ -1593,6 +1731,141 @@ static int create_control_port_nodes(fluid_ladspa_fx_t *fx, fluid_ladspa_effect_
     return FLUID_OK;
 }
 
+/**
+ * Check if an effect has to run after another one added before it, because one of
+ * them writes to a node that the other one reads or writes.
+ *
+ * @param first the effect added first
+ * @param second the effect added later
+ * @return TRUE if second has to run after first, otherwise FALSE
+ */
+static int effect_depends_on(const fluid_ladspa_effect_t *second, const fluid_ladspa_effect_t *first)
+{
+    unsigned int i, k;
+    int writes;
+
+    for(i = 0; i < first->desc->PortCount; i++)
+    {
+        writes = LADSPA_IS_PORT_OUTPUT(first->desc->PortDescriptors[i]);
+
+        for(k = 0; k < second->desc->PortCount; k++)
+        {
+            if(second->port_nodes[k] == first->port_nodes[i]
+                    && (writes || LADSPA_IS_PORT_OUTPUT(second->desc->PortDescriptors[k])))
+            {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Group the effects into stages of effects that can run concurrently, each effect
+ * in the stage following the last stage of the effects it depends on.
+ *
+ * @param fx LADSPA fx instance
+ */
+static void build_stages(fluid_ladspa_fx_t *fx)
+{
+    int stage[FLUID_LADSPA_MAX_EFFECTS];
+    int i, k, s;
+
+    fx->num_stages = 0;
+
+    for(i = 0; i < fx->num_effects; i++)
+    {
+        stage[i] = 0;
+
+        for(k = 0; k < i; k++)
+        {
+            if(stage[k] >= stage[i] && effect_depends_on(fx->effects[i], fx->effects[k]))
+            {
+                stage[i] = stage[k] + 1;
+            }
+        }
+
+        if(stage[i] >= fx->num_stages)
+        {
+            fx->num_stages = stage[i] + 1;
+        }
+    }
+
+    /* list the effects stage by stage, keeping their order within a stage */
+    fx->stage_start[0] = 0;
+
+    for(s = 0; s < fx->num_stages; s++)
+    {
+        k = fx->stage_start[s];
+
+        for(i = 0; i < fx->num_effects; i++)
+        {
+            if(stage[i] == s)
+            {
+                fx->stage_effects[k++] = fx->effects[i];
+            }
+        }
+
+        fx->stage_start[s + 1] = k;
+    }
+
+    FLUID_LOG(FLUID_DBG, "LADSPA runs %d effects in %d stages", fx->num_effects, fx->num_stages);
+}
+
+/**
+ * Find out for every audio node whether the first effect accessing it in a run
+ * reads from it or adds to it, see fluid_ladspa_node_t.
+ *
+ * @param fx LADSPA fx instance
+ */
+static void update_nodes_needs_init(fluid_ladspa_fx_t *fx)
+{
+    fluid_ladspa_effect_t *effect;
+    fluid_ladspa_node_t *node;
+    unsigned int k;
+    int i, n, reads, writes;
+
+    for(n = 0; n < fx->num_nodes; n++)
+    {
+        node = fx->nodes[n];
+
+        if(!(node->type & FLUID_LADSPA_NODE_AUDIO))
+        {
+            continue;
+        }
+
+        node->needs_init = FALSE;
+
+        for(i = 0; i < fx->num_effects; i++)
+        {
+            effect = fx->effects[i];
+            reads = writes = FALSE;
+
+            for(k = 0; k < effect->desc->PortCount; k++)
+            {
+                if(effect->port_nodes[k] == node)
+                {
+                    if(LADSPA_IS_PORT_INPUT(effect->desc->PortDescriptors[k]))
+                    {
+                        reads = TRUE;
+                    }
+                    else
+                    {
+                        writes = TRUE;
+                    }
+                }
+            }
+
+            if(reads || writes)
+            {
+                node->needs_init = reads || effect->mix;
+                break;
+            }
+        }
+    }
+}
+
 static void connect_node_to_port(fluid_ladspa_node_t *node, fluid_ladspa_dir_t dir,
                                  fluid_ladspa_effect_t *effect, int port_idx)
 {
@@ -1734,13 +2007,16 @@ static FLUID_INLINE void copy_host_to_effect_buffers(fluid_ladspa_fx_t *fx, int
     {
         node = fx->host_nodes[n];
 
-        /* Only copy host nodes that have at least one output or output, i.e.
-         * that are connected to at least one effect port. */
-        if(node->num_inputs > 0 || node->num_outputs > 0)
+        /* Only copy host nodes that an effect reads from or adds to, i.e. not
+         * those only overwritten by effects, nor those not connected at all. */
+        if(node->needs_init)
         {
+            const fluid_real_t *FLUID_RESTRICT src = node->host_buffer;
+            LADSPA_Data *FLUID_RESTRICT dst = node->effect_buffer;
+
             for(i = 0; i < num_samples; i++)
             {
-                node->effect_buffer[i] = (LADSPA_Data)node->host_buffer[i];
+                dst[i] = (LADSPA_Data)src[i];
             }
         }
     }
@@ -1763,9 +2039,12 @@ static FLUID_INLINE void copy_effect_to_host_buffers(fluid_ladspa_fx_t *fx, int
          * at least one effect output */
         if(node->num_inputs > 0)
         {
+            const LADSPA_Data *FLUID_RESTRICT src = node->effect_buffer;
+            fluid_real_t *FLUID_RESTRICT dst = node->host_buffer;
+
             for(i = 0; i < num_samples; i++)
             {
-                node->host_buffer[i] = (fluid_real_t)node->effect_buffer[i];
+                dst[i] = (fluid_real_t)src[i];
             }
         }
     }
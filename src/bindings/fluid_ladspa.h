@@ -27,9 +27,15 @@ fluid_ladspa_fx_t *new_fluid_ladspa_fx(fluid_real_t sample_rate, int buffer_size
 void delete_fluid_ladspa_fx(fluid_ladspa_fx_t *fx);
 
 int fluid_ladspa_set_sample_rate(fluid_ladspa_fx_t *fx, fluid_real_t sample_rate);
+size_t fluid_ladspa_get_size(fluid_ladspa_fx_t *fx);
 
 void fluid_ladspa_run(fluid_ladspa_fx_t *fx, int block_count, int block_size);
 
+int fluid_ladspa_run_begin(fluid_ladspa_fx_t *fx, int block_count, int block_size);
+int fluid_ladspa_get_stage_size(fluid_ladspa_fx_t *fx, int stage);
+void fluid_ladspa_run_effect(fluid_ladspa_fx_t *fx, int stage, int index);
+void fluid_ladspa_run_end(fluid_ladspa_fx_t *fx);
+
 int fluid_ladspa_add_host_ports(fluid_ladspa_fx_t *fx, const char *prefix,
                                 int num_buffers, fluid_real_t buffers[], int buf_stride);
 
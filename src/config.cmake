@@ -28,6 +28,9 @@
 /* Define to enable FPE checks */
 #cmakedefine FPE_CHECK @FPE_CHECK@
 
+/* Define to abort on heap allocations while rendering audio */
+#cmakedefine RT_ALLOC_CHECK @RT_ALLOC_CHECK@
+
 /* Define to 1 if you have the <arpa/inet.h> header file. */
 #cmakedefine HAVE_ARPA_INET_H @HAVE_ARPA_INET_H@
 
@@ -73,6 +76,9 @@
 /* Define if compiling with openMP to enable parallel audio rendering */
 #cmakedefine HAVE_OPENMP @HAVE_OPENMP@
 
+/* Define to 1 if you have the <poll.h> header file. */
+#cmakedefine HAVE_POLL_H @HAVE_POLL_H@
+
 /* Define to 1 if you have the <pthread.h> header file. */
 #cmakedefine HAVE_PTHREAD_H @HAVE_PTHREAD_H@
 
@@ -100,6 +106,12 @@
 /* Define to 1 if you have the <sys/mman.h> header file. */
 #cmakedefine HAVE_SYS_MMAN_H @HAVE_SYS_MMAN_H@
 
+/* Define to 1 if you have the <linux/io_uring.h> header file. */
+#cmakedefine HAVE_LINUX_IO_URING_H @HAVE_LINUX_IO_URING_H@
+
+/* Define to 1 if you have the <sys/resource.h> header file. */
+#cmakedefine HAVE_SYS_RESOURCE_H @HAVE_SYS_RESOURCE_H@
+
 /* Define to 1 if you have the <sys/socket.h> header file. */
 #cmakedefine HAVE_SYS_SOCKET_H @HAVE_SYS_SOCKET_H@
 
@@ -127,6 +139,9 @@
 /* Define to 1 if you have the inet_ntop() function. */
 #cmakedefine HAVE_INETNTOP @HAVE_INETNTOP@
 
+/* Define to 1 if you have the shm_open() function. */
+#cmakedefine HAVE_SHM_OPEN @HAVE_SHM_OPEN@
+
 /* Define to enable JACK driver */
 #cmakedefine JACK_SUPPORT @JACK_SUPPORT@
 
@@ -151,6 +166,9 @@
 /* Define to enable libsndfile support */
 #cmakedefine LIBSNDFILE_SUPPORT @LIBSNDFILE_SUPPORT@
 
+/* Define to decode the samples of SF3 files with libvorbisfile */
+#cmakedefine LIBVORBIS_SUPPORT @LIBVORBIS_SUPPORT@
+
 /* Define to enable MidiShare driver */
 #cmakedefine MIDISHARE_SUPPORT @MIDISHARE_SUPPORT@
 
@@ -190,12 +208,18 @@
 /* Define to enable PulseAudio driver */
 #cmakedefine PULSE_SUPPORT @PULSE_SUPPORT@
 
+/* Define to enable PipeWire driver */
+#cmakedefine PIPEWIRE_SUPPORT @PIPEWIRE_SUPPORT@
+
 /* Define to enable DirectSound driver */
 #cmakedefine DSOUND_SUPPORT @DSOUND_SUPPORT@
 
 /* Define to enable Windows WaveOut driver */
 #cmakedefine WAVEOUT_SUPPORT @WAVEOUT_SUPPORT@
 
+/* Define to enable Windows WASAPI driver */
+#cmakedefine WASAPI_SUPPORT @WASAPI_SUPPORT@
+
 /* Define to enable Windows MIDI driver */
 #cmakedefine WINMIDI_SUPPORT @WINMIDI_SUPPORT@
 
@@ -217,9 +241,24 @@
 /* Define to do all DSP in single floating point precision */
 #cmakedefine WITH_FLOAT @WITH_FLOAT@
 
+/* Internal block size in sample frames */
+#cmakedefine FLUID_BUFSIZE @FLUID_BUFSIZE@
+
+/* Resolution of the interpolation tables in bits */
+#cmakedefine FLUID_INTERP_BITS @FLUID_INTERP_BITS@
+
+/* Resolution of the 7th order interpolation table in bits */
+#cmakedefine FLUID_SINC_INTERP_BITS @FLUID_SINC_INTERP_BITS@
+
+/* Define to compute the lookup tables at runtime instead of at build time */
+#cmakedefine ENABLE_RUNTIME_TABLES @ENABLE_RUNTIME_TABLES@
+
 /* Define to profile the DSP code */
 #cmakedefine WITH_PROFILING @WITH_PROFILING@
 
+/* Define to record trace points of the rendering */
+#cmakedefine WITH_TRACE @WITH_TRACE@
+
 /* Define to use the readline library for line editing */
 #cmakedefine WITH_READLINE @WITH_READLINE@
 
@@ -70,6 +70,16 @@ static const fluid_audriver_definition_t fluid_audio_drivers[] =
     },
 #endif
 
+#if PIPEWIRE_SUPPORT
+    {
+        "pipewire",
+        new_fluid_pipewire_audio_driver,
+        new_fluid_pipewire_audio_driver2,
+        delete_fluid_pipewire_audio_driver,
+        fluid_pipewire_audio_driver_settings
+    },
+#endif
+
 #if OSS_SUPPORT
     {
         "oss",
@@ -130,6 +140,16 @@ static const fluid_audriver_definition_t fluid_audio_drivers[] =
     },
 #endif
 
+#if WASAPI_SUPPORT
+    {
+        "wasapi",
+        new_fluid_wasapi_audio_driver,
+        NULL,
+        delete_fluid_wasapi_audio_driver,
+        fluid_wasapi_audio_driver_settings
+    },
+#endif
+
 #if SNDMAN_SUPPORT
     {
         "sndman",
@@ -213,6 +233,8 @@ void fluid_audio_driver_settings(fluid_settings_t *settings)
 
     fluid_settings_register_int(settings, "audio.realtime-prio",
                                 FLUID_DEFAULT_AUDIO_RT_PRIO, 0, 99, 0);
+
+    fluid_settings_register_int(settings, "audio.render-ahead", 0, 0, 64, 0);
     
     fluid_settings_register_str(settings, "audio.driver", "", 0);
 
@@ -422,6 +444,7 @@ int fluid_audio_driver_register(const char **adrivers)
     {
         /* Pass NULL to register all available drivers. */
         FLUID_MEMSET(fluid_adriver_disable_mask, 0, sizeof(fluid_adriver_disable_mask));
+        fluid_settings_invalidate_prototype();
 
         return FLUID_OK;
     }
@@ -451,6 +474,7 @@ int fluid_audio_driver_register(const char **adrivers)
 
     /* Update list of activated drivers */
     FLUID_MEMCPY(fluid_adriver_disable_mask, disable_mask, sizeof(disable_mask));
+    fluid_settings_invalidate_prototype();
 
     return FLUID_OK;
 }
@@ -22,6 +22,7 @@
 #define _FLUID_AUDRIVER_H
 
 #include "fluidsynth_priv.h"
+#include "fluid_sys.h"
 
 /*
  * fluid_audio_driver_t
@@ -39,6 +40,10 @@ void fluid_audio_driver_settings(fluid_settings_t *settings);
 /* Defined in fluid_filerenderer.c */
 void fluid_file_renderer_settings(fluid_settings_t *settings);
 
+/* Defined in fluid_synth.c */
+int fluid_synth_set_workgroup(fluid_synth_t *synth, void *workgroup);
+int fluid_synth_set_thread_factory(fluid_synth_t *synth, const fluid_thread_factory_t *factory);
+
 #if PULSE_SUPPORT
 fluid_audio_driver_t *new_fluid_pulse_audio_driver(fluid_settings_t *settings,
         fluid_synth_t *synth);
@@ -48,6 +53,15 @@ void delete_fluid_pulse_audio_driver(fluid_audio_driver_t *p);
 void fluid_pulse_audio_driver_settings(fluid_settings_t *settings);
 #endif
 
+#if PIPEWIRE_SUPPORT
+fluid_audio_driver_t *new_fluid_pipewire_audio_driver(fluid_settings_t *settings,
+        fluid_synth_t *synth);
+fluid_audio_driver_t *new_fluid_pipewire_audio_driver2(fluid_settings_t *settings,
+        fluid_audio_func_t func, void *data);
+void delete_fluid_pipewire_audio_driver(fluid_audio_driver_t *p);
+void fluid_pipewire_audio_driver_settings(fluid_settings_t *settings);
+#endif
+
 #if ALSA_SUPPORT
 fluid_audio_driver_t *new_fluid_alsa_audio_driver(fluid_settings_t *settings,
         fluid_synth_t *synth);
@@ -106,6 +120,13 @@ void delete_fluid_waveout_audio_driver(fluid_audio_driver_t *p);
 void fluid_waveout_audio_driver_settings(fluid_settings_t *settings);
 #endif
 
+#if WASAPI_SUPPORT
+fluid_audio_driver_t *new_fluid_wasapi_audio_driver(fluid_settings_t *settings,
+        fluid_synth_t *synth);
+void delete_fluid_wasapi_audio_driver(fluid_audio_driver_t *p);
+void fluid_wasapi_audio_driver_settings(fluid_settings_t *settings);
+#endif
+
 #if PORTAUDIO_SUPPORT
 void fluid_portaudio_driver_settings(fluid_settings_t *settings);
 fluid_audio_driver_t *new_fluid_portaudio_driver(fluid_settings_t *settings,
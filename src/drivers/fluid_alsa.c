@@ -55,6 +55,9 @@ typedef struct
     fluid_audio_func_t callback;
     void *data;
     int buffer_size;
+    snd_pcm_format_t format;
+    int tsched;
+    snd_pcm_uframes_t hw_buffer_size;
     fluid_thread_t *thread;
     int cont;
 } fluid_alsa_audio_driver_t;
@@ -62,6 +65,8 @@ typedef struct
 
 static fluid_thread_return_t fluid_alsa_audio_run_float(void *d);
 static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d);
+static fluid_thread_return_t fluid_alsa_audio_run_mmap(void *d);
+static fluid_thread_return_t fluid_alsa_audio_run_tsched(void *d);
 
 
 typedef struct
@@ -74,6 +79,19 @@ typedef struct
 
 static const fluid_alsa_formats_t fluid_alsa_formats[] =
 {
+    /* only used if audio.alsa.mmap is enabled */
+    {
+        "s16, mmap, interleaved",
+        SND_PCM_FORMAT_S16,
+        SND_PCM_ACCESS_MMAP_INTERLEAVED,
+        fluid_alsa_audio_run_mmap
+    },
+    {
+        "float, mmap, non interleaved",
+        SND_PCM_FORMAT_FLOAT,
+        SND_PCM_ACCESS_MMAP_NONINTERLEAVED,
+        fluid_alsa_audio_run_mmap
+    },
     {
         "s16, rw, interleaved",
         SND_PCM_FORMAT_S16,
@@ -111,6 +129,9 @@ typedef struct
 static fluid_thread_return_t fluid_alsa_midi_run(void *d);
 
 
+/* The most events drained from the sequencer before they are handled at once */
+#define FLUID_ALSA_SEQ_BATCH 64
+
 /*
  * fluid_alsa_seq_driver_t
  *
@@ -126,6 +147,8 @@ typedef struct
     int port_count;
     int autoconn_inputs;
     snd_seq_addr_t autoconn_dest;
+    int queue;              /* timestamping the events with midi.timestamp-latency, -1 otherwise */
+    double queue_start;     /* the time by fluid_utime() the queue was started at */
 } fluid_alsa_seq_driver_t;
 
 static fluid_thread_return_t fluid_alsa_seq_run(void *d);
@@ -139,6 +162,8 @@ static fluid_thread_return_t fluid_alsa_seq_run(void *d);
 void fluid_alsa_audio_driver_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_str(settings, "audio.alsa.device", "default", 0);
+    fluid_settings_register_int(settings, "audio.alsa.mmap", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "audio.alsa.tsched", 0, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 
@@ -158,6 +183,7 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
     int periods, period_size;
     char *device = NULL;
     int realtime_prio = 0;
+    int mmap = 0;
     int i, err, dir = 0;
     snd_pcm_hw_params_t *hwparams;
     snd_pcm_sw_params_t *swparams = NULL;
@@ -179,6 +205,14 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
     fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
     fluid_settings_dupstr(settings, "audio.alsa.device", &device);   /* ++ dup device name */
     fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
+    fluid_settings_getint(settings, "audio.alsa.mmap", &mmap);
+    fluid_settings_getint(settings, "audio.alsa.tsched", &dev->tsched);
+
+    if(dev->tsched && mmap)
+    {
+        FLUID_LOG(FLUID_WARN, "audio.alsa.mmap is not supported with audio.alsa.tsched, ignoring it");
+        mmap = 0;
+    }
 
     dev->data = data;
     dev->callback = func;
@@ -208,11 +242,14 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
 
     /* Set hardware parameters. We continue trying access methods and
        sample formats until we have one that works. For example, if
-       memory mapped access fails we try regular IO methods. (not
-       finished, yet). */
+       memory mapped access fails we try regular IO methods. */
 
     for(i = 0; fluid_alsa_formats[i].name != NULL; i++)
     {
+        if(!mmap && fluid_alsa_formats[i].run == fluid_alsa_audio_run_mmap)
+        {
+            continue;
+        }
 
         snd_pcm_hw_params_any(dev->pcm, hwparams);
 
@@ -282,12 +319,24 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
                       periods, (int) tmp);
         }
 
+        /* the driver wakes up by a timer instead, see fluid_alsa_audio_run_tsched() */
+        if(dev->tsched && snd_pcm_hw_params_set_period_wakeup(dev->pcm, hwparams, 0) < 0)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to disable the period wakeups, timer-based scheduling disabled");
+            dev->tsched = 0;
+        }
+
         if(snd_pcm_hw_params(dev->pcm, hwparams) < 0)
         {
             FLUID_LOG(FLUID_WARN, "Audio device hardware configuration failed");
             continue;
         }
 
+        if(snd_pcm_hw_params_get_buffer_size(hwparams, &dev->hw_buffer_size) < 0)
+        {
+            dev->hw_buffer_size = (snd_pcm_uframes_t)period_size * periods;
+        }
+
         break;
     }
 
@@ -297,6 +346,9 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
         goto error_recovery;
     }
 
+    FLUID_LOG(FLUID_DBG, "Using audio format '%s'", fluid_alsa_formats[i].name);
+    dev->format = fluid_alsa_formats[i].format;
+
     /* Set the software params */
     snd_pcm_sw_params_current(dev->pcm, swparams);
 
@@ -322,7 +374,8 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
     }
 
     /* Create the audio thread */
-    dev->thread = new_fluid_thread("alsa-audio", fluid_alsa_formats[i].run, dev, realtime_prio, FALSE);
+    dev->thread = new_fluid_thread("alsa-audio", dev->tsched ? fluid_alsa_audio_run_tsched : fluid_alsa_formats[i].run,
+                                   dev, realtime_prio, FALSE);
 
     if(!dev->thread)
     {
@@ -619,6 +672,360 @@ error_recovery:
     return FLUID_THREAD_RETURN_VALUE;
 }
 
+/*
+ * Render count frames in the format of the device and write them, the buffers
+ * hold at least count frames.
+ */
+static int
+fluid_alsa_audio_write(fluid_alsa_audio_driver_t *dev, float *left, float *right, short *buf,
+                       int *dither_index, int count)
+{
+    float *handle[2];
+    int n, offset = 0;
+
+    if(dev->callback)
+    {
+        FLUID_MEMSET(left, 0, count * sizeof(*left));
+        FLUID_MEMSET(right, 0, count * sizeof(*right));
+
+        handle[0] = left;
+        handle[1] = right;
+
+        (*dev->callback)(dev->data, count, 0, NULL, 2, handle);
+
+        if(dev->format == SND_PCM_FORMAT_S16)
+        {
+            /* convert floating point data to 16 bit (with dithering) */
+            fluid_synth_dither_s16(dither_index, count, left, right, buf, 0, 2, buf, 1, 2);
+        }
+    }
+    else if(dev->format == SND_PCM_FORMAT_S16)	/* dev->data is the synth instance */
+    {
+        fluid_synth_write_s16(dev->data, count, buf, 0, 2, buf, 1, 2);
+    }
+    else
+    {
+        fluid_synth_write_float(dev->data, count, left, 0, 1, right, 0, 1);
+    }
+
+    while(offset < count)
+    {
+        if(dev->format == SND_PCM_FORMAT_S16)
+        {
+            n = snd_pcm_writei(dev->pcm, (void *)(buf + 2 * offset), count - offset);
+        }
+        else
+        {
+            handle[0] = left + offset;
+            handle[1] = right + offset;
+
+            n = snd_pcm_writen(dev->pcm, (void *)handle, count - offset);
+        }
+
+        if(n < 0)	/* error occurred? */
+        {
+            if(fluid_alsa_handle_write_error(dev->pcm, n) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+        }
+        else
+        {
+            offset += n;    /* no error occurred */
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Timer-based scheduling: the hardware buffer is large and the device doesn't
+ * wake the driver up after each period. Instead the driver tops the buffer up
+ * with as many periods as fit into it, and then sleeps until only a safety
+ * margin of audio is left in the buffer. The margin grows after each xrun and
+ * shrinks slowly back while the audio plays without interruptions, so that the
+ * latency adapts to the scheduling of the system.
+ */
+static fluid_thread_return_t fluid_alsa_audio_run_tsched(void *d)
+{
+    fluid_alsa_audio_driver_t *dev = (fluid_alsa_audio_driver_t *) d;
+    float *left;
+    float *right;
+    short *buf;
+    snd_pcm_sframes_t avail, delay, margin, max_margin;
+    double frames_per_usec;
+    unsigned int rate;
+    int dither_index = 0;
+    int wakeups = 0;
+    int buffer_size, err;
+
+    buffer_size = dev->buffer_size;
+
+    left = FLUID_ARRAY(float, buffer_size);
+    right = FLUID_ARRAY(float, buffer_size);
+    buf = FLUID_ARRAY(short, 2 * buffer_size);
+
+    if((left == NULL) || (right == NULL) || (buf == NULL))
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory.");
+        goto error_recovery;
+    }
+
+    if(snd_pcm_prepare(dev->pcm) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to prepare the audio device");
+        goto error_recovery;
+    }
+
+    {
+        snd_pcm_hw_params_t *hwparams;
+        snd_pcm_hw_params_alloca(&hwparams);
+
+        if(snd_pcm_hw_params_current(dev->pcm, hwparams) < 0
+                || snd_pcm_hw_params_get_rate(hwparams, &rate, NULL) < 0)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to get the sample rate of the audio device");
+            goto error_recovery;
+        }
+    }
+
+    frames_per_usec = rate / 1000000.0;
+
+    /* start with a margin of one period, up to half of the buffer */
+    margin = buffer_size;
+    max_margin = (snd_pcm_sframes_t)dev->hw_buffer_size / 2;
+
+    if(max_margin < margin)
+    {
+        max_margin = margin;
+    }
+
+    while(dev->cont)
+    {
+        err = snd_pcm_avail_delay(dev->pcm, &avail, &delay);
+
+        if(err < 0)	/* error occurred? */
+        {
+            if(err == -EPIPE)
+            {
+                /* woke up too late, keep more audio in the buffer from now on */
+                margin = (2 * margin < max_margin) ? 2 * margin : max_margin;
+                wakeups = 0;
+                FLUID_LOG(FLUID_DBG, "ALSA xrun, waking up %d frames before the buffer drains",
+                          (int)margin);
+            }
+
+            if(fluid_alsa_handle_write_error(dev->pcm, err) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+
+            continue;
+        }
+
+        /* fill the buffer up */
+        for(; avail >= buffer_size && dev->cont; avail -= buffer_size, delay += buffer_size)
+        {
+            if(fluid_alsa_audio_write(dev, left, right, buf, &dither_index, buffer_size) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+        }
+
+        /* the buffer was played without interruptions for a while */
+        if(++wakeups >= 100)
+        {
+            wakeups = 0;
+
+            if(margin - margin / 8 >= buffer_size)
+            {
+                margin -= margin / 8;
+            }
+        }
+
+        /* sleep until only the margin is left to be played */
+        if(delay > margin)
+        {
+            fluid_usleep((unsigned int)((delay - margin) / frames_per_usec));
+        }
+        else
+        {
+            /* less than a period could be written, wait for one to become free */
+            fluid_usleep((unsigned int)(buffer_size / frames_per_usec / 2));
+        }
+    }	/* while (dev->cont) */
+
+error_recovery:
+
+    FLUID_FREE(left);
+    FLUID_FREE(right);
+    FLUID_FREE(buf);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Address of the frame at offset of a channel in the mmap area, and the distance
+ * between its frames in samples of size bytes */
+static void *
+fluid_alsa_area_ptr(const snd_pcm_channel_area_t *area, snd_pcm_uframes_t offset,
+                    size_t size, int *incr)
+{
+    *incr = area->step / (8 * size);
+    return (char *)area->addr + (area->first + offset * area->step) / 8;
+}
+
+/*
+ * Render the audio straight into the ring buffer of the device, rather than
+ * into a buffer copied to it by snd_pcm_writen()/snd_pcm_writei(). Handles both
+ * formats and layouts of the mmap entries of fluid_alsa_formats.
+ */
+static fluid_thread_return_t fluid_alsa_audio_run_mmap(void *d)
+{
+    fluid_alsa_audio_driver_t *dev = (fluid_alsa_audio_driver_t *) d;
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, frames;
+    snd_pcm_sframes_t avail, n;
+    float *left = NULL;
+    float *right = NULL;
+    float *handle[2];
+    void *lout, *rout;
+    int lincr, rincr, i, err;
+    int dither_index = 0;
+    int is_float = dev->format == SND_PCM_FORMAT_FLOAT;
+    size_t size = is_float ? sizeof(float) : sizeof(short);
+    int buffer_size = dev->buffer_size;
+
+    if(dev->callback)
+    {
+        /* the callback renders non interleaved float data */
+        left = FLUID_ARRAY(float, buffer_size);
+        right = FLUID_ARRAY(float, buffer_size);
+
+        if((left == NULL) || (right == NULL))
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory.");
+            goto error_recovery;
+        }
+    }
+
+    if(snd_pcm_prepare(dev->pcm) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to prepare the audio device");
+        goto error_recovery;
+    }
+
+    while(dev->cont)
+    {
+        avail = snd_pcm_avail_update(dev->pcm);
+
+        if(avail >= 0 && avail < buffer_size)
+        {
+            /* wait for a period to become free */
+            err = snd_pcm_wait(dev->pcm, 1000);
+            avail = (err < 0) ? err : 0;
+        }
+
+        if(avail < 0)	/* error occurred? */
+        {
+            if(fluid_alsa_handle_write_error(dev->pcm, (int)avail) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+
+            continue;
+        }
+
+        if(avail == 0)
+        {
+            continue;
+        }
+
+        /* the area may wrap around at the end of the ring buffer */
+        n = 0;
+
+        for(frames = buffer_size; frames > 0; frames -= n)
+        {
+            snd_pcm_uframes_t count = frames;
+
+            if((err = snd_pcm_mmap_begin(dev->pcm, &areas, &offset, &count)) < 0)
+            {
+                n = err;
+                break;
+            }
+
+            lout = fluid_alsa_area_ptr(&areas[0], offset, size, &lincr);
+            rout = fluid_alsa_area_ptr(&areas[1], offset, size, &rincr);
+
+            if(dev->callback)
+            {
+                FLUID_MEMSET(left, 0, count * sizeof(*left));
+                FLUID_MEMSET(right, 0, count * sizeof(*right));
+
+                handle[0] = left;
+                handle[1] = right;
+
+                (*dev->callback)(dev->data, count, 0, NULL, 2, handle);
+
+                if(is_float)
+                {
+                    for(i = 0; i < (int)count; i++)
+                    {
+                        ((float *)lout)[i * lincr] = left[i];
+                        ((float *)rout)[i * rincr] = right[i];
+                    }
+                }
+                else
+                {
+                    /* convert floating point data to 16 bit (with dithering) */
+                    fluid_synth_dither_s16(&dither_index, count, left, right,
+                                           lout, 0, lincr, rout, 0, rincr);
+                }
+            }
+            else if(is_float)	/* no user audio callback, dev->data is the synth instance */
+            {
+                fluid_synth_write_float(dev->data, count, lout, 0, lincr, rout, 0, rincr);
+            }
+            else
+            {
+                fluid_synth_write_s16(dev->data, count, lout, 0, lincr, rout, 0, rincr);
+            }
+
+            n = snd_pcm_mmap_commit(dev->pcm, offset, count);
+
+            if(n >= 0 && (snd_pcm_uframes_t)n != count)
+            {
+                n = -EPIPE;
+            }
+
+            if(n < 0)
+            {
+                break;
+            }
+        }
+
+        /* unlike snd_pcm_writei(), committing doesn't start the device */
+        if(n >= 0 && snd_pcm_state(dev->pcm) == SND_PCM_STATE_PREPARED)
+        {
+            n = snd_pcm_start(dev->pcm);
+        }
+
+        if(n < 0)	/* error occurred? */
+        {
+            if(fluid_alsa_handle_write_error(dev->pcm, (int)n) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+        }
+    }	/* while (dev->cont) */
+
+error_recovery:
+
+    FLUID_FREE(left);
+    FLUID_FREE(right);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
 
 /**************************************************************
  *
@@ -783,9 +1190,9 @@ delete_fluid_alsa_rawmidi_driver(fluid_midi_driver_t *p)
 fluid_thread_return_t
 fluid_alsa_midi_run(void *d)
 {
-    fluid_midi_event_t *evt;
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
     fluid_alsa_rawmidi_driver_t *dev = (fluid_alsa_rawmidi_driver_t *) d;
-    int n, i;
+    int n, i, k, count, consumed;
 
     /* go into a loop until someone tells us to stop */
     while(!fluid_atomic_int_get(&dev->should_quit))
@@ -811,13 +1218,14 @@ fluid_alsa_midi_run(void *d)
             }
 
             /* let the parser convert the data into events */
-            for(i = 0; i < n; i++)
+            for(i = 0; i < n; i += consumed)
             {
-                evt = fluid_midi_parser_parse(dev->parser, dev->buffer[i]);
+                count = fluid_midi_parser_parse_buffer(dev->parser, dev->buffer + i, n - i,
+                                                       events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
 
-                if(evt != NULL)
+                for(k = 0; k < count; k++)
                 {
-                    (*dev->driver.handler)(dev->driver.data, evt);
+                    (*dev->driver.handler)(dev->driver.data, &events[k]);
                 }
             }
         }
@@ -1012,6 +1420,7 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
     FLUID_MEMSET(dev, 0, sizeof(fluid_alsa_seq_driver_t));
     dev->driver.data = data;
     dev->driver.handler = handler;
+    dev->queue = -1;
 
     fluid_settings_getint(settings, "midi.realtime-prio", &realtime_prio);
 
@@ -1048,8 +1457,9 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
         portname = NULL;
     }
 
-    /* open the sequencer INPUT only */
-    err = snd_seq_open(&dev->seq_handle, device ? device : "default", SND_SEQ_OPEN_INPUT, 0);
+    /* open the sequencer INPUT only, unless it has to start a queue to timestamp the events */
+    err = snd_seq_open(&dev->seq_handle, device ? device : "default",
+                       fluid_midi_driver_schedules_events(&dev->driver) ? SND_SEQ_OPEN_DUPLEX : SND_SEQ_OPEN_INPUT, 0);
 
     if(err < 0)
     {
@@ -1113,6 +1523,23 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
     snd_seq_port_info_set_midi_channels(port_info, 16);
     snd_seq_port_info_set_port_specified(port_info, 1);
 
+    /* the events are stamped with the real time of their arrival by the queue */
+    if(fluid_midi_driver_schedules_events(&dev->driver))
+    {
+        dev->queue = snd_seq_alloc_named_queue(dev->seq_handle, "fluidsynth");
+
+        if(dev->queue < 0)
+        {
+            FLUID_LOG(FLUID_WARN, "Error allocating an ALSA sequencer queue, the MIDI events are timestamped on reading");
+        }
+        else
+        {
+            snd_seq_port_info_set_timestamping(port_info, 1);
+            snd_seq_port_info_set_timestamp_real(port_info, 1);
+            snd_seq_port_info_set_timestamp_queue(port_info, dev->queue);
+        }
+    }
+
     for(i = 0; i < dev->port_count; i++)
     {
 
@@ -1156,6 +1583,13 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
     }
 #endif /* HAVE_LASH */
 
+    if(dev->queue >= 0)
+    {
+        snd_seq_start_queue(dev->seq_handle, dev->queue, NULL);
+        snd_seq_drain_output(dev->seq_handle);
+        dev->queue_start = fluid_utime();
+    }
+
     fluid_atomic_int_set(&dev->should_quit, 0);
 
     /* create the MIDI thread */
@@ -1220,6 +1654,11 @@ delete_fluid_alsa_seq_driver(fluid_midi_driver_t *p)
 
     if(dev->seq_handle)
     {
+        if(dev->queue >= 0)
+        {
+            snd_seq_free_queue(dev->seq_handle, dev->queue);
+        }
+
         snd_seq_close(dev->seq_handle);
     }
 
@@ -1237,11 +1676,19 @@ delete_fluid_alsa_seq_driver(fluid_midi_driver_t *p)
 fluid_thread_return_t
 fluid_alsa_seq_run(void *d)
 {
-    int n, ev;
+    int n, ev, count = 0;
     snd_seq_event_t *seq_ev;
-    fluid_midi_event_t evt;
+    fluid_midi_event_t events[FLUID_ALSA_SEQ_BATCH];
+    fluid_midi_event_t *batch[FLUID_ALSA_SEQ_BATCH];
+    double usecs[FLUID_ALSA_SEQ_BATCH];
+    fluid_midi_event_t *evt;
     fluid_alsa_seq_driver_t *dev = (fluid_alsa_seq_driver_t *) d;
 
+    for(n = 0; n < FLUID_ALSA_SEQ_BATCH; n++)
+    {
+        batch[n] = &events[n];
+    }
+
     /* go into a loop until someone tells us to stop */
     while(!fluid_atomic_int_get(&dev->should_quit))
     {
@@ -1255,6 +1702,7 @@ fluid_alsa_seq_run(void *d)
         }
         else if(n > 0)           /* check for pending events */
         {
+            /* drain the pending events, handled in batches */
             do
             {
                 ev = snd_seq_event_input(dev->seq_handle, &seq_ev);	/* read the events */
@@ -1278,54 +1726,56 @@ fluid_alsa_seq_run(void *d)
                     break;
                 }
 
+                evt = &events[count];
+
                 switch(seq_ev->type)
                 {
                 case SND_SEQ_EVENT_NOTEON:
-                    evt.type = NOTE_ON;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
-                    evt.param1 = seq_ev->data.note.note;
-                    evt.param2 = seq_ev->data.note.velocity;
+                    evt->type = NOTE_ON;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
+                    evt->param1 = seq_ev->data.note.note;
+                    evt->param2 = seq_ev->data.note.velocity;
                     break;
 
                 case SND_SEQ_EVENT_NOTEOFF:
-                    evt.type = NOTE_OFF;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
-                    evt.param1 = seq_ev->data.note.note;
-                    evt.param2 = seq_ev->data.note.velocity;
+                    evt->type = NOTE_OFF;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
+                    evt->param1 = seq_ev->data.note.note;
+                    evt->param2 = seq_ev->data.note.velocity;
                     break;
 
                 case SND_SEQ_EVENT_KEYPRESS:
-                    evt.type = KEY_PRESSURE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
-                    evt.param1 = seq_ev->data.note.note;
-                    evt.param2 = seq_ev->data.note.velocity;
+                    evt->type = KEY_PRESSURE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
+                    evt->param1 = seq_ev->data.note.note;
+                    evt->param2 = seq_ev->data.note.velocity;
                     break;
 
                 case SND_SEQ_EVENT_CONTROLLER:
-                    evt.type = CONTROL_CHANGE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
-                    evt.param1 = seq_ev->data.control.param;
-                    evt.param2 = seq_ev->data.control.value;
+                    evt->type = CONTROL_CHANGE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->param1 = seq_ev->data.control.param;
+                    evt->param2 = seq_ev->data.control.value;
                     break;
 
                 case SND_SEQ_EVENT_PITCHBEND:
-                    evt.type = PITCH_BEND;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->type = PITCH_BEND;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
 
                     /* ALSA pitch bend is -8192 - 8191, we adjust it here */
-                    evt.param1 = seq_ev->data.control.value + 8192;
+                    evt->param1 = seq_ev->data.control.value + 8192;
                     break;
 
                 case SND_SEQ_EVENT_PGMCHANGE:
-                    evt.type = PROGRAM_CHANGE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
-                    evt.param1 = seq_ev->data.control.value;
+                    evt->type = PROGRAM_CHANGE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->param1 = seq_ev->data.control.value;
                     break;
 
                 case SND_SEQ_EVENT_CHANPRESS:
-                    evt.type = CHANNEL_PRESSURE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
-                    evt.param1 = seq_ev->data.control.value;
+                    evt->type = CHANNEL_PRESSURE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->param1 = seq_ev->data.control.value;
                     break;
 
                 case SND_SEQ_EVENT_SYSEX:
@@ -1334,7 +1784,7 @@ fluid_alsa_seq_run(void *d)
                         continue;
                     }
 
-                    fluid_midi_event_set_sysex(&evt, (char *)(seq_ev->data.ext.ptr) + 1,
+                    fluid_midi_event_set_sysex(evt, (char *)(seq_ev->data.ext.ptr) + 1,
                                                seq_ev->data.ext.len - 2, FALSE);
                     break;
 
@@ -1345,16 +1795,41 @@ fluid_alsa_seq_run(void *d)
                         fluid_alsa_seq_autoconnect_port(dev, seq_ev->data.addr.client, seq_ev->data.addr.port);
                     }
                 }
-                break;
+                continue;		/* nothing to pass on */
 
                 default:
                     continue;		/* unhandled event, next loop iteration */
                 }
 
-                /* send the events to the next link in the chain */
-                (*dev->driver.handler)(dev->driver.data, &evt);
+                /* the real time of the queue when the event arrived */
+                if(dev->queue >= 0 && (seq_ev->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL)
+                {
+                    usecs[count] = dev->queue_start + seq_ev->time.time.tv_sec * 1000000.0
+                                   + seq_ev->time.time.tv_nsec / 1000.0;
+                }
+                else
+                {
+                    usecs[count] = fluid_utime();
+                }
+
+                count++;
+
+                /* send the events to the next link in the chain once the batch is full.
+                 * The data of a SysEx event is left in the input buffer of the sequencer,
+                 * which reading the next events may overwrite: send it right away. */
+                if(count == FLUID_ALSA_SEQ_BATCH || seq_ev->type == SND_SEQ_EVENT_SYSEX)
+                {
+                    fluid_midi_driver_handle_events(&dev->driver, batch, usecs, count);
+                    count = 0;
+                }
             }
             while(ev > 0);
+
+            if(count > 0)
+            {
+                fluid_midi_driver_handle_events(&dev->driver, batch, usecs, count);
+                count = 0;
+            }
         }	/* if poll() > 0 */
     }	/* while (!dev->should_quit) */
 
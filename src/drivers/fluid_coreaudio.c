@@ -40,6 +40,10 @@
 #include <CoreAudio/AudioHardware.h>
 #include <AudioUnit/AudioUnit.h>
 
+#if defined(MAC_OS_VERSION_11_0) && MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_VERSION_11_0
+#include <os/workgroup.h>
+#endif
+
 /*
  * fluid_core_audio_driver_t
  *
@@ -52,7 +56,9 @@ typedef struct
     fluid_audio_func_t callback;
     void *data;
     unsigned int buffer_size;
-    float *buffers[2];
+    int noninterleaved;         /* rendered right into the buffers of the unit */
+    float *buffers[2];          /* for the callback of an interleaved format only */
+    void *workgroup;            /* os_workgroup_t joined by the mixer threads, or NULL */
     double phase;
 } fluid_core_audio_driver_t;
 
@@ -110,6 +116,97 @@ get_num_outputs(AudioDeviceID deviceID)
     return total;
 }
 
+/*
+ * Set the format of the samples given to the output unit, returns the status.
+ * The unit converts them to the format of the device as needed.
+ */
+static OSStatus
+fluid_core_audio_set_format(fluid_core_audio_driver_t *dev, double sample_rate, int noninterleaved)
+{
+    UInt32 frame_size = (noninterleaved ? 1 : 2) * sizeof(float);
+
+    dev->format.mSampleRate = sample_rate; // sample rate of the audio stream
+    dev->format.mFormatID = kAudioFormatLinearPCM; // encoding type of the audio stream
+    dev->format.mFormatFlags = kLinearPCMFormatFlagIsFloat;
+
+    if(noninterleaved)
+    {
+        // a buffer of its own for each channel, i.e. the layout of fluid_synth_process()
+        dev->format.mFormatFlags |= kAudioFormatFlagIsPacked | kAudioFormatFlagIsNonInterleaved;
+    }
+
+    dev->format.mBytesPerPacket = frame_size;
+    dev->format.mFramesPerPacket = 1;
+    dev->format.mBytesPerFrame = frame_size;
+    dev->format.mChannelsPerFrame = 2;
+    dev->format.mBitsPerChannel = 8 * sizeof(float);
+
+    FLUID_LOG(FLUID_DBG, "mSampleRate %g", dev->format.mSampleRate);
+    FLUID_LOG(FLUID_DBG, "mFormatFlags %08X", dev->format.mFormatFlags);
+    FLUID_LOG(FLUID_DBG, "mBytesPerPacket %d", dev->format.mBytesPerPacket);
+    FLUID_LOG(FLUID_DBG, "mFramesPerPacket %d", dev->format.mFramesPerPacket);
+    FLUID_LOG(FLUID_DBG, "mChannelsPerFrame %d", dev->format.mChannelsPerFrame);
+    FLUID_LOG(FLUID_DBG, "mBytesPerFrame %d", dev->format.mBytesPerFrame);
+    FLUID_LOG(FLUID_DBG, "mBitsPerChannel %d", dev->format.mBitsPerChannel);
+
+    return AudioUnitSetProperty(dev->outputUnit,
+                                kAudioUnitProperty_StreamFormat,
+                                kAudioUnitScope_Input,
+                                0,
+                                &dev->format,
+                                sizeof(AudioStreamBasicDescription));
+}
+
+/*
+ * Let the extra mixer threads of the synth join the audio workgroup of the
+ * device, so that they are scheduled along with its realtime thread, e.g. onto
+ * the performance cores of Apple Silicon.
+ */
+static void
+fluid_core_audio_join_workgroup(fluid_core_audio_driver_t *dev)
+{
+#if defined(MAC_OS_VERSION_11_0) && MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_VERSION_11_0
+
+    if(__builtin_available(macOS 11.0, *))
+    {
+        AudioObjectPropertyAddress pa;
+        AudioDeviceID deviceID;
+        os_workgroup_t workgroup = NULL;
+        UInt32 size = sizeof(deviceID);
+
+        if(!OK(AudioUnitGetProperty(dev->outputUnit, kAudioOutputUnitProperty_CurrentDevice,
+                                    kAudioUnitScope_Global, 0, &deviceID, &size)))
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to get the audio device, not joining its workgroup");
+            return;
+        }
+
+        pa.mSelector = kAudioDevicePropertyIOThreadOSWorkgroup;
+        pa.mScope = kAudioObjectPropertyScopeGlobal;
+        pa.mElement = kAudioObjectPropertyElementMaster;
+        size = sizeof(workgroup);
+
+        if(!OK(AudioObjectGetPropertyData(deviceID, &pa, 0, NULL, &size, &workgroup)) || workgroup == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to get the workgroup of the audio device");
+            return;
+        }
+
+        if(fluid_synth_set_workgroup((fluid_synth_t *) dev->data, workgroup) != FLUID_OK)
+        {
+            fluid_synth_set_workgroup((fluid_synth_t *) dev->data, NULL);
+            os_release(workgroup);
+            return;
+        }
+
+        dev->workgroup = workgroup;
+        return;
+    }
+
+#endif
+    FLUID_LOG(FLUID_WARN, "Audio workgroups are not supported by this system");
+}
+
 void
 fluid_core_audio_driver_settings(fluid_settings_t *settings)
 {
@@ -122,6 +219,7 @@ fluid_core_audio_driver_settings(fluid_settings_t *settings)
 
     fluid_settings_register_str(settings, "audio.coreaudio.device", "default", 0);
     fluid_settings_add_option(settings, "audio.coreaudio.device", "default");
+    fluid_settings_register_int(settings, "audio.coreaudio.workgroup", 0, 0, 1, FLUID_HINT_TOGGLED);
 
     if(OK(AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &pa, 0, 0, &size)))
     {
@@ -171,6 +269,7 @@ new_fluid_core_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func
     double sample_rate;
     OSStatus status;
     UInt32 size;
+    int workgroup;
     int i;
 
     dev = FLUID_NEW(fluid_core_audio_driver_t);
@@ -283,29 +382,17 @@ new_fluid_core_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func
 
     // The DefaultOutputUnit should do any format conversions
     // necessary from our format to the device's format.
-    dev->format.mSampleRate = sample_rate; // sample rate of the audio stream
-    dev->format.mFormatID = kAudioFormatLinearPCM; // encoding type of the audio stream
-    dev->format.mFormatFlags = kLinearPCMFormatFlagIsFloat;
-    dev->format.mBytesPerPacket = 2 * sizeof(float);
-    dev->format.mFramesPerPacket = 1;
-    dev->format.mBytesPerFrame = 2 * sizeof(float);
-    dev->format.mChannelsPerFrame = 2;
-    dev->format.mBitsPerChannel = 8 * sizeof(float);
+    // Non-interleaved buffers are rendered into without any copy.
+    dev->noninterleaved = TRUE;
+    status = fluid_core_audio_set_format(dev, sample_rate, TRUE);
 
-    FLUID_LOG(FLUID_DBG, "mSampleRate %g", dev->format.mSampleRate);
-    FLUID_LOG(FLUID_DBG, "mFormatFlags %08X", dev->format.mFormatFlags);
-    FLUID_LOG(FLUID_DBG, "mBytesPerPacket %d", dev->format.mBytesPerPacket);
-    FLUID_LOG(FLUID_DBG, "mFramesPerPacket %d", dev->format.mFramesPerPacket);
-    FLUID_LOG(FLUID_DBG, "mChannelsPerFrame %d", dev->format.mChannelsPerFrame);
-    FLUID_LOG(FLUID_DBG, "mBytesPerFrame %d", dev->format.mBytesPerFrame);
-    FLUID_LOG(FLUID_DBG, "mBitsPerChannel %d", dev->format.mBitsPerChannel);
+    if(status != noErr)
+    {
+        FLUID_LOG(FLUID_DBG, "Non-interleaved format not supported, Status=%ld. Using an interleaved one.", (long int)status);
 
-    status = AudioUnitSetProperty(dev->outputUnit,
-                                  kAudioUnitProperty_StreamFormat,
-                                  kAudioUnitScope_Input,
-                                  0,
-                                  &dev->format,
-                                  sizeof(AudioStreamBasicDescription));
+        dev->noninterleaved = FALSE;
+        status = fluid_core_audio_set_format(dev, sample_rate, FALSE);
+    }
 
     if(status != noErr)
     {
@@ -328,13 +415,16 @@ new_fluid_core_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func
 
     FLUID_LOG(FLUID_DBG, "MaximumFramesPerSlice = %d", dev->buffer_size);
 
-    dev->buffers[0] = FLUID_ARRAY(float, dev->buffer_size);
-    dev->buffers[1] = FLUID_ARRAY(float, dev->buffer_size);
-    
-    if(dev->buffers[0] == NULL || dev->buffers[1] == NULL)
+    if(func != NULL && !dev->noninterleaved)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory.");
-        goto error_recovery;
+        dev->buffers[0] = FLUID_ARRAY(float, dev->buffer_size);
+        dev->buffers[1] = FLUID_ARRAY(float, dev->buffer_size);
+
+        if(dev->buffers[0] == NULL || dev->buffers[1] == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory.");
+            goto error_recovery;
+        }
     }
 
     // Initialize the audio unit
@@ -346,6 +436,21 @@ new_fluid_core_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func
         goto error_recovery;
     }
 
+    // The mixer threads join the workgroup before the synth is rendered
+    fluid_settings_getint(settings, "audio.coreaudio.workgroup", &workgroup);
+
+    if(workgroup)
+    {
+        if(func == NULL)
+        {
+            fluid_core_audio_join_workgroup(dev);
+        }
+        else
+        {
+            FLUID_LOG(FLUID_WARN, "audio.coreaudio.workgroup only applies to a synth, not to a custom audio callback");
+        }
+    }
+
     // Start the rendering
     status = AudioOutputUnitStart(dev->outputUnit);
 
@@ -372,8 +477,24 @@ delete_fluid_core_audio_driver(fluid_audio_driver_t *p)
     fluid_core_audio_driver_t *dev = (fluid_core_audio_driver_t *) p;
     fluid_return_if_fail(dev != NULL);
 
+    if(dev->outputUnit != NULL)
+    {
+        AudioOutputUnitStop(dev->outputUnit);
+    }
+
     CloseComponent(dev->outputUnit);
 
+#if defined(MAC_OS_VERSION_11_0) && MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_VERSION_11_0
+
+    // the mixer threads leave the workgroup before it is released
+    if(dev->workgroup != NULL)
+    {
+        fluid_synth_set_workgroup((fluid_synth_t *) dev->data, NULL);
+        os_release((os_workgroup_t) dev->workgroup);
+    }
+
+#endif
+
     if(dev->buffers[0])
     {
         FLUID_FREE(dev->buffers[0]);
@@ -400,7 +521,27 @@ fluid_core_audio_callback(void *data,
     int len = inNumberFrames;
     float *buffer = ioData->mBuffers[0].mData;
 
-    if(dev->callback)
+    if(dev->noninterleaved)
+    {
+        // render right into the buffers of the unit
+        float *out[2];
+
+        out[0] = ioData->mBuffers[0].mData;
+        out[1] = ioData->mBuffers[1].mData;
+
+        if(dev->callback)
+        {
+            FLUID_MEMSET(out[0], 0, len * sizeof(float));
+            FLUID_MEMSET(out[1], 0, len * sizeof(float));
+
+            (*dev->callback)(dev->data, len, 0, NULL, 2, out);
+        }
+        else
+        {
+            fluid_synth_write_float((fluid_synth_t *) dev->data, len, out[0], 0, 1, out[1], 0, 1);
+        }
+    }
+    else if(dev->callback)
     {
         float *left = dev->buffers[0];
         float *right = dev->buffers[1];
@@ -51,6 +51,7 @@
 #include <unistd.h>
 #include <CoreServices/CoreServices.h>
 #include <CoreMIDI/MIDIServices.h>
+#include <mach/mach_time.h>
 
 typedef struct
 {
@@ -60,6 +61,7 @@ typedef struct
     MIDIPortRef input_port;
     fluid_midi_parser_t *parser;
     int autoconn_inputs;
+    mach_timebase_info_data_t timebase; /* of the timestamps of the packets */
 } fluid_coremidi_driver_t;
 
 void fluid_coremidi_callback(const MIDIPacketList *list, void *p, void *src);
@@ -128,6 +130,7 @@ new_fluid_coremidi_driver(fluid_settings_t *settings, handle_midi_event_func_t h
     dev->endpoint = 0;
     dev->parser = 0;
     dev->driver.handler = handler;
+    mach_timebase_info(&dev->timebase);
     dev->driver.data = data;
 
     dev->parser = new_fluid_midi_parser();
@@ -258,19 +261,31 @@ void
 fluid_coremidi_callback(const MIDIPacketList *list, void *p, void *src)
 {
     unsigned int i, j;
-    fluid_midi_event_t *event;
+    int k, count, consumed;
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
     fluid_coremidi_driver_t *dev = (fluid_coremidi_driver_t *)p;
     const MIDIPacket *packet = &list->packet[0];
+    double now = fluid_utime(), usec;
 
     for(i = 0; i < list->numPackets; ++i)
     {
-        for(j = 0; j < packet->length; ++j)
+        /* a timestamp of 0 stands for now, the others are in host time */
+        usec = now;
+
+        if(packet->timeStamp != 0)
+        {
+            usec -= ((double)mach_absolute_time() - (double)packet->timeStamp)
+                    * dev->timebase.numer / dev->timebase.denom / 1000.0;
+        }
+
+        for(j = 0; j < packet->length; j += consumed)
         {
-            event = fluid_midi_parser_parse(dev->parser, packet->data[j]);
+            count = fluid_midi_parser_parse_buffer(dev->parser, packet->data + j, packet->length - j,
+                                                   events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
 
-            if(event != NULL)
+            for(k = 0; k < count; k++)
             {
-                (*dev->driver.handler)(dev->driver.data, event);
+                fluid_midi_driver_handle_event_at(&dev->driver, &events[k], usec);
             }
         }
 
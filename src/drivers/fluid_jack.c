@@ -32,6 +32,7 @@
 #include "fluid_adriver.h"
 #include "fluid_mdriver.h"
 #include "fluid_settings.h"
+#include "fluid_trace.h"
 
 #if JACK_SUPPORT
 
@@ -72,6 +73,8 @@ struct _fluid_jack_audio_driver_t
 
     fluid_audio_func_t callback;
     void *data;
+
+    int with_mixer_threads;       /* Are the extra mixer threads of the synth JACK threads? */
 };
 
 /* Jack MIDI driver instance */
@@ -81,6 +84,8 @@ struct _fluid_jack_midi_driver_t
     fluid_jack_client_t *client_ref;
     int midi_port_count;
     jack_port_t **midi_port; // array of midi port handles
+    void **midi_buffer; // the event buffer of each port for the current period
+    jack_nframes_t *midi_event_index; // the next event of each port to dispatch
     fluid_midi_parser_t *parser;
     int autoconnect_inputs;
     int autoconnect_is_outdated;
@@ -97,6 +102,9 @@ int fluid_jack_driver_srate(jack_nframes_t nframes, void *arg);
 int fluid_jack_driver_bufsize(jack_nframes_t nframes, void *arg);
 int fluid_jack_driver_process(jack_nframes_t nframes, void *arg);
 void fluid_jack_port_registration(jack_port_id_t port, int is_registering, void *arg);
+static void fluid_jack_start_mixer_threads(fluid_jack_audio_driver_t *dev, jack_client_t *client,
+        fluid_settings_t *settings);
+static void fluid_jack_stop_mixer_threads(fluid_jack_audio_driver_t *dev);
 
 static fluid_mutex_t last_client_mutex = FLUID_MUTEX_INIT;     /* Probably not necessary, but just in case drivers are created by multiple threads */
 static fluid_jack_client_t *last_client = NULL;       /* Last unpaired client. For audio/MIDI driver pairing. */
@@ -109,6 +117,7 @@ fluid_jack_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_register_int(settings, "audio.jack.multi", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "audio.jack.autoconnect", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_str(settings, "audio.jack.server", "", 0);
+    fluid_settings_register_int(settings, "audio.jack.mixer-threads", 0, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 /*
@@ -178,6 +187,7 @@ new_fluid_jack_client(fluid_settings_t *settings, int isaudio, void *driver)
 
             if(isaudio)
             {
+                fluid_jack_start_mixer_threads(driver, client_ref->client, settings);
                 fluid_atomic_pointer_set(&client_ref->audio_driver, driver);
             }
             else
@@ -286,6 +296,7 @@ new_fluid_jack_client(fluid_settings_t *settings, int isaudio, void *driver)
 
     if(isaudio)
     {
+        fluid_jack_start_mixer_threads(driver, client_ref->client, settings);
         fluid_atomic_pointer_set(&client_ref->audio_driver, driver);
     }
     else
@@ -343,9 +354,19 @@ fluid_jack_client_register_ports(void *driver, int isaudio, jack_client_t *clien
         fluid_settings_getint(settings, "synth.midi-channels", &midi_channels);
         ports = midi_channels / 16;
 
-        if((dev->midi_port = FLUID_ARRAY(jack_port_t *, ports)) == NULL)
+        dev->midi_port = FLUID_ARRAY(jack_port_t *, ports);
+        dev->midi_buffer = FLUID_ARRAY(void *, ports);
+        dev->midi_event_index = FLUID_ARRAY(jack_nframes_t, ports);
+
+        if(dev->midi_port == NULL || dev->midi_buffer == NULL || dev->midi_event_index == NULL)
         {
             FLUID_LOG(FLUID_PANIC, "Out of memory");
+            FLUID_FREE(dev->midi_port);
+            FLUID_FREE(dev->midi_buffer);
+            FLUID_FREE(dev->midi_event_index);
+            dev->midi_port = NULL;
+            dev->midi_buffer = NULL;
+            dev->midi_event_index = NULL;
             return FLUID_FAILED;
         }
 
@@ -528,12 +549,97 @@ error_recovery:
     return FLUID_FAILED;
 }
 
+/* Creates an extra mixer thread of the synth as a realtime thread of the JACK client */
+static void *
+fluid_jack_create_mixer_thread(void *data, const char *name, fluid_thread_func_t func, void *arg)
+{
+    jack_client_t *client = data;
+    jack_native_thread_t *thread = FLUID_NEW(jack_native_thread_t);
+
+    if(thread == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    if(jack_client_create_thread(client, thread, jack_client_real_time_priority(client),
+                                 jack_is_realtime(client), func, arg) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the Jack thread '%s'", name);
+        FLUID_FREE(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+/* The mixer thread exits on its own, jack_client_stop_thread() just joins it */
+static void
+fluid_jack_join_mixer_thread(void *data, void *thread)
+{
+    jack_client_stop_thread((jack_client_t *) data, *(jack_native_thread_t *) thread);
+    FLUID_FREE(thread);
+}
+
+/*
+ * Let the extra mixer threads of the synth be created by JACK, so that they run in
+ * the realtime scheduling class of the server, with the priority of the process
+ * callback. Must be called before the driver is handed to the process callback.
+ */
+static void
+fluid_jack_start_mixer_threads(fluid_jack_audio_driver_t *dev, jack_client_t *client,
+                               fluid_settings_t *settings)
+{
+    fluid_thread_factory_t factory;
+    int mixer_threads = 0;
+
+    fluid_settings_getint(settings, "audio.jack.mixer-threads", &mixer_threads);
+
+    if(!mixer_threads)
+    {
+        return;
+    }
+
+    if(dev->callback != NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "audio.jack.mixer-threads only applies to a synth, not to a custom audio callback");
+        return;
+    }
+
+    factory.create = fluid_jack_create_mixer_thread;
+    factory.join = fluid_jack_join_mixer_thread;
+    factory.data = client;
+
+    if(fluid_synth_set_thread_factory((fluid_synth_t *) dev->data, &factory) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to create the mixer threads through Jack, using regular threads");
+        fluid_synth_set_thread_factory((fluid_synth_t *) dev->data, NULL);
+        return;
+    }
+
+    dev->with_mixer_threads = TRUE;
+}
+
+/* The synth must no longer be rendered, and the JACK client still be open */
+static void
+fluid_jack_stop_mixer_threads(fluid_jack_audio_driver_t *dev)
+{
+    if(dev->with_mixer_threads)
+    {
+        fluid_synth_set_thread_factory((fluid_synth_t *) dev->data, NULL);
+        dev->with_mixer_threads = FALSE;
+    }
+}
+
 static void
 fluid_jack_client_close(fluid_jack_client_t *client_ref, void *driver)
 {
+    int isaudio = FALSE;
+
     if(client_ref->audio_driver == driver)
     {
         fluid_atomic_pointer_set(&client_ref->audio_driver, NULL);
+        isaudio = TRUE;
     }
     else if(client_ref->midi_driver == driver)
     {
@@ -543,9 +649,22 @@ fluid_jack_client_close(fluid_jack_client_t *client_ref, void *driver)
     if(client_ref->audio_driver || client_ref->midi_driver)
     {
         fluid_msleep(100);  /* FIXME - Hack to make sure that resources don't get freed while Jack callback is active */
+
+        if(isaudio)
+        {
+            fluid_jack_stop_mixer_threads(driver);
+        }
+
         return;
     }
 
+    if(isaudio && ((fluid_jack_audio_driver_t *) driver)->with_mixer_threads)
+    {
+        /* the synth is no longer rendered once the client is deactivated */
+        jack_deactivate(client_ref->client);
+        fluid_jack_stop_mixer_threads(driver);
+    }
+
     fluid_mutex_lock(last_client_mutex);
 
     if(client_ref == last_client)
@@ -685,23 +804,132 @@ delete_fluid_jack_audio_driver(fluid_audio_driver_t *p)
 }
 
 /* Process function for audio and MIDI Jack drivers */
-int
-fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
+/*
+ * Dispatch the MIDI events of all ports due before frame end of the period,
+ * in the order of their timestamps. If synth is not NULL, the voices they start
+ * begin at their frame within the next block rendered, which starts at frame
+ * block of the period.
+ * Returns the frame of the earliest event still pending, or nframes.
+ */
+static jack_nframes_t
+fluid_jack_midi_dispatch(fluid_jack_midi_driver_t *dev, fluid_synth_t *synth,
+                         jack_nframes_t block, jack_nframes_t end, jack_nframes_t nframes)
+{
+    jack_midi_event_t midi_event;
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
+    fluid_midi_event_t *evt;
+    jack_nframes_t next;
+    unsigned int u;
+    int i, k, count, consumed, port;
+
+    while(1)
+    {
+        /* the earliest event of all ports */
+        port = -1;
+        next = nframes;
+
+        for(i = 0; i < dev->midi_port_count; i++)
+        {
+            if(dev->midi_event_index[i] < jack_midi_get_event_count(dev->midi_buffer[i])
+                    && jack_midi_event_get(&midi_event, dev->midi_buffer[i], dev->midi_event_index[i]) == 0
+                    && (port < 0 || midi_event.time < next))
+            {
+                port = i;
+                next = midi_event.time;
+            }
+        }
+
+        if(port < 0 || next >= end)
+        {
+            return next;
+        }
+
+        jack_midi_event_get(&midi_event, dev->midi_buffer[port], dev->midi_event_index[port]++);
+
+        /* let the parser convert the data into events */
+        for(u = 0; u < midi_event.size; u += consumed)
+        {
+            count = fluid_midi_parser_parse_buffer(dev->parser, midi_event.buffer + u, (int)(midi_event.size - u),
+                                                   events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
+
+            /* send the events to the next link in the chain */
+            for(k = 0; k < count; k++)
+            {
+                evt = &events[k];
+                fluid_midi_event_set_channel(evt, fluid_midi_event_get_channel(evt) + port * 16);
+
+                if(synth != NULL && midi_event.time > block)
+                {
+                    fluid_synth_handle_midi_event_offset(synth, dev->driver.handler, dev->driver.data,
+                                                         evt, midi_event.time - block);
+                }
+                else
+                {
+                    dev->driver.handler(dev->driver.data, evt);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Render len frames of the period, starting at frame start.
+ */
+static int
+fluid_jack_driver_render(fluid_jack_audio_driver_t *dev, jack_nframes_t nframes,
+                         jack_nframes_t start, jack_nframes_t len)
+{
+    float *left, *right;
+    int i;
+
+    if(dev->callback == NULL && dev->num_output_ports == 1 && dev->num_fx_ports == 0)  /* i.e. audio.jack.multi=no */
+    {
+        left = (float *) jack_port_get_buffer(dev->output_ports[0], nframes);
+        right = (float *) jack_port_get_buffer(dev->output_ports[1], nframes);
+
+        return fluid_synth_write_float(dev->data, len, left, start, 1, right, start, 1);
+    }
+    else
+    {
+        for(i = 0; i < dev->num_output_ports * 2; i++)
+        {
+            dev->output_bufs[i] = (float *)jack_port_get_buffer(dev->output_ports[i], nframes) + start;
+        }
+
+        for(i = 0; i < dev->num_fx_ports * 2; i++)
+        {
+            dev->fx_bufs[i] = (float *)jack_port_get_buffer(dev->fx_ports[i], nframes) + start;
+        }
+
+        if(dev->callback == NULL)  /* i.e. audio.jack.multi=yes, a port for every channel */
+        {
+            return fluid_synth_write_float_channels(dev->data,
+                                                    len,
+                                                    dev->num_fx_ports * 2,
+                                                    dev->fx_bufs,
+                                                    dev->num_output_ports * 2,
+                                                    dev->output_bufs);
+        }
+
+        return dev->callback(dev->data,
+                             len,
+                             dev->num_fx_ports * 2,
+                             dev->fx_bufs,
+                             dev->num_output_ports * 2,
+                             dev->output_bufs);
+    }
+}
+
+static int
+fluid_jack_driver_process_cycle(jack_nframes_t nframes, void *arg)
 {
     fluid_jack_client_t *client = (fluid_jack_client_t *)arg;
     fluid_jack_audio_driver_t *audio_driver;
     fluid_jack_midi_driver_t *midi_driver;
-    float *left, *right;
+    fluid_synth_t *synth = NULL;
+    jack_nframes_t pos, block, next, len;
     int i;
 
-    jack_midi_event_t midi_event;
-    fluid_midi_event_t *evt;
-    void *midi_buffer;
-    jack_nframes_t event_count;
-    jack_nframes_t event_index;
-    unsigned int u;
-
-    /* Process MIDI events first, so that they take effect before audio synthesis */
     midi_driver = fluid_atomic_pointer_get(&client->midi_driver);
 
     if(midi_driver)
@@ -713,26 +941,8 @@ fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
 
         for(i = 0; i < midi_driver->midi_port_count; i++)
         {
-            midi_buffer = jack_port_get_buffer(midi_driver->midi_port[i], 0);
-            event_count = jack_midi_get_event_count(midi_buffer);
-
-            for(event_index = 0; event_index < event_count; event_index++)
-            {
-                jack_midi_event_get(&midi_event, midi_buffer, event_index);
-
-                /* let the parser convert the data into events */
-                for(u = 0; u < midi_event.size; u++)
-                {
-                    evt = fluid_midi_parser_parse(midi_driver->parser, midi_event.buffer[u]);
-
-                    /* send the event to the next link in the chain */
-                    if(evt != NULL)
-                    {
-                        fluid_midi_event_set_channel(evt, fluid_midi_event_get_channel(evt) + i * 16);
-                        midi_driver->driver.handler(midi_driver->driver.data, evt);
-                    }
-                }
-            }
+            midi_driver->midi_buffer[i] = jack_port_get_buffer(midi_driver->midi_port[i], 0);
+            midi_driver->midi_event_index[i] = 0;
         }
     }
 
@@ -740,52 +950,79 @@ fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
 
     if(audio_driver == NULL)
     {
-        // shutting down
+        // shutting down, or MIDI only
+        if(midi_driver)
+        {
+            fluid_jack_midi_dispatch(midi_driver, NULL, 0, nframes, nframes);
+        }
+
         return FLUID_OK;
     }
 
-    if(audio_driver->callback == NULL && audio_driver->num_output_ports == 1 && audio_driver->num_fx_ports == 0)  /* i.e. audio.jack.multi=no */
+    if(audio_driver->callback == NULL)
     {
-        left = (float *) jack_port_get_buffer(audio_driver->output_ports[0], nframes);
-        right = (float *) jack_port_get_buffer(audio_driver->output_ports[1], nframes);
-
-        return fluid_synth_write_float(audio_driver->data, nframes, left, 0, 1, right, 0, 1);
+        synth = audio_driver->data;
     }
-    else
+
+    if(audio_driver->callback != NULL)
     {
-        fluid_audio_func_t callback = (audio_driver->callback != NULL) ? audio_driver->callback : (fluid_audio_func_t) fluid_synth_process;
+        /* the callback mixes into the buffers */
+        for(i = 0; i < audio_driver->num_output_ports * 2; i++)
+        {
+            FLUID_MEMSET(jack_port_get_buffer(audio_driver->output_ports[i], nframes), 0, nframes * sizeof(float));
+        }
 
-        for(i = 0; i < audio_driver->num_output_ports; i++)
+        for(i = 0; i < audio_driver->num_fx_ports * 2; i++)
         {
-            int k = i * 2;
+            FLUID_MEMSET(jack_port_get_buffer(audio_driver->fx_ports[i], nframes), 0, nframes * sizeof(float));
+        }
+    }
 
-            audio_driver->output_bufs[k] = (float *)jack_port_get_buffer(audio_driver->output_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->output_bufs[k], 0, nframes * sizeof(float));
+    if(midi_driver == NULL)
+    {
+        return fluid_jack_driver_render(audio_driver, nframes, 0, nframes);
+    }
 
-            k = 2 * i + 1;
-            audio_driver->output_bufs[k] = (float *)jack_port_get_buffer(audio_driver->output_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->output_bufs[k], 0, nframes * sizeof(float));
-        }
+    /* Render the period block by block up to each MIDI event, so that the
+     * events take effect at their timestamp rather than at the beginning of
+     * the period. Voices started by the synth of this driver even start at
+     * their exact frame inside of the block. */
+    for(pos = 0; pos < nframes; pos += len)
+    {
+        /* the frames rendered already come first */
+        block = pos + ((synth != NULL) ? fluid_synth_get_buffered_frames(synth) : 0);
 
-        for(i = 0; i < audio_driver->num_fx_ports; i++)
+        if(block >= nframes)
         {
-            int k = i * 2;
+            next = fluid_jack_midi_dispatch(midi_driver, NULL, 0, nframes, nframes);
+        }
+        else
+        {
+            next = fluid_jack_midi_dispatch(midi_driver, synth, block, block + FLUID_BUFSIZE, nframes);
+        }
 
-            audio_driver->fx_bufs[k] = (float *) jack_port_get_buffer(audio_driver->fx_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->fx_bufs[k], 0, nframes * sizeof(float));
+        /* up to the block of the next event */
+        len = (next < nframes) ? block + (next - block) / FLUID_BUFSIZE * FLUID_BUFSIZE - pos : nframes - pos;
 
-            k = 2 * i + 1;
-            audio_driver->fx_bufs[k] = (float *) jack_port_get_buffer(audio_driver->fx_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->fx_bufs[k], 0, nframes * sizeof(float));
+        if(fluid_jack_driver_render(audio_driver, nframes, pos, len) != FLUID_OK)
+        {
+            return FLUID_FAILED;
         }
-
-        return callback(audio_driver->data,
-                        nframes,
-                        audio_driver->num_fx_ports * 2,
-                        audio_driver->fx_bufs,
-                        audio_driver->num_output_ports * 2,
-                        audio_driver->output_bufs);
     }
+
+    return FLUID_OK;
+}
+
+int
+fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
+{
+    int result;
+    fluid_trace_ref_var(trace_ref);
+
+    result = fluid_jack_driver_process_cycle(nframes, arg);
+    fluid_trace("jack_process", trace_ref);
+
+    return result;
 }
 
 int
@@ -798,8 +1035,28 @@ fluid_jack_driver_bufsize(jack_nframes_t nframes, void *arg)
 int
 fluid_jack_driver_srate(jack_nframes_t nframes, void *arg)
 {
-    /*   printf("the sample rate is now %lu/sec\n", nframes); */
-    /* FIXME: change the sample rate of the synthesizer! */
+    fluid_jack_client_t *client_ref = (fluid_jack_client_t *)arg;
+    fluid_jack_audio_driver_t *dev = fluid_atomic_pointer_get(&client_ref->audio_driver);
+
+    if(dev == NULL)
+    {
+        return 0;
+    }
+
+    /* without a callback of its own, the driver renders the synth directly */
+    if(dev->callback == NULL)
+    {
+        FLUID_LOG(FLUID_INFO, "Jack sample rate is now %lu", (unsigned long)nframes);
+
+        /* the effects units are allocated here, rather than in the process callback */
+        fluid_synth_set_sample_rate(dev->data, (float)nframes);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_WARN, "Jack sample rate is now %lu, unable to adjust the synth rendered by"
+                  " the callback of new_fluid_audio_driver2()", (unsigned long)nframes);
+    }
+
     return 0;
 }
 
@@ -893,6 +1150,8 @@ delete_fluid_jack_midi_driver(fluid_midi_driver_t *p)
 
     delete_fluid_midi_parser(dev->parser);
     FLUID_FREE(dev->midi_port);
+    FLUID_FREE(dev->midi_buffer);
+    FLUID_FREE(dev->midi_event_index);
     FLUID_FREE(dev);
 }
 
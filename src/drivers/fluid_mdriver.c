@@ -20,6 +20,15 @@
 
 #include "fluid_mdriver.h"
 #include "fluid_settings.h"
+#include "fluid_midi_router.h"
+#include "fluid_synth.h"
+#include "fluid_mpsc_queue.h"
+
+/* The most timestamped events waiting for their frame, see midi.timestamp-latency */
+#define FLUID_MIDI_SYNC_EVENTS 1024
+
+/* Ticks the sample timer of the sync waits for events, unless woken up by the driver */
+#define FLUID_MIDI_SYNC_IDLE_TICKS 0x40000000
 
 
 /*
@@ -33,8 +42,37 @@ struct _fluid_mdriver_definition_t
                                 void *event_handler_data);
     void (*free)(fluid_midi_driver_t *p);
     void (*settings)(fluid_settings_t *settings);
+    int sample_accurate;   /* the driver places the events at their frame itself */
 };
 
+/* An event waiting for its frame */
+typedef struct
+{
+    double usec;                    /* the time by fluid_utime() to play the event at */
+    fluid_midi_event_t event;
+} fluid_midi_sync_event_t;
+
+/*
+ * Plays the events received by a MIDI driver at the frame of the audio rendered
+ * by the synth matching the time they were received at, delayed by
+ * midi.timestamp-latency, instead of at the start of the next block. It takes
+ * the place of the handler of the driver, which is called by the rendering.
+ */
+typedef struct
+{
+    fluid_synth_t *synth;
+    handle_midi_event_func_t handler;   /* the handler of the driver */
+    void *data;
+    double latency;                     /* in microseconds */
+    fluid_mpsc_queue_t *queue;          /* events on their way from the driver to the rendering */
+    fluid_sample_timer_t *timer;
+
+    /* the events taken from the queue by the rendering, by their time */
+    fluid_midi_sync_event_t pending[FLUID_MIDI_SYNC_EVENTS];
+    int first;
+    int count;
+} fluid_midi_sync_t;
+
 
 static const fluid_mdriver_definition_t fluid_midi_drivers[] =
 {
@@ -43,13 +81,15 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         "alsa_seq",
         new_fluid_alsa_seq_driver,
         delete_fluid_alsa_seq_driver,
-        fluid_alsa_seq_driver_settings
+        fluid_alsa_seq_driver_settings,
+        FALSE
     },
     {
         "alsa_raw",
         new_fluid_alsa_rawmidi_driver,
         delete_fluid_alsa_rawmidi_driver,
-        fluid_alsa_rawmidi_driver_settings
+        fluid_alsa_rawmidi_driver_settings,
+        FALSE
     },
 #endif
 #if JACK_SUPPORT
@@ -57,7 +97,17 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         "jack",
         new_fluid_jack_midi_driver,
         delete_fluid_jack_midi_driver,
-        fluid_jack_midi_driver_settings
+        fluid_jack_midi_driver_settings,
+        TRUE
+    },
+#endif
+#if PIPEWIRE_SUPPORT
+    {
+        "pipewire",
+        new_fluid_pipewire_midi_driver,
+        delete_fluid_pipewire_midi_driver,
+        fluid_pipewire_midi_driver_settings,
+        TRUE
     },
 #endif
 #if OSS_SUPPORT
@@ -65,7 +115,8 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         "oss",
         new_fluid_oss_midi_driver,
         delete_fluid_oss_midi_driver,
-        fluid_oss_midi_driver_settings
+        fluid_oss_midi_driver_settings,
+        FALSE
     },
 #endif
 #if WINMIDI_SUPPORT
@@ -73,7 +124,8 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         "winmidi",
         new_fluid_winmidi_driver,
         delete_fluid_winmidi_driver,
-        fluid_winmidi_midi_driver_settings
+        fluid_winmidi_midi_driver_settings,
+        FALSE
     },
 #endif
 #if MIDISHARE_SUPPORT
@@ -81,7 +133,8 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         "midishare",
         new_fluid_midishare_midi_driver,
         delete_fluid_midishare_midi_driver,
-        NULL
+        NULL,
+        FALSE
     },
 #endif
 #if COREMIDI_SUPPORT
@@ -89,14 +142,230 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         "coremidi",
         new_fluid_coremidi_driver,
         delete_fluid_coremidi_driver,
-        fluid_coremidi_driver_settings
+        fluid_coremidi_driver_settings,
+        FALSE
+    },
+#endif
+#ifdef NETWORK_SUPPORT
+    {
+        "udp",
+        new_fluid_udp_midi_driver,
+        delete_fluid_udp_midi_driver,
+        fluid_udp_midi_driver_settings,
+        FALSE
     },
 #endif
     /* NULL terminator to avoid zero size array if no driver available */
-    { NULL, NULL, NULL, NULL }
+    { NULL, NULL, NULL, NULL, FALSE }
 };
 
 
+/* Plays an event right away, at the start of the next block */
+static int
+fluid_midi_sync_handle_now(fluid_midi_sync_t *sync, fluid_midi_event_t *event)
+{
+    return sync->handler(sync->data, event);
+}
+
+/* Queues an event received at the given time for the rendering, called by the driver */
+static int
+fluid_midi_sync_push(fluid_midi_sync_t *sync, fluid_midi_event_t *event, double usec)
+{
+    fluid_midi_sync_event_t entry;
+
+    /* the data of a SysEx message stays in the buffers of the driver, which may reuse them right away */
+    if(event->type == MIDI_SYSEX)
+    {
+        return fluid_midi_sync_handle_now(sync, event);
+    }
+
+    entry.usec = usec + sync->latency;
+    entry.event = *event;
+
+    if(fluid_mpsc_queue_push(sync->queue, &entry) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_WARN, "Too many timestamped MIDI events, playing one right away");
+        return fluid_midi_sync_handle_now(sync, event);
+    }
+
+    fluid_sample_timer_wakeup(sync->synth, sync->timer);
+
+    return FLUID_OK;
+}
+
+/* The handler of the driver, for the events it doesn't timestamp itself */
+static int
+fluid_midi_sync_handle_event(void *data, fluid_midi_event_t *event)
+{
+    return fluid_midi_sync_push(data, event, fluid_utime());
+}
+
+/* Sorts an event taken from the queue in by its time, called by the rendering */
+static void
+fluid_midi_sync_insert(fluid_midi_sync_t *sync, const fluid_midi_sync_event_t *entry)
+{
+    int i;
+
+    if(sync->count == FLUID_MIDI_SYNC_EVENTS)
+    {
+        if(sync->first == 0)
+        {
+            /* no room left, play the earliest event right away */
+            fluid_synth_handle_midi_event_offset(sync->synth, sync->handler, sync->data,
+                                                 &sync->pending[0].event, 0);
+            sync->first = 1;
+        }
+
+        sync->count -= sync->first;
+        FLUID_MEMMOVE(sync->pending, sync->pending + sync->first, sync->count * sizeof(*entry));
+        sync->first = 0;
+    }
+
+    /* the events of a driver mostly arrive in order, events of the same time stay in order */
+    for(i = sync->count; i > sync->first && sync->pending[i - 1].usec > entry->usec; i--)
+    {
+        sync->pending[i] = sync->pending[i - 1];
+    }
+
+    sync->pending[i] = *entry;
+    sync->count++;
+}
+
+/*
+ * The sample timer playing the events due in the block about to be rendered at
+ * their frame, called by the rendering. It is due again with the block of the
+ * next event, or as soon as the driver queues another one.
+ */
+static int
+fluid_midi_sync_callback(void *data, unsigned int msec)
+{
+    fluid_midi_sync_t *sync = data;
+    fluid_midi_sync_event_t entry;
+    int offset;
+
+    while(fluid_mpsc_queue_pop(sync->queue, &entry) == FLUID_OK)
+    {
+        fluid_midi_sync_insert(sync, &entry);
+    }
+
+    for(; sync->first < sync->count; sync->first++)
+    {
+        fluid_midi_sync_event_t *next = &sync->pending[sync->first];
+
+        offset = fluid_synth_utime_to_offset(sync->synth, next->usec);
+
+        if(offset >= FLUID_BUFSIZE)
+        {
+            fluid_sample_timer_set_due(sync->synth, sync->timer,
+                                       fluid_sample_timer_get_ticks(sync->synth, sync->timer) + offset);
+            return 1;
+        }
+
+        /* events arriving too late for their frame are played at the start of the block */
+        fluid_synth_handle_midi_event_offset(sync->synth, sync->handler, sync->data,
+                                             &next->event, (offset > 0) ? offset : 0);
+    }
+
+    sync->first = sync->count = 0;
+    fluid_sample_timer_set_due(sync->synth, sync->timer,
+                               fluid_sample_timer_get_ticks(sync->synth, sync->timer) + FLUID_MIDI_SYNC_IDLE_TICKS);
+
+    return 1;
+}
+
+static void
+delete_fluid_midi_sync(fluid_midi_sync_t *sync)
+{
+    fluid_midi_sync_event_t entry;
+    fluid_return_if_fail(sync != NULL);
+
+    if(sync->timer != NULL)
+    {
+        delete_fluid_sample_timer(sync->synth, sync->timer);
+    }
+
+    if(sync->queue != NULL)
+    {
+        /* the events not played yet, e.g. note-offs, aren't dropped */
+        while(fluid_mpsc_queue_pop(sync->queue, &entry) == FLUID_OK)
+        {
+            fluid_midi_sync_insert(sync, &entry);
+        }
+
+        for(; sync->first < sync->count; sync->first++)
+        {
+            fluid_midi_sync_handle_now(sync, &sync->pending[sync->first].event);
+        }
+
+        delete_fluid_mpsc_queue(sync->queue);
+        fluid_synth_use_clock(sync->synth, FALSE);
+    }
+
+    FLUID_FREE(sync);
+}
+
+/*
+ * Creates the sync for the handler of a driver, if it ends at a synth.
+ * Returns NULL otherwise, and if out of memory, the events are then handled
+ * as they arrive.
+ */
+static fluid_midi_sync_t *
+new_fluid_midi_sync(handle_midi_event_func_t handler, void *data, int latency_msec)
+{
+    fluid_midi_sync_t *sync;
+    fluid_synth_t *synth = NULL;
+
+    if(handler == fluid_synth_handle_midi_event)
+    {
+        synth = data;
+    }
+    else if(handler == fluid_midi_router_handle_midi_event)
+    {
+        synth = fluid_midi_router_get_synth(data);
+    }
+
+    if(synth == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "midi.timestamp-latency only applies to MIDI drivers sending their events to a synth");
+        return NULL;
+    }
+
+    sync = FLUID_NEW(fluid_midi_sync_t);
+
+    if(sync == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(sync, 0, sizeof(*sync));
+    sync->synth = synth;
+    sync->handler = handler;
+    sync->data = data;
+    sync->latency = latency_msec * 1000.0;
+
+    sync->queue = new_fluid_mpsc_queue(FLUID_MIDI_SYNC_EVENTS, sizeof(fluid_midi_sync_event_t));
+
+    if(sync->queue == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(sync);
+        return NULL;
+    }
+
+    fluid_synth_use_clock(synth, TRUE);
+    sync->timer = new_fluid_sample_timer(synth, fluid_midi_sync_callback, sync);
+
+    if(sync->timer == NULL)
+    {
+        delete_fluid_midi_sync(sync);
+        return NULL;
+    }
+
+    return sync;
+}
+
+
 void fluid_midi_driver_settings(fluid_settings_t *settings)
 {
     unsigned int i;
@@ -109,10 +378,12 @@ void fluid_midi_driver_settings(fluid_settings_t *settings)
     
     fluid_settings_register_str(settings, "midi.driver", "", 0);
 
+    fluid_settings_register_int(settings, "midi.timestamp-latency", 0, 0, 1000, 0);
+
     for(i = 0; i < FLUID_N_ELEMENTS(fluid_midi_drivers) - 1; i++)
     {
-        /* Select the default driver */
-        if (def_name == NULL)
+        /* Select the default driver, never one listening to the network */
+        if (def_name == NULL && FLUID_STRCMP(fluid_midi_drivers[i].name, "udp") != 0)
         {
             def_name = fluid_midi_drivers[i].name;
         }
@@ -144,20 +415,42 @@ void fluid_midi_driver_settings(fluid_settings_t *settings)
 fluid_midi_driver_t *new_fluid_midi_driver(fluid_settings_t *settings, handle_midi_event_func_t handler, void *event_handler_data)
 {
     fluid_midi_driver_t *driver = NULL;
+    fluid_midi_sync_t *sync = NULL;
     char *allnames;
     const fluid_mdriver_definition_t *def;
+    int latency = 0;
 
     for(def = fluid_midi_drivers; def->name != NULL; def++)
     {
         if(fluid_settings_str_equal(settings, "midi.driver", def->name))
         {
             FLUID_LOG(FLUID_DBG, "Using '%s' midi driver", def->name);
-            driver = def->new(settings, handler, event_handler_data);
+
+            /* the drivers passing their events to the rendering at their frame themselves don't need a sync */
+            fluid_settings_getint(settings, "midi.timestamp-latency", &latency);
+
+            if(latency > 0 && !def->sample_accurate)
+            {
+                sync = new_fluid_midi_sync(handler, event_handler_data, latency);
+            }
+
+            if(sync != NULL)
+            {
+                driver = def->new(settings, fluid_midi_sync_handle_event, sync);
+            }
+            else
+            {
+                driver = def->new(settings, handler, event_handler_data);
+            }
 
             if(driver)
             {
                 driver->define = def;
             }
+            else
+            {
+                delete_fluid_midi_sync(sync);
+            }
 
             return driver;
         }
@@ -188,6 +481,83 @@ fluid_midi_driver_t *new_fluid_midi_driver(fluid_settings_t *settings, handle_mi
  */
 void delete_fluid_midi_driver(fluid_midi_driver_t *driver)
 {
+    fluid_midi_sync_t *sync;
+
     fluid_return_if_fail(driver != NULL);
+
+    sync = (driver->handler == fluid_midi_sync_handle_event) ? driver->data : NULL;
     driver->define->free(driver);
+
+    /* once the driver has stopped queuing events */
+    delete_fluid_midi_sync(sync);
+}
+
+/*
+ * Pass a MIDI event received at the given time by fluid_utime() to the handler
+ * of a driver, for the drivers timestamping their events. Without
+ * midi.timestamp-latency, the time is ignored and the event played at the
+ * start of the next block.
+ */
+int fluid_midi_driver_handle_event_at(fluid_midi_driver_t *driver, fluid_midi_event_t *event, double usec)
+{
+    if(driver->handler == fluid_midi_sync_handle_event)
+    {
+        return fluid_midi_sync_push(driver->data, event, usec);
+    }
+
+    return driver->handler(driver->data, event);
+}
+
+/*
+ * Whether the events passed to the handler of a driver are played at the
+ * frames matching their time, and thus needn't be held back by the driver
+ * until then.
+ */
+int fluid_midi_driver_schedules_events(fluid_midi_driver_t *driver)
+{
+    return driver->handler == fluid_midi_sync_handle_event;
+}
+
+/*
+ * Pass a batch of MIDI events to the handler of a driver. If they end at a
+ * synth, directly or through a MIDI router, its API is entered once for the
+ * whole batch. The times of the events by fluid_utime() are only used with
+ * midi.timestamp-latency, NULL for the events received just now.
+ */
+int fluid_midi_driver_handle_events(fluid_midi_driver_t *driver, fluid_midi_event_t **events,
+                                    const double *usecs, int n)
+{
+    int i, result = FLUID_OK;
+
+    if(driver->handler == fluid_midi_sync_handle_event)
+    {
+        double now = fluid_utime();
+
+        for(i = 0; i < n; i++)
+        {
+            fluid_midi_sync_push(driver->data, events[i], (usecs != NULL) ? usecs[i] : now);
+        }
+
+        return FLUID_OK;
+    }
+
+    if(driver->handler == fluid_synth_handle_midi_event)
+    {
+        return fluid_synth_handle_midi_events(driver->data, events, n);
+    }
+
+    if(driver->handler == fluid_midi_router_handle_midi_event)
+    {
+        return fluid_midi_router_handle_midi_events(driver->data, events, n);
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        if(driver->handler(driver->data, events[i]) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    return result;
 }
@@ -37,6 +37,10 @@ struct _fluid_midi_driver_t
 };
 
 void fluid_midi_driver_settings(fluid_settings_t *settings);
+int fluid_midi_driver_handle_events(fluid_midi_driver_t *driver, fluid_midi_event_t **events,
+                                    const double *usecs, int n);
+int fluid_midi_driver_handle_event_at(fluid_midi_driver_t *driver, fluid_midi_event_t *event, double usec);
+int fluid_midi_driver_schedules_events(fluid_midi_driver_t *driver);
 
 /* ALSA */
 #if ALSA_SUPPORT
@@ -62,6 +66,15 @@ fluid_midi_driver_t *new_fluid_jack_midi_driver(fluid_settings_t *settings,
 void delete_fluid_jack_midi_driver(fluid_midi_driver_t *p);
 #endif
 
+/* PipeWire */
+#if PIPEWIRE_SUPPORT
+void fluid_pipewire_midi_driver_settings(fluid_settings_t *settings);
+fluid_midi_driver_t *new_fluid_pipewire_midi_driver(fluid_settings_t *settings,
+        handle_midi_event_func_t handler,
+        void *data);
+void delete_fluid_pipewire_midi_driver(fluid_midi_driver_t *p);
+#endif
+
 /* OSS */
 #if OSS_SUPPORT
 fluid_midi_driver_t *new_fluid_oss_midi_driver(fluid_settings_t *settings,
@@ -97,4 +110,13 @@ void delete_fluid_coremidi_driver(fluid_midi_driver_t *p);
 void fluid_coremidi_driver_settings(fluid_settings_t *settings);
 #endif
 
+/* definitions for the UDP and RTP-MIDI network driver */
+#ifdef NETWORK_SUPPORT
+fluid_midi_driver_t *new_fluid_udp_midi_driver(fluid_settings_t *settings,
+        handle_midi_event_func_t handler,
+        void *event_handler_data);
+void delete_fluid_udp_midi_driver(fluid_midi_driver_t *p);
+void fluid_udp_midi_driver_settings(fluid_settings_t *settings);
+#endif
+
 #endif  /* _FLUID_AUDRIVER_H */
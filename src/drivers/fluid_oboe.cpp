@@ -51,6 +51,8 @@ typedef struct
     fluid_audio_driver_t driver;
     fluid_synth_t *synth;
     int cont;
+    int low_latency;        /* audio.oboe.low-latency */
+    int32_t max_frames;     /* most frames asked for by a callback */
     OboeAudioStreamCallback *oboe_callback;
     AudioStream *stream;
 } fluid_oboe_audio_driver_t;
@@ -74,6 +76,11 @@ public:
             return DataCallbackResult::Stop;
         }
 
+        if(numFrames > dev->max_frames)
+        {
+            dev->max_frames = numFrames;
+        }
+
         if(stream->getFormat() == AudioFormat::Float)
         {
             fluid_synth_write_float(dev->synth, numFrames, static_cast<float *>(audioData), 0, 2, static_cast<float *>(audioData), 1, 2);
@@ -102,6 +109,26 @@ void fluid_oboe_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings,   "audio.oboe.performance-mode", "None");
     fluid_settings_add_option(settings,   "audio.oboe.performance-mode", "PowerSaving");
     fluid_settings_add_option(settings,   "audio.oboe.performance-mode", "LowLatency");
+
+    fluid_settings_register_int(settings, "audio.oboe.low-latency", 0, 0, 1, FLUID_HINT_TOGGLED);
+}
+
+/*
+ * The frames of a callback in the low latency mode: the burst of the device,
+ * rounded up to whole blocks of the synth, so that every callback renders the
+ * same number of blocks, without any left over for the next one.
+ */
+static int32_t
+fluid_oboe_low_latency_frames()
+{
+    int32_t burst = DefaultStreamValues::FramesPerBurst;
+
+    if(burst <= 0)
+    {
+        burst = FLUID_BUFSIZE;
+    }
+
+    return (burst + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE * FLUID_BUFSIZE;
 }
 
 
@@ -155,6 +182,15 @@ new_fluid_oboe_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
         performance_mode =
             fluid_settings_str_equal(settings, "audio.oboe.performance-mode", "PowerSaving") ? 1 :
             fluid_settings_str_equal(settings, "audio.oboe.performance-mode", "LowLatency") ? 2 : 0;
+        fluid_settings_getint(settings, "audio.oboe.low-latency", &dev->low_latency);
+
+        if(dev->low_latency)
+        {
+            /* an exclusive MMAP stream if the device has one, Oboe falls back to a shared one else */
+            sharing_mode = 1;
+            performance_mode = 2;
+            period_frames = fluid_oboe_low_latency_frames();
+        }
 
         builder->setDeviceId(device_id)
         ->setDirection(Direction::Output)
@@ -180,6 +216,17 @@ new_fluid_oboe_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
         dev->cont = 1;
 
+        if(dev->low_latency)
+        {
+            /* the least buffering that doesn't underrun right away: two bursts */
+            stream->setBufferSizeInFrames(2 * stream->getFramesPerBurst());
+
+            FLUID_LOG(FLUID_INFO, "Oboe low latency stream: %s sharing, burst of %d frames, %d frames per callback, buffer of %d frames",
+                      stream->getSharingMode() == SharingMode::Exclusive ? "exclusive" : "shared",
+                      stream->getFramesPerBurst(), stream->getFramesPerCallback(),
+                      stream->getBufferSizeInFrames());
+        }
+
         FLUID_LOG(FLUID_INFO, "Using Oboe driver");
 
         stream->start();
@@ -211,6 +258,16 @@ void delete_fluid_oboe_audio_driver(fluid_audio_driver_t *p)
         if(dev->stream != NULL)
         {
             dev->stream->stop();
+
+            if(dev->low_latency)
+            {
+                ResultWithValue<int32_t> xruns = dev->stream->getXRunCount();
+
+                FLUID_LOG(FLUID_INFO, "Oboe low latency stream: burst of %d frames, at most %d frames per callback, %d underruns",
+                          dev->stream->getFramesPerBurst(), dev->max_frames,
+                          xruns ? xruns.value() : -1);
+            }
+
             dev->stream->close();
         }
     }
@@ -732,9 +732,9 @@ fluid_thread_return_t
 fluid_oss_midi_run(void *d)
 {
     fluid_oss_midi_driver_t *dev = (fluid_oss_midi_driver_t *) d;
-    fluid_midi_event_t *evt;
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
     struct pollfd fds;
-    int n, i;
+    int n, i, k, count, consumed;
 
     /* go into a loop until someone tells us to stop */
     dev->status = FLUID_MIDI_LISTENING;
@@ -775,14 +775,15 @@ fluid_oss_midi_run(void *d)
         }
 
         /* let the parser convert the data into events */
-        for(i = 0; i < n; i++)
+        for(i = 0; i < n; i += consumed)
         {
-            evt = fluid_midi_parser_parse(dev->parser, dev->buffer[i]);
+            count = fluid_midi_parser_parse_buffer(dev->parser, dev->buffer + i, n - i,
+                                                   events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
 
-            if(evt != NULL)
+            for(k = 0; k < count; k++)
             {
                 /* send the event to the next link in the chain */
-                (*dev->driver.handler)(dev->driver.data, evt);
+                (*dev->driver.handler)(dev->driver.data, &events[k]);
             }
         }
     }
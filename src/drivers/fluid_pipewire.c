@@ -0,0 +1,808 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/* fluid_pipewire.c
+ *
+ * Audio and MIDI driver for PipeWire.
+ *
+ * The drivers are a filter node of the PipeWire graph, with a DSP port
+ * for every audio channel and a port receiving MIDI as a sequence of
+ * controls timestamped by frame. An audio and a MIDI driver created one
+ * after the other share the same node, so that the MIDI events are
+ * dispatched at their frame of the period rendered, like by the JACK
+ * drivers.
+ */
+
+#include "fluid_synth.h"
+#include "fluid_adriver.h"
+#include "fluid_mdriver.h"
+#include "fluid_settings.h"
+#include "fluid_trace.h"
+
+#if PIPEWIRE_SUPPORT
+
+#include <pipewire/pipewire.h>
+#include <pipewire/filter.h>
+#include <spa/pod/iter.h>
+#include <spa/control/control.h>
+
+/* Periods longer than this are rendered as silence, the default maximum quantum of PipeWire */
+#define FLUID_PIPEWIRE_MAX_FRAMES 8192
+
+typedef struct _fluid_pipewire_audio_driver_t fluid_pipewire_audio_driver_t;
+typedef struct _fluid_pipewire_midi_driver_t fluid_pipewire_midi_driver_t;
+
+/* Nodes are shared by an audio and a MIDI driver created one after the other. */
+typedef struct
+{
+    struct pw_thread_loop *loop;
+    struct pw_filter *filter;
+    fluid_pipewire_audio_driver_t *audio_driver;
+    fluid_pipewire_midi_driver_t *midi_driver;
+} fluid_pipewire_node_t;
+
+/* PipeWire audio driver instance */
+struct _fluid_pipewire_audio_driver_t
+{
+    fluid_audio_driver_t driver;
+    fluid_pipewire_node_t *node;
+
+    void **output_ports;
+    int num_output_ports;
+    float **output_bufs;
+
+    void **fx_ports;
+    int num_fx_ports;
+    float **fx_bufs;
+
+    float *scratch;                 /* rendered into for the ports without buffer */
+
+    fluid_audio_func_t callback;
+    void *data;
+};
+
+/* PipeWire MIDI driver instance */
+struct _fluid_pipewire_midi_driver_t
+{
+    fluid_midi_driver_t driver;
+    fluid_pipewire_node_t *node;
+    void *port;
+    struct pw_buffer *buffer;           /* the buffer of the port for the current period */
+    struct spa_pod_sequence *sequence;  /* the MIDI events of the period, NULL if none */
+    struct spa_pod_control *control;    /* the next event of the sequence to dispatch */
+    fluid_midi_parser_t *parser;
+};
+
+static fluid_pipewire_node_t *new_fluid_pipewire_node(fluid_settings_t *settings,
+        int isaudio, void *driver);
+static void fluid_pipewire_node_close(fluid_pipewire_node_t *node, void *driver);
+static int fluid_pipewire_node_add_ports(void *driver, int isaudio, struct pw_filter *filter,
+        fluid_settings_t *settings);
+static void fluid_pipewire_process(void *data, struct spa_io_position *position);
+
+static const struct pw_filter_events fluid_pipewire_filter_events =
+{
+    PW_VERSION_FILTER_EVENTS,
+    .process = fluid_pipewire_process,
+};
+
+static fluid_mutex_t last_node_mutex = FLUID_MUTEX_INIT;    /* drivers may be created by multiple threads */
+static fluid_pipewire_node_t *last_node = NULL;              /* Last unpaired node. For audio/MIDI driver pairing. */
+
+
+void
+fluid_pipewire_audio_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_str(settings, "audio.pipewire.id", "fluidsynth", 0);
+    fluid_settings_register_str(settings, "audio.pipewire.media-role", "Music", 0);
+    fluid_settings_register_int(settings, "audio.pipewire.multi", 0, 0, 1, FLUID_HINT_TOGGLED);
+}
+
+void
+fluid_pipewire_midi_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_str(settings, "midi.pipewire.id", "fluidsynth-midi", 0);
+}
+
+/*
+ * Create a PipeWire node as necessary, share the node of the last driver of the other type.
+ * @param settings Settings object
+ * @param isaudio TRUE if audio driver, FALSE if MIDI
+ * @param driver fluid_pipewire_audio_driver_t or fluid_pipewire_midi_driver_t
+ * @return New or paired Audio/MIDI node
+ */
+static fluid_pipewire_node_t *
+new_fluid_pipewire_node(fluid_settings_t *settings, int isaudio, void *driver)
+{
+    fluid_pipewire_node_t *node = NULL;
+    struct pw_properties *props;
+    char *node_name = NULL;
+    char *media_role = NULL;
+    char latency[32], rate[32];
+    double sample_rate;
+    int period_size;
+
+    fluid_mutex_lock(last_node_mutex);      /* ++ lock last_node */
+
+    /* If the last node is not of the same type (audio or MIDI), then re-use it. */
+    if(last_node &&
+            ((!isaudio && last_node->midi_driver == NULL) || (isaudio && last_node->audio_driver == NULL)))
+    {
+        struct pw_thread_loop *loop = last_node->loop;
+
+        node = last_node;
+
+        /* ports can be added to a running filter, while holding the lock of its loop */
+        pw_thread_loop_lock(loop);
+
+        if(fluid_pipewire_node_add_ports(driver, isaudio, node->filter, settings) == FLUID_OK)
+        {
+            last_node = NULL; /* No more pairing for this node */
+
+            if(isaudio)
+            {
+                fluid_atomic_pointer_set(&node->audio_driver, driver);
+            }
+            else
+            {
+                fluid_atomic_pointer_set(&node->midi_driver, driver);
+            }
+        }
+        else
+        {
+            /* the node is used by the other driver, don't free it */
+            node = NULL;
+        }
+
+        pw_thread_loop_unlock(loop);
+        fluid_mutex_unlock(last_node_mutex);        /* -- unlock last_node */
+
+        return node;
+    }
+
+    node = FLUID_NEW(fluid_pipewire_node_t);
+
+    if(node == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(node, 0, sizeof(fluid_pipewire_node_t));
+
+    pw_init(NULL, NULL);
+
+    node->loop = pw_thread_loop_new("fluidsynth-pipewire", NULL);
+
+    if(node->loop == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the PipeWire thread loop");
+        goto error_recovery;
+    }
+
+    fluid_settings_dupstr(settings, isaudio ? "audio.pipewire.id"    /* ++ alloc node name */
+                          : "midi.pipewire.id", &node_name);
+    fluid_settings_dupstr(settings, "audio.pipewire.media-role", &media_role);  /* ++ alloc media role */
+    fluid_settings_getint(settings, "audio.period-size", &period_size);
+    fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
+
+    /* ask the graph for the period size and sample rate of the synth */
+    FLUID_SNPRINTF(latency, sizeof(latency), "%d/%d", period_size, (int)sample_rate);
+    FLUID_SNPRINTF(rate, sizeof(rate), "1/%d", (int)sample_rate);
+
+    props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio",
+                              PW_KEY_MEDIA_CATEGORY, "Playback",
+                              PW_KEY_MEDIA_ROLE, (media_role != NULL && media_role[0] != '\0') ? media_role : "Music",
+                              PW_KEY_NODE_LATENCY, latency,
+                              "node.rate", rate,
+                              NULL);
+
+    node->filter = pw_filter_new_simple(pw_thread_loop_get_loop(node->loop),
+                                        (node_name != NULL && node_name[0] != '\0') ? node_name : "fluidsynth",
+                                        props, &fluid_pipewire_filter_events, node);
+
+    FLUID_FREE(node_name);     /* -- free node name */
+    FLUID_FREE(media_role);    /* -- free media role */
+
+    if(node->filter == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the PipeWire filter node");
+        goto error_recovery;
+    }
+
+    if(fluid_pipewire_node_add_ports(driver, isaudio, node->filter, settings) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    if(isaudio)
+    {
+        fluid_atomic_pointer_set(&node->audio_driver, driver);
+    }
+    else
+    {
+        fluid_atomic_pointer_set(&node->midi_driver, driver);
+    }
+
+    /* process the periods in the realtime thread of the graph */
+    if(pw_filter_connect(node->filter, PW_FILTER_FLAG_RT_PROCESS, NULL, 0) < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to connect the PipeWire filter node");
+        goto error_recovery;
+    }
+
+    if(pw_thread_loop_start(node->loop) < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to start the PipeWire thread loop");
+        goto error_recovery;
+    }
+
+    last_node = node;
+
+    fluid_mutex_unlock(last_node_mutex);        /* -- unlock last_node */
+
+    return node;
+
+error_recovery:
+
+    fluid_mutex_unlock(last_node_mutex);        /* -- unlock last_node */
+
+    if(node)
+    {
+        if(node->filter)
+        {
+            pw_filter_destroy(node->filter);
+        }
+
+        if(node->loop)
+        {
+            pw_thread_loop_destroy(node->loop);
+        }
+
+        pw_deinit();
+        FLUID_FREE(node);
+    }
+
+    return NULL;
+}
+
+/* Add a DSP port to the filter, returns its handle or NULL */
+static void *
+fluid_pipewire_add_port(struct pw_filter *filter, enum pw_direction direction,
+                        const char *format, const char *name)
+{
+    void *port = pw_filter_add_port(filter, direction, PW_FILTER_PORT_FLAG_MAP_BUFFERS, 0,
+                                    pw_properties_new(PW_KEY_FORMAT_DSP, format,
+                                            PW_KEY_PORT_NAME, name,
+                                            NULL),
+                                    NULL, 0);
+
+    if(port == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create PipeWire port '%s'", name);
+    }
+
+    return port;
+}
+
+static int
+fluid_pipewire_node_add_ports(void *driver, int isaudio, struct pw_filter *filter,
+                              fluid_settings_t *settings)
+{
+    fluid_pipewire_audio_driver_t *dev;
+    char name[64];
+    int multi;
+    int i;
+
+    if(!isaudio)
+    {
+        fluid_pipewire_midi_driver_t *dev = driver;
+
+        dev->port = fluid_pipewire_add_port(filter, PW_DIRECTION_INPUT, "8 bit raw midi", "midi_in");
+
+        return (dev->port != NULL) ? FLUID_OK : FLUID_FAILED;
+    }
+
+    dev = driver;
+
+    fluid_settings_getint(settings, "audio.pipewire.multi", &multi);
+
+    if(!multi)
+    {
+        /* the two audio output ports */
+        dev->num_output_ports = 1;
+        dev->num_fx_ports = 0;
+    }
+    else
+    {
+        /* a port for every channel */
+        fluid_settings_getint(settings, "synth.audio-channels", &dev->num_output_ports);
+        fluid_settings_getint(settings, "synth.effects-channels", &dev->num_fx_ports);
+        fluid_settings_getint(settings, "synth.effects-groups", &i);
+        dev->num_fx_ports *= i;
+    }
+
+    dev->output_ports = FLUID_ARRAY(void *, 2 * dev->num_output_ports);
+    dev->output_bufs = FLUID_ARRAY(float *, 2 * dev->num_output_ports);
+    dev->fx_ports = FLUID_ARRAY(void *, 2 * dev->num_fx_ports + 1);
+    dev->fx_bufs = FLUID_ARRAY(float *, 2 * dev->num_fx_ports + 1);
+    dev->scratch = FLUID_ARRAY(float, FLUID_PIPEWIRE_MAX_FRAMES);
+
+    if(dev->output_ports == NULL || dev->output_bufs == NULL || dev->fx_ports == NULL
+            || dev->fx_bufs == NULL || dev->scratch == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    if(!multi)
+    {
+        dev->output_ports[0] = fluid_pipewire_add_port(filter, PW_DIRECTION_OUTPUT,
+                               "32 bit float mono audio", "left");
+        dev->output_ports[1] = fluid_pipewire_add_port(filter, PW_DIRECTION_OUTPUT,
+                               "32 bit float mono audio", "right");
+
+        return (dev->output_ports[0] != NULL && dev->output_ports[1] != NULL) ? FLUID_OK : FLUID_FAILED;
+    }
+
+    for(i = 0; i < dev->num_output_ports; i++)
+    {
+        FLUID_SNPRINTF(name, sizeof(name), "l_%02d", i);
+
+        if((dev->output_ports[2 * i] = fluid_pipewire_add_port(filter, PW_DIRECTION_OUTPUT,
+                                       "32 bit float mono audio", name)) == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        FLUID_SNPRINTF(name, sizeof(name), "r_%02d", i);
+
+        if((dev->output_ports[2 * i + 1] = fluid_pipewire_add_port(filter, PW_DIRECTION_OUTPUT,
+                                           "32 bit float mono audio", name)) == NULL)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    for(i = 0; i < dev->num_fx_ports; i++)
+    {
+        FLUID_SNPRINTF(name, sizeof(name), "fx_l_%02d", i);
+
+        if((dev->fx_ports[2 * i] = fluid_pipewire_add_port(filter, PW_DIRECTION_OUTPUT,
+                                   "32 bit float mono audio", name)) == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        FLUID_SNPRINTF(name, sizeof(name), "fx_r_%02d", i);
+
+        if((dev->fx_ports[2 * i + 1] = fluid_pipewire_add_port(filter, PW_DIRECTION_OUTPUT,
+                                       "32 bit float mono audio", name)) == NULL)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+static void
+fluid_pipewire_node_close(fluid_pipewire_node_t *node, void *driver)
+{
+    if(node->audio_driver == driver)
+    {
+        fluid_atomic_pointer_set(&node->audio_driver, NULL);
+    }
+    else if(node->midi_driver == driver)
+    {
+        fluid_atomic_pointer_set(&node->midi_driver, NULL);
+    }
+
+    if(node->audio_driver || node->midi_driver)
+    {
+        fluid_msleep(100);  /* FIXME - same hack as the JACK driver: make sure that resources don't get freed while the process callback is active */
+        return;
+    }
+
+    fluid_mutex_lock(last_node_mutex);
+
+    if(node == last_node)
+    {
+        last_node = NULL;
+    }
+
+    fluid_mutex_unlock(last_node_mutex);
+
+    /* destroying the filter waits for its process callback to be done */
+    pw_thread_loop_lock(node->loop);
+    pw_filter_destroy(node->filter);
+    pw_thread_loop_unlock(node->loop);
+
+    pw_thread_loop_stop(node->loop);
+    pw_thread_loop_destroy(node->loop);
+    pw_deinit();
+
+    FLUID_FREE(node);
+}
+
+
+fluid_audio_driver_t *
+new_fluid_pipewire_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
+{
+    return new_fluid_pipewire_audio_driver2(settings, NULL, synth);
+}
+
+fluid_audio_driver_t *
+new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func, void *data)
+{
+    fluid_pipewire_audio_driver_t *dev;
+
+    dev = FLUID_NEW(fluid_pipewire_audio_driver_t);
+
+    if(dev == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(dev, 0, sizeof(fluid_pipewire_audio_driver_t));
+
+    dev->callback = func;
+    dev->data = data;
+
+    dev->node = new_fluid_pipewire_node(settings, TRUE, dev);
+
+    if(dev->node == NULL)
+    {
+        delete_fluid_pipewire_audio_driver((fluid_audio_driver_t *) dev);
+        return NULL;
+    }
+
+    FLUID_LOG(FLUID_INFO, "Using PipeWire driver");
+
+    return (fluid_audio_driver_t *) dev;
+}
+
+void
+delete_fluid_pipewire_audio_driver(fluid_audio_driver_t *p)
+{
+    fluid_pipewire_audio_driver_t *dev = (fluid_pipewire_audio_driver_t *) p;
+    fluid_return_if_fail(dev != NULL);
+
+    if(dev->node != NULL)
+    {
+        fluid_pipewire_node_close(dev->node, dev);
+    }
+
+    FLUID_FREE(dev->output_bufs);
+    FLUID_FREE(dev->output_ports);
+    FLUID_FREE(dev->fx_bufs);
+    FLUID_FREE(dev->fx_ports);
+    FLUID_FREE(dev->scratch);
+    FLUID_FREE(dev);
+}
+
+/* The next MIDI event of the period, or NULL */
+static struct spa_pod_control *
+fluid_pipewire_midi_peek(fluid_pipewire_midi_driver_t *dev)
+{
+    if(dev->sequence == NULL)
+    {
+        return NULL;
+    }
+
+    while(spa_pod_control_is_inside(&dev->sequence->body, SPA_POD_BODY_SIZE(dev->sequence), dev->control))
+    {
+        if(dev->control->type == SPA_CONTROL_Midi)
+        {
+            return dev->control;
+        }
+
+        dev->control = spa_pod_control_next(dev->control);
+    }
+
+    dev->sequence = NULL;
+    return NULL;
+}
+
+/*
+ * Dispatch the MIDI events due before frame end of the period. If synth is
+ * not NULL, the voices they start begin at their frame within the next block
+ * rendered, which starts at frame block of the period.
+ * Returns the frame of the earliest event still pending, or nframes.
+ */
+static uint32_t
+fluid_pipewire_midi_dispatch(fluid_pipewire_midi_driver_t *dev, fluid_synth_t *synth,
+                             uint32_t block, uint32_t end, uint32_t nframes)
+{
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
+    struct spa_pod_control *control;
+    const unsigned char *data;
+    uint32_t size, time, u;
+    int k, count, consumed;
+
+    while((control = fluid_pipewire_midi_peek(dev)) != NULL)
+    {
+        time = (control->offset < nframes) ? control->offset : nframes - 1;
+
+        if(time >= end)
+        {
+            return time;
+        }
+
+        dev->control = spa_pod_control_next(control);
+
+        data = SPA_POD_BODY(&control->value);
+        size = SPA_POD_BODY_SIZE(&control->value);
+
+        /* let the parser convert the data into events */
+        for(u = 0; u < size; u += consumed)
+        {
+            count = fluid_midi_parser_parse_buffer(dev->parser, data + u, (int)(size - u),
+                                                   events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
+
+            /* send the events to the next link in the chain */
+            for(k = 0; k < count; k++)
+            {
+                if(synth != NULL && time > block)
+                {
+                    fluid_synth_handle_midi_event_offset(synth, dev->driver.handler, dev->driver.data,
+                                                         &events[k], time - block);
+                }
+                else
+                {
+                    dev->driver.handler(dev->driver.data, &events[k]);
+                }
+            }
+        }
+    }
+
+    return nframes;
+}
+
+/* The buffer of a port for the period, the scratch buffer if it has none */
+static float *
+fluid_pipewire_port_buffer(fluid_pipewire_audio_driver_t *dev, void *port, uint32_t nframes)
+{
+    float *buf = pw_filter_get_dsp_buffer(port, nframes);
+
+    return (buf != NULL) ? buf : dev->scratch;
+}
+
+/*
+ * Render len frames of the period, starting at frame start.
+ */
+static int
+fluid_pipewire_audio_render(fluid_pipewire_audio_driver_t *dev, uint32_t nframes,
+                            uint32_t start, uint32_t len)
+{
+    int i;
+
+    for(i = 0; i < dev->num_output_ports * 2; i++)
+    {
+        dev->output_bufs[i] = fluid_pipewire_port_buffer(dev, dev->output_ports[i], nframes) + start;
+    }
+
+    for(i = 0; i < dev->num_fx_ports * 2; i++)
+    {
+        dev->fx_bufs[i] = fluid_pipewire_port_buffer(dev, dev->fx_ports[i], nframes) + start;
+    }
+
+    if(dev->callback != NULL)
+    {
+        return dev->callback(dev->data, len, dev->num_fx_ports * 2, dev->fx_bufs,
+                             dev->num_output_ports * 2, dev->output_bufs);
+    }
+
+    if(dev->num_output_ports == 1 && dev->num_fx_ports == 0)  /* i.e. audio.pipewire.multi=no */
+    {
+        return fluid_synth_write_float(dev->data, len, dev->output_bufs[0], 0, 1, dev->output_bufs[1], 0, 1);
+    }
+
+    return fluid_synth_write_float_channels(dev->data, len, dev->num_fx_ports * 2, dev->fx_bufs,
+                                            dev->num_output_ports * 2, dev->output_bufs);
+}
+
+/* Process function of the node, for the audio and MIDI PipeWire drivers */
+static void
+fluid_pipewire_process(void *data, struct spa_io_position *position)
+{
+    fluid_pipewire_node_t *node = data;
+    fluid_pipewire_audio_driver_t *audio_driver;
+    fluid_pipewire_midi_driver_t *midi_driver;
+    fluid_synth_t *synth = NULL;
+    struct spa_data *d;
+    struct spa_pod *pod;
+    uint32_t nframes = (uint32_t)position->clock.duration;
+    uint32_t pos, block, next, len;
+    int i;
+    fluid_trace_ref_var(trace_ref);
+
+    midi_driver = fluid_atomic_pointer_get(&node->midi_driver);
+
+    if(midi_driver)
+    {
+        midi_driver->sequence = NULL;
+        midi_driver->buffer = pw_filter_dequeue_buffer(midi_driver->port);
+
+        if(midi_driver->buffer != NULL)
+        {
+            d = &midi_driver->buffer->buffer->datas[0];
+            pod = spa_pod_from_data(d->data, d->maxsize, d->chunk->offset, d->chunk->size);
+
+            if(pod != NULL && spa_pod_is_sequence(pod))
+            {
+                midi_driver->sequence = (struct spa_pod_sequence *)pod;
+                midi_driver->control = spa_pod_control_first(&midi_driver->sequence->body);
+            }
+        }
+    }
+
+    audio_driver = fluid_atomic_pointer_get(&node->audio_driver);
+
+    if(audio_driver == NULL || nframes > FLUID_PIPEWIRE_MAX_FRAMES)
+    {
+        // shutting down, or MIDI only
+        if(midi_driver)
+        {
+            fluid_pipewire_midi_dispatch(midi_driver, NULL, 0, nframes, nframes);
+        }
+    }
+    else if(midi_driver == NULL)
+    {
+        if(audio_driver->callback != NULL)
+        {
+            /* the callback mixes into the buffers */
+            for(i = 0; i < audio_driver->num_output_ports * 2; i++)
+            {
+                FLUID_MEMSET(fluid_pipewire_port_buffer(audio_driver, audio_driver->output_ports[i], nframes),
+                             0, nframes * sizeof(float));
+            }
+
+            for(i = 0; i < audio_driver->num_fx_ports * 2; i++)
+            {
+                FLUID_MEMSET(fluid_pipewire_port_buffer(audio_driver, audio_driver->fx_ports[i], nframes),
+                             0, nframes * sizeof(float));
+            }
+        }
+
+        fluid_pipewire_audio_render(audio_driver, nframes, 0, nframes);
+    }
+    else
+    {
+        if(audio_driver->callback == NULL)
+        {
+            synth = audio_driver->data;
+        }
+        else
+        {
+            for(i = 0; i < audio_driver->num_output_ports * 2; i++)
+            {
+                FLUID_MEMSET(fluid_pipewire_port_buffer(audio_driver, audio_driver->output_ports[i], nframes),
+                             0, nframes * sizeof(float));
+            }
+
+            for(i = 0; i < audio_driver->num_fx_ports * 2; i++)
+            {
+                FLUID_MEMSET(fluid_pipewire_port_buffer(audio_driver, audio_driver->fx_ports[i], nframes),
+                             0, nframes * sizeof(float));
+            }
+        }
+
+        /* Render the period block by block up to each MIDI event, so that the
+         * events take effect at their frame rather than at the beginning of
+         * the period. Voices started by the synth of this driver even start at
+         * their exact frame inside of the block. */
+        for(pos = 0; pos < nframes; pos += len)
+        {
+            /* the frames rendered already come first */
+            block = pos + ((synth != NULL) ? fluid_synth_get_buffered_frames(synth) : 0);
+
+            if(block >= nframes)
+            {
+                next = fluid_pipewire_midi_dispatch(midi_driver, NULL, 0, nframes, nframes);
+            }
+            else
+            {
+                next = fluid_pipewire_midi_dispatch(midi_driver, synth, block, block + FLUID_BUFSIZE, nframes);
+            }
+
+            /* up to the block of the next event */
+            len = (next < nframes) ? block + (next - block) / FLUID_BUFSIZE * FLUID_BUFSIZE - pos : nframes - pos;
+
+            if(fluid_pipewire_audio_render(audio_driver, nframes, pos, len) != FLUID_OK)
+            {
+                break;
+            }
+        }
+    }
+
+    if(midi_driver && midi_driver->buffer != NULL)
+    {
+        pw_filter_queue_buffer(midi_driver->port, midi_driver->buffer);
+        midi_driver->buffer = NULL;
+    }
+
+    fluid_trace("pipewire_process", trace_ref);
+}
+
+/*
+ * new_fluid_pipewire_midi_driver
+ */
+fluid_midi_driver_t *
+new_fluid_pipewire_midi_driver(fluid_settings_t *settings,
+                               handle_midi_event_func_t handler, void *data)
+{
+    fluid_pipewire_midi_driver_t *dev;
+
+    fluid_return_val_if_fail(handler != NULL, NULL);
+
+    /* allocate the device */
+    dev = FLUID_NEW(fluid_pipewire_midi_driver_t);
+
+    if(dev == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(dev, 0, sizeof(fluid_pipewire_midi_driver_t));
+
+    dev->driver.handler = handler;
+    dev->driver.data = data;
+
+    dev->parser = new_fluid_midi_parser();
+
+    if(dev->parser == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        goto error_recovery;
+    }
+
+    dev->node = new_fluid_pipewire_node(settings, FALSE, dev);
+
+    if(dev->node == NULL)
+    {
+        goto error_recovery;
+    }
+
+    return (fluid_midi_driver_t *)dev;
+
+error_recovery:
+    delete_fluid_pipewire_midi_driver((fluid_midi_driver_t *)dev);
+    return NULL;
+}
+
+void
+delete_fluid_pipewire_midi_driver(fluid_midi_driver_t *p)
+{
+    fluid_pipewire_midi_driver_t *dev = (fluid_pipewire_midi_driver_t *)p;
+    fluid_return_if_fail(dev != NULL);
+
+    if(dev->node != NULL)
+    {
+        fluid_pipewire_node_close(dev->node, dev);
+    }
+
+    delete_fluid_midi_parser(dev->parser);
+    FLUID_FREE(dev);
+}
+
+#endif /* PIPEWIRE_SUPPORT */
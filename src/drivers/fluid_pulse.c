@@ -27,11 +27,15 @@
 #include "fluid_synth.h"
 #include "fluid_adriver.h"
 #include "fluid_settings.h"
+#include "fluid_render_ahead.h"
 
 #if PULSE_SUPPORT
 
 #include <pulse/simple.h>
 #include <pulse/error.h>
+#include <pulse/thread-mainloop.h>
+#include <pulse/context.h>
+#include <pulse/stream.h>
 
 /** fluid_pulse_audio_driver_t
  *
@@ -47,6 +51,14 @@ typedef struct
     int buffer_size;
     fluid_thread_t *thread;
     int cont;
+    fluid_render_ahead_t *ahead;
+
+    /* audio.pulseaudio.async: the stream asks for the audio by a callback run by the mainloop thread */
+    pa_threaded_mainloop *mainloop;
+    pa_context *context;
+    pa_stream *stream;
+    int realtime_prio;
+    int prio_set;
 
     float *left;
     float *right;
@@ -56,6 +68,10 @@ typedef struct
 
 static fluid_thread_return_t fluid_pulse_audio_run(void *d);
 static fluid_thread_return_t fluid_pulse_audio_run2(void *d);
+static int fluid_pulse_audio_connect_async(fluid_pulse_audio_driver_t *dev, const char *server,
+        const char *device, pa_sample_spec *samplespec,
+        pa_buffer_attr *bufattr, int adjust_latency);
+static void fluid_pulse_audio_render(fluid_pulse_audio_driver_t *dev, float *buf, int len);
 
 
 void fluid_pulse_audio_driver_settings(fluid_settings_t *settings)
@@ -65,6 +81,9 @@ void fluid_pulse_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_register_str(settings, "audio.pulseaudio.media-role", "music", 0);
     fluid_settings_register_int(settings, "audio.pulseaudio.adjust-latency", 1, 0, 1,
                                 FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "audio.pulseaudio.async", 0, 0, 1,
+                                FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "audio.pulseaudio.target-latency", 0, 0, 1000, 0);
 }
 
 
@@ -83,15 +102,13 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     pa_sample_spec samplespec;
     pa_buffer_attr bufattr;
     double sample_rate;
-    int period_size, period_bytes, adjust_latency;
+    int period_size, period_bytes, adjust_latency, async, target_latency;
     char *server = NULL;
     char *device = NULL;
     char *media_role = NULL;
     int realtime_prio = 0;
     int err;
-    float *left = NULL,
-           *right = NULL,
-            *buf = NULL;
+    float *left, *right, *buf;
 
     dev = FLUID_NEW(fluid_pulse_audio_driver_t);
 
@@ -110,6 +127,8 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     fluid_settings_dupstr(settings, "audio.pulseaudio.media-role", &media_role);  /* ++ alloc media-role string */
     fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
     fluid_settings_getint(settings, "audio.pulseaudio.adjust-latency", &adjust_latency);
+    fluid_settings_getint(settings, "audio.pulseaudio.async", &async);
+    fluid_settings_getint(settings, "audio.pulseaudio.target-latency", &target_latency);
 
     if(media_role != NULL)
     {
@@ -137,6 +156,7 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     dev->callback = func;
     dev->cont = 1;
     dev->buffer_size = period_size;
+    dev->realtime_prio = realtime_prio;
 
     samplespec.format = PA_SAMPLE_FLOAT32NE;
     samplespec.channels = 2;
@@ -149,24 +169,19 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     bufattr.prebuf = -1;    /* Just initialize to same value as tlength */
     bufattr.fragsize = -1;  /* Not used */
 
-    dev->pa_handle = pa_simple_new(server, "FluidSynth", PA_STREAM_PLAYBACK,
-                                   device, "FluidSynth output", &samplespec,
-                                   NULL, /* pa_channel_map */
-                                   &bufattr,
-                                   &err);
-
-    if(!dev->pa_handle)
+    /* the latency is the audio buffered by the server, ask for the latency requested instead */
+    if(async && target_latency > 0)
     {
-        FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio connection");
-        goto error_recovery;
+        bufattr.tlength = pa_usec_to_bytes((pa_usec_t)target_latency * 1000, &samplespec);
+        bufattr.maxlength = -1;
+        bufattr.minreq = period_bytes;
     }
 
-    FLUID_LOG(FLUID_INFO, "Using PulseAudio driver");
-
+    /* the buffers are freed with the driver on failure */
     if(func != NULL)
     {
-        left = FLUID_ARRAY(float, period_size);
-        right = FLUID_ARRAY(float, period_size);
+        dev->left = left = FLUID_ARRAY(float, period_size);
+        dev->right = right = FLUID_ARRAY(float, period_size);
 
         if(left == NULL || right == NULL)
         {
@@ -175,16 +190,48 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
         }
     }
 
-    buf = FLUID_ARRAY(float, period_size * 2);
+    dev->buf = buf = FLUID_ARRAY(float, period_size * 2);
+
     if(buf == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory.");
         goto error_recovery;
     }
 
-    dev->left = left;
-    dev->right = right;
-    dev->buf = buf;
+    if(func == NULL)
+    {
+        dev->ahead = new_fluid_render_ahead(settings, data);
+    }
+
+    if(async)
+    {
+        if(fluid_pulse_audio_connect_async(dev, server, device, &samplespec, &bufattr,
+                                           adjust_latency) != FLUID_OK)
+        {
+            goto error_recovery;
+        }
+
+        FLUID_LOG(FLUID_INFO, "Using PulseAudio driver, asynchronous stream");
+
+        FLUID_FREE(server);    /* -- free server string */
+        FLUID_FREE(device);    /* -- free device string */
+
+        return (fluid_audio_driver_t *) dev;
+    }
+
+    dev->pa_handle = pa_simple_new(server, "FluidSynth", PA_STREAM_PLAYBACK,
+                                   device, "FluidSynth output", &samplespec,
+                                   NULL, /* pa_channel_map */
+                                   &bufattr,
+                                   &err);
+
+    if(!dev->pa_handle)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio connection");
+        goto error_recovery;
+    }
+
+    FLUID_LOG(FLUID_INFO, "Using PulseAudio driver");
 
     /* Create the audio thread */
     dev->thread = new_fluid_thread("pulse-audio", func ? fluid_pulse_audio_run2 : fluid_pulse_audio_run,
@@ -203,10 +250,6 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
 error_recovery:
     FLUID_FREE(server);    /* -- free server string */
     FLUID_FREE(device);    /* -- free device string */
-    FLUID_FREE(left);
-    FLUID_FREE(right);
-    FLUID_FREE(buf);
-
     delete_fluid_pulse_audio_driver((fluid_audio_driver_t *) dev);
     return NULL;
 }
@@ -229,6 +272,31 @@ void delete_fluid_pulse_audio_driver(fluid_audio_driver_t *p)
         pa_simple_free(dev->pa_handle);
     }
 
+    /* no more write requests once the mainloop is stopped */
+    if(dev->mainloop)
+    {
+        pa_threaded_mainloop_stop(dev->mainloop);
+    }
+
+    if(dev->stream)
+    {
+        pa_stream_disconnect(dev->stream);
+        pa_stream_unref(dev->stream);
+    }
+
+    if(dev->context)
+    {
+        pa_context_disconnect(dev->context);
+        pa_context_unref(dev->context);
+    }
+
+    if(dev->mainloop)
+    {
+        pa_threaded_mainloop_free(dev->mainloop);
+    }
+
+    delete_fluid_render_ahead(dev->ahead);
+
     FLUID_FREE(dev->left);
     FLUID_FREE(dev->right);
     FLUID_FREE(dev->buf);
@@ -249,7 +317,14 @@ fluid_pulse_audio_run(void *d)
 
     while(dev->cont)
     {
-        fluid_synth_write_float(dev->data, buffer_size, buf, 0, 2, buf, 1, 2);
+        if(dev->ahead != NULL)
+        {
+            fluid_render_ahead_write_float(dev->ahead, buffer_size, buf, 0, 2, buf, 1, 2);
+        }
+        else
+        {
+            fluid_synth_write_float(dev->data, buffer_size, buf, 0, 2, buf, 1, 2);
+        }
 
         if(pa_simple_write(dev->pa_handle, buf,
                            buffer_size * sizeof(float) * 2, &err) < 0)
@@ -305,5 +380,205 @@ fluid_pulse_audio_run2(void *d)
     return FLUID_THREAD_RETURN_VALUE;
 }
 
+/* Render len frames of interleaved audio, len not more than the period size */
+static void
+fluid_pulse_audio_render(fluid_pulse_audio_driver_t *dev, float *buf, int len)
+{
+    float *handle[2];
+    int i;
+
+    if(dev->callback == NULL)
+    {
+        if(dev->ahead != NULL)
+        {
+            fluid_render_ahead_write_float(dev->ahead, len, buf, 0, 2, buf, 1, 2);
+        }
+        else
+        {
+            fluid_synth_write_float(dev->data, len, buf, 0, 2, buf, 1, 2);
+        }
+
+        return;
+    }
+
+    handle[0] = dev->left;
+    handle[1] = dev->right;
+
+    FLUID_MEMSET(dev->left, 0, len * sizeof(float));
+    FLUID_MEMSET(dev->right, 0, len * sizeof(float));
+
+    (*dev->callback)(dev->data, len, 0, NULL, 2, handle);
+
+    /* Interleave the floating point data */
+    for(i = 0; i < len; i++)
+    {
+        buf[i * 2] = dev->left[i];
+        buf[i * 2 + 1] = dev->right[i];
+    }
+}
+
+/* Called by the mainloop thread when the stream can take nbytes of audio:
+ * render them right into the buffer of the stream, a period at most at a time */
+static void
+fluid_pulse_audio_stream_write(pa_stream *stream, size_t nbytes, void *userdata)
+{
+    fluid_pulse_audio_driver_t *dev = (fluid_pulse_audio_driver_t *) userdata;
+    size_t frame_bytes = 2 * sizeof(float);
+    size_t bytes, offset, chunk;
+    void *data;
+
+    /* the mainloop thread isn't created by us */
+    if(!dev->prio_set)
+    {
+        fluid_thread_self_set_prio(dev->realtime_prio);
+        dev->prio_set = TRUE;
+    }
+
+    while(nbytes >= frame_bytes)
+    {
+        bytes = nbytes;
+
+        if(pa_stream_begin_write(stream, &data, &bytes) < 0 || data == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Error writing to PulseAudio stream.");
+            return;
+        }
+
+        bytes -= bytes % frame_bytes;
+
+        if(bytes == 0)
+        {
+            pa_stream_cancel_write(stream);
+            return;
+        }
+
+        for(offset = 0; offset < bytes; offset += chunk)
+        {
+            chunk = bytes - offset;
+
+            if(chunk > dev->buffer_size * frame_bytes)
+            {
+                chunk = dev->buffer_size * frame_bytes;
+            }
+
+            fluid_pulse_audio_render(dev, (float *)((char *)data + offset), (int)(chunk / frame_bytes));
+        }
+
+        if(pa_stream_write(stream, data, bytes, NULL, 0, PA_SEEK_RELATIVE) < 0)
+        {
+            FLUID_LOG(FLUID_ERR, "Error writing to PulseAudio stream.");
+            return;
+        }
+
+        nbytes -= bytes;
+    }
+}
+
+static void
+fluid_pulse_audio_context_state(pa_context *context, void *userdata)
+{
+    fluid_pulse_audio_driver_t *dev = (fluid_pulse_audio_driver_t *) userdata;
+
+    pa_threaded_mainloop_signal(dev->mainloop, 0);
+}
+
+static void
+fluid_pulse_audio_stream_state(pa_stream *stream, void *userdata)
+{
+    fluid_pulse_audio_driver_t *dev = (fluid_pulse_audio_driver_t *) userdata;
+
+    pa_threaded_mainloop_signal(dev->mainloop, 0);
+}
+
+/* Connect a playback stream run by a threaded mainloop, which renders the audio in its write callback */
+static int
+fluid_pulse_audio_connect_async(fluid_pulse_audio_driver_t *dev, const char *server,
+                                const char *device, pa_sample_spec *samplespec,
+                                pa_buffer_attr *bufattr, int adjust_latency)
+{
+    pa_context_state_t context_state;
+    pa_stream_state_t stream_state;
+    int result = FLUID_FAILED;
+
+    dev->mainloop = pa_threaded_mainloop_new();
+
+    if(dev->mainloop == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio mainloop");
+        return FLUID_FAILED;
+    }
+
+    dev->context = pa_context_new(pa_threaded_mainloop_get_api(dev->mainloop), "FluidSynth");
+
+    if(dev->context == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio context");
+        return FLUID_FAILED;
+    }
+
+    pa_context_set_state_callback(dev->context, fluid_pulse_audio_context_state, dev);
+
+    if(pa_context_connect(dev->context, server, PA_CONTEXT_NOFLAGS, NULL) < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio connection");
+        return FLUID_FAILED;
+    }
+
+    pa_threaded_mainloop_lock(dev->mainloop);
+
+    if(pa_threaded_mainloop_start(dev->mainloop) < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to start PulseAudio mainloop");
+        goto exit;
+    }
+
+    while((context_state = pa_context_get_state(dev->context)) != PA_CONTEXT_READY)
+    {
+        if(!PA_CONTEXT_IS_GOOD(context_state))
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio connection");
+            goto exit;
+        }
+
+        pa_threaded_mainloop_wait(dev->mainloop);
+    }
+
+    dev->stream = pa_stream_new(dev->context, "FluidSynth output", samplespec, NULL);
+
+    if(dev->stream == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create PulseAudio stream");
+        goto exit;
+    }
+
+    pa_stream_set_state_callback(dev->stream, fluid_pulse_audio_stream_state, dev);
+    pa_stream_set_write_callback(dev->stream, fluid_pulse_audio_stream_write, dev);
+
+    if(pa_stream_connect_playback(dev->stream, device, bufattr,
+                                  adjust_latency ? PA_STREAM_ADJUST_LATENCY : PA_STREAM_NOFLAGS,
+                                  NULL, NULL) < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to connect PulseAudio stream");
+        goto exit;
+    }
+
+    while((stream_state = pa_stream_get_state(dev->stream)) != PA_STREAM_READY)
+    {
+        if(!PA_STREAM_IS_GOOD(stream_state))
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to connect PulseAudio stream");
+            goto exit;
+        }
+
+        pa_threaded_mainloop_wait(dev->mainloop);
+    }
+
+    result = FLUID_OK;
+
+exit:
+    pa_threaded_mainloop_unlock(dev->mainloop);
+    return result;
+}
+
 #endif /* PULSE_SUPPORT */
 
@@ -0,0 +1,353 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_render_ahead.h"
+#include "fluid_synth.h"
+#include "fluid_settings.h"
+#include "fluid_ringbuffer.h"
+
+/* The fewest periods rendered ahead, so that a wakeup of the render thread
+ * missed by one period does not cause an underrun */
+#define FLUID_RENDER_AHEAD_MIN_DEPTH 2
+
+/* Count of periods after which the depth is reduced, if the buffer never ran low in the meantime */
+#define FLUID_RENDER_AHEAD_WINDOW 1024
+
+struct _fluid_render_ahead_t
+{
+    fluid_synth_t *synth;
+    int period_size;
+
+    /* the periods rendered ahead, each one the left channel followed by the right one */
+    fluid_ringbuffer_t *queue;
+
+    int max_depth;
+    fluid_atomic_int_t depth;   /* count of periods to render ahead currently */
+    fluid_atomic_int_t underruns;
+
+    fluid_thread_t *thread;
+    fluid_cond_mutex_t *mutex;
+    fluid_cond_t *cond;
+    int quit;                   /* protected by mutex */
+
+    /* only used by the audio driver */
+    float *period;              /* the period being read, NULL if none */
+    int pos;                    /* frames of period read already */
+    int dither_index;
+    int reads;                  /* periods read in the current window */
+    int min_count;              /* fewest periods buffered in the current window */
+};
+
+static void
+fluid_render_ahead_period(fluid_render_ahead_t *ahead)
+{
+    float *buf = fluid_ringbuffer_get_inptr(ahead->queue, 0);
+
+    fluid_synth_write_float(ahead->synth, ahead->period_size, buf, 0, 1, buf, ahead->period_size, 1);
+    fluid_ringbuffer_next_inptr(ahead->queue, 1);
+}
+
+static fluid_thread_return_t
+fluid_render_ahead_run(void *data)
+{
+    fluid_render_ahead_t *ahead = data;
+    int quit;
+
+    while(1)
+    {
+        fluid_cond_mutex_lock(ahead->mutex);
+
+        while(!ahead->quit
+                && fluid_ringbuffer_get_count(ahead->queue) >= fluid_atomic_int_get(&ahead->depth))
+        {
+            fluid_cond_wait(ahead->cond, ahead->mutex);
+        }
+
+        quit = ahead->quit;
+        fluid_cond_mutex_unlock(ahead->mutex);
+
+        if(quit)
+        {
+            break;
+        }
+
+        fluid_render_ahead_period(ahead);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Create the render ahead stage of an audio driver playing the given synth,
+ * which renders the periods of audio.period-size frames the driver reads on a
+ * thread of its own, up to audio.render-ahead periods in advance.
+ *
+ * Returns NULL if audio.render-ahead is 0 or on error. In the latter case the
+ * driver should render synchronously, as if render ahead was disabled.
+ */
+fluid_render_ahead_t *
+new_fluid_render_ahead(fluid_settings_t *settings, fluid_synth_t *synth)
+{
+    fluid_render_ahead_t *ahead;
+    int periods, realtime_prio = 0;
+    int i;
+
+    fluid_settings_getint(settings, "audio.render-ahead", &periods);
+
+    if(periods == 0)
+    {
+        return NULL;
+    }
+
+    ahead = FLUID_NEW(fluid_render_ahead_t);
+
+    if(ahead == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(ahead, 0, sizeof(*ahead));
+
+    fluid_settings_getint(settings, "audio.period-size", &ahead->period_size);
+    fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
+
+    ahead->synth = synth;
+    ahead->max_depth = (periods < FLUID_RENDER_AHEAD_MIN_DEPTH) ? FLUID_RENDER_AHEAD_MIN_DEPTH : periods;
+    fluid_atomic_int_set(&ahead->depth, ahead->max_depth);
+    ahead->min_count = ahead->max_depth;
+
+    ahead->queue = new_fluid_ringbuffer(ahead->max_depth, 2 * ahead->period_size * sizeof(float));
+    ahead->mutex = new_fluid_cond_mutex();
+    ahead->cond = new_fluid_cond();
+
+    if(ahead->queue == NULL || ahead->mutex == NULL || ahead->cond == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    /* start with a full buffer */
+    for(i = 0; i < ahead->max_depth; i++)
+    {
+        fluid_render_ahead_period(ahead);
+    }
+
+    ahead->thread = new_fluid_thread("render-ahead", fluid_render_ahead_run, ahead, realtime_prio, FALSE);
+
+    if(ahead->thread == NULL)
+    {
+        goto error_recovery;
+    }
+
+    FLUID_LOG(FLUID_INFO, "Rendering up to %d periods ahead of the audio driver", ahead->max_depth);
+
+    return ahead;
+
+error_recovery:
+    delete_fluid_render_ahead(ahead);
+    return NULL;
+}
+
+/*
+ * Stop the render thread. The audio driver must not read from the render
+ * ahead stage anymore.
+ */
+void
+delete_fluid_render_ahead(fluid_render_ahead_t *ahead)
+{
+    fluid_return_if_fail(ahead != NULL);
+
+    if(ahead->thread)
+    {
+        fluid_cond_mutex_lock(ahead->mutex);
+        ahead->quit = TRUE;
+        fluid_cond_broadcast(ahead->cond);
+        fluid_cond_mutex_unlock(ahead->mutex);
+
+        fluid_thread_join(ahead->thread);
+        delete_fluid_thread(ahead->thread);
+    }
+
+    if(ahead->cond)
+    {
+        delete_fluid_cond(ahead->cond);
+    }
+
+    if(ahead->mutex)
+    {
+        delete_fluid_cond_mutex(ahead->mutex);
+    }
+
+    delete_fluid_ringbuffer(ahead->queue);
+    FLUID_FREE(ahead);
+}
+
+/* Done reading a period, keeps track of how far the render thread is ahead */
+static void
+fluid_render_ahead_next_period(fluid_render_ahead_t *ahead)
+{
+    int count, depth;
+
+    fluid_ringbuffer_next_outptr(ahead->queue);
+    ahead->period = NULL;
+    ahead->pos = 0;
+
+    /* Signalling without holding the mutex may miss the render thread right
+     * before it waits, it will then be woken up by the next period. */
+    fluid_cond_signal(ahead->cond);
+
+    count = fluid_ringbuffer_get_count(ahead->queue);
+
+    if(count < ahead->min_count)
+    {
+        ahead->min_count = count;
+    }
+
+    if(++ahead->reads >= FLUID_RENDER_AHEAD_WINDOW)
+    {
+        depth = fluid_atomic_int_get(&ahead->depth);
+
+        /* the render thread kept spare periods all the time, it can do with less */
+        if(ahead->min_count >= FLUID_RENDER_AHEAD_MIN_DEPTH && depth > FLUID_RENDER_AHEAD_MIN_DEPTH)
+        {
+            fluid_atomic_int_set(&ahead->depth, depth - 1);
+        }
+
+        ahead->reads = 0;
+        ahead->min_count = ahead->max_depth;
+    }
+}
+
+static int
+fluid_render_ahead_write(fluid_render_ahead_t *ahead, int len,
+                         void *lout, int loff, int lincr,
+                         void *rout, int roff, int rincr, int s16)
+{
+    int i, n, depth;
+
+    while(len > 0)
+    {
+        if(ahead->period == NULL)
+        {
+            ahead->period = fluid_ringbuffer_get_outptr(ahead->queue);
+
+            if(ahead->period == NULL)
+            {
+                /* the render thread fell behind, output silence and render further ahead */
+                for(i = 0; i < len; i++)
+                {
+                    if(s16)
+                    {
+                        ((int16_t *)lout)[loff + i * lincr] = 0;
+                        ((int16_t *)rout)[roff + i * rincr] = 0;
+                    }
+                    else
+                    {
+                        ((float *)lout)[loff + i * lincr] = 0;
+                        ((float *)rout)[roff + i * rincr] = 0;
+                    }
+                }
+
+                depth = fluid_atomic_int_get(&ahead->depth);
+
+                if(depth < ahead->max_depth)
+                {
+                    fluid_atomic_int_set(&ahead->depth, depth + 1);
+                }
+
+                fluid_atomic_int_inc(&ahead->underruns);
+                fluid_cond_signal(ahead->cond);
+                return FLUID_OK;
+            }
+        }
+
+        n = ahead->period_size - ahead->pos;
+        n = (n > len) ? len : n;
+
+        if(s16)
+        {
+            fluid_synth_dither_s16(&ahead->dither_index, n,
+                                   ahead->period + ahead->pos, ahead->period + ahead->period_size + ahead->pos,
+                                   lout, loff, lincr, rout, roff, rincr);
+        }
+        else
+        {
+            const float *left = ahead->period + ahead->pos;
+            const float *right = left + ahead->period_size;
+
+            for(i = 0; i < n; i++)
+            {
+                ((float *)lout)[loff + i * lincr] = left[i];
+                ((float *)rout)[roff + i * rincr] = right[i];
+            }
+        }
+
+        loff += n * lincr;
+        roff += n * rincr;
+        len -= n;
+
+        if((ahead->pos += n) == ahead->period_size)
+        {
+            fluid_render_ahead_next_period(ahead);
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Read floating point audio rendered ahead, having the same signature as
+ * fluid_synth_write_float(). Doesn't block. Should only be called from the
+ * audio thread of the driver.
+ */
+int
+fluid_render_ahead_write_float(fluid_render_ahead_t *ahead, int len,
+                               void *lout, int loff, int lincr,
+                               void *rout, int roff, int rincr)
+{
+    return fluid_render_ahead_write(ahead, len, lout, loff, lincr, rout, roff, rincr, FALSE);
+}
+
+/*
+ * Same as fluid_render_ahead_write_float() for 16 bit audio, with dithering
+ * like fluid_synth_write_s16().
+ */
+int
+fluid_render_ahead_write_s16(fluid_render_ahead_t *ahead, int len,
+                             void *lout, int loff, int lincr,
+                             void *rout, int roff, int rincr)
+{
+    return fluid_render_ahead_write(ahead, len, lout, loff, lincr, rout, roff, rincr, TRUE);
+}
+
+/* Count of periods rendered ahead currently */
+int
+fluid_render_ahead_get_depth(fluid_render_ahead_t *ahead)
+{
+    return fluid_atomic_int_get(&ahead->depth);
+}
+
+/* Count of reads that found no audio rendered ahead */
+int
+fluid_render_ahead_get_underruns(fluid_render_ahead_t *ahead)
+{
+    return fluid_atomic_int_get(&ahead->underruns);
+}
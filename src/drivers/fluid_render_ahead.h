@@ -0,0 +1,54 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#ifndef _FLUID_RENDER_AHEAD_H
+#define _FLUID_RENDER_AHEAD_H
+
+#include "fluidsynth_priv.h"
+
+/*
+ * fluid_render_ahead_t
+ *
+ * Renders the audio of a synth on a thread of its own, some periods ahead of
+ * the audio driver, for drivers that would otherwise call the synth from
+ * their audio callback. Enabled by audio.render-ahead.
+ */
+
+typedef struct _fluid_render_ahead_t fluid_render_ahead_t;
+
+/* Same as fluid_audio_callback_t, reading from the render ahead buffer */
+typedef int (*fluid_render_ahead_func_t)(fluid_render_ahead_t *ahead, int len,
+        void *out1, int loff, int lincr,
+        void *out2, int roff, int rincr);
+
+fluid_render_ahead_t *new_fluid_render_ahead(fluid_settings_t *settings, fluid_synth_t *synth);
+void delete_fluid_render_ahead(fluid_render_ahead_t *ahead);
+
+int fluid_render_ahead_write_float(fluid_render_ahead_t *ahead, int len,
+                                   void *lout, int loff, int lincr,
+                                   void *rout, int roff, int rincr);
+int fluid_render_ahead_write_s16(fluid_render_ahead_t *ahead, int len,
+                                 void *lout, int loff, int lincr,
+                                 void *rout, int roff, int rincr);
+
+int fluid_render_ahead_get_depth(fluid_render_ahead_t *ahead);
+int fluid_render_ahead_get_underruns(fluid_render_ahead_t *ahead);
+
+#endif /* _FLUID_RENDER_AHEAD_H */
@@ -22,6 +22,7 @@
 #include "fluid_synth.h"
 #include "fluid_adriver.h"
 #include "fluid_settings.h"
+#include "fluid_render_ahead.h"
 
 #if SDL2_SUPPORT
 
@@ -34,6 +35,9 @@ typedef struct
     fluid_synth_t *synth;
     fluid_audio_callback_t write_ptr;
 
+    fluid_render_ahead_t *ahead;
+    fluid_render_ahead_func_t ahead_write_ptr;
+
     SDL_AudioDeviceID devid;
 
     int frame_size;
@@ -48,7 +52,14 @@ SDLAudioCallback(void *data, void *stream, int len)
 
     len /= dev->frame_size;
 
-    dev->write_ptr(dev->synth, len, stream, 0, 2, stream, 1, 2);
+    if(dev->ahead != NULL)
+    {
+        dev->ahead_write_ptr(dev->ahead, len, stream, 0, 2, stream, 1, 2);
+    }
+    else
+    {
+        dev->write_ptr(dev->synth, len, stream, 0, 2, stream, 1, 2);
+    }
 }
 
 void fluid_sdl2_audio_driver_settings(fluid_settings_t *settings)
@@ -87,6 +98,7 @@ new_fluid_sdl2_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 {
     fluid_sdl2_audio_driver_t *dev = NULL;
     fluid_audio_callback_t write_ptr;
+    fluid_render_ahead_func_t ahead_write_ptr;
     double sample_rate;
     int period_size, sample_size;
     SDL_AudioSpec aspec, rspec;
@@ -131,6 +143,7 @@ new_fluid_sdl2_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
         sample_size = sizeof(float);
         write_ptr   = fluid_synth_write_float;
+        ahead_write_ptr = fluid_render_ahead_write_float;
 
         aspec.format = AUDIO_F32SYS;
     }
@@ -140,6 +153,7 @@ new_fluid_sdl2_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
         sample_size = sizeof(short);
         write_ptr   = fluid_synth_write_s16;
+        ahead_write_ptr = fluid_render_ahead_write_s16;
 
         aspec.format = AUDIO_S16SYS;
     }
@@ -208,8 +222,11 @@ new_fluid_sdl2_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
         /* Save copy of other variables */
         dev->write_ptr = write_ptr;
+        dev->ahead_write_ptr = ahead_write_ptr;
         dev->frame_size = sample_size * aspec.channels;
 
+        dev->ahead = new_fluid_render_ahead(settings, synth);
+
         /* Open audio device */
         dev->devid = SDL_OpenAudioDevice(dev_name, 0, &aspec, &rspec, 0);
 
@@ -244,6 +261,8 @@ void delete_fluid_sdl2_audio_driver(fluid_audio_driver_t *d)
             SDL_CloseAudioDevice(dev->devid);
         }
 
+        delete_fluid_render_ahead(dev->ahead);
+
         FLUID_FREE(dev);
     }
 }
@@ -0,0 +1,552 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/* fluid_udpmidi.c
+ *
+ * MIDI input from the network: receives RTP-MIDI (RFC 6295) or raw MIDI
+ * bytes in UDP datagrams and hands the events to the handler straight from
+ * the receiving thread.
+ *
+ * Only the RTP data packets are handled, the session protocol used by some
+ * implementations for inviting peers and synchronizing clocks is not. The
+ * recovery journal is ignored as well, packets arriving late or twice are
+ * dropped.
+ */
+
+#include "fluid_mdriver.h"
+#include "fluid_midi.h"
+#include "fluid_settings.h"
+
+#ifdef NETWORK_SUPPORT
+
+/* Large enough for any datagram not fragmented on an ethernet link */
+#define FLUID_UDP_MIDI_BUFFER_LENGTH 1500
+
+/* Milliseconds after which the thread checks whether to quit */
+#define FLUID_UDP_MIDI_POLL_MSEC 100
+
+/* The count of commands held back for their delta time, more are passed on early */
+#define FLUID_UDP_MIDI_MAX_PENDING 64
+
+#define RTP_HEADER_SIZE 12
+
+/* An event of an RTP packet waiting for its delta time to pass */
+typedef struct
+{
+    fluid_midi_event_t event;
+    double due;
+} fluid_udp_midi_pending_t;
+
+typedef struct
+{
+    fluid_midi_driver_t driver;
+    fluid_socket_t sock;
+    fluid_thread_t *thread;
+    int status;
+    int rtp;
+    int clock_rate;             /* of the RTP timestamps, delta times are given in */
+    int have_seq;
+    unsigned int seq;           /* the sequence number of the last RTP packet */
+    fluid_midi_parser_t *parser;
+    unsigned char buffer[FLUID_UDP_MIDI_BUFFER_LENGTH];
+
+    /* ring of the events held back, in the order of their commands */
+    fluid_udp_midi_pending_t pending[FLUID_UDP_MIDI_MAX_PENDING];
+    int pending_first;
+    int pending_count;
+} fluid_udp_midi_driver_t;
+
+static fluid_thread_return_t fluid_udp_midi_run(void *d);
+
+
+void fluid_udp_midi_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_int(settings, "midi.udp.port", 5004, 1, 65535, 0);
+    fluid_settings_register_int(settings, "midi.udp.rtp", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "midi.udp.rtp-clock-rate", 10000, 1, 1000000, 0);
+}
+
+/*
+ * new_fluid_udp_midi_driver
+ */
+fluid_midi_driver_t *
+new_fluid_udp_midi_driver(fluid_settings_t *settings,
+                          handle_midi_event_func_t handler, void *data)
+{
+    fluid_udp_midi_driver_t *dev;
+    int realtime_prio = 0;
+    int port;
+
+    /* not much use doing anything */
+    if(handler == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Invalid argument");
+        return NULL;
+    }
+
+    dev = FLUID_NEW(fluid_udp_midi_driver_t);
+
+    if(dev == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(dev, 0, sizeof(fluid_udp_midi_driver_t));
+
+    dev->driver.handler = handler;
+    dev->driver.data = data;
+
+    dev->parser = new_fluid_midi_parser();
+
+    if(dev->parser == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(dev);
+        return NULL;
+    }
+
+    fluid_settings_getint(settings, "midi.udp.port", &port);
+    fluid_settings_getint(settings, "midi.udp.rtp", &dev->rtp);
+    fluid_settings_getint(settings, "midi.udp.rtp-clock-rate", &dev->clock_rate);
+    fluid_settings_getint(settings, "midi.realtime-prio", &realtime_prio);
+
+    if(fluid_udp_socket_open(port, &dev->sock) != FLUID_OK)
+    {
+        delete_fluid_midi_parser(dev->parser);
+        FLUID_FREE(dev);
+        return NULL;
+    }
+
+    dev->status = FLUID_MIDI_READY;
+
+    dev->thread = new_fluid_thread("udp-midi", fluid_udp_midi_run, dev, realtime_prio, FALSE);
+
+    if(!dev->thread)
+    {
+        delete_fluid_udp_midi_driver((fluid_midi_driver_t *) dev);
+        return NULL;
+    }
+
+    return (fluid_midi_driver_t *) dev;
+}
+
+/*
+ * delete_fluid_udp_midi_driver
+ */
+void
+delete_fluid_udp_midi_driver(fluid_midi_driver_t *p)
+{
+    fluid_udp_midi_driver_t *dev = (fluid_udp_midi_driver_t *) p;
+    fluid_return_if_fail(dev != NULL);
+
+    /* the thread notices within FLUID_UDP_MIDI_POLL_MSEC */
+    dev->status = FLUID_MIDI_DONE;
+
+    if(dev->thread)
+    {
+        fluid_thread_join(dev->thread);
+        delete_fluid_thread(dev->thread);
+    }
+
+    fluid_udp_socket_close(dev->sock);
+    delete_fluid_midi_parser(dev->parser);
+    FLUID_FREE(dev);
+}
+
+/* Lets the parser convert MIDI bytes received at the given time into events and sends them to the handler */
+static void
+fluid_udp_midi_parse(fluid_udp_midi_driver_t *dev, const unsigned char *buf, int len, double usec)
+{
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
+    int i, k, count, consumed;
+
+    for(i = 0; i < len; i += consumed)
+    {
+        count = fluid_midi_parser_parse_buffer(dev->parser, buf + i, len - i,
+                                               events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
+
+        for(k = 0; k < count; k++)
+        {
+            fluid_midi_driver_handle_event_at(&dev->driver, &events[k], usec);
+        }
+    }
+}
+
+/* Reads a delta time of the RTP-MIDI command list, returns the count of bytes read or -1 */
+static int
+fluid_rtp_midi_read_delta(const unsigned char *buf, int len, unsigned int *delta)
+{
+    int i;
+
+    *delta = 0;
+
+    for(i = 0; i < 4 && i < len; i++)
+    {
+        *delta = (*delta << 7) | (buf[i] & 0x7F);
+
+        if(!(buf[i] & 0x80))
+        {
+            return i + 1;
+        }
+    }
+
+    return -1;
+}
+
+/* The count of data bytes following a status byte, other than SysEx */
+static int
+fluid_rtp_midi_data_size(unsigned char status)
+{
+    if(status < 0xF0)
+    {
+        return ((status & 0xE0) == 0xC0) ? 1 : 2;
+    }
+
+    switch(status)
+    {
+    case MIDI_TIME_CODE:
+    case MIDI_SONG_SELECT:
+        return 1;
+
+    case MIDI_SONG_POSITION:
+        return 2;
+
+    default:
+        return 0;
+    }
+}
+
+/* The time a command is due at, given by its delta time from the arrival of the packet */
+static double
+fluid_rtp_midi_due(fluid_udp_midi_driver_t *dev, double arrival, unsigned int delta)
+{
+    return arrival + delta * 1000000.0 / dev->clock_rate;
+}
+
+/* Passes on the first event held back, freeing the copy of its SysEx data */
+static void
+fluid_rtp_midi_send_pending(fluid_udp_midi_driver_t *dev)
+{
+    fluid_udp_midi_pending_t *pending = &dev->pending[dev->pending_first];
+
+    fluid_midi_driver_handle_event_at(&dev->driver, &pending->event, pending->due);
+
+    if(pending->event.type == MIDI_SYSEX)
+    {
+        FLUID_FREE(pending->event.paramptr);
+    }
+
+    dev->pending_first = (dev->pending_first + 1) % FLUID_UDP_MIDI_MAX_PENDING;
+    dev->pending_count--;
+}
+
+/*
+ * Passes on the events held back that are due by now, all of them if all is TRUE,
+ * returns the milliseconds until the next one is due or -1 if there is none left
+ */
+static int
+fluid_rtp_midi_send_due(fluid_udp_midi_driver_t *dev, int all)
+{
+    double msec;
+
+    while(dev->pending_count > 0)
+    {
+        msec = (dev->pending[dev->pending_first].due - fluid_utime()) / 1000.0;
+
+        if(msec > 0 && !all)
+        {
+            return (int)msec + 1;
+        }
+
+        fluid_rtp_midi_send_pending(dev);
+    }
+
+    return -1;
+}
+
+/* Lets the parser convert MIDI bytes into events and holds them back until the given time */
+static void
+fluid_rtp_midi_hold(fluid_udp_midi_driver_t *dev, const unsigned char *buf, int len, double due)
+{
+    fluid_midi_event_t events[FLUID_MIDI_PARSER_MAX_EVENTS];
+    fluid_udp_midi_pending_t *pending;
+    void *data;
+    int i, k, count, consumed;
+
+    for(i = 0; i < len; i += consumed)
+    {
+        count = fluid_midi_parser_parse_buffer(dev->parser, buf + i, len - i,
+                                               events, FLUID_MIDI_PARSER_MAX_EVENTS, &consumed);
+
+        for(k = 0; k < count; k++)
+        {
+            if(dev->pending_count == FLUID_UDP_MIDI_MAX_PENDING)
+            {
+                FLUID_LOG(FLUID_DBG, "Too many RTP-MIDI commands held back, passing one on early");
+                fluid_rtp_midi_send_pending(dev);
+            }
+
+            /* the SysEx data is only valid until the parser gets the next bytes */
+            if(events[k].type == MIDI_SYSEX)
+            {
+                data = FLUID_MALLOC(events[k].param1);
+
+                if(data == NULL)
+                {
+                    FLUID_LOG(FLUID_ERR, "Out of memory");
+                    continue;
+                }
+
+                FLUID_MEMCPY(data, events[k].paramptr, events[k].param1);
+                events[k].paramptr = data;
+            }
+
+            pending = &dev->pending[(dev->pending_first + dev->pending_count) % FLUID_UDP_MIDI_MAX_PENDING];
+            pending->event = events[k];
+            pending->due = due;
+            dev->pending_count++;
+        }
+    }
+}
+
+/*
+ * Hands the events of a command of an RTP packet to the handler, or holds
+ * them back until the time the command is due at, unless the events are
+ * played at the frame of their time anyway with midi.timestamp-latency.
+ * The receiving thread passes them on once due, see fluid_udp_midi_run().
+ */
+static void
+fluid_rtp_midi_send(fluid_udp_midi_driver_t *dev, unsigned char status, const unsigned char *buf, int len, double due)
+{
+    if(fluid_midi_driver_schedules_events(&dev->driver)
+            || (dev->pending_count == 0 && due <= fluid_utime()))
+    {
+        fluid_udp_midi_parse(dev, &status, 1, due);
+        fluid_udp_midi_parse(dev, buf, len, due);
+    }
+    else
+    {
+        fluid_rtp_midi_hold(dev, &status, 1, due);
+        fluid_rtp_midi_hold(dev, buf, len, due);
+    }
+}
+
+/*
+ * Handles the MIDI command section of an RTP-MIDI packet, see RFC 6295
+ * section 3. Commands are dispatched in order, each one once its delta
+ * time has passed. Running status only applies within the packet.
+ */
+static void
+fluid_rtp_midi_handle_packet(fluid_udp_midi_driver_t *dev, const unsigned char *buf, int len, double arrival)
+{
+    unsigned int seq, delta, time = 0;
+    unsigned char status, running_status = 0;
+    int pos, end, n, size, no_delta;
+
+    if(len < RTP_HEADER_SIZE || (buf[0] & 0xC0) != 0x80)
+    {
+        FLUID_LOG(FLUID_DBG, "Dropping a UDP packet that isn't RTP");
+        return;
+    }
+
+    /* skip the contributing sources and the header extension */
+    pos = RTP_HEADER_SIZE + 4 * (buf[0] & 0x0F);
+
+    if((buf[0] & 0x10) && pos + 4 <= len)
+    {
+        pos += 4 + 4 * ((buf[pos + 2] << 8) | buf[pos + 3]);
+    }
+
+    if(pos >= len)
+    {
+        FLUID_LOG(FLUID_DBG, "Dropping an RTP packet without MIDI commands");
+        return;
+    }
+
+    seq = (buf[2] << 8) | buf[3];
+
+    if(dev->have_seq && (short)(seq - dev->seq) <= 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Dropping RTP packet %u, it arrived after packet %u", seq, dev->seq);
+        return;
+    }
+
+    dev->have_seq = TRUE;
+    dev->seq = seq;
+
+    /* the header of the command section: B J Z P LEN */
+    no_delta = !(buf[pos] & 0x20);
+    end = buf[pos] & 0x0F;
+
+    if(buf[pos++] & 0x80)
+    {
+        if(pos >= len)
+        {
+            return;
+        }
+
+        end = (end << 8) | buf[pos++];
+    }
+
+    end += pos;
+
+    if(end > len)
+    {
+        FLUID_LOG(FLUID_DBG, "Dropping a truncated RTP packet");
+        return;
+    }
+
+    while(pos < end)
+    {
+        /* every command but the first one is preceded by its delta time, the first one if Z is set */
+        if(!no_delta)
+        {
+            n = fluid_rtp_midi_read_delta(buf + pos, end - pos, &delta);
+
+            if(n < 0)
+            {
+                break;
+            }
+
+            pos += n;
+            time += delta;
+        }
+
+        no_delta = FALSE;
+
+        if(pos >= end)
+        {
+            break;
+        }
+
+        if(buf[pos] & 0x80)
+        {
+            status = buf[pos++];
+
+            if(status < 0xF0)
+            {
+                running_status = status;
+            }
+            else if(status < 0xF8)
+            {
+                running_status = 0;
+            }
+        }
+        else if(running_status != 0)
+        {
+            status = running_status;
+        }
+        else
+        {
+            FLUID_LOG(FLUID_DBG, "Dropping the rest of an RTP packet missing a status byte");
+            break;
+        }
+
+        if(status == MIDI_SYSEX || status == MIDI_EOX)
+        {
+            /* a SysEx segment, up to and including its terminating F0, F7 or F4 byte */
+            for(size = 0; pos + size < end && !(buf[pos + size] & 0x80); size++)
+            {
+            }
+
+            if(pos + size >= end)
+            {
+                break;
+            }
+
+            size++;
+
+            /* only complete SysEx messages are passed on, segments are dropped */
+            if(status == MIDI_SYSEX && buf[pos + size - 1] == MIDI_EOX)
+            {
+                fluid_rtp_midi_send(dev, status, buf + pos, size, fluid_rtp_midi_due(dev, arrival, time));
+            }
+
+            pos += size;
+            continue;
+        }
+
+        size = fluid_rtp_midi_data_size(status);
+
+        if(pos + size > end)
+        {
+            break;
+        }
+
+        fluid_rtp_midi_send(dev, status, buf + pos, size, fluid_rtp_midi_due(dev, arrival, time));
+        pos += size;
+    }
+}
+
+/*
+ * fluid_udp_midi_run
+ */
+static fluid_thread_return_t
+fluid_udp_midi_run(void *d)
+{
+    fluid_udp_midi_driver_t *dev = (fluid_udp_midi_driver_t *) d;
+    int n, msec;
+
+    /* go into a loop until someone tells us to stop */
+    dev->status = FLUID_MIDI_LISTENING;
+
+    while(dev->status == FLUID_MIDI_LISTENING)
+    {
+        /* wake up for the next event held back as well */
+        msec = fluid_rtp_midi_send_due(dev, FALSE);
+        n = fluid_socket_wait(dev->sock, (msec >= 0 && msec < FLUID_UDP_MIDI_POLL_MSEC) ? msec : FLUID_UDP_MIDI_POLL_MSEC);
+
+        if(n == 0)
+        {
+            continue;
+        }
+
+        if(n < 0)
+        {
+            break;
+        }
+
+        n = fluid_socket_recv(dev->sock, dev->buffer, FLUID_UDP_MIDI_BUFFER_LENGTH);
+
+        if(n < 0)
+        {
+            /* e.g. an ICMP error reported for an earlier datagram, the socket is still usable */
+            FLUID_LOG(FLUID_DBG, "Failed to receive a UDP packet");
+            continue;
+        }
+
+        if(dev->rtp)
+        {
+            fluid_rtp_midi_handle_packet(dev, dev->buffer, n, fluid_utime());
+        }
+        else
+        {
+            fluid_udp_midi_parse(dev, dev->buffer, n, fluid_utime());
+        }
+    }
+
+    /* rather early than never, e.g. for the note offs */
+    fluid_rtp_midi_send_due(dev, TRUE);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+#endif /* NETWORK_SUPPORT */
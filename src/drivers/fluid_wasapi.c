@@ -0,0 +1,711 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/* fluid_wasapi.c
+ *
+ * Audio driver for the Windows Audio Session API.
+ *
+ * The stream is event driven: the audio engine signals an event every
+ * period, and the period is rendered straight into the memory returned by
+ * IAudioRenderClient_GetBuffer(). In exclusive mode, the stream talks to the
+ * device directly with a period of audio.period-size frames. In shared mode,
+ * the period of the engine is lowered to the smallest one supported through
+ * IAudioClient3, when the format of the stream is the one of the engine.
+ */
+
+#include "fluid_synth.h"
+#include "fluid_adriver.h"
+#include "fluid_settings.h"
+
+#if WASAPI_SUPPORT
+
+#define COBJMACROS
+
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#include <avrt.h>
+
+#define NOBITMAP
+#include <mmreg.h>
+
+/* The GUIDs are defined here, the libraries of some toolchains lack them */
+static const CLSID fluid_wasapi_clsid_mmdevice_enumerator =
+{
+    0xbcde0395, 0xe52f, 0x467c, {0x8e, 0x3d, 0xc4, 0x57, 0x92, 0x91, 0x69, 0x2e}
+};
+
+static const IID fluid_wasapi_iid_mmdevice_enumerator =
+{
+    0xa95664d2, 0x9614, 0x4f35, {0xa7, 0x46, 0xde, 0x8d, 0xb6, 0x36, 0x17, 0xe6}
+};
+
+static const IID fluid_wasapi_iid_audio_client =
+{
+    0x1cb9ad4c, 0xdbfa, 0x4c32, {0xb1, 0x78, 0xc2, 0xf5, 0x68, 0xa7, 0x03, 0xb2}
+};
+
+static const IID fluid_wasapi_iid_audio_render_client =
+{
+    0xf294acfc, 0x3146, 0x4483, {0xa7, 0xbf, 0xad, 0xdc, 0xa7, 0xc2, 0x60, 0xe2}
+};
+
+static const GUID fluid_wasapi_subtype_ieee_float =
+{
+    0x00000003, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}
+};
+
+static const GUID fluid_wasapi_subtype_pcm =
+{
+    0x00000001, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}
+};
+
+static const PROPERTYKEY fluid_wasapi_pkey_device_friendly_name =
+{
+    {0xa45c254e, 0xdf1c, 0x4efd, {0x80, 0x20, 0x67, 0xd1, 0x46, 0xa8, 0x50, 0xe0}}, 14
+};
+
+#ifdef __IAudioClient3_INTERFACE_DEFINED__
+static const IID fluid_wasapi_iid_audio_client3 =
+{
+    0x7ed4ee07, 0x8e67, 0x4cd4, {0x8c, 0x1a, 0x2b, 0x7a, 0x59, 0x87, 0xad, 0x42}
+};
+#endif
+
+/* Missing from the headers of older toolchains */
+#ifndef AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM
+#define AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM 0x80000000
+#endif
+
+#ifndef AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY
+#define AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY 0x08000000
+#endif
+
+/* Time to wait for the event of the stream before giving up, in msec */
+#define FLUID_WASAPI_TIMEOUT 2000
+
+/* 100 nanosecond units of REFERENCE_TIME per second */
+#define FLUID_WASAPI_REFTIMES_PER_SEC 10000000
+
+typedef struct
+{
+    fluid_audio_driver_t driver;
+
+    fluid_synth_t *synth;
+    fluid_audio_callback_t write;
+
+    char *devname;                  /* audio.wasapi.device, NULL for the default endpoint */
+    int exclusive;                  /* audio.wasapi.exclusive-mode */
+    int period_size;
+    double sample_rate;
+    WAVEFORMATEXTENSIBLE format;
+
+    IAudioClient *client;
+    IAudioRenderClient *render;
+    UINT32 buffer_frames;
+
+    HANDLE thread;
+    DWORD thread_id;
+    HANDLE init_ev;                 /* set once the stream is started, or has failed to */
+    HANDLE buffer_ev;               /* set by the audio engine when it wants a period */
+    HANDLE quit_ev;
+    int init_ok;
+
+} fluid_wasapi_audio_driver_t;
+
+static DWORD WINAPI fluid_wasapi_audio_run(LPVOID lpParameter);
+
+
+/* Friendly name of an endpoint in UTF-8, to be freed, or NULL */
+static char *
+fluid_wasapi_get_device_name(IMMDevice *device)
+{
+    IPropertyStore *props = NULL;
+    PROPVARIANT var;
+    char *name = NULL;
+    int len;
+
+    if(FAILED(IMMDevice_OpenPropertyStore(device, STGM_READ, &props)))
+    {
+        return NULL;
+    }
+
+    PropVariantInit(&var);
+
+    if(SUCCEEDED(IPropertyStore_GetValue(props, &fluid_wasapi_pkey_device_friendly_name, &var))
+            && var.vt == VT_LPWSTR)
+    {
+        len = WideCharToMultiByte(CP_UTF8, 0, var.pwszVal, -1, NULL, 0, NULL, NULL);
+        name = FLUID_ARRAY(char, len);
+
+        if(name != NULL)
+        {
+            WideCharToMultiByte(CP_UTF8, 0, var.pwszVal, -1, name, len, NULL, NULL);
+        }
+    }
+
+    PropVariantClear(&var);
+    IPropertyStore_Release(props);
+
+    return name;
+}
+
+/*
+ * Call func on every active render endpoint, until it returns TRUE.
+ * Returns the endpoint func returned TRUE for, with a reference, or NULL.
+ */
+static IMMDevice *
+fluid_wasapi_foreach_device(IMMDeviceEnumerator *enumerator,
+                            int (*func)(IMMDevice *device, const char *name, void *data), void *data)
+{
+    IMMDeviceCollection *collection = NULL;
+    IMMDevice *device, *found = NULL;
+    UINT i, count;
+    char *name;
+
+    if(FAILED(IMMDeviceEnumerator_EnumAudioEndpoints(enumerator, eRender, DEVICE_STATE_ACTIVE, &collection)))
+    {
+        return NULL;
+    }
+
+    if(FAILED(IMMDeviceCollection_GetCount(collection, &count)))
+    {
+        count = 0;
+    }
+
+    for(i = 0; i < count && found == NULL; i++)
+    {
+        if(FAILED(IMMDeviceCollection_Item(collection, i, &device)))
+        {
+            continue;
+        }
+
+        name = fluid_wasapi_get_device_name(device);
+
+        if(name != NULL && func(device, name, data))
+        {
+            found = device;
+        }
+        else
+        {
+            IMMDevice_Release(device);
+        }
+
+        FLUID_FREE(name);
+    }
+
+    IMMDeviceCollection_Release(collection);
+
+    return found;
+}
+
+static int
+fluid_wasapi_add_device_option(IMMDevice *device, const char *name, void *data)
+{
+    fluid_settings_add_option((fluid_settings_t *) data, "audio.wasapi.device", name);
+    return FALSE;
+}
+
+static int
+fluid_wasapi_match_device_name(IMMDevice *device, const char *name, void *data)
+{
+    FLUID_LOG(FLUID_DBG, "Testing audio device: %s", name);
+    return FLUID_STRCASECMP(name, (const char *) data) == 0;
+}
+
+void fluid_wasapi_audio_driver_settings(fluid_settings_t *settings)
+{
+    IMMDeviceEnumerator *enumerator = NULL;
+    HRESULT com_init;
+
+    fluid_settings_register_str(settings, "audio.wasapi.device", "default", 0);
+    fluid_settings_add_option(settings, "audio.wasapi.device", "default");
+    fluid_settings_register_int(settings, "audio.wasapi.exclusive-mode", 0, 0, 1, FLUID_HINT_TOGGLED);
+
+    com_init = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+    if(SUCCEEDED(CoCreateInstance(&fluid_wasapi_clsid_mmdevice_enumerator, NULL, CLSCTX_ALL,
+                                  &fluid_wasapi_iid_mmdevice_enumerator, (void **) &enumerator)))
+    {
+        fluid_wasapi_foreach_device(enumerator, fluid_wasapi_add_device_option, settings);
+        IMMDeviceEnumerator_Release(enumerator);
+    }
+
+    if(SUCCEEDED(com_init))
+    {
+        CoUninitialize();
+    }
+}
+
+
+/*
+ * new_fluid_wasapi_audio_driver
+ */
+fluid_audio_driver_t *
+new_fluid_wasapi_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
+{
+    fluid_wasapi_audio_driver_t *dev;
+    HANDLE wait[2];
+    int bits;
+
+    /* create and clear the driver data */
+    dev = FLUID_NEW(fluid_wasapi_audio_driver_t);
+
+    if(dev == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(dev, 0, sizeof(fluid_wasapi_audio_driver_t));
+    dev->synth = synth;
+
+    fluid_settings_getnum(settings, "synth.sample-rate", &dev->sample_rate);
+    fluid_settings_getint(settings, "audio.period-size", &dev->period_size);
+    fluid_settings_getint(settings, "audio.wasapi.exclusive-mode", &dev->exclusive);
+
+    /* check the format */
+    if(fluid_settings_str_equal(settings, "audio.sample-format", "float"))
+    {
+        FLUID_LOG(FLUID_DBG, "Selected 32 bit sample format");
+
+        bits = 32;
+        dev->write = fluid_synth_write_float;
+        dev->format.SubFormat = fluid_wasapi_subtype_ieee_float;
+    }
+    else if(fluid_settings_str_equal(settings, "audio.sample-format", "16bits"))
+    {
+        FLUID_LOG(FLUID_DBG, "Selected 16 bit sample format");
+
+        bits = 16;
+        dev->write = fluid_synth_write_s16;
+        dev->format.SubFormat = fluid_wasapi_subtype_pcm;
+    }
+    else
+    {
+        FLUID_LOG(FLUID_ERR, "Unhandled sample format");
+        goto error_recovery;
+    }
+
+    dev->format.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+    dev->format.Format.nChannels = 2;
+    dev->format.Format.nSamplesPerSec = (DWORD) dev->sample_rate;
+    dev->format.Format.wBitsPerSample = (WORD) bits;
+    dev->format.Format.nBlockAlign = (WORD)(2 * bits / 8);
+    dev->format.Format.nAvgBytesPerSec = dev->format.Format.nSamplesPerSec * dev->format.Format.nBlockAlign;
+    dev->format.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+    dev->format.Samples.wValidBitsPerSample = (WORD) bits;
+    dev->format.dwChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
+
+    /* get the selected device name. if none is specified, use the default endpoint. */
+    if(fluid_settings_dupstr(settings, "audio.wasapi.device", &dev->devname) == FLUID_OK /* ++ alloc device name */
+            && dev->devname != NULL
+            && (dev->devname[0] == '\0' || FLUID_STRCASECMP(dev->devname, "default") == 0))
+    {
+        FLUID_FREE(dev->devname);    /* -- free device name */
+        dev->devname = NULL;
+    }
+
+    dev->init_ev = CreateEvent(NULL, FALSE, FALSE, NULL);
+    dev->buffer_ev = CreateEvent(NULL, FALSE, FALSE, NULL);
+    dev->quit_ev = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if(dev->init_ev == NULL || dev->buffer_ev == NULL || dev->quit_ev == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the events of the WASAPI driver");
+        goto error_recovery;
+    }
+
+    /* the stream is set up by the audio thread, which owns the COM objects */
+    dev->thread = CreateThread(NULL, 0, fluid_wasapi_audio_run, (LPVOID) dev, 0, &dev->thread_id);
+
+    if(dev->thread == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the WASAPI audio thread");
+        goto error_recovery;
+    }
+
+    wait[0] = dev->init_ev;
+    wait[1] = dev->thread;
+    WaitForMultipleObjects(2, wait, FALSE, INFINITE);
+
+    if(!dev->init_ok)
+    {
+        goto error_recovery;
+    }
+
+    FLUID_LOG(FLUID_INFO, "Using WASAPI driver");
+
+    return (fluid_audio_driver_t *) dev;
+
+error_recovery:
+    delete_fluid_wasapi_audio_driver((fluid_audio_driver_t *) dev);
+    return NULL;
+}
+
+
+void delete_fluid_wasapi_audio_driver(fluid_audio_driver_t *d)
+{
+    fluid_wasapi_audio_driver_t *dev = (fluid_wasapi_audio_driver_t *) d;
+    fluid_return_if_fail(dev != NULL);
+
+    /* wait till the audio thread exits, it releases the stream */
+    if(dev->thread != NULL)
+    {
+        /* tell the audio thread to stop its loop */
+        SetEvent(dev->quit_ev);
+
+        if(WaitForSingleObject(dev->thread, FLUID_WASAPI_TIMEOUT) != WAIT_OBJECT_0)
+        {
+            /* on error kill the thread mercilessly */
+            FLUID_LOG(FLUID_DBG, "Couldn't join the audio thread. killing it.");
+            TerminateThread(dev->thread, 0);
+        }
+
+        /* Release the thread object */
+        CloseHandle(dev->thread);
+    }
+
+    /* Release the event objects */
+    if(dev->init_ev != NULL)
+    {
+        CloseHandle(dev->init_ev);
+    }
+
+    if(dev->buffer_ev != NULL)
+    {
+        CloseHandle(dev->buffer_ev);
+    }
+
+    if(dev->quit_ev != NULL)
+    {
+        CloseHandle(dev->quit_ev);
+    }
+
+    FLUID_FREE(dev->devname);
+    FLUID_FREE(dev);
+}
+
+/* Initialize the client in exclusive mode, with a period of audio.period-size frames */
+static HRESULT
+fluid_wasapi_init_exclusive(fluid_wasapi_audio_driver_t *dev, IMMDevice *device)
+{
+    REFERENCE_TIME default_period, min_period, period;
+    HRESULT hr;
+
+    IAudioClient_GetDevicePeriod(dev->client, &default_period, &min_period);
+
+    period = (REFERENCE_TIME)(dev->period_size * (double) FLUID_WASAPI_REFTIMES_PER_SEC / dev->sample_rate + 0.5);
+
+    if(period < min_period)
+    {
+        FLUID_LOG(FLUID_WARN, "audio.period-size is below the minimum period of the device, using %d frames",
+                  (int)(min_period * dev->sample_rate / FLUID_WASAPI_REFTIMES_PER_SEC + 0.5));
+        period = min_period;
+    }
+
+    hr = IAudioClient_Initialize(dev->client, AUDCLNT_SHAREMODE_EXCLUSIVE, AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                 period, period, (WAVEFORMATEX *) &dev->format, NULL);
+
+    if(hr == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED)
+    {
+        UINT32 frames;
+
+        /* the device wants the period of the aligned buffer it offers, on a new client */
+        IAudioClient_GetBufferSize(dev->client, &frames);
+        IAudioClient_Release(dev->client);
+        dev->client = NULL;
+
+        period = (REFERENCE_TIME)(frames * (double) FLUID_WASAPI_REFTIMES_PER_SEC / dev->sample_rate + 0.5);
+
+        hr = IMMDevice_Activate(device, &fluid_wasapi_iid_audio_client, CLSCTX_ALL, NULL, (void **) &dev->client);
+
+        if(SUCCEEDED(hr))
+        {
+            hr = IAudioClient_Initialize(dev->client, AUDCLNT_SHAREMODE_EXCLUSIVE, AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                         period, period, (WAVEFORMATEX *) &dev->format, NULL);
+        }
+    }
+
+    return hr;
+}
+
+/* Initialize the client in shared mode, with the smallest period the engine supports */
+static HRESULT
+fluid_wasapi_init_shared(fluid_wasapi_audio_driver_t *dev)
+{
+    REFERENCE_TIME duration;
+
+#ifdef __IAudioClient3_INTERFACE_DEFINED__
+    WAVEFORMATEX *closest = NULL;
+    HRESULT hr;
+
+    /* an exact match of the format of the engine is required by a low latency stream */
+    hr = IAudioClient_IsFormatSupported(dev->client, AUDCLNT_SHAREMODE_SHARED, (WAVEFORMATEX *) &dev->format, &closest);
+    CoTaskMemFree(closest);
+
+    if(hr == S_OK)
+    {
+        IAudioClient3 *client3 = NULL;
+        UINT32 default_frames, fundamental_frames, min_frames, max_frames;
+
+        if(SUCCEEDED(IAudioClient_QueryInterface(dev->client, &fluid_wasapi_iid_audio_client3, (void **) &client3)))
+        {
+            hr = IAudioClient3_GetSharedModeEnginePeriod(client3, (WAVEFORMATEX *) &dev->format, &default_frames,
+                    &fundamental_frames, &min_frames, &max_frames);
+
+            if(SUCCEEDED(hr))
+            {
+                hr = IAudioClient3_InitializeSharedAudioStream(client3, AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                        min_frames, (WAVEFORMATEX *) &dev->format, NULL);
+            }
+
+            IAudioClient3_Release(client3);
+
+            if(SUCCEEDED(hr))
+            {
+                FLUID_LOG(FLUID_DBG, "WASAPI shared stream with a period of %d frames", (int) min_frames);
+                return hr;
+            }
+        }
+    }
+
+#endif
+
+    /* let the engine convert the format, the buffer is then of a standard period */
+    duration = (REFERENCE_TIME)(dev->period_size * (double) FLUID_WASAPI_REFTIMES_PER_SEC / dev->sample_rate + 0.5);
+
+    return IAudioClient_Initialize(dev->client, AUDCLNT_SHAREMODE_SHARED,
+                                   AUDCLNT_STREAMFLAGS_EVENTCALLBACK
+                                   | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM
+                                   | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY,
+                                   duration, 0, (WAVEFORMATEX *) &dev->format, NULL);
+}
+
+/* Set up the stream on the audio thread. Returns FLUID_OK or FLUID_FAILED. */
+static int
+fluid_wasapi_open(fluid_wasapi_audio_driver_t *dev)
+{
+    IMMDeviceEnumerator *enumerator = NULL;
+    IMMDevice *device = NULL;
+    HRESULT hr;
+
+    hr = CoCreateInstance(&fluid_wasapi_clsid_mmdevice_enumerator, NULL, CLSCTX_ALL,
+                          &fluid_wasapi_iid_mmdevice_enumerator, (void **) &enumerator);
+
+    if(FAILED(hr))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the WASAPI device enumerator: 0x%lx", (unsigned long) hr);
+        goto error_recovery;
+    }
+
+    if(dev->devname != NULL)
+    {
+        device = fluid_wasapi_foreach_device(enumerator, fluid_wasapi_match_device_name, dev->devname);
+
+        if(device == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Audio device '%s' not found", dev->devname);
+            goto error_recovery;
+        }
+    }
+    else if(FAILED(hr = IMMDeviceEnumerator_GetDefaultAudioEndpoint(enumerator, eRender, eMultimedia, &device)))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to get the default audio device: 0x%lx", (unsigned long) hr);
+        goto error_recovery;
+    }
+
+    hr = IMMDevice_Activate(device, &fluid_wasapi_iid_audio_client, CLSCTX_ALL, NULL, (void **) &dev->client);
+
+    if(FAILED(hr))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to activate the WASAPI audio client: 0x%lx", (unsigned long) hr);
+        goto error_recovery;
+    }
+
+    hr = dev->exclusive ? fluid_wasapi_init_exclusive(dev, device) : fluid_wasapi_init_shared(dev);
+
+    if(FAILED(hr))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to initialize the WASAPI %s stream: 0x%lx%s",
+                  dev->exclusive ? "exclusive" : "shared", (unsigned long) hr,
+                  (hr == AUDCLNT_E_UNSUPPORTED_FORMAT) ? ", the sample format or rate is not supported by the device" : "");
+        goto error_recovery;
+    }
+
+    if(FAILED(hr = IAudioClient_GetBufferSize(dev->client, &dev->buffer_frames))
+            || FAILED(hr = IAudioClient_SetEventHandle(dev->client, dev->buffer_ev))
+            || FAILED(hr = IAudioClient_GetService(dev->client, &fluid_wasapi_iid_audio_render_client,
+                           (void **) &dev->render)))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to set up the WASAPI stream: 0x%lx", (unsigned long) hr);
+        goto error_recovery;
+    }
+
+    FLUID_LOG(FLUID_DBG, "WASAPI %s stream with a buffer of %d frames",
+              dev->exclusive ? "exclusive" : "shared", (int) dev->buffer_frames);
+
+    IMMDevice_Release(device);
+    IMMDeviceEnumerator_Release(enumerator);
+
+    return FLUID_OK;
+
+error_recovery:
+
+    if(device != NULL)
+    {
+        IMMDevice_Release(device);
+    }
+
+    if(enumerator != NULL)
+    {
+        IMMDeviceEnumerator_Release(enumerator);
+    }
+
+    return FLUID_FAILED;
+}
+
+/* Render the frames the engine asks for into its buffer */
+static int
+fluid_wasapi_write(fluid_wasapi_audio_driver_t *dev)
+{
+    UINT32 padding = 0, frames;
+    BYTE *data;
+
+    /* the buffer of an exclusive stream is played in turn with the one of the device, whole */
+    if(!dev->exclusive && FAILED(IAudioClient_GetCurrentPadding(dev->client, &padding)))
+    {
+        return FLUID_FAILED;
+    }
+
+    frames = dev->buffer_frames - padding;
+
+    if(frames == 0)
+    {
+        return FLUID_OK;
+    }
+
+    if(FAILED(IAudioRenderClient_GetBuffer(dev->render, frames, &data)))
+    {
+        return FLUID_FAILED;
+    }
+
+    dev->write(dev->synth, frames, data, 0, 2, data, 1, 2);
+
+    return SUCCEEDED(IAudioRenderClient_ReleaseBuffer(dev->render, frames, 0)) ? FLUID_OK : FLUID_FAILED;
+}
+
+static DWORD WINAPI fluid_wasapi_audio_run(LPVOID lpParameter)
+{
+    fluid_wasapi_audio_driver_t *dev = (fluid_wasapi_audio_driver_t *) lpParameter;
+    HANDLE mmcss = NULL;
+    DWORD task_index = 0;
+    HANDLE wait[2];
+    HRESULT com_init;
+    DWORD res;
+
+    com_init = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+    if(FAILED(com_init))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to initialize COM for the WASAPI driver");
+        goto done;
+    }
+
+    if(fluid_wasapi_open(dev) != FLUID_OK)
+    {
+        goto done;
+    }
+
+    /* the buffer given to the engine on start is silence */
+    if(fluid_wasapi_write(dev) != FLUID_OK || FAILED(IAudioClient_Start(dev->client)))
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to start the WASAPI stream");
+        goto done;
+    }
+
+    /* let the multimedia class scheduler run the thread as it does for pro audio applications */
+    mmcss = AvSetMmThreadCharacteristicsA("Pro Audio", &task_index);
+
+    if(mmcss == NULL)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    }
+
+    dev->init_ok = TRUE;
+    SetEvent(dev->init_ev);
+
+    wait[0] = dev->quit_ev;
+    wait[1] = dev->buffer_ev;
+
+    for(;;)
+    {
+        res = WaitForMultipleObjects(2, wait, FALSE, FLUID_WASAPI_TIMEOUT);
+
+        if(res == WAIT_OBJECT_0)
+        {
+            break;
+        }
+
+        if(res != WAIT_OBJECT_0 + 1)
+        {
+            FLUID_LOG(FLUID_ERR, "The WASAPI stream stopped asking for audio");
+            break;
+        }
+
+        if(fluid_wasapi_write(dev) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to write to the WASAPI stream, the device may have been removed");
+            break;
+        }
+    }
+
+    IAudioClient_Stop(dev->client);
+
+done:
+
+    if(mmcss != NULL)
+    {
+        AvRevertMmThreadCharacteristics(mmcss);
+    }
+
+    if(dev->render != NULL)
+    {
+        IAudioRenderClient_Release(dev->render);
+        dev->render = NULL;
+    }
+
+    if(dev->client != NULL)
+    {
+        IAudioClient_Release(dev->client);
+        dev->client = NULL;
+    }
+
+    if(SUCCEEDED(com_init))
+    {
+        CoUninitialize();
+    }
+
+    /* the creator is waiting for the thread to have exited when the stream failed to start */
+    SetEvent(dev->init_ev);
+
+    return 0;
+}
+
+#endif /* WASAPI_SUPPORT */
@@ -22,6 +22,7 @@
 #include "fluid_synth.h"
 #include "fluid_adriver.h"
 #include "fluid_settings.h"
+#include "fluid_render_ahead.h"
 
 #if WAVEOUT_SUPPORT
 
@@ -43,6 +44,9 @@ typedef struct
     fluid_synth_t *synth;
     fluid_audio_callback_t write_ptr;
 
+    fluid_render_ahead_t *ahead;
+    fluid_render_ahead_func_t ahead_write_ptr;
+
     HWAVEOUT hWaveOut;
     WAVEHDR  waveHeader[NB_SOUND_BUFFERS];
 
@@ -103,7 +107,14 @@ static DWORD WINAPI fluid_waveout_synth_thread(void *data)
             }
             else
             {
-                dev->write_ptr(dev->synth, dev->num_frames, pWave->lpData, 0, 2, pWave->lpData, 1, 2);
+                if(dev->ahead != NULL)
+                {
+                    dev->ahead_write_ptr(dev->ahead, dev->num_frames, pWave->lpData, 0, 2, pWave->lpData, 1, 2);
+                }
+                else
+                {
+                    dev->write_ptr(dev->synth, dev->num_frames, pWave->lpData, 0, 2, pWave->lpData, 1, 2);
+                }
 
                 waveOutWrite((HWAVEOUT)msg.wParam, pWave, sizeof(WAVEHDR));
             }
@@ -155,6 +166,7 @@ new_fluid_waveout_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 {
     fluid_waveout_audio_driver_t *dev = NULL;
     fluid_audio_callback_t write_ptr;
+    fluid_render_ahead_func_t ahead_write_ptr;
     double sample_rate;
     int periods, period_size, frequency, sample_size;
     LPSTR ptrBuffer;
@@ -180,6 +192,7 @@ new_fluid_waveout_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
         sample_size = sizeof(float);
         write_ptr   = fluid_synth_write_float;
+        ahead_write_ptr = fluid_render_ahead_write_float;
 
         wfx.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
     }
@@ -189,6 +202,7 @@ new_fluid_waveout_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
         sample_size = sizeof(short);
         write_ptr   = fluid_synth_write_s16;
+        ahead_write_ptr = fluid_render_ahead_write_s16;
 
         wfx.wFormatTag = WAVE_FORMAT_PCM;
     }
@@ -229,8 +243,11 @@ new_fluid_waveout_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
     /* Save copy of other variables */
     dev->write_ptr = write_ptr;
+    dev->ahead_write_ptr = ahead_write_ptr;
     dev->sample_size = sample_size;
 
+    dev->ahead = new_fluid_render_ahead(settings, synth);
+
     /* Calculate the number of frames in a block */
     dev->num_frames = lenBuffer / wfx.nBlockAlign;
 
@@ -378,6 +395,8 @@ void delete_fluid_waveout_audio_driver(fluid_audio_driver_t *d)
         CloseHandle(dev->hQuit);
     }
 
+    delete_fluid_render_ahead(dev->ahead);
+
     HeapFree(GetProcessHeap(), 0, dev);
 }
 
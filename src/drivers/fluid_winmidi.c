@@ -55,6 +55,9 @@ typedef struct
     /* Sysex data buffer */
     unsigned char sysExBuf[MIDI_SYSEX_BUF_COUNT * MIDI_SYSEX_MAX_SIZE];
 
+    /* The time by fluid_utime() the input was started at, the timestamps count from */
+    double start_usec;
+
 } fluid_winmidi_driver_t;
 
 #define msg_type(_m)  ((unsigned char)(_m & 0xf0))
@@ -110,7 +113,8 @@ fluid_winmidi_callback(HMIDIIN hmi, UINT wMsg, DWORD_PTR dwInstance,
             event.param2 = 0;
         }
 
-        (*dev->driver.handler)(dev->driver.data, &event);
+        /* dwParam2 is the time the message was received at in milliseconds since the input was started */
+        fluid_midi_driver_handle_event_at(&dev->driver, &event, dev->start_usec + dwParam2 * 1000.0);
         break;
 
     case MIM_LONGDATA:    /* SYSEX data */
@@ -336,6 +340,8 @@ new_fluid_winmidi_driver(fluid_settings_t *settings,
     }
 
     /* Start the MIDI input interface */
+    dev->start_usec = fluid_utime();
+
     if(midiInStart(dev->hmidiin) != MMSYSERR_NOERROR)
     {
         FLUID_LOG(FLUID_ERR, "Failed to start the MIDI input. MIDI input not available.");
@@ -42,6 +42,10 @@
 #include <SDL.h>
 #endif
 
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
 void print_usage(void);
 void print_help(fluid_settings_t *settings);
 void print_welcome(void);
@@ -291,15 +295,371 @@ fast_render_loop(fluid_settings_t *settings, fluid_synth_t *synth, fluid_player_
         return;
     }
 
-    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    fluid_file_renderer_process_player(renderer, player);
+
+    delete_fluid_file_renderer(renderer);
+}
+
+/* Render the first MIDI file of the player in time segments, by several threads */
+static void
+fast_render_segments(fluid_synth_t *synth, fluid_player_t *player, int jobs)
+{
+    fluid_file_renderer_t *renderer;
+
+    renderer = new_fluid_file_renderer(synth);
+
+    if(!renderer)
     {
-        if(fluid_file_renderer_process_block(renderer) != FLUID_OK)
+        return;
+    }
+
+    if(fluid_file_renderer_process_segments(renderer, player, jobs) != FLUID_OK)
+    {
+        fprintf(stderr, "Failed to render the MIDI file in segments\n");
+    }
+
+    delete_fluid_file_renderer(renderer);
+}
+
+/* MIDI files rendered to separate audio files by several threads, see fast_render_batch() */
+typedef struct
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;         /* the synth that loaded the SoundFonts shared by all jobs */
+    char **files;                 /* the MIDI files to render */
+    int count;
+    fluid_atomic_int_t next;      /* index of the next MIDI file to render */
+    fluid_atomic_int_t failed;    /* number of MIDI files that could not be rendered */
+    const char *dir;              /* directory receiving the audio files */
+    const char *ext;              /* extension of the audio files */
+    int quiet;
+    fluid_mutex_t mutex;          /* serializes the creation and deletion of synths and renderers */
+} fast_render_batch_t;
+
+/* Return the name of the audio file a MIDI file is rendered to by fast_render_batch() */
+static char *
+fast_render_batch_filename(fast_render_batch_t *batch, const char *midifile)
+{
+    const char *name = midifile, *s;
+    char *filename;
+    int len, size;
+
+    for(s = midifile; *s != '\0'; s++)
+    {
+#ifdef WIN32
+        if(*s == '/' || *s == '\\')
+#else
+        if(*s == '/')
+#endif
         {
-            break;
+            name = s + 1;
         }
     }
 
+    s = FLUID_STRRCHR(name, '.');
+    len = (s != NULL && s != name) ? (int)(s - name) : (int)FLUID_STRLEN(name);
+
+    size = FLUID_STRLEN(batch->dir) + 1 + len + 1 + FLUID_STRLEN(batch->ext) + 1;
+    filename = malloc(size);
+
+    if(filename != NULL)
+    {
+        FLUID_SNPRINTF(filename, size, "%s/%.*s.%s", batch->dir, len, name, batch->ext);
+    }
+
+    return filename;
+}
+
+/* Render one MIDI file of a batch with a synth of its own, which borrows the SoundFonts of batch->synth */
+static int
+fast_render_batch_file(fast_render_batch_t *batch, const char *midifile)
+{
+    fluid_synth_t *synth;
+    fluid_player_t *player = NULL;
+    fluid_file_renderer_t *renderer = NULL;
+    char *filename;
+    int i, count, result = FLUID_FAILED;
+
+    filename = fast_render_batch_filename(batch, midifile);
+
+    if(filename == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    fluid_mutex_lock(batch->mutex);
+    synth = new_fluid_synth(batch->settings);
+
+    if(synth != NULL)
+    {
+        /* the SoundFont stack of the batch, in the same order */
+        count = fluid_synth_sfcount(batch->synth);
+
+        for(i = count - 1; i >= 0; i--)
+        {
+            fluid_synth_add_sfont(synth, fluid_synth_get_sfont(batch->synth, i));
+        }
+
+        player = new_fluid_player(synth);
+
+        fluid_settings_setstr(batch->settings, "audio.file.name", filename);
+        renderer = new_fluid_file_renderer(synth);
+    }
+
+    fluid_mutex_unlock(batch->mutex);
+
+    if(player != NULL && renderer != NULL
+            && fluid_player_add(player, midifile) == FLUID_OK
+            && fluid_player_play(player) == FLUID_OK)
+    {
+        if(!batch->quiet)
+        {
+            printf("Rendering '%s' to '%s'..\n", midifile, filename);
+        }
+
+        result = fluid_file_renderer_process_player(renderer, player);
+    }
+
+    if(result != FLUID_OK)
+    {
+        fprintf(stderr, "Failed to render the MIDI file '%s'\n", midifile);
+    }
+
+    fluid_mutex_lock(batch->mutex);
     delete_fluid_file_renderer(renderer);
+    delete_fluid_player(player);
+
+    if(synth != NULL)
+    {
+        /* give the SoundFonts back, so that deleting the synth leaves them alone */
+        for(i = 0; i < fluid_synth_count_midi_channels(synth); i++)
+        {
+            fluid_synth_unset_program(synth, i);
+        }
+
+        while(fluid_synth_sfcount(synth) > 0)
+        {
+            fluid_synth_remove_sfont(synth, fluid_synth_get_sfont(synth, 0));
+        }
+
+        delete_fluid_synth(synth);
+    }
+
+    fluid_mutex_unlock(batch->mutex);
+
+    free(filename);
+    return result;
+}
+
+static fluid_thread_return_t
+fast_render_batch_run(void *data)
+{
+    fast_render_batch_t *batch = data;
+    int i;
+
+    while((i = fluid_atomic_int_exchange_and_add(&batch->next, 1)) < batch->count)
+    {
+        if(fast_render_batch_file(batch, batch->files[i]) != FLUID_OK)
+        {
+            fluid_atomic_int_inc(&batch->failed);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Render each MIDI file to an audio file of the same name in the directory
+ * given by audio.file.name, with the given number of threads. Every MIDI file
+ * is played by a synth of its own, which share the SoundFonts loaded by synth,
+ * so that they are only loaded once. Returns the number of files that could
+ * not be rendered.
+ */
+static int
+fast_render_batch(fluid_settings_t *settings, fluid_synth_t *synth,
+                  char **files, int count, int jobs, int quiet)
+{
+    fast_render_batch_t batch;
+    fluid_thread_t **threads;
+    char *dir = NULL, *type = NULL;
+    int i;
+
+    if(jobs > count)
+    {
+        jobs = count;
+    }
+
+    threads = malloc(jobs * sizeof(*threads));
+
+    if(threads == NULL || fluid_settings_dupstr(settings, "audio.file.name", &dir) != FLUID_OK || dir == NULL)
+    {
+        free(threads);
+        return count;
+    }
+
+    /* the file type determines the extension, the file renderer writes raw audio without libsndfile */
+    if(fluid_settings_dupstr(settings, "audio.file.type", &type) != FLUID_OK)
+    {
+        type = NULL;
+    }
+
+    FLUID_MEMSET(&batch, 0, sizeof(batch));
+    batch.settings = settings;
+    batch.synth = synth;
+    batch.files = files;
+    batch.count = count;
+    batch.dir = dir;
+    batch.ext = (type == NULL) ? "raw" : (FLUID_STRCMP(type, "auto") == 0) ? "wav" : type;
+    batch.quiet = quiet;
+    fluid_mutex_init(batch.mutex);
+
+    if(!quiet)
+    {
+        printf("Rendering %d MIDI files to '%s' with %d threads..\n", count, dir, jobs);
+    }
+
+    /* the library's thread functions are private, use the GLib ones like fluid_sys.c does */
+    for(i = 0; i < jobs - 1; i++)
+    {
+#if NEW_GLIB_THREAD_API
+        threads[i] = g_thread_try_new("render-job", fast_render_batch_run, &batch, NULL);
+#else
+        threads[i] = g_thread_create(fast_render_batch_run, &batch, TRUE, NULL);
+#endif
+    }
+
+    /* this thread is the last job, it takes over if threads could not be created */
+    fast_render_batch_run(&batch);
+
+    for(i = 0; i < jobs - 1; i++)
+    {
+        if(threads[i] != NULL)
+        {
+            g_thread_join(threads[i]);
+        }
+    }
+
+    fluid_mutex_destroy(batch.mutex);
+    free(threads);
+    FLUID_FREE(type);
+    FLUID_FREE(dir);
+
+    return fluid_atomic_int_get(&batch.failed);
+}
+
+/* qsort() comparison of block durations */
+static int
+benchmark_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Render the MIDI files of the player like fast rendering does, in blocks of
+ * audio.period-size frames, without writing the audio anywhere. The duration
+ * of each block is the one measured by the synth for its DSP load. Prints the
+ * realtime factor, the block latency percentiles, the voice statistics and the
+ * peak memory use of the process.
+ */
+static int
+benchmark_loop(fluid_settings_t *settings, fluid_synth_t *synth, fluid_player_t *player)
+{
+    double *durations = NULL, *d, total = 0, audio, deadline, voices = 0, rate;
+    float *left, *right;
+    int period, count = 0, size = 0;
+#ifdef HAVE_SYS_RESOURCE_H
+    struct rusage usage;
+#endif
+
+    fluid_settings_getint(settings, "audio.period-size", &period);
+    fluid_settings_getnum(settings, "synth.sample-rate", &rate);
+
+    left = malloc(period * sizeof(*left));
+    right = malloc(period * sizeof(*right));
+
+    if(left == NULL || right == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        goto error;
+    }
+
+    fluid_synth_reset_stats(synth);
+
+    /* the duration of a block, in microseconds, at 100 percent DSP load */
+    deadline = period * 1000000.0 / rate;
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        if(count == size)
+        {
+            size = (size == 0) ? 4096 : 2 * size;
+            d = realloc(durations, size * sizeof(*durations));
+
+            if(d == NULL)
+            {
+                fprintf(stderr, "Out of memory\n");
+                goto error;
+            }
+
+            durations = d;
+        }
+
+        if(fluid_synth_write_float(synth, period, left, 0, 1, right, 0, 1) != FLUID_OK)
+        {
+            fprintf(stderr, "Failed to render the audio\n");
+            goto error;
+        }
+
+        durations[count] = fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_DSP_LOAD) * deadline / 100.0;
+        total += durations[count++];
+        voices += fluid_synth_get_active_voice_count(synth);
+    }
+
+    if(count == 0)
+    {
+        fprintf(stderr, "Nothing was rendered\n");
+        goto error;
+    }
+
+    qsort(durations, count, sizeof(*durations), benchmark_compare);
+    audio = count * deadline;
+
+    printf("Rendered %.3f s of audio in %.3f s: realtime factor %.2f\n",
+           audio / 1000000.0, total / 1000000.0, (total > 0) ? audio / total : 0);
+    printf("Block latency (%d frames, %.0f us deadline): p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           period, deadline, durations[(count - 1) / 2], durations[(count - 1) * 99 / 100],
+           durations[count - 1]);
+    printf("Voices: peak %.0f, average %.1f, stolen %.0f\n",
+           fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_VOICES), voices / count,
+           fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_STOLEN_VOICES));
+    printf("Blocks over the deadline: %.0f of %d\n",
+           fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_XRUNS), count);
+
+#ifdef HAVE_SYS_RESOURCE_H
+
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+        /* in bytes rather than kilobytes */
+        usage.ru_maxrss /= 1024;
+#endif
+        printf("Peak memory: %ld kB\n", (long)usage.ru_maxrss);
+    }
+
+#endif
+
+    free(durations);
+    free(left);
+    free(right);
+    return FLUID_OK;
+
+error:
+    free(durations);
+    free(left);
+    free(right);
+    return FLUID_FAILED;
 }
 
 /*
@@ -347,7 +707,10 @@ int main(int argc, char **argv)
     int audio_channels = 0;
     int dump = 0;
     int fast_render = 0;
-    static const char optchars[] = "a:C:c:dE:f:F:G:g:hijK:L:lm:nO:o:p:qR:r:sT:Vvz:";
+    int render_jobs = 0;
+    int render_segments = 0;
+    int benchmark = 0;
+    static const char optchars[] = "a:BC:c:dE:f:F:G:g:hiJ:jK:L:lm:nO:o:p:qR:r:SsT:Vvz:";
 #ifdef HAVE_LASH
     int connect_lash = 1;
     int enabled_lash = 0;		/* set to TRUE if lash gets enabled */
@@ -391,6 +754,7 @@ int main(int argc, char **argv)
             {"audio-file-format", 1, 0, 'O'},
             {"audio-file-type", 1, 0, 'T'},
             {"audio-groups", 1, 0, 'G'},
+            {"benchmark", 0, 0, 'B'},
             {"chorus", 1, 0, 'C'},
             {"connect-jack-outputs", 0, 0, 'j'},
             {"disable-lash", 0, 0, 'l'},
@@ -398,6 +762,7 @@ int main(int argc, char **argv)
             {"fast-render", 1, 0, 'F'},
             {"gain", 1, 0, 'g'},
             {"help", 0, 0, 'h'},
+            {"jobs", 1, 0, 'J'},
             {"load-config", 1, 0, 'f'},
             {"midi-channels", 1, 0, 'K'},
             {"midi-driver", 1, 0, 'm'},
@@ -408,6 +773,7 @@ int main(int argc, char **argv)
             {"quiet", 0, 0, 'q'},
             {"reverb", 1, 0, 'R'},
             {"sample-rate", 1, 0, 'r'},
+            {"segments", 0, 0, 'S'},
             {"server", 0, 0, 's'},
             {"verbose", 0, 0, 'v'},
             {"version", 0, 0, 'V'},
@@ -495,6 +861,10 @@ int main(int argc, char **argv)
 
             break;
 
+        case 'B':
+            benchmark = 1;
+            break;
+
         case 'C':
             if((optarg != NULL) && ((FLUID_STRCMP(optarg, "0") == 0) || (FLUID_STRCMP(optarg, "no") == 0)))
             {
@@ -566,6 +936,17 @@ int main(int argc, char **argv)
             interactive = 0;
             break;
 
+        case 'J':
+            render_jobs = atoi(optarg);
+
+            if(render_jobs < 1)
+            {
+                fprintf(stderr, "Invalid number of jobs: %s\n", optarg);
+                goto cleanup;
+            }
+
+            break;
+
         case 'j':
             fluid_settings_setint(settings, "audio.jack.autoconnect", 1);
             fluid_settings_setint(settings, "midi.autoconnect", 1);
@@ -668,6 +1049,10 @@ int main(int argc, char **argv)
             fluid_settings_setnum(settings, "synth.sample-rate", atof(optarg));
             break;
 
+        case 'S':
+            render_segments = 1;
+            break;
+
         case 's':
 #ifdef NETWORK_SUPPORT
             with_server = 1;
@@ -783,6 +1168,14 @@ int main(int argc, char **argv)
         fluid_settings_setint(settings, "synth.audio-groups", audio_groups);
     }
 
+    /* benchmarking renders like fast rendering, without writing any file */
+    if(benchmark)
+    {
+        fast_render = 1;
+        render_jobs = 0;
+        render_segments = 0;
+    }
+
     if(fast_render)
     {
         midi_in = 0;		/* disable MIDI driver creation */
@@ -792,6 +1185,19 @@ int main(int argc, char **argv)
 #endif
         fluid_settings_setstr(settings, "player.timing-source", "sample");
         fluid_settings_setint(settings, "synth.lock-memory", 0);
+
+        /* the SoundFonts are shared by the synths of the jobs, they must not load samples on demand */
+        if(render_jobs > 0 || render_segments)
+        {
+            fluid_settings_setint(settings, "synth.dynamic-sample-loading", 0);
+            fluid_settings_setint(settings, "synth.lazy-preset-loading", 0);
+        }
+
+        /* a single MIDI file rendered in segments is played by the player, not in a batch */
+        if(render_segments && render_jobs == 0)
+        {
+            render_jobs = 1;
+        }
     }
 
     /* create the synthesizer */
@@ -850,8 +1256,8 @@ int main(int argc, char **argv)
         }
     }
 
-    /* play the midi files, if any */
-    for(i = arg1; i < argc; i++)
+    /* play the midi files, if any (each of them is played by a synth of its own in a batch) */
+    for(i = arg1; i < argc && !(fast_render && render_jobs > 0 && !render_segments); i++)
     {
         if((argv[i][0] != '-') && fluid_is_midifile(argv[i]))
         {
@@ -877,7 +1283,7 @@ int main(int argc, char **argv)
     }
 
     /* start the player */
-    if(player != NULL)
+    if(player != NULL || (fast_render && render_jobs > 0 && !render_segments))
     {
         /* Try to load the default soundfont, if no soundfont specified */
         if(fluid_synth_get_sfont(synth, 0) == NULL)
@@ -897,7 +1303,10 @@ int main(int argc, char **argv)
             FLUID_FREE(s);
         }
 
-        fluid_player_play(player);
+        if(player != NULL)
+        {
+            fluid_player_play(player);
+        }
     }
 
     /* try to load and execute the user or system configuration file */
@@ -958,8 +1367,51 @@ int main(int argc, char **argv)
 
 #endif
 
+    /* benchmarking the rendering of the MIDI files, if requested */
+    if(benchmark)
+    {
+        if(player == NULL)
+        {
+            fprintf(stderr, "No midi file specified!\n");
+            goto cleanup;
+        }
+
+        if(benchmark_loop(settings, synth, player) != FLUID_OK)
+        {
+            goto cleanup;
+        }
+    }
+    /* fast rendering audio files in parallel, if requested */
+    else if(fast_render && render_jobs > 0 && !render_segments)
+    {
+        char **files = malloc(argc * sizeof(*files));
+        int count = 0;
+
+        for(i = arg1; files != NULL && i < argc; i++)
+        {
+            if((argv[i][0] != '-') && fluid_is_midifile(argv[i]))
+            {
+                files[count++] = argv[i];
+            }
+        }
+
+        if(count == 0)
+        {
+            fprintf(stderr, "No midi file specified!\n");
+            free(files);
+            goto cleanup;
+        }
+
+        count = fast_render_batch(settings, synth, files, count, render_jobs, quiet);
+        free(files);
+
+        if(count > 0)
+        {
+            goto cleanup;
+        }
+    }
     /* fast rendering audio file, if requested */
-    if(fast_render)
+    else if(fast_render)
     {
         char *filename;
 
@@ -979,7 +1431,14 @@ int main(int argc, char **argv)
             FLUID_FREE(filename);
         }
 
-        fast_render_loop(settings, synth, player);
+        if(render_segments)
+        {
+            fast_render_segments(synth, player, render_jobs);
+        }
+        else
+        {
+            fast_render_loop(settings, synth, player);
+        }
     }
     else /* start the synthesis thread */
     {
@@ -1089,6 +1548,7 @@ void print_configure()
          "double"
 #endif
         );
+    printf("DSP kernels=%s\n", fluid_version_dsp_str());
 }
 
 /*
@@ -1109,6 +1569,9 @@ print_help(fluid_settings_t *settings)
     printf(" -a, --audio-driver=[label]\n"
            "    The name of the audio driver to use.\n"
            "    Valid values: %s\n", audio_options ? audio_options : "ERROR");
+    printf(" -B, --benchmark\n"
+           "    Render the MIDI files as fast as possible without writing the audio,\n"
+           "    and print the realtime factor, block latencies, voice statistics and peak memory\n");
     printf(" -c, --audio-bufcount=[count]\n"
            "    Number of audio buffers\n");
     printf(" -C, --chorus\n"
@@ -1131,6 +1594,9 @@ print_help(fluid_settings_t *settings)
            "    Don't read commands from the shell [default = yes]\n");
     printf(" -j, --connect-jack-outputs\n"
            "    Attempt to connect the jack outputs to the physical ports\n");
+    printf(" -J, --jobs=[num]\n"
+           "    Render the MIDI files given with -F with [num] threads, each of them\n"
+           "    to a file of its own in the directory given with -F\n");
     printf(" -K, --midi-channels=[num]\n"
            "    The number of midi channels [default = 16]\n");
 #ifdef HAVE_LASH
@@ -1157,6 +1623,9 @@ print_help(fluid_settings_t *settings)
            "    Set the sample rate\n");
     printf(" -R, --reverb\n"
            "    Turn the reverb on or off [0|1|yes|no, default = on]\n");
+    printf(" -S, --segments\n"
+           "    Render a single MIDI file given with -F in time segments, by the\n"
+           "    threads given with -J, to the file given with -F\n");
     printf(" -s, --server\n"
            "    Start FluidSynth as a server process\n");
     printf(" -T, --audio-file-type\n"
@@ -1,21 +1,30 @@
 
+#ifdef ENABLE_RUNTIME_TABLES
+/* compiled into fluid_conv.c, see the enable-runtime-tables build option */
+typedef fluid_real_t fluid_table_real_t;
+#else
 #include "utils/fluid_conv_tables.h"
 #include "make_tables.h"
 
+typedef double fluid_table_real_t;
+#endif
+
 
 /* conversion tables */
-static double fluid_ct2hz_tab[FLUID_CENTS_HZ_SIZE];
-static double fluid_cb2amp_tab[FLUID_CB_AMP_SIZE];
-static double fluid_concave_tab[FLUID_VEL_CB_SIZE];
-static double fluid_convex_tab[FLUID_VEL_CB_SIZE];
-static double fluid_pan_tab[FLUID_PAN_SIZE];
+static fluid_table_real_t fluid_ct2hz_tab[FLUID_CENTS_HZ_SIZE];
+static fluid_table_real_t fluid_cb2amp_tab[FLUID_CB_AMP_SIZE];
+static fluid_table_real_t fluid_concave_tab[FLUID_VEL_CB_SIZE];
+static fluid_table_real_t fluid_convex_tab[FLUID_VEL_CB_SIZE];
+static fluid_table_real_t fluid_pan_tab[FLUID_PAN_SIZE];
+static fluid_table_real_t fluid_filter_sin_tab[FLUID_FILTER_TRIG_SIZE];
+static fluid_table_real_t fluid_filter_omc_tab[FLUID_FILTER_TRIG_SIZE];
 
 /*
  * void fluid_synth_init
  *
  * Does all the initialization for this module.
  */
-static void fluid_conversion_config(void)
+void fluid_conversion_config(void)
 {
     int i;
     double x;
@@ -66,8 +75,18 @@ static void fluid_conversion_config(void)
     {
         fluid_pan_tab[i] = sin(i * x);
     }
+
+    /* sin(omega) and 1 - cos(omega) of the filter cutoff frequencies, the latter as
+     * 2 * sin^2(omega / 2) to keep its precision at low frequencies */
+    for(i = 0; i < FLUID_FILTER_TRIG_SIZE; i++)
+    {
+        x = M_PI * pow(2.0, (FLUID_FILTER_NCT_MIN + i * FLUID_FILTER_NCT_STEP) / 1200.0);
+        fluid_filter_sin_tab[i] = sin(2.0 * x);
+        fluid_filter_omc_tab[i] = 2.0 * sin(x) * sin(x);
+    }
 }
 
+#ifndef ENABLE_RUNTIME_TABLES
 
 void gen_conv_table(FILE *fp)
 {
@@ -80,5 +99,7 @@ void gen_conv_table(FILE *fp)
     EMIT_ARRAY(fp, fluid_concave_tab);
     EMIT_ARRAY(fp, fluid_convex_tab);
     EMIT_ARRAY(fp, fluid_pan_tab);
+    EMIT_ARRAY(fp, fluid_filter_sin_tab);
+    EMIT_ARRAY(fp, fluid_filter_omc_tab);
 }
-
+#endif
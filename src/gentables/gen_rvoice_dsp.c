@@ -1,19 +1,33 @@
 
+#ifdef ENABLE_RUNTIME_TABLES
+/* compiled into fluid_rvoice_dsp.c, see the enable-runtime-tables build option */
+typedef fluid_real_t fluid_table_real_t;
+#else
 #include "rvoice/fluid_rvoice_dsp_tables.h"
 #include "make_tables.h"
 
+typedef double fluid_table_real_t;
+#endif
+
 /* Linear interpolation table (2 coefficients centered on 1st) */
-static double interp_coeff_linear[FLUID_INTERP_MAX][2];
+static fluid_table_real_t interp_coeff_linear[FLUID_INTERP_MAX][2];
 
 /* 4th order (cubic) interpolation table (4 coefficients centered on 2nd) */
-static double interp_coeff[FLUID_INTERP_MAX][4];
+static fluid_table_real_t interp_coeff[FLUID_INTERP_MAX][4];
 
 /* 7th order interpolation (7 coefficients centered on 3rd) */
-static double sinc_table7[FLUID_INTERP_MAX][SINC_INTERP_ORDER];
-
+static fluid_table_real_t sinc_table7[FLUID_SINC_INTERP_MAX][SINC_INTERP_ORDER];
+
+#ifdef ENABLE_RUNTIME_TABLES
+/* for the single precision block kernels, see synth.dsp-precision */
+static float interp_coeff_linear_float[FLUID_INTERP_MAX][2];
+static float interp_coeff_float[FLUID_INTERP_MAX][4];
+static float sinc_table7_float[FLUID_SINC_INTERP_MAX][SINC_INTERP_ORDER];
+#else
 static double cb_interp_coeff_linear(int y, int x) { return interp_coeff_linear[y][x]; }
 static double cb_interp_coeff       (int y, int x) { return interp_coeff[y][x]; }
 static double cb_sinc_table7        (int y, int x) { return sinc_table7[y][x]; }
+#endif
 
 /* Initializes interpolation tables */
 void fluid_rvoice_dsp_config(void)
@@ -44,11 +58,11 @@ void fluid_rvoice_dsp_config(void)
     for(i = 0; i < SINC_INTERP_ORDER; i++)
     {
         /* i2: Offset in terms of fractional samples ('subsamples') */
-        for(i2 = 0; i2 < FLUID_INTERP_MAX; i2++)
+        for(i2 = 0; i2 < FLUID_SINC_INTERP_MAX; i2++)
         {
             /* center on middle of table */
             i_shifted = (double)i - ((double)SINC_INTERP_ORDER / 2.0)
-                        + (double)i2 / (double)FLUID_INTERP_MAX;
+                        + (double)i2 / (double)FLUID_SINC_INTERP_MAX;
 
             /* sinc(0) cannot be calculated straightforward (limit needed for 0/0) */
             if(fabs(i_shifted) > 0.000001)
@@ -63,11 +77,35 @@ void fluid_rvoice_dsp_config(void)
                 v = 1.0;
             }
 
-            sinc_table7[FLUID_INTERP_MAX - i2 - 1][i] = v;
+            sinc_table7[FLUID_SINC_INTERP_MAX - i2 - 1][i] = v;
         }
     }
+
+#ifdef ENABLE_RUNTIME_TABLES
+
+    for(i = 0; i < FLUID_INTERP_MAX; i++)
+    {
+        for(i2 = 0; i2 < 4; i2++)
+        {
+            interp_coeff_float[i][i2] = (float)interp_coeff[i][i2];
+        }
+
+        interp_coeff_linear_float[i][0] = (float)interp_coeff_linear[i][0];
+        interp_coeff_linear_float[i][1] = (float)interp_coeff_linear[i][1];
+    }
+
+    for(i = 0; i < FLUID_SINC_INTERP_MAX; i++)
+    {
+        for(i2 = 0; i2 < SINC_INTERP_ORDER; i2++)
+        {
+            sinc_table7_float[i][i2] = (float)sinc_table7[i][i2];
+        }
+    }
+
+#endif
 }
 
+#ifndef ENABLE_RUNTIME_TABLES
 
 void gen_rvoice_table_dsp (FILE *fp)
 {
@@ -77,5 +115,11 @@ void gen_rvoice_table_dsp (FILE *fp)
     /* Emit the matrices */
     emit_matrix(fp, "interp_coeff_linear", cb_interp_coeff_linear, FLUID_INTERP_MAX, 2);
     emit_matrix(fp, "interp_coeff",        cb_interp_coeff,        FLUID_INTERP_MAX, 4);
-    emit_matrix(fp, "sinc_table7",         cb_sinc_table7,         FLUID_INTERP_MAX, 7);
+    emit_matrix(fp, "sinc_table7",         cb_sinc_table7,         FLUID_SINC_INTERP_MAX, 7);
+
+    /* for the single precision block kernels, see synth.dsp-precision */
+    emit_matrix_float(fp, "interp_coeff_linear_float", cb_interp_coeff_linear, FLUID_INTERP_MAX, 2);
+    emit_matrix_float(fp, "interp_coeff_float",        cb_interp_coeff,        FLUID_INTERP_MAX, 4);
+    emit_matrix_float(fp, "sinc_table7_float",         cb_sinc_table7,         FLUID_SINC_INTERP_MAX, 7);
 }
+#endif
@@ -3,7 +3,8 @@
 
 static void write_value(FILE *fp, double val, int i)
 {
-    fprintf(fp, "    %.15e%c    /* %d */\n",
+    /* 17 significant digits, so that the tables equal the ones computed with enable-runtime-tables */
+    fprintf(fp, "    %.16e%c    /* %d */\n",
         val,
         ',',
         i
@@ -24,12 +25,12 @@ void emit_array(FILE *fp, const char *tblname, const double *tbl, int size)
     fprintf(fp, "};\n\n");
 }
 
-/* Emit a matrix of real numbers */
-void emit_matrix(FILE *fp, const char *tblname, emit_matrix_cb tbl_cb, int sizeh, int sizel)
+/* Emit a matrix of numbers of the given C type */
+static void emit_matrix_type(FILE *fp, const char *type, const char *tblname, emit_matrix_cb tbl_cb, int sizeh, int sizel)
 {
     int i, j;
 
-    fprintf(fp, "static const fluid_real_t %s[%d][%d] = {\n    {\n", tblname, sizeh, sizel);
+    fprintf(fp, "static const %s %s[%d][%d] = {\n    {\n", type, tblname, sizeh, sizel);
 
     for (i = 0; i < sizeh; i++)
     {
@@ -46,6 +47,18 @@ void emit_matrix(FILE *fp, const char *tblname, emit_matrix_cb tbl_cb, int sizeh
     }
 }
 
+/* Emit a matrix of real numbers */
+void emit_matrix(FILE *fp, const char *tblname, emit_matrix_cb tbl_cb, int sizeh, int sizel)
+{
+    emit_matrix_type(fp, "fluid_real_t", tblname, tbl_cb, sizeh, sizel);
+}
+
+/* Emit a matrix of single precision numbers */
+void emit_matrix_float(FILE *fp, const char *tblname, emit_matrix_cb tbl_cb, int sizeh, int sizel)
+{
+    emit_matrix_type(fp, "float", tblname, tbl_cb, sizeh, sizel);
+}
+
 static void open_table(FILE**fp, const char* dir, const char* file)
 {
     char buf[2048] = {0};
@@ -13,6 +13,10 @@
 /* callback for general access to matrices */
 typedef double (*emit_matrix_cb)(int y, int x);
 
+/* Calculators, also compiled into the library with enable-runtime-tables */
+void fluid_conversion_config(void);
+void fluid_rvoice_dsp_config(void);
+
 /* Generators */
 void gen_rvoice_table_dsp(FILE *fp);
 void gen_conv_table(FILE *fp);
@@ -23,4 +27,7 @@ void emit_array(FILE *fp, const char *tblname, const double *tbl, int size);
 /* Emit a matrix of real numbers */
 void emit_matrix(FILE *fp, const char *tblname, emit_matrix_cb tbl_cb, int sizeh, int sizel);
 
+/* Emit a matrix of single precision numbers */
+void emit_matrix_float(FILE *fp, const char *tblname, emit_matrix_cb tbl_cb, int sizeh, int sizel);
+
 #endif
@@ -35,37 +35,48 @@ static long fluid_getlength(unsigned char *s);
  * Returns NULL if there was an error reading or allocating memory.
  */
 typedef FILE  *fluid_file;
+static int fluid_file_get_length(fluid_file fp, size_t *length);
 static char *fluid_file_read_full(fluid_file fp, size_t *length);
 static void fluid_midi_event_set_sysex_LOCAL(fluid_midi_event_t *evt, int type, void *data, int size, int dynamic);
 static void fluid_midi_event_get_sysex_LOCAL(fluid_midi_event_t *evt, void **data, int *size);
 #define READ_FULL_INITIAL_BUFLEN 1024
 
+/* Longest time the sample timer of the player sleeps until the next event, in msec,
+ * so that its current tick doesn't lag behind too much */
+#define FLUID_PLAYER_MAX_SLEEP_MSEC 10
+
 static fluid_track_t *new_fluid_track(int num);
 static void delete_fluid_track(fluid_track_t *track);
 static int fluid_track_set_name(fluid_track_t *track, char *name);
 static int fluid_track_add_event(fluid_track_t *track, fluid_midi_event_t *evt);
-static fluid_midi_event_t *fluid_track_next_event(fluid_track_t *track);
-static int fluid_track_get_duration(fluid_track_t *track);
-static int fluid_track_reset(fluid_track_t *track);
-
-static void fluid_track_send_events(fluid_track_t *track,
-                                   fluid_synth_t *synth,
-                                   fluid_player_t *player,
-                                   unsigned int ticks);
 
 
-static int fluid_player_add_track(fluid_player_t *player, fluid_track_t *track);
+static int fluid_player_song_add_track(fluid_player_song_t *song, fluid_track_t *track);
+static int fluid_player_song_build_events(fluid_player_song_t *song);
+static int fluid_player_song_load(fluid_player_song_t *song, fluid_playlist_item *item);
+static void fluid_player_song_free(fluid_player_song_t *song);
+static void fluid_player_free_events(fluid_player_t *player);
+static void fluid_player_send_events(fluid_player_t *player, unsigned int ticks);
+static void fluid_player_send_events_exact(fluid_player_t *player);
+static void fluid_player_seek_events(fluid_player_t *player, unsigned int ticks);
 static int fluid_player_callback(void *data, unsigned int msec);
+static void fluid_player_look_ahead(fluid_player_t *player);
+static void fluid_player_release_lookahead(fluid_player_t *player, int all);
+static int fluid_player_queue_lookahead(fluid_player_t *player, const fluid_player_lookahead_request_t *request);
+static void fluid_player_release_presets(fluid_player_t *player, int all, int event);
+static fluid_thread_return_t fluid_player_lookahead_run(void *data);
 static int fluid_player_reset(fluid_player_t *player);
 static int fluid_player_load(fluid_player_t *player, fluid_playlist_item *item);
 static void fluid_player_advancefile(fluid_player_t *player);
 static void fluid_player_playlist_load(fluid_player_t *player, unsigned int msec);
+static void fluid_player_request_preload(fluid_player_t *player);
+static fluid_thread_return_t fluid_player_preload_run(void *data);
 
 static fluid_midi_file *new_fluid_midi_file(const char *buffer, size_t length);
 static void delete_fluid_midi_file(fluid_midi_file *mf);
 static int fluid_midi_file_read_mthd(fluid_midi_file *midifile);
-static int fluid_midi_file_load_tracks(fluid_midi_file *midifile, fluid_player_t *player);
-static int fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_t *player, int num);
+static int fluid_midi_file_load_tracks(fluid_midi_file *midifile, fluid_player_song_t *song);
+static int fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_song_t *song, int num);
 static int fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track);
 static int fluid_midi_file_read_varlen(fluid_midi_file *mf);
 static int fluid_midi_file_getc(fluid_midi_file *mf);
@@ -158,25 +169,36 @@ new_fluid_midi_file(const char *buffer, size_t length)
     return mf;
 }
 
-static char *
-fluid_file_read_full(fluid_file fp, size_t *length)
+static int
+fluid_file_get_length(fluid_file fp, size_t *length)
 {
-    size_t buflen;
-    char *buffer;
-    size_t n;
-
-    /* Work out the length of the file in advance */
     if(FLUID_FSEEK(fp, 0, SEEK_END) != 0)
     {
         FLUID_LOG(FLUID_ERR, "File load: Could not seek within file");
-        return NULL;
+        return FLUID_FAILED;
     }
 
-    buflen = ftell(fp);
+    *length = ftell(fp);
 
     if(FLUID_FSEEK(fp, 0, SEEK_SET) != 0)
     {
         FLUID_LOG(FLUID_ERR, "File load: Could not seek within file");
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
+static char *
+fluid_file_read_full(fluid_file fp, size_t *length)
+{
+    size_t buflen;
+    char *buffer;
+    size_t n;
+
+    /* Work out the length of the file in advance */
+    if(fluid_file_get_length(fp, &buflen) != FLUID_OK)
+    {
         return NULL;
     }
 
@@ -382,13 +404,13 @@ fluid_midi_file_read_mthd(fluid_midi_file *mf)
  * fluid_midi_file_load_tracks
  */
 int
-fluid_midi_file_load_tracks(fluid_midi_file *mf, fluid_player_t *player)
+fluid_midi_file_load_tracks(fluid_midi_file *mf, fluid_player_song_t *song)
 {
     int i;
 
     for(i = 0; i < mf->ntracks; i++)
     {
-        if(fluid_midi_file_read_track(mf, player, i) != FLUID_OK)
+        if(fluid_midi_file_read_track(mf, song, i) != FLUID_OK)
         {
             return FLUID_FAILED;
         }
@@ -472,7 +494,7 @@ fluid_midi_file_eot(fluid_midi_file *mf)
  * fluid_midi_file_read_track
  */
 int
-fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_t *player, int num)
+fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_song_t *song, int num)
 {
     fluid_track_t *track;
     unsigned char id[5], length[5];
@@ -534,7 +556,7 @@ fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_t *player, int num)
                 }
             }
 
-            if(fluid_player_add_track(player, track) != FLUID_OK)
+            if(fluid_player_song_add_track(song, track) != FLUID_OK)
             {
                 delete_fluid_track(track);
                 return FLUID_FAILED;
@@ -1431,9 +1453,7 @@ new_fluid_track(int num)
     track->name = NULL;
     track->num = num;
     track->first = NULL;
-    track->cur = NULL;
     track->last = NULL;
-    track->ticks = 0;
     return track;
 }
 
@@ -1482,24 +1502,6 @@ fluid_track_set_name(fluid_track_t *track, char *name)
     return FLUID_OK;
 }
 
-/*
- * fluid_track_get_duration
- */
-int
-fluid_track_get_duration(fluid_track_t *track)
-{
-    int time = 0;
-    fluid_midi_event_t *evt = track->first;
-
-    while(evt != NULL)
-    {
-        time += evt->dtime;
-        evt = evt->next;
-    }
-
-    return time;
-}
-
 /*
  * fluid_track_add_event
  */
@@ -1511,7 +1513,6 @@ fluid_track_add_event(fluid_track_t *track, fluid_midi_event_t *evt)
     if(track->first == NULL)
     {
         track->first = evt;
-        track->cur = evt;
         track->last = evt;
     }
     else
@@ -1523,102 +1524,6 @@ fluid_track_add_event(fluid_track_t *track, fluid_midi_event_t *evt)
     return FLUID_OK;
 }
 
-/*
- * fluid_track_next_event
- */
-fluid_midi_event_t *
-fluid_track_next_event(fluid_track_t *track)
-{
-    if(track->cur != NULL)
-    {
-        track->cur = track->cur->next;
-    }
-
-    return track->cur;
-}
-
-/*
- * fluid_track_reset
- */
-int
-fluid_track_reset(fluid_track_t *track)
-{
-    track->ticks = 0;
-    track->cur = track->first;
-    return FLUID_OK;
-}
-
-/*
- * fluid_track_send_events
- */
-void
-fluid_track_send_events(fluid_track_t *track,
-                        fluid_synth_t *synth,
-                        fluid_player_t *player,
-                        unsigned int ticks)
-{
-    fluid_midi_event_t *event;
-    int seeking = player->seek_ticks >= 0;
-
-    if(seeking)
-    {
-        ticks = player->seek_ticks; /* update target ticks */
-
-        if(track->ticks > ticks)
-        {
-            fluid_track_reset(track);    /* reset track if seeking backwards */
-        }
-    }
-
-    while(1)
-    {
-
-        event = track->cur;
-
-        if(event == NULL)
-        {
-            return;
-        }
-
-        /* 		printf("track=%02d\tticks=%05u\ttrack=%05u\tdtime=%05u\tnext=%05u\n", */
-        /* 		       track->num, */
-        /* 		       ticks, */
-        /* 		       track->ticks, */
-        /* 		       event->dtime, */
-        /* 		       track->ticks + event->dtime); */
-
-        if(track->ticks + event->dtime > ticks)
-        {
-            return;
-        }
-
-        track->ticks += event->dtime;
-
-        if(!player || event->type == MIDI_EOT)
-        {
-        }
-        else if(seeking && (event->type == NOTE_ON || event->type == NOTE_OFF))
-        {
-            /* skip on/off messages */
-        }
-        else
-        {
-            if(player->playback_callback)
-            {
-                player->playback_callback(player->playback_userdata, event);
-            }
-        }
-
-        if(event->type == MIDI_SET_TEMPO)
-        {
-            fluid_player_set_midi_tempo(player, event->param1);
-        }
-
-        fluid_track_next_event(track);
-
-    }
-}
-
 /******************************************************
  *
  *     fluid_player
@@ -1659,6 +1564,10 @@ new_fluid_player(fluid_synth_t *synth)
         player->track[i] = NULL;
     }
 
+    FLUID_MEMSET(&player->events, 0, sizeof(player->events));
+    player->cur_event = 0;
+    player->song_cached = FALSE;
+
     player->synth = synth;
     player->system_timer = NULL;
     player->sample_timer = NULL;
@@ -1669,8 +1578,30 @@ new_fluid_player(fluid_synth_t *synth)
     player->miditempo = 500000;
     player->deltatime = 4.0;
     player->cur_msec = 0;
+    player->start_time = 0;
+    player->cur_time = 0;
     player->cur_ticks = 0;
     player->seek_ticks = -1;
+    player->preload_thread = NULL;
+    player->preload_mutex = NULL;
+    player->preload_cond = NULL;
+    player->preload_request = NULL;
+    player->preload_item = NULL;
+    FLUID_MEMSET(&player->preload_song, 0, sizeof(player->preload_song));
+    player->preload_quit = FALSE;
+    player->lookahead_msec = 0;
+    player->lookahead_event = -1;
+    player->lookahead_channels = 0;
+    player->lookahead_released = 0;
+    player->lookahead_bank = NULL;
+    player->lookahead_thread = NULL;
+    player->lookahead_presets = NULL;
+    player->lookahead_mutex = NULL;
+    player->lookahead_cond = NULL;
+    player->lookahead_first = 0;
+    player->lookahead_count = 0;
+    player->lookahead_busy = FALSE;
+    player->lookahead_quit = FALSE;
     fluid_player_set_playback_callback(player, fluid_synth_handle_midi_event, synth);
     player->use_system_timer = fluid_settings_str_equal(synth->settings,
                                "player.timing-source", "system");
@@ -1695,6 +1626,57 @@ new_fluid_player(fluid_synth_t *synth)
         }
     }
 
+    fluid_settings_getint(synth->settings, "player.preload", &i);
+
+    if(i)
+    {
+        player->preload_mutex = new_fluid_cond_mutex();
+        player->preload_cond = new_fluid_cond();
+
+        if(player->preload_mutex == NULL || player->preload_cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto err;
+        }
+
+        player->preload_thread = new_fluid_thread("player-preload", fluid_player_preload_run, player, 0, FALSE);
+
+        if(player->preload_thread == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to create the player preload thread");
+            goto err;
+        }
+    }
+
+    fluid_settings_getnum(synth->settings, "player.program-lookahead", &player->lookahead_msec);
+    player->lookahead_msec *= 1000;
+
+    if(player->lookahead_msec > 0)
+    {
+        player->lookahead_channels = fluid_synth_count_midi_channels(synth);
+        player->lookahead_bank = FLUID_ARRAY(int, 2 * player->lookahead_channels);
+
+        player->lookahead_mutex = new_fluid_cond_mutex();
+        player->lookahead_cond = new_fluid_cond();
+
+        if(player->lookahead_bank == NULL || player->lookahead_mutex == NULL || player->lookahead_cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto err;
+        }
+
+        player->lookahead_thread = new_fluid_thread("player-lookahead", fluid_player_lookahead_run, player, 0, FALSE);
+
+        if(player->lookahead_thread == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to create the player lookahead thread");
+            goto err;
+        }
+    }
+
+    fluid_settings_getint(synth->settings, "player.cache-songs", &i);
+    player->cache_songs = i;
+
     fluid_settings_getint(synth->settings, "player.reset-synth", &i);
     fluid_player_handle_reset_synth(player, NULL, i);
 
@@ -1727,12 +1709,69 @@ delete_fluid_player(fluid_player_t *player)
     delete_fluid_timer(player->system_timer);
     delete_fluid_sample_timer(player->synth, player->sample_timer);
 
+    if(player->preload_thread != NULL)
+    {
+        fluid_cond_mutex_lock(player->preload_mutex);
+        player->preload_quit = TRUE;
+        fluid_cond_signal(player->preload_cond);
+        fluid_cond_mutex_unlock(player->preload_mutex);
+
+        fluid_thread_join(player->preload_thread);
+        delete_fluid_thread(player->preload_thread);
+    }
+
+    if(player->preload_cond != NULL)
+    {
+        delete_fluid_cond(player->preload_cond);
+    }
+
+    if(player->preload_mutex != NULL)
+    {
+        delete_fluid_cond_mutex(player->preload_mutex);
+    }
+
+    fluid_player_song_free(&player->preload_song);
+
+    if(player->lookahead_thread != NULL)
+    {
+        fluid_cond_mutex_lock(player->lookahead_mutex);
+        player->lookahead_quit = TRUE;
+        fluid_cond_signal(player->lookahead_cond);
+        fluid_cond_mutex_unlock(player->lookahead_mutex);
+
+        fluid_thread_join(player->lookahead_thread);
+        delete_fluid_thread(player->lookahead_thread);
+    }
+
+    /* the presets the thread has left preloaded */
+    fluid_player_release_presets(player, TRUE, 0);
+
+    if(player->lookahead_cond != NULL)
+    {
+        delete_fluid_cond(player->lookahead_cond);
+    }
+
+    if(player->lookahead_mutex != NULL)
+    {
+        delete_fluid_cond_mutex(player->lookahead_mutex);
+    }
+
+    FLUID_FREE(player->lookahead_bank);
+
     while(player->playlist != NULL)
     {
         q = player->playlist->next;
         pi = (fluid_playlist_item *) player->playlist->data;
         FLUID_FREE(pi->filename);
-        FLUID_FREE(pi->buffer);
+
+        FLUID_FREE(pi->buffer_copy);
+
+        if(pi->song != NULL)
+        {
+            fluid_player_song_free(pi->song);
+            FLUID_FREE(pi->song);
+        }
+
         FLUID_FREE(pi);
         delete1_fluid_list(player->playlist);
         player->playlist = q;
@@ -1755,6 +1794,19 @@ fluid_player_settings(fluid_settings_t *settings)
 
     /* Selects whether the player should reset the synth between songs, or not. */
     fluid_settings_register_int(settings, "player.reset-synth", 1, 0, 1, FLUID_HINT_TOGGLED);
+
+    /* Selects whether the songs of the playlist are kept loaded, to play them again without loading their files. */
+    fluid_settings_register_int(settings, "player.cache-songs", 0, 0, 1, FLUID_HINT_TOGGLED);
+
+    /* Selects whether the next file of the playlist is loaded by a thread while the current one plays. */
+    fluid_settings_register_int(settings, "player.preload", 0, 0, 1, FLUID_HINT_TOGGLED);
+
+    /* How many seconds ahead the presets of the program changes are announced to the SoundFont loaders. */
+    fluid_settings_register_num(settings, "player.program-lookahead", 0.0, 0.0, 60.0, 0);
+
+    /* The length of the segments of fluid_player_render_segments() and their pre-roll, in seconds. */
+    fluid_settings_register_num(settings, "player.segment-length", 60.0, 1.0, 3600.0, 0);
+    fluid_settings_register_num(settings, "player.segment-pre-roll", 5.0, 0.1, 60.0, 0);
 }
 
 
@@ -1763,15 +1815,23 @@ fluid_player_reset(fluid_player_t *player)
 {
     int i;
 
+    /* the tracks and events of a cached song remain owned by its playlist item */
     for(i = 0; i < MAX_NUMBER_OF_TRACKS; i++)
     {
         if(player->track[i] != NULL)
         {
-            delete_fluid_track(player->track[i]);
+            if(!player->song_cached)
+            {
+                delete_fluid_track(player->track[i]);
+            }
+
             player->track[i] = NULL;
         }
     }
 
+    fluid_player_free_events(player);
+    player->song_cached = FALSE;
+
     /*	player->current_file = NULL; */
     /*	player->status = FLUID_PLAYER_READY; */
     /*	player->loop = 1; */
@@ -1784,14 +1844,14 @@ fluid_player_reset(fluid_player_t *player)
 }
 
 /*
- * fluid_player_add_track
+ * fluid_player_song_add_track
  */
 int
-fluid_player_add_track(fluid_player_t *player, fluid_track_t *track)
+fluid_player_song_add_track(fluid_player_song_t *song, fluid_track_t *track)
 {
-    if(player->ntracks < MAX_NUMBER_OF_TRACKS)
+    if(song->ntracks < MAX_NUMBER_OF_TRACKS)
     {
-        player->track[player->ntracks++] = track;
+        song->track[song->ntracks++] = track;
         return FLUID_OK;
     }
     else
@@ -1800,452 +1860,1941 @@ fluid_player_add_track(fluid_player_t *player, fluid_track_t *track)
     }
 }
 
-/**
- * Change the MIDI callback function. This is usually set to
- * fluid_synth_handle_midi_event, but can optionally be changed
- * to a user-defined function instead, for intercepting all MIDI
- * messages sent to the synth. You can also use a midi router as
- * the callback function to modify the MIDI messages before sending
- * them to the synth.
- * @param player MIDI player instance
- * @param handler Pointer to callback function
- * @param handler_data Parameter sent to the callback function
- * @returns FLUID_OK
- * @since 1.1.4
+/*
+ * fluid_player_song_build_events
+ * Merges the events of all tracks into song->events, in the order they are
+ * played: by tick, events at the same tick in the order of their tracks.
  */
 int
-fluid_player_set_playback_callback(fluid_player_t *player,
-                                   handle_midi_event_func_t handler, void *handler_data)
+fluid_player_song_build_events(fluid_player_song_t *song)
 {
-    player->playback_callback = handler;
-    player->playback_userdata = handler_data;
-    return FLUID_OK;
-}
+    fluid_player_events_t *events = &song->events;
+    fluid_midi_event_t *cur[MAX_NUMBER_OF_TRACKS];
+    unsigned int cur_ticks[MAX_NUMBER_OF_TRACKS];
+    fluid_midi_event_t *evt;
+    int i, n, next, count = 0;
 
-/**
- * Add a MIDI file to a player queue.
- * @param player MIDI player instance
- * @param midifile File name of the MIDI file to add
- * @return #FLUID_OK or #FLUID_FAILED
- */
-int
-fluid_player_add(fluid_player_t *player, const char *midifile)
-{
-    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
-    char *f = FLUID_STRDUP(midifile);
+    for(i = 0; i < song->ntracks; i++)
+    {
+        for(evt = song->track[i]->first; evt != NULL; evt = evt->next)
+        {
+            count++;
+        }
 
-    if(!pi || !f)
+        cur[i] = song->track[i]->first;
+        cur_ticks[i] = (cur[i] != NULL) ? cur[i]->dtime : 0;
+    }
+
+    if(count == 0)
     {
-        FLUID_FREE(pi);
-        FLUID_FREE(f);
-        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_OK;
+    }
+
+    events->ticks = FLUID_ARRAY(unsigned int, count);
+    events->event = FLUID_ARRAY(fluid_midi_event_t, count);
+    events->replay = FLUID_ARRAY(int, count);
+
+    if(events->ticks == NULL || events->event == NULL || events->replay == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
         return FLUID_FAILED;
     }
 
-    pi->filename = f;
-    pi->buffer = NULL;
-    pi->buffer_len = 0;
-    player->playlist = fluid_list_append(player->playlist, pi);
+    for(n = 0; n < count; n++)
+    {
+        /* the earliest of the next events of all tracks */
+        for(i = 0, next = -1; i < song->ntracks; i++)
+        {
+            if(cur[i] != NULL && (next < 0 || cur_ticks[i] < cur_ticks[next]))
+            {
+                next = i;
+            }
+        }
+
+        evt = cur[next];
+        events->ticks[n] = cur_ticks[next];
+        events->event[n] = *evt;
+        events->event[n].next = NULL;
+
+        if(evt->type != NOTE_ON && evt->type != NOTE_OFF && evt->type != MIDI_EOT)
+        {
+            events->replay[events->replay_count++] = n;
+        }
+
+        cur[next] = evt->next;
+
+        if(cur[next] != NULL)
+        {
+            cur_ticks[next] += cur[next]->dtime;
+        }
+    }
+
+    events->count = count;
     return FLUID_OK;
 }
 
-/**
- * Add a MIDI file to a player queue, from a buffer in memory.
- * @param player MIDI player instance
- * @param buffer Pointer to memory containing the bytes of a complete MIDI
- *   file. The data is copied, so the caller may free or modify it immediately
- *   without affecting the playlist.
- * @param len Length of the buffer, in bytes.
- * @return #FLUID_OK or #FLUID_FAILED
+/*
+ * fluid_player_free_events
  */
-int
-fluid_player_add_mem(fluid_player_t *player, const void *buffer, size_t len)
+void
+fluid_player_free_events(fluid_player_t *player)
 {
-    /* Take a copy of the buffer, so the caller can free immediately. */
-    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
-    void *buf_copy = FLUID_MALLOC(len);
+    fluid_player_release_lookahead(player, TRUE);
 
-    if(!pi || !buf_copy)
+    if(!player->song_cached)
     {
-        FLUID_FREE(pi);
-        FLUID_FREE(buf_copy);
-        FLUID_LOG(FLUID_PANIC, "Out of memory");
-        return FLUID_FAILED;
+        FLUID_FREE(player->events.ticks);
+        FLUID_FREE(player->events.event);
+        FLUID_FREE(player->events.replay);
     }
 
-    FLUID_MEMCPY(buf_copy, buffer, len);
-    pi->filename = NULL;
-    pi->buffer = buf_copy;
-    pi->buffer_len = len;
-    player->playlist = fluid_list_append(player->playlist, pi);
-    return FLUID_OK;
+    FLUID_MEMSET(&player->events, 0, sizeof(player->events));
+    player->cur_event = 0;
 }
 
 /*
- * fluid_player_load
+ * fluid_player_song_free
+ * Frees the tracks and events of a song, which can be loaded again.
  */
-int
-fluid_player_load(fluid_player_t *player, fluid_playlist_item *item)
+void
+fluid_player_song_free(fluid_player_song_t *song)
 {
-    fluid_midi_file *midifile;
-    char *buffer;
-    size_t buffer_length;
-    int buffer_owned;
+    int i;
 
-    if(item->filename != NULL)
+    for(i = 0; i < song->ntracks; i++)
     {
-        fluid_file fp;
-        /* This file is specified by filename; load the file from disk */
-        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile %s", __FILE__, __LINE__,
-                  item->filename);
-        /* Read the entire contents of the file into the buffer */
-        fp = FLUID_FOPEN(item->filename, "rb");
+        delete_fluid_track(song->track[i]);
+    }
 
-        if(fp == NULL)
+    FLUID_FREE(song->events.ticks);
+    FLUID_FREE(song->events.event);
+    FLUID_FREE(song->events.replay);
+    FLUID_MEMSET(song, 0, sizeof(*song));
+}
+
+/*
+ * fluid_player_send_event
+ * The voices started by the event begin offset frames into the next block rendered.
+ */
+static void
+fluid_player_send_event(fluid_player_t *player, fluid_midi_event_t *event, int offset)
+{
+    if(event->type != MIDI_EOT && player->playback_callback)
+    {
+        if(offset > 0)
         {
-            FLUID_LOG(FLUID_ERR, "Couldn't open the MIDI file");
-            return FLUID_FAILED;
+            fluid_synth_handle_midi_event_offset(player->synth, player->playback_callback,
+                                                 player->playback_userdata, event, offset);
         }
-
-        buffer = fluid_file_read_full(fp, &buffer_length);
-
-        FLUID_FCLOSE(fp);
-
-        if(buffer == NULL)
+        else
         {
-            return FLUID_FAILED;
+            player->playback_callback(player->playback_userdata, event);
         }
+    }
 
-        buffer_owned = 1;
+    if(event->type == MIDI_SET_TEMPO)
+    {
+        fluid_player_set_midi_tempo(player, event->param1);
     }
-    else
+}
+
+/*
+ * fluid_player_send_events
+ * Sends all events up to ticks.
+ */
+void
+fluid_player_send_events(fluid_player_t *player, unsigned int ticks)
+{
+    fluid_player_events_t *events = &player->events;
+
+    while(player->cur_event < events->count && events->ticks[player->cur_event] <= ticks)
     {
-        /* This file is specified by a pre-loaded buffer; load from memory */
-        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile from memory (%p)",
-                  __FILE__, __LINE__, item->buffer);
-        buffer = (char *) item->buffer;
-        buffer_length = item->buffer_len;
-        /* Do not free the buffer (it is owned by the playlist) */
-        buffer_owned = 0;
+        fluid_player_send_event(player, &events->event[player->cur_event++], 0);
     }
+}
 
-    midifile = new_fluid_midi_file(buffer, buffer_length);
+/*
+ * fluid_player_send_events_exact
+ * Sends all events due before the end of the block about to be rendered, when
+ * driven by the sample timer. Their time is computed from their ticks and the
+ * tempo, notes start at their exact frame inside of the block and tempo changes
+ * take effect from the tick of their event.
+ */
+static void
+fluid_player_send_events_exact(fluid_player_t *player)
+{
+    fluid_player_events_t *events = &player->events;
+    double frames_per_msec = player->synth->sample_rate / 1000.0;
+    fluid_midi_event_t *event;
+    unsigned int ticks;
+    double time, offset;
 
-    if(midifile == NULL)
+    while(player->cur_event < events->count)
     {
-        if(buffer_owned)
+        ticks = events->ticks[player->cur_event];
+        time = player->start_time + ((double)ticks - player->start_ticks) * player->deltatime;
+        offset = (time - player->cur_time) * frames_per_msec;
+
+        if(offset >= FLUID_BUFSIZE)
         {
-            FLUID_FREE(buffer);
+            break;
         }
 
-        return FLUID_FAILED;
+        event = &events->event[player->cur_event++];
+        fluid_player_send_event(player, event, (offset > 0) ? (int)offset : 0);
+
+        if(event->type == MIDI_SET_TEMPO)
+        {
+            player->start_ticks = ticks;
+            player->start_time = time;
+        }
     }
+}
 
-    player->division = fluid_midi_file_get_division(midifile);
-    fluid_player_set_midi_tempo(player, player->miditempo); // Update deltatime
-    /*FLUID_LOG(FLUID_DBG, "quarter note division=%d\n", player->division); */
+/*
+ * Let the sample timer of the player sleep until the block of the next event,
+ * after fluid_player_send_events_exact(). The API functions changing the
+ * position or the tempo wake it up.
+ */
+static void
+fluid_player_sleep_until_next_event(fluid_player_t *player)
+{
+    double frames_per_msec = player->synth->sample_rate / 1000.0;
+    double time = player->start_time
+                  + ((double)player->events.ticks[player->cur_event] - player->start_ticks) * player->deltatime;
+    double lookahead_time;
 
-    if(fluid_midi_file_load_tracks(midifile, player) != FLUID_OK)
+    /* or until the next program change is to be looked at */
+    if(player->lookahead_event >= 0 && player->lookahead_event < player->events.count)
     {
-        if(buffer_owned)
+        lookahead_time = player->start_time - player->lookahead_msec
+                         + ((double)player->events.ticks[player->lookahead_event] - player->start_ticks) * player->deltatime;
+
+        if(lookahead_time < time)
         {
-            FLUID_FREE(buffer);
+            time = lookahead_time;
         }
-
-        delete_fluid_midi_file(midifile);
-        return FLUID_FAILED;
     }
 
-    delete_fluid_midi_file(midifile);
-
-    if(buffer_owned)
+    if(time > player->cur_time + FLUID_PLAYER_MAX_SLEEP_MSEC)
     {
-        FLUID_FREE(buffer);
+        time = player->cur_time + FLUID_PLAYER_MAX_SLEEP_MSEC;
     }
 
-    return FLUID_OK;
+    /* a frame early, to be sure not to miss the block of the event by rounding */
+    if(time > player->cur_time)
+    {
+        fluid_sample_timer_set_due(player->synth, player->sample_timer,
+                                   (unsigned int)(time * frames_per_msec) - 1);
+    }
 }
 
+/*
+ * fluid_player_seek_events
+ * Moves to the first event after ticks. All events on the way but notes are
+ * sent, from the beginning of the file when seeking backwards.
+ */
 void
-fluid_player_advancefile(fluid_player_t *player)
+fluid_player_seek_events(fluid_player_t *player, unsigned int ticks)
 {
-    if(player->playlist == NULL)
+    fluid_player_events_t *events = &player->events;
+    int lo, hi, mid, target;
+
+    fluid_player_release_lookahead(player, TRUE);
+
+    /* binary search for the first event after ticks */
+    for(lo = 0, hi = events->count; lo < hi;)
     {
-        return; /* No files to play */
+        mid = lo + (hi - lo) / 2;
+
+        if(events->ticks[mid] <= ticks)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
     }
 
-    if(player->currentfile != NULL)
+    target = lo;
+
+    if(target < player->cur_event)
     {
-        player->currentfile = fluid_list_next(player->currentfile);
+        player->cur_event = 0;
     }
 
-    if(player->currentfile == NULL)
+    /* binary search for the first event to replay */
+    for(lo = 0, hi = events->replay_count; lo < hi;)
     {
-        if(player->loop == 0)
+        mid = lo + (hi - lo) / 2;
+
+        if(events->replay[mid] < player->cur_event)
         {
-            return; /* We're done playing */
+            lo = mid + 1;
         }
-
-        if(player->loop > 0)
+        else
         {
-            player->loop--;
+            hi = mid;
         }
+    }
 
-        player->currentfile = player->playlist;
+    for(; lo < events->replay_count && events->replay[lo] < target; lo++)
+    {
+        fluid_player_send_event(player, &events->event[events->replay[lo]], 0);
     }
+
+    player->cur_event = target;
 }
 
-void
-fluid_player_playlist_load(fluid_player_t *player, unsigned int msec)
+/* A preset preloaded for a program change ahead */
+typedef struct
 {
-    fluid_playlist_item *current_playitem;
+    fluid_preset_t *preset;
+    int chan;
+    int event;                  /* the index of the program change */
+} fluid_player_lookahead_t;
+
+/*
+ * fluid_player_look_ahead
+ * Announces the presets of the program changes due within player.program-lookahead
+ * to their SoundFont loaders, e.g. for the samples of their presets to be loaded
+ * with synth.dynamic-sample-loading by the time they are played, and releases the
+ * ones played. The time of the events is computed with the current tempo.
+ * Loading samples is no realtime operation, so the lookahead thread does both.
+ */
+static void
+fluid_player_look_ahead(fluid_player_t *player)
+{
+    fluid_player_events_t *events = &player->events;
+    fluid_player_lookahead_request_t request;
+    fluid_midi_event_t *event;
+    double time;
     int i;
 
-    do
+    if(player->lookahead_thread == NULL)
     {
-        fluid_player_advancefile(player);
-
-        if(player->currentfile == NULL)
-        {
-            /* Failed to find next song, probably since we're finished */
-            player->status = FLUID_PLAYER_DONE;
-            return;
-        }
-
-        fluid_player_reset(player);
-        current_playitem = (fluid_playlist_item *) player->currentfile->data;
+        return;
     }
-    while(fluid_player_load(player, current_playitem) != FLUID_OK);
 
-    /* Successfully loaded midi file */
+    fluid_player_release_lookahead(player, FALSE);
 
-    player->begin_msec = msec;
-    player->start_msec = msec;
-    player->start_ticks = 0;
-    player->cur_ticks = 0;
+    /* the banks of the channels are the ones the events played have set */
+    if(player->lookahead_event < 0)
+    {
+        player->lookahead_event = player->cur_event;
+        player->lookahead_released = player->cur_event;
 
-    if(player->reset_synth_between_songs)
+        for(i = 0; i < 2 * player->lookahead_channels; i++)
+        {
+            player->lookahead_bank[i] = -1;
+        }
+    }
+    else if(player->lookahead_event < player->cur_event)
     {
-        fluid_synth_system_reset(player->synth);
+        player->lookahead_event = player->cur_event;
     }
 
-    for(i = 0; i < player->ntracks; i++)
+    for(; player->lookahead_event < events->count; player->lookahead_event++)
     {
-        if(player->track[i] != NULL)
+        time = player->start_time
+               + ((double)events->ticks[player->lookahead_event] - player->start_ticks) * player->deltatime;
+
+        if(time > player->cur_time + player->lookahead_msec)
+        {
+            break;
+        }
+
+        event = &events->event[player->lookahead_event];
+
+        if(event->channel >= player->lookahead_channels)
+        {
+            continue;
+        }
+
+        if(event->type == CONTROL_CHANGE && event->param1 == BANK_SELECT_MSB)
+        {
+            player->lookahead_bank[2 * event->channel] = event->param2;
+        }
+        else if(event->type == CONTROL_CHANGE && event->param1 == BANK_SELECT_LSB)
+        {
+            player->lookahead_bank[2 * event->channel + 1] = event->param2;
+        }
+        else if(event->type == PROGRAM_CHANGE && player->send_program_change)
         {
-            fluid_track_reset(player->track[i]);
+            request.type = FLUID_PLAYER_LOOKAHEAD_PRELOAD;
+            request.chan = event->channel;
+            request.bank_msb = player->lookahead_bank[2 * event->channel];
+            request.bank_lsb = player->lookahead_bank[2 * event->channel + 1];
+            request.prog = event->param1;
+            request.event = player->lookahead_event;
+
+            /* the thread lags behind, look at the event again next time */
+            if(!fluid_player_queue_lookahead(player, &request))
+            {
+                break;
+            }
         }
     }
 }
 
 /*
- * fluid_player_callback
+ * fluid_player_release_lookahead
+ * Requests the presets preloaded whose program change has been played to be
+ * released, or all of them to start looking ahead over from the current event.
  */
-int
-fluid_player_callback(void *data, unsigned int msec)
+static void
+fluid_player_release_lookahead(fluid_player_t *player, int all)
 {
-    int i;
-    int loadnextfile;
-    int status = FLUID_PLAYER_DONE;
-    fluid_player_t *player;
-    fluid_synth_t *synth;
-    player = (fluid_player_t *) data;
-    synth = player->synth;
+    fluid_player_lookahead_request_t request;
+    int i, end;
 
-    loadnextfile = player->currentfile == NULL ? 1 : 0;
+    if(player->lookahead_thread == NULL)
+    {
+        return;
+    }
 
-    if(player->status == FLUID_PLAYER_DONE)
+    FLUID_MEMSET(&request, 0, sizeof(request));
+
+    if(all)
     {
-        fluid_synth_all_notes_off(synth, -1);
-        return 1;
+        request.type = FLUID_PLAYER_LOOKAHEAD_RELEASE_ALL;
+        fluid_player_queue_lookahead(player, &request);
+        player->lookahead_event = -1;
+        return;
     }
-    do
+
+    /* only bother the thread once a program change looked at has been played */
+    end = (player->cur_event < player->lookahead_event) ? player->cur_event : player->lookahead_event;
+
+    for(i = player->lookahead_released; i < end; i++)
     {
-        if(loadnextfile)
+        if(player->events.event[i].type == PROGRAM_CHANGE)
         {
-            loadnextfile = 0;
-            fluid_player_playlist_load(player, msec);
+            request.type = FLUID_PLAYER_LOOKAHEAD_RELEASE;
+            request.event = player->cur_event;
 
-            if(player->currentfile == NULL)
+            if(!fluid_player_queue_lookahead(player, &request))
             {
-                return 0;
+                return;
             }
+
+            break;
         }
+    }
 
-        player->cur_msec = msec;
-        player->cur_ticks = (player->start_ticks
-                             + (int)((double)(player->cur_msec - player->start_msec)
-                                     / player->deltatime + 0.5)); /* 0.5 to average overall error when casting */
+    if(end > player->lookahead_released)
+    {
+        player->lookahead_released = end;
+    }
+}
 
-        if(player->seek_ticks >= 0)
+/*
+ * fluid_player_queue_lookahead
+ * Queues a request to the lookahead thread. Requesting to release all the
+ * presets drops the requests queued so far, so that it never fails.
+ * Returns FALSE if the queue is full.
+ */
+static int
+fluid_player_queue_lookahead(fluid_player_t *player, const fluid_player_lookahead_request_t *request)
+{
+    int ok = TRUE;
+
+    fluid_cond_mutex_lock(player->lookahead_mutex);
+
+    if(request->type == FLUID_PLAYER_LOOKAHEAD_RELEASE_ALL)
+    {
+        player->lookahead_first = 0;
+        player->lookahead_count = 0;
+    }
+
+    if(player->lookahead_count < FLUID_PLAYER_LOOKAHEAD_REQUESTS)
+    {
+        player->lookahead_requests[(player->lookahead_first + player->lookahead_count)
+                                   % FLUID_PLAYER_LOOKAHEAD_REQUESTS] = *request;
+        player->lookahead_count++;
+        fluid_cond_signal(player->lookahead_cond);
+    }
+    else
+    {
+        ok = FALSE;
+    }
+
+    fluid_cond_mutex_unlock(player->lookahead_mutex);
+
+    return ok;
+}
+
+/*
+ * fluid_player_release_presets
+ * Releases the presets preloaded for the program changes before the given
+ * event, or all of them.
+ */
+static void
+fluid_player_release_presets(fluid_player_t *player, int all, int event)
+{
+    fluid_player_lookahead_t *lookahead;
+    fluid_list_t *head;
+
+    while(player->lookahead_presets != NULL)
+    {
+        head = player->lookahead_presets;
+        lookahead = fluid_list_get(head);
+
+        if(!all && lookahead->event >= event)
         {
-            fluid_synth_all_sounds_off(synth, -1); /* avoid hanging notes */
+            break;
         }
 
-        for(i = 0; i < player->ntracks; i++)
+        fluid_synth_release_preloaded_preset(player->synth, lookahead->preset, lookahead->chan);
+        FLUID_FREE(lookahead);
+        player->lookahead_presets = fluid_list_remove_link(head, head);
+        delete1_fluid_list(head);
+    }
+}
+
+/*
+ * fluid_player_lookahead_run
+ * Thread preloading and releasing the presets requested by the player.
+ */
+static fluid_thread_return_t
+fluid_player_lookahead_run(void *data)
+{
+    fluid_player_t *player = data;
+    fluid_player_lookahead_request_t request;
+    fluid_player_lookahead_t *lookahead;
+    fluid_preset_t *preset;
+
+    while(1)
+    {
+        fluid_cond_mutex_lock(player->lookahead_mutex);
+
+        while(player->lookahead_count == 0 && !player->lookahead_quit)
         {
-            if(!fluid_track_eot(player->track[i]))
-            {
-                status = FLUID_PLAYER_PLAYING;
-                fluid_track_send_events(player->track[i], synth, player, player->cur_ticks);
-            }
+            fluid_cond_wait(player->lookahead_cond, player->lookahead_mutex);
         }
 
-        if(player->seek_ticks >= 0)
+        if(player->lookahead_quit)
         {
-            player->start_ticks = player->seek_ticks;   /* tick position of last tempo value (which is now) */
-            player->cur_ticks = player->seek_ticks;
-            player->begin_msec = msec;      /* only used to calculate the duration of playing */
-            player->start_msec = msec;      /* should be the (synth)-time of the last tempo change */
-            player->seek_ticks = -1;        /* clear seek_ticks */
+            fluid_cond_mutex_unlock(player->lookahead_mutex);
+            break;
         }
 
-        if(status == FLUID_PLAYER_DONE)
+        request = player->lookahead_requests[player->lookahead_first];
+        player->lookahead_first = (player->lookahead_first + 1) % FLUID_PLAYER_LOOKAHEAD_REQUESTS;
+        player->lookahead_count--;
+        player->lookahead_busy = TRUE;
+        fluid_cond_mutex_unlock(player->lookahead_mutex);
+
+        switch(request.type)
         {
-            FLUID_LOG(FLUID_DBG, "%s: %d: Duration=%.3f sec", __FILE__,
-                      __LINE__, (msec - player->begin_msec) / 1000.0);
-            loadnextfile = 1;
-        }
-    }
-    while(loadnextfile);
+        case FLUID_PLAYER_LOOKAHEAD_PRELOAD:
+            lookahead = FLUID_NEW(fluid_player_lookahead_t);
 
-    player->status = status;
+            if(lookahead == NULL)
+            {
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+            }
+            else if((preset = fluid_synth_preload_program(player->synth, request.chan,
+                              request.bank_msb, request.bank_lsb, request.prog)) == NULL)
+            {
+                FLUID_FREE(lookahead);
+            }
+            else
+            {
+                lookahead->preset = preset;
+                lookahead->chan = request.chan;
+                lookahead->event = request.event;
+                player->lookahead_presets = fluid_list_append(player->lookahead_presets, lookahead);
+            }
 
-    return 1;
-}
+            break;
+
+        case FLUID_PLAYER_LOOKAHEAD_RELEASE:
+            fluid_player_release_presets(player, FALSE, request.event);
+            break;
+
+        case FLUID_PLAYER_LOOKAHEAD_RELEASE_ALL:
+            fluid_player_release_presets(player, TRUE, 0);
+            break;
+        }
+
+        fluid_cond_mutex_lock(player->lookahead_mutex);
+        player->lookahead_busy = FALSE;
+        fluid_cond_mutex_unlock(player->lookahead_mutex);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * fluid_player_lookahead_pending
+ * Returns the number of requests the lookahead thread has yet to carry out.
+ */
+int
+fluid_player_lookahead_pending(fluid_player_t *player)
+{
+    int count;
+
+    if(player->lookahead_thread == NULL)
+    {
+        return 0;
+    }
+
+    fluid_cond_mutex_lock(player->lookahead_mutex);
+    count = player->lookahead_count + player->lookahead_busy;
+    fluid_cond_mutex_unlock(player->lookahead_mutex);
+
+    return count;
+}
+
+/**
+ * Change the MIDI callback function. This is usually set to
+ * fluid_synth_handle_midi_event, but can optionally be changed
+ * to a user-defined function instead, for intercepting all MIDI
+ * messages sent to the synth. You can also use a midi router as
+ * the callback function to modify the MIDI messages before sending
+ * them to the synth.
+ * @param player MIDI player instance
+ * @param handler Pointer to callback function
+ * @param handler_data Parameter sent to the callback function
+ * @returns FLUID_OK
+ * @since 1.1.4
+ */
+int
+fluid_player_set_playback_callback(fluid_player_t *player,
+                                   handle_midi_event_func_t handler, void *handler_data)
+{
+    player->playback_callback = handler;
+    player->playback_userdata = handler_data;
+    return FLUID_OK;
+}
+
+/**
+ * Add a MIDI file to a player queue.
+ * @param player MIDI player instance
+ * @param midifile File name of the MIDI file to add
+ * @return #FLUID_OK or #FLUID_FAILED
+ */
+int
+fluid_player_add(fluid_player_t *player, const char *midifile)
+{
+    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
+    char *f = FLUID_STRDUP(midifile);
+
+    if(!pi || !f)
+    {
+        FLUID_FREE(pi);
+        FLUID_FREE(f);
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    pi->filename = f;
+    pi->buffer = NULL;
+    pi->buffer_len = 0;
+    pi->buffer_copy = NULL;
+    pi->song = NULL;
+    player->playlist = fluid_list_append(player->playlist, pi);
+    return FLUID_OK;
+}
+
+/**
+ * Add a MIDI file to a player queue, from a buffer in memory.
+ * @param player MIDI player instance
+ * @param buffer Pointer to memory containing the bytes of a complete MIDI
+ *   file. The data is copied, so the caller may free or modify it immediately
+ *   without affecting the playlist.
+ * @param len Length of the buffer, in bytes.
+ * @return #FLUID_OK or #FLUID_FAILED
+ */
+int
+fluid_player_add_mem(fluid_player_t *player, const void *buffer, size_t len)
+{
+    /* Take a copy of the buffer, so the caller can free immediately. */
+    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
+    void *buf_copy = FLUID_MALLOC(len);
+
+    if(!pi || !buf_copy)
+    {
+        FLUID_FREE(pi);
+        FLUID_FREE(buf_copy);
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(buf_copy, buffer, len);
+    pi->filename = NULL;
+    pi->buffer = buf_copy;
+    pi->buffer_len = len;
+    pi->buffer_copy = buf_copy;
+    pi->song = NULL;
+    player->playlist = fluid_list_append(player->playlist, pi);
+    return FLUID_OK;
+}
+
+/**
+ * Add a MIDI file to a player queue, from a buffer in memory which is not copied.
+ * @param player MIDI player instance
+ * @param buffer Pointer to memory containing the bytes of a complete MIDI
+ *   file. It remains owned by the caller, who must neither free nor modify it
+ *   until the player has been deleted.
+ * @param len Length of the buffer, in bytes.
+ * @return #FLUID_OK or #FLUID_FAILED
+ *
+ * The same as fluid_player_add_mem(), without the copy of the buffer, e.g. for
+ * large collections of MIDI files kept in memory anyway.
+ * @since 2.2.0
+ */
+int
+fluid_player_add_mem_nocopy(fluid_player_t *player, const void *buffer, size_t len)
+{
+    fluid_playlist_item *pi;
+
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(buffer != NULL, FLUID_FAILED);
+
+    pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
+
+    if(!pi)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    pi->filename = NULL;
+    pi->buffer = buffer;
+    pi->buffer_len = len;
+    pi->buffer_copy = NULL;
+    pi->song = NULL;
+    player->playlist = fluid_list_append(player->playlist, pi);
+    return FLUID_OK;
+}
+
+/*
+ * fluid_player_song_load
+ * Loads the file of a playlist item to an empty song, which is left empty on failure.
+ * Only reads the item, so it may be called by the preload thread.
+ */
+int
+fluid_player_song_load(fluid_player_song_t *song, fluid_playlist_item *item)
+{
+    fluid_midi_file *midifile;
+    fluid_file_mapping_t *mapping = NULL;
+    const char *buffer;
+    char *read_buffer = NULL;
+    size_t buffer_length;
+
+    if(item->filename != NULL)
+    {
+        fluid_file fp;
+        /* This file is specified by filename; load the file from disk */
+        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile %s", __FILE__, __LINE__,
+                  item->filename);
+        fp = FLUID_FOPEN(item->filename, "rb");
+
+        if(fp == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Couldn't open the MIDI file");
+            return FLUID_FAILED;
+        }
+
+        /* Map the file into memory, or read its entire contents into the buffer if it can't be mapped */
+        if(fluid_file_get_length(fp, &buffer_length) == FLUID_OK && buffer_length > 0)
+        {
+            mapping = new_fluid_file_mapping(item->filename, 0, buffer_length);
+        }
+
+        if(mapping != NULL)
+        {
+            buffer = fluid_file_mapping_get_data(mapping);
+        }
+        else
+        {
+            buffer = read_buffer = fluid_file_read_full(fp, &buffer_length);
+        }
+
+        FLUID_FCLOSE(fp);
+
+        if(buffer == NULL)
+        {
+            return FLUID_FAILED;
+        }
+    }
+    else
+    {
+        /* This file is specified by a pre-loaded buffer; load from memory */
+        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile from memory (%p)",
+                  __FILE__, __LINE__, item->buffer);
+        /* Do not free the buffer (it is owned by the playlist or the caller) */
+        buffer = item->buffer;
+        buffer_length = item->buffer_len;
+    }
+
+    midifile = new_fluid_midi_file(buffer, buffer_length);
+
+    if(midifile == NULL)
+    {
+        FLUID_FREE(read_buffer);
+        delete_fluid_file_mapping(mapping);
+        return FLUID_FAILED;
+    }
+
+    song->division = fluid_midi_file_get_division(midifile);
+    /*FLUID_LOG(FLUID_DBG, "quarter note division=%d\n", song->division); */
+
+    if(fluid_midi_file_load_tracks(midifile, song) != FLUID_OK
+            || fluid_player_song_build_events(song) != FLUID_OK)
+    {
+        FLUID_FREE(read_buffer);
+        delete_fluid_file_mapping(mapping);
+        delete_fluid_midi_file(midifile);
+        fluid_player_song_free(song);
+        return FLUID_FAILED;
+    }
+
+    delete_fluid_midi_file(midifile);
+    FLUID_FREE(read_buffer);
+    delete_fluid_file_mapping(mapping);
+    return FLUID_OK;
+}
+
+/*
+ * fluid_player_install_song
+ * Lets the player play a song loaded from a playlist item after fluid_player_reset().
+ * The player takes the song over, unless it is the one cached by the item, which
+ * the song is moved to first with "player.cache-songs".
+ */
+static void
+fluid_player_install_song(fluid_player_t *player, fluid_playlist_item *item, fluid_player_song_t *song)
+{
+    if(player->cache_songs && item->song == NULL)
+    {
+        item->song = FLUID_NEW(fluid_player_song_t);
+
+        if(item->song != NULL)
+        {
+            *item->song = *song;
+            FLUID_MEMSET(song, 0, sizeof(*song));
+            song = item->song;
+        }
+    }
+
+    FLUID_MEMCPY(player->track, song->track, song->ntracks * sizeof(*song->track));
+    player->ntracks = song->ntracks;
+    player->events = song->events;
+    player->division = song->division;
+    player->song_cached = (song == item->song);
+
+    if(!player->song_cached)
+    {
+        FLUID_MEMSET(song, 0, sizeof(*song));
+    }
+
+    fluid_player_set_midi_tempo(player, player->miditempo); // Update deltatime
+}
+
+/*
+ * fluid_player_load
+ */
+int
+fluid_player_load(fluid_player_t *player, fluid_playlist_item *item)
+{
+    fluid_player_song_t song;
+
+    if(item->song != NULL)
+    {
+        fluid_player_install_song(player, item, item->song);
+        return FLUID_OK;
+    }
+
+    FLUID_MEMSET(&song, 0, sizeof(song));
+
+    if(fluid_player_song_load(&song, item) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    fluid_player_install_song(player, item, &song);
+    return FLUID_OK;
+}
+
+void
+fluid_player_advancefile(fluid_player_t *player)
+{
+    if(player->playlist == NULL)
+    {
+        return; /* No files to play */
+    }
+
+    if(player->currentfile != NULL)
+    {
+        player->currentfile = fluid_list_next(player->currentfile);
+    }
+
+    if(player->currentfile == NULL)
+    {
+        if(player->loop == 0)
+        {
+            return; /* We're done playing */
+        }
+
+        if(player->loop > 0)
+        {
+            player->loop--;
+        }
+
+        player->currentfile = player->playlist;
+    }
+}
+
+void
+fluid_player_playlist_load(fluid_player_t *player, unsigned int msec)
+{
+    fluid_playlist_item *current_playitem;
+    fluid_player_song_t song;
+    int preloaded;
+
+    do
+    {
+        fluid_player_advancefile(player);
+
+        if(player->currentfile == NULL)
+        {
+            /* Failed to find next song, probably since we're finished */
+            player->status = FLUID_PLAYER_DONE;
+            return;
+        }
+
+        fluid_player_reset(player);
+        current_playitem = (fluid_playlist_item *) player->currentfile->data;
+
+        /* take the song over from the preload thread, if it has loaded it already */
+        preloaded = FALSE;
+
+        if(player->preload_thread != NULL)
+        {
+            fluid_cond_mutex_lock(player->preload_mutex);
+
+            if(player->preload_item == player->currentfile)
+            {
+                song = player->preload_song;
+                FLUID_MEMSET(&player->preload_song, 0, sizeof(player->preload_song));
+                player->preload_item = NULL;
+                preloaded = TRUE;
+            }
+
+            fluid_cond_mutex_unlock(player->preload_mutex);
+        }
+
+        if(preloaded)
+        {
+            fluid_player_install_song(player, current_playitem, &song);
+            break;
+        }
+    }
+    while(fluid_player_load(player, current_playitem) != FLUID_OK);
+
+    fluid_player_request_preload(player);
+
+    /* Successfully loaded midi file */
+
+    player->begin_msec = msec;
+    player->start_msec = msec;
+    player->start_time = player->cur_time;
+    player->start_ticks = 0;
+    player->cur_ticks = 0;
+
+    if(player->reset_synth_between_songs)
+    {
+        fluid_synth_system_reset(player->synth);
+    }
+
+    player->cur_event = 0;
+}
+
+/*
+ * fluid_player_request_preload
+ * Lets the preload thread load the file played after the current one, if any.
+ */
+void
+fluid_player_request_preload(fluid_player_t *player)
+{
+    fluid_list_t *next;
+
+    if(player->preload_thread == NULL)
+    {
+        return;
+    }
+
+    /* the same as fluid_player_advancefile() */
+    next = fluid_list_next(player->currentfile);
+
+    if(next == NULL && player->loop != 0)
+    {
+        next = player->playlist;
+    }
+
+    /* nor if it has been loaded for good */
+    if(next == NULL || ((fluid_playlist_item *) next->data)->song != NULL)
+    {
+        return;
+    }
+
+    fluid_cond_mutex_lock(player->preload_mutex);
+
+    if(player->preload_item != next)
+    {
+        player->preload_request = next;
+        fluid_cond_signal(player->preload_cond);
+    }
+
+    fluid_cond_mutex_unlock(player->preload_mutex);
+}
+
+/*
+ * fluid_player_preload_run
+ * Thread loading the files of the playlist requested by the player, so that
+ * the next song starts without loading it from the rendering thread.
+ */
+fluid_thread_return_t
+fluid_player_preload_run(void *data)
+{
+    fluid_player_t *player = data;
+    fluid_player_song_t song, old_song;
+    fluid_list_t *item;
+    int ok;
+
+    while(1)
+    {
+        fluid_cond_mutex_lock(player->preload_mutex);
+
+        while(player->preload_request == NULL && !player->preload_quit)
+        {
+            fluid_cond_wait(player->preload_cond, player->preload_mutex);
+        }
+
+        if(player->preload_quit)
+        {
+            fluid_cond_mutex_unlock(player->preload_mutex);
+            break;
+        }
+
+        item = player->preload_request;
+        player->preload_request = NULL;
+        fluid_cond_mutex_unlock(player->preload_mutex);
+
+        FLUID_MEMSET(&song, 0, sizeof(song));
+        ok = (fluid_player_song_load(&song, (fluid_playlist_item *) item->data) == FLUID_OK);
+
+        /* hand the song over, unless another file has been requested meanwhile */
+        fluid_cond_mutex_lock(player->preload_mutex);
+
+        if(ok && player->preload_request == NULL)
+        {
+            old_song = player->preload_song;
+            player->preload_song = song;
+            player->preload_item = item;
+            song = old_song;
+        }
+
+        fluid_cond_mutex_unlock(player->preload_mutex);
+
+        /* the song superseded, if any */
+        fluid_player_song_free(&song);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * fluid_player_callback
+ */
+int
+fluid_player_callback(void *data, unsigned int msec)
+{
+    int loadnextfile;
+    int status = FLUID_PLAYER_DONE;
+    fluid_player_t *player;
+    fluid_synth_t *synth;
+    player = (fluid_player_t *) data;
+    synth = player->synth;
+
+    loadnextfile = player->currentfile == NULL ? 1 : 0;
+
+    /* the sample timer rounds the time of the block down to milliseconds */
+    player->cur_time = player->use_system_timer ? msec
+                       : fluid_sample_timer_get_ticks(synth, player->sample_timer) * 1000.0 / synth->sample_rate;
+
+    if(player->status == FLUID_PLAYER_DONE)
+    {
+        fluid_player_release_lookahead(player, TRUE);
+        fluid_synth_all_notes_off(synth, -1);
+        return 1;
+    }
+    do
+    {
+        if(loadnextfile)
+        {
+            loadnextfile = 0;
+
+            /* Loading the next file reads it from disk anyway, which is no
+             * realtime operation either, so don't account its allocations. */
+            fluid_rt_exit();
+            fluid_player_playlist_load(player, msec);
+            fluid_rt_enter();
+
+            if(player->currentfile == NULL)
+            {
+                return 0;
+            }
+        }
+
+        player->cur_msec = msec;
+        player->cur_ticks = (player->start_ticks
+                             + (int)((player->cur_time - player->start_time)
+                                     / player->deltatime + 0.5)); /* 0.5 to average overall error when casting */
+
+        if(player->seek_ticks >= 0)
+        {
+            fluid_synth_all_sounds_off(synth, -1); /* avoid hanging notes */
+        }
+
+        if(player->cur_event < player->events.count)
+        {
+            status = FLUID_PLAYER_PLAYING;
+
+            if(player->seek_ticks >= 0)
+            {
+                fluid_player_seek_events(player, player->seek_ticks);
+            }
+            else if(player->use_system_timer)
+            {
+                fluid_player_send_events(player, player->cur_ticks);
+            }
+            else
+            {
+                fluid_player_send_events_exact(player);
+            }
+
+            if(player->seek_ticks < 0)
+            {
+                fluid_player_look_ahead(player);
+            }
+        }
+
+        if(player->seek_ticks >= 0)
+        {
+            player->start_ticks = player->seek_ticks;   /* tick position of last tempo value (which is now) */
+            player->cur_ticks = player->seek_ticks;
+            player->begin_msec = msec;      /* only used to calculate the duration of playing */
+            player->start_msec = msec;      /* should be the (synth)-time of the last tempo change */
+            player->start_time = player->cur_time;
+            player->seek_ticks = -1;        /* clear seek_ticks */
+        }
+
+        if(status == FLUID_PLAYER_DONE)
+        {
+            FLUID_LOG(FLUID_DBG, "%s: %d: Duration=%.3f sec", __FILE__,
+                      __LINE__, (msec - player->begin_msec) / 1000.0);
+            loadnextfile = 1;
+        }
+    }
+    while(loadnextfile);
+
+    player->status = status;
+
+    if(!player->use_system_timer && status == FLUID_PLAYER_PLAYING
+            && player->seek_ticks < 0 && player->cur_event < player->events.count)
+    {
+        fluid_player_sleep_until_next_event(player);
+    }
+
+    return 1;
+}
+
+/**
+ * Activates play mode for a MIDI player if not already playing.
+ * @param player MIDI player instance
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int
+fluid_player_play(fluid_player_t *player)
+{
+    if(player->status == FLUID_PLAYER_PLAYING ||
+       player->playlist == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    if(!player->use_system_timer)
+    {
+        fluid_sample_timer_reset(player->synth, player->sample_timer);
+    }
+
+    player->status = FLUID_PLAYER_PLAYING;
+
+    return FLUID_OK;
+}
+/**
+ * Pauses the MIDI playback.
+ *
+ * It will not rewind to the beginning of the file, use fluid_player_seek() for this purpose.
+ * @param player MIDI player instance
+ * @return Always returns #FLUID_OK
+ */
+int
+fluid_player_stop(fluid_player_t *player)
+{
+    player->status = FLUID_PLAYER_DONE;
+    fluid_player_seek(player, fluid_player_get_current_tick(player));
+    fluid_sample_timer_wakeup(player->synth, player->sample_timer);
+    return FLUID_OK;
+}
+
+/**
+ * Get MIDI player status.
+ * @param player MIDI player instance
+ * @return Player status (#fluid_player_status)
+ * @since 1.1.0
+ */
+int
+fluid_player_get_status(fluid_player_t *player)
+{
+    return player->status;
+}
+
+/**
+ * Seek in the currently playing file.
+ * @param player MIDI player instance
+ * @param ticks the position to seek to in the current file
+ * @return #FLUID_FAILED if ticks is negative or after the latest tick of the file,
+ *   #FLUID_OK otherwise
+ * @since 2.0.0
+ *
+ * The actual seek is performed during the player_callback.
+ */
+int fluid_player_seek(fluid_player_t *player, int ticks)
+{
+    if(ticks < 0 || ticks > fluid_player_get_total_ticks(player))
+    {
+        return FLUID_FAILED;
+    }
+
+    player->seek_ticks = ticks;
+    fluid_sample_timer_wakeup(player->synth, player->sample_timer);
+    return FLUID_OK;
+}
+
+
+/**
+ * Enable looping of a MIDI player
+ * @param player MIDI player instance
+ * @param loop Times left to loop the playlist. -1 means loop infinitely.
+ * @return Always returns #FLUID_OK
+ * @since 1.1.0
+ *
+ * For example, if you want to loop the playlist twice, set loop to 2
+ * and call this function before you start the player.
+ */
+int fluid_player_set_loop(fluid_player_t *player, int loop)
+{
+    player->loop = loop;
+    return FLUID_OK;
+}
+
+/**
+ * Set the tempo of a MIDI player.
+ * @param player MIDI player instance
+ * @param tempo Tempo to set playback speed to (in microseconds per quarter note, as per MIDI file spec)
+ * @return Always returns #FLUID_OK
+ */
+int fluid_player_set_midi_tempo(fluid_player_t *player, int tempo)
+{
+    player->miditempo = tempo;
+    player->deltatime = (double) tempo / player->division / 1000.0; /* in milliseconds */
+    player->start_msec = player->cur_msec;
+    player->start_time = player->cur_time;
+    player->start_ticks = player->cur_ticks;
+    fluid_sample_timer_wakeup(player->synth, player->sample_timer);
+
+    FLUID_LOG(FLUID_DBG,
+              "tempo=%d, tick time=%f msec, cur time=%d msec, cur tick=%d",
+              tempo, player->deltatime, player->cur_msec, player->cur_ticks);
+
+    return FLUID_OK;
+}
+
+/**
+ * Set the tempo of a MIDI player in beats per minute.
+ * @param player MIDI player instance
+ * @param bpm Tempo in beats per minute
+ * @return Always returns #FLUID_OK
+ */
+int fluid_player_set_bpm(fluid_player_t *player, int bpm)
+{
+    return fluid_player_set_midi_tempo(player, 60000000L / bpm);
+}
+
+/**
+ * Wait for a MIDI player until the playback has been stopped.
+ * @param player MIDI player instance
+ * @return Always #FLUID_OK
+ */
+int
+fluid_player_join(fluid_player_t *player)
+{
+    while(player->status != FLUID_PLAYER_DONE)
+    {
+        fluid_msleep(10);
+    }
+    return FLUID_OK;
+}
+
+/**
+ * Render the audio of a MIDI player until it has finished playing, and pass it
+ * to a callback in chunks of a given number of frames, e.g. to store it in
+ * memory or to stream it over the network.
+ * @param player MIDI player instance, using the sample timer (i.e. "player.timing-source"
+ *   is "sample"), which has been started with fluid_player_play()
+ * @param frames Number of frames of each chunk passed to \p func
+ * @param func Callback function receiving the audio
+ * @param data User defined data pointer passed to \p func
+ * @return #FLUID_OK on success, #FLUID_FAILED if \p func stopped rendering or an error occurred
+ * @since 2.2.0
+ *
+ * The chunks are rendered by fluid_synth_write_float() straight to the buffer
+ * passed to \p func, without copying them. As the player is only checked
+ * between chunks, the audio may end up to \p frames frames after the end
+ * of the song.
+ */
+int
+fluid_player_render(fluid_player_t *player, int frames, fluid_player_render_func_t func, void *data)
+{
+    float *buf;
+    int result = FLUID_OK;
+
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(frames > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(func != NULL, FLUID_FAILED);
+
+    buf = FLUID_ARRAY(float, 2 * frames);
+
+    if(buf == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    while(result == FLUID_OK && fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        result = fluid_synth_write_float(player->synth, frames, buf, 0, 2, buf, 1, 2);
+
+        if(result == FLUID_OK)
+        {
+            result = func(data, buf, frames);
+        }
+    }
+
+    FLUID_FREE(buf);
+
+    return result;
+}
+
+/* Length of the crossfade between the segments of fluid_player_render_segments() */
+#define FLUID_PLAYER_SEGMENT_CROSSFADE_MSEC 50
+
+/* Number of frames the threads of fluid_player_render_segments() render at once */
+#define FLUID_PLAYER_SEGMENT_CHUNK_FRAMES 4096
+
+enum
+{
+    FLUID_PLAYER_SEGMENT_PENDING,
+    FLUID_PLAYER_SEGMENT_RENDERED,
+    FLUID_PLAYER_SEGMENT_FAILED
+};
+
+/* A time segment of the song rendered by fluid_player_render_segments() */
+typedef struct
+{
+    float *buf;                 /* the interleaved stereo frames of the segment, with the crossfade to the next one */
+    int frames;
+    int state;
+} fluid_player_segment_t;
+
+/* State shared by the threads rendering the segments of a song */
+typedef struct
+{
+    fluid_synth_t *synth;       /* the synth whose SoundFonts and settings are used by all segments */
+    fluid_sfont_t **sfonts;     /* the SoundFont stack of synth, top first */
+    int sfont_count;
+    const void *buffer;         /* the MIDI file */
+    size_t buffer_len;
+    fluid_player_song_t song;   /* the song, for its tempo map */
+    double sample_rate;
+    int seg_frames;             /* length of a segment, in frames */
+    int pre_roll_frames;        /* frames rendered before a segment begins */
+    int fade_frames;            /* frames crossfaded between two segments */
+    fluid_player_segment_t *segments;
+    int count;
+    int next;                   /* index of the next segment to render */
+    int consumed;               /* number of segments passed to the callback */
+    int ahead;                  /* number of segments that may be rendered ahead of the callback */
+    fluid_atomic_int_t quit;
+    fluid_cond_mutex_t *mutex;  /* protects next, consumed and the state of the segments */
+    fluid_cond_t *cond;
+
+    fluid_player_render_func_t func;
+    void *data;
+    float *out;                 /* the chunk passed to func next */
+    int out_frames;
+    int out_pos;
+} fluid_player_segments_t;
+
+/* The time of a tick of the song, in milliseconds, from its tempo changes */
+static double
+fluid_player_segments_tick_msec(fluid_player_segments_t *segs, unsigned int ticks)
+{
+    fluid_player_events_t *events = &segs->song.events;
+    double deltatime = 500000.0 / segs->song.division / 1000.0, time = 0;
+    unsigned int start = 0;
+    int i;
+
+    for(i = 0; i < events->count && events->ticks[i] <= ticks; i++)
+    {
+        if(events->event[i].type == MIDI_SET_TEMPO)
+        {
+            time += (events->ticks[i] - start) * deltatime;
+            start = events->ticks[i];
+            deltatime = (double)events->event[i].param1 / segs->song.division / 1000.0;
+        }
+    }
+
+    return time + (ticks - start) * deltatime;
+}
+
+/* The latest tick of the song at or before a time in milliseconds */
+static unsigned int
+fluid_player_segments_msec_tick(fluid_player_segments_t *segs, double msec)
+{
+    fluid_player_events_t *events = &segs->song.events;
+    double deltatime = 500000.0 / segs->song.division / 1000.0, time = 0, t;
+    unsigned int start = 0;
+    int i;
+
+    for(i = 0; i < events->count; i++)
+    {
+        if(events->event[i].type == MIDI_SET_TEMPO)
+        {
+            t = time + (events->ticks[i] - start) * deltatime;
+
+            if(t > msec)
+            {
+                break;
+            }
+
+            time = t;
+            start = events->ticks[i];
+            deltatime = (double)events->event[i].param1 / segs->song.division / 1000.0;
+        }
+    }
+
+    return start + (unsigned int)((msec - time) / deltatime);
+}
+
+/*
+ * Render segment k of the song with a synth and a player of its own. The
+ * player seeks to the pre-roll before the segment, which replays the program
+ * changes and controllers up to there, and lets the notes held over the
+ * beginning of the segment, their release and the effects settle before the
+ * frames of the segment are kept.
+ */
+static int
+fluid_player_segments_render(fluid_player_segments_t *segs, int k)
+{
+    fluid_player_segment_t *seg = &segs->segments[k];
+    fluid_synth_t *synth;
+    fluid_player_t *player = NULL;
+    double begin = (double)k * segs->seg_frames, origin = 0;
+    int last = (k == segs->count - 1);
+    int i, n, seek = -1, start, skip, keep, size, pos = 0, result = FLUID_FAILED;
+    float *buf;
+
+    if(k > 0 && begin > segs->pre_roll_frames)
+    {
+        seek = (int)fluid_player_segments_msec_tick(segs, (begin - segs->pre_roll_frames) * 1000 / segs->sample_rate);
+        origin = fluid_player_segments_tick_msec(segs, seek) * segs->sample_rate / 1000;
+    }
+
+    /* rendered from the block of the seek, so that the blocks are those of a single synth playing the song */
+    start = FLUID_BUFSIZE * (int)(origin / FLUID_BUFSIZE);
+    skip = k * segs->seg_frames - start;
+    keep = segs->seg_frames + segs->fade_frames;
+    size = last ? segs->seg_frames + FLUID_PLAYER_SEGMENT_CHUNK_FRAMES : keep;
+    seg->buf = FLUID_ARRAY(float, 2 * size);
+
+    if(seg->buf == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* the synths share the settings, their creation and deletion are serialized */
+    fluid_cond_mutex_lock(segs->mutex);
+    synth = new_fluid_synth(segs->synth->settings);
+
+    if(synth != NULL)
+    {
+        for(i = segs->sfont_count - 1; i >= 0; i--)
+        {
+            /* keep the id the SoundFont has in segs->synth */
+            synth->sfont_id = segs->sfonts[i]->id - 1;
+            fluid_synth_add_sfont(synth, segs->sfonts[i]);
+        }
+
+        player = new_fluid_player(synth);
+    }
+
+    fluid_cond_mutex_unlock(segs->mutex);
+
+    if(player != NULL && fluid_player_add_mem_nocopy(player, segs->buffer, segs->buffer_len) == FLUID_OK)
+    {
+        /* performed by the first callback, once the file has been loaded */
+        player->seek_ticks = seek;
+        fluid_player_play(player);
+        result = FLUID_OK;
+
+        /* the events after the seek are played at their frame in the block of the seek */
+        if(seek >= 0)
+        {
+            result = fluid_synth_write_float(synth, FLUID_BUFSIZE, seg->buf, 0, 2, seg->buf, 1, 2);
+            player->start_time += (origin - start) * 1000 / segs->sample_rate;
+            skip -= FLUID_BUFSIZE;
+        }
+
+        /* the pre-roll, rendered to the buffer of the segment and discarded */
+        while(result == FLUID_OK && skip > 0 && !fluid_atomic_int_get(&segs->quit))
+        {
+            n = (skip < size) ? skip : size;
+            n = (n < FLUID_PLAYER_SEGMENT_CHUNK_FRAMES) ? n : FLUID_PLAYER_SEGMENT_CHUNK_FRAMES;
+            result = fluid_synth_write_float(synth, n, seg->buf, 0, 2, seg->buf, 1, 2);
+            skip -= n;
+        }
+
+        /* the last segment lasts until the end of the song */
+        while(result == FLUID_OK && !fluid_atomic_int_get(&segs->quit)
+                && (last ? fluid_player_get_status(player) == FLUID_PLAYER_PLAYING : pos < keep))
+        {
+            n = last ? FLUID_PLAYER_SEGMENT_CHUNK_FRAMES : keep - pos;
+            n = (n < FLUID_PLAYER_SEGMENT_CHUNK_FRAMES) ? n : FLUID_PLAYER_SEGMENT_CHUNK_FRAMES;
+
+            if(pos + n > size)
+            {
+                buf = FLUID_REALLOC(seg->buf, 2 * 2 * size * sizeof(float));
+
+                if(buf == NULL)
+                {
+                    FLUID_LOG(FLUID_ERR, "Out of memory");
+                    result = FLUID_FAILED;
+                    break;
+                }
+
+                seg->buf = buf;
+                size *= 2;
+            }
+
+            result = fluid_synth_write_float(synth, n, seg->buf, 2 * pos, 2, seg->buf, 2 * pos + 1, 2);
+            pos += n;
+        }
+
+        if(fluid_atomic_int_get(&segs->quit))
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    seg->frames = pos;
+
+    fluid_cond_mutex_lock(segs->mutex);
+    delete_fluid_player(player);
+
+    if(synth != NULL)
+    {
+        /* give the SoundFonts back, so that deleting the synth leaves them alone */
+        for(i = 0; i < fluid_synth_count_midi_channels(synth); i++)
+        {
+            fluid_synth_unset_program(synth, i);
+        }
+
+        while(fluid_synth_sfcount(synth) > 0)
+        {
+            fluid_synth_remove_sfont(synth, fluid_synth_get_sfont(synth, 0));
+        }
+
+        delete_fluid_synth(synth);
+    }
+
+    fluid_cond_mutex_unlock(segs->mutex);
+
+    return result;
+}
+
+/* Thread rendering the segments of a song in turn, at most segs->ahead in advance of the callback */
+static fluid_thread_return_t
+fluid_player_segments_run(void *data)
+{
+    fluid_player_segments_t *segs = data;
+    int k, result;
+
+    while(1)
+    {
+        fluid_cond_mutex_lock(segs->mutex);
+
+        while(!fluid_atomic_int_get(&segs->quit) && segs->next < segs->count
+                && segs->next >= segs->consumed + segs->ahead)
+        {
+            fluid_cond_wait(segs->cond, segs->mutex);
+        }
+
+        if(fluid_atomic_int_get(&segs->quit) || segs->next >= segs->count)
+        {
+            fluid_cond_mutex_unlock(segs->mutex);
+            break;
+        }
+
+        k = segs->next++;
+        fluid_cond_mutex_unlock(segs->mutex);
+
+        result = fluid_player_segments_render(segs, k);
+
+        fluid_cond_mutex_lock(segs->mutex);
+        segs->segments[k].state = (result == FLUID_OK) ? FLUID_PLAYER_SEGMENT_RENDERED : FLUID_PLAYER_SEGMENT_FAILED;
+        fluid_cond_broadcast(segs->cond);
+        fluid_cond_mutex_unlock(segs->mutex);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Pass frames to the callback of fluid_player_render_segments(), in chunks of segs->out_frames */
+static int
+fluid_player_segments_emit(fluid_player_segments_t *segs, const float *buf, int frames)
+{
+    int n;
+
+    while(frames > 0)
+    {
+        n = segs->out_frames - segs->out_pos;
+        n = (n < frames) ? n : frames;
+
+        FLUID_MEMCPY(segs->out + 2 * segs->out_pos, buf, 2 * n * sizeof(float));
+        segs->out_pos += n;
+        buf += 2 * n;
+        frames -= n;
+
+        if(segs->out_pos == segs->out_frames)
+        {
+            segs->out_pos = 0;
+
+            if(segs->func(segs->data, segs->out, segs->out_frames) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Pass the segments to the callback in order, as they have been rendered, each
+ * of them crossfaded with the end of the previous one.
+ */
+static int
+fluid_player_segments_consume(fluid_player_segments_t *segs, float *fade)
+{
+    fluid_player_segment_t *seg, *prev = NULL;
+    int i, k, n, end, state, result = FLUID_OK;
+    float w;
+
+    for(k = 0; k < segs->count && result == FLUID_OK; k++)
+    {
+        seg = &segs->segments[k];
+
+        fluid_cond_mutex_lock(segs->mutex);
+
+        while(seg->state == FLUID_PLAYER_SEGMENT_PENDING)
+        {
+            fluid_cond_wait(segs->cond, segs->mutex);
+        }
+
+        state = seg->state;
+        fluid_cond_mutex_unlock(segs->mutex);
+
+        if(state != FLUID_PLAYER_SEGMENT_RENDERED)
+        {
+            result = FLUID_FAILED;
+            break;
+        }
+
+        n = 0;
+
+        if(prev != NULL)
+        {
+            const float *tail = prev->buf + 2 * segs->seg_frames;
+
+            n = (seg->frames < segs->fade_frames) ? seg->frames : segs->fade_frames;
+
+            for(i = 0; i < n; i++)
+            {
+                w = (i + 0.5f) / n;
+                fade[2 * i] = (1 - w) * tail[2 * i] + w * seg->buf[2 * i];
+                fade[2 * i + 1] = (1 - w) * tail[2 * i + 1] + w * seg->buf[2 * i + 1];
+            }
+
+            FLUID_FREE(prev->buf);
+            prev->buf = NULL;
+            result = fluid_player_segments_emit(segs, fade, n);
+        }
+
+        end = (k < segs->count - 1) ? segs->seg_frames : seg->frames;
+
+        if(result == FLUID_OK)
+        {
+            result = fluid_player_segments_emit(segs, seg->buf + 2 * n, end - n);
+        }
+
+        prev = seg;
+
+        /* let the threads render the next segments */
+        fluid_cond_mutex_lock(segs->mutex);
+        segs->consumed = k + 1;
+        fluid_cond_broadcast(segs->cond);
+        fluid_cond_mutex_unlock(segs->mutex);
+    }
+
+    if(result == FLUID_OK && segs->out_pos > 0)
+    {
+        result = segs->func(segs->data, segs->out, segs->out_pos);
+    }
+
+    return result;
+}
+
+/**
+ * Render the audio of the first file of a MIDI player in time segments, by
+ * several threads at once, and pass it to a callback in chunks of a given
+ * number of frames, like fluid_player_render().
+ * @param player MIDI player instance, whose synth provides the SoundFonts and the settings,
+ *   using the sample timer (i.e. "player.timing-source" is "sample")
+ * @param frames Number of frames of each chunk passed to \p func, but the last one
+ * @param jobs Number of threads rendering the segments
+ * @param func Callback function receiving the audio, called by the calling thread
+ * @param data User defined data pointer passed to \p func
+ * @return #FLUID_OK on success, #FLUID_FAILED if \p func stopped rendering or an error occurred
+ * @since 2.2.0
+ *
+ * The song is split into segments of "player.segment-length" seconds, each of
+ * them rendered by a synth and a player of its own, which share the SoundFonts
+ * of the synth of \p player. A segment starts "player.segment-pre-roll"
+ * seconds early, from the program changes and controllers replayed by seeking,
+ * so that the notes held over its beginning, their release and the effects
+ * have settled by then, and is crossfaded with the previous one over
+ * 50 milliseconds. Notes started before the pre-roll are missing, so the
+ * pre-roll should be as long as the longest release and reverb tail.
+ *
+ * The player itself is left alone, as are its playback callback and further
+ * files. The SoundFonts are used by several synths at the same time, so
+ * "synth.dynamic-sample-loading" and "synth.lazy-preset-loading" have to be
+ * disabled when loading them.
+ */
+int
+fluid_player_render_segments(fluid_player_t *player, int frames, int jobs,
+                             fluid_player_render_func_t func, void *data)
+{
+    fluid_player_segments_t segs;
+    fluid_playlist_item *item, mem_item;
+    fluid_settings_t *settings;
+    fluid_thread_t **threads = NULL;
+    char *buffer = NULL;
+    float *fade = NULL;
+    double length, pre_roll, end;
+    int i, threads_count = 0, dynamic, lazy, result = FLUID_FAILED;
+
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(frames > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(jobs > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(func != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(player->playlist != NULL, FLUID_FAILED);
+
+    settings = player->synth->settings;
+    fluid_settings_getint(settings, "synth.dynamic-sample-loading", &dynamic);
+    fluid_settings_getint(settings, "synth.lazy-preset-loading", &lazy);
+
+    if(dynamic || lazy)
+    {
+        FLUID_LOG(FLUID_ERR, "Can't render in segments with synth.dynamic-sample-loading or synth.lazy-preset-loading");
+        return FLUID_FAILED;
+    }
+
+    if(!fluid_settings_str_equal(settings, "player.timing-source", "sample"))
+    {
+        FLUID_LOG(FLUID_ERR, "Can't render in segments without the sample timer of the player");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(&segs, 0, sizeof(segs));
+    item = (fluid_playlist_item *) player->playlist->data;
+
+    /* the file is read once, the players of the segments take it from memory */
+    if(item->filename != NULL)
+    {
+        fluid_file fp = FLUID_FOPEN(item->filename, "rb");
+
+        if(fp == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Couldn't open the MIDI file");
+            return FLUID_FAILED;
+        }
+
+        buffer = fluid_file_read_full(fp, &segs.buffer_len);
+        FLUID_FCLOSE(fp);
+
+        if(buffer == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        segs.buffer = buffer;
+    }
+    else
+    {
+        segs.buffer = item->buffer;
+        segs.buffer_len = item->buffer_len;
+    }
+
+    mem_item.filename = NULL;
+    mem_item.buffer = segs.buffer;
+    mem_item.buffer_len = segs.buffer_len;
+    mem_item.buffer_copy = NULL;
+    mem_item.song = NULL;
+
+    if(fluid_player_song_load(&segs.song, &mem_item) != FLUID_OK)
+    {
+        goto exit;
+    }
 
-/**
- * Activates play mode for a MIDI player if not already playing.
- * @param player MIDI player instance
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int
-fluid_player_play(fluid_player_t *player)
-{
-    if(player->status == FLUID_PLAYER_PLAYING ||
-       player->playlist == NULL)
+    if(segs.song.division == 0)
     {
-        return FLUID_OK;
+        FLUID_LOG(FLUID_ERR, "Can't render a MIDI file without a division in segments");
+        goto exit;
     }
 
-    if(!player->use_system_timer)
+    fluid_settings_getnum(settings, "player.segment-length", &length);
+    fluid_settings_getnum(settings, "player.segment-pre-roll", &pre_roll);
+
+    segs.synth = player->synth;
+    segs.sample_rate = player->synth->output_rate;
+    segs.seg_frames = (int)(length * segs.sample_rate);
+    segs.pre_roll_frames = (int)(pre_roll * segs.sample_rate);
+    segs.fade_frames = (int)(FLUID_PLAYER_SEGMENT_CROSSFADE_MSEC * segs.sample_rate / 1000);
+
+    /* the last segment begins before the last event */
+    end = (segs.song.events.count > 0)
+          ? fluid_player_segments_tick_msec(&segs, segs.song.events.ticks[segs.song.events.count - 1]) : 0;
+    segs.count = (int)(end * segs.sample_rate / 1000 / segs.seg_frames) + 1;
+    jobs = (jobs < segs.count) ? jobs : segs.count;
+    segs.ahead = 2 * jobs;
+
+    segs.sfont_count = fluid_synth_sfcount(player->synth);
+    segs.sfonts = FLUID_ARRAY(fluid_sfont_t *, segs.sfont_count + 1);
+    segs.segments = FLUID_ARRAY(fluid_player_segment_t, segs.count);
+    segs.out = FLUID_ARRAY(float, 2 * frames);
+    segs.out_frames = frames;
+    segs.func = func;
+    segs.data = data;
+    fade = FLUID_ARRAY(float, 2 * segs.fade_frames + 2);
+    threads = FLUID_ARRAY(fluid_thread_t *, jobs);
+    segs.mutex = new_fluid_cond_mutex();
+    segs.cond = new_fluid_cond();
+
+    if(segs.sfonts == NULL || segs.segments == NULL || segs.out == NULL || fade == NULL
+            || threads == NULL || segs.mutex == NULL || segs.cond == NULL)
     {
-        fluid_sample_timer_reset(player->synth, player->sample_timer);
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto exit;
     }
 
-    player->status = FLUID_PLAYER_PLAYING;
+    FLUID_MEMSET(segs.segments, 0, segs.count * sizeof(*segs.segments));
 
-    return FLUID_OK;
-}
-/**
- * Pauses the MIDI playback.
- *
- * It will not rewind to the beginning of the file, use fluid_player_seek() for this purpose.
- * @param player MIDI player instance
- * @return Always returns #FLUID_OK
- */
-int
-fluid_player_stop(fluid_player_t *player)
-{
-    player->status = FLUID_PLAYER_DONE;
-    fluid_player_seek(player, fluid_player_get_current_tick(player));
-    return FLUID_OK;
-}
+    for(i = 0; i < segs.sfont_count; i++)
+    {
+        segs.sfonts[i] = fluid_synth_get_sfont(player->synth, i);
+    }
 
-/**
- * Get MIDI player status.
- * @param player MIDI player instance
- * @return Player status (#fluid_player_status)
- * @since 1.1.0
- */
-int
-fluid_player_get_status(fluid_player_t *player)
-{
-    return player->status;
-}
+    FLUID_LOG(FLUID_INFO, "Rendering %d segments of %.1f sec with %d threads", segs.count, length, jobs);
 
-/**
- * Seek in the currently playing file.
- * @param player MIDI player instance
- * @param ticks the position to seek to in the current file
- * @return #FLUID_FAILED if ticks is negative or after the latest tick of the file,
- *   #FLUID_OK otherwise
- * @since 2.0.0
- *
- * The actual seek is performed during the player_callback.
- */
-int fluid_player_seek(fluid_player_t *player, int ticks)
-{
-    if(ticks < 0 || ticks > fluid_player_get_total_ticks(player))
+    for(threads_count = 0; threads_count < jobs; threads_count++)
     {
-        return FLUID_FAILED;
+        threads[threads_count] = new_fluid_thread("player-segment", fluid_player_segments_run, &segs, 0, FALSE);
+
+        if(threads[threads_count] == NULL)
+        {
+            break;
+        }
     }
 
-    player->seek_ticks = ticks;
-    return FLUID_OK;
-}
+    if(threads_count == 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the threads rendering the segments");
+        goto exit;
+    }
 
+    result = fluid_player_segments_consume(&segs, fade);
 
-/**
- * Enable looping of a MIDI player
- * @param player MIDI player instance
- * @param loop Times left to loop the playlist. -1 means loop infinitely.
- * @return Always returns #FLUID_OK
- * @since 1.1.0
- *
- * For example, if you want to loop the playlist twice, set loop to 2
- * and call this function before you start the player.
- */
-int fluid_player_set_loop(fluid_player_t *player, int loop)
-{
-    player->loop = loop;
-    return FLUID_OK;
-}
+exit:
 
-/**
- * Set the tempo of a MIDI player.
- * @param player MIDI player instance
- * @param tempo Tempo to set playback speed to (in microseconds per quarter note, as per MIDI file spec)
- * @return Always returns #FLUID_OK
- */
-int fluid_player_set_midi_tempo(fluid_player_t *player, int tempo)
-{
-    player->miditempo = tempo;
-    player->deltatime = (double) tempo / player->division / 1000.0; /* in milliseconds */
-    player->start_msec = player->cur_msec;
-    player->start_ticks = player->cur_ticks;
+    if(segs.mutex != NULL && segs.cond != NULL)
+    {
+        fluid_cond_mutex_lock(segs.mutex);
+        fluid_atomic_int_set(&segs.quit, TRUE);
+        fluid_cond_broadcast(segs.cond);
+        fluid_cond_mutex_unlock(segs.mutex);
+    }
 
-    FLUID_LOG(FLUID_DBG,
-              "tempo=%d, tick time=%f msec, cur time=%d msec, cur tick=%d",
-              tempo, player->deltatime, player->cur_msec, player->cur_ticks);
+    for(i = 0; i < threads_count; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
 
-    return FLUID_OK;
-}
+    if(segs.segments != NULL)
+    {
+        for(i = 0; i < segs.count; i++)
+        {
+            FLUID_FREE(segs.segments[i].buf);
+        }
+    }
 
-/**
- * Set the tempo of a MIDI player in beats per minute.
- * @param player MIDI player instance
- * @param bpm Tempo in beats per minute
- * @return Always returns #FLUID_OK
- */
-int fluid_player_set_bpm(fluid_player_t *player, int bpm)
-{
-    return fluid_player_set_midi_tempo(player, 60000000L / bpm);
-}
+    if(segs.cond != NULL)
+    {
+        delete_fluid_cond(segs.cond);
+    }
 
-/**
- * Wait for a MIDI player until the playback has been stopped.
- * @param player MIDI player instance
- * @return Always #FLUID_OK
- */
-int
-fluid_player_join(fluid_player_t *player)
-{
-    while(player->status != FLUID_PLAYER_DONE)
+    if(segs.mutex != NULL)
     {
-        fluid_msleep(10);
+        delete_fluid_cond_mutex(segs.mutex);
     }
-    return FLUID_OK;
+
+    fluid_player_song_free(&segs.song);
+    FLUID_FREE(segs.segments);
+    FLUID_FREE(segs.sfonts);
+    FLUID_FREE(segs.out);
+    FLUID_FREE(fade);
+    FLUID_FREE(threads);
+    FLUID_FREE(buffer);
+
+    return result;
 }
 
 /**
@@ -2267,23 +3816,10 @@ int fluid_player_get_current_tick(fluid_player_t *player)
  */
 int fluid_player_get_total_ticks(fluid_player_t *player)
 {
-    int i;
-    int maxTicks = 0;
-
-    for(i = 0; i < player->ntracks; i++)
-    {
-        if(player->track[i] != NULL)
-        {
-            int ticks = fluid_track_get_duration(player->track[i]);
-
-            if(ticks > maxTicks)
-            {
-                maxTicks = ticks;
-            }
-        }
-    }
+    fluid_player_events_t *events = &player->events;
 
-    return maxTicks;
+    /* the events are sorted, the last one is the very last to play */
+    return (events->count > 0) ? (int)events->ticks[events->count - 1] : 0;
 }
 
 /**
@@ -2343,6 +3879,62 @@ delete_fluid_midi_parser(fluid_midi_parser_t *parser)
     FLUID_FREE(parser);
 }
 
+/* Store a data byte of the current message, and return the message once it is complete */
+static FLUID_INLINE fluid_midi_event_t *
+fluid_midi_parser_data(fluid_midi_parser_t *parser, unsigned char c)
+{
+    /* Discard data bytes for events we don't care about */
+    if(parser->status == 0)
+    {
+        return NULL;
+    }
+
+    /* Max data size exceeded? (SYSEX messages only really) */
+    if(parser->nr_bytes == FLUID_MIDI_PARSER_MAX_DATA_SIZE)
+    {
+        parser->status = 0; /* Discard the rest of the message */
+        return NULL;
+    }
+
+    /* Store next byte */
+    parser->data[parser->nr_bytes++] = c;
+
+    /* Do we still need more data to get this event complete? */
+    if(parser->status == MIDI_SYSEX || parser->nr_bytes < parser->nr_bytes_total)
+    {
+        return NULL;
+    }
+
+    /* Event is complete, return it.
+     * Running status byte MIDI feature is also handled here. */
+    parser->event.type = parser->status;
+    parser->event.channel = parser->channel;
+    parser->nr_bytes = 0; /* Reset data size, in case there are additional running status messages */
+
+    switch(parser->status)
+    {
+    case NOTE_OFF:
+    case NOTE_ON:
+    case KEY_PRESSURE:
+    case CONTROL_CHANGE:
+    case PROGRAM_CHANGE:
+    case CHANNEL_PRESSURE:
+        parser->event.param1 = parser->data[0]; /* For example key number */
+        parser->event.param2 = parser->data[1]; /* For example velocity */
+        break;
+
+    case PITCH_BEND:
+        /* Pitch-bend is transmitted with 14-bit precision. */
+        parser->event.param1 = (parser->data[1] << 7) | parser->data[0];
+        break;
+
+    default: /* Unlikely */
+        return NULL;
+    }
+
+    return &parser->event;
+}
+
 /**
  * Parse a MIDI stream one character at a time.
  * @param parser Parser instance
@@ -2414,57 +4006,60 @@ fluid_midi_parser_parse(fluid_midi_parser_t *parser, unsigned char c)
     }
 
     /* Data/parameter byte */
+    return fluid_midi_parser_data(parser, c);
+}
 
-    /* Discard data bytes for events we don't care about */
-    if(parser->status == 0)
-    {
-        return NULL;
-    }
-
-    /* Max data size exceeded? (SYSEX messages only really) */
-    if(parser->nr_bytes == FLUID_MIDI_PARSER_MAX_DATA_SIZE)
-    {
-        parser->status = 0; /* Discard the rest of the message */
-        return NULL;
-    }
-
-    /* Store next byte */
-    parser->data[parser->nr_bytes++] = c;
+/*
+ * Parse a buffer of a MIDI stream, storing the events it contains to an array.
+ * Parsing stops at the end of the buffer, when max_events events have been
+ * parsed, or after a SYSEX event, whose data is stored by the parser and only
+ * valid until the next call, like with fluid_midi_parser_parse(). Messages
+ * spanning several buffers, running status and real-time messages in the
+ * middle of other messages are handled just the same.
+ * @param parser Parser instance
+ * @param buf Bytes of the MIDI stream
+ * @param len Count of bytes in buf
+ * @param events Array to store the parsed events to
+ * @param max_events Size of the events array
+ * @param consumed Returns the count of bytes parsed, which is less than len
+ *   if parsing stopped early
+ * @return Count of events stored to events
+ */
+int
+fluid_midi_parser_parse_buffer(fluid_midi_parser_t *parser, const unsigned char *buf, int len,
+                               fluid_midi_event_t *events, int max_events, int *consumed)
+{
+    fluid_midi_event_t *event;
+    int i, count = 0;
 
-    /* Do we still need more data to get this event complete? */
-    if(parser->status == MIDI_SYSEX || parser->nr_bytes < parser->nr_bytes_total)
+    for(i = 0; i < len && count < max_events; i++)
     {
-        return NULL;
-    }
-
-    /* Event is complete, return it.
-     * Running status byte MIDI feature is also handled here. */
-    parser->event.type = parser->status;
-    parser->event.channel = parser->channel;
-    parser->nr_bytes = 0; /* Reset data size, in case there are additional running status messages */
+        /* Data bytes are the most frequent ones, especially with running status */
+        if(buf[i] & 0x80)
+        {
+            event = fluid_midi_parser_parse(parser, buf[i]);
+        }
+        else
+        {
+            event = fluid_midi_parser_data(parser, buf[i]);
+        }
 
-    switch(parser->status)
-    {
-    case NOTE_OFF:
-    case NOTE_ON:
-    case KEY_PRESSURE:
-    case CONTROL_CHANGE:
-    case PROGRAM_CHANGE:
-    case CHANNEL_PRESSURE:
-        parser->event.param1 = parser->data[0]; /* For example key number */
-        parser->event.param2 = parser->data[1]; /* For example velocity */
-        break;
+        if(event == NULL)
+        {
+            continue;
+        }
 
-    case PITCH_BEND:
-        /* Pitch-bend is transmitted with 14-bit precision. */
-        parser->event.param1 = (parser->data[1] << 7) | parser->data[0];
-        break;
+        events[count++] = *event;
 
-    default: /* Unlikely */
-        return NULL;
+        if(event->type == MIDI_SYSEX)
+        {
+            i++;
+            break;
+        }
     }
 
-    return &parser->event;
+    *consumed = i;
+    return count;
 }
 
 /* Purpose:
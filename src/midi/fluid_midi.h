@@ -30,6 +30,11 @@ typedef struct _fluid_midi_parser_t fluid_midi_parser_t;
 fluid_midi_parser_t *new_fluid_midi_parser(void);
 void delete_fluid_midi_parser(fluid_midi_parser_t *parser);
 fluid_midi_event_t *fluid_midi_parser_parse(fluid_midi_parser_t *parser, unsigned char c);
+int fluid_midi_parser_parse_buffer(fluid_midi_parser_t *parser, const unsigned char *buf, int len,
+                                   fluid_midi_event_t *events, int max_events, int *consumed);
+
+/* Count of events the MIDI drivers parse at once with fluid_midi_parser_parse_buffer() */
+#define FLUID_MIDI_PARSER_MAX_EVENTS 64
 
 
 /***************************************************************
@@ -244,16 +249,43 @@ struct _fluid_track_t
     char *name;
     int num;
     fluid_midi_event_t *first;
-    fluid_midi_event_t *cur;
     fluid_midi_event_t *last;
-    unsigned int ticks;
 };
 
 typedef struct _fluid_track_t fluid_track_t;
 
-#define fluid_track_eot(track)  ((track)->cur == NULL)
+
+/*
+ * fluid_player_events_t
+ * All events of the loaded MIDI file merged in the order they are played,
+ * built once after the tracks have been loaded.
+ */
+typedef struct
+{
+    int count;                  /* number of events */
+    unsigned int *ticks;        /* absolute tick of each event */
+    fluid_midi_event_t *event;  /* copy of each event, SYSEX data remain owned by the tracks */
+    int replay_count;           /* number of events replayed when seeking */
+    int *replay;                /* indices of the events replayed when seeking, i.e. all but notes and EOT */
+} fluid_player_events_t;
 
 
+/*
+ * fluid_player
+ */
+/*
+ * fluid_player_song_t
+ * The tracks of a MIDI file and their events merged, loaded by the player
+ * before it is played, or preloaded meanwhile by its thread.
+ */
+typedef struct
+{
+    int ntracks;
+    fluid_track_t *track[MAX_NUMBER_OF_TRACKS];
+    fluid_player_events_t events;
+    unsigned int division;
+} fluid_player_song_t;
+
 /*
  * fluid_playlist_item
  * Used as the `data' elements of the fluid_player.playlist.
@@ -263,18 +295,38 @@ typedef struct _fluid_track_t fluid_track_t;
 typedef struct
 {
     char *filename;     /** Name of file (owned); NULL if data pre-loaded */
-    void *buffer;       /** The MIDI file data (owned); NULL if filename */
+    const void *buffer; /** The MIDI file data; NULL if filename */
     size_t buffer_len;  /** Number of bytes in buffer; 0 if filename */
+    void *buffer_copy;  /** The buffer if copied by fluid_player_add_mem() (owned); NULL if borrowed */
+    fluid_player_song_t *song; /** The song loaded from the file (owned), kept with "player.cache-songs"; NULL if not loaded */
 } fluid_playlist_item;
 
-/*
- * fluid_player
- */
+/* The number of requests the player may queue to its lookahead thread */
+#define FLUID_PLAYER_LOOKAHEAD_REQUESTS 64
+
+/* A request of the player to its lookahead thread */
+typedef struct
+{
+    enum
+    {
+        FLUID_PLAYER_LOOKAHEAD_PRELOAD,     /* preload the program of the program change event */
+        FLUID_PLAYER_LOOKAHEAD_RELEASE,     /* release the presets of the events before event */
+        FLUID_PLAYER_LOOKAHEAD_RELEASE_ALL  /* release all the presets */
+    } type;
+    int chan;
+    int bank_msb;
+    int bank_lsb;
+    int prog;
+    int event;
+} fluid_player_lookahead_request_t;
+
 struct _fluid_player_t
 {
     int status;
     int ntracks;
     fluid_track_t *track[MAX_NUMBER_OF_TRACKS];
+    fluid_player_events_t events; /* the events of all tracks in playing order */
+    int cur_event;            /* index of the next event to play */
     fluid_synth_t *synth;
     fluid_timer_t *system_timer;
     fluid_sample_timer_t *sample_timer;
@@ -286,21 +338,51 @@ struct _fluid_player_t
     char send_program_change; /* should we ignore the program changes? */
     char use_system_timer;   /* if zero, use sample timers, otherwise use system clock timer */
     char reset_synth_between_songs; /* 1 if system reset should be sent to the synth between songs. */
+    char cache_songs;         /* keep the songs loaded by the playlist items, see "player.cache-songs" */
+    char song_cached;         /* the tracks and events played are owned by the song of the current playlist item */
     int seek_ticks;           /* new position in tempo ticks (midi ticks) for seeking */
     int start_ticks;          /* the number of tempo ticks passed at the last tempo change */
     int cur_ticks;            /* the number of tempo ticks passed */
     int begin_msec;           /* the time (msec) of the beginning of the file */
     int start_msec;           /* the start time of the last tempo change */
     int cur_msec;             /* the current time */
+    double start_time;        /* the exact time (msec) of the last tempo change */
+    double cur_time;          /* the exact current time (msec), the start of the block about to be rendered with the sample timer */
     int miditempo;            /* as indicated by MIDI SetTempo: n 24th of a usec per midi-clock. bravo! */
     double deltatime;         /* milliseconds per midi tick. depends on set-tempo */
     unsigned int division;
 
     handle_midi_event_func_t playback_callback; /* function fired on each midi event as it is played */
     void *playback_userdata; /* pointer to user-defined data passed to playback_callback function */
+
+    /* preloading of the next file of the playlist, see "player.preload" */
+    fluid_thread_t *preload_thread;
+    fluid_cond_mutex_t *preload_mutex; /* protects the fields below */
+    fluid_cond_t *preload_cond;
+    fluid_list_t *preload_request;  /* playlist item for the thread to preload next, or NULL */
+    fluid_list_t *preload_item;     /* playlist item preloaded to preload_song, or NULL */
+    fluid_player_song_t preload_song;
+    int preload_quit;
+
+    /* preloading of the presets selected by the program changes ahead, see "player.program-lookahead" */
+    double lookahead_msec;          /* how far ahead, 0 if disabled */
+    int lookahead_event;            /* index of the next event to look at, -1 to start over from cur_event */
+    int lookahead_channels;
+    int lookahead_released;         /* index of the first event looked at whose presets haven't been requested to be released */
+    int *lookahead_bank;            /* the bank select MSB and LSB of each channel up to lookahead_event, -1 if unchanged */
+    fluid_thread_t *lookahead_thread; /* preloading and releasing the presets, off the rendering thread */
+    fluid_list_t *lookahead_presets; /* the presets preloaded (fluid_player_lookahead_t), in playing order, owned by the thread */
+    fluid_cond_mutex_t *lookahead_mutex; /* protects the fields below */
+    fluid_cond_t *lookahead_cond;
+    fluid_player_lookahead_request_t lookahead_requests[FLUID_PLAYER_LOOKAHEAD_REQUESTS]; /* queued for the thread */
+    int lookahead_first;            /* index of the first request queued */
+    int lookahead_count;            /* the number of requests queued */
+    int lookahead_busy;             /* the thread is carrying out a request */
+    int lookahead_quit;
 };
 
 void fluid_player_settings(fluid_settings_t *settings);
+int fluid_player_lookahead_pending(fluid_player_t *player);
 
 
 /*
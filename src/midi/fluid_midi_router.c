@@ -28,14 +28,42 @@
 #include "fluid_midi.h"
 #include "fluid_synth.h"
 
+/*
+ * The rules compiled into a table, looked up by rule type and input channel.
+ * Each row lists the rules whose channel window matches, in the order of the
+ * rule lists, along with the channel of the events they generate. The last
+ * row of each rule type lists all of its rules, for event channels beyond
+ * the synth's channels, and their channels are computed for every event.
+ *
+ * A table is never changed once in use. Rule changes compile a new one,
+ * which takes over atomically, so that every event is handled either with
+ * the rules before or after the change.
+ */
+typedef struct
+{
+    fluid_midi_router_rule_t *rule;
+    int chan;                                  /* Channel of the generated events, -1 if it depends on the event */
+    int waiting;                               /* The rule's waiting flag when the table was compiled */
+} fluid_midi_router_entry_t;
+
+typedef struct
+{
+    int nr_chans;                              /* Count of input channels having a row of their own */
+    int *rows;                                 /* Index of the first entry of each row, and one past the last row */
+    fluid_midi_router_entry_t *entries;
+} fluid_midi_router_table_t;
+
 /*
  * fluid_midi_router
  */
 struct _fluid_midi_router_t
 {
-    fluid_mutex_t rules_mutex;
+    fluid_mutex_t rules_mutex;                 /* Serializes rule changes, events are handled without it */
     fluid_midi_router_rule_t *rules[FLUID_MIDI_ROUTER_RULE_COUNT];        /* List of rules for each rule type */
-    fluid_midi_router_rule_t *free_rules;      /* List of rules to free (was waiting for final events which were received) */
+    fluid_midi_router_rule_t *free_rules;      /* List of rules removed, to free once no event is handled with them */
+
+    fluid_midi_router_table_t *table;          /* Rules compiled for handling events, swapped atomically */
+    fluid_atomic_int_t readers;                /* Count of events being handled, with any table */
 
     handle_midi_event_func_t event_handler;    /* Callback function for generated events */
     void *event_handler_data;                  /* One arg for the callback */
@@ -60,12 +88,13 @@ struct _fluid_midi_router_rule_t
     fluid_real_t par2_mul;
     int par2_add;
 
-    int pending_events;                      /* In case of noteon: How many keys are still down? */
-    char keys_cc[128];                       /* Flags, whether a key is down / controller is set (sustain) */
+    fluid_atomic_int_t pending_events;       /* In case of noteon: How many keys are still down? -1 once the rule is removed */
+    fluid_atomic_int_t keys_cc[128];         /* Flags, whether a key is down / controller is set (sustain) */
     fluid_midi_router_rule_t *next;          /* next entry */
-    int waiting;                             /* Set to TRUE when rule has been deactivated but there are still pending_events */
+    int waiting;                             /* Set to TRUE when rule has been deactivated but there are still pending_events, with rules_mutex locked */
 };
 
+static int fluid_midi_router_update_table(fluid_midi_router_t *router);
 
 /**
  * Create a new midi router.  The default rules will pass all events unmodified.
@@ -115,6 +144,11 @@ new_fluid_midi_router(fluid_settings_t *settings, handle_midi_event_func_t handl
         }
     }
 
+    if(fluid_midi_router_update_table(router) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
     return router;
 
 error_recovery:
@@ -146,97 +180,237 @@ delete_fluid_midi_router(fluid_midi_router_t *router)
         }
     }
 
+    for(rule = router->free_rules; rule; rule = next_rule)
+    {
+        next_rule = rule->next;
+        FLUID_FREE(rule);
+    }
+
+    FLUID_FREE(router->table);
     fluid_mutex_destroy(router->rules_mutex);
     FLUID_FREE(router);
 }
 
-/**
- * Set a MIDI router to use default "unity" rules. Such a router will pass all
- * events unmodified.
- * @param router Router to set to default rules.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- * @since 1.1.0
- */
-int
-fluid_midi_router_set_default_rules(fluid_midi_router_t *router)
+/* Returns TRUE if the value is within the window of a rule */
+static FLUID_INLINE int
+fluid_midi_router_rule_match(int min, int max, int value)
 {
-    fluid_midi_router_rule_t *new_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
-    fluid_midi_router_rule_t *del_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
-    fluid_midi_router_rule_t *rule, *next_rule, *prev_rule;
-    int i, i2;
+    if(min > max)
+    {
+        /* Inverted rule: Exclude everything between max and min (but not min/max) */
+        return !(value > max && value < min);
+    }
 
-    fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
+    /* Normal rule: Exclude everything < max or > min (but not min/max) */
+    return !(value > max || value < min);
+}
 
-    /* Allocate new default rules outside of lock */
+/* Scales and offsets a value of a matching event, and limits it to 0..max */
+static FLUID_INLINE int
+fluid_midi_router_rule_map(int value, fluid_real_t mul, int add, int max)
+{
+    value = add + (int)((fluid_real_t)value * mul + (fluid_real_t)0.5);
 
-    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+    if(value < 0)
     {
-        new_rules[i] = new_fluid_midi_router_rule();
+        return 0;
+    }
 
-        if(!new_rules[i])
-        {
-            /* Free already allocated rules */
-            for(i2 = 0; i2 < i; i2++)
-            {
-                delete_fluid_midi_router_rule(new_rules[i2]);
-            }
+    return (value > max) ? max : value;
+}
 
-            return FLUID_FAILED;
-        }
+/* The channel of the events a rule generates for an input channel.
+ * Note: rule->chan_mul will probably be 0 or 1. If it's 0, input from all
+ * input channels is mapped to the same synth channel. */
+static int
+fluid_midi_router_rule_chan(fluid_midi_router_t *router, fluid_midi_router_rule_t *rule, int chan)
+{
+    chan = rule->chan_add + (int)((fluid_real_t)chan * rule->chan_mul + (fluid_real_t)0.5);
+
+    /* Channel range limiting */
+    if(chan < 0)
+    {
+        chan = 0;
+    }
+    else if(chan >= router->nr_midi_channels)
+    {
+        chan = router->nr_midi_channels - 1;
     }
 
+    return chan;
+}
 
-    fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
+/*
+ * Unlinks the rules from the rule lists which are done, and if all is TRUE
+ * deactivates every other rule: they wait for the negative events of their
+ * pending events, and are done if there aren't any. The rules unlinked are
+ * held in router->free_rules until the next table is in use. Must be called
+ * with rules_mutex locked.
+ */
+static void
+fluid_midi_router_remove_rules(fluid_midi_router_t *router, int all)
+{
+    fluid_midi_router_rule_t *rule, *next_rule, *prev_rule;
+    int i;
 
     for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
     {
-        del_rules[i] = NULL;
         prev_rule = NULL;
 
-        /* Process existing rules */
         for(rule = router->rules[i]; rule; rule = next_rule)
         {
             next_rule = rule->next;
 
-            if(rule->pending_events == 0)     /* Rule has no pending events? */
+            if(fluid_atomic_int_get(&rule->pending_events) < 0)     /* Rule is done? */
             {
                 /* Remove rule from rule list */
                 if(prev_rule)
                 {
                     prev_rule->next = next_rule;
                 }
-                else if(rule == router->rules[i])
+                else
                 {
                     router->rules[i] = next_rule;
                 }
 
-                /* Prepend to delete list */
-                rule->next = del_rules[i];
-                del_rules[i] = rule;
+                /* Prepend to free list */
+                rule->next = router->free_rules;
+                router->free_rules = rule;
             }
             else
             {
-                rule->waiting = TRUE;          /* Pending events, mark as waiting */
+                if(all)
+                {
+                    rule->waiting = TRUE;
+                }
+
                 prev_rule = rule;
             }
         }
+    }
+}
 
-        /* Prepend new default rule */
-        new_rules[i]->next = router->rules[i];
-        router->rules[i] = new_rules[i];
+/* Compiles the rules of the router into a new table */
+static fluid_midi_router_table_t *
+new_fluid_midi_router_table(fluid_midi_router_t *router)
+{
+    fluid_midi_router_table_t *table;
+    fluid_midi_router_rule_t *rule;
+    int nr_chans = (router->nr_midi_channels > 0) ? router->nr_midi_channels : 0;
+    int nr_rows = FLUID_MIDI_ROUTER_RULE_COUNT * (nr_chans + 1);
+    int i, chan, row, n = 0;
+
+    /* Count the entries */
+    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+    {
+        for(rule = router->rules[i]; rule; rule = rule->next)
+        {
+            for(chan = 0; chan < nr_chans; chan++)
+            {
+                n += fluid_midi_router_rule_match(rule->chan_min, rule->chan_max, chan);
+            }
+
+            n++;
+        }
     }
 
-    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
+    /* A single allocation, the entries first for their alignment */
+    table = FLUID_MALLOC(sizeof(fluid_midi_router_table_t) + n * sizeof(fluid_midi_router_entry_t)
+                         + (nr_rows + 1) * sizeof(int));
+
+    if(table == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    table->nr_chans = nr_chans;
+    table->entries = (fluid_midi_router_entry_t *)(table + 1);
+    table->rows = (int *)(table->entries + n);
+
+    for(i = 0, row = 0, n = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+    {
+        for(chan = 0; chan < nr_chans; chan++)
+        {
+            table->rows[row++] = n;
+
+            for(rule = router->rules[i]; rule; rule = rule->next)
+            {
+                if(fluid_midi_router_rule_match(rule->chan_min, rule->chan_max, chan))
+                {
+                    table->entries[n].rule = rule;
+                    table->entries[n].chan = fluid_midi_router_rule_chan(router, rule, chan);
+                    table->entries[n].waiting = rule->waiting;
+                    n++;
+                }
+            }
+        }
+
+        table->rows[row++] = n;
+
+        for(rule = router->rules[i]; rule; rule = rule->next)
+        {
+            table->entries[n].rule = rule;
+            table->entries[n].chan = -1;
+            table->entries[n].waiting = rule->waiting;
+            n++;
+        }
+    }
+
+    table->rows[row] = n;
+
+    return table;
+}
+
+/*
+ * Compiles the rules and swaps the new table in, then waits until no event
+ * is handled with the old table anymore, before freeing it along with the
+ * rules removed. Deactivated rules without pending events are done from
+ * then on. Must be called with rules_mutex locked.
+ */
+static int
+fluid_midi_router_update_table(fluid_midi_router_t *router)
+{
+    fluid_midi_router_table_t *table, *old_table;
+    fluid_midi_router_rule_t *rule, *next_rule;
+    int i;
+
+    table = new_fluid_midi_router_table(router);
+
+    if(table == NULL)
+    {
+        /* The old table stays in use, the rules removed from it are skipped */
+        return FLUID_FAILED;
+    }
+
+    old_table = fluid_atomic_pointer_get(&router->table);
+    fluid_atomic_pointer_set(&router->table, table);
 
+    /* Any event handled from now on uses the new table */
+    while(fluid_atomic_int_get(&router->readers) > 0)
+    {
+        fluid_msleep(1);
+    }
+
+    FLUID_FREE(old_table);
 
-    /* Free old rules outside of lock */
+    for(rule = router->free_rules; rule; rule = next_rule)
+    {
+        next_rule = rule->next;
+        FLUID_FREE(rule);
+    }
 
+    router->free_rules = NULL;
+
+    /* No more pending events can be counted while their rule is active */
     for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
     {
-        for(rule = del_rules[i]; rule; rule = next_rule)
+        for(rule = router->rules[i]; rule; rule = rule->next)
         {
-            next_rule = rule->next;
-            FLUID_FREE(rule);
+            if(rule->waiting)
+            {
+                fluid_atomic_int_compare_and_exchange(&rule->pending_events, 0, -1);
+            }
         }
     }
 
@@ -244,72 +418,79 @@ fluid_midi_router_set_default_rules(fluid_midi_router_t *router)
 }
 
 /**
- * Clear all rules in a MIDI router. Such a router will drop all events until
- * rules are added.
- * @param router Router to clear all rules from
+ * Set a MIDI router to use default "unity" rules. Such a router will pass all
+ * events unmodified.
+ * @param router Router to set to default rules.
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  * @since 1.1.0
  */
 int
-fluid_midi_router_clear_rules(fluid_midi_router_t *router)
+fluid_midi_router_set_default_rules(fluid_midi_router_t *router)
 {
-    fluid_midi_router_rule_t *del_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
-    fluid_midi_router_rule_t *rule, *next_rule, *prev_rule;
-    int i;
+    fluid_midi_router_rule_t *new_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
+    int i, i2, ret;
 
     fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
 
-    fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
+    /* Allocate new default rules outside of lock */
 
     for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
     {
-        del_rules[i] = NULL;
-        prev_rule = NULL;
+        new_rules[i] = new_fluid_midi_router_rule();
 
-        /* Process existing rules */
-        for(rule = router->rules[i]; rule; rule = next_rule)
+        if(!new_rules[i])
         {
-            next_rule = rule->next;
-
-            if(rule->pending_events == 0)     /* Rule has no pending events? */
-            {
-                /* Remove rule from rule list */
-                if(prev_rule)
-                {
-                    prev_rule->next = next_rule;
-                }
-                else if(rule == router->rules[i])
-                {
-                    router->rules[i] = next_rule;
-                }
-
-                /* Prepend to delete list */
-                rule->next = del_rules[i];
-                del_rules[i] = rule;
-            }
-            else
+            /* Free already allocated rules */
+            for(i2 = 0; i2 < i; i2++)
             {
-                rule->waiting = TRUE;           /* Pending events, mark as waiting */
-                prev_rule = rule;
+                delete_fluid_midi_router_rule(new_rules[i2]);
             }
+
+            return FLUID_FAILED;
         }
     }
 
-    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
 
+    fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
 
-    /* Free old rules outside of lock */
+    fluid_midi_router_remove_rules(router, TRUE);
 
     for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
     {
-        for(rule = del_rules[i]; rule; rule = next_rule)
-        {
-            next_rule = rule->next;
-            FLUID_FREE(rule);
-        }
+        /* Prepend new default rule */
+        new_rules[i]->next = router->rules[i];
+        router->rules[i] = new_rules[i];
     }
 
-    return FLUID_OK;
+    ret = fluid_midi_router_update_table(router);
+
+    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
+
+    return ret;
+}
+
+/**
+ * Clear all rules in a MIDI router. Such a router will drop all events until
+ * rules are added.
+ * @param router Router to clear all rules from
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 1.1.0
+ */
+int
+fluid_midi_router_clear_rules(fluid_midi_router_t *router)
+{
+    int ret;
+
+    fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
+
+    fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
+
+    fluid_midi_router_remove_rules(router, TRUE);
+    ret = fluid_midi_router_update_table(router);
+
+    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
+
+    return ret;
 }
 
 /**
@@ -325,7 +506,7 @@ int
 fluid_midi_router_add_rule(fluid_midi_router_t *router, fluid_midi_router_rule_t *rule,
                            int type)
 {
-    fluid_midi_router_rule_t *free_rules, *next_rule;
+    int ret;
 
     fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(rule != NULL, FLUID_FAILED);
@@ -334,25 +515,23 @@ fluid_midi_router_add_rule(fluid_midi_router_t *router, fluid_midi_router_rule_t
 
     fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
 
-    /* Take over free rules list, if any (to free outside of lock) */
-    free_rules = router->free_rules;
-    router->free_rules = NULL;
+    /* Drop any deactivated rules which were waiting for events and are now done */
+    fluid_midi_router_remove_rules(router, FALSE);
 
     rule->next = router->rules[type];
     router->rules[type] = rule;
 
-    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
-
+    ret = fluid_midi_router_update_table(router);
 
-    /* Free any deactivated rules which were waiting for events and are now done */
-
-    for(; free_rules; free_rules = next_rule)
+    if(ret != FLUID_OK)
     {
-        next_rule = free_rules->next;
-        FLUID_FREE(free_rules);
+        /* The caller keeps the rule */
+        router->rules[type] = rule->next;
     }
 
-    return FLUID_OK;
+    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
+
+    return ret;
 }
 
 /**
@@ -535,12 +714,19 @@ fluid_midi_router_rule_set_param2(fluid_midi_router_rule_t *rule, int min, int m
  * - velocity switching ("v <=100: Angel Choir; V > 100: Hell's Bells")
  * - get rid of aftertouch
  * - ...
+ *
+ * Events are handled without taking a lock, in constant time for the rules
+ * not matching their channel. Functions changing the rules wait for the
+ * events being handled, so they must not be called from within \a handler.
  */
 int
 fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
 {
     fluid_midi_router_t *router = (fluid_midi_router_t *)data;
-    fluid_midi_router_rule_t **rulep, *rule, *next_rule, *prev_rule = NULL;
+    fluid_midi_router_table_t *table;
+    const fluid_midi_router_entry_t *entry, *end;
+    fluid_midi_router_rule_t *rule;
+    int type;
     int event_has_par2 = 0; /* Flag, indicates that current event needs two parameters */
     int par1_max = 127;     /* Range limit for par1 */
     int par2_max = 127;     /* Range limit for par2 */
@@ -551,6 +737,7 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
     int par2;
     int event_par1;
     int event_par2;
+    int row, pending;
     fluid_midi_event_t new_event;
 
     /* Some keyboards report noteoff through a noteon event with vel=0.
@@ -561,228 +748,159 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
         event->param2 = 127;        /* Release velocity */
     }
 
-    fluid_mutex_lock(router->rules_mutex);    /* ++ lock rules */
-
     /* Depending on the event type, choose the correct list of rules. */
     switch(event->type)
     {
     case NOTE_ON:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_NOTE];
+        type = FLUID_MIDI_ROUTER_RULE_NOTE;
         event_has_par2 = 1;
         break;
 
     case NOTE_OFF:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_NOTE];
+        type = FLUID_MIDI_ROUTER_RULE_NOTE;
         event_has_par2 = 1;
         break;
 
     case CONTROL_CHANGE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_CC];
+        type = FLUID_MIDI_ROUTER_RULE_CC;
         event_has_par2 = 1;
         break;
 
     case PROGRAM_CHANGE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_PROG_CHANGE];
+        type = FLUID_MIDI_ROUTER_RULE_PROG_CHANGE;
         break;
 
     case PITCH_BEND:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_PITCH_BEND];
+        type = FLUID_MIDI_ROUTER_RULE_PITCH_BEND;
         par1_max = 16383;
         break;
 
     case CHANNEL_PRESSURE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_CHANNEL_PRESSURE];
+        type = FLUID_MIDI_ROUTER_RULE_CHANNEL_PRESSURE;
         break;
 
     case KEY_PRESSURE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_KEY_PRESSURE];
+        type = FLUID_MIDI_ROUTER_RULE_KEY_PRESSURE;
         event_has_par2 = 1;
         break;
 
     case MIDI_SYSTEM_RESET:
     case MIDI_SYSEX:
-        ret_val = router->event_handler(router->event_handler_data, event);
-        fluid_mutex_unlock(router->rules_mutex);   /* -- unlock rules */
-        return ret_val;
+        return router->event_handler(router->event_handler_data, event);
 
     default:
-        rulep = NULL;    /* Event will not be passed on */
-        break;
+        return FLUID_OK;    /* Event will not be passed on */
     }
 
-    /* Loop over rules in the list, looking for matches for this event. */
-    for(rule = rulep ? *rulep : NULL; rule; prev_rule = rule, rule = next_rule)
+    event_par1 = (int)event->param1;
+    event_par2 = (int)event->param2;
+
+    /* Announce the event before taking the table, the table is not freed until it's handled */
+    fluid_atomic_int_inc(&router->readers);
+    table = fluid_atomic_pointer_get(&router->table);
+
+    /* The row of the event's channel, or the one of all rules for other channels */
+    row = type * (table->nr_chans + 1)
+          + ((event->channel < table->nr_chans) ? event->channel : table->nr_chans);
+
+    entry = table->entries + table->rows[row];
+    end = table->entries + table->rows[row + 1];
+
+    /* Loop over the rules matching the event's channel, looking for matches for this event. */
+    for(; entry < end; entry++)
     {
-        event_par1 = (int)event->param1;
-        event_par2 = (int)event->param2;
-        next_rule = rule->next;     /* Rule may get removed from list, so get next here */
+        rule = entry->rule;
 
-        /* Channel window */
-        if(rule->chan_min > rule->chan_max)
+        /* Rule removed since the table was compiled? */
+        if(fluid_atomic_int_get(&rule->pending_events) < 0)
         {
-            /* Inverted rule: Exclude everything between max and min (but not min/max) */
-            if(event->channel > rule->chan_max && event->channel < rule->chan_min)
-            {
-                continue;
-            }
+            continue;
         }
-        else        /* Normal rule: Exclude everything < max or > min (but not min/max) */
+
+        chan = entry->chan;
+
+        if(chan < 0)
         {
-            if(event->channel > rule->chan_max || event->channel < rule->chan_min)
+            /* Channel window */
+            if(!fluid_midi_router_rule_match(rule->chan_min, rule->chan_max, event->channel))
             {
                 continue;
             }
+
+            chan = fluid_midi_router_rule_chan(router, rule, event->channel);
         }
 
         /* Par 1 window */
-        if(rule->par1_min > rule->par1_max)
-        {
-            /* Inverted rule: Exclude everything between max and min (but not min/max) */
-            if(event_par1 > rule->par1_max && event_par1 < rule->par1_min)
-            {
-                continue;
-            }
-        }
-        else        /* Normal rule: Exclude everything < max or > min (but not min/max)*/
+        if(!fluid_midi_router_rule_match(rule->par1_min, rule->par1_max, event_par1))
         {
-            if(event_par1 > rule->par1_max || event_par1 < rule->par1_min)
-            {
-                continue;
-            }
+            continue;
         }
 
         /* Par 2 window (only applies to event types, which have 2 pars)
          * For noteoff events, velocity switching doesn't make any sense.
          * Velocity scaling might be useful, though.
          */
-        if(event_has_par2 && event->type != NOTE_OFF)
+        if(event_has_par2 && event->type != NOTE_OFF
+                && !fluid_midi_router_rule_match(rule->par2_min, rule->par2_max, event_par2))
         {
-            if(rule->par2_min > rule->par2_max)
-            {
-                /* Inverted rule: Exclude everything between max and min (but not min/max) */
-                if(event_par2 > rule->par2_max && event_par2 < rule->par2_min)
-                {
-                    continue;
-                }
-            }
-            else      /* Normal rule: Exclude everything < max or > min (but not min/max)*/
-            {
-                if(event_par2 > rule->par2_max || event_par2 < rule->par2_min)
-                {
-                    continue;
-                }
-            }
+            continue;
         }
 
-        /* Channel scaling / offset
-         * Note: rule->chan_mul will probably be 0 or 1. If it's 0, input from all
-         * input channels is mapped to the same synth channel.
-         */
-        chan = rule->chan_add + (int)((fluid_real_t)event->channel * rule->chan_mul
-                     + (fluid_real_t)0.5);
-
         /* Par 1 scaling / offset */
-        par1 = rule->par1_add + (int)((fluid_real_t)event_par1 * rule->par1_mul
-                     + (fluid_real_t)0.5);
+        par1 = fluid_midi_router_rule_map(event_par1, rule->par1_mul, rule->par1_add, par1_max);
 
         /* Par 2 scaling / offset, if applicable */
-        if(event_has_par2)
-        {
-            par2 = rule->par2_add + (int)((fluid_real_t)event_par2 * rule->par2_mul
-                         + (fluid_real_t)0.5);
-        }
-        else
-        {
-            par2 = 0;
-        }
-
-        /* Channel range limiting */
-        if(chan < 0)
-        {
-            chan = 0;
-        }
-        else if(chan >= router->nr_midi_channels)
-        {
-            chan = router->nr_midi_channels - 1;
-        }
-
-        /* Par1 range limiting */
-        if(par1 < 0)
-        {
-            par1 = 0;
-        }
-        else if(par1 > par1_max)
-        {
-            par1 = par1_max;
-        }
-
-        /* Par2 range limiting */
-        if(event_has_par2)
-        {
-            if(par2 < 0)
-            {
-                par2 = 0;
-            }
-            else if(par2 > par2_max)
-            {
-                par2 = par2_max;
-            }
-        }
+        par2 = event_has_par2 ? fluid_midi_router_rule_map(event_par2, rule->par2_mul, rule->par2_add, par2_max) : 0;
 
         /* At this point we have to create an event of event->type on 'chan' with par1 (maybe par2).
          * We keep track on the state of noteon and sustain pedal events. If the application tries
          * to delete a rule, it will only be fully removed, if pending noteoff / pedal off events have
          * arrived. In the meantime while waiting, it will only let through 'negative' events
-         * (noteoff or pedal up).
+         * (noteoff or pedal up). The state may change concurrently on other threads, and the rule
+         * may get removed, so it is only changed atomically.
          */
         if(event->type == NOTE_ON || (event->type == CONTROL_CHANGE
                                       && par1 == SUSTAIN_SWITCH && par2 >= 64))
         {
             /* Noteon or sustain pedal down event generated */
-            if(rule->keys_cc[par1] == 0)
+            if(fluid_atomic_int_compare_and_exchange(&rule->keys_cc[par1], 0, 1))
             {
-                rule->keys_cc[par1] = 1;
-                rule->pending_events++;
+                /* Count the pending event, unless the rule was removed meanwhile */
+                do
+                {
+                    pending = fluid_atomic_int_get(&rule->pending_events);
+                }
+                while(pending >= 0 && !fluid_atomic_int_compare_and_exchange(&rule->pending_events, pending, pending + 1));
+
+                if(pending < 0)
+                {
+                    fluid_atomic_int_set(&rule->keys_cc[par1], 0);
+                    continue;
+                }
             }
         }
         else if(event->type == NOTE_OFF || (event->type == CONTROL_CHANGE
                                             && par1 == SUSTAIN_SWITCH && par2 < 64))
         {
             /* Noteoff or sustain pedal up event generated */
-            if(rule->keys_cc[par1] > 0)
+            if(fluid_atomic_int_compare_and_exchange(&rule->keys_cc[par1], 1, 0))
             {
-                rule->keys_cc[par1] = 0;
-                rule->pending_events--;
-
                 /* Rule is waiting for negative event to be destroyed? */
-                if(rule->waiting)
+                if(fluid_atomic_int_dec_and_test(&rule->pending_events) && entry->waiting)
                 {
-                    if(rule->pending_events == 0)
-                    {
-                        /* Remove rule from rule list */
-                        if(prev_rule)
-                        {
-                            prev_rule->next = next_rule;
-                        }
-                        else
-                        {
-                            *rulep = next_rule;
-                        }
-
-                        /* Add to free list */
-                        rule->next = router->free_rules;
-                        router->free_rules = rule;
-
-                        rule = prev_rule;   /* Set rule to previous rule, which gets assigned to the next prev_rule value (in for() statement) */
-                    }
+                    /* Done, it's removed from the rule list on the next rule change */
+                    fluid_atomic_int_compare_and_exchange(&rule->pending_events, 0, -1);
+                }
 
+                if(entry->waiting)
+                {
                     goto send_event;      /* Pass the event to complete the cycle */
                 }
             }
         }
 
         /* Rule is still waiting for negative event? (note off or pedal up) */
-        if(rule->waiting)
+        if(entry->waiting)
         {
             continue;    /* Skip (rule is inactive except for matching negative event) */
         }
@@ -804,11 +922,55 @@ send_event:
         }
     }
 
-    fluid_mutex_unlock(router->rules_mutex);          /* -- unlock rules */
+    fluid_atomic_int_add(&router->readers, -1);
 
     return ret_val;
 }
 
+/*
+ * Handle a batch of MIDI events, as fluid_midi_router_handle_midi_event()
+ * would one after the other. If the router ends at a synth, its API is
+ * entered once for the whole batch.
+ */
+int
+fluid_midi_router_handle_midi_events(fluid_midi_router_t *router, fluid_midi_event_t **events, int n)
+{
+    int i, result = FLUID_OK;
+    fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
+
+    if(router->event_handler == fluid_synth_handle_midi_event)
+    {
+        return fluid_synth_handle_midi_batch(router->event_handler_data, fluid_midi_router_handle_midi_event,
+                                             router, events, n);
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        if(fluid_midi_router_handle_midi_event(router, events[i]) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * The synth the router sends its events to, NULL if they go to another handler
+ */
+fluid_synth_t *
+fluid_midi_router_get_synth(fluid_midi_router_t *router)
+{
+    fluid_return_val_if_fail(router != NULL, NULL);
+
+    if(router->event_handler == fluid_synth_handle_midi_event)
+    {
+        return router->event_handler_data;
+    }
+
+    return NULL;
+}
+
 /**
  * MIDI event callback function to display event information to stdout
  * @param data MIDI router instance
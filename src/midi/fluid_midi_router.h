@@ -28,5 +28,8 @@
 #include "fluid_midi.h"
 #include "fluid_sys.h"
 
+int fluid_midi_router_handle_midi_events(fluid_midi_router_t *router, fluid_midi_event_t **events, int n);
+fluid_synth_t *fluid_midi_router_get_synth(fluid_midi_router_t *router);
+
 
 #endif
@@ -36,8 +36,19 @@
  *                           SEQUENCER
  */
 
+/* Number of event entries allocated in advance, more are allocated when needed */
 #define FLUID_SEQUENCER_EVENTS_MAX	1000
 
+/* One bucket of the radix heap for each bit of the 32 bit event time, plus one for the earliest time */
+#define FLUID_SEQUENCER_QUEUE_BUCKETS 33
+
+typedef struct
+{
+    fluid_evt_entry *first;
+    fluid_evt_entry *last;
+    unsigned int min_time;  /* earliest time of the events in this bucket */
+} fluid_seq_queue_bucket_t;
+
 /* Private data for SEQUENCER */
 struct _fluid_sequencer_t
 {
@@ -48,16 +59,12 @@ struct _fluid_sequencer_t
     fluid_list_t *clients;
     fluid_seq_id_t clientsID;
     /* for queue + heap */
-    fluid_evt_entry *preQueue;
-    fluid_evt_entry *preQueueLast;
+    fluid_evt_entry *preQueue;  /* lockless stack of entries not yet in the queue, latest first */
     fluid_timer_t *timer;
-    int queue0StartTime;
-    short prevCellNb;
-    fluid_evt_entry *queue0[256][2];
-    fluid_evt_entry *queue1[255][2];
-    fluid_evt_entry *queueLater;
+    int queueLastTick;          /* latest tick whose events have been sent */
+    unsigned int queueBase;     /* time of the events in queue[0], no event in the queue is earlier */
+    fluid_seq_queue_bucket_t queue[FLUID_SEQUENCER_QUEUE_BUCKETS];
     fluid_evt_heap_t *heap;
-    fluid_mutex_t mutex;
 };
 
 /* Private data for clients */
@@ -73,11 +80,14 @@ typedef struct _fluid_sequencer_client_t
 static short _fluid_seq_queue_init(fluid_sequencer_t *seq, int nbEvents);
 static void _fluid_seq_queue_end(fluid_sequencer_t *seq);
 static short _fluid_seq_queue_pre_insert(fluid_sequencer_t *seq, fluid_event_t *evt);
+static void _fluid_seq_queue_push_pre_queue_list(fluid_sequencer_t *seq, fluid_evt_entry *top,
+        fluid_evt_entry *bottom);
 static void _fluid_seq_queue_pre_remove(fluid_sequencer_t *seq, fluid_seq_id_t src, fluid_seq_id_t dest, int type);
 static int _fluid_seq_queue_process(void *data, unsigned int msec); // callback from timer
 static void _fluid_seq_queue_insert_entry(fluid_sequencer_t *seq, fluid_evt_entry *evtentry);
 static void _fluid_seq_queue_remove_entries_matching(fluid_sequencer_t *seq, fluid_evt_entry *temp);
 static void _fluid_seq_queue_send_queued_events(fluid_sequencer_t *seq);
+static void _fluid_seq_queue_shift(fluid_sequencer_t *seq, int delta);
 static void _fluid_free_evt_queue(fluid_evt_entry **first, fluid_evt_entry **last);
 
 
@@ -462,6 +472,71 @@ fluid_sequencer_send_at(fluid_sequencer_t *seq, fluid_event_t *evt,
     return _fluid_seq_queue_pre_insert(seq, evt);
 }
 
+/**
+ * Schedule several events for sending at later times at once.
+ * @param seq Sequencer object
+ * @param events Array of \a count events to send (will be copied into internal queue)
+ * @param times Array of \a count time values in ticks, one for each event (see fluid_sequencer_send_at())
+ * @param count Number of events
+ * @param absolute TRUE if \a times are absolute sequencer time (time since sequencer
+ *   creation), FALSE if relative to current time.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise, in which case none of the events has been scheduled
+ * @since 2.2.0
+ *
+ * Does the same as calling fluid_sequencer_send_at() for each event in turn,
+ * but takes the memory for all of them from the event queue at once, and
+ * passes them on to the sequencer thread in one go. Events at the same time
+ * are sent in the order of the array. Unlike fluid_sequencer_send_at(), this
+ * function doesn't change the time stamp of the events passed, so that the
+ * same events may be used again for the next call, without allocating any.
+ */
+int
+fluid_sequencer_send_batch(fluid_sequencer_t *seq, fluid_event_t **events, const unsigned int *times,
+                           int count, int absolute)
+{
+    fluid_evt_entry *entry, *next, *top = NULL, *bottom;
+    unsigned int now;
+    int i;
+
+    fluid_return_val_if_fail(seq != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(events != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(times != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(count >= 0, FLUID_FAILED);
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    entry = bottom = _fluid_seq_heap_get_free_list(seq->heap, count);
+
+    if(entry == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "sequencer: Out of memory\n");
+        return FLUID_FAILED;
+    }
+
+    now = fluid_sequencer_get_tick(seq);
+
+    /* stack the entries in reverse order, the first event at the bottom */
+    for(i = 0; i < count; i++, entry = next)
+    {
+        next = entry->next;
+
+        entry->entryType = FLUID_EVT_ENTRY_INSERT;
+        entry->scale = seq->scale;
+        FLUID_MEMCPY(&(entry->evt), events[i], sizeof(fluid_event_t));
+        fluid_event_set_time(&(entry->evt), absolute ? times[i] : now + times[i]);
+
+        entry->next = top;
+        top = entry;
+    }
+
+    _fluid_seq_queue_push_pre_queue_list(seq, top, bottom);
+
+    return FLUID_OK;
+}
+
 /**
  * Remove events from the event queue.
  * @param seq Sequencer object
@@ -542,23 +617,14 @@ fluid_sequencer_set_time_scale(fluid_sequencer_t *seq, double scale)
 
         seq->scale = scale;
 
-        // change start0 so that cellNb is preserved
-        seq->queue0StartTime = (seq->queue0StartTime + seq->prevCellNb) * (seq->scale / oldScale) - seq->prevCellNb;
-
-        // change all preQueue events for new scale
+        // events already queued keep their delay in ticks to the latest tick processed,
+        // events in the preQueue get adjusted to the new scale when they are queued
+        if(seq->queueLastTick >= 0)
         {
-            fluid_evt_entry *tmp;
-            tmp = seq->preQueue;
+            int lastTick = seq->queueLastTick * (seq->scale / oldScale);
 
-            while(tmp)
-            {
-                if(tmp->entryType == FLUID_EVT_ENTRY_INSERT)
-                {
-                    tmp->evt.time = tmp->evt.time * seq->scale / oldScale;
-                }
-
-                tmp = tmp->next;
-            }
+            _fluid_seq_queue_shift(seq, lastTick - seq->queueLastTick);
+            seq->queueLastTick = lastTick;
         }
 
         /* re-start timer */
@@ -581,6 +647,24 @@ fluid_sequencer_get_time_scale(fluid_sequencer_t *seq)
     return seq->scale;
 }
 
+/**
+ * Get statistics about the event queue of a sequencer.
+ * @param seq Sequencer object
+ * @param capacity Returns the number of events the sequencer has allocated memory for (may be NULL)
+ * @param queued Returns the number of events currently scheduled (may be NULL)
+ * @param max_queued Returns the largest number of events that have been scheduled at once (may be NULL)
+ *
+ * The capacity grows on demand, it is never exceeded by the number of scheduled events.
+ * @since 2.2.0
+ */
+void
+fluid_sequencer_get_queue_stats(fluid_sequencer_t *seq, int *capacity, int *queued, int *max_queued)
+{
+    fluid_return_if_fail(seq != NULL);
+
+    _fluid_evt_heap_get_stats(seq->heap, capacity, queued, max_queued);
+}
+
 
 /**********************
 
@@ -593,65 +677,56 @@ fluid_sequencer_get_time_scale(fluid_sequencer_t *seq)
 
   Data structures
 
-  There is a heap, allocated at init time, for managing a pool
-  of event entries, that is description of an event, its time,
-  and whether it is a normal event or a removal command.
-
-  The queue is separated in two arrays, and a list.  The first
-  array 'queue0' corresponds to the events to be sent in the
-  next 256 ticks (0 to 255), the second array 'queue1' contains
-  the events to be send from now+256 to now+65535. The list
-  called 'queueLater' contains the events to be sent later than
-  that. In each array, one cell contains a list of events having
-  the same time (in the queue0 array), or the same time/256 (in
-  the queue1 array), and a pointer to the last event in the list
-  of the cell so as to be able to insert fast at the end of the
-  list (i.e. a cell = 2 pointers).  The 'queueLater' list is
-  ordered by time and by post time.  This way, inserting 'soon'
-  events is fast (below 65535 ticks, that is about 1 minute if 1
-  tick=1ms).  Inserting later events is more slow, but this is a
-  realtime engine, isn't it ?
-
-  The queue0 starts at queue0StartTime.  When 256 ticks have
-  elapsed, the queue0 array is emptied, and the first cell of
-  the queue1 array is expanded in the queue0 array, according to
-  the time of each event. The queue1 array is shifted to the
-  left, and the first events of the queueLater list are inserte
-  in the last cell of the queue1 array.
-
-  We remember the previously managed cell in queue0 in the
-  prevCellNb variable. When processing the current cell, we
-  process the events in between (late events).
+  There is a heap, allocated at init time and growing on demand, for
+  managing a pool of event entries, that is description of an event,
+  its time, and whether it is a normal event or a removal command.
+
+  The queue is a radix heap: an array of buckets, each holding a
+  list of events, and the time 'queueBase' no queued event is earlier
+  than. Bucket 0 contains the events at queueBase, bucket i (i > 0)
+  the events whose time first differs from queueBase in bit i - 1
+  (counting from the least significant bit). All events of a bucket
+  are earlier than the events of the following buckets, and the
+  events of a bucket are kept in the order they have been inserted,
+  so that events at the same time are sent in the order they have
+  been sent to the sequencer.
+
+  Inserting an event merely appends it to its bucket. Once bucket 0
+  is empty, queueBase is advanced to the earliest event of the next
+  non-empty bucket, which is redistributed to the buckets below it.
+  As an event only ever moves to lower buckets, it is moved at most
+  32 times, so that inserting and sending an event takes amortized
+  constant time, however far in the future the event is.
+
+  We remember the latest tick whose events have been sent in
+  queueLastTick. Events inserted for this tick or earlier are late
+  and sent immediately.
 
   Functions
 
   The main thread functions first get an event entry from the
-  heap, and copy the given event into it, then merely enqueue it
-  in a preQueue. This is in order to protect the data structure:
+  heap, and copy the given event into it, then merely push it
+  to the preQueue. This is in order to protect the data structure:
   everything is managed in the callback (thread or interrupt,
   depending on the architecture).
 
-  All queue data structure management is done in a timer
-  callback: '_fluid_seq_queue_process'.  The
-  _fluid_seq_queue_process function first process the preQueue,
-  inserting or removing event entries from the queue, then
-  processes the queue, by sending events ready to be sent at the
-  current time.
+  All queue data structure management is done in
+  fluid_sequencer_process(), called by the sequencer timer or
+  the synth. It first processes the preQueue, inserting or removing
+  event entries from the queue, then processes the queue, by sending
+  events ready to be sent at the current time.
 
   Critical sections between the main thread (or app) and the
   sequencer thread (or interrupt) are:
 
   - the heap management (if two threads get a free event at the
-  same time)
-  - the preQueue access.
-
-  These are really small and fast sections (merely a pointer or
-  two changing value). They are not protected by a mutex for now
-  (August 2002). Waiting for crossplatform mutex solutions. When
-  changing this code, beware that the
-  _fluid_seq_queue_pre_insert function may be called by the
-  callback of the queue thread (ex : a note event inserts a
-  noteoff event).
+  same time), protected by the mutex of the heap
+  - the preQueue access. The preQueue is a lockless stack: entries
+  are pushed with a compare-and-exchange on its top, and the sequencer
+  thread takes the whole stack at once and reverses it. When changing
+  this code, beware that the _fluid_seq_queue_pre_insert function may
+  be called by the callback of the queue thread (ex : a note event
+  inserts a noteoff event).
 
 */
 
@@ -672,16 +747,11 @@ _fluid_seq_queue_init(fluid_sequencer_t *seq, int maxEvents)
     }
 
     seq->preQueue = NULL;
-    seq->preQueueLast = NULL;
 
-    FLUID_MEMSET(seq->queue0, 0, 2 * 256 * sizeof(fluid_evt_entry *));
-    FLUID_MEMSET(seq->queue1, 0, 2 * 255 * sizeof(fluid_evt_entry *));
+    FLUID_MEMSET(seq->queue, 0, sizeof(seq->queue));
 
-    seq->queueLater = NULL;
-    seq->queue0StartTime = fluid_sequencer_get_tick(seq);
-    seq->prevCellNb = -1;
-
-    fluid_mutex_init(seq->mutex);
+    seq->queueLastTick = (int)fluid_sequencer_get_tick(seq) - 1;
+    seq->queueBase = 0;
 
     /* start timer */
     if(seq->useSystemTimer)
@@ -698,26 +768,18 @@ _fluid_seq_queue_end(fluid_sequencer_t *seq)
 {
     int i;
 
-    /* free all remaining events */
-    _fluid_free_evt_queue(&seq->preQueue, &seq->preQueueLast);
-
-    for(i = 0; i < 256; i++)
-    {
-        _fluid_free_evt_queue(&(seq->queue0[i][0]), &(seq->queue0[i][1]));
-    }
-
-    for(i = 0; i < 255; i++)
+    if(seq->timer)
     {
-        _fluid_free_evt_queue(&(seq->queue1[i][0]), &(seq->queue1[i][1]));
+        delete_fluid_timer(seq->timer);
+        seq->timer = NULL;
     }
 
-    _fluid_free_evt_queue(&seq->queueLater, NULL);
-
+    /* free all remaining events */
+    _fluid_free_evt_queue(&seq->preQueue, NULL);
 
-    if(seq->timer)
+    for(i = 0; i < FLUID_SEQUENCER_QUEUE_BUCKETS; i++)
     {
-        delete_fluid_timer(seq->timer);
-        seq->timer = NULL;
+        _fluid_free_evt_queue(&seq->queue[i].first, &seq->queue[i].last);
     }
 
     if(seq->heap)
@@ -725,8 +787,6 @@ _fluid_seq_queue_end(fluid_sequencer_t *seq)
         _fluid_evt_heap_free(seq->heap);
         seq->heap = NULL;
     }
-
-    fluid_mutex_destroy(seq->mutex);
 }
 
 
@@ -735,6 +795,53 @@ _fluid_seq_queue_end(fluid_sequencer_t *seq)
 /* queue management */
 /********************/
 
+/* Push a stack of event entries linked from top to bottom to the preQueue at once,
+ * without locking. May be called by any thread at any time. */
+static void
+_fluid_seq_queue_push_pre_queue_list(fluid_sequencer_t *seq, fluid_evt_entry *top, fluid_evt_entry *bottom)
+{
+    fluid_evt_entry *prev_top;
+
+    do
+    {
+        prev_top = fluid_atomic_pointer_get(&seq->preQueue);
+        bottom->next = prev_top;
+    }
+    while(!fluid_atomic_pointer_compare_and_exchange(&seq->preQueue, prev_top, top));
+}
+
+/* Push an event entry to the preQueue, without locking.
+ * May be called by any thread at any time. */
+static void
+_fluid_seq_queue_push_pre_queue(fluid_sequencer_t *seq, fluid_evt_entry *evtentry)
+{
+    _fluid_seq_queue_push_pre_queue_list(seq, evtentry, evtentry);
+}
+
+/* Take all entries from the preQueue, in the order they have been pushed */
+static fluid_evt_entry *
+_fluid_seq_queue_take_pre_queue(fluid_sequencer_t *seq)
+{
+    fluid_evt_entry *top, *next, *first = NULL;
+
+    do
+    {
+        top = fluid_atomic_pointer_get(&seq->preQueue);
+    }
+    while(!fluid_atomic_pointer_compare_and_exchange(&seq->preQueue, top, NULL));
+
+    /* reverse the stack */
+    while(top)
+    {
+        next = top->next;
+        top->next = first;
+        first = top;
+        top = next;
+    }
+
+    return first;
+}
+
 /* Create event_entry and append to the preQueue.
  * May be called from the main thread (usually) but also recursively
  * from the queue thread, when a callback itself does an insert... */
@@ -745,30 +852,15 @@ _fluid_seq_queue_pre_insert(fluid_sequencer_t *seq, fluid_event_t *evt)
 
     if(evtentry == NULL)
     {
-        /* should not happen */
-        FLUID_LOG(FLUID_PANIC, "sequencer: no more free events\n");
+        FLUID_LOG(FLUID_PANIC, "sequencer: Out of memory\n");
         return -1;
     }
 
-    evtentry->next = NULL;
     evtentry->entryType = FLUID_EVT_ENTRY_INSERT;
+    evtentry->scale = seq->scale;
     FLUID_MEMCPY(&(evtentry->evt), evt, sizeof(fluid_event_t));
 
-    fluid_mutex_lock(seq->mutex);
-
-    /* append to preQueue */
-    if(seq->preQueueLast)
-    {
-        seq->preQueueLast->next = evtentry;
-    }
-    else
-    {
-        seq->preQueue = evtentry;
-    }
-
-    seq->preQueueLast = evtentry;
-
-    fluid_mutex_unlock(seq->mutex);
+    _fluid_seq_queue_push_pre_queue(seq, evtentry);
 
     return (0);
 }
@@ -783,12 +875,10 @@ _fluid_seq_queue_pre_remove(fluid_sequencer_t *seq, fluid_seq_id_t src, fluid_se
 
     if(evtentry == NULL)
     {
-        /* should not happen */
-        FLUID_LOG(FLUID_PANIC, "sequencer: no more free events\n");
+        FLUID_LOG(FLUID_PANIC, "sequencer: Out of memory\n");
         return;
     }
 
-    evtentry->next = NULL;
     evtentry->entryType = FLUID_EVT_ENTRY_REMOVE;
     {
         fluid_event_t *evt = &(evtentry->evt);
@@ -798,22 +888,7 @@ _fluid_seq_queue_pre_remove(fluid_sequencer_t *seq, fluid_seq_id_t src, fluid_se
         evt->type = type;
     }
 
-    fluid_mutex_lock(seq->mutex);
-
-    /* append to preQueue */
-    if(seq->preQueueLast)
-    {
-        seq->preQueueLast->next = evtentry;
-    }
-    else
-    {
-        seq->preQueue = evtentry;
-    }
-
-    seq->preQueueLast = evtentry;
-
-    fluid_mutex_unlock(seq->mutex);
-    return;
+    _fluid_seq_queue_push_pre_queue(seq, evtentry);
 }
 
 static void
@@ -865,14 +940,8 @@ fluid_sequencer_process(fluid_sequencer_t *seq, unsigned int msec)
     fluid_evt_entry *tmp;
     fluid_evt_entry *next;
 
-    fluid_mutex_lock(seq->mutex);
-
     /* get the preQueue */
-    tmp = seq->preQueue;
-    seq->preQueue = NULL;
-    seq->preQueueLast = NULL;
-
-    fluid_mutex_unlock(seq->mutex);
+    tmp = _fluid_seq_queue_take_pre_queue(seq);
 
     /* walk all the preQueue and process them in order : inserts and removes */
     while(tmp)
@@ -885,6 +954,12 @@ fluid_sequencer_process(fluid_sequencer_t *seq, unsigned int msec)
         }
         else
         {
+            /* the scale has changed since the event was sent */
+            if(tmp->scale != seq->scale)
+            {
+                tmp->evt.time = tmp->evt.time * seq->scale / tmp->scale;
+            }
+
             _fluid_seq_queue_insert_entry(seq, tmp);
         }
 
@@ -897,102 +972,96 @@ fluid_sequencer_process(fluid_sequencer_t *seq, unsigned int msec)
 
 }
 
-#if 0
-static void
-_fluid_seq_queue_print_later(fluid_sequencer_t *seq)
+/* Index of the bucket of the radix heap an event at time belongs to */
+static int
+_fluid_seq_queue_bucket(fluid_sequencer_t *seq, unsigned int time)
 {
-    int count = 0;
-    fluid_evt_entry *tmp = seq->queueLater;
-
-    printf("queueLater:\n");
+    unsigned int diff = time ^ seq->queueBase;
+    int bucket = 0;
 
-    while(tmp)
+    while(diff)
     {
-        unsigned int delay = tmp->evt.time - seq->queue0StartTime;
-        printf("queueLater: Delay = %i\n", delay);
-        tmp = tmp->next;
-        count++;
+        diff >>= 1;
+        bucket++;
     }
 
-    printf("queueLater: Total of %i events\n", count);
+    return bucket;
 }
-#endif
 
+/* Append an event entry to its bucket, its time must not be earlier than queueBase */
 static void
-_fluid_seq_queue_insert_queue0(fluid_sequencer_t *seq, fluid_evt_entry *tmp, int cell)
+_fluid_seq_queue_append(fluid_sequencer_t *seq, fluid_evt_entry *evtentry)
 {
-    if(seq->queue0[cell][1] == NULL)
+    fluid_seq_queue_bucket_t *bucket = &seq->queue[_fluid_seq_queue_bucket(seq, evtentry->evt.time)];
+
+    if(bucket->first == NULL)
     {
-        seq->queue0[cell][1] = seq->queue0[cell][0] = tmp;
+        bucket->first = evtentry;
+        bucket->min_time = evtentry->evt.time;
     }
     else
     {
-        seq->queue0[cell][1]->next = tmp;
-        seq->queue0[cell][1] = tmp;
+        bucket->last->next = evtentry;
+
+        if(evtentry->evt.time < bucket->min_time)
+        {
+            bucket->min_time = evtentry->evt.time;
+        }
     }
 
-    tmp->next = NULL;
+    bucket->last = evtentry;
+    evtentry->next = NULL;
 }
 
-static void
-_fluid_seq_queue_insert_queue1(fluid_sequencer_t *seq, fluid_evt_entry *tmp, int cell)
+/* Remove the earliest event entry from the queue if it is due at tick 'now'.
+ * Returns NULL if there's no such event. */
+static fluid_evt_entry *
+_fluid_seq_queue_pop(fluid_sequencer_t *seq, unsigned int now)
 {
-    if(seq->queue1[cell][1] == NULL)
-    {
-        seq->queue1[cell][1] = seq->queue1[cell][0] = tmp;
-    }
-    else
+    fluid_seq_queue_bucket_t *bucket = &seq->queue[0];
+    fluid_evt_entry *evtentry;
+
+    if(bucket->first == NULL)
     {
-        seq->queue1[cell][1]->next = tmp;
-        seq->queue1[cell][1] = tmp;
-    }
+        fluid_evt_entry *next;
+        int i;
 
-    tmp->next = NULL;
-}
+        for(i = 1; i < FLUID_SEQUENCER_QUEUE_BUCKETS && seq->queue[i].first == NULL; i++)
+        {
+        }
 
-static void
-_fluid_seq_queue_insert_queue_later(fluid_sequencer_t *seq, fluid_evt_entry *evtentry)
-{
-    fluid_evt_entry *prev;
-    fluid_evt_entry *tmp;
-    unsigned int time = evtentry->evt.time;
+        if(i == FLUID_SEQUENCER_QUEUE_BUCKETS || seq->queue[i].min_time > now)
+        {
+            return NULL;
+        }
 
-    /* insert in 'queueLater', after the ones that have the same
-     * time */
+        /* advance to the earliest event and redistribute its bucket to the buckets below */
+        evtentry = seq->queue[i].first;
+        seq->queueBase = seq->queue[i].min_time;
+        seq->queue[i].first = seq->queue[i].last = NULL;
 
-    /* first? */
-    if((seq->queueLater == NULL)
-            || (seq->queueLater->evt.time > time))
+        while(evtentry)
+        {
+            next = evtentry->next;
+            _fluid_seq_queue_append(seq, evtentry);
+            evtentry = next;
+        }
+    }
+    else if(seq->queueBase > now)
     {
-        evtentry->next = seq->queueLater;
-        seq->queueLater = evtentry;
-        return;
+        return NULL;
     }
 
-    /* walk queueLater */
-    /* this is the only slow thing : if the event is more
-       than 65535 ticks after the current time */
+    evtentry = bucket->first;
+    bucket->first = evtentry->next;
 
-    prev = seq->queueLater;
-    tmp = prev->next;
-
-    while(tmp)
+    if(bucket->first == NULL)
     {
-        if(tmp->evt.time > time)
-        {
-            /* insert before tmp */
-            evtentry->next = tmp;
-            prev->next = evtentry;
-            return;
-        }
-
-        prev = tmp;
-        tmp = prev->next;
+        bucket->last = NULL;
     }
 
-    /* last */
     evtentry->next = NULL;
-    prev->next = evtentry;
+    return evtentry;
 }
 
 static void
@@ -1000,54 +1069,56 @@ _fluid_seq_queue_insert_entry(fluid_sequencer_t *seq, fluid_evt_entry *evtentry)
 {
     /* time is relative to seq origin, in ticks */
     fluid_event_t *evt = &(evtentry->evt);
-    unsigned int time = evt->time;
-    unsigned int delay;
 
-    if(seq->queue0StartTime > 0)
+    /* queueLastTick could be < 0 if seq was just started, or if the
+       scale changed a lot early */
+    if(seq->queueLastTick >= 0 && evt->time <= (unsigned int)seq->queueLastTick)
     {
-        /* queue0StartTime could be < 0 if the scale changed a
-           lot early, breaking the following comparison
-        */
-        if(time < (unsigned int)seq->queue0StartTime)
-        {
-            /* we are late, send now */
-            fluid_sequencer_send_now(seq, evt);
+        /* we are late, send now */
+        fluid_sequencer_send_now(seq, evt);
 
-            _fluid_seq_heap_set_free(seq->heap, evtentry);
-            return;
-        }
+        _fluid_seq_heap_set_free(seq->heap, evtentry);
+        return;
     }
 
-    if(seq->prevCellNb >= 0)
-    {
-        /* prevCellNb could be -1 is seq was just started - unlikely */
-        /* prevCellNb can also be -1 if cellNb was reset to 0 in
-           _fluid_seq_queue_send_queued_events() */
-        if(time <= (unsigned int)(seq->queue0StartTime + seq->prevCellNb))
-        {
-            /* we are late, send now */
-            fluid_sequencer_send_now(seq, evt);
-
-            _fluid_seq_heap_set_free(seq->heap, evtentry);
-            return;
-        }
-    }
+    _fluid_seq_queue_append(seq, evtentry);
+}
 
-    delay = time - seq->queue0StartTime;
+/* Move all queued events by delta ticks, keeping their order */
+static void
+_fluid_seq_queue_shift(fluid_sequencer_t *seq, int delta)
+{
+    fluid_evt_entry *first = NULL, *last = NULL, *evtentry;
 
-    if(delay > 65535)
+    if(delta == 0)
     {
-        _fluid_seq_queue_insert_queue_later(seq, evtentry);
-
+        return;
     }
-    else if(delay > 255)
+
+    /* take out all events, earliest first */
+    while((evtentry = _fluid_seq_queue_pop(seq, UINT_MAX)) != NULL)
     {
-        _fluid_seq_queue_insert_queue1(seq, evtentry, delay / 256 - 1);
+        if(last == NULL)
+        {
+            first = evtentry;
+        }
+        else
+        {
+            last->next = evtentry;
+        }
 
+        last = evtentry;
     }
-    else
+
+    /* all queued events are later than queueLastTick, and stay later than it when moved with it */
+    seq->queueBase = (seq->queueLastTick + delta >= 0) ? (unsigned int)(seq->queueLastTick + delta) : 0;
+
+    while(first)
     {
-        _fluid_seq_queue_insert_queue0(seq, evtentry, delay);
+        evtentry = first;
+        first = first->next;
+        evtentry->evt.time += delta;
+        _fluid_seq_queue_append(seq, evtentry);
     }
 }
 
@@ -1110,10 +1181,10 @@ _fluid_seq_queue_remove_entries_matching(fluid_sequencer_t *seq, fluid_evt_entry
     /* we can set it free now */
     _fluid_seq_heap_set_free(seq->heap, templ);
 
-    /* queue0 */
-    for(i = 0 ; i < 256 ; i++)
+    for(i = 0 ; i < FLUID_SEQUENCER_QUEUE_BUCKETS ; i++)
     {
-        fluid_evt_entry *tmp = seq->queue0[i][0];
+        fluid_seq_queue_bucket_t *bucket = &seq->queue[i];
+        fluid_evt_entry *tmp = bucket->first;
         fluid_evt_entry *prev = NULL;
 
         while(tmp)
@@ -1125,109 +1196,28 @@ _fluid_seq_queue_remove_entries_matching(fluid_sequencer_t *seq, fluid_evt_entry
                 if(prev)
                 {
                     prev->next = tmp->next;
-
-                    if(tmp == seq->queue0[i][1])  // last one in list
-                    {
-                        seq->queue0[i][1] = prev;
-                    }
-
-                    _fluid_seq_heap_set_free(seq->heap, tmp);
-                    tmp = prev->next;
                 }
                 else
                 {
-                    /* first one in list */
-                    seq->queue0[i][0] = tmp->next;
-
-                    if(tmp == seq->queue0[i][1])  // last one in list
-                    {
-                        seq->queue0[i][1] = NULL;
-                    }
-
-                    _fluid_seq_heap_set_free(seq->heap, tmp);
-                    tmp = seq->queue0[i][0];
+                    bucket->first = tmp->next;
                 }
-            }
-            else
-            {
-                prev = tmp;
-                tmp = prev->next;
-            }
-        }
-    }
-
-    /* queue1 */
-    for(i = 0 ; i < 255 ; i++)
-    {
-        fluid_evt_entry *tmp = seq->queue1[i][0];
-        fluid_evt_entry *prev = NULL;
 
-        while(tmp)
-        {
-            if(_fluid_seq_queue_matchevent((&tmp->evt), type, src, dest))
-            {
-                /* remove */
-                if(prev)
+                if(tmp == bucket->last)
                 {
-                    prev->next = tmp->next;
-
-                    if(tmp == seq->queue1[i][1])  // last one in list
-                    {
-                        seq->queue1[i][1] = prev;
-                    }
-
-                    _fluid_seq_heap_set_free(seq->heap, tmp);
-                    tmp = prev->next;
+                    bucket->last = prev;
                 }
-                else
-                {
-                    /* first one in list */
-                    seq->queue1[i][0] = tmp->next;
-
-                    if(tmp == seq->queue1[i][1])  // last one in list
-                    {
-                        seq->queue1[i][1] = NULL;
-                    }
 
-                    _fluid_seq_heap_set_free(seq->heap, tmp);
-                    tmp = seq->queue1[i][0];
-                }
+                _fluid_seq_heap_set_free(seq->heap, tmp);
+                tmp = (prev != NULL) ? prev->next : bucket->first;
             }
             else
             {
-                prev = tmp;
-                tmp = prev->next;
-            }
-        }
-    }
-
-    /* queueLater */
-    {
-        fluid_evt_entry *tmp = seq->queueLater;
-        fluid_evt_entry *prev = NULL;
-
-        while(tmp)
-        {
-            if(_fluid_seq_queue_matchevent((&tmp->evt), type, src, dest))
-            {
-                /* remove */
-                if(prev)
+                /* the earliest time of the remaining events */
+                if(prev == NULL || tmp->evt.time < bucket->min_time)
                 {
-                    prev->next = tmp->next;
-
-                    _fluid_seq_heap_set_free(seq->heap, tmp);
-                    tmp = prev->next;
+                    bucket->min_time = tmp->evt.time;
                 }
-                else
-                {
-                    seq->queueLater = tmp->next;
 
-                    _fluid_seq_heap_set_free(seq->heap, tmp);
-                    tmp = seq->queueLater;
-                }
-            }
-            else
-            {
                 prev = tmp;
                 tmp = prev->next;
             }
@@ -1235,122 +1225,23 @@ _fluid_seq_queue_remove_entries_matching(fluid_sequencer_t *seq, fluid_evt_entry
     }
 }
 
-static void
-_fluid_seq_queue_send_cell_events(fluid_sequencer_t *seq, int cellNb)
-{
-    fluid_evt_entry *next;
-    fluid_evt_entry *tmp;
-
-    tmp = seq->queue0[cellNb][0];
-
-    while(tmp)
-    {
-        fluid_sequencer_send_now(seq, &(tmp->evt));
-
-        next = tmp->next;
-
-        _fluid_seq_heap_set_free(seq->heap, tmp);
-        tmp = next;
-    }
-
-    seq->queue0[cellNb][0] = NULL;
-    seq->queue0[cellNb][1] = NULL;
-}
-
-static void
-_fluid_seq_queue_slide(fluid_sequencer_t *seq)
-{
-    short i;
-    fluid_evt_entry *next;
-    fluid_evt_entry *tmp;
-    int count = 0;
-
-    /* do the slide */
-    seq->queue0StartTime += 256;
-
-    /* sort all queue1[0] into queue0 according to new queue0StartTime */
-    tmp = seq->queue1[0][0];
-
-    while(tmp)
-    {
-        unsigned int delay = tmp->evt.time - seq->queue0StartTime;
-        next = tmp->next;
-
-        if(delay > 255)
-        {
-            /* should not happen !! */
-            /* append it to queue1[1] */
-            _fluid_seq_queue_insert_queue1(seq, tmp, 1);
-        }
-        else
-        {
-            _fluid_seq_queue_insert_queue0(seq, tmp, delay);
-        }
-
-        tmp = next;
-        count++;
-    }
-
-    /* slide all queue1[i] into queue1[i-1] */
-    for(i = 1 ; i < 255 ; i++)
-    {
-        seq->queue1[i - 1][0] = seq->queue1[i][0];
-        seq->queue1[i - 1][1] = seq->queue1[i][1];
-    }
-
-    seq->queue1[254][0] = NULL;
-    seq->queue1[254][1] = NULL;
-
-
-    /* append queueLater to queue1[254] */
-    count = 0;
-    tmp = seq->queueLater;
-
-    while(tmp)
-    {
-        unsigned int delay = tmp->evt.time - seq->queue0StartTime;
-
-        if(delay > 65535)
-        {
-            break;
-        }
-
-        next = tmp->next;
-
-        /* append it */
-        _fluid_seq_queue_insert_queue1(seq, tmp, 254);
-        tmp = next;
-        count++;
-    }
-
-    seq->queueLater = tmp;
-}
-
 static void
 _fluid_seq_queue_send_queued_events(fluid_sequencer_t *seq)
 {
     unsigned int nowTicks = fluid_sequencer_get_tick(seq);
-    short cellNb;
+    fluid_evt_entry *evtentry;
 
-    cellNb = seq->prevCellNb + 1;
-
-    while(cellNb <= (int)(nowTicks - seq->queue0StartTime))
+    while((evtentry = _fluid_seq_queue_pop(seq, nowTicks)) != NULL)
     {
-        if(cellNb == 256)
-        {
-            cellNb = 0;
-            _fluid_seq_queue_slide(seq);
-        } /* slide */
-
-        /* process queue0[cellNb] */
-        _fluid_seq_queue_send_cell_events(seq, cellNb);
+        fluid_sequencer_send_now(seq, &(evtentry->evt));
+        _fluid_seq_heap_set_free(seq->heap, evtentry);
 
         /* the current scale may have changed through a callback event */
         nowTicks = fluid_sequencer_get_tick(seq);
-
-        /* next cell */
-        cellNb++;
     }
 
-    seq->prevCellNb = cellNb - 1;
+    if((int)nowTicks > seq->queueLastTick)
+    {
+        seq->queueLastTick = nowTicks;
+    }
 }
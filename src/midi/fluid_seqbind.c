@@ -43,6 +43,9 @@ struct _fluid_seqbind_t
     fluid_sequencer_t *seq;
     fluid_sample_timer_t *sample_timer;
     fluid_seq_id_t client_id;
+    unsigned int block_ticks;   /* audio frames since the sample timer has started, at the start of the current block */
+    fluid_thread_id_t timer_thread; /* thread running the sample timer callback, FLUID_THREAD_ID_NULL outside of it */
+    int api_entered;            /* TRUE if the sample timer callback has entered the API of the synth */
 };
 typedef struct _fluid_seqbind_t fluid_seqbind_t;
 
@@ -62,6 +65,13 @@ delete_fluid_seqbind(fluid_seqbind_t *seqbind)
         seqbind->client_id = -1;
     }
 
+    /* unregistered by an event of the sample timer callback */
+    if(seqbind->api_entered)
+    {
+        seqbind->api_entered = FALSE;
+        fluid_synth_api_exit(seqbind->synth);
+    }
+
     if((seqbind->sample_timer != NULL) && (seqbind->synth != NULL))
     {
         delete_fluid_sample_timer(seqbind->synth, seqbind->sample_timer);
@@ -118,6 +128,7 @@ fluid_sequencer_register_fluidsynth(fluid_sequencer_t *seq, fluid_synth_t *synth
     FLUID_MEMSET(seqbind, 0, sizeof(*seqbind));
 
     seqbind->client_id = -1;
+    seqbind->timer_thread = FLUID_THREAD_ID_NULL;
     seqbind->synth = synth;
     seqbind->seq = seq;
 
@@ -154,10 +165,141 @@ int
 fluid_seqbind_timer_callback(void *data, unsigned int msec)
 {
     fluid_seqbind_t *seqbind = (fluid_seqbind_t *) data;
-    fluid_sequencer_process(seqbind->seq, msec);
+    double frames_per_msec = seqbind->synth->sample_rate / 1000.0;
+    unsigned int end_ticks, end_msec;
+
+    /* Send all events up to the end of the block about to be rendered,
+     * notes are delayed to their frame inside of it by fluid_seqbind_start_offset() */
+    seqbind->block_ticks = fluid_sample_timer_get_ticks(seqbind->synth, seqbind->sample_timer);
+    end_ticks = seqbind->block_ticks + FLUID_BUFSIZE;
+    end_msec = (unsigned int)(end_ticks / frames_per_msec);
+
+    /* the last millisecond starting inside this block */
+    if((unsigned int)(end_msec * frames_per_msec) >= end_ticks)
+    {
+        end_msec--;
+    }
+
+    /* The events received meanwhile are passed to the synth by the API entered
+     * only once, see fluid_seqbind_enter_api() */
+    seqbind->timer_thread = fluid_thread_get_id();
+    fluid_sequencer_process(seqbind->seq, (end_msec > msec) ? end_msec : msec);
+    seqbind->timer_thread = FLUID_THREAD_ID_NULL;
+
+    if(seqbind->api_entered)
+    {
+        seqbind->api_entered = FALSE;
+        fluid_synth_api_exit(seqbind->synth);
+    }
+
     return 1;
 }
 
+/*
+ * Enter the API of the synth for the events sent by the sample timer callback,
+ * and keep it entered for the following ones until the end of the block.
+ * Returns FALSE if the event has been sent by another thread, e.g. by
+ * fluid_sequencer_send_now(), which has to go through the public functions.
+ */
+static int
+fluid_seqbind_enter_api(fluid_seqbind_t *seqbind)
+{
+    if(seqbind->timer_thread != fluid_thread_get_id())
+    {
+        return FALSE;
+    }
+
+    if(!seqbind->api_entered)
+    {
+        fluid_synth_api_enter(seqbind->synth);
+        seqbind->api_entered = TRUE;
+    }
+
+    return TRUE;
+}
+
+/* Pass a channel message to the synth, directly if the API is entered already */
+static void
+fluid_seqbind_send(fluid_seqbind_t *seqbind, int type, int chan, int param1, int param2, int offset)
+{
+    fluid_synth_t *synth = seqbind->synth;
+
+    if(fluid_seqbind_enter_api(seqbind))
+    {
+        fluid_synth_process_api_event(synth, type, chan, param1, param2, offset);
+        return;
+    }
+
+    switch(type)
+    {
+    case FLUID_API_EVENT_NOTEON:
+        fluid_synth_noteon_offset(synth, chan, param1, param2, offset);
+        break;
+
+    case FLUID_API_EVENT_NOTEOFF:
+        fluid_synth_noteoff(synth, chan, param1);
+        break;
+
+    case FLUID_API_EVENT_CC:
+        fluid_synth_cc(synth, chan, param1, param2);
+        break;
+
+    case FLUID_API_EVENT_PITCH_BEND:
+        fluid_synth_pitch_bend(synth, chan, param1);
+        break;
+
+    case FLUID_API_EVENT_PROGRAM_CHANGE:
+        fluid_synth_program_change(synth, chan, param1);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Frame of the current block at which a note event starts, 0 if it is due already */
+static int
+fluid_seqbind_start_offset(fluid_seqbind_t *seqbind, fluid_event_t *evt, fluid_sequencer_t *seq)
+{
+    double ticks;
+
+    if(seqbind->sample_timer == NULL)
+    {
+        return 0;
+    }
+
+    ticks = fluid_event_get_time(evt) * seqbind->synth->sample_rate / fluid_sequencer_get_time_scale(seq);
+
+    if(ticks <= seqbind->block_ticks || ticks >= seqbind->block_ticks + FLUID_BUFSIZE)
+    {
+        return 0;
+    }
+
+    return (unsigned int)ticks - seqbind->block_ticks;
+}
+
+/*
+ * Sequencer time at which a note event started at frame offset of the current
+ * block, see fluid_seqbind_start_offset(): the time of the event, or the start of
+ * the block if it was due already, or now if it has been sent immediately.
+ */
+static unsigned int
+fluid_seqbind_start_time(fluid_seqbind_t *seqbind, fluid_event_t *evt, fluid_sequencer_t *seq,
+                         int offset, unsigned int now)
+{
+    if(offset > 0)
+    {
+        return fluid_event_get_time(evt);
+    }
+
+    if(seqbind->sample_timer == NULL || seqbind->timer_thread != fluid_thread_get_id())
+    {
+        return now;
+    }
+
+    return (unsigned int)(seqbind->block_ticks * fluid_sequencer_get_time_scale(seq) / seqbind->synth->sample_rate);
+}
+
 /* Callback for midi events */
 void
 fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_sequencer_t *seq, void *data)
@@ -170,20 +312,26 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
     {
 
     case FLUID_SEQ_NOTEON:
-        fluid_synth_noteon(synth, fluid_event_get_channel(evt), fluid_event_get_key(evt), fluid_event_get_velocity(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_NOTEON, fluid_event_get_channel(evt), fluid_event_get_key(evt),
+                           fluid_event_get_velocity(evt), fluid_seqbind_start_offset(seqbind, evt, seq));
         break;
 
     case FLUID_SEQ_NOTEOFF:
-        fluid_synth_noteoff(synth, fluid_event_get_channel(evt), fluid_event_get_key(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_NOTEOFF, fluid_event_get_channel(evt), fluid_event_get_key(evt), 0, 0);
         break;
 
     case FLUID_SEQ_NOTE:
     {
-        unsigned int dur;
-        fluid_synth_noteon(synth, fluid_event_get_channel(evt), fluid_event_get_key(evt), fluid_event_get_velocity(evt));
+        int offset = fluid_seqbind_start_offset(seqbind, evt, seq);
+        unsigned int start, dur;
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_NOTEON, fluid_event_get_channel(evt), fluid_event_get_key(evt),
+                           fluid_event_get_velocity(evt), offset);
+        /* the duration counts from the start of the note, not from the end of the block
+         * the sequencer is processed up to */
+        start = fluid_seqbind_start_time(seqbind, evt, seq, offset, time);
         dur = fluid_event_get_duration(evt);
         fluid_event_noteoff(evt, fluid_event_get_channel(evt), fluid_event_get_key(evt));
-        fluid_sequencer_send_at(seq, evt, dur, 0);
+        fluid_sequencer_send_at(seq, evt, start + dur, 1);
     }
     break;
 
@@ -200,7 +348,7 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
         break;
 
     case FLUID_SEQ_PROGRAMCHANGE:
-        fluid_synth_program_change(synth, fluid_event_get_channel(evt), fluid_event_get_program(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_PROGRAM_CHANGE, fluid_event_get_channel(evt), fluid_event_get_program(evt), 0, 0);
         break;
 
     case FLUID_SEQ_PROGRAMSELECT:
@@ -216,7 +364,7 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
         break;
 
     case FLUID_SEQ_PITCHBEND:
-        fluid_synth_pitch_bend(synth, fluid_event_get_channel(evt), fluid_event_get_pitch(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_PITCH_BEND, fluid_event_get_channel(evt), fluid_event_get_pitch(evt), 0, 0);
         break;
 
     case FLUID_SEQ_PITCHWHEELSENS:
@@ -224,31 +372,32 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
         break;
 
     case FLUID_SEQ_CONTROLCHANGE:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), fluid_event_get_control(evt), fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), fluid_event_get_control(evt),
+                           fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_MODULATION:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), MODULATION_MSB, fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), MODULATION_MSB, fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_SUSTAIN:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), SUSTAIN_SWITCH, fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), SUSTAIN_SWITCH, fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_PAN:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), PAN_MSB, fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), PAN_MSB, fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_VOLUME:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), VOLUME_MSB, fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), VOLUME_MSB, fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_REVERBSEND:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), EFFECTS_DEPTH1, fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), EFFECTS_DEPTH1, fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_CHORUSSEND:
-        fluid_synth_cc(synth, fluid_event_get_channel(evt), EFFECTS_DEPTH3, fluid_event_get_value(evt));
+        fluid_seqbind_send(seqbind, FLUID_API_EVENT_CC, fluid_event_get_channel(evt), EFFECTS_DEPTH3, fluid_event_get_value(evt), 0);
         break;
 
     case FLUID_SEQ_CHANNELPRESSURE:
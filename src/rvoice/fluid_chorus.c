@@ -119,38 +119,17 @@
 #define SCALE_WET 1.0f
 
 #define MAX_SAMPLES 2048 /* delay length in sample (46.4 ms at sample rate: 44100Hz).*/
-#define LOW_MOD_DEPTH 176             /* low mod_depth/2 in samples */
-#define HIGH_MOD_DEPTH  MAX_SAMPLES/2 /* high mod_depth in sample */
-#define RANGE_MOD_DEPTH (HIGH_MOD_DEPTH - LOW_MOD_DEPTH)
-
-/* Important min max values for MOD_RATE */
-/* mod rate define the rate at which the modulator is updated. Examples
-   50: the modulator is updated every 50 samples (less cpu cycles expensive).
-   1: the modulator is updated every sample (more cpu cycles expensive).
-*/
-/* MOD_RATE acceptable for max lfo speed (5Hz) and max modulation depth (46.6 ms) */
-#define LOW_MOD_RATE 5  /* MOD_RATE acceptable for low modulation depth (8 ms) */
-#define HIGH_MOD_RATE 4 /* MOD_RATE acceptable for max modulation depth (46.6 ms) */
-                        /* and max lfo speed (5 Hz) */
-#define RANGE_MOD_RATE (HIGH_MOD_RATE - LOW_MOD_RATE)
-
-/* some chorus cpu_load measurement dependant of modulation rate: mod_rate
- (number of chorus blocks: 2)
-
- No stero unit:
- mod_rate | chorus cpu load(%) | one voice cpu load (%)
- ----------------------------------------------------
- 50       | 0.204              |
- 5        | 0.256              |  0.169
- 1        | 0.417              |
-
- With stero unit:
- mod_rate | chorus cpu load(%) | one voice cpu load (%)
- ----------------------------------------------------
- 50       | 0.220              |
- 5        | 0.274              |  0.169
- 1        | 0.465              |
-
+/* Modulation rate:
+   the modulators are computed only once per block of FLUID_BUFSIZE samples.
+   In between, the read position of each chorus block follows a linear ramp
+   from the modulator value at the beginning of the block to its value at the
+   end of the block. With max lfo speed (5Hz) and max modulation depth
+   (46.6 ms), the ramp is off from the sine wave by 0.3 sample at most, which
+   is covered by the fractional interpolation.
+   Because the positions are known in advance for the whole block, all chorus
+   blocks are processed side by side (see process_chorus_blocks()). This
+   allows the compiler to use SIMD instructions, processing several chorus
+   blocks at once.
 */
 
 /*
@@ -190,16 +169,8 @@ typedef struct
 -----------------------------------------------------------------------------*/
 typedef struct
 {
-    /*-------------*/
-    int line_out; /* current line out position for this modulator */
-    /*-------------*/
     sinus_modulator sinus; /* sinus lfo */
     triang_modulator triang; /* triangle lfo */
-    /*-------------------------*/
-    /* first order All-Pass interpolator members */
-    fluid_real_t  frac_pos_mod; /* fractional position part between samples */
-    /* previous value used when interpolating using fractional */
-    fluid_real_t  buffer;
 } modulator;
 
 /* Private data for SKEL file */
@@ -216,21 +187,30 @@ struct _fluid_chorus_t
     fluid_real_t width;
     fluid_real_t wet1, wet2;
 
-    fluid_real_t *line; /* buffer line */
+    fluid_real_t *line; /* buffer line (mirrored, see push_in_delay_line) */
     int   size;    /* effective internal size (in samples) */
 
     int line_in;  /* line in position */
 
     /* center output position members */
-    fluid_real_t  center_pos_mod; /* center output position modulated by modulator */
-    int          mod_depth;   /* modulation depth (in samples) */
-
-    /* variable rate control of center output position */
-    int index_rate;  /* index rate to know when to update center_pos_mod */
-    int mod_rate;    /* rate at which center_pos_mod is updated */
+    int center_pos;  /* center output position at the beginning of the block */
+    int mod_depth;   /* modulation depth (in samples) */
 
     /* modulator member */
     modulator mod[MAX_CHORUS]; /* sinus/triangle modulator */
+
+    /* per chorus block members, stored side by side to be processed at once */
+    /* modulated offset from center_pos at the beginning of the next block */
+    fluid_real_t mod_offset[MAX_CHORUS];
+    /* read position at the beginning of the block */
+    fluid_real_t mod_pos[MAX_CHORUS];
+    /* increment of the read position at each sample of the block */
+    fluid_real_t mod_step[MAX_CHORUS];
+    /* previous value of the first order All-Pass interpolator */
+    fluid_real_t mod_buffer[MAX_CHORUS];
+    /* stereo unit gains of each block */
+    fluid_real_t gain_left[MAX_CHORUS];
+    fluid_real_t gain_right[MAX_CHORUS];
 };
 
 /*-----------------------------------------------------------------------------
@@ -333,6 +313,8 @@ static void set_triangle_frequency(triang_modulator *mod, float freq,
 /*-----------------------------------------------------------------------------
    Get current value of triangular oscillator
        y(n) = y(n-1) + dy
+   When the value goes beyond a peak, it is folded back from the peak, so the
+   phase of the oscillator is kept with the large slope used at block rate.
 -----------------------------------------------------------------------------*/
 static FLUID_INLINE fluid_real_t get_mod_triang(triang_modulator *mod)
 {
@@ -341,132 +323,154 @@ static FLUID_INLINE fluid_real_t get_mod_triang(triang_modulator *mod)
     if(mod->val >= 1.0)
     {
         mod->inc = -mod->inc;
-        return 1.0;
+        mod->val = 2.0 - mod->val;
     }
-
-    if(mod->val <= -1.0)
+    else if(mod->val <= -1.0)
     {
         mod->inc = -mod->inc;
-        return -1.0;
+        mod->val = -2.0 - mod->val;
     }
 
     return  mod->val;
 }
 /*-----------------------------------------------------------------------------
- Reads the sample value out of the modulated delay line.
- @param mdl, pointer on modulated delay line.
- @return the sample value.
+ Gets the next value of the modulator of one chorus block, scaled by the
+ modulation depth. The value is the offset of the read position from the
+ center position one block later.
 -----------------------------------------------------------------------------*/
-static FLUID_INLINE fluid_real_t get_mod_delay(fluid_chorus_t *chorus,
+static FLUID_INLINE fluid_real_t get_mod_offset(fluid_chorus_t *chorus,
         modulator *mod)
 {
-    fluid_real_t out_index;  /* new modulated index position */
-    int int_out_index; /* integer part of out_index */
-    fluid_real_t out; /* value to return */
+    if(chorus->type == FLUID_CHORUS_MOD_SINE)
+    {
+        return get_mod_sinus(&mod->sinus) * chorus->mod_depth;
+    }
+
+    return get_mod_triang(&mod->triang) * chorus->mod_depth;
+}
 
-    /* Checks if the modulator must be updated (every mod_rate samples). */
-    /* Important: center_pos_mod must be used immediately for the
-       first sample. So, mdl->index_rate must be initialized
-       to mdl->mod_rate (new_mod_delay_line())  */
+/*-----------------------------------------------------------------------------
+ Computes the modulators of all chorus blocks for the next block of samples
+ and derives the read position ramp of each chorus block.
+
+ The read position moves from center_pos + offset at the beginning of the
+ block to the same position one block later. It is wrapped so that its
+ lowest value along the ramp lies in the delay line, the highest values
+ are then read in the mirrored part of the line.
+-----------------------------------------------------------------------------*/
+static void update_mod_positions(fluid_chorus_t *chorus)
+{
+    int i;
 
-    if(chorus->index_rate >= chorus->mod_rate)
+    for(i = 0; i < chorus->number_blocks; i++)
     {
-        /* out_index = center position (center_pos_mod) + sinus waweform */
-        if(chorus->type == FLUID_CHORUS_MOD_SINE)
-        {
-            out_index = chorus->center_pos_mod +
-                        get_mod_sinus(&mod->sinus) * chorus->mod_depth;
-        }
-        else
-        {
-            out_index = chorus->center_pos_mod +
-                        get_mod_triang(&mod->triang) * chorus->mod_depth;
-        }
+        fluid_real_t offset = get_mod_offset(chorus, &chorus->mod[i]);
+        fluid_real_t pos = chorus->center_pos + chorus->mod_offset[i];
+        fluid_real_t step = 1 + (offset - chorus->mod_offset[i]) / FLUID_BUFSIZE;
+        fluid_real_t lowest = (step < 0) ? pos + (FLUID_BUFSIZE - 1) * step : pos;
 
-        /* extracts integer part in int_out_index */
-        if(out_index >= 0.0f)
+        /* circular motion as needed */
+        if(lowest < 0)
         {
-            int_out_index = (int)out_index; /* current integer part */
-
-            /* forces read index (line_out)  with integer modulation value  */
-            /* Boundary check and circular motion as needed */
-            if((mod->line_out = int_out_index) >= chorus->size)
-            {
-                mod->line_out -= chorus->size;
-            }
+            pos += chorus->size;
         }
-        else /* negative */
+        else if(lowest >= chorus->size)
         {
-            int_out_index = (int)(out_index - 1); /* previous integer part */
-            /* forces read index (line_out) with integer modulation value  */
-            /* circular motion as needed */
-            mod->line_out   = int_out_index + chorus->size;
+            pos -= chorus->size;
         }
 
-        /* extracts fractionnal part. (it will be used when interpolating
-          between line_out and line_out +1) and memorize it.
-          Memorizing is necessary for modulation rate above 1 */
-        mod->frac_pos_mod = out_index - int_out_index;
+        chorus->mod_pos[i] = pos;
+        chorus->mod_step[i] = step;
+        chorus->mod_offset[i] = offset;
     }
 
-    /*  First order all-pass interpolation ----------------------------------*/
-    /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
-    /*  begins interpolation: read current sample */
-    out = chorus->line[mod->line_out];
+    /* updates center position to the next block */
+    if((chorus->center_pos += FLUID_BUFSIZE) >= chorus->size)
+    {
+        chorus->center_pos -= chorus->size;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ Reads the sample values out of the modulated delay line for all chorus blocks
+ at position sample_index of the block and mixes them through the stereo unit.
+
+ The read position of each block is computed from the ramp of its modulator.
+ As the delay line is shared by all blocks and isn't written while reading,
+ the blocks are independent and are processed in SIMD lanes.
+
+ @param chorus, pointer chorus unit.
+ @param sample_index, index of the sample in the block.
+ @param out_left, out_right, pointers on the stereo output sample.
+-----------------------------------------------------------------------------*/
+static FLUID_INLINE void process_chorus_blocks(fluid_chorus_t *chorus,
+        int sample_index,
+        fluid_real_t *out_left, fluid_real_t *out_right)
+{
+    const fluid_real_t *line = chorus->line;
+    const fluid_real_t *mod_pos = chorus->mod_pos;
+    const fluid_real_t *mod_step = chorus->mod_step;
+    const fluid_real_t *gain_left = chorus->gain_left;
+    const fluid_real_t *gain_right = chorus->gain_right;
+    fluid_real_t *mod_buffer = chorus->mod_buffer;
+    fluid_real_t left = 0, right = 0;
+    int nr = chorus->number_blocks;
+    int i;
 
-    /* updates line_out to the next sample.
-       Boundary check and circular motion as needed */
-    if(++mod->line_out >= chorus->size)
+    #pragma omp simd reduction(+:left,right)
+    for(i = 0; i < nr; i++)
     {
-        mod->line_out -= chorus->size;
+        /* modulated read position */
+        fluid_real_t out_index = mod_pos[i] + mod_step[i] * sample_index;
+        int line_out = (int)out_index;
+        /* fractional position part between samples */
+        fluid_real_t frac_pos_mod = out_index - line_out;
+        fluid_real_t out;
+
+        /*  First order all-pass interpolation ------------------------------*/
+        /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
+        /* Fractional interpolation between next sample (at next position) and
+           previous output added to current sample.
+        */
+        out = line[line_out] + frac_pos_mod * (line[line_out + 1] - mod_buffer[i]);
+        mod_buffer[i] = out; /* memorizes current output */
+
+        /* accumulate out into stereo unit */
+        left += out * gain_left[i];
+        right += out * gain_right[i];
     }
 
-    /* Fractional interpolation between next sample (at next position) and
-       previous output added to current sample.
-    */
-    out += mod->frac_pos_mod * (chorus->line[mod->line_out] - mod->buffer);
-    mod->buffer = out; /* memorizes current output */
-    return out;
+    *out_left = left;
+    *out_right = right;
 }
 
 /*-----------------------------------------------------------------------------
- Push a sample val into the delay line
+ Push a sample val into the delay line.
+ The line is written twice, followed by a copy of its first FLUID_BUFSIZE
+ samples. This way, a read position ramp starting anywhere in the line never
+ needs a boundary check during a block.
 -----------------------------------------------------------------------------*/
 #define push_in_delay_line(dl, val) \
 {\
     dl->line[dl->line_in] = val;\
+    dl->line[dl->line_in + dl->size] = val;\
+    if(dl->line_in < FLUID_BUFSIZE) dl->line[dl->line_in + 2 * dl->size] = val;\
     /* Incrementation and circular motion if necessary */\
     if(++dl->line_in >= dl->size) dl->line_in -= dl->size;\
 }\
 
 /*-----------------------------------------------------------------------------
- Initialize : mod_rate, center_pos_mod,  and index rate
+ Initialize center_pos.
 
- center_pos_mod is initialized so that the delay between center_pos_mod and
+ center_pos is initialized so that the delay between center_pos and
  line_in is: mod_depth + INTERP_SAMPLES_NBR.
 -----------------------------------------------------------------------------*/
 static void set_center_position(fluid_chorus_t *chorus)
 {
     int center;
 
-    /* Sets the modulation rate. This rate defines how often
-     the  center position (center_pos_mod ) is modulated .
-     The value is expressed in samples. The default value is 1 that means that
-     center_pos_mod is updated at every sample.
-     For example with a value of 2, the center position position will be
-     updated only one time every 2 samples only.
-    */
-    chorus->mod_rate = LOW_MOD_RATE; /* default modulation rate */
-
-    /* compensate mod rate for high modulation depth */
-    if(chorus->mod_depth > LOW_MOD_DEPTH)
-    {
-        int delta_mod_depth = (chorus->mod_depth - LOW_MOD_DEPTH);
-        chorus->mod_rate += (delta_mod_depth * RANGE_MOD_RATE) / RANGE_MOD_DEPTH;
-    }
-
-    /* Initializes the modulated center position (center_pos_mod) so that:
-        - the delay between center_pos_mod and line_in is:
+    /* Initializes the center position (center_pos) so that:
+        - the delay between center_pos and line_in is:
           mod_depth + INTERP_SAMPLES_NBR.
     */
     center = chorus->line_in - (INTERP_SAMPLES_NBR + chorus->mod_depth);
@@ -476,12 +480,7 @@ static void set_center_position(fluid_chorus_t *chorus)
         center += chorus->size;
     }
 
-    chorus->center_pos_mod = (fluid_real_t)center;
-
-    /* index rate to control when to update center_pos_mod */
-    /* Important: must be set to get center_pos_mod immediately used for the
-       reading of first sample (see get_mod_delay()) */
-    chorus->index_rate = chorus->mod_rate;
+    chorus->center_pos = center;
 }
 
 /*-----------------------------------------------------------------------------
@@ -512,7 +511,8 @@ static int new_mod_delay_line(fluid_chorus_t *chorus, int delay_length)
     */
     /* total size of the line:  size = INTERP_SAMPLES_NBR + delay_length */
     chorus->size = delay_length + INTERP_SAMPLES_NBR;
-    chorus->line = FLUID_ARRAY(fluid_real_t, chorus->size);
+    /* the line is mirrored (see push_in_delay_line) */
+    chorus->line = FLUID_ARRAY(fluid_real_t, 2 * chorus->size + FLUID_BUFSIZE);
 
     if(! chorus->line)
     {
@@ -521,21 +521,13 @@ static int new_mod_delay_line(fluid_chorus_t *chorus, int delay_length)
 
     /* clears the buffer:
      - delay line
-     - interpolator member: buffer, frac_pos_mod
+     - interpolator member: mod_buffer
     */
     fluid_chorus_reset(chorus);
 
     /* Initializes line_in to the start of the buffer */
     chorus->line_in = 0;
-    /*------------------------------------------------------------------------
-     Initializes modulation members:
-     - modulation rate (the speed at which center_pos_mod is modulated: mod_rate
-     - modulated center position: center_pos_mod
-     - index rate to know when to update center_pos_mod:index_rate
-     -------------------------------------------------------------------------*/
-    /* Initializes the modulated center position:
-       mod_rate, center_pos_mod,  and index rate
-    */
+    /* Initializes the center position */
     set_center_position(chorus);
 
     return FLUID_OK;
@@ -601,6 +593,104 @@ delete_fluid_chorus(fluid_chorus_t *chorus)
     FLUID_FREE(chorus);
 }
 
+/**
+ * Get the memory taken by the chorus unit.
+ * @param chorus pointer on chorus unit returned by new_fluid_chorus().
+ * @return bytes of the chorus unit and of its delay line.
+ */
+size_t
+fluid_chorus_get_size(const fluid_chorus_t *chorus)
+{
+    return sizeof(*chorus) + (2 * (size_t)chorus->size + FLUID_BUFSIZE) * sizeof(fluid_real_t);
+}
+
+/**
+ * Save the state of the chorus unit: its parameters, modulators and delay line.
+ * @param chorus pointer on chorus unit returned by new_fluid_chorus().
+ * @param data fluid_chorus_get_size() bytes to store the state to.
+ */
+void
+fluid_chorus_save_state(const fluid_chorus_t *chorus, void *data)
+{
+    FLUID_MEMCPY(data, chorus, sizeof(*chorus));
+    FLUID_MEMCPY((char *)data + sizeof(*chorus), chorus->line,
+                 fluid_chorus_get_size(chorus) - sizeof(*chorus));
+}
+
+/*
+ * Check that a saved chorus state fits the delay line and the parameters of a
+ * chorus unit, and that the read positions of its blocks lie in the delay line.
+ */
+static int
+fluid_chorus_check_state(const fluid_chorus_t *chorus, const fluid_chorus_t *saved)
+{
+    int i;
+
+    if(saved->size != chorus->size || saved->type != chorus->type
+            || saved->number_blocks != chorus->number_blocks || saved->mod_depth != chorus->mod_depth
+            || saved->line_in < 0 || saved->line_in >= saved->size
+            || saved->center_pos < 0 || saved->center_pos >= saved->size)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < saved->number_blocks; i++)
+    {
+        const modulator *mod = &saved->mod[i];
+        fluid_real_t lowest = saved->mod_pos[i];
+        fluid_real_t highest = saved->mod_pos[i] + (FLUID_BUFSIZE - 1) * saved->mod_step[i];
+
+        if(saved->mod_step[i] < 0)
+        {
+            lowest = highest;
+            highest = saved->mod_pos[i];
+        }
+
+        /* the line is read at the read position and the one after it */
+        if(!(lowest >= 0 && highest < 2 * saved->size + FLUID_BUFSIZE - 1)
+                || !(FLUID_FABS(saved->mod_offset[i]) <= saved->mod_depth)
+                || mod->sinus.a1 != chorus->mod[i].sinus.a1
+                || mod->sinus.reset_buffer2 != chorus->mod[i].sinus.reset_buffer2
+                || !(FLUID_FABS(mod->sinus.buffer1) <= 1 && FLUID_FABS(mod->sinus.buffer2) <= 1)
+                || FLUID_FABS(mod->triang.inc) != FLUID_FABS(chorus->mod[i].triang.inc)
+                || !(FLUID_FABS(mod->triang.val) <= 1))
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Restore the state of a chorus unit saved by fluid_chorus_save_state().
+ * @param chorus pointer on chorus unit returned by new_fluid_chorus().
+ * @param data the state, fluid_chorus_get_size() bytes.
+ * @return FLUID_OK on success, FLUID_FAILED if the unit was saved with a
+ *  delay line of another size, i.e. at another sample rate, or with other
+ *  parameters, or if the state is corrupted.
+ */
+int
+fluid_chorus_load_state(fluid_chorus_t *chorus, const void *data)
+{
+    fluid_real_t *line = chorus->line;
+    fluid_chorus_t saved;
+
+    FLUID_MEMCPY(&saved, data, sizeof(saved));
+
+    if(fluid_chorus_check_state(chorus, &saved) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    *chorus = saved;
+    chorus->line = line;
+    FLUID_MEMCPY(line, (const char *)data + sizeof(saved),
+                 fluid_chorus_get_size(chorus) - sizeof(saved));
+
+    return FLUID_OK;
+}
+
 /**
  * Clear the internal delay line and associate filter.
  * @param chorus pointer on chorus unit returned by new_fluid_chorus().
@@ -609,20 +699,18 @@ void
 fluid_chorus_reset(fluid_chorus_t *chorus)
 {
     int i;
-    unsigned int u;
 
-    /* reset delay line */
-    for(i = 0; i < chorus->size; i++)
+    /* reset delay line, including its mirrored part */
+    for(i = 0; i < 2 * chorus->size + FLUID_BUFSIZE; i++)
     {
         chorus->line[i] = 0;
     }
 
     /* reset modulators's allpass filter */
-    for(u = 0; u < FLUID_N_ELEMENTS(chorus->mod); u++)
+    for(i = 0; i < MAX_CHORUS; i++)
     {
-        /* initializes 1st order All-Pass interpolator members */
-        chorus->mod[u].buffer = 0;       /* previous delay sample value */
-        chorus->mod[u].frac_pos_mod = 0; /* fractional position (between consecutives sample) */
+        /* previous delay sample value of 1st order All-Pass interpolator */
+        chorus->mod_buffer[i] = 0;
     }
 }
 
@@ -729,25 +817,20 @@ fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t level,
 #ifdef DEBUG_PRINT
     printf("depth_ms:%f, depth_samples/2:%d\n", chorus->depth_ms, chorus->mod_depth);
 #endif
-    /* Initializes the modulated center position:
-       mod_rate, center_pos_mod,  and index rate.
-    */
-    set_center_position(chorus); /* must be called before set_xxxx_frequency() */
-#ifdef DEBUG_PRINT
-    printf("mod_rate:%d\n", chorus->mod_rate);
-#endif
+    /* Initializes the center position */
+    set_center_position(chorus);
 
-    /* initialize modulator frequency */
+    /* initialize modulator frequency, the modulators are updated once per block */
     for(i = 0; i < chorus->number_blocks; i++)
     {
         set_sinus_frequency(&chorus->mod[i].sinus,
-                            chorus->speed_Hz * chorus->mod_rate,
+                            chorus->speed_Hz * FLUID_BUFSIZE,
                             chorus->sample_rate,
                             /* phase offset between modulators waveform */
                             (float)((360.0f / (float) chorus->number_blocks) * i));
 
         set_triangle_frequency(&chorus->mod[i].triang,
-                               chorus->speed_Hz * chorus->mod_rate,
+                               chorus->speed_Hz * FLUID_BUFSIZE,
                                chorus->sample_rate,
                                /* phase offset between modulators waveform */
                                (float)i / chorus->number_blocks);
@@ -766,6 +849,19 @@ fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t level,
         chorus->type = FLUID_CHORUS_MOD_SINE;
     }
 
+    /* initial modulated offset of each block: current value of the modulator */
+    for(i = 0; i < chorus->number_blocks; i++)
+    {
+        if(chorus->type == FLUID_CHORUS_MOD_SINE)
+        {
+            chorus->mod_offset[i] = chorus->mod[i].sinus.buffer1 * chorus->mod_depth;
+        }
+        else
+        {
+            chorus->mod_offset[i] = chorus->mod[i].triang.val * chorus->mod_depth;
+        }
+    }
+
 #ifdef DEBUG_PRINT
 
     if(chorus->type == FLUID_CHORUS_MOD_SINE)
@@ -857,6 +953,33 @@ fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t level,
 #endif
         }
     }
+
+    /* Stereo unit gains of each block: even blocks are accumulated into the
+       left input of the stereo unit, odd blocks into the right input.
+       In case of number_blocks odd, the right input level is lower than the
+       left one, so the last block is added to the right input too to have
+       them balanced.
+    */
+    for(i = 0; i < chorus->number_blocks; i++)
+    {
+        if(i & 1)
+        {
+            chorus->gain_left[i] = chorus->wet2;
+            chorus->gain_right[i] = chorus->wet1;
+        }
+        else
+        {
+            chorus->gain_left[i] = chorus->wet1;
+            chorus->gain_right[i] = chorus->wet2;
+        }
+    }
+
+    if((chorus->number_blocks & 1) && chorus->number_blocks > 2)
+    {
+        i = chorus->number_blocks - 1;
+        chorus->gain_left[i] = chorus->wet1 + chorus->wet2;
+        chorus->gain_right[i] = chorus->wet1 + chorus->wet2;
+    }
 }
 
 
@@ -871,63 +994,25 @@ void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
                              fluid_real_t *left_out, fluid_real_t *right_out)
 {
     int sample_index;
-    int i;
-    fluid_real_t d_out[2];               /* output stereo Left and Right  */
+
+    /* modulators are computed once for the whole block */
+    update_mod_positions(chorus);
 
     /* foreach sample, process output sample then input sample */
     for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
     {
-        fluid_real_t out; /* block output */
-
-        d_out[0] = d_out[1] = 0.0f; /* clear stereo unit input */
-
-#if 0
-        /* Debug: Listen to the chorus signal only */
-        left_out[sample_index] = 0;
-        right_out[sample_index] = 0;
-#endif
-
-        ++chorus->index_rate; /* modulator rate */
-
-        /* foreach chorus block, process output sample */
-        for(i = 0; i < chorus->number_blocks; i++)
-        {
-            /* get sample from the output of modulated delay line */
-            out = get_mod_delay(chorus, &chorus->mod[i]);
-
-            /* accumulate out into stereo unit input */
-            d_out[i & 1] += out;
-        }
-
-        /* update modulator index rate and output center position */
-        if(chorus->index_rate >= chorus->mod_rate)
-        {
-            chorus->index_rate = 0; /* clear modulator index rate */
-
-            /* updates center position (center_pos_mod) to the next position
-               specified by modulation rate */
-            if((chorus->center_pos_mod += chorus->mod_rate) >= chorus->size)
-            {
-                chorus->center_pos_mod -= chorus->size;
-            }
-        }
+        fluid_real_t out_left, out_right; /* stereo unit output */
+        /* read the input first, the output may be written in place */
+        fluid_real_t in_sample = in[sample_index];
 
-        /* Adjust stereo input level in case of number_blocks odd:
-           In those case, d_out[1] level is lower than d_out[0], so we need to
-           add out value to d_out[1] to have d_out[0] and d_out[1] balanced.
-        */
-        if((i & 1) && i > 2)  // i = 3,5,7...
-        {
-            d_out[1] +=  out ;
-        }
+        process_chorus_blocks(chorus, sample_index, &out_left, &out_right);
 
-        /* process stereo unit */
-        /* Add the chorus stereo unit d_out to left and right output */
-        left_out[sample_index]  += d_out[0] * chorus->wet1  + d_out[1] * chorus->wet2;
-        right_out[sample_index] += d_out[1] * chorus->wet1  + d_out[0] * chorus->wet2;
+        /* Add the chorus stereo unit output to left and right output */
+        left_out[sample_index]  += out_left;
+        right_out[sample_index] += out_right;
 
         /* Write the current input sample into the circular buffer */
-        push_in_delay_line(chorus, in[sample_index]);
+        push_in_delay_line(chorus, in_sample);
     }
 }
 
@@ -943,62 +1028,24 @@ void fluid_chorus_processreplace(fluid_chorus_t *chorus, const fluid_real_t *in,
                                  fluid_real_t *left_out, fluid_real_t *right_out)
 {
     int sample_index;
-    int i;
-    fluid_real_t d_out[2];               /* output stereo Left and Right  */
+
+    /* modulators are computed once for the whole block */
+    update_mod_positions(chorus);
 
     /* foreach sample, process output sample then input sample */
     for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
     {
-        fluid_real_t out; /* block output */
-
-        d_out[0] = d_out[1] = 0.0f; /* clear stereo unit input */
-
-#if 0
-        /* Debug: Listen to the chorus signal only */
-        left_out[sample_index] = 0;
-        right_out[sample_index] = 0;
-#endif
-
-        ++chorus->index_rate; /* modulator rate */
-
-        /* foreach chorus block, process output sample */
-        for(i = 0; i < chorus->number_blocks; i++)
-        {
-            /* get sample from the output of modulated delay line */
-            out = get_mod_delay(chorus, &chorus->mod[i]);
-
-            /* accumulate out into stereo unit input */
-            d_out[i & 1] += out;
-        }
+        fluid_real_t out_left, out_right; /* stereo unit output */
+        /* read the input first, the output may be written in place */
+        fluid_real_t in_sample = in[sample_index];
 
-        /* update modulator index rate and output center position */
-        if(chorus->index_rate >= chorus->mod_rate)
-        {
-            chorus->index_rate = 0; /* clear modulator index rate */
-
-            /* updates center position (center_pos_mod) to the next position
-               specified by modulation rate */
-            if((chorus->center_pos_mod += chorus->mod_rate) >= chorus->size)
-            {
-                chorus->center_pos_mod -= chorus->size;
-            }
-        }
-
-        /* Adjust stereo input level in case of number_blocks odd:
-           In those case, d_out[1] level is lower than d_out[0], so we need to
-           add out value to d_out[1] to have d_out[0] and d_out[1] balanced.
-        */
-        if((i & 1) && i > 2)  // i = 3,5,7...
-        {
-            d_out[1] +=  out ;
-        }
+        process_chorus_blocks(chorus, sample_index, &out_left, &out_right);
 
-        /* process stereo unit */
-        /* store the chorus stereo unit d_out to left and right output */
-        left_out[sample_index]  = d_out[0] * chorus->wet1  + d_out[1] * chorus->wet2;
-        right_out[sample_index] = d_out[1] * chorus->wet1  + d_out[0] * chorus->wet2;
+        /* store the chorus stereo unit output to left and right output */
+        left_out[sample_index]  = out_left;
+        right_out[sample_index] = out_right;
 
         /* Write the current input sample into the circular buffer */
-        push_in_delay_line(chorus, in[sample_index]);
+        push_in_delay_line(chorus, in_sample);
     }
 }
@@ -49,6 +49,9 @@ typedef enum
  */
 fluid_chorus_t *new_fluid_chorus(fluid_real_t sample_rate);
 void delete_fluid_chorus(fluid_chorus_t *chorus);
+size_t fluid_chorus_get_size(const fluid_chorus_t *chorus);
+void fluid_chorus_save_state(const fluid_chorus_t *chorus, void *data);
+int fluid_chorus_load_state(fluid_chorus_t *chorus, const void *data);
 void fluid_chorus_reset(fluid_chorus_t *chorus);
 
 void fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t level,
@@ -0,0 +1,709 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/*
+ * Convolution reverb
+ *
+ * The mono input is convolved with a stereo impulse response by partitioned
+ * overlap-save FFT convolution. Both channels are handled by a single complex
+ * transform: the partitions of the impulse response are transformed as
+ * left + i * right, so that the real and imaginary parts of the inverse
+ * transform of their products with the input spectrum are the left and the
+ * right output.
+ *
+ * The head of the impulse response is convolved in partitions of FLUID_BUFSIZE
+ * frames by the rendering thread, without latency. If a tail size is given, the
+ * rest of the impulse response is convolved in partitions of that size by a worker
+ * thread, a tail block at a time. As the head covers the first two tail blocks
+ * of the impulse response, the output of the tail for an input block is only
+ * due one tail block later, leaving the worker the duration of a tail block to
+ * compute it.
+ */
+
+#include "fluid_convolver.h"
+#include "fluid_sys.h"
+
+typedef struct
+{
+    int size;               /* number of complex values, a power of two */
+    int *bitrev;            /* bit-reversed indices */
+    fluid_real_t *twiddle;  /* size / 2 complex roots of unity exp(-2 pi i k / size) */
+} fluid_conv_fft_t;
+
+/* a uniformly partitioned convolution */
+typedef struct
+{
+    int size;               /* partition size N, the FFTs are 2N */
+    int count;              /* number of partitions */
+    fluid_conv_fft_t fft;
+    fluid_real_t *ir;       /* spectra of the partitions of the impulse response, 2N complex values each */
+    fluid_real_t *fdl;      /* spectra of the latest count input blocks */
+    int fdl_pos;            /* partition index of the spectrum of the latest input block */
+    fluid_real_t *in;       /* the latest two input blocks */
+    fluid_real_t *work;     /* 2N complex values */
+} fluid_conv_stage_t;
+
+struct _fluid_convolver_t
+{
+    int length;             /* frames of the impulse response */
+    int decay_frames;       /* frames of silent input after which the output is silent */
+    int silent_frames;      /* frames of silent input since the last sound, up to decay_frames */
+    fluid_real_t level;
+
+    fluid_conv_stage_t head;
+    fluid_real_t head_out[2 * FLUID_BUFSIZE];
+
+    int with_tail;
+    fluid_conv_stage_t tail;
+    int tail_pos;           /* frames of the current tail block gathered */
+    fluid_real_t *tail_in;  /* input gathered for the current tail block */
+    fluid_real_t *tail_out[2]; /* left then right output of the current tail block, and of the next one */
+    int tail_read;          /* index of the tail_out being read */
+
+#if ENABLE_MIXER_THREADS
+    fluid_thread_t *thread;
+    fluid_cond_mutex_t *mutex;
+    fluid_cond_t *cond;     /* signalled when a job is pending or done, and on quit */
+    fluid_real_t *job_in;   /* input block of the job, owned by the worker while the job is pending */
+    fluid_real_t *job_out;  /* output of the job */
+    int job_pending;        /* protected by mutex */
+    int should_quit;        /* protected by mutex */
+#endif
+};
+
+static int
+fluid_conv_fft_init(fluid_conv_fft_t *fft, int size)
+{
+    int i, j, k, bits = 0;
+
+    fft->size = size;
+    fft->bitrev = FLUID_ARRAY(int, size);
+    fft->twiddle = FLUID_ARRAY(fluid_real_t, size);
+
+    if(fft->bitrev == NULL || fft->twiddle == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    while((1 << bits) < size)
+    {
+        bits++;
+    }
+
+    for(i = 0; i < size; i++)
+    {
+        for(j = 0, k = 0; k < bits; k++)
+        {
+            j = (j << 1) | ((i >> k) & 1);
+        }
+
+        fft->bitrev[i] = j;
+    }
+
+    for(i = 0; i < size / 2; i++)
+    {
+        fft->twiddle[2 * i] = cos(2.0 * M_PI * i / size);
+        fft->twiddle[2 * i + 1] = -sin(2.0 * M_PI * i / size);
+    }
+
+    return FLUID_OK;
+}
+
+static void
+fluid_conv_fft_free(fluid_conv_fft_t *fft)
+{
+    FLUID_FREE(fft->bitrev);
+    FLUID_FREE(fft->twiddle);
+}
+
+/* In-place radix-2 transform of fft->size complex values, the inverse one isn't scaled */
+static void
+fluid_conv_fft(const fluid_conv_fft_t *fft, fluid_real_t *data, int inverse)
+{
+    const int n = fft->size;
+    const fluid_real_t sign = inverse ? -1 : 1;
+    int i, j, k, len;
+
+    for(i = 0; i < n; i++)
+    {
+        j = fft->bitrev[i];
+
+        if(j > i)
+        {
+            fluid_real_t re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+
+    for(len = 2; len <= n; len <<= 1)
+    {
+        const int half = len / 2, step = n / len;
+
+        for(i = 0; i < n; i += len)
+        {
+            fluid_real_t *FLUID_RESTRICT a = &data[2 * i];
+            fluid_real_t *FLUID_RESTRICT b = &data[2 * (i + half)];
+
+            for(k = 0; k < half; k++)
+            {
+                fluid_real_t wr = fft->twiddle[2 * k * step];
+                fluid_real_t wi = sign * fft->twiddle[2 * k * step + 1];
+                fluid_real_t xr = b[2 * k] * wr - b[2 * k + 1] * wi;
+                fluid_real_t xi = b[2 * k] * wi + b[2 * k + 1] * wr;
+
+                b[2 * k] = a[2 * k] - xr;
+                b[2 * k + 1] = a[2 * k + 1] - xi;
+                a[2 * k] += xr;
+                a[2 * k + 1] += xi;
+            }
+        }
+    }
+}
+
+static void
+fluid_conv_stage_clear(fluid_conv_stage_t *stage)
+{
+    FLUID_MEMSET(stage->fdl, 0, stage->count * 4 * stage->size * sizeof(fluid_real_t));
+    FLUID_MEMSET(stage->in, 0, 2 * stage->size * sizeof(fluid_real_t));
+    stage->fdl_pos = 0;
+}
+
+static void
+fluid_conv_stage_free(fluid_conv_stage_t *stage)
+{
+    fluid_conv_fft_free(&stage->fft);
+    FLUID_FREE(stage->ir);
+    FLUID_FREE(stage->fdl);
+    FLUID_FREE(stage->in);
+    FLUID_FREE(stage->work);
+}
+
+/*
+ * Set up the convolution of count partitions of size frames of the impulse response,
+ * starting at frame offset.
+ */
+static int
+fluid_conv_stage_init(fluid_conv_stage_t *stage, const float *left, const float *right,
+                      int length, int offset, int size, int count)
+{
+    const int m = 2 * size;
+    const fluid_real_t scale = (fluid_real_t)1 / m;
+    int i, j, frame;
+
+    FLUID_MEMSET(stage, 0, sizeof(*stage));
+    stage->size = size;
+    stage->count = count;
+
+    if(fluid_conv_fft_init(&stage->fft, m) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    stage->ir = FLUID_ARRAY(fluid_real_t, count * 2 * m);
+    stage->fdl = FLUID_ARRAY(fluid_real_t, count * 2 * m);
+    stage->in = FLUID_ARRAY(fluid_real_t, m);
+    stage->work = FLUID_ARRAY(fluid_real_t, 2 * m);
+
+    if(stage->ir == NULL || stage->fdl == NULL || stage->in == NULL || stage->work == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(stage->ir, 0, count * 2 * m * sizeof(fluid_real_t));
+
+    /* the scale of the inverse transforms is applied to the impulse response */
+    for(j = 0; j < count; j++)
+    {
+        fluid_real_t *spectrum = &stage->ir[j * 2 * m];
+
+        for(i = 0, frame = offset + j * size; i < size && frame < length; i++, frame++)
+        {
+            spectrum[2 * i] = left[frame] * scale;
+            spectrum[2 * i + 1] = right[frame] * scale;
+        }
+
+        fluid_conv_fft(&stage->fft, spectrum, FALSE);
+    }
+
+    fluid_conv_stage_clear(stage);
+
+    return FLUID_OK;
+}
+
+/* Convolve the next block of stage->size input frames */
+static void
+fluid_conv_stage_process(fluid_conv_stage_t *stage, const fluid_real_t *in,
+                         fluid_real_t *out_l, fluid_real_t *out_r)
+{
+    const int n = stage->size, m = 2 * n;
+    fluid_real_t *FLUID_RESTRICT acc = stage->work;
+    fluid_real_t *x;
+    int i, j, pos;
+
+    /* overlap-save: transform the previous block followed by the new one */
+    FLUID_MEMMOVE(stage->in, stage->in + n, n * sizeof(fluid_real_t));
+    FLUID_MEMCPY(stage->in + n, in, n * sizeof(fluid_real_t));
+
+    stage->fdl_pos = (stage->fdl_pos + 1) % stage->count;
+    x = &stage->fdl[stage->fdl_pos * 2 * m];
+
+    for(i = 0; i < m; i++)
+    {
+        x[2 * i] = stage->in[i];
+        x[2 * i + 1] = 0;
+    }
+
+    fluid_conv_fft(&stage->fft, x, FALSE);
+
+    /* the latest input block with the first partition, the one before it with the second... */
+    FLUID_MEMSET(acc, 0, 2 * m * sizeof(fluid_real_t));
+
+    for(j = 0, pos = stage->fdl_pos; j < stage->count; j++, pos = (pos > 0) ? pos - 1 : stage->count - 1)
+    {
+        const fluid_real_t *FLUID_RESTRICT xs = &stage->fdl[pos * 2 * m];
+        const fluid_real_t *FLUID_RESTRICT h = &stage->ir[j * 2 * m];
+
+        for(i = 0; i < 2 * m; i += 2)
+        {
+            acc[i] += xs[i] * h[i] - xs[i + 1] * h[i + 1];
+            acc[i + 1] += xs[i] * h[i + 1] + xs[i + 1] * h[i];
+        }
+    }
+
+    fluid_conv_fft(&stage->fft, acc, TRUE);
+
+    /* the first half is wrapped around, the second one is the output */
+    for(i = 0; i < n; i++)
+    {
+        out_l[i] = acc[2 * (n + i)];
+        out_r[i] = acc[2 * (n + i) + 1];
+    }
+}
+
+/* Convolve a tail block of input, out receives the left output followed by the right one */
+static void
+fluid_convolver_run_job(fluid_convolver_t *conv, const fluid_real_t *in, fluid_real_t *out)
+{
+    fluid_conv_stage_process(&conv->tail, in, out, out + conv->tail.size);
+}
+
+#if ENABLE_MIXER_THREADS
+static fluid_thread_return_t
+fluid_convolver_worker(void *data)
+{
+    fluid_convolver_t *conv = data;
+    unsigned int state;
+    int flushed = (fluid_thread_self_flush_denormals(TRUE, &state) == FLUID_OK);
+
+    fluid_cond_mutex_lock(conv->mutex);
+
+    while(1)
+    {
+        while(!conv->job_pending && !conv->should_quit)
+        {
+            fluid_cond_wait(conv->cond, conv->mutex);
+        }
+
+        if(conv->should_quit)
+        {
+            break;
+        }
+
+        fluid_cond_mutex_unlock(conv->mutex);
+        fluid_convolver_run_job(conv, conv->job_in, conv->job_out);
+        fluid_cond_mutex_lock(conv->mutex);
+
+        conv->job_pending = FALSE;
+        fluid_cond_broadcast(conv->cond);
+    }
+
+    fluid_cond_mutex_unlock(conv->mutex);
+
+    if(flushed)
+    {
+        fluid_thread_self_restore_denormals(state);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+#endif
+
+/* Wait for the worker to complete the tail block it is working on, if any */
+static void
+fluid_convolver_wait_tail(fluid_convolver_t *conv)
+{
+#if ENABLE_MIXER_THREADS
+
+    if(conv->thread != NULL)
+    {
+        fluid_cond_mutex_lock(conv->mutex);
+
+        while(conv->job_pending)
+        {
+            fluid_cond_wait(conv->cond, conv->mutex);
+        }
+
+        fluid_cond_mutex_unlock(conv->mutex);
+    }
+
+#endif
+}
+
+/*
+ * Start convolving the tail block just gathered. Its output is read while the
+ * next one is gathered, by then the output of the previous block has to be done.
+ */
+static void
+fluid_convolver_next_tail_block(fluid_convolver_t *conv)
+{
+    fluid_real_t *out;
+
+    fluid_convolver_wait_tail(conv);
+    conv->tail_read = !conv->tail_read;
+    out = conv->tail_out[!conv->tail_read];
+
+#if ENABLE_MIXER_THREADS
+
+    if(conv->thread != NULL)
+    {
+        FLUID_MEMCPY(conv->job_in, conv->tail_in, conv->tail.size * sizeof(fluid_real_t));
+
+        fluid_cond_mutex_lock(conv->mutex);
+        conv->job_out = out;
+        conv->job_pending = TRUE;
+        fluid_cond_broadcast(conv->cond);
+        fluid_cond_mutex_unlock(conv->mutex);
+        return;
+    }
+
+#endif
+
+    /* without a worker, the rendering thread does it right away */
+    fluid_convolver_run_job(conv, conv->tail_in, out);
+}
+
+/**
+ * Create a convolution reverb. Not hard real-time capable.
+ * @param left impulse response of the left channel
+ * @param right impulse response of the right channel, NULL to use the left one for both
+ * @param length number of frames of the impulse response
+ * @param tail_size partition size in frames of the part of the impulse response convolved
+ *   by a worker thread, rounded up to a power of two of at least FLUID_CONVOLVER_MIN_TAIL_SIZE.
+ *   0 to convolve all of it in the rendering thread, in partitions of FLUID_BUFSIZE frames.
+ * @param prio_level real-time priority of the worker thread
+ * @return the convolution reverb, NULL on error
+ */
+fluid_convolver_t *
+new_fluid_convolver(const float *left, const float *right, int length, int tail_size, int prio_level)
+{
+    fluid_convolver_t *conv;
+    int head_length = length;
+    int size = FLUID_CONVOLVER_MIN_TAIL_SIZE;
+
+    fluid_return_val_if_fail(left != NULL, NULL);
+    fluid_return_val_if_fail(length > 0, NULL);
+    fluid_return_val_if_fail(tail_size >= 0, NULL);
+
+    if(right == NULL)
+    {
+        right = left;
+    }
+
+    conv = FLUID_NEW(fluid_convolver_t);
+
+    if(conv == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(conv, 0, sizeof(*conv));
+    conv->length = length;
+    conv->level = 1;
+
+    if(tail_size > 0)
+    {
+        while(size < tail_size)
+        {
+            size <<= 1;
+        }
+
+        /* the head covers the first two tail blocks of the impulse response */
+        conv->with_tail = (length > 2 * size);
+    }
+
+    if(conv->with_tail)
+    {
+        head_length = 2 * size;
+
+        if(fluid_conv_stage_init(&conv->tail, left, right, length, head_length, size,
+                                 (length - head_length + size - 1) / size) != FLUID_OK)
+        {
+            goto error_recovery;
+        }
+
+        conv->tail_in = FLUID_ARRAY(fluid_real_t, size);
+        conv->tail_out[0] = FLUID_ARRAY(fluid_real_t, 2 * size);
+        conv->tail_out[1] = FLUID_ARRAY(fluid_real_t, 2 * size);
+
+        if(conv->tail_in == NULL || conv->tail_out[0] == NULL || conv->tail_out[1] == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+
+        /* the output of the tail lags behind its input by a block, and the input by the head */
+        conv->decay_frames = 4 * size;
+    }
+
+    if(fluid_conv_stage_init(&conv->head, left, right, length, 0, FLUID_BUFSIZE,
+                             (head_length + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    conv->decay_frames += length + 2 * FLUID_BUFSIZE;
+    fluid_convolver_reset(conv);
+
+#if ENABLE_MIXER_THREADS
+
+    if(conv->with_tail)
+    {
+        conv->job_in = FLUID_ARRAY(fluid_real_t, size);
+        conv->mutex = new_fluid_cond_mutex();
+        conv->cond = new_fluid_cond();
+
+        if(conv->job_in == NULL || conv->mutex == NULL || conv->cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+
+        conv->thread = new_fluid_thread("convolver", fluid_convolver_worker, conv, prio_level, FALSE);
+
+        if(conv->thread == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to create the convolution reverb thread, the rendering thread convolves the tail");
+        }
+    }
+
+#endif
+
+    return conv;
+
+error_recovery:
+    delete_fluid_convolver(conv);
+    return NULL;
+}
+
+void
+delete_fluid_convolver(fluid_convolver_t *conv)
+{
+    fluid_return_if_fail(conv != NULL);
+
+#if ENABLE_MIXER_THREADS
+
+    if(conv->thread != NULL)
+    {
+        fluid_cond_mutex_lock(conv->mutex);
+        conv->should_quit = TRUE;
+        fluid_cond_broadcast(conv->cond);
+        fluid_cond_mutex_unlock(conv->mutex);
+
+        fluid_thread_join(conv->thread);
+        delete_fluid_thread(conv->thread);
+    }
+
+    if(conv->mutex != NULL)
+    {
+        delete_fluid_cond_mutex(conv->mutex);
+    }
+
+    if(conv->cond != NULL)
+    {
+        delete_fluid_cond(conv->cond);
+    }
+
+    FLUID_FREE(conv->job_in);
+#endif
+
+    fluid_conv_stage_free(&conv->head);
+    fluid_conv_stage_free(&conv->tail);
+    FLUID_FREE(conv->tail_in);
+    FLUID_FREE(conv->tail_out[0]);
+    FLUID_FREE(conv->tail_out[1]);
+    FLUID_FREE(conv);
+}
+
+/* the bytes of the spectra and buffers of a stage, see fluid_conv_stage_init() */
+static size_t
+fluid_conv_stage_get_size(const fluid_conv_stage_t *stage)
+{
+    size_t m = 2 * (size_t)stage->size;
+
+    return m * (sizeof(int) + sizeof(fluid_real_t))
+           + (4 * stage->count * m + 3 * m) * sizeof(fluid_real_t);
+}
+
+size_t
+fluid_convolver_get_size(const fluid_convolver_t *conv)
+{
+    size_t size = sizeof(*conv) + fluid_conv_stage_get_size(&conv->head);
+
+    if(conv->with_tail)
+    {
+        /* tail_in and the two tail_out */
+        size += fluid_conv_stage_get_size(&conv->tail) + 5 * (size_t)conv->tail.size * sizeof(fluid_real_t);
+
+#if ENABLE_MIXER_THREADS
+        size += (size_t)conv->tail.size * sizeof(fluid_real_t);
+#endif
+    }
+
+    return size;
+}
+
+static FLUID_INLINE void
+fluid_convolver_process(fluid_convolver_t *conv, const fluid_real_t *in,
+                        fluid_real_t *left_out, fluid_real_t *right_out, int mix)
+{
+    fluid_real_t *FLUID_RESTRICT out_l = conv->head_out;
+    fluid_real_t *FLUID_RESTRICT out_r = conv->head_out + FLUID_BUFSIZE;
+    int i = 0;
+
+    while(i < FLUID_BUFSIZE && in[i] == 0)
+    {
+        i++;
+    }
+
+    if(i < FLUID_BUFSIZE)
+    {
+        conv->silent_frames = 0;
+    }
+    else if(conv->silent_frames < conv->decay_frames)
+    {
+        conv->silent_frames += FLUID_BUFSIZE;
+    }
+
+    fluid_conv_stage_process(&conv->head, in, out_l, out_r);
+
+    if(conv->with_tail)
+    {
+        const fluid_real_t *FLUID_RESTRICT tail_l = conv->tail_out[conv->tail_read] + conv->tail_pos;
+        const fluid_real_t *FLUID_RESTRICT tail_r = tail_l + conv->tail.size;
+
+        for(i = 0; i < FLUID_BUFSIZE; i++)
+        {
+            out_l[i] += tail_l[i];
+            out_r[i] += tail_r[i];
+        }
+
+        FLUID_MEMCPY(conv->tail_in + conv->tail_pos, in, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        conv->tail_pos += FLUID_BUFSIZE;
+
+        if(conv->tail_pos == conv->tail.size)
+        {
+            fluid_convolver_next_tail_block(conv);
+            conv->tail_pos = 0;
+        }
+    }
+
+    if(mix)
+    {
+        for(i = 0; i < FLUID_BUFSIZE; i++)
+        {
+            left_out[i] += conv->level * out_l[i];
+            right_out[i] += conv->level * out_r[i];
+        }
+    }
+    else
+    {
+        for(i = 0; i < FLUID_BUFSIZE; i++)
+        {
+            left_out[i] = conv->level * out_l[i];
+            right_out[i] = conv->level * out_r[i];
+        }
+    }
+}
+
+/**
+ * Convolve FLUID_BUFSIZE frames of input, and add the output to left_out and right_out.
+ */
+void
+fluid_convolver_processmix(fluid_convolver_t *conv, const fluid_real_t *in,
+                           fluid_real_t *left_out, fluid_real_t *right_out)
+{
+    fluid_convolver_process(conv, in, left_out, right_out, TRUE);
+}
+
+/**
+ * Convolve FLUID_BUFSIZE frames of input into left_out and right_out.
+ */
+void
+fluid_convolver_processreplace(fluid_convolver_t *conv, const fluid_real_t *in,
+                               fluid_real_t *left_out, fluid_real_t *right_out)
+{
+    fluid_convolver_process(conv, in, left_out, right_out, FALSE);
+}
+
+/**
+ * Silence the convolution reverb. Waits for the worker, if it is convolving the tail.
+ */
+void
+fluid_convolver_reset(fluid_convolver_t *conv)
+{
+    fluid_conv_stage_clear(&conv->head);
+
+    if(conv->with_tail)
+    {
+        fluid_convolver_wait_tail(conv);
+        fluid_conv_stage_clear(&conv->tail);
+        FLUID_MEMSET(conv->tail_out[0], 0, 2 * conv->tail.size * sizeof(fluid_real_t));
+        FLUID_MEMSET(conv->tail_out[1], 0, 2 * conv->tail.size * sizeof(fluid_real_t));
+        conv->tail_pos = 0;
+    }
+
+    conv->silent_frames = conv->decay_frames;
+}
+
+/**
+ * @return TRUE if the input has been silent for long enough for the output to be
+ * silent, and to stay silent as long as the input is. No reset is needed then,
+ * before the convolution reverb is bypassed.
+ */
+int
+fluid_convolver_is_decayed(fluid_convolver_t *conv)
+{
+    return conv->silent_frames >= conv->decay_frames;
+}
+
+/**
+ * Set the gain of the output.
+ */
+void
+fluid_convolver_set_level(fluid_convolver_t *conv, fluid_real_t level)
+{
+    conv->level = level;
+}
@@ -0,0 +1,52 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+
+#ifndef _FLUID_CONVOLVER_H
+#define _FLUID_CONVOLVER_H
+
+#include "fluidsynth_priv.h"
+
+typedef struct _fluid_convolver_t fluid_convolver_t;
+
+/* The shortest partitions of the tail of an impulse response, see new_fluid_convolver() */
+#define FLUID_CONVOLVER_MIN_TAIL_SIZE (2 * FLUID_BUFSIZE)
+
+
+/*
+ * convolution reverb
+ */
+fluid_convolver_t *new_fluid_convolver(const float *left, const float *right, int length,
+                                       int tail_size, int prio_level);
+void delete_fluid_convolver(fluid_convolver_t *conv);
+size_t fluid_convolver_get_size(const fluid_convolver_t *conv);
+
+void fluid_convolver_processmix(fluid_convolver_t *conv, const fluid_real_t *in,
+                                fluid_real_t *left_out, fluid_real_t *right_out);
+
+void fluid_convolver_processreplace(fluid_convolver_t *conv, const fluid_real_t *in,
+                                    fluid_real_t *left_out, fluid_real_t *right_out);
+
+void fluid_convolver_reset(fluid_convolver_t *conv);
+int fluid_convolver_is_decayed(fluid_convolver_t *conv);
+
+void fluid_convolver_set_level(fluid_convolver_t *conv, fluid_real_t level);
+
+#endif /* _FLUID_CONVOLVER_H */
@@ -33,6 +33,7 @@
  * @param iir_filter Filter parameter
  * @param dsp_buf Pointer to the synthesized audio data
  * @param count Count of samples in dsp_buf
+ * @param check_denormal TRUE to flush a denormal filter history to zero first
  */
 /*
  * Variable description:
@@ -46,6 +47,96 @@
  * - dsp_hist1: same
  * - dsp_hist2: same
  */
+static FLUID_INLINE void
+fluid_iir_filter_run(fluid_iir_filter_t *iir_filter,
+                     fluid_real_t *dsp_buf, int count, int check_denormal)
+{
+    /* IIR filter sample history */
+    fluid_real_t dsp_hist1 = iir_filter->hist1;
+    fluid_real_t dsp_hist2 = iir_filter->hist2;
+
+    /* IIR filter coefficients */
+    fluid_real_t dsp_a1 = iir_filter->a1;
+    fluid_real_t dsp_a2 = iir_filter->a2;
+    fluid_real_t dsp_b02 = iir_filter->b02;
+    fluid_real_t dsp_b1 = iir_filter->b1;
+    int dsp_filter_coeff_incr_count = iir_filter->filter_coeff_incr_count;
+
+    fluid_real_t dsp_centernode;
+    int dsp_i;
+
+    /* filter (implement the voice filter according to SoundFont standard) */
+
+    /* Check for denormal number (too close to zero). */
+    if(check_denormal && FLUID_FABS(dsp_hist1) < 1e-20f)
+    {
+        dsp_hist1 = 0.0f;    /* FIXME JMG - Is this even needed? */
+    }
+
+    /* Two versions of the filter loop. One, while the filter is
+    * changing towards its new setting. The other, if the filter
+    * doesn't change.
+    */
+
+    if(dsp_filter_coeff_incr_count > 0)
+    {
+        fluid_real_t dsp_a1_incr = iir_filter->a1_incr;
+        fluid_real_t dsp_a2_incr = iir_filter->a2_incr;
+        fluid_real_t dsp_b02_incr = iir_filter->b02_incr;
+        fluid_real_t dsp_b1_incr = iir_filter->b1_incr;
+
+
+        /* Increment is added to each filter coefficient filter_coeff_incr_count times. */
+        for(dsp_i = 0; dsp_i < count; dsp_i++)
+        {
+            /* The filter is implemented in Direct-II form. */
+            dsp_centernode = dsp_buf[dsp_i] - dsp_a1 * dsp_hist1 - dsp_a2 * dsp_hist2;
+            dsp_buf[dsp_i] = dsp_b02 * (dsp_centernode + dsp_hist2) + dsp_b1 * dsp_hist1;
+            dsp_hist2 = dsp_hist1;
+            dsp_hist1 = dsp_centernode;
+
+            if(dsp_filter_coeff_incr_count-- > 0)
+            {
+                fluid_real_t old_b02 = dsp_b02;
+                dsp_a1 += dsp_a1_incr;
+                dsp_a2 += dsp_a2_incr;
+                dsp_b02 += dsp_b02_incr;
+                dsp_b1 += dsp_b1_incr;
+
+                /* Compensate history to avoid the filter going havoc with large frequency changes */
+                if(iir_filter->compensate_incr && FLUID_FABS(dsp_b02) > 0.001f)
+                {
+                    fluid_real_t compensate = old_b02 / dsp_b02;
+                    dsp_hist1 *= compensate;
+                    dsp_hist2 *= compensate;
+                }
+            }
+        } /* for dsp_i */
+    }
+    else /* The filter parameters are constant.  This is duplicated to save time. */
+    {
+        for(dsp_i = 0; dsp_i < count; dsp_i++)
+        {
+            /* The filter is implemented in Direct-II form. */
+            dsp_centernode = dsp_buf[dsp_i] - dsp_a1 * dsp_hist1 - dsp_a2 * dsp_hist2;
+            dsp_buf[dsp_i] = dsp_b02 * (dsp_centernode + dsp_hist2) + dsp_b1 * dsp_hist1;
+            dsp_hist2 = dsp_hist1;
+            dsp_hist1 = dsp_centernode;
+        }
+    }
+
+    iir_filter->hist1 = dsp_hist1;
+    iir_filter->hist2 = dsp_hist2;
+    iir_filter->a1 = dsp_a1;
+    iir_filter->a2 = dsp_a2;
+    iir_filter->b02 = dsp_b02;
+    iir_filter->b1 = dsp_b1;
+    iir_filter->filter_coeff_incr_count = dsp_filter_coeff_incr_count;
+}
+
+/**
+ * Applies the filter to a block of synthesized audio data, see fluid_iir_filter_run().
+ */
 void
 fluid_iir_filter_apply(fluid_iir_filter_t *iir_filter,
                        fluid_real_t *dsp_buf, int count)
@@ -54,91 +145,234 @@ fluid_iir_filter_apply(fluid_iir_filter_t *iir_filter,
     {
         return;
     }
-    else
+
+    fluid_iir_filter_run(iir_filter, dsp_buf, count, TRUE);
+    fluid_check_fpe("voice_filter");
+}
+
+/**
+ * Applies the filter to a part of a block, for filtering a block in several
+ * calls. Only the first part checks the filter history for denormals, so that
+ * the parts come out as from a single fluid_iir_filter_apply() call for the
+ * whole block.
+ * @param iir_filter Filter parameter
+ * @param dsp_buf Pointer to the part of the synthesized audio data
+ * @param count Count of samples in dsp_buf
+ * @param first TRUE for the first part of a block
+ */
+void
+fluid_iir_filter_apply_part(fluid_iir_filter_t *iir_filter,
+                            fluid_real_t *dsp_buf, int count, int first)
+{
+    if(iir_filter->type == FLUID_IIR_DISABLED || iir_filter->q_lin == 0)
+    {
+        return;
+    }
+
+    fluid_iir_filter_run(iir_filter, dsp_buf, count, first);
+}
+
+
+/**
+ * Filters one full block of up to #FLUID_IIR_FILTER_LANES voices, one voice per lane.
+ * The unused lanes have all their coefficients and history set to zero, so they
+ * produce silence without any special treatment.
+ */
+static void
+fluid_iir_filter_apply_lanes(fluid_iir_filter_t **iir_filters, fluid_real_t **dsp_bufs, int lanes)
+{
+    /* the samples of all lanes interleaved, so that each frame is one contiguous vector */
+    fluid_real_t frames[FLUID_BUFSIZE * FLUID_IIR_FILTER_LANES];
+    fluid_real_t hist1[FLUID_IIR_FILTER_LANES], hist2[FLUID_IIR_FILTER_LANES];
+    fluid_real_t a1[FLUID_IIR_FILTER_LANES], a2[FLUID_IIR_FILTER_LANES];
+    fluid_real_t b02[FLUID_IIR_FILTER_LANES], b1[FLUID_IIR_FILTER_LANES];
+    fluid_real_t a1_incr[FLUID_IIR_FILTER_LANES], a2_incr[FLUID_IIR_FILTER_LANES];
+    fluid_real_t b02_incr[FLUID_IIR_FILTER_LANES], b1_incr[FLUID_IIR_FILTER_LANES];
+    int incr_count[FLUID_IIR_FILTER_LANES], compensate_incr[FLUID_IIR_FILTER_LANES];
+    int i, v, ramp_count = 0;
+
+    for(v = 0; v < FLUID_IIR_FILTER_LANES; v++)
+    {
+        if(v < lanes)
+        {
+            fluid_iir_filter_t *iir_filter = iir_filters[v];
+
+            hist1[v] = iir_filter->hist1;
+            hist2[v] = iir_filter->hist2;
+            a1[v] = iir_filter->a1;
+            a2[v] = iir_filter->a2;
+            b02[v] = iir_filter->b02;
+            b1[v] = iir_filter->b1;
+            incr_count[v] = iir_filter->filter_coeff_incr_count;
+            compensate_incr[v] = iir_filter->compensate_incr;
+
+            /* only ramping filters carry meaningful increments */
+            if(incr_count[v] > 0)
+            {
+                a1_incr[v] = iir_filter->a1_incr;
+                a2_incr[v] = iir_filter->a2_incr;
+                b02_incr[v] = iir_filter->b02_incr;
+                b1_incr[v] = iir_filter->b1_incr;
+                ramp_count = (incr_count[v] > ramp_count) ? incr_count[v] : ramp_count;
+            }
+            else
+            {
+                a1_incr[v] = a2_incr[v] = b02_incr[v] = b1_incr[v] = 0;
+            }
+
+            /* Check for denormal number (too close to zero). */
+            if(FLUID_FABS(hist1[v]) < 1e-20f)
+            {
+                hist1[v] = 0.0f;
+            }
+
+            for(i = 0; i < FLUID_BUFSIZE; i++)
+            {
+                frames[i * FLUID_IIR_FILTER_LANES + v] = dsp_bufs[v][i];
+            }
+        }
+        else
+        {
+            hist1[v] = hist2[v] = a1[v] = a2[v] = b02[v] = b1[v] = 0;
+            a1_incr[v] = a2_incr[v] = b02_incr[v] = b1_incr[v] = 0;
+            incr_count[v] = compensate_incr[v] = 0;
+
+            for(i = 0; i < FLUID_BUFSIZE; i++)
+            {
+                frames[i * FLUID_IIR_FILTER_LANES + v] = 0;
+            }
+        }
+    }
+
+    ramp_count = (ramp_count > FLUID_BUFSIZE) ? FLUID_BUFSIZE : ramp_count;
+
+    /* While any of the filters is changing towards its new setting. The lanes, which
+     * are not (anymore), add zero increments and compensate their history by one. */
+    for(i = 0; i < ramp_count; i++)
+    {
+        fluid_real_t *frame = &frames[i * FLUID_IIR_FILTER_LANES];
+
+        #pragma omp simd
+        for(v = 0; v < FLUID_IIR_FILTER_LANES; v++)
+        {
+            /* The filter is implemented in Direct-II form. */
+            fluid_real_t centernode = frame[v] - a1[v] * hist1[v] - a2[v] * hist2[v];
+            fluid_real_t ramp = (i < incr_count[v]) ? 1.0f : 0.0f;
+            fluid_real_t old_b02 = b02[v];
+            int compensate;
+
+            frame[v] = b02[v] * (centernode + hist2[v]) + b1[v] * hist1[v];
+            hist2[v] = hist1[v];
+            hist1[v] = centernode;
+
+            a1[v] += ramp * a1_incr[v];
+            a2[v] += ramp * a2_incr[v];
+            b02[v] += ramp * b02_incr[v];
+            b1[v] += ramp * b1_incr[v];
+
+            /* Compensate history to avoid the filter going havoc with large frequency changes */
+            compensate = (i < incr_count[v]) && compensate_incr[v] && FLUID_FABS(b02[v]) > 0.001f;
+            old_b02 = compensate ? old_b02 / b02[v] : 1.0f;
+            hist1[v] *= old_b02;
+            hist2[v] *= old_b02;
+        }
+    }
+
+    /* The filter parameters are constant. */
+    for(; i < FLUID_BUFSIZE; i++)
     {
-        /* IIR filter sample history */
-        fluid_real_t dsp_hist1 = iir_filter->hist1;
-        fluid_real_t dsp_hist2 = iir_filter->hist2;
+        fluid_real_t *frame = &frames[i * FLUID_IIR_FILTER_LANES];
 
-        /* IIR filter coefficients */
-        fluid_real_t dsp_a1 = iir_filter->a1;
-        fluid_real_t dsp_a2 = iir_filter->a2;
-        fluid_real_t dsp_b02 = iir_filter->b02;
-        fluid_real_t dsp_b1 = iir_filter->b1;
-        int dsp_filter_coeff_incr_count = iir_filter->filter_coeff_incr_count;
+        #pragma omp simd
+        for(v = 0; v < FLUID_IIR_FILTER_LANES; v++)
+        {
+            fluid_real_t centernode = frame[v] - a1[v] * hist1[v] - a2[v] * hist2[v];
 
-        fluid_real_t dsp_centernode;
-        int dsp_i;
+            frame[v] = b02[v] * (centernode + hist2[v]) + b1[v] * hist1[v];
+            hist2[v] = hist1[v];
+            hist1[v] = centernode;
+        }
+    }
 
-        /* filter (implement the voice filter according to SoundFont standard) */
+    for(v = 0; v < lanes; v++)
+    {
+        fluid_iir_filter_t *iir_filter = iir_filters[v];
 
-        /* Check for denormal number (too close to zero). */
-        if(FLUID_FABS(dsp_hist1) < 1e-20f)
+        for(i = 0; i < FLUID_BUFSIZE; i++)
         {
-            dsp_hist1 = 0.0f;    /* FIXME JMG - Is this even needed? */
+            dsp_bufs[v][i] = frames[i * FLUID_IIR_FILTER_LANES + v];
         }
 
-        /* Two versions of the filter loop. One, while the filter is
-        * changing towards its new setting. The other, if the filter
-        * doesn't change.
-        */
+        iir_filter->hist1 = hist1[v];
+        iir_filter->hist2 = hist2[v];
+        iir_filter->a1 = a1[v];
+        iir_filter->a2 = a2[v];
+        iir_filter->b02 = b02[v];
+        iir_filter->b1 = b1[v];
 
-        if(dsp_filter_coeff_incr_count > 0)
+        /* like fluid_iir_filter_apply(), which counts down once per sample while ramping */
+        if(incr_count[v] > 0)
         {
-            fluid_real_t dsp_a1_incr = iir_filter->a1_incr;
-            fluid_real_t dsp_a2_incr = iir_filter->a2_incr;
-            fluid_real_t dsp_b02_incr = iir_filter->b02_incr;
-            fluid_real_t dsp_b1_incr = iir_filter->b1_incr;
+            iir_filter->filter_coeff_incr_count = incr_count[v] - FLUID_BUFSIZE;
+        }
+    }
 
+    fluid_check_fpe("voice_filter");
+}
 
-            /* Increment is added to each filter coefficient filter_coeff_incr_count times. */
-            for(dsp_i = 0; dsp_i < count; dsp_i++)
-            {
-                /* The filter is implemented in Direct-II form. */
-                dsp_centernode = dsp_buf[dsp_i] - dsp_a1 * dsp_hist1 - dsp_a2 * dsp_hist2;
-                dsp_buf[dsp_i] = dsp_b02 * (dsp_centernode + dsp_hist2) + dsp_b1 * dsp_hist1;
-                dsp_hist2 = dsp_hist1;
-                dsp_hist1 = dsp_centernode;
+/**
+ * Applies the filters of several voices, like calling fluid_iir_filter_apply()
+ * for each of them. The filters of voices, which rendered a full block, are
+ * processed side by side in SIMD lanes, as the recursion of the filter
+ * prevents vectorizing a single voice. Apart from floating point contraction,
+ * the results are identical.
+ *
+ * @param iir_filters Filters to apply
+ * @param dsp_bufs Audio data to filter, one buffer for each filter
+ * @param counts Count of samples in each of dsp_bufs
+ * @param filter_count Number of filters
+ */
+void
+fluid_iir_filter_apply_batch(fluid_iir_filter_t **iir_filters, fluid_real_t **dsp_bufs,
+                             const int *counts, int filter_count)
+{
+    fluid_iir_filter_t *lane_filters[FLUID_IIR_FILTER_LANES];
+    fluid_real_t *lane_bufs[FLUID_IIR_FILTER_LANES];
+    int i, lanes = 0;
 
-                if(dsp_filter_coeff_incr_count-- > 0)
-                {
-                    fluid_real_t old_b02 = dsp_b02;
-                    dsp_a1 += dsp_a1_incr;
-                    dsp_a2 += dsp_a2_incr;
-                    dsp_b02 += dsp_b02_incr;
-                    dsp_b1 += dsp_b1_incr;
-
-                    /* Compensate history to avoid the filter going havoc with large frequency changes */
-                    if(iir_filter->compensate_incr && FLUID_FABS(dsp_b02) > 0.001f)
-                    {
-                        fluid_real_t compensate = old_b02 / dsp_b02;
-                        dsp_hist1 *= compensate;
-                        dsp_hist2 *= compensate;
-                    }
-                }
-            } /* for dsp_i */
+    for(i = 0; i < filter_count; i++)
+    {
+        fluid_iir_filter_t *iir_filter = iir_filters[i];
+
+        if(iir_filter->type == FLUID_IIR_DISABLED || iir_filter->q_lin == 0)
+        {
+            continue;
         }
-        else /* The filter parameters are constant.  This is duplicated to save time. */
+
+        if(counts[i] != FLUID_BUFSIZE)
         {
-            for(dsp_i = 0; dsp_i < count; dsp_i++)
-            {
-                /* The filter is implemented in Direct-II form. */
-                dsp_centernode = dsp_buf[dsp_i] - dsp_a1 * dsp_hist1 - dsp_a2 * dsp_hist2;
-                dsp_buf[dsp_i] = dsp_b02 * (dsp_centernode + dsp_hist2) + dsp_b1 * dsp_hist1;
-                dsp_hist2 = dsp_hist1;
-                dsp_hist1 = dsp_centernode;
-            }
+            fluid_iir_filter_apply(iir_filter, dsp_bufs[i], counts[i]);
+            continue;
         }
 
-        iir_filter->hist1 = dsp_hist1;
-        iir_filter->hist2 = dsp_hist2;
-        iir_filter->a1 = dsp_a1;
-        iir_filter->a2 = dsp_a2;
-        iir_filter->b02 = dsp_b02;
-        iir_filter->b1 = dsp_b1;
-        iir_filter->filter_coeff_incr_count = dsp_filter_coeff_incr_count;
+        lane_filters[lanes] = iir_filter;
+        lane_bufs[lanes++] = dsp_bufs[i];
 
-        fluid_check_fpe("voice_filter");
+        if(lanes == FLUID_IIR_FILTER_LANES)
+        {
+            fluid_iir_filter_apply_lanes(lane_filters, lane_bufs, lanes);
+            lanes = 0;
+        }
+    }
+
+    if(lanes == 1)
+    {
+        /* a single filter is faster in the scalar loop */
+        fluid_iir_filter_apply(lane_filters[0], lane_bufs[0], FLUID_BUFSIZE);
+    }
+    else if(lanes > 1)
+    {
+        fluid_iir_filter_apply_lanes(lane_filters, lane_bufs, lanes);
     }
 }
 
@@ -275,12 +509,16 @@ fluid_iir_filter_calculate_coefficients(fluid_iir_filter_t *iir_filter,
          * into account for both significant frequency relocation and for
          * bandwidth readjustment'. */
 
-        fluid_real_t omega = (fluid_real_t)(2.0 * M_PI) *
-                                            (iir_filter->last_fres / output_rate);
-        fluid_real_t sin_coeff = FLUID_SIN(omega);
-        fluid_real_t cos_coeff = FLUID_COS(omega);
-        fluid_real_t alpha_coeff = sin_coeff / (2.0f * iir_filter->q_lin);
-        fluid_real_t a0_inv = 1.0f / (1.0f + alpha_coeff);
+        /* sin(omega) and 1 - cos(omega) of omega = 2 * PI * last_fres / output_rate,
+         * looked up by the cutoff frequency relative to the output rate */
+        fluid_real_t sin_coeff, omc_coeff, cos_coeff;
+        fluid_real_t alpha_coeff, a0_inv;
+        fluid_real_t a1_temp, a2_temp, b02_temp, b1_temp;
+
+        fluid_nct2trig(iir_filter->last_nct, &sin_coeff, &omc_coeff);
+        cos_coeff = 1.0f - omc_coeff;
+        alpha_coeff = sin_coeff / (2.0f * iir_filter->q_lin);
+        a0_inv = 1.0f / (1.0f + alpha_coeff);
 
         /* Calculate the filter coefficients. All coefficients are
          * normalized by a0. Think of `a1' as `a1/a0'.
@@ -292,10 +530,8 @@ fluid_iir_filter_calculate_coefficients(fluid_iir_filter_t *iir_filter,
          *  iir_filter->b2=(1.-cos_coeff)*a0_inv*0.5*iir_filter->filter_gain; */
 
         /* "a" coeffs are same for all 3 available filter types */
-        fluid_real_t a1_temp = -2.0f * cos_coeff * a0_inv;
-        fluid_real_t a2_temp = (1.0f - alpha_coeff) * a0_inv;
-
-        fluid_real_t b02_temp, b1_temp;
+        a1_temp = -2.0f * cos_coeff * a0_inv;
+        a2_temp = (1.0f - alpha_coeff) * a0_inv;
 
         switch(iir_filter->type)
         {
@@ -309,7 +545,7 @@ fluid_iir_filter_calculate_coefficients(fluid_iir_filter_t *iir_filter,
             break;
 
         case FLUID_IIR_LOWPASS:
-            b1_temp = (1.0f - cos_coeff) * a0_inv * iir_filter->filter_gain;
+            b1_temp = omc_coeff * a0_inv * iir_filter->filter_gain;
 
             /* both b0 -and- b2 */
             b02_temp = b1_temp * 0.5f;
@@ -371,10 +607,21 @@ void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
                            fluid_real_t output_rate,
                            fluid_real_t fres_mod)
 {
-    fluid_real_t fres;
+    fluid_real_t fres, cents = iir_filter->fres + fres_mod, nct;
+
+    /* the output rate in cents, to look up the coefficients by the cutoff in cents */
+    if(iir_filter->nct_rate != output_rate)
+    {
+        iir_filter->nct_rate = output_rate;
+        iir_filter->rate_nct = fluid_hz2ct(output_rate);
+    }
 
     /* calculate the frequency of the resonant filter in Hz */
-    fres = fluid_ct2hz(iir_filter->fres + fres_mod);
+    fres = fluid_ct2hz(cents);
+
+    /* fluid_ct2hz() clips to the SoundFont range and resolves whole cents */
+    fluid_clip(cents, 1500, 13500);
+    nct = (int)cents - iir_filter->rate_nct;
 
     /* FIXME - Still potential for a click during turn on, can we interpolate
        between 20khz cutoff and 0 Q? */
@@ -392,10 +639,12 @@ void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
     if(fres > 0.45f * output_rate)
     {
         fres = 0.45f * output_rate;
+        nct = -1382.4f;           /* 1200 * log2(0.45) */
     }
     else if(fres < 5.f)
     {
         fres = 5.f;
+        nct = fluid_hz2ct(5.f) - iir_filter->rate_nct;
     }
 
     /* if filter enabled and there is a significant frequency change.. */
@@ -408,6 +657,7 @@ void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
          * case, the filter is set directly, instead of smoothly fading
          * between old and new settings. */
         iir_filter->last_fres = fres;
+        iir_filter->last_nct = nct;
         fluid_iir_filter_calculate_coefficients(iir_filter, FLUID_BUFSIZE,
                                                 output_rate);
     }
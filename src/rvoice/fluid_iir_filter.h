@@ -32,6 +32,15 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_q);
 void fluid_iir_filter_apply(fluid_iir_filter_t *iir_filter,
                             fluid_real_t *dsp_buf, int dsp_buf_count);
 
+void fluid_iir_filter_apply_part(fluid_iir_filter_t *iir_filter,
+                                 fluid_real_t *dsp_buf, int dsp_buf_count, int first);
+
+/* Number of filters processed side by side by fluid_iir_filter_apply_batch() */
+#define FLUID_IIR_FILTER_LANES 8
+
+void fluid_iir_filter_apply_batch(fluid_iir_filter_t **iir_filters, fluid_real_t **dsp_bufs,
+                                  const int *counts, int filter_count);
+
 void fluid_iir_filter_reset(fluid_iir_filter_t *iir_filter);
 
 void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
@@ -67,6 +76,9 @@ struct _fluid_iir_filter_t
     fluid_real_t last_fres;         /* Current resonance frequency of the IIR filter */
     /* Serves as a flag: A deviation between fres and last_fres */
     /* indicates, that the filter has to be recalculated. */
+    fluid_real_t last_nct;          /* last_fres in cents relative to the output rate */
+    fluid_real_t nct_rate;          /* the output rate that rate_nct was calculated for */
+    fluid_real_t rate_nct;          /* the output rate in absolute cents */
     fluid_real_t q_lin;             /* the q-factor on a linear scale */
     fluid_real_t filter_gain;       /* Gain correction factor, depends on q */
 };
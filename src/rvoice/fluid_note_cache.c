@@ -0,0 +1,497 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_note_cache.h"
+#include "fluid_sys.h"
+
+/* Count of blocks the recordings grow by at once */
+#define FLUID_NOTE_CACHE_CHUNK_BLOCKS 16
+
+/* Count of chunks per entry the size of the cache is divided into */
+#define FLUID_NOTE_CACHE_ENTRY_CHUNKS 4
+
+/* the state of a voice, which determines its output before panning */
+typedef struct
+{
+    fluid_rvoice_dsp_t dsp;
+    fluid_iir_filter_t resonant_filter;
+    fluid_iir_filter_t resonant_custom_filter;
+    fluid_rvoice_envlfo_t envlfo;
+} fluid_note_cache_state_t;
+
+typedef struct
+{
+    fluid_note_cache_state_t state; /* the state of the voice once it has rendered the block */
+    int count;                      /* the count returned by fluid_rvoice_write() for the block */
+    fluid_real_t buf[FLUID_BUFSIZE];
+} fluid_note_cache_block_t;
+
+struct _fluid_note_cache_chunk_t
+{
+    fluid_note_cache_chunk_t *next;
+    fluid_note_cache_block_t blocks[FLUID_NOTE_CACHE_CHUNK_BLOCKS];
+};
+
+struct _fluid_note_cache_entry_t
+{
+    fluid_note_cache_state_t start; /* the state the recording has started in */
+    const short *data;              /* the data of the sample, to tell another sample at the same address apart */
+    fluid_note_cache_chunk_t *chunks; /* the chunks holding the recorded blocks */
+    fluid_note_cache_chunk_t *last_chunk;
+    int block_count;                /* count of blocks recorded */
+    int capacity;                   /* count of blocks the chunks hold */
+    int used;                       /* Is the entry holding a recording? */
+    int recording;                  /* Is a voice still recording it? */
+    int stale;                      /* Has the entry been cleared while in use? Not played anymore */
+    int users;                      /* count of the voices recording or playing it */
+    unsigned int last_use;          /* the value of the clock of the cache when it has last been started */
+};
+
+struct _fluid_note_cache_t
+{
+    fluid_note_cache_entry_t *entries;
+    int entry_count;
+    fluid_note_cache_chunk_t *chunks;
+    fluid_note_cache_chunk_t *free_chunks;
+    int max_entry_blocks;           /* count of blocks an entry records at most */
+    unsigned int clock;             /* incremented whenever an entry is started */
+    unsigned int hits;              /* count of the voices played back */
+};
+
+/**
+ * Create a cache of rendered notes.
+ * @param size the memory to use in bytes, the entries included
+ */
+fluid_note_cache_t *
+new_fluid_note_cache(unsigned int size)
+{
+    fluid_note_cache_t *cache;
+    int i, chunk_count;
+
+    cache = FLUID_NEW(fluid_note_cache_t);
+
+    if(cache == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(cache, 0, sizeof(*cache));
+    cache->entry_count = size / (sizeof(fluid_note_cache_entry_t)
+                                 + FLUID_NOTE_CACHE_ENTRY_CHUNKS * sizeof(fluid_note_cache_chunk_t));
+
+    if(cache->entry_count < 1)
+    {
+        cache->entry_count = 1;
+    }
+
+    /* a recording may take up a quarter of the chunks */
+    chunk_count = cache->entry_count * FLUID_NOTE_CACHE_ENTRY_CHUNKS;
+    cache->max_entry_blocks = cache->entry_count * FLUID_NOTE_CACHE_CHUNK_BLOCKS;
+
+    cache->entries = FLUID_ARRAY(fluid_note_cache_entry_t, cache->entry_count);
+    cache->chunks = FLUID_ARRAY(fluid_note_cache_chunk_t, chunk_count);
+
+    if(cache->entries == NULL || cache->chunks == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_note_cache(cache);
+        return NULL;
+    }
+
+    FLUID_MEMSET(cache->entries, 0, cache->entry_count * sizeof(*cache->entries));
+
+    for(i = 0; i < chunk_count; i++)
+    {
+        cache->chunks[i].next = (i + 1 < chunk_count) ? &cache->chunks[i + 1] : NULL;
+    }
+
+    cache->free_chunks = cache->chunks;
+
+    FLUID_LOG(FLUID_DBG, "Note cache of %d notes of up to %d blocks", cache->entry_count, cache->max_entry_blocks);
+
+    return cache;
+}
+
+void
+delete_fluid_note_cache(fluid_note_cache_t *cache)
+{
+    fluid_return_if_fail(cache != NULL);
+
+    FLUID_FREE(cache->entries);
+    FLUID_FREE(cache->chunks);
+    FLUID_FREE(cache);
+}
+
+/* The states are copied and compared byte by byte, including the padding, which
+ * is only ever copied along, so that a copy compares as equal to the original. */
+static FLUID_INLINE void
+fluid_note_cache_save_state(fluid_note_cache_state_t *state, const fluid_rvoice_t *voice)
+{
+    FLUID_MEMCPY(&state->dsp, &voice->dsp, sizeof(state->dsp));
+    FLUID_MEMCPY(&state->resonant_filter, &voice->resonant_filter, sizeof(state->resonant_filter));
+    FLUID_MEMCPY(&state->resonant_custom_filter, &voice->resonant_custom_filter, sizeof(state->resonant_custom_filter));
+    FLUID_MEMCPY(&state->envlfo, &voice->envlfo, sizeof(state->envlfo));
+}
+
+static FLUID_INLINE void
+fluid_note_cache_load_state(fluid_rvoice_t *voice, const fluid_note_cache_state_t *state)
+{
+    FLUID_MEMCPY(&voice->dsp, &state->dsp, sizeof(state->dsp));
+    FLUID_MEMCPY(&voice->resonant_filter, &state->resonant_filter, sizeof(state->resonant_filter));
+    FLUID_MEMCPY(&voice->resonant_custom_filter, &state->resonant_custom_filter, sizeof(state->resonant_custom_filter));
+    FLUID_MEMCPY(&voice->envlfo, &state->envlfo, sizeof(state->envlfo));
+}
+
+static FLUID_INLINE int
+fluid_note_cache_state_equals(const fluid_note_cache_state_t *state, const fluid_rvoice_t *voice)
+{
+    return FLUID_MEMCMP(&state->dsp, &voice->dsp, sizeof(state->dsp)) == 0
+           && FLUID_MEMCMP(&state->envlfo, &voice->envlfo, sizeof(state->envlfo)) == 0
+           && FLUID_MEMCMP(&state->resonant_filter, &voice->resonant_filter, sizeof(state->resonant_filter)) == 0
+           && FLUID_MEMCMP(&state->resonant_custom_filter, &voice->resonant_custom_filter,
+                           sizeof(state->resonant_custom_filter)) == 0;
+}
+
+/* Give the chunks of an entry back and make it available */
+static void
+fluid_note_cache_free_entry(fluid_note_cache_t *cache, fluid_note_cache_entry_t *entry)
+{
+    if(entry->last_chunk != NULL)
+    {
+        entry->last_chunk->next = cache->free_chunks;
+        cache->free_chunks = entry->chunks;
+    }
+
+    entry->chunks = entry->last_chunk = NULL;
+    entry->used = FALSE;
+}
+
+/* Free the least recently used entry, which no voice uses, and return it, or NULL if there is none */
+static fluid_note_cache_entry_t *
+fluid_note_cache_evict(fluid_note_cache_t *cache)
+{
+    fluid_note_cache_entry_t *oldest = NULL;
+    int i;
+
+    for(i = 0; i < cache->entry_count; i++)
+    {
+        fluid_note_cache_entry_t *entry = &cache->entries[i];
+
+        if(entry->used && entry->users == 0
+                && (oldest == NULL || (int)(entry->last_use - oldest->last_use) < 0))
+        {
+            oldest = entry;
+        }
+    }
+
+    if(oldest != NULL)
+    {
+        fluid_note_cache_free_entry(cache, oldest);
+    }
+
+    return oldest;
+}
+
+/**
+ * Let a voice added to the mixer play a recorded note back if its state matches,
+ * or record its output otherwise. Looped voices, which last until their noteoff,
+ * and stereo pairs, which are rendered together, are left alone.
+ */
+void
+fluid_note_cache_start(fluid_note_cache_t *cache, fluid_rvoice_t *voice)
+{
+    fluid_sample_t *sample = voice->dsp.sample;
+    fluid_note_cache_entry_t *entry = NULL;
+    int i;
+
+    voice->note_cache = NULL;
+    voice->note_cache_chunk = NULL;
+    voice->note_cache_block = 0;
+    voice->note_cache_mode = FLUID_NOTE_CACHE_OFF;
+
+    if(sample == NULL || voice->dsp.samplemode != FLUID_UNLOOPED
+            || voice->stereo_follower != NULL || voice->stereo_leader != NULL)
+    {
+        return;
+    }
+
+    for(i = 0; i < cache->entry_count; i++)
+    {
+        fluid_note_cache_entry_t *e = &cache->entries[i];
+
+        if(!e->used)
+        {
+            entry = (entry == NULL) ? e : entry;
+            continue;
+        }
+
+        if(e->stale || e->start.dsp.sample != sample || e->data != sample->data
+                || !fluid_note_cache_state_equals(&e->start, voice))
+        {
+            continue;
+        }
+
+        if(e->recording || e->block_count == 0)
+        {
+            /* still being recorded by another voice, or nothing to play */
+            return;
+        }
+
+        e->users++;
+        e->last_use = ++cache->clock;
+        cache->hits++;
+
+        voice->note_cache = e;
+        voice->note_cache_mode = FLUID_NOTE_CACHE_PLAY;
+        return;
+    }
+
+    if(entry == NULL)
+    {
+        entry = fluid_note_cache_evict(cache);
+
+        if(entry == NULL)
+        {
+            return;
+        }
+    }
+
+    fluid_note_cache_save_state(&entry->start, voice);
+    entry->data = sample->data;
+    entry->block_count = 0;
+    entry->capacity = 0;
+    entry->used = TRUE;
+    entry->recording = TRUE;
+    entry->stale = FALSE;
+    entry->users = 1;
+    entry->last_use = ++cache->clock;
+
+    voice->note_cache = entry;
+    voice->note_cache_mode = FLUID_NOTE_CACHE_RECORD;
+}
+
+/**
+ * Detach a finished voice from its entry. A recording ends with it.
+ */
+void
+fluid_note_cache_release(fluid_note_cache_t *cache, fluid_rvoice_t *voice)
+{
+    fluid_note_cache_entry_t *entry = voice->note_cache;
+
+    if(entry == NULL)
+    {
+        return;
+    }
+
+    if(voice->note_cache_mode == FLUID_NOTE_CACHE_RECORD)
+    {
+        entry->recording = FALSE;
+    }
+
+    entry->users--;
+
+    if(entry->users == 0 && (entry->stale || entry->block_count == 0))
+    {
+        fluid_note_cache_free_entry(cache, entry);
+    }
+
+    voice->note_cache = NULL;
+    voice->note_cache_mode = FLUID_NOTE_CACHE_OFF;
+}
+
+/**
+ * Make room for the recordings to grow by the blocks rendered next, before any
+ * of them is rendered. Recordings, which can't grow, end once they are full.
+ */
+void
+fluid_note_cache_reserve(fluid_note_cache_t *cache, int blockcount)
+{
+    int i;
+
+    for(i = 0; i < cache->entry_count; i++)
+    {
+        fluid_note_cache_entry_t *entry = &cache->entries[i];
+
+        if(!entry->used || !entry->recording)
+        {
+            continue;
+        }
+
+        while(entry->capacity < entry->block_count + blockcount && entry->capacity < cache->max_entry_blocks)
+        {
+            fluid_note_cache_chunk_t *chunk = cache->free_chunks;
+
+            if(chunk == NULL && fluid_note_cache_evict(cache) != NULL)
+            {
+                chunk = cache->free_chunks;
+            }
+
+            if(chunk == NULL)
+            {
+                break;
+            }
+
+            cache->free_chunks = chunk->next;
+            chunk->next = NULL;
+
+            if(entry->last_chunk == NULL)
+            {
+                entry->chunks = chunk;
+            }
+            else
+            {
+                entry->last_chunk->next = chunk;
+            }
+
+            entry->last_chunk = chunk;
+            entry->capacity += FLUID_NOTE_CACHE_CHUNK_BLOCKS;
+        }
+    }
+}
+
+/**
+ * Forget all recordings, e.g. before the samples they have been recorded from are freed.
+ * The entries still in use are freed once released.
+ */
+void
+fluid_note_cache_clear(fluid_note_cache_t *cache)
+{
+    int i;
+
+    for(i = 0; i < cache->entry_count; i++)
+    {
+        fluid_note_cache_entry_t *entry = &cache->entries[i];
+
+        if(entry->used && entry->users == 0)
+        {
+            fluid_note_cache_free_entry(cache, entry);
+        }
+        else
+        {
+            entry->stale = TRUE;
+        }
+    }
+}
+
+/**
+ * @return the count of voices, which have been started playing a recorded note back
+ */
+unsigned int
+fluid_note_cache_get_hits(const fluid_note_cache_t *cache)
+{
+    return cache->hits;
+}
+
+/**
+ * @return the bytes of the cache, its entries and all of its chunks, allocated up front
+ */
+size_t
+fluid_note_cache_get_size(const fluid_note_cache_t *cache)
+{
+    return sizeof(*cache) + cache->entry_count * (sizeof(fluid_note_cache_entry_t)
+            + FLUID_NOTE_CACHE_ENTRY_CHUNKS * sizeof(fluid_note_cache_chunk_t));
+}
+
+/* From now on, the voice renders on its own, starting from its current state */
+static int
+fluid_note_cache_leave(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+{
+    if(voice->note_cache_mode == FLUID_NOTE_CACHE_RECORD)
+    {
+        voice->note_cache->recording = FALSE;
+    }
+
+    voice->note_cache_mode = FLUID_NOTE_CACHE_OFF;
+
+    return fluid_rvoice_write(voice, dsp_buf);
+}
+
+/**
+ * Synthesize a voice started by fluid_note_cache_start() to a buffer, as
+ * fluid_rvoice_write() does. The voice plays the next recorded block back, or
+ * records the block it renders, as long as its state is the one the recording
+ * has been left in by the previous block.
+ */
+int
+fluid_note_cache_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+{
+    fluid_note_cache_entry_t *entry = voice->note_cache;
+    fluid_note_cache_chunk_t *chunk = voice->note_cache_chunk;
+    fluid_note_cache_block_t *block;
+    int k = voice->note_cache_block, i = k % FLUID_NOTE_CACHE_CHUNK_BLOCKS;
+    int count;
+
+    if(voice->note_cache_mode == FLUID_NOTE_CACHE_OFF)
+    {
+        return fluid_rvoice_write(voice, dsp_buf);
+    }
+
+    /* an event has changed the voice since the previous block */
+    if(!fluid_note_cache_state_equals((k == 0) ? &entry->start : &chunk->blocks[(k - 1) % FLUID_NOTE_CACHE_CHUNK_BLOCKS].state,
+                                      voice))
+    {
+        return fluid_note_cache_leave(voice, dsp_buf);
+    }
+
+    if(k >= ((voice->note_cache_mode == FLUID_NOTE_CACHE_PLAY) ? entry->block_count : entry->capacity))
+    {
+        return fluid_note_cache_leave(voice, dsp_buf);
+    }
+
+    if(i == 0)
+    {
+        chunk = (k == 0) ? entry->chunks : chunk->next;
+    }
+
+    block = &chunk->blocks[i];
+    voice->note_cache_chunk = chunk;
+    voice->note_cache_block++;
+
+    if(voice->note_cache_mode == FLUID_NOTE_CACHE_PLAY)
+    {
+        if(block->count > 0)
+        {
+            FLUID_MEMCPY(dsp_buf, block->buf, block->count * sizeof(*dsp_buf));
+        }
+
+        fluid_note_cache_load_state(voice, &block->state);
+        return block->count;
+    }
+
+    count = fluid_rvoice_write(voice, dsp_buf);
+
+    if(count > 0)
+    {
+        FLUID_MEMCPY(block->buf, dsp_buf, count * sizeof(*dsp_buf));
+    }
+
+    block->count = count;
+    fluid_note_cache_save_state(&block->state, voice);
+    entry->block_count = k + 1;
+
+    /* the voice has finished */
+    if(count >= 0 && count < FLUID_BUFSIZE)
+    {
+        entry->recording = FALSE;
+    }
+
+    return count;
+}
@@ -0,0 +1,65 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+
+#ifndef _FLUID_NOTE_CACHE_H
+#define _FLUID_NOTE_CACHE_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_rvoice.h"
+
+/*
+ * Cache of the rendered notes of unlooped voices, see synth.note-cache-size.
+ *
+ * The output of a voice before panning and the effects sends only depends on
+ * its state: its dsp parameters, filters, envelopes and LFOs. The first voice
+ * starting in a state records its output block by block, along with its state
+ * after each block. Later voices starting in the same state copy the recorded
+ * blocks instead of rendering them, and take over the recorded state after
+ * each one. A voice whose state no longer matches the recording, e.g. after a
+ * noteoff or a controller change, continues to render on its own from there.
+ *
+ * Entries are looked up and released while the events and the finished voices
+ * are processed, their blocks are only written by the voice recording them and
+ * only read by others once the recording is over. So the voices can be
+ * rendered by several threads.
+ */
+typedef struct _fluid_note_cache_t fluid_note_cache_t;
+
+enum fluid_note_cache_mode
+{
+    FLUID_NOTE_CACHE_OFF = 0,       /**< The voice renders on its own */
+    FLUID_NOTE_CACHE_RECORD,        /**< The voice renders and records its output */
+    FLUID_NOTE_CACHE_PLAY           /**< The voice plays a recorded output back */
+};
+
+fluid_note_cache_t *new_fluid_note_cache(unsigned int size);
+void delete_fluid_note_cache(fluid_note_cache_t *cache);
+
+void fluid_note_cache_start(fluid_note_cache_t *cache, fluid_rvoice_t *voice);
+void fluid_note_cache_release(fluid_note_cache_t *cache, fluid_rvoice_t *voice);
+void fluid_note_cache_reserve(fluid_note_cache_t *cache, int blockcount);
+void fluid_note_cache_clear(fluid_note_cache_t *cache);
+unsigned int fluid_note_cache_get_hits(const fluid_note_cache_t *cache);
+size_t fluid_note_cache_get_size(const fluid_note_cache_t *cache);
+
+int fluid_note_cache_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
+
+#endif
@@ -26,9 +26,13 @@
  *  phase
  */
 
-#define FLUID_INTERP_BITS        8
-#define FLUID_INTERP_BITS_MASK   0xff000000
-#define FLUID_INTERP_BITS_SHIFT  24
+#include "fluid_rvoice_dsp_tables.h"
+
+#define FLUID_INTERP_BITS_SHIFT  (32 - FLUID_INTERP_BITS)
+#define FLUID_INTERP_BITS_MASK   ((uint32_t)(FLUID_INTERP_MAX - 1) << FLUID_INTERP_BITS_SHIFT)
+
+#define FLUID_SINC_INTERP_BITS_SHIFT  (32 - FLUID_SINC_INTERP_BITS)
+#define FLUID_SINC_INTERP_BITS_MASK   ((uint32_t)(FLUID_SINC_INTERP_MAX - 1) << FLUID_SINC_INTERP_BITS_SHIFT)
 
 
 #define FLUID_FRACT_MAX ((double)4294967296.0)
@@ -88,6 +92,10 @@ typedef uint64_t fluid_phase_t;
 #define fluid_phase_fract_to_tablerow(_x) \
   ((unsigned int)(fluid_phase_fract(_x) & FLUID_INTERP_BITS_MASK) >> FLUID_INTERP_BITS_SHIFT)
 
+/* The same for the 7th order interpolation table, which may have a different resolution */
+#define fluid_phase_fract_to_sincrow(_x) \
+  ((unsigned int)(fluid_phase_fract(_x) & FLUID_SINC_INTERP_BITS_MASK) >> FLUID_SINC_INTERP_BITS_SHIFT)
+
 #define fluid_phase_double(_x) \
   ((double)(fluid_phase_index(_x)) + ((double)fluid_phase_fract(_x) / FLUID_FRACT_MAX))
 
@@ -281,6 +281,21 @@ a flatter response on comb filter. So the input gain is set to 0.1 rather 1.0. *
 /* phase offset between modulators waveform */
 #define MOD_PHASE  (360.0f/(float) NBR_DELAYS)
 
+/*-- Decimation related settings ----------------------------------
+ The feedback delay network may run at a half or a quarter of the sample
+ rate (see fluid_revmodel_set_decimation()), as little of its damped tail
+ is above that Nyquist frequency. The tone corrected input is decimated by
+ one or two stages of half band FIR filters, the output of the network
+ interpolated back to the sample rate by the same stages. Every other tap
+ of a half band filter but the center one is 0, so in its polyphase form
+ one branch is a mere delay and the other one has 2 * HALFBAND_TAPS taps,
+ HALFBAND_TAPS different ones as the filter is symmetric.
+*/
+#define MAX_DECIMATION 4
+#define DECIMATION_STAGES 2     /* log2(MAX_DECIMATION) */
+#define HALFBAND_TAPS 4
+#define HALFBAND_SIZE (4 * HALFBAND_TAPS - 1) /* length of the filter */
+
 #if (NBR_DELAYS == 8)
     #define DELAY_L0 601
     #define DELAY_L1 691
@@ -324,83 +339,22 @@ a flatter response on comb filter. So the input gain is set to 0.1 rather 1.0. *
 -----------------------------------------------------------------------------*/
 
 
-/*-----------------------------------------------------------------------------
- Delay absorbent low pass filter
------------------------------------------------------------------------------*/
-typedef struct
-{
-    fluid_real_t buffer;
-    fluid_real_t b0, a1;         /* filter coefficients */
-} fdn_delay_lpf;
-
-/*-----------------------------------------------------------------------------
- Sets coefficients for delay absorbent low pass filter.
- @param lpf pointer on low pass filter structure.
- @param b0,a1 coefficients.
------------------------------------------------------------------------------*/
-static void set_fdn_delay_lpf(fdn_delay_lpf *lpf,
-                              fluid_real_t b0, fluid_real_t  a1)
-{
-    lpf->b0 = b0;
-    lpf->a1 = a1;
-}
-
-/*-----------------------------------------------------------------------------
- Process delay absorbent low pass filter.
- @param mod_delay modulated delay line.
- @param in, input sample.
- @param out output sample.
------------------------------------------------------------------------------*/
-/* process low pass damping filter (input, output, delay) */
-#define process_damping_filter(in,out,mod_delay) \
-{\
-    out = in * mod_delay->dl.damping.b0 - mod_delay->dl.damping.buffer * \
-                                            mod_delay->dl.damping.a1;\
-    mod_delay->dl.damping.buffer = out;\
-}\
-
-
 /*-----------------------------------------------------------------------------
  Delay line :
  The delay line is composed of the line plus an absorbent low pass filter
  to get frequency dependant reverb time.
+ The samples of the line and the low pass filter are kept by the late
+ structure, interleaved with the ones of the other lines (see fluid_late).
 -----------------------------------------------------------------------------*/
 typedef struct
 {
-    fluid_real_t *line; /* buffer line */
     int   size;    /* effective internal size (in samples) */
     /*-------------*/
     int line_in;  /* line in position */
     int line_out; /* line out position */
-    /*-------------*/
-    fdn_delay_lpf damping; /* damping low pass filter */
 } delay_line;
 
 
-/*-----------------------------------------------------------------------------
- Clears a delay line to DC_OFFSET float value.
- @param dl pointer on delay line structure
------------------------------------------------------------------------------*/
-static void clear_delay_line(delay_line *dl)
-{
-    int i;
-
-    for(i = 0; i < dl->size; i++)
-    {
-        dl->line[i] = DC_OFFSET;
-    }
-}
-
-/*-----------------------------------------------------------------------------
- Push a sample val into the delay line
------------------------------------------------------------------------------*/
-#define push_in_delay_line(dl, val) \
-{\
-    dl->line[dl->line_in] = val;\
-    /* Incrementation and circular motion if necessary */\
-    if(++dl->line_in >= dl->size) dl->line_in -= dl->size;\
-}\
-
 /*-----------------------------------------------------------------------------
  Modulator for modulated delay line
 -----------------------------------------------------------------------------*/
@@ -477,6 +431,8 @@ static FLUID_INLINE fluid_real_t get_mod_sinus(sinus_modulator *mod)
  - center output position modulated by the modulator.
  - variable rate control of center output position.
  - first order All-Pass interpolator.
+ The variable rate control and the state of the interpolator are shared by
+ all lines and kept by the late structure.
 -----------------------------------------------------------------------------*/
 typedef struct
 {
@@ -489,22 +445,13 @@ typedef struct
     /* center output position members */
     fluid_real_t  center_pos_mod; /* center output position modulated by modulator */
     int          mod_depth;   /* modulation depth (in samples) */
-    /*-------------------------*/
-    /* variable rate control of center output position */
-    int index_rate;  /* index rate to know when to update center_pos_mod */
-    int mod_rate;    /* rate at which center_pos_mod is updated */
-    /*-------------------------*/
-    /* first order All-Pass interpolator members */
-    fluid_real_t  frac_pos_mod; /* fractional position part between samples) */
-    /* previous value used when interpolating using fractional */
-    fluid_real_t  buffer;
 } mod_delay_line;
 
 
 /*-----------------------------------------------------------------------------
  Modulated delay line initialization.
 
- Sets the length line ( alloc delay samples).
+ Sets the length line.
  Remark: the function sets the internal size accordling to the length delay_length.
  As the delay line is a modulated line, its internal size is augmented by mod_depth.
  The size is also augmented by INTERP_SAMPLES_NBR to take account of interpolation.
@@ -512,15 +459,11 @@ typedef struct
  @param mdl, pointer on modulated delay line.
  @param delay_length the length of the delay line in samples.
  @param mod_depth depth of the modulation in samples (amplitude of the sine wave).
- @param mod_rate the rate of the modulation in samples.
- @return FLUID_OK if success , FLUID_FAILED if memory error.
-
- Return FLUID_OK if success, FLUID_FAILED if memory error.
+ @return FLUID_OK if success , FLUID_FAILED if the length is invalid.
 -----------------------------------------------------------------------------*/
 static int set_mod_delay_line(mod_delay_line *mdl,
                               int delay_length,
-                              int mod_depth,
-                              int mod_rate
+                              int mod_depth
                              )
 {
     /*-----------------------------------------------------------------------*/
@@ -540,21 +483,12 @@ static int set_mod_delay_line(mod_delay_line *mdl,
 
     mdl->mod_depth = mod_depth;
     /*-----------------------------------------------------------------------
-     allocates delay_line and initialize members:
-       - line, size, line_in, line_out...
+     initialize delay_line members: size, line_in, line_out...
     */
     {
         /* total size of the line:
         size = INTERP_SAMPLES_NBR + mod_depth + delay_length */
         mdl->dl.size = delay_length + mod_depth + INTERP_SAMPLES_NBR;
-        mdl->dl.line = FLUID_ARRAY(fluid_real_t, mdl->dl.size);
-
-        if(! mdl->dl.line)
-        {
-            return FLUID_FAILED;
-        }
-
-        clear_delay_line(&mdl->dl); /* clears the buffer */
 
         /* Initializes line_in to the start of the buffer */
         mdl->dl.line_in = 0;
@@ -564,48 +498,11 @@ static int set_mod_delay_line(mod_delay_line *mdl,
         mdl->dl.line_out = mdl->dl.line_in + INTERP_SAMPLES_NBR;
     }
 
-    /* Damping low pass filter -------------------*/
-    mdl->dl.damping.buffer = 0;
-    /*------------------------------------------------------------------------
-     Initializes modulation members:
-     - modulated center position: center_pos_mod
-     - index rate to know when to update center_pos_mod:index_rate
-     - modulation rate (the speed at which center_pos_mod is modulated: mod_rate
-     - interpolator member: buffer, frac_pos_mod
-     -------------------------------------------------------------------------*/
-    /* Sets the modulation rate. This rate defines how often
-     the  center position (center_pos_mod ) is modulated .
-     The value is expressed in samples. The default value is 1 that means that
-     center_pos_mod is updated at every sample.
-     For example with a value of 2, the center position position will be
-     updated only one time every 2 samples only.
-    */
-    mdl->mod_rate = 1; /* default modulation rate: every one sample */
-
-    if(mod_rate > mdl->dl.size)
-    {
-        FLUID_LOG(FLUID_INFO,
-                  "fdn reverb: modulation rate is out of range");
-    }
-    else
-    {
-        mdl->mod_rate = mod_rate;
-    }
-
     /* Initializes the modulated center position (center_pos_mod) so that:
         - the delay between line_out and center_pos_mod is mod_depth.
         - the delay between center_pos_mod and line_in is delay_length.
      */
     mdl->center_pos_mod = (fluid_real_t) INTERP_SAMPLES_NBR + mod_depth;
-
-    /* index rate to control when to update center_pos_mod */
-    /* Important: must be set to get center_pos_mod immediately used for the
-       reading of first sample (see get_mod_delay()) */
-    mdl->index_rate = mdl->mod_rate;
-
-    /* initializes 1st order All-Pass interpolator members */
-    mdl->buffer = 0;       /* previous delay sample value */
-    mdl->frac_pos_mod = 0; /* fractional position (between consecutives sample) */
     return FLUID_OK;
 }
 
@@ -620,80 +517,79 @@ static int get_mod_delay_line_length(mod_delay_line *mdl)
 }
 
 /*-----------------------------------------------------------------------------
- Reads the sample value out of the modulated delay line.
+ Updates the modulated read position of a delay line. This must be called
+ every mod_rate samples, and first for the reading of the first sample.
+
+ As both line_in and line_out move by one sample at each sample, the distance
+ between them is constant until the next update. So the update gives the
+ delays, behind the input position, of the 2 samples read by the interpolator
+ until the next update.
+
  @param mdl, pointer on modulated delay line.
- @return the sample value.
+ @param mod_rate the rate of the modulation in samples.
+ @param delay0, delay1 return the delays of the current and next sample read.
+ @param frac_pos_mod returns the fractional position between these samples.
 -----------------------------------------------------------------------------*/
-static FLUID_INLINE fluid_real_t get_mod_delay(mod_delay_line *mdl)
+static void update_mod_delay(mod_delay_line *mdl, int mod_rate,
+                             int *delay0, int *delay1, fluid_real_t *frac_pos_mod)
 {
     fluid_real_t out_index;  /* new modulated index position */
     int int_out_index; /* integer part of out_index */
-    fluid_real_t out; /* value to return */
+    int delay;
 
-    /* Checks if the modulator must be updated (every mod_rate samples). */
-    /* Important: center_pos_mod must be used immediately for the
-       first sample. So, mdl->index_rate must be initialized
-       to mdl->mod_rate (set_mod_delay_line())  */
+    /* out_index = center position (center_pos_mod) + sinus waweform */
+    out_index = mdl->center_pos_mod +
+                get_mod_sinus(&mdl->mod) * mdl->mod_depth;
 
-    if(++mdl->index_rate >= mdl->mod_rate)
+    /* extracts integer part in int_out_index */
+    if(out_index >= 0.0f)
     {
-        mdl->index_rate = 0;
-
-        /* out_index = center position (center_pos_mod) + sinus waweform */
-        out_index = mdl->center_pos_mod +
-                    get_mod_sinus(&mdl->mod) * mdl->mod_depth;
+        int_out_index = (int)out_index; /* current integer part */
 
-        /* extracts integer part in int_out_index */
-        if(out_index >= 0.0f)
-        {
-            int_out_index = (int)out_index; /* current integer part */
-
-            /* forces read index (line_out)  with integer modulation value  */
-            /* Boundary check and circular motion as needed */
-            if((mdl->dl.line_out = int_out_index) >= mdl->dl.size)
-            {
-                mdl->dl.line_out -= mdl->dl.size;
-            }
-        }
-        else /* negative */
+        /* forces read index (line_out)  with integer modulation value  */
+        /* Boundary check and circular motion as needed */
+        if((mdl->dl.line_out = int_out_index) >= mdl->dl.size)
         {
-            int_out_index = (int)(out_index - 1); /* previous integer part */
-            /* forces read index (line_out) with integer modulation value  */
-            /* circular motion as needed */
-            mdl->dl.line_out   = int_out_index + mdl->dl.size;
+            mdl->dl.line_out -= mdl->dl.size;
         }
+    }
+    else /* negative */
+    {
+        int_out_index = (int)(out_index - 1); /* previous integer part */
+        /* forces read index (line_out) with integer modulation value  */
+        /* circular motion as needed */
+        mdl->dl.line_out   = int_out_index + mdl->dl.size;
+    }
 
-        /* extracts fractionnal part. (it will be used when interpolating
-          between line_out and line_out +1) and memorize it.
-          Memorizing is necessary for modulation rate above 1 */
-        mdl->frac_pos_mod = out_index - int_out_index;
+    /* extracts fractionnal part. (it will be used when interpolating
+      between line_out and line_out +1) and memorize it.
+      Memorizing is necessary for modulation rate above 1 */
+    *frac_pos_mod = out_index - int_out_index;
 
-        /* updates center position (center_pos_mod) to the next position
-           specified by modulation rate */
-        if((mdl->center_pos_mod += mdl->mod_rate) >= mdl->dl.size)
-        {
-            mdl->center_pos_mod -= mdl->dl.size;
-        }
+    /* updates center position (center_pos_mod) to the next position
+       specified by modulation rate */
+    if((mdl->center_pos_mod += mod_rate) >= mdl->dl.size)
+    {
+        mdl->center_pos_mod -= mdl->dl.size;
     }
 
-    /*  First order all-pass interpolation ----------------------------------*/
-    /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
-    /*  begins interpolation: read current sample */
-    out = mdl->dl.line[mdl->dl.line_out];
+    /* line_out holds the sample written delay samples ago, if line_out is
+       line_in, the one written dl.size samples ago */
+    delay = mdl->dl.line_in - mdl->dl.line_out;
 
-    /* updates line_out to the next sample.
-       Boundary check and circular motion as needed */
-    if(++mdl->dl.line_out >= mdl->dl.size)
+    if(delay <= 0)
     {
-        mdl->dl.line_out -= mdl->dl.size;
+        delay += mdl->dl.size;
     }
 
-    /* Fractional interpolation between next sample (at next position) and
-       previous output added to current sample.
-    */
-    out += mdl->frac_pos_mod * (mdl->dl.line[mdl->dl.line_out] - mdl->buffer);
-    mdl->buffer = out; /* memorizes current output */
-    return out;
+    *delay0 = delay;
+    *delay1 = (delay > 1) ? delay - 1 : mdl->dl.size;
+
+    /* line_in at the next update */
+    if((mdl->dl.line_in += mod_rate) >= mdl->dl.size)
+    {
+        mdl->dl.line_in -= mdl->dl.size;
+    }
 }
 
 /*-----------------------------------------------------------------------------
@@ -702,18 +598,295 @@ static FLUID_INLINE fluid_real_t get_mod_delay(mod_delay_line *mdl)
 struct _fluid_late
 {
     fluid_real_t samplerate;       /* sample rate */
+    int decimation;                /* the sample rate of the reverb output divided by samplerate:
+                                      1 (full rate), 2 or 4, see fluid_revmodel_set_decimation() */
     /*----- High pass tone corrector -------------------------------------*/
     fluid_real_t tone_buffer;
     fluid_real_t b1, b2;
     /*----- Modulated delay lines lines ----------------------------------*/
     mod_delay_line mod_delay_lines[NBR_DELAYS];
     /*-----------------------------------------------------------------------*/
+    /* The samples of all delay lines are kept one line after the other in one
+       buffer: sample at position p of line i is lines[i * lines_size + p].
+       All lines have the size of the longest one and are written at the same
+       position line_in, each line being read at its own delay behind line_in.
+       This way, one position is shared by all lines, which are processed in
+       parallel, while each line is still read from consecutive samples. */
+    fluid_real_t *lines;
+    int lines_size;   /* number of positions in each line */
+    int line_in;      /* line in position */
+    /*-------------------------*/
+    /* variable rate control of center output position */
+    int index_rate;  /* index rate to know when to update center_pos_mod */
+    int mod_rate;    /* rate at which center_pos_mod is updated */
+    /*-------------------------*/
+    /* state of each line, laid out to process all lines at once */
+    int delay0[NBR_DELAYS];              /* delay of the current sample read */
+    int delay1[NBR_DELAYS];              /* delay of the next sample read */
+    /* first order All-Pass interpolator members */
+    fluid_real_t frac_pos_mod[NBR_DELAYS]; /* fractional position part between samples) */
+    /* previous value used when interpolating using fractional */
+    fluid_real_t interp_buffer[NBR_DELAYS];
+    /* Delay absorbent low pass filter */
+    fluid_real_t damping_b0[NBR_DELAYS];
+    fluid_real_t damping_a1[NBR_DELAYS]; /* filter coefficients */
+    fluid_real_t damping_buffer[NBR_DELAYS];
+    /*-----------------------------------------------------------------------*/
     /* Output coefficients for separate Left and right stereo outputs */
     fluid_real_t out_left_gain[NBR_DELAYS]; /* Left delay lines' output gains */
     fluid_real_t out_right_gain[NBR_DELAYS];/* Right delay lines' output gains*/
 };
 
 typedef struct _fluid_late   fluid_late;
+
+/*-----------------------------------------------------------------------------
+ Clears the delay lines to DC_OFFSET float value.
+ @param late pointer on late structure
+-----------------------------------------------------------------------------*/
+static void clear_delay_lines(fluid_late *late)
+{
+    int i;
+
+    for(i = 0; i < late->lines_size * NBR_DELAYS; i++)
+    {
+        late->lines[i] = DC_OFFSET;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ Processes one sample through the feedback delay network, all lines at once.
+ @param late pointer on late structure.
+ @param xn input sample.
+ @param out_left, out_right return the stereo output.
+-----------------------------------------------------------------------------*/
+static FLUID_INLINE void process_fdn(fluid_late *late, fluid_real_t xn,
+                                     fluid_real_t *out_left, fluid_real_t *out_right)
+{
+    int i;
+    fluid_real_t left = 0, right = 0;   /* output stereo Left  and Right  */
+    fluid_real_t matrix_factor = 0;     /* partial matrix computation */
+    fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
+    fluid_real_t next_out[NBR_DELAYS];  /* next sample of the lines, for interpolation */
+    fluid_real_t *line_in;
+
+    /* Checks if the modulators must be updated (every mod_rate samples). */
+    /* Important: the modulators must be used immediately for the
+       first sample. So, index_rate must be initialized
+       to mod_rate (create_mod_delay_lines())  */
+    if(++late->index_rate >= late->mod_rate)
+    {
+        late->index_rate = 0;
+
+        for(i = 0; i < NBR_DELAYS; i++)
+        {
+            update_mod_delay(&late->mod_delay_lines[i], late->mod_rate,
+                             &late->delay0[i], &late->delay1[i], &late->frac_pos_mod[i]);
+        }
+    }
+
+    /*--------------------------------------------------------------------
+     process  feedback delayed network:
+      - xn is the input signal.
+      - before inserting in the line input we first we get the delay lines
+        output, filter them and compute output in delay_out[].
+      - also matrix_factor is computed (to simplify further matrix product)
+    ---------------------------------------------------------------------*/
+    /* We begin with the modulated output delay line + damping filter.
+       The samples of each line are read first, as reading them at different
+       delays doesn't vectorize well. */
+    for(i = 0; i < NBR_DELAYS; i++)
+    {
+        int pos0 = late->line_in - late->delay0[i];
+        int pos1 = late->line_in - late->delay1[i];
+
+        pos0 += (pos0 < 0) ? late->lines_size : 0;
+        pos1 += (pos1 < 0) ? late->lines_size : 0;
+
+        delay_out[i] = late->lines[i * late->lines_size + pos0];
+        next_out[i] = late->lines[i * late->lines_size + pos1];
+    }
+
+    #pragma omp simd reduction(+:matrix_factor,left,right)
+    for(i = 0; i < NBR_DELAYS; i++)
+    {
+        fluid_real_t out;
+
+        /*  First order all-pass interpolation ------------------------------*/
+        /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
+        /* Fractional interpolation between next sample and
+           previous output added to current sample. */
+        out = delay_out[i] + late->frac_pos_mod[i] * (next_out[i] - late->interp_buffer[i]);
+        late->interp_buffer[i] = out; /* memorizes current output */
+
+        /* process low pass damping filter */
+        out = out * late->damping_b0[i] - late->damping_buffer[i] * late->damping_a1[i];
+        late->damping_buffer[i] = out;
+
+        /* Result in delay_out[], and matrix_factor.
+           These will be of use later during input line process */
+        delay_out[i] = out;   /* result in delay_out[] */
+        matrix_factor += out; /* result in matrix_factor */
+
+        /* Process stereo output */
+        /* stereo left = left + out_left_gain * delay_out */
+        left += late->out_left_gain[i] * out;
+        /* stereo right= right+ out_right_gain * delay_out */
+        right += late->out_right_gain[i] * out;
+    }
+
+    /* now we process the input delay line.Each input is a combination of
+       - xn: input signal
+       - delay_out[] the output of a delay line given by a permutation matrix P
+       - and matrix_factor.
+      This computes: in_delay_line = xn + (delay_out[] * matrix A) with
+      an algorithm equivalent but faster than using a product with matrix A.
+    */
+    /* matrix_factor = output sum * (-2.0)/N  */
+    matrix_factor *= FDN_MATRIX_FACTOR;
+    matrix_factor += xn; /* adds reverb input signal */
+
+    line_in = &late->lines[late->line_in];
+
+    for(i = 1; i < NBR_DELAYS; i++)
+    {
+        /* delay_in[i-1] = delay_out[i] + matrix_factor */
+        line_in[(i - 1) * late->lines_size] = delay_out[i] + matrix_factor;
+    }
+
+    /* last line input (NB_DELAY-1) */
+    /* delay_in[0] = delay_out[NB_DELAY -1] + matrix_factor */
+    line_in[(NBR_DELAYS - 1) * late->lines_size] = delay_out[0] + matrix_factor;
+
+    /* Incrementation and circular motion if necessary */
+    if(++late->line_in >= late->lines_size)
+    {
+        late->line_in = 0;
+    }
+
+    *out_left = left;
+    *out_right = right;
+}
+
+/*-----------------------------------------------------------------------------
+ Half band stage: halves the rate of the fdn input, and doubles the one of its
+ output (see fluid_revmodel_set_decimation()). The filters keep the last
+ inputs from the previous block.
+-----------------------------------------------------------------------------*/
+typedef struct
+{
+    fluid_real_t dec_hist[HALFBAND_SIZE - 1];            /* mono input */
+    fluid_real_t interp_left[2 * HALFBAND_TAPS - 1];     /* stereo output */
+    fluid_real_t interp_right[2 * HALFBAND_TAPS - 1];
+} fluid_halfband_stage;
+
+/* The coefficients on one side of the center of the half band filter, from
+   the center out, the ones in between being 0 and the center one 0.5 */
+static fluid_real_t halfband_coeffs[HALFBAND_TAPS];
+
+/*-----------------------------------------------------------------------------
+ Designs the half band filter: a windowed sinc cut at a quarter of the rate,
+ normalized to a DC gain of 1.
+-----------------------------------------------------------------------------*/
+static void fluid_halfband_init(void)
+{
+    double sum = 0;
+    int j;
+
+    for(j = 0; j < HALFBAND_TAPS; j++)
+    {
+        int d = 2 * j + 1; /* from the center */
+        double x = 2 * M_PI * (HALFBAND_SIZE / 2 + d + 1) / (HALFBAND_SIZE + 1);
+        double w = 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x); /* Blackman window */
+
+        halfband_coeffs[j] = (fluid_real_t)(sin(M_PI * d / 2) / (M_PI * d) * w);
+        sum += halfband_coeffs[j];
+    }
+
+    /* 0.5 + 2 * sum = 1 */
+    for(j = 0; j < HALFBAND_TAPS; j++)
+    {
+        halfband_coeffs[j] = (fluid_real_t)(halfband_coeffs[j] * 0.25 / sum);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ Low pass filters and decimates by 2.
+ @param stage the half band stage.
+ @param in input, 2 * count samples.
+ @param out output, count samples.
+-----------------------------------------------------------------------------*/
+static void fluid_halfband_decimate(fluid_halfband_stage *stage, const fluid_real_t *in,
+                                    fluid_real_t *out, int count)
+{
+    fluid_real_t x[HALFBAND_SIZE - 1 + FLUID_BUFSIZE];
+    int j, m;
+
+    FLUID_MEMCPY(x, stage->dec_hist, sizeof(stage->dec_hist));
+    FLUID_MEMCPY(&x[HALFBAND_SIZE - 1], in, 2 * count * sizeof(fluid_real_t));
+
+    for(m = 0; m < count; m++)
+    {
+        /* the center of the filter ending at the second input of the pair */
+        const fluid_real_t *c = &x[2 * m + 2 * HALFBAND_TAPS];
+        fluid_real_t y = 0.5f * c[0];
+
+        for(j = 0; j < HALFBAND_TAPS; j++)
+        {
+            y += halfband_coeffs[j] * (c[-2 * j - 1] + c[2 * j + 1]);
+        }
+
+        out[m] = y;
+    }
+
+    FLUID_MEMCPY(stage->dec_hist, &x[2 * count], sizeof(stage->dec_hist));
+}
+
+/*-----------------------------------------------------------------------------
+ Interpolates by 2: each input is followed by the one filtered half way to the
+ next input.
+ @param hist the last inputs of the previous block.
+ @param in input, count samples.
+ @param out output, 2 * count samples.
+-----------------------------------------------------------------------------*/
+static void fluid_halfband_interpolate(fluid_real_t *hist, const fluid_real_t *in,
+                                       fluid_real_t *out, int count)
+{
+    fluid_real_t x[2 * HALFBAND_TAPS - 1 + FLUID_BUFSIZE / 2];
+    fluid_real_t half[FLUID_BUFSIZE / 2];
+    int j, m;
+
+    FLUID_MEMCPY(x, hist, (2 * HALFBAND_TAPS - 1) * sizeof(fluid_real_t));
+    FLUID_MEMCPY(&x[2 * HALFBAND_TAPS - 1], in, count * sizeof(fluid_real_t));
+
+    for(m = 0; m < count; m++)
+    {
+        half[m] = 0;
+    }
+
+    /* the branch filtering between the samples, the zeroes inserted by the
+       interpolation making up for the gain of 2 */
+    for(j = 0; j < HALFBAND_TAPS; j++)
+    {
+        fluid_real_t coeff = 2 * halfband_coeffs[j];
+        const fluid_real_t *before = &x[HALFBAND_TAPS - 1 - j];
+        const fluid_real_t *after = &x[HALFBAND_TAPS + j];
+
+        #pragma omp simd
+        for(m = 0; m < count; m++)
+        {
+            half[m] += coeff * (before[m] + after[m]);
+        }
+    }
+
+    for(m = 0; m < count; m++)
+    {
+        out[2 * m] = x[m + HALFBAND_TAPS - 1];
+        out[2 * m + 1] = half[m];
+    }
+
+    FLUID_MEMCPY(hist, &x[count], (2 * HALFBAND_TAPS - 1) * sizeof(fluid_real_t));
+}
+
 /*-----------------------------------------------------------------------------
  fluidsynth reverb structure
 -----------------------------------------------------------------------------*/
@@ -727,6 +900,9 @@ struct _fluid_revmodel_t
 
     /* fdn reverberation structure */
     fluid_late  late;
+
+    /* processing of the fdn at a lower rate, see fluid_revmodel_set_decimation() */
+    fluid_halfband_stage stages[DECIMATION_STAGES];
 };
 
 /*-----------------------------------------------------------------------------
@@ -831,9 +1007,16 @@ static void update_rev_time_damping(fluid_late *late,
         /* iir low pass filter feedback gain */
         ai = (20.f / 80.f) * FLUID_LOGF(gi) * (1.f - 1.f / alpha2);
 
+        /* the same pole at the decimated rate, keeping the damping of the
+           frequencies left as it is at the full rate */
+        if(late->decimation > 1)
+        {
+            ai = FLUID_POW(ai, late->decimation);
+        }
+
         /* b0 = gi * (1 - ai),  a1 = - ai */
-        set_fdn_delay_lpf(&late->mod_delay_lines[i].dl.damping,
-                          gi * (1.f - ai), -ai);
+        late->damping_b0[i] = gi * (1.f - ai);
+        late->damping_a1[i] = -ai;
     }
 }
 
@@ -894,14 +1077,11 @@ static void update_stereo_coefficient(fluid_late *late, fluid_real_t wet1)
 -----------------------------------------------------------------------------*/
 static void delete_fluid_rev_late(fluid_late *late)
 {
-    int i;
     fluid_return_if_fail(late != NULL);
 
     /* free the delay lines */
-    for(i = 0; i < NBR_DELAYS; i++)
-    {
-        FLUID_FREE(late->mod_delay_lines[i].dl.line);
-    }
+    FLUID_FREE(late->lines);
+    late->lines = NULL;
 }
 
 /*-----------------------------------------------------------------------------
@@ -910,7 +1090,7 @@ static void delete_fluid_rev_late(fluid_late *late)
  @param sample_rate, the audio sample rate.
  @return FLUID_OK if success, FLUID_FAILED otherwise.
 -----------------------------------------------------------------------------*/
-static int create_mod_delay_lines(fluid_late *late, fluid_real_t sample_rate)
+static int create_mod_delay_lines(fluid_late *late, fluid_real_t sample_rate, int decimation)
 {
     /* Delay lines length table (in samples) */
     static const int delay_length[NBR_DELAYS] =
@@ -945,12 +1125,16 @@ static int create_mod_delay_lines(fluid_late *late, fluid_real_t sample_rate)
         Modulation depth (mod_depth) is set to nominal value of MOD_DEPTH at sample rate 44100Hz.
         For sample rate > 44100, mod_depth is multiplied by sample_rate / 44100. This ensures
         that the effect of modulated delay line keeps inchanged.
+
+      3)When the network runs at a decimated rate, the lengths and the modulation depth
+        are those of the full rate divided by the decimation, keeping the same delays
+        in seconds.
     */
-    fluid_real_t length_factor = 2.0f;
-    fluid_real_t mod_depth = MOD_DEPTH;
-    if(sample_rate > 44100.0f)
+    fluid_real_t length_factor = 2.0f / decimation;
+    fluid_real_t mod_depth = (fluid_real_t)MOD_DEPTH / decimation;
+    if(sample_rate * decimation > 44100.0f)
     {
-        fluid_real_t sample_rate_factor = sample_rate/44100.0f;
+        fluid_real_t sample_rate_factor = sample_rate * decimation / 44100.0f;
         length_factor *= sample_rate_factor;
         mod_depth *= sample_rate_factor;
     }
@@ -971,18 +1155,30 @@ static int create_mod_delay_lines(fluid_late *late, fluid_real_t sample_rate)
     }
 #endif
 
+    late->lines_size = 0;
+
     for(i = 0; i < NBR_DELAYS; i++) /* for each delay line */
     {
-        /* allocate delay line and set local delay lines's parameters */
+        /* set local delay lines's parameters */
         result = set_mod_delay_line(&late->mod_delay_lines[i],
                                     delay_length[i] * length_factor,
-                                    mod_depth, MOD_RATE);
+                                    mod_depth);
 
         if(result == FLUID_FAILED)
         {
             return FLUID_FAILED;
         }
 
+        if(late->mod_delay_lines[i].dl.size > late->lines_size)
+        {
+            late->lines_size = late->mod_delay_lines[i].dl.size;
+        }
+
+        /* initializes 1st order All-Pass interpolator and damping filter members */
+        late->interp_buffer[i] = 0;  /* previous delay sample value */
+        late->frac_pos_mod[i] = 0;   /* fractional position (between consecutives sample) */
+        late->damping_buffer[i] = 0;
+
         /* Sets local Modulators parameters: frequency and phase
          Each modulateur are shifted of MOD_PHASE degree
         */
@@ -991,6 +1187,42 @@ static int create_mod_delay_lines(fluid_late *late, fluid_real_t sample_rate)
                           late->samplerate,
                           (float)(MOD_PHASE * i));
     }
+
+    /* allocates the interleaved delay lines */
+    late->lines = FLUID_ARRAY(fluid_real_t, late->lines_size * NBR_DELAYS);
+
+    if(late->lines == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    clear_delay_lines(late); /* clears the buffer */
+    late->line_in = 0;
+
+    /* Sets the modulation rate. This rate defines how often
+     the  center position (center_pos_mod ) is modulated .
+     The value is expressed in samples. The default value is 1 that means that
+     center_pos_mod is updated at every sample.
+     For example with a value of 2, the center position position will be
+     updated only one time every 2 samples only.
+    */
+    late->mod_rate = 1; /* default modulation rate: every one sample */
+
+    if(MOD_RATE > late->mod_delay_lines[0].dl.size)
+    {
+        FLUID_LOG(FLUID_INFO,
+                  "fdn reverb: modulation rate is out of range");
+    }
+    else
+    {
+        late->mod_rate = MOD_RATE;
+    }
+
+    /* index rate to control when to update center_pos_mod */
+    /* Important: must be set to get center_pos_mod immediately used for the
+       reading of first sample (see process_fdn()) */
+    late->index_rate = late->mod_rate;
+
     return FLUID_OK;
 }
 
@@ -1000,17 +1232,18 @@ static int create_mod_delay_lines(fluid_late *late, fluid_real_t sample_rate)
  @param sample_rate the sample rate.
  @return FLUID_OK if success, FLUID_FAILED otherwise.
 -----------------------------------------------------------------------------*/
-static int create_fluid_rev_late(fluid_late *late, fluid_real_t sample_rate)
+static int create_fluid_rev_late(fluid_late *late, fluid_real_t sample_rate, int decimation)
 {
     FLUID_MEMSET(late, 0,  sizeof(fluid_late));
 
     late->samplerate = sample_rate;
+    late->decimation = decimation;
 
     /*--------------------------------------------------------------------------
       First initialize the modulated delay lines
     */
 
-    if(create_mod_delay_lines(late, sample_rate) == FLUID_FAILED)
+    if(create_mod_delay_lines(late, sample_rate, decimation) == FLUID_FAILED)
     {
         return FLUID_FAILED;
     }
@@ -1026,13 +1259,32 @@ static int create_fluid_rev_late(fluid_late *late, fluid_real_t sample_rate)
 static void
 fluid_revmodel_init(fluid_revmodel_t *rev)
 {
+    fluid_late *late = &rev->late;
     int i;
 
     /* clears all the delay lines */
-    for(i = 0; i < NBR_DELAYS; i ++)
+    clear_delay_lines(late);
+
+    /* and starts their positions, modulators and filters over, as created */
+    for(i = 0; i < NBR_DELAYS; i++)
     {
-        clear_delay_line(&rev->late.mod_delay_lines[i].dl);
+        mod_delay_line *mdl = &late->mod_delay_lines[i];
+
+        mdl->dl.line_in = 0;
+        mdl->dl.line_out = INTERP_SAMPLES_NBR;
+        mdl->center_pos_mod = (fluid_real_t) INTERP_SAMPLES_NBR + mdl->mod_depth;
+        set_mod_frequency(&mdl->mod, MOD_FREQ * MOD_RATE, late->samplerate, (float)(MOD_PHASE * i));
+
+        late->interp_buffer[i] = 0;
+        late->frac_pos_mod[i] = 0;
+        late->damping_buffer[i] = 0;
     }
+
+    late->tone_buffer = 0.0f;
+    late->line_in = 0;
+    late->index_rate = late->mod_rate;
+
+    FLUID_MEMSET(rev->stages, 0, sizeof(rev->stages));
 }
 
 
@@ -1098,8 +1350,10 @@ new_fluid_revmodel(fluid_real_t sample_rate)
         return NULL;
     }
 
+    FLUID_MEMSET(rev, 0, sizeof(*rev));
+
     /* create fdn reverb */
-    if(create_fluid_rev_late(&rev->late, sample_rate) != FLUID_OK)
+    if(create_fluid_rev_late(&rev->late, sample_rate, 1) != FLUID_OK)
     {
         delete_fluid_revmodel(rev);
         return NULL;
@@ -1129,6 +1383,101 @@ delete_fluid_revmodel(fluid_revmodel_t *rev)
     FLUID_FREE(rev);
 }
 
+/*
+* Gets the memory taken by the reverb.
+* @param rev pointer on reverb.
+* @return bytes of the reverb and of its delay lines.
+*/
+size_t
+fluid_revmodel_get_size(const fluid_revmodel_t *rev)
+{
+    return sizeof(*rev) + (size_t)rev->late.lines_size * NBR_DELAYS * sizeof(fluid_real_t);
+}
+
+/*
+* Saves the state of the reverb: its parameters, its filters and delay lines.
+* @param rev pointer on reverb.
+* @param data fluid_revmodel_get_size() bytes to store the state to.
+*/
+void
+fluid_revmodel_save_state(const fluid_revmodel_t *rev, void *data)
+{
+    FLUID_MEMCPY(data, rev, sizeof(*rev));
+    FLUID_MEMCPY((char *)data + sizeof(*rev), rev->late.lines,
+                 fluid_revmodel_get_size(rev) - sizeof(*rev));
+}
+
+/*
+* Checks that a saved reverb state fits the delay lines and modulators of a
+* reverb, and that its read and write positions lie in these delay lines.
+* @param rev pointer on reverb.
+* @param saved the state to check.
+* @return FLUID_OK if the state can be restored, FLUID_FAILED otherwise.
+*/
+static int
+fluid_revmodel_check_state(const fluid_revmodel_t *rev, const fluid_revmodel_t *saved)
+{
+    const fluid_late *late = &saved->late;
+    int i;
+
+    if(late->samplerate != rev->late.samplerate || late->decimation != rev->late.decimation
+            || late->lines_size != rev->late.lines_size || late->mod_rate != rev->late.mod_rate
+            || late->line_in < 0 || late->line_in >= late->lines_size
+            || late->index_rate < 0 || late->index_rate > late->mod_rate)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < NBR_DELAYS; i++)
+    {
+        const mod_delay_line *mdl = &late->mod_delay_lines[i];
+        const mod_delay_line *own = &rev->late.mod_delay_lines[i];
+
+        if(mdl->dl.size != own->dl.size || mdl->mod_depth != own->mod_depth
+                || mdl->mod.a1 != own->mod.a1 || mdl->mod.reset_buffer2 != own->mod.reset_buffer2
+                || mdl->dl.line_in < 0 || mdl->dl.line_in >= mdl->dl.size
+                || mdl->dl.line_out < 0 || mdl->dl.line_out >= mdl->dl.size
+                || !(mdl->center_pos_mod >= 0 && mdl->center_pos_mod < mdl->dl.size)
+                || !(FLUID_FABS(mdl->mod.buffer1) <= 1 && FLUID_FABS(mdl->mod.buffer2) <= 1)
+                || late->delay0[i] < 0 || late->delay0[i] > late->lines_size
+                || late->delay1[i] < 0 || late->delay1[i] > late->lines_size)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+* Restores the state of a reverb saved by fluid_revmodel_save_state().
+* @param rev pointer on reverb.
+* @param data the state, fluid_revmodel_get_size() bytes.
+* @return FLUID_OK if success, FLUID_FAILED if the reverb was saved with
+*  delay lines of another size, i.e. at another sample rate, or if the state
+*  is corrupted.
+*/
+int
+fluid_revmodel_load_state(fluid_revmodel_t *rev, const void *data)
+{
+    fluid_real_t *lines = rev->late.lines;
+    fluid_revmodel_t saved;
+
+    FLUID_MEMCPY(&saved, data, sizeof(saved));
+
+    if(fluid_revmodel_check_state(rev, &saved) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    *rev = saved;
+    rev->late.lines = lines;
+    FLUID_MEMCPY(lines, (const char *)data + sizeof(saved),
+                 fluid_revmodel_get_size(rev) - sizeof(saved));
+
+    return FLUID_OK;
+}
+
 /*
 * Sets one or more reverb parameters. Note this must be called at least one
 * time after calling new_fluid_revmodel().
@@ -1207,13 +1556,14 @@ fluid_revmodel_set(fluid_revmodel_t *rev, int set, fluid_real_t roomsize,
 int
 fluid_revmodel_samplerate_change(fluid_revmodel_t *rev, fluid_real_t sample_rate)
 {
-    rev->late.samplerate = sample_rate; /* new sample rate value */
+    /* new sample rate value of the fdn */
+    rev->late.samplerate = sample_rate / rev->late.decimation;
 
     /* free all delay lines */
     delete_fluid_rev_late(&rev->late);
 
     /* create all delay lines */
-    if(create_mod_delay_lines(&rev->late, sample_rate) == FLUID_FAILED)
+    if(create_mod_delay_lines(&rev->late, rev->late.samplerate, rev->late.decimation) == FLUID_FAILED)
     {
         return FLUID_FAILED; /* memory error */
     }
@@ -1225,7 +1575,50 @@ fluid_revmodel_samplerate_change(fluid_revmodel_t *rev, fluid_real_t sample_rate
 }
 
 /*
-* Damps the reverb by clearing the delay lines.
+* Lets the feedback delay network of the reverb run at a half or a quarter of
+* the sample rate, which makes the reverb about as much cheaper. The tone
+* correction and the stereo output stay at the sample rate. The delay lines
+* are reallocated and cleared, the same care must be taken as for
+* fluid_revmodel_samplerate_change().
+*
+* @param rev the reverb.
+* @param decimation 1 for the full sample rate, 2 or 4.
+* @return FLUID_OK if success, FLUID_FAILED otherwise (invalid decimation or
+* memory error).
+* Reverb API.
+*/
+int
+fluid_revmodel_set_decimation(fluid_revmodel_t *rev, int decimation)
+{
+    fluid_real_t sample_rate = rev->late.samplerate * rev->late.decimation;
+
+    if((decimation != 1 && decimation != 2 && decimation != MAX_DECIMATION)
+            || FLUID_BUFSIZE % decimation != 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(decimation > 1 && halfband_coeffs[0] == 0)
+    {
+        /* designed once, always the same */
+        fluid_halfband_init();
+    }
+
+    rev->late.decimation = decimation;
+
+    if(fluid_revmodel_samplerate_change(rev, sample_rate) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    fluid_revmodel_init(rev);
+
+    return FLUID_OK;
+}
+
+/*
+* Damps the reverb by clearing the delay lines, its state is that of
+* a reverb just created.
 * @param rev the reverb.
 *
 * Reverb API.
@@ -1236,6 +1629,91 @@ fluid_revmodel_reset(fluid_revmodel_t *rev)
     fluid_revmodel_init(rev);
 }
 
+/*-----------------------------------------------------------------------------
+* fdn reverb process at a decimated rate, see fluid_revmodel_set_decimation().
+* @param rev pointer on reverb.
+* @param in monophonic buffer input (FLUID_BUFSIZE samples).
+* @param left_out stereo left processed output (FLUID_BUFSIZE samples).
+* @param right_out stereo right processed output (FLUID_BUFSIZE samples).
+* @param mix TRUE to mix the reverb in out, FALSE to replace what is there.
+-----------------------------------------------------------------------------*/
+static void
+fluid_revmodel_process_decimated(fluid_revmodel_t *rev, const fluid_real_t *in,
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int mix)
+{
+    int stages = (rev->late.decimation == MAX_DECIMATION) ? 2 : 1;
+    int count = FLUID_BUFSIZE;
+    int i, k;
+
+    fluid_real_t tone_buffer = rev->late.tone_buffer;
+    fluid_real_t b1 = rev->late.b1, b2 = rev->late.b2, wet2 = rev->wet2;
+
+    /* the samples at the sample rate, and at each of the lower rates */
+    fluid_real_t x[FLUID_BUFSIZE], x_left[FLUID_BUFSIZE], x_right[FLUID_BUFSIZE];
+    fluid_real_t y[FLUID_BUFSIZE / 2], y_left[FLUID_BUFSIZE / 2], y_right[FLUID_BUFSIZE / 2];
+
+    /* tone correction at the sample rate */
+    for(k = 0; k < FLUID_BUFSIZE; k++)
+    {
+#ifdef DENORMALISING
+        /* Input is adjusted by DC_OFFSET. */
+        fluid_real_t xn = (in[k]) * FIXED_GAIN + DC_OFFSET;
+#else
+        fluid_real_t xn = (in[k]) * FIXED_GAIN;
+#endif
+
+        x[k] = xn * b1 - b2 * tone_buffer;
+        tone_buffer = xn;
+    }
+
+    rev->late.tone_buffer = tone_buffer;
+
+    for(i = 0; i < stages; i++)
+    {
+        count /= 2;
+        fluid_halfband_decimate(&rev->stages[i], x, y, count);
+        FLUID_MEMCPY(x, y, count * sizeof(fluid_real_t));
+    }
+
+    /* process feedback delayed network */
+    for(k = 0; k < count; k++)
+    {
+        process_fdn(&rev->late, x[k], &x_left[k], &x_right[k]);
+    }
+
+    for(i = stages - 1; i >= 0; i--)
+    {
+        FLUID_MEMCPY(y_left, x_left, count * sizeof(fluid_real_t));
+        FLUID_MEMCPY(y_right, x_right, count * sizeof(fluid_real_t));
+        fluid_halfband_interpolate(rev->stages[i].interp_left, y_left, x_left, count);
+        fluid_halfband_interpolate(rev->stages[i].interp_right, y_right, x_right, count);
+        count *= 2;
+    }
+
+    for(k = 0; k < FLUID_BUFSIZE; k++)
+    {
+        fluid_real_t out_left = x_left[k], out_right = x_right[k];
+
+#ifdef DENORMALISING
+        /* Removes the DC offset */
+        out_left -= DC_OFFSET;
+        out_right -= DC_OFFSET;
+#endif
+
+        /* see fluid_revmodel_processreplace() */
+        if(mix)
+        {
+            left_out[k]  += out_left  + out_right * wet2;
+            right_out[k] += out_right + out_left * wet2;
+        }
+        else
+        {
+            left_out[k]  = out_left  + out_right * wet2;
+            right_out[k] = out_right + out_left * wet2;
+        }
+    }
+}
+
 /*-----------------------------------------------------------------------------
 * fdn reverb process replace.
 * @param rev pointer on reverb.
@@ -1250,20 +1728,20 @@ void
 fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
                               fluid_real_t *left_out, fluid_real_t *right_out)
 {
-    int i, k;
+    int k;
 
     fluid_real_t xn;                   /* mono input x(n) */
     fluid_real_t out_tone_filter;      /* tone corrector output */
     fluid_real_t out_left, out_right;  /* output stereo Left  and Right  */
-    fluid_real_t matrix_factor;        /* partial matrix computation */
-    fluid_real_t delay_out_s;          /* sample */
-    fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
 
-    for(k = 0; k < FLUID_BUFSIZE; k++)
+    if(rev->late.decimation > 1)
     {
-        /* stereo output */
-        out_left = out_right = 0;
+        fluid_revmodel_process_decimated(rev, in, left_out, right_out, FALSE);
+        return;
+    }
 
+    for(k = 0; k < FLUID_BUFSIZE; k++)
+    {
 #ifdef DENORMALISING
         /* Input is adjusted by DC_OFFSET. */
         xn = (in[k]) * FIXED_GAIN + DC_OFFSET;
@@ -1277,62 +1755,8 @@ fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
         out_tone_filter = xn * rev->late.b1 - rev->late.b2 * rev->late.tone_buffer;
         rev->late.tone_buffer = xn;
         xn = out_tone_filter;
-        /*--------------------------------------------------------------------
-         process  feedback delayed network:
-          - xn is the input signal.
-          - before inserting in the line input we first we get the delay lines
-            output, filter them and compute output in delay_out[].
-          - also matrix_factor is computed (to simplify further matrix product)
-        ---------------------------------------------------------------------*/
-        /* We begin with the modulated output delay line + damping filter */
-        matrix_factor = 0;
-
-        for(i = 0; i < NBR_DELAYS; i++)
-        {
-            mod_delay_line *mdl = &rev->late.mod_delay_lines[i];
-            /* get current modulated output */
-            delay_out_s = get_mod_delay(mdl);
-
-            /* process low pass damping filter
-              (input:delay_out_s, output:delay_out_s) */
-            process_damping_filter(delay_out_s, delay_out_s, mdl);
-
-            /* Result in delay_out[], and matrix_factor.
-               These will be of use later during input line process */
-            delay_out[i] = delay_out_s;   /* result in delay_out[] */
-            matrix_factor += delay_out_s; /* result in matrix_factor */
-
-            /* Process stereo output */
-            /* stereo left = left + out_left_gain * delay_out */
-            out_left += rev->late.out_left_gain[i] * delay_out_s;
-            /* stereo right= right+ out_right_gain * delay_out */
-            out_right += rev->late.out_right_gain[i] * delay_out_s;
-        }
-
-        /* now we process the input delay line.Each input is a combination of
-           - xn: input signal
-           - delay_out[] the output of a delay line given by a permutation matrix P
-           - and matrix_factor.
-          This computes: in_delay_line = xn + (delay_out[] * matrix A) with
-          an algorithm equivalent but faster than using a product with matrix A.
-        */
-        /* matrix_factor = output sum * (-2.0)/N  */
-        matrix_factor *= FDN_MATRIX_FACTOR;
-        matrix_factor += xn; /* adds reverb input signal */
-
-        for(i = 1; i < NBR_DELAYS; i++)
-        {
-            /* delay_in[i-1] = delay_out[i] + matrix_factor */
-            delay_line *dl = &rev->late.mod_delay_lines[i - 1].dl;
-            push_in_delay_line(dl, delay_out[i] + matrix_factor);
-        }
-
-        /* last line input (NB_DELAY-1) */
-        /* delay_in[0] = delay_out[NB_DELAY -1] + matrix_factor */
-        {
-            delay_line *dl = &rev->late.mod_delay_lines[NBR_DELAYS - 1].dl;
-            push_in_delay_line(dl, delay_out[0] + matrix_factor);
-        }
+        /* process feedback delayed network */
+        process_fdn(&rev->late, xn, &out_left, &out_right);
 
         /*-------------------------------------------------------------------*/
 #ifdef DENORMALISING
@@ -1372,19 +1796,20 @@ fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
 void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
                                fluid_real_t *left_out, fluid_real_t *right_out)
 {
-    int i, k;
+    int k;
 
     fluid_real_t xn;                   /* mono input x(n) */
     fluid_real_t out_tone_filter;      /* tone corrector output */
     fluid_real_t out_left, out_right;  /* output stereo Left  and Right  */
-    fluid_real_t matrix_factor;        /* partial matrix term */
-    fluid_real_t delay_out_s;          /* sample */
-    fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
+
+    if(rev->late.decimation > 1)
+    {
+        fluid_revmodel_process_decimated(rev, in, left_out, right_out, TRUE);
+        return;
+    }
 
     for(k = 0; k < FLUID_BUFSIZE; k++)
     {
-        /* stereo output */
-        out_left = out_right = 0;
 #ifdef DENORMALISING
         /* Input is adjusted by DC_OFFSET. */
         xn = (in[k]) * FIXED_GAIN + DC_OFFSET;
@@ -1398,62 +1823,8 @@ void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
         out_tone_filter = xn * rev->late.b1 - rev->late.b2 * rev->late.tone_buffer;
         rev->late.tone_buffer = xn;
         xn = out_tone_filter;
-        /*--------------------------------------------------------------------
-         process feedback delayed network:
-          - xn is the input signal.
-          - before inserting in the line input we first we get the delay lines
-            output, filter them and compute output in local delay_out[].
-          - also matrix_factor is computed (to simplify further matrix product).
-        ---------------------------------------------------------------------*/
-        /* We begin with the modulated output delay line + damping filter */
-        matrix_factor = 0;
-
-        for(i = 0; i < NBR_DELAYS; i++)
-        {
-            mod_delay_line *mdl = &rev->late.mod_delay_lines[i];
-            /* get current modulated output */
-            delay_out_s = get_mod_delay(mdl);
-
-            /* process low pass damping filter
-              (input:delay_out_s, output:delay_out_s) */
-            process_damping_filter(delay_out_s, delay_out_s, mdl);
-
-            /* Result in delay_out[], and matrix_factor.
-               These will be of use later during input line process */
-            delay_out[i] = delay_out_s;   /* result in delay_out[] */
-            matrix_factor += delay_out_s; /* result in matrix_factor */
-
-            /* Process stereo output */
-            /* stereo left = left + out_left_gain * delay_out */
-            out_left += rev->late.out_left_gain[i] * delay_out_s;
-            /* stereo right= right+ out_right_gain * delay_out */
-            out_right += rev->late.out_right_gain[i] * delay_out_s;
-        }
-
-        /* now we process the input delay line. Each input is a combination of:
-           - xn: input signal
-           - delay_out[] the output of a delay line given by a permutation matrix P
-           - and matrix_factor.
-          This computes: in_delay_line = xn + (delay_out[] * matrix A) with
-          an algorithm equivalent but faster than using a product with matrix A.
-        */
-        /* matrix_factor = output sum * (-2.0)/N  */
-        matrix_factor *= FDN_MATRIX_FACTOR;
-        matrix_factor += xn; /* adds reverb input signal */
-
-        for(i = 1; i < NBR_DELAYS; i++)
-        {
-            /* delay_in[i-1] = delay_out[i] + matrix_factor */
-            delay_line *dl = &rev->late.mod_delay_lines[i - 1].dl;
-            push_in_delay_line(dl, delay_out[i] + matrix_factor);
-        }
-
-        /* last line input (NB_DELAY-1) */
-        /* delay_in[0] = delay_out[NB_DELAY -1] + matrix_factor */
-        {
-            delay_line *dl = &rev->late.mod_delay_lines[NBR_DELAYS - 1].dl;
-            push_in_delay_line(dl, delay_out[0] + matrix_factor);
-        }
+        /* process feedback delayed network */
+        process_fdn(&rev->late, xn, &out_left, &out_right);
 
         /*-------------------------------------------------------------------*/
 #ifdef DENORMALISING
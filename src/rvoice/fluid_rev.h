@@ -73,5 +73,9 @@ void fluid_revmodel_set(fluid_revmodel_t *rev, int set, fluid_real_t roomsize,
                         fluid_real_t damping, fluid_real_t width, fluid_real_t level);
 
 int fluid_revmodel_samplerate_change(fluid_revmodel_t *rev, fluid_real_t sample_rate);
+int fluid_revmodel_set_decimation(fluid_revmodel_t *rev, int decimation);
+size_t fluid_revmodel_get_size(const fluid_revmodel_t *rev);
+void fluid_revmodel_save_state(const fluid_revmodel_t *rev, void *data);
+int fluid_revmodel_load_state(fluid_revmodel_t *rev, const void *data);
 
 #endif /* _FLUID_REV_H */
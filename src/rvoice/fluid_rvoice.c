@@ -21,40 +21,130 @@
 #include "fluid_rvoice.h"
 #include "fluid_conv.h"
 #include "fluid_sys.h"
+#include "fluid_note_cache.h"
 
 
 static void fluid_rvoice_noteoff_LOCAL(fluid_rvoice_t *voice, unsigned int min_ticks);
 
+struct _fluid_rvoice_slab_t
+{
+    void *mem;          /* the allocated memory, to free */
+    char *base;         /* the first rvoice, aligned to FLUID_DEFAULT_ALIGNMENT */
+    size_t stride;      /* size of an rvoice, rounded up to FLUID_DEFAULT_ALIGNMENT */
+    int count;
+};
+
 /**
- * @return -1 if voice is quiet, 0 if voice has finished, 1 otherwise
+ * Allocate @p count rvoices in one block of memory. Each of them starts on its own
+ * cache line, so that no two threads rendering different voices share one.
+ * @return the slab, NULL on out of memory
  */
-static FLUID_INLINE int
-fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
+fluid_rvoice_slab_t *
+new_fluid_rvoice_slab(int count)
 {
-    fluid_real_t target_amp;	/* target amplitude */
+    fluid_rvoice_slab_t *slab = FLUID_NEW(fluid_rvoice_slab_t);
+
+    if(slab == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    slab->count = count;
+    slab->stride = (sizeof(fluid_rvoice_t) + FLUID_DEFAULT_ALIGNMENT - 1) & ~(size_t)(FLUID_DEFAULT_ALIGNMENT - 1);
+    slab->mem = FLUID_MALLOC(count * slab->stride + FLUID_DEFAULT_ALIGNMENT);
+
+    if(slab->mem == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(slab);
+        return NULL;
+    }
+
+    slab->base = fluid_align_ptr(slab->mem, FLUID_DEFAULT_ALIGNMENT);
+    FLUID_MEMSET(slab->base, 0, count * slab->stride);
+
+    return slab;
+}
 
+void
+delete_fluid_rvoice_slab(fluid_rvoice_slab_t *slab)
+{
+    fluid_return_if_fail(slab != NULL);
+
+    FLUID_FREE(slab->mem);
+    FLUID_FREE(slab);
+}
+
+/**
+ * @return the rvoice at @p index of the slab
+ */
+fluid_rvoice_t *
+fluid_rvoice_slab_get(fluid_rvoice_slab_t *slab, int index)
+{
+    fluid_return_val_if_fail(index >= 0 && index < slab->count, NULL);
+
+    return (fluid_rvoice_t *)(slab->base + index * slab->stride);
+}
+
+/* Count of attenuations converted by fluid_rvoice_calc_amp() */
+#define FLUID_RVOICE_AMP_CB_COUNT 3
+
+/**
+ * First half of fluid_rvoice_calc_amp(): the attenuations to be converted to
+ * amplitudes, stored in cb: the attenuation of the voice, the attenuation of
+ * the envelope and the LFO and the smallest possible attenuation.
+ *
+ * @return -1 if voice is quiet, 1 otherwise
+ */
+static FLUID_INLINE int
+fluid_rvoice_calc_amp_cb(fluid_rvoice_t *voice, fluid_real_t *cb)
+{
     if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVDELAY)
     {
         return -1;    /* The volume amplitude is in hold phase. No sound is produced. */
     }
 
+    cb[0] = voice->dsp.attenuation;
+    cb[2] = voice->dsp.min_attenuation_cB;
+
     if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVATTACK)
     {
         /* the envelope is in the attack section: ramp linearly to max value.
          * A positive modlfo_to_vol should increase volume (negative attenuation).
          */
-        target_amp = fluid_cb2amp(voice->dsp.attenuation)
-                     * fluid_cb2amp(fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol)
-                     * fluid_adsr_env_get_val(&voice->envlfo.volenv);
+        cb[1] = fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol;
+    }
+    else
+    {
+        cb[1] = FLUID_PEAK_ATTENUATION * (1.0f - fluid_adsr_env_get_val(&voice->envlfo.volenv))
+                + fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol;
+    }
+
+    return 1;
+}
+
+/**
+ * Second half of fluid_rvoice_calc_amp(), given the amplitudes of the
+ * attenuations from fluid_rvoice_calc_amp_cb().
+ *
+ * @return -1 if voice is quiet, 0 if voice has finished, 1 otherwise
+ */
+static FLUID_INLINE int
+fluid_rvoice_calc_amp_finish(fluid_rvoice_t *voice, const fluid_real_t *amp)
+{
+    fluid_real_t target_amp;	/* target amplitude */
+
+    if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVATTACK)
+    {
+        target_amp = amp[0] * amp[1] * fluid_adsr_env_get_val(&voice->envlfo.volenv);
     }
     else
     {
         fluid_real_t amplitude_that_reaches_noise_floor;
         fluid_real_t amp_max;
 
-        target_amp = fluid_cb2amp(voice->dsp.attenuation)
-                     * fluid_cb2amp(FLUID_PEAK_ATTENUATION * (1.0f - fluid_adsr_env_get_val(&voice->envlfo.volenv))
-                                    + fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol);
+        target_amp = amp[0] * amp[1];
 
         /* We turn off a voice, if the volume has dropped low enough. */
 
@@ -83,8 +173,7 @@ fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
          * volenv_val can only drop):
          */
 
-        amp_max = fluid_cb2amp(voice->dsp.min_attenuation_cB) *
-                  fluid_adsr_env_get_val(&voice->envlfo.volenv);
+        amp_max = amp[2] * fluid_adsr_env_get_val(&voice->envlfo.volenv);
 
         /* And if amp_max is already smaller than the known amplitude,
          * which will attenuate the sample below the noise floor, then we
@@ -109,6 +198,29 @@ fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
     return 1;
 }
 
+/**
+ * @return -1 if voice is quiet, 0 if voice has finished, 1 otherwise
+ */
+static FLUID_INLINE int
+fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
+{
+    fluid_real_t cb[FLUID_RVOICE_AMP_CB_COUNT];
+    fluid_real_t amp[FLUID_RVOICE_AMP_CB_COUNT];
+    int i;
+
+    if(fluid_rvoice_calc_amp_cb(voice, cb) < 0)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < FLUID_RVOICE_AMP_CB_COUNT; i++)
+    {
+        amp[i] = fluid_cb2amp(cb[i]);
+    }
+
+    return fluid_rvoice_calc_amp_finish(voice, amp);
+}
+
 
 /* these should be the absolute minimum that FluidSynth can deal with */
 #define FLUID_MIN_LOOP_SIZE 2
@@ -272,205 +384,1165 @@ fluid_rvoice_check_sample_sanity(fluid_rvoice_t *voice)
 
         if(index_in_sample >= voice->dsp.loopend)
         {
-            /* FLUID_LOG(FLUID_DBG, "Loop / sample sanity check: Phase after 2nd loop point!"); */
-            fluid_phase_set_int(voice->dsp.phase, voice->dsp.loopstart);
+            /* FLUID_LOG(FLUID_DBG, "Loop / sample sanity check: Phase after 2nd loop point!"); */
+            fluid_phase_set_int(voice->dsp.phase, voice->dsp.loopstart);
+        }
+    }
+
+    /*    FLUID_LOG(FLUID_DBG, "Loop / sample sanity check: Sample from %i to %i, loop from %i to %i", voice->dsp.start, voice->dsp.end, voice->dsp.loopstart, voice->dsp.loopend); */
+
+    /* Sample sanity has been assured. Don't check again, until some
+       sample parameter is changed by modulation. */
+    voice->dsp.check_sample_sanity_flag = 0;
+#if 0
+    printf("Sane? playback loop from %i to %i\n", voice->dsp.loopstart, voice->dsp.loopend);
+#endif
+    fluid_check_fpe("voice_check_sample_sanity");
+}
+
+
+/**
+ * Choose the interpolation method of a voice for the next block. Unless disabled,
+ * a voice, which is quiet enough or has been in the release stage for long
+ * enough, is rendered with linear interpolation rather than with the more
+ * expensive method requested by the synth, as the difference can hardly be
+ * heard. The amplitude threshold is doubled once a voice has been downgraded,
+ * so that a voice close to it doesn't switch back and forth.
+ */
+static FLUID_INLINE void
+fluid_rvoice_write_interp_qos(fluid_rvoice_t *voice)
+{
+    fluid_rvoice_dsp_t *dsp = &voice->dsp;
+    enum fluid_interp method = dsp->requested_interp_method;
+
+    if(method > FLUID_INTERP_LINEAR)
+    {
+        fluid_real_t threshold = (dsp->interp_method < method) ? 2 * dsp->qos_amp : dsp->qos_amp;
+        fluid_real_t amp = dsp->amp + dsp->amp_incr * FLUID_BUFSIZE;
+
+        if(amp < dsp->amp)
+        {
+            amp = dsp->amp;
+        }
+
+        if(amp < threshold
+                || (dsp->qos_release_blocks >= 0
+                    && fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVRELEASE
+                    && voice->envlfo.volenv.count >= (unsigned int)dsp->qos_release_blocks))
+        {
+            method = FLUID_INTERP_LINEAR;
+        }
+    }
+
+    /* A switch is crossfaded, see fluid_rvoice_write_crossfade(), unless the voice starts
+     * the block silent: its first block, or the first one after quiet blocks. */
+    dsp->prev_interp_method = (dsp->amp == 0) ? method : dsp->interp_method;
+    dsp->interp_method = method;
+}
+
+/**
+ * Run the envelopes and LFOs of a voice for the next block, the first part of
+ * fluid_rvoice_write_prepare().
+ *
+ * @return 1 if the voice continues, 0 if it has finished
+ */
+static int
+fluid_rvoice_write_prepare_env(fluid_rvoice_t *voice)
+{
+    int ticks = voice->envlfo.ticks;
+
+    /******************* sample sanity check **********/
+
+    if(!voice->dsp.sample)
+    {
+        return 0;
+    }
+
+    if(voice->dsp.check_sample_sanity_flag)
+    {
+        fluid_rvoice_check_sample_sanity(voice);
+    }
+
+    /******************* noteoff check ****************/
+
+    if(voice->envlfo.noteoff_ticks != 0 &&
+            voice->envlfo.ticks >= voice->envlfo.noteoff_ticks)
+    {
+        fluid_rvoice_noteoff_LOCAL(voice, 0);
+    }
+
+    voice->envlfo.ticks += FLUID_BUFSIZE;
+
+    /******************* vol env **********************/
+
+    fluid_adsr_env_calc(&voice->envlfo.volenv, 1);
+    fluid_check_fpe("voice_write vol env");
+
+    if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVFINISHED)
+    {
+        return 0;
+    }
+
+    /******************* mod env **********************/
+
+    fluid_adsr_env_calc(&voice->envlfo.modenv, 0);
+    fluid_check_fpe("voice_write mod env");
+
+    /******************* lfo **********************/
+
+    fluid_lfo_calc(&voice->envlfo.modlfo, ticks);
+    fluid_check_fpe("voice_write mod LFO");
+    fluid_lfo_calc(&voice->envlfo.viblfo, ticks);
+    fluid_check_fpe("voice_write vib LFO");
+
+    return 1;
+}
+
+/**
+ * Calculate the modulation envelope value, pitch, portamento and interpolation
+ * method of a voice for the next block, the last part of
+ * fluid_rvoice_write_prepare() once the amplitude has been calculated.
+ */
+static void
+fluid_rvoice_write_prepare_phase(fluid_rvoice_t *voice, fluid_real_t *modenv_val_out,
+                                 fluid_real_t *pitch_out, int *is_looping)
+{
+    fluid_real_t modenv_val;
+
+    /******************* phase **********************/
+
+    /* SF2.04 section 8.1.2 #26:
+     * attack of modEnv is convex ?!?
+     */
+    *modenv_val_out = modenv_val = (fluid_adsr_env_get_section(&voice->envlfo.modenv) == FLUID_VOICE_ENVATTACK)
+                 ? fluid_convex(127 * fluid_adsr_env_get_val(&voice->envlfo.modenv))
+                 : fluid_adsr_env_get_val(&voice->envlfo.modenv);
+    *pitch_out = voice->dsp.pitch +
+                 voice->dsp.pitchoffset +
+                 fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_pitch
+                 + fluid_lfo_get_val(&voice->envlfo.viblfo) * voice->envlfo.viblfo_to_pitch
+                 + modenv_val * voice->envlfo.modenv_to_pitch;
+
+    /******************* portamento ****************/
+    /* pitchoffset is updated if enabled.
+       Pitchoffset will be added to dsp pitch at next phase calculation time */
+
+    /* In most cases portamento will be disabled. Thus first verify that portamento is
+     * enabled before updating pitchoffset and before disabling portamento when necessary,
+     * in order to keep the performance loss at minimum.
+     * If the algorithm would first update pitchoffset and then verify if portamento
+     * needs to be disabled, there would be a significant performance drop on a x87 FPU
+     */
+    if(voice->dsp.pitchinc > 0.0f)
+    {
+        /* portamento is enabled, so update pitchoffset */
+        voice->dsp.pitchoffset += voice->dsp.pitchinc;
+
+        /* when pitchoffset reaches 0.0f, portamento is disabled */
+        if(voice->dsp.pitchoffset > 0.0f)
+        {
+            voice->dsp.pitchoffset = voice->dsp.pitchinc = 0.0f;
+        }
+    }
+    else if(voice->dsp.pitchinc < 0.0f)
+    {
+        /* portamento is enabled, so update pitchoffset */
+        voice->dsp.pitchoffset += voice->dsp.pitchinc;
+
+        /* when pitchoffset reaches 0.0f, portamento is disabled */
+        if(voice->dsp.pitchoffset < 0.0f)
+        {
+            voice->dsp.pitchoffset = voice->dsp.pitchinc = 0.0f;
+        }
+    }
+
+    /* voice is currently looping? */
+    *is_looping = voice->dsp.samplemode == FLUID_LOOP_DURING_RELEASE
+                 || (voice->dsp.samplemode == FLUID_LOOP_UNTIL_RELEASE
+                     && fluid_adsr_env_get_section(&voice->envlfo.volenv) < FLUID_VOICE_ENVRELEASE);
+
+    fluid_rvoice_write_interp_qos(voice);
+}
+
+/**
+ * Run envelopes, LFOs and amplitude calculation of a voice for the next block,
+ * i.e. everything that fluid_rvoice_write() does before running the dsp
+ * interpolation, except for converting the pitch to the phase increment (see
+ * fluid_rvoice_write_phase_incr()).
+ *
+ * @param pitch_out Location to store the pitch of the next block in cents
+ * @return 1 if the block must be interpolated, otherwise the count to be
+ * returned by fluid_rvoice_write() (-1 if quiet, 0 if finished).
+ */
+static int
+fluid_rvoice_write_prepare(fluid_rvoice_t *voice, fluid_real_t *modenv_val_out, fluid_real_t *pitch_out,
+                           int *is_looping)
+{
+    int count = fluid_rvoice_write_prepare_env(voice);
+
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    /******************* amplitude **********************/
+
+    count = fluid_rvoice_calc_amp(voice);
+
+    if(count <= 0)
+    {
+        /* a quiet voice is not delayed any longer */
+        voice->dsp.start_offset = 0;
+        return count; /* return -1 if voice is quiet, 0 if voice has finished */
+    }
+
+    fluid_rvoice_write_prepare_phase(voice, modenv_val_out, pitch_out, is_looping);
+
+    return 1;
+}
+
+/**
+ * Set the phase increment of a voice for the next block.
+ *
+ * @param pitch_hz the frequency of the pitch returned by fluid_rvoice_write_prepare()
+ */
+static FLUID_INLINE void
+fluid_rvoice_write_phase_incr(fluid_rvoice_t *voice, fluid_real_t pitch_hz)
+{
+    /* Calculate the number of samples, that the DSP loop advances
+     * through the original waveform with each step in the output
+     * buffer. It is the ratio between the frequencies of original
+     * waveform and output waveform. The root pitch only changes with
+     * its generator, so its reciprocal has been taken once before. */
+    voice->dsp.phase_incr = pitch_hz * voice->dsp.root_pitch_incr;
+
+    fluid_check_fpe("voice_write phase calculation");
+
+    /* if phase_incr is not advancing, set it to the minimum fraction value (prevent stuckage) */
+    if(voice->dsp.phase_incr == 0)
+    {
+        voice->dsp.phase_incr = 1;
+    }
+}
+
+/**
+ * Silence the frames of the first block of a voice, which lie before the frame
+ * the voice has been started at. The interpolation has left them untouched.
+ */
+static FLUID_INLINE void
+fluid_rvoice_write_start_offset(fluid_rvoice_dsp_t *dsp, fluid_real_t *dsp_buf)
+{
+    if(dsp->start_offset > 0)
+    {
+        FLUID_MEMSET(dsp_buf, 0, dsp->start_offset * sizeof(*dsp_buf));
+        dsp->start_offset = 0;
+    }
+}
+
+/**
+ * Whether a voice plays its sample at the original pitch for the next block,
+ * e.g. a drum sample with an unmodulated pitch at the output rate.
+ */
+static FLUID_INLINE int
+fluid_rvoice_is_unpitched(const fluid_rvoice_dsp_t *dsp)
+{
+    return dsp->phase_incr == 1 && fluid_phase_fract(dsp->phase) == 0;
+}
+
+/**
+ * Run the dsp interpolation for a single voice with the given method, reading the sample data
+ */
+static int
+fluid_rvoice_interpolate_data(fluid_rvoice_dsp_t *dsp, enum fluid_interp method, fluid_real_t *dsp_buf,
+                              int is_looping)
+{
+    /* nothing to interpolate */
+    if(fluid_rvoice_is_unpitched(dsp))
+    {
+        return fluid_rvoice_dsp_copy(dsp, dsp_buf, is_looping);
+    }
+
+    switch(method)
+    {
+    case FLUID_INTERP_NONE:
+        return fluid_rvoice_dsp_interpolate_none(dsp, dsp_buf, is_looping);
+
+    case FLUID_INTERP_LINEAR:
+        return fluid_rvoice_dsp_interpolate_linear(dsp, dsp_buf, is_looping);
+
+    case FLUID_INTERP_4THORDER:
+    default:
+        return fluid_rvoice_dsp_interpolate_4th_order(dsp, dsp_buf, is_looping);
+
+    case FLUID_INTERP_7THORDER:
+        return fluid_rvoice_dsp_interpolate_7th_order(dsp, dsp_buf, is_looping);
+    }
+}
+
+/* Frames read around the position of a voice by the interpolation at most,
+ * besides the ones its phase increments cover */
+#define FLUID_RVOICE_STREAM_MARGIN 8
+
+/**
+ * Whether the part of a streamed sample from \c base holds all of the frames the
+ * interpolation of the next block reads, from \c first to \c last, or stands in
+ * for them with the start or the loop of the sample.
+ */
+static int
+fluid_rvoice_stream_covers(const fluid_rvoice_dsp_t *dsp, int is_looping, unsigned int first,
+                           unsigned int last, unsigned int base, unsigned int count)
+{
+    unsigned int loopstart = (unsigned int)dsp->loopstart;
+    unsigned int loopend = (unsigned int)dsp->loopend;
+    int loop_inside = loopstart >= base && loopend <= base + count;
+
+    /* the points before the loop start are the ones at its end once looped, and the
+     * voice goes back to the loop start at its end */
+    if(dsp->has_looped && first < loopstart)
+    {
+        if(!loop_inside)
+        {
+            return FALSE;
+        }
+
+        first = loopstart;
+    }
+
+    if(is_looping && last + 1 >= loopend && !loop_inside)
+    {
+        return FALSE;
+    }
+
+    return first >= base && last < base + count;
+}
+
+/**
+ * Run the dsp interpolation for a voice playing a streamed sample, reading one of the
+ * parts of it in memory: the head or the loop of the sample, or the ring buffer of the
+ * voice. The interpolation reads a copy of the voice, with a sample made up of the part.
+ * Returns -1 if none holds all of the frames of the next block, the voice reads the
+ * mapped SoundFont file then.
+ */
+static int
+fluid_rvoice_interpolate_stream(fluid_rvoice_dsp_t *dsp, enum fluid_interp method, fluid_real_t *dsp_buf,
+                                int is_looping)
+{
+    const fluid_sample_t *sample = dsp->sample;
+    unsigned int index = fluid_phase_index(dsp->phase);
+    unsigned int start = (unsigned int)dsp->start;
+    unsigned int end = (unsigned int)dsp->end;
+    unsigned int loopstart = (unsigned int)dsp->loopstart;
+    unsigned int loopend = (unsigned int)dsp->loopend;
+    unsigned int loop_count = fluid_sample_get_stream_loop_count(sample);
+    fluid_real_t frames = dsp->phase_incr * (FLUID_BUFSIZE - dsp->start_offset);
+    unsigned int first, last, limit, base, count;
+    short *data;
+    char *data24;
+    fluid_sample_t window;
+    fluid_rvoice_dsp_t view;
+    int result;
+
+    if(frames >= FLUID_SAMPLE_STREAM_GUARD / 2 || dsp->start < 0 || dsp->end < dsp->start
+            || (is_looping && (dsp->loopstart < 0 || loopend <= loopstart)))
+    {
+        return -1;
+    }
+
+    limit = is_looping ? loopend : end + 1;
+
+    if(index >= limit)
+    {
+        return -1;
+    }
+
+    /* the frames read by the interpolation, the ones before the start are its first one */
+    first = (index >= FLUID_RVOICE_STREAM_MARGIN) ? index - FLUID_RVOICE_STREAM_MARGIN : 0;
+    last = index + (unsigned int)frames + 1 + FLUID_RVOICE_STREAM_MARGIN;
+
+    if(!dsp->has_looped && first < start)
+    {
+        first = start;
+    }
+
+    if(last >= limit)
+    {
+        last = limit - 1;
+    }
+
+    if(fluid_rvoice_stream_covers(dsp, is_looping, first, last, sample->start, sample->stream_preload))
+    {
+        base = sample->start;
+        count = sample->stream_preload;
+        data = sample->stream_data;
+        data24 = sample->stream_data24;
+    }
+    else if(loop_count > 0 && loopstart == sample->loopstart && loopend == sample->loopend
+            && fluid_rvoice_stream_covers(dsp, is_looping, first, last, loopstart, loop_count))
+    {
+        base = loopstart;
+        count = loop_count;
+        data = sample->stream_data + sample->stream_preload;
+        data24 = (sample->stream_data24 != NULL) ? sample->stream_data24 + sample->stream_preload : NULL;
+    }
+    /* the ring buffer streams forward, looping voices read the loop from its copy
+     * once they have entered it */
+    else if(dsp->stream == NULL || (is_looping && (dsp->has_looped || last + 1 >= loopend))
+            || !fluid_sample_stream_get_window(dsp->stream, first, last, &base, &count, &data, &data24)
+            || !fluid_rvoice_stream_covers(dsp, is_looping, first, last, base, count))
+    {
+        return -1;
+    }
+
+    window = *sample;
+    window.data = data;
+    window.data24 = data24;
+    window.float_data = NULL;
+    window.loop_data = NULL;
+    FLUID_MEMSET(window.loop_mipmaps, 0, sizeof(window.loop_mipmaps));
+
+    /* the points outside of the part aren't read by this block, they only need to be in it */
+    view = *dsp;
+    view.sample = &window;
+    view.phase -= (fluid_phase_t)base << 32;
+    view.start = (start >= base && start < base + count) ? (int)(start - base) : 0;
+    view.end = (end >= base && end < base + count) ? (int)(end - base) : (int)count - 1;
+
+    if(loopstart >= base && loopend <= base + count)
+    {
+        view.loopstart = (int)(loopstart - base);
+        view.loopend = (int)(loopend - base);
+    }
+    else
+    {
+        view.loopstart = 0;
+        view.loopend = (int)count;
+    }
+
+    result = fluid_rvoice_interpolate_data(&view, method, dsp_buf, is_looping);
+
+    dsp->phase = view.phase + ((fluid_phase_t)base << 32);
+    dsp->amp = view.amp;
+    dsp->has_looped = view.has_looped;
+
+    return result;
+}
+
+/**
+ * Run the dsp interpolation for a single voice with the given method
+ */
+static int
+fluid_rvoice_interpolate(fluid_rvoice_dsp_t *dsp, enum fluid_interp method, fluid_real_t *dsp_buf,
+                         int is_looping)
+{
+    /* streamed samples are read from memory whenever possible */
+    if(dsp->sample->stream_data != NULL)
+    {
+        int count = fluid_rvoice_interpolate_stream(dsp, method, dsp_buf, is_looping);
+
+        if(count >= 0)
+        {
+            return count;
+        }
+    }
+
+    return fluid_rvoice_interpolate_data(dsp, method, dsp_buf, is_looping);
+}
+
+/**
+ * Run the dsp interpolation for a voice, whose interpolation method has changed
+ * since the previous block. The block is interpolated with both methods and
+ * crossfaded from the old to the new one, to avoid a click.
+ */
+static int
+fluid_rvoice_write_crossfade(fluid_rvoice_dsp_t *dsp, fluid_real_t *dsp_buf, int is_looping)
+{
+    fluid_real_t prev_buf[FLUID_BUFSIZE];
+    fluid_rvoice_dsp_t prev_dsp = *dsp;
+    int i, count, prev_count;
+
+    /* the old method works on a copy, the voice continues with the state of the new one */
+    prev_count = fluid_rvoice_interpolate(&prev_dsp, dsp->prev_interp_method, prev_buf, is_looping);
+    count = fluid_rvoice_interpolate(dsp, dsp->interp_method, dsp_buf, is_looping);
+
+    if(prev_count > count)
+    {
+        prev_count = count;
+    }
+
+    for(i = 0; i < prev_count; i++)
+    {
+        fluid_real_t fade = (fluid_real_t)(i + 1) / prev_count;
+        dsp_buf[i] = prev_buf[i] + fade * (dsp_buf[i] - prev_buf[i]);
+    }
+
+    dsp->prev_interp_method = dsp->interp_method;
+
+    return count;
+}
+
+/**
+ * Run the dsp interpolation for a single voice
+ */
+static int
+fluid_rvoice_write_interpolate(fluid_rvoice_dsp_t *dsp, fluid_real_t *dsp_buf, int is_looping)
+{
+    int count;
+
+    /*********************** run the dsp chain ************************
+     * The sample is mixed with the output buffer.
+     * The buffer has to be filled from 0 to FLUID_BUFSIZE-1.
+     * Depending on the position in the loop and the loop size, this
+     * may require several runs. */
+
+    if(dsp->prev_interp_method != dsp->interp_method)
+    {
+        count = fluid_rvoice_write_crossfade(dsp, dsp_buf, is_looping);
+    }
+    else
+    {
+        count = fluid_rvoice_interpolate(dsp, dsp->interp_method, dsp_buf, is_looping);
+    }
+
+    fluid_check_fpe("voice_write interpolation");
+
+    fluid_rvoice_write_start_offset(dsp, dsp_buf);
+
+    return count;
+}
+
+/**
+ * Apply the resonant filters to the interpolated samples of a voice
+ */
+static void
+fluid_rvoice_write_filter(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, int count, fluid_real_t modenv_val)
+{
+    /*************** resonant filter ******************/
+
+    fluid_iir_filter_calc(&voice->resonant_filter, voice->dsp.output_rate,
+                          fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc +
+                          modenv_val * voice->envlfo.modenv_to_fc);
+
+    fluid_iir_filter_apply(&voice->resonant_filter, dsp_buf, count);
+
+    /* additional custom filter - only uses the fixed modulator, no lfos... */
+    fluid_iir_filter_calc(&voice->resonant_custom_filter, voice->dsp.output_rate, 0);
+    fluid_iir_filter_apply(&voice->resonant_custom_filter, dsp_buf, count);
+}
+
+/**
+ * Synthesize a voice to a buffer, up to the filters.
+ * @return as fluid_rvoice_write()
+ */
+static FLUID_INLINE int
+fluid_rvoice_write_dry(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, fluid_real_t *modenv_val)
+{
+    int count, is_looping;
+    fluid_real_t pitch;
+    fluid_profile_ref_var(prof_ref);
+
+    count = fluid_rvoice_write_prepare(voice, modenv_val, &pitch, &is_looping);
+
+    if(count <= 0)
+    {
+        fluid_rvoice_profile(FLUID_PROF_STAGE_ENV, prof_ref, &voice, NULL, 1, FLUID_BUFSIZE);
+        return count;
+    }
+
+    fluid_rvoice_write_phase_incr(voice, fluid_ct2hz_real(pitch));
+    fluid_rvoice_profile(FLUID_PROF_STAGE_ENV, prof_ref, &voice, NULL, 1, FLUID_BUFSIZE);
+
+    count = fluid_rvoice_write_interpolate(&voice->dsp, dsp_buf, is_looping);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_INTERP, prof_ref, &voice, NULL, 1, 0);
+
+    return count;
+}
+
+/**
+ * Synthesize a voice to a buffer.
+ *
+ * @param voice rvoice to synthesize
+ * @param dsp_buf Audio buffer to synthesize to (#FLUID_BUFSIZE in length)
+ * @return Count of samples written to dsp_buf. (-1 means voice is currently
+ * quiet, 0 .. #FLUID_BUFSIZE-1 means voice finished.)
+ *
+ * Panning, reverb and chorus are processed separately. The dsp interpolation
+ * routine is in (fluid_rvoice_dsp.c).
+ */
+int
+fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+{
+    int count;
+    fluid_real_t modenv_val;
+    fluid_profile_ref_var(prof_ref);
+
+    count = fluid_rvoice_write_dry(voice, dsp_buf, &modenv_val);
+
+    if(count <= 0)
+    {
+        return count;
+    }
+
+    fluid_profile_ref_set(prof_ref);
+    fluid_rvoice_write_filter(voice, dsp_buf, count, modenv_val);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_FILTER, prof_ref, &voice, NULL, 1, 0);
+
+    return count;
+}
+
+/**
+ * Synthesize a voice to a buffer like fluid_rvoice_write(), but leave applying
+ * the filters to the caller. Their coefficients are updated for the block, so
+ * that applying resonant_filter and then resonant_custom_filter to the samples,
+ * e.g. part by part with fluid_iir_filter_apply_part(), gives the output of
+ * fluid_rvoice_write().
+ *
+ * @param voice rvoice to synthesize
+ * @param dsp_buf Audio buffer to synthesize to (#FLUID_BUFSIZE in length)
+ * @return as fluid_rvoice_write()
+ */
+int
+fluid_rvoice_write_unfiltered(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+{
+    int count;
+    fluid_real_t modenv_val;
+
+    count = fluid_rvoice_write_dry(voice, dsp_buf, &modenv_val);
+
+    if(count > 0)
+    {
+        fluid_iir_filter_calc(&voice->resonant_filter, voice->dsp.output_rate,
+                              fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc +
+                              modenv_val * voice->envlfo.modenv_to_fc);
+        fluid_iir_filter_calc(&voice->resonant_custom_filter, voice->dsp.output_rate, 0);
+    }
+
+    return count;
+}
+
+/**
+ * Make the follower of a stereo pair continue with the state of its leader:
+ * the same phase, envelopes and LFOs, translated to its own sample. Only
+ * its sample, its filters and its output buffers are its own.
+ */
+static void
+fluid_rvoice_stereo_sync(fluid_rvoice_t *voice, fluid_rvoice_t *follower)
+{
+    fluid_sample_t *sample = follower->dsp.sample;
+    fluid_real_t noise_floor_nonloop = follower->dsp.amplitude_that_reaches_noise_floor_nonloop;
+    fluid_real_t noise_floor_loop = follower->dsp.amplitude_that_reaches_noise_floor_loop;
+    int shift = (int)sample->start - (int)voice->dsp.sample->start;
+
+    follower->dsp = voice->dsp;
+    follower->envlfo = voice->envlfo;
+
+    follower->dsp.sample = sample;
+    follower->dsp.amplitude_that_reaches_noise_floor_nonloop = noise_floor_nonloop;
+    follower->dsp.amplitude_that_reaches_noise_floor_loop = noise_floor_loop;
+
+    fluid_phase_sub_int(follower->dsp.phase, -shift);
+    follower->dsp.start += shift;
+    follower->dsp.end += shift;
+    follower->dsp.loopstart += shift;
+    follower->dsp.loopend += shift;
+}
+
+/**
+ * Synthesize a stereo pair of voices. The envelopes, LFOs, amplitude and pitch
+ * of the pair are only calculated once, for this voice, and both samples are
+ * interpolated with the same phase. Each of the two voices is filtered on its
+ * own.
+ *
+ * @param voice the leader of the pair, the one whose stereo_follower is set
+ * @param dsp_buf Audio buffer to synthesize the leader to (#FLUID_BUFSIZE in length)
+ * @param follower_buf Audio buffer to synthesize the follower to (#FLUID_BUFSIZE in length)
+ * @return Count of samples written to both buffers, as for fluid_rvoice_write().
+ */
+int
+fluid_rvoice_write_stereo(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, fluid_real_t *follower_buf)
+{
+    fluid_rvoice_t *follower = voice->stereo_follower;
+    int count, is_looping;
+    fluid_real_t modenv_val, pitch;
+    fluid_profile_ref_var(prof_ref);
+
+    /* the pair is only quiet when the louder of both samples is */
+    if(voice->dsp.amplitude_that_reaches_noise_floor_nonloop > follower->dsp.amplitude_that_reaches_noise_floor_nonloop)
+    {
+        voice->dsp.amplitude_that_reaches_noise_floor_nonloop = follower->dsp.amplitude_that_reaches_noise_floor_nonloop;
+    }
+
+    if(voice->dsp.amplitude_that_reaches_noise_floor_loop > follower->dsp.amplitude_that_reaches_noise_floor_loop)
+    {
+        voice->dsp.amplitude_that_reaches_noise_floor_loop = follower->dsp.amplitude_that_reaches_noise_floor_loop;
+    }
+
+    count = fluid_rvoice_write_prepare(voice, &modenv_val, &pitch, &is_looping);
+
+    if(voice->stereo_follower == NULL)
+    {
+        /* the sample sanity check has turned the voice off */
+        fluid_rvoice_voiceoff(follower, NULL);
+        return count;
+    }
+
+    if(count <= 0)
+    {
+        fluid_rvoice_stereo_sync(voice, follower);
+        fluid_rvoice_profile(FLUID_PROF_STAGE_ENV, prof_ref, &voice, NULL, 1, FLUID_BUFSIZE);
+        return count;
+    }
+
+    fluid_rvoice_write_phase_incr(voice, fluid_ct2hz_real(pitch));
+    fluid_rvoice_stereo_sync(voice, follower);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_ENV, prof_ref, &voice, NULL, 1, FLUID_BUFSIZE);
+
+    count = fluid_rvoice_write_interpolate(&voice->dsp, dsp_buf, is_looping);
+    fluid_rvoice_write_interpolate(&follower->dsp, follower_buf, is_looping);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_INTERP, prof_ref, &voice, NULL, 1, 0);
+
+    if(count == 0)
+    {
+        return count;
+    }
+
+    fluid_rvoice_write_filter(voice, dsp_buf, count, modenv_val);
+    fluid_rvoice_write_filter(follower, follower_buf, count, modenv_val);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_FILTER, prof_ref, &voice, NULL, 1, 0);
+
+    return count;
+}
+
+/**
+ * Tell whether a voice renders its next block in the delay section of its
+ * volume envelope. It renders nothing there, see fluid_rvoice_calc_amp_cb(),
+ * so its delayed blocks may be skipped with fluid_rvoice_skip_delay()
+ * instead of being rendered and mixed one by one.
+ */
+int
+fluid_rvoice_is_delayed(const fluid_rvoice_t *voice)
+{
+    const fluid_adsr_env_t *volenv = &voice->envlfo.volenv;
+
+    /* the note cache compares the state of the voice block by block, the
+     * follower of a stereo pair is skipped along with its leader */
+    return volenv->section == FLUID_VOICE_ENVDELAY
+           && volenv->count < volenv->data[FLUID_VOICE_ENVDELAY].count
+           && voice->dsp.sample != NULL
+           && voice->note_cache_mode == FLUID_NOTE_CACHE_OFF
+           && voice->stereo_leader == NULL;
+}
+
+/**
+ * Skip the blocks of a voice in the delay section of its volume envelope, see
+ * fluid_rvoice_is_delayed(). Only the envelopes and LFOs are run, the state
+ * of the voice is the same as after rendering these quiet blocks with
+ * fluid_rvoice_write(), and of its follower as after
+ * fluid_rvoice_write_stereo().
+ *
+ * @param blockcount the count of blocks to be rendered
+ * @return the count of blocks skipped, the remaining ones must be rendered
+ */
+int
+fluid_rvoice_skip_delay(fluid_rvoice_t *voice, int blockcount)
+{
+    fluid_adsr_env_t *volenv = &voice->envlfo.volenv;
+    unsigned int count, noteoff_blocks;
+    int i;
+    fluid_profile_ref_var(prof_ref);
+
+    if(!fluid_rvoice_is_delayed(voice))
+    {
+        return 0;
+    }
+
+    if(voice->dsp.check_sample_sanity_flag)
+    {
+        if(voice->stereo_follower != NULL)
+        {
+            /* fluid_rvoice_write_stereo() turns both voices off if needed */
+            return 0;
+        }
+
+        fluid_rvoice_check_sample_sanity(voice);
+
+        if(volenv->section != FLUID_VOICE_ENVDELAY)
+        {
+            /* turned off */
+            return 0;
+        }
+    }
+
+    count = volenv->data[FLUID_VOICE_ENVDELAY].count - volenv->count;
+
+    if(count > (unsigned int)blockcount)
+    {
+        count = blockcount;
+    }
+
+    /* a noteoff ends the delay */
+    if(voice->envlfo.noteoff_ticks != 0)
+    {
+        if(voice->envlfo.ticks >= voice->envlfo.noteoff_ticks)
+        {
+            return 0;
+        }
+
+        noteoff_blocks = (voice->envlfo.noteoff_ticks - voice->envlfo.ticks + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+
+        if(count > noteoff_blocks)
+        {
+            count = noteoff_blocks;
         }
     }
 
-    /*    FLUID_LOG(FLUID_DBG, "Loop / sample sanity check: Sample from %i to %i, loop from %i to %i", voice->dsp.start, voice->dsp.end, voice->dsp.loopstart, voice->dsp.loopend); */
+    for(i = 0; i < (int)count; i++)
+    {
+        int ticks = voice->envlfo.ticks;
 
-    /* Sample sanity has been assured. Don't check again, until some
-       sample parameter is changed by modulation. */
-    voice->dsp.check_sample_sanity_flag = 0;
-#if 0
-    printf("Sane? playback loop from %i to %i\n", voice->dsp.loopstart, voice->dsp.loopend);
-#endif
-    fluid_check_fpe("voice_check_sample_sanity");
+        voice->envlfo.ticks += FLUID_BUFSIZE;
+        fluid_adsr_env_calc(volenv, 1);
+        fluid_adsr_env_calc(&voice->envlfo.modenv, 0);
+        fluid_lfo_calc(&voice->envlfo.modlfo, ticks);
+        fluid_lfo_calc(&voice->envlfo.viblfo, ticks);
+    }
+
+    /* a quiet voice is not delayed any longer */
+    voice->dsp.start_offset = 0;
+
+    if(voice->stereo_follower != NULL)
+    {
+        fluid_rvoice_stereo_sync(voice, voice->stereo_follower);
+    }
+
+    fluid_rvoice_profile(FLUID_PROF_STAGE_ENV, prof_ref, &voice, NULL, 1, count * FLUID_BUFSIZE);
+
+    return count;
+}
+
+/**
+ * Save the rendering state of a voice for fluid_synth_save_state(), see
+ * fluid_rvoice_state_t.
+ */
+void
+fluid_rvoice_save_state(const fluid_rvoice_t *voice, fluid_rvoice_state_t *state)
+{
+    const fluid_rvoice_dsp_t *dsp = &voice->dsp;
+    unsigned int i;
+
+    FLUID_MEMSET(state, 0, sizeof(*state));
+    state->phase = dsp->phase;
+    state->phase_incr = dsp->phase_incr;
+    state->amp = dsp->amp;
+    state->amp_incr = dsp->amp_incr;
+    state->interp_method = dsp->interp_method;
+    state->requested_interp_method = dsp->requested_interp_method;
+    state->prev_interp_method = dsp->prev_interp_method;
+    state->qos_amp = dsp->qos_amp;
+    state->qos_release_blocks = dsp->qos_release_blocks;
+    state->has_looped = dsp->has_looped;
+    state->start_offset = dsp->start_offset;
+    state->pitchoffset = dsp->pitchoffset;
+    state->pitchinc = dsp->pitchinc;
+    state->pitch = dsp->pitch;
+    state->root_pitch_incr = dsp->root_pitch_incr;
+    state->attenuation = dsp->attenuation;
+    state->prev_attenuation = dsp->prev_attenuation;
+    state->min_attenuation_cB = dsp->min_attenuation_cB;
+    state->amplitude_that_reaches_noise_floor_nonloop = dsp->amplitude_that_reaches_noise_floor_nonloop;
+    state->amplitude_that_reaches_noise_floor_loop = dsp->amplitude_that_reaches_noise_floor_loop;
+    state->synth_gain = dsp->synth_gain;
+    state->resonant_filter = voice->resonant_filter;
+    state->resonant_custom_filter = voice->resonant_custom_filter;
+
+    for(i = 0; i < voice->buffers.count && i < FLUID_RVOICE_MAX_BUFS; i++)
+    {
+        state->buffer_amp[i] = voice->buffers.bufs[i].amp;
+    }
+
+    state->envlfo = voice->envlfo;
+}
+
+static int
+fluid_rvoice_is_interp_method(int method)
+{
+    return method == FLUID_INTERP_NONE || method == FLUID_INTERP_LINEAR
+           || method == FLUID_INTERP_4THORDER || method == FLUID_INTERP_7THORDER;
 }
 
+/* Restore the state of a filter, keeping its type and flags */
+static void
+fluid_rvoice_load_filter_state(fluid_iir_filter_t *filter, const fluid_iir_filter_t *state)
+{
+    enum fluid_iir_filter_type type = filter->type;
+    enum fluid_iir_filter_flags flags = filter->flags;
+
+    *filter = *state;
+    filter->type = type;
+    filter->flags = flags;
+}
 
 /**
- * Synthesize a voice to a buffer.
- *
- * @param voice rvoice to synthesize
- * @param dsp_buf Audio buffer to synthesize to (#FLUID_BUFSIZE in length)
- * @return Count of samples written to dsp_buf. (-1 means voice is currently
- * quiet, 0 .. #FLUID_BUFSIZE-1 means voice finished.)
- *
- * Panning, reverb and chorus are processed separately. The dsp interpolation
- * routine is in (fluid_rvoice_dsp.c).
+ * Continue rendering from the state of a voice saved by fluid_rvoice_save_state(),
+ * possibly by another synth: its position in the sample, its envelopes, LFOs,
+ * filters and amplitudes. The voice must have been started for the same sample
+ * and generators as the voice saving the state, and not rendered yet: its sample
+ * and loop points are kept, and the position saved must lie within them. It is
+ * left unpaired from the other voice of a stereo sample, see
+ * fluid_rvoice_set_stereo_follower() to pair them again, and doesn't record to
+ * the note cache.
+ * @return FLUID_OK on success, FLUID_FAILED if the state doesn't fit the voice,
+ * which is left as it is then
  */
 int
-fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+fluid_rvoice_load_state(fluid_rvoice_t *voice, const fluid_rvoice_state_t *state)
 {
-    int ticks = voice->envlfo.ticks;
-    int count, is_looping;
-    fluid_real_t modenv_val;
-
-    /******************* sample sanity check **********/
+    fluid_rvoice_dsp_t *dsp = &voice->dsp;
+    int index = (int)fluid_phase_index(state->phase);
+    int looping;
+    unsigned int i;
 
-    if(!voice->dsp.sample)
+    if(!fluid_rvoice_is_interp_method(state->interp_method)
+            || !fluid_rvoice_is_interp_method(state->requested_interp_method)
+            || !fluid_rvoice_is_interp_method(state->prev_interp_method)
+            || state->envlfo.volenv.section < 0 || state->envlfo.volenv.section >= FLUID_VOICE_ENVFINISHED
+            || state->envlfo.modenv.section < 0 || state->envlfo.modenv.section >= FLUID_VOICE_ENVLAST
+            || state->start_offset >= FLUID_BUFSIZE)
     {
-        return 0;
+        return FLUID_FAILED;
     }
 
-    if(voice->dsp.check_sample_sanity_flag)
+    /* the sample and loop points of the voice, as the voice saving the state played them */
+    if(dsp->check_sample_sanity_flag)
     {
         fluid_rvoice_check_sample_sanity(voice);
     }
 
-    /******************* noteoff check ****************/
-
-    if(voice->envlfo.noteoff_ticks != 0 &&
-            voice->envlfo.ticks >= voice->envlfo.noteoff_ticks)
+    if(dsp->start >= dsp->end || index < dsp->start || index > dsp->end)
     {
-        fluid_rvoice_noteoff_LOCAL(voice, 0);
+        return FLUID_FAILED;
     }
 
-    voice->envlfo.ticks += FLUID_BUFSIZE;
-
-    /******************* vol env **********************/
-
-    fluid_adsr_env_calc(&voice->envlfo.volenv, 1);
-    fluid_check_fpe("voice_write vol env");
+    /* A looping voice gets past the end of its loop by one increment at most: a block
+     * filled up on the last points of the loop leaves the wrap around to the next one. */
+    looping = (dsp->samplemode == FLUID_LOOP_UNTIL_RELEASE && state->envlfo.volenv.section < FLUID_VOICE_ENVRELEASE)
+              || dsp->samplemode == FLUID_LOOP_DURING_RELEASE;
 
-    if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVFINISHED)
+    if(looping && !(state->phase_incr >= 0 && index <= dsp->loopend + state->phase_incr))
     {
-        return 0;
+        return FLUID_FAILED;
     }
 
-    /******************* mod env **********************/
-
-    fluid_adsr_env_calc(&voice->envlfo.modenv, 0);
-    fluid_check_fpe("voice_write mod env");
-
-    /******************* lfo **********************/
+    dsp->phase = state->phase;
+    dsp->phase_incr = state->phase_incr;
+    dsp->amp = state->amp;
+    dsp->amp_incr = state->amp_incr;
+    dsp->interp_method = (enum fluid_interp)state->interp_method;
+    dsp->requested_interp_method = (enum fluid_interp)state->requested_interp_method;
+    dsp->prev_interp_method = (enum fluid_interp)state->prev_interp_method;
+    dsp->qos_amp = state->qos_amp;
+    dsp->qos_release_blocks = state->qos_release_blocks;
+    dsp->has_looped = (state->has_looped != 0);
+    dsp->start_offset = state->start_offset;
+    dsp->pitchoffset = state->pitchoffset;
+    dsp->pitchinc = state->pitchinc;
+    dsp->pitch = state->pitch;
+    dsp->root_pitch_incr = state->root_pitch_incr;
+    dsp->attenuation = state->attenuation;
+    dsp->prev_attenuation = state->prev_attenuation;
+    dsp->min_attenuation_cB = state->min_attenuation_cB;
+    dsp->amplitude_that_reaches_noise_floor_nonloop = state->amplitude_that_reaches_noise_floor_nonloop;
+    dsp->amplitude_that_reaches_noise_floor_loop = state->amplitude_that_reaches_noise_floor_loop;
+    dsp->synth_gain = state->synth_gain;
+    fluid_rvoice_load_filter_state(&voice->resonant_filter, &state->resonant_filter);
+    fluid_rvoice_load_filter_state(&voice->resonant_custom_filter, &state->resonant_custom_filter);
+
+    for(i = 0; i < voice->buffers.count && i < FLUID_RVOICE_MAX_BUFS; i++)
+    {
+        voice->buffers.bufs[i].amp = state->buffer_amp[i];
+    }
 
-    fluid_lfo_calc(&voice->envlfo.modlfo, ticks);
-    fluid_check_fpe("voice_write mod LFO");
-    fluid_lfo_calc(&voice->envlfo.viblfo, ticks);
-    fluid_check_fpe("voice_write vib LFO");
+    voice->envlfo = state->envlfo;
 
-    /******************* amplitude **********************/
+    fluid_rvoice_unlink_stereo(voice);
+    voice->note_cache = NULL;
+    voice->note_cache_chunk = NULL;
+    voice->note_cache_block = 0;
+    voice->note_cache_mode = FLUID_NOTE_CACHE_OFF;
 
-    count = fluid_rvoice_calc_amp(voice);
+    return FLUID_OK;
+}
 
-    if(count <= 0)
+/**
+ * Dissolve the stereo pair of a voice, both voices are rendered on their own
+ * from now on. The follower continues from the state of its leader.
+ */
+void
+fluid_rvoice_unlink_stereo(fluid_rvoice_t *voice)
+{
+    if(voice->stereo_follower != NULL)
     {
-        return count; /* return -1 if voice is quiet, 0 if voice has finished */
+        voice->stereo_follower->stereo_leader = NULL;
+        voice->stereo_follower = NULL;
     }
 
-    /******************* phase **********************/
-
-    /* SF2.04 section 8.1.2 #26:
-     * attack of modEnv is convex ?!?
-     */
-    modenv_val = (fluid_adsr_env_get_section(&voice->envlfo.modenv) == FLUID_VOICE_ENVATTACK)
-                 ? fluid_convex(127 * fluid_adsr_env_get_val(&voice->envlfo.modenv))
-                 : fluid_adsr_env_get_val(&voice->envlfo.modenv);
-    /* Calculate the number of samples, that the DSP loop advances
-     * through the original waveform with each step in the output
-     * buffer. It is the ratio between the frequencies of original
-     * waveform and output waveform.*/
-    voice->dsp.phase_incr = fluid_ct2hz_real(voice->dsp.pitch +
-                            voice->dsp.pitchoffset +
-                            fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_pitch
-                            + fluid_lfo_get_val(&voice->envlfo.viblfo) * voice->envlfo.viblfo_to_pitch
-                            + modenv_val * voice->envlfo.modenv_to_pitch)
-                            / voice->dsp.root_pitch_hz;
-
-    /******************* portamento ****************/
-    /* pitchoffset is updated if enabled.
-       Pitchoffset will be added to dsp pitch at next phase calculation time */
+    if(voice->stereo_leader != NULL)
+    {
+        voice->stereo_leader->stereo_follower = NULL;
+        voice->stereo_leader = NULL;
+    }
+}
 
-    /* In most cases portamento will be disabled. Thus first verify that portamento is
-     * enabled before updating pitchoffset and before disabling portamento when necessary,
-     * in order to keep the performance loss at minimum.
-     * If the algorithm would first update pitchoffset and then verify if portamento
-     * needs to be disabled, there would be a significant performance drop on a x87 FPU
-     */
-    if(voice->dsp.pitchinc > 0.0f)
+/**
+ * Synthesize a block of several voices. The result is the same as calling
+ * fluid_rvoice_write() for each voice, but the voices are processed stage by
+ * stage: the control rate updates (envelopes, LFOs, amplitude) of all voices
+ * run first, with one vectorized pass converting their attenuations to
+ * amplitudes, followed by one converting their pitches, before
+ * any of them is interpolated. The resonant filters of the voices are run side
+ * by side. If the voices play the same sample with the same interpolation
+ * method, the sample data are also only streamed through the cache once.
+ *
+ * @param voices rvoices to synthesize (at most #FLUID_RVOICE_BATCH_MAX)
+ * @param dsp_bufs Audio buffers to synthesize to, one for each voice (#FLUID_BUFSIZE in length)
+ * @param counts Location to store the return value of fluid_rvoice_write() for each voice
+ * @param voice_count Number of voices
+ * @param same_sample TRUE if all voices play the same sample with the same interpolation method
+ */
+void
+fluid_rvoice_write_batch(fluid_rvoice_t **voices, fluid_real_t **dsp_bufs, int *counts, int voice_count,
+                         int same_sample)
+{
+    fluid_rvoice_dsp_t *dsp[FLUID_RVOICE_BATCH_MAX];
+    fluid_iir_filter_t *filters[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t *bufs[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t modenv_val[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t pitch[FLUID_RVOICE_BATCH_MAX];
+    int is_looping[FLUID_RVOICE_BATCH_MAX];
+    int index[FLUID_RVOICE_BATCH_MAX];
+    int batch_counts[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t amp[FLUID_RVOICE_BATCH_MAX * FLUID_RVOICE_AMP_CB_COUNT];
+    int i, k, a = 0, n = 0, m = 0;
+    fluid_profile_ref_var(prof_ref);
+
+    /* the envelopes and LFOs of all voices, then their attenuations converted
+     * to amplitudes in one pass */
+    for(i = 0; i < voice_count; i++)
     {
-        /* portamento is enabled, so update pitchoffset */
-        voice->dsp.pitchoffset += voice->dsp.pitchinc;
+        counts[i] = fluid_rvoice_write_prepare_env(voices[i]);
 
-        /* when pitchoffset reaches 0.0f, portamento is disabled */
-        if(voice->dsp.pitchoffset > 0.0f)
+        if(counts[i] > 0)
         {
-            voice->dsp.pitchoffset = voice->dsp.pitchinc = 0.0f;
+            counts[i] = fluid_rvoice_calc_amp_cb(voices[i], &amp[a * FLUID_RVOICE_AMP_CB_COUNT]);
+
+            if(counts[i] > 0)
+            {
+                index[a++] = i;
+            }
+            else
+            {
+                /* a quiet voice is not delayed any longer */
+                voices[i]->dsp.start_offset = 0;
+            }
         }
     }
-    else if(voice->dsp.pitchinc < 0.0f)
+
+    fluid_cb2amp_batch(amp, a * FLUID_RVOICE_AMP_CB_COUNT);
+
+    for(k = 0; k < a; k++)
     {
-        /* portamento is enabled, so update pitchoffset */
-        voice->dsp.pitchoffset += voice->dsp.pitchinc;
+        i = index[k];
+        counts[i] = fluid_rvoice_calc_amp_finish(voices[i], &amp[k * FLUID_RVOICE_AMP_CB_COUNT]);
 
-        /* when pitchoffset reaches 0.0f, portamento is disabled */
-        if(voice->dsp.pitchoffset < 0.0f)
+        if(counts[i] <= 0)
         {
-            voice->dsp.pitchoffset = voice->dsp.pitchinc = 0.0f;
+            voices[i]->dsp.start_offset = 0;
+            continue;
         }
+
+        fluid_rvoice_write_prepare_phase(voices[i], &modenv_val[n], &pitch[n], &is_looping[n]);
+        dsp[n] = &voices[i]->dsp;
+        bufs[n] = dsp_bufs[i];
+        index[n++] = i;
     }
 
-    fluid_check_fpe("voice_write phase calculation");
+    /* the pitches from cents to Hz */
+    fluid_ct2hz_real_batch(pitch, n);
 
-    /* if phase_incr is not advancing, set it to the minimum fraction value (prevent stuckage) */
-    if(voice->dsp.phase_incr == 0)
+    for(i = 0; i < n; i++)
     {
-        voice->dsp.phase_incr = 1;
+        fluid_rvoice_write_phase_incr(voices[index[i]], pitch[i]);
     }
 
-    /* voice is currently looping? */
-    is_looping = voice->dsp.samplemode == FLUID_LOOP_DURING_RELEASE
-                 || (voice->dsp.samplemode == FLUID_LOOP_UNTIL_RELEASE
-                     && fluid_adsr_env_get_section(&voice->envlfo.volenv) < FLUID_VOICE_ENVRELEASE);
-
-    /*********************** run the dsp chain ************************
-     * The sample is mixed with the output buffer.
-     * The buffer has to be filled from 0 to FLUID_BUFSIZE-1.
-     * Depending on the position in the loop and the loop size, this
-     * may require several runs. */
+    fluid_rvoice_profile(FLUID_PROF_STAGE_ENV, prof_ref, voices, NULL, voice_count, FLUID_BUFSIZE);
 
-    switch(voice->dsp.interp_method)
+    /* the interpolation methods may have changed since the mixer grouped the voices,
+     * and a voice switching to another one is crossfaded on its own.
+     * Copying the sample frames of a voice at its original pitch is cheaper anyway,
+     * and streamed samples are read from memory by fluid_rvoice_interpolate(). */
+    for(i = 0; same_sample && i < n; i++)
     {
-    case FLUID_INTERP_NONE:
-        count = fluid_rvoice_dsp_interpolate_none(&voice->dsp, dsp_buf, is_looping);
-        break;
-
-    case FLUID_INTERP_LINEAR:
-        count = fluid_rvoice_dsp_interpolate_linear(&voice->dsp, dsp_buf, is_looping);
-        break;
+        same_sample = dsp[i]->interp_method == dsp[0]->interp_method
+                      && dsp[i]->prev_interp_method == dsp[i]->interp_method
+                      && !fluid_rvoice_is_unpitched(dsp[i])
+                      && dsp[i]->sample->stream_data == NULL;
+    }
 
-    case FLUID_INTERP_4THORDER:
-    default:
-        count = fluid_rvoice_dsp_interpolate_4th_order(&voice->dsp, dsp_buf, is_looping);
-        break;
+    if(n > 1 && same_sample)
+    {
+        fluid_rvoice_dsp_interpolate_batch(dsp, bufs, is_looping, batch_counts, n);
+        fluid_check_fpe("voice_write interpolation");
 
-    case FLUID_INTERP_7THORDER:
-        count = fluid_rvoice_dsp_interpolate_7th_order(&voice->dsp, dsp_buf, is_looping);
-        break;
+        for(i = 0; i < n; i++)
+        {
+            fluid_rvoice_write_start_offset(dsp[i], bufs[i]);
+        }
+    }
+    else
+    {
+        for(i = 0; i < n; i++)
+        {
+            batch_counts[i] = fluid_rvoice_write_interpolate(dsp[i], bufs[i], is_looping[i]);
+        }
     }
 
-    fluid_check_fpe("voice_write interpolation");
+    fluid_rvoice_profile(FLUID_PROF_STAGE_INTERP, prof_ref, voices, index, n, 0);
 
-    if(count == 0)
+    /* drop the voices, which have finished without rendering anything */
+    for(i = 0; i < n; i++)
     {
-        return count;
+        fluid_rvoice_t *voice = voices[index[i]];
+
+        counts[index[i]] = batch_counts[i];
+
+        if(batch_counts[i] != 0)
+        {
+            fluid_iir_filter_calc(&voice->resonant_filter, voice->dsp.output_rate,
+                                  fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc +
+                                  modenv_val[i] * voice->envlfo.modenv_to_fc);
+            fluid_iir_filter_calc(&voice->resonant_custom_filter, voice->dsp.output_rate, 0);
+
+            index[m] = index[i];
+            bufs[m] = bufs[i];
+            batch_counts[m++] = batch_counts[i];
+        }
     }
 
     /*************** resonant filter ******************/
+    for(i = 0; i < m; i++)
+    {
+        filters[i] = &voices[index[i]]->resonant_filter;
+    }
 
-    fluid_iir_filter_calc(&voice->resonant_filter, voice->dsp.output_rate,
-                          fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc +
-                          modenv_val * voice->envlfo.modenv_to_fc);
-
-    fluid_iir_filter_apply(&voice->resonant_filter, dsp_buf, count);
+    fluid_iir_filter_apply_batch(filters, bufs, batch_counts, m);
 
     /* additional custom filter - only uses the fixed modulator, no lfos... */
-    fluid_iir_filter_calc(&voice->resonant_custom_filter, voice->dsp.output_rate, 0);
-    fluid_iir_filter_apply(&voice->resonant_custom_filter, dsp_buf, count);
+    for(i = 0; i < m; i++)
+    {
+        filters[i] = &voices[index[i]]->resonant_custom_filter;
+    }
 
-    return count;
+    fluid_iir_filter_apply_batch(filters, bufs, batch_counts, m);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_FILTER, prof_ref, voices, index, m, 0);
 }
 
 /**
@@ -530,11 +1602,22 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping)
 }
 
 
+/**
+ * Prepare a voice for a new note.
+ *
+ * @param param[0].i MIDI channel of the note, see fluid_rvoice_mixer_channel_off()
+ */
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_reset)
 {
     fluid_rvoice_t *voice = obj;
 
+    voice->chan = param[0].i;
+
+    /* the mixer has dissolved the stereo pair of the previous note already */
+    voice->stereo_follower = voice->stereo_leader = NULL;
+
     voice->dsp.has_looped = 0;
+    voice->dsp.start_offset = 0;
     voice->envlfo.ticks = 0;
     voice->envlfo.noteoff_ticks = 0;
     voice->dsp.amp = 0.0f; /* The last value of the volume envelope, used to
@@ -578,6 +1661,12 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_noteoff)
 static void
 fluid_rvoice_noteoff_LOCAL(fluid_rvoice_t *voice, unsigned int min_ticks)
 {
+    /* a voice turned off, e.g. by all sounds off, isn't brought back to release */
+    if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVFINISHED)
+    {
+        return;
+    }
+
     if(min_ticks > voice->envlfo.ticks)
     {
         /* Delay noteoff */
@@ -765,7 +1854,43 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_method)
     fluid_rvoice_t *voice = obj;
     int value = param[0].i;
 
-    voice->dsp.interp_method = value;
+    voice->dsp.requested_interp_method = value;
+
+    /* a playing voice switches to it with its next block */
+    if(voice->envlfo.ticks == 0)
+    {
+        voice->dsp.interp_method = value;
+    }
+}
+
+/**
+ * Configure the interpolation quality of service of a voice,
+ * see fluid_rvoice_write_interp_qos().
+ *
+ * @param param[0].i count of blocks in the release stage, after which the voice
+ * is rendered with linear interpolation, -1 to disable
+ * @param param[1].real linear amplitude below which the voice is rendered with
+ * linear interpolation, 0 to disable
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_qos)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->dsp.qos_release_blocks = param[0].i;
+    voice->dsp.qos_amp = param[1].real;
+}
+
+/**
+ * Select the precision of the interpolation of a voice.
+ *
+ * @param param[0].i TRUE to interpolate in single precision, FALSE in the
+ * precision of fluid_real_t
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_dsp_precision)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->dsp.single_precision = (char)param[0].i;
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz)
@@ -773,7 +1898,8 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz)
     fluid_rvoice_t *voice = obj;
     fluid_real_t value = param[0].real;
 
-    voice->dsp.root_pitch_hz = value;
+    /* fluid_ct2hz_real() returns at least 1 Hz, but be safe against bad sample rates */
+    voice->dsp.root_pitch_incr = (value > 0) ? (fluid_real_t)1.0 / value : 0;
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_pitch)
@@ -912,6 +2038,14 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_samplemode)
 }
 
 
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_offset)
+{
+    fluid_rvoice_t *voice = obj;
+    int value = param[0].i;
+
+    voice->dsp.start_offset = value;
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample)
 {
     fluid_rvoice_t *voice = obj;
@@ -925,12 +2059,86 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample)
     }
 }
 
+/**
+ * Pair a voice with the other voice of a stereo sample, which is rendered
+ * along with it from now on, see fluid_rvoice_write_stereo(). Both voices
+ * must be in the same state, apart from their samples, filters and buffers.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_stereo_follower)
+{
+    fluid_rvoice_t *voice = obj;
+    fluid_rvoice_t *follower = param[0].ptr;
+
+    if(voice->stereo_follower == NULL && voice->stereo_leader == NULL
+            && follower->stereo_follower == NULL && follower->stereo_leader == NULL)
+    {
+        voice->stereo_follower = follower;
+        follower->stereo_leader = voice;
+    }
+}
+
+/**
+ * Tell a voice the note it plays, published by fluid_rvoice_mixer_get_snapshot().
+ *
+ * @param param[0].i MIDI channel
+ * @param param[1].i MIDI note
+ * @param param[2].i MIDI velocity
+ * @param param[3].i ID of the voice
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_note)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->chan = param[0].i;
+    voice->key = param[1].i;
+    voice->vel = param[2].i;
+    voice->id = (unsigned int)param[3].i;
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_voiceoff)
 {
     fluid_rvoice_t *voice = obj;
 
+    /* the other voice of a stereo pair keeps playing */
+    fluid_rvoice_unlink_stereo(voice);
+
     fluid_adsr_env_set_section(&voice->envlfo.volenv, FLUID_VOICE_ENVFINISHED);
     fluid_adsr_env_set_section(&voice->envlfo.modenv, FLUID_VOICE_ENVFINISHED);
 }
 
+#ifdef WITH_PROFILING
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_profile_index)
+{
+    fluid_rvoice_t *voice = obj;
+    int value = param[0].i;
+
+    voice->profile_index = value;
+}
+
+/**
+ * Charge the time spent since \c ref to a rendering stage of some voices.
+ * The time is evenly shared between the voices and added to the profiling
+ * data of the presets they were started from.
+ *
+ * @param stage The rendering stage (FLUID_PROF_STAGE_*)
+ * @param ref Time reference, set to the current time
+ * @param voices rvoices (at most #FLUID_RVOICE_BATCH_MAX)
+ * @param index Indexes of the rendered voices in \c voices, NULL for the first \c voice_count
+ * @param voice_count Number of rendered voices
+ * @param samples Number of audio samples rendered by each voice
+ */
+void
+fluid_rvoice_profile_stage(int stage, double *ref, fluid_rvoice_t **voices, const int *index,
+                           int voice_count, unsigned int samples)
+{
+    int presets[FLUID_RVOICE_BATCH_MAX];
+    int i;
+
+    for(i = 0; i < voice_count; i++)
+    {
+        presets[i] = voices[index ? index[i] : i]->profile_index;
+    }
 
+    fluid_profile_presets(stage, *ref, presets, voice_count, samples);
+}
+#endif
@@ -28,11 +28,14 @@
 #include "fluid_lfo.h"
 #include "fluid_phase.h"
 #include "fluid_sfont.h"
+#include "fluid_samplestream.h"
 
 typedef struct _fluid_rvoice_envlfo_t fluid_rvoice_envlfo_t;
 typedef struct _fluid_rvoice_dsp_t fluid_rvoice_dsp_t;
 typedef struct _fluid_rvoice_buffers_t fluid_rvoice_buffers_t;
 typedef struct _fluid_rvoice_t fluid_rvoice_t;
+typedef struct _fluid_note_cache_entry_t fluid_note_cache_entry_t;
+typedef struct _fluid_note_cache_chunk_t fluid_note_cache_chunk_t;
 
 /* Smallest amplitude that can be perceived (full scale is +/- 0.5)
  * 16 bits => 96+4=100 dB dynamic range => 0.00001
@@ -41,6 +44,9 @@ typedef struct _fluid_rvoice_t fluid_rvoice_t;
  */
 #define FLUID_NOISE_FLOOR ((fluid_real_t)2.e-7)
 
+/* Maximum number of voices synthesized at once by fluid_rvoice_write_batch() */
+#define FLUID_RVOICE_BATCH_MAX 8
+
 enum fluid_loop
 {
     FLUID_UNLOOPED = 0,
@@ -83,17 +89,17 @@ struct _fluid_rvoice_envlfo_t
  */
 struct _fluid_rvoice_dsp_t
 {
-    /* interpolation method, as in fluid_interp in fluidsynth.h */
-    enum fluid_interp interp_method;
-    enum fluid_loop samplemode;
+    /* The fields read by the interpolators come first, so that rendering a block
+     * touches as few cache lines of the voice as possible. */
 
-    /* Flag that is set as soon as the first loop is completed. */
-    char has_looped;
+    fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
+    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
 
-    /* Flag that initiates, that sample-related parameters have to be checked. */
-    char check_sample_sanity_flag;
+    fluid_real_t amp;                /* current linear amplitude */
+    fluid_real_t amp_incr;		/* amplitude increment value for the next FLUID_BUFSIZE samples */
 
     fluid_sample_t *sample;
+    fluid_sample_stream_t *stream;   /* the ring buffer the sample is streamed into, if any */
 
     /* sample and loop start and end points (offset in sample memory).  */
     int start;
@@ -101,6 +107,31 @@ struct _fluid_rvoice_dsp_t
     int loopstart;
     int loopend;	/* Note: first point following the loop (superimposed on loopstart) */
 
+    /* interpolation method, as in fluid_interp in fluidsynth.h, used for the next block */
+    enum fluid_interp interp_method;
+    enum fluid_interp requested_interp_method; /* the method set by the synth */
+    enum fluid_interp prev_interp_method;      /* the method used for the previous block */
+
+    /* Quality of service: quiet voices and voices having been released for
+     * long enough are rendered with linear interpolation,
+     * see fluid_rvoice_write_interp_qos() */
+    fluid_real_t qos_amp;            /* amplitude below which a voice is quiet, 0 if disabled */
+    int qos_release_blocks;          /* count of blocks after the release, -1 if disabled */
+    enum fluid_loop samplemode;
+
+    /* Flag that is set as soon as the first loop is completed. */
+    char has_looped;
+
+    /* Flag that initiates, that sample-related parameters have to be checked. */
+    char check_sample_sanity_flag;
+
+    /* Flag set to interpolate the bulk of the sample in single precision, see synth.dsp-precision */
+    char single_precision;
+
+    /* Number of silent frames at the beginning of the first block of the voice,
+     * for voices started in the middle of a block. */
+    unsigned int start_offset;
+
     /* Stuff needed for portamento calculations */
     fluid_real_t pitchoffset;        /* the portamento range in midicents */
     fluid_real_t pitchinc;           /* the portamento increment in midicents */
@@ -108,7 +139,7 @@ struct _fluid_rvoice_dsp_t
     /* Stuff needed for phase calculations */
 
     fluid_real_t pitch;              /* the pitch in midicents */
-    fluid_real_t root_pitch_hz;
+    fluid_real_t root_pitch_incr;    /* the reciprocal of the root pitch in Hz, scaled by the sample rate ratio */
     fluid_real_t output_rate;
 
     /* Stuff needed for amplitude calculations */
@@ -121,14 +152,6 @@ struct _fluid_rvoice_dsp_t
     fluid_real_t amplitude_that_reaches_noise_floor_nonloop;
     fluid_real_t amplitude_that_reaches_noise_floor_loop;
     fluid_real_t synth_gain; 	/* master gain */
-
-    /* Dynamic input to the interpolator below */
-
-    fluid_real_t amp;                /* current linear amplitude */
-    fluid_real_t amp_incr;		/* amplitude increment value for the next FLUID_BUFSIZE samples */
-
-    fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
-    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
 };
 
 /* Currently left, right, reverb, chorus. To be changed if we
@@ -154,15 +177,91 @@ struct _fluid_rvoice_buffers_t
  */
 struct _fluid_rvoice_t
 {
-    fluid_rvoice_envlfo_t envlfo;
+    /* ordered by how often they are accessed while rendering, the dsp fields on every sample */
     fluid_rvoice_dsp_t dsp;
     fluid_iir_filter_t resonant_filter; /* IIR resonant dsp filter */
     fluid_iir_filter_t resonant_custom_filter; /* optional custom/general-purpose IIR resonant filter */
     fluid_rvoice_buffers_t buffers;
+    fluid_rvoice_envlfo_t envlfo;
+
+    /* the other voice of a stereo pair, rendered in the same pass as this one,
+     * see fluid_rvoice_write_stereo(). Only one of them is set. */
+    fluid_rvoice_t *stereo_follower; /* the voice rendered along with this one */
+    fluid_rvoice_t *stereo_leader;   /* the voice rendering this one */
+
+    /* the note played by the voice, see fluid_rvoice_mixer_get_snapshot().
+     * The channel is always set, by fluid_rvoice_reset(). */
+    int chan;
+    int key;
+    int vel;
+    unsigned int id;
+
+    /* the rendered note the voice records or plays back, see fluid_note_cache_write() */
+    fluid_note_cache_entry_t *note_cache;
+    fluid_note_cache_chunk_t *note_cache_chunk; /* the chunk of the next block */
+    int note_cache_block;            /* index of the next block in the note */
+    int note_cache_mode;             /* see #fluid_note_cache_mode */
+
+#ifdef WITH_PROFILING
+    int profile_index; /* preset index in fluid_profile_preset_data, -1 if not profiled */
+#endif
 };
 
 
+/*
+ * The rendering state of a voice saved by fluid_synth_save_state(): what changes
+ * while it plays. The sample, the sample and loop points, the buffers mapping
+ * and the filter types are the ones of the voice it is restored to, see
+ * fluid_rvoice_load_state().
+ */
+typedef struct
+{
+    fluid_phase_t phase;
+    fluid_real_t phase_incr;
+    fluid_real_t amp;
+    fluid_real_t amp_incr;
+    int interp_method;
+    int requested_interp_method;
+    int prev_interp_method;
+    fluid_real_t qos_amp;
+    int qos_release_blocks;
+    int has_looped;
+    unsigned int start_offset;
+    fluid_real_t pitchoffset;
+    fluid_real_t pitchinc;
+    fluid_real_t pitch;
+    fluid_real_t root_pitch_incr;
+    fluid_real_t attenuation;
+    fluid_real_t prev_attenuation;
+    fluid_real_t min_attenuation_cB;
+    fluid_real_t amplitude_that_reaches_noise_floor_nonloop;
+    fluid_real_t amplitude_that_reaches_noise_floor_loop;
+    fluid_real_t synth_gain;
+    fluid_iir_filter_t resonant_filter;
+    fluid_iir_filter_t resonant_custom_filter;
+    fluid_real_t buffer_amp[FLUID_RVOICE_MAX_BUFS];
+    fluid_rvoice_envlfo_t envlfo;
+} fluid_rvoice_state_t;
+
+/*
+ * Storage for rvoices in one contiguous block, each of them starting on a cache line
+ */
+typedef struct _fluid_rvoice_slab_t fluid_rvoice_slab_t;
+
+fluid_rvoice_slab_t *new_fluid_rvoice_slab(int count);
+void delete_fluid_rvoice_slab(fluid_rvoice_slab_t *slab);
+fluid_rvoice_t *fluid_rvoice_slab_get(fluid_rvoice_slab_t *slab, int index);
+
 int fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
+int fluid_rvoice_write_unfiltered(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
+void fluid_rvoice_write_batch(fluid_rvoice_t **voices, fluid_real_t **dsp_bufs, int *counts, int voice_count,
+                              int same_sample);
+int fluid_rvoice_write_stereo(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, fluid_real_t *follower_buf);
+void fluid_rvoice_unlink_stereo(fluid_rvoice_t *voice);
+void fluid_rvoice_save_state(const fluid_rvoice_t *voice, fluid_rvoice_state_t *state);
+int fluid_rvoice_load_state(fluid_rvoice_t *voice, const fluid_rvoice_state_t *state);
+int fluid_rvoice_is_delayed(const fluid_rvoice_t *voice);
+int fluid_rvoice_skip_delay(fluid_rvoice_t *voice, int blockcount);
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_amp);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping);
@@ -174,6 +273,8 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_multi_retrigger_attack);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_portamento);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_output_rate);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_method);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_qos);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_dsp_precision);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_pitch);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_attenuation);
@@ -190,14 +291,35 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_end);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_loopstart);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_loopend);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_samplemode);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_offset);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_stereo_follower);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_note);
+
+#ifdef WITH_PROFILING
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_profile_index);
+
+void fluid_rvoice_profile_stage(int stage, double *ref, fluid_rvoice_t **voices, const int *index,
+                                int voice_count, unsigned int samples);
+
+/* Charges the time spent since _ref to a rendering stage of the voices _voices[_index[i]]
+ * (or _voices[i] if _index is NULL), see fluid_rvoice_profile_stage() */
+#define fluid_rvoice_profile(_stage, _ref, _voices, _index, _count, _samples) \
+    fluid_rvoice_profile_stage(_stage, &(_ref), _voices, _index, _count, _samples)
+#else
+#define fluid_rvoice_profile(_stage, _ref, _voices, _index, _count, _samples)
+#endif
 
 /* defined in fluid_rvoice_dsp.c */
 void fluid_rvoice_dsp_config(void);
+void fluid_rvoice_dsp_dispatch_config(void);
+int fluid_rvoice_dsp_copy(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
 int fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
 int fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
 int fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
 int fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
+void fluid_rvoice_dsp_interpolate_batch(fluid_rvoice_dsp_t **voices, fluid_real_t **dsp_bufs,
+                                        const int *is_looping, int *counts, int voice_count);
 
 
 /*
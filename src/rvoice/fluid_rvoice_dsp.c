@@ -21,7 +21,13 @@
 #include "fluid_sys.h"
 #include "fluid_phase.h"
 #include "fluid_rvoice.h"
+#include "fluid_rvoice_dsp_tables.h"
+
+#ifdef ENABLE_RUNTIME_TABLES
+#include "gentables/gen_rvoice_dsp.c"
+#else
 #include "fluid_rvoice_dsp_tables.c"
+#endif
 
 /* Purpose:
  *
@@ -54,6 +60,932 @@ fluid_rvoice_get_float_sample(const short int *dsp_msb, const char *dsp_lsb, uns
     return (fluid_real_t)sample;
 }
 
+static FLUID_INLINE float
+fluid_rvoice_get_single_sample(const short int *dsp_msb, const char *dsp_lsb, unsigned int idx)
+{
+    int32_t sample = fluid_rvoice_get_sample(dsp_msb, dsp_lsb, idx);
+    return (float)sample;
+}
+
+/* Like fluid_rvoice_get_float_sample(), preferring the sample points converted on loading, if any */
+static FLUID_INLINE fluid_real_t
+fluid_rvoice_get_point(const short int *dsp_msb, const char *dsp_lsb, const float *dsp_float, unsigned int idx)
+{
+    if(dsp_float != NULL)
+    {
+        return (fluid_real_t)dsp_float[idx];
+    }
+
+    return fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, idx);
+}
+
+/* The formats of sample data the block kernels are specialized for */
+enum fluid_rvoice_dsp_format
+{
+    FLUID_DSP_FORMAT_16,     /* 16 bit sample data only */
+    FLUID_DSP_FORMAT_24,     /* 16 bit sample data and their least significant bytes */
+    FLUID_DSP_FORMAT_FLOAT,  /* both converted to float on loading, see synth.sample-float */
+    FLUID_DSP_FORMATS
+};
+
+/* Like fluid_rvoice_get_sample(), for the block kernels, which know whether the sample has 24 bit */
+static FLUID_INLINE int32_t
+fluid_rvoice_dsp_get_point(const short int *dsp_msb, const char *dsp_lsb, int is_24bit, unsigned int idx)
+{
+    uint32_t msb = (uint32_t)dsp_msb[idx];
+    uint8_t lsb = is_24bit ? (uint8_t)dsp_lsb[idx] : 0U;
+
+    return (int32_t)((msb << 8) | lsb);
+}
+
+static FLUID_INLINE fluid_real_t
+fluid_rvoice_dsp_point(const short int *dsp_msb, const char *dsp_lsb, const float *dsp_float, int format,
+                       unsigned int idx)
+{
+    int32_t sample;
+
+    if(format == FLUID_DSP_FORMAT_FLOAT)
+    {
+        return (fluid_real_t)dsp_float[idx];
+    }
+
+    sample = fluid_rvoice_dsp_get_point(dsp_msb, dsp_lsb, format == FLUID_DSP_FORMAT_24, idx);
+    return (fluid_real_t)sample;
+}
+
+static FLUID_INLINE float
+fluid_rvoice_dsp_single_point(const short int *dsp_msb, const char *dsp_lsb, const float *dsp_float, int format,
+                              unsigned int idx)
+{
+    int32_t sample;
+
+    if(format == FLUID_DSP_FORMAT_FLOAT)
+    {
+        return dsp_float[idx];
+    }
+
+    sample = fluid_rvoice_dsp_get_point(dsp_msb, dsp_lsb, format == FLUID_DSP_FORMAT_24, idx);
+    return (float)sample;
+}
+
+/* Block interpolation kernels
+ *
+ * The inner loops of the interpolators below work frame by frame, as the
+ * sample points to use depend on the current phase. For the bulk of a sample
+ * however, i.e. where all interpolation points are known to lie within the
+ * sample data, the work can be split into two passes:
+ *
+ * 1. a scalar pass advancing the phase and amplitude, which gathers the
+ *    interpolation points and the coefficient table rows into small
+ *    structure-of-arrays buffers, and
+ * 2. a pass computing the weighted sum over those buffers, using unit-stride
+ *    accesses only, so that it can be vectorized by the compiler for the
+ *    target the library is compiled for.
+ *
+ * Only pass 2 is vectorized this way, pass 1 remains scalar code, see the
+ * AVX2 variants below for vectorized gathers. The amplitude ramp is still
+ * accumulated serially, and the order of the multiply-adds is the same as in
+ * the scalar loops. Thus both paths produce identical results, only the fused
+ * multiply-add contraction a compiler may use for the vectorized loop can
+ * cause deviations, which are within 1e-6 relative to the sample's full
+ * scale. The scalar loops remain in place
+ * and take care of everything the block kernels don't (sample and loop
+ * boundaries, degenerate sample lengths).
+ */
+
+/* Maximum number of frames processed by a block kernel at once */
+#define FLUID_DSP_BLOCK_FRAMES FLUID_BUFSIZE
+
+/**
+ * Returns the number of consecutive frames (at most \c max_frames) that can be
+ * interpolated starting from \c dsp_phase, before the phase index exceeds
+ * \c end_index.
+ */
+static FLUID_INLINE unsigned int
+fluid_rvoice_dsp_frames_until(fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                              unsigned int end_index, unsigned int max_frames)
+{
+    fluid_phase_t limit, frames;
+
+    /* end_index may have wrapped around for very short samples, leave that to the scalar loops */
+    if(end_index == 0xFFFFFFFFu)
+    {
+        return 0;
+    }
+
+    limit = ((fluid_phase_t)end_index + 1) << 32;
+
+    if(dsp_phase >= limit)
+    {
+        return 0;
+    }
+
+    if(dsp_phase_incr == 0)
+    {
+        return max_frames;
+    }
+
+    frames = (limit - dsp_phase + dsp_phase_incr - 1) / dsp_phase_incr;
+
+    return (frames < max_frames) ? (unsigned int)frames : max_frames;
+}
+
+/* Linear interpolation of \c count frames that all lie within the sample data */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_linear(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                              fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                              fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                              fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    fluid_real_t amp[FLUID_DSP_BLOCK_FRAMES];
+    fluid_real_t c0[FLUID_DSP_BLOCK_FRAMES], c1[FLUID_DSP_BLOCK_FRAMES];
+    fluid_real_t p0[FLUID_DSP_BLOCK_FRAMES], p1[FLUID_DSP_BLOCK_FRAMES];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+
+    for(i = 0; i < count; i++)
+    {
+        unsigned int idx = fluid_phase_index(phase);
+        const fluid_real_t *coeffs = interp_coeff_linear[fluid_phase_fract_to_tablerow(phase)];
+
+        c0[i] = coeffs[0];
+        c1[i] = coeffs[1];
+        p0[i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx);
+        p1[i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx + 1);
+        amp[i] = a;
+
+        fluid_phase_incr(phase, dsp_phase_incr);
+        a += dsp_amp_incr;
+    }
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = amp[i] * (c0[i] * p0[i] + c1[i] * p1[i]);
+    }
+
+    *dsp_phase = phase;
+    *dsp_amp = a;
+}
+
+/* 4th order interpolation of \c count frames that all lie within the sample data */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_4th_order(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                                 fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                 fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                 fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    fluid_real_t amp[FLUID_DSP_BLOCK_FRAMES];
+    fluid_real_t c[4][FLUID_DSP_BLOCK_FRAMES];
+    fluid_real_t p[4][FLUID_DSP_BLOCK_FRAMES];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+
+    for(i = 0; i < count; i++)
+    {
+        unsigned int idx = fluid_phase_index(phase);
+        const fluid_real_t *coeffs = interp_coeff[fluid_phase_fract_to_tablerow(phase)];
+
+        c[0][i] = coeffs[0];
+        c[1][i] = coeffs[1];
+        c[2][i] = coeffs[2];
+        c[3][i] = coeffs[3];
+        p[0][i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx - 1);
+        p[1][i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx);
+        p[2][i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx + 1);
+        p[3][i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx + 2);
+        amp[i] = a;
+
+        fluid_phase_incr(phase, dsp_phase_incr);
+        a += dsp_amp_incr;
+    }
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = amp[i] *
+                 (c[0][i] * p[0][i]
+                  + c[1][i] * p[1][i]
+                  + c[2][i] * p[2][i]
+                  + c[3][i] * p[3][i]);
+    }
+
+    *dsp_phase = phase;
+    *dsp_amp = a;
+}
+
+/* 7th order interpolation of \c count frames that all lie within the sample data */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_7th_order(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                                 fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                 fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                 fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    fluid_real_t amp[FLUID_DSP_BLOCK_FRAMES];
+    fluid_real_t c[SINC_INTERP_ORDER][FLUID_DSP_BLOCK_FRAMES];
+    fluid_real_t p[SINC_INTERP_ORDER][FLUID_DSP_BLOCK_FRAMES];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+    int k;
+
+    for(i = 0; i < count; i++)
+    {
+        unsigned int idx = fluid_phase_index(phase);
+        const fluid_real_t *coeffs = sinc_table7[fluid_phase_fract_to_sincrow(phase)];
+
+        for(k = 0; k < SINC_INTERP_ORDER; k++)
+        {
+            c[k][i] = coeffs[k];
+            p[k][i] = fluid_rvoice_dsp_point(dsp_data, dsp_data24, dsp_float, format, idx + k - 3);
+        }
+
+        amp[i] = a;
+
+        fluid_phase_incr(phase, dsp_phase_incr);
+        a += dsp_amp_incr;
+    }
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = amp[i]
+                 * (c[0][i] * p[0][i]
+                    + c[1][i] * p[1][i]
+                    + c[2][i] * p[2][i]
+                    + c[3][i] * p[3][i]
+                    + c[4][i] * p[4][i]
+                    + c[5][i] * p[5][i]
+                    + c[6][i] * p[6][i]);
+    }
+
+    *dsp_phase = phase;
+    *dsp_amp = a;
+}
+
+/* Single precision block kernels
+ *
+ * Variants of the block kernels above used for voices having their
+ * single_precision flag set (see synth.dsp-precision): the interpolation
+ * points, coefficients and amplitudes are gathered as floats, so that the
+ * weighted sum is computed on twice as many frames per SIMD instruction as
+ * with doubles, and the gathered data take half the cache. The 24 bit sample
+ * points are exactly representable as floats, the phase and the amplitude
+ * ramp are still advanced in the precision of fluid_real_t, so that rounding
+ * errors don't accumulate from one frame to the next.
+ */
+
+/* Linear interpolation of \c count frames in single precision */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_linear_float(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                                    fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                    fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                    fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    float amp[FLUID_DSP_BLOCK_FRAMES];
+    float c0[FLUID_DSP_BLOCK_FRAMES], c1[FLUID_DSP_BLOCK_FRAMES];
+    float p0[FLUID_DSP_BLOCK_FRAMES], p1[FLUID_DSP_BLOCK_FRAMES];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+
+    for(i = 0; i < count; i++)
+    {
+        unsigned int idx = fluid_phase_index(phase);
+        const float *coeffs = interp_coeff_linear_float[fluid_phase_fract_to_tablerow(phase)];
+
+        c0[i] = coeffs[0];
+        c1[i] = coeffs[1];
+        p0[i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx);
+        p1[i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx + 1);
+        amp[i] = (float)a;
+
+        fluid_phase_incr(phase, dsp_phase_incr);
+        a += dsp_amp_incr;
+    }
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = amp[i] * (c0[i] * p0[i] + c1[i] * p1[i]);
+    }
+
+    *dsp_phase = phase;
+    *dsp_amp = a;
+}
+
+/* 4th order interpolation of \c count frames in single precision */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_4th_order_float(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                                       fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                       fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                       fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    float amp[FLUID_DSP_BLOCK_FRAMES];
+    float c[4][FLUID_DSP_BLOCK_FRAMES];
+    float p[4][FLUID_DSP_BLOCK_FRAMES];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+
+    for(i = 0; i < count; i++)
+    {
+        unsigned int idx = fluid_phase_index(phase);
+        const float *coeffs = interp_coeff_float[fluid_phase_fract_to_tablerow(phase)];
+
+        c[0][i] = coeffs[0];
+        c[1][i] = coeffs[1];
+        c[2][i] = coeffs[2];
+        c[3][i] = coeffs[3];
+        p[0][i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx - 1);
+        p[1][i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx);
+        p[2][i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx + 1);
+        p[3][i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx + 2);
+        amp[i] = (float)a;
+
+        fluid_phase_incr(phase, dsp_phase_incr);
+        a += dsp_amp_incr;
+    }
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = amp[i] *
+                 (c[0][i] * p[0][i]
+                  + c[1][i] * p[1][i]
+                  + c[2][i] * p[2][i]
+                  + c[3][i] * p[3][i]);
+    }
+
+    *dsp_phase = phase;
+    *dsp_amp = a;
+}
+
+/* 7th order interpolation of \c count frames in single precision */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_7th_order_float(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                                       fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                       fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                       fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    float amp[FLUID_DSP_BLOCK_FRAMES];
+    float c[SINC_INTERP_ORDER][FLUID_DSP_BLOCK_FRAMES];
+    float p[SINC_INTERP_ORDER][FLUID_DSP_BLOCK_FRAMES];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+    int k;
+
+    for(i = 0; i < count; i++)
+    {
+        unsigned int idx = fluid_phase_index(phase);
+        const float *coeffs = sinc_table7_float[fluid_phase_fract_to_sincrow(phase)];
+
+        for(k = 0; k < SINC_INTERP_ORDER; k++)
+        {
+            c[k][i] = coeffs[k];
+            p[k][i] = fluid_rvoice_dsp_single_point(dsp_data, dsp_data24, dsp_float, format, idx + k - 3);
+        }
+
+        amp[i] = (float)a;
+
+        fluid_phase_incr(phase, dsp_phase_incr);
+        a += dsp_amp_incr;
+    }
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = amp[i]
+                 * (c[0][i] * p[0][i]
+                    + c[1][i] * p[1][i]
+                    + c[2][i] * p[2][i]
+                    + c[3][i] * p[3][i]
+                    + c[4][i] * p[4][i]
+                    + c[5][i] * p[5][i]
+                    + c[6][i] * p[6][i]);
+    }
+
+    *dsp_phase = phase;
+    *dsp_amp = a;
+}
+
+/* Specialized block kernels
+ *
+ * The block kernels above are instantiated for each sample data format, with
+ * format being a constant, so that the compiler drops the checks for the
+ * least significant byte and the float data from their inner loops. With the
+ * sample data converted to float on loading, gathering an interpolation point
+ * is a single load. The interpolators pick the variant for the voice from
+ * fluid_rvoice_dsp_block_table once per call.
+ */
+
+typedef void (*fluid_rvoice_dsp_block_t)(const short int *dsp_data, const char *dsp_data24,
+        const float *dsp_float, fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+        fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+        fluid_real_t *FLUID_RESTRICT out, unsigned int count);
+
+#define FLUID_DSP_BLOCK_VARIANT(kernel, suffix, format) \
+    static void kernel##suffix(const short int *dsp_data, const char *dsp_data24, \
+                               const float *dsp_float, fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr, \
+                               fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr, \
+                               fluid_real_t *FLUID_RESTRICT out, unsigned int count) \
+    { \
+        kernel(dsp_data, dsp_data24, dsp_float, dsp_phase, dsp_phase_incr, dsp_amp, dsp_amp_incr, \
+               out, count, format); \
+    }
+
+#define FLUID_DSP_BLOCK_VARIANTS(kernel) \
+    FLUID_DSP_BLOCK_VARIANT(kernel, _16, FLUID_DSP_FORMAT_16) \
+    FLUID_DSP_BLOCK_VARIANT(kernel, _24, FLUID_DSP_FORMAT_24) \
+    FLUID_DSP_BLOCK_VARIANT(kernel, _f32, FLUID_DSP_FORMAT_FLOAT)
+
+FLUID_DSP_BLOCK_VARIANTS(fluid_rvoice_dsp_block_linear)
+FLUID_DSP_BLOCK_VARIANTS(fluid_rvoice_dsp_block_4th_order)
+FLUID_DSP_BLOCK_VARIANTS(fluid_rvoice_dsp_block_7th_order)
+FLUID_DSP_BLOCK_VARIANTS(fluid_rvoice_dsp_block_linear_float)
+FLUID_DSP_BLOCK_VARIANTS(fluid_rvoice_dsp_block_4th_order_float)
+FLUID_DSP_BLOCK_VARIANTS(fluid_rvoice_dsp_block_7th_order_float)
+
+enum fluid_rvoice_dsp_block_kernel
+{
+    FLUID_DSP_BLOCK_LINEAR,
+    FLUID_DSP_BLOCK_4TH_ORDER,
+    FLUID_DSP_BLOCK_7TH_ORDER,
+    FLUID_DSP_BLOCK_KERNELS
+};
+
+/* indexed by kernel, single precision and sample data format */
+static const fluid_rvoice_dsp_block_t fluid_rvoice_dsp_blocks[FLUID_DSP_BLOCK_KERNELS][2][FLUID_DSP_FORMATS] =
+{
+    {
+        { fluid_rvoice_dsp_block_linear_16, fluid_rvoice_dsp_block_linear_24, fluid_rvoice_dsp_block_linear_f32 },
+        {
+            fluid_rvoice_dsp_block_linear_float_16, fluid_rvoice_dsp_block_linear_float_24,
+            fluid_rvoice_dsp_block_linear_float_f32
+        }
+    },
+    {
+        {
+            fluid_rvoice_dsp_block_4th_order_16, fluid_rvoice_dsp_block_4th_order_24,
+            fluid_rvoice_dsp_block_4th_order_f32
+        },
+        {
+            fluid_rvoice_dsp_block_4th_order_float_16, fluid_rvoice_dsp_block_4th_order_float_24,
+            fluid_rvoice_dsp_block_4th_order_float_f32
+        }
+    },
+    {
+        {
+            fluid_rvoice_dsp_block_7th_order_16, fluid_rvoice_dsp_block_7th_order_24,
+            fluid_rvoice_dsp_block_7th_order_f32
+        },
+        {
+            fluid_rvoice_dsp_block_7th_order_float_16, fluid_rvoice_dsp_block_7th_order_float_24,
+            fluid_rvoice_dsp_block_7th_order_float_f32
+        }
+    }
+};
+
+/* AVX2 block kernels
+ *
+ * The gathers of pass 1 are what the block kernels above spend most of their
+ * time on, and which no compiler vectorizes on its own. On x86, the variants
+ * below advance 8 phases at once in vector registers, and gather the
+ * coefficient rows and the sample points of 8 frames with the AVX2 gather
+ * instructions: two 16 bit points per 32 bit lane, and the least significant
+ * bytes of up to four points per lane. The products are summed in the same
+ * order as in the kernels above, and without fusing the multiply-adds, so
+ * that the results are identical to theirs. Frames left over from the
+ * multiples of 8 are handed to the kernels above, as are the 24 bit samples
+ * for linear interpolation, where gathering the least significant bytes of
+ * two points would read before the first one. They are selected at runtime,
+ * see fluid_rvoice_dsp_dispatch_config().
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FLUID_DSP_X86_VARIANTS 1
+#include <immintrin.h>
+
+#define FLUID_DSP_AVX2_INLINE FLUID_INLINE __attribute__((always_inline, target("avx2")))
+
+/* Splits 8 consecutive phases, 4 in each of ph0 and ph1, into their indices and fractional parts */
+static FLUID_DSP_AVX2_INLINE void
+fluid_rvoice_dsp_avx2_split(__m256i ph0, __m256i ph1, __m256i *idx, __m256i *fract)
+{
+    __m256 lo = _mm256_castsi256_ps(ph0);
+    __m256 hi = _mm256_castsi256_ps(ph1);
+
+    /* the 32 bit halves of the phases end up in the order 0, 1, 4, 5, 2, 3, 6, 7 */
+    *idx = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))),
+                                    _MM_SHUFFLE(3, 1, 2, 0));
+    *fract = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))),
+                                      _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+/* Gathers the \c taps sample points from idx + first on of 8 frames */
+static FLUID_DSP_AVX2_INLINE void
+fluid_rvoice_dsp_avx2_points(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                             int format, __m256i idx, int first, int taps, __m256 *p)
+{
+    __m256i msb[SINC_INTERP_ORDER];
+    int k;
+
+    if(format == FLUID_DSP_FORMAT_FLOAT)
+    {
+        for(k = 0; k < taps; k++)
+        {
+            p[k] = _mm256_i32gather_ps(dsp_float, _mm256_add_epi32(idx, _mm256_set1_epi32(first + k)), 4);
+        }
+
+        return;
+    }
+
+    /* the points at 2 * j and 2 * j + 1 from a single gather, the last one of an odd count of
+     * them as the upper half of its pair with the one before, so that nothing past it is read */
+    for(k = 0; k < taps; k += 2)
+    {
+        int pair = (k + 1 < taps) ? k : k - 1;
+        __m256i v = _mm256_i32gather_epi32((const int *)dsp_data,
+                                           _mm256_add_epi32(idx, _mm256_set1_epi32(first + pair)), 2);
+        __m256i upper = _mm256_srai_epi32(_mm256_and_si256(v, _mm256_set1_epi32((int)0xFFFF0000)), 8);
+
+        if(pair == k)
+        {
+            msb[k] = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 8);
+            msb[k + 1] = upper;
+        }
+        else
+        {
+            msb[k] = upper;
+        }
+    }
+
+    /* the least significant bytes of 4 points from a single gather, the last 4 points for the
+     * ones left over (at least 4 taps, see above) */
+    if(format == FLUID_DSP_FORMAT_24)
+    {
+        for(k = 0; k < taps; k += 4)
+        {
+            int quad = (k + 4 <= taps) ? k : taps - 4;
+            __m256i v = _mm256_i32gather_epi32((const int *)dsp_data24,
+                                               _mm256_add_epi32(idx, _mm256_set1_epi32(first + quad)), 1);
+            int j;
+
+            for(j = k - quad; j < 4; j++)
+            {
+                __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(v, 8 * j), _mm256_set1_epi32(0xFF));
+                msb[quad + j] = _mm256_or_si256(msb[quad + j], lsb);
+            }
+        }
+    }
+
+    for(k = 0; k < taps; k++)
+    {
+        p[k] = _mm256_cvtepi32_ps(msb[k]);
+    }
+}
+
+/**
+ * Interpolates the frames of \c count in multiples of 8, from the coefficient
+ * table \c ftable in single precision, or \c table in the precision of fluid_real_t.
+ *
+ * @param first offset of the first interpolation point from the phase index
+ * @param taps number of interpolation points, i.e. of columns of the table
+ * @param sinc whether the table is indexed like sinc_table7
+ * @return the number of frames interpolated
+ */
+static FLUID_DSP_AVX2_INLINE unsigned int
+fluid_rvoice_dsp_avx2_block(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                            const float *ftable, const fluid_real_t *table, int first, int taps, int sinc,
+                            fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                            fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                            fluid_real_t *FLUID_RESTRICT out, unsigned int count, int format)
+{
+    __m256i ph0, ph1, step, idx, fract, row;
+    __m256 p[SINC_INTERP_ORDER];
+    fluid_phase_t phase = *dsp_phase;
+    fluid_real_t a = *dsp_amp;
+    unsigned int n = count & ~7U;
+    unsigned int i;
+    int j, k;
+
+    /* the gathers take signed 32 bit indices */
+    if(n == 0 || fluid_phase_index(phase + (fluid_phase_t)n * dsp_phase_incr) >= 0x7FFFFFF0U)
+    {
+        return 0;
+    }
+
+#ifdef WITH_FLOAT
+    /* fluid_real_t is float, so that the regular kernels are single precision ones */
+    if(ftable == NULL)
+    {
+        ftable = table;
+    }
+#endif
+
+    ph0 = _mm256_set_epi64x((long long)(phase + 3 * dsp_phase_incr), (long long)(phase + 2 * dsp_phase_incr),
+                            (long long)(phase + dsp_phase_incr), (long long)phase);
+    ph1 = _mm256_add_epi64(ph0, _mm256_set1_epi64x((long long)(4 * dsp_phase_incr)));
+    step = _mm256_set1_epi64x((long long)(8 * dsp_phase_incr));
+
+    for(i = 0; i < n; i += 8)
+    {
+        fluid_rvoice_dsp_avx2_split(ph0, ph1, &idx, &fract);
+
+        if(sinc)
+        {
+            row = _mm256_srli_epi32(_mm256_and_si256(fract, _mm256_set1_epi32((int)FLUID_SINC_INTERP_BITS_MASK)),
+                                    FLUID_SINC_INTERP_BITS_SHIFT);
+        }
+        else
+        {
+            row = _mm256_srli_epi32(_mm256_and_si256(fract, _mm256_set1_epi32((int)FLUID_INTERP_BITS_MASK)),
+                                    FLUID_INTERP_BITS_SHIFT);
+        }
+
+        row = _mm256_mullo_epi32(row, _mm256_set1_epi32(taps));
+
+        fluid_rvoice_dsp_avx2_points(dsp_data, dsp_data24, dsp_float, format, idx, first, taps, p);
+
+        if(ftable != NULL)
+        {
+            float amp[8];
+            __m256 sum;
+
+            for(j = 0; j < 8; j++)
+            {
+                amp[j] = (float)a;
+                a += dsp_amp_incr;
+            }
+
+            sum = _mm256_mul_ps(_mm256_i32gather_ps(ftable, row, 4), p[0]);
+
+            for(k = 1; k < taps; k++)
+            {
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_i32gather_ps(ftable + k, row, 4), p[k]));
+            }
+
+            sum = _mm256_mul_ps(_mm256_loadu_ps(amp), sum);
+
+#ifdef WITH_FLOAT
+            _mm256_storeu_ps(out + i, sum);
+#else
+            _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(sum)));
+            _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(sum, 1)));
+#endif
+        }
+
+#ifndef WITH_FLOAT
+        else
+        {
+            double amp[8];
+            int h;
+
+            for(j = 0; j < 8; j++)
+            {
+                amp[j] = a;
+                a += dsp_amp_incr;
+            }
+
+            /* the points as doubles, and the table rows, 4 frames at a time */
+            for(h = 0; h < 2; h++)
+            {
+                __m128i rows = h ? _mm256_extracti128_si256(row, 1) : _mm256_castsi256_si128(row);
+                __m256d sum;
+
+#define FLUID_DSP_AVX2_POINT_PD(_k) \
+    _mm256_cvtps_pd(h ? _mm256_extractf128_ps(p[_k], 1) : _mm256_castps256_ps128(p[_k]))
+
+                sum = _mm256_mul_pd(_mm256_i32gather_pd(table, rows, 8), FLUID_DSP_AVX2_POINT_PD(0));
+
+                for(k = 1; k < taps; k++)
+                {
+                    sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_i32gather_pd(table + k, rows, 8),
+                                                           FLUID_DSP_AVX2_POINT_PD(k)));
+                }
+
+#undef FLUID_DSP_AVX2_POINT_PD
+
+                _mm256_storeu_pd(out + i + 4 * h, _mm256_mul_pd(_mm256_loadu_pd(amp + 4 * h), sum));
+            }
+        }
+
+#endif
+
+        ph0 = _mm256_add_epi64(ph0, step);
+        ph1 = _mm256_add_epi64(ph1, step);
+    }
+
+    *dsp_phase = phase + (fluid_phase_t)n * dsp_phase_incr;
+    *dsp_amp = a;
+
+    return n;
+}
+
+/* An AVX2 variant of a block kernel, leaving the frames it didn't interpolate to the kernel itself */
+#define FLUID_DSP_AVX2_VARIANT(kernel, suffix, format, ftable, table, first, taps, sinc) \
+    __attribute__((target("avx2"))) static void kernel##suffix##_avx2(const short int *dsp_data, \
+            const char *dsp_data24, const float *dsp_float, fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr, \
+            fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr, fluid_real_t *FLUID_RESTRICT out, unsigned int count) \
+    { \
+        unsigned int n = fluid_rvoice_dsp_avx2_block(dsp_data, dsp_data24, dsp_float, ftable, table, \
+                         first, taps, sinc, dsp_phase, dsp_phase_incr, dsp_amp, dsp_amp_incr, out, count, format); \
+        kernel(dsp_data, dsp_data24, dsp_float, dsp_phase, dsp_phase_incr, dsp_amp, dsp_amp_incr, \
+               out + n, count - n, format); \
+    }
+
+#define FLUID_DSP_AVX2_VARIANTS(kernel, ftable, table, first, taps, sinc) \
+    FLUID_DSP_AVX2_VARIANT(kernel, _16, FLUID_DSP_FORMAT_16, ftable, table, first, taps, sinc) \
+    FLUID_DSP_AVX2_VARIANT(kernel, _24, FLUID_DSP_FORMAT_24, ftable, table, first, taps, sinc) \
+    FLUID_DSP_AVX2_VARIANT(kernel, _f32, FLUID_DSP_FORMAT_FLOAT, ftable, table, first, taps, sinc)
+
+FLUID_DSP_AVX2_VARIANT(fluid_rvoice_dsp_block_linear, _16, FLUID_DSP_FORMAT_16,
+                       NULL, interp_coeff_linear[0], 0, 2, 0)
+FLUID_DSP_AVX2_VARIANT(fluid_rvoice_dsp_block_linear, _f32, FLUID_DSP_FORMAT_FLOAT,
+                       NULL, interp_coeff_linear[0], 0, 2, 0)
+FLUID_DSP_AVX2_VARIANTS(fluid_rvoice_dsp_block_4th_order, NULL, interp_coeff[0], -1, 4, 0)
+FLUID_DSP_AVX2_VARIANTS(fluid_rvoice_dsp_block_7th_order, NULL, sinc_table7[0], -3, SINC_INTERP_ORDER, 1)
+FLUID_DSP_AVX2_VARIANT(fluid_rvoice_dsp_block_linear_float, _16, FLUID_DSP_FORMAT_16,
+                       interp_coeff_linear_float[0], NULL, 0, 2, 0)
+FLUID_DSP_AVX2_VARIANT(fluid_rvoice_dsp_block_linear_float, _f32, FLUID_DSP_FORMAT_FLOAT,
+                       interp_coeff_linear_float[0], NULL, 0, 2, 0)
+FLUID_DSP_AVX2_VARIANTS(fluid_rvoice_dsp_block_4th_order_float, interp_coeff_float[0], NULL, -1, 4, 0)
+FLUID_DSP_AVX2_VARIANTS(fluid_rvoice_dsp_block_7th_order_float, sinc_table7_float[0], NULL,
+                        -3, SINC_INTERP_ORDER, 1)
+
+/* like fluid_rvoice_dsp_blocks, with the AVX2 variants */
+static const fluid_rvoice_dsp_block_t fluid_rvoice_dsp_blocks_avx2[FLUID_DSP_BLOCK_KERNELS][2][FLUID_DSP_FORMATS] =
+{
+    {
+        {
+            fluid_rvoice_dsp_block_linear_16_avx2, fluid_rvoice_dsp_block_linear_24,
+            fluid_rvoice_dsp_block_linear_f32_avx2
+        },
+        {
+            fluid_rvoice_dsp_block_linear_float_16_avx2, fluid_rvoice_dsp_block_linear_float_24,
+            fluid_rvoice_dsp_block_linear_float_f32_avx2
+        }
+    },
+    {
+        {
+            fluid_rvoice_dsp_block_4th_order_16_avx2, fluid_rvoice_dsp_block_4th_order_24_avx2,
+            fluid_rvoice_dsp_block_4th_order_f32_avx2
+        },
+        {
+            fluid_rvoice_dsp_block_4th_order_float_16_avx2, fluid_rvoice_dsp_block_4th_order_float_24_avx2,
+            fluid_rvoice_dsp_block_4th_order_float_f32_avx2
+        }
+    },
+    {
+        {
+            fluid_rvoice_dsp_block_7th_order_16_avx2, fluid_rvoice_dsp_block_7th_order_24_avx2,
+            fluid_rvoice_dsp_block_7th_order_f32_avx2
+        },
+        {
+            fluid_rvoice_dsp_block_7th_order_float_16_avx2, fluid_rvoice_dsp_block_7th_order_float_24_avx2,
+            fluid_rvoice_dsp_block_7th_order_float_f32_avx2
+        }
+    }
+};
+#endif
+
+/* The block kernels selected for the CPU, either fluid_rvoice_dsp_blocks or fluid_rvoice_dsp_blocks_avx2 */
+static const fluid_rvoice_dsp_block_t (*fluid_rvoice_dsp_block_table)[2][FLUID_DSP_FORMATS] = fluid_rvoice_dsp_blocks;
+
+/**
+ * Select the variants of the block kernels for the features of the CPU.
+ * Called once by fluid_synth_init(), after fluid_cpu_dispatch_init().
+ */
+void
+fluid_rvoice_dsp_dispatch_config(void)
+{
+    const char *variant = FLUID_CPU_BASELINE;
+
+    fluid_rvoice_dsp_block_table = fluid_rvoice_dsp_blocks;
+
+#if FLUID_DSP_X86_VARIANTS
+
+    if(fluid_cpu_features() & FLUID_CPU_AVX2)
+    {
+        fluid_rvoice_dsp_block_table = fluid_rvoice_dsp_blocks_avx2;
+        variant = "avx2";
+    }
+
+#endif
+
+    fluid_cpu_dispatch_register("interp", variant);
+}
+
+/* the format of the sample data of the voice */
+static FLUID_INLINE int
+fluid_rvoice_dsp_format(const fluid_rvoice_dsp_t *voice)
+{
+    if(voice->sample->float_data != NULL)
+    {
+        return FLUID_DSP_FORMAT_FLOAT;
+    }
+
+    return (voice->sample->data24 != NULL) ? FLUID_DSP_FORMAT_24 : FLUID_DSP_FORMAT_16;
+}
+
+/* the variant of a block kernel to use for the voice */
+static FLUID_INLINE fluid_rvoice_dsp_block_t
+fluid_rvoice_dsp_block_select(const fluid_rvoice_dsp_t *voice, enum fluid_rvoice_dsp_block_kernel kernel)
+{
+    return fluid_rvoice_dsp_block_table[kernel][voice->single_precision != 0][fluid_rvoice_dsp_format(voice)];
+}
+
+/**
+ * Interpolates a looping voice from the padded copy of its loop (see
+ * fluid_sample_pad_loop()) for as long as it stays within the loop, where the
+ * points around the loop boundary need no special handling. Voices playing an
+ * octave or more above the original pitch read the decimated copy of the loop
+ * closest to their pitch instead, if there is one (see fluid_sample_decimate_loop()).
+ * Stops without interpolating anything if the voice isn't within the loop,
+ * leaving it to the regular path.
+ *
+ * @param lookbehind number of interpolation points before the current one
+ * @param phase_offset offset of \c dsp_phase from the actual phase, in frames of the copy
+ * @return the index of the next frame of \c dsp_buf, either FLUID_BUFSIZE or \c dsp_i
+ */
+static unsigned int
+fluid_rvoice_dsp_interpolate_loop(fluid_rvoice_dsp_t *voice, enum fluid_rvoice_dsp_block_kernel kernel,
+                                  unsigned int lookbehind, fluid_phase_t phase_offset,
+                                  fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                  fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                  fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i)
+{
+    const fluid_sample_t *sample = voice->sample;
+    unsigned int loopstart = (unsigned int)voice->loopstart;
+    unsigned int loopend = (unsigned int)voice->loopend;
+    unsigned int start = (unsigned int)voice->start;
+    const float *loop_data = sample->loop_data;
+    fluid_rvoice_dsp_block_t block;
+    fluid_phase_t loop_phase, loop_offset;
+    unsigned int first_index, n;
+    int octave;
+
+    /* the loop may have been moved by the generators */
+    if(loopstart != sample->loopstart || loopend != sample->loopend)
+    {
+        return dsp_i;
+    }
+
+    /* the lowest octave of the loop that still needs a phase increment of a frame at least */
+    for(octave = 0; octave < FLUID_SAMPLE_LOOP_MIPMAPS && sample->loop_mipmaps[octave] != NULL
+            && fluid_phase_index(dsp_phase_incr) >= (2U << octave); octave++)
+    {
+        loop_data = sample->loop_mipmaps[octave];
+    }
+
+    if(loop_data == NULL)
+    {
+        return dsp_i;
+    }
+
+    block = fluid_rvoice_dsp_block_table[kernel][voice->single_precision != 0][FLUID_DSP_FORMAT_FLOAT];
+
+    /* the copy starts FLUID_SAMPLE_LOOP_PADDING of its points before the loop, and the phase
+     * offset is in points of the copy as well */
+    loop_offset = ((fluid_phase_t)FLUID_SAMPLE_LOOP_PADDING << 32) + phase_offset - (phase_offset >> octave);
+
+    /* until the voice has looped, the points before the loop aren't the ones at its end */
+    first_index = voice->has_looped ? loopstart
+                  : ((start > loopstart) ? start : loopstart) + ((lookbehind + (octave ? 1 : 0)) << octave);
+
+    while(dsp_i < FLUID_BUFSIZE)
+    {
+        unsigned int dsp_phase_index = fluid_phase_index(*dsp_phase);
+
+        /* go back to loop start */
+        if(dsp_phase_index >= loopend)
+        {
+            fluid_phase_sub_int(*dsp_phase, loopend - loopstart);
+            voice->has_looped = 1;
+            first_index = loopstart;
+            continue;
+        }
+
+        if(dsp_phase_index < first_index)
+        {
+            break;
+        }
+
+        n = fluid_rvoice_dsp_frames_until(*dsp_phase, dsp_phase_incr, loopend - 1, FLUID_BUFSIZE - dsp_i);
+        loop_phase = ((*dsp_phase - ((fluid_phase_t)loopstart << 32)) >> octave) + loop_offset;
+
+        block(NULL, NULL, loop_data, &loop_phase, dsp_phase_incr >> octave, dsp_amp, dsp_amp_incr,
+              &dsp_buf[dsp_i], n);
+
+        *dsp_phase += (fluid_phase_t)n * dsp_phase_incr;
+        dsp_i += n;
+    }
+
+    return dsp_i;
+}
+
 /* No interpolation. Just take the sample, which is closest to
   * the playback pointer.  Questionable quality, but very
   * efficient. */
@@ -66,7 +998,7 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_offset;
     unsigned int dsp_phase_index;
     unsigned int end_index;
 
@@ -116,6 +1048,93 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
     return (dsp_i);
 }
 
+/* Conversion of \c count consecutive sample frames, starting at \c idx */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_copy(const short int *dsp_data, const char *dsp_data24, const float *dsp_float,
+                            unsigned int idx, fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                            fluid_real_t *FLUID_RESTRICT out, unsigned int count)
+{
+    fluid_real_t a = *dsp_amp;
+    unsigned int i;
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        out[i] = fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + i);
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        out[i] *= a;
+        a += dsp_amp_incr;
+    }
+
+    *dsp_amp = a;
+}
+
+/* No interpolation needed. The sample is played at its original pitch and
+ * output rate, i.e. the phase increment is exactly 1 and the phase lies on a
+ * sample point (see fluid_rvoice_is_unpitched()), so the sample frames are
+ * just converted and copied. The other methods return the same values, except
+ * for the 7th order interpolation, as the rows of its table are 1/256 of a frame
+ * off the sample points. */
+int
+fluid_rvoice_dsp_copy(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
+{
+    unsigned int dsp_phase_index = fluid_phase_index(voice->phase);
+    short int *dsp_data = voice->sample->data;
+    char *dsp_data24 = voice->sample->data24;
+    fluid_real_t dsp_amp = voice->amp;
+    fluid_real_t dsp_amp_incr = voice->amp_incr;
+    unsigned int dsp_i = voice->start_offset;
+    unsigned int end_index, count;
+
+    end_index = looping ? voice->loopend - 1 : voice->end;
+
+    while(1)
+    {
+        /* copy sequence of sample points */
+        if(dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index)
+        {
+            count = end_index - dsp_phase_index + 1;
+
+            if(count > FLUID_BUFSIZE - dsp_i || count == 0)
+            {
+                count = FLUID_BUFSIZE - dsp_i;
+            }
+
+            fluid_rvoice_dsp_block_copy(dsp_data, dsp_data24, voice->sample->float_data, dsp_phase_index,
+                                        &dsp_amp, dsp_amp_incr, &dsp_buf[dsp_i], count);
+            dsp_i += count;
+            dsp_phase_index += count;
+        }
+
+        /* break out if not looping (buffer may not be full) */
+        if(!looping)
+        {
+            break;
+        }
+
+        /* go back to loop start */
+        if(dsp_phase_index > end_index)
+        {
+            dsp_phase_index -= voice->loopend - voice->loopstart;
+            voice->has_looped = 1;
+        }
+
+        /* break out if filled buffer */
+        if(dsp_i >= FLUID_BUFSIZE)
+        {
+            break;
+        }
+    }
+
+    fluid_phase_set_int(voice->phase, dsp_phase_index);
+    voice->amp = dsp_amp;
+
+    return (dsp_i);
+}
+
 /* Straight line interpolation.
  * Returns number of samples processed (usually FLUID_BUFSIZE but could be
  * smaller if end of sample occurs).
@@ -123,13 +1142,14 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
 int
 fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
 {
+    fluid_rvoice_dsp_block_t block = fluid_rvoice_dsp_block_select(voice, FLUID_DSP_BLOCK_LINEAR);
     fluid_phase_t dsp_phase = voice->phase;
     fluid_phase_t dsp_phase_incr;
     short int *dsp_data = voice->sample->data;
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_offset;
     unsigned int dsp_phase_index;
     unsigned int end_index;
     fluid_real_t point;
@@ -138,6 +1158,13 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
     /* Convert playback "speed" floating point value to phase index/fract */
     fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
 
+    /* within the loop, interpolate from its padded copy if there is one */
+    if(looping)
+    {
+        dsp_i = fluid_rvoice_dsp_interpolate_loop(voice, FLUID_DSP_BLOCK_LINEAR, 0, 0, &dsp_phase, dsp_phase_incr,
+                &dsp_amp, dsp_amp_incr, dsp_buf, dsp_i);
+    }
+
     /* last index before 2nd interpolation point must be specially handled */
     end_index = (looping ? voice->loopend - 1 : voice->end) - 1;
 
@@ -155,6 +1182,22 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
     {
         dsp_phase_index = fluid_phase_index(dsp_phase);
 
+        /* interpolate the bulk of the sample points in blocks */
+        if(dsp_i < FLUID_BUFSIZE)
+        {
+            unsigned int n = fluid_rvoice_dsp_frames_until(dsp_phase, dsp_phase_incr, end_index,
+                             FLUID_BUFSIZE - dsp_i);
+
+            if(n > 0)
+            {
+                block(dsp_data, dsp_data24, voice->sample->float_data, &dsp_phase, dsp_phase_incr,
+                      &dsp_amp, dsp_amp_incr, &dsp_buf[dsp_i], n);
+
+                dsp_i += n;
+                dsp_phase_index = fluid_phase_index(dsp_phase);
+            }
+        }
+
         /* interpolate the sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
         {
@@ -223,13 +1266,14 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
 int
 fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
 {
+    fluid_rvoice_dsp_block_t block = fluid_rvoice_dsp_block_select(voice, FLUID_DSP_BLOCK_4TH_ORDER);
     fluid_phase_t dsp_phase = voice->phase;
     fluid_phase_t dsp_phase_incr;
     short int *dsp_data = voice->sample->data;
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_offset;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
     fluid_real_t start_point, end_point1, end_point2;
@@ -238,6 +1282,13 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
     /* Convert playback "speed" floating point value to phase index/fract */
     fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
 
+    /* within the loop, interpolate from its padded copy if there is one */
+    if(looping)
+    {
+        dsp_i = fluid_rvoice_dsp_interpolate_loop(voice, FLUID_DSP_BLOCK_4TH_ORDER, 1, 0, &dsp_phase, dsp_phase_incr,
+                &dsp_amp, dsp_amp_incr, dsp_buf, dsp_i);
+    }
+
     /* last index before 4th interpolation point must be specially handled */
     end_index = (looping ? voice->loopend - 1 : voice->end) - 2;
 
@@ -284,6 +1335,22 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
             dsp_amp += dsp_amp_incr;
         }
 
+        /* interpolate the bulk of the sample points in blocks */
+        if(dsp_i < FLUID_BUFSIZE)
+        {
+            unsigned int n = fluid_rvoice_dsp_frames_until(dsp_phase, dsp_phase_incr, end_index,
+                             FLUID_BUFSIZE - dsp_i);
+
+            if(n > 0)
+            {
+                block(dsp_data, dsp_data24, voice->sample->float_data, &dsp_phase, dsp_phase_incr,
+                      &dsp_amp, dsp_amp_incr, &dsp_buf[dsp_i], n);
+
+                dsp_i += n;
+                dsp_phase_index = fluid_phase_index(dsp_phase);
+            }
+        }
+
         /* interpolate the sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
         {
@@ -382,13 +1449,14 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
 int
 fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
 {
+    fluid_rvoice_dsp_block_t block = fluid_rvoice_dsp_block_select(voice, FLUID_DSP_BLOCK_7TH_ORDER);
     fluid_phase_t dsp_phase = voice->phase;
     fluid_phase_t dsp_phase_incr;
     short int *dsp_data = voice->sample->data;
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_offset;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
     fluid_real_t start_points[3], end_points[3];
@@ -401,6 +1469,13 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
      * the 4th sample point */
     fluid_phase_incr(dsp_phase, (fluid_phase_t)0x80000000);
 
+    /* within the loop, interpolate from its padded copy if there is one */
+    if(looping)
+    {
+        dsp_i = fluid_rvoice_dsp_interpolate_loop(voice, FLUID_DSP_BLOCK_7TH_ORDER, 3, 0x80000000, &dsp_phase, dsp_phase_incr,
+                &dsp_amp, dsp_amp_incr, dsp_buf, dsp_i);
+    }
+
     /* last index before 7th interpolation point must be specially handled */
     end_index = (looping ? voice->loopend - 1 : voice->end) - 3;
 
@@ -440,7 +1515,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         /* interpolate first sample point (start or loop start) if needed */
         for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * start_points[2]
@@ -462,7 +1537,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         /* interpolate 2nd to first sample point (start or loop start) if needed */
         for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * start_points[1]
@@ -484,7 +1559,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         /* interpolate 3rd to first sample point (start or loop start) if needed */
         for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * start_points[0]
@@ -504,10 +1579,26 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         start_index -= 2;	/* set back to original start index */
 
 
+        /* interpolate the bulk of the sample points in blocks */
+        if(dsp_i < FLUID_BUFSIZE)
+        {
+            unsigned int n = fluid_rvoice_dsp_frames_until(dsp_phase, dsp_phase_incr, end_index,
+                             FLUID_BUFSIZE - dsp_i);
+
+            if(n > 0)
+            {
+                block(dsp_data, dsp_data24, voice->sample->float_data, &dsp_phase, dsp_phase_incr,
+                      &dsp_amp, dsp_amp_incr, &dsp_buf[dsp_i], n);
+
+                dsp_i += n;
+                dsp_phase_index = fluid_phase_index(dsp_phase);
+            }
+        }
+
         /* interpolate the sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 3)
@@ -535,7 +1626,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         /* interpolate within 3rd to last point */
         for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 3)
@@ -557,7 +1648,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         /* interpolate within 2nd to last point */
         for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 3)
@@ -579,7 +1670,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         /* interpolate within last point */
         for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+            coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase)];
 
             dsp_buf[dsp_i] = dsp_amp
                              * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 3)
@@ -634,3 +1725,197 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
 
     return (dsp_i);
 }
+
+/**
+ * Checks whether the interpolation points of all frames of the next block of
+ * a voice lie within the sample data, i.e. whether the block can be rendered
+ * without start, end or loop point handling.
+ *
+ * @param lookbehind number of interpolation points before the current one
+ * @param lookahead number of interpolation points after the current one
+ */
+static FLUID_INLINE int
+fluid_rvoice_dsp_batch_eligible(const fluid_rvoice_dsp_t *voice, int looping,
+                                fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                                unsigned int lookbehind, unsigned int lookahead)
+{
+    unsigned int start_index = voice->has_looped ? voice->loopstart : voice->start;
+    unsigned int end_index = (looping ? voice->loopend - 1 : voice->end) - lookahead;
+
+    if(fluid_phase_index(dsp_phase) < start_index + lookbehind)
+    {
+        return FALSE;
+    }
+
+    return fluid_rvoice_dsp_frames_until(dsp_phase, dsp_phase_incr, end_index, FLUID_BUFSIZE) == FLUID_BUFSIZE;
+}
+
+/**
+ * Interpolates one block of several voices, which all play the same sample with
+ * the same interpolation method.
+ *
+ * Voices whose next block lies entirely within the bulk of the sample are
+ * interpolated together: their phase, phase increment and amplitude are kept
+ * in structure-of-arrays form and every output frame is computed for all of
+ * them at once, so that the sample data are streamed through the cache once
+ * instead of once per voice. All other voices are handed to the regular
+ * interpolators. Apart from floating point contraction, the results are
+ * identical to calling the interpolator of each voice separately.
+ *
+ * @param voices the voices to interpolate (at most #FLUID_RVOICE_BATCH_MAX)
+ * @param dsp_bufs output buffers (#FLUID_BUFSIZE in length), one for each voice
+ * @param is_looping whether each voice is currently looping
+ * @param counts location to store the count of samples written to each buffer
+ * @param voice_count number of voices
+ */
+void
+fluid_rvoice_dsp_interpolate_batch(fluid_rvoice_dsp_t **voices, fluid_real_t **dsp_bufs,
+                                   const int *is_looping, int *counts, int voice_count)
+{
+    fluid_phase_t dsp_phase[FLUID_RVOICE_BATCH_MAX];
+    fluid_phase_t dsp_phase_incr[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t dsp_amp[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t dsp_amp_incr[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t *dsp_buf[FLUID_RVOICE_BATCH_MAX];
+    int index[FLUID_RVOICE_BATCH_MAX];
+    const short int *dsp_data = voices[0]->sample->data;
+    const char *dsp_data24 = voices[0]->sample->data24;
+    const float *dsp_float = voices[0]->sample->float_data;
+    enum fluid_interp interp_method = voices[0]->interp_method;
+    /* 7th order interpolation is centered on the 4th sample point */
+    fluid_phase_t phase_offset = (interp_method == FLUID_INTERP_7THORDER) ? (fluid_phase_t)0x80000000 : 0;
+    unsigned int lookbehind, lookahead;
+    int i, v, n = 0;
+
+    switch(interp_method)
+    {
+    case FLUID_INTERP_LINEAR:
+        lookbehind = 0;
+        lookahead = 1;
+        break;
+
+    case FLUID_INTERP_7THORDER:
+        lookbehind = 3;
+        lookahead = 3;
+        break;
+
+    case FLUID_INTERP_4THORDER:
+    default:
+        lookbehind = 1;
+        lookahead = 2;
+        break;
+    }
+
+    for(v = 0; v < voice_count; v++)
+    {
+        fluid_phase_t phase_incr;
+        fluid_phase_set_float(phase_incr, voices[v]->phase_incr);
+
+        /* no interpolation is cheap enough on its own */
+        if(interp_method != FLUID_INTERP_NONE && voices[v]->start_offset == 0
+                && fluid_rvoice_dsp_batch_eligible(voices[v], is_looping[v], voices[v]->phase + phase_offset,
+                        phase_incr, lookbehind, lookahead))
+        {
+            dsp_phase[n] = voices[v]->phase + phase_offset;
+            dsp_phase_incr[n] = phase_incr;
+            dsp_amp[n] = voices[v]->amp;
+            dsp_amp_incr[n] = voices[v]->amp_incr;
+            dsp_buf[n] = dsp_bufs[v];
+            index[n++] = v;
+            continue;
+        }
+
+        switch(interp_method)
+        {
+        case FLUID_INTERP_NONE:
+            counts[v] = fluid_rvoice_dsp_interpolate_none(voices[v], dsp_bufs[v], is_looping[v]);
+            break;
+
+        case FLUID_INTERP_LINEAR:
+            counts[v] = fluid_rvoice_dsp_interpolate_linear(voices[v], dsp_bufs[v], is_looping[v]);
+            break;
+
+        case FLUID_INTERP_4THORDER:
+        default:
+            counts[v] = fluid_rvoice_dsp_interpolate_4th_order(voices[v], dsp_bufs[v], is_looping[v]);
+            break;
+
+        case FLUID_INTERP_7THORDER:
+            counts[v] = fluid_rvoice_dsp_interpolate_7th_order(voices[v], dsp_bufs[v], is_looping[v]);
+            break;
+        }
+    }
+
+    if(n == 0)
+    {
+        return;
+    }
+
+    for(i = 0; i < FLUID_BUFSIZE; i++)
+    {
+        switch(interp_method)
+        {
+        case FLUID_INTERP_LINEAR:
+            for(v = 0; v < n; v++)
+            {
+                unsigned int idx = fluid_phase_index(dsp_phase[v]);
+                const fluid_real_t *coeffs = interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase[v])];
+
+                dsp_buf[v][i] = dsp_amp[v]
+                                * (coeffs[0] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx)
+                                   + coeffs[1] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + 1));
+            }
+
+            break;
+
+        case FLUID_INTERP_7THORDER:
+            for(v = 0; v < n; v++)
+            {
+                unsigned int idx = fluid_phase_index(dsp_phase[v]);
+                const fluid_real_t *coeffs = sinc_table7[fluid_phase_fract_to_sincrow(dsp_phase[v])];
+
+                dsp_buf[v][i] = dsp_amp[v]
+                                * (coeffs[0] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx - 3)
+                                   + coeffs[1] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx - 2)
+                                   + coeffs[2] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx - 1)
+                                   + coeffs[3] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx)
+                                   + coeffs[4] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + 1)
+                                   + coeffs[5] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + 2)
+                                   + coeffs[6] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + 3));
+            }
+
+            break;
+
+        case FLUID_INTERP_4THORDER:
+        default:
+            for(v = 0; v < n; v++)
+            {
+                unsigned int idx = fluid_phase_index(dsp_phase[v]);
+                const fluid_real_t *coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase[v])];
+
+                dsp_buf[v][i] = dsp_amp[v] *
+                                (coeffs[0] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx - 1)
+                                 + coeffs[1] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx)
+                                 + coeffs[2] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + 1)
+                                 + coeffs[3] * fluid_rvoice_get_point(dsp_data, dsp_data24, dsp_float, idx + 2));
+            }
+
+            break;
+        }
+
+        /* increment phase and amplitude */
+        #pragma omp simd
+        for(v = 0; v < n; v++)
+        {
+            fluid_phase_incr(dsp_phase[v], dsp_phase_incr[v]);
+            dsp_amp[v] += dsp_amp_incr[v];
+        }
+    }
+
+    for(v = 0; v < n; v++)
+    {
+        voices[index[v]]->phase = dsp_phase[v] - phase_offset;
+        voices[index[v]]->amp = dsp_amp[v];
+        counts[index[v]] = FLUID_BUFSIZE;
+    }
+}
@@ -2,7 +2,18 @@
 #ifndef _FLUID_RVOICE_DSP_TABLES_H
 #define _FLUID_RVOICE_DSP_TABLES_H
 
-#define FLUID_INTERP_MAX         256
+/* Resolution of the interpolation tables in bits of the fractional sample position,
+ * see the interp-bits and sinc-interp-bits build options */
+#ifndef FLUID_INTERP_BITS
+#define FLUID_INTERP_BITS        8
+#endif
+
+#ifndef FLUID_SINC_INTERP_BITS
+#define FLUID_SINC_INTERP_BITS   FLUID_INTERP_BITS
+#endif
+
+#define FLUID_INTERP_MAX         (1 << FLUID_INTERP_BITS)
+#define FLUID_SINC_INTERP_MAX    (1 << FLUID_SINC_INTERP_BITS)
 #define SINC_INTERP_ORDER 7	/* 7th order constant */
 
 #endif
@@ -25,12 +25,74 @@
 #include "fluid_lfo.h"
 #include "fluid_adsr_env.h"
 
-static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event);
+/* Number of event slots in each spill segment */
+#define FLUID_RVOICE_EVENT_SEGMENT_SIZE 1024
 
-static FLUID_INLINE void
-fluid_rvoice_event_dispatch(fluid_rvoice_event_t *event)
+/* Number of params an extension slot holds, and the slots taken by an event with all of them */
+#define FLUID_RVOICE_EVENT_SLOT_PARAMS ((int)(sizeof(fluid_rvoice_event_t) / sizeof(fluid_rvoice_param_t)))
+#define FLUID_RVOICE_EVENT_LONG_SLOTS (1 + (MAX_EVENT_PARAMS - FLUID_RVOICE_EVENT_PARAMS \
+                                            + FLUID_RVOICE_EVENT_SLOT_PARAMS - 1) / FLUID_RVOICE_EVENT_SLOT_PARAMS)
+
+/* Events with more than FLUID_RVOICE_EVENT_PARAMS params are marked by the lowest bit
+ * of their object pointer, and the rest of their params follow in the next slots */
+#define FLUID_RVOICE_EVENT_LONG_FLAG ((uintptr_t)1)
+
+struct _fluid_rvoice_event_segment_t
+{
+    fluid_rvoice_event_segment_t *next; /**< Next segment, published at flush */
+    fluid_rvoice_event_segment_t *next_stored; /**< Next segment, only accessed by the pushing thread */
+    unsigned int queue_mark; /**< Count of queue slots to be dispatched before the ones of this segment */
+    int size; /**< Count of event slots the segment can hold */
+    int stored; /**< Count of slots pushed, only accessed by the pushing thread */
+    fluid_atomic_int_t committed; /**< Count of slots flushed */
+    int read; /**< Count of slots dispatched, only accessed by the renderer */
+    fluid_rvoice_event_t *events;
+};
+
+static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler,
+        const fluid_rvoice_event_t *src_event, int slots);
+
+/*
+ * Dispatch the event stored in slots, the first of which must be given.
+ * get_slot() returns the following ones by their index, it is only called for long events.
+ * @return The number of slots the event took up.
+ */
+static FLUID_INLINE int
+fluid_rvoice_event_dispatch(fluid_rvoice_event_t *event, fluid_rvoice_event_t *(*get_slot)(void *data, int index), void *data)
 {
-    event->method(event->object, event->param);
+    fluid_rvoice_param_t param[FLUID_RVOICE_EVENT_LONG_SLOTS * FLUID_RVOICE_EVENT_SLOT_PARAMS];
+    uintptr_t object = (uintptr_t)event->object;
+    int i;
+
+    if(!(object & FLUID_RVOICE_EVENT_LONG_FLAG))
+    {
+        event->method(event->object, event->param);
+        return 1;
+    }
+
+    /* gather the params of a long event, its slots may be split by the end of the queue */
+    FLUID_MEMCPY(param, event->param, sizeof(event->param));
+
+    for(i = 1; i < FLUID_RVOICE_EVENT_LONG_SLOTS; i++)
+    {
+        FLUID_MEMCPY(&param[FLUID_RVOICE_EVENT_PARAMS + (i - 1) * FLUID_RVOICE_EVENT_SLOT_PARAMS],
+                     get_slot(data, i), sizeof(fluid_rvoice_event_t));
+    }
+
+    event->method((void *)(object & ~FLUID_RVOICE_EVENT_LONG_FLAG), param);
+    return FLUID_RVOICE_EVENT_LONG_SLOTS;
+}
+
+static fluid_rvoice_event_t *
+fluid_rvoice_event_get_queue_slot(void *data, int index)
+{
+    return fluid_spsc_queue_get_outptr_at((fluid_spsc_queue_t *)data, index);
+}
+
+static fluid_rvoice_event_t *
+fluid_rvoice_event_get_segment_slot(void *data, int index)
+{
+    return (fluid_rvoice_event_t *)data + index;
 }
 
 
@@ -50,19 +112,42 @@ fluid_rvoice_eventhandler_push_int_real(fluid_rvoice_eventhandler_t *handler,
     local_event.param[0].i = intparam;
     local_event.param[1].real = realparam;
 
-    return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event);
+    return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event, 1);
 }
 
+/**
+ * Push an event with count params, the method must not read any others.
+ * Events with up to FLUID_RVOICE_EVENT_PARAMS params take up a single slot
+ * of the queue, the rest FLUID_RVOICE_EVENT_LONG_SLOTS ones.
+ */
 int
-fluid_rvoice_eventhandler_push(fluid_rvoice_eventhandler_t *handler, fluid_rvoice_function_t method, void *object, fluid_rvoice_param_t param[MAX_EVENT_PARAMS])
+fluid_rvoice_eventhandler_push(fluid_rvoice_eventhandler_t *handler, fluid_rvoice_function_t method, void *object,
+                               fluid_rvoice_param_t param[MAX_EVENT_PARAMS], int count)
 {
-    fluid_rvoice_event_t local_event;
+    fluid_rvoice_event_t local_event[FLUID_RVOICE_EVENT_LONG_SLOTS];
+    fluid_rvoice_param_t *dest = local_event[0].param;
+    int slots = 1;
 
-    local_event.method = method;
-    local_event.object = object;
-    FLUID_MEMCPY(&local_event.param, param, sizeof(*param) * MAX_EVENT_PARAMS);
+    fluid_return_val_if_fail(count >= 0 && count <= MAX_EVENT_PARAMS, FLUID_FAILED);
+    fluid_return_val_if_fail(((uintptr_t)object & FLUID_RVOICE_EVENT_LONG_FLAG) == 0, FLUID_FAILED);
+
+    local_event[0].method = method;
+    local_event[0].object = object;
+
+    if(count > FLUID_RVOICE_EVENT_PARAMS)
+    {
+        /* the params continue in the slots following the first one */
+        local_event[0].object = (void *)((uintptr_t)object | FLUID_RVOICE_EVENT_LONG_FLAG);
+        FLUID_MEMCPY(dest, param, sizeof(*param) * FLUID_RVOICE_EVENT_PARAMS);
+        dest = (fluid_rvoice_param_t *)&local_event[1];
+        param += FLUID_RVOICE_EVENT_PARAMS;
+        count -= FLUID_RVOICE_EVENT_PARAMS;
+        slots = FLUID_RVOICE_EVENT_LONG_SLOTS;
+    }
 
-    return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event);
+    FLUID_MEMCPY(dest, param, sizeof(*param) * count);
+
+    return fluid_rvoice_eventhandler_push_LOCAL(handler, local_event, slots);
 }
 
 int
@@ -75,33 +160,243 @@ fluid_rvoice_eventhandler_push_ptr(fluid_rvoice_eventhandler_t *handler,
     local_event.object = object;
     local_event.param[0].ptr = ptr;
 
-    return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event);
+    return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event, 1);
+}
+
+static fluid_rvoice_event_segment_t *
+new_fluid_rvoice_event_segment(int size)
+{
+    fluid_rvoice_event_segment_t *segment;
+
+    segment = FLUID_MALLOC(sizeof(*segment) + size * sizeof(fluid_rvoice_event_t));
+
+    if(segment == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(segment, 0, sizeof(*segment));
+    segment->size = size;
+    segment->events = (fluid_rvoice_event_t *)(segment + 1);
+
+    return segment;
 }
 
-static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event)
+/*
+ * Move the spill segments the renderer is done with to the free list.
+ */
+static void
+fluid_rvoice_eventhandler_recycle(fluid_rvoice_eventhandler_t *handler)
 {
+    fluid_rvoice_event_segment_t *out = fluid_atomic_pointer_get(&handler->spill_out);
+    fluid_rvoice_event_segment_t *segment;
+
+    while(handler->spill_first != out)
+    {
+        segment = handler->spill_first;
+        handler->spill_first = segment->next_stored;
+
+        if(segment->size == 0)
+        {
+            /* the empty segment the handler starts with */
+            FLUID_FREE(segment);
+            continue;
+        }
+
+        segment->next_stored = handler->spill_free;
+        handler->spill_free = segment;
+    }
+}
+
+/*
+ * Get the location to store the slots of the next spilled event in, allocating
+ * a new segment if needed. A new segment is started as well if new_run is TRUE,
+ * i.e. if the queue overflowed again after the renderer had dispatched all
+ * spilled events, so that the segment knows which queue events go first.
+ */
+static fluid_rvoice_event_t *
+fluid_rvoice_eventhandler_spill(fluid_rvoice_eventhandler_t *handler, int new_run, int slots)
+{
+    fluid_rvoice_event_segment_t *segment = handler->spill_last;
     fluid_rvoice_event_t *event;
-    int old_queue_stored = fluid_atomic_int_add(&handler->queue_stored, 1);
 
-    event = fluid_ringbuffer_get_inptr(handler->queue, old_queue_stored);
+    /* the slots of an event are kept together, the end of a segment is left unused otherwise */
+    if(new_run || segment->stored + slots > segment->size)
+    {
+        fluid_rvoice_eventhandler_recycle(handler);
+
+        if(handler->spill_free != NULL)
+        {
+            segment = handler->spill_free;
+            handler->spill_free = segment->next_stored;
+        }
+        else
+        {
+            segment = new_fluid_rvoice_event_segment(FLUID_RVOICE_EVENT_SEGMENT_SIZE);
+
+            if(segment == NULL)
+            {
+                return NULL;
+            }
+
+            handler->spill_segments++;
+            FLUID_LOG(FLUID_DBG, "Event queue full, %d spill segments allocated", handler->spill_segments);
+        }
+
+        segment->next = NULL;
+        segment->next_stored = NULL;
+        segment->queue_mark = handler->queue_pushed + fluid_atomic_int_get(&handler->queue_stored);
+        segment->stored = 0;
+        fluid_atomic_int_set(&segment->committed, 0);
+        segment->read = 0;
+
+        /* the link to the new segment is published by the next flush */
+        if(handler->spill_flush == NULL)
+        {
+            handler->spill_flush = handler->spill_last;
+        }
+
+        handler->spill_last->next_stored = segment;
+        handler->spill_last = segment;
+    }
+    else if(handler->spill_flush == NULL)
+    {
+        handler->spill_flush = segment;
+    }
+
+    handler->spill_stored += slots;
+    event = &segment->events[segment->stored];
+    segment->stored += slots;
+
+    return event;
+}
+
+static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler,
+        const fluid_rvoice_event_t *src_event, int slots)
+{
+    fluid_rvoice_event_t *event = NULL;
+    int old_queue_stored, i;
+
+    /* Once an event has been spilled, the following ones have to be spilled
+     * as well until the renderer has dispatched them all, to keep their order. */
+    if(handler->spill_stored == fluid_atomic_int_get(&handler->spill_dispatched))
+    {
+        old_queue_stored = fluid_atomic_int_add(&handler->queue_stored, slots);
+
+        if(fluid_spsc_queue_get_inptr(handler->queue, old_queue_stored + slots - 1) == NULL)
+        {
+            fluid_atomic_int_add(&handler->queue_stored, -slots);
+            event = fluid_rvoice_eventhandler_spill(handler, TRUE, slots);
+        }
+        else
+        {
+            /* the slots in the queue may wrap around its end */
+            for(i = 0; i < slots; i++)
+            {
+                event = fluid_spsc_queue_get_inptr(handler->queue, old_queue_stored + i);
+                FLUID_MEMCPY(event, &src_event[i], sizeof(*event));
+            }
+
+            return FLUID_OK;
+        }
+    }
+    else
+    {
+        event = fluid_rvoice_eventhandler_spill(handler, FALSE, slots);
+    }
 
     if(event == NULL)
     {
-        fluid_atomic_int_add(&handler->queue_stored, -1);
-        FLUID_LOG(FLUID_WARN, "Ringbuffer full, try increasing polyphony!");
-        return FLUID_FAILED; // Buffer full...
+        FLUID_LOG(FLUID_WARN, "Event queue full and out of memory, event dropped!");
+        return FLUID_FAILED;
     }
 
-    FLUID_MEMCPY(event, src_event, sizeof(*event));
+    FLUID_MEMCPY(event, src_event, slots * sizeof(*event));
 
     return FLUID_OK;
 }
 
+/**
+ * Commit all events pushed since the last flush, so that the renderer
+ * dispatches them at once.
+ */
+void
+fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
+{
+    fluid_rvoice_event_segment_t *segment;
+    int queue_stored = fluid_atomic_int_get(&handler->queue_stored);
+    int queued;
+
+    if(queue_stored > 0)
+    {
+        fluid_atomic_int_set(&handler->queue_stored, 0);
+        fluid_spsc_queue_next_inptr(handler->queue, queue_stored);
+        handler->queue_pushed += queue_stored;
+    }
+
+    /* The events of a segment must be committed before the link to the next
+     * segment is published, the renderer leaves a segment once it sees the link. */
+    for(segment = handler->spill_flush; segment != NULL; segment = segment->next_stored)
+    {
+        fluid_atomic_int_set(&segment->committed, segment->stored);
+
+        if(segment->next_stored != NULL)
+        {
+            fluid_atomic_pointer_set(&segment->next, segment->next_stored);
+        }
+    }
+
+    if(handler->spill_flush != NULL)
+    {
+        handler->spill_flush = NULL;
+        fluid_atomic_int_set(&handler->spill_committed, handler->spill_stored);
+    }
+
+    queued = fluid_spsc_queue_get_count(handler->queue)
+             + handler->spill_stored - fluid_atomic_int_get(&handler->spill_dispatched);
+
+    if(queued > fluid_atomic_int_get(&handler->max_queued))
+    {
+        fluid_atomic_int_set(&handler->max_queued, queued);
+    }
+}
+
+/**
+ * Get statistics about the event queue. Must be called by the pushing thread.
+ * Long events are counted by the slots they take up.
+ * @param capacity Returns the number of event slots that fit into the memory allocated (may be NULL)
+ * @param queued Returns the number of event slots waiting to be dispatched (may be NULL)
+ * @param max_queued Returns the largest number of event slots that were waiting at once (may be NULL)
+ */
+void
+fluid_rvoice_eventhandler_get_stats(fluid_rvoice_eventhandler_t *handler,
+                                    int *capacity, int *queued, int *max_queued)
+{
+    if(capacity != NULL)
+    {
+        *capacity = fluid_spsc_queue_get_capacity(handler->queue)
+                    + handler->spill_segments * FLUID_RVOICE_EVENT_SEGMENT_SIZE;
+    }
+
+    if(queued != NULL)
+    {
+        *queued = fluid_spsc_queue_get_count(handler->queue)
+                  + fluid_atomic_int_get(&handler->queue_stored)
+                  + handler->spill_stored - fluid_atomic_int_get(&handler->spill_dispatched);
+    }
+
+    if(max_queued != NULL)
+    {
+        *max_queued = fluid_atomic_int_get(&handler->max_queued);
+    }
+}
+
 
 void
 fluid_rvoice_eventhandler_finished_voice_callback(fluid_rvoice_eventhandler_t *eventhandler, fluid_rvoice_t *rvoice)
 {
-    fluid_rvoice_t **vptr = fluid_ringbuffer_get_inptr(eventhandler->finished_voices, 0);
+    fluid_rvoice_t **vptr = fluid_spsc_queue_get_inptr(eventhandler->finished_voices, 0);
 
     if(vptr == NULL)
     {
@@ -109,12 +404,12 @@ fluid_rvoice_eventhandler_finished_voice_callback(fluid_rvoice_eventhandler_t *e
     }
 
     *vptr = rvoice;
-    fluid_ringbuffer_next_inptr(eventhandler->finished_voices, 1);
+    fluid_spsc_queue_next_inptr(eventhandler->finished_voices, 1);
 }
 
 fluid_rvoice_eventhandler_t *
 new_fluid_rvoice_eventhandler(int queuesize,
-                              int finished_voices_size, int bufs, int fx_bufs, int fx_units, fluid_real_t sample_rate, int extra_threads, int prio)
+                              int finished_voices_size, int bufs, int fx_bufs, int fx_units, int extra_threads, int prio)
 {
     fluid_rvoice_eventhandler_t *eventhandler = FLUID_NEW(fluid_rvoice_eventhandler_t);
 
@@ -124,13 +419,25 @@ new_fluid_rvoice_eventhandler(int queuesize,
         return NULL;
     }
 
-    eventhandler->mixer = NULL;
-    eventhandler->queue = NULL;
-    eventhandler->finished_voices = NULL;
+    FLUID_MEMSET(eventhandler, 0, sizeof(*eventhandler));
 
     fluid_atomic_int_set(&eventhandler->queue_stored, 0);
+    fluid_atomic_int_set(&eventhandler->spill_committed, 0);
+    fluid_atomic_int_set(&eventhandler->spill_dispatched, 0);
+    fluid_atomic_int_set(&eventhandler->max_queued, 0);
 
-    eventhandler->finished_voices = new_fluid_ringbuffer(finished_voices_size,
+    /* an empty segment to start from, so that the renderer always has one */
+    eventhandler->spill_first = new_fluid_rvoice_event_segment(0);
+
+    if(eventhandler->spill_first == NULL)
+    {
+        goto error_recovery;
+    }
+
+    eventhandler->spill_last = eventhandler->spill_first;
+    eventhandler->spill_out = eventhandler->spill_first;
+
+    eventhandler->finished_voices = new_fluid_spsc_queue(finished_voices_size,
                                     sizeof(fluid_rvoice_t *));
 
     if(eventhandler->finished_voices == NULL)
@@ -138,14 +445,14 @@ new_fluid_rvoice_eventhandler(int queuesize,
         goto error_recovery;
     }
 
-    eventhandler->queue = new_fluid_ringbuffer(queuesize, sizeof(fluid_rvoice_event_t));
+    eventhandler->queue = new_fluid_spsc_queue(queuesize, sizeof(fluid_rvoice_event_t));
 
     if(eventhandler->queue == NULL)
     {
         goto error_recovery;
     }
 
-    eventhandler->mixer = new_fluid_rvoice_mixer(bufs, fx_bufs, fx_units, sample_rate, eventhandler, extra_threads, prio);
+    eventhandler->mixer = new_fluid_rvoice_mixer(bufs, fx_bufs, fx_units, eventhandler, extra_threads, prio);
 
     if(eventhandler->mixer == NULL)
     {
@@ -162,7 +469,9 @@ error_recovery:
 int
 fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *handler)
 {
-    return fluid_ringbuffer_get_count(handler->queue);
+    return fluid_spsc_queue_get_count(handler->queue)
+           + fluid_atomic_int_get(&handler->spill_committed)
+           - fluid_atomic_int_get(&handler->spill_dispatched);
 }
 
 
@@ -174,13 +483,51 @@ int
 fluid_rvoice_eventhandler_dispatch_all(fluid_rvoice_eventhandler_t *handler)
 {
     fluid_rvoice_event_t *event;
-    int result = 0;
+    fluid_rvoice_event_segment_t *segment, *next;
+    int committed, count, slots, result = 0;
 
-    while(NULL != (event = fluid_ringbuffer_get_outptr(handler->queue)))
+    while(1)
     {
-        fluid_rvoice_event_dispatch(event);
-        result++;
-        fluid_ringbuffer_next_outptr(handler->queue);
+        while(NULL != (event = fluid_spsc_queue_get_outptr(handler->queue)))
+        {
+            slots = fluid_rvoice_event_dispatch(event, fluid_rvoice_event_get_queue_slot, handler->queue);
+            result++;
+            handler->queue_dispatched += slots;
+
+            fluid_spsc_queue_next_outptr(handler->queue, slots);
+        }
+
+        segment = handler->spill_out;
+
+        if((int)(handler->queue_dispatched - segment->queue_mark) < 0)
+        {
+            /* events pushed before the spilled ones are still to come through the queue */
+            break;
+        }
+
+        /* no more events are added to a segment once it is linked to the next one */
+        next = fluid_atomic_pointer_get(&segment->next);
+        committed = fluid_atomic_int_get(&segment->committed);
+        count = committed - segment->read;
+
+        while(segment->read < committed)
+        {
+            event = &segment->events[segment->read];
+            segment->read += fluid_rvoice_event_dispatch(event, fluid_rvoice_event_get_segment_slot, event);
+            result++;
+        }
+
+        if(count > 0)
+        {
+            fluid_atomic_int_add(&handler->spill_dispatched, count);
+        }
+
+        if(next == NULL)
+        {
+            break;
+        }
+
+        fluid_atomic_pointer_set(&handler->spill_out, next);
     }
 
     return result;
@@ -193,7 +540,22 @@ delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *handler)
     fluid_return_if_fail(handler != NULL);
 
     delete_fluid_rvoice_mixer(handler->mixer);
-    delete_fluid_ringbuffer(handler->queue);
-    delete_fluid_ringbuffer(handler->finished_voices);
+    delete_fluid_spsc_queue(handler->queue);
+    delete_fluid_spsc_queue(handler->finished_voices);
+
+    while(handler->spill_first != NULL)
+    {
+        fluid_rvoice_event_segment_t *segment = handler->spill_first;
+        handler->spill_first = segment->next_stored;
+        FLUID_FREE(segment);
+    }
+
+    while(handler->spill_free != NULL)
+    {
+        fluid_rvoice_event_segment_t *segment = handler->spill_free;
+        handler->spill_free = segment->next_stored;
+        FLUID_FREE(segment);
+    }
+
     FLUID_FREE(handler);
 }
@@ -24,33 +24,58 @@
 
 #include "fluidsynth_priv.h"
 #include "fluid_rvoice_mixer.h"
-#include "fluid_ringbuffer.h"
+#include "fluid_spsc_queue.h"
 
 typedef struct _fluid_rvoice_event_t fluid_rvoice_event_t;
 
+/* The number of parameters stored along with the method and object of an event. Events
+ * with more of them are followed by slots holding the rest, see fluid_rvoice_eventhandler_push(). */
+#define FLUID_RVOICE_EVENT_PARAMS 2
+
 struct _fluid_rvoice_event_t
 {
     fluid_rvoice_function_t method;
     void *object;
-    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    fluid_rvoice_param_t param[FLUID_RVOICE_EVENT_PARAMS];
 };
 
+typedef struct _fluid_rvoice_event_segment_t fluid_rvoice_event_segment_t;
+
 /*
  * Bridge between the renderer thread and the midi state thread.
  * fluid_rvoice_eventhandler_fetch_all() can be called in parallel
  * with fluid_rvoice_eventhandler_push/flush()
+ *
+ * Events that don't fit into the queue any more are chained into spill
+ * segments, which are allocated and recycled by the pushing thread only.
+ * The renderer thread dispatches them after the events that were pushed
+ * to the queue before them.
  */
 struct _fluid_rvoice_eventhandler_t
 {
-    fluid_ringbuffer_t *queue; /**< List of fluid_rvoice_event_t */
+    fluid_spsc_queue_t *queue; /**< List of fluid_rvoice_event_t slots */
     fluid_atomic_int_t queue_stored; /**< Extras pushed but not flushed */
-    fluid_ringbuffer_t *finished_voices; /**< return queue from handler, list of fluid_rvoice_t* */
+    unsigned int queue_pushed; /**< Count of event slots ever flushed to queue, only accessed by the pushing thread */
+    unsigned int queue_dispatched; /**< Count of event slots ever dispatched from queue, only accessed by the renderer */
+
+    fluid_rvoice_event_segment_t *spill_first; /**< Oldest spill segment not recycled yet */
+    fluid_rvoice_event_segment_t *spill_last; /**< Spill segment events are pushed to */
+    fluid_rvoice_event_segment_t *spill_flush; /**< Oldest spill segment holding events not flushed */
+    fluid_rvoice_event_segment_t *spill_free; /**< Recycled spill segments */
+    fluid_rvoice_event_segment_t *spill_out; /**< Spill segment currently dispatched by the renderer */
+    int spill_stored; /**< Count of event slots ever pushed to spill segments, including those not flushed */
+    fluid_atomic_int_t spill_committed; /**< Count of spill event slots ever flushed */
+    fluid_atomic_int_t spill_dispatched; /**< Count of spill event slots ever dispatched */
+    int spill_segments; /**< Count of allocated spill segments */
+    fluid_atomic_int_t max_queued; /**< Highest count of event slots waiting to be dispatched at a flush */
+
+    fluid_spsc_queue_t *finished_voices; /**< return queue from handler, list of fluid_rvoice_t* */
     fluid_rvoice_mixer_t *mixer;
 };
 
 fluid_rvoice_eventhandler_t *new_fluid_rvoice_eventhandler(
     int queuesize, int finished_voices_size, int bufs,
-    int fx_bufs, int fx_units, fluid_real_t sample_rate, int, int);
+    int fx_bufs, int fx_units, int, int);
 
 void delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *);
 
@@ -58,18 +83,9 @@ int fluid_rvoice_eventhandler_dispatch_all(fluid_rvoice_eventhandler_t *);
 int fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *);
 void fluid_rvoice_eventhandler_finished_voice_callback(fluid_rvoice_eventhandler_t *eventhandler,
         fluid_rvoice_t *rvoice);
-
-static FLUID_INLINE void
-fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
-{
-    int queue_stored = fluid_atomic_int_get(&handler->queue_stored);
-
-    if(queue_stored > 0)
-    {
-        fluid_atomic_int_set(&handler->queue_stored, 0);
-        fluid_ringbuffer_next_inptr(handler->queue, queue_stored);
-    }
-}
+void fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler);
+void fluid_rvoice_eventhandler_get_stats(fluid_rvoice_eventhandler_t *handler,
+        int *capacity, int *queued, int *max_queued);
 
 /**
  * @return next finished voice, or NULL if nothing in queue
@@ -77,7 +93,7 @@ fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
 static FLUID_INLINE fluid_rvoice_t *
 fluid_rvoice_eventhandler_get_finished_voice(fluid_rvoice_eventhandler_t *handler)
 {
-    void *result = fluid_ringbuffer_get_outptr(handler->finished_voices);
+    void *result = fluid_spsc_queue_get_outptr(handler->finished_voices);
 
     if(result == NULL)
     {
@@ -85,7 +101,7 @@ fluid_rvoice_eventhandler_get_finished_voice(fluid_rvoice_eventhandler_t *handle
     }
 
     result = * (fluid_rvoice_t **) result;
-    fluid_ringbuffer_next_outptr(handler->finished_voices);
+    fluid_spsc_queue_next_outptr(handler->finished_voices, 1);
     return result;
 }
 
@@ -99,7 +115,7 @@ int fluid_rvoice_eventhandler_push_ptr(fluid_rvoice_eventhandler_t *handler,
 
 int fluid_rvoice_eventhandler_push(fluid_rvoice_eventhandler_t *handler,
                                    fluid_rvoice_function_t method, void *object,
-                                   fluid_rvoice_param_t param[MAX_EVENT_PARAMS]);
+                                   fluid_rvoice_param_t param[MAX_EVENT_PARAMS], int count);
 
 static FLUID_INLINE void
 fluid_rvoice_eventhandler_add_rvoice(fluid_rvoice_eventhandler_t *handler,
@@ -109,6 +125,41 @@ fluid_rvoice_eventhandler_add_rvoice(fluid_rvoice_eventhandler_t *handler,
                                        handler->mixer, rvoice);
 }
 
+/* Adds up to MAX_EVENT_PARAMS rvoices to the mixer with a single event */
+static FLUID_INLINE void
+fluid_rvoice_eventhandler_add_rvoices(fluid_rvoice_eventhandler_t *handler,
+                                      fluid_rvoice_t **rvoices, int count)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    int i;
+
+    for(i = 0; i < MAX_EVENT_PARAMS; i++)
+    {
+        param[i].ptr = (i < count) ? rvoices[i] : NULL;
+    }
+
+    /* terminated by NULL, unless all of the params are taken */
+    fluid_rvoice_eventhandler_push(handler, fluid_rvoice_mixer_add_voices, handler->mixer, param,
+                                   (count < MAX_EVENT_PARAMS) ? count + 1 : MAX_EVENT_PARAMS);
+}
+
+/* Finishes up to MAX_EVENT_PARAMS rvoices with a single event */
+static FLUID_INLINE void
+fluid_rvoice_eventhandler_rvoices_off(fluid_rvoice_eventhandler_t *handler,
+                                      fluid_rvoice_t **rvoices, int count)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    int i;
+
+    for(i = 0; i < MAX_EVENT_PARAMS; i++)
+    {
+        param[i].ptr = (i < count) ? rvoices[i] : NULL;
+    }
+
+    fluid_rvoice_eventhandler_push(handler, fluid_rvoice_mixer_voices_off, handler->mixer, param,
+                                   (count < MAX_EVENT_PARAMS) ? count + 1 : MAX_EVENT_PARAMS);
+}
+
 
 
 #endif
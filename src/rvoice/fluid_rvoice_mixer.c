@@ -20,9 +20,12 @@
 
 #include "fluid_rvoice_mixer.h"
 #include "fluid_rvoice.h"
+#include "fluid_note_cache.h"
 #include "fluid_sys.h"
+#include "fluid_trace.h"
 #include "fluid_rev.h"
 #include "fluid_chorus.h"
+#include "fluid_convolver.h"
 #include "fluid_ladspa.h"
 #include "fluid_synth.h"
 
@@ -31,14 +34,38 @@
 // so don't activate the thread(s).
 #define VOICES_PER_THREAD 8
 
+// How many voices following a voice are searched for others playing the same sample,
+// in order to synthesize them together.
+#define BATCH_SEARCH_WINDOW 64
+
+// Number of voice chunks the work-stealing scheduler creates per worker and block,
+// so that workers finishing early have something left to steal.
+#define WS_CHUNKS_PER_WORKER 4
+
+// Number of times an idle mixer thread checks for new work before going to sleep
+// when using the work-stealing scheduler.
+#define WS_SPIN_COUNT 4096
+
+// Most pause instructions a spinning mixer thread executes between two checks for new work
+#define SPIN_MAX_PAUSES 64
+
+// Pause instructions the rendering thread executes between two polls of spinning mixer threads
+#define SPIN_POLL_PAUSES 16
+
 typedef struct _fluid_mixer_buffers_t fluid_mixer_buffers_t;
+typedef struct _fluid_render_pool_t fluid_render_pool_t;
 
 struct _fluid_mixer_buffers_t
 {
     fluid_rvoice_mixer_t *mixer; /**< Owner of object */
 #if ENABLE_MIXER_THREADS
     fluid_thread_t *thread;     /**< Thread object */
+    void *factory_thread;       /**< Thread object created by the thread factory of the mixer instead, or NULL */
     fluid_atomic_int_t ready;   /**< Atomic: buffers are ready for mixing */
+    int worker;                 /**< Index of this thread's deque for the work-stealing scheduler (0 = main thread) */
+    int core;                   /**< CPU core the thread is pinned to, -1 if not pinned */
+    int flush_denormals;        /**< Does the thread currently flush denormals to zero? */
+    void *workgroup_token;      /**< Token of the audio workgroup joined by the thread, or NULL */
 #endif
 
     fluid_rvoice_t **finished_voices; /* List of voices who have finished */
@@ -46,6 +73,10 @@ struct _fluid_mixer_buffers_t
 
     fluid_real_t *local_buf;
 
+    /** FLUID_RVOICE_BATCH_MAX mono voice buffers for synthesizing voices that play the same sample
+     * together, each FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT in length */
+    fluid_real_t *batch_buf;
+
     int buf_count;
     int fx_buf_count;
 
@@ -70,14 +101,114 @@ struct _fluid_mixer_buffers_t
      */
     fluid_real_t *fx_left_buf;
     fluid_real_t *fx_right_buf;
+
+    /** buffers of the caller the first stereo channel is rendered to instead of \c left_buf
+     * and \c right_buf while set, see fluid_rvoice_mixer_set_output(). Only used by the
+     * buffers of the mixer itself, NULL otherwise. */
+    fluid_real_t *out_left;
+    fluid_real_t *out_right;
+
+    /** number of blocks at the beginning of each buffer that may have been written to since
+     * the buffer was zeroed last. Indexed like the buffers of fluid_mixer_buffers_prepare()
+     * (2 * \c buf_count interleaved left and right buffers followed by the \c fx_buf_count
+     * left effects buffers), followed by the \c fx_buf_count right effects buffers.
+     * Buffers that have not been written to are neither zeroed nor mixed. */
+    int *dirty;
+
+    /** indices into \c dirty of the buffers written to since they were zeroed last, in the order
+     * of their first write, so that zeroing and mixing never have to look at the others */
+    int *touched;
+    int touched_count;
 };
 
+/* indices into fluid_mixer_buffers_t::dirty */
+#define DIRTY_LEFT(buffers, i) (2 * (i))
+#define DIRTY_RIGHT(buffers, i) (2 * (i) + 1)
+#define DIRTY_FX_LEFT(buffers, i) (2 * (buffers)->buf_count + (i))
+#define DIRTY_FX_RIGHT(buffers, i) (2 * (buffers)->buf_count + (buffers)->fx_buf_count + (i))
+
 typedef struct _fluid_mixer_fx_t fluid_mixer_fx_t;
 
 struct _fluid_mixer_fx_t
 {
     fluid_revmodel_t *reverb; /**< Reverb unit */
     fluid_chorus_t *chorus; /**< Chorus unit */
+    fluid_convolver_t *conv; /**< Convolution reverb used instead of the reverb unit, or NULL */
+
+    /* TRUE when the unit had no input and its output decayed below the noise floor.
+     * The unit has been reset and is bypassed until input shows up again. */
+    int reverb_idle;
+    int chorus_idle;
+
+    /* gains of the effects inputs of the group, see fluid_rvoice_mixer_set_fx_send() */
+    fluid_real_t reverb_send;
+    fluid_real_t chorus_send;
+};
+
+/* effects units for a sample rate change or for turning an effect on or off, see new_fluid_rvoice_mixer_rate() */
+struct _fluid_rvoice_mixer_rate_t
+{
+    fluid_real_t sample_rate;
+    int fx_units;
+    int reverb;                     /**< What to do with the reverb units, see #fluid_mixer_fx_change */
+    int chorus;                     /**< What to do with the chorus units, see #fluid_mixer_fx_change */
+    fluid_mixer_fx_t *fx;           /**< Units to swap in, the replaced ones once swapped */
+    fluid_atomic_int_t swapped;     /**< Atomic: has fluid_rvoice_mixer_set_rate() been dispatched? */
+};
+
+/* level meter of a mixer buffer, see fluid_rvoice_mixer_enable_meters() */
+typedef struct
+{
+    /* Only accessed by the rendering thread: the levels since the last reset */
+    fluid_real_t peak;
+    double sum;                     /**< Sum of the squares of the samples */
+    double count;                   /**< Count of the samples */
+
+    volatile float level_peak;      /**< Atomic: peak published to the readers */
+    volatile float level_rms;       /**< Atomic: RMS published to the readers */
+    fluid_atomic_int_t reset;       /**< Atomic: set by the reader to start measuring anew */
+} fluid_mixer_meter_t;
+
+/* voices published after each rendering, see fluid_rvoice_mixer_enable_snapshot() */
+typedef struct
+{
+    fluid_voice_snapshot_t *voices[2]; /**< The latest voices in voices[seq % 2], the next ones written to the other one */
+    int count[2];                   /**< Count of the voices in each array */
+    int size;                       /**< Length of both arrays */
+    fluid_atomic_int_t seq;         /**< Atomic: incremented once the next voices have been written */
+} fluid_mixer_snapshot_t;
+
+/* count of the input samples weighted for each output sample of the upsampler */
+#define FLUID_MIXER_UPSAMPLER_TAPS 48
+
+/* cutoff of the upsampler relative to the Nyquist frequency of the input */
+#define FLUID_MIXER_UPSAMPLER_CUTOFF 0.9
+
+/* Kaiser window of the upsampler filter, attenuating its stop band by about 85 dB */
+#define FLUID_MIXER_UPSAMPLER_BETA 8.6
+
+/* polyphase upsampler of the mixer buffers to the output rate, see fluid_rvoice_mixer_set_upsampling() */
+typedef struct
+{
+    int num;                        /**< Output samples per \c den input samples */
+    int den;
+    fluid_real_t *coefs;            /**< \c num phases of FLUID_MIXER_UPSAMPLER_TAPS coefficients, latest input sample first */
+    int channels;                   /**< Count of the buffers, indexed like fluid_mixer_buffers_t::dirty */
+    int in_size;                    /**< Length of the input of each buffer */
+    fluid_real_t *in;               /**< Input of each buffer, starting with the FLUID_MIXER_UPSAMPLER_TAPS - 1 samples still needed */
+    int *silent;                    /**< Count of the zero samples at the end of each input */
+    int in_frames;                  /**< Count of the samples in each input */
+    int next;                       /**< Index of the latest input sample of the next output sample */
+    int phase;                      /**< Phase of the next output sample, 0 to \c num - 1 */
+    fluid_real_t *out;              /**< Output buffers, laid out like left_buf, right_buf, fx_left_buf and fx_right_buf in a row */
+} fluid_mixer_upsampler_t;
+
+/* convolution reverb for an fx unit, see new_fluid_rvoice_mixer_ir() */
+struct _fluid_rvoice_mixer_ir_t
+{
+    int unit;
+    fluid_convolver_t *conv;        /**< Convolver to swap in, the replaced one once swapped */
+    fluid_atomic_int_t swapped;     /**< Atomic: has fluid_rvoice_mixer_set_ir() been dispatched? */
 };
 
 struct _fluid_rvoice_mixer_t
@@ -88,18 +219,32 @@ struct _fluid_rvoice_mixer_t
     fluid_rvoice_eventhandler_t *eventhandler;
 
     fluid_rvoice_t **rvoices; /**< Read-only: Voices array, sorted so that all nulls are last */
-    int polyphony; /**< Read-only: Length of voices array */
+    int polyphony; /**< Read-only: Maximum number of voices */
+    int polyphony_capacity; /**< Read-only: Length of voices array, see fluid_rvoice_mixer_reserve_polyphony() */
     int active_voices; /**< Read-only: Number of non-null voices */
     int current_blockcount;      /**< Read-only: how many blocks to process this time */
     int fx_units;
     int with_reverb;        /**< Should the synth use the built-in reverb unit? */
     int with_chorus;        /**< Should the synth use the built-in chorus unit? */
     int mix_fx_to_out;      /**< Should the effects be mixed in with the primary output? */
+    int fx_shared;          /**< Do all fx groups feed the units of the first one? See fluid_rvoice_mixer_set_fx_shared() */
+    int prefetch_voices;    /**< Are the voices about to be rendered prefetched? See fluid_rvoice_mixer_set_prefetch() */
+    int fused_voices;       /**< Are the voices rendered on their own filtered and mixed in one pass? See fluid_rvoice_mixer_set_fused() */
+    fluid_note_cache_t *note_cache; /**< Rendered notes of unlooped voices, or NULL, see fluid_rvoice_mixer_set_note_cache() */
+    int reverb_decimation;  /**< Rate divider of the reverb units created, see fluid_rvoice_mixer_set_reverb_decimation() */
 
 #ifdef LADSPA
     fluid_ladspa_fx_t *ladspa_fx; /**< Used by mixer only: Effects unit for LADSPA support. Never created or freed */
 #endif
 
+    int render_core;             /**< CPU core to pin the rendering thread to, -1 if not pinned */
+    fluid_thread_id_t render_thread; /**< Rendering thread last pinned to render_core */
+    int flush_denormals;         /**< Are denormals flushed to zero by all rendering threads? */
+    fluid_mixer_meter_t *meters; /**< Level meters indexed like fluid_mixer_buffers_t::dirty, or NULL */
+    fluid_mixer_snapshot_t *snapshot; /**< Voices published after each rendering, or NULL */
+    fluid_mixer_upsampler_t *upsampler; /**< Upsampler of the buffers to the output rate, or NULL */
+    int output_used;             /**< Has the last rendering written to the buffers of fluid_rvoice_mixer_set_output()? */
+
 #if ENABLE_MIXER_THREADS
 //  int sleeping_threads;        /**< Atomic: number of threads currently asleep */
 //  int active_threads;          /**< Atomic: number of threads in the thread loop */
@@ -112,93 +257,437 @@ struct _fluid_rvoice_mixer_t
 
     int thread_count;            /**< Number of extra mixer threads for multi-core rendering */
     fluid_mixer_buffers_t *threads;    /**< Array of mixer threads (thread_count in length) */
+    fluid_render_pool_t *pool;   /**< Render pool shared with other mixers, whose workers use the buffers of \c threads instead of own threads, or NULL */
+    int pool_busy;               /**< Number of pool workers currently rendering for the mixer, guarded by the lock of the pool */
+    int pool_leaving;            /**< Is the mixer waiting for pool_busy to drop to 0? Guarded by the lock of the pool */
+    int thread_prio;             /**< Real-time prio level of the extra mixer threads */
+    int *thread_cores;           /**< CPU cores to pin the extra mixer threads to (thread_count in length), or NULL */
+    void *workgroup;             /**< Audio workgroup of the device for the extra mixer threads to join, or NULL */
+    fluid_thread_factory_t thread_factory; /**< Creates the extra mixer threads if create is not NULL, instead of new_fluid_thread() */
+
+    int scheduler;               /**< How voices are distributed among threads, see #fluid_mixer_scheduler */
+    double spin_time;            /**< Microseconds idle mixer threads keep spinning after their last work before going to sleep, 0 to sleep right away */
+    fluid_atomic_int_t parked_threads; /**< Atomic: number of threads waiting on wakeup_threads */
+
+    /* Work-stealing scheduler: the active voices are split into chunks of similar cost
+     * (ws_chunks[i] is the index of the first voice of chunk i, polyphony+1 in length).
+     * Each worker owns a deque of chunk indices, packed as (head << 16) | tail into an atomic
+     * int ((thread_count+1) in length). The owner pops from the head, others steal from the tail. */
+    int *ws_chunks;
+    fluid_atomic_int_t *ws_deques;
+    int ws_workers;              /**< Number of workers participating in the current block */
+    int next_mix;                /**< Deterministic scheduler: the extra thread to mix in next */
+
+    fluid_atomic_int_t current_fx; /**< Atomic: next fx job for the threads to process */
+    int fx_jobs;                 /**< Number of fx jobs (reverb or chorus of one fx unit) in the current block */
+#ifdef LADSPA
+    int ladspa_jobs;             /**< TRUE if the fx jobs are the LADSPA effects of ladspa_stage instead */
+    int ladspa_stage;            /**< Stage of the LADSPA effects being run by the fx jobs */
+#endif
+
+    double wait_time;            /**< Microseconds the rendering thread waited for the mixer threads, see fluid_rvoice_mixer_take_wait_time() */
 #endif
 };
 
 #if ENABLE_MIXER_THREADS
 static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer);
 static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level);
+static void fluid_rvoice_mixer_leave_render_pool(fluid_rvoice_mixer_t *mixer);
 #endif
 
+/**
+ * Remember that the first \c blockcount blocks of a buffer have been written to.
+ */
 static FLUID_INLINE void
-fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+fluid_mixer_buffers_set_dirty(fluid_mixer_buffers_t *buffers, int index, int blockcount)
+{
+    if(buffers->dirty[index] < blockcount)
+    {
+        if(buffers->dirty[index] == 0)
+        {
+            buffers->touched[buffers->touched_count++] = index;
+        }
+
+        buffers->dirty[index] = blockcount;
+    }
+}
+
+/**
+ * Forget about a buffer written to without zeroing it, e.g. because it belongs to the caller.
+ */
+static void
+fluid_mixer_buffers_forget_dirty(fluid_mixer_buffers_t *buffers, int index)
+{
+    int i;
+
+    buffers->dirty[index] = 0;
+
+    for(i = 0; i < buffers->touched_count; i++)
+    {
+        if(buffers->touched[i] == index)
+        {
+            buffers->touched[i] = buffers->touched[--buffers->touched_count];
+            break;
+        }
+    }
+}
+
+/**
+ * Zero a buffer written to and forget about it, as if it hadn't been.
+ */
+static void
+fluid_mixer_buffers_clear_dirty(fluid_mixer_buffers_t *buffers, fluid_real_t *buf, int index)
+{
+    FLUID_MEMSET(buf, 0, buffers->dirty[index] * FLUID_BUFSIZE * sizeof(fluid_real_t));
+    fluid_mixer_buffers_forget_dirty(buffers, index);
+}
+
+/**
+ * Get the left or right buffer of the first stereo channel, which the effects are mixed
+ * to: the one of the caller if the mixer renders to it, the own one otherwise.
+ */
+static FLUID_INLINE fluid_real_t *
+fluid_mixer_buffers_get_main_buf(fluid_mixer_buffers_t *buffers, int right)
+{
+    if(buffers->out_left != NULL)
+    {
+        return right ? buffers->out_right : buffers->out_left;
+    }
+
+    return fluid_align_ptr(right ? buffers->right_buf : buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+}
+
+/**
+ * @return the count of the fx units actually processed: the first one only if
+ * all fx groups share it, all of them otherwise
+ */
+static FLUID_INLINE int
+fluid_rvoice_mixer_count_fx_busses(fluid_rvoice_mixer_t *mixer)
+{
+    return mixer->fx_shared ? 1 : mixer->fx_units;
+}
+
+/**
+ * Scale the reverb or the chorus input of an fx unit by the send gain of its group.
+ * If all fx groups share the unit, the inputs of the other groups are mixed in by
+ * their send gains and cleared, so that their effects channels stay silent. The input
+ * of a group whose send gain is 0 is dropped, so that it doesn't keep the unit busy.
+ * Called by the rendering thread before the fx units are processed.
+ */
+static void
+fluid_rvoice_mixer_send_fx_input(fluid_rvoice_mixer_t *mixer, int unit, int chorus)
 {
     const int fx_channels_per_unit = mixer->buffers.fx_buf_count / mixer->fx_units;
-    int i, f;
+    const int count = mixer->fx_shared ? mixer->fx_units : unit + 1;
+    const int buf_idx = unit * fx_channels_per_unit + (chorus ? SYNTH_CHORUS_CHANNEL : SYNTH_REVERB_CHANNEL);
+    fluid_real_t *in = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *FLUID_RESTRICT bus = &in[buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+    int *dirty = mixer->buffers.dirty;
+    int g, i;
+
+    for(g = unit; g < count; g++)
+    {
+        int src_idx = g * fx_channels_per_unit + (chorus ? SYNTH_CHORUS_CHANNEL : SYNTH_REVERB_CHANNEL);
+        int scount = dirty[DIRTY_FX_LEFT(&mixer->buffers, src_idx)] * FLUID_BUFSIZE;
+        fluid_real_t send = chorus ? mixer->fx[g].chorus_send : mixer->fx[g].reverb_send;
+        fluid_real_t *FLUID_RESTRICT src;
 
-    void (*reverb_process_func)(fluid_revmodel_t *rev, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
-    void (*chorus_process_func)(fluid_chorus_t *chorus, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+        if(scount == 0 || (g == unit && send == 1))
+        {
+            continue;
+        }
+
+        src = &in[src_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+
+        if(send == 0)
+        {
+            fluid_mixer_buffers_clear_dirty(&mixer->buffers, src, DIRTY_FX_LEFT(&mixer->buffers, src_idx));
+            continue;
+        }
+
+        if(g == unit)
+        {
+            #pragma omp simd aligned(bus:FLUID_DEFAULT_ALIGNMENT)
+
+            for(i = 0; i < scount; i++)
+            {
+                bus[i] *= send;
+            }
+
+            continue;
+        }
 
-    fluid_real_t *out_rev_l, *out_rev_r, *out_ch_l, *out_ch_r;
+        #pragma omp simd aligned(bus,src:FLUID_DEFAULT_ALIGNMENT)
+
+        for(i = 0; i < scount; i++)
+        {
+            bus[i] += send * src[i];
+        }
+
+        FLUID_MEMSET(src, 0, scount * sizeof(fluid_real_t));
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_FX_LEFT(&mixer->buffers, buf_idx), scount / FLUID_BUFSIZE);
+    }
+}
+
+/**
+ * Run the reverb or the chorus of one fx unit over the current block.
+ * @param unit index of the fx unit
+ * @param chorus TRUE to run the chorus, FALSE to run the reverb
+ * @param mix TRUE to mix the effect in with the first stereo channel, FALSE to
+ * replace the effect input by its output in the respective stereo effects channel
+ */
+static void
+fluid_rvoice_mixer_process_fx_unit(fluid_rvoice_mixer_t *mixer, int unit, int chorus,
+                                   int mix, int current_blockcount)
+{
+    const int fx_channels_per_unit = mixer->buffers.fx_buf_count / mixer->fx_units;
+    int buf_idx = unit * fx_channels_per_unit + (chorus ? SYNTH_CHORUS_CHANNEL : SYNTH_REVERB_CHANNEL);
+    int *idle = chorus ? &mixer->fx[unit].chorus_idle : &mixer->fx[unit].reverb_idle;
+    int *dirty = mixer->buffers.dirty;
+    int has_input = (dirty[DIRTY_FX_LEFT(&mixer->buffers, buf_idx)] > 0);
+    int mix_tail = FALSE;
+    int i;
 
     // all dry unprocessed mono input is stored in the left channel
-    fluid_real_t *in_rev = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    fluid_real_t *in_ch = in_rev;
+    fluid_real_t *in = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *out_l, *out_r;
 
-    fluid_profile_ref_var(prof_ref);
+    void (*reverb_process_func)(fluid_revmodel_t *rev, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+    void (*chorus_process_func)(fluid_chorus_t *chorus, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+    void (*conv_process_func)(fluid_convolver_t *conv, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+    fluid_convolver_t *conv = chorus ? NULL : mixer->fx[unit].conv;
 
+    if(chorus ? (mixer->fx[unit].chorus == NULL) : (mixer->fx[unit].reverb == NULL && conv == NULL))
+    {
+        // the units haven't been created yet, or have been released while the effect was off
+        return;
+    }
 
-    if(mixer->mix_fx_to_out)
+    if(has_input)
+    {
+        *idle = FALSE;
+    }
+    else if(*idle)
+    {
+        // silent input and silent unit, the output is silent as well
+        return;
+    }
+    else
+    {
+        // only the tail is left, process it in place to find out when it has decayed
+        mix_tail = mix;
+        mix = FALSE;
+    }
+
+    if(mix)
     {
         // mix effects to first stereo channel
-        out_ch_l = out_rev_l = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-        out_ch_r = out_rev_r = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_l = fluid_mixer_buffers_get_main_buf(&mixer->buffers, FALSE);
+        out_r = fluid_mixer_buffers_get_main_buf(&mixer->buffers, TRUE);
 
         reverb_process_func = fluid_revmodel_processmix;
         chorus_process_func = fluid_chorus_processmix;
+        conv_process_func = fluid_convolver_processmix;
 
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_LEFT(&mixer->buffers, 0), current_blockcount);
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_RIGHT(&mixer->buffers, 0), current_blockcount);
     }
     else
     {
         // replace effects into respective stereo effects channel
-        out_ch_l = out_rev_l = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-        out_ch_r = out_rev_r = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_l = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_r = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
 
         reverb_process_func = fluid_revmodel_processreplace;
         chorus_process_func = fluid_chorus_processreplace;
+        conv_process_func = fluid_convolver_processreplace;
+
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_FX_LEFT(&mixer->buffers, buf_idx), current_blockcount);
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_FX_RIGHT(&mixer->buffers, buf_idx), current_blockcount);
     }
 
+    for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i += FLUID_BUFSIZE)
+    {
+        int samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + i;
+        int out_idx = mix ? i : samp_idx;
+
+        if(chorus)
+        {
+            chorus_process_func(mixer->fx[unit].chorus, &in[samp_idx], &out_l[out_idx], &out_r[out_idx]);
+        }
+        else if(conv != NULL)
+        {
+            conv_process_func(conv, &in[samp_idx], &out_l[out_idx], &out_r[out_idx]);
+        }
+        else
+        {
+            reverb_process_func(mixer->fx[unit].reverb, &in[samp_idx], &out_l[out_idx], &out_r[out_idx]);
+        }
+    }
 
-    if(mixer->with_reverb)
+    if(!has_input)
     {
-        for(f = 0; f < mixer->fx_units; f++)
+        fluid_real_t peak = 0;
+        fluid_real_t *FLUID_RESTRICT tail_l = &out_l[buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+        fluid_real_t *FLUID_RESTRICT tail_r = &out_r[buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+
+        for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i++)
         {
-            int buf_idx = f * fx_channels_per_unit + SYNTH_REVERB_CHANNEL;
-            
-            for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i += FLUID_BUFSIZE)
+            fluid_real_t a = FLUID_FABS(tail_l[i]) + FLUID_FABS(tail_r[i]);
+            peak = (a > peak) ? a : peak;
+        }
+
+        if(mix_tail)
+        {
+            fluid_real_t *FLUID_RESTRICT main_l = fluid_mixer_buffers_get_main_buf(&mixer->buffers, FALSE);
+            fluid_real_t *FLUID_RESTRICT main_r = fluid_mixer_buffers_get_main_buf(&mixer->buffers, TRUE);
+
+            #pragma omp simd aligned(main_l,main_r,tail_l,tail_r:FLUID_DEFAULT_ALIGNMENT)
+
+            for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i++)
+            {
+                main_l[i] += tail_l[i];
+                main_r[i] += tail_r[i];
+            }
+
+            fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_LEFT(&mixer->buffers, 0), current_blockcount);
+            fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_RIGHT(&mixer->buffers, 0), current_blockcount);
+        }
+
+        if(conv != NULL)
+        {
+            // the convolution is clean once the input has been silent for as long as its impulse response
+            *idle = fluid_convolver_is_decayed(conv);
+        }
+        else if(peak < FLUID_NOISE_FLOOR)
+        {
+            // the tail has decayed, start from a clean state when input shows up again
+            if(chorus)
+            {
+                fluid_chorus_reset(mixer->fx[unit].chorus);
+            }
+            else
             {
-                int samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + i;
-                
-                reverb_process_func(mixer->fx[f].reverb,
-                                    &in_rev[samp_idx],
-                                    mixer->mix_fx_to_out ? &out_rev_l[i] : &out_rev_l[samp_idx],
-                                    mixer->mix_fx_to_out ? &out_rev_r[i] : &out_rev_r[samp_idx]);
+                fluid_revmodel_reset(mixer->fx[unit].reverb);
             }
+
+            *idle = TRUE;
         }
+    }
+}
+
+#if ENABLE_MIXER_THREADS
+/**
+ * Run one fx job of the current block: the reverb of an fx unit if \p job is below
+ * the count of the reverb jobs, the chorus of one otherwise.
+ * @param mix TRUE to mix the effect in with the first stereo channel, FALSE to
+ * process it in place into its stereo effects channel
+ */
+static FLUID_INLINE void
+fluid_rvoice_mixer_process_fx_job(fluid_rvoice_mixer_t *mixer, int job, int mix)
+{
+    int reverb_jobs = mixer->with_reverb ? fluid_rvoice_mixer_count_fx_busses(mixer) : 0;
 
-        fluid_profile(FLUID_PROF_ONE_BLOCK_REVERB, prof_ref, 0,
-                      current_blockcount * FLUID_BUFSIZE);
+    if(job < reverb_jobs)
+    {
+        fluid_rvoice_mixer_process_fx_unit(mixer, job, FALSE, mix, mixer->current_blockcount);
+    }
+    else
+    {
+        fluid_rvoice_mixer_process_fx_unit(mixer, job - reverb_jobs, TRUE, mix, mixer->current_blockcount);
     }
+}
+
+/**
+ * Run the fx jobs of the current block until there are none left. Jobs are
+ * the reverbs of all fx units followed by their choruses, each of them
+ * processed in place into its stereo effects channel, or the LADSPA effects
+ * of one stage.
+ */
+static void
+fluid_rvoice_mixer_process_fx_jobs(fluid_rvoice_mixer_t *mixer)
+{
+    int job;
 
-    if(mixer->with_chorus)
+    while((job = fluid_atomic_int_exchange_and_add(&mixer->current_fx, 1)) < mixer->fx_jobs)
     {
-        for(f = 0; f < mixer->fx_units; f++)
+#ifdef LADSPA
+
+        if(mixer->ladspa_jobs)
         {
-            int buf_idx = f * fx_channels_per_unit + SYNTH_CHORUS_CHANNEL;
-            
-            for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i += FLUID_BUFSIZE)
+            fluid_ladspa_run_effect(mixer->ladspa_fx, mixer->ladspa_stage, job);
+            continue;
+        }
+
+#endif
+
+        fluid_rvoice_mixer_process_fx_job(mixer, job, FALSE);
+    }
+}
+
+static void fluid_render_fx_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount);
+#ifdef LADSPA
+static void fluid_render_ladspa_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount);
+#endif
+#endif
+
+static FLUID_INLINE void
+fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+{
+    int f, busses = fluid_rvoice_mixer_count_fx_busses(mixer);
+
+    fluid_profile_ref_var(prof_ref);
+
+    for(f = 0; f < busses; f++)
+    {
+        if(mixer->with_reverb)
+        {
+            fluid_rvoice_mixer_send_fx_input(mixer, f, FALSE);
+        }
+
+        if(mixer->with_chorus)
+        {
+            fluid_rvoice_mixer_send_fx_input(mixer, f, TRUE);
+        }
+    }
+
+#if ENABLE_MIXER_THREADS
+    mixer->fx_jobs = busses * ((mixer->with_reverb != 0) + (mixer->with_chorus != 0));
+
+    /* Independent fx units are processed by the extra mixer threads, unless
+     * LADSPA reads the effect inputs after the effects have been mixed to the output. */
+    if(mixer->thread_count > 0 && mixer->fx_jobs > 1
+#ifdef LADSPA
+            && !(mixer->ladspa_fx != NULL && mixer->mix_fx_to_out)
+#endif
+      )
+    {
+        fluid_render_fx_multithread(mixer, current_blockcount);
+    }
+    else
+#endif
+    {
+        if(mixer->with_reverb)
+        {
+            for(f = 0; f < busses; f++)
             {
-                int samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + i;
-                
-                chorus_process_func(mixer->fx[f].chorus,
-                                    &in_ch [samp_idx],
-                                    mixer->mix_fx_to_out ? &out_ch_l[i] : &out_ch_l[samp_idx],
-                                    mixer->mix_fx_to_out ? &out_ch_r[i] : &out_ch_r[samp_idx]);
+                fluid_rvoice_mixer_process_fx_unit(mixer, f, FALSE, mixer->mix_fx_to_out, current_blockcount);
             }
+
+            fluid_profile(FLUID_PROF_ONE_BLOCK_REVERB, prof_ref, 0,
+                          current_blockcount * FLUID_BUFSIZE);
         }
 
-        fluid_profile(FLUID_PROF_ONE_BLOCK_CHORUS, prof_ref, 0,
-                      current_blockcount * FLUID_BUFSIZE);
+        if(mixer->with_chorus)
+        {
+            for(f = 0; f < busses; f++)
+            {
+                fluid_rvoice_mixer_process_fx_unit(mixer, f, TRUE, mixer->mix_fx_to_out, current_blockcount);
+            }
+
+            fluid_profile(FLUID_PROF_ONE_BLOCK_CHORUS, prof_ref, 0,
+                          current_blockcount * FLUID_BUFSIZE);
+        }
     }
 
 #ifdef LADSPA
@@ -207,8 +696,29 @@ fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcoun
      * set up in fluid_rvoice_mixer_set_ladspa. */
     if(mixer->ladspa_fx)
     {
-        fluid_ladspa_run(mixer->ladspa_fx, current_blockcount, FLUID_BUFSIZE);
+        int count = 2 * (mixer->buffers.buf_count + mixer->buffers.fx_buf_count);
+        fluid_trace_ref_var(trace_ref);
+
+#if ENABLE_MIXER_THREADS
+
+        if(mixer->thread_count > 0)
+        {
+            fluid_render_ladspa_multithread(mixer, current_blockcount);
+        }
+        else
+#endif
+        {
+            fluid_ladspa_run(mixer->ladspa_fx, current_blockcount, FLUID_BUFSIZE);
+        }
+
+        fluid_trace("ladspa", trace_ref);
         fluid_check_fpe("LADSPA");
+
+        // the plugins may write to any of the host buffers
+        for(f = 0; f < count; f++)
+        {
+            fluid_mixer_buffers_set_dirty(&mixer->buffers, f, current_blockcount);
+        }
     }
 
 #endif
@@ -281,6 +791,12 @@ fluid_mixer_buffers_prepare(fluid_mixer_buffers_t *buffers, fluid_real_t **outbu
         outbufs[i * 2 + 1] = &base_ptr[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
     }
 
+    if(buffers->out_left != NULL)
+    {
+        outbufs[0] = buffers->out_left;
+        outbufs[1] = buffers->out_right;
+    }
+
     return offset + buffers->fx_buf_count;
 }
 
@@ -324,6 +840,12 @@ fluid_mixer_buffer_process_finished_voices(fluid_mixer_buffers_t *buffers)
 
         buffers->mixer->active_voices = av;
 
+        if(buffers->mixer->note_cache != NULL)
+        {
+            fluid_note_cache_release(buffers->mixer->note_cache, v);
+        }
+
+        fluid_rvoice_unlink_stereo(v);
         fluid_rvoice_eventhandler_finished_voice_callback(buffers->mixer->eventhandler, v);
     }
 
@@ -360,38 +882,30 @@ get_dest_buf(fluid_rvoice_buffers_t *buffers, int index,
 }
 
 /**
- * Mix samples down from internal dsp_buf to output buffers
+ * Collect the destinations of a voice, each of them only once: two records
+ * mixing to the same buffer are mixed with their summed amplitude, so that
+ * fluid_rvoice_buffers_accumulate() never sees aliased destinations.
  *
  * @param buffers Destination buffer(s)
- * @param dsp_buf Mono sample source
- * @param start_block starting sample in dsp_buf
- * @param sample_count number of samples to mix following \c start_block
  * @param dest_bufs Array of buffers to mixdown to
  * @param dest_bufcount Length of dest_bufs (i.e count of buffers)
+ * @param dest Location to store the destinations (#FLUID_RVOICE_MAX_BUFS in length)
+ * @param amps Location to store the amplitude of each destination
+ * @param mappings Location to store the index of each destination in dest_bufs
+ * @return Count of destinations
  */
-static void
-fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
-                         const fluid_real_t *FLUID_RESTRICT dsp_buf,
-                         int start_block, int sample_count,
-                         fluid_real_t **dest_bufs, int dest_bufcount)
+static FLUID_INLINE int
+fluid_rvoice_buffers_get_dests(fluid_rvoice_buffers_t *buffers,
+                               fluid_real_t **dest_bufs, int dest_bufcount,
+                               fluid_real_t **dest, fluid_real_t *amps, int *mappings)
 {
     /* buffers count to mixdown to */
     int bufcount = buffers->count;
-    int i, dsp_i;
-
-    /* if there is nothing to mix, return immediately */
-    if(sample_count <= 0 || dest_bufcount <= 0)
-    {
-        return;
-    }
-
-    FLUID_ASSERT((uintptr_t)dsp_buf % FLUID_DEFAULT_ALIGNMENT == 0);
-    FLUID_ASSERT((uintptr_t)(&dsp_buf[start_block * FLUID_BUFSIZE]) % FLUID_DEFAULT_ALIGNMENT == 0);
+    int i, j, k, count = 0;
 
-    /* mixdown for each buffer */
     for(i = 0; i < bufcount; i++)
     {
-        fluid_real_t *FLUID_RESTRICT buf = get_dest_buf(buffers, i, dest_bufs, dest_bufcount);
+        fluid_real_t *buf = get_dest_buf(buffers, i, dest_bufs, dest_bufcount);
         fluid_real_t amp = buffers->bufs[i].amp;
 
         if(buf == NULL || amp == 0.0f)
@@ -401,957 +915,4191 @@ fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
 
         FLUID_ASSERT((uintptr_t)buf % FLUID_DEFAULT_ALIGNMENT == 0);
 
-        /* mixdown sample_count samples in the current buffer buf
-           Note, that this loop could be unrolled by FLUID_BUFSIZE elements */
-        #pragma omp simd aligned(dsp_buf,buf:FLUID_DEFAULT_ALIGNMENT)
-        for(dsp_i = 0; dsp_i < sample_count; dsp_i++)
+        j = buffers->bufs[i].mapping;
+
+        for(k = 0; k < count && mappings[k] != j; k++)
         {
-            // Index by blocks (not by samples) to let the compiler know that we always start accessing
-            // buf and dsp_buf at the FLUID_BUFSIZE*sizeof(fluid_real_t) byte boundary and never somewhere
-            // in between.
-            // A good compiler should understand: Aha, so I don't need to add a peel loop when vectorizing
-            // this loop. Great.
-            buf[start_block * FLUID_BUFSIZE + dsp_i] += amp * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
         }
+
+        if(k < count)
+        {
+            amps[k] += amp;
+            continue;
+        }
+
+        dest[count] = buf;
+        amps[count] = amp;
+        mappings[count] = j;
+        count++;
     }
+
+    return count;
 }
 
+/* On x86, the DSP kernels are compiled once more for the wider vectors of AVX2
+ * and AVX-512, and the variant selected for the CPU at runtime, see
+ * fluid_rvoice_mixer_dispatch_config(). Their code must be inlined into the variants. */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FLUID_MIXER_X86_VARIANTS 1
+#define FLUID_MIXER_KERNEL_INLINE FLUID_INLINE __attribute__((always_inline))
+#else
+#define FLUID_MIXER_KERNEL_INLINE FLUID_INLINE
+#endif
+
 /**
- * Synthesize one voice and add to buffer.
- * NOTE: If return value is less than blockcount*FLUID_BUFSIZE, that means
- * voice has been finished, removed and possibly replaced with another voice.
+ * Add samples to the destinations collected by fluid_rvoice_buffers_get_dests()
+ *
+ * @param dest Destinations
+ * @param amps Amplitude of each destination
+ * @param count Count of destinations
+ * @param dsp_buf Mono sample source
+ * @param offset Position in the destinations to add the first sample to
+ * @param sample_count Count of samples in dsp_buf
  */
-static FLUID_INLINE void
-fluid_mixer_buffers_render_one(fluid_mixer_buffers_t *buffers,
-                               fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
-                               unsigned int dest_bufcount, fluid_real_t *src_buf, int blockcount)
+static FLUID_MIXER_KERNEL_INLINE void
+fluid_rvoice_buffers_accumulate(fluid_real_t *const *dest, const fluid_real_t *amps, int count,
+                                const fluid_real_t *FLUID_RESTRICT dsp_buf, int offset, int sample_count)
 {
-    int i, total_samples = 0, last_block_mixed = 0;
+    int i, k, dsp_i;
 
-    for(i = 0; i < blockcount; i++)
+    FLUID_ASSERT((uintptr_t)dsp_buf % FLUID_DEFAULT_ALIGNMENT == 0);
+
+    /* Mixdown to as many buffers as possible in one pass, so that dsp_buf is only read once.
+     * All the loops start at a FLUID_DEFAULT_ALIGNMENT byte boundary, the
+     * compiler doesn't need to add a peel loop when vectorizing them. */
+    for(i = 0; i < count; i += k)
     {
-        /* render one block in src_buf */
-        int s = fluid_rvoice_write(rvoice, &src_buf[FLUID_BUFSIZE * i]);
-        if(s == -1)
-        {
-            /* the voice is silent, mix back all the previously rendered sound */
-            fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
-                                     total_samples - (last_block_mixed*FLUID_BUFSIZE),
-                                     dest_bufs, dest_bufcount);
+        k = count - i;
 
-            last_block_mixed = i+1; /* future block start index to mix from */
-            total_samples += FLUID_BUFSIZE; /* accumulate samples count rendered */
-        }
-        else
+        if(k >= 4)
         {
-            /* the voice wasn't quiet. Some samples have been rendered [0..FLUID_BUFSIZE] */
-            total_samples += s;
-            if(s < FLUID_BUFSIZE)
+            fluid_real_t *FLUID_RESTRICT buf0 = &dest[i][offset];
+            fluid_real_t *FLUID_RESTRICT buf1 = &dest[i + 1][offset];
+            fluid_real_t *FLUID_RESTRICT buf2 = &dest[i + 2][offset];
+            fluid_real_t *FLUID_RESTRICT buf3 = &dest[i + 3][offset];
+            fluid_real_t amp0 = amps[i], amp1 = amps[i + 1], amp2 = amps[i + 2], amp3 = amps[i + 3];
+
+            k = 4;
+
+            #pragma omp simd aligned(dsp_buf,buf0,buf1,buf2,buf3:FLUID_DEFAULT_ALIGNMENT)
+            for(dsp_i = 0; dsp_i < sample_count; dsp_i++)
             {
-                /* voice has finished */
-                break;
+                fluid_real_t sample = dsp_buf[dsp_i];
+
+                buf0[dsp_i] += amp0 * sample;
+                buf1[dsp_i] += amp1 * sample;
+                buf2[dsp_i] += amp2 * sample;
+                buf3[dsp_i] += amp3 * sample;
             }
         }
-    }
-
-    /* Now mix the remaining blocks from last_block_mixed to total_sample */
-    fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
-                             total_samples - (last_block_mixed*FLUID_BUFSIZE),
-                             dest_bufs, dest_bufcount);
-
-    if(total_samples < blockcount * FLUID_BUFSIZE)
-    {
-        /* voice has finished */
-        fluid_finish_rvoice(buffers, rvoice);
-    }
-}
+        else if(k >= 2)
+        {
+            fluid_real_t *FLUID_RESTRICT buf0 = &dest[i][offset];
+            fluid_real_t *FLUID_RESTRICT buf1 = &dest[i + 1][offset];
+            fluid_real_t amp0 = amps[i], amp1 = amps[i + 1];
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voice)
-{
-    int i;
-    fluid_rvoice_mixer_t *mixer = obj;
-    fluid_rvoice_t *voice = param[0].ptr;
+            k = 2;
 
-    if(mixer->active_voices < mixer->polyphony)
-    {
-        mixer->rvoices[mixer->active_voices++] = voice;
-        return; // success
-    }
+            #pragma omp simd aligned(dsp_buf,buf0,buf1:FLUID_DEFAULT_ALIGNMENT)
+            for(dsp_i = 0; dsp_i < sample_count; dsp_i++)
+            {
+                fluid_real_t sample = dsp_buf[dsp_i];
 
-    /* See if any voices just finished, if so, take its place.
-       This can happen in voice overflow conditions. */
-    for(i = 0; i < mixer->active_voices; i++)
-    {
-        if(mixer->rvoices[i] == voice)
-        {
-            FLUID_LOG(FLUID_ERR, "Internal error: Trying to replace an existing rvoice in fluid_rvoice_mixer_add_voice?!");
-            return;
+                buf0[dsp_i] += amp0 * sample;
+                buf1[dsp_i] += amp1 * sample;
+            }
         }
-
-        if(mixer->rvoices[i]->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+        else
         {
-            fluid_finish_rvoice(&mixer->buffers, mixer->rvoices[i]);
-            mixer->rvoices[i] = voice;
-            return; // success
+            fluid_real_t *FLUID_RESTRICT buf0 = &dest[i][offset];
+            fluid_real_t amp0 = amps[i];
+
+            #pragma omp simd aligned(dsp_buf,buf0:FLUID_DEFAULT_ALIGNMENT)
+            for(dsp_i = 0; dsp_i < sample_count; dsp_i++)
+            {
+                buf0[dsp_i] += amp0 * dsp_buf[dsp_i];
+            }
         }
     }
-
-    /* This should never happen */
-    FLUID_LOG(FLUID_ERR, "Trying to exceed polyphony in fluid_rvoice_mixer_add_voice");
-    return;
 }
 
-static int
-fluid_mixer_buffers_update_polyphony(fluid_mixer_buffers_t *buffers, int value)
-{
-    void *newptr;
-
-    if(buffers->finished_voice_count > value)
-    {
-        return FLUID_FAILED;
-    }
+typedef void (*fluid_rvoice_accumulate_func_t)(fluid_real_t *const *dest, const fluid_real_t *amps, int count,
+        const fluid_real_t *FLUID_RESTRICT dsp_buf, int offset, int sample_count);
 
-    newptr = FLUID_REALLOC(buffers->finished_voices, value * sizeof(fluid_rvoice_t *));
+static void
+fluid_rvoice_buffers_accumulate_generic(fluid_real_t *const *dest, const fluid_real_t *amps, int count,
+                                        const fluid_real_t *FLUID_RESTRICT dsp_buf, int offset, int sample_count)
+{
+    fluid_rvoice_buffers_accumulate(dest, amps, count, dsp_buf, offset, sample_count);
+}
 
-    if(newptr == NULL && value > 0)
-    {
-        return FLUID_FAILED;
-    }
+#if FLUID_MIXER_X86_VARIANTS
+__attribute__((target("avx2,fma"))) static void
+fluid_rvoice_buffers_accumulate_avx2(fluid_real_t *const *dest, const fluid_real_t *amps, int count,
+                                     const fluid_real_t *FLUID_RESTRICT dsp_buf, int offset, int sample_count)
+{
+    fluid_rvoice_buffers_accumulate(dest, amps, count, dsp_buf, offset, sample_count);
+}
 
-    buffers->finished_voices = newptr;
-    return FLUID_OK;
+__attribute__((target("avx512f"))) static void
+fluid_rvoice_buffers_accumulate_avx512f(fluid_real_t *const *dest, const fluid_real_t *amps, int count,
+                                        const fluid_real_t *FLUID_RESTRICT dsp_buf, int offset, int sample_count)
+{
+    fluid_rvoice_buffers_accumulate(dest, amps, count, dsp_buf, offset, sample_count);
 }
+#endif
+
+/* The variant of fluid_rvoice_buffers_accumulate() selected for the CPU */
+static fluid_rvoice_accumulate_func_t fluid_rvoice_buffers_accumulate_kernel = fluid_rvoice_buffers_accumulate_generic;
 
 /**
- * Update polyphony - max number of voices (NOTE: not hard real-time capable)
- * @return FLUID_OK or FLUID_FAILED
+ * Select the variants of the mixer kernels for the features of the CPU.
+ * Called once by fluid_synth_init(), after fluid_cpu_dispatch_init().
  */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony)
+void
+fluid_rvoice_mixer_dispatch_config(void)
 {
-    void *newptr;
-    fluid_rvoice_mixer_t *handler = obj;
-    int value = param[0].i;
+    const char *variant = FLUID_CPU_BASELINE;
+#if FLUID_MIXER_X86_VARIANTS
+    unsigned int features = fluid_cpu_features();
+#endif
 
-    if(handler->active_voices > value)
-    {
-        return /*FLUID_FAILED*/;
-    }
+    fluid_rvoice_buffers_accumulate_kernel = fluid_rvoice_buffers_accumulate_generic;
 
-    newptr = FLUID_REALLOC(handler->rvoices, value * sizeof(fluid_rvoice_t *));
+#if FLUID_MIXER_X86_VARIANTS
 
-    if(newptr == NULL)
+    if(features & FLUID_CPU_AVX512F)
     {
-        return /*FLUID_FAILED*/;
+        fluid_rvoice_buffers_accumulate_kernel = fluid_rvoice_buffers_accumulate_avx512f;
+        variant = "avx512f";
     }
-
-    handler->rvoices = newptr;
-
-    if(fluid_mixer_buffers_update_polyphony(&handler->buffers, value)
-            == FLUID_FAILED)
+    else if(features & FLUID_CPU_AVX2)
     {
-        return /*FLUID_FAILED*/;
+        fluid_rvoice_buffers_accumulate_kernel = fluid_rvoice_buffers_accumulate_avx2;
+        variant = "avx2";
     }
 
-#if ENABLE_MIXER_THREADS
-    {
-        int i;
-
-        for(i = 0; i < handler->thread_count; i++)
-        {
-            if(fluid_mixer_buffers_update_polyphony(&handler->threads[i], value)
-                    == FLUID_FAILED)
-            {
-                return /*FLUID_FAILED*/;
-            }
-        }
-    }
 #endif
 
-    handler->polyphony = value;
-    return /*FLUID_OK*/;
+    fluid_cpu_dispatch_register("mix", variant);
 }
 
-
+/**
+ * Mix samples down from internal dsp_buf to output buffers
+ *
+ * @param buffers Destination buffer(s)
+ * @param dsp_buf Mono sample source
+ * @param start_block starting sample in dsp_buf
+ * @param sample_count number of samples to mix following \c start_block
+ * @param dest_bufs Array of buffers to mixdown to
+ * @param dest_bufcount Length of dest_bufs (i.e count of buffers)
+ * @param dest_buffers Mixer buffers dest_bufs belong to, to remember which ones have been written to
+ */
 static void
-fluid_render_loop_singlethread(fluid_rvoice_mixer_t *mixer, int blockcount)
+fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
+                         const fluid_real_t *FLUID_RESTRICT dsp_buf,
+                         int start_block, int sample_count,
+                         fluid_real_t **dest_bufs, int dest_bufcount, fluid_mixer_buffers_t *dest_buffers)
 {
-    int i;
-    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
-                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
-    int bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
-
-    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+    int end_block = start_block + (sample_count + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+    int i, count;
 
-    fluid_profile_ref_var(prof_ref);
+    /* the destinations actually written to, each of them only once */
+    fluid_real_t *dest[FLUID_RVOICE_MAX_BUFS];
+    fluid_real_t amps[FLUID_RVOICE_MAX_BUFS];
+    int mappings[FLUID_RVOICE_MAX_BUFS];
 
-    for(i = 0; i < mixer->active_voices; i++)
+    /* if there is nothing to mix, return immediately */
+    if(sample_count <= 0 || dest_bufcount <= 0)
     {
-        fluid_mixer_buffers_render_one(&mixer->buffers, mixer->rvoices[i], bufs,
-                                       bufcount, local_buf, blockcount);
-        fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
-                      blockcount * FLUID_BUFSIZE);
+        return;
     }
-}
-
-static FLUID_INLINE void
-fluid_mixer_buffers_zero(fluid_mixer_buffers_t *buffers, int current_blockcount)
-{
-    int i, size = current_blockcount * FLUID_BUFSIZE * sizeof(fluid_real_t);
 
-    /* TODO: Optimize by only zero out the buffers we actually use later on. */
-    int buf_count = buffers->buf_count, fx_buf_count = buffers->fx_buf_count;
+    FLUID_ASSERT((uintptr_t)dsp_buf % FLUID_DEFAULT_ALIGNMENT == 0);
 
-    fluid_real_t *FLUID_RESTRICT buf_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
-    fluid_real_t *FLUID_RESTRICT buf_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    count = fluid_rvoice_buffers_get_dests(buffers, dest_bufs, dest_bufcount, dest, amps, mappings);
 
-    for(i = 0; i < buf_count; i++)
+    for(i = 0; i < count; i++)
     {
-        FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-        FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        fluid_mixer_buffers_set_dirty(dest_buffers, mappings[i], end_block);
     }
 
-    buf_l = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    buf_r = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < fx_buf_count; i++)
-    {
-        FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-        FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-    }
+    fluid_rvoice_buffers_accumulate_kernel(dest, amps, count, &dsp_buf[start_block * FLUID_BUFSIZE],
+                                           start_block * FLUID_BUFSIZE, sample_count);
 }
 
-static int
-fluid_mixer_buffers_init(fluid_mixer_buffers_t *buffers, fluid_rvoice_mixer_t *mixer)
-{
-    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
-
-    buffers->mixer = mixer;
-    buffers->buf_count = mixer->buffers.buf_count;
-    buffers->fx_buf_count = mixer->buffers.fx_buf_count;
-
-    /* Local mono voice buf */
-    buffers->local_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, samplecount, FLUID_DEFAULT_ALIGNMENT);
+/* Number of samples filtered and added to the destinations at once by
+ * fluid_mixer_buffers_render_fused(), a multiple of FLUID_DEFAULT_ALIGNMENT bytes */
+#define FLUID_MIXER_FUSED_FRAMES 16
 
-    /* Left and right audio buffers */
+/**
+ * Synthesize one voice like fluid_mixer_buffers_render_one(), but add it to the
+ * buffers block by block: each part of #FLUID_MIXER_FUSED_FRAMES samples goes
+ * through both filters and is added to all the destinations while it is still
+ * in a cache line of its own, instead of filtering the whole block in place and
+ * reading all the rendered blocks back from src_buf for mixing.
+ */
+static void
+fluid_mixer_buffers_render_fused(fluid_mixer_buffers_t *buffers,
+                                 fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
+                                 unsigned int dest_bufcount, fluid_real_t *src_buf, int start_block, int blockcount)
+{
+    /* the destinations actually written to, each of them only once */
+    fluid_real_t *dest[FLUID_RVOICE_MAX_BUFS];
+    fluid_real_t amps[FLUID_RVOICE_MAX_BUFS];
+    int mappings[FLUID_RVOICE_MAX_BUFS];
+    int i, j, n, count, s = FLUID_BUFSIZE, end_block = start_block;
+    fluid_profile_ref_var(prof_ref);
 
-    buffers->left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
-    buffers->right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    count = fluid_rvoice_buffers_get_dests(&rvoice->buffers, dest_bufs, dest_bufcount, dest, amps, mappings);
 
-    if((buffers->local_buf == NULL) || (buffers->left_buf == NULL) || (buffers->right_buf == NULL))
+    for(i = start_block; i < blockcount; i++)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return 0;
-    }
-
-    /* Effects audio buffers */
-
-    buffers->fx_left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
-    buffers->fx_right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+        /* render one block in src_buf, up to the filters */
+        s = fluid_rvoice_write_unfiltered(rvoice, src_buf);
 
-    if((buffers->fx_left_buf == NULL) || (buffers->fx_right_buf == NULL))
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return 0;
-    }
+        if(s == -1)
+        {
+            /* the voice is silent, nothing to add */
+            continue;
+        }
 
-    buffers->finished_voices = NULL;
+        fluid_profile_ref_set(prof_ref);
 
-    if(fluid_mixer_buffers_update_polyphony(buffers, mixer->polyphony)
-            == FLUID_FAILED)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return 0;
-    }
+        for(j = 0; j < s; j += n)
+        {
+            n = (s - j < FLUID_MIXER_FUSED_FRAMES) ? s - j : FLUID_MIXER_FUSED_FRAMES;
 
-    return 1;
-}
+            fluid_iir_filter_apply_part(&rvoice->resonant_filter, &src_buf[j], n, j == 0);
+            fluid_iir_filter_apply_part(&rvoice->resonant_custom_filter, &src_buf[j], n, j == 0);
+            fluid_rvoice_buffers_accumulate_kernel(dest, amps, count, &src_buf[j], i * FLUID_BUFSIZE + j, n);
+        }
 
-/**
- * Note: Not hard real-time capable (calls malloc)
- */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    fluid_real_t samplerate = param[1].real; // because fluid_synth_update_mixer() puts real into arg2
+        fluid_check_fpe("voice_filter");
+        fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, &rvoice, NULL, 1, 0);
 
-    int i;
-    for(i = 0; i < mixer->fx_units; i++)
-    {
-        if(mixer->fx[i].chorus)
+        if(s > 0)
         {
-            delete_fluid_chorus(mixer->fx[i].chorus);
+            end_block = i + 1;
         }
 
-        mixer->fx[i].chorus = new_fluid_chorus(samplerate);
-
-        if(mixer->fx[i].reverb)
+        if(s < FLUID_BUFSIZE)
         {
-            fluid_revmodel_samplerate_change(mixer->fx[i].reverb, samplerate);
+            /* voice has finished */
+            break;
         }
     }
 
-#if LADSPA
-
-    if(mixer->ladspa_fx != NULL)
+    if(end_block > start_block)
     {
-        fluid_ladspa_set_sample_rate(mixer->ladspa_fx, samplerate);
+        for(j = 0; j < count; j++)
+        {
+            fluid_mixer_buffers_set_dirty(buffers, mappings[j], end_block);
+        }
     }
 
-#endif
+    if(s >= 0 && s < FLUID_BUFSIZE)
+    {
+        fluid_finish_rvoice(buffers, rvoice);
+    }
 }
 
-
 /**
- * @param buf_count number of primary stereo buffers
- * @param fx_buf_count number of stereo effect buffers
+ * Synthesize one voice and add to buffer, starting at block \c start_block
+ * (see fluid_rvoice_skip_delay()).
+ * NOTE: If return value is less than blockcount*FLUID_BUFSIZE, that means
+ * voice has been finished, removed and possibly replaced with another voice.
  */
-fluid_rvoice_mixer_t *
-new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, int fx_units, fluid_real_t sample_rate, fluid_rvoice_eventhandler_t *evthandler, int extra_threads, int prio)
+static FLUID_INLINE void
+fluid_mixer_buffers_render_one(fluid_mixer_buffers_t *buffers,
+                               fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
+                               unsigned int dest_bufcount, fluid_real_t *src_buf, int start_block, int blockcount)
 {
-    int i;
-    fluid_rvoice_mixer_t *mixer = FLUID_NEW(fluid_rvoice_mixer_t);
+    int i, total_samples = start_block * FLUID_BUFSIZE, last_block_mixed = start_block;
+    fluid_profile_ref_var(prof_ref);
 
-    if(mixer == NULL)
+    if(buffers->mixer->fused_voices && rvoice->note_cache_mode == FLUID_NOTE_CACHE_OFF)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return NULL;
+        fluid_mixer_buffers_render_fused(buffers, rvoice, dest_bufs, dest_bufcount, src_buf, start_block, blockcount);
+        return;
     }
 
-    FLUID_MEMSET(mixer, 0, sizeof(fluid_rvoice_mixer_t));
-    mixer->eventhandler = evthandler;
-    mixer->fx_units = fx_units;
-    mixer->buffers.buf_count = buf_count;
-    mixer->buffers.fx_buf_count = fx_buf_count * fx_units;
+    for(i = start_block; i < blockcount; i++)
+    {
+        /* render one block in src_buf */
+        int s = (rvoice->note_cache_mode != FLUID_NOTE_CACHE_OFF)
+                ? fluid_note_cache_write(rvoice, &src_buf[FLUID_BUFSIZE * i])
+                : fluid_rvoice_write(rvoice, &src_buf[FLUID_BUFSIZE * i]);
+        if(s == -1)
+        {
+            /* the voice is silent, mix back all the previously rendered sound */
+            fluid_profile_ref_set(prof_ref);
+            fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
+                                     total_samples - (last_block_mixed*FLUID_BUFSIZE),
+                                     dest_bufs, dest_bufcount, buffers);
+            fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, &rvoice, NULL, 1, 0);
 
-    /* allocate the reverb module */
-    mixer->fx = FLUID_ARRAY(fluid_mixer_fx_t, fx_units);
-    if(mixer->fx == NULL)
+            last_block_mixed = i+1; /* future block start index to mix from */
+            total_samples += FLUID_BUFSIZE; /* accumulate samples count rendered */
+        }
+        else
+        {
+            /* the voice wasn't quiet. Some samples have been rendered [0..FLUID_BUFSIZE] */
+            total_samples += s;
+            if(s < FLUID_BUFSIZE)
+            {
+                /* voice has finished */
+                break;
+            }
+        }
+    }
+
+    /* Now mix the remaining blocks from last_block_mixed to total_sample */
+    fluid_profile_ref_set(prof_ref);
+    fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
+                             total_samples - (last_block_mixed*FLUID_BUFSIZE),
+                             dest_bufs, dest_bufcount, buffers);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, &rvoice, NULL, 1, 0);
+
+    if(total_samples < blockcount * FLUID_BUFSIZE)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        goto error_recovery;
+        /* voice has finished */
+        fluid_finish_rvoice(buffers, rvoice);
     }
-    
-    FLUID_MEMSET(mixer->fx, 0, fx_units * sizeof(*mixer->fx));
-    
-    for(i = 0; i < fx_units; i++)
+}
+
+/**
+ * Synthesize a stereo pair of voices, see fluid_rvoice_write_stereo(), and add
+ * both of them to the buffers. Equivalent to calling
+ * fluid_mixer_buffers_render_one() for the leader and its follower.
+ */
+static void
+fluid_mixer_buffers_render_stereo(fluid_mixer_buffers_t *buffers, fluid_rvoice_t *rvoice,
+                                  fluid_real_t **dest_bufs, unsigned int dest_bufcount, int start_block, int blockcount)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+
+    fluid_real_t *src_buf = fluid_align_ptr(buffers->batch_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *follower_buf = &src_buf[samplecount];
+    fluid_rvoice_t *follower = rvoice->stereo_follower;
+    int i, total_samples = start_block * FLUID_BUFSIZE, last_block_mixed = start_block;
+    fluid_profile_ref_var(prof_ref);
+
+    for(i = start_block; i < blockcount; i++)
     {
-        mixer->fx[i].reverb = new_fluid_revmodel(sample_rate);
-        mixer->fx[i].chorus = new_fluid_chorus(sample_rate);
+        /* render one block of both voices */
+        int s = fluid_rvoice_write_stereo(rvoice, &src_buf[FLUID_BUFSIZE * i], &follower_buf[FLUID_BUFSIZE * i]);
+
+        if(s == -1)
+        {
+            /* the voices are silent, mix back all the previously rendered sound */
+            fluid_profile_ref_set(prof_ref);
+            fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
+                                     total_samples - (last_block_mixed*FLUID_BUFSIZE),
+                                     dest_bufs, dest_bufcount, buffers);
+            fluid_rvoice_buffers_mix(&follower->buffers, follower_buf, last_block_mixed,
+                                     total_samples - (last_block_mixed*FLUID_BUFSIZE),
+                                     dest_bufs, dest_bufcount, buffers);
+            fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, &rvoice, NULL, 1, 0);
 
-        if(mixer->fx[i].reverb == NULL || mixer->fx[i].chorus == NULL)
+            last_block_mixed = i+1; /* future block start index to mix from */
+            total_samples += FLUID_BUFSIZE; /* accumulate samples count rendered */
+        }
+        else
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            goto error_recovery;
+            /* the voices weren't quiet. Some samples have been rendered [0..FLUID_BUFSIZE] */
+            total_samples += s;
+            if(s < FLUID_BUFSIZE)
+            {
+                /* voice has finished */
+                break;
+            }
         }
     }
 
-    if(!fluid_mixer_buffers_init(&mixer->buffers, mixer))
+    /* Now mix the remaining blocks from last_block_mixed to total_sample */
+    fluid_profile_ref_set(prof_ref);
+    fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
+                             total_samples - (last_block_mixed*FLUID_BUFSIZE),
+                             dest_bufs, dest_bufcount, buffers);
+    fluid_rvoice_buffers_mix(&follower->buffers, follower_buf, last_block_mixed,
+                             total_samples - (last_block_mixed*FLUID_BUFSIZE),
+                             dest_bufs, dest_bufcount, buffers);
+    fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, &rvoice, NULL, 1, 0);
+
+    if(total_samples < blockcount * FLUID_BUFSIZE)
     {
-        goto error_recovery;
+        /* the voices have finished together, unless the sample sanity check
+         * has turned the leader off and the follower finishes on its own.
+         * The pair stays linked until the finished voices are processed, so
+         * that the follower is not rendered on its own meanwhile. */
+        if(rvoice->stereo_follower != NULL)
+        {
+            fluid_finish_rvoice(buffers, follower);
+        }
+
+        fluid_finish_rvoice(buffers, rvoice);
     }
+}
 
-#if ENABLE_MIXER_THREADS
-    mixer->thread_ready = new_fluid_cond();
-    mixer->wakeup_threads = new_fluid_cond();
-    mixer->thread_ready_m = new_fluid_cond_mutex();
-    mixer->wakeup_threads_m = new_fluid_cond_mutex();
+/**
+ * Synthesize several voices block by block and add them to the buffers.
+ * Equivalent to calling fluid_mixer_buffers_render_one() for each voice.
+ * \c same_sample tells whether they all play the same sample with the same
+ * interpolation method (see fluid_rvoice_write_batch()).
+ */
+static void
+fluid_mixer_buffers_render_batch(fluid_mixer_buffers_t *buffers,
+                                 fluid_rvoice_t **rvoices, int voice_count, int same_sample,
+                                 fluid_real_t **dest_bufs, unsigned int dest_bufcount, int blockcount)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
 
-    if(!mixer->thread_ready || !mixer->wakeup_threads ||
-            !mixer->thread_ready_m || !mixer->wakeup_threads_m)
+    fluid_real_t *batch_buf = fluid_align_ptr(buffers->batch_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_rvoice_t *active[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t *dsp_bufs[FLUID_RVOICE_BATCH_MAX];
+    int active_index[FLUID_RVOICE_BATCH_MAX];
+    int counts[FLUID_RVOICE_BATCH_MAX];
+    int total_samples[FLUID_RVOICE_BATCH_MAX];
+    int last_block_mixed[FLUID_RVOICE_BATCH_MAX];
+    int finished[FLUID_RVOICE_BATCH_MAX];
+    int i, v, n;
+    fluid_profile_ref_var(prof_ref);
+
+    for(v = 0; v < voice_count; v++)
     {
-        goto error_recovery;
+        total_samples[v] = last_block_mixed[v] = finished[v] = 0;
     }
 
-    if(fluid_rvoice_mixer_set_threads(mixer, extra_threads, prio) != FLUID_OK)
+    for(i = 0; i < blockcount; i++)
     {
-        goto error_recovery;
+        /* collect the voices, which haven't finished yet */
+        for(v = 0, n = 0; v < voice_count; v++)
+        {
+            if(!finished[v])
+            {
+                active[n] = rvoices[v];
+                dsp_bufs[n] = &batch_buf[v * samplecount + FLUID_BUFSIZE * i];
+                active_index[n++] = v;
+            }
+        }
+
+        if(n == 0)
+        {
+            break;
+        }
+
+        /* render one block of each voice */
+        fluid_rvoice_write_batch(active, dsp_bufs, counts, n, same_sample);
+
+        for(v = 0; v < n; v++)
+        {
+            int k = active_index[v];
+            int s = counts[v];
+
+            if(s == -1)
+            {
+                /* the voice is silent, mix back all the previously rendered sound */
+                fluid_profile_ref_set(prof_ref);
+                fluid_rvoice_buffers_mix(&rvoices[k]->buffers, &batch_buf[k * samplecount], last_block_mixed[k],
+                                         total_samples[k] - (last_block_mixed[k]*FLUID_BUFSIZE),
+                                         dest_bufs, dest_bufcount, buffers);
+                fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, rvoices, &k, 1, 0);
+
+                last_block_mixed[k] = i+1; /* future block start index to mix from */
+                total_samples[k] += FLUID_BUFSIZE; /* accumulate samples count rendered */
+            }
+            else
+            {
+                /* the voice wasn't quiet. Some samples have been rendered [0..FLUID_BUFSIZE] */
+                total_samples[k] += s;
+                finished[k] = (s < FLUID_BUFSIZE);
+            }
+        }
     }
 
-#endif
+    for(v = 0; v < voice_count; v++)
+    {
+        /* Now mix the remaining blocks from last_block_mixed to total_sample */
+        fluid_profile_ref_set(prof_ref);
+        fluid_rvoice_buffers_mix(&rvoices[v]->buffers, &batch_buf[v * samplecount], last_block_mixed[v],
+                                 total_samples[v] - (last_block_mixed[v]*FLUID_BUFSIZE),
+                                 dest_bufs, dest_bufcount, buffers);
+        fluid_rvoice_profile(FLUID_PROF_STAGE_MIX, prof_ref, rvoices, &v, 1, 0);
+
+        if(total_samples[v] < blockcount * FLUID_BUFSIZE)
+        {
+            /* voice has finished */
+            fluid_finish_rvoice(buffers, rvoices[v]);
+        }
+    }
+}
 
-    return mixer;
-    
-error_recovery:
-    delete_fluid_rvoice_mixer(mixer);
-    return NULL;
+/* Starts loading the state of a voice into the cache, that is rendered after the next one */
+static FLUID_INLINE void
+fluid_rvoice_prefetch_state(const fluid_rvoice_t *rvoice)
+{
+    FLUID_PREFETCH(&rvoice->dsp);
+    FLUID_PREFETCH(&rvoice->dsp.sample);
+    FLUID_PREFETCH(&rvoice->resonant_filter);
+    FLUID_PREFETCH(&rvoice->buffers);
+    FLUID_PREFETCH(&rvoice->envlfo);
+}
+
+/* Starts loading the sample frames at the phase of the voice rendered next, whose state is cached already */
+static FLUID_INLINE void
+fluid_rvoice_prefetch_sample(const fluid_rvoice_t *rvoice)
+{
+    const fluid_sample_t *sample = rvoice->dsp.sample;
+    unsigned int index = fluid_phase_index(rvoice->dsp.phase);
+
+    if(sample == NULL)
+    {
+        return;
+    }
+
+    if(sample->float_data != NULL)
+    {
+        FLUID_PREFETCH(&sample->float_data[index]);
+    }
+    else
+    {
+        FLUID_PREFETCH(&sample->data[index]);
+
+        if(sample->data24 != NULL)
+        {
+            FLUID_PREFETCH(&sample->data24[index]);
+        }
+    }
+}
+
+/*
+ * Pipelines the cache misses of the voices with the rendering: while the
+ * voices starting at rvoices[next] are rendered, the sample frames of the
+ * first of them and the state of the one after are loaded.
+ */
+static FLUID_INLINE void
+fluid_mixer_buffers_prefetch(fluid_rvoice_t **rvoices, int next, int end)
+{
+    if(next < end)
+    {
+        fluid_rvoice_prefetch_sample(rvoices[next]);
+    }
+
+    if(next + 1 < end)
+    {
+        fluid_rvoice_prefetch_state(rvoices[next + 1]);
+    }
 }
 
+/**
+ * Synthesize the voices mixer->rvoices[start..end-1] and add them to the buffers.
+ * Voices playing the same sample with the same interpolation method are moved
+ * next to each other and synthesized together. The remaining voices are
+ * synthesized in batches as well, so that their filters run side by side.
+ */
 static void
-fluid_mixer_buffers_free(fluid_mixer_buffers_t *buffers)
+fluid_mixer_buffers_render_range(fluid_mixer_buffers_t *buffers, int start, int end,
+                                 fluid_real_t **dest_bufs, unsigned int dest_bufcount,
+                                 fluid_real_t *src_buf, int blockcount)
 {
-    FLUID_FREE(buffers->finished_voices);
+    fluid_rvoice_t **rvoices = buffers->mixer->rvoices;
+    fluid_rvoice_t *others[FLUID_RVOICE_BATCH_MAX];
+    int prefetch = buffers->mixer->prefetch_voices;
+    int i, j, n, skipped, window_end, other_count = 0;
 
-    /* free all the sample buffers */
-    FLUID_FREE(buffers->local_buf);
-    FLUID_FREE(buffers->left_buf);
-    FLUID_FREE(buffers->right_buf);
-    FLUID_FREE(buffers->fx_left_buf);
-    FLUID_FREE(buffers->fx_right_buf);
+    if(prefetch && start < end)
+    {
+        fluid_rvoice_prefetch_state(rvoices[start]);
+
+        if(start + 1 < end)
+        {
+            fluid_rvoice_prefetch_state(rvoices[start + 1]);
+        }
+    }
+
+    for(i = start; i < end; i += n)
+    {
+        fluid_rvoice_t *rvoice = rvoices[i];
+
+        n = 1;
+
+        if(rvoice->stereo_leader != NULL)
+        {
+            /* rendered along with the other voice of its stereo pair */
+            continue;
+        }
+
+        if(rvoice->stereo_follower != NULL)
+        {
+            if(prefetch)
+            {
+                fluid_mixer_buffers_prefetch(rvoices, i + 1, end);
+            }
+
+            skipped = fluid_rvoice_skip_delay(rvoice, blockcount);
+
+            if(skipped < blockcount)
+            {
+                fluid_mixer_buffers_render_stereo(buffers, rvoice, dest_bufs, dest_bufcount, skipped, blockcount);
+            }
+
+            continue;
+        }
+
+        if(fluid_rvoice_is_delayed(rvoice))
+        {
+            /* nothing to render or mix before the delay is over, the rest
+             * of the blocks on its own as the delay ends only once */
+            if(prefetch)
+            {
+                fluid_mixer_buffers_prefetch(rvoices, i + 1, end);
+            }
+
+            skipped = fluid_rvoice_skip_delay(rvoice, blockcount);
+
+            if(skipped < blockcount)
+            {
+                fluid_mixer_buffers_render_one(buffers, rvoice, dest_bufs, dest_bufcount, src_buf, skipped, blockcount);
+            }
+
+            continue;
+        }
+
+        if(rvoice->note_cache_mode != FLUID_NOTE_CACHE_OFF)
+        {
+            /* recording or playing a note back, see fluid_note_cache_write() */
+            if(prefetch)
+            {
+                fluid_mixer_buffers_prefetch(rvoices, i + 1, end);
+            }
+
+            fluid_mixer_buffers_render_one(buffers, rvoice, dest_bufs, dest_bufcount, src_buf, 0, blockcount);
+            continue;
+        }
+
+        window_end = (end - i > BATCH_SEARCH_WINDOW) ? i + BATCH_SEARCH_WINDOW : end;
+
+        for(j = i + 1; j < window_end && n < FLUID_RVOICE_BATCH_MAX; j++)
+        {
+            if(rvoices[j]->dsp.sample == rvoice->dsp.sample
+                    && rvoices[j]->dsp.interp_method == rvoice->dsp.interp_method
+                    && rvoices[j]->stereo_leader == NULL && rvoices[j]->stereo_follower == NULL
+                    && rvoices[j]->note_cache_mode == FLUID_NOTE_CACHE_OFF
+                    && !fluid_rvoice_is_delayed(rvoices[j]))
+            {
+                fluid_rvoice_t *tmp = rvoices[i + n];
+                rvoices[i + n] = rvoices[j];
+                rvoices[j] = tmp;
+                n++;
+            }
+        }
+
+        if(prefetch)
+        {
+            fluid_mixer_buffers_prefetch(rvoices, i + n, end);
+        }
+
+        if(rvoice->dsp.sample == NULL)
+        {
+            for(j = i; j < i + n; j++)
+            {
+                fluid_mixer_buffers_render_one(buffers, rvoices[j], dest_bufs, dest_bufcount, src_buf, 0, blockcount);
+            }
+        }
+        else if(n == 1 && buffers->mixer->fused_voices)
+        {
+            /* nothing to share with the other voices */
+            fluid_mixer_buffers_render_one(buffers, rvoice, dest_bufs, dest_bufcount, src_buf, 0, blockcount);
+        }
+        else if(n == 1)
+        {
+            others[other_count++] = rvoice;
+
+            if(other_count == FLUID_RVOICE_BATCH_MAX)
+            {
+                fluid_mixer_buffers_render_batch(buffers, others, other_count, FALSE,
+                                                 dest_bufs, dest_bufcount, blockcount);
+                other_count = 0;
+            }
+        }
+        else
+        {
+            fluid_mixer_buffers_render_batch(buffers, &rvoices[i], n, TRUE, dest_bufs, dest_bufcount, blockcount);
+        }
+    }
+
+    if(other_count == 1)
+    {
+        fluid_mixer_buffers_render_one(buffers, others[0], dest_bufs, dest_bufcount, src_buf, 0, blockcount);
+    }
+    else if(other_count > 1)
+    {
+        fluid_mixer_buffers_render_batch(buffers, others, other_count, FALSE, dest_bufs, dest_bufcount, blockcount);
+    }
 }
 
-void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *mixer)
+static void
+fluid_rvoice_mixer_add_voice_LOCAL(fluid_rvoice_mixer_t *mixer, fluid_rvoice_t *voice)
 {
     int i;
-    
-    fluid_return_if_fail(mixer != NULL);
 
-#if ENABLE_MIXER_THREADS
-    delete_rvoice_mixer_threads(mixer);
+    if(mixer->note_cache != NULL)
+    {
+        fluid_note_cache_start(mixer->note_cache, voice);
+    }
 
-    if(mixer->thread_ready)
+    if(mixer->active_voices < mixer->polyphony)
     {
-        delete_fluid_cond(mixer->thread_ready);
+        mixer->rvoices[mixer->active_voices++] = voice;
+        return; // success
     }
 
-    if(mixer->wakeup_threads)
-    {
-        delete_fluid_cond(mixer->wakeup_threads);
+    /* See if any voices just finished, if so, take its place.
+       This can happen in voice overflow conditions. */
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        if(mixer->rvoices[i] == voice)
+        {
+            FLUID_LOG(FLUID_ERR, "Internal error: Trying to replace an existing rvoice in fluid_rvoice_mixer_add_voice?!");
+            return;
+        }
+
+        if(mixer->rvoices[i]->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+        {
+            fluid_rvoice_unlink_stereo(mixer->rvoices[i]);
+            fluid_finish_rvoice(&mixer->buffers, mixer->rvoices[i]);
+            mixer->rvoices[i] = voice;
+            return; // success
+        }
+    }
+
+    /* This should never happen */
+    if(mixer->note_cache != NULL)
+    {
+        fluid_note_cache_release(mixer->note_cache, voice);
+    }
+
+    FLUID_LOG(FLUID_ERR, "Trying to exceed polyphony in fluid_rvoice_mixer_add_voice");
+    return;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voice)
+{
+    fluid_rvoice_mixer_add_voice_LOCAL(obj, param[0].ptr);
+}
+
+/* Adds the voices started by one noteon at once, so that they all start
+ * rendering with the same block. The list ends at the first NULL. */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voices)
+{
+    int i;
+
+    for(i = 0; i < MAX_EVENT_PARAMS && param[i].ptr != NULL; i++)
+    {
+        fluid_rvoice_mixer_add_voice_LOCAL(obj, param[i].ptr);
+    }
+}
+
+/* Finishes several voices with a single event, like fluid_rvoice_voiceoff()
+ * does for each of them. The list ends at the first NULL. */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_voices_off)
+{
+    int i;
+
+    for(i = 0; i < MAX_EVENT_PARAMS && param[i].ptr != NULL; i++)
+    {
+        fluid_rvoice_voiceoff(param[i].ptr, NULL);
+    }
+}
+
+/**
+ * Finish all the voices of a MIDI channel in one pass, instead of
+ * an event for each of them.
+ *
+ * @param param[0].i MIDI channel, -1 for all of them
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_channel_off)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int chan = param[0].i;
+    int i;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        fluid_rvoice_t *rvoice = mixer->rvoices[i];
+
+        if(chan == -1 || rvoice->chan == chan)
+        {
+            fluid_rvoice_voiceoff(rvoice, NULL);
+        }
+    }
+}
+
+static int
+fluid_mixer_buffers_update_polyphony(fluid_mixer_buffers_t *buffers, int value)
+{
+    void *newptr;
+
+    if(buffers->finished_voice_count > value)
+    {
+        return FLUID_FAILED;
+    }
+
+    newptr = FLUID_REALLOC(buffers->finished_voices, value * sizeof(fluid_rvoice_t *));
+
+    if(newptr == NULL && value > 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    buffers->finished_voices = newptr;
+    return FLUID_OK;
+}
+
+/* Grow the voice lists of the mixer and of its threads to hold at least value voices */
+static int
+fluid_rvoice_mixer_reserve_polyphony_LOCAL(fluid_rvoice_mixer_t *handler, int value)
+{
+    void *newptr;
+
+    if(value <= handler->polyphony_capacity)
+    {
+        return FLUID_OK;
+    }
+
+    newptr = FLUID_REALLOC(handler->rvoices, value * sizeof(fluid_rvoice_t *));
+
+    if(newptr == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    handler->rvoices = newptr;
+
+    if(fluid_mixer_buffers_update_polyphony(&handler->buffers, value)
+            == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+#if ENABLE_MIXER_THREADS
+    newptr = FLUID_REALLOC(handler->ws_chunks, (value + 1) * sizeof(int));
+
+    if(newptr == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    handler->ws_chunks = newptr;
+
+    {
+        int i;
+
+        for(i = 0; i < handler->thread_count; i++)
+        {
+            if(fluid_mixer_buffers_update_polyphony(&handler->threads[i], value)
+                    == FLUID_FAILED)
+            {
+                return FLUID_FAILED;
+            }
+        }
+    }
+#endif
+
+    handler->polyphony_capacity = value;
+    return FLUID_OK;
+}
+
+static void
+fluid_rvoice_mixer_set_polyphony_LOCAL(fluid_rvoice_mixer_t *handler, int value)
+{
+    int result;
+
+    if(handler->active_voices > value)
+    {
+        return /*FLUID_FAILED*/;
+    }
+
+    /* within the reserved voices, this is only a counter update */
+    if(value > handler->polyphony_capacity)
+    {
+        /* growing beyond them is known to reallocate the voice lists */
+        fluid_rt_exit();
+        result = fluid_rvoice_mixer_reserve_polyphony_LOCAL(handler, value);
+        fluid_rt_enter();
+
+        if(result == FLUID_FAILED)
+        {
+            return /*FLUID_FAILED*/;
+        }
+    }
+
+    handler->polyphony = value;
+    return /*FLUID_OK*/;
+}
+
+/**
+ * Allocate the voice lists for @p value voices up front, so that raising the
+ * polyphony up to it doesn't allocate while rendering. Must not be called
+ * while the mixer is rendering.
+ * @return FLUID_OK, FLUID_FAILED on out of memory
+ */
+int
+fluid_rvoice_mixer_reserve_polyphony(fluid_rvoice_mixer_t *mixer, int value)
+{
+    if(fluid_rvoice_mixer_reserve_polyphony_LOCAL(mixer, value) == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Update polyphony - max number of voices (NOTE: not hard real-time capable)
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony)
+{
+    fluid_rvoice_mixer_set_polyphony_LOCAL(obj, param[0].i);
+}
+
+
+static void
+fluid_render_loop_singlethread(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
+                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
+    int bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
+
+    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    fluid_profile_ref_var(prof_ref);
+
+    fluid_mixer_buffers_render_range(&mixer->buffers, 0, mixer->active_voices, bufs,
+                                     bufcount, local_buf, blockcount);
+    fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, mixer->active_voices,
+                  blockcount * FLUID_BUFSIZE);
+}
+
+/**
+ * Get a buffer of the mixer buffers by its index into fluid_mixer_buffers_t::dirty.
+ */
+static FLUID_INLINE fluid_real_t *
+fluid_mixer_buffers_get_dirty_buf(fluid_mixer_buffers_t *buffers, int index)
+{
+    int buf_count = buffers->buf_count, fx_buf_count = buffers->fx_buf_count;
+    fluid_real_t *buf;
+
+    if(index < 2)
+    {
+        return fluid_mixer_buffers_get_main_buf(buffers, index);
+    }
+    else if(index < 2 * buf_count)
+    {
+        buf = (index % 2 == 0) ? buffers->left_buf : buffers->right_buf;
+        index /= 2;
+    }
+    else if(index < 2 * buf_count + fx_buf_count)
+    {
+        buf = buffers->fx_left_buf;
+        index -= 2 * buf_count;
+    }
+    else
+    {
+        buf = buffers->fx_right_buf;
+        index -= 2 * buf_count + fx_buf_count;
+    }
+
+    buf = fluid_align_ptr(buf, FLUID_DEFAULT_ALIGNMENT);
+    return &buf[index * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+}
+
+static FLUID_INLINE void
+fluid_mixer_buffers_zero(fluid_mixer_buffers_t *buffers)
+{
+    int i;
+
+    /* Only zero out what has been written to since the last time */
+    for(i = 0; i < buffers->touched_count; i++)
+    {
+        int index = buffers->touched[i];
+
+        FLUID_MEMSET(fluid_mixer_buffers_get_dirty_buf(buffers, index), 0,
+                     buffers->dirty[index] * FLUID_BUFSIZE * sizeof(fluid_real_t));
+        buffers->dirty[index] = 0;
+    }
+
+    buffers->touched_count = 0;
+}
+
+static int
+fluid_mixer_buffers_init(fluid_mixer_buffers_t *buffers, fluid_rvoice_mixer_t *mixer)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    int has_fx_right = (buffers == &mixer->buffers);
+    int i;
+
+    buffers->mixer = mixer;
+    buffers->buf_count = mixer->buffers.buf_count;
+    buffers->fx_buf_count = mixer->buffers.fx_buf_count;
+
+    /* Local mono voice buf */
+    buffers->local_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->batch_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, FLUID_RVOICE_BATCH_MAX * samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    /* Left and right audio buffers */
+
+    buffers->left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    if((buffers->local_buf == NULL) || (buffers->batch_buf == NULL)
+            || (buffers->left_buf == NULL) || (buffers->right_buf == NULL))
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    /* Effects audio buffers */
+
+    buffers->fx_left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    /* The voices only write their mono effects input to the left buffers, the effects units
+     * write their output to the ones of the main thread. So the extra mixer threads do without. */
+    if(has_fx_right)
+    {
+        buffers->fx_right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    }
+
+    if((buffers->fx_left_buf == NULL) || (has_fx_right && buffers->fx_right_buf == NULL))
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    /* The buffers are not initialized yet, so they need to be zeroed entirely */
+    buffers->dirty = FLUID_ARRAY(int, 2 * (buffers->buf_count + buffers->fx_buf_count));
+    buffers->touched = FLUID_ARRAY(int, 2 * (buffers->buf_count + buffers->fx_buf_count));
+
+    if(buffers->dirty == NULL || buffers->touched == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    buffers->touched_count = 0;
+
+    for(i = 0; i < 2 * (buffers->buf_count + buffers->fx_buf_count); i++)
+    {
+        buffers->dirty[i] = 0;
+
+        if(has_fx_right || i < DIRTY_FX_RIGHT(buffers, 0))
+        {
+            buffers->dirty[i] = FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+            buffers->touched[buffers->touched_count++] = i;
+        }
+    }
+
+    buffers->finished_voices = NULL;
+
+    if(fluid_mixer_buffers_update_polyphony(buffers, mixer->polyphony_capacity)
+            == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Create the effects units of all fx units of the mixer for a new sample rate, or for
+ * an effect turned on, to be swapped in by fluid_rvoice_mixer_set_rate(). Call it from
+ * any thread but the rendering one, it allocates memory.
+ * @param reverb What to do with the reverb units, see #fluid_mixer_fx_change
+ * @param chorus What to do with the chorus units, see #fluid_mixer_fx_change
+ * @return the new units, NULL on error
+ */
+fluid_rvoice_mixer_rate_t *
+new_fluid_rvoice_mixer_rate(fluid_rvoice_mixer_t *mixer, fluid_real_t sample_rate, int reverb, int chorus)
+{
+    int i;
+    fluid_rvoice_mixer_rate_t *rate = FLUID_NEW(fluid_rvoice_mixer_rate_t);
+
+    if(rate == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(rate, 0, sizeof(*rate));
+    rate->sample_rate = sample_rate;
+    rate->fx_units = fluid_rvoice_mixer_count_fx_busses(mixer);
+    rate->reverb = reverb;
+    rate->chorus = chorus;
+    fluid_atomic_int_set(&rate->swapped, FALSE);
+
+    rate->fx = FLUID_ARRAY(fluid_mixer_fx_t, rate->fx_units);
+
+    if(rate->fx == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(rate->fx, 0, rate->fx_units * sizeof(*rate->fx));
+
+    for(i = 0; i < rate->fx_units; i++)
+    {
+        if(reverb == FLUID_MIXER_FX_NEW)
+        {
+            rate->fx[i].reverb = new_fluid_revmodel(sample_rate);
+
+            if(rate->fx[i].reverb == NULL
+                    || (mixer->reverb_decimation > 1
+                        && fluid_revmodel_set_decimation(rate->fx[i].reverb, mixer->reverb_decimation) != FLUID_OK))
+            {
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+                goto error_recovery;
+            }
+        }
+
+        if(chorus == FLUID_MIXER_FX_NEW)
+        {
+            rate->fx[i].chorus = new_fluid_chorus(sample_rate);
+
+            if(rate->fx[i].chorus == NULL)
+            {
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+                goto error_recovery;
+            }
+        }
+    }
+
+    return rate;
+
+error_recovery:
+    delete_fluid_rvoice_mixer_rate(rate);
+    return NULL;
+}
+
+/**
+ * Free the units of a fluid_rvoice_mixer_rate_t: the new ones if it hasn't been
+ * swapped in, the replaced ones otherwise. Not to be called between
+ * fluid_rvoice_mixer_set_rate() being queued and dispatched.
+ */
+void
+delete_fluid_rvoice_mixer_rate(fluid_rvoice_mixer_rate_t *rate)
+{
+    int i;
+
+    fluid_return_if_fail(rate != NULL);
+
+    if(rate->fx != NULL)
+    {
+        for(i = 0; i < rate->fx_units; i++)
+        {
+            delete_fluid_revmodel(rate->fx[i].reverb);
+            delete_fluid_chorus(rate->fx[i].chorus);
+        }
+    }
+
+    FLUID_FREE(rate->fx);
+    FLUID_FREE(rate);
+}
+
+/**
+ * @return TRUE once fluid_rvoice_mixer_set_rate() has been dispatched, i.e. when
+ * @p rate holds the replaced units, which are safe to delete now.
+ */
+int
+fluid_rvoice_mixer_rate_is_swapped(fluid_rvoice_mixer_rate_t *rate)
+{
+    return fluid_atomic_int_get(&rate->swapped);
+}
+
+/**
+ * Swap the effects units created by new_fluid_rvoice_mixer_rate() with the ones in use,
+ * between two blocks, leaving those it was told to keep alone. Hard real-time capable,
+ * as long as no LADSPA effects are active: the replaced units are passed back in the
+ * fluid_rvoice_mixer_rate_t for the caller to delete.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_rate)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_rvoice_mixer_rate_t *rate = param[0].ptr;
+    fluid_mixer_fx_t fx;
+
+    int i;
+    for(i = 0; i < rate->fx_units; i++)
+    {
+        fx = mixer->fx[i];
+
+        /* the new units are silent until they get some input */
+        if(rate->reverb != FLUID_MIXER_FX_KEEP)
+        {
+            mixer->fx[i].reverb = rate->fx[i].reverb;
+            rate->fx[i].reverb = fx.reverb;
+            mixer->fx[i].reverb_idle = TRUE;
+        }
+
+        if(rate->chorus != FLUID_MIXER_FX_KEEP)
+        {
+            mixer->fx[i].chorus = rate->fx[i].chorus;
+            rate->fx[i].chorus = fx.chorus;
+            mixer->fx[i].chorus_idle = TRUE;
+        }
+    }
+
+#if LADSPA
+
+    if(mixer->ladspa_fx != NULL)
+    {
+        fluid_ladspa_set_sample_rate(mixer->ladspa_fx, rate->sample_rate);
+    }
+
+#endif
+
+    fluid_atomic_int_set(&rate->swapped, TRUE);
+}
+
+/**
+ * Prepare the replacement of the reverb of an fx unit by a convolution reverb,
+ * see fluid_rvoice_mixer_set_ir().
+ * @param unit index of the fx unit
+ * @param conv the convolution reverb, NULL to go back to the reverb unit. Owned by the
+ *   fluid_rvoice_mixer_ir_t until it is swapped in.
+ * @return the replacement, NULL on error
+ */
+fluid_rvoice_mixer_ir_t *
+new_fluid_rvoice_mixer_ir(int unit, fluid_convolver_t *conv)
+{
+    fluid_rvoice_mixer_ir_t *ir = FLUID_NEW(fluid_rvoice_mixer_ir_t);
+
+    if(ir == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    ir->unit = unit;
+    ir->conv = conv;
+    fluid_atomic_int_set(&ir->swapped, FALSE);
+
+    return ir;
+}
+
+/**
+ * Free a fluid_rvoice_mixer_ir_t along with its convolution reverb: the new one if it
+ * hasn't been swapped in, the replaced one otherwise. Not to be called between
+ * fluid_rvoice_mixer_set_ir() being queued and dispatched.
+ */
+void
+delete_fluid_rvoice_mixer_ir(fluid_rvoice_mixer_ir_t *ir)
+{
+    fluid_return_if_fail(ir != NULL);
+
+    delete_fluid_convolver(ir->conv);
+    FLUID_FREE(ir);
+}
+
+/**
+ * @return TRUE once fluid_rvoice_mixer_set_ir() has been dispatched, i.e. when
+ * @p ir holds the replaced convolution reverb, which is safe to delete now.
+ */
+int
+fluid_rvoice_mixer_ir_is_swapped(fluid_rvoice_mixer_ir_t *ir)
+{
+    return fluid_atomic_int_get(&ir->swapped);
+}
+
+/**
+ * Swap the convolution reverb of a fluid_rvoice_mixer_ir_t with the one of its fx unit,
+ * between two blocks. The replaced one is passed back for the caller to delete.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_ir)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_rvoice_mixer_ir_t *ir = param[0].ptr;
+    fluid_convolver_t *conv = mixer->fx[ir->unit].conv;
+
+    mixer->fx[ir->unit].conv = ir->conv;
+    ir->conv = conv;
+
+    /* whichever of them is used now starts from silence */
+    if(mixer->fx[ir->unit].reverb != NULL)
+    {
+        fluid_revmodel_reset(mixer->fx[ir->unit].reverb);
+    }
+
+    mixer->fx[ir->unit].reverb_idle = TRUE;
+
+    fluid_atomic_int_set(&ir->swapped, TRUE);
+}
+
+
+/**
+ * @param buf_count number of primary stereo buffers
+ * @param fx_buf_count number of stereo effect buffers
+ */
+fluid_rvoice_mixer_t *
+new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, int fx_units, fluid_rvoice_eventhandler_t *evthandler, int extra_threads, int prio)
+{
+    int i;
+    fluid_rvoice_mixer_t *mixer = FLUID_NEW(fluid_rvoice_mixer_t);
+
+    if(mixer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(mixer, 0, sizeof(fluid_rvoice_mixer_t));
+    mixer->eventhandler = evthandler;
+    mixer->fx_units = fx_units;
+    mixer->render_core = -1;
+    mixer->buffers.buf_count = buf_count;
+    mixer->buffers.fx_buf_count = fx_buf_count * fx_units;
+
+    /* the reverb and chorus units are created once the effects are turned on,
+     * see new_fluid_rvoice_mixer_rate() */
+    mixer->fx = FLUID_ARRAY(fluid_mixer_fx_t, fx_units);
+    if(mixer->fx == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    
+    FLUID_MEMSET(mixer->fx, 0, fx_units * sizeof(*mixer->fx));
+    
+    for(i = 0; i < fx_units; i++)
+    {
+        mixer->fx[i].reverb_idle = TRUE;
+        mixer->fx[i].chorus_idle = TRUE;
+        mixer->fx[i].reverb_send = 1;
+        mixer->fx[i].chorus_send = 1;
+    }
+
+    if(!fluid_mixer_buffers_init(&mixer->buffers, mixer))
+    {
+        goto error_recovery;
+    }
+
+#if ENABLE_MIXER_THREADS
+    mixer->thread_ready = new_fluid_cond();
+    mixer->wakeup_threads = new_fluid_cond();
+    mixer->thread_ready_m = new_fluid_cond_mutex();
+    mixer->wakeup_threads_m = new_fluid_cond_mutex();
+
+    if(!mixer->thread_ready || !mixer->wakeup_threads ||
+            !mixer->thread_ready_m || !mixer->wakeup_threads_m)
+    {
+        goto error_recovery;
+    }
+
+    if(fluid_rvoice_mixer_set_threads(mixer, extra_threads, prio) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+#endif
+
+    return mixer;
+    
+error_recovery:
+    delete_fluid_rvoice_mixer(mixer);
+    return NULL;
+}
+
+static void
+delete_fluid_mixer_upsampler(fluid_mixer_upsampler_t *upsampler)
+{
+    fluid_return_if_fail(upsampler != NULL);
+
+    FLUID_FREE(upsampler->coefs);
+    FLUID_FREE(upsampler->in);
+    FLUID_FREE(upsampler->silent);
+    FLUID_FREE(upsampler->out);
+    FLUID_FREE(upsampler);
+}
+
+/* Modified Bessel function of the first kind and order 0, for the Kaiser window */
+static double
+fluid_mixer_upsampler_bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    int k;
+
+    for(k = 1; term > 1e-12 * sum; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/*
+ * Design the polyphase filter: a lowpass sinc at the cutoff of the input, in a Kaiser window of
+ * num * FLUID_MIXER_UPSAMPLER_TAPS samples of the output rate. Each phase weights the input
+ * samples with the coefficients of its own, normalized so that a constant input stays unchanged.
+ */
+static void
+fluid_mixer_upsampler_design(fluid_mixer_upsampler_t *upsampler)
+{
+    int num = upsampler->num, length = num * FLUID_MIXER_UPSAMPLER_TAPS;
+    double center = length / 2.0, i0_beta = fluid_mixer_upsampler_bessel_i0(FLUID_MIXER_UPSAMPLER_BETA);
+    int p, k;
+
+    for(p = 0; p < num; p++)
+    {
+        fluid_real_t *coefs = &upsampler->coefs[p * FLUID_MIXER_UPSAMPLER_TAPS];
+        double sum = 0;
+
+        for(k = 0; k < FLUID_MIXER_UPSAMPLER_TAPS; k++)
+        {
+            double x = p + k * num - center;
+            double r = x / center;
+            double t = FLUID_MIXER_UPSAMPLER_CUTOFF * x / num;
+            double sinc = (t == 0) ? 1 : sin(M_PI * t) / (M_PI * t);
+            double window = fluid_mixer_upsampler_bessel_i0(FLUID_MIXER_UPSAMPLER_BETA * sqrt(1 - r * r)) / i0_beta;
+
+            coefs[k] = (fluid_real_t)(sinc * window);
+            sum += coefs[k];
+        }
+
+        for(k = 0; k < FLUID_MIXER_UPSAMPLER_TAPS; k++)
+        {
+            coefs[k] = (fluid_real_t)(coefs[k] / sum);
+        }
+    }
+}
+
+/* Start the upsampler over, with silence in the past */
+static void
+fluid_mixer_upsampler_clear(fluid_mixer_upsampler_t *upsampler)
+{
+    int i;
+
+    FLUID_MEMSET(upsampler->in, 0, upsampler->channels * upsampler->in_size * sizeof(fluid_real_t));
+    upsampler->in_frames = FLUID_MIXER_UPSAMPLER_TAPS - 1;
+    upsampler->next = FLUID_MIXER_UPSAMPLER_TAPS - 1;
+    upsampler->phase = 0;
+
+    for(i = 0; i < upsampler->channels; i++)
+    {
+        upsampler->silent[i] = upsampler->in_frames;
+    }
+}
+
+/**
+ * Get an output buffer of the upsampler by the index of its mixer buffer into fluid_mixer_buffers_t::dirty.
+ */
+static FLUID_INLINE fluid_real_t *
+fluid_mixer_upsampler_get_out_buf(fluid_mixer_upsampler_t *upsampler, int buf_count, int index)
+{
+    fluid_real_t *out = fluid_align_ptr(upsampler->out, FLUID_DEFAULT_ALIGNMENT);
+
+    if(index < 2 * buf_count)
+    {
+        /* the interleaved left and right buffers */
+        index = (index % 2 == 0) ? index / 2 : buf_count + index / 2;
+    }
+
+    return &out[index * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+}
+
+/* Append the blocks just rendered to the input of the upsampler */
+static void
+fluid_rvoice_mixer_queue_upsampling(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    fluid_mixer_upsampler_t *upsampler = mixer->upsampler;
+    int count = blockcount * FLUID_BUFSIZE;
+    int i;
+
+    for(i = 0; i < upsampler->channels; i++)
+    {
+        fluid_real_t *in = &upsampler->in[i * upsampler->in_size + upsampler->in_frames];
+        int written = mixer->buffers.dirty[i] * FLUID_BUFSIZE;
+
+        /* the mixer buffers have been zeroed beyond what was written to */
+        FLUID_MEMCPY(in, fluid_mixer_buffers_get_dirty_buf(&mixer->buffers, i), written * sizeof(fluid_real_t));
+        FLUID_MEMSET(in + written, 0, (count - written) * sizeof(fluid_real_t));
+        upsampler->silent[i] = (written > 0) ? count - written : upsampler->silent[i] + count;
+    }
+
+    upsampler->in_frames += count;
+}
+
+static void
+fluid_mixer_buffers_free(fluid_mixer_buffers_t *buffers)
+{
+    FLUID_FREE(buffers->finished_voices);
+
+    /* free all the sample buffers */
+    FLUID_FREE(buffers->local_buf);
+    FLUID_FREE(buffers->batch_buf);
+    FLUID_FREE(buffers->left_buf);
+    FLUID_FREE(buffers->right_buf);
+    FLUID_FREE(buffers->fx_left_buf);
+    FLUID_FREE(buffers->fx_right_buf);
+    FLUID_FREE(buffers->dirty);
+    FLUID_FREE(buffers->touched);
+}
+
+void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *mixer)
+{
+    int i;
+    
+    fluid_return_if_fail(mixer != NULL);
+
+#if ENABLE_MIXER_THREADS
+    fluid_rvoice_mixer_leave_render_pool(mixer);
+    delete_rvoice_mixer_threads(mixer);
+
+    if(mixer->thread_ready)
+    {
+        delete_fluid_cond(mixer->thread_ready);
+    }
+
+    if(mixer->wakeup_threads)
+    {
+        delete_fluid_cond(mixer->wakeup_threads);
+    }
+
+    if(mixer->thread_ready_m)
+    {
+        delete_fluid_cond_mutex(mixer->thread_ready_m);
+    }
+
+    if(mixer->wakeup_threads_m)
+    {
+        delete_fluid_cond_mutex(mixer->wakeup_threads_m);
+    }
+
+    FLUID_FREE(mixer->thread_cores);
+#endif
+    fluid_mixer_buffers_free(&mixer->buffers);
+
+    
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].reverb)
+        {
+            delete_fluid_revmodel(mixer->fx[i].reverb);
+        }
+
+        if(mixer->fx[i].chorus)
+        {
+            delete_fluid_chorus(mixer->fx[i].chorus);
+        }
+
+        delete_fluid_convolver(mixer->fx[i].conv);
+    }
+
+    FLUID_FREE(mixer->fx);
+    FLUID_FREE(mixer->rvoices);
+    FLUID_FREE(mixer->meters);
+
+    if(mixer->snapshot != NULL)
+    {
+        FLUID_FREE(mixer->snapshot->voices[0]);
+        FLUID_FREE(mixer->snapshot->voices[1]);
+        FLUID_FREE(mixer->snapshot);
+    }
+
+    delete_fluid_mixer_upsampler(mixer->upsampler);
+    delete_fluid_note_cache(mixer->note_cache);
+#if ENABLE_MIXER_THREADS
+    FLUID_FREE(mixer->ws_chunks);
+#endif
+    FLUID_FREE(mixer);
+}
+
+
+#ifdef LADSPA
+/**
+ * Set a LADSPS fx instance to be used by the mixer and assign the mixer buffers
+ * as LADSPA host buffers with sensible names */
+void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
+                                   fluid_ladspa_fx_t *ladspa_fx, int audio_groups)
+{
+    mixer->ladspa_fx = ladspa_fx;
+
+    if(ladspa_fx == NULL)
+    {
+        return;
+    }
+    else
+    {
+        fluid_real_t *main_l = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_real_t *main_r = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+        fluid_real_t *rev = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_real_t *chor = rev;
+
+        rev = &rev[SYNTH_REVERB_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+        chor = &chor[SYNTH_CHORUS_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Main:L", audio_groups,
+                                    main_l,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Main:R", audio_groups,
+                                    main_r,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Reverb:Send", 1,
+                                    rev,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Chorus:Send", 1,
+                                    chor,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    }
+}
+#endif
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_enabled)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int on = param[0].i;
+
+    mixer->with_reverb = on;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_enabled)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int on = param[0].i;
+    mixer->with_chorus = on;
+}
+
+void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->mix_fx_to_out = on;
+}
+
+/**
+ * Let all fx groups feed the reverb and the chorus of the first one, by their send
+ * gains, rather than each of them having units of its own. Must be called before
+ * any units have been created by new_fluid_rvoice_mixer_rate().
+ */
+void fluid_rvoice_mixer_set_fx_shared(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->fx_shared = on;
+}
+
+/**
+ * Set the gain of the reverb or the chorus input of an fx group.
+ * param[0].i is the fx group, param[1].i TRUE for the chorus, FALSE for the reverb,
+ * param[2].real the gain.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_fx_send)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int unit = param[0].i;
+
+    if(param[1].i)
+    {
+        mixer->fx[unit].chorus_send = param[2].real;
+    }
+    else
+    {
+        mixer->fx[unit].reverb_send = param[2].real;
+    }
+}
+
+/**
+ * Select how voices are distributed among the mixer threads.
+ * Must not be called while rendering.
+ * @param scheduler a value of #fluid_mixer_scheduler
+ */
+void fluid_rvoice_mixer_set_scheduler(fluid_rvoice_mixer_t *mixer, int scheduler)
+{
+#if ENABLE_MIXER_THREADS
+    mixer->scheduler = scheduler;
+#endif
+}
+
+/**
+ * Tell whether rendering the next blocks would only give silence: no voice is
+ * playing, the reverb and chorus tails have decayed below the noise floor (see
+ * fluid_rvoice_mixer_process_fx_unit()) and neither the level meters nor LADSPA
+ * need the blocks to be rendered.
+ */
+int fluid_rvoice_mixer_is_silent(fluid_rvoice_mixer_t *mixer)
+{
+    int f, busses = fluid_rvoice_mixer_count_fx_busses(mixer);
+
+    if(mixer->active_voices > 0 || mixer->meters != NULL)
+    {
+        return FALSE;
+    }
+
+#ifdef LADSPA
+
+    if(mixer->ladspa_fx != NULL)
+    {
+        return FALSE;
+    }
+
+#endif
+
+    for(f = 0; f < busses; f++)
+    {
+        const fluid_mixer_fx_t *fx = &mixer->fx[f];
+
+        if(mixer->with_reverb && !fx->reverb_idle && (fx->reverb != NULL || fx->conv != NULL))
+        {
+            return FALSE;
+        }
+
+        if(mixer->with_chorus && !fx->chorus_idle && fx->chorus != NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* The state of an effects unit saved by fluid_rvoice_mixer_save_fx_state(), followed by
+ * the state of its reverb and of its chorus, of the given sizes, 0 if not created */
+typedef struct
+{
+    int reverb_idle;
+    int chorus_idle;
+    unsigned int reverb_size;
+    unsigned int chorus_size;
+} fluid_mixer_fx_state_t;
+
+/**
+ * Get the bytes of the state of the effects units saved by fluid_rvoice_mixer_save_fx_state().
+ * Called with the API of the synth locked, so that the fx units aren't replaced meanwhile.
+ */
+size_t fluid_rvoice_mixer_get_fx_state_size(fluid_rvoice_mixer_t *mixer)
+{
+    size_t size = 0;
+    int i;
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        size += sizeof(fluid_mixer_fx_state_t);
+
+        if(mixer->fx[i].reverb != NULL)
+        {
+            size += fluid_revmodel_get_size(mixer->fx[i].reverb);
+        }
+
+        if(mixer->fx[i].chorus != NULL)
+        {
+            size += fluid_chorus_get_size(mixer->fx[i].chorus);
+        }
+    }
+
+    return size;
+}
+
+/**
+ * Save the state of the reverb and chorus units, with their delay lines, to
+ * \p data of fluid_rvoice_mixer_get_fx_state_size() bytes. The convolution
+ * reverbs are left out. Must not be called while rendering.
+ */
+void fluid_rvoice_mixer_save_fx_state(fluid_rvoice_mixer_t *mixer, void *data)
+{
+    char *pos = data;
+    int i;
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        const fluid_mixer_fx_t *fx = &mixer->fx[i];
+        fluid_mixer_fx_state_t state;
+
+        state.reverb_idle = fx->reverb_idle;
+        state.chorus_idle = fx->chorus_idle;
+        state.reverb_size = (fx->reverb != NULL) ? (unsigned int)fluid_revmodel_get_size(fx->reverb) : 0;
+        state.chorus_size = (fx->chorus != NULL) ? (unsigned int)fluid_chorus_get_size(fx->chorus) : 0;
+        FLUID_MEMCPY(pos, &state, sizeof(state));
+        pos += sizeof(state);
+
+        if(fx->reverb != NULL)
+        {
+            fluid_revmodel_save_state(fx->reverb, pos);
+            pos += state.reverb_size;
+        }
+
+        if(fx->chorus != NULL)
+        {
+            fluid_chorus_save_state(fx->chorus, pos);
+            pos += state.chorus_size;
+        }
+    }
+}
+
+/**
+ * Restore the state of the effects units saved by fluid_rvoice_mixer_save_fx_state().
+ * The units not saved are reset, the units saved but not created are left out.
+ * Must not be called while rendering.
+ * @return FLUID_OK on success, FLUID_FAILED if the state doesn't match the units, e.g.
+ * because it was saved by a mixer with another count of units or another sample rate
+ */
+int fluid_rvoice_mixer_load_fx_state(fluid_rvoice_mixer_t *mixer, const void *data, size_t size)
+{
+    const char *pos = data, *end = pos + size;
+    int i;
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        fluid_mixer_fx_t *fx = &mixer->fx[i];
+        fluid_mixer_fx_state_t state;
+
+        if((size_t)(end - pos) < sizeof(state))
+        {
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMCPY(&state, pos, sizeof(state));
+        pos += sizeof(state);
+
+        if((size_t)(end - pos) < (size_t)state.reverb_size + state.chorus_size)
+        {
+            return FLUID_FAILED;
+        }
+
+        if(fx->reverb != NULL)
+        {
+            if(state.reverb_size == 0)
+            {
+                fluid_revmodel_reset(fx->reverb);
+            }
+            else if(state.reverb_size != fluid_revmodel_get_size(fx->reverb)
+                    || fluid_revmodel_load_state(fx->reverb, pos) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+        }
+
+        if(fx->chorus != NULL)
+        {
+            if(state.chorus_size == 0)
+            {
+                fluid_chorus_reset(fx->chorus);
+            }
+            else if(state.chorus_size != fluid_chorus_get_size(fx->chorus)
+                    || fluid_chorus_load_state(fx->chorus, pos + state.reverb_size) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+        }
+
+        fx->reverb_idle = state.reverb_idle;
+        fx->chorus_idle = state.chorus_idle;
+        pos += state.reverb_size + state.chorus_size;
+    }
+
+    return (pos == end) ? FLUID_OK : FLUID_FAILED;
+}
+
+/**
+ * Get a voice the mixer renders, in the order they are rendered.
+ * Must not be called while rendering.
+ * @param index the index of the voice, below fluid_rvoice_mixer_get_active_voices()
+ */
+fluid_rvoice_t *fluid_rvoice_mixer_get_voice(fluid_rvoice_mixer_t *mixer, int index)
+{
+    return mixer->rvoices[index];
+}
+
+/**
+ * Remove the voices finished since the last rendering right away, rather than
+ * by the next rendering, e.g. the ones turned off by fluid_synth_restore_state().
+ * Must not be called while rendering.
+ */
+void fluid_rvoice_mixer_remove_finished_voices(fluid_rvoice_mixer_t *mixer)
+{
+    int i;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        if(mixer->rvoices[i]->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+        {
+            fluid_finish_rvoice(&mixer->buffers, mixer->rvoices[i]);
+        }
+    }
+
+    fluid_rvoice_mixer_process_finished_voices(mixer);
+}
+
+/**
+ * Add the voices restored by fluid_synth_restore_state() at once, in the order
+ * they were rendered in when saved, so that they are mixed in the same order
+ * once the finished voices are removed. The note cache isn't used by the voices
+ * added. Must not be called while rendering.
+ * @param voices the rvoices to add, NULL ones are skipped
+ * @param count the length of \p voices
+ */
+void fluid_rvoice_mixer_restore_voices(fluid_rvoice_mixer_t *mixer, fluid_rvoice_t **voices, int count)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(voices[i] == NULL)
+        {
+            continue;
+        }
+
+        if(mixer->active_voices == mixer->polyphony)
+        {
+            FLUID_LOG(FLUID_ERR, "Trying to exceed polyphony in fluid_rvoice_mixer_restore_voices");
+            return;
+        }
+
+        mixer->rvoices[mixer->active_voices++] = voices[i];
+    }
+}
+
+/**
+ * Let the rendering prefetch the state and the sample frames of the next voices
+ * while rendering a voice, see fluid_mixer_buffers_prefetch().
+ */
+void fluid_rvoice_mixer_set_prefetch(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->prefetch_voices = on;
+}
+
+/**
+ * Let the voices rendered on their own, rather than along with other voices
+ * playing the same sample, be filtered and added to the buffers in one pass,
+ * see fluid_mixer_buffers_render_fused().
+ */
+void fluid_rvoice_mixer_set_fused(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->fused_voices = on;
+}
+
+/**
+ * Let the reverb units created from now on run their feedback delay network
+ * at a lower rate, see fluid_revmodel_set_decimation().
+ * @param decimation the rate divider, rounded down to 1, 2 or 4
+ */
+void fluid_rvoice_mixer_set_reverb_decimation(fluid_rvoice_mixer_t *mixer, int decimation)
+{
+    mixer->reverb_decimation = (decimation >= 4) ? 4 : (decimation >= 2) ? 2 : 1;
+}
+
+/**
+ * Let the voices of unlooped samples record their output, to be played back by
+ * later voices starting in the same state, see fluid_note_cache_start().
+ * Must be called before rendering starts.
+ * @param size the memory to use for the recordings in bytes
+ */
+int fluid_rvoice_mixer_set_note_cache(fluid_rvoice_mixer_t *mixer, unsigned int size)
+{
+    fluid_note_cache_t *cache = new_fluid_note_cache(size);
+
+    if(cache == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    delete_fluid_note_cache(mixer->note_cache);
+    mixer->note_cache = cache;
+    return FLUID_OK;
+}
+
+/**
+ * @return the count of voices the note cache has played back, 0 without a note cache
+ */
+unsigned int fluid_rvoice_mixer_get_note_cache_hits(fluid_rvoice_mixer_t *mixer)
+{
+    return (mixer->note_cache != NULL) ? fluid_note_cache_get_hits(mixer->note_cache) : 0;
+}
+
+/**
+ * @return the bytes of the buffers allocated by fluid_mixer_buffers_init() and of the
+ * list of finished voices
+ */
+static size_t
+fluid_mixer_buffers_get_size(const fluid_mixer_buffers_t *buffers, int polyphony_capacity)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    int bufs = 1 + FLUID_RVOICE_BATCH_MAX + 2 * buffers->buf_count + buffers->fx_buf_count;
+
+    if(buffers->fx_right_buf != NULL)
+    {
+        bufs += buffers->fx_buf_count;
+    }
+
+    return (size_t)bufs * samplecount * sizeof(fluid_real_t)
+           + 4 * (buffers->buf_count + buffers->fx_buf_count) * sizeof(int)
+           + polyphony_capacity * sizeof(fluid_rvoice_t *);
+}
+
+/**
+ * Add the bytes of the mixer to \p bytes, indexed by #fluid_synth_memory: the ones of its
+ * buffers, of the buffers of its threads, of the list of its voices and of its fx units.
+ * Called with the API of the synth locked, so that the fx units aren't replaced meanwhile.
+ */
+void fluid_rvoice_mixer_get_memory(fluid_rvoice_mixer_t *mixer, size_t *bytes)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    fluid_mixer_upsampler_t *upsampler = mixer->upsampler;
+    int i;
+
+    bytes[FLUID_SYNTH_MEMORY_VOICES] += mixer->polyphony_capacity * sizeof(fluid_rvoice_t *);
+    bytes[FLUID_SYNTH_MEMORY_MIXER] += sizeof(*mixer)
+                                       + fluid_mixer_buffers_get_size(&mixer->buffers, mixer->polyphony_capacity);
+
+    if(mixer->note_cache != NULL)
+    {
+        bytes[FLUID_SYNTH_MEMORY_MIXER] += fluid_note_cache_get_size(mixer->note_cache);
+    }
+
+    if(upsampler != NULL)
+    {
+        bytes[FLUID_SYNTH_MEMORY_MIXER] += sizeof(*upsampler)
+                                           + (upsampler->num * FLUID_MIXER_UPSAMPLER_TAPS
+                                              + upsampler->channels * (upsampler->in_size + samplecount)) * sizeof(fluid_real_t)
+                                           + upsampler->channels * sizeof(int);
+    }
+
+#if ENABLE_MIXER_THREADS
+
+    for(i = 0; i < mixer->thread_count; i++)
+    {
+        bytes[FLUID_SYNTH_MEMORY_MIXER_THREADS] += sizeof(mixer->threads[i])
+                + fluid_mixer_buffers_get_size(&mixer->threads[i], mixer->polyphony_capacity);
+    }
+
+#endif
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].reverb != NULL)
+        {
+            bytes[FLUID_SYNTH_MEMORY_REVERB] += fluid_revmodel_get_size(mixer->fx[i].reverb);
+        }
+
+        if(mixer->fx[i].conv != NULL)
+        {
+            bytes[FLUID_SYNTH_MEMORY_REVERB] += fluid_convolver_get_size(mixer->fx[i].conv);
+        }
+
+        if(mixer->fx[i].chorus != NULL)
+        {
+            bytes[FLUID_SYNTH_MEMORY_CHORUS] += fluid_chorus_get_size(mixer->fx[i].chorus);
+        }
+    }
+
+#ifdef LADSPA
+
+    if(mixer->ladspa_fx != NULL)
+    {
+        bytes[FLUID_SYNTH_MEMORY_LADSPA] += fluid_ladspa_get_size(mixer->ladspa_fx);
+    }
+
+#endif
+}
+
+/* Forget the recorded notes, before the samples they have been recorded from can be freed */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_clear_note_cache)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+
+    if(mixer->note_cache != NULL)
+    {
+        fluid_note_cache_clear(mixer->note_cache);
+    }
+}
+
+/**
+ * Let the idle mixer threads spin instead of going to sleep.
+ * @param msec Milliseconds the threads keep spinning after they last had work,
+ *   0 to let them sleep right away
+ */
+void fluid_rvoice_mixer_set_spin_time(fluid_rvoice_mixer_t *mixer, int msec)
+{
+#if ENABLE_MIXER_THREADS
+    mixer->spin_time = msec * 1000.0;
+#endif
+}
+
+/**
+ * Let all threads rendering the mixer flush denormal numbers to zero. The
+ * thread calling fluid_rvoice_mixer_render() does so for the duration of the
+ * call only, the extra mixer threads as of their next block.
+ * @return FLUID_OK, FLUID_FAILED if not supported on this platform
+ */
+int fluid_rvoice_mixer_set_flush_denormals(fluid_rvoice_mixer_t *mixer, int enable)
+{
+    unsigned int state;
+
+    if(enable)
+    {
+        /* check for support, without changing the mode of the calling thread */
+        if(fluid_thread_self_flush_denormals(TRUE, &state) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        fluid_thread_self_restore_denormals(state);
+    }
+
+    mixer->flush_denormals = enable;
+    return FLUID_OK;
+}
+
+/**
+ * Start measuring the peak and RMS levels of the output and effects buffers,
+ * while they are still in the cache after the rendering. Must be called before
+ * the mixer renders.
+ */
+int fluid_rvoice_mixer_enable_meters(fluid_rvoice_mixer_t *mixer)
+{
+    int count = 2 * (mixer->buffers.buf_count + mixer->buffers.fx_buf_count);
+
+    if(mixer->meters == NULL)
+    {
+        mixer->meters = FLUID_ARRAY(fluid_mixer_meter_t, count);
+
+        if(mixer->meters == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(mixer->meters, 0, count * sizeof(*mixer->meters));
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Get the levels of a buffer measured since the last call for the buffer. May be called
+ * from any thread, but only from one at a time for each buffer.
+ * @param fx TRUE for an effects buffer, FALSE for an output buffer
+ * @param chan Even for the left and odd for the right buffer of a stereo pair
+ * @param peak Location to store the peak level to
+ * @param rms Location to store the RMS level to
+ * @return #FLUID_OK on success, #FLUID_FAILED if the meters aren't enabled or \p chan is invalid
+ */
+int fluid_rvoice_mixer_get_level(fluid_rvoice_mixer_t *mixer, int fx, int chan, float *peak, float *rms)
+{
+    fluid_mixer_buffers_t *buffers = &mixer->buffers;
+    fluid_mixer_meter_t *meter;
+    int index;
+
+    if(mixer->meters == NULL || chan < 0 || chan >= 2 * (fx ? buffers->fx_buf_count : buffers->buf_count))
+    {
+        return FLUID_FAILED;
+    }
+
+    if(fx)
+    {
+        index = (chan % 2 == 0) ? DIRTY_FX_LEFT(buffers, chan / 2) : DIRTY_FX_RIGHT(buffers, chan / 2);
+    }
+    else
+    {
+        index = (chan % 2 == 0) ? DIRTY_LEFT(buffers, chan / 2) : DIRTY_RIGHT(buffers, chan / 2);
+    }
+
+    meter = &mixer->meters[index];
+    *peak = fluid_atomic_float_get(&meter->level_peak);
+    *rms = fluid_atomic_float_get(&meter->level_rms);
+    fluid_atomic_int_set(&meter->reset, TRUE);
+
+    return FLUID_OK;
+}
+
+/**
+ * Start publishing the voices rendered after each rendering, at most as many as
+ * the voices reserved by fluid_rvoice_mixer_reserve_polyphony() up to now. Must be
+ * called before the mixer renders.
+ */
+int fluid_rvoice_mixer_enable_snapshot(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_mixer_snapshot_t *snapshot;
+    int size = mixer->polyphony_capacity;
+
+    if(mixer->snapshot != NULL)
+    {
+        return FLUID_OK;
+    }
+
+    snapshot = FLUID_NEW(fluid_mixer_snapshot_t);
+
+    if(snapshot == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(snapshot, 0, sizeof(*snapshot));
+    snapshot->size = size;
+    snapshot->voices[0] = FLUID_ARRAY(fluid_voice_snapshot_t, size);
+    snapshot->voices[1] = FLUID_ARRAY(fluid_voice_snapshot_t, size);
+
+    if(snapshot->voices[0] == NULL || snapshot->voices[1] == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(snapshot->voices[0]);
+        FLUID_FREE(snapshot->voices[1]);
+        FLUID_FREE(snapshot);
+        return FLUID_FAILED;
+    }
+
+    mixer->snapshot = snapshot;
+    return FLUID_OK;
+}
+
+/**
+ * Copy the voices published after the latest rendering. May be called from any thread,
+ * a sequence lock on the two arrays of the snapshot keeps it from ever waiting for the
+ * rendering thread: the voices copied are discarded and copied again if they have been
+ * overwritten in the meantime.
+ * @param voices Array to store the voices to
+ * @param size Length of \p voices
+ * @return Count of the voices stored, #FLUID_FAILED if the snapshot isn't enabled or if
+ *   the voices have been overwritten each time they were copied
+ */
+int fluid_rvoice_mixer_get_snapshot(fluid_rvoice_mixer_t *mixer, fluid_voice_snapshot_t *voices, int size)
+{
+    fluid_mixer_snapshot_t *snapshot = mixer->snapshot;
+    int i, seq, count;
+
+    if(snapshot == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < 16; i++)
+    {
+        seq = fluid_atomic_int_get(&snapshot->seq);
+        count = snapshot->count[seq % 2];
+        count = (count < size) ? count : size;
+        FLUID_MEMCPY(voices, snapshot->voices[seq % 2], count * sizeof(*voices));
+
+        /* the rendering thread has only written to the other array */
+        if(fluid_atomic_int_get(&snapshot->seq) == seq)
+        {
+            return count;
+        }
+    }
+
+    return FLUID_FAILED;
+}
+
+/* Write the voices rendered to the array not read by the readers, then hand it over */
+static void
+fluid_rvoice_mixer_publish_snapshot(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_mixer_snapshot_t *snapshot = mixer->snapshot;
+    /* wraps around before overflowing, keeping the arrays alternating */
+    int seq = (fluid_atomic_int_get(&snapshot->seq) + 1) & 0x3fffffff;
+    fluid_voice_snapshot_t *voices = snapshot->voices[seq % 2];
+    int i, count = (mixer->active_voices < snapshot->size) ? mixer->active_voices : snapshot->size;
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_rvoice_t *rvoice = mixer->rvoices[i];
+
+        voices[i].chan = rvoice->chan;
+        voices[i].key = rvoice->key;
+        voices[i].vel = rvoice->vel;
+        /* the sections are in the order of enum fluid_voice_envelope_stage */
+        voices[i].stage = fluid_adsr_env_get_section(&rvoice->envlfo.volenv);
+        voices[i].id = rvoice->id;
+    }
+
+    snapshot->count[seq % 2] = count;
+    fluid_atomic_int_set(&snapshot->seq, seq);
+}
+
+/**
+ * Render the blocks at a lower rate than the output. The blocks rendered are upsampled to
+ * \p num / \p den times their rate by fluid_rvoice_mixer_upsample(), whose buffers are returned by
+ * fluid_rvoice_mixer_get_bufs() and fluid_rvoice_mixer_get_fx_bufs() instead of the rendered ones.
+ * @param num Output samples per \p den rendered samples, larger than \p den, 1 to turn upsampling off
+ * @param den Rendered samples per \p num output samples
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory
+ */
+int fluid_rvoice_mixer_set_upsampling(fluid_rvoice_mixer_t *mixer, int num, int den)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    fluid_mixer_upsampler_t *upsampler;
+
+    delete_fluid_mixer_upsampler(mixer->upsampler);
+    mixer->upsampler = NULL;
+
+    if(num <= den)
+    {
+        return FLUID_OK;
+    }
+
+    upsampler = FLUID_NEW(fluid_mixer_upsampler_t);
+
+    if(upsampler == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(upsampler, 0, sizeof(*upsampler));
+    upsampler->num = num;
+    upsampler->den = den;
+    upsampler->channels = 2 * (mixer->buffers.buf_count + mixer->buffers.fx_buf_count);
+
+    /* the samples still needed, the ones left over from the previous call and the blocks rendered */
+    upsampler->in_size = FLUID_MIXER_UPSAMPLER_TAPS + 2 * FLUID_BUFSIZE + samplecount;
+    upsampler->coefs = FLUID_ARRAY(fluid_real_t, num * FLUID_MIXER_UPSAMPLER_TAPS);
+    upsampler->in = FLUID_ARRAY(fluid_real_t, upsampler->channels * upsampler->in_size);
+    upsampler->silent = FLUID_ARRAY(int, upsampler->channels);
+    upsampler->out = FLUID_ARRAY_ALIGNED(fluid_real_t, upsampler->channels * samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    if(upsampler->coefs == NULL || upsampler->in == NULL || upsampler->silent == NULL || upsampler->out == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_mixer_upsampler(upsampler);
+        return FLUID_FAILED;
+    }
+
+    fluid_mixer_upsampler_design(upsampler);
+    fluid_mixer_upsampler_clear(upsampler);
+
+    mixer->upsampler = upsampler;
+    return FLUID_OK;
+}
+
+/**
+ * Get the count of the blocks to render before \p blockcount blocks can be upsampled.
+ * @return Count of the blocks, 0 if the samples left over from the previous blocks are enough
+ */
+int fluid_rvoice_mixer_get_upsampling_blocks(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    fluid_mixer_upsampler_t *upsampler = mixer->upsampler;
+    int last, missing;
+
+    if(upsampler == NULL)
+    {
+        return blockcount;
+    }
+
+    /* the latest input sample of the last output sample */
+    last = upsampler->next
+           + (upsampler->phase + (blockcount * FLUID_BUFSIZE - 1) * upsampler->den) / upsampler->num;
+    missing = last + 1 - upsampler->in_frames;
+
+    return (missing > 0) ? (missing + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE : 0;
+}
+
+/**
+ * Upsample the blocks rendered to the output buffers, as many whole blocks as the rendered
+ * blocks are enough for. The rendered samples not used up are kept for the next call.
+ * @param blockcount Maximum number of blocks to output
+ * @return Number of blocks output
+ */
+int fluid_rvoice_mixer_upsample(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    fluid_mixer_upsampler_t *upsampler = mixer->upsampler;
+    int num = upsampler->num, den = upsampler->den;
+    int count, shift, total, i, k, ch;
+
+    /* the count of output samples whose input samples have all been rendered */
+    count = (upsampler->in_frames > upsampler->next)
+            ? ((upsampler->in_frames - upsampler->next) * num - 1 - upsampler->phase) / den + 1 : 0;
+    count /= FLUID_BUFSIZE;
+    blockcount = (count < blockcount) ? count : blockcount;
+    count = blockcount * FLUID_BUFSIZE;
+
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    for(ch = 0; ch < upsampler->channels; ch++)
+    {
+        const fluid_real_t *FLUID_RESTRICT in = &upsampler->in[ch * upsampler->in_size];
+        fluid_real_t *FLUID_RESTRICT out = fluid_mixer_upsampler_get_out_buf(upsampler, mixer->buffers.buf_count, ch);
+        int next = upsampler->next, phase = upsampler->phase;
+
+        if(upsampler->silent[ch] >= upsampler->in_frames)
+        {
+            /* every input sample is zero */
+            FLUID_MEMSET(out, 0, count * sizeof(fluid_real_t));
+            continue;
+        }
+
+        for(i = 0; i < count; i++)
+        {
+            const fluid_real_t *FLUID_RESTRICT coefs = &upsampler->coefs[phase * FLUID_MIXER_UPSAMPLER_TAPS];
+            const fluid_real_t *FLUID_RESTRICT x = &in[next];
+            fluid_real_t y = 0;
+
+            for(k = 0; k < FLUID_MIXER_UPSAMPLER_TAPS; k++)
+            {
+                y += coefs[k] * x[-k];
+            }
+
+            out[i] = y;
+            phase += den;
+
+            if(phase >= num)
+            {
+                phase -= num;
+                next++;
+            }
+        }
+    }
+
+    total = upsampler->phase + count * den;
+    upsampler->next += total / num;
+    upsampler->phase = total % num;
+
+    /* drop the input samples no longer needed */
+    shift = upsampler->next - (FLUID_MIXER_UPSAMPLER_TAPS - 1);
+
+    if(shift > 0)
+    {
+        upsampler->in_frames -= shift;
+        upsampler->next -= shift;
+
+        for(ch = 0; ch < upsampler->channels; ch++)
+        {
+            fluid_real_t *in = &upsampler->in[ch * upsampler->in_size];
+
+            FLUID_MEMMOVE(in, in + shift, upsampler->in_frames * sizeof(fluid_real_t));
+
+            if(upsampler->silent[ch] > upsampler->in_frames)
+            {
+                upsampler->silent[ch] = upsampler->in_frames;
+            }
+        }
+    }
+
+    return blockcount;
+}
+
+/* Add the samples of a buffer to the peak and the sum of squares */
+static void
+fluid_mixer_meter_measure(const fluid_real_t *FLUID_RESTRICT buf, int count, fluid_real_t *peak, double *sum)
+{
+    fluid_real_t p = *peak, s = 0;
+    int i;
+
+    #pragma omp simd reduction(max:p) reduction(+:s)
+    for(i = 0; i < count; i++)
+    {
+        fluid_real_t x = FLUID_FABS(buf[i]);
+
+        p = (x > p) ? x : p;
+        s += buf[i] * buf[i];
+    }
+
+    *peak = p;
+    *sum += s;
+}
+
+/* Measure the buffers rendered, only the blocks written to can be other than silent */
+static void
+fluid_rvoice_mixer_update_meters(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    fluid_mixer_buffers_t *buffers = &mixer->buffers;
+    int i, count = 2 * (buffers->buf_count + buffers->fx_buf_count);
+    double rms;
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_mixer_meter_t *meter = &mixer->meters[i];
+        int blocks = (buffers->dirty[i] < blockcount) ? buffers->dirty[i] : blockcount;
+
+        if(fluid_atomic_int_get(&meter->reset))
+        {
+            fluid_atomic_int_set(&meter->reset, FALSE);
+            meter->peak = 0;
+            meter->sum = 0;
+            meter->count = 0;
+        }
+
+        if(blocks > 0)
+        {
+            fluid_mixer_meter_measure(fluid_mixer_buffers_get_dirty_buf(buffers, i),
+                                      blocks * FLUID_BUFSIZE, &meter->peak, &meter->sum);
+        }
+
+        meter->count += blockcount * FLUID_BUFSIZE;
+        rms = sqrt(meter->sum / meter->count);
+
+        fluid_atomic_float_set(&meter->level_peak, (float)meter->peak);
+        fluid_atomic_float_set(&meter->level_rms, (float)rms);
+    }
+}
+
+/**
+ * Pin the rendering threads to CPU cores.
+ * @param cores CPU cores, the first one for the thread calling fluid_rvoice_mixer_render(),
+ *   the next ones for the extra mixer threads, or -1 to leave a thread unpinned
+ * @param count Number of cores given, threads beyond them are not pinned
+ * @return #FLUID_OK on success, #FLUID_FAILED if the mixer threads couldn't be restarted
+ *
+ * The extra mixer threads are restarted, so that they allocate their buffers
+ * once pinned.
+ */
+int fluid_rvoice_mixer_set_affinity(fluid_rvoice_mixer_t *mixer, const int *cores, int count)
+{
+    mixer->render_core = (count > 0) ? cores[0] : -1;
+    mixer->render_thread = FLUID_THREAD_ID_NULL;
+
+#if ENABLE_MIXER_THREADS
+    FLUID_FREE(mixer->thread_cores);
+    mixer->thread_cores = NULL;
+
+    // the workers of a render pool are shared with other mixers
+    if(count > 1 && mixer->thread_count > 0 && mixer->pool == NULL)
+    {
+        int i;
+
+        mixer->thread_cores = FLUID_ARRAY(int, mixer->thread_count);
+
+        if(mixer->thread_cores == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        for(i = 0; i < mixer->thread_count; i++)
+        {
+            mixer->thread_cores[i] = (i + 1 < count) ? cores[i + 1] : -1;
+        }
+
+        return fluid_rvoice_mixer_set_threads(mixer, mixer->thread_count, mixer->thread_prio);
+    }
+
+#endif
+    return FLUID_OK;
+}
+
+/**
+ * Let the extra mixer threads join the audio workgroup of a device.
+ * @param workgroup os_workgroup_t of the device, or NULL to leave it
+ * @return #FLUID_OK on success, #FLUID_FAILED if the mixer threads couldn't be restarted
+ *
+ * The extra mixer threads are restarted, so that they join the workgroup
+ * when they start and leave it when they exit. The workgroup must outlive
+ * them, i.e. be replaced by NULL before it is released.
+ */
+int fluid_rvoice_mixer_set_workgroup(fluid_rvoice_mixer_t *mixer, void *workgroup)
+{
+#if ENABLE_MIXER_THREADS
+
+    if(workgroup == mixer->workgroup)
+    {
+        return FLUID_OK;
+    }
+
+    if(mixer->thread_count > 0 && mixer->pool == NULL)
+    {
+        int thread_count = mixer->thread_count;
+
+        /* the running threads leave the previous workgroup */
+        delete_rvoice_mixer_threads(mixer);
+        mixer->workgroup = workgroup;
+        return fluid_rvoice_mixer_set_threads(mixer, thread_count, mixer->thread_prio);
+    }
+
+    mixer->workgroup = workgroup;
+#endif
+    return FLUID_OK;
+}
+
+/**
+ * Let the extra mixer threads be created by a thread factory, e.g. the one of an audio server.
+ * @param factory Creates and joins the threads, copied, or NULL for new_fluid_thread()
+ * @return #FLUID_OK on success, #FLUID_FAILED if the mixer threads couldn't be restarted
+ *
+ * The extra mixer threads are restarted through the factory, and joined by it
+ * when replaced by NULL again, which must happen before the factory is gone.
+ * The workers of a render pool are left alone, they are shared with other mixers.
+ */
+int fluid_rvoice_mixer_set_thread_factory(fluid_rvoice_mixer_t *mixer, const fluid_thread_factory_t *factory)
+{
+#if ENABLE_MIXER_THREADS
+    int thread_count = mixer->thread_count;
+
+    if(factory == NULL && mixer->thread_factory.create == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    /* the running threads are joined by the factory that created them */
+    if(thread_count > 0 && mixer->pool == NULL)
+    {
+        delete_rvoice_mixer_threads(mixer);
+    }
+
+    if(factory != NULL)
+    {
+        mixer->thread_factory = *factory;
+    }
+    else
+    {
+        FLUID_MEMSET(&mixer->thread_factory, 0, sizeof(mixer->thread_factory));
+    }
+
+    if(thread_count > 0 && mixer->pool == NULL)
+    {
+        return fluid_rvoice_mixer_set_threads(mixer, thread_count, mixer->thread_prio);
+    }
+
+#endif
+    return FLUID_OK;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int set = param[0].i;
+    int nr = param[1].i;
+    fluid_real_t level = param[2].real;
+    fluid_real_t speed = param[3].real;
+    fluid_real_t depth_ms = param[4].real;
+    int type = param[5].i;
+
+    int i;
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].chorus != NULL)
+        {
+            fluid_chorus_set(mixer->fx[i].chorus, set, nr, level, speed, depth_ms, type);
+        }
+    }
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_params)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int set = param[0].i;
+    fluid_real_t roomsize = param[1].real;
+    fluid_real_t damping = param[2].real;
+    fluid_real_t width = param[3].real;
+    fluid_real_t level = param[4].real;
+
+    int i;
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].reverb != NULL)
+        {
+            fluid_revmodel_set(mixer->fx[i].reverb, set, roomsize, damping, width, level);
+        }
+
+        if((set & FLUID_REVMODEL_SET_LEVEL) && mixer->fx[i].conv != NULL)
+        {
+            fluid_convolver_set_level(mixer->fx[i].conv, level);
+        }
+    }
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_reverb)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i;
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].reverb != NULL)
+        {
+            fluid_revmodel_reset(mixer->fx[i].reverb);
+        }
+
+        if(mixer->fx[i].conv != NULL)
+        {
+            fluid_convolver_reset(mixer->fx[i].conv);
+        }
+    }
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_upsampling)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+
+    if(mixer->upsampler != NULL)
+    {
+        fluid_mixer_upsampler_clear(mixer->upsampler);
+    }
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i;
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].chorus != NULL)
+        {
+            fluid_chorus_reset(mixer->fx[i].chorus);
+        }
+    }
+}
+
+int fluid_rvoice_mixer_get_bufs(fluid_rvoice_mixer_t *mixer,
+                                fluid_real_t **left, fluid_real_t **right)
+{
+    if(mixer->upsampler != NULL)
+    {
+        *left = fluid_mixer_upsampler_get_out_buf(mixer->upsampler, mixer->buffers.buf_count, DIRTY_LEFT(&mixer->buffers, 0));
+        *right = fluid_mixer_upsampler_get_out_buf(mixer->upsampler, mixer->buffers.buf_count, DIRTY_RIGHT(&mixer->buffers, 0));
+        return mixer->buffers.buf_count;
+    }
+
+    *left = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
+    *right = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
+    return mixer->buffers.buf_count;
+}
+
+/**
+ * Render the first stereo channel of the next fluid_rvoice_mixer_render() call straight
+ * into the buffers of the caller, instead of into the ones of fluid_rvoice_mixer_get_bufs().
+ * Must be called by the rendering thread, right before the rendering.
+ * @param left, right Buffers of at least the count of blocks rendered, aligned to
+ *   FLUID_DEFAULT_ALIGNMENT
+ *
+ * The buffers are only rendered to if the mixer doesn't have to read them afterwards,
+ * which it does when upsampling or running LADSPA effects. Whether they have been is told
+ * by fluid_rvoice_mixer_is_output_used(), the samples are in the own buffers otherwise.
+ */
+void fluid_rvoice_mixer_set_output(fluid_rvoice_mixer_t *mixer, fluid_real_t *left, fluid_real_t *right)
+{
+    fluid_mixer_buffers_t *buffers = &mixer->buffers;
+
+    if(mixer->upsampler != NULL
+            || (uintptr_t)left % FLUID_DEFAULT_ALIGNMENT != 0
+            || (uintptr_t)right % FLUID_DEFAULT_ALIGNMENT != 0)
+    {
+        buffers->out_left = NULL;
+        buffers->out_right = NULL;
+        return;
+    }
+
+    // leave the own buffers clean for the renderings they are used by again
+    if(buffers->out_left == NULL)
+    {
+        fluid_mixer_buffers_clear_dirty(buffers, fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT),
+                                        DIRTY_LEFT(buffers, 0));
+        fluid_mixer_buffers_clear_dirty(buffers, fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT),
+                                        DIRTY_RIGHT(buffers, 0));
+    }
+
+    buffers->out_left = left;
+    buffers->out_right = right;
+}
+
+/**
+ * @return TRUE if the last fluid_rvoice_mixer_render() call has rendered the first stereo
+ * channel to the buffers of fluid_rvoice_mixer_set_output()
+ */
+int fluid_rvoice_mixer_is_output_used(fluid_rvoice_mixer_t *mixer)
+{
+    return mixer->output_used;
+}
+
+int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
+                                   fluid_real_t **fx_left, fluid_real_t **fx_right)
+{
+    if(mixer->upsampler != NULL)
+    {
+        *fx_left = fluid_mixer_upsampler_get_out_buf(mixer->upsampler, mixer->buffers.buf_count, DIRTY_FX_LEFT(&mixer->buffers, 0));
+        *fx_right = fluid_mixer_upsampler_get_out_buf(mixer->upsampler, mixer->buffers.buf_count, DIRTY_FX_RIGHT(&mixer->buffers, 0));
+        return mixer->buffers.fx_buf_count;
+    }
+
+    *fx_left = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    *fx_right = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+    return mixer->buffers.fx_buf_count;
+}
+
+int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer)
+{
+    return FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+}
+
+int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer)
+{
+    return mixer->active_voices;
+}
+
+/**
+ * Get the time the rendering thread spent waiting for the mixer threads
+ * since the last call. Must be called from the rendering thread only.
+ * @return Waiting time in microseconds
+ */
+double fluid_rvoice_mixer_take_wait_time(fluid_rvoice_mixer_t *mixer)
+{
+#if ENABLE_MIXER_THREADS
+    double wait_time = mixer->wait_time;
+    mixer->wait_time = 0;
+    return wait_time;
+#else
+    return 0;
+#endif
+}
+
+#if ENABLE_MIXER_THREADS
+
+#define WS_DEQUE_PACK(head, tail) ((int)(((unsigned int)(head) << 16) | (unsigned int)(tail)))
+#define WS_DEQUE_HEAD(deque) ((unsigned int)(deque) >> 16)
+#define WS_DEQUE_TAIL(deque) ((unsigned int)(deque) & 0xFFFF)
+
+/* Rough estimate of the relative cost of rendering a voice */
+static FLUID_INLINE int
+fluid_mixer_voice_cost(const fluid_rvoice_t *rvoice)
+{
+    int cost;
+
+    switch(rvoice->dsp.interp_method)
+    {
+    case FLUID_INTERP_NONE:
+        cost = 1;
+        break;
+
+    case FLUID_INTERP_LINEAR:
+        cost = 2;
+        break;
+
+    case FLUID_INTERP_4THORDER:
+        cost = 3;
+        break;
+
+    default:
+        cost = 5;
+        break;
+    }
+
+    if(rvoice->resonant_filter.type != FLUID_IIR_DISABLED)
+    {
+        cost++;
+    }
+
+    if(rvoice->resonant_custom_filter.type != FLUID_IIR_DISABLED)
+    {
+        cost++;
+    }
+
+    return cost;
+}
+
+/**
+ * Split the active voices into chunks of similar cost and hand out an equal
+ * number of chunks to each worker's deque. Must only be called while no
+ * thread is rendering.
+ */
+static void
+fluid_mixer_ws_prepare(fluid_rvoice_mixer_t *mixer, int workers)
+{
+    int i, total_cost = 0, chunk_cost, chunk_target, chunk_count = 0;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        total_cost += fluid_mixer_voice_cost(mixer->rvoices[i]);
+    }
+
+    chunk_target = total_cost / (workers * WS_CHUNKS_PER_WORKER);
+
+    if(chunk_target < 1)
+    {
+        chunk_target = 1;
+    }
+
+    chunk_cost = 0;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        if(chunk_cost == 0)
+        {
+            mixer->ws_chunks[chunk_count++] = i;
+        }
+
+        chunk_cost += fluid_mixer_voice_cost(mixer->rvoices[i]);
+
+        if(chunk_cost >= chunk_target)
+        {
+            chunk_cost = 0;
+        }
+    }
+
+    mixer->ws_chunks[chunk_count] = mixer->active_voices;
+
+    for(i = 0; i < workers; i++)
+    {
+        fluid_atomic_int_set(&mixer->ws_deques[i],
+                             WS_DEQUE_PACK(i * chunk_count / workers, (i + 1) * chunk_count / workers));
+    }
+
+    mixer->ws_workers = workers;
+}
+
+/**
+ * Pop a chunk from a worker's deque, from the head if \c steal is FALSE, else from the tail.
+ * @return the chunk index or -1 if the deque is empty
+ */
+static FLUID_INLINE int
+fluid_mixer_ws_pop(fluid_atomic_int_t *deque, int steal)
+{
+    int old, new_deque;
+    unsigned int head, tail;
+
+    do
+    {
+        old = fluid_atomic_int_get(deque);
+        head = WS_DEQUE_HEAD(old);
+        tail = WS_DEQUE_TAIL(old);
+
+        if(head >= tail)
+        {
+            return -1;
+        }
+
+        new_deque = steal ? WS_DEQUE_PACK(head, tail - 1) : WS_DEQUE_PACK(head + 1, tail);
+    }
+    while(!fluid_atomic_int_compare_and_exchange(deque, old, new_deque));
+
+    return steal ? (int)tail - 1 : (int)head;
+}
+
+/**
+ * Get the next range of voices to render.
+ * @param worker index of the calling worker (0 = main thread)
+ * @param end location to store the index following the last voice of the range
+ * @return the index of the first voice of the range or -1 if there are no voices left
+ */
+static FLUID_INLINE int
+fluid_mixer_get_mt_rvoices(fluid_rvoice_mixer_t *mixer, int worker, int *end)
+{
+    int i;
+
+    if(mixer->scheduler != FLUID_MIXER_SCHEDULER_SHARED)
+    {
+        int chunk = fluid_mixer_ws_pop(&mixer->ws_deques[worker], FALSE);
+
+        // own deque is empty, try to steal from the others, unless the voices of each worker are fixed
+        for(i = 1; chunk < 0 && mixer->scheduler == FLUID_MIXER_SCHEDULER_WORK_STEALING && i < mixer->ws_workers; i++)
+        {
+            chunk = fluid_mixer_ws_pop(&mixer->ws_deques[(worker + i) % mixer->ws_workers], TRUE);
+        }
+
+        if(chunk < 0)
+        {
+            return -1;
+        }
+
+        *end = mixer->ws_chunks[chunk + 1];
+        return mixer->ws_chunks[chunk];
+    }
+
+    i = fluid_atomic_int_exchange_and_add(&mixer->current_rvoice, 1);
+
+    if(i >= mixer->active_voices)
+    {
+        return -1;
+    }
+
+    *end = i + 1;
+    return i;
+}
+
+#define THREAD_BUF_PROCESSING 0
+#define THREAD_BUF_VALID 1
+#define THREAD_BUF_NODATA 2
+#define THREAD_BUF_TERMINATE 3
+#define THREAD_BUF_FX 4
+#define THREAD_BUF_STARTING 5
+#define THREAD_BUF_QUEUED 6     /* voices to render, waiting for a worker of the render pool */
+#define THREAD_BUF_QUEUED_FX 7  /* fx jobs to process, waiting for a worker of the render pool */
+
+static void fluid_render_pool_wakeup(fluid_render_pool_t *pool);
+
+static FLUID_INLINE int
+fluid_mixer_thread_has_work(fluid_mixer_buffers_t *buffers)
+{
+    int j = fluid_atomic_int_get(&buffers->ready);
+
+    return (j == THREAD_BUF_PROCESSING || j == THREAD_BUF_TERMINATE || j == THREAD_BUF_FX);
+}
+
+/**
+ * Busy wait for new work, backing off with more and more pause instructions
+ * between the checks, until mixer->spin_time has elapsed since \c last_work.
+ * @return TRUE if there is new work, FALSE if the thread should go to sleep
+ */
+static int
+fluid_mixer_thread_spin(fluid_mixer_buffers_t *buffers, double last_work)
+{
+    int pauses = 1;
+    int i;
+
+    while(!fluid_mixer_thread_has_work(buffers))
+    {
+        for(i = 0; i < pauses; i++)
+        {
+            fluid_cpu_relax();
+        }
+
+        if(pauses < SPIN_MAX_PAUSES)
+        {
+            pauses *= 2;
+        }
+        else if(fluid_utime() - last_work > buffers->mixer->spin_time)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Thread loop (processes voices in parallel to primary synthesis thread) */
+static void
+fluid_mixer_thread_run(fluid_mixer_buffers_t *buffers)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    int hasValidData = 0;
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
+    int bufcount = 0;
+    int current_blockcount = 0;
+    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    double last_work = fluid_utime();
+
+    fluid_rt_enter();
+
+    while(!fluid_atomic_int_get(&mixer->threads_should_terminate))
+    {
+        int end, start;
+
+        if(buffers->flush_denormals != mixer->flush_denormals)
+        {
+            buffers->flush_denormals = mixer->flush_denormals;
+            fluid_thread_self_flush_denormals(buffers->flush_denormals, NULL);
+        }
+
+        if(fluid_atomic_int_get(&buffers->ready) == THREAD_BUF_FX)
+        {
+            // voices are mixed, help processing the fx units, then signal as having no data
+            fluid_rvoice_mixer_process_fx_jobs(mixer);
+            start = -1;
+        }
+        else
+        {
+            start = fluid_mixer_get_mt_rvoices(mixer, buffers->worker, &end);
+        }
+
+        if(start < 0)
+        {
+            int spin = (mixer->scheduler == FLUID_MIXER_SCHEDULER_WORK_STEALING) ? WS_SPIN_COUNT : 0;
+
+            // if no voices: signal rendered buffers, sleep
+            fluid_atomic_int_set(&buffers->ready, hasValidData ? THREAD_BUF_VALID : THREAD_BUF_NODATA);
+            fluid_cond_mutex_lock(mixer->thread_ready_m);
+            fluid_cond_signal(mixer->thread_ready);
+            fluid_cond_mutex_unlock(mixer->thread_ready_m);
+
+            // spin for a while before going to sleep, the next block may follow shortly
+            if(mixer->spin_time > 0)
+            {
+                spin = fluid_mixer_thread_spin(buffers, last_work);
+            }
+            else
+            {
+                for(; spin > 0; spin--)
+                {
+                    if(fluid_mixer_thread_has_work(buffers))
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if(spin == 0)
+            {
+                fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+                fluid_atomic_int_inc(&mixer->parked_threads);
+
+                while(!fluid_mixer_thread_has_work(buffers))
+                {
+                    fluid_cond_wait(mixer->wakeup_threads, mixer->wakeup_threads_m);
+                }
+
+                fluid_atomic_int_add(&mixer->parked_threads, -1);
+                fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+            }
+
+            if(mixer->spin_time > 0)
+            {
+                last_work = fluid_utime();
+            }
+
+            hasValidData = 0;
+        }
+        else
+        {
+            // else: if buffer is not zeroed, zero buffers
+            if(!hasValidData)
+            {
+                // blockcount may have changed, since thread was put to sleep
+                current_blockcount = mixer->current_blockcount;
+                fluid_mixer_buffers_zero(buffers);
+                bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
+                hasValidData = 1;
+            }
+
+            // then render voices to buffers
+            {
+                fluid_trace_ref_var(trace_ref);
+                fluid_mixer_buffers_render_range(buffers, start, end, bufs, bufcount, local_buf, current_blockcount);
+                fluid_trace("render_range", trace_ref);
+            }
+        }
+    }
+
+    fluid_rt_exit();
+}
+
+/* Core thread function */
+static fluid_thread_return_t
+fluid_mixer_thread_func(void *data)
+{
+    fluid_mixer_buffers_t *buffers = data;
+    int ok;
+
+    /* The thread allocates its own buffers, once pinned, so that they get
+     * placed on the memory of its NUMA node when first touched. */
+    if(buffers->core >= 0)
+    {
+        fluid_thread_self_set_affinity(buffers->core);
+    }
+
+    /* scheduled along with the thread of the audio device */
+    if(buffers->mixer->workgroup != NULL
+            && fluid_thread_self_join_workgroup(buffers->mixer->workgroup, &buffers->workgroup_token) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_WARN, "Mixer thread failed to join the audio workgroup");
+    }
+
+    ok = fluid_mixer_buffers_init(buffers, buffers->mixer);
+
+    fluid_atomic_int_set(&buffers->ready, ok ? THREAD_BUF_NODATA : THREAD_BUF_TERMINATE);
+    fluid_cond_mutex_lock(buffers->mixer->thread_ready_m);
+    fluid_cond_signal(buffers->mixer->thread_ready);
+    fluid_cond_mutex_unlock(buffers->mixer->thread_ready_m);
+
+    if(ok)
+    {
+        fluid_mixer_thread_run(buffers);
+    }
+
+    if(buffers->workgroup_token != NULL)
+    {
+        fluid_thread_self_leave_workgroup(buffers->mixer->workgroup, buffers->workgroup_token);
+        buffers->workgroup_token = NULL;
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Add the buffers of a mixer thread to those of the main thread, only those
+ * the thread has written to and only as far as it has written.
+ */
+static void
+fluid_mixer_buffers_mix(fluid_mixer_buffers_t *dst, fluid_mixer_buffers_t *src, int current_blockcount)
+{
+    int i, j;
+
+    /* the threads share the buffer layout of the main thread */
+    FLUID_ASSERT(src->buf_count == dst->buf_count && src->fx_buf_count == dst->fx_buf_count);
+
+    for(i = 0; i < src->touched_count; i++)
+    {
+        int index = src->touched[i];
+        int blocks = (src->dirty[index] < current_blockcount) ? src->dirty[index] : current_blockcount;
+        int scount = blocks * FLUID_BUFSIZE;
+        const fluid_real_t *FLUID_RESTRICT base_src = fluid_mixer_buffers_get_dirty_buf(src, index);
+        fluid_real_t *FLUID_RESTRICT base_dst = fluid_mixer_buffers_get_dirty_buf(dst, index);
+
+        fluid_mixer_buffers_set_dirty(dst, index, blocks);
+
+        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+        for(j = 0; j < scount; j++)
+        {
+            base_dst[j] += base_src[j];
+        }
+    }
+}
+
+
+/**
+ * Mix the threads in one after another in a fixed order, as soon as the next
+ * one has finished, so that the buffers always add up the same way.
+ * @return TRUE if a thread is still to be mixed in
+ */
+static int
+fluid_mixer_mix_in_order(fluid_rvoice_mixer_t *mixer, int extra_threads, int current_blockcount)
+{
+    for(; mixer->next_mix < extra_threads; mixer->next_mix++)
+    {
+        fluid_mixer_buffers_t *buffers = &mixer->threads[mixer->next_mix];
+        int j = fluid_atomic_int_get(&buffers->ready);
+
+        if(j == THREAD_BUF_VALID)
+        {
+            fluid_atomic_int_set(&buffers->ready, THREAD_BUF_NODATA);
+            fluid_mixer_buffers_mix(&mixer->buffers, buffers, current_blockcount);
+        }
+        else if(j != THREAD_BUF_NODATA)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Go through all threads and see if someone is finished for mixing
+ */
+static int
+fluid_mixer_mix_in(fluid_rvoice_mixer_t *mixer, int extra_threads, int current_blockcount)
+{
+    int i, result, hasmixed;
+
+    if(mixer->scheduler == FLUID_MIXER_SCHEDULER_DETERMINISTIC)
+    {
+        return fluid_mixer_mix_in_order(mixer, extra_threads, current_blockcount);
+    }
+
+    do
+    {
+        hasmixed = 0;
+        result = 0;
+
+        for(i = 0; i < extra_threads; i++)
+        {
+            int j = fluid_atomic_int_get(&mixer->threads[i].ready);
+
+            switch(j)
+            {
+            case THREAD_BUF_PROCESSING:
+            case THREAD_BUF_QUEUED:
+                result = 1;
+                break;
+
+            case THREAD_BUF_VALID:
+                fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_NODATA);
+                fluid_mixer_buffers_mix(&mixer->buffers, &mixer->threads[i], current_blockcount);
+                hasmixed = 1;
+                break;
+            }
+        }
+    }
+    while(hasmixed);
+
+    return result;
+}
+
+/**
+ * Wait for a mixer thread to signal thread_ready, called with thread_ready_m locked.
+ * While the threads are spinning they are polled instead, after a short pause.
+ */
+static void
+fluid_mixer_wait_threads(fluid_rvoice_mixer_t *mixer)
+{
+    double wait = fluid_utime();
+    fluid_trace_ref_var(trace_ref);
+
+    if(mixer->spin_time > 0)
+    {
+        int i;
+
+        fluid_cond_mutex_unlock(mixer->thread_ready_m);
+
+        for(i = 0; i < SPIN_POLL_PAUSES; i++)
+        {
+            fluid_cpu_relax();
+        }
+
+        fluid_cond_mutex_lock(mixer->thread_ready_m);
+    }
+    else
+    {
+        fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
+    }
+
+    fluid_trace("wait_threads", trace_ref);
+    mixer->wait_time += fluid_utime() - wait;
+}
+
+static void fluid_render_pool_run(fluid_mixer_buffers_t *buffers, int fx);
+
+/**
+ * Render the voices of the first thread, whose work no pool worker has claimed
+ * yet, in its buffers.
+ * @return TRUE if there has been one
+ */
+static int
+fluid_mixer_take_over_queued(fluid_rvoice_mixer_t *mixer, int extra_threads)
+{
+    int i;
+
+    for(i = 0; i < extra_threads; i++)
+    {
+        if(fluid_atomic_int_compare_and_exchange(&mixer->threads[i].ready, THREAD_BUF_QUEUED, THREAD_BUF_PROCESSING))
+        {
+            fluid_render_pool_run(&mixer->threads[i], FALSE);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+fluid_render_loop_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+{
+    int i, bufcount;
+    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
+                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
+    // How many threads should we start this time?
+    int extra_threads = mixer->active_voices / VOICES_PER_THREAD;
+
+    if(extra_threads > mixer->thread_count)
+    {
+        extra_threads = mixer->thread_count;
+    }
+
+    if(extra_threads == 0)
+    {
+        // No extra threads? No thread overhead!
+        fluid_render_loop_singlethread(mixer, current_blockcount);
+        return;
+    }
+
+    bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
+
+    // Prepare the deques or the voice list
+    if(mixer->scheduler != FLUID_MIXER_SCHEDULER_SHARED)
+    {
+        fluid_mixer_ws_prepare(mixer, extra_threads + 1);
+        mixer->next_mix = 0;
+    }
+    else
+    {
+        fluid_atomic_int_set(&mixer->current_rvoice, 0);
+    }
+
+    for(i = 0; i < extra_threads; i++)
+    {
+        fluid_atomic_int_set(&mixer->threads[i].ready,
+                             (mixer->pool != NULL) ? THREAD_BUF_QUEUED : THREAD_BUF_PROCESSING);
+    }
+
+    // Signal threads to wake up, only taking the lock if a thread is actually asleep:
+    // a thread about to sleep checks its state again with the lock held
+    if(mixer->pool != NULL)
+    {
+        fluid_render_pool_wakeup(mixer->pool);
+    }
+    else if(fluid_atomic_int_get(&mixer->parked_threads) > 0)
+    {
+        fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+        fluid_cond_broadcast(mixer->wakeup_threads);
+        fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+    }
+
+    // The own voices come first, before any thread is mixed in on top of them
+    if(mixer->scheduler == FLUID_MIXER_SCHEDULER_DETERMINISTIC)
+    {
+        int end, start;
+
+        while((start = fluid_mixer_get_mt_rvoices(mixer, 0, &end)) >= 0)
+        {
+            fluid_mixer_buffers_render_range(&mixer->buffers, start, end, bufs, bufcount, local_buf, current_blockcount);
+        }
+    }
+
+    // If thread is finished, mix it in
+    while(fluid_mixer_mix_in(mixer, extra_threads, current_blockcount))
+    {
+        // Otherwise get voices and render them
+        int end;
+        int start = fluid_mixer_get_mt_rvoices(mixer, 0, &end);
+
+        if(start >= 0)
+        {
+            fluid_profile_ref_var(prof_ref);
+            fluid_mixer_buffers_render_range(&mixer->buffers, start, end, bufs, bufcount, local_buf, current_blockcount);
+            fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, end - start,
+                          current_blockcount * FLUID_BUFSIZE);
+            //test++;
+        }
+        else
+        {
+            // If no voices, wait for mixes. Make sure one is still processing to avoid deadlock
+            int is_processing = 0;
+
+            // the voices of a thread are its own, render them in its buffers rather than waiting for a pool worker
+            if(mixer->scheduler == FLUID_MIXER_SCHEDULER_DETERMINISTIC
+                    && fluid_mixer_take_over_queued(mixer, extra_threads))
+            {
+                continue;
+            }
+
+            //waits++;
+            fluid_cond_mutex_lock(mixer->thread_ready_m);
+
+            for(i = 0; i < extra_threads; i++)
+            {
+                // take back the work no pool worker got around to, rather than waiting for one
+                fluid_atomic_int_compare_and_exchange(&mixer->threads[i].ready, THREAD_BUF_QUEUED, THREAD_BUF_NODATA);
+
+                if(fluid_atomic_int_get(&mixer->threads[i].ready) ==
+                        THREAD_BUF_PROCESSING)
+                {
+                    is_processing = 1;
+                }
+            }
+
+            if(is_processing)
+            {
+                fluid_mixer_wait_threads(mixer);
+            }
+
+            fluid_cond_mutex_unlock(mixer->thread_ready_m);
+        }
+    }
+
+    //FLUID_LOG(FLUID_DBG, "Blockcount: %d, mixed %d of %d voices myself, waits = %d",
+    //	    current_blockcount, test, mixer->active_voices, waits);
+}
+
+/**
+ * Run the mixer->fx_jobs fx jobs on the extra mixer threads and the main thread,
+ * and wait for all of them to be finished.
+ * @param fused TRUE for the main thread to run the first job itself, mixing the
+ * effect straight into the first stereo channel while the threads run the others
+ */
+static void
+fluid_mixer_process_fx_jobs_multithread(fluid_rvoice_mixer_t *mixer, int fused)
+{
+    int i, fx_threads = mixer->fx_jobs - 1;
+
+    if(fx_threads > mixer->thread_count)
+    {
+        fx_threads = mixer->thread_count;
+    }
+
+    fluid_atomic_int_set(&mixer->current_fx, fused ? 1 : 0);
+
+    for(i = 0; i < fx_threads; i++)
+    {
+        fluid_atomic_int_set(&mixer->threads[i].ready,
+                             (mixer->pool != NULL) ? THREAD_BUF_QUEUED_FX : THREAD_BUF_FX);
+    }
+
+    // only take the lock if a thread is actually asleep
+    if(mixer->pool != NULL)
+    {
+        fluid_render_pool_wakeup(mixer->pool);
+    }
+    else if(fluid_atomic_int_get(&mixer->parked_threads) > 0)
+    {
+        fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+        fluid_cond_broadcast(mixer->wakeup_threads);
+        fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+    }
+
+    if(fused)
+    {
+        fluid_rvoice_mixer_process_fx_job(mixer, 0, TRUE);
+    }
+
+    fluid_rvoice_mixer_process_fx_jobs(mixer);
+
+    // wait for the threads to finish their last job
+    fluid_cond_mutex_lock(mixer->thread_ready_m);
+
+    for(i = 0; i < fx_threads; i++)
+    {
+        fluid_atomic_int_compare_and_exchange(&mixer->threads[i].ready, THREAD_BUF_QUEUED_FX, THREAD_BUF_NODATA);
+
+        while(fluid_atomic_int_get(&mixer->threads[i].ready) == THREAD_BUF_FX)
+        {
+            fluid_mixer_wait_threads(mixer);
+        }
+    }
+
+    fluid_cond_mutex_unlock(mixer->thread_ready_m);
+}
+
+#ifdef LADSPA
+/**
+ * Run the LADSPA effects of the current block, the effects of each stage that
+ * has several of them are shared among the extra mixer threads and the main thread.
+ */
+static void
+fluid_render_ladspa_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+{
+    int stage, i, size, num_stages;
+
+    num_stages = fluid_ladspa_run_begin(mixer->ladspa_fx, current_blockcount, FLUID_BUFSIZE);
+
+    if(num_stages == 0)
+    {
+        return;
+    }
+
+    for(stage = 0; stage < num_stages; stage++)
+    {
+        size = fluid_ladspa_get_stage_size(mixer->ladspa_fx, stage);
+
+        if(size > 1)
+        {
+            mixer->ladspa_stage = stage;
+            mixer->ladspa_jobs = TRUE;
+            mixer->fx_jobs = size;
+            fluid_mixer_process_fx_jobs_multithread(mixer, FALSE);
+            mixer->ladspa_jobs = FALSE;
+        }
+        else
+        {
+            for(i = 0; i < size; i++)
+            {
+                fluid_ladspa_run_effect(mixer->ladspa_fx, stage, i);
+            }
+        }
+    }
+
+    fluid_ladspa_run_end(mixer->ladspa_fx);
+}
+#endif
+
+/**
+ * Process the fx units of the current block on the extra mixer threads and the
+ * main thread. Must only be called once all voices have been mixed in.
+ */
+static void
+fluid_render_fx_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+{
+    const int fx_channels_per_unit = mixer->buffers.fx_buf_count / mixer->fx_units;
+    int i, f;
+
+    if(mixer->mix_fx_to_out)
+    {
+        /* the first effect of the first unit accumulates straight into the output,
+         * marked written to beforehand for the threads not to race for the dirty list */
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_LEFT(&mixer->buffers, 0), current_blockcount);
+        fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_RIGHT(&mixer->buffers, 0), current_blockcount);
+    }
+
+    fluid_mixer_process_fx_jobs_multithread(mixer, mixer->mix_fx_to_out);
+
+    if(mixer->mix_fx_to_out)
+    {
+        // mix the other effects processed in place to the first stereo channel,
+        // in the same order as fluid_rvoice_mixer_process_fx_unit() would
+        int first = TRUE;
+        int scount = current_blockcount * FLUID_BUFSIZE;
+        fluid_real_t *FLUID_RESTRICT out_l = fluid_mixer_buffers_get_main_buf(&mixer->buffers, FALSE);
+        fluid_real_t *FLUID_RESTRICT out_r = fluid_mixer_buffers_get_main_buf(&mixer->buffers, TRUE);
+        fluid_real_t *FLUID_RESTRICT fx_l = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_real_t *FLUID_RESTRICT fx_r = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+        for(i = 0; i < 2; i++)
+        {
+            int channel = (i == 0) ? SYNTH_REVERB_CHANNEL : SYNTH_CHORUS_CHANNEL;
+
+            if(!((i == 0) ? mixer->with_reverb : mixer->with_chorus))
+            {
+                continue;
+            }
+
+            for(f = first ? 1 : 0; f < mixer->fx_units; f++)
+            {
+                int buf_idx = (f * fx_channels_per_unit + channel) * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
+                int j;
+
+                // bypassed units left their buffers silent
+                if(mixer->buffers.dirty[DIRTY_FX_RIGHT(&mixer->buffers, f * fx_channels_per_unit + channel)] == 0)
+                {
+                    continue;
+                }
+
+                fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_LEFT(&mixer->buffers, 0), current_blockcount);
+                fluid_mixer_buffers_set_dirty(&mixer->buffers, DIRTY_RIGHT(&mixer->buffers, 0), current_blockcount);
+
+                #pragma omp simd aligned(out_l,out_r,fx_l,fx_r:FLUID_DEFAULT_ALIGNMENT)
+
+                for(j = 0; j < scount; j++)
+                {
+                    out_l[j] += fx_l[buf_idx + j];
+                    out_r[j] += fx_r[buf_idx + j];
+                }
+            }
+
+            first = FALSE;
+        }
     }
+}
 
-    if(mixer->thread_ready_m)
-    {
-        delete_fluid_cond_mutex(mixer->thread_ready_m);
-    }
+static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer)
+{
+    int i;
+    fluid_atomic_int_set(&mixer->threads_should_terminate, 1);
+    // Signal threads to wake up
+    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
 
-    if(mixer->wakeup_threads_m)
+    for(i = 0; i < mixer->thread_count; i++)
     {
-        delete_fluid_cond_mutex(mixer->wakeup_threads_m);
+        fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_TERMINATE);
     }
 
-#endif
-    fluid_mixer_buffers_free(&mixer->buffers);
+    fluid_cond_broadcast(mixer->wakeup_threads);
+    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
 
-    
-    for(i = 0; i < mixer->fx_units; i++)
+    for(i = 0; i < mixer->thread_count; i++)
     {
-        if(mixer->fx[i].reverb)
+        if(mixer->threads[i].thread)
         {
-            delete_fluid_revmodel(mixer->fx[i].reverb);
+            fluid_thread_join(mixer->threads[i].thread);
+            delete_fluid_thread(mixer->threads[i].thread);
         }
-
-        if(mixer->fx[i].chorus)
+        else if(mixer->threads[i].factory_thread)
         {
-            delete_fluid_chorus(mixer->fx[i].chorus);
+            mixer->thread_factory.join(mixer->thread_factory.data, mixer->threads[i].factory_thread);
         }
+
+        fluid_mixer_buffers_free(&mixer->threads[i]);
     }
 
-    FLUID_FREE(mixer->fx);
-    FLUID_FREE(mixer->rvoices);
-    FLUID_FREE(mixer);
+    FLUID_FREE(mixer->threads);
+    FLUID_FREE(mixer->ws_deques);
+    mixer->thread_count = 0;
+    mixer->threads = NULL;
+    mixer->ws_deques = NULL;
 }
 
-
-#ifdef LADSPA
 /**
- * Set a LADSPS fx instance to be used by the mixer and assign the mixer buffers
- * as LADSPA host buffers with sensible names */
-void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
-                                   fluid_ladspa_fx_t *ladspa_fx, int audio_groups)
+ * Update amount of extra mixer threads.
+ * @param thread_count Number of extra mixer threads for multi-core rendering
+ * @param prio_level real-time prio level for the extra mixer threads
+ */
+static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level)
 {
-    mixer->ladspa_fx = ladspa_fx;
+    char name[16];
+    int i;
 
-    if(ladspa_fx == NULL)
+    // Kill all existing threads first
+    if(mixer->thread_count)
     {
-        return;
+        delete_rvoice_mixer_threads(mixer);
     }
-    else
-    {
-        fluid_real_t *main_l = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-        fluid_real_t *main_r = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
 
-        fluid_real_t *rev = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-        fluid_real_t *chor = rev;
+    if(thread_count == 0)
+    {
+        return FLUID_OK;
+    }
 
-        rev = &rev[SYNTH_REVERB_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
-        chor = &chor[SYNTH_CHORUS_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+    // Now prepare the new threads
+    mixer->thread_prio = prio_level;
+    fluid_atomic_int_set(&mixer->threads_should_terminate, 0);
+    mixer->threads = FLUID_ARRAY(fluid_mixer_buffers_t, thread_count);
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Main:L", audio_groups,
-                                    main_l,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    if(mixer->threads == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Main:R", audio_groups,
-                                    main_r,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    FLUID_MEMSET(mixer->threads, 0, thread_count * sizeof(fluid_mixer_buffers_t));
+    mixer->thread_count = thread_count;
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Reverb:Send", 1,
-                                    rev,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    // one deque for each extra thread plus the main thread
+    mixer->ws_deques = FLUID_ARRAY(fluid_atomic_int_t, thread_count + 1);
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Chorus:Send", 1,
-                                    chor,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    if(mixer->ws_deques == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
     }
-}
-#endif
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_enabled)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int on = param[0].i;
+    FLUID_MEMSET(mixer->ws_deques, 0, (thread_count + 1) * sizeof(fluid_atomic_int_t));
 
-    mixer->with_reverb = on;
-}
+    for(i = 0; i < thread_count; i++)
+    {
+        fluid_mixer_buffers_t *b = &mixer->threads[i];
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_enabled)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int on = param[0].i;
-    mixer->with_chorus = on;
-}
+        b->mixer = mixer;
+        b->worker = i + 1;
+        b->core = (mixer->thread_cores != NULL) ? mixer->thread_cores[i] : -1;
+        b->flush_denormals = FALSE;
+        fluid_atomic_int_set(&b->ready, THREAD_BUF_STARTING);
+        FLUID_SNPRINTF(name, sizeof(name), "mixer%d", i);
 
-void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on)
-{
-    mixer->mix_fx_to_out = on;
-}
+        if(mixer->thread_factory.create != NULL)
+        {
+            b->factory_thread = mixer->thread_factory.create(mixer->thread_factory.data, name, fluid_mixer_thread_func, b);
+        }
+        else
+        {
+            b->thread = new_fluid_thread(name, fluid_mixer_thread_func, b, prio_level, 0);
+        }
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int set = param[0].i;
-    int nr = param[1].i;
-    fluid_real_t level = param[2].real;
-    fluid_real_t speed = param[3].real;
-    fluid_real_t depth_ms = param[4].real;
-    int type = param[5].i;
+        if(!b->thread && !b->factory_thread)
+        {
+            return FLUID_FAILED;
+        }
 
-    int i;
-    for(i = 0; i < mixer->fx_units; i++)
-    {
-        fluid_chorus_set(mixer->fx[i].chorus, set, nr, level, speed, depth_ms, type);
-    }
-}
+        // wait for the thread to allocate its buffers
+        fluid_cond_mutex_lock(mixer->thread_ready_m);
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_params)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int set = param[0].i;
-    fluid_real_t roomsize = param[1].real;
-    fluid_real_t damping = param[2].real;
-    fluid_real_t width = param[3].real;
-    fluid_real_t level = param[4].real;
+        while(fluid_atomic_int_get(&b->ready) == THREAD_BUF_STARTING)
+        {
+            fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
+        }
 
-    int i;
-    for(i = 0; i < mixer->fx_units; i++)
-    {
-        fluid_revmodel_set(mixer->fx[i].reverb, set, roomsize, damping, width, level);
-    }
-}
+        fluid_cond_mutex_unlock(mixer->thread_ready_m);
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_reverb)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int i;
-    for(i = 0; i < mixer->fx_units; i++)
-    {
-        fluid_revmodel_reset(mixer->fx[i].reverb);
+        if(fluid_atomic_int_get(&b->ready) == THREAD_BUF_TERMINATE)
+        {
+            return FLUID_FAILED;
+        }
     }
-}
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int i;
-    for(i = 0; i < mixer->fx_units; i++)
-    {
-        fluid_chorus_reset(mixer->fx[i].chorus);
-    }
+    return FLUID_OK;
 }
 
-int fluid_rvoice_mixer_get_bufs(fluid_rvoice_mixer_t *mixer,
-                                fluid_real_t **left, fluid_real_t **right)
+/* Worker threads shared by all mixers of the process that join them, instead of
+ * starting extra mixer threads of their own, see fluid_rvoice_mixer_join_render_pool() */
+struct _fluid_render_pool_t
 {
-    *left = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-    *right = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
-    return mixer->buffers.buf_count;
-}
+    int refcount;                  /**< Number of mixers that joined the pool, guarded by render_pool_mutex */
+    int worker_count;
+    fluid_thread_t **workers;
+    fluid_cond_t *wakeup;          /**< Signalled when buffers are queued, the pool terminates or a mixer may leave */
+    fluid_cond_mutex_t *lock;      /**< Guards the members below and fluid_rvoice_mixer_t::pool_busy */
+    int terminate;
+    fluid_rvoice_mixer_t **mixers; /**< Mixers that joined the pool (mixer_count in length) */
+    int mixer_count;
+    int next_mixer;                /**< Mixer to look at first for queued buffers, for all of them to take turns */
+    fluid_atomic_int_t parked;     /**< Atomic: number of workers waiting on wakeup */
+};
 
-int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
-                                   fluid_real_t **fx_left, fluid_real_t **fx_right)
-{
-    *fx_left = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    *fx_right = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-    return mixer->buffers.fx_buf_count;
-}
+static fluid_render_pool_t *render_pool = NULL;
+static fluid_mutex_t render_pool_mutex = FLUID_MUTEX_INIT;
 
-int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer)
+/**
+ * Wake up the workers after queueing buffers, only taking the lock if a worker is
+ * actually asleep: a worker about to sleep looks for queued buffers again with the lock held.
+ */
+static void
+fluid_render_pool_wakeup(fluid_render_pool_t *pool)
 {
-    return FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    if(fluid_atomic_int_get(&pool->parked) > 0)
+    {
+        fluid_cond_mutex_lock(pool->lock);
+        fluid_cond_broadcast(pool->wakeup);
+        fluid_cond_mutex_unlock(pool->lock);
+    }
 }
 
-#if WITH_PROFILING
-int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer)
+/**
+ * Claim queued buffers of a mixer for a worker, called with the lock of the pool held.
+ * The mixers are looked at in turns, starting after the one that got the last worker,
+ * so that a mixer with many voices can't keep the workers from the others.
+ * @param fx Set to TRUE if the buffers are queued for fx jobs rather than voices
+ * @return the claimed buffers, NULL if none are queued
+ */
+static fluid_mixer_buffers_t *
+fluid_render_pool_claim_LOCAL(fluid_render_pool_t *pool, int *fx)
 {
-    return mixer->active_voices;
-}
-#endif
+    int i, j;
 
-#if ENABLE_MIXER_THREADS
+    for(i = 0; i < pool->mixer_count; i++)
+    {
+        int m = (pool->next_mixer + i) % pool->mixer_count;
+        fluid_rvoice_mixer_t *mixer = pool->mixers[m];
 
-static FLUID_INLINE fluid_rvoice_t *
-fluid_mixer_get_mt_rvoice(fluid_rvoice_mixer_t *mixer)
-{
-    int i = fluid_atomic_int_exchange_and_add(&mixer->current_rvoice, 1);
+        for(j = 0; j < mixer->thread_count; j++)
+        {
+            fluid_mixer_buffers_t *b = &mixer->threads[j];
+            int state = fluid_atomic_int_get(&b->ready);
 
-    if(i >= mixer->active_voices)
-    {
-        return NULL;
+            if(state == THREAD_BUF_QUEUED
+                    && fluid_atomic_int_compare_and_exchange(&b->ready, THREAD_BUF_QUEUED, THREAD_BUF_PROCESSING))
+            {
+                *fx = FALSE;
+            }
+            else if(state == THREAD_BUF_QUEUED_FX
+                    && fluid_atomic_int_compare_and_exchange(&b->ready, THREAD_BUF_QUEUED_FX, THREAD_BUF_FX))
+            {
+                *fx = TRUE;
+            }
+            else
+            {
+                continue;
+            }
+
+            pool->next_mixer = (m + 1) % pool->mixer_count;
+            mixer->pool_busy++;
+            return b;
+        }
     }
 
-    return mixer->rvoices[i];
+    return NULL;
 }
 
-#define THREAD_BUF_PROCESSING 0
-#define THREAD_BUF_VALID 1
-#define THREAD_BUF_NODATA 2
-#define THREAD_BUF_TERMINATE 3
-
-/* Core thread function (processes voices in parallel to primary synthesis thread) */
-static fluid_thread_return_t
-fluid_mixer_thread_func(void *data)
+/**
+ * Render the voices or process the fx jobs of a mixer in the buffers claimed by a
+ * worker, like fluid_mixer_thread_run() does for one block.
+ */
+static void
+fluid_render_pool_run(fluid_mixer_buffers_t *buffers, int fx)
 {
-    fluid_mixer_buffers_t *buffers = data;
     fluid_rvoice_mixer_t *mixer = buffers->mixer;
     int hasValidData = 0;
     FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
     int bufcount = 0;
-    int current_blockcount = 0;
     fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    int start, end;
 
-    while(!fluid_atomic_int_get(&mixer->threads_should_terminate))
+    if(fx)
     {
-        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer);
-
-        if(rvoice == NULL)
-        {
-            // if no voices: signal rendered buffers, sleep
-            fluid_atomic_int_set(&buffers->ready, hasValidData ? THREAD_BUF_VALID : THREAD_BUF_NODATA);
-            fluid_cond_mutex_lock(mixer->thread_ready_m);
-            fluid_cond_signal(mixer->thread_ready);
-            fluid_cond_mutex_unlock(mixer->thread_ready_m);
-
-            fluid_cond_mutex_lock(mixer->wakeup_threads_m);
-
-            while(1)
-            {
-                int j = fluid_atomic_int_get(&buffers->ready);
-
-                if(j == THREAD_BUF_PROCESSING || j == THREAD_BUF_TERMINATE)
-                {
-                    break;
-                }
-
-                fluid_cond_wait(mixer->wakeup_threads, mixer->wakeup_threads_m);
-            }
-
-            fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
-
-            hasValidData = 0;
-        }
-        else
+        fluid_rvoice_mixer_process_fx_jobs(mixer);
+    }
+    else
+    {
+        while((start = fluid_mixer_get_mt_rvoices(mixer, buffers->worker, &end)) >= 0)
         {
-            // else: if buffer is not zeroed, zero buffers
             if(!hasValidData)
             {
-                // blockcount may have changed, since thread was put to sleep
-                current_blockcount = mixer->current_blockcount;
-                fluid_mixer_buffers_zero(buffers, current_blockcount);
+                fluid_mixer_buffers_zero(buffers);
                 bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
                 hasValidData = 1;
             }
 
-            // then render voice to buffers
-            fluid_mixer_buffers_render_one(buffers, rvoice, bufs, bufcount, local_buf, current_blockcount);
+            {
+                fluid_trace_ref_var(trace_ref);
+                fluid_mixer_buffers_render_range(buffers, start, end, bufs, bufcount, local_buf, mixer->current_blockcount);
+                fluid_trace("render_range", trace_ref);
+            }
         }
     }
 
-    return FLUID_THREAD_RETURN_VALUE;
+    fluid_atomic_int_set(&buffers->ready, hasValidData ? THREAD_BUF_VALID : THREAD_BUF_NODATA);
+    fluid_cond_mutex_lock(mixer->thread_ready_m);
+    fluid_cond_signal(mixer->thread_ready);
+    fluid_cond_mutex_unlock(mixer->thread_ready_m);
 }
 
-static void
-fluid_mixer_buffers_mix(fluid_mixer_buffers_t *dst, fluid_mixer_buffers_t *src, int current_blockcount)
+/* Worker thread function of the render pool */
+static fluid_thread_return_t
+fluid_render_pool_worker_func(void *data)
 {
-    int i, j;
-    int scount = current_blockcount * FLUID_BUFSIZE;
-    int minbuf;
-    fluid_real_t *FLUID_RESTRICT base_src;
-    fluid_real_t *FLUID_RESTRICT base_dst;
+    fluid_render_pool_t *pool = data;
+    fluid_mixer_buffers_t *buffers;
+    int fx, flush_denormals = FALSE;
 
-    minbuf = dst->buf_count;
+    fluid_rt_enter();
+    fluid_cond_mutex_lock(pool->lock);
 
-    if(minbuf > src->buf_count)
+    while(!pool->terminate)
     {
-        minbuf = src->buf_count;
-    }
-
-    base_src = fluid_align_ptr(src->left_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_rvoice_mixer_t *mixer;
 
-    for(i = 0; i < minbuf; i++)
-    {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        buffers = fluid_render_pool_claim_LOCAL(pool, &fx);
 
-        for(j = 0; j < scount; j++)
+        if(buffers == NULL)
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
-        }
-    }
+            fluid_atomic_int_inc(&pool->parked);
 
-    base_src = fluid_align_ptr(src->right_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->right_buf, FLUID_DEFAULT_ALIGNMENT);
+            while(!pool->terminate && (buffers = fluid_render_pool_claim_LOCAL(pool, &fx)) == NULL)
+            {
+                fluid_cond_wait(pool->wakeup, pool->lock);
+            }
 
-    for(i = 0; i < minbuf; i++)
-    {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+            fluid_atomic_int_add(&pool->parked, -1);
 
-        for(j = 0; j < scount; j++)
-        {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            if(buffers == NULL)
+            {
+                break;
+            }
         }
-    }
-
-    minbuf = dst->fx_buf_count;
-
-    if(minbuf > src->fx_buf_count)
-    {
-        minbuf = src->fx_buf_count;
-    }
-
-    base_src = fluid_align_ptr(src->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
 
-    for(i = 0; i < minbuf; i++)
-    {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        mixer = buffers->mixer;
+        fluid_cond_mutex_unlock(pool->lock);
 
-        for(j = 0; j < scount; j++)
+        if(flush_denormals != mixer->flush_denormals)
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            flush_denormals = mixer->flush_denormals;
+            fluid_thread_self_flush_denormals(flush_denormals, NULL);
         }
-    }
 
-    base_src = fluid_align_ptr(src->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_render_pool_run(buffers, fx);
 
-    for(i = 0; i < minbuf; i++)
-    {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        fluid_cond_mutex_lock(pool->lock);
+        mixer->pool_busy--;
 
-        for(j = 0; j < scount; j++)
+        if(mixer->pool_leaving && mixer->pool_busy == 0)
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            fluid_cond_broadcast(pool->wakeup);
         }
     }
-}
 
+    fluid_cond_mutex_unlock(pool->lock);
+    fluid_rt_exit();
 
-/**
- * Go through all threads and see if someone is finished for mixing
- */
-static int
-fluid_mixer_mix_in(fluid_rvoice_mixer_t *mixer, int extra_threads, int current_blockcount)
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+static void
+delete_fluid_render_pool(fluid_render_pool_t *pool)
 {
-    int i, result, hasmixed;
+    int i;
 
-    do
+    fluid_return_if_fail(pool != NULL);
+
+    if(pool->lock != NULL && pool->wakeup != NULL)
     {
-        hasmixed = 0;
-        result = 0;
+        fluid_cond_mutex_lock(pool->lock);
+        pool->terminate = TRUE;
+        fluid_cond_broadcast(pool->wakeup);
+        fluid_cond_mutex_unlock(pool->lock);
+    }
 
-        for(i = 0; i < extra_threads; i++)
-        {
-            int j = fluid_atomic_int_get(&mixer->threads[i].ready);
+    for(i = 0; i < pool->worker_count; i++)
+    {
+        fluid_thread_join(pool->workers[i]);
+        delete_fluid_thread(pool->workers[i]);
+    }
 
-            switch(j)
-            {
-            case THREAD_BUF_PROCESSING:
-                result = 1;
-                break;
+    if(pool->wakeup)
+    {
+        delete_fluid_cond(pool->wakeup);
+    }
 
-            case THREAD_BUF_VALID:
-                fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_NODATA);
-                fluid_mixer_buffers_mix(&mixer->buffers, &mixer->threads[i], current_blockcount);
-                hasmixed = 1;
-                break;
-            }
-        }
+    if(pool->lock)
+    {
+        delete_fluid_cond_mutex(pool->lock);
     }
-    while(hasmixed);
 
-    return result;
+    FLUID_FREE(pool->workers);
+    FLUID_FREE(pool->mixers);
+    FLUID_FREE(pool);
 }
 
-static void
-fluid_render_loop_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+static fluid_render_pool_t *
+new_fluid_render_pool(int workers, int prio_level)
 {
-    int i, bufcount;
-    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
-                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
-    // How many threads should we start this time?
-    int extra_threads = mixer->active_voices / VOICES_PER_THREAD;
-
-    if(extra_threads > mixer->thread_count)
-    {
-        extra_threads = mixer->thread_count;
-    }
+    char name[16];
+    int i;
+    fluid_render_pool_t *pool = FLUID_NEW(fluid_render_pool_t);
 
-    if(extra_threads == 0)
+    if(pool == NULL)
     {
-        // No extra threads? No thread overhead!
-        fluid_render_loop_singlethread(mixer, current_blockcount);
-        return;
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
     }
 
-    bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
-
-    // Prepare voice list
-    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
-    fluid_atomic_int_set(&mixer->current_rvoice, 0);
+    FLUID_MEMSET(pool, 0, sizeof(*pool));
+    pool->wakeup = new_fluid_cond();
+    pool->lock = new_fluid_cond_mutex();
+    pool->workers = FLUID_ARRAY(fluid_thread_t *, workers);
 
-    for(i = 0; i < extra_threads; i++)
+    if(pool->wakeup == NULL || pool->lock == NULL || pool->workers == NULL)
     {
-        fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_PROCESSING);
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
     }
 
-    // Signal threads to wake up
-    fluid_cond_broadcast(mixer->wakeup_threads);
-    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
-
-    // If thread is finished, mix it in
-    while(fluid_mixer_mix_in(mixer, extra_threads, current_blockcount))
+    for(i = 0; i < workers; i++)
     {
-        // Otherwise get a voice and render it
-        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer);
+        FLUID_SNPRINTF(name, sizeof(name), "pool%d", i);
+        pool->workers[i] = new_fluid_thread(name, fluid_render_pool_worker_func, pool, prio_level, FALSE);
 
-        if(rvoice != NULL)
+        if(pool->workers[i] == NULL)
         {
-            fluid_profile_ref_var(prof_ref);
-            fluid_mixer_buffers_render_one(&mixer->buffers, rvoice, bufs, bufcount, local_buf, current_blockcount);
-            fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
-                          current_blockcount * FLUID_BUFSIZE);
-            //test++;
+            goto error_recovery;
         }
-        else
-        {
-            // If no voices, wait for mixes. Make sure one is still processing to avoid deadlock
-            int is_processing = 0;
-            //waits++;
-            fluid_cond_mutex_lock(mixer->thread_ready_m);
-
-            for(i = 0; i < extra_threads; i++)
-            {
-                if(fluid_atomic_int_get(&mixer->threads[i].ready) ==
-                        THREAD_BUF_PROCESSING)
-                {
-                    is_processing = 1;
-                }
-            }
-
-            if(is_processing)
-            {
-                fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
-            }
 
-            fluid_cond_mutex_unlock(mixer->thread_ready_m);
-        }
+        pool->worker_count++;
     }
 
-    //FLUID_LOG(FLUID_DBG, "Blockcount: %d, mixed %d of %d voices myself, waits = %d",
-    //	    current_blockcount, test, mixer->active_voices, waits);
+    return pool;
+
+error_recovery:
+    delete_fluid_render_pool(pool);
+    return NULL;
 }
 
-static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer)
+/**
+ * Stop rendering with the workers of the render pool, once none of them uses
+ * the mixer anymore. The pool is stopped when the last mixer leaves it.
+ */
+static void
+fluid_rvoice_mixer_leave_render_pool(fluid_rvoice_mixer_t *mixer)
 {
+    fluid_render_pool_t *pool = mixer->pool;
     int i;
-    fluid_atomic_int_set(&mixer->threads_should_terminate, 1);
-    // Signal threads to wake up
-    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
 
-    for(i = 0; i < mixer->thread_count; i++)
+    if(pool == NULL)
     {
-        fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_TERMINATE);
+        return;
     }
 
-    fluid_cond_broadcast(mixer->wakeup_threads);
-    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+    fluid_cond_mutex_lock(pool->lock);
 
-    for(i = 0; i < mixer->thread_count; i++)
+    for(i = 0; i < pool->mixer_count; i++)
     {
-        if(mixer->threads[i].thread)
+        if(pool->mixers[i] == mixer)
         {
-            fluid_thread_join(mixer->threads[i].thread);
-            delete_fluid_thread(mixer->threads[i].thread);
+            pool->mixers[i] = pool->mixers[--pool->mixer_count];
+            break;
         }
+    }
 
-        fluid_mixer_buffers_free(&mixer->threads[i]);
+    pool->next_mixer = 0;
+
+    // a worker may still be signalling the last buffers it rendered
+    mixer->pool_leaving = TRUE;
+
+    while(mixer->pool_busy > 0)
+    {
+        fluid_cond_wait(pool->wakeup, pool->lock);
     }
 
-    FLUID_FREE(mixer->threads);
-    mixer->thread_count = 0;
-    mixer->threads = NULL;
+    fluid_cond_mutex_unlock(pool->lock);
+    mixer->pool = NULL;
+
+    fluid_mutex_lock(render_pool_mutex);
+
+    if(--pool->refcount == 0)
+    {
+        render_pool = NULL;
+        delete_fluid_render_pool(pool);
+    }
+
+    fluid_mutex_unlock(render_pool_mutex);
 }
+#endif
 
 /**
- * Update amount of extra mixer threads.
- * @param thread_count Number of extra mixer threads for multi-core rendering
- * @param prio_level real-time prio level for the extra mixer threads
+ * Render the voices and effects of the mixer with the workers of the render pool
+ * shared by all mixers of the process that join it, instead of with extra mixer threads
+ * of its own. The pool is started by the first mixer joining it and stopped once the last
+ * one is deleted. Each mixer gets buffers for all workers, the workers take turns among
+ * the mixers that have work queued.
+ * @param workers Number of workers, if the pool has to be started
+ * @param prio_level real-time prio level of the workers, if the pool has to be started
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  */
-static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level)
+int
+fluid_rvoice_mixer_join_render_pool(fluid_rvoice_mixer_t *mixer, int workers, int prio_level)
 {
-    char name[16];
+#if ENABLE_MIXER_THREADS
+    fluid_render_pool_t *pool;
+    fluid_rvoice_mixer_t **mixers;
     int i;
 
-    // Kill all existing threads first
-    if(mixer->thread_count)
+    fluid_return_val_if_fail(mixer != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(mixer->pool == NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(workers > 0, FLUID_FAILED);
+
+    // own extra mixer threads are replaced by the workers
+    if(fluid_rvoice_mixer_set_threads(mixer, 0, prio_level) != FLUID_OK)
     {
-        delete_rvoice_mixer_threads(mixer);
+        return FLUID_FAILED;
     }
 
-    if(thread_count == 0)
+    fluid_mutex_lock(render_pool_mutex);
+
+    if(render_pool == NULL)
     {
-        return FLUID_OK;
+        render_pool = new_fluid_render_pool(workers, prio_level);
+    }
+    else if(render_pool->worker_count != workers)
+    {
+        FLUID_LOG(FLUID_WARN, "The render pool is already running with %d workers, not %d",
+                  render_pool->worker_count, workers);
     }
 
-    // Now prepare the new threads
-    fluid_atomic_int_set(&mixer->threads_should_terminate, 0);
-    mixer->threads = FLUID_ARRAY(fluid_mixer_buffers_t, thread_count);
+    pool = render_pool;
 
-    if(mixer->threads == NULL)
+    if(pool != NULL)
+    {
+        pool->refcount++;
+    }
+
+    fluid_mutex_unlock(render_pool_mutex);
+
+    if(pool == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    // from now on fluid_rvoice_mixer_leave_render_pool() cleans up after a failure
+    mixer->pool = pool;
+    mixer->pool_leaving = FALSE;
+    mixer->threads = FLUID_ARRAY(fluid_mixer_buffers_t, pool->worker_count);
+    mixer->ws_deques = FLUID_ARRAY(fluid_atomic_int_t, pool->worker_count + 1);
+
+    if(mixer->threads == NULL || mixer->ws_deques == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory");
         return FLUID_FAILED;
     }
 
-    FLUID_MEMSET(mixer->threads, 0, thread_count * sizeof(fluid_mixer_buffers_t));
-    mixer->thread_count = thread_count;
+    FLUID_MEMSET(mixer->threads, 0, pool->worker_count * sizeof(fluid_mixer_buffers_t));
+    FLUID_MEMSET(mixer->ws_deques, 0, (pool->worker_count + 1) * sizeof(fluid_atomic_int_t));
+    mixer->thread_count = pool->worker_count;
 
-    for(i = 0; i < thread_count; i++)
+    for(i = 0; i < mixer->thread_count; i++)
     {
         fluid_mixer_buffers_t *b = &mixer->threads[i];
 
+        b->worker = i + 1;
+        b->core = -1;
+        fluid_atomic_int_set(&b->ready, THREAD_BUF_NODATA);
+
         if(!fluid_mixer_buffers_init(b, mixer))
         {
             return FLUID_FAILED;
         }
+    }
 
-        fluid_atomic_int_set(&b->ready, THREAD_BUF_NODATA);
-        FLUID_SNPRINTF(name, sizeof(name), "mixer%d", i);
-        b->thread = new_fluid_thread(name, fluid_mixer_thread_func, b, prio_level, 0);
+    fluid_cond_mutex_lock(pool->lock);
+    mixers = FLUID_REALLOC(pool->mixers, (pool->mixer_count + 1) * sizeof(*mixers));
 
-        if(!b->thread)
-        {
-            return FLUID_FAILED;
-        }
+    if(mixers != NULL)
+    {
+        pool->mixers = mixers;
+        pool->mixers[pool->mixer_count++] = mixer;
+    }
+
+    fluid_cond_mutex_unlock(pool->lock);
+
+    if(mixers == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
     }
 
     return FLUID_OK;
-}
+#else
+    FLUID_LOG(FLUID_ERR, "The render pool requires mixer threads, which are disabled in this build");
+    return FLUID_FAILED;
 #endif
+}
 
 /**
  * Synthesize audio into buffers
@@ -1361,12 +5109,48 @@ static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int threa
 int
 fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount)
 {
+    unsigned int fpu_state;
+    int flush_denormals = mixer->flush_denormals
+                          && fluid_thread_self_flush_denormals(TRUE, &fpu_state) == FLUID_OK;
+    fluid_trace_ref_var(trace_ref);
     fluid_profile_ref_var(prof_ref);
 
+    // pin the rendering thread, whenever it's a different one
+    if(mixer->render_core >= 0 && mixer->render_thread != fluid_thread_get_id())
+    {
+        mixer->render_thread = fluid_thread_get_id();
+        fluid_thread_self_set_affinity(mixer->render_core);
+    }
+
     mixer->current_blockcount = blockcount;
+    mixer->output_used = (mixer->buffers.out_left != NULL);
+
+    /* LADSPA may have been set up by the events dispatched since fluid_rvoice_mixer_set_output(),
+     * its host buffers are the own ones */
+#ifdef LADSPA
+    if(mixer->ladspa_fx != NULL)
+    {
+        mixer->output_used = FALSE;
+        mixer->buffers.out_left = NULL;
+        mixer->buffers.out_right = NULL;
+    }
+
+#endif
+
+    if(mixer->output_used)
+    {
+        // the voices are added to the buffers of the caller
+        FLUID_MEMSET(mixer->buffers.out_left, 0, blockcount * FLUID_BUFSIZE * sizeof(fluid_real_t));
+        FLUID_MEMSET(mixer->buffers.out_right, 0, blockcount * FLUID_BUFSIZE * sizeof(fluid_real_t));
+    }
+
+    if(mixer->note_cache != NULL)
+    {
+        fluid_note_cache_reserve(mixer->note_cache, blockcount);
+    }
 
     // Zero buffers
-    fluid_mixer_buffers_zero(&mixer->buffers, blockcount);
+    fluid_mixer_buffers_zero(&mixer->buffers);
     fluid_profile(FLUID_PROF_ONE_BLOCK_CLEAR, prof_ref, mixer->active_voices,
                   blockcount * FLUID_BUFSIZE);
 
@@ -1384,13 +5168,46 @@ fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount)
 
     fluid_profile(FLUID_PROF_ONE_BLOCK_VOICES, prof_ref, mixer->active_voices,
                   blockcount * FLUID_BUFSIZE);
+    fluid_trace("render_voices", trace_ref);
 
 
     // Process reverb & chorus
+    fluid_trace_ref_reset(trace_ref);
     fluid_rvoice_mixer_process_fx(mixer, blockcount);
+    fluid_trace("process_fx", trace_ref);
+
+    if(mixer->meters != NULL)
+    {
+        fluid_rvoice_mixer_update_meters(mixer, blockcount);
+    }
+
+    if(mixer->upsampler != NULL)
+    {
+        fluid_rvoice_mixer_queue_upsampling(mixer, blockcount);
+    }
+
+    if(mixer->output_used)
+    {
+        // don't zero the buffers of the caller before the next rendering
+        fluid_mixer_buffers_forget_dirty(&mixer->buffers, DIRTY_LEFT(&mixer->buffers, 0));
+        fluid_mixer_buffers_forget_dirty(&mixer->buffers, DIRTY_RIGHT(&mixer->buffers, 0));
+        mixer->buffers.out_left = NULL;
+        mixer->buffers.out_right = NULL;
+    }
 
     // Call the callback and pack active voice array
     fluid_rvoice_mixer_process_finished_voices(mixer);
 
+    if(mixer->snapshot != NULL)
+    {
+        fluid_rvoice_mixer_publish_snapshot(mixer);
+    }
+
+    // leave the calling thread as it was
+    if(flush_denormals)
+    {
+        fluid_thread_self_restore_denormals(fpu_state);
+    }
+
     return blockcount;
 }
@@ -25,38 +25,104 @@
 #include "fluidsynth_priv.h"
 #include "fluid_rvoice.h"
 #include "fluid_ladspa.h"
+#include "fluid_convolver.h"
 
 typedef struct _fluid_rvoice_mixer_t fluid_rvoice_mixer_t;
+typedef struct _fluid_rvoice_mixer_rate_t fluid_rvoice_mixer_rate_t;
+typedef struct _fluid_rvoice_mixer_ir_t fluid_rvoice_mixer_ir_t;
+
+/** How voices are distributed among the mixer threads */
+enum fluid_mixer_scheduler
+{
+    FLUID_MIXER_SCHEDULER_SHARED, /**< All threads pick single voices from a shared counter */
+    FLUID_MIXER_SCHEDULER_WORK_STEALING, /**< Each thread owns a deque of voice chunks and steals from others when done */
+    FLUID_MIXER_SCHEDULER_DETERMINISTIC /**< Each thread renders its own deque only, mixed in in the order of the threads */
+};
+
+/** What a fluid_rvoice_mixer_rate_t does with the reverb or the chorus units */
+enum fluid_mixer_fx_change
+{
+    FLUID_MIXER_FX_KEEP, /**< Leave the units in use alone */
+    FLUID_MIXER_FX_NEW, /**< Replace the units in use by new ones, or create them */
+    FLUID_MIXER_FX_REMOVE /**< Remove the units in use, the effect is bypassed */
+};
 
 int fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount);
 int fluid_rvoice_mixer_get_bufs(fluid_rvoice_mixer_t *mixer,
                                 fluid_real_t **left, fluid_real_t **right);
+void fluid_rvoice_mixer_set_output(fluid_rvoice_mixer_t *mixer, fluid_real_t *left, fluid_real_t *right);
+int fluid_rvoice_mixer_is_output_used(fluid_rvoice_mixer_t *mixer);
 int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
                                    fluid_real_t **fx_left, fluid_real_t **fx_right);
 int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer);
-#if WITH_PROFILING
 int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer);
-#endif
+double fluid_rvoice_mixer_take_wait_time(fluid_rvoice_mixer_t *mixer);
 fluid_rvoice_mixer_t *new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, int fx_units,
-        fluid_real_t sample_rate, fluid_rvoice_eventhandler_t *, int, int);
+        fluid_rvoice_eventhandler_t *, int, int);
 
 void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *);
 
+fluid_rvoice_mixer_rate_t *new_fluid_rvoice_mixer_rate(fluid_rvoice_mixer_t *mixer, fluid_real_t sample_rate,
+        int reverb, int chorus);
+void delete_fluid_rvoice_mixer_rate(fluid_rvoice_mixer_rate_t *rate);
+int fluid_rvoice_mixer_rate_is_swapped(fluid_rvoice_mixer_rate_t *rate);
+
+fluid_rvoice_mixer_ir_t *new_fluid_rvoice_mixer_ir(int unit, fluid_convolver_t *conv);
+void delete_fluid_rvoice_mixer_ir(fluid_rvoice_mixer_ir_t *ir);
+int fluid_rvoice_mixer_ir_is_swapped(fluid_rvoice_mixer_ir_t *ir);
+
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voice);
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voices);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_voices_off);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_channel_off);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_rate);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_ir);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_enabled);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_enabled);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_params);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_fx_send);
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_reverb);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_upsampling);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_clear_note_cache);
 
 
 
 void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on);
+void fluid_rvoice_mixer_set_fx_shared(fluid_rvoice_mixer_t *mixer, int on);
+void fluid_rvoice_mixer_set_scheduler(fluid_rvoice_mixer_t *mixer, int scheduler);
+void fluid_rvoice_mixer_set_spin_time(fluid_rvoice_mixer_t *mixer, int msec);
+void fluid_rvoice_mixer_set_prefetch(fluid_rvoice_mixer_t *mixer, int on);
+int fluid_rvoice_mixer_is_silent(fluid_rvoice_mixer_t *mixer);
+size_t fluid_rvoice_mixer_get_fx_state_size(fluid_rvoice_mixer_t *mixer);
+void fluid_rvoice_mixer_save_fx_state(fluid_rvoice_mixer_t *mixer, void *data);
+int fluid_rvoice_mixer_load_fx_state(fluid_rvoice_mixer_t *mixer, const void *data, size_t size);
+fluid_rvoice_t *fluid_rvoice_mixer_get_voice(fluid_rvoice_mixer_t *mixer, int index);
+void fluid_rvoice_mixer_remove_finished_voices(fluid_rvoice_mixer_t *mixer);
+void fluid_rvoice_mixer_restore_voices(fluid_rvoice_mixer_t *mixer, fluid_rvoice_t **voices, int count);
+void fluid_rvoice_mixer_set_fused(fluid_rvoice_mixer_t *mixer, int on);
+void fluid_rvoice_mixer_set_reverb_decimation(fluid_rvoice_mixer_t *mixer, int decimation);
+int fluid_rvoice_mixer_set_note_cache(fluid_rvoice_mixer_t *mixer, unsigned int size);
+unsigned int fluid_rvoice_mixer_get_note_cache_hits(fluid_rvoice_mixer_t *mixer);
+void fluid_rvoice_mixer_get_memory(fluid_rvoice_mixer_t *mixer, size_t *bytes);
+int fluid_rvoice_mixer_set_flush_denormals(fluid_rvoice_mixer_t *mixer, int enable);
+int fluid_rvoice_mixer_enable_meters(fluid_rvoice_mixer_t *mixer);
+int fluid_rvoice_mixer_get_level(fluid_rvoice_mixer_t *mixer, int fx, int chan, float *peak, float *rms);
+int fluid_rvoice_mixer_enable_snapshot(fluid_rvoice_mixer_t *mixer);
+int fluid_rvoice_mixer_get_snapshot(fluid_rvoice_mixer_t *mixer, fluid_voice_snapshot_t *voices, int size);
+int fluid_rvoice_mixer_set_upsampling(fluid_rvoice_mixer_t *mixer, int num, int den);
+int fluid_rvoice_mixer_get_upsampling_blocks(fluid_rvoice_mixer_t *mixer, int blockcount);
+int fluid_rvoice_mixer_upsample(fluid_rvoice_mixer_t *mixer, int blockcount);
+int fluid_rvoice_mixer_reserve_polyphony(fluid_rvoice_mixer_t *mixer, int value);
+int fluid_rvoice_mixer_set_affinity(fluid_rvoice_mixer_t *mixer, const int *cores, int count);
+int fluid_rvoice_mixer_set_workgroup(fluid_rvoice_mixer_t *mixer, void *workgroup);
+void fluid_rvoice_mixer_dispatch_config(void);
+int fluid_rvoice_mixer_set_thread_factory(fluid_rvoice_mixer_t *mixer, const fluid_thread_factory_t *factory);
+int fluid_rvoice_mixer_join_render_pool(fluid_rvoice_mixer_t *mixer, int workers, int prio_level);
 #ifdef LADSPA
 void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
                                    fluid_ladspa_fx_t *ladspa_fx, int audio_groups);
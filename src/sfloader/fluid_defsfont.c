@@ -25,6 +25,7 @@
 #include "fluid_defsfont.h"
 #include "fluid_sfont.h"
 #include "fluid_sys.h"
+#include "fluid_trace.h"
 #include "fluid_synth.h"
 #include "fluid_samplecache.h"
 
@@ -33,14 +34,29 @@
  * compatible as most existing soundfonts expect exactly this (strange, non-standard) behaviour. */
 #define EMU_ATTENUATION_FACTOR (0.4f)
 
+/* Size of the blocks of the arena holding the zones, instruments and modulators of a SoundFont */
+#define DEFSFONT_ARENA_BLOCK_SIZE (64 * 1024)
+
 /* Dynamic sample loading functions */
 static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static void unload_sample(fluid_sample_t *sample);
+static void load_preset_sample(fluid_defsfont_t *defsfont, SFData *sffile, fluid_sample_t *sample);
+static void read_ahead_sample(fluid_defsfont_t *defsfont, SFData *sffile, fluid_sample_t *sample);
+static int queue_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
+static int fluid_defsfont_start_loader(fluid_defsfont_t *defsfont);
+static void fluid_defsfont_stop_loader(fluid_defsfont_t *defsfont);
+static fluid_thread_return_t fluid_defsfont_loader_run(void *data);
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan);
 static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason);
-static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone);
+static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone, fluid_arena_t *arena);
+static int fluid_defpreset_build_zone_table(fluid_defpreset_t *defpreset);
+static int fluid_defpreset_compile_voice_zones(fluid_defpreset_t *defpreset, fluid_arena_t *arena);
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx);
+static void fluid_defpreset_import_sfont_header(fluid_defpreset_t *defpreset, SFPreset *sfpreset);
+static int fluid_defpreset_import_sfont_zones(fluid_defpreset_t *defpreset, SFPreset *sfpreset,
+        fluid_defsfont_t *defsfont);
+static int fluid_defsfont_import_lazy_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset);
 
 
 /***************************************************************
@@ -99,6 +115,8 @@ fluid_sfont_t *fluid_defsfloader_load(fluid_sfloader_t *loader, const char *file
     }
 
     fluid_sfont_set_data(sfont, defsfont);
+    sfont->get_memory = fluid_defsfont_sfont_get_memory;
+    sfont->get_load_stats = fluid_defsfont_sfont_get_load_stats;
 
     defsfont->sfont = sfont;
 
@@ -150,6 +168,146 @@ fluid_preset_t *fluid_defsfont_sfont_iteration_next(fluid_sfont_t *sfont)
     return fluid_defsfont_iteration_next(fluid_sfont_get_data(sfont));
 }
 
+/* Add the bytes of sample data to the shared or the private ones, and to the locked ones */
+static void fluid_defsfont_add_sample_memory(const short *data, size_t *bytes)
+{
+    size_t size;
+    int shared, locked;
+
+    if(fluid_samplecache_get_memory(data, &size, &shared, &locked) == FLUID_OK)
+    {
+        bytes[shared ? FLUID_SYNTH_MEMORY_SAMPLES_SHARED : FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE] += size;
+
+        if(locked)
+        {
+            bytes[FLUID_SYNTH_MEMORY_SAMPLES_LOCKED] += size;
+        }
+    }
+}
+
+/*
+ * Get the position of a sample in the samples of a SoundFont, by which a voice
+ * playing it is saved by fluid_synth_save_state().
+ * Returns -1 if the SoundFont doesn't hold the sample or isn't loaded by the default loader.
+ */
+int fluid_defsfont_sfont_get_sample_index(fluid_sfont_t *sfont, const fluid_sample_t *sample)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    fluid_list_t *list;
+    int index = 0;
+
+    if(sfont->free != fluid_defsfont_sfont_delete)
+    {
+        return -1;
+    }
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        if(fluid_list_get(list) == sample)
+        {
+            return index;
+        }
+
+        index++;
+    }
+
+    return -1;
+}
+
+/*
+ * Get the sample at a position given by fluid_defsfont_sfont_get_sample_index().
+ * Returns NULL if there is none or if the SoundFont isn't loaded by the default loader.
+ */
+fluid_sample_t *fluid_defsfont_sfont_get_sample(fluid_sfont_t *sfont, int index)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+
+    if(sfont->free != fluid_defsfont_sfont_delete || index < 0)
+    {
+        return NULL;
+    }
+
+    return fluid_list_get(fluid_list_nth(defsfont->sample, index));
+}
+
+void fluid_defsfont_sfont_get_memory(fluid_sfont_t *sfont, size_t *bytes)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    size_t size = sizeof(*sfont) + sizeof(*defsfont) + fluid_arena_get_size(defsfont->arena);
+    fluid_list_t *list;
+
+    if(defsfont->filename != NULL)
+    {
+        size += FLUID_STRLEN(defsfont->filename) + 1;
+    }
+
+    if(defsfont->sfdata != NULL)
+    {
+        size += fluid_sffile_get_size(defsfont->sfdata);
+    }
+
+    if(defsfont->sampledata != NULL)
+    {
+        fluid_defsfont_add_sample_memory(defsfont->sampledata, bytes);
+    }
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        size += sizeof(fluid_list_t) + sizeof(*sample);
+        bytes[FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE] += fluid_sample_get_loop_size(sample)
+                + fluid_sample_get_stream_size(sample);
+
+        /* loaded on their own, see delete_fluid_defsfont() */
+        if(sample->data != NULL && sample->data != defsfont->sampledata)
+        {
+            fluid_defsfont_add_sample_memory(sample->data, bytes);
+        }
+    }
+
+    for(list = defsfont->preset; list; list = fluid_list_next(list))
+    {
+        fluid_preset_t *preset = fluid_list_get(list);
+        fluid_defpreset_t *defpreset = fluid_preset_get_data(preset);
+
+        size += sizeof(fluid_list_t) + sizeof(*preset) + sizeof(*defpreset);
+
+        if(defpreset->zone_table_index != NULL)
+        {
+            int count = defpreset->zone_table_index[128 * defpreset->num_vel_buckets];
+
+            size += (128 * defpreset->num_vel_buckets + 1) * sizeof(int)
+                    + count * sizeof(fluid_zone_table_entry_t);
+        }
+    }
+
+    size += sizeof(fluid_list_t) * fluid_list_size(defsfont->inst);
+
+    bytes[FLUID_SYNTH_MEMORY_SOUNDFONTS] += size;
+}
+
+void fluid_defsfont_sfont_get_load_stats(fluid_sfont_t *sfont, double *msec, size_t *bytes)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    double sfont_msec[FLUID_SFONT_LOAD_LAST];
+    size_t sfont_bytes[FLUID_SFONT_LOAD_LAST];
+    int i;
+
+    if(defsfont->load_stats == NULL)
+    {
+        return;
+    }
+
+    fluid_sfont_load_stats_get(defsfont->load_stats, sfont_msec, sfont_bytes);
+
+    for(i = 0; i < FLUID_SFONT_LOAD_LAST; i++)
+    {
+        msec[i] += sfont_msec[i];
+        bytes[i] += sfont_bytes[i];
+    }
+}
+
 void fluid_defpreset_preset_delete(fluid_preset_t *preset)
 {
     fluid_defsfont_t *defsfont;
@@ -185,7 +343,15 @@ int fluid_defpreset_preset_get_num(fluid_preset_t *preset)
 int fluid_defpreset_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
                                   int chan, int key, int vel)
 {
-    return fluid_defpreset_noteon(fluid_preset_get_data(preset), synth, chan, key, vel);
+    fluid_defpreset_t *defpreset = fluid_preset_get_data(preset);
+
+    /* a preset obtained by iterating over the SoundFont may not be imported yet */
+    if(fluid_defsfont_import_lazy_preset(fluid_sfont_get_data(preset->sfont), defpreset) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    return fluid_defpreset_noteon(defpreset, synth, chan, key, vel);
 }
 
 
@@ -200,6 +366,7 @@ int fluid_defpreset_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
 fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 {
     fluid_defsfont_t *defsfont;
+    int streaming, load_stats;
 
     defsfont = FLUID_NEW(fluid_defsfont_t);
 
@@ -211,8 +378,53 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 
     FLUID_MEMSET(defsfont, 0, sizeof(*defsfont));
 
+    defsfont->arena = new_fluid_arena(DEFSFONT_ARENA_BLOCK_SIZE);
+
+    if(defsfont->arena == NULL)
+    {
+        FLUID_FREE(defsfont);
+        return NULL;
+    }
+
     fluid_settings_getint(settings, "synth.lock-memory", &defsfont->mlock);
+    fluid_settings_getint(settings, "synth.huge-pages", &defsfont->huge_pages);
     fluid_settings_getint(settings, "synth.dynamic-sample-loading", &defsfont->dynamic_samples);
+    fluid_settings_getint(settings, "synth.dynamic-sample-loading-async", &defsfont->async_samples);
+    fluid_settings_getint(settings, "synth.dynamic-sample-loading-reads", &defsfont->read_depth);
+    fluid_settings_getint(settings, "synth.lazy-preset-loading", &defsfont->lazy_presets);
+    fluid_settings_getint(settings, "synth.sample-mmap", &defsfont->mmap);
+    fluid_settings_getint(settings, "synth.sample-float", &defsfont->float_samples);
+    fluid_settings_getint(settings, "synth.sample-loop-padding", &defsfont->pad_loops);
+    fluid_settings_getint(settings, "synth.sample-mipmaps", &defsfont->mipmap_loops);
+    fluid_settings_getint(settings, "synth.load-threads", &defsfont->load_threads);
+    fluid_settings_getint(settings, "synth.sample-cache-size", &defsfont->cache_size);
+    fluid_settings_dupstr(settings, "synth.sample-cache-dir", &defsfont->cache_dir);
+    fluid_settings_getint(settings, "synth.sample-shm", &defsfont->shm);
+
+    if(fluid_settings_getint(settings, "synth.sfont-load-stats", &load_stats) == FLUID_OK && load_stats)
+    {
+        defsfont->load_stats = new_fluid_sfont_load_stats();
+
+        if(defsfont->load_stats == NULL)
+        {
+            delete_fluid_arena(defsfont->arena);
+            FLUID_FREE(defsfont->cache_dir);
+            FLUID_FREE(defsfont);
+            return NULL;
+        }
+    }
+
+    if(fluid_settings_getint(settings, "synth.sample-streaming", &streaming) == FLUID_OK && streaming)
+    {
+        /* Streaming reads the samples from the mapped file, and locking or converting
+         * all of the sample data would read them from disk right away */
+        fluid_settings_getint(settings, "synth.sample-streaming-preload", &defsfont->stream_preload);
+        defsfont->mmap = TRUE;
+        defsfont->mlock = FALSE;
+        defsfont->float_samples = FALSE;
+        defsfont->pad_loops = FALSE;
+        defsfont->mipmap_loops = FALSE;
+    }
 
     return defsfont;
 }
@@ -233,17 +445,21 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
     {
         sample = (fluid_sample_t *) fluid_list_get(list);
 
-        if(sample->refcount != 0)
+        if(fluid_atomic_int_get(&sample->refcount) != 0)
         {
             return FLUID_FAILED;
         }
     }
 
+    fluid_defsfont_stop_loader(defsfont);
+
     if(defsfont->filename != NULL)
     {
         FLUID_FREE(defsfont->filename);
     }
 
+    FLUID_FREE(defsfont->cache_dir);
+
     for(list = defsfont->sample; list; list = fluid_list_next(list))
     {
         sample = (fluid_sample_t *) fluid_list_get(list);
@@ -278,12 +494,16 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
 
     delete_fluid_list(defsfont->preset);
 
-    for(list = defsfont->inst; list; list = fluid_list_next(list))
+    if(defsfont->sfdata != NULL)
     {
-        delete_fluid_inst(fluid_list_get(list));
+        fluid_sffile_close(defsfont->sfdata);
     }
 
+    /* the instruments, zones and modulators are all freed at once */
     delete_fluid_list(defsfont->inst);
+    delete_fluid_arena(defsfont->arena);
+
+    delete_fluid_sfont_load_stats(defsfont->load_stats);
 
     FLUID_FREE(defsfont);
     return FLUID_OK;
@@ -297,12 +517,34 @@ const char *fluid_defsfont_get_name(fluid_defsfont_t *defsfont)
     return defsfont->filename;
 }
 
-/* Load sample data for a single sample from the Soundfont file.
- * Returns FLUID_OK on error, otherwise FLUID_FAILED
- */
-int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, fluid_sample_t *sample)
+/* Copy the head and the loop of a sample mapped from the SoundFont file to memory, so that
+ * voices can start playing it right away while the rest is streamed in the background. Only
+ * the copies count against the memory, the pages of the mapping may be dropped any time. */
+static void fluid_defsfont_preload_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    unsigned int count;
+
+    fluid_sample_free_stream_data(sample);
+
+    if(defsfont->stream_preload <= 0 || sample->data == NULL || sample->end < sample->start
+            || !fluid_samplecache_is_mapped(sample->data))
+    {
+        return;
+    }
+
+    count = sample->end + 1 - sample->start;
+
+    if(count > (unsigned int)defsfont->stream_preload)
+    {
+        count = defsfont->stream_preload;
+    }
+
+    fluid_sample_copy_stream_data(sample, count);
+}
+
+/* The index of the last sample point loaded of a sample */
+static unsigned int fluid_defsfont_get_source_end(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
 {
-    int num_samples;
     unsigned int source_end = sample->source_end;
 
     /* For uncompressed samples we want to include the 46 zero sample word area following each sample
@@ -320,9 +562,20 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
         }
     }
 
+    return source_end;
+}
+
+/* Load sample data for a single sample from the Soundfont file.
+ * Returns FLUID_OK on error, otherwise FLUID_FAILED
+ */
+int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, fluid_sample_t *sample)
+{
+    int num_samples;
+
     num_samples = fluid_samplecache_load(
-                      sfdata, sample->source_start, source_end, sample->sampletype,
-                      defsfont->mlock, &sample->data, &sample->data24);
+                      sfdata, sample->source_start, fluid_defsfont_get_source_end(defsfont, sample), sample->sampletype,
+                      defsfont->mlock, defsfont->mmap, defsfont->cache_size, defsfont->cache_dir,
+                      defsfont->shm, defsfont->float_samples, &sample->data, &sample->data24, &sample->float_data);
 
     if(num_samples < 0)
     {
@@ -352,14 +605,175 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
     return FLUID_OK;
 }
 
+/* Make the copies of the sample loop the interpolation reads instead of the sample data,
+ * see synth.sample-loop-padding and synth.sample-mipmaps */
+static void fluid_defsfont_copy_sample_loop(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    if(defsfont->pad_loops)
+    {
+        fluid_sample_pad_loop(sample);
+    }
+
+    if(defsfont->mipmap_loops)
+    {
+        fluid_sample_decimate_loop(sample);
+    }
+}
+
+/* Prepare a sample loaded for playback: copy its head and loop and find its peak */
+static void fluid_defsfont_optimize_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    double start = fluid_sfont_load_stats_start(defsfont->load_stats);
+
+    fluid_defsfont_preload_sample(defsfont, sample);
+    fluid_defsfont_copy_sample_loop(defsfont, sample);
+    fluid_voice_optimize_sample(sample);
+
+    fluid_sfont_load_stats_add(defsfont->load_stats, FLUID_SFONT_LOAD_SAMPLE_OPTIMIZE, start,
+                               (sample->end - sample->start + 1) * sizeof(short));
+}
+
+/* The samples of a Soundfont to be set up by a pool of loader threads */
+typedef struct
+{
+    fluid_defsfont_t *defsfont;
+    SFData *sfdata;
+    fluid_sample_t **samples;
+    int count;
+    fluid_atomic_int_t next;    /* index of the next sample to be set up */
+    fluid_atomic_int_t failed;  /* set if any of the samples failed to load */
+} fluid_defsfont_load_job_t;
+
+/* Loads a single sample of an SF3 file, or sets up a sample of an SF2 file pointing into the
+ * sample data block loaded already. Can be called by several threads at once for different samples.
+ * Returns FLUID_OK on success, otherwise FLUID_FAILED
+ */
+static int fluid_defsfont_setup_sample(fluid_defsfont_t *defsfont, SFData *sfdata, fluid_sample_t *sample)
+{
+    if(sfdata->version.major == 3)
+    {
+        /* SF3 samples get loaded individually, as most (or all) of them are in Ogg Vorbis format
+         * anyway */
+        if(fluid_defsfont_load_sampledata(defsfont, sfdata, sample) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to load sample '%s'", sample->name);
+            return FLUID_FAILED;
+        }
+
+        fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
+    }
+    else
+    {
+        /* Data pointers of SF2 samples point to large sample data block loaded above */
+        sample->data = defsfont->sampledata;
+        sample->data24 = defsfont->sample24data;
+        sample->float_data = defsfont->samplefloatdata;
+        fluid_sample_sanitize_loop(sample, defsfont->samplesize);
+    }
+
+    fluid_defsfont_optimize_sample(defsfont, sample);
+
+    return FLUID_OK;
+}
+
+static fluid_thread_return_t fluid_defsfont_load_worker(void *data)
+{
+    fluid_defsfont_load_job_t *job = data;
+    int i;
+
+    while((i = fluid_atomic_int_exchange_and_add(&job->next, 1)) < job->count)
+    {
+        if(fluid_atomic_int_get(&job->failed))
+        {
+            break;
+        }
+
+        if(fluid_defsfont_setup_sample(job->defsfont, job->sfdata, job->samples[i]) == FLUID_FAILED)
+        {
+            fluid_atomic_int_set(&job->failed, TRUE);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Sets up all samples, spreading the reading, decompression and optimization of the samples over
+ * defsfont->load_threads threads (including the calling one).
+ * Returns FLUID_OK on success, otherwise FLUID_FAILED
+ */
+static int fluid_defsfont_setup_all_samples(fluid_defsfont_t *defsfont, SFData *sfdata)
+{
+    fluid_defsfont_load_job_t job;
+    fluid_thread_t **threads = NULL;
+    fluid_list_t *list;
+    int i, num_threads = 0;
+
+    FLUID_MEMSET(&job, 0, sizeof(job));
+    job.defsfont = defsfont;
+    job.sfdata = sfdata;
+    job.count = fluid_list_size(defsfont->sample);
+
+    if(job.count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    job.samples = FLUID_ARRAY(fluid_sample_t *, job.count);
+
+    if(job.samples == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0, list = defsfont->sample; list; list = fluid_list_next(list), i++)
+    {
+        job.samples[i] = fluid_list_get(list);
+    }
+
+    if(defsfont->load_threads > 1 && job.count > 1)
+    {
+        num_threads = ((defsfont->load_threads < job.count) ? defsfont->load_threads : job.count) - 1;
+        threads = FLUID_ARRAY(fluid_thread_t *, num_threads);
+
+        if(threads == NULL)
+        {
+            /* Not fatal, load the samples in this thread only */
+            num_threads = 0;
+        }
+
+        for(i = 0; i < num_threads; i++)
+        {
+            threads[i] = new_fluid_thread("sfont-loader", fluid_defsfont_load_worker, &job, 0, FALSE);
+
+            if(threads[i] == NULL)
+            {
+                num_threads = i;
+                break;
+            }
+        }
+    }
+
+    fluid_defsfont_load_worker(&job);
+
+    for(i = 0; i < num_threads; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    FLUID_FREE(threads);
+    FLUID_FREE(job.samples);
+
+    return fluid_atomic_int_get(&job.failed) ? FLUID_FAILED : FLUID_OK;
+}
+
 /* Loads the sample data for all samples from the Soundfont file. For SF2 files, it loads the data in
  * one large block. For SF3 files, each compressed sample gets loaded individually.
  * Returns FLUID_OK on success, otherwise FLUID_FAILED
  */
 int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata)
 {
-    fluid_list_t *list;
-    fluid_sample_t *sample;
     int sf3_file = (sfdata->version.major == 3);
 
     /* For SF2 files, we load the sample data in one large block */
@@ -368,8 +782,9 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
         int read_samples;
         int num_samples = sfdata->samplesize / sizeof(short);
 
-        read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0, defsfont->mlock,
-                                              &defsfont->sampledata, &defsfont->sample24data);
+        read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0, defsfont->mlock, defsfont->mmap,
+                                              defsfont->cache_size, NULL, defsfont->shm, defsfont->float_samples,
+                                              &defsfont->sampledata, &defsfont->sample24data, &defsfont->samplefloatdata);
 
         if(read_samples != num_samples)
         {
@@ -379,34 +794,7 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
         }
     }
 
-    for(list = defsfont->sample; list; list = fluid_list_next(list))
-    {
-        sample = fluid_list_get(list);
-
-        if(sf3_file)
-        {
-            /* SF3 samples get loaded individually, as most (or all) of them are in Ogg Vorbis format
-             * anyway */
-            if(fluid_defsfont_load_sampledata(defsfont, sfdata, sample) == FLUID_FAILED)
-            {
-                FLUID_LOG(FLUID_ERR, "Failed to load sample '%s'", sample->name);
-                return FLUID_FAILED;
-            }
-
-            fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
-        }
-        else
-        {
-            /* Data pointers of SF2 samples point to large sample data block loaded above */
-            sample->data = defsfont->sampledata;
-            sample->data24 = defsfont->sample24data;
-            fluid_sample_sanitize_loop(sample, defsfont->samplesize);
-        }
-
-        fluid_voice_optimize_sample(sample);
-    }
-
-    return FLUID_OK;
+    return fluid_defsfont_setup_all_samples(defsfont, sfdata);
 }
 
 /*
@@ -420,7 +808,10 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
     SFSample *sfsample;
     fluid_sample_t *sample;
     fluid_defpreset_t *defpreset = NULL;
+    double load_start, start;
+    size_t arena_size;
 
+    load_start = fluid_sfont_load_stats_start(defsfont->load_stats);
     defsfont->filename = FLUID_STRDUP(file);
 
     if(defsfont->filename == NULL)
@@ -440,12 +831,17 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         return FLUID_FAILED;
     }
 
-    if(fluid_sffile_parse_presets(sfdata) == FLUID_FAILED)
+    sfdata->huge_pages = defsfont->huge_pages;
+    sfdata->load_stats = defsfont->load_stats;
+
+    if(fluid_sffile_parse_presets(sfdata, defsfont->cache_dir) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Couldn't parse presets from soundfont file");
         goto err_exit;
     }
 
+    fluid_sfont_load_stats_add(defsfont->load_stats, FLUID_SFONT_LOAD_PARSE, load_start, sfdata->hydrasize);
+
     /* Keep track of the position and size of the sample data because
        it's loaded separately (and might be unoaded/reloaded in future) */
     defsfont->samplepos = sfdata->samplepos;
@@ -454,6 +850,7 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
     defsfont->sample24size = sfdata->sample24size;
 
     /* Create all samples from sample headers */
+    start = fluid_sfont_load_stats_start(defsfont->load_stats);
     p = sfdata->sample;
 
     while(p != NULL)
@@ -483,6 +880,8 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         p = fluid_list_next(p);
     }
 
+    fluid_sfont_load_stats_add(defsfont->load_stats, FLUID_SFONT_LOAD_PRESETS, start, 0);
+
     /* If dynamic sample loading is disabled, load all samples in the Soundfont */
     if(!defsfont->dynamic_samples)
     {
@@ -494,6 +893,8 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
     }
 
     /* Load all the presets */
+    start = fluid_sfont_load_stats_start(defsfont->load_stats);
+    arena_size = fluid_arena_get_size(defsfont->arena);
     p = sfdata->preset;
 
     while(p != NULL)
@@ -506,7 +907,13 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
             goto err_exit;
         }
 
-        if(fluid_defpreset_import_sfont(defpreset, sfpreset, defsfont) != FLUID_OK)
+        if(defsfont->lazy_presets)
+        {
+            /* only import the zones once the preset is used */
+            fluid_defpreset_import_sfont_header(defpreset, sfpreset);
+            defpreset->sfpreset = sfpreset;
+        }
+        else if(fluid_defpreset_import_sfont(defpreset, sfpreset, defsfont) != FLUID_OK)
         {
             goto err_exit;
         }
@@ -516,10 +923,31 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
             goto err_exit;
         }
 
+        if(defpreset->sfpreset != NULL)
+        {
+            defsfont->num_lazy_presets++;
+        }
+
         p = fluid_list_next(p);
     }
 
-    fluid_sffile_close(sfdata);
+    fluid_sfont_load_stats_add(defsfont->load_stats, FLUID_SFONT_LOAD_PRESETS, start,
+                               fluid_arena_get_size(defsfont->arena) - arena_size);
+
+    if(defsfont->num_lazy_presets > 0)
+    {
+        /* Keep the parsed presets and instruments to import the zones of the
+         * presets later on. The sample data are not read from this handle anymore. */
+        sfdata->fcbs->fclose(sfdata->sffd);
+        sfdata->sffd = NULL;
+        defsfont->sfdata = sfdata;
+    }
+    else
+    {
+        fluid_sffile_close(sfdata);
+    }
+
+    fluid_sfont_load_stats_report(defsfont->load_stats, "Loaded SoundFont", file, load_start, NULL, NULL);
 
     return FLUID_OK;
 
@@ -585,6 +1013,11 @@ fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank,
 
         if((fluid_preset_get_banknum(preset) == bank) && (fluid_preset_get_num(preset) == num))
         {
+            if(fluid_defsfont_import_lazy_preset(defsfont, fluid_preset_get_data(preset)) != FLUID_OK)
+            {
+                return NULL;
+            }
+
             return preset;
         }
     }
@@ -593,9 +1026,52 @@ fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank,
 }
 
 /*
- * fluid_defsfont_iteration_start
+ * Import the zones of a preset left out by synth.lazy-preset-loading, if not done yet.
+ * Like the rest of the preset handling, this is called with the synth's API lock held.
  */
-void fluid_defsfont_iteration_start(fluid_defsfont_t *defsfont)
+static int
+fluid_defsfont_import_lazy_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset)
+{
+    SFPreset *sfpreset = defpreset->sfpreset;
+    double start;
+    size_t arena_size;
+    int ret;
+
+    if(sfpreset == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    start = fluid_sfont_load_stats_start(defsfont->load_stats);
+    arena_size = fluid_arena_get_size(defsfont->arena);
+
+    defpreset->sfpreset = NULL;
+    ret = fluid_defpreset_import_sfont_zones(defpreset, sfpreset, defsfont);
+
+    fluid_sfont_load_stats_add(defsfont->load_stats, FLUID_SFONT_LOAD_PRESETS, start,
+                               fluid_arena_get_size(defsfont->arena) - arena_size);
+
+    if(ret != FLUID_OK)
+    {
+        /* leave the preset without any zones, its notes won't start any voice */
+        FLUID_LOG(FLUID_ERR, "Failed to import preset '%s'", defpreset->name);
+        fluid_defpreset_delete_zones(defpreset);
+    }
+
+    /* the parsed file isn't needed anymore once all presets have been imported */
+    if(--defsfont->num_lazy_presets == 0)
+    {
+        fluid_sffile_close(defsfont->sfdata);
+        defsfont->sfdata = NULL;
+    }
+
+    return ret;
+}
+
+/*
+ * fluid_defsfont_iteration_start
+ */
+void fluid_defsfont_iteration_start(fluid_defsfont_t *defsfont)
 {
     defsfont->preset_iter_cur = defsfont->preset;
 }
@@ -637,6 +1113,11 @@ new_fluid_defpreset(void)
     defpreset->num = 0;
     defpreset->global_zone = NULL;
     defpreset->zone = NULL;
+    FLUID_MEMSET(defpreset->vel_bucket, 0, sizeof(defpreset->vel_bucket));
+    defpreset->num_vel_buckets = 0;
+    defpreset->zone_table_index = NULL;
+    defpreset->zone_table = NULL;
+    defpreset->sfpreset = NULL;
     return defpreset;
 }
 
@@ -646,23 +1127,27 @@ new_fluid_defpreset(void)
 void
 delete_fluid_defpreset(fluid_defpreset_t *defpreset)
 {
-    fluid_preset_zone_t *zone;
-
     fluid_return_if_fail(defpreset != NULL);
 
-    delete_fluid_preset_zone(defpreset->global_zone);
-    defpreset->global_zone = NULL;
-
-    zone = defpreset->zone;
+    fluid_defpreset_delete_zones(defpreset);
+    FLUID_FREE(defpreset);
+}
 
-    while(zone != NULL)
-    {
-        defpreset->zone = zone->next;
-        delete_fluid_preset_zone(zone);
-        zone = defpreset->zone;
-    }
+/*
+ * Delete the zones of a preset and its zone table. The zones themselves
+ * belong to the arena of the SoundFont and are only freed with it.
+ */
+void
+fluid_defpreset_delete_zones(fluid_defpreset_t *defpreset)
+{
+    defpreset->global_zone = NULL;
+    defpreset->zone = NULL;
 
-    FLUID_FREE(defpreset);
+    FLUID_FREE(defpreset->zone_table_index);
+    FLUID_FREE(defpreset->zone_table);
+    defpreset->zone_table_index = NULL;
+    defpreset->zone_table = NULL;
+    defpreset->num_vel_buckets = 0;
 }
 
 int
@@ -693,42 +1178,37 @@ fluid_defpreset_next(fluid_defpreset_t *defpreset)
 }
 
 /*
- * Adds global and local modulators list to the voice. This is done in 2 steps:
- * - Step 1: Local modulators replace identic global modulators.
- * - Step 2: global + local modulators are added to the voice using mode.
+ * Merges the global and local modulators list of a zone into mod_list, in the
+ * order they are added to the voice: local modulators replace identic global
+ * modulators.
  *
- * Instrument zone list (local/global) must be added using FLUID_VOICE_OVERWRITE.
- * Preset zone list (local/global) must be added using FLUID_VOICE_ADD.
+ * Instrument zone list (local/global) must be merged using FLUID_VOICE_OVERWRITE.
+ * Preset zone list (local/global) must be merged using FLUID_VOICE_ADD.
  *
- * @param voice voice instance.
+ * @param mod_list array of FLUID_NUM_MOD modulators receiving the list.
  * @param global_mod global list of modulators.
  * @param local_mod local list of modulators.
- * @param mode Determines how to handle an existing identical modulator.
+ * @param mode Determines how the modulators are added to the voice.
  *   #FLUID_VOICE_ADD to add (offset) the modulator amounts,
  *   #FLUID_VOICE_OVERWRITE to replace the modulator,
+ * @return the number of modulators in mod_list.
 */
-static void
-fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
-                                        fluid_mod_t *global_mod, fluid_mod_t *local_mod,
-                                        int mode)
+static int
+fluid_voice_zone_merge_mods(fluid_mod_t **mod_list,
+                            fluid_mod_t *global_mod, fluid_mod_t *local_mod,
+                            int mode)
 {
-    fluid_mod_t *mod;
-    /* list for 'sorting' global/local modulators */
-    fluid_mod_t *mod_list[FLUID_NUM_MOD];
-    int mod_list_count, i;
+    int mod_list_count, i, count;
 
     /* identity_limit_count is the modulator upper limit number to handle with
      * existing identical modulators.
      * When identity_limit_count is below the actual number of modulators, this
      * will restrict identity check to this upper limit,
      * This is useful when we know by advance that there is no duplicate with
-     * modulators at index above this limit. This avoid wasting cpu cycles at
-     * noteon.
+     * modulators at index above this limit.
      */
     int identity_limit_count;
 
-    /* Step 1: Local modulators replace identic global modulators. */
-
     /* local (instrument zone/preset zone), modulators: Put them all into a list. */
     mod_list_count = 0;
 
@@ -794,37 +1274,160 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
         global_mod = global_mod->next;
     }
 
-    /* Step 2: global + local modulators are added to the voice using mode. */
+    /* in mode FLUID_VOICE_OVERWRITE disabled instruments modulators CANNOT be skipped. */
+    /* in mode FLUID_VOICE_ADD disabled preset modulators can be skipped. */
+    for(i = 0, count = 0; i < mod_list_count; i++)
+    {
+        if((mode == FLUID_VOICE_OVERWRITE) || (mod_list[i]->amount != 0))
+        {
+            mod_list[count++] = mod_list[i];
+        }
+    }
 
-    /*
-     * mod_list contains local and global modulators, we know that:
-     * - there is no global modulator identic to another global modulator,
-     * - there is no local modulator identic to another local modulator,
-     * So these local/global modulators are only checked against
-     * actual number of voice modulators.
-     */
+    return count;
+}
+
+/*
+ * Precompute the generators and modulators a voice gets from the instrument
+ * zone of voice_zone and the preset zone it belongs to, both merged with
+ * their global zones, so that fluid_defpreset_noteon() only has to apply them.
+ */
+static int
+fluid_voice_zone_compile(fluid_voice_zone_t *voice_zone, fluid_preset_zone_t *preset_zone,
+                         fluid_preset_zone_t *global_preset_zone, fluid_arena_t *arena)
+{
+    fluid_inst_zone_t *inst_zone = voice_zone->inst_zone;
+    fluid_inst_zone_t *global_inst_zone = fluid_inst_get_global_zone(preset_zone->inst);
+    fluid_voice_zone_gen_t gen[2 * GEN_LAST];
+    fluid_mod_t *mod[2 * FLUID_NUM_MOD];
+    int i, num_gens, num_mods;
 
-    /* Restrict identity check to the actual number of voice modulators */
-    /* Actual number of voice modulators : defaults + [instruments] */
-    identity_limit_count = voice->mod_count;
+    /* Instrument level, generators */
+    num_gens = 0;
 
-    for(i = 0; i < mod_list_count; i++)
+    for(i = 0; i < GEN_LAST; i++)
     {
+        /* SF 2.01 section 9.4 'bullet' 4:
+         *
+         * A generator in a local instrument zone supersedes a
+         * global instrument zone generator.  Both cases supersede
+         * the default generator -> voice_gen_set */
+
+        if(inst_zone->gen[i].flags)
+        {
+            gen[num_gens].num = (unsigned char)i;
+            gen[num_gens++].val = inst_zone->gen[i].val;
+        }
+        else if((global_inst_zone != NULL) && (global_inst_zone->gen[i].flags))
+        {
+            gen[num_gens].num = (unsigned char)i;
+            gen[num_gens++].val = global_inst_zone->gen[i].val;
+        }
+    }
 
-        mod = mod_list[i];
-        /* in mode FLUID_VOICE_OVERWRITE disabled instruments modulators CANNOT be skipped. */
-        /* in mode FLUID_VOICE_ADD disabled preset modulators can be skipped. */
+    voice_zone->num_inst_gens = num_gens;
+
+    /* Preset level, generators */
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        /* SF 2.01 section 8.5 page 58: If some generators are
+         encountered at preset level, they should be ignored.
+         However this check is not necessary when the soundfont
+         loader has ignored invalid preset generators.
+         Actually load_pgen()has ignored these invalid preset
+         generators:
+           GEN_STARTADDROFS,      GEN_ENDADDROFS,
+           GEN_STARTLOOPADDROFS,  GEN_ENDLOOPADDROFS,
+           GEN_STARTADDRCOARSEOFS,GEN_ENDADDRCOARSEOFS,
+           GEN_STARTLOOPADDRCOARSEOFS,
+           GEN_KEYNUM, GEN_VELOCITY,
+           GEN_ENDLOOPADDRCOARSEOFS,
+           GEN_SAMPLEMODE, GEN_EXCLUSIVECLASS,GEN_OVERRIDEROOTKEY
+        */
+
+        /* SF 2.01 section 9.4 'bullet' 9: A generator in a
+         * local preset zone supersedes a global preset zone
+         * generator.  The effect is -added- to the destination
+         * summing node -> voice_gen_incr */
 
-        if((mode == FLUID_VOICE_OVERWRITE) || (mod->amount != 0))
+        if(preset_zone->gen[i].flags)
         {
-            /* Instrument modulators -supersede- existing (default) modulators.
-               SF 2.01 page 69, 'bullet' 6 */
+            gen[num_gens].num = (unsigned char)i;
+            gen[num_gens++].val = preset_zone->gen[i].val;
+        }
+        else if((global_preset_zone != NULL) && global_preset_zone->gen[i].flags)
+        {
+            gen[num_gens].num = (unsigned char)i;
+            gen[num_gens++].val = global_preset_zone->gen[i].val;
+        }
+    }
 
-            /* Preset modulators -add- to existing instrument modulators.
-               SF2.01 page 70 first bullet on page */
-            fluid_voice_add_mod_local(voice, mod, mode, identity_limit_count);
+    voice_zone->num_preset_gens = num_gens - voice_zone->num_inst_gens;
+
+    /* instrument zone modulators (global and local), then preset zone modulators */
+    voice_zone->num_inst_mods = fluid_voice_zone_merge_mods(mod,
+                                global_inst_zone ? global_inst_zone->mod : NULL,
+                                inst_zone->mod, FLUID_VOICE_OVERWRITE);
+    voice_zone->num_preset_mods = fluid_voice_zone_merge_mods(mod + voice_zone->num_inst_mods,
+                                  global_preset_zone ? global_preset_zone->mod : NULL,
+                                  preset_zone->mod, FLUID_VOICE_ADD);
+    num_mods = voice_zone->num_inst_mods + voice_zone->num_preset_mods;
+
+    /* taken from the arena right after the voice zones of the preset zone,
+     * so that starting a voice reads them from nearby memory */
+    voice_zone->gen = NULL;
+    voice_zone->mod = NULL;
+
+    if(num_gens > 0)
+    {
+        voice_zone->gen = fluid_arena_alloc(arena, num_gens * sizeof(*gen));
+
+        if(voice_zone->gen == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMCPY(voice_zone->gen, gen, num_gens * sizeof(*gen));
+    }
+
+    if(num_mods > 0)
+    {
+        voice_zone->mod = fluid_arena_alloc(arena, num_mods * sizeof(*mod));
+
+        if(voice_zone->mod == NULL)
+        {
+            return FLUID_FAILED;
         }
+
+        FLUID_MEMCPY(voice_zone->mod, mod, num_mods * sizeof(*mod));
     }
+
+    return FLUID_OK;
+}
+
+/*
+ * Precompute the generators and modulators of all voice zones of the preset,
+ * once all of its zones have been added.
+ */
+static int
+fluid_defpreset_compile_voice_zones(fluid_defpreset_t *defpreset, fluid_arena_t *arena)
+{
+    fluid_preset_zone_t *preset_zone;
+    int i;
+
+    for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+    {
+        for(i = 0; i < preset_zone->num_voice_zones; i++)
+        {
+            if(fluid_voice_zone_compile(&preset_zone->voice_zone[i], preset_zone,
+                                        defpreset->global_zone, arena) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+        }
+    }
+
+    return FLUID_OK;
 }
 
 /*
@@ -833,154 +1436,103 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
 int
 fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int chan, int key, int vel)
 {
-    fluid_preset_zone_t *preset_zone, *global_preset_zone;
-    fluid_inst_t *inst;
-    fluid_inst_zone_t *inst_zone, *global_inst_zone;
     fluid_voice_zone_t *voice_zone;
-    fluid_list_t *list;
+    fluid_voice_zone_gen_t *gen;
+    fluid_mod_t **mod;
     fluid_voice_t *voice;
-    int i;
+    fluid_voice_batch_t batch;
+    int i, cell, entry, last_entry, identity_limit_count;
 
-    global_preset_zone = fluid_defpreset_get_global_zone(defpreset);
+    /* no zone can match a note outside the MIDI range, nor one of a preset
+     * without zone table because its zones failed to be imported */
+    if(key < 0 || key > 127 || vel < 0 || vel > 127 || defpreset->zone_table_index == NULL)
+    {
+        return FLUID_OK;
+    }
 
-    /* run thru all the zones of this preset */
-    preset_zone = fluid_defpreset_get_zone(defpreset);
+    /* run thru all the zones of this preset whose key and velocity range
+       contains the note, as looked up in the zone table */
+    cell = key * defpreset->num_vel_buckets + defpreset->vel_bucket[vel];
+    entry = defpreset->zone_table_index[cell];
+    last_entry = defpreset->zone_table_index[cell + 1];
+    batch.count = 0;
 
-    while(preset_zone != NULL)
+    for(; entry < last_entry; entry++)
     {
+        voice_zone = defpreset->zone_table[entry].voice_zone;
 
-        /* check if the note falls into the key and velocity range of this
-           preset */
-        if(fluid_zone_inside_range(&preset_zone->range, key, vel))
+        /* check if the instrument zone is ignored.
+           An instrument zone must be ignored when its voice is already running
+           played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
+        if(fluid_zone_inside_range(&voice_zone->range, key, vel))
         {
-
-            inst = fluid_preset_zone_get_inst(preset_zone);
-            global_inst_zone = fluid_inst_get_global_zone(inst);
-
-            /* run thru all the zones of this instrument that could start a voice */
-            for(list = preset_zone->voice_zone; list != NULL; list = fluid_list_next(list))
+            /* the sample data of a preset just selected may still be loading in the background */
+            if(voice_zone->inst_zone->sample != NULL
+                    && fluid_atomic_int_get(&voice_zone->inst_zone->sample->loading))
             {
-                voice_zone = fluid_list_get(list);
-
-                /* check if the instrument zone is ignored and the note falls into
-                   the key and velocity range of this  instrument zone.
-                   An instrument zone must be ignored when its voice is already running
-                   played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
-                if(fluid_zone_inside_range(&voice_zone->range, key, vel))
-                {
-
-                    inst_zone = voice_zone->inst_zone;
-
-                    /* this is a good zone. allocate a new synthesis process and initialize it */
-                    voice = fluid_synth_alloc_voice_LOCAL(synth, inst_zone->sample, chan, key, vel, &voice_zone->range);
-
-                    if(voice == NULL)
-                    {
-                        return FLUID_FAILED;
-                    }
-
+                continue;
+            }
 
-                    /* Instrument level, generators */
+            /* this is a good zone. allocate a new synthesis process and initialize it */
+            voice = fluid_synth_alloc_voice_LOCAL(synth, voice_zone->inst_zone->sample, chan, key, vel, &voice_zone->range);
 
-                    for(i = 0; i < GEN_LAST; i++)
-                    {
+            if(voice == NULL)
+            {
+                /* the voices started so far play nevertheless */
+                fluid_synth_commit_voice_batch_LOCAL(synth, &batch);
+                return FLUID_FAILED;
+            }
 
-                        /* SF 2.01 section 9.4 'bullet' 4:
-                         *
-                         * A generator in a local instrument zone supersedes a
-                         * global instrument zone generator.  Both cases supersede
-                         * the default generator -> voice_gen_set */
+            /* Instrument level generators and modulators supersede the default ones,
+             * preset level generators and modulators add to them. */
+            gen = voice_zone->gen;
 
-                        if(inst_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_set(voice, i, inst_zone->gen[i].val);
+            for(i = 0; i < voice_zone->num_inst_gens; i++)
+            {
+                fluid_voice_gen_set(voice, gen[i].num, gen[i].val);
+            }
 
-                        }
-                        else if((global_inst_zone != NULL) && (global_inst_zone->gen[i].flags))
-                        {
-                            fluid_voice_gen_set(voice, i, global_inst_zone->gen[i].val);
+            for(gen += i, i = 0; i < voice_zone->num_preset_gens; i++)
+            {
+                fluid_voice_gen_incr(voice, gen[i].num, gen[i].val);
+            }
 
-                        }
-                        else
-                        {
-                            /* The generator has not been defined in this instrument.
-                             * Do nothing, leave it at the default.
-                             */
-                        }
+            /* Instrument modulators -supersede- existing (default) modulators.
+               SF 2.01 page 69, 'bullet' 6.
+               The modulators of a zone are checked for identity against the
+               voice modulators existing before they are added only. */
+            mod = voice_zone->mod;
+            identity_limit_count = voice->mod_count;
 
-                    } /* for all generators */
+            for(i = 0; i < voice_zone->num_inst_mods; i++)
+            {
+                fluid_voice_add_mod_local(voice, mod[i], FLUID_VOICE_OVERWRITE, identity_limit_count);
+            }
 
-                    /* Adds instrument zone modulators (global and local) to the voice.*/
-                    fluid_defpreset_noteon_add_mod_to_voice(voice,
-                                                            /* global instrument modulators */
-                                                            global_inst_zone ? global_inst_zone->mod : NULL,
-                                                            inst_zone->mod, /* local instrument modulators */
-                                                            FLUID_VOICE_OVERWRITE); /* mode */
+            /* Preset modulators -add- to existing instrument modulators.
+               SF2.01 page 70 first bullet on page */
+            identity_limit_count = voice->mod_count;
 
-                    /* Preset level, generators */
+            for(mod += i, i = 0; i < voice_zone->num_preset_mods; i++)
+            {
+                fluid_voice_add_mod_local(voice, mod[i], FLUID_VOICE_ADD, identity_limit_count);
+            }
 
-                    for(i = 0; i < GEN_LAST; i++)
-                    {
+            /* start the synthesis process, it is added to the synthesis
+               loop together with the other voices of this noteon. */
+            fluid_synth_start_voice_batch_LOCAL(synth, voice, &batch);
 
-                        /* SF 2.01 section 8.5 page 58: If some generators are
-                         encountered at preset level, they should be ignored.
-                         However this check is not necessary when the soundfont
-                         loader has ignored invalid preset generators.
-                         Actually load_pgen()has ignored these invalid preset
-                         generators:
-                           GEN_STARTADDROFS,      GEN_ENDADDROFS,
-                           GEN_STARTLOOPADDROFS,  GEN_ENDLOOPADDROFS,
-                           GEN_STARTADDRCOARSEOFS,GEN_ENDADDRCOARSEOFS,
-                           GEN_STARTLOOPADDRCOARSEOFS,
-                           GEN_KEYNUM, GEN_VELOCITY,
-                           GEN_ENDLOOPADDRCOARSEOFS,
-                           GEN_SAMPLEMODE, GEN_EXCLUSIVECLASS,GEN_OVERRIDEROOTKEY
-                        */
-
-                        /* SF 2.01 section 9.4 'bullet' 9: A generator in a
-                         * local preset zone supersedes a global preset zone
-                         * generator.  The effect is -added- to the destination
-                         * summing node -> voice_gen_incr */
-
-                        if(preset_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_incr(voice, i, preset_zone->gen[i].val);
-                        }
-                        else if((global_preset_zone != NULL) && global_preset_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_incr(voice, i, global_preset_zone->gen[i].val);
-                        }
-                        else
-                        {
-                            /* The generator has not been defined in this preset
-                             * Do nothing, leave it unchanged.
-                             */
-                        }
-                    } /* for all generators */
-
-                    /* Adds preset zone modulators (global and local) to the voice.*/
-                    fluid_defpreset_noteon_add_mod_to_voice(voice,
-                                                            /* global preset modulators */
-                                                            global_preset_zone ? global_preset_zone->mod : NULL,
-                                                            preset_zone->mod, /* local preset modulators */
-                                                            FLUID_VOICE_ADD); /* mode */
-
-                    /* add the synthesis process to the synthesis loop. */
-                    fluid_synth_start_voice(synth, voice);
-
-                    /* Store the ID of the first voice that was created by this noteon event.
-                     * Exclusive class may only terminate older voices.
-                     * That avoids killing voices, which have just been created.
-                     * (a noteon event can create several voice processes with the same exclusive
-                     * class - for example when using stereo samples)
-                     */
-                }
-            }
+            /* Store the ID of the first voice that was created by this noteon event.
+             * Exclusive class may only terminate older voices.
+             * That avoids killing voices, which have just been created.
+             * (a noteon event can create several voice processes with the same exclusive
+             * class - for example when using stereo samples)
+             */
         }
-
-        preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
+    fluid_synth_commit_voice_batch_LOCAL(synth, &batch);
+
     return FLUID_OK;
 }
 
@@ -1002,12 +1554,17 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
                              SFPreset *sfpreset,
                              fluid_defsfont_t *defsfont)
 {
-    fluid_list_t *p;
-    SFZone *sfzone;
-    fluid_preset_zone_t *zone;
-    int count;
-    char zone_name[256];
+    fluid_defpreset_import_sfont_header(defpreset, sfpreset);
+
+    return fluid_defpreset_import_sfont_zones(defpreset, sfpreset, defsfont);
+}
 
+/*
+ * Import the name, bank and number of a preset
+ */
+static void
+fluid_defpreset_import_sfont_header(fluid_defpreset_t *defpreset, SFPreset *sfpreset)
+{
     if(FLUID_STRLEN(sfpreset->name) > 0)
     {
         FLUID_STRCPY(defpreset->name, sfpreset->name);
@@ -1019,6 +1576,21 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
 
     defpreset->bank = sfpreset->bank;
     defpreset->num = sfpreset->prenum;
+}
+
+/*
+ * Import the zones of a preset, and build the tables used to start its voices
+ */
+static int
+fluid_defpreset_import_sfont_zones(fluid_defpreset_t *defpreset, SFPreset *sfpreset,
+                                   fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *p;
+    SFZone *sfzone;
+    fluid_preset_zone_t *zone;
+    int count;
+    char zone_name[256];
+
     p = sfpreset->zone;
     count = 0;
 
@@ -1026,7 +1598,7 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
     {
         sfzone = (SFZone *)fluid_list_get(p);
         FLUID_SNPRINTF(zone_name, sizeof(zone_name), "pz:%s/%d", defpreset->name, count);
-        zone = new_fluid_preset_zone(zone_name);
+        zone = new_fluid_preset_zone(defsfont->arena, zone_name);
 
         if(zone == NULL)
         {
@@ -1035,7 +1607,6 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
 
         if(fluid_preset_zone_import_sfont(zone, sfzone, defsfont) != FLUID_OK)
         {
-            delete_fluid_preset_zone(zone);
             return FLUID_FAILED;
         }
 
@@ -1052,6 +1623,153 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
         count++;
     }
 
+    if(fluid_defpreset_compile_voice_zones(defpreset, defsfont->arena) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    return fluid_defpreset_build_zone_table(defpreset);
+}
+
+/*
+ * Count the zone table entries for the given key and velocity, and store them
+ * into table if it isn't NULL.
+ */
+static int
+fluid_defpreset_collect_zones(fluid_defpreset_t *defpreset, int key, int vel,
+                              fluid_zone_table_entry_t *table)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+    int i, count = 0;
+
+    for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+    {
+        /* the range of a voice zone is already contained in the range of its preset zone */
+        for(i = 0; i < preset_zone->num_voice_zones; i++)
+        {
+            voice_zone = &preset_zone->voice_zone[i];
+
+            /* don't use fluid_zone_inside_range() here, it would reset the ignore flag */
+            if(voice_zone->range.keylo <= key && voice_zone->range.keyhi >= key
+                    && voice_zone->range.vello <= vel && voice_zone->range.velhi >= vel)
+            {
+                if(table != NULL)
+                {
+                    table[count].preset_zone = preset_zone;
+                    table[count].voice_zone = voice_zone;
+                }
+
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+/*
+ * fluid_defpreset_build_zone_table
+ *
+ * Precompute the voice zones matching each key and velocity, so that
+ * fluid_defpreset_noteon() doesn't have to search the zones of the preset.
+ * Velocities are grouped into buckets delimited by the lower and upper
+ * velocity limits of all voice zones, so that the table stays small.
+ */
+static int
+fluid_defpreset_build_zone_table(fluid_defpreset_t *defpreset)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+    unsigned char bucket_start[128 + 1];
+    int bucket_vel[128];
+    int i, key, vel, bucket, cell, count;
+
+    FLUID_MEMSET(bucket_start, 0, sizeof(bucket_start));
+    bucket_start[0] = TRUE;
+
+    for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+    {
+        for(i = 0; i < preset_zone->num_voice_zones; i++)
+        {
+            voice_zone = &preset_zone->voice_zone[i];
+
+            if(voice_zone->range.vello > 0 && voice_zone->range.vello <= 127)
+            {
+                bucket_start[voice_zone->range.vello] = TRUE;
+            }
+
+            if(voice_zone->range.velhi >= 0 && voice_zone->range.velhi < 127)
+            {
+                bucket_start[voice_zone->range.velhi + 1] = TRUE;
+            }
+        }
+    }
+
+    bucket = -1;
+
+    for(vel = 0; vel < 128; vel++)
+    {
+        if(bucket_start[vel])
+        {
+            bucket++;
+            bucket_vel[bucket] = vel;
+        }
+
+        defpreset->vel_bucket[vel] = (unsigned char)bucket;
+    }
+
+    defpreset->num_vel_buckets = bucket + 1;
+
+    FLUID_FREE(defpreset->zone_table_index);
+    FLUID_FREE(defpreset->zone_table);
+    defpreset->zone_table = NULL;
+    defpreset->zone_table_index = FLUID_ARRAY(int, 128 * defpreset->num_vel_buckets + 1);
+
+    if(defpreset->zone_table_index == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* first pass: count the entries of each key and velocity bucket */
+    count = 0;
+
+    for(key = 0; key < 128; key++)
+    {
+        for(bucket = 0; bucket < defpreset->num_vel_buckets; bucket++)
+        {
+            cell = key * defpreset->num_vel_buckets + bucket;
+            defpreset->zone_table_index[cell] = count;
+            count += fluid_defpreset_collect_zones(defpreset, key, bucket_vel[bucket], NULL);
+        }
+    }
+
+    defpreset->zone_table_index[128 * defpreset->num_vel_buckets] = count;
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    defpreset->zone_table = FLUID_ARRAY(fluid_zone_table_entry_t, count);
+
+    if(defpreset->zone_table == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* second pass: store the entries */
+    for(cell = 0, key = 0; key < 128; key++)
+    {
+        for(bucket = 0; bucket < defpreset->num_vel_buckets; bucket++, cell++)
+        {
+            fluid_defpreset_collect_zones(defpreset, key, bucket_vel[bucket],
+                                          &defpreset->zone_table[defpreset->zone_table_index[cell]]);
+        }
+    }
+
     return FLUID_OK;
 }
 
@@ -1111,25 +1829,23 @@ fluid_preset_zone_next(fluid_preset_zone_t *zone)
  * new_fluid_preset_zone
  */
 fluid_preset_zone_t *
-new_fluid_preset_zone(char *name)
+new_fluid_preset_zone(fluid_arena_t *arena, char *name)
 {
     fluid_preset_zone_t *zone = NULL;
-    zone = FLUID_NEW(fluid_preset_zone_t);
+    zone = fluid_arena_alloc(arena, sizeof(fluid_preset_zone_t));
 
     if(zone == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
     zone->next = NULL;
     zone->voice_zone = NULL;
-    zone->name = FLUID_STRDUP(name);
+    zone->num_voice_zones = 0;
+    zone->name = fluid_arena_strdup(arena, name);
 
     if(zone->name == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        FLUID_FREE(zone);
         return NULL;
     }
 
@@ -1158,68 +1874,63 @@ void delete_fluid_list_mod(fluid_mod_t *mod)
     while(mod)	/* delete the modulators */
     {
         tmp = mod;
-        mod = mod->next;
-        delete_fluid_mod(tmp);
-    }
-}
-
-/*
- * delete_fluid_preset_zone
- */
-void
-delete_fluid_preset_zone(fluid_preset_zone_t *zone)
-{
-    fluid_list_t *list;
-
-    fluid_return_if_fail(zone != NULL);
-
-    delete_fluid_list_mod(zone->mod);
-
-    for(list = zone->voice_zone; list != NULL; list = fluid_list_next(list))
-    {
-        FLUID_FREE(fluid_list_get(list));
+        mod = mod->next;
+        delete_fluid_mod(tmp);
     }
+}
 
-    delete_fluid_list(zone->voice_zone);
+/* We only create voice ranges for zones that could actually start a voice,
+ * i.e. that have a sample and don't point to ROM */
+static int fluid_inst_zone_can_start_voice(fluid_inst_zone_t *inst_zone)
+{
+    fluid_sample_t *sample = fluid_inst_zone_get_sample(inst_zone);
 
-    FLUID_FREE(zone->name);
-    FLUID_FREE(zone);
+    return (sample != NULL) && !fluid_sample_in_rom(sample);
 }
 
-static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone)
+static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone, fluid_arena_t *arena)
 {
     fluid_inst_zone_t *inst_zone;
-    fluid_sample_t *sample;
     fluid_voice_zone_t *voice_zone;
     fluid_zone_range_t *irange;
     fluid_zone_range_t *prange = &preset_zone->range;
+    int count = 0;
 
     fluid_return_val_if_fail(preset_zone->inst != NULL, FLUID_FAILED);
 
-    inst_zone = fluid_inst_get_zone(preset_zone->inst);
-
-    while(inst_zone != NULL)
+    for(inst_zone = fluid_inst_get_zone(preset_zone->inst); inst_zone != NULL;
+            inst_zone = fluid_inst_zone_next(inst_zone))
     {
+        count += fluid_inst_zone_can_start_voice(inst_zone);
+    }
 
-        /* We only create voice ranges for zones that could actually start a voice,
-         * i.e. that have a sample and don't point to ROM */
-        sample = fluid_inst_zone_get_sample(inst_zone);
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
 
-        if((sample == NULL) || fluid_sample_in_rom(sample))
-        {
-            inst_zone = fluid_inst_zone_next(inst_zone);
-            continue;
-        }
+    /* all voice zones of the preset zone in one array, looked up one after the other */
+    preset_zone->voice_zone = fluid_arena_alloc(arena, count * sizeof(fluid_voice_zone_t));
 
-        voice_zone = FLUID_NEW(fluid_voice_zone_t);
+    if(preset_zone->voice_zone == NULL)
+    {
+        return FLUID_FAILED;
+    }
 
-        if(voice_zone == NULL)
+    for(inst_zone = fluid_inst_get_zone(preset_zone->inst); inst_zone != NULL;
+            inst_zone = fluid_inst_zone_next(inst_zone))
+    {
+        if(!fluid_inst_zone_can_start_voice(inst_zone))
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            return FLUID_FAILED;
+            continue;
         }
 
+        voice_zone = &preset_zone->voice_zone[preset_zone->num_voice_zones++];
         voice_zone->inst_zone = inst_zone;
+        voice_zone->gen = NULL;
+        voice_zone->mod = NULL;
+        voice_zone->num_inst_gens = voice_zone->num_preset_gens = 0;
+        voice_zone->num_inst_mods = voice_zone->num_preset_mods = 0;
 
         irange = &inst_zone->range;
 
@@ -1228,10 +1939,6 @@ static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone
         voice_zone->range.vello = (prange->vello > irange->vello) ? prange->vello : irange->vello;
         voice_zone->range.velhi = (prange->velhi < irange->velhi) ? prange->velhi : irange->velhi;
         voice_zone->range.ignore = FALSE;
-
-        preset_zone->voice_zone = fluid_list_append(preset_zone->voice_zone, voice_zone);
-
-        inst_zone = fluid_inst_zone_next(inst_zone);
     }
 
     return FLUID_OK;
@@ -1296,7 +2003,7 @@ static void fluid_limit_mod_list(char *zone_name, fluid_mod_t **list_mod)
                 *list_mod = NULL;
             }
 
-            delete_fluid_list_mod(mod);
+            /* the modulators cut off stay in the arena of the SoundFont */
             FLUID_LOG(FLUID_WARN, "%s, modulators count limited to %d", zone_name,
                       FLUID_NUM_MOD);
             break;
@@ -1344,8 +2051,6 @@ fluid_zone_check_mod(char *zone_name, fluid_mod_t **list_mod)
             {
                 *list_mod = next;
             }
-
-            delete_fluid_mod(mod); /* freeing */
         }
         else
         {
@@ -1496,22 +2201,33 @@ fluid_zone_mod_source_import_sfont(unsigned char *src, unsigned char *flags, uns
  * @return FLUID_OK if success, FLUID_FAILED otherwise.
  */
 static int
-fluid_zone_mod_import_sfont(char *zone_name, fluid_mod_t **mod, SFZone *sfzone)
+fluid_zone_mod_import_sfont(char *zone_name, fluid_mod_t **mod, SFZone *sfzone, fluid_arena_t *arena)
 {
     fluid_list_t *r;
+    fluid_mod_t *mods;
     int count;
 
+    count = fluid_list_size(sfzone->mod);
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    /* the modulators of the zone are stored next to each other */
+    mods = fluid_arena_alloc(arena, count * sizeof(fluid_mod_t));
+
+    if(mods == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
     /* Import the modulators (only SF2.1 and higher) */
     for(count = 0, r = sfzone->mod; r != NULL; count++)
     {
 
         SFMod *mod_src = (SFMod *)fluid_list_get(r);
-        fluid_mod_t *mod_dest = new_fluid_mod();
-
-        if(mod_dest == NULL)
-        {
-            return FLUID_FAILED;
-        }
+        fluid_mod_t *mod_dest = &mods[count];
 
         mod_dest->next = NULL; /* pointer to next modulator, this is the end of the list now.*/
 
@@ -1579,15 +2295,7 @@ fluid_zone_mod_import_sfont(char *zone_name, fluid_mod_t **mod, SFZone *sfzone)
         }
         else
         {
-            fluid_mod_t *last_mod = *mod;
-
-            /* Find the end of the list */
-            while(last_mod->next != NULL)
-            {
-                last_mod = last_mod->next;
-            }
-
-            last_mod->next = mod_dest;
+            mods[count - 1].next = mod_dest;
         }
 
         r = fluid_list_next(r);
@@ -1623,14 +2331,14 @@ fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, SFZone *sfzone, fluid_
             return FLUID_FAILED;
         }
 
-        if(fluid_preset_zone_create_voice_zones(zone) == FLUID_FAILED)
+        if(fluid_preset_zone_create_voice_zones(zone, defsfont->arena) == FLUID_FAILED)
         {
             return FLUID_FAILED;
         }
     }
 
     /* Import the modulators (only SF2.1 and higher) */
-    return fluid_zone_mod_import_sfont(zone->name, &zone->mod, sfzone);
+    return fluid_zone_mod_import_sfont(zone->name, &zone->mod, sfzone, defsfont->arena);
 }
 
 /*
@@ -1652,13 +2360,12 @@ fluid_preset_zone_get_inst(fluid_preset_zone_t *zone)
  * new_fluid_inst
  */
 fluid_inst_t *
-new_fluid_inst()
+new_fluid_inst(fluid_arena_t *arena)
 {
-    fluid_inst_t *inst = FLUID_NEW(fluid_inst_t);
+    fluid_inst_t *inst = fluid_arena_alloc(arena, sizeof(fluid_inst_t));
 
     if(inst == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
@@ -1668,31 +2375,6 @@ new_fluid_inst()
     return inst;
 }
 
-/*
- * delete_fluid_inst
- */
-void
-delete_fluid_inst(fluid_inst_t *inst)
-{
-    fluid_inst_zone_t *zone;
-
-    fluid_return_if_fail(inst != NULL);
-
-    delete_fluid_inst_zone(inst->global_zone);
-    inst->global_zone = NULL;
-
-    zone = inst->zone;
-
-    while(zone != NULL)
-    {
-        inst->zone = zone->next;
-        delete_fluid_inst_zone(zone);
-        zone = inst->zone;
-    }
-
-    FLUID_FREE(inst);
-}
-
 /*
  * fluid_inst_set_global_zone
  */
@@ -1716,11 +2398,10 @@ fluid_inst_import_sfont(SFInst *sfinst, fluid_defsfont_t *defsfont)
     char zone_name[256];
     int count;
 
-    inst = (fluid_inst_t *) new_fluid_inst();
+    inst = new_fluid_inst(defsfont->arena);
 
     if(inst == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
@@ -1746,7 +2427,7 @@ fluid_inst_import_sfont(SFInst *sfinst, fluid_defsfont_t *defsfont)
         /* instrument zone name */
         FLUID_SNPRINTF(zone_name, sizeof(zone_name), "iz:%s/%d", inst->name, count);
 
-        inst_zone = new_fluid_inst_zone(zone_name);
+        inst_zone = new_fluid_inst_zone(defsfont->arena, zone_name);
 
         if(inst_zone == NULL)
         {
@@ -1755,7 +2436,6 @@ fluid_inst_import_sfont(SFInst *sfinst, fluid_defsfont_t *defsfont)
 
         if(fluid_inst_zone_import_sfont(inst_zone, sfzone, defsfont) != FLUID_OK)
         {
-            delete_fluid_inst_zone(inst_zone);
             return NULL;
         }
 
@@ -1824,24 +2504,21 @@ fluid_inst_get_global_zone(fluid_inst_t *inst)
  * new_fluid_inst_zone
  */
 fluid_inst_zone_t *
-new_fluid_inst_zone(char *name)
+new_fluid_inst_zone(fluid_arena_t *arena, char *name)
 {
     fluid_inst_zone_t *zone = NULL;
-    zone = FLUID_NEW(fluid_inst_zone_t);
+    zone = fluid_arena_alloc(arena, sizeof(fluid_inst_zone_t));
 
     if(zone == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
     zone->next = NULL;
-    zone->name = FLUID_STRDUP(name);
+    zone->name = fluid_arena_strdup(arena, name);
 
     if(zone->name == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        FLUID_FREE(zone);
         return NULL;
     }
 
@@ -1858,20 +2535,6 @@ new_fluid_inst_zone(char *name)
     return zone;
 }
 
-/*
- * delete_fluid_inst_zone
- */
-void
-delete_fluid_inst_zone(fluid_inst_zone_t *zone)
-{
-    fluid_return_if_fail(zone != NULL);
-
-    delete_fluid_list_mod(zone->mod);
-
-    FLUID_FREE(zone->name);
-    FLUID_FREE(zone);
-}
-
 /*
  * fluid_inst_zone_next
  */
@@ -1902,7 +2565,7 @@ fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, SFZone *sfzone, fluid
     }
 
     /* Import the modulators (only SF2.1 and higher) */
-    return fluid_zone_mod_import_sfont(inst_zone->name, &inst_zone->mod, sfzone);
+    return fluid_zone_mod_import_sfont(inst_zone->name, &inst_zone->mod, sfzone, defsfont->arena);
 }
 
 /*
@@ -1993,21 +2656,26 @@ static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
     return FLUID_OK;
 }
 
-/* Called if a preset has been selected for or unselected from a channel. Used by
- * dynamic sample loading to load and unload samples on demand. */
+/* Called if a preset has been selected for or unselected from a channel, or is
+ * about to be. Used by dynamic sample loading to load and unload samples on demand. */
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan)
 {
     fluid_defsfont_t *defsfont;
 
-    if(reason == FLUID_PRESET_SELECTED)
+    /* A preset about to be selected is loaded the same, until it is selected
+     * indeed or no longer about to be */
+    if(reason == FLUID_PRESET_SELECTED || reason == FLUID_PRESET_PRELOAD)
     {
-        FLUID_LOG(FLUID_DBG, "Selected preset '%s' on channel %d", fluid_preset_get_name(preset), chan);
+        FLUID_LOG(FLUID_DBG, "%s preset '%s' on channel %d", (reason == FLUID_PRESET_SELECTED) ? "Selected" : "Preloading",
+                  fluid_preset_get_name(preset), chan);
         defsfont = fluid_sfont_get_data(preset->sfont);
+        fluid_defsfont_import_lazy_preset(defsfont, fluid_preset_get_data(preset));
         load_preset_samples(defsfont, preset);
     }
-    else if(reason == FLUID_PRESET_UNSELECTED)
+    else if(reason == FLUID_PRESET_UNSELECTED || reason == FLUID_PRESET_PRELOAD_DONE)
     {
-        FLUID_LOG(FLUID_DBG, "Deselected preset '%s' from channel %d", fluid_preset_get_name(preset), chan);
+        FLUID_LOG(FLUID_DBG, "%s preset '%s' from channel %d", (reason == FLUID_PRESET_UNSELECTED) ? "Deselected" : "Done preloading",
+                  fluid_preset_get_name(preset), chan);
         defsfont = fluid_sfont_get_data(preset->sfont);
         unload_preset_samples(defsfont, preset);
     }
@@ -2016,8 +2684,44 @@ static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int
 }
 
 
+/* Load the sample data of a sample used by a selected preset, disabling it if it
+ * fails. Used by dynamic sample loading. */
+static void load_preset_sample(fluid_defsfont_t *defsfont, SFData *sffile, fluid_sample_t *sample)
+{
+    if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
+    {
+        fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
+        fluid_defsfont_optimize_sample(defsfont, sample);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
+        sample->start = sample->end = 0;
+    }
+}
+
+/* Start reading the sample data of a sample about to be loaded along with others, so that
+ * they are read all at once, see synth.dynamic-sample-loading-reads. Not for the samples
+ * mapped or shared rather than read, nor for the ones cached already. */
+static void read_ahead_sample(fluid_defsfont_t *defsfont, SFData *sffile, fluid_sample_t *sample)
+{
+    unsigned int source_end;
+
+    if(defsfont->read_depth <= 1 || defsfont->mmap || defsfont->shm)
+    {
+        return;
+    }
+
+    source_end = fluid_defsfont_get_source_end(defsfont, sample);
+
+    if(!fluid_samplecache_contains(sffile, sample->source_start, source_end, sample->sampletype))
+    {
+        fluid_sffile_read_ahead(sffile, sample->source_start, source_end, sample->sampletype, defsfont->read_depth);
+    }
+}
+
 /* Walk through all samples used by the passed in preset and make sure that the
- * sample data is loaded for each sample. Used by dynamic sample loading. */
+ * sample data is loaded for each sample, read all at once. Used by dynamic sample loading. */
 static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
 {
     fluid_defpreset_t *defpreset;
@@ -2026,6 +2730,23 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
     fluid_inst_zone_t *inst_zone;
     fluid_sample_t *sample;
     SFData *sffile = NULL;
+    fluid_list_t *samples = NULL, *p;
+    double start, msec_before[FLUID_SFONT_LOAD_LAST];
+    size_t bytes_before[FLUID_SFONT_LOAD_LAST];
+    fluid_trace_ref_var(trace_ref);
+
+    /* the loader thread is started by the first preset selected */
+    if(defsfont->async_samples && (defsfont->loader != NULL || fluid_defsfont_start_loader(defsfont) == FLUID_OK))
+    {
+        return queue_preset_samples(defsfont, preset);
+    }
+
+    start = fluid_sfont_load_stats_start(defsfont->load_stats);
+
+    if(defsfont->load_stats != NULL)
+    {
+        fluid_sfont_load_stats_get(defsfont->load_stats, msec_before, bytes_before);
+    }
 
     defpreset = fluid_preset_get_data(preset);
     preset_zone = fluid_defpreset_get_zone(defpreset);
@@ -2057,19 +2778,24 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
                         if(sffile == NULL)
                         {
                             FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
+                            delete_fluid_list(samples);
+                            fluid_trace("load_preset_samples", trace_ref);
                             return FLUID_FAILED;
                         }
+
+                        sffile->load_stats = defsfont->load_stats;
                     }
 
-                    if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
+                    p = fluid_list_prepend(samples, sample);
+
+                    if(p != NULL)
                     {
-                        fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
-                        fluid_voice_optimize_sample(sample);
+                        samples = p;
+                        read_ahead_sample(defsfont, sffile, sample);
                     }
                     else
                     {
-                        FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
-                        sample->start = sample->end = 0;
+                        load_preset_sample(defsfont, sffile, sample);
                     }
                 }
             }
@@ -2082,9 +2808,105 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
 
     if(sffile != NULL)
     {
+        fluid_sffile_flush_read_ahead(sffile);
+
+        for(p = samples; p != NULL; p = fluid_list_next(p))
+        {
+            load_preset_sample(defsfont, sffile, fluid_list_get(p));
+        }
+
+        delete_fluid_list(samples);
         fluid_sffile_close(sffile);
+
+        fluid_sfont_load_stats_report(defsfont->load_stats, "Loaded the samples of preset",
+                                      fluid_preset_get_name(preset), start, msec_before, bytes_before);
+    }
+
+    fluid_trace("load_preset_samples", trace_ref);
+    return FLUID_OK;
+}
+
+/* Walk through all samples used by the passed in preset and queue the ones whose
+ * sample data isn't loaded yet for the loader thread, ahead of the samples queued
+ * by the presets selected before: the preset selected last is most likely to be
+ * played next. Notes of the preset skip the samples until they are loaded.
+ * Used by dynamic sample loading with synth.dynamic-sample-loading-async. */
+static int queue_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
+{
+    fluid_defpreset_t *defpreset;
+    fluid_preset_zone_t *preset_zone;
+    fluid_inst_t *inst;
+    fluid_inst_zone_t *inst_zone;
+    fluid_sample_t *sample;
+    fluid_list_t *queued = NULL, *last = NULL, *link;
+
+    defpreset = fluid_preset_get_data(preset);
+    preset_zone = fluid_defpreset_get_zone(defpreset);
+
+    fluid_cond_mutex_lock(defsfont->loader_mutex);
+
+    while(preset_zone != NULL)
+    {
+        inst = fluid_preset_zone_get_inst(preset_zone);
+        inst_zone = fluid_inst_get_zone(inst);
+
+        while(inst_zone != NULL)
+        {
+            sample = fluid_inst_zone_get_sample(inst_zone);
+
+            /* The loader thread owns the samples it is loading, it checks their
+             * count once done */
+            if((sample != NULL) && fluid_atomic_int_get(&sample->loading))
+            {
+                sample->preset_count++;
+            }
+            else if((sample != NULL) && (sample->start != sample->end))
+            {
+                sample->preset_count++;
+
+                if(sample->preset_count == 1 && sample->data == NULL)
+                {
+                    link = new_fluid_list();
+
+                    if(link == NULL)
+                    {
+                        FLUID_LOG(FLUID_ERR, "Out of memory, disabling sample '%s'", sample->name);
+                        sample->start = sample->end = 0;
+                        inst_zone = fluid_inst_zone_next(inst_zone);
+                        continue;
+                    }
+
+                    fluid_atomic_int_set(&sample->loading, TRUE);
+                    link->data = sample;
+
+                    if(last == NULL)
+                    {
+                        queued = link;
+                    }
+                    else
+                    {
+                        last->next = link;
+                    }
+
+                    last = link;
+                }
+            }
+
+            inst_zone = fluid_inst_zone_next(inst_zone);
+        }
+
+        preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
+    if(last != NULL)
+    {
+        last->next = defsfont->loader_queue;
+        defsfont->loader_queue = queued;
+        fluid_cond_signal(defsfont->loader_cond);
+    }
+
+    fluid_cond_mutex_unlock(defsfont->loader_mutex);
+
     return FLUID_OK;
 }
 
@@ -2102,6 +2924,11 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
     defpreset = fluid_preset_get_data(preset);
     preset_zone = fluid_defpreset_get_zone(defpreset);
 
+    if(defsfont->loader != NULL)
+    {
+        fluid_cond_mutex_lock(defsfont->loader_mutex);
+    }
+
     while(preset_zone != NULL)
     {
         inst = fluid_preset_zone_get_inst(preset_zone);
@@ -2111,7 +2938,16 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
         {
             sample = fluid_inst_zone_get_sample(inst_zone);
 
-            if((sample != NULL) && (sample->preset_count > 0))
+            /* The loader thread unloads the samples it is loading if their
+             * count has dropped to zero once done */
+            if((sample != NULL) && fluid_atomic_int_get(&sample->loading))
+            {
+                if(sample->preset_count > 0)
+                {
+                    sample->preset_count--;
+                }
+            }
+            else if((sample != NULL) && (sample->preset_count > 0))
             {
                 sample->preset_count--;
 
@@ -2120,7 +2956,7 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
                  * still in use by a voice, dynamic_samples_sample_notify will
                  * take care of unloading the sample as soon as the voice is
                  * finished with it (but only on the next API call). */
-                if(sample->preset_count == 0 && sample->refcount == 0)
+                if(sample->preset_count == 0 && fluid_atomic_int_get(&sample->refcount) == 0)
                 {
                     unload_sample(sample);
                 }
@@ -2132,6 +2968,11 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
         preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
+    if(defsfont->loader != NULL)
+    {
+        fluid_cond_mutex_unlock(defsfont->loader_mutex);
+    }
+
     return FLUID_OK;
 }
 
@@ -2141,7 +2982,7 @@ static void unload_sample(fluid_sample_t *sample)
     fluid_return_if_fail(sample != NULL);
     fluid_return_if_fail(sample->data != NULL);
     fluid_return_if_fail(sample->preset_count == 0);
-    fluid_return_if_fail(sample->refcount == 0);
+    fluid_return_if_fail(fluid_atomic_int_get(&sample->refcount) == 0);
 
     FLUID_LOG(FLUID_DBG, "Unloading sample '%s'", sample->name);
 
@@ -2153,7 +2994,194 @@ static void unload_sample(fluid_sample_t *sample)
     {
         sample->data = NULL;
         sample->data24 = NULL;
+        sample->float_data = NULL;
+        fluid_sample_free_stream_data(sample);
+        fluid_sample_unpad_loop(sample);
+    }
+}
+
+/* Start the thread loading the samples of the selected presets in the background.
+ * Returns FLUID_OK on success, otherwise FLUID_FAILED and the samples are loaded
+ * by the thread selecting the presets. */
+static int fluid_defsfont_start_loader(fluid_defsfont_t *defsfont)
+{
+    defsfont->loader_mutex = new_fluid_cond_mutex();
+    defsfont->loader_cond = new_fluid_cond();
+
+    if(defsfont->loader_mutex != NULL && defsfont->loader_cond != NULL)
+    {
+        defsfont->loader = new_fluid_thread("sample-loader", fluid_defsfont_loader_run, defsfont, 0, FALSE);
+    }
+
+    if(defsfont->loader == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to start the sample loader, loading the samples of the selected presets right away");
+        fluid_defsfont_stop_loader(defsfont);
+        defsfont->async_samples = FALSE;
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
+/* Stop the loader thread, waiting for the sample it is loading. The samples still
+ * queued are left unloaded. */
+static void fluid_defsfont_stop_loader(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+
+    if(defsfont->loader != NULL)
+    {
+        fluid_cond_mutex_lock(defsfont->loader_mutex);
+        defsfont->loader_quit = TRUE;
+        fluid_cond_signal(defsfont->loader_cond);
+        fluid_cond_mutex_unlock(defsfont->loader_mutex);
+
+        fluid_thread_join(defsfont->loader);
+        delete_fluid_thread(defsfont->loader);
+        defsfont->loader = NULL;
+    }
+
+    for(list = defsfont->loader_queue; list != NULL; list = fluid_list_next(list))
+    {
+        fluid_atomic_int_set(&((fluid_sample_t *)fluid_list_get(list))->loading, FALSE);
+    }
+
+    delete_fluid_list(defsfont->loader_queue);
+    defsfont->loader_queue = NULL;
+
+    if(defsfont->loader_cond != NULL)
+    {
+        delete_fluid_cond(defsfont->loader_cond);
+        defsfont->loader_cond = NULL;
+    }
+
+    if(defsfont->loader_mutex != NULL)
+    {
+        delete_fluid_cond_mutex(defsfont->loader_mutex);
+        defsfont->loader_mutex = NULL;
+    }
+}
+
+/* Load the queued samples one after the other, keeping the SoundFont file open as
+ * long as there are some. A sample is published to the notes of its presets once
+ * loaded by clearing its loading flag. */
+static fluid_thread_return_t fluid_defsfont_loader_run(void *data)
+{
+    fluid_defsfont_t *defsfont = data;
+    fluid_sample_t *sample, **ahead;
+    fluid_list_t *link;
+    SFData *sffile = NULL;
+    double start = 0.0, msec_before[FLUID_SFONT_LOAD_LAST];
+    size_t bytes_before[FLUID_SFONT_LOAD_LAST];
+    int i, ahead_count;
+
+    /* the samples queued after the one loaded, to be read along with it */
+    ahead = (defsfont->read_depth > 1) ? FLUID_ARRAY(fluid_sample_t *, defsfont->read_depth - 1) : NULL;
+
+    fluid_cond_mutex_lock(defsfont->loader_mutex);
+
+    while(!defsfont->loader_quit)
+    {
+        if(defsfont->loader_queue == NULL)
+        {
+            if(sffile != NULL)
+            {
+                fluid_cond_mutex_unlock(defsfont->loader_mutex);
+                fluid_sffile_close(sffile);
+                sffile = NULL;
+                fluid_sfont_load_stats_report(defsfont->load_stats, "Loaded the queued samples of SoundFont",
+                                              defsfont->filename, start, msec_before, bytes_before);
+                fluid_cond_mutex_lock(defsfont->loader_mutex);
+            }
+            else
+            {
+                fluid_cond_wait(defsfont->loader_cond, defsfont->loader_mutex);
+            }
+
+            continue;
+        }
+
+        link = defsfont->loader_queue;
+        sample = fluid_list_get(link);
+        defsfont->loader_queue = fluid_list_remove_link(defsfont->loader_queue, link);
+        delete1_fluid_list(link);
+
+        /* unselected again while queued */
+        if(sample->preset_count == 0)
+        {
+            fluid_atomic_int_set(&sample->loading, FALSE);
+            continue;
+        }
+
+        /* owned by this thread as long as they are queued */
+        ahead_count = 0;
+
+        for(link = defsfont->loader_queue; link != NULL && ahead != NULL && ahead_count < defsfont->read_depth - 1;
+                link = fluid_list_next(link))
+        {
+            ahead[ahead_count++] = fluid_list_get(link);
+        }
+
+        fluid_cond_mutex_unlock(defsfont->loader_mutex);
+
+        if(sffile == NULL)
+        {
+            /* the samples loaded until the queue is empty are reported together */
+            start = fluid_sfont_load_stats_start(defsfont->load_stats);
+
+            if(defsfont->load_stats != NULL)
+            {
+                fluid_sfont_load_stats_get(defsfont->load_stats, msec_before, bytes_before);
+            }
+
+            sffile = fluid_sffile_open(defsfont->filename, defsfont->fcbs);
+
+            if(sffile != NULL)
+            {
+                sffile->load_stats = defsfont->load_stats;
+            }
+        }
+
+        if(sffile != NULL)
+        {
+            /* the reads submitted before are kept until they are taken */
+            read_ahead_sample(defsfont, sffile, sample);
+
+            for(i = 0; i < ahead_count; i++)
+            {
+                read_ahead_sample(defsfont, sffile, ahead[i]);
+            }
+
+            fluid_sffile_flush_read_ahead(sffile);
+            load_preset_sample(defsfont, sffile, sample);
+        }
+        else
+        {
+            FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file, disabling sample '%s'", sample->name);
+            sample->start = sample->end = 0;
+        }
+
+        fluid_cond_mutex_lock(defsfont->loader_mutex);
+
+        /* unselected while loading */
+        if(sample->preset_count == 0 && sample->data != NULL)
+        {
+            unload_sample(sample);
+        }
+
+        fluid_atomic_int_set(&sample->loading, FALSE);
+    }
+
+    fluid_cond_mutex_unlock(defsfont->loader_mutex);
+
+    if(sffile != NULL)
+    {
+        fluid_sffile_close(sffile);
     }
+
+    FLUID_FREE(ahead);
+    return FLUID_THREAD_RETURN_VALUE;
 }
 
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx)
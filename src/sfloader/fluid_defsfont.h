@@ -54,6 +54,7 @@ typedef struct _fluid_preset_zone_t fluid_preset_zone_t;
 typedef struct _fluid_inst_t fluid_inst_t;
 typedef struct _fluid_inst_zone_t fluid_inst_zone_t;            /**< Soundfont Instrument Zone */
 typedef struct _fluid_voice_zone_t fluid_voice_zone_t;
+typedef struct _fluid_zone_table_entry_t fluid_zone_table_entry_t;
 
 /* defines the velocity and key range for a zone */
 struct _fluid_zone_range_t
@@ -65,12 +66,37 @@ struct _fluid_zone_range_t
     unsigned char ignore;	/* set to TRUE for legato playing to ignore this range zone */
 };
 
+/* A generator a voice zone sets or adds to the voice */
+typedef struct
+{
+    unsigned char num;  /* the generator (#fluid_gen_type) */
+    float val;          /* the value set or added */
+} fluid_voice_zone_gen_t;
+
 /* Stored on a preset zone to keep track of the inst zones that could start a voice
- * and their combined preset zone/instument zone ranges */
+ * and their combined preset zone/instument zone ranges.
+ * The generators and modulators of the instrument zone and of the preset zone,
+ * merged with their global zones, are precomputed once the preset is loaded:
+ * gen holds the num_inst_gens instrument generators followed by the
+ * num_preset_gens preset generators, mod the num_inst_mods instrument
+ * modulators followed by the num_preset_mods preset modulators. */
 struct _fluid_voice_zone_t
 {
     fluid_inst_zone_t *inst_zone;
     fluid_zone_range_t range;
+    fluid_voice_zone_gen_t *gen;
+    int num_inst_gens;
+    int num_preset_gens;
+    fluid_mod_t **mod;
+    int num_inst_mods;
+    int num_preset_mods;
+};
+
+/* A voice zone together with the preset zone it belongs to, see fluid_defpreset_t */
+struct _fluid_zone_table_entry_t
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
 };
 
 /*
@@ -87,6 +113,10 @@ const char *fluid_defsfont_sfont_get_name(fluid_sfont_t *sfont);
 fluid_preset_t *fluid_defsfont_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum);
 void fluid_defsfont_sfont_iteration_start(fluid_sfont_t *sfont);
 fluid_preset_t *fluid_defsfont_sfont_iteration_next(fluid_sfont_t *sfont);
+void fluid_defsfont_sfont_get_memory(fluid_sfont_t *sfont, size_t *bytes);
+void fluid_defsfont_sfont_get_load_stats(fluid_sfont_t *sfont, double *msec, size_t *bytes);
+int fluid_defsfont_sfont_get_sample_index(fluid_sfont_t *sfont, const fluid_sample_t *sample);
+fluid_sample_t *fluid_defsfont_sfont_get_sample(fluid_sfont_t *sfont, int index);
 
 
 void fluid_defpreset_preset_delete(fluid_preset_t *preset);
@@ -111,13 +141,36 @@ struct _fluid_defsfont_t
     unsigned int sample24pos;		/* position within sffd of the sm24 chunk, set to zero if no 24 bit sample support */
     unsigned int sample24size;		/* length within sffd of the sm24 chunk */
     char *sample24data;        /* if not NULL, the least significant byte of the 24bit sample data, loaded in ram */
+    float *samplefloatdata;    /* if not NULL, the sample data converted to float */
 
     fluid_sfont_t *sfont;      /* pointer to parent sfont */
     fluid_list_t *sample;      /* the samples in this soundfont */
     fluid_list_t *preset;      /* the presets of this soundfont */
     fluid_list_t *inst;        /* the instruments of this soundfont */
     int mlock;                 /* Should we try memlock (avoid swapping)? */
+    int huge_pages;            /* Should we advise huge pages for the sample data? */
     int dynamic_samples;       /* Enables dynamic sample loading if set */
+    int async_samples;         /* Loads the samples of the selected presets in the background if set */
+    int read_depth;            /* the most sample reads in flight at once with dynamic sample loading */
+    fluid_thread_t *loader;    /* the thread loading the samples in the background, started by the first preset selected */
+    fluid_cond_mutex_t *loader_mutex; /* guards the queue, and the preset counts of the samples once the loader is started */
+    fluid_cond_t *loader_cond; /* signaled when samples are queued */
+    fluid_list_t *loader_queue; /* the samples to be loaded in the background, the ones of the preset selected last first */
+    int loader_quit;           /* tells the loader thread to stop, with loader_mutex locked */
+    int lazy_presets;          /* Import the zones of the presets only once they are used if set */
+    int num_lazy_presets;      /* Number of presets whose zones are not imported yet */
+    SFData *sfdata;            /* the parsed file, kept as long as num_lazy_presets isn't zero */
+    int mmap;                  /* Should we try to map the sample data from the file instead of reading it? */
+    int float_samples;         /* Should the sample data be converted to float on loading? */
+    int pad_loops;             /* Should the sample loops be copied with padding on loading? */
+    int mipmap_loops;          /* Should the sample loops be decimated by octaves on loading? */
+    int cache_size;            /* MiB of sample data to keep cached once no longer used */
+    char *cache_dir;           /* directory to store decoded compressed samples into, NULL or empty if none */
+    int shm;                   /* Should we share the sample data read into memory with other processes? */
+    int stream_preload;        /* If not zero, only keep this many frames of each mapped sample resident */
+    int load_threads;          /* Number of threads loading the sample data */
+    fluid_arena_t *arena;      /* the zones, instruments and modulators of the presets, freed all at once with the SoundFont */
+    fluid_sfont_load_stats_t *load_stats; /* the stages of loading are timed into, NULL unless synth.sfont-load-stats is set */
 
     fluid_list_t *preset_iter_cur;       /* the current preset in the iteration */
 };
@@ -148,10 +201,24 @@ struct _fluid_defpreset_t
     unsigned int num;                     /* the preset number */
     fluid_preset_zone_t *global_zone;        /* the global zone of the preset */
     fluid_preset_zone_t *zone;               /* the chained list of preset zones */
+
+    /* Lookup table of the voice zones that can start a voice for a given key
+     * and velocity, built once all zones have been added. Velocities are grouped
+     * into buckets which are matched by the same zones. The entries for key k and
+     * bucket b are zone_table[zone_table_index[k * num_vel_buckets + b]] up to
+     * (excluding) the entry at zone_table_index[k * num_vel_buckets + b + 1],
+     * in the same order as the zones are stored in the preset. */
+    unsigned char vel_bucket[128];           /* velocity bucket of each velocity */
+    int num_vel_buckets;                     /* number of velocity buckets */
+    int *zone_table_index;                   /* start of each key and velocity bucket in zone_table */
+    fluid_zone_table_entry_t *zone_table;    /* the voice zones, grouped by key and velocity bucket */
+
+    SFPreset *sfpreset;                      /* if not NULL, the zones are still to be imported from it */
 };
 
 fluid_defpreset_t *new_fluid_defpreset(void);
 void delete_fluid_defpreset(fluid_defpreset_t *defpreset);
+void fluid_defpreset_delete_zones(fluid_defpreset_t *defpreset);
 fluid_defpreset_t *fluid_defpreset_next(fluid_defpreset_t *defpreset);
 int fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset, SFPreset *sfpreset, fluid_defsfont_t *defsfont);
 int fluid_defpreset_set_global_zone(fluid_defpreset_t *defpreset, fluid_preset_zone_t *zone);
@@ -171,15 +238,15 @@ struct _fluid_preset_zone_t
     fluid_preset_zone_t *next;
     char *name;
     fluid_inst_t *inst;
-    fluid_list_t *voice_zone;
+    fluid_voice_zone_t *voice_zone;  /* the voice zones of the preset zone, num_voice_zones of them */
+    int num_voice_zones;
     fluid_zone_range_t range;
     fluid_gen_t gen[GEN_LAST];
     fluid_mod_t *mod;  /* List of modulators */
 };
 
-fluid_preset_zone_t *new_fluid_preset_zone(char *name);
+fluid_preset_zone_t *new_fluid_preset_zone(fluid_arena_t *arena, char *name);
 void delete_fluid_list_mod(fluid_mod_t *mod);
-void delete_fluid_preset_zone(fluid_preset_zone_t *zone);
 fluid_preset_zone_t *fluid_preset_zone_next(fluid_preset_zone_t *zone);
 int fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, SFZone *sfzone, fluid_defsfont_t *defssfont);
 fluid_inst_t *fluid_preset_zone_get_inst(fluid_preset_zone_t *zone);
@@ -195,9 +262,8 @@ struct _fluid_inst_t
     fluid_inst_zone_t *zone;
 };
 
-fluid_inst_t *new_fluid_inst(void);
+fluid_inst_t *new_fluid_inst(fluid_arena_t *arena);
 fluid_inst_t *fluid_inst_import_sfont(SFInst *sfinst, fluid_defsfont_t *defsfont);
-void delete_fluid_inst(fluid_inst_t *inst);
 int fluid_inst_set_global_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone);
 int fluid_inst_add_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone);
 fluid_inst_zone_t *fluid_inst_get_zone(fluid_inst_t *inst);
@@ -217,8 +283,7 @@ struct _fluid_inst_zone_t
 };
 
 
-fluid_inst_zone_t *new_fluid_inst_zone(char *name);
-void delete_fluid_inst_zone(fluid_inst_zone_t *zone);
+fluid_inst_zone_t *new_fluid_inst_zone(fluid_arena_t *arena, char *name);
 fluid_inst_zone_t *fluid_inst_zone_next(fluid_inst_zone_t *zone);
 int fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, SFZone *sfzone, fluid_defsfont_t *defsfont);
 fluid_sample_t *fluid_inst_zone_get_sample(fluid_inst_zone_t *zone);
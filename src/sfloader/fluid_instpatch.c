@@ -2,6 +2,7 @@
 #include "fluid_instpatch.h"
 #include "fluid_list.h"
 #include "fluid_sfont.h"
+#include "fluid_mod.h"
 #include "fluid_sys.h"
 
 #include <libinstpatch/libinstpatch.h>
@@ -33,8 +34,17 @@ typedef struct _instpatch_voice_user_data
     /* pointer to the sample store that holds the PCM */
     IpatchSampleStoreCache *sample_store;
 
-    /* pointer to a preallocated fluid_sample_t that we can use during noteon for this voice */
+    /* pointer to a fluid_sample_t set up on loading for the noteons of this voice, or NULL
+     * for ROM and other non-readable samples */
     fluid_sample_t *sample;
+
+    /* the generators and modulators of the voice, converted on loading */
+    int gen_count;
+    unsigned char gen_index[IPATCH_SF2_GEN_COUNT];
+    float gen_value[IPATCH_SF2_GEN_COUNT];
+
+    int mod_count;
+    fluid_mod_t *mods;
 } fluid_instpatch_voice_user_data_t;
 
 
@@ -101,15 +111,13 @@ fluid_instpatch_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int
     /* voice index array */
     guint16 voice_indices[MAX_INST_VOICES];
     int sel_values[IPATCH_SF2_VOICE_CACHE_MAX_SEL_VALUES];
-    fluid_mod_t *fmod = g_alloca(fluid_mod_sizeof());
     fluid_voice_t *flvoice;
 
     fluid_instpatch_preset_t *preset_data = fluid_preset_get_data(preset);
 
-    int i, voice_count, voice_num, ret = FLUID_FAILED;
-    GSList *p;
+    int i, voice_count, voice_num;
 
-    /* lookup the voice cache that we've created on loading */
+    /* lookup the voice cache that we've created on loading, the preset holds a reference to it */
     IpatchSF2VoiceCache *cache = preset_data->cache;
 
     /* loading and caching the instrument could have failed though */
@@ -118,8 +126,6 @@ fluid_instpatch_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int
         return FLUID_FAILED;
     }
 
-    g_object_ref(cache);
-
     for(i = 0; i < cache->sel_count; i++)
     {
         IpatchSF2VoiceSelInfo *sel_info = &cache->sel_info[i];
@@ -146,106 +152,38 @@ fluid_instpatch_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int
     /* loop over matching voice indexes */
     for(voice_num = 0; voice_num < voice_count; voice_num++)
     {
-        IpatchSF2GenArray *gen_array;
-        fluid_sample_t *fsample;
-
         IpatchSF2Voice *voice = IPATCH_SF2_VOICE_CACHE_GET_VOICE(cache, voice_indices[voice_num]);
+        fluid_instpatch_voice_user_data_t *data = voice->user_data;
 
-        if(!voice->sample_store)
+        if(data->sample == NULL)
         {
             /* For ROM and other non-readable samples */
             continue;
         }
 
-        fsample = ((fluid_instpatch_voice_user_data_t *)voice->user_data)->sample;
-
-        ret = fluid_sample_set_sound_data(fsample,
-                                          ipatch_sample_store_cache_get_location(IPATCH_SAMPLE_STORE_CACHE(voice->sample_store)),
-                                          NULL,
-                                          voice->sample_size,
-                                          voice->rate,
-                                          FALSE
-                                         );
-
-        if(FLUID_UNLIKELY(ret == FLUID_FAILED))
-        {
-            FLUID_LOG(FLUID_ERR, "fluid_sample_set_sound_data() failed");
-            goto error_rec;
-        }
-
-        ret = fluid_sample_set_loop(fsample, voice->loop_start, voice->loop_end);
-
-        if(FLUID_UNLIKELY(ret == FLUID_FAILED))
-        {
-            FLUID_LOG(FLUID_ERR, "fluid_sample_set_loop() failed");
-            goto error_rec;
-        }
-
-        ret = fluid_sample_set_pitch(fsample, voice->root_note, voice->fine_tune);
-
-        if(FLUID_UNLIKELY(ret == FLUID_FAILED))
-        {
-            FLUID_LOG(FLUID_ERR, "fluid_sample_set_pitch() failed");
-            goto error_rec;
-        }
-
         /* allocate the FluidSynth voice */
-        flvoice = fluid_synth_alloc_voice(synth, fsample, chan, key, vel);
+        flvoice = fluid_synth_alloc_voice(synth, data->sample, chan, key, vel);
 
         if(flvoice == NULL)
         {
-            ret = FLUID_FAILED;
-            goto error_rec;
+            return FLUID_FAILED;
         }
 
         /* set only those generator parameters that are set */
-        gen_array = &voice->gen_array;
-
-        for(i = 0; i < IPATCH_SF2_GEN_COUNT; i++)
+        for(i = 0; i < data->gen_count; i++)
         {
-            if(IPATCH_SF2_GEN_ARRAY_TEST_FLAG(gen_array, i))
-            {
-                fluid_voice_gen_set(flvoice, i, (float)(gen_array->values[i].sword));
-            }
+            fluid_voice_gen_set(flvoice, data->gen_index[i], data->gen_value[i]);
         }
 
-        p = voice->mod_list;
-
-        while(p)
+        for(i = 0; i < data->mod_count; i++)
         {
-            static const unsigned int mod_mask =
-                (IPATCH_SF2_MOD_MASK_DIRECTION | IPATCH_SF2_MOD_MASK_POLARITY | IPATCH_SF2_MOD_MASK_TYPE);
-
-            IpatchSF2Mod *mod = p->data;
-
-            fluid_mod_set_dest(fmod, mod->dest);
-            fluid_mod_set_source1(fmod,
-                                  mod->src & IPATCH_SF2_MOD_MASK_CONTROL,
-                                  ((mod->src & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
-                                  | ((mod->src & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
-
-            fluid_mod_set_source2(fmod,
-                                  mod->amtsrc & IPATCH_SF2_MOD_MASK_CONTROL,
-                                  ((mod->amtsrc & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
-                                  | ((mod->amtsrc & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
-
-            fluid_mod_set_amount(fmod, mod->amount);
-            fluid_voice_add_mod(flvoice, fmod, FLUID_VOICE_OVERWRITE);
-
-            p = p->next;
+            fluid_voice_add_mod(flvoice, &data->mods[i], FLUID_VOICE_OVERWRITE);
         }
 
         fluid_synth_start_voice(synth, flvoice);
-
-        /* sample store reference taken over by fsample structure */
     }
 
-    ret = FLUID_OK;
-
-error_rec:
-
-    g_object_unref(cache);
-    return ret;
+    return FLUID_OK;
 }
 
 
@@ -300,34 +238,136 @@ fluid_instpatch_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum)
     return NULL;
 }
 
-static fluid_instpatch_voice_user_data_t *new_fluid_instpatch_voice_user_data(IpatchSampleStoreCache *sample_store)
+static void fluid_instpatch_on_voice_user_data_destroy(gpointer user_data)
 {
+    fluid_instpatch_voice_user_data_t *data = user_data;
+
+    delete_fluid_sample(data->sample);
+
+    if(data->sample_store != NULL)
+    {
+        ipatch_sample_store_cache_close(data->sample_store);
+    }
+
+    FLUID_FREE(data->mods);
+    FLUID_FREE(data);
+}
+
+/*
+ * Set up the sample of a voice and convert its generators and modulators, so
+ * that noteons only have to start the voice.
+ */
+static fluid_instpatch_voice_user_data_t *new_fluid_instpatch_voice_user_data(IpatchSF2Voice *voice)
+{
+    static const unsigned int mod_mask =
+        (IPATCH_SF2_MOD_MASK_DIRECTION | IPATCH_SF2_MOD_MASK_POLARITY | IPATCH_SF2_MOD_MASK_TYPE);
+
+    IpatchSampleStoreCache *sample_store = IPATCH_SAMPLE_STORE_CACHE(voice->sample_store);
+    IpatchSF2GenArray *gen_array = &voice->gen_array;
     fluid_instpatch_voice_user_data_t *data = FLUID_NEW(fluid_instpatch_voice_user_data_t);
-    fluid_sample_t *sample = new_fluid_sample();
+    fluid_sample_t *sample = NULL;
+    GSList *p;
+    int i;
 
-    if(data == NULL || sample == NULL)
+    if(data == NULL)
     {
-        FLUID_FREE(data);
-        delete_fluid_sample(sample);
         FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
-    data->sample = sample;
+    FLUID_MEMSET(data, 0, sizeof(*data));
 
-    /* Keep sample store cached by doing a dummy open */
-    ipatch_sample_store_cache_open(sample_store);
-    data->sample_store = sample_store;
-    return data;
-}
+    if(sample_store != NULL)
+    {
+        /* Keep sample store cached by doing a dummy open */
+        ipatch_sample_store_cache_open(sample_store);
+        data->sample_store = sample_store;
 
-static void fluid_instpatch_on_voice_user_data_destroy(gpointer user_data)
-{
-    fluid_instpatch_voice_user_data_t *data = user_data;
+        sample = new_fluid_sample();
 
-    delete_fluid_sample(data->sample);
-    ipatch_sample_store_cache_close(data->sample_store);
-    FLUID_FREE(data);
+        if(sample == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_rec;
+        }
+
+        data->sample = sample;
+
+        if(fluid_sample_set_sound_data(sample,
+                                       ipatch_sample_store_cache_get_location(sample_store),
+                                       NULL,
+                                       voice->sample_size,
+                                       voice->rate,
+                                       FALSE
+                                      ) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "fluid_sample_set_sound_data() failed");
+            goto error_rec;
+        }
+
+        if(fluid_sample_set_loop(sample, voice->loop_start, voice->loop_end) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "fluid_sample_set_loop() failed");
+            goto error_rec;
+        }
+
+        if(fluid_sample_set_pitch(sample, voice->root_note, voice->fine_tune) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "fluid_sample_set_pitch() failed");
+            goto error_rec;
+        }
+    }
+
+    /* only those generator parameters that are set */
+    for(i = 0; i < IPATCH_SF2_GEN_COUNT; i++)
+    {
+        if(IPATCH_SF2_GEN_ARRAY_TEST_FLAG(gen_array, i))
+        {
+            data->gen_index[data->gen_count] = (unsigned char) i;
+            data->gen_value[data->gen_count] = (float)(gen_array->values[i].sword);
+            data->gen_count++;
+        }
+    }
+
+    data->mod_count = g_slist_length(voice->mod_list);
+
+    if(data->mod_count > 0)
+    {
+        data->mods = FLUID_ARRAY(fluid_mod_t, data->mod_count);
+
+        if(data->mods == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_rec;
+        }
+
+        FLUID_MEMSET(data->mods, 0, data->mod_count * sizeof(fluid_mod_t));
+    }
+
+    for(p = voice->mod_list, i = 0; p != NULL; p = p->next, i++)
+    {
+        IpatchSF2Mod *mod = p->data;
+        fluid_mod_t *fmod = &data->mods[i];
+
+        fluid_mod_set_dest(fmod, mod->dest);
+        fluid_mod_set_source1(fmod,
+                              mod->src & IPATCH_SF2_MOD_MASK_CONTROL,
+                              ((mod->src & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
+                              | ((mod->src & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
+
+        fluid_mod_set_source2(fmod,
+                              mod->amtsrc & IPATCH_SF2_MOD_MASK_CONTROL,
+                              ((mod->amtsrc & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
+                              | ((mod->amtsrc & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
+
+        fluid_mod_set_amount(fmod, mod->amount);
+    }
+
+    return data;
+
+error_rec:
+    fluid_instpatch_on_voice_user_data_destroy(data);
+    return NULL;
 }
 
 static IpatchSF2VoiceCache *convert_dls_to_sf2_instrument(fluid_instpatch_font_t *patchfont, IpatchDLS2Inst *item, const char **err)
@@ -394,7 +434,7 @@ static IpatchSF2VoiceCache *convert_dls_to_sf2_instrument(fluid_instpatch_font_t
             return NULL;
         }
 
-        if((voice->user_data = new_fluid_instpatch_voice_user_data(IPATCH_SAMPLE_STORE_CACHE(voice->sample_store))) == NULL)
+        if((voice->user_data = new_fluid_instpatch_voice_user_data(voice)) == NULL)
         {
             *err = oom;
             g_object_unref(cache);
@@ -599,7 +639,7 @@ static int delete_fluid_instpatch(fluid_instpatch_font_t *pfont)
             IpatchSF2Voice *voice = IPATCH_SF2_VOICE_CACHE_GET_VOICE(cache, voice_indices[i]);
             fluid_sample_t *fsample = ((fluid_instpatch_voice_user_data_t *)voice->user_data)->sample;
 
-            if(fsample->refcount != 0)
+            if(fsample != NULL && fluid_atomic_int_get(&fsample->refcount) != 0)
             {
                 g_object_unref(cache);
                 return FLUID_FAILED;
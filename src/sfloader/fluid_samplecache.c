@@ -24,12 +24,55 @@
 /* CACHED SAMPLE DATA LOADER
  *
  * This is a wrapper around fluid_sffile_read_sample_data that attempts to cache the read
- * data across all FluidSynth instances in a global (process-wide) list.
+ * data across all FluidSynth instances in a global (process-wide) hash table.
+ *
+ * The entries are spread over several shards by the file name of their SoundFont, each
+ * with a hash table of its own indexed by the cache key and guarded by its own mutex, so
+ * that loading the samples of different SoundFonts doesn't serialize. A second set of
+ * shards indexes the entries by their sample data, for unloading them.
+ *
+ * Entries no longer referenced by any SoundFont can stay cached, up to a size given when
+ * loading samples, so that loading them again doesn't read them from disk. They are evicted
+ * in least recently used order when they exceed that size.
+ *
+ * Decoding compressed (SF3) samples takes a while, so the decoded sample data can also be
+ * stored into files of a cache directory, to be mapped from there when loaded again.
+ *
+ * Sample data read into memory can also be stored into POSIX shared memory objects, in the
+ * same format as those files, for other processes loading the same SoundFont to map them
+ * rather than keeping a copy of their own.
  */
 
 #include "fluid_samplecache.h"
 #include "fluid_sys.h"
 #include "fluid_list.h"
+#include "fluid_hash.h"
+
+/* Number of shards of the cache, each guarded by a mutex of its own */
+#define SAMPLECACHE_NUM_SHARDS 8
+
+/* How large the sample data of an entry has to be for logging how much of it is in huge pages */
+#define SAMPLECACHE_HUGE_PAGES_REPORT_SIZE (4 * 1024 * 1024)
+
+/* Identifies the files of decoded sample data in the cache directory */
+#define SAMPLECACHE_FILE_MAGIC "FLUIDPCM"
+#define SAMPLECACHE_FILE_BYTE_ORDER 0x01020304
+
+/* The header of a file of decoded sample data, followed by the file name of the
+ * SoundFont and the samples, in the byte order of the machine, at header_size */
+typedef struct
+{
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint64_t modification_time;
+    uint32_t sf_samplepos;
+    uint32_t sf_samplesize;
+    uint32_t sample_start;
+    uint32_t sample_end;
+    uint32_t sample_count;
+    uint32_t filename_length;
+} fluid_samplecache_file_header_t;
 
 
 typedef struct _fluid_samplecache_entry_t fluid_samplecache_entry_t;
@@ -52,18 +95,88 @@ struct _fluid_samplecache_entry_t
     char *sample_data24;
     int sample_count;
 
+    /* The sample data converted to float, aligned within sample_float_buf, NULL if not requested yet */
+    float *sample_float_data;
+    void *sample_float_buf;
+
+    /* Set if the sample data are mapped from the file rather than read into memory */
+    fluid_file_mapping_t *mapping;
+    fluid_file_mapping_t *mapping24;
+
     int num_references;
     int mlocked;
+    int huge_pages;        /* huge pages have been advised for the sample data read */
+
+    /* The shard of samplecache_shards holding the entry */
+    int shard;
+
+    /* The list of unreferenced entries, most recently used first, guarded by samplecache_lru_mutex */
+    fluid_samplecache_entry_t *lru_prev;
+    fluid_samplecache_entry_t *lru_next;
+    int in_lru;
+    int evicting;          /* removed from the list by fluid_samplecache_evict(), which deletes it unless referenced again */
 };
 
-static fluid_list_t *samplecache_list = NULL;
-static fluid_mutex_t samplecache_mutex = FLUID_MUTEX_INIT;
+typedef struct
+{
+    fluid_mutex_t mutex;
+    fluid_hashtable_t *entries;  /* created with the first entry, deleted with the last one */
+} fluid_samplecache_shard_t;
+
+#define SAMPLECACHE_SHARD_INIT { FLUID_MUTEX_INIT, NULL }
+
+/* The entries indexed by their cache key, sharded by the file name */
+static fluid_samplecache_shard_t samplecache_shards[SAMPLECACHE_NUM_SHARDS] =
+{
+    SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT,
+    SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT
+};
+
+/* The entries indexed by their sample data, sharded by the address of the data.
+ * Always locked after the shard of samplecache_shards of the entry, if both are locked. */
+static fluid_samplecache_shard_t samplecache_data_shards[SAMPLECACHE_NUM_SHARDS] =
+{
+    SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT,
+    SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT, SAMPLECACHE_SHARD_INIT
+};
+
+/* The unreferenced entries, cached up to samplecache_max_unused_size bytes of sample data.
+ * Always locked after the shard of the entry, if both are locked. */
+static fluid_mutex_t samplecache_lru_mutex = FLUID_MUTEX_INIT;
+static fluid_samplecache_entry_t *samplecache_lru_head = NULL;
+static fluid_samplecache_entry_t *samplecache_lru_tail = NULL;
+static size_t samplecache_unused_size = 0;
+static size_t samplecache_max_unused_size = 0;
+
+static fluid_atomic_int_t samplecache_hits = 0;
+static fluid_atomic_int_t samplecache_misses = 0;
 
 static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf, unsigned int sample_start,
-        unsigned int sample_end, int sample_type, time_t mtime);
+        unsigned int sample_end, int sample_type, time_t mtime, int try_mmap, const char *cache_dir, int try_shm);
 static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf, unsigned int sample_start,
         unsigned int sample_end, int sample_type, time_t mtime);
 static void delete_samplecache_entry(fluid_samplecache_entry_t *entry);
+static void convert_samplecache_entry(fluid_samplecache_entry_t *entry, int locked);
+static void report_samplecache_huge_pages(const fluid_samplecache_entry_t *entry);
+static fluid_samplecache_entry_t *find_samplecache_entry_by_data(const short *sample_data);
+static void add_samplecache_entry(fluid_samplecache_entry_t *entry);
+static void remove_samplecache_entry(fluid_samplecache_entry_t *entry);
+static fluid_samplecache_shard_t *get_data_shard(const short *sample_data);
+static unsigned int samplecache_entry_hash(const void *key);
+static int samplecache_entry_equal(const void *a, const void *b);
+static size_t samplecache_entry_size(const fluid_samplecache_entry_t *entry);
+static void lru_insert(fluid_samplecache_entry_t *entry);
+static void lru_remove(fluid_samplecache_entry_t *entry);
+static void fluid_samplecache_evict(void);
+static void get_samplecache_file_path(const fluid_samplecache_entry_t *entry, const char *cache_dir,
+                                      char *path, int size);
+static void init_samplecache_file_header(const fluid_samplecache_entry_t *entry,
+        fluid_samplecache_file_header_t *header);
+static int load_samplecache_file(fluid_samplecache_entry_t *entry, const char *cache_dir);
+static void store_samplecache_file(const fluid_samplecache_entry_t *entry, const char *cache_dir);
+static void get_samplecache_shm_name(const fluid_samplecache_entry_t *entry, char *name, int size);
+static int load_samplecache_shm(fluid_samplecache_entry_t *entry);
+static void store_samplecache_shm(fluid_samplecache_entry_t *entry);
 
 static int fluid_get_file_modification_time(char *filename, time_t *modification_time);
 
@@ -72,13 +185,19 @@ static int fluid_get_file_modification_time(char *filename, time_t *modification
 
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **sample_data, char **sample_data24)
+                           int try_mlock, int try_mmap, unsigned int cache_size, const char *cache_dir,
+                           int try_shm, int to_float, short **sample_data, char **sample_data24, float **sample_float_data)
 {
     fluid_samplecache_entry_t *entry;
-    int ret;
+    fluid_samplecache_shard_t *shard;
+    double max_unused_size;
+    double start = fluid_sfont_load_stats_start(sf->load_stats);
+    size_t hit_bytes = 0;
+    int ret, created = FALSE;
     time_t mtime;
 
-    fluid_mutex_lock(samplecache_mutex);
+    shard = &samplecache_shards[fluid_str_hash(sf->fname) % SAMPLECACHE_NUM_SHARDS];
+    fluid_mutex_lock(shard->mutex);
 
     if(fluid_get_file_modification_time(sf->fname, &mtime) == FLUID_FAILED)
     {
@@ -89,18 +208,74 @@ int fluid_samplecache_load(SFData *sf,
 
     if(entry == NULL)
     {
-        entry = new_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime);
+        fluid_samplecache_entry_t *new_entry;
+        double new_start;
 
-        if(entry == NULL)
+        fluid_atomic_int_inc(&samplecache_misses);
+
+        /* Reading (and possibly decompressing) the sample data takes a while, don't keep
+         * other threads that load different samples waiting for it */
+        fluid_mutex_unlock(shard->mutex);
+        new_start = fluid_sfont_load_stats_start(sf->load_stats);
+        new_entry = new_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime, try_mmap, cache_dir, try_shm);
+
+        /* reading and decoding the sample data are timed as stages of their own */
+        start += fluid_sfont_load_stats_start(sf->load_stats) - new_start;
+        fluid_mutex_lock(shard->mutex);
+
+        if(new_entry == NULL)
         {
             ret = -1;
             goto unlock_exit;
         }
 
-        samplecache_list = fluid_list_prepend(samplecache_list, entry);
+        /* Somebody else might have loaded the same sample data in the meantime */
+        entry = get_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime);
+
+        if(entry == NULL)
+        {
+            entry = new_entry;
+            entry->shard = (int)(shard - samplecache_shards);
+            add_samplecache_entry(entry);
+            created = TRUE;
+        }
+        else
+        {
+            delete_samplecache_entry(new_entry);
+        }
+    }
+    else
+    {
+        fluid_atomic_int_inc(&samplecache_hits);
+        hit_bytes = entry->sample_count * (sizeof(short) + ((entry->sample_data24 != NULL) ? 1 : 0));
     }
 
-    if(try_mlock && !entry->mlocked)
+    if(entry->num_references == 0)
+    {
+        /* taken out of the unreferenced entries, or kept from being evicted */
+        fluid_mutex_lock(samplecache_lru_mutex);
+
+        if(entry->in_lru)
+        {
+            lru_remove(entry);
+        }
+
+        fluid_mutex_unlock(samplecache_lru_mutex);
+    }
+
+    if(to_float && entry->sample_float_data == NULL)
+    {
+        convert_samplecache_entry(entry, entry->mlocked);
+    }
+
+    if(created && entry->huge_pages)
+    {
+        report_samplecache_huge_pages(entry);
+    }
+
+    /* Mapped sample data are left to the operating system, locking them would read all
+     * of them from the file right away and pin the pages of the file or shared memory */
+    if(try_mlock && !entry->mlocked && entry->mapping == NULL)
     {
         /* Lock the memory to disable paging. It's okay if this fails. It
          * probably means that the user doesn't have the required permission. */
@@ -115,6 +290,17 @@ int fluid_samplecache_load(SFData *sf,
                 entry->mlocked = TRUE;
             }
 
+            if(entry->mlocked && entry->sample_float_data != NULL
+                    && fluid_mlock(entry->sample_float_data, entry->sample_count * sizeof(float)) != 0)
+            {
+                if(entry->sample_data24 != NULL)
+                {
+                    fluid_munlock(entry->sample_data24, entry->sample_count);
+                }
+
+                entry->mlocked = FALSE;
+            }
+
             if(!entry->mlocked)
             {
                 fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
@@ -126,71 +312,303 @@ int fluid_samplecache_load(SFData *sf,
     entry->num_references++;
     *sample_data = entry->sample_data;
     *sample_data24 = entry->sample_data24;
+    *sample_float_data = to_float ? entry->sample_float_data : NULL;
     ret = entry->sample_count;
 
 unlock_exit:
-    fluid_mutex_unlock(samplecache_mutex);
+    fluid_mutex_unlock(shard->mutex);
+
+    /* the size given applies to all unreferenced entries, from now on,
+     * limited to the address space */
+    max_unused_size = cache_size * 1048576.0;
+
+    fluid_mutex_lock(samplecache_lru_mutex);
+    samplecache_max_unused_size = (max_unused_size < (double)SIZE_MAX) ? (size_t)max_unused_size : SIZE_MAX;
+    fluid_mutex_unlock(samplecache_lru_mutex);
+
+    fluid_samplecache_evict();
+
+    fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_CACHE, start, hit_bytes);
+
     return ret;
 }
 
 int fluid_samplecache_unload(const short *sample_data)
 {
-    fluid_list_t *entry_list;
     fluid_samplecache_entry_t *entry;
-    int ret;
-
-    fluid_mutex_lock(samplecache_mutex);
+    fluid_samplecache_shard_t *shard;
+    int keep = FALSE;
 
-    entry_list = samplecache_list;
+    /* The caller holds a reference to the entry, so it can't go away
+     * after the data shard has been unlocked */
+    entry = find_samplecache_entry_by_data(sample_data);
 
-    while(entry_list)
+    if(entry == NULL)
     {
-        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+        FLUID_LOG(FLUID_ERR, "Trying to free sample data not found in cache.");
+        return FLUID_FAILED;
+    }
+
+    shard = &samplecache_shards[entry->shard];
+    fluid_mutex_lock(shard->mutex);
+
+    entry->num_references--;
 
-        if(sample_data == entry->sample_data)
+    if(entry->num_references == 0)
+    {
+        if(entry->mlocked)
         {
-            entry->num_references--;
+            fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
 
-            if(entry->num_references == 0)
+            if(entry->sample_data24 != NULL)
             {
-                if(entry->mlocked)
-                {
-                    fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
-
-                    if(entry->sample_data24 != NULL)
-                    {
-                        fluid_munlock(entry->sample_data24, entry->sample_count);
-                    }
-                }
+                fluid_munlock(entry->sample_data24, entry->sample_count);
+            }
 
-                samplecache_list = fluid_list_remove(samplecache_list, entry);
-                delete_samplecache_entry(entry);
+            if(entry->sample_float_data != NULL)
+            {
+                fluid_munlock(entry->sample_float_data, entry->sample_count * sizeof(float));
             }
 
-            ret = FLUID_OK;
-            goto unlock_exit;
+            entry->mlocked = FALSE;
         }
 
-        entry_list = fluid_list_next(entry_list);
+        fluid_mutex_lock(samplecache_lru_mutex);
+
+        if(entry->evicting)
+        {
+            /* fluid_samplecache_evict() is about to delete it */
+            keep = TRUE;
+        }
+        else if(samplecache_max_unused_size > 0)
+        {
+            lru_insert(entry);
+            keep = TRUE;
+        }
+
+        fluid_mutex_unlock(samplecache_lru_mutex);
+
+        if(!keep)
+        {
+            remove_samplecache_entry(entry);
+        }
+    }
+    else
+    {
+        keep = TRUE;
     }
 
-    FLUID_LOG(FLUID_ERR, "Trying to free sample data not found in cache.");
-    ret = FLUID_FAILED;
+    fluid_mutex_unlock(shard->mutex);
 
-unlock_exit:
-    fluid_mutex_unlock(samplecache_mutex);
+    if(!keep)
+    {
+        delete_samplecache_entry(entry);
+    }
+    else
+    {
+        fluid_samplecache_evict();
+    }
+
+    return FLUID_OK;
+}
+
+/* Returns TRUE if the sample data have been mapped from the file rather than read into memory */
+int fluid_samplecache_is_mapped(const short *sample_data)
+{
+    fluid_samplecache_shard_t *data_shard = get_data_shard(sample_data);
+    fluid_samplecache_entry_t *entry;
+    int ret = FALSE;
+
+    fluid_mutex_lock(data_shard->mutex);
+
+    if(data_shard->entries != NULL)
+    {
+        entry = fluid_hashtable_lookup(data_shard->entries, sample_data);
+        ret = (entry != NULL) && (entry->mapping != NULL);
+    }
+
+    fluid_mutex_unlock(data_shard->mutex);
     return ret;
 }
 
+/* Get the bytes taken by sample data, and whether it is shared with other SoundFonts or
+ * processes, or mapped from a file, and locked into memory. Fails if the data are not cached. */
+int fluid_samplecache_get_memory(const short *sample_data, size_t *size, int *shared, int *locked)
+{
+    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_shard_t *shard;
+
+    /* The caller holds a reference to the entry, as in fluid_samplecache_unload() */
+    entry = find_samplecache_entry_by_data(sample_data);
+
+    if(entry == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    shard = &samplecache_shards[entry->shard];
+    fluid_mutex_lock(shard->mutex);
+
+    *size = samplecache_entry_size(entry);
+    *shared = (entry->num_references > 1) || (entry->mapping != NULL);
+    *locked = entry->mlocked;
+
+    fluid_mutex_unlock(shard->mutex);
+
+    return FLUID_OK;
+}
+
+/* Check whether the sample data of a sample are cached already, e.g. loaded by another synth,
+ * without taking a reference to them */
+int fluid_samplecache_contains(SFData *sf, unsigned int sample_start, unsigned int sample_end, int sample_type)
+{
+    fluid_samplecache_shard_t *shard;
+    int ret;
+    time_t mtime;
+
+    if(fluid_get_file_modification_time(sf->fname, &mtime) == FLUID_FAILED)
+    {
+        mtime = 0;
+    }
+
+    shard = &samplecache_shards[fluid_str_hash(sf->fname) % SAMPLECACHE_NUM_SHARDS];
+    fluid_mutex_lock(shard->mutex);
+    ret = (get_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime) != NULL);
+    fluid_mutex_unlock(shard->mutex);
+
+    return ret;
+}
+
+/* Get the number of hits and misses of all lookups of sample data so far, and the size
+ * of the sample data cached while no longer used */
+void fluid_samplecache_get_stats(unsigned int *hits, unsigned int *misses, size_t *unused_size)
+{
+    *hits = (unsigned int)fluid_atomic_int_get(&samplecache_hits);
+    *misses = (unsigned int)fluid_atomic_int_get(&samplecache_misses);
+
+    fluid_mutex_lock(samplecache_lru_mutex);
+    *unused_size = samplecache_unused_size;
+    fluid_mutex_unlock(samplecache_lru_mutex);
+}
+
 
 /* Private functions */
+
+/* Deletes the least recently used unreferenced entries, until they fit into the cache size */
+static void fluid_samplecache_evict(void)
+{
+    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_shard_t *shard;
+    int evict;
+
+    while(TRUE)
+    {
+        fluid_mutex_lock(samplecache_lru_mutex);
+
+        entry = samplecache_lru_tail;
+
+        if(entry == NULL || samplecache_unused_size <= samplecache_max_unused_size)
+        {
+            fluid_mutex_unlock(samplecache_lru_mutex);
+            break;
+        }
+
+        /* Nobody but this thread deletes the entry while it is evicting. It can't be
+         * removed from the indexes here, as its shard has to be locked first. */
+        lru_remove(entry);
+        entry->evicting = TRUE;
+        fluid_mutex_unlock(samplecache_lru_mutex);
+
+        shard = &samplecache_shards[entry->shard];
+        fluid_mutex_lock(shard->mutex);
+
+        /* unless it has been loaded again in the meantime */
+        evict = (entry->num_references == 0);
+        entry->evicting = FALSE;
+
+        if(evict)
+        {
+            remove_samplecache_entry(entry);
+        }
+
+        fluid_mutex_unlock(shard->mutex);
+
+        if(evict)
+        {
+            delete_samplecache_entry(entry);
+        }
+    }
+}
+
+/* Adds the entry as most recently used, samplecache_lru_mutex has to be locked */
+static void lru_insert(fluid_samplecache_entry_t *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = samplecache_lru_head;
+
+    if(samplecache_lru_head != NULL)
+    {
+        samplecache_lru_head->lru_prev = entry;
+    }
+    else
+    {
+        samplecache_lru_tail = entry;
+    }
+
+    samplecache_lru_head = entry;
+    entry->in_lru = TRUE;
+    samplecache_unused_size += samplecache_entry_size(entry);
+}
+
+/* samplecache_lru_mutex has to be locked */
+static void lru_remove(fluid_samplecache_entry_t *entry)
+{
+    if(entry->lru_prev != NULL)
+    {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else
+    {
+        samplecache_lru_head = entry->lru_next;
+    }
+
+    if(entry->lru_next != NULL)
+    {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else
+    {
+        samplecache_lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = entry->lru_next = NULL;
+    entry->in_lru = FALSE;
+    samplecache_unused_size -= samplecache_entry_size(entry);
+}
+
+static size_t samplecache_entry_size(const fluid_samplecache_entry_t *entry)
+{
+    size_t frame_size = (entry->sample_data24 != NULL) ? 3 : 2;
+
+    if(entry->sample_float_data != NULL)
+    {
+        frame_size += sizeof(float);
+    }
+
+    return (size_t)entry->sample_count * frame_size;
+}
 static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
         unsigned int sample_start,
         unsigned int sample_end,
         int sample_type,
-        time_t mtime)
+        time_t mtime,
+        int try_mmap,
+        const char *cache_dir,
+        int try_shm)
 {
     fluid_samplecache_entry_t *entry;
+    int use_cache_dir;
+    double start;
 
     entry = FLUID_NEW(fluid_samplecache_entry_t);
 
@@ -218,9 +636,64 @@ static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
     entry->sample_end = sample_end;
     entry->sample_type = sample_type;
     entry->modification_time = mtime;
+    entry->huge_pages = sf->huge_pages;
+
+    entry->sample_count = -1;
+
+    if(try_mmap)
+    {
+        /* Fall back to reading the samples if they cannot be mapped */
+        entry->sample_count = fluid_sffile_map_sample_data(sf, sample_start, sample_end, sample_type,
+                              &entry->sample_data, &entry->sample_data24,
+                              &entry->mapping, &entry->mapping24);
+    }
+
+    /* Compressed samples may have been decoded before */
+    use_cache_dir = (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) && cache_dir != NULL && cache_dir[0] != '\0';
+
+    if(entry->sample_count < 0 && use_cache_dir)
+    {
+        start = fluid_sfont_load_stats_start(sf->load_stats);
+        entry->sample_count = load_samplecache_file(entry, cache_dir);
+
+        if(entry->sample_count >= 0)
+        {
+            fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_IO, start,
+                                       entry->sample_count * sizeof(short));
+        }
+    }
+
+    /* Another process may have read them before */
+    if(entry->sample_count < 0 && try_shm)
+    {
+        start = fluid_sfont_load_stats_start(sf->load_stats);
+        entry->sample_count = load_samplecache_shm(entry);
+
+        if(entry->sample_count >= 0)
+        {
+            fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_CACHE, start,
+                                       entry->sample_count * (sizeof(short) + ((entry->sample_data24 != NULL) ? 1 : 0)));
+        }
+    }
 
-    entry->sample_count = fluid_sffile_read_sample_data(sf, sample_start, sample_end, sample_type,
-                          &entry->sample_data, &entry->sample_data24);
+    if(entry->sample_count < 0)
+    {
+        entry->sample_count = fluid_sffile_read_sample_data(sf, sample_start, sample_end, sample_type,
+                              &entry->sample_data, &entry->sample_data24);
+        start = fluid_sfont_load_stats_start(sf->load_stats);
+
+        if(entry->sample_count > 0 && use_cache_dir)
+        {
+            store_samplecache_file(entry, cache_dir);
+        }
+
+        if(entry->sample_count > 0 && try_shm)
+        {
+            store_samplecache_shm(entry);
+        }
+
+        fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_CACHE, start, 0);
+    }
 
     if(entry->sample_count < 0)
     {
@@ -239,43 +712,521 @@ static void delete_samplecache_entry(fluid_samplecache_entry_t *entry)
     fluid_return_if_fail(entry != NULL);
 
     FLUID_FREE(entry->filename);
-    FLUID_FREE(entry->sample_data);
-    FLUID_FREE(entry->sample_data24);
+
+    if(entry->mapping != NULL)
+    {
+        delete_fluid_file_mapping(entry->mapping);
+        delete_fluid_file_mapping(entry->mapping24);
+    }
+    else
+    {
+        FLUID_FREE(entry->sample_data);
+        FLUID_FREE(entry->sample_data24);
+    }
+
+    FLUID_FREE(entry->sample_float_buf);
     FLUID_FREE(entry);
 }
 
+/* Converts the sample data of the entry to float, merging the least significant bytes of 24 bit
+ * samples into them, so that the interpolation can read each sample point at once. Retried on the
+ * next load if it fails, as the sample data can be used as they are in the meantime. The shard of
+ * the entry has to be locked, and the entry must not be in the list of unreferenced entries. */
+static void convert_samplecache_entry(fluid_samplecache_entry_t *entry, int locked)
+{
+    float *data;
+    int i;
+
+    if(entry->sample_count <= 0)
+    {
+        return;
+    }
+
+    entry->sample_float_buf = FLUID_MALLOC(entry->sample_count * sizeof(float) + FLUID_DEFAULT_ALIGNMENT);
+
+    if(entry->sample_float_buf == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Out of memory converting the sample data to float, using them as they are");
+        return;
+    }
+
+    data = fluid_align_ptr(entry->sample_float_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    if(entry->huge_pages)
+    {
+        fluid_huge_pages_advise(data, entry->sample_count * sizeof(float));
+    }
+
+    for(i = 0; i < entry->sample_count; i++)
+    {
+        uint32_t msb = (uint32_t)entry->sample_data[i];
+        uint8_t lsb = (entry->sample_data24 != NULL) ? (uint8_t)entry->sample_data24[i] : 0U;
+
+        /* exact, the 24 bits fit into the mantissa */
+        data[i] = (float)(int32_t)((msb << 8) | lsb);
+    }
+
+    /* the other sample data of the entry are locked already */
+    if(locked && fluid_mlock(data, entry->sample_count * sizeof(float)) != 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
+    }
+
+    entry->sample_float_data = data;
+}
+
+/* Logs how much of the sample data of a large entry the system backs with huge pages */
+static void report_samplecache_huge_pages(const fluid_samplecache_entry_t *entry)
+{
+    unsigned long size, huge;
+
+    /* the mapped ones aren't anonymous memory */
+    if(entry->mapping != NULL || entry->sample_count <= 0)
+    {
+        return;
+    }
+
+    size = entry->sample_count * sizeof(short);
+    huge = fluid_huge_pages_get_size(entry->sample_data, size);
+
+    if(entry->sample_data24 != NULL)
+    {
+        size += entry->sample_count;
+        huge += fluid_huge_pages_get_size(entry->sample_data24, entry->sample_count);
+    }
+
+    if(entry->sample_float_data != NULL)
+    {
+        size += entry->sample_count * sizeof(float);
+        huge += fluid_huge_pages_get_size(entry->sample_float_data, entry->sample_count * sizeof(float));
+    }
+
+    /* the samples loaded one by one are mostly smaller than a huge page */
+    if(size >= SAMPLECACHE_HUGE_PAGES_REPORT_SIZE)
+    {
+        FLUID_LOG(FLUID_INFO, "%lu of %lu kB of the sample data of '%s' are in huge pages",
+                  huge / 1024, size / 1024, entry->filename);
+    }
+}
+
 static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf,
         unsigned int sample_start,
         unsigned int sample_end,
         int sample_type,
         time_t mtime)
 {
-    fluid_list_t *entry_list;
-    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_shard_t *shard = &samplecache_shards[fluid_str_hash(sf->fname) % SAMPLECACHE_NUM_SHARDS];
+    fluid_samplecache_entry_t key;
+
+    if(shard->entries == NULL)
+    {
+        return NULL;
+    }
+
+    /* only the cache key members are used for the lookup */
+    key.filename = sf->fname;
+    key.modification_time = mtime;
+    key.sf_samplepos = sf->samplepos;
+    key.sf_samplesize = sf->samplesize;
+    key.sf_sample24pos = sf->sample24pos;
+    key.sf_sample24size = sf->sample24size;
+    key.sample_start = sample_start;
+    key.sample_end = sample_end;
+    key.sample_type = sample_type;
+
+    return fluid_hashtable_lookup(shard->entries, &key);
+}
+
+static fluid_samplecache_entry_t *find_samplecache_entry_by_data(const short *sample_data)
+{
+    fluid_samplecache_shard_t *data_shard = get_data_shard(sample_data);
+    fluid_samplecache_entry_t *entry = NULL;
+
+    fluid_mutex_lock(data_shard->mutex);
+
+    if(data_shard->entries != NULL)
+    {
+        entry = fluid_hashtable_lookup(data_shard->entries, sample_data);
+    }
+
+    fluid_mutex_unlock(data_shard->mutex);
+    return entry;
+}
+
+/* Adds the entry to both indexes, the shard of the entry has to be locked */
+static void add_samplecache_entry(fluid_samplecache_entry_t *entry)
+{
+    fluid_samplecache_shard_t *shard = &samplecache_shards[entry->shard];
+    fluid_samplecache_shard_t *data_shard = get_data_shard(entry->sample_data);
+
+    if(shard->entries == NULL)
+    {
+        shard->entries = new_fluid_hashtable(samplecache_entry_hash, samplecache_entry_equal);
+    }
+
+    fluid_hashtable_insert(shard->entries, entry, entry);
 
-    entry_list = samplecache_list;
+    fluid_mutex_lock(data_shard->mutex);
 
-    while(entry_list)
+    if(data_shard->entries == NULL)
     {
-        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+        data_shard->entries = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+    }
+
+    fluid_hashtable_insert(data_shard->entries, entry->sample_data, entry);
+    fluid_mutex_unlock(data_shard->mutex);
+}
+
+/* Removes the entry from both indexes, the shard of the entry has to be locked */
+static void remove_samplecache_entry(fluid_samplecache_entry_t *entry)
+{
+    fluid_samplecache_shard_t *shard = &samplecache_shards[entry->shard];
+    fluid_samplecache_shard_t *data_shard = get_data_shard(entry->sample_data);
+
+    fluid_hashtable_remove(shard->entries, entry);
+
+    if(fluid_hashtable_size(shard->entries) == 0)
+    {
+        delete_fluid_hashtable(shard->entries);
+        shard->entries = NULL;
+    }
+
+    fluid_mutex_lock(data_shard->mutex);
+    fluid_hashtable_remove(data_shard->entries, entry->sample_data);
+
+    if(fluid_hashtable_size(data_shard->entries) == 0)
+    {
+        delete_fluid_hashtable(data_shard->entries);
+        data_shard->entries = NULL;
+    }
+
+    fluid_mutex_unlock(data_shard->mutex);
+}
+
+static fluid_samplecache_shard_t *get_data_shard(const short *sample_data)
+{
+    /* the low bits of the address are the same for most allocations */
+    return &samplecache_data_shards[((uintptr_t)sample_data >> 6) % SAMPLECACHE_NUM_SHARDS];
+}
+
+static unsigned int samplecache_entry_hash(const void *key)
+{
+    const fluid_samplecache_entry_t *entry = key;
+    unsigned int h = fluid_str_hash(entry->filename);
+
+    h = h * 31 + (unsigned int)entry->modification_time;
+    h = h * 31 + entry->sf_samplepos;
+    h = h * 31 + entry->sf_sample24pos;
+    h = h * 31 + entry->sample_start;
+    h = h * 31 + entry->sample_end;
+    h = h * 31 + (unsigned int)entry->sample_type;
+
+    return h;
+}
+
+static int samplecache_entry_equal(const void *a, const void *b)
+{
+    const fluid_samplecache_entry_t *entry1 = a;
+    const fluid_samplecache_entry_t *entry2 = b;
 
-        if((FLUID_STRCMP(sf->fname, entry->filename) == 0) &&
-                (mtime == entry->modification_time) &&
-                (sf->samplepos == entry->sf_samplepos) &&
-                (sf->samplesize == entry->sf_samplesize) &&
-                (sf->sample24pos == entry->sf_sample24pos) &&
-                (sf->sample24size == entry->sf_sample24size) &&
-                (sample_start == entry->sample_start) &&
-                (sample_end == entry->sample_end) &&
-                (sample_type == entry->sample_type))
+    return (FLUID_STRCMP(entry1->filename, entry2->filename) == 0) &&
+           (entry1->modification_time == entry2->modification_time) &&
+           (entry1->sf_samplepos == entry2->sf_samplepos) &&
+           (entry1->sf_samplesize == entry2->sf_samplesize) &&
+           (entry1->sf_sample24pos == entry2->sf_sample24pos) &&
+           (entry1->sf_sample24size == entry2->sf_sample24size) &&
+           (entry1->sample_start == entry2->sample_start) &&
+           (entry1->sample_end == entry2->sample_end) &&
+           (entry1->sample_type == entry2->sample_type);
+}
+
+/* The file of the decoded sample data of the entry in the cache directory */
+static void get_samplecache_file_path(const fluid_samplecache_entry_t *entry, const char *cache_dir,
+                                      char *path, int size)
+{
+    FLUID_SNPRINTF(path, size, "%s/fluidsynth-%08x-%u-%u.pcm", cache_dir,
+                   fluid_str_hash(entry->filename), entry->sample_start, entry->sample_end);
+}
+
+static void init_samplecache_file_header(const fluid_samplecache_entry_t *entry,
+        fluid_samplecache_file_header_t *header)
+{
+    unsigned int length = (unsigned int)FLUID_STRLEN(entry->filename);
+
+    FLUID_MEMSET(header, 0, sizeof(*header));
+    FLUID_MEMCPY(header->magic, SAMPLECACHE_FILE_MAGIC, sizeof(header->magic));
+    header->byte_order = SAMPLECACHE_FILE_BYTE_ORDER;
+    /* keep the samples aligned */
+    header->header_size = (sizeof(*header) + length + 15) & ~15u;
+    header->modification_time = (uint64_t)entry->modification_time;
+    header->sf_samplepos = entry->sf_samplepos;
+    header->sf_samplesize = entry->sf_samplesize;
+    header->sample_start = entry->sample_start;
+    header->sample_end = entry->sample_end;
+    header->sample_count = (uint32_t)entry->sample_count;
+    header->filename_length = length;
+}
+
+/*
+ * Maps (or reads, if mapping isn't possible) the decoded sample data of the entry from its
+ * file in the cache directory. Returns the number of samples, -1 if there is no such file
+ * or it doesn't belong to the SoundFont as it is now.
+ */
+static int load_samplecache_file(fluid_samplecache_entry_t *entry, const char *cache_dir)
+{
+    fluid_samplecache_file_header_t header, expected;
+    char path[1024];
+    char *filename = NULL;
+    FILE *file;
+    int count = -1;
+    long size;
+
+    get_samplecache_file_path(entry, cache_dir, path, sizeof(path));
+    file = FLUID_FOPEN(path, "rb");
+
+    if(file == NULL)
+    {
+        return -1;
+    }
+
+    if(FLUID_FREAD(&header, sizeof(header), 1, file) != 1)
+    {
+        goto exit;
+    }
+
+    entry->sample_count = (int)header.sample_count;
+    init_samplecache_file_header(entry, &expected);
+    entry->sample_count = -1;
+
+    if(FLUID_MEMCMP(&header, &expected, sizeof(header)) != 0 || header.sample_count == 0
+            || header.sample_count > INT_MAX / sizeof(short))
+    {
+        FLUID_LOG(FLUID_DBG, "Ignoring outdated decoded sample data '%s'", path);
+        goto exit;
+    }
+
+    filename = FLUID_MALLOC(header.filename_length);
+
+    if(filename == NULL
+            || FLUID_FREAD(filename, 1, header.filename_length, file) != header.filename_length
+            || FLUID_MEMCMP(filename, entry->filename, header.filename_length) != 0)
+    {
+        goto exit;
+    }
+
+    /* a file truncated while written would crash when accessing the mapping */
+    if(FLUID_FSEEK(file, 0, SEEK_END) != 0 || (size = FLUID_FTELL(file)) < 0
+            || (unsigned long)size < header.header_size + header.sample_count * sizeof(short))
+    {
+        goto exit;
+    }
+
+    entry->mapping = new_fluid_file_mapping(path, header.header_size, header.sample_count * sizeof(short));
+
+    if(entry->mapping != NULL)
+    {
+        entry->sample_data = (short *)fluid_file_mapping_get_data(entry->mapping);
+    }
+    else
+    {
+        entry->sample_data = FLUID_ARRAY(short, header.sample_count);
+
+        if(entry->sample_data != NULL && entry->huge_pages)
         {
-            return entry;
+            fluid_huge_pages_advise(entry->sample_data, header.sample_count * sizeof(short));
         }
 
-        entry_list = fluid_list_next(entry_list);
+        if(entry->sample_data == NULL
+                || FLUID_FSEEK(file, header.header_size, SEEK_SET) != 0
+                || FLUID_FREAD(entry->sample_data, sizeof(short), header.sample_count, file) != header.sample_count)
+        {
+            FLUID_FREE(entry->sample_data);
+            entry->sample_data = NULL;
+            goto exit;
+        }
     }
 
-    return NULL;
+    count = (int)header.sample_count;
+    FLUID_LOG(FLUID_DBG, "Loaded decoded sample data from '%s'", path);
+
+exit:
+    FLUID_FREE(filename);
+    FLUID_FCLOSE(file);
+    return count;
+}
+
+/*
+ * Stores the decoded sample data of the entry into its file in the cache directory.
+ * It's written to a temporary file first, so that others never see a partial file.
+ * Failing is not an error, the sample data will just be decoded again next time.
+ */
+static void store_samplecache_file(const fluid_samplecache_entry_t *entry, const char *cache_dir)
+{
+    fluid_samplecache_file_header_t header;
+    static const char padding[16] = { 0 };
+    char path[1024], tmp_path[1100];
+    FILE *file;
+    size_t length;
+    int ok;
+
+    init_samplecache_file_header(entry, &header);
+    length = header.filename_length;
+
+    get_samplecache_file_path(entry, cache_dir, path, sizeof(path));
+    FLUID_SNPRINTF(tmp_path, sizeof(tmp_path), "%s.%p.%.0f.tmp", path, (const void *)entry, fluid_utime());
+
+    file = FLUID_FOPEN(tmp_path, "wb");
+
+    if(file == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to create '%s' to store decoded sample data", tmp_path);
+        return;
+    }
+
+    ok = (fwrite(&header, sizeof(header), 1, file) == 1)
+         && (fwrite(entry->filename, 1, length, file) == length)
+         && (fwrite(padding, 1, header.header_size - sizeof(header) - length, file)
+             == header.header_size - sizeof(header) - length)
+         && (fwrite(entry->sample_data, sizeof(short), entry->sample_count, file) == (size_t)entry->sample_count);
+
+    ok = (FLUID_FCLOSE(file) == 0) && ok;
+
+    if(!ok || rename(tmp_path, path) != 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to store decoded sample data to '%s'", path);
+        remove(tmp_path);
+    }
+}
+
+/* The shared memory object of the sample data of the entry, also named after the modification
+ * time of the SoundFont, so that a modified SoundFont gets new objects */
+static void get_samplecache_shm_name(const fluid_samplecache_entry_t *entry, char *name, int size)
+{
+    FLUID_SNPRINTF(name, size, "/fluidsynth-%08x-%08x-%u-%u", fluid_str_hash(entry->filename),
+                   (unsigned int)entry->modification_time, entry->sample_start, entry->sample_end);
+}
+
+/*
+ * Maps the sample data of the entry from its shared memory object. Returns the number of
+ * samples, -1 if there is no such object or it doesn't belong to the SoundFont as it is now.
+ */
+static int load_samplecache_shm(fluid_samplecache_entry_t *entry)
+{
+    fluid_samplecache_file_header_t header, expected;
+    fluid_file_mapping_t *mapping;
+    fluid_samplecache_file_header_t *shared;
+    char name[128];
+    unsigned int size;
+    uint32_t byte_order;
+
+    get_samplecache_shm_name(entry, name, sizeof(name));
+    mapping = new_fluid_shm_mapping(name, 0, sizeof(header));
+
+    if(mapping == NULL)
+    {
+        return -1;
+    }
+
+    /* the byte order is stored last by the process filling the object */
+    shared = fluid_file_mapping_get_data(mapping);
+    byte_order = (uint32_t)fluid_atomic_int_get((fluid_atomic_int_t *)&shared->byte_order);
+    FLUID_MEMCPY(&header, shared, sizeof(header));
+    header.byte_order = byte_order;
+    delete_fluid_file_mapping(mapping);
+
+    entry->sample_count = (int)header.sample_count;
+    init_samplecache_file_header(entry, &expected);
+    entry->sample_count = -1;
+
+    if(FLUID_MEMCMP(&header, &expected, sizeof(header)) != 0 || header.sample_count == 0
+            || header.sample_count > (INT_MAX - header.header_size) / sizeof(short))
+    {
+        FLUID_LOG(FLUID_DBG, "Ignoring incomplete or outdated shared sample data '%s'", name);
+        return -1;
+    }
+
+    size = header.header_size + header.sample_count * (unsigned int)sizeof(short);
+    mapping = new_fluid_shm_mapping(name, 0, size);
+
+    if(mapping == NULL)
+    {
+        return -1;
+    }
+
+    if(FLUID_MEMCMP((char *)fluid_file_mapping_get_data(mapping) + sizeof(header),
+                    entry->filename, header.filename_length) != 0)
+    {
+        delete_fluid_file_mapping(mapping);
+        return -1;
+    }
+
+    entry->mapping = mapping;
+    entry->sample_data = (short *)((char *)fluid_file_mapping_get_data(mapping) + header.header_size);
+    FLUID_LOG(FLUID_DBG, "Mapped shared sample data '%s'", name);
+
+    return (int)header.sample_count;
+}
+
+/*
+ * Stores the sample data of the entry into a new shared memory object and maps them
+ * from there instead. An existing object is left alone, whether complete or still being
+ * filled by another process. The byte order is stored last, so that others never map a
+ * partial object. Failing is not an error, the entry just keeps its own copy.
+ */
+static void store_samplecache_shm(fluid_samplecache_entry_t *entry)
+{
+    fluid_samplecache_file_header_t header;
+    fluid_samplecache_file_header_t *shared;
+    fluid_file_mapping_t *mapping;
+    char name[128];
+    char *data;
+    size_t size;
+
+    /* only the 16 bit sample data fit the format */
+    if(entry->mapping != NULL || entry->sample_data24 != NULL)
+    {
+        return;
+    }
+
+    init_samplecache_file_header(entry, &header);
+
+    if(header.sample_count > (INT_MAX - header.header_size) / sizeof(short))
+    {
+        return;
+    }
+
+    size = header.header_size + entry->sample_count * sizeof(short);
+
+    get_samplecache_shm_name(entry, name, sizeof(name));
+    mapping = new_fluid_shm_object(name, (unsigned long)size);
+
+    if(mapping == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Not storing sample data to shared memory '%s'", name);
+        return;
+    }
+
+    /* the new object is zeroed, including the padding after the file name */
+    data = fluid_file_mapping_get_data(mapping);
+    shared = (fluid_samplecache_file_header_t *)data;
+    header.byte_order = 0;
+    FLUID_MEMCPY(data, &header, sizeof(header));
+    FLUID_MEMCPY(data + sizeof(header), entry->filename, header.filename_length);
+    FLUID_MEMCPY(data + header.header_size, entry->sample_data, entry->sample_count * sizeof(short));
+    fluid_atomic_int_set((fluid_atomic_int_t *)&shared->byte_order, SAMPLECACHE_FILE_BYTE_ORDER);
+    delete_fluid_file_mapping(mapping);
+
+    /* share the pages with the other processes rather than keeping a copy */
+    mapping = new_fluid_shm_mapping(name, header.header_size, (unsigned long)(entry->sample_count * sizeof(short)));
+
+    if(mapping != NULL)
+    {
+        FLUID_FREE(entry->sample_data);
+        entry->mapping = mapping;
+        entry->sample_data = fluid_file_mapping_get_data(mapping);
+    }
+
+    FLUID_LOG(FLUID_DBG, "Stored sample data to shared memory '%s'", name);
 }
 
 static int fluid_get_file_modification_time(char *filename, time_t *modification_time)
@@ -27,8 +27,17 @@
 
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **data, char **data24);
+                           int try_mlock, int try_mmap, unsigned int cache_size, const char *cache_dir,
+                           int try_shm, int to_float, short **data, char **data24, float **float_data);
 
 int fluid_samplecache_unload(const short *sample_data);
 
+int fluid_samplecache_is_mapped(const short *sample_data);
+
+int fluid_samplecache_get_memory(const short *sample_data, size_t *size, int *shared, int *locked);
+
+int fluid_samplecache_contains(SFData *sf, unsigned int sample_start, unsigned int sample_end, int sample_type);
+
+void fluid_samplecache_get_stats(unsigned int *hits, unsigned int *misses, size_t *unused_size);
+
 #endif /* _FLUID_SAMPLECACHE_H */
@@ -0,0 +1,495 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_samplestream.h"
+#include "fluid_ringbuffer.h"
+#include "fluid_sys.h"
+
+/* How long the streamer thread sleeps once all ring buffers are full, in milliseconds.
+ * The ring buffers and the heads of the samples last many times that. */
+#define FLUID_SAMPLE_STREAMER_PERIOD 4
+
+/* Frames copied into a ring buffer at once, before the next ring buffer gets its turn */
+#define FLUID_SAMPLE_STREAM_CHUNK 4096
+
+/* Who a ring buffer of the pool belongs to */
+enum fluid_sample_stream_state
+{
+    FLUID_SAMPLE_STREAM_FREE,       /* the synth, which may hand it out to a voice */
+    FLUID_SAMPLE_STREAM_ACTIVE,     /* the streamer thread, filling it for a voice */
+    FLUID_SAMPLE_STREAM_RELEASED,   /* the streamer thread, until it stops filling it */
+    FLUID_SAMPLE_STREAM_DONE        /* the synth, which lets go of the sample */
+};
+
+struct _fluid_sample_stream_t
+{
+    fluid_sample_t *sample;     /* referenced until the stream is free again */
+    const short *data;
+    const char *data24;
+    unsigned int first;         /* the first frame streamed, the guard before the end of the head */
+    unsigned int end;           /* the last frame of the sample */
+
+    /* FLUID_SAMPLE_STREAM_FRAMES + FLUID_SAMPLE_STREAM_GUARD frames, frame i being
+     * at i % FLUID_SAMPLE_STREAM_FRAMES, and also at FLUID_SAMPLE_STREAM_FRAMES + i % FLUID_SAMPLE_STREAM_FRAMES
+     * if that's within the guard */
+    short *ring;
+    char *ring24;               /* the least significant bytes, allocated by the streamer thread once needed */
+
+    fluid_atomic_int_t filled;  /* the frame following the last one streamed, set by the streamer thread */
+    fluid_atomic_int_t needed;  /* the first frame the voice still reads, set by the rendering */
+    fluid_atomic_int_t state;
+};
+
+struct _fluid_sample_streamer_t
+{
+    fluid_sample_stream_t *streams;
+    int stream_count;
+    int next_stream;                /* where the synth looks for a free stream first */
+    fluid_atomic_int_t done_count;  /* streams the streamer thread is done with */
+
+    fluid_ringbuffer_t *queue;      /* streams handed out, for the streamer thread */
+    fluid_sample_stream_t **active; /* streams filled by the streamer thread */
+    int active_count;
+
+    fluid_thread_t *thread;
+    fluid_atomic_int_t quit;
+};
+
+static fluid_thread_return_t fluid_sample_streamer_run(void *data);
+
+
+/*
+ * Create the streamer thread, with a pool of \c stream_count ring buffers: as many
+ * voices as that can stream their samples at the same time, the others read them
+ * from the mapped file.
+ */
+fluid_sample_streamer_t *new_fluid_sample_streamer(int stream_count)
+{
+    fluid_sample_streamer_t *streamer;
+    int i;
+
+    fluid_return_val_if_fail(stream_count > 0, NULL);
+
+    streamer = FLUID_NEW(fluid_sample_streamer_t);
+
+    if(streamer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(streamer, 0, sizeof(*streamer));
+
+    streamer->streams = FLUID_ARRAY(fluid_sample_stream_t, stream_count);
+    streamer->active = FLUID_ARRAY(fluid_sample_stream_t *, stream_count);
+    streamer->queue = new_fluid_ringbuffer(stream_count, sizeof(fluid_sample_stream_t *));
+
+    if(streamer->streams == NULL || streamer->active == NULL || streamer->queue == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(streamer->streams, 0, stream_count * sizeof(*streamer->streams));
+    streamer->stream_count = stream_count;
+
+    for(i = 0; i < stream_count; i++)
+    {
+        streamer->streams[i].ring = FLUID_ARRAY(short, FLUID_SAMPLE_STREAM_FRAMES + FLUID_SAMPLE_STREAM_GUARD);
+
+        if(streamer->streams[i].ring == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+    }
+
+    streamer->thread = new_fluid_thread("sample-streamer", fluid_sample_streamer_run, streamer, 0, FALSE);
+
+    if(streamer->thread == NULL)
+    {
+        goto error_recovery;
+    }
+
+    return streamer;
+
+error_recovery:
+    delete_fluid_sample_streamer(streamer);
+    return NULL;
+}
+
+/*
+ * Stop the streamer thread and free the ring buffers. Must not be called while
+ * the voices using them are rendered.
+ */
+void delete_fluid_sample_streamer(fluid_sample_streamer_t *streamer)
+{
+    int i;
+
+    fluid_return_if_fail(streamer != NULL);
+
+    if(streamer->thread != NULL)
+    {
+        fluid_atomic_int_set(&streamer->quit, TRUE);
+        fluid_thread_join(streamer->thread);
+        delete_fluid_thread(streamer->thread);
+    }
+
+    for(i = 0; i < streamer->stream_count; i++)
+    {
+        fluid_sample_stream_t *stream = &streamer->streams[i];
+
+        if(stream->sample != NULL)
+        {
+            fluid_sample_decr_ref(stream->sample);
+        }
+
+        FLUID_FREE(stream->ring);
+        FLUID_FREE(stream->ring24);
+    }
+
+    delete_fluid_ringbuffer(streamer->queue);
+    FLUID_FREE(streamer->active);
+    FLUID_FREE(streamer->streams);
+    FLUID_FREE(streamer);
+}
+
+/* The bytes taken by the ring buffers of the pool */
+size_t fluid_sample_streamer_get_memory(const fluid_sample_streamer_t *streamer)
+{
+    const size_t ring_size = FLUID_SAMPLE_STREAM_FRAMES + FLUID_SAMPLE_STREAM_GUARD;
+    size_t size = sizeof(*streamer)
+                  + streamer->stream_count * (sizeof(fluid_sample_stream_t) + 2 * sizeof(fluid_sample_stream_t *)
+                                              + ring_size * sizeof(short));
+    int i;
+
+    for(i = 0; i < streamer->stream_count; i++)
+    {
+        if(streamer->streams[i].ring24 != NULL)
+        {
+            size += ring_size;
+        }
+    }
+
+    return size;
+}
+
+/*
+ * Hand a ring buffer of the pool out to a voice starting to play a streamed sample,
+ * and have the streamer thread fill it with the frames following the head of the
+ * sample. Returns NULL if the sample isn't streamed, or if all ring buffers are in
+ * use, the voice reads the frames from the mapped file then.
+ *
+ * Must only be called by one thread at a time, i.e. with the synth API entered.
+ * The stream must be released by fluid_sample_stream_release() once the voice is
+ * finished.
+ */
+fluid_sample_stream_t *fluid_sample_streamer_start(fluid_sample_streamer_t *streamer, fluid_sample_t *sample)
+{
+    fluid_sample_stream_t *stream = NULL, **request;
+    int i;
+
+    fluid_return_val_if_fail(streamer != NULL, NULL);
+    fluid_return_val_if_fail(sample != NULL, NULL);
+
+    /* all of it is in memory */
+    if(sample->stream_data == NULL || sample->start + sample->stream_preload > sample->end)
+    {
+        return NULL;
+    }
+
+    fluid_sample_streamer_collect(streamer);
+
+    for(i = 0; i < streamer->stream_count; i++)
+    {
+        int index = (streamer->next_stream + i) % streamer->stream_count;
+
+        if(fluid_atomic_int_get(&streamer->streams[index].state) == FLUID_SAMPLE_STREAM_FREE)
+        {
+            stream = &streamer->streams[index];
+            streamer->next_stream = (index + 1) % streamer->stream_count;
+            break;
+        }
+    }
+
+    /* the queue holds a stream from being handed out until the streamer thread takes
+     * it, which is before the stream can be handed out again: it can't be full */
+    request = fluid_ringbuffer_get_inptr(streamer->queue, 0);
+
+    if(stream == NULL || request == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "No ring buffer left to stream sample '%s'", sample->name);
+        return NULL;
+    }
+
+    fluid_sample_incr_ref(sample);
+    stream->sample = sample;
+    stream->data = sample->data;
+    stream->data24 = sample->data24;
+    /* the voice reads the frames around its position in one piece, and changes over
+     * from the head to the ring buffer anywhere within the guard */
+    stream->first = sample->start + sample->stream_preload;
+    stream->first -= (sample->stream_preload > FLUID_SAMPLE_STREAM_GUARD) ? FLUID_SAMPLE_STREAM_GUARD
+                     : sample->stream_preload;
+    stream->end = sample->end;
+    fluid_atomic_int_set(&stream->filled, (int)stream->first);
+    fluid_atomic_int_set(&stream->needed, (int)stream->first);
+    fluid_atomic_int_set(&stream->state, FLUID_SAMPLE_STREAM_ACTIVE);
+
+    *request = stream;
+    fluid_ringbuffer_next_inptr(streamer->queue, 1);
+
+    return stream;
+}
+
+/*
+ * Give a stream back once its voice is finished, i.e. not rendered anymore. The
+ * streamer thread stops filling it, and fluid_sample_streamer_collect() puts it
+ * back into the pool.
+ */
+void fluid_sample_stream_release(fluid_sample_stream_t *stream)
+{
+    fluid_return_if_fail(stream != NULL);
+
+    fluid_atomic_int_set(&stream->state, FLUID_SAMPLE_STREAM_RELEASED);
+}
+
+/*
+ * Put the streams released and no longer filled by the streamer thread back into the
+ * pool, and let go of their samples. Must only be called by one thread at a time, i.e.
+ * with the synth API entered, as a sample may be unloaded by that.
+ */
+void fluid_sample_streamer_collect(fluid_sample_streamer_t *streamer)
+{
+    int i;
+
+    fluid_return_if_fail(streamer != NULL);
+
+    if(fluid_atomic_int_get(&streamer->done_count) == 0)
+    {
+        return;
+    }
+
+    for(i = 0; i < streamer->stream_count; i++)
+    {
+        fluid_sample_stream_t *stream = &streamer->streams[i];
+        fluid_sample_t *sample = stream->sample;
+
+        if(fluid_atomic_int_get(&stream->state) != FLUID_SAMPLE_STREAM_DONE)
+        {
+            continue;
+        }
+
+        stream->sample = NULL;
+        fluid_atomic_int_add(&streamer->done_count, -1);
+        fluid_atomic_int_set(&stream->state, FLUID_SAMPLE_STREAM_FREE);
+        fluid_sample_decr_ref(sample);
+    }
+}
+
+/*
+ * Get the part of the sample streamed into the ring buffer of a voice, starting at
+ * frame \c first and covering frame \c last at least, to be read by the voice in one
+ * piece. The frames before \c first may be streamed over afterwards, so the voice
+ * mustn't ask for them anymore. Called by the rendering of the voice, it doesn't wait
+ * for the streamer thread.
+ *
+ * @param base Location to store the frame of the sample the part starts at, i.e. \c first
+ * @param count Location to store the frames of the part, more than \c last - \c first
+ * @param data Location to store the 16 bit points of the part
+ * @param data24 Location to store the least significant bytes of the part, NULL for 16 bit samples
+ * @return TRUE on success, FALSE if the frames are not (or no longer) in the ring buffer
+ */
+int fluid_sample_stream_get_window(fluid_sample_stream_t *stream, unsigned int first, unsigned int last,
+                                   unsigned int *base, unsigned int *count,
+                                   short **data, char **data24)
+{
+    unsigned int needed = (unsigned int)fluid_atomic_int_get(&stream->needed);
+    unsigned int filled, offset, n;
+
+    if(first < needed || last < first || last - first >= FLUID_SAMPLE_STREAM_GUARD)
+    {
+        return FALSE;
+    }
+
+    /* the streamer thread may stream over the frames before it from now on */
+    if(first > needed)
+    {
+        fluid_atomic_int_set(&stream->needed, (int)first);
+    }
+
+    filled = (unsigned int)fluid_atomic_int_get(&stream->filled);
+
+    if(last >= filled || (stream->data24 != NULL && stream->ring24 == NULL))
+    {
+        return FALSE;
+    }
+
+    /* the streamer thread streams no further than a ring ahead of the frames needed,
+     * all frames up to filled are in the ring */
+    offset = first % FLUID_SAMPLE_STREAM_FRAMES;
+    n = filled - first;
+
+    if(n > FLUID_SAMPLE_STREAM_FRAMES + FLUID_SAMPLE_STREAM_GUARD - offset)
+    {
+        n = FLUID_SAMPLE_STREAM_FRAMES + FLUID_SAMPLE_STREAM_GUARD - offset;
+    }
+
+    *base = first;
+    *count = n;
+    *data = stream->ring + offset;
+    *data24 = (stream->ring24 != NULL) ? stream->ring24 + offset : NULL;
+
+    return TRUE;
+}
+
+/* Copy frames of the sample into the ring buffer, not wrapping around the ring */
+static void fluid_sample_stream_copy(fluid_sample_stream_t *stream, unsigned int frame, unsigned int count)
+{
+    unsigned int offset = frame % FLUID_SAMPLE_STREAM_FRAMES;
+
+    FLUID_MEMCPY(stream->ring + offset, stream->data + frame, count * sizeof(short));
+
+    if(stream->ring24 != NULL)
+    {
+        FLUID_MEMCPY(stream->ring24 + offset, stream->data24 + frame, count);
+    }
+
+    /* the guard repeats the start of the ring */
+    if(offset < FLUID_SAMPLE_STREAM_GUARD)
+    {
+        unsigned int n = (offset + count > FLUID_SAMPLE_STREAM_GUARD) ? FLUID_SAMPLE_STREAM_GUARD - offset : count;
+
+        FLUID_MEMCPY(stream->ring + FLUID_SAMPLE_STREAM_FRAMES + offset, stream->data + frame, n * sizeof(short));
+
+        if(stream->ring24 != NULL)
+        {
+            FLUID_MEMCPY(stream->ring24 + FLUID_SAMPLE_STREAM_FRAMES + offset, stream->data24 + frame, n);
+        }
+    }
+}
+
+/*
+ * Stream a chunk of the sample into the ring buffer of a voice, up to a ring ahead of
+ * the first frame the voice still needs. Returns TRUE if anything has been streamed.
+ */
+static int fluid_sample_stream_fill(fluid_sample_stream_t *stream)
+{
+    unsigned int needed = (unsigned int)fluid_atomic_int_get(&stream->needed);
+    unsigned int filled = (unsigned int)fluid_atomic_int_get(&stream->filled);
+    unsigned int limit, count, n;
+
+    if(stream->data24 != NULL && stream->ring24 == NULL)
+    {
+        stream->ring24 = FLUID_ARRAY(char, FLUID_SAMPLE_STREAM_FRAMES + FLUID_SAMPLE_STREAM_GUARD);
+
+        if(stream->ring24 == NULL)
+        {
+            /* the voice reads the mapped file instead */
+            return FALSE;
+        }
+    }
+
+    /* the voice got ahead of the streamer, skip the frames it has played */
+    if(filled < needed)
+    {
+        filled = needed;
+    }
+
+    limit = (stream->end - needed >= FLUID_SAMPLE_STREAM_FRAMES) ? needed + FLUID_SAMPLE_STREAM_FRAMES : stream->end + 1;
+
+    if(filled >= limit)
+    {
+        return FALSE;
+    }
+
+    count = (limit - filled > FLUID_SAMPLE_STREAM_CHUNK) ? FLUID_SAMPLE_STREAM_CHUNK : limit - filled;
+
+    /* have the operating system read the next chunk while this one is copied */
+    if(filled + count <= stream->end)
+    {
+        n = (stream->end + 1 - filled - count > FLUID_SAMPLE_STREAM_CHUNK) ? FLUID_SAMPLE_STREAM_CHUNK
+            : stream->end + 1 - filled - count;
+        fluid_file_mapping_prefetch(stream->data + filled + count, n * sizeof(short));
+    }
+
+    n = FLUID_SAMPLE_STREAM_FRAMES - filled % FLUID_SAMPLE_STREAM_FRAMES;
+
+    if(n > count)
+    {
+        n = count;
+    }
+
+    fluid_sample_stream_copy(stream, filled, n);
+
+    if(n < count)
+    {
+        fluid_sample_stream_copy(stream, filled + n, count - n);
+    }
+
+    /* the frames are in the ring before the voice learns about them */
+    fluid_atomic_int_set(&stream->filled, (int)(filled + count));
+
+    return TRUE;
+}
+
+static fluid_thread_return_t fluid_sample_streamer_run(void *data)
+{
+    fluid_sample_streamer_t *streamer = data;
+    fluid_sample_stream_t **request;
+    int i, busy;
+
+    while(!fluid_atomic_int_get(&streamer->quit))
+    {
+        /* the streams handed out since the last pass */
+        while((request = fluid_ringbuffer_get_outptr(streamer->queue)) != NULL)
+        {
+            streamer->active[streamer->active_count++] = *request;
+            fluid_ringbuffer_next_outptr(streamer->queue);
+        }
+
+        busy = FALSE;
+
+        for(i = 0; i < streamer->active_count;)
+        {
+            fluid_sample_stream_t *stream = streamer->active[i];
+
+            if(fluid_atomic_int_get(&stream->state) == FLUID_SAMPLE_STREAM_RELEASED)
+            {
+                /* the synth may let go of the sample from now on */
+                streamer->active[i] = streamer->active[--streamer->active_count];
+                fluid_atomic_int_set(&stream->state, FLUID_SAMPLE_STREAM_DONE);
+                fluid_atomic_int_inc(&streamer->done_count);
+                continue;
+            }
+
+            busy |= fluid_sample_stream_fill(stream);
+            i++;
+        }
+
+        /* all ring buffers are as full as they get, or there is none */
+        if(!busy)
+        {
+            fluid_msleep(FLUID_SAMPLE_STREAMER_PERIOD);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
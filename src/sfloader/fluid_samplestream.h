@@ -0,0 +1,65 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+
+#ifndef _FLUID_SAMPLESTREAM_H
+#define _FLUID_SAMPLESTREAM_H
+
+#include "fluid_sfont.h"
+
+/*
+ * Background reader of streamed samples.
+ *
+ * Only the first frames and the loop of a streamed sample are kept in memory, copied
+ * from the mapped SoundFont file by fluid_sample_copy_stream_data(). When a voice starts
+ * playing such a sample, it gets a ring buffer of its own from the bounded pool of
+ * the streamer, and the streamer thread copies the rest of the sample from the
+ * mapped file into it while the voice plays the head. The voices thereby read from
+ * memory, and the memory of the streamed samples doesn't grow with their size: the
+ * heads and loops of the samples, and the ring buffers of the pool. Voices only read
+ * the mapped file if the streamer thread falls behind, or all ring buffers are in use.
+ *
+ * A ring buffer is handed over to the streamer thread through a lock-free queue,
+ * and the frames are handed over to the voice by the atomic count of frames
+ * streamed, so that neither the synth nor the rendering wait for the disk.
+ */
+typedef struct _fluid_sample_streamer_t fluid_sample_streamer_t;
+typedef struct _fluid_sample_stream_t fluid_sample_stream_t;
+
+/* The frames of a ring buffer, as many as it streams ahead of the voice at most */
+#define FLUID_SAMPLE_STREAM_FRAMES 16384
+
+/* The frames at the start of a ring buffer repeated at its end, so that up to this
+ * many frames can be read in one piece from anywhere in the ring */
+#define FLUID_SAMPLE_STREAM_GUARD 2048
+
+fluid_sample_streamer_t *new_fluid_sample_streamer(int stream_count);
+void delete_fluid_sample_streamer(fluid_sample_streamer_t *streamer);
+size_t fluid_sample_streamer_get_memory(const fluid_sample_streamer_t *streamer);
+
+fluid_sample_stream_t *fluid_sample_streamer_start(fluid_sample_streamer_t *streamer, fluid_sample_t *sample);
+void fluid_sample_stream_release(fluid_sample_stream_t *stream);
+void fluid_sample_streamer_collect(fluid_sample_streamer_t *streamer);
+
+int fluid_sample_stream_get_window(fluid_sample_stream_t *stream, unsigned int first, unsigned int last,
+                                   unsigned int *base, unsigned int *count,
+                                   short **data, char **data24);
+
+#endif /* _FLUID_SAMPLESTREAM_H */
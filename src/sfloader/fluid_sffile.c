@@ -25,8 +25,11 @@
 #include "fluid_sffile.h"
 #include "fluid_sfont.h"
 #include "fluid_sys.h"
+#include "fluid_hash.h"
 
-#if LIBSNDFILE_SUPPORT
+#if LIBVORBIS_SUPPORT
+#include <vorbis/vorbisfile.h>
+#elif LIBSNDFILE_SUPPORT
 #include <sndfile.h>
 #endif
 
@@ -295,6 +298,156 @@ static const unsigned short invalid_preset_gen[] =
     } while (0)
 
 
+/* Identifies the index files of the parsed HYDRA chunk of SoundFonts in the cache directory */
+#define SFINDEX_MAGIC "FLUIDSFI"
+#define SFINDEX_BYTE_ORDER 0x01020304
+
+/* The header of an index file, followed by the file name of the SoundFont and, at header_size,
+ * the arrays of presets, instruments, samples, zones, generators and modulators in the byte
+ * order of the machine. Records refer to each other by their index in these arrays. */
+typedef struct
+{
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint64_t modification_time;
+    uint32_t filesize;
+    uint32_t hydrapos;
+    uint32_t hydrasize;
+    uint32_t preset_count;
+    uint32_t inst_count;
+    uint32_t sample_count;
+    uint32_t zone_count;
+    uint32_t gen_count;
+    uint32_t mod_count;
+    uint32_t filename_length;
+} SFIndexHeader;
+
+typedef struct
+{
+    char name[24];
+    uint16_t prenum;
+    uint16_t bank;
+    uint32_t libr;
+    uint32_t genre;
+    uint32_t morph;
+    uint32_t zone_start; /* the zones of all presets, then of all instruments, follow each other */
+    uint32_t zone_count;
+} SFIndexPreset;
+
+typedef struct
+{
+    char name[24];
+    uint32_t zone_start;
+    uint32_t zone_count;
+} SFIndexInst;
+
+typedef struct
+{
+    char name[24];
+    uint32_t start;
+    uint32_t end;
+    uint32_t loopstart;
+    uint32_t loopend;
+    uint32_t samplerate;
+    uint8_t origpitch;
+    int8_t pitchadj;
+    uint16_t sampletype;
+} SFIndexSample;
+
+typedef struct
+{
+    uint32_t instsamp; /* index + 1 of the instrument or sample of the zone, 0 if none */
+    uint32_t gen_start;
+    uint32_t gen_count;
+    uint32_t mod_start;
+    uint32_t mod_count;
+} SFIndexZone;
+
+/* A chunk read into memory, parsed through buffer_fcbs */
+typedef struct
+{
+    unsigned char *data;
+    long size;
+    long pos;
+} SFBuffer;
+
+/* A read of sample data in the background, see fluid_sffile_read_ahead() */
+typedef struct
+{
+    void *buf;
+    unsigned int length; /* 0 if not read, or the read failed */
+    int pending;         /* TRUE until the read has completed */
+} SFRead;
+
+typedef struct
+{
+    unsigned int start;
+    unsigned int end;
+    SFRead data;
+    SFRead data24;
+} SFReadAhead;
+
+static int buffer_fread(void *buf, int count, void *handle)
+{
+    SFBuffer *buffer = handle;
+
+    if(count < 0 || count > buffer->size - buffer->pos)
+    {
+        FLUID_LOG(FLUID_ERR, "EOF while attempting to read %d bytes", count);
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(buf, buffer->data + buffer->pos, count);
+    buffer->pos += count;
+
+    return FLUID_OK;
+}
+
+static int buffer_fseek(void *handle, long offset, int origin)
+{
+    SFBuffer *buffer = handle;
+    long pos;
+
+    switch(origin)
+    {
+    case SEEK_SET:
+        pos = offset;
+        break;
+
+    case SEEK_CUR:
+        pos = buffer->pos + offset;
+        break;
+
+    case SEEK_END:
+        pos = buffer->size + offset;
+        break;
+
+    default:
+        return FLUID_FAILED;
+    }
+
+    if(pos < 0 || pos > buffer->size)
+    {
+        FLUID_LOG(FLUID_ERR, "Seeking beyond the end of the chunk");
+        return FLUID_FAILED;
+    }
+
+    buffer->pos = pos;
+
+    return FLUID_OK;
+}
+
+static long buffer_ftell(void *handle)
+{
+    return ((SFBuffer *)handle)->pos;
+}
+
+static const fluid_file_callbacks_t buffer_fcbs =
+{
+    NULL, buffer_fread, buffer_fseek, NULL, buffer_ftell
+};
+
 static int load_header(SFData *sf);
 static int load_body(SFData *sf);
 static int process_info(SFData *sf, int size);
@@ -311,6 +464,19 @@ static int load_igen(SFData *sf, int size);
 static int load_shdr(SFData *sf, unsigned int size);
 static int fixup_pgen(SFData *sf);
 static int fixup_igen(SFData *sf);
+static void get_index_file_path(const SFData *sf, const char *index_dir, char *path, int size);
+static void init_index_header(const SFData *sf, time_t modification_time, SFIndexHeader *header);
+static int load_index(SFData *sf, const char *index_dir, time_t modification_time);
+static void store_index(const SFData *sf, const char *index_dir, time_t modification_time);
+static uint64_t get_index_file_size(const SFIndexHeader *header);
+static int check_index_zones(const SFIndexHeader *header, const SFIndexZone *izones, uint32_t start,
+                             uint32_t count, uint32_t instsamp_count, uint32_t *next_zone);
+static void load_index_zones(fluid_list_t **zone_list, const SFIndexZone *izones, uint32_t start, uint32_t count,
+                             SFZone *zones, SFGen *gens, SFMod *mods, fluid_list_t **instsamp_nodes);
+static void count_index_zones(fluid_list_t *zone_list, SFIndexHeader *header);
+static uint32_t store_index_zones(fluid_list_t *zone_list, fluid_hashtable_t *sample_indices,
+                                  SFIndexZone *izones, SFGen *gens, SFMod *mods,
+                                  uint32_t *nzones, uint32_t *ngens, uint32_t *nmods);
 
 static int chunkid(uint32_t id);
 static int read_listchunk(SFData *sf, SFChunk *chunk);
@@ -324,9 +490,12 @@ static int valid_preset_genid(unsigned short genid);
 static void delete_preset(SFPreset *preset);
 static void delete_inst(SFInst *inst);
 static void delete_zone(SFZone *zone);
+static void *new_records(SFData *sf, int count, size_t size);
 
 static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigned int end_byte, short **data);
 static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int end, short **data, char **data24);
+static int fluid_sffile_take_read_ahead(SFData *sf, unsigned int start, unsigned int end, short **data, char **data24);
+static void delete_read_ahead(SFReadAhead *read_ahead);
 
 /**
  * Check if a file is a SoundFont file.
@@ -415,6 +584,7 @@ SFData *fluid_sffile_open(const char *fname, const fluid_file_callbacks_t *fcbs)
 
     FLUID_MEMSET(sf, 0, sizeof(SFData));
 
+    fluid_mutex_init(sf->io_mutex);
     sf->fcbs = fcbs;
 
     if((sf->sffd = fcbs->fopen(fname)) == NULL)
@@ -467,15 +637,44 @@ error_exit:
 /*
  * Parse all preset information from the soundfont
  *
+ * If index_dir is an existing directory and the soundfont is a file opened with the default
+ * callbacks, the parsed information is taken from the index file of the soundfont in there
+ * if it is up to date, or stored into it once parsed.
+ *
  * @return FLUID_OK on success, otherwise FLUID_FAILED
  */
-int fluid_sffile_parse_presets(SFData *sf)
+int fluid_sffile_parse_presets(SFData *sf, const char *index_dir)
 {
+    fluid_stat_buf_t buf;
+    int use_index = (index_dir != NULL && index_dir[0] != '\0' && sf->fcbs->fopen == default_fopen
+                     && fluid_stat(sf->fname, &buf) == 0);
+    int ret;
+
+    if(use_index)
+    {
+        ret = load_index(sf, index_dir, buf.st_mtime);
+
+        if(ret < 0)
+        {
+            return FLUID_FAILED;
+        }
+
+        if(ret)
+        {
+            return FLUID_OK;
+        }
+    }
+
     if(!load_body(sf))
     {
         return FLUID_FAILED;
     }
 
+    if(use_index)
+    {
+        store_index(sf, index_dir, buf.st_mtime);
+    }
+
     return FLUID_OK;
 }
 
@@ -497,20 +696,340 @@ int fluid_sffile_parse_presets(SFData *sf)
 int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
                                   int sample_type, short **data, char **data24)
 {
+    double start;
     int num_samples;
 
     if(sample_type & FLUID_SAMPLETYPE_OGG_VORBIS)
     {
+        /* times reading and decoding on its own */
         num_samples = fluid_sffile_read_vorbis(sf, sample_start, sample_end, data);
     }
     else
     {
+        start = fluid_sfont_load_stats_start(sf->load_stats);
         num_samples = fluid_sffile_read_wav(sf, sample_start, sample_end, data, data24);
+
+        if(num_samples > 0)
+        {
+            fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_IO, start,
+                                       num_samples * (sizeof(short) + ((*data24 != NULL) ? 1 : 0)));
+        }
+    }
+
+    return num_samples;
+}
+
+/*
+ * Map the sample data directly from the SoundFont file into memory instead of reading it.
+ *
+ * This is only possible for uncompressed samples of a SoundFont that has been opened with the
+ * default file callbacks, on a little endian machine (the samples are stored little endian).
+ * The mapped data must not be modified and has to be released with delete_fluid_file_mapping().
+ *
+ * @param sf SoundFont file
+ * @param sample_start index of first sample point in Soundfont sample chunk
+ * @param sample_end index of last sample point in Soundfont sample chunk
+ * @param sample_type type of the sample in Soundfont
+ * @param data pointer to the mapped 16-bit sample data
+ * @param data24 pointer to the mapped 24-bit LSB sample data, NULL if there are none
+ * @param mapping mapping of the 16-bit sample data
+ * @param mapping24 mapping of the 24-bit LSB sample data, NULL if there are none
+ * @return number of samples mapped, -1 if the samples couldn't be mapped and have to be read instead
+ */
+int fluid_sffile_map_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                 int sample_type, short **data, char **data24,
+                                 fluid_file_mapping_t **mapping, fluid_file_mapping_t **mapping24)
+{
+    int num_samples = (sample_end + 1) - sample_start;
+    double start = fluid_sfont_load_stats_start(sf->load_stats);
+
+    *mapping = NULL;
+    *mapping24 = NULL;
+
+    if((sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) || FLUID_IS_BIG_ENDIAN
+            || sf->fcbs->fopen != default_fopen || num_samples <= 0)
+    {
+        return -1;
+    }
+
+    /* the 16-bit samples must be properly aligned in memory, which they are only if they are in the file */
+    if((sf->samplepos % sizeof(short)) != 0)
+    {
+        return -1;
     }
 
+    /* leave the error reporting for invalid offsets to fluid_sffile_read_wav() */
+    if((sample_start * sizeof(short) > sf->samplesize) || (sample_end * sizeof(short) > sf->samplesize))
+    {
+        return -1;
+    }
+
+    if(sf->sample24pos && ((sample_start > sf->sample24size) || (sample_end > sf->sample24size)))
+    {
+        return -1;
+    }
+
+    /* accessing a mapping beyond the end of the file crashes, so be paranoid about truncated files */
+    if(((unsigned long)sf->samplepos + (sample_end + 1) * sizeof(short) > (unsigned long)sf->filesize)
+            || (sf->sample24pos && ((unsigned long)sf->sample24pos + sample_end + 1 > (unsigned long)sf->filesize)))
+    {
+        return -1;
+    }
+
+    *mapping = new_fluid_file_mapping(sf->fname, sf->samplepos + sample_start * sizeof(short),
+                                      num_samples * sizeof(short));
+
+    if(*mapping == NULL)
+    {
+        return -1;
+    }
+
+    if(sf->sample24pos)
+    {
+        *mapping24 = new_fluid_file_mapping(sf->fname, sf->sample24pos + sample_start, num_samples);
+
+        if(*mapping24 == NULL)
+        {
+            delete_fluid_file_mapping(*mapping);
+            *mapping = NULL;
+            return -1;
+        }
+    }
+
+    *data = (short *)fluid_file_mapping_get_data(*mapping);
+    *data24 = (*mapping24 != NULL) ? (char *)fluid_file_mapping_get_data(*mapping24) : NULL;
+
+    fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_IO, start,
+                               num_samples * (sizeof(short) + ((*data24 != NULL) ? 1 : 0)));
+
     return num_samples;
 }
 
+/*
+ * Start reading the sample data of a sample in the background, to be taken by
+ * fluid_sffile_read_sample_data() later on, so that the sample data of several
+ * samples are read at once.
+ *
+ * This is only possible for uncompressed samples of a SoundFont that has been opened with the
+ * default file callbacks, on a system supporting batched reads (see new_fluid_file_reader()).
+ * The reads are only passed to the operating system by fluid_sffile_flush_read_ahead(), or
+ * when the sample data of any of them are taken.
+ *
+ * @param sf SoundFont file
+ * @param sample_start index of first sample point in Soundfont sample chunk
+ * @param sample_end index of last sample point in Soundfont sample chunk
+ * @param sample_type type of the sample in Soundfont
+ * @param depth the most reads in flight at once
+ * @return FLUID_OK if the sample data is being read, otherwise FLUID_FAILED
+ */
+int fluid_sffile_read_ahead(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                           int sample_type, int depth)
+{
+    SFReadAhead *read_ahead;
+    fluid_list_t *p;
+    int num_samples = (sample_end + 1) - sample_start;
+    int ret = FLUID_FAILED;
+
+    if((sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) || sf->fcbs->fopen != default_fopen || num_samples <= 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* leave the error reporting for invalid offsets to fluid_sffile_read_wav() */
+    if((sample_start * sizeof(short) > sf->samplesize) || (sample_end * sizeof(short) > sf->samplesize))
+    {
+        return FLUID_FAILED;
+    }
+
+    fluid_mutex_lock(sf->io_mutex);
+
+    if(sf->reader == NULL && !sf->reader_failed)
+    {
+        sf->reader = new_fluid_file_reader(sf->fname, depth);
+        sf->reader_failed = (sf->reader == NULL);
+    }
+
+    if(sf->reader == NULL)
+    {
+        goto unlock_exit;
+    }
+
+    for(p = sf->read_ahead; p != NULL; p = fluid_list_next(p))
+    {
+        read_ahead = fluid_list_get(p);
+
+        if(read_ahead->start == sample_start && read_ahead->end == sample_end)
+        {
+            ret = (read_ahead->data.length > 0) ? FLUID_OK : FLUID_FAILED;
+            goto unlock_exit;
+        }
+    }
+
+    read_ahead = FLUID_NEW(SFReadAhead);
+
+    if(read_ahead == NULL)
+    {
+        goto unlock_exit;
+    }
+
+    FLUID_MEMSET(read_ahead, 0, sizeof(*read_ahead));
+    read_ahead->start = sample_start;
+    read_ahead->end = sample_end;
+    read_ahead->data.length = num_samples * sizeof(short);
+    read_ahead->data.buf = FLUID_MALLOC(read_ahead->data.length);
+
+    /* the 24-bit sample data aren't read if they are invalid, fluid_sffile_read_wav() complains about them */
+    if(sf->sample24pos && sample_start <= sf->sample24size && sample_end <= sf->sample24size)
+    {
+        read_ahead->data24.length = num_samples;
+        read_ahead->data24.buf = FLUID_MALLOC(read_ahead->data24.length);
+    }
+
+    if(read_ahead->data.buf == NULL || (read_ahead->data24.length > 0 && read_ahead->data24.buf == NULL))
+    {
+        delete_read_ahead(read_ahead);
+        goto unlock_exit;
+    }
+
+    /* both reads or none, there is no way to take one of them back */
+    if(read_ahead->data24.length > 0 && fluid_file_reader_submit(sf->reader, read_ahead->data24.buf,
+            sf->sample24pos + sample_start, read_ahead->data24.length, &read_ahead->data24) != FLUID_OK)
+    {
+        delete_read_ahead(read_ahead);
+        goto unlock_exit;
+    }
+
+    if(fluid_file_reader_submit(sf->reader, read_ahead->data.buf, sf->samplepos + sample_start * sizeof(short),
+                                read_ahead->data.length, &read_ahead->data) != FLUID_OK)
+    {
+        if(read_ahead->data24.length == 0)
+        {
+            delete_read_ahead(read_ahead);
+            goto unlock_exit;
+        }
+
+        /* kept until the 24-bit data are read, then dropped */
+        read_ahead->data.length = 0;
+    }
+
+    read_ahead->data.pending = (read_ahead->data.length > 0);
+    read_ahead->data24.pending = (read_ahead->data24.length > 0);
+    sf->read_ahead = fluid_list_prepend(sf->read_ahead, read_ahead);
+    ret = (read_ahead->data.length > 0) ? FLUID_OK : FLUID_FAILED;
+
+unlock_exit:
+    fluid_mutex_unlock(sf->io_mutex);
+    return ret;
+}
+
+/*
+ * Pass the reads started by fluid_sffile_read_ahead() to the operating system.
+ *
+ * @param sf SoundFont file
+ */
+void fluid_sffile_flush_read_ahead(SFData *sf)
+{
+    fluid_mutex_lock(sf->io_mutex);
+
+    if(sf->reader != NULL)
+    {
+        fluid_file_reader_flush(sf->reader);
+    }
+
+    fluid_mutex_unlock(sf->io_mutex);
+}
+
+static void delete_read_ahead(SFReadAhead *read_ahead)
+{
+    FLUID_FREE(read_ahead->data.buf);
+    FLUID_FREE(read_ahead->data24.buf);
+    FLUID_FREE(read_ahead);
+}
+
+/* Takes the sample data read ahead of a sample, if any. Returns TRUE if the 16-bit sample data have
+ * been read, the 24-bit sample data are NULL if there are none or they couldn't be read. */
+static int fluid_sffile_take_read_ahead(SFData *sf, unsigned int start, unsigned int end, short **data, char **data24)
+{
+    SFReadAhead *read_ahead = NULL;
+    SFRead *read;
+    fluid_list_t *p;
+    void *completed;
+    int n, ret = FALSE;
+
+    fluid_mutex_lock(sf->io_mutex);
+
+    for(p = sf->read_ahead; p != NULL; p = fluid_list_next(p))
+    {
+        read_ahead = fluid_list_get(p);
+
+        if(read_ahead->start == start && read_ahead->end == end)
+        {
+            break;
+        }
+    }
+
+    if(p == NULL)
+    {
+        fluid_mutex_unlock(sf->io_mutex);
+        return FALSE;
+    }
+
+    sf->read_ahead = fluid_list_remove_link(sf->read_ahead, p);
+    delete1_fluid_list(p);
+
+    /* the reads of other samples may complete first */
+    while(read_ahead->data.pending || read_ahead->data24.pending)
+    {
+        n = fluid_file_reader_complete(sf->reader, &completed);
+
+        if(completed == NULL)
+        {
+            /* taken back by the reader */
+            read_ahead->data.length = read_ahead->data24.length = 0;
+            break;
+        }
+
+        read = completed;
+        read->pending = FALSE;
+
+        if(n != (int)read->length)
+        {
+            read->length = 0;
+        }
+    }
+
+    fluid_mutex_unlock(sf->io_mutex);
+
+    if(read_ahead->data.length > 0)
+    {
+        *data = read_ahead->data.buf;
+        read_ahead->data.buf = NULL;
+        ret = TRUE;
+
+        if(read_ahead->data24.length > 0)
+        {
+            *data24 = read_ahead->data24.buf;
+            read_ahead->data24.buf = NULL;
+        }
+        else if(sf->sample24pos)
+        {
+            if((start > sf->sample24size) || (end > sf->sample24size))
+            {
+                FLUID_LOG(FLUID_ERR, "Sample offsets exceed 24-bit sample data chunk");
+            }
+            else
+            {
+                FLUID_LOG(FLUID_ERR, "Failed to read 24-bit sample data");
+            }
+
+            FLUID_LOG(FLUID_WARN, "Ignoring 24-bit sample data, sound quality might suffer");
+        }
+    }
+
+    delete_read_ahead(read_ahead);
+    return ret;
+}
+
 /*
  * Close a SoundFont file and free the SFData structure.
  *
@@ -528,6 +1047,16 @@ void fluid_sffile_close(SFData *sf)
         sf->fcbs->fclose(sf->sffd);
     }
 
+    /* waits for the samples read ahead, which are never taken now */
+    delete_fluid_file_reader(sf->reader);
+
+    for(entry = sf->read_ahead; entry; entry = fluid_list_next(entry))
+    {
+        delete_read_ahead(fluid_list_get(entry));
+    }
+
+    delete_fluid_list(sf->read_ahead);
+
     FLUID_FREE(sf->fname);
 
     entry = sf->info;
@@ -572,9 +1101,189 @@ void fluid_sffile_close(SFData *sf)
 
     delete_fluid_list(sf->sample);
 
+    for(entry = sf->records; entry; entry = fluid_list_next(entry))
+    {
+        FLUID_FREE(fluid_list_get(entry));
+    }
+
+    delete_fluid_list(sf->records);
+
+    fluid_mutex_destroy(sf->io_mutex);
     FLUID_FREE(sf);
 }
 
+/* Count the bytes of the list nodes of the zones of a preset or an instrument */
+static size_t get_zones_size(fluid_list_t *zones)
+{
+    size_t size = 0;
+
+    for(; zones; zones = fluid_list_next(zones))
+    {
+        SFZone *zone = fluid_list_get(zones);
+
+        size += sizeof(fluid_list_t) * (1 + fluid_list_size(zone->gen) + fluid_list_size(zone->mod));
+    }
+
+    return size;
+}
+
+/*
+ * Get the memory taken by the parsed SoundFont file, not counting its sample data.
+ *
+ * @param sf pointer to SFData structure
+ * @return bytes of the SFData structure, its lists and records
+ */
+size_t fluid_sffile_get_size(const SFData *sf)
+{
+    fluid_list_t *entry;
+    size_t size = sizeof(*sf) + sf->heap_size;
+
+    if(sf->fname != NULL)
+    {
+        size += FLUID_STRLEN(sf->fname) + 1;
+    }
+
+    size += sizeof(fluid_list_t) * (fluid_list_size(sf->info) + fluid_list_size(sf->records));
+
+    for(entry = sf->preset; entry; entry = fluid_list_next(entry))
+    {
+        size += sizeof(fluid_list_t) + sizeof(SFPreset) + get_zones_size(((SFPreset *)fluid_list_get(entry))->zone);
+    }
+
+    for(entry = sf->inst; entry; entry = fluid_list_next(entry))
+    {
+        size += sizeof(fluid_list_t) + sizeof(SFInst) + get_zones_size(((SFInst *)fluid_list_get(entry))->zone);
+    }
+
+    size += (sizeof(fluid_list_t) + sizeof(SFSample)) * fluid_list_size(sf->sample);
+
+    return size;
+}
+
+
+/*
+ * Create the statistics the stages of loading a SoundFont are timed into.
+ *
+ * @return the statistics, all zero, NULL on error
+ */
+fluid_sfont_load_stats_t *new_fluid_sfont_load_stats(void)
+{
+    fluid_sfont_load_stats_t *stats = FLUID_NEW(fluid_sfont_load_stats_t);
+
+    if(stats == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(stats, 0, sizeof(*stats));
+    fluid_mutex_init(stats->mutex);
+
+    return stats;
+}
+
+void delete_fluid_sfont_load_stats(fluid_sfont_load_stats_t *stats)
+{
+    fluid_return_if_fail(stats != NULL);
+
+    fluid_mutex_destroy(stats->mutex);
+    FLUID_FREE(stats);
+}
+
+/*
+ * Start timing a stage of loading a SoundFont.
+ *
+ * @param stats the statistics, NULL if the loading isn't timed
+ * @return the time reference to be passed to fluid_sfont_load_stats_add(), 0 if not timed
+ */
+double fluid_sfont_load_stats_start(const fluid_sfont_load_stats_t *stats)
+{
+    return (stats != NULL) ? fluid_utime() : 0.0;
+}
+
+/*
+ * Add the time spent since a time reference, and the bytes processed, to a stage of loading a SoundFont.
+ *
+ * @param stats the statistics, NULL if the loading isn't timed
+ * @param stage the stage (#fluid_sfont_load_stage)
+ * @param start time reference returned by fluid_sfont_load_stats_start()
+ * @param bytes the bytes processed
+ */
+void fluid_sfont_load_stats_add(fluid_sfont_load_stats_t *stats, int stage, double start, size_t bytes)
+{
+    double msec;
+
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    msec = (fluid_utime() - start) / 1000.0;
+
+    fluid_mutex_lock(stats->mutex);
+    stats->msec[stage] += msec;
+    stats->bytes[stage] += bytes;
+    fluid_mutex_unlock(stats->mutex);
+}
+
+/*
+ * Get the time in milliseconds and the bytes of each stage of loading a SoundFont.
+ *
+ * @param stats the statistics
+ * @param msec FLUID_SFONT_LOAD_LAST times
+ * @param bytes FLUID_SFONT_LOAD_LAST byte counts
+ */
+void fluid_sfont_load_stats_get(fluid_sfont_load_stats_t *stats, double *msec, size_t *bytes)
+{
+    fluid_mutex_lock(stats->mutex);
+    FLUID_MEMCPY(msec, stats->msec, sizeof(stats->msec));
+    FLUID_MEMCPY(bytes, stats->bytes, sizeof(stats->bytes));
+    fluid_mutex_unlock(stats->mutex);
+}
+
+/*
+ * Log the breakdown of the time taken by loading (a part of) a SoundFont at FLUID_INFO.
+ *
+ * @param stats the statistics, nothing is logged if NULL
+ * @param what what has been loaded, followed by name in the message
+ * @param name the name of what has been loaded
+ * @param start time reference returned by fluid_sfont_load_stats_start() before loading it
+ * @param msec_before the times got by fluid_sfont_load_stats_get() before loading it, NULL for none
+ * @param bytes_before the bytes got by fluid_sfont_load_stats_get() before loading it, NULL for none
+ */
+void fluid_sfont_load_stats_report(fluid_sfont_load_stats_t *stats, const char *what, const char *name,
+                                   double start, const double *msec_before, const size_t *bytes_before)
+{
+    static const char *const stage_names[FLUID_SFONT_LOAD_LAST] =
+    {
+        "parsing", "presets", "sample I/O", "SF3 decoding", "sample optimizing", "sample cache"
+    };
+    double msec[FLUID_SFONT_LOAD_LAST];
+    size_t bytes[FLUID_SFONT_LOAD_LAST];
+    char buf[512];
+    int i, len = 0;
+
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    fluid_sfont_load_stats_get(stats, msec, bytes);
+
+    for(i = 0; i < FLUID_SFONT_LOAD_LAST && len < (int)sizeof(buf); i++)
+    {
+        if(msec_before != NULL)
+        {
+            msec[i] -= msec_before[i];
+            bytes[i] -= bytes_before[i];
+        }
+
+        len += FLUID_SNPRINTF(buf + len, sizeof(buf) - len, "%s%s %.1f ms (%lu kB)", (i > 0) ? ", " : "",
+                              stage_names[i], msec[i], (unsigned long)(bytes[i] / 1024));
+    }
+
+    FLUID_LOG(FLUID_INFO, "%s '%s' in %.1f ms: %s", what, name, (fluid_utime() - start) / 1000.0, buf);
+}
 
 /*
  * Private functions
@@ -679,13 +1388,52 @@ static int load_header(SFData *sf)
 
 static int load_body(SFData *sf)
 {
+    SFBuffer hydra;
+    const fluid_file_callbacks_t *fcbs = sf->fcbs;
+    FILE *sffd = sf->sffd;
+    int ret;
+
+    if(sf->hydrasize > sf->filesize)
+    {
+        FLUID_LOG(FLUID_ERR, "HYDRA chunk size exceeds file size");
+        return FALSE;
+    }
+
     if(sf->fcbs->fseek(sf->sffd, sf->hydrapos, SEEK_SET) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Failed to seek to HYDRA position");
         return FALSE;
     }
 
-    if(!process_pdta(sf, sf->hydrasize))
+    /* Read the whole chunk at once, and parse it from memory rather than
+     * reading each field of each record from the file */
+    hydra.size = sf->hydrasize;
+    hydra.pos = 0;
+    hydra.data = FLUID_MALLOC(hydra.size + 1);
+
+    if(hydra.data == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FALSE;
+    }
+
+    if(hydra.size > 0 && sf->fcbs->fread(hydra.data, hydra.size, sf->sffd) == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to read HYDRA chunk");
+        FLUID_FREE(hydra.data);
+        return FALSE;
+    }
+
+    sf->fcbs = &buffer_fcbs;
+    sf->sffd = (FILE *)&hydra;
+
+    ret = process_pdta(sf, sf->hydrasize);
+
+    sf->fcbs = fcbs;
+    sf->sffd = sffd;
+    FLUID_FREE(hydra.data);
+
+    if(!ret)
     {
         return FALSE;
     }
@@ -760,7 +1508,7 @@ static int process_info(SFData *sf, int size)
 
             if(sf->version.major == 3)
             {
-#if !LIBSNDFILE_SUPPORT
+#if !LIBSNDFILE_SUPPORT && !LIBVORBIS_SUPPORT
                 FLUID_LOG(FLUID_WARN,
                           "Sound font version is %d.%d but fluidsynth was compiled without"
                           " support for (v3.x)",
@@ -809,6 +1557,7 @@ static int process_info(SFData *sf, int size)
 
             /* attach to INFO list, fluid_sffile_close will cleanup if FAIL occurs */
             sf->info = fluid_list_append(sf->info, item.fcc);
+            sf->heap_size += chunk.size + sizeof(uint32_t) + 1;
 
             /* save chunk fcc and update pointer to data value */
             *item.fcc++ = chunk.id;
@@ -1137,10 +1886,11 @@ static int load_phdr(SFData *sf, int size)
 static int load_pbag(SFData *sf, int size)
 {
     fluid_list_t *p, *p2;
-    SFZone *z, *pz = NULL;
+    SFZone *z, *pz = NULL, *zones;
     unsigned short genndx, modndx;
     unsigned short pgenndx = 0, pmodndx = 0;
     unsigned short i;
+    int nzones = 0;
 
     if(size % SF_BAG_SIZE || size == 0)  /* size is multiple of SF_BAG_SIZE? */
     {
@@ -1148,6 +1898,11 @@ static int load_pbag(SFData *sf, int size)
         return FALSE;
     }
 
+    if((zones = new_records(sf, size / SF_BAG_SIZE, sizeof(SFZone))) == NULL)
+    {
+        return FALSE;
+    }
+
     p = sf->preset;
 
     while(p)
@@ -1164,11 +1919,7 @@ static int load_pbag(SFData *sf, int size)
                 return FALSE;
             }
 
-            if((z = FLUID_NEW(SFZone)) == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                return FALSE;
-            }
+            z = &zones[nzones++];
 
             p2->data = z;
             z->gen = NULL; /* Init gen and mod before possible failure, */
@@ -1275,7 +2026,13 @@ static int load_pbag(SFData *sf, int size)
 static int load_pmod(SFData *sf, int size)
 {
     fluid_list_t *p, *p2, *p3;
-    SFMod *m;
+    SFMod *m, *mods;
+    int nmods = 0;
+
+    if((mods = new_records(sf, size / SF_MOD_SIZE, sizeof(SFMod))) == NULL)
+    {
+        return FALSE;
+    }
 
     p = sf->preset;
 
@@ -1298,11 +2055,7 @@ static int load_pmod(SFData *sf, int size)
                     return FALSE;
                 }
 
-                if((m = FLUID_NEW(SFMod)) == NULL)
-                {
-                    FLUID_LOG(FLUID_ERR, "Out of memory");
-                    return FALSE;
-                }
+                m = &mods[nmods++];
 
                 p3->data = m;
                 READW(sf, m->src);
@@ -1357,10 +2110,15 @@ static int load_pgen(SFData *sf, int size)
 {
     fluid_list_t *p, *p2, *p3, *dup, **hz = NULL;
     SFZone *z;
-    SFGen *g;
+    SFGen *g, *gens;
     SFGenAmount genval;
     unsigned short genid;
-    int level, skip, drop, gzone, discarded;
+    int level, skip, drop, gzone, discarded, ngens = 0;
+
+    if((gens = new_records(sf, size / SF_GEN_SIZE, sizeof(SFGen))) == NULL)
+    {
+        return FALSE;
+    }
 
     p = sf->preset;
 
@@ -1455,11 +2213,7 @@ static int load_pgen(SFData *sf, int size)
                     if(!dup)
                     {
                         /* if gen ! dup alloc new */
-                        if((g = FLUID_NEW(SFGen)) == NULL)
-                        {
-                            FLUID_LOG(FLUID_ERR, "Out of memory");
-                            return FALSE;
-                        }
+                        g = &gens[ngens++];
 
                         p3->data = g;
                         g->id = genid;
@@ -1657,9 +2411,9 @@ static int load_ihdr(SFData *sf, int size)
 static int load_ibag(SFData *sf, int size)
 {
     fluid_list_t *p, *p2;
-    SFZone *z, *pz = NULL;
+    SFZone *z, *pz = NULL, *zones;
     unsigned short genndx, modndx, pgenndx = 0, pmodndx = 0;
-    int i;
+    int i, nzones = 0;
 
     if(size % SF_BAG_SIZE || size == 0)  /* size is multiple of SF_BAG_SIZE? */
     {
@@ -1667,6 +2421,11 @@ static int load_ibag(SFData *sf, int size)
         return FALSE;
     }
 
+    if((zones = new_records(sf, size / SF_BAG_SIZE, sizeof(SFZone))) == NULL)
+    {
+        return FALSE;
+    }
+
     p = sf->inst;
 
     while(p)
@@ -1683,11 +2442,7 @@ static int load_ibag(SFData *sf, int size)
                 return FALSE;
             }
 
-            if((z = FLUID_NEW(SFZone)) == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                return FALSE;
-            }
+            z = &zones[nzones++];
 
             p2->data = z;
             z->gen = NULL; /* In case of failure, */
@@ -1795,7 +2550,13 @@ static int load_ibag(SFData *sf, int size)
 static int load_imod(SFData *sf, int size)
 {
     fluid_list_t *p, *p2, *p3;
-    SFMod *m;
+    SFMod *m, *mods;
+    int nmods = 0;
+
+    if((mods = new_records(sf, size / SF_MOD_SIZE, sizeof(SFMod))) == NULL)
+    {
+        return FALSE;
+    }
 
     p = sf->inst;
 
@@ -1818,11 +2579,7 @@ static int load_imod(SFData *sf, int size)
                     return FALSE;
                 }
 
-                if((m = FLUID_NEW(SFMod)) == NULL)
-                {
-                    FLUID_LOG(FLUID_ERR, "Out of memory");
-                    return FALSE;
-                }
+                m = &mods[nmods++];
 
                 p3->data = m;
                 READW(sf, m->src);
@@ -1866,10 +2623,15 @@ static int load_igen(SFData *sf, int size)
 {
     fluid_list_t *p, *p2, *p3, *dup, **hz = NULL;
     SFZone *z;
-    SFGen *g;
+    SFGen *g, *gens;
     SFGenAmount genval;
     unsigned short genid;
-    int level, skip, drop, gzone, discarded;
+    int level, skip, drop, gzone, discarded, ngens = 0;
+
+    if((gens = new_records(sf, size / SF_GEN_SIZE, sizeof(SFGen))) == NULL)
+    {
+        return FALSE;
+    }
 
     p = sf->inst;
 
@@ -1964,11 +2726,7 @@ static int load_igen(SFData *sf, int size)
                     if(!dup)
                     {
                         /* if gen ! dup alloc new */
-                        if((g = FLUID_NEW(SFGen)) == NULL)
-                        {
-                            FLUID_LOG(FLUID_ERR, "Out of memory");
-                            return FALSE;
-                        }
+                        g = &gens[ngens++];
 
                         p3->data = g;
                         g->id = genid;
@@ -2174,46 +2932,594 @@ static int fixup_pgen(SFData *sf)
     return TRUE;
 }
 
-/* "fixup" (sample # -> sample ptr) sample references in instrument list */
-static int fixup_igen(SFData *sf)
-{
-    fluid_list_t *p, *p2, *p3;
-    SFZone *z;
-    int i;
+/* "fixup" (sample # -> sample ptr) sample references in instrument list */
+static int fixup_igen(SFData *sf)
+{
+    fluid_list_t *p, *p2, *p3;
+    SFZone *z;
+    int i;
+
+    p = sf->inst;
+
+    while(p)
+    {
+        p2 = ((SFInst *)(p->data))->zone;
+
+        while(p2)
+        {
+            /* traverse instrument's zones */
+            z = (SFZone *)(p2->data);
+
+            if((i = FLUID_POINTER_TO_INT(z->instsamp)))
+            {
+                /* load sample # */
+                p3 = fluid_list_nth(sf->sample, i - 1);
+
+                if(!p3)
+                {
+                    FLUID_LOG(FLUID_ERR, "Instrument '%s': Invalid sample reference",
+                              ((SFInst *)(p->data))->name);
+                    return FALSE;
+                }
+
+                z->instsamp = p3;
+            }
+
+            p2 = fluid_list_next(p2);
+        }
+
+        p = fluid_list_next(p);
+    }
+
+    return TRUE;
+}
+
+/* The index file of the soundfont in the index directory */
+static void get_index_file_path(const SFData *sf, const char *index_dir, char *path, int size)
+{
+    FLUID_SNPRINTF(path, size, "%s/fluidsynth-%08x.sfi", index_dir, fluid_str_hash(sf->fname));
+}
+
+static void init_index_header(const SFData *sf, time_t modification_time, SFIndexHeader *header)
+{
+    unsigned int length = (unsigned int)FLUID_STRLEN(sf->fname);
+
+    FLUID_MEMSET(header, 0, sizeof(*header));
+    FLUID_MEMCPY(header->magic, SFINDEX_MAGIC, sizeof(header->magic));
+    header->byte_order = SFINDEX_BYTE_ORDER;
+    /* keep the records aligned */
+    header->header_size = (uint32_t)((sizeof(*header) + length + 7) & ~(size_t)7);
+    header->modification_time = (uint64_t)modification_time;
+    header->filesize = sf->filesize;
+    header->hydrapos = sf->hydrapos;
+    header->hydrasize = sf->hydrasize;
+    header->filename_length = length;
+}
+
+/* The size of an index file, so that records beyond its end are never accessed */
+static uint64_t get_index_file_size(const SFIndexHeader *header)
+{
+    return header->header_size
+           + (uint64_t)header->preset_count * sizeof(SFIndexPreset)
+           + (uint64_t)header->inst_count * sizeof(SFIndexInst)
+           + (uint64_t)header->sample_count * sizeof(SFIndexSample)
+           + (uint64_t)header->zone_count * sizeof(SFIndexZone)
+           + (uint64_t)header->gen_count * sizeof(SFGen)
+           + (uint64_t)header->mod_count * sizeof(SFMod);
+}
+
+/* Checks the index zones of a preset or instrument, which follow the ones of the previous one */
+static int check_index_zones(const SFIndexHeader *header, const SFIndexZone *izones, uint32_t start,
+                             uint32_t count, uint32_t instsamp_count, uint32_t *next_zone)
+{
+    uint32_t i;
+
+    if(start != *next_zone || count > header->zone_count - start)
+    {
+        return FALSE;
+    }
+
+    for(i = start; i < start + count; i++)
+    {
+        if(izones[i].instsamp > instsamp_count
+                || izones[i].gen_count > header->gen_count
+                || izones[i].gen_start > header->gen_count - izones[i].gen_count
+                || izones[i].mod_count > header->mod_count
+                || izones[i].mod_start > header->mod_count - izones[i].mod_count)
+        {
+            return FALSE;
+        }
+    }
+
+    *next_zone = start + count;
+
+    return TRUE;
+}
+
+/* Rebuilds the zone list of a preset or instrument from its index zones */
+static void load_index_zones(fluid_list_t **zone_list, const SFIndexZone *izones, uint32_t start, uint32_t count,
+                             SFZone *zones, SFGen *gens, SFMod *mods, fluid_list_t **instsamp_nodes)
+{
+    uint32_t i, k;
+
+    /* the lists are built backwards, as prepending is much cheaper than appending */
+    for(i = start + count; i-- > start;)
+    {
+        SFZone *z = &zones[i];
+
+        z->instsamp = izones[i].instsamp ? instsamp_nodes[izones[i].instsamp - 1] : NULL;
+        z->gen = NULL;
+        z->mod = NULL;
+        *zone_list = fluid_list_prepend(*zone_list, z);
+
+        for(k = izones[i].gen_count; k-- > 0;)
+        {
+            z->gen = fluid_list_prepend(z->gen, &gens[izones[i].gen_start + k]);
+        }
+
+        for(k = izones[i].mod_count; k-- > 0;)
+        {
+            z->mod = fluid_list_prepend(z->mod, &mods[izones[i].mod_start + k]);
+        }
+    }
+}
+
+/*
+ * Rebuilds the presets, instruments and samples of the soundfont from its index file in the
+ * index directory, mapped (or read, if mapping isn't possible) into memory and processed in
+ * one pass. Returns TRUE when done, FALSE if there is no such file or it doesn't belong to the
+ * soundfont as it is now, and -1 if running out of memory on the way.
+ */
+static int load_index(SFData *sf, const char *index_dir, time_t modification_time)
+{
+    SFIndexHeader header, expected;
+    const SFIndexPreset *ipresets;
+    const SFIndexInst *iinsts;
+    const SFIndexSample *isamples;
+    const SFIndexZone *izones;
+    fluid_file_mapping_t *mapping = NULL;
+    fluid_list_t **inst_nodes = NULL, **sample_nodes = NULL;
+    SFZone *zones;
+    SFGen *gens;
+    SFMod *mods;
+    char path[1024];
+    char *filename = NULL, *buffer = NULL;
+    const char *data;
+    FILE *file;
+    uint64_t size;
+    long file_size;
+    uint32_t i, next_zone = 0;
+    int ret = FALSE;
+
+    get_index_file_path(sf, index_dir, path, sizeof(path));
+    file = FLUID_FOPEN(path, "rb");
+
+    if(file == NULL)
+    {
+        return FALSE;
+    }
+
+    if(FLUID_FREAD(&header, sizeof(header), 1, file) != 1)
+    {
+        goto exit;
+    }
+
+    init_index_header(sf, modification_time, &expected);
+    expected.preset_count = header.preset_count;
+    expected.inst_count = header.inst_count;
+    expected.sample_count = header.sample_count;
+    expected.zone_count = header.zone_count;
+    expected.gen_count = header.gen_count;
+    expected.mod_count = header.mod_count;
+
+    if(FLUID_MEMCMP(&header, &expected, sizeof(header)) != 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Ignoring outdated SoundFont index '%s'", path);
+        goto exit;
+    }
+
+    filename = FLUID_MALLOC(header.filename_length + 1);
+
+    if(filename == NULL
+            || FLUID_FREAD(filename, 1, header.filename_length, file) != header.filename_length
+            || FLUID_MEMCMP(filename, sf->fname, header.filename_length) != 0)
+    {
+        goto exit;
+    }
+
+    size = get_index_file_size(&header);
+
+    /* a file truncated while written would crash when accessing the mapping */
+    if(FLUID_FSEEK(file, 0, SEEK_END) != 0 || (file_size = FLUID_FTELL(file)) < 0
+            || (uint64_t)file_size != size)
+    {
+        goto exit;
+    }
+
+    mapping = new_fluid_file_mapping(path, 0, (unsigned long)size);
+
+    if(mapping != NULL)
+    {
+        data = fluid_file_mapping_get_data(mapping);
+    }
+    else
+    {
+        buffer = FLUID_MALLOC((size_t)size);
+
+        if(buffer == NULL
+                || FLUID_FSEEK(file, 0, SEEK_SET) != 0
+                || FLUID_FREAD(buffer, 1, (size_t)size, file) != (size_t)size)
+        {
+            goto exit;
+        }
+
+        data = buffer;
+    }
+
+    ipresets = (const SFIndexPreset *)(data + header.header_size);
+    iinsts = (const SFIndexInst *)(ipresets + header.preset_count);
+    isamples = (const SFIndexSample *)(iinsts + header.inst_count);
+    izones = (const SFIndexZone *)(isamples + header.sample_count);
+
+    /* check all references before building anything, the SoundFont is parsed instead otherwise */
+    for(i = 0; i < header.preset_count; i++)
+    {
+        if(!check_index_zones(&header, izones, ipresets[i].zone_start, ipresets[i].zone_count,
+                              header.inst_count, &next_zone))
+        {
+            goto invalid;
+        }
+    }
+
+    for(i = 0; i < header.inst_count; i++)
+    {
+        if(!check_index_zones(&header, izones, iinsts[i].zone_start, iinsts[i].zone_count,
+                              header.sample_count, &next_zone))
+        {
+            goto invalid;
+        }
+    }
+
+    if(next_zone != header.zone_count)
+    {
+        goto invalid;
+    }
+
+    ret = -1;
+    inst_nodes = FLUID_ARRAY(fluid_list_t *, header.inst_count + 1);
+    sample_nodes = FLUID_ARRAY(fluid_list_t *, header.sample_count + 1);
+    zones = new_records(sf, (int)header.zone_count, sizeof(SFZone));
+    gens = new_records(sf, (int)header.gen_count, sizeof(SFGen));
+    mods = new_records(sf, (int)header.mod_count, sizeof(SFMod));
+
+    if(inst_nodes == NULL || sample_nodes == NULL || zones == NULL || gens == NULL || mods == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto exit;
+    }
+
+    FLUID_MEMCPY(gens, izones + header.zone_count, header.gen_count * sizeof(SFGen));
+    FLUID_MEMCPY(mods, (const SFGen *)(izones + header.zone_count) + header.gen_count,
+                 header.mod_count * sizeof(SFMod));
+
+    for(i = header.sample_count; i-- > 0;)
+    {
+        SFSample *sample = FLUID_NEW(SFSample);
+
+        if(sample == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto exit;
+        }
+
+        FLUID_MEMCPY(sample->name, isamples[i].name, 20);
+        sample->name[20] = '\0';
+        sample->start = isamples[i].start;
+        sample->end = isamples[i].end;
+        sample->loopstart = isamples[i].loopstart;
+        sample->loopend = isamples[i].loopend;
+        sample->samplerate = isamples[i].samplerate;
+        sample->origpitch = isamples[i].origpitch;
+        sample->pitchadj = isamples[i].pitchadj;
+        sample->sampletype = isamples[i].sampletype;
+        sample->fluid_sample = NULL;
+
+        sf->sample = fluid_list_prepend(sf->sample, sample);
+        sample_nodes[i] = sf->sample;
+    }
+
+    for(i = header.inst_count; i-- > 0;)
+    {
+        SFInst *inst = FLUID_NEW(SFInst);
+
+        if(inst == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto exit;
+        }
+
+        FLUID_MEMCPY(inst->name, iinsts[i].name, 20);
+        inst->name[20] = '\0';
+        inst->idx = (int)i;
+        inst->zone = NULL;
+
+        sf->inst = fluid_list_prepend(sf->inst, inst);
+        inst_nodes[i] = sf->inst;
+        load_index_zones(&inst->zone, izones, iinsts[i].zone_start, iinsts[i].zone_count,
+                         zones, gens, mods, sample_nodes);
+    }
+
+    for(i = header.preset_count; i-- > 0;)
+    {
+        SFPreset *preset = FLUID_NEW(SFPreset);
+
+        if(preset == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto exit;
+        }
+
+        FLUID_MEMCPY(preset->name, ipresets[i].name, 20);
+        preset->name[20] = '\0';
+        preset->prenum = ipresets[i].prenum;
+        preset->bank = ipresets[i].bank;
+        preset->libr = ipresets[i].libr;
+        preset->genre = ipresets[i].genre;
+        preset->morph = ipresets[i].morph;
+        preset->zone = NULL;
+
+        sf->preset = fluid_list_prepend(sf->preset, preset);
+        load_index_zones(&preset->zone, izones, ipresets[i].zone_start, ipresets[i].zone_count,
+                         zones, gens, mods, inst_nodes);
+    }
+
+    ret = TRUE;
+    FLUID_LOG(FLUID_DBG, "Loaded SoundFont index '%s'", path);
+    goto exit;
+
+invalid:
+    FLUID_LOG(FLUID_DBG, "Ignoring invalid SoundFont index '%s'", path);
+
+exit:
+    FLUID_FREE(inst_nodes);
+    FLUID_FREE(sample_nodes);
+    delete_fluid_file_mapping(mapping);
+    FLUID_FREE(buffer);
+    FLUID_FREE(filename);
+    FLUID_FCLOSE(file);
+    return ret;
+}
+
+/* Counts the zones, generators and modulators of a zone list into the header of an index file */
+static void count_index_zones(fluid_list_t *zone_list, SFIndexHeader *header)
+{
+    fluid_list_t *p, *p2;
+
+    for(p = zone_list; p; p = fluid_list_next(p))
+    {
+        SFZone *z = (SFZone *)fluid_list_get(p);
+
+        header->zone_count++;
+
+        for(p2 = z->gen; p2; p2 = fluid_list_next(p2))
+        {
+            header->gen_count += (fluid_list_get(p2) != NULL);
+        }
+
+        for(p2 = z->mod; p2; p2 = fluid_list_next(p2))
+        {
+            header->mod_count += (fluid_list_get(p2) != NULL);
+        }
+    }
+}
+
+/* Stores a zone list into the records of an index file, returns the number of zones stored */
+static uint32_t store_index_zones(fluid_list_t *zone_list, fluid_hashtable_t *sample_indices,
+                                  SFIndexZone *izones, SFGen *gens, SFMod *mods,
+                                  uint32_t *nzones, uint32_t *ngens, uint32_t *nmods)
+{
+    fluid_list_t *p, *p2;
+    uint32_t start = *nzones;
+
+    for(p = zone_list; p; p = fluid_list_next(p))
+    {
+        SFZone *z = (SFZone *)fluid_list_get(p);
+        SFIndexZone *iz = &izones[(*nzones)++];
+
+        if(z->instsamp == NULL)
+        {
+            iz->instsamp = 0;
+        }
+        else if(sample_indices == NULL)
+        {
+            /* zone of a preset */
+            iz->instsamp = (uint32_t)((SFInst *)fluid_list_get(z->instsamp))->idx + 1;
+        }
+        else
+        {
+            void *index = fluid_hashtable_lookup(sample_indices, z->instsamp);
+
+            iz->instsamp = FLUID_POINTER_TO_UINT(index);
+        }
+
+        iz->gen_start = *ngens;
+
+        for(p2 = z->gen; p2; p2 = fluid_list_next(p2))
+        {
+            if(fluid_list_get(p2) != NULL)
+            {
+                gens[(*ngens)++] = *(SFGen *)fluid_list_get(p2);
+            }
+        }
+
+        iz->gen_count = *ngens - iz->gen_start;
+        iz->mod_start = *nmods;
+
+        for(p2 = z->mod; p2; p2 = fluid_list_next(p2))
+        {
+            if(fluid_list_get(p2) != NULL)
+            {
+                mods[(*nmods)++] = *(SFMod *)fluid_list_get(p2);
+            }
+        }
+
+        iz->mod_count = *nmods - iz->mod_start;
+    }
+
+    return *nzones - start;
+}
+
+/*
+ * Stores the parsed presets, instruments and samples of the soundfont into its index file in
+ * the index directory. It's written to a temporary file first, so that others never see a partial
+ * file. Failing is not an error, the soundfont will just be parsed again next time.
+ */
+static void store_index(const SFData *sf, const char *index_dir, time_t modification_time)
+{
+    SFIndexHeader header;
+    SFIndexPreset *ipresets;
+    SFIndexInst *iinsts;
+    SFIndexSample *isamples;
+    SFIndexZone *izones;
+    SFGen *gens;
+    SFMod *mods;
+    fluid_hashtable_t *sample_indices;
+    fluid_list_t *p;
+    char path[1024], tmp_path[1100];
+    char *data;
+    FILE *file;
+    size_t size;
+    uint32_t i, nzones = 0, ngens = 0, nmods = 0;
+    int ok;
+
+    init_index_header(sf, modification_time, &header);
+
+    for(p = sf->preset; p; p = fluid_list_next(p))
+    {
+        header.preset_count++;
+        count_index_zones(((SFPreset *)fluid_list_get(p))->zone, &header);
+    }
+
+    for(p = sf->inst; p; p = fluid_list_next(p))
+    {
+        header.inst_count++;
+        count_index_zones(((SFInst *)fluid_list_get(p))->zone, &header);
+    }
+
+    header.sample_count = (uint32_t)fluid_list_size(sf->sample);
+
+    size = (size_t)get_index_file_size(&header);
+    data = FLUID_MALLOC(size);
+    sample_indices = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+    if(data == NULL || sample_indices == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Out of memory, not storing a SoundFont index");
+        goto exit;
+    }
+
+    /* zero the padding of the names and records too, so that the same SoundFont always gets the same file */
+    FLUID_MEMSET(data, 0, size);
+    FLUID_MEMCPY(data, &header, sizeof(header));
+    FLUID_MEMCPY(data + sizeof(header), sf->fname, header.filename_length);
+
+    ipresets = (SFIndexPreset *)(data + header.header_size);
+    iinsts = (SFIndexInst *)(ipresets + header.preset_count);
+    isamples = (SFIndexSample *)(iinsts + header.inst_count);
+    izones = (SFIndexZone *)(isamples + header.sample_count);
+    gens = (SFGen *)(izones + header.zone_count);
+    mods = (SFMod *)(gens + header.gen_count);
+
+    for(p = sf->sample, i = 0; p; p = fluid_list_next(p), i++)
+    {
+        const SFSample *sample = (const SFSample *)fluid_list_get(p);
+
+        FLUID_MEMCPY(isamples[i].name, sample->name, 20);
+        isamples[i].start = sample->start;
+        isamples[i].end = sample->end;
+        isamples[i].loopstart = sample->loopstart;
+        isamples[i].loopend = sample->loopend;
+        isamples[i].samplerate = sample->samplerate;
+        isamples[i].origpitch = sample->origpitch;
+        isamples[i].pitchadj = sample->pitchadj;
+        isamples[i].sampletype = sample->sampletype;
+
+        /* instrument zones refer to the list nodes of their samples */
+        fluid_hashtable_insert(sample_indices, p, FLUID_UINT_TO_POINTER(i + 1));
+    }
+
+    for(p = sf->preset, i = 0; p; p = fluid_list_next(p), i++)
+    {
+        const SFPreset *preset = (const SFPreset *)fluid_list_get(p);
+
+        FLUID_MEMCPY(ipresets[i].name, preset->name, 20);
+        ipresets[i].prenum = preset->prenum;
+        ipresets[i].bank = preset->bank;
+        ipresets[i].libr = preset->libr;
+        ipresets[i].genre = preset->genre;
+        ipresets[i].morph = preset->morph;
+        ipresets[i].zone_start = nzones;
+        ipresets[i].zone_count = store_index_zones(preset->zone, NULL, izones, gens, mods,
+                                 &nzones, &ngens, &nmods);
+    }
+
+    for(p = sf->inst, i = 0; p; p = fluid_list_next(p), i++)
+    {
+        const SFInst *inst = (const SFInst *)fluid_list_get(p);
+
+        FLUID_MEMCPY(iinsts[i].name, inst->name, 20);
+        iinsts[i].zone_start = nzones;
+        iinsts[i].zone_count = store_index_zones(inst->zone, sample_indices, izones, gens, mods,
+                               &nzones, &ngens, &nmods);
+    }
+
+    get_index_file_path(sf, index_dir, path, sizeof(path));
+    FLUID_SNPRINTF(tmp_path, sizeof(tmp_path), "%s.%p.%.0f.tmp", path, (const void *)sf, fluid_utime());
 
-    p = sf->inst;
+    file = FLUID_FOPEN(tmp_path, "wb");
 
-    while(p)
+    if(file == NULL)
     {
-        p2 = ((SFInst *)(p->data))->zone;
+        FLUID_LOG(FLUID_WARN, "Failed to create '%s' to store a SoundFont index", tmp_path);
+        goto exit;
+    }
 
-        while(p2)
-        {
-            /* traverse instrument's zones */
-            z = (SFZone *)(p2->data);
+    ok = (fwrite(data, 1, size, file) == size);
+    ok = (FLUID_FCLOSE(file) == 0) && ok;
 
-            if((i = FLUID_POINTER_TO_INT(z->instsamp)))
-            {
-                /* load sample # */
-                p3 = fluid_list_nth(sf->sample, i - 1);
+    if(!ok || rename(tmp_path, path) != 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to store SoundFont index to '%s'", path);
+        remove(tmp_path);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_DBG, "Stored SoundFont index to '%s'", path);
+    }
 
-                if(!p3)
-                {
-                    FLUID_LOG(FLUID_ERR, "Instrument '%s': Invalid sample reference",
-                              ((SFInst *)(p->data))->name);
-                    return FALSE;
-                }
+exit:
+    delete_fluid_hashtable(sample_indices);
+    FLUID_FREE(data);
+}
 
-                z->instsamp = p3;
-            }
+/* Allocate the records of a sub-chunk all at once, freed by fluid_sffile_close() */
+static void *new_records(SFData *sf, int count, size_t size)
+{
+    void *records;
 
-            p2 = fluid_list_next(p2);
-        }
+    /* one more, so that empty chunks don't end up with a NULL pointer */
+    records = FLUID_MALLOC((count + 1) * size);
 
-        p = fluid_list_next(p);
+    if(records == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
     }
 
-    return TRUE;
+    sf->records = fluid_list_prepend(sf->records, records);
+    sf->heap_size += (count + 1) * size;
+
+    return records;
 }
 
 static void delete_preset(SFPreset *preset)
@@ -2265,37 +3571,17 @@ static void delete_inst(SFInst *inst)
 }
 
 
-/* Free all elements of a zone (Preset or Instrument) */
+/* Free the lists of a zone (Preset or Instrument) */
 static void delete_zone(SFZone *zone)
 {
-    fluid_list_t *entry;
-
     if(!zone)
     {
         return;
     }
 
-    entry = zone->gen;
-
-    while(entry)
-    {
-        FLUID_FREE(fluid_list_get(entry));
-        entry = fluid_list_next(entry);
-    }
-
+    /* the zone, its generators and modulators belong to the record arrays */
     delete_fluid_list(zone->gen);
-
-    entry = zone->mod;
-
-    while(entry)
-    {
-        FLUID_FREE(fluid_list_get(entry));
-        entry = fluid_list_next(entry);
-    }
-
     delete_fluid_list(zone->mod);
-
-    FLUID_FREE(zone);
 }
 
 /* preset sort function, first by bank, then by preset # */
@@ -2379,6 +3665,7 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
 {
     short *loaded_data = NULL;
     char *loaded_data24 = NULL;
+    int read_ahead;
 
     int num_samples = (end + 1) - start;
     fluid_return_val_if_fail(num_samples > 0, -1);
@@ -2389,11 +3676,11 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
         goto error_exit;
     }
 
-    /* Load 16-bit sample data */
-    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + (start * sizeof(short)), SEEK_SET) == FLUID_FAILED)
+    read_ahead = fluid_sffile_take_read_ahead(sf, start, end, &loaded_data, &loaded_data24);
+
+    if(read_ahead)
     {
-        FLUID_LOG(FLUID_ERR, "Failed to seek to sample position");
-        goto error_exit;
+        goto byte_swap;
     }
 
     loaded_data = FLUID_ARRAY(short, num_samples);
@@ -2404,12 +3691,32 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
         goto error_exit;
     }
 
+    if(sf->huge_pages)
+    {
+        fluid_huge_pages_advise(loaded_data, num_samples * sizeof(short));
+    }
+
+    /* Load 16-bit sample data */
+    fluid_mutex_lock(sf->io_mutex);
+
+    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + (start * sizeof(short)), SEEK_SET) == FLUID_FAILED)
+    {
+        fluid_mutex_unlock(sf->io_mutex);
+        FLUID_LOG(FLUID_ERR, "Failed to seek to sample position");
+        goto error_exit;
+    }
+
     if(sf->fcbs->fread(loaded_data, num_samples * sizeof(short), sf->sffd) == FLUID_FAILED)
     {
+        fluid_mutex_unlock(sf->io_mutex);
         FLUID_LOG(FLUID_ERR, "Failed to read sample data");
         goto error_exit;
     }
 
+    fluid_mutex_unlock(sf->io_mutex);
+
+byte_swap:
+
     /* If this machine is big endian, byte swap the 16 bit samples */
     if(FLUID_IS_BIG_ENDIAN)
     {
@@ -2426,7 +3733,7 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
     /* Optionally load additional 8 bit sample data for 24-bit support. Any failures while loading
      * the 24-bit sample data will be logged as errors but won't prevent the sample reading to
      * fail, as sound output is still possible with the 16-bit sample data. */
-    if(sf->sample24pos)
+    if(sf->sample24pos && !read_ahead)
     {
         if((start > sf->sample24size) || (end > sf->sample24size))
         {
@@ -2434,25 +3741,36 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
             goto error24_exit;
         }
 
-        if(sf->fcbs->fseek(sf->sffd, sf->sample24pos + start, SEEK_SET) == FLUID_FAILED)
+        loaded_data24 = FLUID_ARRAY(char, num_samples);
+
+        if(loaded_data24 == NULL)
         {
-            FLUID_LOG(FLUID_ERR, "Failed to seek position for 24-bit sample data in data file");
+            FLUID_LOG(FLUID_ERR, "Out of memory reading 24-bit sample data");
             goto error24_exit;
         }
 
-        loaded_data24 = FLUID_ARRAY(char, num_samples);
+        if(sf->huge_pages)
+        {
+            fluid_huge_pages_advise(loaded_data24, num_samples);
+        }
 
-        if(loaded_data24 == NULL)
+        fluid_mutex_lock(sf->io_mutex);
+
+        if(sf->fcbs->fseek(sf->sffd, sf->sample24pos + start, SEEK_SET) == FLUID_FAILED)
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory reading 24-bit sample data");
+            fluid_mutex_unlock(sf->io_mutex);
+            FLUID_LOG(FLUID_ERR, "Failed to seek position for 24-bit sample data in data file");
             goto error24_exit;
         }
 
         if(sf->fcbs->fread(loaded_data24, num_samples, sf->sffd) == FLUID_FAILED)
         {
+            fluid_mutex_unlock(sf->io_mutex);
             FLUID_LOG(FLUID_ERR, "Failed to read 24-bit sample data");
             goto error24_exit;
         }
+
+        fluid_mutex_unlock(sf->io_mutex);
     }
 
     *data24 = loaded_data24;
@@ -2473,17 +3791,254 @@ error_exit:
 
 
 /* Ogg Vorbis loading and decompression */
-#if LIBSNDFILE_SUPPORT
+#if LIBVORBIS_SUPPORT || LIBSNDFILE_SUPPORT
+
+/*
+ * Reads the Ogg Vorbis data of a sample from the Soundfont into memory, so that
+ * several samples can be decompressed in parallel. Returns its length in bytes,
+ * or -1 on error.
+ */
+static int fluid_sffile_read_compressed(SFData *sf, unsigned int start_byte, unsigned int end_byte,
+                                        char **compressed_data)
+{
+    double start = fluid_sfont_load_stats_start(sf->load_stats);
+
+    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize) || (end_byte < start_byte))
+    {
+        FLUID_LOG(FLUID_ERR, "Ogg Vorbis data offsets exceed sample data chunk");
+        return -1;
+    }
+
+    *compressed_data = FLUID_MALLOC((end_byte + 1) - start_byte);
+
+    if(*compressed_data == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return -1;
+    }
+
+    /* Read the Ogg Vorbis data from the Soundfont, the decompression doesn't need the file anymore */
+    fluid_mutex_lock(sf->io_mutex);
+
+    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + start_byte, SEEK_SET) == FLUID_FAILED)
+    {
+        fluid_mutex_unlock(sf->io_mutex);
+        FLUID_LOG(FLUID_ERR, "Failed to seek to compressd sample position");
+        FLUID_FREE(*compressed_data);
+        return -1;
+    }
+
+    if(sf->fcbs->fread(*compressed_data, (end_byte + 1) - start_byte, sf->sffd) == FLUID_FAILED)
+    {
+        fluid_mutex_unlock(sf->io_mutex);
+        FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
+        FLUID_FREE(*compressed_data);
+        return -1;
+    }
+
+    fluid_mutex_unlock(sf->io_mutex);
+
+    fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SAMPLE_IO, start, (end_byte + 1) - start_byte);
+
+    return (end_byte + 1) - start_byte;
+}
+#endif
+
+#if LIBVORBIS_SUPPORT
+
+/* Memory access routines for libvorbisfile, decoding each sample straight from
+ * the copy of its compressed data. */
+typedef struct _ovmem_data_t
+{
+    const char *buf;   /* compressed data */
+    ogg_int64_t length; /* length of the compressed data */
+    ogg_int64_t offset; /* current offset from start of compressed data */
+
+} ovmem_data_t;
+
+static size_t ovmem_read(void *ptr, size_t size, size_t nmemb, void *user_data)
+{
+    ovmem_data_t *data = user_data;
+    ogg_int64_t count = (ogg_int64_t)(size * nmemb);
+
+    if(size == 0)
+    {
+        return 0;
+    }
+
+    if(count > data->length - data->offset)
+    {
+        count = data->length - data->offset;
+    }
+
+    FLUID_MEMCPY(ptr, data->buf + data->offset, (size_t)count);
+    data->offset += count;
+
+    return (size_t)count / size;
+}
+
+static int ovmem_seek(void *user_data, ogg_int64_t offset, int whence)
+{
+    ovmem_data_t *data = user_data;
+
+    switch(whence)
+    {
+    case SEEK_SET:
+        break;
+
+    case SEEK_CUR:
+        offset += data->offset;
+        break;
+
+    case SEEK_END:
+        offset += data->length;
+        break;
+
+    default:
+        return -1;
+    }
+
+    if(offset < 0 || offset > data->length)
+    {
+        return -1;
+    }
+
+    data->offset = offset;
+
+    return 0;
+}
+
+static long ovmem_tell(void *user_data)
+{
+    ovmem_data_t *data = user_data;
+
+    return (long)data->offset;
+}
+
+/**
+ * Read Ogg Vorbis compressed data from the Soundfont and decompress it, returning the number of samples
+ * in the decompressed WAV. Only 16-bit mono samples are supported.
+ *
+ * Note that this function takes byte indices for start and end source data. The sample headers in SF3
+ * files use byte indices, so those pointers can be passed directly to this function.
+ *
+ * Each sample is an Ogg Vorbis stream of its own, decoded by libvorbisfile
+ * from memory right into the sample data, without the format detection and
+ * the conversions of libsndfile.
+ */
+static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigned int end_byte, short **data)
+{
+    static const ov_callbacks callbacks =
+    {
+        ovmem_read,
+        ovmem_seek,
+        NULL,
+        ovmem_tell
+    };
+    OggVorbis_File vf;
+    vorbis_info *info;
+    ovmem_data_t ovdata;
+    short *wav_data = NULL;
+    char *compressed_data;
+    ogg_int64_t frames, pos = 0;
+    long n;
+    int length, bitstream;
+    double start;
+
+    length = fluid_sffile_read_compressed(sf, start_byte, end_byte, &compressed_data);
+
+    if(length < 0)
+    {
+        return -1;
+    }
 
-/* Virtual file access routines to allow loading individually compressed
- * samples from the Soundfont sample data chunk using the file callbacks
- * passing in during opening of the file */
+    start = fluid_sfont_load_stats_start(sf->load_stats);
+
+    ovdata.buf = compressed_data;
+    ovdata.length = length;
+    ovdata.offset = 0;
+
+    if(ov_open_callbacks(&ovdata, &vf, NULL, 0, callbacks) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to open the Ogg Vorbis data of a sample");
+        FLUID_FREE(compressed_data);
+        return -1;
+    }
+
+    info = ov_info(&vf, -1);
+    frames = ov_pcm_total(&vf, -1);
+
+    // Empty sample
+    if(info == NULL || frames <= 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Empty decompressed sample");
+        *data = NULL;
+        ov_clear(&vf);
+        FLUID_FREE(compressed_data);
+        return 0;
+    }
+
+    // Mono sample
+    if(info->channels != 1)
+    {
+        FLUID_LOG(FLUID_DBG, "Unsupported channel count %d in ogg sample", info->channels);
+        goto error_exit;
+    }
+
+    wav_data = FLUID_ARRAY(short, frames);
+
+    if(!wav_data)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_exit;
+    }
+
+    if(sf->huge_pages)
+    {
+        fluid_huge_pages_advise(wav_data, (unsigned long)frames * sizeof(short));
+    }
+
+    /* Decompresses to signed 16-bit PCM in host byte order */
+    while(pos < frames)
+    {
+        n = ov_read(&vf, (char *)(wav_data + pos), (int)((frames - pos) * sizeof(short)),
+                    FLUID_IS_BIG_ENDIAN, sizeof(short), 1, &bitstream);
+
+        if(n <= 0)
+        {
+            FLUID_LOG(FLUID_ERR, "Decompression of an Ogg Vorbis sample failed");
+            goto error_exit;
+        }
+
+        pos += n / sizeof(short);
+    }
+
+    ov_clear(&vf);
+    FLUID_FREE(compressed_data);
+
+    *data = wav_data;
+
+    fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SF3_DECODE, start, (size_t)frames * sizeof(short));
+
+    return (int)frames;
+
+error_exit:
+    FLUID_FREE(wav_data);
+    ov_clear(&vf);
+    FLUID_FREE(compressed_data);
+    return -1;
+}
+#elif LIBSNDFILE_SUPPORT
+
+/* Virtual file access routines to allow decompressing individually compressed
+ * samples after reading them from the Soundfont sample data chunk. They operate
+ * on a copy of the compressed data in memory, so that several samples can be
+ * decompressed in parallel. */
 typedef struct _sfvio_data_t
 {
-    SFData *sffile;
-    sf_count_t start;  /* start byte offset of compressed data */
-    sf_count_t end;    /* end byte offset of compressed data */
-    sf_count_t offset; /* current virtual file offset from start byte offset */
+    const char *buf;   /* compressed data */
+    sf_count_t length; /* length of the compressed data */
+    sf_count_t offset; /* current virtual file offset from start of compressed data */
 
 } sfvio_data_t;
 
@@ -2491,13 +4046,12 @@ static sf_count_t sfvio_get_filelen(void *user_data)
 {
     sfvio_data_t *data = user_data;
 
-    return (data->end + 1) - data->start;
+    return data->length;
 }
 
 static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
 {
     sfvio_data_t *data = user_data;
-    SFData *sf = data->sffile;
     sf_count_t new_offset;
 
     switch(whence)
@@ -2518,7 +4072,7 @@ static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
         goto fail; /* proper error handling not possible?? */
     }
 
-    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + data->start + new_offset, SEEK_SET) != FLUID_FAILED)
+    if(new_offset >= 0 && new_offset <= data->length)
     {
         data->offset = new_offset;
     }
@@ -2530,7 +4084,6 @@ fail:
 static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
 {
     sfvio_data_t *data = user_data;
-    SFData *sf = data->sffile;
     sf_count_t remain;
 
     remain = sfvio_get_filelen(user_data) - data->offset;
@@ -2545,12 +4098,7 @@ static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
         return count;
     }
 
-    if(sf->fcbs->fread(ptr, count, sf->sffd) == FLUID_FAILED)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
-        return 0;
-    }
-
+    FLUID_MEMCPY(ptr, data->buf + data->offset, count);
     data->offset += count;
 
     return count;
@@ -2587,34 +4135,33 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     };
     sfvio_data_t sfdata;
     short *wav_data = NULL;
+    char *compressed_data;
+    int length;
+    double start;
+
+    length = fluid_sffile_read_compressed(sf, start_byte, end_byte, &compressed_data);
 
-    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize))
+    if(length < 0)
     {
-        FLUID_LOG(FLUID_ERR, "Ogg Vorbis data offsets exceed sample data chunk");
         return -1;
     }
 
+    start = fluid_sfont_load_stats_start(sf->load_stats);
+
     // Initialize file position indicator and SF_INFO structure
-    sfdata.sffile = sf;
-    sfdata.start = start_byte;
-    sfdata.end = end_byte;
+    sfdata.buf = compressed_data;
+    sfdata.length = length;
     sfdata.offset = 0;
 
     FLUID_MEMSET(&sfinfo, 0, sizeof(sfinfo));
 
-    /* Seek to beginning of Ogg Vorbis data in Soundfont */
-    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + start_byte, SEEK_SET) == FLUID_FAILED)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to seek to compressd sample position");
-        return -1;
-    }
-
     // Open sample as a virtual file
     sndfile = sf_open_virtual(&sfvio, SFM_READ, &sfinfo, &sfdata);
 
     if(!sndfile)
     {
         FLUID_LOG(FLUID_ERR, "%s", sf_strerror(sndfile));
+        FLUID_FREE(compressed_data);
         return -1;
     }
 
@@ -2624,6 +4171,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         FLUID_LOG(FLUID_DBG, "Empty decompressed sample");
         *data = NULL;
         sf_close(sndfile);
+        FLUID_FREE(compressed_data);
         return 0;
     }
 
@@ -2647,6 +4195,11 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         goto error_exit;
     }
 
+    if(sf->huge_pages)
+    {
+        fluid_huge_pages_advise(wav_data, (unsigned long)(sfinfo.frames * sizeof(short)));
+    }
+
     /* Automatically decompresses the Ogg Vorbis data to 16-bit PCM */
     if(sf_readf_short(sndfile, wav_data, sfinfo.frames) < sfinfo.frames)
     {
@@ -2656,14 +4209,18 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     }
 
     sf_close(sndfile);
+    FLUID_FREE(compressed_data);
 
     *data = wav_data;
 
+    fluid_sfont_load_stats_add(sf->load_stats, FLUID_SFONT_LOAD_SF3_DECODE, start, (size_t)sfinfo.frames * sizeof(short));
+
     return sfinfo.frames;
 
 error_exit:
     FLUID_FREE(wav_data);
     sf_close(sndfile);
+    FLUID_FREE(compressed_data);
     return -1;
 }
 #else
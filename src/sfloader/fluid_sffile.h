@@ -30,6 +30,7 @@
 #include "fluid_mod.h"
 #include "fluidsynth.h"
 #include "fluidsynth_priv.h"
+#include "fluid_sys.h"
 
 
 /* Sound Font structure defines */
@@ -136,6 +137,16 @@ struct _SFPreset
     fluid_list_t *zone; /* list of preset zones */
 };
 
+/* The time and the bytes taken by each stage of loading a SoundFont (#fluid_sfont_load_stage),
+ * see fluid_synth_get_sfont_load_stats(). The stages may be timed by several loader threads
+ * at once, whose times add up. */
+typedef struct
+{
+    fluid_mutex_t mutex;
+    double msec[FLUID_SFONT_LOAD_LAST];
+    size_t bytes[FLUID_SFONT_LOAD_LAST];
+} fluid_sfont_load_stats_t;
+
 /* NOTE: sffd is also used to determine if sound font is new (NULL) */
 struct _SFData
 {
@@ -158,11 +169,19 @@ struct _SFData
     char *fname; /* file name */
     FILE *sffd; /* loaded sfont file descriptor */
     const fluid_file_callbacks_t *fcbs; /* file callbacks used to read this file */
+    fluid_mutex_t io_mutex; /* serializes reading sample data from sffd, which might happen in several threads */
+    fluid_file_reader_t *reader; /* reads the sample data submitted by fluid_sffile_read_ahead() */
+    int reader_failed; /* TRUE if the reader couldn't be created, not to try again */
+    fluid_list_t *read_ahead; /* the samples read ahead (SFReadAhead), not taken yet */
+    int huge_pages; /* TRUE to advise huge pages for the sample data read */
+    fluid_sfont_load_stats_t *load_stats; /* the stages of loading are timed into, NULL if not timed */
 
     fluid_list_t *info; /* linked list of info strings (1st byte is ID) */
     fluid_list_t *preset; /* linked list of preset info */
     fluid_list_t *inst; /* linked list of instrument info */
     fluid_list_t *sample; /* linked list of sample info */
+    fluid_list_t *records; /* arrays holding the zones, generators and modulators of the lists above */
+    size_t heap_size; /* bytes of the info strings and of the records, see fluid_sffile_get_size() */
 };
 
 /* functions */
@@ -222,8 +241,23 @@ struct _SFShdr
 /* Public functions  */
 SFData *fluid_sffile_open(const char *fname, const fluid_file_callbacks_t *fcbs);
 void fluid_sffile_close(SFData *sf);
-int fluid_sffile_parse_presets(SFData *sf);
+size_t fluid_sffile_get_size(const SFData *sf);
+int fluid_sffile_parse_presets(SFData *sf, const char *index_dir);
 int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
                                   int sample_type, short **data, char **data24);
+int fluid_sffile_map_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                 int sample_type, short **data, char **data24,
+                                 fluid_file_mapping_t **mapping, fluid_file_mapping_t **mapping24);
+int fluid_sffile_read_ahead(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                           int sample_type, int depth);
+void fluid_sffile_flush_read_ahead(SFData *sf);
+
+fluid_sfont_load_stats_t *new_fluid_sfont_load_stats(void);
+void delete_fluid_sfont_load_stats(fluid_sfont_load_stats_t *stats);
+double fluid_sfont_load_stats_start(const fluid_sfont_load_stats_t *stats);
+void fluid_sfont_load_stats_add(fluid_sfont_load_stats_t *stats, int stage, double start, size_t bytes);
+void fluid_sfont_load_stats_get(fluid_sfont_load_stats_t *stats, double *msec, size_t *bytes);
+void fluid_sfont_load_stats_report(fluid_sfont_load_stats_t *stats, const char *what, const char *name,
+                                   double start, const double *msec_before, const size_t *bytes_before);
 
 #endif /* _FLUID_SFFILE_H */
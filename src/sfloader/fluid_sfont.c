@@ -515,6 +515,8 @@ delete_fluid_sample(fluid_sample_t *sample)
         FLUID_FREE(sample->data24);
     }
 
+    fluid_sample_unpad_loop(sample);
+    fluid_sample_free_stream_data(sample);
     FLUID_FREE(sample);
 }
 
@@ -587,6 +589,9 @@ fluid_sample_set_sound_data(fluid_sample_t *sample,
 
     sample->data = NULL;
     sample->data24 = NULL;
+    sample->float_data = NULL;
+    fluid_sample_unpad_loop(sample);
+    fluid_sample_free_stream_data(sample);
 
     if(copy_data)
     {
@@ -668,6 +673,8 @@ int fluid_sample_set_loop(fluid_sample_t *sample, unsigned int loop_start, unsig
 {
     fluid_return_val_if_fail(sample != NULL, FLUID_FAILED);
 
+    fluid_sample_unpad_loop(sample);
+    fluid_sample_free_stream_data(sample);
     sample->loopstart = loop_start;
     sample->loopend = loop_end;
 
@@ -824,3 +831,249 @@ int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int buffer_size)
 
     return modified;
 }
+
+/* The point of the sample loop at a frame offset from its start, repeating the loop in both
+ * directions, as float */
+static float fluid_sample_get_loop_point(const fluid_sample_t *sample, int offset)
+{
+    int loop_len = (int)(sample->loopend - sample->loopstart);
+    unsigned int idx = sample->loopstart + (unsigned int)((offset % loop_len + loop_len) % loop_len);
+    uint32_t msb = (uint32_t)sample->data[idx];
+    uint8_t lsb = (sample->data24 != NULL) ? (uint8_t)sample->data24[idx] : 0U;
+
+    /* exact, the 24 bits fit into the mantissa */
+    return (float)(int32_t)((msb << 8) | lsb);
+}
+
+/* Copy the points of the sample loop to float, preceded by its last and followed by its
+ * first FLUID_SAMPLE_LOOP_PADDING points, so that the interpolation can read the points
+ * around the loop boundary without wrapping around. The sample is played without the
+ * copy if its loop is too short or there is not enough memory for it.
+ */
+void fluid_sample_pad_loop(fluid_sample_t *sample)
+{
+    unsigned int loop_len, i;
+    float *loop_data;
+
+    FLUID_FREE(sample->loop_data);
+    sample->loop_data = NULL;
+
+    if(sample->data == NULL || sample->loopend < sample->loopstart + FLUID_SAMPLE_LOOP_PADDING)
+    {
+        return;
+    }
+
+    loop_len = sample->loopend - sample->loopstart;
+    loop_data = FLUID_ARRAY(float, loop_len + 2 * FLUID_SAMPLE_LOOP_PADDING);
+
+    if(loop_data == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Out of memory padding the loop of sample '%s'", sample->name);
+        return;
+    }
+
+    for(i = 0; i < loop_len + 2 * FLUID_SAMPLE_LOOP_PADDING; i++)
+    {
+        loop_data[i] = fluid_sample_get_loop_point(sample, (int)i - FLUID_SAMPLE_LOOP_PADDING);
+    }
+
+    sample->loop_data = loop_data;
+}
+
+/* Low-pass filter the sample loop and decimate it by 2, 4, 8 and 16, so that voices playing
+ * the loop several octaves above the original pitch read fewer points and alias less. Each
+ * octave is padded like the copy of fluid_sample_pad_loop(), with the points of the loop
+ * repeated, and holds a point every 2^octave frames from FLUID_SAMPLE_LOOP_PADDING of them
+ * before the loop start on. The octaves longer than the loop itself aren't made.
+ */
+void fluid_sample_decimate_loop(fluid_sample_t *sample)
+{
+    /* the number of points of each octave the windowed sinc filter reaches to either side */
+#define SAMPLE_MIPMAP_FILTER_WIDTH 8
+    unsigned int loop_len, len, i;
+    int octave, factor, width, j;
+    double *filter, sum;
+    float *mipmap;
+
+    for(octave = 0; octave < FLUID_SAMPLE_LOOP_MIPMAPS; octave++)
+    {
+        FLUID_FREE(sample->loop_mipmaps[octave]);
+        sample->loop_mipmaps[octave] = NULL;
+    }
+
+    if(sample->data == NULL || sample->loopend < sample->loopstart + FLUID_SAMPLE_LOOP_PADDING)
+    {
+        return;
+    }
+
+    loop_len = sample->loopend - sample->loopstart;
+
+    for(octave = 0; octave < FLUID_SAMPLE_LOOP_MIPMAPS && (2U << octave) <= loop_len; octave++)
+    {
+        factor = 2 << octave;
+        width = SAMPLE_MIPMAP_FILTER_WIDTH * factor;
+        len = (loop_len + factor - 1) / factor + 2 * FLUID_SAMPLE_LOOP_PADDING + 1;
+
+        filter = FLUID_ARRAY(double, 2 * width + 1);
+        mipmap = FLUID_ARRAY(float, len);
+
+        if(filter == NULL || mipmap == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Out of memory decimating the loop of sample '%s'", sample->name);
+            FLUID_FREE(filter);
+            FLUID_FREE(mipmap);
+            return;
+        }
+
+        /* cut off at the Nyquist frequency of the octave, with a Hann window and unity gain */
+        for(j = -width, sum = 0; j <= width; j++)
+        {
+            double x = M_PI * j / factor;
+            double v = (j != 0) ? sin(x) / x : 1.0;
+
+            filter[j + width] = v * 0.5 * (1.0 + cos(M_PI * j / (width + 1)));
+            sum += filter[j + width];
+        }
+
+        for(i = 0; i < len; i++)
+        {
+            int pos = ((int)i - FLUID_SAMPLE_LOOP_PADDING) * factor;
+            double v = 0;
+
+            for(j = -width; j <= width; j++)
+            {
+                v += filter[j + width] * fluid_sample_get_loop_point(sample, pos + j);
+            }
+
+            mipmap[i] = (float)(v / sum);
+        }
+
+        FLUID_FREE(filter);
+        sample->loop_mipmaps[octave] = mipmap;
+    }
+}
+
+/* Free the copies of the sample loop made by fluid_sample_pad_loop() and
+ * fluid_sample_decimate_loop(), if any */
+void fluid_sample_unpad_loop(fluid_sample_t *sample)
+{
+    int octave;
+
+    FLUID_FREE(sample->loop_data);
+    sample->loop_data = NULL;
+
+    for(octave = 0; octave < FLUID_SAMPLE_LOOP_MIPMAPS; octave++)
+    {
+        FLUID_FREE(sample->loop_mipmaps[octave]);
+        sample->loop_mipmaps[octave] = NULL;
+    }
+}
+
+/* Get the bytes taken by the copies of the sample loop made by fluid_sample_pad_loop()
+ * and fluid_sample_decimate_loop() */
+size_t fluid_sample_get_loop_size(const fluid_sample_t *sample)
+{
+    unsigned int loop_len = sample->loopend - sample->loopstart;
+    size_t size = 0;
+    int octave;
+
+    if(sample->loop_data != NULL)
+    {
+        size += (loop_len + 2 * FLUID_SAMPLE_LOOP_PADDING) * sizeof(float);
+    }
+
+    for(octave = 0; octave < FLUID_SAMPLE_LOOP_MIPMAPS; octave++)
+    {
+        if(sample->loop_mipmaps[octave] != NULL)
+        {
+            unsigned int factor = 2U << octave;
+
+            size += ((loop_len + factor - 1) / factor + 2 * FLUID_SAMPLE_LOOP_PADDING + 1) * sizeof(float);
+        }
+    }
+
+    return size;
+}
+
+/* The frames of the loop of a streamed sample copied to memory after its head,
+ * zero if there is no loop or it's part of the head */
+unsigned int fluid_sample_get_stream_loop_count(const fluid_sample_t *sample)
+{
+    if(sample->loopend <= sample->loopstart || sample->loopstart < sample->start
+            || sample->loopend > sample->end + 1 || sample->loopend <= sample->start + sample->stream_preload)
+    {
+        return 0;
+    }
+
+    return sample->loopend - sample->loopstart;
+}
+
+/* Copy the first \c count points of a sample from its start to memory, followed by its
+ * loop, so that voices can play them without touching the SoundFont file while the rest
+ * of the sample is streamed (see fluid_sample_streamer_start()). Returns FLUID_OK on
+ * success, FLUID_FAILED if out of memory, the sample isn't streamed then.
+ */
+int fluid_sample_copy_stream_data(fluid_sample_t *sample, unsigned int count)
+{
+    unsigned int loop_count;
+
+    fluid_sample_free_stream_data(sample);
+
+    if(sample->data == NULL || count == 0 || sample->end < sample->start || count > sample->end + 1 - sample->start)
+    {
+        return FLUID_FAILED;
+    }
+
+    sample->stream_preload = count;
+    loop_count = fluid_sample_get_stream_loop_count(sample);
+    sample->stream_data = FLUID_ARRAY(short, count + loop_count);
+
+    if(sample->data24 != NULL)
+    {
+        sample->stream_data24 = FLUID_ARRAY(char, count + loop_count);
+    }
+
+    if(sample->stream_data == NULL || (sample->data24 != NULL && sample->stream_data24 == NULL))
+    {
+        FLUID_LOG(FLUID_WARN, "Out of memory copying the head of sample '%s'", sample->name);
+        fluid_sample_free_stream_data(sample);
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(sample->stream_data, sample->data + sample->start, count * sizeof(short));
+    FLUID_MEMCPY(sample->stream_data + count, sample->data + sample->loopstart, loop_count * sizeof(short));
+
+    if(sample->data24 != NULL)
+    {
+        FLUID_MEMCPY(sample->stream_data24, sample->data24 + sample->start, count);
+        FLUID_MEMCPY(sample->stream_data24 + count, sample->data24 + sample->loopstart, loop_count);
+    }
+
+    return FLUID_OK;
+}
+
+/* Free the copies made by fluid_sample_copy_stream_data(), if any, the sample isn't
+ * streamed anymore */
+void fluid_sample_free_stream_data(fluid_sample_t *sample)
+{
+    FLUID_FREE(sample->stream_data);
+    FLUID_FREE(sample->stream_data24);
+    sample->stream_data = NULL;
+    sample->stream_data24 = NULL;
+    sample->stream_preload = 0;
+}
+
+/* Get the bytes taken by the copies made by fluid_sample_copy_stream_data() */
+size_t fluid_sample_get_stream_size(const fluid_sample_t *sample)
+{
+    size_t count;
+
+    if(sample->stream_data == NULL)
+    {
+        return 0;
+    }
+
+    count = sample->stream_preload + fluid_sample_get_stream_loop_count(sample);
+
+    return count * ((sample->stream_data24 != NULL) ? sizeof(short) + 1 : sizeof(short));
+}
@@ -23,9 +23,39 @@
 #define _PRIV_FLUID_SFONT_H
 
 #include "fluidsynth.h"
+#include "fluid_sys.h"
 
 int fluid_sample_validate(fluid_sample_t *sample, unsigned int max_end);
 int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
+void fluid_sample_pad_loop(fluid_sample_t *sample);
+void fluid_sample_decimate_loop(fluid_sample_t *sample);
+void fluid_sample_unpad_loop(fluid_sample_t *sample);
+size_t fluid_sample_get_loop_size(const fluid_sample_t *sample);
+int fluid_sample_copy_stream_data(fluid_sample_t *sample, unsigned int count);
+void fluid_sample_free_stream_data(fluid_sample_t *sample);
+unsigned int fluid_sample_get_stream_loop_count(const fluid_sample_t *sample);
+size_t fluid_sample_get_stream_size(const fluid_sample_t *sample);
+
+/* The number of points copied from each end of a sample loop to the other one by
+ * fluid_sample_pad_loop(), as many as the 7th order interpolation reads around a sample point */
+#define FLUID_SAMPLE_LOOP_PADDING 3
+
+/* The number of octaves a sample loop is decimated by fluid_sample_decimate_loop() */
+#define FLUID_SAMPLE_LOOP_MIPMAPS 4
+
+void *default_fopen(const char *path);
+
+/*
+ * Add the bytes taken by a SoundFont to \c bytes, indexed by #fluid_synth_memory,
+ * see fluid_synth_get_memory_stats().
+ */
+typedef void (*fluid_sfont_get_memory_t)(fluid_sfont_t *sfont, size_t *bytes);
+
+/*
+ * Add the milliseconds and the bytes of each stage of loading a SoundFont to \c msec and \c bytes,
+ * indexed by #fluid_sfont_load_stage, see fluid_synth_get_sfont_load_stats().
+ */
+typedef void (*fluid_sfont_get_load_stats_t)(fluid_sfont_t *sfont, double *msec, size_t *bytes);
 
 /*
  * Utility macros to access soundfonts, presets, and samples
@@ -48,11 +78,10 @@ int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
   { if ((_preset) && (_preset)->notify) { (*(_preset)->notify)(_preset,_reason,_chan); }}
 
 
-#define fluid_sample_incr_ref(_sample) { (_sample)->refcount++; }
+#define fluid_sample_incr_ref(_sample) { fluid_atomic_int_inc(&(_sample)->refcount); }
 
 #define fluid_sample_decr_ref(_sample) \
-  (_sample)->refcount--; \
-  if (((_sample)->refcount == 0) && ((_sample)->notify)) \
+  if (fluid_atomic_int_dec_and_test(&(_sample)->refcount) && ((_sample)->notify)) \
     (*(_sample)->notify)(_sample, FLUID_SAMPLE_DONE);
 
 
@@ -91,7 +120,7 @@ struct _fluid_sfont_t
 {
     void *data;           /**< User defined data */
     int id;               /**< SoundFont ID */
-    int refcount;         /**< SoundFont reference count (1 if no presets referencing it) */
+    fluid_atomic_int_t refcount; /**< SoundFont reference count (1 if no presets referencing it), may be shared by several synths */
     int bankofs;          /**< Bank offset */
 
     fluid_sfont_free_t free;
@@ -103,6 +132,10 @@ struct _fluid_sfont_t
     fluid_sfont_iteration_start_t iteration_start;
 
     fluid_sfont_iteration_next_t iteration_next;
+
+    fluid_sfont_get_memory_t get_memory; /**< Only set by the loaders of FluidSynth, NULL otherwise */
+
+    fluid_sfont_get_load_stats_t get_load_stats; /**< Only set by the loaders of FluidSynth, NULL otherwise */
 };
 
 /**
@@ -126,7 +159,7 @@ struct _fluid_preset_t
     /**
      * Virtual SoundFont preset notify method.
      * @param preset Virtual SoundFont preset
-     * @param reason #FLUID_PRESET_SELECTED or #FLUID_PRESET_UNSELECTED
+     * @param reason #FLUID_PRESET_SELECTED, #FLUID_PRESET_UNSELECTED, #FLUID_PRESET_PRELOAD or #FLUID_PRESET_PRELOAD_DONE
      * @param chan MIDI channel number
      * @return Should return #FLUID_OK
      *
@@ -169,12 +202,19 @@ struct _fluid_sample_t
     int auto_free;                /**< TRUE if _fluid_sample_t::data and _fluid_sample_t::data24 should be freed upon sample destruction */
     short *data;                  /**< Pointer to the sample's 16 bit PCM data */
     char *data24;                 /**< If not NULL, pointer to the least significant byte counterparts of each sample data point in order to create 24 bit audio samples */
+    float *float_data;            /**< If not NULL, the points of \a data and \a data24 converted to float on loading (see synth.sample-float), owned by the sample cache */
+    float *loop_data;             /**< If not NULL, the points of the loop as float, with the last #FLUID_SAMPLE_LOOP_PADDING in front of and the first ones after it (see synth.sample-loop-padding) */
+    float *loop_mipmaps[FLUID_SAMPLE_LOOP_MIPMAPS]; /**< If not NULL, the loop low-pass filtered and decimated by 2, 4, 8 and 16, padded like \a loop_data (see synth.sample-mipmaps) */
 
     int amplitude_that_reaches_noise_floor_is_valid;      /**< Indicates if \a amplitude_that_reaches_noise_floor is valid (TRUE), set to FALSE initially to calculate. */
     double amplitude_that_reaches_noise_floor;            /**< The amplitude at which the sample's loop will be below the noise floor.  For voice off optimization, calculated automatically. */
 
-    unsigned int refcount;        /**< Count of voices using this sample */
+    fluid_atomic_int_t refcount;  /**< Count of voices using this sample, which may belong to different synths */
     int preset_count;             /**< Count of selected presets using this sample (used for dynamic sample loading) */
+    fluid_atomic_int_t loading;   /**< Set while the sample data is loaded in the background, in which case notes skip the sample (see synth.dynamic-sample-loading-async) */
+    unsigned int stream_preload;  /**< If not zero, only this many frames from \a start are copied to \a stream_data, the rest is streamed from the SoundFont file */
+    short *stream_data;           /**< If not NULL, the \a stream_preload points from \a start followed by the loop, if outside of them, copied to memory (see synth.sample-streaming) */
+    char *stream_data24;          /**< If not NULL, the least significant bytes of \a stream_data */
 
     /**
      * Implement this function to receive notification when sample is no longer used.
@@ -56,6 +56,14 @@ new_fluid_channel(fluid_synth_t *synth, int num)
     chan->channum = num;
     chan->preset = NULL;
     chan->tuning = NULL;
+    chan->voices = NULL;
+    chan->voice_count = 0;
+    chan->voice_quota = 0;
+    FLUID_MEMSET(chan->key_voices, 0, sizeof(chan->key_voices));
+    FLUID_MEMSET(chan->excl_voices, 0, sizeof(chan->excl_voices));
+    FLUID_MEMSET(chan->pending_cc, 0, sizeof(chan->pending_cc));
+    chan->pending_ctrl = 0;
+    chan->pending_tuning = FALSE;
 
     fluid_channel_init(chan);
     fluid_channel_init_ctrl(chan, 0);
@@ -77,6 +85,8 @@ fluid_channel_init(fluid_channel_t *chan)
     /* monophonic list initialization */
     for(i = 0; i < FLUID_CHANNEL_SIZE_MONOLIST; i++)
     {
+        chan->monolist[i].note = 0;
+        chan->monolist[i].vel = 0;
         chan->monolist[i].next = i + 1;
     }
 
@@ -232,6 +242,139 @@ fluid_channel_reset(fluid_channel_t *chan)
     fluid_channel_init_ctrl(chan, 0);
 }
 
+/*
+ * Save the MIDI state of a channel, see fluid_channel_state_t.
+ */
+void
+fluid_channel_save_state(const fluid_channel_t *chan, fluid_channel_state_t *state)
+{
+    FLUID_MEMSET(state, 0, sizeof(*state));
+    state->mode = chan->mode;
+    state->mode_val = chan->mode_val;
+    state->i_first = chan->i_first;
+    state->i_last = chan->i_last;
+    state->prev_note = chan->prev_note;
+    state->n_notes = chan->n_notes;
+    FLUID_MEMCPY(state->monolist, chan->monolist, sizeof(state->monolist));
+    state->key_mono_sustained = chan->key_mono_sustained;
+    state->previous_cc_breath = chan->previous_cc_breath;
+    state->legatomode = chan->legatomode;
+    state->portamentomode = chan->portamentomode;
+    FLUID_MEMCPY(state->cc, chan->cc, sizeof(state->cc));
+    FLUID_MEMCPY(state->key_pressure, chan->key_pressure, sizeof(state->key_pressure));
+    state->channel_type = chan->channel_type;
+    state->interp_method = chan->interp_method;
+    state->channel_pressure = chan->channel_pressure;
+    state->pitch_wheel_sensitivity = chan->pitch_wheel_sensitivity;
+    state->pitch_bend = chan->pitch_bend;
+    state->sostenuto_orderid = chan->sostenuto_orderid;
+    state->tuning_bank = chan->tuning_bank;
+    state->tuning_prog = chan->tuning_prog;
+    state->sfont_bank_prog = chan->sfont_bank_prog;
+    state->nrpn_select = chan->nrpn_select;
+    state->nrpn_active = chan->nrpn_active;
+    FLUID_MEMCPY(state->gen, chan->gen, sizeof(state->gen));
+}
+
+/* A note of a saved channel state, or INVALID_NOTE if allowed */
+static int
+fluid_channel_is_state_note(int note, int allow_invalid)
+{
+    return (note >= 0 && note <= 127) || (allow_invalid && note == INVALID_NOTE);
+}
+
+/*
+ * Check that the fields of a saved channel state used as indices or counts are
+ * in range for this channel.
+ */
+int
+fluid_channel_check_state(const fluid_channel_t *chan, const fluid_channel_state_t *state)
+{
+    int i;
+
+    if(state->mode < 0 || state->mode > 0xFF
+            || state->mode_val < 0 || state->mode_val > chan->synth->midi_channels - chan->channum
+            || state->i_first >= FLUID_CHANNEL_SIZE_MONOLIST || state->i_last >= FLUID_CHANNEL_SIZE_MONOLIST
+            || state->n_notes > FLUID_CHANNEL_SIZE_MONOLIST
+            || !fluid_channel_is_state_note(state->prev_note, TRUE)
+            || !fluid_channel_is_state_note(state->key_mono_sustained, TRUE)
+            || state->legatomode < 0 || state->legatomode >= FLUID_CHANNEL_LEGATO_MODE_LAST
+            || state->portamentomode < 0 || state->portamentomode >= FLUID_CHANNEL_PORTAMENTO_MODE_LAST
+            || (state->channel_type != CHANNEL_TYPE_MELODIC && state->channel_type != CHANNEL_TYPE_DRUM)
+            || (state->interp_method != FLUID_INTERP_NONE && state->interp_method != FLUID_INTERP_LINEAR
+                && state->interp_method != FLUID_INTERP_4THORDER && state->interp_method != FLUID_INTERP_7THORDER)
+            || state->channel_pressure > 127
+            || state->pitch_bend < 0 || state->pitch_bend > 0x3FFF
+            || state->tuning_bank < 0 || state->tuning_bank > 127
+            || state->tuning_prog < 0 || state->tuning_prog > 127
+            || state->nrpn_select < 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < FLUID_CHANNEL_SIZE_MONOLIST; i++)
+    {
+        if(state->monolist[i].next >= FLUID_CHANNEL_SIZE_MONOLIST
+                || !fluid_channel_is_state_note(state->monolist[i].note, FALSE)
+                || state->monolist[i].vel > 127)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    for(i = 0; i < 128; i++)
+    {
+        if(!fluid_channel_is_state_note(state->cc[i], i == PORTAMENTO_CTRL) || state->key_pressure[i] > 127)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Restore the MIDI state of a channel saved by fluid_channel_save_state(),
+ * leaving its preset and its tuning alone. Should only be called from synthesis context.
+ * Returns FLUID_FAILED, leaving the channel alone, if the state is out of range.
+ */
+int
+fluid_channel_load_state(fluid_channel_t *chan, const fluid_channel_state_t *state)
+{
+    if(fluid_channel_check_state(chan, state) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    chan->mode = state->mode;
+    chan->mode_val = state->mode_val;
+    chan->i_first = state->i_first;
+    chan->i_last = state->i_last;
+    chan->prev_note = state->prev_note;
+    chan->n_notes = state->n_notes;
+    FLUID_MEMCPY(chan->monolist, state->monolist, sizeof(chan->monolist));
+    chan->key_mono_sustained = state->key_mono_sustained;
+    chan->previous_cc_breath = state->previous_cc_breath;
+    chan->legatomode = (enum fluid_channel_legato_mode)state->legatomode;
+    chan->portamentomode = (enum fluid_channel_portamento_mode)state->portamentomode;
+    FLUID_MEMCPY(chan->cc, state->cc, sizeof(chan->cc));
+    FLUID_MEMCPY(chan->key_pressure, state->key_pressure, sizeof(chan->key_pressure));
+    chan->channel_type = (enum fluid_midi_channel_type)state->channel_type;
+    chan->interp_method = (enum fluid_interp)state->interp_method;
+    chan->channel_pressure = state->channel_pressure;
+    chan->pitch_wheel_sensitivity = state->pitch_wheel_sensitivity;
+    chan->pitch_bend = state->pitch_bend;
+    chan->sostenuto_orderid = state->sostenuto_orderid;
+    chan->tuning_bank = state->tuning_bank;
+    chan->tuning_prog = state->tuning_prog;
+    chan->sfont_bank_prog = state->sfont_bank_prog;
+    chan->nrpn_select = (enum fluid_gen_type)state->nrpn_select;
+    chan->nrpn_active = state->nrpn_active;
+    FLUID_MEMCPY(chan->gen, state->gen, sizeof(chan->gen));
+
+    return FLUID_OK;
+}
+
 /* Should only be called from synthesis context */
 int
 fluid_channel_set_preset(fluid_channel_t *chan, fluid_preset_t *preset)
@@ -246,7 +389,7 @@ fluid_channel_set_preset(fluid_channel_t *chan, fluid_preset_t *preset)
     if(chan->preset)
     {
         sfont = chan->preset->sfont;
-        sfont->refcount--;
+        fluid_atomic_int_add(&sfont->refcount, -1);
     }
 
     fluid_preset_notify(chan->preset, FLUID_PRESET_UNSELECTED, chan->channum);
@@ -256,7 +399,7 @@ fluid_channel_set_preset(fluid_channel_t *chan, fluid_preset_t *preset)
     if(preset)
     {
         sfont = preset->sfont;
-        sfont->refcount++;
+        fluid_atomic_int_inc(&sfont->refcount);
     }
 
     fluid_preset_notify(preset, FLUID_PRESET_SELECTED, chan->channum);
@@ -129,12 +129,72 @@ struct _fluid_channel_t
      * applied to future notes. They are copied to a voice's generators
      * in fluid_voice_init(), which calls fluid_gen_init().  */
     fluid_real_t gen[GEN_LAST];
+
+    /* The voices playing on this channel, linked through their chan_next, and those of
+     * each key, linked through their key_next. Maintained by fluid_voice_init() and
+     * fluid_voice_stop(), so that channel messages only visit the voices they affect.
+     * The voices started with an exclusive class are also linked through their excl_next,
+     * by the class modulo 128, until they are killed for it. */
+    fluid_voice_t *voices;
+    fluid_voice_t *key_voices[128];
+    fluid_voice_t *excl_voices[128];
+    int voice_count;                      /**< Number of the voices playing on this channel */
+
+    /* The number of voices reserved to the channel if the polyphony is exhausted,
+     * 0 if none, see fluid_synth_set_voice_quota(). Kept by fluid_channel_reset(). */
+    int voice_quota;
+
+    /* The controllers changed since the last block rendered, whose voices are yet
+     * to be modulated if synth.coalesce-controllers is enabled: a bit for each CC,
+     * and for each general controller (FLUID_MOD_PITCHWHEEL, ...). */
+    uint32_t pending_cc[4];
+    uint32_t pending_ctrl;
+
+    /* TRUE if the tuning of the channel has changed in realtime since the last block,
+     * and its voices are yet to be retuned, if synth.coalesce-controllers is enabled. */
+    int pending_tuning;
 };
 
+/*
+ * The part of a channel saved by fluid_synth_save_state(): all of its MIDI state but
+ * its preset and its tuning, which are looked up again by the synth restoring it.
+ */
+typedef struct
+{
+    int mode;
+    int mode_val;
+    unsigned char i_first;
+    unsigned char i_last;
+    unsigned char prev_note;
+    unsigned char n_notes;
+    struct mononote monolist[FLUID_CHANNEL_SIZE_MONOLIST];
+    unsigned char key_mono_sustained;
+    unsigned char previous_cc_breath;
+    int legatomode;
+    int portamentomode;
+    unsigned char cc[128];
+    unsigned char key_pressure[128];
+    int channel_type;
+    int interp_method;
+    unsigned char channel_pressure;
+    unsigned char pitch_wheel_sensitivity;
+    short pitch_bend;
+    unsigned int sostenuto_orderid;
+    int tuning_bank;
+    int tuning_prog;
+    int sfont_bank_prog;
+    int nrpn_select;
+    char nrpn_active;
+    fluid_real_t gen[GEN_LAST];
+} fluid_channel_state_t;
+
 fluid_channel_t *new_fluid_channel(fluid_synth_t *synth, int num);
 void fluid_channel_init_ctrl(fluid_channel_t *chan, int is_all_ctrl_off);
 void delete_fluid_channel(fluid_channel_t *chan);
 void fluid_channel_reset(fluid_channel_t *chan);
+void fluid_channel_save_state(const fluid_channel_t *chan, fluid_channel_state_t *state);
+int fluid_channel_check_state(const fluid_channel_t *chan, const fluid_channel_state_t *state);
+int fluid_channel_load_state(fluid_channel_t *chan, const fluid_channel_state_t *state);
 int fluid_channel_set_preset(fluid_channel_t *chan, fluid_preset_t *preset);
 void fluid_channel_set_sfont_bank_prog(fluid_channel_t *chan, int sfont,
                                        int bank, int prog);
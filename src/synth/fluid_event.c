@@ -741,8 +741,6 @@ fluid_event_get_sfont_id(fluid_event_t *evt)
 fluid_evt_heap_t *
 _fluid_evt_heap_init(int nbEvents)
 {
-#ifdef HEAP_WITH_DYNALLOC
-
     int i;
     fluid_evt_heap_t *heap;
     fluid_evt_entry *tmp;
@@ -756,6 +754,9 @@ _fluid_evt_heap_init(int nbEvents)
     }
 
     heap->freelist = NULL;
+    heap->capacity = 0;
+    heap->in_use = 0;
+    heap->max_in_use = 0;
     fluid_mutex_init(heap->mutex);
 
     /* LOCK */
@@ -765,52 +766,27 @@ _fluid_evt_heap_init(int nbEvents)
     for(i = 0; i < nbEvents; i++)
     {
         tmp = FLUID_NEW(fluid_evt_entry);
+
+        if(tmp == NULL)
+        {
+            /* more entries will be allocated when needed */
+            break;
+        }
+
         tmp->next = heap->freelist;
         heap->freelist = tmp;
+        heap->capacity++;
     }
 
     /* UNLOCK */
     fluid_mutex_unlock(heap->mutex);
 
-
-#else
-    int i;
-    fluid_evt_heap_t *heap;
-    int siz = 2 * sizeof(fluid_evt_entry *) + sizeof(fluid_evt_entry) * nbEvents;
-
-    heap = (fluid_evt_heap_t *)FLUID_MALLOC(siz);
-
-    if(heap == NULL)
-    {
-        FLUID_LOG(FLUID_PANIC, "sequencer: Out of memory\n");
-        return NULL;
-    }
-
-    FLUID_MEMSET(heap, 0, siz);
-
-    /* link all heap events */
-    {
-        fluid_evt_entry *tmp = &(heap->pool);
-
-        for(i = 0 ; i < nbEvents - 1 ; i++)
-        {
-            tmp[i].next = &(tmp[i + 1]);
-        }
-
-        tmp[nbEvents - 1].next = NULL;
-
-        /* set head & tail */
-        heap->tail = &(tmp[nbEvents - 1]);
-        heap->head = &(heap->pool);
-    }
-#endif
     return (heap);
 }
 
 void
 _fluid_evt_heap_free(fluid_evt_heap_t *heap)
 {
-#ifdef HEAP_WITH_DYNALLOC
     fluid_evt_entry *tmp, *next;
 
     /* LOCK */
@@ -830,16 +806,11 @@ _fluid_evt_heap_free(fluid_evt_heap_t *heap)
     fluid_mutex_destroy(heap->mutex);
 
     FLUID_FREE(heap);
-
-#else
-    FLUID_FREE(heap);
-#endif
 }
 
 fluid_evt_entry *
 _fluid_seq_heap_get_free(fluid_evt_heap_t *heap)
 {
-#ifdef HEAP_WITH_DYNALLOC
     fluid_evt_entry *evt = NULL;
 
     /* LOCK */
@@ -854,6 +825,7 @@ _fluid_seq_heap_get_free(fluid_evt_heap_t *heap)
         if(heap->freelist != NULL)
         {
             heap->freelist->next = NULL;
+            heap->capacity++;
         }
     }
 
@@ -865,49 +837,129 @@ _fluid_seq_heap_get_free(fluid_evt_heap_t *heap)
     {
         heap->freelist = heap->freelist->next;
         evt->next = NULL;
+
+        if(++heap->in_use > heap->max_in_use)
+        {
+            heap->max_in_use = heap->in_use;
+        }
     }
 
     /* UNLOCK */
     fluid_mutex_unlock(heap->mutex);
 
     return evt;
+}
+
+/* Take count entries from the heap at once, linked by their next pointers.
+ * Returns NULL if not all of them could be allocated, taking none. */
+fluid_evt_entry *
+_fluid_seq_heap_get_free_list(fluid_evt_heap_t *heap, int count)
+{
+    fluid_evt_entry *first, *evt, *last = NULL;
+    int i;
+
+    fluid_return_val_if_fail(count > 0, NULL);
+
+    /* LOCK */
+    fluid_mutex_lock(heap->mutex);
+
+    first = heap->freelist;
+
+    for(i = 0, evt = first; i < count; i++, last = evt, evt = evt->next)
+    {
+#if !defined(MACOS9)
+
+        if(evt == NULL)
+        {
+            /* grow the list at its end */
+            evt = FLUID_NEW(fluid_evt_entry);
+
+            if(evt == NULL)
+            {
+                break;
+            }
+
+            evt->next = NULL;
+            heap->capacity++;
+
+            if(last != NULL)
+            {
+                last->next = evt;
+            }
+            else
+            {
+                heap->freelist = first = evt;
+            }
+        }
 
 #else
-    fluid_evt_entry *evt;
 
-    if(heap->head == NULL)
+        if(evt == NULL)
+        {
+            break;
+        }
+
+#endif
+    }
+
+    if(i < count)
     {
+        /* UNLOCK */
+        fluid_mutex_unlock(heap->mutex);
         return NULL;
     }
 
-    /* take from head of the heap */
-    /* critical - should threadlock ? */
-    evt = heap->head;
-    heap->head = heap->head->next;
+    heap->freelist = last->next;
+    last->next = NULL;
 
-    return evt;
-#endif
+    heap->in_use += count;
+
+    if(heap->in_use > heap->max_in_use)
+    {
+        heap->max_in_use = heap->in_use;
+    }
+
+    /* UNLOCK */
+    fluid_mutex_unlock(heap->mutex);
+
+    return first;
 }
 
 void
 _fluid_seq_heap_set_free(fluid_evt_heap_t *heap, fluid_evt_entry *evt)
 {
-#ifdef HEAP_WITH_DYNALLOC
-
     /* LOCK */
     fluid_mutex_lock(heap->mutex);
 
     evt->next = heap->freelist;
     heap->freelist = evt;
+    heap->in_use--;
 
     /* UNLOCK */
     fluid_mutex_unlock(heap->mutex);
+}
 
-#else
-    /* append to the end of the heap */
-    /* critical - should threadlock ? */
-    heap->tail->next = evt;
-    heap->tail = evt;
-    evt->next = NULL;
-#endif
+void
+_fluid_evt_heap_get_stats(fluid_evt_heap_t *heap, int *capacity, int *in_use, int *max_in_use)
+{
+    /* LOCK */
+    fluid_mutex_lock(heap->mutex);
+
+    if(capacity != NULL)
+    {
+        *capacity = heap->capacity;
+    }
+
+    if(in_use != NULL)
+    {
+        *in_use = heap->in_use;
+    }
+
+    if(max_in_use != NULL)
+    {
+        *max_in_use = heap->max_in_use;
+    }
+
+    /* UNLOCK */
+    fluid_mutex_unlock(heap->mutex);
 }
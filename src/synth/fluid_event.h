@@ -61,27 +61,25 @@ struct _fluid_evt_entry
 {
     fluid_evt_entry *next;
     short entryType;
+    double scale;           /* time scale of the sequencer when the event was sent */
     fluid_event_t evt;
 };
 
-#define HEAP_WITH_DYNALLOC 1
-/* #undef HEAP_WITH_DYNALLOC */
-
+/* Pool of event entries, growing on demand */
 typedef struct _fluid_evt_heap_t
 {
-#ifdef HEAP_WITH_DYNALLOC
     fluid_evt_entry *freelist;
     fluid_mutex_t mutex;
-#else
-    fluid_evt_entry *head;
-    fluid_evt_entry *tail;
-    fluid_evt_entry pool;
-#endif
+    int capacity;           /* number of entries allocated */
+    int in_use;             /* number of entries taken from the freelist */
+    int max_in_use;         /* largest value of in_use so far */
 } fluid_evt_heap_t;
 
 fluid_evt_heap_t *_fluid_evt_heap_init(int nbEvents);
 void _fluid_evt_heap_free(fluid_evt_heap_t *heap);
 fluid_evt_entry *_fluid_seq_heap_get_free(fluid_evt_heap_t *heap);
+fluid_evt_entry *_fluid_seq_heap_get_free_list(fluid_evt_heap_t *heap, int count);
 void _fluid_seq_heap_set_free(fluid_evt_heap_t *heap, fluid_evt_entry *evt);
+void _fluid_evt_heap_get_stats(fluid_evt_heap_t *heap, int *capacity, int *in_use, int *max_in_use);
 
 #endif /* _FLUID_EVENT_PRIV_H */
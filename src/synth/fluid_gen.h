@@ -36,13 +36,15 @@ typedef struct _fluid_gen_info_t
 
 /*
  * SoundFont generator structure.
+ * Every voice and every zone holds GEN_LAST of them: single precision,
+ * with the flags last, keeps them at 16 bytes each.
  */
 typedef struct _fluid_gen_t
 {
+    float val;           /**< The nominal value */
+    float mod;           /**< Change by modulators */
+    float nrpn;          /**< Change by NRPN messages */
     unsigned char flags; /**< Is the generator set or not (#fluid_gen_flags) */
-    double val;          /**< The nominal value */
-    double mod;          /**< Change by modulators */
-    double nrpn;         /**< Change by NRPN messages */
 } fluid_gen_t;
 
 /*
@@ -54,8 +56,8 @@ enum fluid_gen_flags
     GEN_SET,		/**< Generator value is set */
 };
 
-#define fluid_gen_set_mod(_gen, _val)  { (_gen)->mod = (double) (_val); }
-#define fluid_gen_set_nrpn(_gen, _val) { (_gen)->nrpn = (double) (_val); }
+#define fluid_gen_set_mod(_gen, _val)  { (_gen)->mod = (float) (_val); }
+#define fluid_gen_set_nrpn(_gen, _val) { (_gen)->nrpn = (float) (_val); }
 
 fluid_real_t fluid_gen_scale(int gen, float value);
 fluid_real_t fluid_gen_scale_nrpn(int gen, int nrpn);
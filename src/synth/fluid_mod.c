@@ -22,6 +22,12 @@
 #include "fluid_chan.h"
 #include "fluid_voice.h"
 
+/* The 16 SoundFont mapping functions, followed by the 4 of FLUID_MOD_SIN */
+#define FLUID_MOD_MAPPINGS 20
+
+/* The transformed values of all 7 bit source values, by mapping function */
+static fluid_real_t fluid_mod_transform_tab[FLUID_MOD_MAPPINGS][128];
+
 /**
  * Clone the modulators destination, sources, flags and amount.
  * @param mod the modulator to store the copy to
@@ -360,6 +366,77 @@ fluid_mod_transform_source_value(fluid_real_t val, unsigned char mod_flags, cons
     return val;
 }
 
+/*
+ * returns the index of the mapping function of the source flags into fluid_mod_transform_tab,
+ * or -1 if they don't specify a known one
+ */
+static FLUID_INLINE int
+fluid_mod_get_mapping(unsigned char mod_flags)
+{
+    mod_flags &= ~FLUID_MOD_CC;
+
+    if(mod_flags < 16)
+    {
+        return mod_flags;
+    }
+
+    if((mod_flags & ~(FLUID_MOD_SIN | FLUID_MOD_BIPOLAR | FLUID_MOD_NEGATIVE)) == 0)
+    {
+        return 16 + (mod_flags & (FLUID_MOD_BIPOLAR | FLUID_MOD_NEGATIVE));
+    }
+
+    return -1;
+}
+
+/*
+ * fills the tables of the transformed 7 bit source values, once for all synths
+ */
+void
+fluid_mod_config(void)
+{
+    static const unsigned char sin_flags[] =
+    {
+        FLUID_MOD_SIN | FLUID_MOD_UNIPOLAR | FLUID_MOD_POSITIVE,
+        FLUID_MOD_SIN | FLUID_MOD_UNIPOLAR | FLUID_MOD_NEGATIVE,
+        FLUID_MOD_SIN | FLUID_MOD_BIPOLAR | FLUID_MOD_POSITIVE,
+        FLUID_MOD_SIN | FLUID_MOD_BIPOLAR | FLUID_MOD_NEGATIVE
+    };
+    int i, val;
+
+    for(i = 0; i < FLUID_MOD_MAPPINGS; i++)
+    {
+        unsigned char flags = (i < 16) ? i : sin_flags[i - 16];
+
+        for(val = 0; val < 128; val++)
+        {
+            fluid_mod_transform_tab[i][val] = fluid_mod_transform_source_value(val, flags, 127);
+        }
+    }
+}
+
+/*
+ * retrieves the value of a source of the modulator transformed into [0.0;1.0], looked up in
+ * fluid_mod_transform_tab for the sources of 7 bits
+ */
+static FLUID_INLINE fluid_real_t
+fluid_mod_get_mapped_value(const unsigned char mod_src,
+                           const unsigned char mod_flags,
+                           const fluid_voice_t *voice)
+{
+    fluid_real_t range = 127.0;
+    fluid_real_t val = fluid_mod_get_source_value(mod_src, mod_flags, &range, voice);
+    int mapping = fluid_mod_get_mapping(mod_flags);
+
+    /* the pitch wheel, pan and balance have ranges of their own, while the pitch wheel
+     * sensitivity and the key and velocity set by generators may exceed 7 bits */
+    if(mapping >= 0 && range == 127 && val >= 0 && val <= 127)
+    {
+        return fluid_mod_transform_tab[mapping][(int)val];
+    }
+
+    return fluid_mod_transform_source_value(val, mod_flags, range);
+}
+
 /*
  * fluid_mod_get_value.
  * Computes and return modulator output following SF2.01
@@ -384,7 +461,6 @@ fluid_mod_get_value(fluid_mod_t *mod, fluid_voice_t *voice)
     extern fluid_mod_t default_vel2filter_mod;
 
     fluid_real_t v1 = 0.0, v2 = 1.0;
-    fluid_real_t range1 = 127.0, range2 = 127.0;
 
     /* 'special treatment' for default controller
      *
@@ -425,10 +501,7 @@ fluid_mod_get_value(fluid_mod_t *mod, fluid_voice_t *voice)
     /* get the initial value of the first source */
     if(mod->src1 > 0)
     {
-        v1 = fluid_mod_get_source_value(mod->src1, mod->flags1, &range1, voice);
-
-        /* transform the input value */
-        v1 = fluid_mod_transform_source_value(v1, mod->flags1, range1);
+        v1 = fluid_mod_get_mapped_value(mod->src1, mod->flags1, voice);
     }
     /* When primary source input (src1) is set to General Controller 'No Controller',
        output is forced to 0.0
@@ -447,10 +520,7 @@ fluid_mod_get_value(fluid_mod_t *mod, fluid_voice_t *voice)
     /* get the second input source */
     if(mod->src2 > 0)
     {
-        v2 = fluid_mod_get_source_value(mod->src2, mod->flags2, &range2, voice);
-
-        /* transform the second input value */
-        v2 = fluid_mod_transform_source_value(v2, mod->flags2, range2);
+        v2 = fluid_mod_get_mapped_value(mod->src2, mod->flags2, voice);
     }
     /* When secondary source input (src2) is set to General Controller 'No Controller',
        output is forced to +1.0
@@ -43,6 +43,7 @@ struct _fluid_mod_t
     fluid_mod_t *next;
 };
 
+void fluid_mod_config(void);
 fluid_real_t fluid_mod_get_value(fluid_mod_t *mod, fluid_voice_t *voice);
 int fluid_mod_check_sources(const fluid_mod_t *mod, char *name);
 
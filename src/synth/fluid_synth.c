@@ -20,12 +20,19 @@
 
 #include "fluid_synth.h"
 #include "fluid_sys.h"
+#include "fluid_trace.h"
 #include "fluid_chan.h"
 #include "fluid_tuning.h"
 #include "fluid_settings.h"
 #include "fluid_sfont.h"
 #include "fluid_defsfont.h"
+#include "fluid_samplecache.h"
 #include "fluid_instpatch.h"
+#include "fluid_adriver.h"
+
+#if LIBSNDFILE_SUPPORT
+#include <sndfile.h>
+#endif
 
 #ifdef TRAP_ON_FPE
 #define _GNU_SOURCE
@@ -54,9 +61,58 @@ extern int feenableexcept(int excepts);
     FLUID_API_RETURN(fail_value); \
   } \
 
+/* Number of events the lock-free API queue can hold before falling back to the mutex */
+#define FLUID_API_QUEUE_SIZE 4096
+
+/* Number of tunings preallocated, further ones are allocated from the heap */
+#define FLUID_TUNING_POOL_SIZE 32
+
+/* largest numerator of the ratio of synth.sample-rate to synth.internal-rate */
+#define FLUID_SYNTH_MAX_UPSAMPLING 64
+
+/* the gains of the delay-locked loop following the rendering in time, see fluid_synth_update_clock() */
+#define FLUID_CLOCK_W1 (1.0 / 64)
+#define FLUID_CLOCK_W2 (FLUID_CLOCK_W1 * FLUID_CLOCK_W1 / 2)
+/* errors and drifts beyond which the clock starts over */
+#define FLUID_CLOCK_RESYNC_USEC 200000.0
+#define FLUID_CLOCK_MAX_DRIFT 0.01
+/* frames from the block about to be rendered beyond which fluid_synth_utime_to_offset() saturates */
+#define FLUID_CLOCK_MAX_OFFSET 0x40000000
+
+typedef struct
+{
+    int type;
+    int chan;
+    int param1;
+    int param2;
+} fluid_synth_api_event_t;
+
+/* A voice started or stopped, see fluid_synth_pop_voice_activity() */
+typedef struct
+{
+    int type;
+    int chan;
+    int key;
+    unsigned int id;
+    int active_voices;
+} fluid_voice_activity_t;
+
 static void fluid_synth_init(void);
-static void fluid_synth_api_enter(fluid_synth_t *synth);
-static void fluid_synth_api_exit(fluid_synth_t *synth);
+static int fluid_synth_queue_api_event(fluid_synth_t *synth, int type, int chan,
+                                       int param1, int param2);
+static void fluid_synth_process_api_queue(fluid_synth_t *synth);
+static void fluid_synth_join_sfload_jobs(fluid_synth_t *synth, int all);
+static void fluid_synth_free_replaced_rates(fluid_synth_t *synth, int all);
+static int fluid_synth_change_fx_units(fluid_synth_t *synth, fluid_real_t sample_rate, int reverb, int chorus);
+static void fluid_synth_set_fx_send_LOCAL(fluid_synth_t *synth, int fx_group, int channel, double send);
+static void fluid_synth_update_fx_units(fluid_synth_t *synth);
+static void fluid_synth_free_replaced_irs(fluid_synth_t *synth, int all);
+
+static int fluid_synth_process_noteon(fluid_synth_t *synth, int chan, int key, int vel);
+static int fluid_synth_process_noteoff(fluid_synth_t *synth, int chan, int key);
+static int fluid_synth_process_cc(fluid_synth_t *synth, int chan, int num, int val);
+static int fluid_synth_process_pitch_bend(fluid_synth_t *synth, int chan, int val);
+static int fluid_synth_process_program_change(fluid_synth_t *synth, int chan, int prognum);
 
 static int fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key,
                                     int vel);
@@ -84,18 +140,33 @@ fluid_synth_get_preset(fluid_synth_t *synth, int sfontnum,
 static fluid_preset_t *
 fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname,
                                      int banknum, int prognum);
+static int fluid_synth_preset_index_key(int banknum, int prognum, void **key);
+static void fluid_synth_preset_index_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
+static void fluid_synth_preset_index_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
 
 static void fluid_synth_update_presets(fluid_synth_t *synth);
 static void fluid_synth_update_gain_LOCAL(fluid_synth_t *synth);
 static int fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony);
+static int fluid_synth_alloc_voices_LOCAL(fluid_synth_t *synth, int from, int to);
+static void fluid_synth_start_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice);
 static void init_dither(void);
-static FLUID_INLINE int16_t round_clip_to_i16(float x);
 static int fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount);
-
-static fluid_voice_t *fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth);
+static int fluid_synth_render_internal_blocks(fluid_synth_t *synth, int blockcount);
+static void fluid_synth_update_render_stats(fluid_synth_t *synth, double time, int len);
+static void fluid_synth_update_voice_limit(fluid_synth_t *synth, float load);
+static void fluid_synth_update_pending_controllers(fluid_synth_t *synth);
+
+static fluid_voice_t *fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth, int chan);
+static void fluid_synth_kill_voices_LOCAL(fluid_synth_t *synth, int limit);
+static void fluid_synth_degrade_interp_LOCAL(fluid_synth_t *synth, int degrade);
+static void fluid_synth_rebuild_overflow_heap_LOCAL(fluid_synth_t *synth);
 static void fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
         fluid_voice_t *new_voice);
 static int fluid_synth_sfunload_callback(void *data, unsigned int msec);
+static int fluid_synth_reclaim_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
+static void fluid_synth_wake_sfont_reclaimer(fluid_synth_t *synth);
+static fluid_thread_return_t fluid_synth_sfont_reclaimer_run(void *data);
+static void delete_fluid_sfont_reclaimer(fluid_sfont_reclaimer_t *reclaimer);
 static fluid_tuning_t *fluid_synth_get_tuning(fluid_synth_t *synth,
         int bank, int prog);
 static int fluid_synth_replace_tuning_LOCK(fluid_synth_t *synth,
@@ -105,6 +176,7 @@ static void fluid_synth_replace_tuning_LOCAL(fluid_synth_t *synth,
         fluid_tuning_t *old_tuning,
         fluid_tuning_t *new_tuning,
         int apply, int unref_new);
+static void fluid_synth_retune_voices_LOCAL(fluid_channel_t *channel);
 static void fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth,
         fluid_channel_t *channel);
 static int fluid_synth_set_tuning_LOCAL(fluid_synth_t *synth, int chan,
@@ -115,6 +187,7 @@ static void fluid_synth_stop_LOCAL(fluid_synth_t *synth, unsigned int id);
 
 
 static int fluid_synth_set_important_channels(fluid_synth_t *synth, const char *channels);
+static int fluid_synth_set_cpu_affinity(fluid_synth_t *synth, const char *cores);
 
 
 /* Callback handlers for real-time settings */
@@ -122,6 +195,12 @@ static void fluid_synth_handle_gain(void *data, const char *name, double value);
 static void fluid_synth_handle_polyphony(void *data, const char *name, int value);
 static void fluid_synth_handle_device_id(void *data, const char *name, int value);
 static void fluid_synth_handle_overflow(void *data, const char *name, double value);
+static void fluid_synth_handle_dynamic_polyphony(void *data, const char *name, int value);
+static void fluid_synth_handle_dynamic_polyphony_load(void *data, const char *name, double value);
+static void fluid_synth_handle_interp_qos(void *data, const char *name, int value);
+static void fluid_synth_handle_interp_qos_num(void *data, const char *name, double value);
+static void fluid_synth_handle_dsp_precision(void *data, const char *name, const char *value);
+static void fluid_synth_handle_coalesce_controllers(void *data, const char *name, int value);
 static void fluid_synth_handle_important_channels(void *data, const char *name,
         const char *value);
 static void fluid_synth_handle_reverb_chorus_num(void *data, const char *name, double value);
@@ -187,12 +266,16 @@ static const fluid_revmodel_presets_t revmodel_preset[] =
 void fluid_synth_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_int(settings, "synth.verbose", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.voice-activity-queue", 0, 0, 65536, 0);
+    fluid_settings_register_int(settings, "synth.voice-snapshot", 0, 0, 1, FLUID_HINT_TOGGLED);
 
     fluid_settings_register_int(settings, "synth.reverb.active", 1, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_num(settings, "synth.reverb.room-size", FLUID_REVERB_DEFAULT_ROOMSIZE, 0.0f, 1.0f, 0);
     fluid_settings_register_num(settings, "synth.reverb.damp", FLUID_REVERB_DEFAULT_DAMP, 0.0f, 1.0f, 0);
     fluid_settings_register_num(settings, "synth.reverb.width", FLUID_REVERB_DEFAULT_WIDTH, 0.0f, 100.0f, 0);
     fluid_settings_register_num(settings, "synth.reverb.level", FLUID_REVERB_DEFAULT_LEVEL, 0.0f, 1.0f, 0);
+    fluid_settings_register_int(settings, "synth.reverb.ir-tail-size", 1024, 0, 65536, 0);
+    fluid_settings_register_int(settings, "synth.reverb.decimation", 1, 1, 4, 0);
 
     fluid_settings_register_int(settings, "synth.chorus.active", 1, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.chorus.nr", FLUID_CHORUS_DEFAULT_N, 0, 99, 0);
@@ -201,7 +284,19 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_num(settings, "synth.chorus.depth", FLUID_CHORUS_DEFAULT_DEPTH, 0.0f, 256.0f, 0);
 
     fluid_settings_register_int(settings, "synth.ladspa.active", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.level-meters", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.lock-memory", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.huge-pages", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-mmap", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-float", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-loop-padding", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-mipmaps", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-cache-size", 0, 0, 65535, 0);
+    fluid_settings_register_str(settings, "synth.sample-cache-dir", "", 0);
+    fluid_settings_register_int(settings, "synth.sample-shm", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming-preload", 32768, 64, 8388608, 0);
+    fluid_settings_register_int(settings, "synth.load-threads", 1, 1, 256, 0);
     fluid_settings_register_str(settings, "midi.portname", "", 0);
 
 #ifdef DEFAULT_SOUNDFONT
@@ -209,23 +304,43 @@ void fluid_synth_settings(fluid_settings_t *settings)
 #endif
 
     fluid_settings_register_int(settings, "synth.polyphony", 256, 1, 65535, 0);
+    fluid_settings_register_int(settings, "synth.polyphony-max", 0, 0, 65535, 0);
     fluid_settings_register_int(settings, "synth.midi-channels", 16, 16, 256, 0);
     fluid_settings_register_num(settings, "synth.gain", 0.2f, 0.0f, 10.0f, 0);
     fluid_settings_register_int(settings, "synth.audio-channels", 1, 1, 128, 0);
     fluid_settings_register_int(settings, "synth.audio-groups", 1, 1, 128, 0);
     fluid_settings_register_int(settings, "synth.effects-channels", 2, 2, 2, 0);
     fluid_settings_register_int(settings, "synth.effects-groups", 1, 1, 128, 0);
+    fluid_settings_register_int(settings, "synth.effects-release-time", 10000, 0, 3600000, 0);
+    fluid_settings_register_int(settings, "synth.effects-shared", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_num(settings, "synth.sample-rate", 44100.0f, 8000.0f, 96000.0f, 0);
+    fluid_settings_register_num(settings, "synth.internal-rate", 0.0f, 0.0f, 96000.0f, 0);
     fluid_settings_register_int(settings, "synth.device-id", 0, 0, 126, 0);
 #ifdef ENABLE_MIXER_THREADS
     fluid_settings_register_int(settings, "synth.cpu-cores", 1, 1, 256, 0);
 #else
     fluid_settings_register_int(settings, "synth.cpu-cores", 1, 1, 1, 0);
 #endif
+    fluid_settings_register_str(settings, "synth.cpu-cores-scheduler", "shared", 0);
+    fluid_settings_add_option(settings, "synth.cpu-cores-scheduler", "shared");
+    fluid_settings_add_option(settings, "synth.cpu-cores-scheduler", "work-stealing");
+    fluid_settings_add_option(settings, "synth.cpu-cores-scheduler", "deterministic");
+    fluid_settings_register_str(settings, "synth.cpu-affinity", "", 0);
+    fluid_settings_register_int(settings, "synth.cpu-cores-spin-time", 0, 0, 10000, 0);
+    fluid_settings_register_int(settings, "synth.voice-prefetch", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.voice-fused-mixing", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.note-cache-size", 0, 0, 1024, 0);
+#ifdef ENABLE_MIXER_THREADS
+    fluid_settings_register_int(settings, "synth.render-pool", 0, 0, 256, 0);
+#else
+    fluid_settings_register_int(settings, "synth.render-pool", 0, 0, 0, 0);
+#endif
+    fluid_settings_register_int(settings, "synth.flush-denormals", 0, 0, 1, FLUID_HINT_TOGGLED);
 
     fluid_settings_register_int(settings, "synth.min-note-length", 10, 0, 65535, 0);
 
     fluid_settings_register_int(settings, "synth.threadsafe-api", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.lock-free-api", 0, 0, 1, FLUID_HINT_TOGGLED);
 
     fluid_settings_register_num(settings, "synth.overflow.percussion", 4000, -10000, 10000, 0);
     fluid_settings_register_num(settings, "synth.overflow.sustained", -1000, -10000, 10000, 0);
@@ -235,6 +350,20 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_num(settings, "synth.overflow.important", 5000, -50000, 50000, 0);
     fluid_settings_register_str(settings, "synth.overflow.important-channels", "", 0);
 
+    fluid_settings_register_int(settings, "synth.dynamic-polyphony.active", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_num(settings, "synth.dynamic-polyphony.high-load", 90, 0, 100, 0);
+    fluid_settings_register_num(settings, "synth.dynamic-polyphony.low-load", 70, 0, 100, 0);
+
+    fluid_settings_register_int(settings, "synth.interp-qos.active", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_num(settings, "synth.interp-qos.attenuation", 600, 0, 1440, 0);
+    fluid_settings_register_num(settings, "synth.interp-qos.release-time", 100, 0, 10000, 0);
+
+    fluid_settings_register_str(settings, "synth.dsp-precision", "double", 0);
+    fluid_settings_add_option(settings, "synth.dsp-precision", "double");
+    fluid_settings_add_option(settings, "synth.dsp-precision", "float");
+
+    fluid_settings_register_int(settings, "synth.coalesce-controllers", 0, 0, 1, FLUID_HINT_TOGGLED);
+
     fluid_settings_register_str(settings, "synth.midi-bank-select", "gs", 0);
     fluid_settings_add_option(settings, "synth.midi-bank-select", "gm");
     fluid_settings_add_option(settings, "synth.midi-bank-select", "gs");
@@ -242,6 +371,10 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings, "synth.midi-bank-select", "mma");
 
     fluid_settings_register_int(settings, "synth.dynamic-sample-loading", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.dynamic-sample-loading-async", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.dynamic-sample-loading-reads", 64, 1, 1024, 0);
+    fluid_settings_register_int(settings, "synth.lazy-preset-loading", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sfont-load-stats", 0, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 /**
@@ -268,6 +401,27 @@ fluid_version_str(void)
     return FLUIDSYNTH_VERSION;
 }
 
+/**
+ * Get the CPU features detected at runtime and the variants of the DSP kernels
+ * selected for them, e.g. "cpu=sse2,avx2 mix=avx2 interp=avx2".
+ * @return Space separated list, which is internal and should not be modified or freed.
+ *
+ * Setting the environment variable FLUID_CPU_FEATURES to a comma separated list
+ * of features, e.g. "sse2", or to "none" restricts the features the kernels are
+ * selected for, before the first synth is created.
+ * @since 2.2.0
+ */
+const char *
+fluid_version_dsp_str(void)
+{
+    if(fluid_atomic_int_compare_and_exchange(&fluid_synth_initialized, 0, 1))
+    {
+        fluid_synth_init();
+    }
+
+    return fluid_cpu_dispatch_str();
+}
+
 /*
  * void fluid_synth_init
  *
@@ -281,6 +435,17 @@ fluid_synth_init(void)
     feenableexcept(FE_DIVBYZERO | FE_UNDERFLOW | FE_OVERFLOW | FE_INVALID);
 #endif
 
+#ifdef ENABLE_RUNTIME_TABLES
+    fluid_conversion_config();
+    fluid_rvoice_dsp_config();
+#endif
+
+    /* select the variants of the DSP kernels for the CPU */
+    fluid_cpu_dispatch_init();
+    fluid_rvoice_mixer_dispatch_config();
+    fluid_rvoice_dsp_dispatch_config();
+
+    fluid_mod_config();
     init_dither();
 
     /* custom_breath2att_mod is not a default modulator specified in SF2.01.
@@ -492,18 +657,33 @@ struct _fluid_sample_timer_t
     fluid_timer_callback_t callback;
     void *data;
     int isfinished;
+    unsigned int due;           /* Synth ticks before the block of which the callback needn't be called */
+    fluid_atomic_int_t woken;   /* Is the callback to be called by the next block anyway? */
 };
 
 /*
  * fluid_sample_timer_process - called when synth->ticks is updated
+ *
+ * The callbacks are only called by the blocks containing the tick they are
+ * due, by default the next block, see fluid_sample_timer_set_due(). As long
+ * as none of them are due, nor woken up, the timers aren't even walked.
  */
 static void fluid_sample_timer_process(fluid_synth_t *synth)
 {
     fluid_sample_timer_t *st;
     long msec;
-    int cont;
+    int cont, next;
     unsigned int ticks = fluid_synth_get_ticks(synth);
 
+    if(fluid_atomic_int_get(&synth->sample_timers_woken))
+    {
+        fluid_atomic_int_set(&synth->sample_timers_woken, 0);
+    }
+    else if((int)(synth->sample_timers_due - ticks) >= FLUID_BUFSIZE)
+    {
+        return;
+    }
+
     for(st = synth->sample_timers; st; st = st->next)
     {
         if(st->isfinished)
@@ -511,6 +691,13 @@ static void fluid_sample_timer_process(fluid_synth_t *synth)
             continue;
         }
 
+        if(!fluid_atomic_int_compare_and_exchange(&st->woken, 1, 0)
+                && (int)(st->due - ticks) >= FLUID_BUFSIZE)
+        {
+            continue;
+        }
+
+        st->due = ticks + FLUID_BUFSIZE;
         msec = (long)(1000.0 * ((double)(ticks - st->starttick)) / synth->sample_rate);
         cont = (*st->callback)(st->data, msec);
 
@@ -519,6 +706,19 @@ static void fluid_sample_timer_process(fluid_synth_t *synth)
             st->isfinished = 1;
         }
     }
+
+    /* the earliest of the timers, which the callbacks may have added or delayed */
+    next = INT_MAX;
+
+    for(st = synth->sample_timers; st; st = st->next)
+    {
+        if(!st->isfinished && (int)(st->due - ticks) < next)
+        {
+            next = (int)(st->due - ticks);
+        }
+    }
+
+    synth->sample_timers_due = ticks + next;
 }
 
 fluid_sample_timer_t *new_fluid_sample_timer(fluid_synth_t *synth, fluid_timer_callback_t callback, void *data)
@@ -531,10 +731,12 @@ fluid_sample_timer_t *new_fluid_sample_timer(fluid_synth_t *synth, fluid_timer_c
         return NULL;
     }
 
-    fluid_sample_timer_reset(synth, result);
     result->isfinished = 0;
     result->data = data;
     result->callback = callback;
+    result->due = fluid_synth_get_ticks(synth);
+    fluid_atomic_int_set(&result->woken, 0);
+    fluid_sample_timer_reset(synth, result);
     result->next = synth->sample_timers;
     synth->sample_timers = result;
     return result;
@@ -564,6 +766,38 @@ void delete_fluid_sample_timer(fluid_synth_t *synth, fluid_sample_timer_t *timer
 void fluid_sample_timer_reset(fluid_synth_t *synth, fluid_sample_timer_t *timer)
 {
     timer->starttick = fluid_synth_get_ticks(synth);
+    fluid_sample_timer_wakeup(synth, timer);
+}
+
+/*
+ * Let the callback of a timer be called by the next block, even if not due
+ * yet. May be called by any thread, e.g. when the timer has new work to do.
+ */
+void fluid_sample_timer_wakeup(fluid_synth_t *synth, fluid_sample_timer_t *timer)
+{
+    fluid_return_if_fail(timer != NULL);
+
+    fluid_atomic_int_set(&timer->woken, 1);
+    fluid_atomic_int_set(&synth->sample_timers_woken, 1);
+}
+
+/*
+ * Let the callback of a timer be called next by the block containing the
+ * given ticks of the timer, see fluid_sample_timer_get_ticks(), rather than
+ * by the next block. To be called from the timer callback.
+ */
+void fluid_sample_timer_set_due(fluid_synth_t *synth, fluid_sample_timer_t *timer, unsigned int ticks)
+{
+    timer->due = (unsigned int)(timer->starttick + ticks);
+}
+
+/*
+ * Number of audio frames between the start of a timer and the start of
+ * the block about to be rendered, when called from the timer callback.
+ */
+unsigned int fluid_sample_timer_get_ticks(fluid_synth_t *synth, fluid_sample_timer_t *timer)
+{
+    return fluid_synth_get_ticks(synth) - timer->starttick;
 }
 
 /***************************************************************
@@ -582,6 +816,43 @@ fluid_synth_update_mixer(fluid_synth_t *synth, fluid_rvoice_function_t method, i
                                             intparam, realparam);
 }
 
+/*
+ * Render at synth.internal-rate instead of the sample rate, if it's lower and makes a ratio
+ * of small enough integers with it to be upsampled by the mixer.
+ */
+static void
+fluid_synth_init_upsampling(fluid_synth_t *synth, double internal_rate)
+{
+    int num = (int)(synth->sample_rate + 0.5), den = (int)(internal_rate + 0.5);
+    int a = num, b = den, r;
+
+    synth->output_rate = synth->sample_rate;
+    synth->upsample_num = synth->upsample_den = 1;
+
+    if(den <= 0 || den >= num)
+    {
+        return;
+    }
+
+    while(b != 0)
+    {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+
+    if(num / a > FLUID_SYNTH_MAX_UPSAMPLING)
+    {
+        FLUID_LOG(FLUID_WARN, "synth.internal-rate of %d Hz can't be upsampled to %d Hz, rendering at %d Hz",
+                  den, num, num);
+        return;
+    }
+
+    synth->upsample_num = num / a;
+    synth->upsample_den = den / a;
+    synth->sample_rate = synth->output_rate * synth->upsample_den / synth->upsample_num;
+}
+
 static FLUID_INLINE unsigned int fluid_synth_get_min_note_length_LOCAL(fluid_synth_t *synth)
 {
     int i;
@@ -589,6 +860,56 @@ static FLUID_INLINE unsigned int fluid_synth_get_min_note_length_LOCAL(fluid_syn
     return (unsigned int)(i * synth->sample_rate / 1000.0f);
 }
 
+/* Setup the list of default modulators, needs the eventhandler to be set up */
+static void
+fluid_synth_init_default_mods(fluid_synth_t *synth)
+{
+    fluid_synth_add_default_mod(synth, &default_vel2att_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_vel2filter_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_at2viblfo_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_mod2viblfo_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_att_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_pan_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_expr_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_reverb_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_chorus_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &default_pitch_bend_mod, FLUID_SYNTH_ADD);
+    fluid_synth_add_default_mod(synth, &custom_balance_mod, FLUID_SYNTH_ADD);
+}
+
+/* Set the parameters of the reverb and chorus from the settings */
+static void
+fluid_synth_init_effects(fluid_synth_t *synth)
+{
+    double room, damp, width, level, speed, depth;
+    int nr, i;
+
+    fluid_settings_getnum(synth->settings, "synth.reverb.room-size", &room);
+    fluid_settings_getnum(synth->settings, "synth.reverb.damp", &damp);
+    fluid_settings_getnum(synth->settings, "synth.reverb.width", &width);
+    fluid_settings_getnum(synth->settings, "synth.reverb.level", &level);
+
+    fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_ALL, room, damp, width, level);
+
+    fluid_settings_getint(synth->settings, "synth.chorus.nr", &nr);
+    fluid_settings_getnum(synth->settings, "synth.chorus.level", &level);
+    fluid_settings_getnum(synth->settings, "synth.chorus.speed", &speed);
+    fluid_settings_getnum(synth->settings, "synth.chorus.depth", &depth);
+
+    fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_ALL, nr, level, speed, depth,
+                                FLUID_CHORUS_DEFAULT_TYPE);
+
+    for(i = 0; i < synth->effects_groups; i++)
+    {
+        fluid_synth_set_fx_send_LOCAL(synth, i, SYNTH_REVERB_CHANNEL, 1.0);
+        fluid_synth_set_fx_send_LOCAL(synth, i, SYNTH_CHORUS_CHANNEL, 1.0);
+    }
+
+    /* the units of the effects turned on are created along with the parameters set above */
+    fluid_synth_set_reverb_on(synth, synth->with_reverb);
+    fluid_synth_set_chorus_on(synth, synth->with_chorus);
+}
+
 /**
  * Create new FluidSynth instance.
  * @param settings Configuration parameters to use (used directly).
@@ -605,8 +926,11 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_synth_t *synth;
     fluid_sfloader_t *loader;
     char *important_channels;
+    char *cpu_affinity;
     int i, nbuf, prio_level = 0;
     int with_ladspa = 0;
+    int pool_workers = 0;
+    double num_val, internal_rate;
 
     /* initialize all the conversion tables and other stuff */
     if(fluid_atomic_int_compare_and_exchange(&fluid_synth_initialized, 0, 1))
@@ -631,20 +955,29 @@ new_fluid_synth(fluid_settings_t *settings)
 
     synth->settings = settings;
 
+    /* keep the rendering threads from waiting for the log function */
+    synth->with_log_async = (fluid_log_async_ref() == FLUID_OK);
+
     fluid_settings_getint(settings, "synth.reverb.active", &synth->with_reverb);
     fluid_settings_getint(settings, "synth.chorus.active", &synth->with_chorus);
     fluid_settings_getint(settings, "synth.verbose", &synth->verbose);
 
     fluid_settings_getint(settings, "synth.polyphony", &synth->polyphony);
+    fluid_settings_getint(settings, "synth.polyphony-max", &synth->nvoice);
     fluid_settings_getnum(settings, "synth.sample-rate", &synth->sample_rate);
+    fluid_settings_getnum(settings, "synth.internal-rate", &internal_rate);
+    fluid_synth_init_upsampling(synth, internal_rate);
     fluid_settings_getint(settings, "synth.midi-channels", &synth->midi_channels);
     fluid_settings_getint(settings, "synth.audio-channels", &synth->audio_channels);
     fluid_settings_getint(settings, "synth.audio-groups", &synth->audio_groups);
     fluid_settings_getint(settings, "synth.effects-channels", &synth->effects_channels);
     fluid_settings_getint(settings, "synth.effects-groups", &synth->effects_groups);
+    fluid_settings_getint(settings, "synth.effects-release-time", &synth->fx_release_time);
+    fluid_settings_getint(settings, "synth.effects-shared", &synth->effects_shared);
     fluid_settings_getnum_float(settings, "synth.gain", &synth->gain);
     fluid_settings_getint(settings, "synth.device-id", &synth->device_id);
     fluid_settings_getint(settings, "synth.cpu-cores", &synth->cores);
+    fluid_settings_getint(settings, "synth.render-pool", &pool_workers);
 
     fluid_settings_getnum_float(settings, "synth.overflow.percussion", &synth->overflow.percussion);
     fluid_settings_getnum_float(settings, "synth.overflow.released", &synth->overflow.released);
@@ -653,6 +986,21 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_settings_getnum_float(settings, "synth.overflow.age", &synth->overflow.age);
     fluid_settings_getnum_float(settings, "synth.overflow.important", &synth->overflow.important);
 
+    fluid_settings_getint(settings, "synth.dynamic-polyphony.active", &i);
+    fluid_atomic_int_set(&synth->dynamic_polyphony, i);
+    fluid_settings_getnum(settings, "synth.dynamic-polyphony.high-load", &num_val);
+    fluid_atomic_float_set(&synth->dynamic_polyphony_high, num_val);
+    fluid_settings_getnum(settings, "synth.dynamic-polyphony.low-load", &num_val);
+    fluid_atomic_float_set(&synth->dynamic_polyphony_low, num_val);
+
+    fluid_settings_getint(settings, "synth.interp-qos.active", &synth->interp_qos);
+    fluid_settings_getnum(settings, "synth.interp-qos.attenuation", &synth->interp_qos_attenuation);
+    fluid_settings_getnum(settings, "synth.interp-qos.release-time", &synth->interp_qos_release_time);
+
+    synth->dsp_single_precision = fluid_settings_str_equal(settings, "synth.dsp-precision", "float");
+
+    fluid_settings_getint(settings, "synth.coalesce-controllers", &synth->coalesce_controllers);
+
     /* register the callbacks */
     fluid_settings_callback_num(settings, "synth.gain",
                                 fluid_synth_handle_gain, synth);
@@ -674,6 +1022,22 @@ new_fluid_synth(fluid_settings_t *settings)
                                 fluid_synth_handle_overflow, synth);
     fluid_settings_callback_str(settings, "synth.overflow.important-channels",
                                 fluid_synth_handle_important_channels, synth);
+    fluid_settings_callback_int(settings, "synth.dynamic-polyphony.active",
+                                fluid_synth_handle_dynamic_polyphony, synth);
+    fluid_settings_callback_num(settings, "synth.dynamic-polyphony.high-load",
+                                fluid_synth_handle_dynamic_polyphony_load, synth);
+    fluid_settings_callback_num(settings, "synth.dynamic-polyphony.low-load",
+                                fluid_synth_handle_dynamic_polyphony_load, synth);
+    fluid_settings_callback_int(settings, "synth.interp-qos.active",
+                                fluid_synth_handle_interp_qos, synth);
+    fluid_settings_callback_num(settings, "synth.interp-qos.attenuation",
+                                fluid_synth_handle_interp_qos_num, synth);
+    fluid_settings_callback_num(settings, "synth.interp-qos.release-time",
+                                fluid_synth_handle_interp_qos_num, synth);
+    fluid_settings_callback_str(settings, "synth.dsp-precision",
+                                fluid_synth_handle_dsp_precision, synth);
+    fluid_settings_callback_int(settings, "synth.coalesce-controllers",
+                                fluid_synth_handle_coalesce_controllers, synth);
     fluid_settings_callback_num(settings, "synth.reverb.room-size",
                                 fluid_synth_handle_reverb_chorus_num, synth);
     fluid_settings_callback_num(settings, "synth.reverb.damp",
@@ -769,36 +1133,170 @@ new_fluid_synth(fluid_settings_t *settings)
     synth->tuning = NULL;
     fluid_private_init(synth->tuning_iter);
 
+    /* tunings are replaced by MIDI tuning messages, possibly while rendering audio */
+    synth->tuning_pool = new_fluid_pool(FLUID_TUNING_POOL_SIZE, sizeof(fluid_tuning_t));
+
+    if(synth->tuning_pool == NULL)
+    {
+        goto error_recovery;
+    }
+
     /* Initialize multi-core variables if multiple cores enabled */
-    if(synth->cores > 1)
+    if(synth->cores > 1 || pool_workers > 0)
     {
         fluid_settings_getint(synth->settings, "audio.realtime-prio", &prio_level);
     }
 
+    /* voices are allocated for synth.polyphony-max up front, so that raising the polyphony
+     * up to it is only a counter update */
+    if(synth->nvoice < synth->polyphony)
+    {
+        synth->nvoice = synth->polyphony;
+    }
+
     /* Allocate event queue for rvoice mixer */
     /* In an overflow situation, a new voice takes about 50 spaces in the queue! */
-    synth->eventhandler = new_fluid_rvoice_eventhandler(synth->polyphony * 64,
-                          synth->polyphony, nbuf, synth->effects_channels, synth->effects_groups, synth->sample_rate, synth->cores - 1, prio_level);
+    synth->eventhandler = new_fluid_rvoice_eventhandler(synth->nvoice * 64,
+                          synth->nvoice, nbuf, synth->effects_channels, synth->effects_groups, (pool_workers > 0) ? 0 : synth->cores - 1, prio_level);
 
     if(synth->eventhandler == NULL)
     {
         goto error_recovery;
     }
 
+    if(fluid_rvoice_mixer_set_upsampling(synth->eventhandler->mixer, synth->upsample_num, synth->upsample_den) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_rvoice_mixer_set_fx_shared(synth->eventhandler->mixer, synth->effects_shared);
+
+    synth->fx_sends = FLUID_ARRAY(double, 2 * synth->effects_groups);
+
+    if(synth->fx_sends == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    /* render with the workers shared by the synths of the process instead of own threads */
+    if(pool_workers > 0
+            && fluid_rvoice_mixer_join_render_pool(synth->eventhandler->mixer, pool_workers, prio_level) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    if(fluid_rvoice_mixer_reserve_polyphony(synth->eventhandler->mixer, synth->nvoice) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    if(fluid_settings_str_equal(settings, "synth.cpu-cores-scheduler", "work-stealing"))
+    {
+        fluid_rvoice_mixer_set_scheduler(synth->eventhandler->mixer, FLUID_MIXER_SCHEDULER_WORK_STEALING);
+    }
+    else if(fluid_settings_str_equal(settings, "synth.cpu-cores-scheduler", "deterministic"))
+    {
+        fluid_rvoice_mixer_set_scheduler(synth->eventhandler->mixer, FLUID_MIXER_SCHEDULER_DETERMINISTIC);
+    }
+
+    fluid_settings_getint(settings, "synth.cpu-cores-spin-time", &i);
+    fluid_rvoice_mixer_set_spin_time(synth->eventhandler->mixer, i);
+
+    fluid_settings_getint(settings, "synth.voice-prefetch", &i);
+    fluid_rvoice_mixer_set_prefetch(synth->eventhandler->mixer, i);
+
+    fluid_settings_getint(settings, "synth.voice-fused-mixing", &i);
+    fluid_rvoice_mixer_set_fused(synth->eventhandler->mixer, i);
+
+    fluid_settings_getint(settings, "synth.reverb.decimation", &i);
+    fluid_rvoice_mixer_set_reverb_decimation(synth->eventhandler->mixer, i);
+
+    fluid_settings_getint(settings, "synth.note-cache-size", &i);
+
+    if(i > 0 && fluid_rvoice_mixer_set_note_cache(synth->eventhandler->mixer, (unsigned int)i * 1024 * 1024) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.flush-denormals", &i);
+
+    if(i && fluid_rvoice_mixer_set_flush_denormals(synth->eventhandler->mixer, TRUE) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_WARN, "Flushing denormals to zero is not supported on this platform");
+    }
+
+    fluid_settings_getint(settings, "synth.voice-snapshot", &synth->with_voice_snapshot);
+
+    if(synth->with_voice_snapshot && fluid_rvoice_mixer_enable_snapshot(synth->eventhandler->mixer) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.voice-activity-queue", &i);
+
+    if(i > 0)
+    {
+        synth->voice_activity = new_fluid_ringbuffer(i, sizeof(fluid_voice_activity_t));
+
+        if(synth->voice_activity == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
+    fluid_settings_getint(settings, "synth.level-meters", &i);
+
+    if(i && fluid_rvoice_mixer_enable_meters(synth->eventhandler->mixer) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    if(fluid_settings_dupstr(settings, "synth.cpu-affinity", &cpu_affinity) == FLUID_OK)
+    {
+        i = fluid_synth_set_cpu_affinity(synth, cpu_affinity);
+        FLUID_FREE(cpu_affinity);
+
+        if(i != FLUID_OK)
+        {
+            goto error_recovery;
+        }
+    }
+
+    fluid_settings_getint(settings, "synth.lock-free-api", &i);
+
+    /* without the mutex, several threads entering the synth would process the queue at once */
+    if(i && !synth->use_mutex)
+    {
+        FLUID_LOG(FLUID_WARN, "synth.lock-free-api requires synth.threadsafe-api, calling the synth directly");
+    }
+    else if(i)
+    {
+        synth->api_queue = new_fluid_mpsc_queue(FLUID_API_QUEUE_SIZE, sizeof(fluid_synth_api_event_t));
+
+        if(synth->api_queue == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
+    fluid_settings_getint(settings, "synth.sample-streaming", &i);
+
+    if(i)
+    {
+        /* a ring buffer for each voice, the voices beyond read from the mapped file */
+        synth->sample_streamer = new_fluid_sample_streamer(synth->polyphony);
+
+        if(synth->sample_streamer == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
     /* Setup the list of default modulators.
      * Needs to happen after eventhandler has been set up, as fluid_synth_enter_api is called in the process */
     synth->default_mod = NULL;
-    fluid_synth_add_default_mod(synth, &default_vel2att_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_vel2filter_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_at2viblfo_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_mod2viblfo_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_att_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_pan_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_expr_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_reverb_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_chorus_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &default_pitch_bend_mod, FLUID_SYNTH_ADD);
-    fluid_synth_add_default_mod(synth, &custom_balance_mod, FLUID_SYNTH_ADD);
+    fluid_synth_init_default_mods(synth);
 
     /* Create and initialize the Fx unit.*/
     fluid_settings_getint(settings, "synth.ladspa.active", &with_ladspa);
@@ -848,6 +1346,15 @@ new_fluid_synth(fluid_settings_t *settings)
         fluid_synth_add_sfloader(synth, loader);
     }
 
+    /* the channels already look up their default presets */
+    synth->preset_index = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+    if(synth->preset_index == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
     /* allocate all channel objects */
     synth->channel = FLUID_ARRAY(fluid_channel_t *, synth->midi_channels);
 
@@ -869,7 +1376,6 @@ new_fluid_synth(fluid_settings_t *settings)
     }
 
     /* allocate all synthesis processes */
-    synth->nvoice = synth->polyphony;
     synth->voice = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
 
     if(synth->voice == NULL)
@@ -878,16 +1384,21 @@ new_fluid_synth(fluid_settings_t *settings)
     }
 
     FLUID_MEMSET(synth->voice, 0, synth->nvoice * sizeof(*synth->voice));
-    for(i = 0; i < synth->nvoice; i++)
+
+    if(fluid_synth_alloc_voices_LOCAL(synth, 0, synth->nvoice) != FLUID_OK)
     {
-        synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate);
+        goto error_recovery;
+    }
 
-        if(synth->voice[i] == NULL)
-        {
-            goto error_recovery;
-        }
+    synth->overflow_heap = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
+
+    if(synth->overflow_heap == NULL)
+    {
+        goto error_recovery;
     }
 
+    fluid_synth_rebuild_overflow_heap_LOCAL(synth);
+
     /* sets a default basic channel */
     /* Sets one basic channel: basic channel 0, mode 0 (Omni On - Poly) */
     /* (i.e all channels are polyphonic) */
@@ -900,45 +1411,12 @@ new_fluid_synth(fluid_settings_t *settings)
 
     fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
                              synth->polyphony, 0.0f);
-    fluid_synth_set_reverb_on(synth, synth->with_reverb);
-    fluid_synth_set_chorus_on(synth, synth->with_chorus);
 
     synth->cur = FLUID_BUFSIZE;
     synth->curmax = 0;
     synth->dither_index = 0;
 
-    {
-        double room, damp, width, level;
-
-        fluid_settings_getnum(settings, "synth.reverb.room-size", &room);
-        fluid_settings_getnum(settings, "synth.reverb.damp", &damp);
-        fluid_settings_getnum(settings, "synth.reverb.width", &width);
-        fluid_settings_getnum(settings, "synth.reverb.level", &level);
-
-        fluid_synth_set_reverb_full(synth,
-                                          FLUID_REVMODEL_SET_ALL,
-                                          room,
-                                          damp,
-                                          width,
-                                          level);
-    }
-
-    {
-        double level, speed, depth;
-
-        fluid_settings_getint(settings, "synth.chorus.nr", &i);
-        fluid_settings_getnum(settings, "synth.chorus.level", &level);
-        fluid_settings_getnum(settings, "synth.chorus.speed", &speed);
-        fluid_settings_getnum(settings, "synth.chorus.depth", &depth);
-
-        fluid_synth_set_chorus_full(synth,
-                                          FLUID_CHORUS_SET_ALL,
-                                          i,
-                                          level,
-                                          speed,
-                                          depth,
-                                          FLUID_CHORUS_DEFAULT_TYPE);
-    }
+    fluid_synth_init_effects(synth);
 
 
     synth->bank_select = FLUID_BANK_STYLE_GS;
@@ -992,6 +1470,9 @@ delete_fluid_synth(fluid_synth_t *synth)
 
     fluid_profiling_print();
 
+    /* wait for the SoundFonts still loading in the background */
+    fluid_synth_join_sfload_jobs(synth, TRUE);
+
     /* turn off all voices, needed to unload SoundFont data */
     if(synth->voice != NULL)
     {
@@ -1036,6 +1517,13 @@ delete_fluid_synth(fluid_synth_t *synth)
     }
 
     delete_fluid_rvoice_eventhandler(synth->eventhandler);
+    fluid_synth_free_replaced_rates(synth, TRUE);
+    fluid_synth_free_replaced_irs(synth, TRUE);
+    delete_fluid_mpsc_queue(synth->api_queue);
+    delete_fluid_sample_streamer(synth->sample_streamer);
+
+    /* all voices are stopped, free the SoundFonts unloaded before */
+    delete_fluid_sfont_reclaimer(synth->sfont_reclaimer);
 
     /* delete all the SoundFonts */
     for(list = synth->sfont; list; list = fluid_list_next(list))
@@ -1045,6 +1533,7 @@ delete_fluid_synth(fluid_synth_t *synth)
     }
 
     delete_fluid_list(synth->sfont);
+    delete_fluid_hashtable(synth->preset_index);
 
     /* delete all the SoundFont loaders */
 
@@ -1075,10 +1564,20 @@ delete_fluid_synth(fluid_synth_t *synth)
         }
 
         FLUID_FREE(synth->voice);
+        FLUID_FREE(synth->overflow_heap);
     }
 
+    FLUID_FREE(synth->fx_sends);
 
-    /* free the tunings, if any */
+    for(list = synth->rvoice_slabs; list; list = fluid_list_next(list))
+    {
+        delete_fluid_rvoice_slab(fluid_list_get(list));
+    }
+
+    delete_fluid_list(synth->rvoice_slabs);
+
+
+    /* free the tunings, if any */
     if(synth->tuning != NULL)
     {
         for(i = 0; i < 128; i++)
@@ -1097,6 +1596,7 @@ delete_fluid_synth(fluid_synth_t *synth)
         FLUID_FREE(synth->tuning);
     }
 
+    delete_fluid_pool(synth->tuning_pool);
     fluid_private_free(synth->tuning_iter);
 
 #ifdef LADSPA
@@ -1108,9 +1608,15 @@ delete_fluid_synth(fluid_synth_t *synth)
     delete_fluid_list_mod(synth->default_mod);
 
     FLUID_FREE(synth->overflow.important_channels);
+    delete_fluid_ringbuffer(synth->voice_activity);
 
     fluid_rec_mutex_destroy(synth->mutex);
 
+    if(synth->with_log_async)
+    {
+        fluid_log_async_unref();
+    }
+
     FLUID_FREE(synth);
 }
 
@@ -1140,6 +1646,8 @@ fluid_synth_error(fluid_synth_t *synth)
  * @param key MIDI note number (0-127)
  * @param vel MIDI velocity (0-127, 0=noteoff)
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @note If "synth.lock-free-api" is enabled, the event is queued and #FLUID_OK
+ * is returned before it has actually been processed.
  */
 int
 fluid_synth_noteon(fluid_synth_t *synth, int chan, int key, int vel)
@@ -1147,15 +1655,235 @@ fluid_synth_noteon(fluid_synth_t *synth, int chan, int key, int vel)
     int result;
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(vel >= 0 && vel <= 127, FLUID_FAILED);
+
+    if(fluid_synth_queue_api_event(synth, FLUID_API_EVENT_NOTEON, chan, key, vel))
+    {
+        return FLUID_OK;
+    }
+
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    result = fluid_synth_process_noteon(synth, chan, key, vel);
+    FLUID_API_RETURN(result);
+}
 
-    /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+/*
+ * Send a noteon message, whose voices start offset frames into the next
+ * block rendered, instead of at its beginning.
+ * Used by the sequencer to place notes at their exact frame.
+ */
+int
+fluid_synth_noteon_offset(fluid_synth_t *synth, int chan, int key, int vel, int offset)
+{
+    int result;
+    fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
+    fluid_return_val_if_fail(vel >= 0 && vel <= 127, FLUID_FAILED);
+    fluid_return_val_if_fail(offset >= 0 && offset < FLUID_BUFSIZE, FLUID_FAILED);
 
-    result = fluid_synth_noteon_LOCAL(synth, chan, key, vel);
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    synth->voice_start_offset = offset;
+    result = fluid_synth_process_noteon(synth, chan, key, vel);
+    synth->voice_start_offset = 0;
     FLUID_API_RETURN(result);
 }
 
+/*
+ * Pass a MIDI event to handler, e.g. a MIDI router ending at this synth, so
+ * that the voices it starts begin offset frames into the next block rendered,
+ * see fluid_synth_noteon_offset(). Events queued by the lock-free API start
+ * at the beginning of the block.
+ * Used by the drivers to place timestamped MIDI events at their exact frame.
+ */
+int
+fluid_synth_handle_midi_event_offset(fluid_synth_t *synth, handle_midi_event_func_t handler, void *data,
+                                     fluid_midi_event_t *event, int offset)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handler != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(offset >= 0 && offset < FLUID_BUFSIZE, FLUID_FAILED);
+
+    /* the API is entered recursively by the handler, so that no other
+     * thread starts voices meanwhile */
+    fluid_synth_api_enter(synth);
+    synth->voice_start_offset = offset;
+    result = handler(data, event);
+    synth->voice_start_offset = 0;
+    fluid_synth_api_exit(synth);
+
+    return result;
+}
+
+/*
+ * Pass a batch of MIDI events to handler, e.g. a MIDI router ending at this
+ * synth, entering the API once for all of them: the changes they make are
+ * handed to the rendering at once, when the API is left.
+ * Returns FLUID_FAILED if the handler failed for any of them.
+ */
+int
+fluid_synth_handle_midi_batch(fluid_synth_t *synth, handle_midi_event_func_t handler, void *data,
+                              fluid_midi_event_t **events, int n)
+{
+    int i, result = FLUID_OK;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handler != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(events != NULL || n == 0, FLUID_FAILED);
+    fluid_return_val_if_fail(n >= 0, FLUID_FAILED);
+
+    fluid_synth_api_enter(synth);
+
+    for(i = 0; i < n; i++)
+    {
+        if(handler(data, events[i]) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    fluid_synth_api_exit(synth);
+
+    return result;
+}
+
+/*
+ * Number of frames left from the blocks rendered already, which the next call
+ * to fluid_synth_write_float() or fluid_synth_process() returns before
+ * rendering a new block. MIDI events sent now take effect after them.
+ * Must be called from the rendering thread.
+ */
+int
+fluid_synth_get_buffered_frames(fluid_synth_t *synth)
+{
+    fluid_return_val_if_fail(synth != NULL, 0);
+
+    return (synth->cur + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE * FLUID_BUFSIZE - synth->cur;
+}
+
+/*
+ * Let the rendering follow the time of fluid_utime() at which the blocks are
+ * rendered, for fluid_synth_utime_to_offset(). Counted, to be called once with
+ * TRUE and once with FALSE by each user.
+ */
+void
+fluid_synth_use_clock(fluid_synth_t *synth, int use)
+{
+    fluid_return_if_fail(synth != NULL);
+
+    fluid_atomic_int_add(&synth->clock_users, use ? 1 : -1);
+}
+
+/*
+ * Follows the time of fluid_utime() at which the rendering reaches the ticks
+ * of the synth, by a delay-locked loop. The audio drivers render in periods,
+ * several blocks in a row after waiting for the device, so the time measured
+ * for each call is smoothed over many periods, tracking the drift of the audio
+ * clock against the system clock as well.
+ */
+static void
+fluid_synth_update_clock(fluid_synth_t *synth)
+{
+    double now = fluid_utime();
+    double nominal = 1000000.0 / synth->sample_rate;
+    unsigned int ticks = fluid_synth_get_ticks(synth);
+    int elapsed = (int)(ticks - synth->clock_ticks);
+    double usec = synth->clock_usec + elapsed * synth->clock_usec_per_tick;
+    double err = now - usec;
+
+    if(synth->clock_usec == 0 || FLUID_FABS(err) > FLUID_CLOCK_RESYNC_USEC
+            || FLUID_FABS(synth->clock_usec_per_tick - nominal) > nominal * FLUID_CLOCK_MAX_DRIFT)
+    {
+        /* started, resumed after the rendering stalled, or the sample rate changed */
+        usec = now;
+        synth->clock_usec_per_tick = nominal;
+    }
+    else if(elapsed > 0)
+    {
+        usec += FLUID_CLOCK_W1 * err;
+        synth->clock_usec_per_tick += FLUID_CLOCK_W2 * err / elapsed;
+    }
+    else
+    {
+        return;
+    }
+
+    synth->clock_ticks = ticks;
+    synth->clock_usec = usec;
+}
+
+/*
+ * The frame inside the block about to be rendered, at which the time of
+ * fluid_utime() is reached by the rendering, see fluid_synth_use_clock().
+ * Negative if passed already, beyond FLUID_BUFSIZE for the next blocks.
+ * To be called by the rendering thread, e.g. from a sample timer.
+ */
+int
+fluid_synth_utime_to_offset(fluid_synth_t *synth, double usec)
+{
+    double frames;
+
+    if(synth->clock_usec == 0)
+    {
+        return 0;
+    }
+
+    frames = (int)(synth->clock_ticks - fluid_synth_get_ticks(synth))
+             + (usec - synth->clock_usec) / synth->clock_usec_per_tick;
+    fluid_clip(frames, -FLUID_CLOCK_MAX_OFFSET, FLUID_CLOCK_MAX_OFFSET);
+
+    frames = floor(frames);
+
+    return (int)frames;
+}
+
+/*
+ * Let the extra mixer threads join the audio workgroup of the device the
+ * synth is rendered for, or leave it with NULL. Must not be called while the
+ * synth is being rendered, i.e. before the audio driver starts rendering it
+ * and after it stopped.
+ */
+int
+fluid_synth_set_workgroup(fluid_synth_t *synth, void *workgroup)
+{
+    int retval;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+
+    fluid_synth_api_enter(synth);
+    retval = fluid_rvoice_mixer_set_workgroup(synth->eventhandler->mixer, workgroup);
+    fluid_synth_api_exit(synth);
+
+    return retval;
+}
+
+/*
+ * Let the extra mixer threads be created by the audio driver the synth is rendered by,
+ * or by new_fluid_thread() again with NULL. Must not be called while the synth is
+ * being rendered, see fluid_synth_set_workgroup().
+ */
+int
+fluid_synth_set_thread_factory(fluid_synth_t *synth, const fluid_thread_factory_t *factory)
+{
+    int retval;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+
+    fluid_synth_api_enter(synth);
+    retval = fluid_rvoice_mixer_set_thread_factory(synth->eventhandler->mixer, factory);
+    fluid_synth_api_exit(synth);
+
+    return retval;
+}
+
+/* Body of fluid_synth_noteon, the API must have been entered */
+static int
+fluid_synth_process_noteon(fluid_synth_t *synth, int chan, int key, int vel)
+{
+    /* Allowed only on MIDI channel enabled */
+    if(!(synth->channel[chan]->mode & FLUID_CHANNEL_ENABLED))
+    {
+        return FLUID_FAILED;
+    }
+
+    return fluid_synth_noteon_LOCAL(synth, chan, key, vel);
+}
+
 /* Local synthesis thread variant of fluid_synth_noteon */
 static int
 fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key, int vel)
@@ -1224,19 +1952,36 @@ fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key, int vel)
  * @param key MIDI note number (0-127)
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise (may just mean that no
  *   voices matched the note off event)
+ * @note If "synth.lock-free-api" is enabled, the event is queued and #FLUID_OK
+ * is returned before it has actually been processed.
  */
 int
 fluid_synth_noteoff(fluid_synth_t *synth, int chan, int key)
 {
     int result;
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
+
+    if(fluid_synth_queue_api_event(synth, FLUID_API_EVENT_NOTEOFF, chan, key, 0))
+    {
+        return FLUID_OK;
+    }
+
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    result = fluid_synth_process_noteoff(synth, chan, key);
+    FLUID_API_RETURN(result);
+}
 
+/* Body of fluid_synth_noteoff, the API must have been entered */
+static int
+fluid_synth_process_noteoff(fluid_synth_t *synth, int chan, int key)
+{
     /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    if(!(synth->channel[chan]->mode & FLUID_CHANNEL_ENABLED))
+    {
+        return FLUID_FAILED;
+    }
 
-    result = fluid_synth_noteoff_LOCAL(synth, chan, key);
-    FLUID_API_RETURN(result);
+    return fluid_synth_noteoff_LOCAL(synth, chan, key);
 }
 
 /* Local synthesis thread variant of fluid_synth_noteoff */
@@ -1275,14 +2020,13 @@ static int
 fluid_synth_damp_voices_by_sustain_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_channel_t *channel = synth->channel[chan];
-    fluid_voice_t *voice;
-    int i;
+    fluid_voice_t *voice, *next;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->voices; voice != NULL; voice = next)
     {
-        voice = synth->voice[i];
+        next = voice->chan_next;
 
-        if((fluid_voice_get_channel(voice) == chan) && fluid_voice_is_sustained(voice))
+        if(fluid_voice_is_sustained(voice))
         {
             if(voice->key == channel->key_mono_sustained)
             {
@@ -1305,14 +2049,13 @@ static int
 fluid_synth_damp_voices_by_sostenuto_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_channel_t *channel = synth->channel[chan];
-    fluid_voice_t *voice;
-    int i;
+    fluid_voice_t *voice, *next;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->voices; voice != NULL; voice = next)
     {
-        voice = synth->voice[i];
+        next = voice->chan_next;
 
-        if((fluid_voice_get_channel(voice) == chan) && fluid_voice_is_sostenuto(voice))
+        if(fluid_voice_is_sostenuto(voice))
         {
             if(voice->key == channel->key_mono_sustained)
             {
@@ -1467,17 +2210,32 @@ fluid_synth_remove_default_mod(fluid_synth_t *synth, const fluid_mod_t *mod)
  *    could be used as CC global for all channels belonging to basic channel 7.
  * - Let a basic channel 0 in mode 3. If MIDI channel 15  is disabled it could be used
  *   as CC global for all channels belonging to basic channel 0.
+ * @note If "synth.lock-free-api" is enabled, the event is queued and #FLUID_OK
+ * is returned before it has actually been processed.
  */
 int
 fluid_synth_cc(fluid_synth_t *synth, int chan, int num, int val)
 {
-    int result = FLUID_FAILED;
-    fluid_channel_t *channel;
+    int result;
     fluid_return_val_if_fail(num >= 0 && num <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(val >= 0 && val <= 127, FLUID_FAILED);
+
+    if(fluid_synth_queue_api_event(synth, FLUID_API_EVENT_CC, chan, num, val))
+    {
+        return FLUID_OK;
+    }
+
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    result = fluid_synth_process_cc(synth, chan, num, val);
+    FLUID_API_RETURN(result);
+}
 
-    channel = synth->channel[chan];
+/* Body of fluid_synth_cc, the API must have been entered */
+static int
+fluid_synth_process_cc(fluid_synth_t *synth, int chan, int num, int val)
+{
+    int result = FLUID_FAILED;
+    fluid_channel_t *channel = synth->channel[chan];
 
     if(channel->mode &  FLUID_CHANNEL_ENABLED)
     {
@@ -1532,7 +2290,7 @@ fluid_synth_cc(fluid_synth_t *synth, int chan, int num, int val)
         }
     }
 
-    FLUID_API_RETURN(result);
+    return result;
 }
 
 /* Local synthesis thread variant of MIDI CC set function.
@@ -2285,23 +3043,19 @@ fluid_synth_all_sounds_off(fluid_synth_t *synth, int chan)
     FLUID_API_RETURN(result);
 }
 
-/* Local synthesis thread variant of all sounds off, (chan=-1 selects all channels) */
+/* Local synthesis thread variant of all sounds off, (chan=-1 selects all channels).
+ * The mixer finishes the voices in one pass, rather than with an event per voice. */
 static int
 fluid_synth_all_sounds_off_LOCAL(fluid_synth_t *synth, int chan)
 {
-    fluid_voice_t *voice;
-    int i;
-
-    for(i = 0; i < synth->polyphony; i++)
+    if((chan == -1) ? (synth->active_voice_count == 0)
+            : (synth->channel[chan]->voice_count == 0))
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_is_playing(voice) && ((-1 == chan) || (chan == fluid_voice_get_channel(voice))))
-        {
-            fluid_voice_off(voice);
-        }
+        return FLUID_OK;
     }
 
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_channel_off, chan, 0.0f);
+
     return FLUID_OK;
 }
 
@@ -2374,58 +3128,210 @@ fluid_synth_system_reset_LOCAL(fluid_synth_t *synth)
 }
 
 /**
- * Update voices on a MIDI channel after a MIDI control change.
+ * Restore the state of a synth right after new_fluid_synth(), so that it can be reused,
+ * e.g. for the next job of a pool of synths, without creating it again.
  * @param synth FluidSynth instance
- * @param chan MIDI channel number (0 to MIDI channel count - 1)
- * @param is_cc Boolean value indicating if ctrl is a CC controller or not
- * @param ctrl MIDI controller value
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Further to fluid_synth_system_reset(), the tunings are deleted, the default modulators,
+ * the gain, the polyphony and the parameters of the reverb and chorus are taken
+ * from the settings again, and the ticks and the sample timers start at 0 again
+ * silently, discarding the audio rendered but not read yet. Nothing is freed: the
+ * loaded SoundFonts, the convolution reverbs and the allocated voices are kept.
+ *
+ * @note Must not be called while the synth is rendered by another thread, e.g. by an
+ * audio driver. The players and sequencers using the synth should be stopped first.
+ * @since 2.2.0
  */
-static int
-fluid_synth_modulate_voices_LOCAL(fluid_synth_t *synth, int chan, int is_cc, int ctrl)
+int
+fluid_synth_reset_to_initial_state(fluid_synth_t *synth)
 {
-    fluid_voice_t *voice;
-    int i;
+    fluid_sample_timer_t *st;
+    int i, k;
 
-    for(i = 0; i < synth->polyphony; i++)
-    {
-        voice = synth->voice[i];
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
 
-        if(fluid_voice_get_channel(voice) == chan)
+    /* the notes, channels and effects, unreferencing the tunings of the channels */
+    fluid_synth_system_reset_LOCAL(synth);
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_reset_upsampling, 0, 0.0f);
+
+    if(synth->tuning != NULL)
+    {
+        for(i = 0; i < 128; i++)
         {
-            fluid_voice_modulate(voice, is_cc, ctrl);
+            if(synth->tuning[i] == NULL)
+            {
+                continue;
+            }
+
+            for(k = 0; k < 128; k++)
+            {
+                if(synth->tuning[i][k] != NULL)
+                {
+                    fluid_tuning_unref(synth->tuning[i][k], 1);
+                    synth->tuning[i][k] = NULL;
+                }
+            }
         }
     }
 
-    return FLUID_OK;
+    delete_fluid_list_mod(synth->default_mod);
+    synth->default_mod = NULL;
+    fluid_synth_init_default_mods(synth);
+
+    fluid_settings_getnum_float(synth->settings, "synth.gain", &synth->gain);
+    fluid_synth_update_gain_LOCAL(synth);
+    fluid_settings_getint(synth->settings, "synth.polyphony", &i);
+    fluid_synth_update_polyphony_LOCAL(synth, i);
+
+    fluid_settings_getint(synth->settings, "synth.reverb.active", &synth->with_reverb);
+    fluid_settings_getint(synth->settings, "synth.chorus.active", &synth->with_chorus);
+    fluid_synth_init_effects(synth);
+
+    synth->cur = FLUID_BUFSIZE;
+    synth->curmax = 0;
+    synth->dither_index = 0;
+
+    fluid_atomic_int_set(&synth->ticks_since_start, 0);
+
+    for(st = synth->sample_timers; st; st = st->next)
+    {
+        st->due = 0;
+        fluid_sample_timer_reset(synth, st);
+    }
+
+    synth->sample_timers_due = 0;
+    synth->start = fluid_curtime();
+
+    FLUID_API_RETURN(FLUID_OK);
 }
 
 /**
- * Update voices on a MIDI channel after all MIDI controllers have been changed.
+ * Update voices on a MIDI channel after a MIDI control change.
  * @param synth FluidSynth instance
  * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param is_cc Boolean value indicating if ctrl is a CC controller or not
+ * @param ctrl MIDI controller value
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  */
 static int
-fluid_synth_modulate_voices_all_LOCAL(fluid_synth_t *synth, int chan)
+fluid_synth_modulate_voices_LOCAL(fluid_synth_t *synth, int chan, int is_cc, int ctrl)
 {
+    fluid_channel_t *channel = synth->channel[chan];
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    /* Only note the controller, its voices are modulated with the next block */
+    if(synth->coalesce_controllers)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_get_channel(voice) == chan)
+        if(is_cc)
+        {
+            channel->pending_cc[ctrl >> 5] |= 1u << (ctrl & 31);
+        }
+        else
         {
-            fluid_voice_modulate_all(voice);
+            channel->pending_ctrl |= 1u << ctrl;
         }
+
+        fluid_atomic_int_set(&synth->controllers_pending, 1);
+        return FLUID_OK;
+    }
+
+    for(voice = channel->voices; voice != NULL; voice = voice->chan_next)
+    {
+        fluid_voice_modulate(voice, is_cc, ctrl);
     }
 
     return FLUID_OK;
 }
 
-/**
+/*
+ * Modulates the voices of all channels for the controllers changed since the
+ * last block, once for each controller, and retunes the voices of the channels
+ * whose tuning has changed, if synth.coalesce-controllers is enabled.
+ * Called by the rendering thread before each block.
+ */
+static void
+fluid_synth_update_pending_controllers(fluid_synth_t *synth)
+{
+    unsigned int i;
+    int chan, j;
+
+    fluid_synth_api_enter(synth);
+    fluid_atomic_int_set(&synth->controllers_pending, 0);
+
+    for(chan = 0; chan < synth->midi_channels; chan++)
+    {
+        fluid_channel_t *channel = synth->channel[chan];
+        uint32_t ctrl = channel->pending_ctrl;
+        fluid_voice_t *voice;
+
+        /* the tuning first, the pitch modulators are applied on top of it */
+        if(channel->pending_tuning)
+        {
+            channel->pending_tuning = FALSE;
+            fluid_synth_retune_voices_LOCAL(channel);
+        }
+
+        for(i = 0; i < FLUID_N_ELEMENTS(channel->pending_cc); i++)
+        {
+            uint32_t cc = channel->pending_cc[i];
+            channel->pending_cc[i] = 0;
+
+            for(j = 0; cc != 0; j++, cc >>= 1)
+            {
+                if(cc & 1)
+                {
+                    for(voice = channel->voices; voice != NULL; voice = voice->chan_next)
+                    {
+                        fluid_voice_modulate(voice, 1, i * 32 + j);
+                    }
+                }
+            }
+        }
+
+        channel->pending_ctrl = 0;
+
+        for(j = 0; ctrl != 0; j++, ctrl >>= 1)
+        {
+            if(ctrl & 1)
+            {
+                for(voice = channel->voices; voice != NULL; voice = voice->chan_next)
+                {
+                    fluid_voice_modulate(voice, 0, j);
+                }
+            }
+        }
+    }
+
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Update voices on a MIDI channel after all MIDI controllers have been changed.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+static int
+fluid_synth_modulate_voices_all_LOCAL(fluid_synth_t *synth, int chan)
+{
+    fluid_channel_t *channel = synth->channel[chan];
+    fluid_voice_t *voice;
+
+    /* nothing left pending on the channel */
+    FLUID_MEMSET(channel->pending_cc, 0, sizeof(channel->pending_cc));
+    channel->pending_ctrl = 0;
+
+    for(voice = channel->voices; voice != NULL; voice = voice->chan_next)
+    {
+        fluid_voice_modulate_all(voice);
+    }
+
+    return FLUID_OK;
+}
+
+/**
  * Set the MIDI channel pressure controller value.
  * @param synth FluidSynth instance
  * @param chan MIDI channel number (0 to MIDI channel count - 1)
@@ -2498,21 +3404,15 @@ static int
 fluid_synth_update_key_pressure_LOCAL(fluid_synth_t *synth, int chan, int key)
 {
     fluid_voice_t *voice;
-    int i;
     int result = FLUID_OK;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->key_voices[key]; voice != NULL; voice = voice->key_next)
     {
-        voice = synth->voice[i];
+        result = fluid_voice_modulate(voice, 0, FLUID_MOD_KEYPRESSURE);
 
-        if(voice->chan == chan && voice->key == key)
+        if(result != FLUID_OK)
         {
-            result = fluid_voice_modulate(voice, 0, FLUID_MOD_KEYPRESSURE);
-
-            if(result != FLUID_OK)
-            {
-                return result;
-            }
+            return result;
         }
     }
 
@@ -2525,16 +3425,34 @@ fluid_synth_update_key_pressure_LOCAL(fluid_synth_t *synth, int chan, int key)
  * @param chan MIDI channel number (0 to MIDI channel count - 1)
  * @param val MIDI pitch bend value (0-16383 with 8192 being center)
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @note If "synth.lock-free-api" is enabled, the event is queued and #FLUID_OK
+ * is returned before it has actually been processed.
  */
 int
 fluid_synth_pitch_bend(fluid_synth_t *synth, int chan, int val)
 {
     int result;
     fluid_return_val_if_fail(val >= 0 && val <= 16383, FLUID_FAILED);
+
+    if(fluid_synth_queue_api_event(synth, FLUID_API_EVENT_PITCH_BEND, chan, val, 0))
+    {
+        return FLUID_OK;
+    }
+
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    result = fluid_synth_process_pitch_bend(synth, chan, val);
+    FLUID_API_RETURN(result);
+}
 
+/* Body of fluid_synth_pitch_bend, the API must have been entered */
+static int
+fluid_synth_process_pitch_bend(fluid_synth_t *synth, int chan, int val)
+{
     /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    if(!(synth->channel[chan]->mode & FLUID_CHANNEL_ENABLED))
+    {
+        return FLUID_FAILED;
+    }
 
     if(synth->verbose)
     {
@@ -2542,9 +3460,7 @@ fluid_synth_pitch_bend(fluid_synth_t *synth, int chan, int val)
     }
 
     fluid_channel_set_pitch_bend(synth->channel[chan], val);
-    result = fluid_synth_update_pitch_bend_LOCAL(synth, chan);
-
-    FLUID_API_RETURN(result);
+    return fluid_synth_update_pitch_bend_LOCAL(synth, chan);
 }
 
 /* Local synthesis thread variant of pitch bend */
@@ -2657,6 +3573,9 @@ fluid_synth_set_preset(fluid_synth_t *synth, int chan, fluid_preset_t *preset)
     return fluid_channel_set_preset(channel, preset);
 }
 
+/* Value of the preset index for bank and program numbers found in no SoundFont */
+static char fluid_synth_no_preset;
+
 /* Get a preset by SoundFont, bank and program numbers.
  * Returns preset pointer or NULL.
  */
@@ -2664,8 +3583,10 @@ static fluid_preset_t *
 fluid_synth_get_preset(fluid_synth_t *synth, int sfontnum,
                        int banknum, int prognum)
 {
+    fluid_preset_t *preset;
     fluid_sfont_t *sfont;
     fluid_list_t *list;
+    void *key;
 
     /* 128 indicates an "unset" operation" */
     if(prognum == FLUID_UNSET_PROGRAM)
@@ -2673,6 +3594,18 @@ fluid_synth_get_preset(fluid_synth_t *synth, int sfontnum,
         return NULL;
     }
 
+    /* the preset found before by bank and program may be the one of this SoundFont */
+    if(fluid_synth_preset_index_key(banknum, prognum, &key))
+    {
+        preset = fluid_hashtable_lookup(synth->preset_index, key);
+
+        if(preset != NULL && preset != (fluid_preset_t *)&fluid_synth_no_preset
+                && fluid_sfont_get_id(fluid_preset_get_sfont(preset)) == sfontnum)
+        {
+            return preset;
+        }
+    }
+
     for(list = synth->sfont; list; list = fluid_list_next(list))
     {
         sfont = fluid_list_get(list);
@@ -2709,6 +3642,19 @@ fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname
     return NULL;
 }
 
+/* Key of the preset index, if the bank and program numbers fit into one */
+static int
+fluid_synth_preset_index_key(int banknum, int prognum, void **key)
+{
+    if(banknum < 0 || banknum >= (1 << 22) || prognum < 0 || prognum > 0xff)
+    {
+        return FALSE;
+    }
+
+    *key = FLUID_INT_TO_POINTER(banknum << 8 | prognum);
+    return TRUE;
+}
+
 /* Find a preset by bank and program numbers.
  * Returns preset pointer or NULL.
  */
@@ -2719,6 +3665,21 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
     fluid_preset_t *preset;
     fluid_sfont_t *sfont;
     fluid_list_t *list;
+    void *key;
+    int indexed;
+
+    /* presets found before, or known to be missing, are taken from the index */
+    indexed = fluid_synth_preset_index_key(banknum, prognum, &key);
+
+    if(indexed)
+    {
+        preset = fluid_hashtable_lookup(synth->preset_index, key);
+
+        if(preset != NULL)
+        {
+            return (preset == (fluid_preset_t *)&fluid_synth_no_preset) ? NULL : preset;
+        }
+    }
 
     for(list = synth->sfont; list; list = fluid_list_next(list))
     {
@@ -2728,11 +3689,64 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
 
         if(preset)
         {
-            return preset;
+            break;
         }
     }
 
-    return NULL;
+    if(!list)
+    {
+        preset = NULL;
+    }
+
+    if(indexed)
+    {
+        fluid_hashtable_insert(synth->preset_index, key,
+                               preset ? preset : (fluid_preset_t *)&fluid_synth_no_preset);
+    }
+
+    return preset;
+}
+
+/* Drop the presets of the SoundFont from the preset index */
+static int
+fluid_synth_preset_index_match_sfont(void *key, void *value, void *user_data)
+{
+    return (value != &fluid_synth_no_preset
+            && fluid_preset_get_sfont((fluid_preset_t *)value) == (fluid_sfont_t *)user_data);
+}
+
+/* Update the preset index for a SoundFont removed from the sfont list:
+ * the presets found in other SoundFonts and the missing ones stay the same */
+static void
+fluid_synth_preset_index_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_hashtable_foreach_steal(synth->preset_index, fluid_synth_preset_index_match_sfont, sfont);
+}
+
+/* Update the preset index for a SoundFont put on top of the sfont list:
+ * its presets now hide the ones looked up before, look them up again */
+static void
+fluid_synth_preset_index_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_preset_t *preset;
+    void *key;
+
+    if(sfont->iteration_start == NULL || sfont->iteration_next == NULL)
+    {
+        fluid_hashtable_remove_all(synth->preset_index);
+        return;
+    }
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        if(fluid_synth_preset_index_key(fluid_preset_get_banknum(preset) + sfont->bankofs,
+                                        fluid_preset_get_num(preset), &key))
+        {
+            fluid_hashtable_remove(synth->preset_index, key);
+        }
+    }
 }
 
 /**
@@ -2741,6 +3755,8 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
  * @param chan MIDI channel number (0 to MIDI channel count - 1)
  * @param prognum MIDI program number (0-127)
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @note If "synth.lock-free-api" is enabled, the event is queued and #FLUID_OK
+ * is returned before it has actually been processed.
  */
 /* FIXME - Currently not real-time safe, due to preset allocation and mutex lock,
  * and may be called from within synthesis context. */
@@ -2750,27 +3766,93 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
 int
 fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
 {
-    fluid_preset_t *preset = NULL;
-    fluid_channel_t *channel;
-    int subst_bank, subst_prog, banknum = 0, result = FLUID_FAILED;
-
+    int result;
     fluid_return_val_if_fail(prognum >= 0 && prognum <= 128, FLUID_FAILED);
+
+    if(fluid_synth_queue_api_event(synth, FLUID_API_EVENT_PROGRAM_CHANGE, chan, prognum, 0))
+    {
+        return FLUID_OK;
+    }
+
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    result = fluid_synth_process_program_change(synth, chan, prognum);
+    FLUID_API_RETURN(result);
+}
 
-    /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+/* The preset a program change selects on a channel with the bank it has, without
+ * logging: the program of the bank, or the fallback if there is none.
+ * subst_bank and subst_prog are set to the bank and program found. */
+static fluid_preset_t *
+fluid_synth_find_program_preset(fluid_synth_t *synth, fluid_channel_t *channel, int banknum, int prognum,
+                                int *subst_bank, int *subst_prog)
+{
+    fluid_preset_t *preset;
 
-    channel = synth->channel[chan];
+    *subst_bank = banknum;
+    *subst_prog = prognum;
 
-    if(channel->channel_type == CHANNEL_TYPE_DRUM)
+    preset = fluid_synth_find_preset(synth, *subst_bank, *subst_prog);
+
+    /* Fallback to another preset if not found */
+    if(!preset)
     {
-        banknum = DRUM_INST_BANK;
+        /* Percussion: Fallback to preset 0 in percussion bank */
+        if(channel->channel_type == CHANNEL_TYPE_DRUM)
+        {
+            *subst_prog = 0;
+            *subst_bank = DRUM_INST_BANK;
+            preset = fluid_synth_find_preset(synth, *subst_bank, *subst_prog);
+        }
+        /* Melodic instrument */
+        else
+        {
+            /* Fallback first to bank 0:prognum */
+            *subst_bank = 0;
+            preset = fluid_synth_find_preset(synth, *subst_bank, *subst_prog);
+
+            /* Fallback to first preset in bank 0 (usually piano...) */
+            if(!preset)
+            {
+                *subst_prog = 0;
+                preset = fluid_synth_find_preset(synth, *subst_bank, *subst_prog);
+            }
+        }
     }
-    else
+
+    return preset;
+}
+
+/* The bank a program change selects from on a channel */
+static int
+fluid_synth_get_program_bank(fluid_channel_t *channel)
+{
+    int banknum = DRUM_INST_BANK;
+
+    if(channel->channel_type != CHANNEL_TYPE_DRUM)
     {
         fluid_channel_get_sfont_bank_prog(channel, NULL, &banknum, NULL);
     }
 
+    return banknum;
+}
+
+/* Body of fluid_synth_program_change, the API must have been entered */
+static int
+fluid_synth_process_program_change(fluid_synth_t *synth, int chan, int prognum)
+{
+    fluid_preset_t *preset = NULL;
+    fluid_channel_t *channel;
+    int subst_bank, subst_prog, banknum;
+
+    /* Allowed only on MIDI channel enabled */
+    if(!(synth->channel[chan]->mode & FLUID_CHANNEL_ENABLED))
+    {
+        return FLUID_FAILED;
+    }
+
+    channel = synth->channel[chan];
+    banknum = fluid_synth_get_program_bank(channel);
+
     if(synth->verbose)
     {
         FLUID_LOG(FLUID_INFO, "prog\t%d\t%d\t%d", chan, banknum, prognum);
@@ -2784,36 +3866,10 @@ fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
     */
     if(prognum != FLUID_UNSET_PROGRAM)
     {
-        subst_bank = banknum;
-        subst_prog = prognum;
+        preset = fluid_synth_find_program_preset(synth, channel, banknum, prognum, &subst_bank, &subst_prog);
 
-        preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-
-        /* Fallback to another preset if not found */
-        if(!preset)
+        if(preset == NULL || subst_bank != banknum || subst_prog != prognum)
         {
-            /* Percussion: Fallback to preset 0 in percussion bank */
-            if(channel->channel_type == CHANNEL_TYPE_DRUM)
-            {
-                subst_prog = 0;
-                subst_bank = DRUM_INST_BANK;
-                preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-            }
-            /* Melodic instrument */
-            else
-            {
-                /* Fallback first to bank 0:prognum */
-                subst_bank = 0;
-                preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-
-                /* Fallback to first preset in bank 0 (usually piano...) */
-                if(!preset)
-                {
-                    subst_prog = 0;
-                    preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-                }
-            }
-
             if(preset)
             {
                 FLUID_LOG(FLUID_WARN, "Instrument not found on channel %d [bank=%d prog=%d], substituted [bank=%d prog=%d]",
@@ -2829,9 +3885,72 @@ fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
     /* Assign the SoundFont ID and program number to the channel */
     fluid_channel_set_sfont_bank_prog(channel, preset ? fluid_sfont_get_id(preset->sfont) : 0,
                                       -1, prognum);
-    result = fluid_synth_set_preset(synth, chan, preset);
+    return fluid_synth_set_preset(synth, chan, preset);
+}
 
-    FLUID_API_RETURN(result);
+/*
+ * Hint the loader of the preset a program change would select on a channel,
+ * after the bank select messages bank_msb and bank_lsb (-1 if none), that it
+ * is about to be selected, e.g. for it to load its samples in advance
+ * (FLUID_PRESET_PRELOAD). The channel itself is left unchanged.
+ * Returns the preset, kept along with its SoundFont until passed to
+ * fluid_synth_release_preloaded_preset(), or NULL if none would be selected.
+ */
+fluid_preset_t *
+fluid_synth_preload_program(fluid_synth_t *synth, int chan, int bank_msb, int bank_lsb, int prognum)
+{
+    fluid_preset_t *preset;
+    fluid_channel_t *channel;
+    int sfont_bank_prog, channel_type, subst_bank, subst_prog;
+    fluid_return_val_if_fail(prognum >= 0 && prognum <= 127, NULL);
+    FLUID_API_ENTRY_CHAN(NULL);
+
+    channel = synth->channel[chan];
+
+    /* the bank the channel would have, as set by the bank select messages */
+    sfont_bank_prog = channel->sfont_bank_prog;
+    channel_type = channel->channel_type;
+
+    if(bank_msb >= 0)
+    {
+        fluid_channel_set_bank_msb(channel, bank_msb & 0x7F);
+    }
+
+    if(bank_lsb >= 0)
+    {
+        fluid_channel_set_bank_lsb(channel, bank_lsb & 0x7F);
+    }
+
+    preset = fluid_synth_find_program_preset(synth, channel, fluid_synth_get_program_bank(channel), prognum,
+                                             &subst_bank, &subst_prog);
+
+    channel->sfont_bank_prog = sfont_bank_prog;
+    channel->channel_type = channel_type;
+
+    if(preset != NULL)
+    {
+        fluid_atomic_int_inc(&preset->sfont->refcount);
+        fluid_preset_notify(preset, FLUID_PRESET_PRELOAD, chan);
+    }
+
+    FLUID_API_RETURN(preset);
+}
+
+/*
+ * Release a preset returned by fluid_synth_preload_program(), once selected or
+ * no longer about to be (FLUID_PRESET_PRELOAD_DONE).
+ */
+void
+fluid_synth_release_preloaded_preset(fluid_synth_t *synth, fluid_preset_t *preset, int chan)
+{
+    fluid_return_if_fail(synth != NULL);
+    fluid_return_if_fail(preset != NULL);
+    fluid_synth_api_enter(synth);
+
+    fluid_preset_notify(preset, FLUID_PRESET_PRELOAD_DONE, chan);
+    fluid_synth_sfont_unref(synth, preset->sfont);
+
+    fluid_synth_api_exit(synth);
 }
 
 /**
@@ -3059,10 +4178,10 @@ fluid_synth_update_presets(fluid_synth_t *synth)
  * Set up an event to change the sample-rate of the synth during the next rendering call.
  * @warning This function is broken-by-design! Don't use it! Instead, specify the sample-rate when creating the synth.
  * @deprecated As of fluidsynth 2.1.0 this function has been deprecated.
- * Changing the sample-rate is generally not considered to be a real-time use-case, as it always produces some audible artifact ("click", "pop") on the dry sound and effects (because LFOs for chorus and reverb need to be reinitialized).
- * The sample-rate change may also require memory allocation deep down in the effect units.
- * However, this memory allocation may fail and there is no way for the caller to know that, because the actual change of the sample-rate is executed during rendering.
- * This function cannot (must not) do the sample-rate change itself, otherwise the synth needs to be locked down, causing rendering to block.
+ * Changing the sample-rate is generally not considered to be a real-time use-case, as it always produces some audible artifact ("click", "pop") on the dry sound and effects (because all playing voices are stopped and the chorus and reverb start over empty).
+ * The effect units for the new sample-rate are allocated by this function, in the calling thread, and swapped in between two blocks of the next rendering call, which doesn't allocate nor free any memory (unless LADSPA effects are active).
+ * If the allocation fails, an error is logged and the sample-rate remains unchanged.
+ * The units replaced are freed by the next call of this function, or by delete_fluid_synth().
  * Esp. do not use this function if this @p synth instance is used by an audio driver, because the audio driver cannot be notified by this sample-rate change.
  * Long story short: don't use it.
  * @code{.cpp}
@@ -3089,6 +4208,30 @@ fluid_synth_set_sample_rate(fluid_synth_t *synth, float sample_rate)
     fluid_return_if_fail(synth != NULL);
     fluid_synth_api_enter(synth);
     fluid_clip(sample_rate, 8000.0f, 96000.0f);
+
+    /* keep rendering at the same ratio to the output */
+    synth->output_rate = sample_rate;
+    sample_rate = sample_rate * synth->upsample_den / synth->upsample_num;
+
+    /* free the effects units replaced by previous changes */
+    fluid_synth_free_replaced_rates(synth, FALSE);
+
+    if(synth->sample_rate == sample_rate)
+    {
+        fluid_synth_api_exit(synth);
+        return;
+    }
+
+    /* replace the units created so far by ones for the new sample-rate */
+    if(fluid_synth_change_fx_units(synth, sample_rate,
+                                   synth->with_reverb_units ? FLUID_MIXER_FX_NEW : FLUID_MIXER_FX_KEEP,
+                                   synth->with_chorus_units ? FLUID_MIXER_FX_NEW : FLUID_MIXER_FX_KEEP) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to change the sample-rate to %.0f Hz", sample_rate);
+        fluid_synth_api_exit(synth);
+        return;
+    }
+
     synth->sample_rate = sample_rate;
 
     synth->min_note_length_ticks = fluid_synth_get_min_note_length_LOCAL(synth);
@@ -3098,32 +4241,174 @@ fluid_synth_set_sample_rate(fluid_synth_t *synth, float sample_rate)
         fluid_voice_set_output_rate(synth->voice[i], sample_rate);
     }
 
-    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_samplerate,
-                             0, sample_rate);
+    /* all of it is flushed at once, so that it happens between two blocks */
     fluid_synth_api_exit(synth);
 }
 
-
-/* Handler for synth.gain setting. */
-static void
-fluid_synth_handle_gain(void *data, const char *name, double value)
-{
-    fluid_synth_t *synth = (fluid_synth_t *)data;
-    fluid_synth_set_gain(synth, (float) value);
-}
-
-/**
- * Set synth output gain value.
- * @param synth FluidSynth instance
- * @param gain Gain value (function clamps value to the range 0.0 to 10.0)
+/*
+ * Allocate the reverb or chorus units of all fx units here, rather than in the rendering
+ * thread, to be swapped in between two blocks along with the current parameters.
+ * @param reverb What to do with the reverb units, see #fluid_mixer_fx_change
+ * @param chorus What to do with the chorus units, see #fluid_mixer_fx_change
  */
-void
-fluid_synth_set_gain(fluid_synth_t *synth, float gain)
+static int
+fluid_synth_change_fx_units(fluid_synth_t *synth, fluid_real_t sample_rate, int reverb, int chorus)
 {
-    fluid_return_if_fail(synth != NULL);
-    fluid_synth_api_enter(synth);
+    fluid_rvoice_mixer_rate_t *rate;
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
 
-    fluid_clip(gain, 0.0f, 10.0f);
+    rate = new_fluid_rvoice_mixer_rate(synth->eventhandler->mixer, sample_rate, reverb, chorus);
+
+    if(rate == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    synth->replaced_rates = fluid_list_prepend(synth->replaced_rates, rate);
+    fluid_rvoice_eventhandler_push_ptr(synth->eventhandler, fluid_rvoice_mixer_set_rate,
+                                       synth->eventhandler->mixer, rate);
+
+    if(reverb != FLUID_MIXER_FX_KEEP)
+    {
+        synth->with_reverb_units = (reverb == FLUID_MIXER_FX_NEW);
+    }
+
+    if(chorus != FLUID_MIXER_FX_KEEP)
+    {
+        synth->with_chorus_units = (chorus == FLUID_MIXER_FX_NEW);
+    }
+
+    /* the new units know nothing of the current reverb and chorus parameters */
+    param[0].i = FLUID_REVMODEL_SET_ALL;
+    param[1].real = synth->reverb_roomsize;
+    param[2].real = synth->reverb_damping;
+    param[3].real = synth->reverb_width;
+    param[4].real = synth->reverb_level;
+    fluid_rvoice_eventhandler_push(synth->eventhandler, fluid_rvoice_mixer_set_reverb_params,
+                                   synth->eventhandler->mixer, param, 5);
+
+    param[0].i = FLUID_CHORUS_SET_ALL;
+    param[1].i = synth->chorus_nr;
+    param[2].real = synth->chorus_level;
+    param[3].real = synth->chorus_speed;
+    param[4].real = synth->chorus_depth;
+    param[5].i = synth->chorus_type;
+    fluid_rvoice_eventhandler_push(synth->eventhandler, fluid_rvoice_mixer_set_chorus_params,
+                                   synth->eventhandler->mixer, param, 6);
+
+    return FLUID_OK;
+}
+
+/*
+ * Create the units of the effects turned on, and remove those of the effects turned off
+ * for synth.effects-release-time, then delete the units swapped out already.
+ */
+static void
+fluid_synth_update_fx_units(fluid_synth_t *synth)
+{
+    int reverb = FLUID_MIXER_FX_KEEP, chorus = FLUID_MIXER_FX_KEEP;
+    unsigned int now;
+
+    if(synth->with_reverb != synth->with_reverb_units || synth->with_chorus != synth->with_chorus_units)
+    {
+        now = fluid_curtime();
+
+        if(synth->with_reverb != synth->with_reverb_units
+                && (synth->with_reverb || now - synth->reverb_off_time >= (unsigned int)synth->fx_release_time))
+        {
+            reverb = synth->with_reverb ? FLUID_MIXER_FX_NEW : FLUID_MIXER_FX_REMOVE;
+        }
+
+        if(synth->with_chorus != synth->with_chorus_units
+                && (synth->with_chorus || now - synth->chorus_off_time >= (unsigned int)synth->fx_release_time))
+        {
+            chorus = synth->with_chorus ? FLUID_MIXER_FX_NEW : FLUID_MIXER_FX_REMOVE;
+        }
+
+        if((reverb != FLUID_MIXER_FX_KEEP || chorus != FLUID_MIXER_FX_KEEP)
+                && fluid_synth_change_fx_units(synth, synth->sample_rate, reverb, chorus) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to create the effects units");
+        }
+    }
+
+    fluid_synth_free_replaced_rates(synth, FALSE);
+
+    /* checked again by fluid_synth_api_enter() */
+    synth->fx_units_pending = (synth->with_reverb != synth->with_reverb_units
+                               || synth->with_chorus != synth->with_chorus_units
+                               || synth->replaced_rates != NULL);
+}
+
+/*
+ * Delete the effects units replaced by sample-rate changes. Unless @p all is set,
+ * only those of the changes the rendering thread has swapped in already.
+ */
+static void
+fluid_synth_free_replaced_rates(fluid_synth_t *synth, int all)
+{
+    fluid_list_t *list, *next;
+    fluid_rvoice_mixer_rate_t *rate;
+
+    for(list = synth->replaced_rates; list; list = next)
+    {
+        next = fluid_list_next(list);
+        rate = fluid_list_get(list);
+
+        if(all || fluid_rvoice_mixer_rate_is_swapped(rate))
+        {
+            delete_fluid_rvoice_mixer_rate(rate);
+            synth->replaced_rates = fluid_list_remove_link(synth->replaced_rates, list);
+            delete1_fluid_list(list);
+        }
+    }
+}
+
+/*
+ * Delete the convolution reverbs replaced by fluid_synth_set_reverb_group_ir(). Unless
+ * @p all is set, only those the rendering thread has swapped out already.
+ */
+static void
+fluid_synth_free_replaced_irs(fluid_synth_t *synth, int all)
+{
+    fluid_list_t *list, *next;
+    fluid_rvoice_mixer_ir_t *ir;
+
+    for(list = synth->replaced_irs; list; list = next)
+    {
+        next = fluid_list_next(list);
+        ir = fluid_list_get(list);
+
+        if(all || fluid_rvoice_mixer_ir_is_swapped(ir))
+        {
+            delete_fluid_rvoice_mixer_ir(ir);
+            synth->replaced_irs = fluid_list_remove_link(synth->replaced_irs, list);
+            delete1_fluid_list(list);
+        }
+    }
+}
+
+
+/* Handler for synth.gain setting. */
+static void
+fluid_synth_handle_gain(void *data, const char *name, double value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_synth_set_gain(synth, (float) value);
+}
+
+/**
+ * Set synth output gain value.
+ * @param synth FluidSynth instance
+ * @param gain Gain value (function clamps value to the range 0.0 to 10.0)
+ */
+void
+fluid_synth_set_gain(fluid_synth_t *synth, float gain)
+{
+    fluid_return_if_fail(synth != NULL);
+    fluid_synth_api_enter(synth);
+
+    fluid_clip(gain, 0.0f, 10.0f);
 
     synth->gain = gain;
     fluid_synth_update_gain_LOCAL(synth);
@@ -3197,11 +4482,55 @@ fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony)
     FLUID_API_RETURN(result);
 }
 
+/*
+ * Create the voices synth->voice[from..to-1], their rvoices in one slab.
+ * On failure, none of them is left.
+ */
+static int
+fluid_synth_alloc_voices_LOCAL(fluid_synth_t *synth, int from, int to)
+{
+    fluid_rvoice_slab_t *slab;
+    int i;
+
+    slab = new_fluid_rvoice_slab(2 * (to - from));
+
+    if(slab == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    synth->rvoice_slabs = fluid_list_prepend(synth->rvoice_slabs, slab);
+
+    /* the rvoice and overflow rvoice of a voice are next to each other */
+    for(i = from; i < to; i++)
+    {
+        synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate,
+                                          fluid_rvoice_slab_get(slab, 2 * (i - from)),
+                                          fluid_rvoice_slab_get(slab, 2 * (i - from) + 1));
+
+        if(synth->voice[i] == NULL)
+        {
+            /* the slab is freed with the others by delete_fluid_synth() */
+            while(--i >= from)
+            {
+                delete_fluid_voice(synth->voice[i]);
+                synth->voice[i] = NULL;
+            }
+
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
 /* Called by synthesis thread to update the polyphony value */
 static int
 fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
 {
+    fluid_rvoice_t *rvoices[MAX_EVENT_PARAMS];
     fluid_voice_t *voice;
+    int count = 0;
     int i;
 
     if(new_polyphony > synth->nvoice)
@@ -3217,15 +4546,23 @@ fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
 
         synth->voice = new_voices;
 
-        for(i = synth->nvoice; i < new_polyphony; i++)
+        new_voices = FLUID_REALLOC(synth->overflow_heap,
+                                   sizeof(fluid_voice_t *) * new_polyphony);
+
+        if(new_voices == NULL)
         {
-            synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate);
+            return FLUID_FAILED;
+        }
 
-            if(synth->voice[i] == NULL)
-            {
-                return FLUID_FAILED;
-            }
+        synth->overflow_heap = new_voices;
+
+        if(fluid_synth_alloc_voices_LOCAL(synth, synth->nvoice, new_polyphony) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
 
+        for(i = synth->nvoice; i < new_polyphony; i++)
+        {
             fluid_voice_set_custom_filter(synth->voice[i], synth->custom_filter_type, synth->custom_filter_flags);
         }
 
@@ -3233,18 +4570,30 @@ fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
     }
 
     synth->polyphony = new_polyphony;
+    fluid_synth_rebuild_overflow_heap_LOCAL(synth);
 
-    /* turn off any voices above the new limit */
+    /* turn off any voices above the new limit, a batch of them per event */
     for(i = synth->polyphony; i < synth->nvoice; i++)
     {
         voice = synth->voice[i];
 
         if(fluid_voice_is_playing(voice))
         {
-            fluid_voice_off(voice);
+            rvoices[count++] = voice->rvoice;
+
+            if(count == MAX_EVENT_PARAMS)
+            {
+                fluid_rvoice_eventhandler_rvoices_off(synth->eventhandler, rvoices, count);
+                count = 0;
+            }
         }
     }
 
+    if(count > 0)
+    {
+        fluid_rvoice_eventhandler_rvoices_off(synth->eventhandler, rvoices, count);
+    }
+
     fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
                              synth->polyphony, 0.0f);
 
@@ -3297,12 +4646,79 @@ fluid_synth_get_active_voice_count(fluid_synth_t *synth)
     FLUID_API_RETURN(result);
 }
 
+/**
+ * Reserve a number of voices to a MIDI channel, for when the polyphony is exhausted.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1), -1 for all channels
+ * @param quota Number of voices reserved to the channel, 0 for none (the default)
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * As long as voices are available, a channel borrows as many as it needs beyond its quota.
+ * Once the polyphony is exhausted, the voices to start new ones are no longer stolen from
+ * all channels alike: a channel playing as many voices as its quota, or more, kills one of
+ * its own voices, and the other channels take theirs back from the channels borrowing
+ * beyond their quota, the ones without quota included. A channel playing its quota is left
+ * alone, so that e.g. the drums keep playing while a pad with the sustain pedal down
+ * exhausts the polyphony. Only if no channel borrows does a channel playing fewer voices
+ * than its quota kill any voice, so the quotas should not add up to more than the polyphony.
+ *
+ * The quotas are kept by fluid_synth_system_reset() and fluid_synth_reset_to_initial_state().
+ * @since 2.2.0
+ */
+int
+fluid_synth_set_voice_quota(fluid_synth_t *synth, int chan, int quota)
+{
+    int i;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(quota >= 0 && quota <= 65535, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    if(chan < -1 || chan >= synth->midi_channels)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    for(i = 0; i < synth->midi_channels; i++)
+    {
+        fluid_channel_t *channel = synth->channel[i];
+
+        if(chan >= 0 && i != chan)
+        {
+            continue;
+        }
+
+        synth->voice_quota_channels += (quota > 0) - (channel->voice_quota > 0);
+        channel->voice_quota = quota;
+    }
+
+    FLUID_API_RETURN(FLUID_OK);
+}
+
+/**
+ * Get the number of voices reserved to a MIDI channel, see fluid_synth_set_voice_quota().
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @return The voice quota of the channel, 0 if none, #FLUID_FAILED on error
+ * @since 2.2.0
+ */
+int
+fluid_synth_get_voice_quota(fluid_synth_t *synth, int chan)
+{
+    int result;
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+
+    result = synth->channel[chan]->voice_quota;
+    FLUID_API_RETURN(result);
+}
+
 /**
  * Get the internal synthesis buffer size value.
  * @param synth FluidSynth instance
  * @return Internal buffer size in audio frames.
  *
- * Audio is synthesized this number of frames at a time.  Defaults to 64 frames.
+ * Audio is synthesized this number of frames at a time.  Defaults to 64 frames,
+ * other sizes can be chosen with the \c block-size build option.
  */
 int
 fluid_synth_get_internal_bufsize(fluid_synth_t *synth)
@@ -3397,7 +4813,6 @@ fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
 #ifdef WITH_FLOAT
     int bytes;
 #endif
-    float cpu_load;
 
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(left != NULL, FLUID_FAILED);
@@ -3548,9 +4963,7 @@ fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
 
     synth->cur = num;
 
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+    fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
 
     return FLUID_OK;
 }
@@ -3683,7 +5096,6 @@ fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
     double time = fluid_utime();
     int i, f, num, count, buffered_blocks;
 
-    float cpu_load;
 
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(nfx % 2 == 0, FLUID_FAILED);
@@ -3792,83 +5204,351 @@ fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
 
     synth->cur = num;
 
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+    fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
 
     return FLUID_OK;
 }
 
-/**
- * Synthesize a block of floating point audio samples to audio buffers.
- * @param synth FluidSynth instance
- * @param len Count of audio frames to synthesize
- * @param lout Array of floats to store left channel of audio
- * @param loff Offset index in 'lout' for first sample
- * @param lincr Increment between samples stored to 'lout'
- * @param rout Array of floats to store right channel of audio
- * @param roff Offset index in 'rout' for first sample
- * @param rincr Increment between samples stored to 'rout'
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- *
- * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
- * lincr = 2, rincr = 2).
- *
- * @note Should only be called from synthesis thread.
- * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
- */
-int
-fluid_synth_write_float(fluid_synth_t *synth, int len,
-                        void *lout, int loff, int lincr,
-                        void *rout, int roff, int rincr)
+static FLUID_INLINE void fluid_synth_copy_single_buffer(float *FLUID_RESTRICT out,
+                                                      int ooff,
+                                                      const fluid_real_t *FLUID_RESTRICT in,
+                                                      int ioff,
+                                                      int buf_idx,
+                                                      int num)
 {
-    return fluid_synth_write_float_LOCAL(synth, len, lout, loff, lincr, rout, roff, rincr, fluid_synth_render_blocks);
+    if(out != NULL)
+    {
+        int j;
+
+        in += buf_idx * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + ioff;
+        out += ooff;
+
+        for(j = 0; j < num; j++)
+        {
+            out[j] = (float) in[j];
+        }
+    }
 }
 
-int
-fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
-                              void *lout, int loff, int lincr,
-                              void *rout, int roff, int rincr,
-                              int (*block_render_func)(fluid_synth_t *, int)
-                             )
+/*
+ * Copies num frames of every stereo pair of mixer buffers, starting at frame ioff,
+ * to the buffers of the same index, starting at frame ooff.
+ */
+static void
+fluid_synth_copy_buffers(int nfx, float *fx[], int nout, float *out[], int ooff,
+                         const fluid_real_t *left_in, const fluid_real_t *right_in,
+                         const fluid_real_t *fx_left_in, const fluid_real_t *fx_right_in,
+                         int ioff, int num)
 {
-    int n, cur, size;
-    float *left_out = (float *) lout + loff;
-    float *right_out = (float *) rout + roff;
-    fluid_real_t *left_in;
-    fluid_real_t *right_in;
-    double time = fluid_utime();
-    float cpu_load;
-
-    fluid_profile_ref_var(prof_ref);
+    int i;
 
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(lout != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(rout != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
-    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+    for(i = 0; i < nout / 2; i++)
+    {
+        fluid_synth_copy_single_buffer(out[i * 2], ooff, left_in, ioff, i, num);
+        fluid_synth_copy_single_buffer(out[i * 2 + 1], ooff, right_in, ioff, i, num);
+    }
 
-    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, 1);
-    fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
+    for(i = 0; i < nfx / 2; i++)
+    {
+        fluid_synth_copy_single_buffer(fx[i * 2], ooff, fx_left_in, ioff, i, num);
+        fluid_synth_copy_single_buffer(fx[i * 2 + 1], ooff, fx_right_in, ioff, i, num);
+    }
+}
 
-    size = len;
-    cur = synth->cur;
+/*
+ * Interleaves num frames of the first npairs stereo pairs of mixer buffers, starting at
+ * frame ioff, to the channels of out, starting at frame ooff.
+ */
+static FLUID_INLINE void
+fluid_synth_interleave_pairs(float *FLUID_RESTRICT out, int nchannels, int ooff,
+                             const fluid_real_t *FLUID_RESTRICT left_in,
+                             const fluid_real_t *FLUID_RESTRICT right_in,
+                             int npairs, int ioff, int num)
+{
+    int i, j;
 
-    do
+    for(i = 0; i < npairs; i++)
     {
-        /* fill up the buffers as needed */
-        if(cur >= synth->curmax)
+        const fluid_real_t *l = left_in + i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + ioff;
+        const fluid_real_t *r = right_in + i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + ioff;
+        float *o = out + ooff * nchannels + i * 2;
+
+        for(j = 0; j < num; j++)
         {
-            int blocksleft = (size + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
-            synth->curmax = FLUID_BUFSIZE * block_render_func(synth, blocksleft);
-            fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
-            cur = 0;
+            o[j * nchannels] = (float) l[j];
+            o[j * nchannels + 1] = (float) r[j];
         }
+    }
+}
 
-        /* calculate amount of available samples */
-        n = synth->curmax - cur;
-
-        /* keep track of emitted samples */
+/*
+ * Renders len frames and writes them either to the planar buffers fx and out (see
+ * fluid_synth_copy_buffers()) or, if interleaved isn't NULL, to its nchannels channels,
+ * the audio channels first and the effects channels, if any, after them.
+ * The buffer counts must have been checked by the caller.
+ */
+static int
+fluid_synth_write_channels_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
+                                 int nout, float *out[], int nchannels, float *interleaved)
+{
+    fluid_real_t *left_in, *fx_left_in;
+    fluid_real_t *right_in, *fx_right_in;
+
+    double time = fluid_utime();
+    int num, count, buffered_blocks, ioff;
+    int naudchan = synth->audio_channels;
+    int nfxpairs = (nchannels - 2 * naudchan) / 2;
+
+    fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
+    fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left_in, &fx_right_in);
+
+    /* without buffers for them, reverb and chorus are mixed to the audio channels */
+    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, interleaved != NULL && nfxpairs == 0);
+
+    /* First, take what's still available in the buffer, then render blocks and copy till we have 'len' samples */
+    count = 0;
+    num = synth->cur;
+
+    buffered_blocks = (synth->cur + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+
+    while(count < len)
+    {
+        if(count == 0 && synth->cur < buffered_blocks * FLUID_BUFSIZE)
+        {
+            int available = (buffered_blocks * FLUID_BUFSIZE) - synth->cur;
+            num = (available > len) ? len : available;
+            ioff = synth->cur;
+        }
+        else
+        {
+            int blocksleft = (len - count + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+            int blockcount = fluid_synth_render_blocks(synth, blocksleft);
+
+            num = (blockcount * FLUID_BUFSIZE > len - count) ? len - count : blockcount * FLUID_BUFSIZE;
+            ioff = 0;
+        }
+
+        if(interleaved != NULL)
+        {
+            fluid_synth_interleave_pairs(interleaved, nchannels, count, left_in, right_in,
+                                         naudchan, ioff, num);
+            fluid_synth_interleave_pairs(interleaved + 2 * naudchan, nchannels, count, fx_left_in, fx_right_in,
+                                         nfxpairs, ioff, num);
+        }
+        else
+        {
+            fluid_synth_copy_buffers(nfx, fx, nout, out, count, left_in, right_in,
+                                     fx_left_in, fx_right_in, ioff, num);
+        }
+
+        count += num;
+        num += ioff; /* if we're now done, num becomes the new synth->cur below */
+    }
+
+    synth->cur = num;
+
+    fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
+
+    return FLUID_OK;
+}
+
+/*
+ * Synthesize floating point audio to one stereo pair of buffers per audio and effects channel.
+ *
+ * Unlike fluid_synth_process() the audio is written to rather than mixed into the buffers,
+ * so that they need not be zeroed in advance, and every audio channel goes to the buffers
+ * of its own index, i.e. \p nout must be <code>2 * fluid_synth_count_audio_channels()</code>
+ * and \p nfx either 0 or <code>2 * fluid_synth_count_effects_channels() *
+ * fluid_synth_count_effects_groups()</code>. Buffers must not alias. NULL buffers are
+ * permitted and will cause to skip that channel.
+ *
+ * Used by audio drivers providing a port for every channel, e.g. jack with audio.jack.multi.
+ * Should only be called from synthesis thread.
+ */
+int
+fluid_synth_write_float_channels(fluid_synth_t *synth, int len, int nfx, float *fx[],
+                                 int nout, float *out[])
+{
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(nout == 2 * synth->audio_channels, FLUID_FAILED);
+    fluid_return_val_if_fail(nfx == 0 || nfx == 2 * synth->effects_channels * synth->effects_groups, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK);
+
+    return fluid_synth_write_channels_LOCAL(synth, len, nfx, fx, nout, out, 0, NULL);
+}
+
+/**
+ * Synthesize floating point audio of all audio channels, and optionally all effects channels,
+ * to a single interleaved buffer.
+ *
+ * The frames of \p out hold the left and right channel of every audio channel, followed by
+ * the left and right channel of every effects channel of every effects group if requested,
+ * i.e. audio channel \c i is stored at <code>out[frame * nchannels + 2 * i]</code> and
+ * <code>out[frame * nchannels + 2 * i + 1]</code>.
+ *
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param nchannels Count of channels of every frame in \p out, either
+ * <code>2 * fluid_synth_count_audio_channels()</code>, in which case reverb and chorus are mixed
+ * to the audio channels, or <code>2 * (fluid_synth_count_audio_channels() +
+ * fluid_synth_count_effects_channels() * fluid_synth_count_effects_groups())</code>.
+ * @param out Buffer of <code>len * nchannels</code> floats to store the audio to
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * @note Unlike fluid_synth_process(), the audio is written to \p out rather than mixed into it,
+ * there is no need to zero it out before.
+ * @note Should only be called from synthesis thread.
+ * @since 2.2.0
+ */
+int
+fluid_synth_write_interleaved(fluid_synth_t *synth, int len, int nchannels, float *out)
+{
+    int naudchan, nfxchan;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(out != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+
+    naudchan = synth->audio_channels;
+    nfxchan = synth->effects_channels * synth->effects_groups;
+
+    fluid_return_val_if_fail(nchannels == 2 * naudchan || nchannels == 2 * (naudchan + nfxchan), FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK);
+
+    return fluid_synth_write_channels_LOCAL(synth, len, 0, NULL, 0, NULL, nchannels, out);
+}
+
+#if defined(WITH_FLOAT)
+/*
+ * Render len frames, a multiple of FLUID_BUFSIZE, into separate left and right buffers.
+ * The mixer renders into them whenever they are aligned, the samples are copied from
+ * the mixer buffers otherwise.
+ */
+static void
+fluid_synth_write_float_direct(fluid_synth_t *synth, int len, float *left_out, float *right_out)
+{
+    fluid_rvoice_mixer_t *mixer = synth->eventhandler->mixer;
+    fluid_real_t *left_in, *right_in;
+    int n;
+
+    while(len > 0)
+    {
+        fluid_rvoice_mixer_set_output(mixer, left_out, right_out);
+        n = FLUID_BUFSIZE * fluid_synth_render_blocks(synth, len / FLUID_BUFSIZE);
+
+        if(!fluid_rvoice_mixer_is_output_used(mixer))
+        {
+            fluid_rvoice_mixer_get_bufs(mixer, &left_in, &right_in);
+            FLUID_MEMCPY(left_out, left_in, n * sizeof(float));
+            FLUID_MEMCPY(right_out, right_in, n * sizeof(float));
+        }
+
+        left_out += n;
+        right_out += n;
+        len -= n;
+    }
+
+    /* nothing left in the mixer buffers for the next call */
+    synth->cur = 0;
+    synth->curmax = 0;
+}
+#endif
+
+/**
+ * Synthesize a block of floating point audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of floats to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of floats to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
+ * lincr = 2, rincr = 2).
+ *
+ * When FluidSynth has been built with float samples, separate left and right buffers
+ * (lincr = rincr = 1) starting at a 64 byte boundary are rendered into without an
+ * intermediate copy, as long as \p len is a multiple of fluid_synth_get_internal_bufsize()
+ * and so is the count of frames written by the previous calls.
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ */
+int
+fluid_synth_write_float(fluid_synth_t *synth, int len,
+                        void *lout, int loff, int lincr,
+                        void *rout, int roff, int rincr)
+{
+    return fluid_synth_write_float_LOCAL(synth, len, lout, loff, lincr, rout, roff, rincr, fluid_synth_render_blocks);
+}
+
+int
+fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
+                              void *lout, int loff, int lincr,
+                              void *rout, int roff, int rincr,
+                              int (*block_render_func)(fluid_synth_t *, int)
+                             )
+{
+    int n, cur, size;
+    float *left_out = (float *) lout + loff;
+    float *right_out = (float *) rout + roff;
+    fluid_real_t *left_in;
+    fluid_real_t *right_in;
+    double time = fluid_utime();
+
+    fluid_profile_ref_var(prof_ref);
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(lout != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(rout != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+
+    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, 1);
+
+#if defined(WITH_FLOAT)
+
+    /* Whole blocks of separate left and right samples, with none left of the previous call,
+     * are rendered straight into the buffers of the caller, if aligned. */
+    if(block_render_func == fluid_synth_render_blocks && synth->upsample_num == 1
+            && synth->cur >= synth->curmax && len % FLUID_BUFSIZE == 0 && lincr == 1 && rincr == 1)
+    {
+        fluid_synth_write_float_direct(synth, len, left_out, right_out);
+
+        fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
+
+        fluid_profile_write(FLUID_PROF_WRITE, prof_ref,
+                            fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
+                            len);
+        return FLUID_OK;
+    }
+
+#endif
+
+    fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
+
+    size = len;
+    cur = synth->cur;
+
+    do
+    {
+        /* fill up the buffers as needed */
+        if(cur >= synth->curmax)
+        {
+            int blocksleft = (size + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+            synth->curmax = FLUID_BUFSIZE * block_render_func(synth, blocksleft);
+            fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
+            cur = 0;
+        }
+
+        /* calculate amount of available samples */
+        n = synth->curmax - cur;
+
+        /* keep track of emitted samples */
         if(n > size)
         {
             n = size;
@@ -3900,9 +5580,7 @@ fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
 
     synth->cur = cur;
 
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+    fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
 
     fluid_profile_write(FLUID_PROF_WRITE, prof_ref,
                         fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
@@ -3937,32 +5615,92 @@ init_dither(void)
     }
 }
 
-/* A portable replacement for roundf(), seems it may actually be faster too! */
-static FLUID_INLINE int16_t
-round_clip_to_i16(float x)
+/* Maximum number of samples converted by the kernels below at once */
+#define FLUID_CONVERT_BLOCK FLUID_BUFSIZE
+
+/*
+ * Round and clip a block of scaled samples to 16 bit and store them with the given increment.
+ *
+ * Clipping before rounding (half away from zero) gives the same results as clipping the
+ * rounded values, but leaves a loop without branches, which the compiler can vectorize.
+ * Only the stores to interleaved buffers remain scalar.
+ */
+static FLUID_INLINE void
+fluid_synth_round_clip_s16(int16_t *FLUID_RESTRICT out, int incr, const float *FLUID_RESTRICT x, int n)
 {
-    long i;
+    int16_t tmp[FLUID_CONVERT_BLOCK];
+    int16_t *dst = (incr == 1) ? out : tmp;
+    int i;
 
-    if(x >= 0.0f)
+    for(i = 0; i < n; i++)
     {
-        i = (long)(x + 0.5f);
+        float v = x[i];
 
-        if(FLUID_UNLIKELY(i > 32767))
+        v = (v > 32767.0f) ? 32767.0f : v;
+        v = (v < -32768.0f) ? -32768.0f : v;
+        dst[i] = (int16_t)(int32_t)(v + ((v >= 0.0f) ? 0.5f : -0.5f));
+    }
+
+    if(incr != 1)
+    {
+        for(i = 0; i < n; i++)
         {
-            i = 32767;
+            out[i * incr] = tmp[i];
         }
     }
-    else
+}
+
+/*
+ * Add the dither noise starting at index di to a block of stereo samples scaled to 16 bit
+ * and store them. The block must not exceed FLUID_CONVERT_BLOCK nor the end of the dither table.
+ */
+static FLUID_INLINE void
+fluid_synth_dither_block_s16(int di, int n, float *FLUID_RESTRICT xl, float *FLUID_RESTRICT xr,
+                             int16_t *left_out, int lincr, int16_t *right_out, int rincr)
+{
+    const float *FLUID_RESTRICT dl = &rand_table[0][di];
+    const float *FLUID_RESTRICT dr = &rand_table[1][di];
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        xl[i] += dl[i];
+        xr[i] += dr[i];
+    }
+
+    fluid_synth_round_clip_s16(left_out, lincr, xl, n);
+    fluid_synth_round_clip_s16(right_out, rincr, xr, n);
+}
+
+/*
+ * Scale a block of samples by \p scale, round and clip them to the range of
+ * <code>-scale - 1</code> to \p scale and store them with the given increment.
+ */
+static FLUID_INLINE void
+fluid_synth_round_clip_s32(int32_t *FLUID_RESTRICT out, int incr, const fluid_real_t *FLUID_RESTRICT in,
+                           double scale, int n)
+{
+    int32_t tmp[FLUID_CONVERT_BLOCK];
+    int32_t *dst = (incr == 1) ? out : tmp;
+    double min = -scale - 1.0;
+    int i;
+
+    for(i = 0; i < n; i++)
     {
-        i = (long)(x - 0.5f);
+        double v = in[i] * scale;
+
+        v = (v > scale) ? scale : v;
+        v = (v < min) ? min : v;
+        dst[i] = (int32_t)(v + ((v >= 0.0) ? 0.5 : -0.5));
+    }
 
-        if(FLUID_UNLIKELY(i < -32768))
+    if(incr != 1)
+    {
+        for(i = 0; i < n; i++)
         {
-            i = -32768;
+            out[i * incr] = tmp[i];
         }
     }
-
-    return (int16_t)i;
 }
 
 /**
@@ -3996,7 +5734,6 @@ fluid_synth_write_s16(fluid_synth_t *synth, int len,
     fluid_real_t *left_in;
     fluid_real_t *right_in;
     double time = fluid_utime();
-    float cpu_load;
 
     fluid_profile_ref_var(prof_ref);
 
@@ -4036,38 +5773,46 @@ fluid_synth_write_s16(fluid_synth_t *synth, int len,
         size -= n;
 
         /* update pointers to current position */
-        left_in  += cur + n;
-        right_in += cur + n;
+        left_in  += cur;
+        right_in += cur;
 
         /* set final cursor position */
         cur += n;
 
-        /* reverse index */
-        n = 0 - n;
-
-        do
+        /* convert block by block, up to the end of the dither table */
+        while(n > 0)
         {
-            *left_out = round_clip_to_i16(left_in[n] * 32766.0f + rand_table[0][di]);
-            *right_out = round_clip_to_i16(right_in[n] * 32766.0f + rand_table[1][di]);
+            float xl[FLUID_CONVERT_BLOCK], xr[FLUID_CONVERT_BLOCK];
+            int i, num = (n > FLUID_CONVERT_BLOCK) ? FLUID_CONVERT_BLOCK : n;
 
-            left_out  += lincr;
-            right_out += rincr;
+            num = (num > DITHER_SIZE - di) ? DITHER_SIZE - di : num;
+
+            for(i = 0; i < num; i++)
+            {
+                xl[i] = left_in[i] * 32766.0f;
+                xr[i] = right_in[i] * 32766.0f;
+            }
+
+            fluid_synth_dither_block_s16(di, num, xl, xr, left_out, lincr, right_out, rincr);
 
-            if(++di >= DITHER_SIZE)
+            left_in += num;
+            right_in += num;
+            left_out += num * lincr;
+            right_out += num * rincr;
+            n -= num;
+
+            if((di += num) >= DITHER_SIZE)
             {
                 di = 0;
             }
         }
-        while(++n < 0);
     }
     while(size);
 
     synth->cur = cur;
     synth->dither_index = di;	/* keep dither buffer continuous */
 
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+    fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
 
     fluid_profile_write(FLUID_PROF_WRITE, prof_ref,
                         fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
@@ -4075,44 +5820,200 @@ fluid_synth_write_s16(fluid_synth_t *synth, int len,
     return 0;
 }
 
-/**
- * Converts stereo floating point sample data to signed 16 bit data with dithering.
- * @param dither_index Pointer to an integer which should be initialized to 0
- *   before the first call and passed unmodified to additional calls which are
- *   part of the same synthesis output.
- * @param len Length in frames to convert
- * @param lin Buffer of left audio samples to convert from
- * @param rin Buffer of right audio samples to convert from
- * @param lout Array of 16 bit words to store left channel of audio
- * @param loff Offset index in 'lout' for first sample
- * @param lincr Increment between samples stored to 'lout'
- * @param rout Array of 16 bit words to store right channel of audio
- * @param roff Offset index in 'rout' for first sample
- * @param rincr Increment between samples stored to 'rout'
- *
- * @note Currently private to libfluidsynth.
- */
-void
-fluid_synth_dither_s16(int *dither_index, int len, const float *lin, const float *rin,
-                       void *lout, int loff, int lincr,
-                       void *rout, int roff, int rincr)
+static int
+fluid_synth_write_s32_LOCAL(fluid_synth_t *synth, int len,
+                            void *lout, int loff, int lincr,
+                            void *rout, int roff, int rincr,
+                            double scale)
 {
-    int i, j, k;
-    int16_t *left_out = lout;
-    int16_t *right_out = rout;
-    int di = *dither_index;
-    fluid_profile_ref_var(prof_ref);
+    int n, cur, size;
+    int32_t *left_out = (int32_t *)lout + loff;
+    int32_t *right_out = (int32_t *)rout + roff;
+    fluid_real_t *left_in;
+    fluid_real_t *right_in;
+    double time = fluid_utime();
 
-    for(i = 0, j = loff, k = roff; i < len; i++, j += lincr, k += rincr)
-    {
-        left_out[j] = round_clip_to_i16(lin[i] * 32766.0f + rand_table[0][di]);
-        right_out[k] = round_clip_to_i16(rin[i] * 32766.0f + rand_table[1][di]);
+    fluid_profile_ref_var(prof_ref);
 
-        if(++di >= DITHER_SIZE)
-        {
-            di = 0;
-        }
-    }
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(lout != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(rout != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+
+    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, 1);
+    fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
+
+    size = len;
+    cur = synth->cur;
+
+    do
+    {
+        /* fill up the buffers as needed */
+        if(cur >= synth->curmax)
+        {
+            int blocksleft = (size + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+            synth->curmax = FLUID_BUFSIZE * fluid_synth_render_blocks(synth, blocksleft);
+            fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
+            cur = 0;
+        }
+
+        /* calculate amount of available samples */
+        n = synth->curmax - cur;
+
+        /* keep track of emitted samples */
+        if(n > size)
+        {
+            n = size;
+        }
+
+        size -= n;
+
+        /* update pointers to current position */
+        left_in  += cur;
+        right_in += cur;
+
+        /* set final cursor position */
+        cur += n;
+
+        while(n > 0)
+        {
+            int num = (n > FLUID_CONVERT_BLOCK) ? FLUID_CONVERT_BLOCK : n;
+
+            fluid_synth_round_clip_s32(left_out, lincr, left_in, scale, num);
+            fluid_synth_round_clip_s32(right_out, rincr, right_in, scale, num);
+
+            left_in += num;
+            right_in += num;
+            left_out += num * lincr;
+            right_out += num * rincr;
+            n -= num;
+        }
+    }
+    while(size);
+
+    synth->cur = cur;
+
+    fluid_synth_update_render_stats(synth, fluid_utime() - time, len);
+
+    fluid_profile_write(FLUID_PROF_WRITE, prof_ref,
+                        fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
+                        len);
+    return FLUID_OK;
+}
+
+/**
+ * Synthesize a block of 24 bit audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of 32 bit words to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of 32 bit words to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Every sample is stored in the lower 24 bits of a 32 bit word and sign extended,
+ * i.e. in the range of -8388608 to 8388607 (like the S24 formats of ALSA).
+ * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
+ * lincr = 2, rincr = 2).
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ * @note No dithering is performed, the quantization noise of 24 bit audio is
+ * far below the noise of any playback device.
+ * @since 2.2.0
+ */
+int
+fluid_synth_write_s24(fluid_synth_t *synth, int len,
+                      void *lout, int loff, int lincr,
+                      void *rout, int roff, int rincr)
+{
+    return fluid_synth_write_s32_LOCAL(synth, len, lout, loff, lincr, rout, roff, rincr, 8388607.0);
+}
+
+/**
+ * Synthesize a block of 32 bit audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of 32 bit words to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of 32 bit words to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
+ * lincr = 2, rincr = 2).
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ * @note No dithering is performed.
+ * @since 2.2.0
+ */
+int
+fluid_synth_write_s32(fluid_synth_t *synth, int len,
+                      void *lout, int loff, int lincr,
+                      void *rout, int roff, int rincr)
+{
+    return fluid_synth_write_s32_LOCAL(synth, len, lout, loff, lincr, rout, roff, rincr, 2147483647.0);
+}
+
+/**
+ * Converts stereo floating point sample data to signed 16 bit data with dithering.
+ * @param dither_index Pointer to an integer which should be initialized to 0
+ *   before the first call and passed unmodified to additional calls which are
+ *   part of the same synthesis output.
+ * @param len Length in frames to convert
+ * @param lin Buffer of left audio samples to convert from
+ * @param rin Buffer of right audio samples to convert from
+ * @param lout Array of 16 bit words to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of 16 bit words to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ *
+ * @note Currently private to libfluidsynth.
+ */
+void
+fluid_synth_dither_s16(int *dither_index, int len, const float *lin, const float *rin,
+                       void *lout, int loff, int lincr,
+                       void *rout, int roff, int rincr)
+{
+    float xl[FLUID_CONVERT_BLOCK], xr[FLUID_CONVERT_BLOCK];
+    int i, num;
+    int16_t *left_out = (int16_t *)lout + loff;
+    int16_t *right_out = (int16_t *)rout + roff;
+    int di = *dither_index;
+    fluid_profile_ref_var(prof_ref);
+
+    while(len > 0)
+    {
+        num = (len > FLUID_CONVERT_BLOCK) ? FLUID_CONVERT_BLOCK : len;
+        num = (num > DITHER_SIZE - di) ? DITHER_SIZE - di : num;
+
+        for(i = 0; i < num; i++)
+        {
+            xl[i] = lin[i] * 32766.0f;
+            xr[i] = rin[i] * 32766.0f;
+        }
+
+        fluid_synth_dither_block_s16(di, num, xl, xr, left_out, lincr, right_out, rincr);
+
+        lin += num;
+        rin += num;
+        left_out += num * lincr;
+        right_out += num * rincr;
+        len -= num;
+
+        if((di += num) >= DITHER_SIZE)
+        {
+            di = 0;
+        }
+    }
 
     *dither_index = di;	/* keep dither buffer continuous */
 
@@ -4122,12 +6023,22 @@ fluid_synth_dither_s16(int *dither_index, int len, const float *lin, const float
 static void
 fluid_synth_check_finished_voices(fluid_synth_t *synth)
 {
-    int j;
+    int j, finished = FALSE;
     fluid_rvoice_t *fv;
 
     while(NULL != (fv = fluid_rvoice_eventhandler_get_finished_voice(synth->eventhandler)))
     {
-        for(j = 0; j < synth->polyphony; j++)
+        finished = TRUE;
+
+        /* the rvoice isn't rendered anymore, neither is its ring buffer read */
+        if(fv->dsp.stream != NULL)
+        {
+            fluid_sample_stream_release(fv->dsp.stream);
+            fv->dsp.stream = NULL;
+        }
+
+        /* voices above the polyphony limit are turned off, they finish as well */
+        for(j = 0; j < synth->nvoice; j++)
         {
             if(synth->voice[j]->rvoice == fv)
             {
@@ -4142,6 +6053,17 @@ fluid_synth_check_finished_voices(fluid_synth_t *synth)
             }
         }
     }
+
+    /* the samples of the SoundFonts unloaded may not be used anymore */
+    if(finished)
+    {
+        if(synth->sample_streamer != NULL)
+        {
+            fluid_sample_streamer_collect(synth->sample_streamer);
+        }
+
+        fluid_synth_wake_sfont_reclaimer(synth);
+    }
 }
 
 /**
@@ -4162,8 +6084,49 @@ void fluid_synth_process_event_queue(fluid_synth_t *synth)
  */
 static int
 fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
+{
+    fluid_rvoice_mixer_t *mixer = synth->eventhandler->mixer;
+    int maxblocks, inblocks;
+    fluid_trace_ref_var(trace_ref);
+
+    if(synth->upsample_num == 1)
+    {
+        return fluid_synth_render_internal_blocks(synth, blockcount);
+    }
+
+    maxblocks = fluid_rvoice_mixer_get_bufcount(mixer);
+    blockcount = (blockcount < maxblocks) ? blockcount : maxblocks;
+
+    /* the blocks rendered at synth.internal-rate may be cut short by pending events,
+     * the callers expect at least one block at the output rate */
+    do
+    {
+        inblocks = fluid_rvoice_mixer_get_upsampling_blocks(mixer, blockcount);
+
+        if(inblocks > 0)
+        {
+            fluid_synth_render_internal_blocks(synth, inblocks);
+        }
+
+        fluid_trace_ref_reset(trace_ref);
+        inblocks = fluid_rvoice_mixer_upsample(mixer, blockcount);
+        fluid_trace("upsample", trace_ref);
+    }
+    while(inblocks == 0);
+
+    return inblocks;
+}
+
+/**
+ * Process blocks (FLUID_BUFSIZE) of audio at the rate the voices are rendered at.
+ * @return number of blocks rendered. Might (often) return less than requested
+ */
+static int
+fluid_synth_render_internal_blocks(fluid_synth_t *synth, int blockcount)
 {
     int i, maxblocks;
+    fluid_trace_ref_var(trace_ref);
+    fluid_trace_ref_var(dispatch_ref);
     fluid_profile_ref_var(prof_ref);
 
     /* Assign ID of synthesis thread */
@@ -4171,7 +6134,14 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
 
     fluid_check_fpe("??? Just starting up ???");
 
+    fluid_rt_enter();
     fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+    fluid_trace("dispatch", dispatch_ref);
+
+    if(fluid_atomic_int_get(&synth->clock_users))
+    {
+        fluid_synth_update_clock(synth);
+    }
 
     /* do not render more blocks than we can store internally */
     maxblocks = fluid_rvoice_mixer_get_bufcount(synth->eventhandler->mixer);
@@ -4184,17 +6154,32 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
     for(i = 0; i < blockcount; i++)
     {
         fluid_sample_timer_process(synth);
-        fluid_synth_add_ticks(synth, FLUID_BUFSIZE);
+
+        if(fluid_atomic_int_get(&synth->controllers_pending))
+        {
+            fluid_synth_update_pending_controllers(synth);
+        }
 
         /* If events have been queued waiting for fluid_rvoice_eventhandler_dispatch_all()
-         * (should only happen with parallel render) stop processing and go for rendering
+         * (by the timers, or by another thread with parallel render), they must be
+         * dispatched before this block is rendered, so that e.g. notes of the
+         * sequencer start in this block at their exact frame.
          */
         if(fluid_rvoice_eventhandler_dispatch_count(synth->eventhandler))
         {
-            // Something has happened, we can't process more
-            blockcount = i + 1;
-            break;
+            if(i > 0)
+            {
+                // Render the previous blocks first, this one is processed again by the next call
+                blockcount = i;
+                break;
+            }
+
+            fluid_trace_ref_reset(dispatch_ref);
+            fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+            fluid_trace("dispatch", dispatch_ref);
         }
+
+        fluid_synth_add_ticks(synth, FLUID_BUFSIZE);
     }
 
     fluid_check_fpe("fluid_sample_timer_process");
@@ -4216,90 +6201,247 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
     fluid_profile(FLUID_PROF_ONE_BLOCK, prof_ref,
                   fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
                   blockcount * FLUID_BUFSIZE);
+    fluid_trace("render_blocks", trace_ref);
+    fluid_rt_exit();
     return blockcount;
 }
 
 /*
- * Handler for synth.reverb.* and synth.chorus.* double settings.
+ * Advance the synth by up to len frames of silence without rendering them, for
+ * an offline renderer to write zero samples instead. Only whole blocks are
+ * skipped, as long as no voice is playing, the effects tails have decayed and
+ * nothing is left of the previous rendering call. The sample timers (e.g. of a
+ * MIDI player) run for each block as when rendering, the skipping stops at the
+ * first block events are queued for, so that it is rendered by the next call.
+ * Returns the number of frames skipped, the caller renders the rest.
  */
-static void fluid_synth_handle_reverb_chorus_num(void *data, const char *name, double value)
+int
+fluid_synth_skip_silence(fluid_synth_t *synth, int len)
 {
-    fluid_synth_t *synth = (fluid_synth_t *)data;
-    fluid_return_if_fail(synth != NULL);
+    fluid_rvoice_mixer_t *mixer = synth->eventhandler->mixer;
+    int i, blockcount = len / FLUID_BUFSIZE;
 
-    if(FLUID_STRCMP(name, "synth.reverb.room-size") == 0)
-    {
-        fluid_synth_set_reverb_roomsize(synth, value);
-    }
-    else if(FLUID_STRCMP(name, "synth.reverb.damp") == 0)
-    {
-        fluid_synth_set_reverb_damp(synth, value);
-    }
-    else if(FLUID_STRCMP(name, "synth.reverb.width") == 0)
-    {
-        fluid_synth_set_reverb_width(synth, value);
-    }
-    else if(FLUID_STRCMP(name, "synth.reverb.level") == 0)
+    if(synth->upsample_num != 1 || synth->cur < synth->curmax || blockcount == 0)
     {
-        fluid_synth_set_reverb_level(synth, value);
+        return 0;
     }
-    else if(FLUID_STRCMP(name, "synth.chorus.depth") == 0)
+
+    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+
+    if(!fluid_rvoice_mixer_is_silent(mixer))
     {
-        fluid_synth_set_chorus_depth(synth, value);
+        return 0;
     }
-    else if(FLUID_STRCMP(name, "synth.chorus.speed") == 0)
+
+    if(fluid_atomic_int_get(&synth->clock_users))
     {
-        fluid_synth_set_chorus_speed(synth, value);
+        fluid_synth_update_clock(synth);
     }
-    else if(FLUID_STRCMP(name, "synth.chorus.level") == 0)
+
+    for(i = 0; i < blockcount; i++)
     {
-        fluid_synth_set_chorus_level(synth, value);
+        fluid_sample_timer_process(synth);
+
+        if(fluid_atomic_int_get(&synth->controllers_pending))
+        {
+            fluid_synth_update_pending_controllers(synth);
+        }
+
+        if(fluid_rvoice_eventhandler_dispatch_count(synth->eventhandler))
+        {
+            break;
+        }
+
+        fluid_synth_add_ticks(synth, FLUID_BUFSIZE);
     }
+
+    return i * FLUID_BUFSIZE;
 }
 
 /*
- * Handler for synth.reverb.* and synth.chorus.* integer settings.
+ * Update the statistics of the audio rendering after a rendering call.
+ * time is the time the call took in microseconds, len the number of frames it rendered.
  */
-static void fluid_synth_handle_reverb_chorus_int(void *data, const char *name, int value)
+static void
+fluid_synth_update_render_stats(fluid_synth_t *synth, double time, int len)
 {
-    fluid_synth_t *synth = (fluid_synth_t *)data;
-    fluid_return_if_fail(synth != NULL);
+    float cpu_load, dsp_load;
+    int bucket, voices;
+    double wait_time = fluid_rvoice_mixer_take_wait_time(synth->eventhandler->mixer);
 
-    if(FLUID_STRCMP(name, "synth.reverb.active") == 0)
-    {
-        fluid_synth_set_reverb_on(synth, value);
-    }
-    else if(FLUID_STRCMP(name, "synth.chorus.active") == 0)
+    dsp_load = time * synth->output_rate / len / 10000.0;
+    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + dsp_load);
+    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+    fluid_atomic_float_set(&synth->dsp_load, dsp_load);
+
+    if(dsp_load > fluid_atomic_float_get(&synth->peak_dsp_load))
     {
-        fluid_synth_set_chorus_on(synth, value);
+        fluid_atomic_float_set(&synth->peak_dsp_load, dsp_load);
     }
-    else if(FLUID_STRCMP(name, "synth.chorus.nr") == 0)
+
+    fluid_atomic_float_set(&synth->mixer_wait, (time > 0) ? 100.0 * wait_time / time : 0);
+
+    bucket = (int)(dsp_load / 10);
+    bucket = (bucket < FLUID_SYNTH_RENDER_HISTOGRAM_SIZE) ? bucket : FLUID_SYNTH_RENDER_HISTOGRAM_SIZE - 1;
+    fluid_atomic_int_inc(&synth->render_histogram[bucket]);
+    fluid_atomic_int_inc(&synth->render_calls);
+
+    voices = fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer);
+
+    if(voices > fluid_atomic_int_get(&synth->peak_voices))
     {
-        fluid_synth_set_chorus_nr(synth, value);
+        fluid_atomic_int_set(&synth->peak_voices, voices);
     }
+
+    fluid_synth_update_voice_limit(synth, cpu_load);
 }
 
 /*
- * Handler for synth.overflow.* settings.
+ * Adapt the number of voices allowed at once to the CPU load of the rendering
+ * calls, if synth.dynamic-polyphony.active is on. Called by the rendering
+ * thread after a rendering call.
+ *
+ * When the load exceeds synth.dynamic-polyphony.high-load, the voices with the
+ * lowest overflow priority are killed, until the load of the remaining voices
+ * is expected to lie between both load thresholds, and voices are limited to
+ * 4th order interpolation. Once the load is below
+ * synth.dynamic-polyphony.low-load, the limit is raised step by step, until all
+ * the voices of synth.polyphony are allowed again.
  */
-static void fluid_synth_handle_overflow(void *data, const char *name, double value)
+static void
+fluid_synth_update_voice_limit(fluid_synth_t *synth, float load)
 {
-    fluid_synth_t *synth = (fluid_synth_t *)data;
-    fluid_return_if_fail(synth != NULL);
-
-    fluid_synth_api_enter(synth);
+    float high, low;
+    int limit, target;
 
-    if(FLUID_STRCMP(name, "synth.overflow.percussion") == 0)
+    if(!fluid_atomic_int_get(&synth->dynamic_polyphony))
     {
-        synth->overflow.percussion = value;
+        return;
     }
-    else if(FLUID_STRCMP(name, "synth.overflow.released") == 0)
+
+    high = fluid_atomic_float_get(&synth->dynamic_polyphony_high);
+    low = fluid_atomic_float_get(&synth->dynamic_polyphony_low);
+    limit = fluid_atomic_int_get(&synth->voice_limit);
+
+    /* nothing to do, unless the synth is overloaded or recovering */
+    if(load <= high && (load >= low || limit == 0))
     {
-        synth->overflow.released = value;
+        return;
     }
-    else if(FLUID_STRCMP(name, "synth.overflow.sustained") == 0)
-    {
-        synth->overflow.sustained = value;
+
+    fluid_synth_api_enter(synth);
+
+    if(load > high)
+    {
+        /* don't kill more than half of the voices at once */
+        target = (int)(synth->active_voice_count * 0.5f * (high + low) / load);
+        target = (target < synth->active_voice_count / 2) ? synth->active_voice_count / 2 : target;
+        target = (target < 1) ? 1 : target;
+
+        if(limit == 0 || target < limit)
+        {
+            limit = target;
+        }
+
+        fluid_synth_kill_voices_LOCAL(synth, limit);
+        fluid_synth_degrade_interp_LOCAL(synth, TRUE);
+    }
+    else
+    {
+        limit += (synth->polyphony / 32 > 1) ? synth->polyphony / 32 : 1;
+
+        if(limit >= synth->polyphony)
+        {
+            limit = 0;
+            fluid_synth_degrade_interp_LOCAL(synth, FALSE);
+        }
+    }
+
+    fluid_atomic_int_set(&synth->voice_limit, limit);
+    fluid_synth_api_exit(synth);
+}
+
+/*
+ * Handler for synth.reverb.* and synth.chorus.* double settings.
+ */
+static void fluid_synth_handle_reverb_chorus_num(void *data, const char *name, double value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
+
+    if(FLUID_STRCMP(name, "synth.reverb.room-size") == 0)
+    {
+        fluid_synth_set_reverb_roomsize(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.reverb.damp") == 0)
+    {
+        fluid_synth_set_reverb_damp(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.reverb.width") == 0)
+    {
+        fluid_synth_set_reverb_width(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.reverb.level") == 0)
+    {
+        fluid_synth_set_reverb_level(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.chorus.depth") == 0)
+    {
+        fluid_synth_set_chorus_depth(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.chorus.speed") == 0)
+    {
+        fluid_synth_set_chorus_speed(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.chorus.level") == 0)
+    {
+        fluid_synth_set_chorus_level(synth, value);
+    }
+}
+
+/*
+ * Handler for synth.reverb.* and synth.chorus.* integer settings.
+ */
+static void fluid_synth_handle_reverb_chorus_int(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
+
+    if(FLUID_STRCMP(name, "synth.reverb.active") == 0)
+    {
+        fluid_synth_set_reverb_on(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.chorus.active") == 0)
+    {
+        fluid_synth_set_chorus_on(synth, value);
+    }
+    else if(FLUID_STRCMP(name, "synth.chorus.nr") == 0)
+    {
+        fluid_synth_set_chorus_nr(synth, value);
+    }
+}
+
+/*
+ * Handler for synth.overflow.* settings.
+ */
+static void fluid_synth_handle_overflow(void *data, const char *name, double value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
+
+    fluid_synth_api_enter(synth);
+
+    if(FLUID_STRCMP(name, "synth.overflow.percussion") == 0)
+    {
+        synth->overflow.percussion = value;
+    }
+    else if(FLUID_STRCMP(name, "synth.overflow.released") == 0)
+    {
+        synth->overflow.released = value;
+    }
+    else if(FLUID_STRCMP(name, "synth.overflow.sustained") == 0)
+    {
+        synth->overflow.sustained = value;
     }
     else if(FLUID_STRCMP(name, "synth.overflow.volume") == 0)
     {
@@ -4314,775 +6456,1700 @@ static void fluid_synth_handle_overflow(void *data, const char *name, double val
         synth->overflow.important = value;
     }
 
+    fluid_synth_rebuild_overflow_heap_LOCAL(synth);
     fluid_synth_api_exit(synth);
 }
 
-/* Selects a voice for killing. */
-static fluid_voice_t *
-fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth)
+/*
+ * Handler for synth.dynamic-polyphony.active setting.
+ */
+static void fluid_synth_handle_dynamic_polyphony(void *data, const char *name, int value)
 {
-    int i;
-    float best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
-    float this_voice_prio;
-    fluid_voice_t *voice;
-    int best_voice_index = -1;
-    unsigned int ticks = fluid_synth_get_ticks(synth);
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-    for(i = 0; i < synth->polyphony; i++)
-    {
+    fluid_synth_api_enter(synth);
+    fluid_atomic_int_set(&synth->dynamic_polyphony, value);
 
-        voice = synth->voice[i];
+    if(!value)
+    {
+        /* all the voices are allowed again */
+        fluid_atomic_int_set(&synth->voice_limit, 0);
+        fluid_synth_degrade_interp_LOCAL(synth, FALSE);
+    }
 
-        /* safeguard against an available voice. */
-        if(_AVAILABLE(voice))
-        {
-            return voice;
-        }
+    fluid_synth_api_exit(synth);
+}
 
-        this_voice_prio = fluid_voice_get_overflow_prio(voice, &synth->overflow,
-                          ticks);
+/*
+ * Handler for synth.dynamic-polyphony.*-load settings.
+ */
+static void fluid_synth_handle_dynamic_polyphony_load(void *data, const char *name, double value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-        /* check if this voice has less priority than the previous candidate. */
-        if(this_voice_prio < best_prio)
-        {
-            best_voice_index = i;
-            best_prio = this_voice_prio;
-        }
+    if(FLUID_STRCMP(name, "synth.dynamic-polyphony.high-load") == 0)
+    {
+        fluid_atomic_float_set(&synth->dynamic_polyphony_high, value);
     }
-
-    if(best_voice_index < 0)
+    else if(FLUID_STRCMP(name, "synth.dynamic-polyphony.low-load") == 0)
     {
-        return NULL;
+        fluid_atomic_float_set(&synth->dynamic_polyphony_low, value);
     }
+}
 
-    voice = synth->voice[best_voice_index];
-    FLUID_LOG(FLUID_DBG, "Killing voice %d, index %d, chan %d, key %d ",
-              fluid_voice_get_id(voice), best_voice_index, fluid_voice_get_channel(voice), fluid_voice_get_key(voice));
-    fluid_voice_off(voice);
+/*
+ * Handler for synth.interp-qos.active setting, applies to the voices started afterwards.
+ */
+static void fluid_synth_handle_interp_qos(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-    return voice;
+    fluid_synth_api_enter(synth);
+    synth->interp_qos = value;
+    fluid_synth_api_exit(synth);
 }
 
+/*
+ * Handler for synth.dsp-precision setting, applies to the voices started afterwards.
+ */
+static void fluid_synth_handle_dsp_precision(void *data, const char *name, const char *value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-/**
- * Allocate a synthesis voice.
- * @param synth FluidSynth instance
- * @param sample Sample to assign to the voice
- * @param chan MIDI channel number (0 to MIDI channel count - 1)
- * @param key MIDI note number for the voice (0-127)
- * @param vel MIDI velocity for the voice (0-127)
- * @return Allocated synthesis voice or NULL on error
- *
- * This function is called by a SoundFont's preset in response to a noteon event.
- * The returned voice comes with default modulators and generators.
- * A single noteon event may create any number of voices, when the preset is layered.
- *
- * @note Should only be called from within synthesis thread, which includes
- * SoundFont loader preset noteon method.
+    fluid_synth_api_enter(synth);
+    synth->dsp_single_precision = (value != NULL && FLUID_STRCMP(value, "float") == 0);
+    fluid_synth_api_exit(synth);
+}
+
+/*
+ * Handler for synth.coalesce-controllers setting. Controllers still pending
+ * when it is disabled are applied with the next block.
  */
-fluid_voice_t *
-fluid_synth_alloc_voice(fluid_synth_t *synth, fluid_sample_t *sample,
-                        int chan, int key, int vel)
+static void fluid_synth_handle_coalesce_controllers(void *data, const char *name, int value)
 {
-    fluid_return_val_if_fail(sample != NULL, NULL);
-    FLUID_API_ENTRY_CHAN(NULL);
-    FLUID_API_RETURN(fluid_synth_alloc_voice_LOCAL(synth, sample, chan, key, vel, NULL));
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
+    fluid_synth_api_enter(synth);
+    synth->coalesce_controllers = value;
+    fluid_synth_api_exit(synth);
 }
 
-fluid_voice_t *
-fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel, fluid_zone_range_t *zone_range)
+/*
+ * Handler for synth.interp-qos.* settings, apply to the voices started afterwards.
+ */
+static void fluid_synth_handle_interp_qos_num(void *data, const char *name, double value)
 {
-    int i, k;
-    fluid_voice_t *voice = NULL;
-    fluid_channel_t *channel = NULL;
-    unsigned int ticks;
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-    /* check if there's an available synthesis process */
-    for(i = 0; i < synth->polyphony; i++)
+    fluid_synth_api_enter(synth);
+
+    if(FLUID_STRCMP(name, "synth.interp-qos.attenuation") == 0)
     {
-        if(_AVAILABLE(synth->voice[i]))
-        {
-            voice = synth->voice[i];
-            break;
-        }
+        synth->interp_qos_attenuation = value;
     }
-
-    /* No success yet? Then stop a running voice. */
-    if(voice == NULL)
+    else if(FLUID_STRCMP(name, "synth.interp-qos.release-time") == 0)
     {
-        FLUID_LOG(FLUID_DBG, "Polyphony exceeded, trying to kill a voice");
-        voice = fluid_synth_free_voice_by_kill_LOCAL(synth);
+        synth->interp_qos_release_time = value;
     }
 
-    if(voice == NULL)
+    fluid_synth_api_exit(synth);
+}
+
+/*
+ * Limit the voices to 4th order interpolation while the synth is overloaded,
+ * or give them back the interpolation method of their channel.
+ */
+static void
+fluid_synth_degrade_interp_LOCAL(fluid_synth_t *synth, int degrade)
+{
+    int i, method;
+
+    if(synth->interp_degraded == degrade)
     {
-        FLUID_LOG(FLUID_WARN, "Failed to allocate a synthesis process. (chan=%d,key=%d)", chan, key);
-        return NULL;
+        return;
     }
 
-    ticks = fluid_synth_get_ticks(synth);
+    synth->interp_degraded = degrade;
 
-    if(synth->verbose)
+    for(i = 0; i < synth->polyphony; i++)
     {
-        k = 0;
+        fluid_voice_t *voice = synth->voice[i];
 
-        for(i = 0; i < synth->polyphony; i++)
+        if(!fluid_voice_is_playing(voice))
         {
-            if(!_AVAILABLE(synth->voice[i]))
-            {
-                k++;
-            }
+            continue;
         }
 
-        FLUID_LOG(FLUID_INFO, "noteon\t%d\t%d\t%d\t%05d\t%.3f\t%.3f\t%.3f\t%d",
-                  chan, key, vel, synth->storeid,
-                  (float) ticks / 44100.0f,
-                  (fluid_curtime() - synth->start) / 1000.0f,
-                  0.0f,
-                  k);
+        method = fluid_channel_get_interp_method(voice->channel);
+
+        if(method > FLUID_INTERP_4THORDER)
+        {
+            fluid_voice_set_interp_method(voice, degrade ? FLUID_INTERP_4THORDER : method);
+        }
     }
+}
 
-    channel = synth->channel[chan];
+/* Overflow priority of voices which can be reused right away. */
+#define OVERFLOW_PRIO_AVAILABLE (-OVERFLOW_PRIO_CANNOT_KILL)
 
-    if(fluid_voice_init(voice, sample, zone_range, channel, key, vel,
-                        synth->storeid, ticks, synth->gain) != FLUID_OK)
+/* Maximum depth of the overflow heap is log2(65535 voices) */
+#define OVERFLOW_HEAP_MAX_DEPTH 16
+
+/*
+ * Voice stealing
+ *
+ * The overflow priority of a voice is the sum of a part which only changes
+ * when the voice changes its state, see fluid_voice_get_overflow_prio_base(),
+ * and a part depending on the age of the voice, which has the sign of
+ * synth.overflow.age and shrinks towards zero as the voice gets older. The
+ * voices are kept in a binary min-heap on the former, which is updated
+ * whenever a voice changes its state. As the priority of a voice can't be less
+ * than its key in the heap plus the lowest possible age part, the search for
+ * the voice with the lowest priority can skip any subtree whose root's key
+ * plus that bound is not less than the best priority found so far. The bound
+ * is zero unless synth.overflow.age is negative.
+ */
+
+/* Get the key of a voice in the overflow heap. */
+static float
+fluid_synth_get_overflow_heap_key(fluid_synth_t *synth, fluid_voice_t *voice)
+{
+    if(_AVAILABLE(voice))
     {
-        FLUID_LOG(FLUID_WARN, "Failed to initialize voice");
-        return NULL;
+        return OVERFLOW_PRIO_AVAILABLE;
     }
 
-    /* add the default modulators to the synthesis process. */
-    /* custom_breath2att_modulator is not a default modulator specified in SF
-      it is intended to replace default_vel2att_mod for this channel on demand using
-      API fluid_synth_set_breath_mode() or shell command setbreathmode for this channel.
-    */
+    /* Are we already overflowing? */
+    if(!voice->can_access_overflow_rvoice)
     {
-        int mono = fluid_channel_is_playing_mono(channel);
-        fluid_mod_t *default_mod = synth->default_mod;
+        return OVERFLOW_PRIO_CANNOT_KILL;
+    }
 
-        while(default_mod != NULL)
-        {
-            if(
-                /* See if default_mod is the velocity_to_attenuation modulator */
-                fluid_mod_test_identity(default_mod, &default_vel2att_mod) &&
-                // See if a replacement by custom_breath2att_modulator has been demanded
-                // for this channel
-                ((!mono && (channel->mode &  FLUID_CHANNEL_BREATH_POLY)) ||
-                 (mono && (channel->mode &  FLUID_CHANNEL_BREATH_MONO)))
-            )
-            {
-                // Replacement of default_vel2att modulator by custom_breath2att_modulator
-                fluid_voice_add_mod_local(voice, &custom_breath2att_mod, FLUID_VOICE_DEFAULT, 0);
-            }
-            else
-            {
-                fluid_voice_add_mod_local(voice, default_mod, FLUID_VOICE_DEFAULT, 0);
-            }
+    return fluid_voice_get_overflow_prio_base(voice, &synth->overflow);
+}
 
-            // Next default modulator to add to the voice
-            default_mod = default_mod->next;
+static FLUID_INLINE void
+fluid_synth_set_overflow_heap_entry(fluid_synth_t *synth, int i, fluid_voice_t *voice)
+{
+    synth->overflow_heap[i] = voice;
+    voice->overflow_heap_index = i;
+}
+
+static void
+fluid_synth_overflow_heap_sift_up(fluid_synth_t *synth, int i)
+{
+    fluid_voice_t *voice = synth->overflow_heap[i];
+
+    while(i > 0)
+    {
+        int parent = (i - 1) / 2;
+
+        if(synth->overflow_heap[parent]->overflow_prio <= voice->overflow_prio)
+        {
+            break;
         }
+
+        fluid_synth_set_overflow_heap_entry(synth, i, synth->overflow_heap[parent]);
+        i = parent;
     }
 
-    return voice;
+    fluid_synth_set_overflow_heap_entry(synth, i, voice);
 }
 
-/* Kill all voices on a given channel, which have the same exclusive class
- * generator as new_voice.
- */
 static void
-fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
-        fluid_voice_t *new_voice)
+fluid_synth_overflow_heap_sift_down(fluid_synth_t *synth, int i)
 {
-    int excl_class = fluid_voice_gen_value(new_voice, GEN_EXCLUSIVECLASS);
-    int i;
+    fluid_voice_t *voice = synth->overflow_heap[i];
+    int size = synth->polyphony;
 
-    /* Excl. class 0: No exclusive class */
-    if(excl_class == 0)
+    for(;;)
     {
-        return;
-    }
+        int child = 2 * i + 1;
 
-    /* Kill all notes on the same channel with the same exclusive class */
-    for(i = 0; i < synth->polyphony; i++)
-    {
-        fluid_voice_t *existing_voice = synth->voice[i];
-        int existing_excl_class = fluid_voice_gen_value(existing_voice, GEN_EXCLUSIVECLASS);
+        if(child >= size)
+        {
+            break;
+        }
 
-        /* If voice is playing, on the same channel, has same exclusive
-         * class and is not part of the same noteon event (voice group), then kill it */
+        if(child + 1 < size
+                && synth->overflow_heap[child + 1]->overflow_prio < synth->overflow_heap[child]->overflow_prio)
+        {
+            child++;
+        }
 
-        if(fluid_voice_is_playing(existing_voice)
-                && fluid_voice_get_channel(existing_voice) == fluid_voice_get_channel(new_voice)
-                && existing_excl_class == excl_class
-                && fluid_voice_get_id(existing_voice) != fluid_voice_get_id(new_voice))
+        if(voice->overflow_prio <= synth->overflow_heap[child]->overflow_prio)
         {
-            fluid_voice_kill_excl(existing_voice);
+            break;
         }
+
+        fluid_synth_set_overflow_heap_entry(synth, i, synth->overflow_heap[child]);
+        i = child;
     }
+
+    fluid_synth_set_overflow_heap_entry(synth, i, voice);
 }
 
-/**
- * Activate a voice previously allocated with fluid_synth_alloc_voice().
- * @param synth FluidSynth instance
- * @param voice Voice to activate
- *
- * This function is called by a SoundFont's preset in response to a noteon
- * event.  Exclusive classes are processed here.
- *
- * @note Should only be called from within synthesis thread, which includes
- * SoundFont loader preset noteon method.
+/*
+ * Recalculate the key of all voices and rebuild the overflow heap. Needed when
+ * the polyphony or anything the keys of all voices depend on has changed.
  */
-void
-fluid_synth_start_voice(fluid_synth_t *synth, fluid_voice_t *voice)
+static void
+fluid_synth_rebuild_overflow_heap_LOCAL(fluid_synth_t *synth)
 {
-    fluid_return_if_fail(synth != NULL);
-    fluid_return_if_fail(voice != NULL);
-//  fluid_return_if_fail (fluid_synth_is_synth_thread (synth));
-    fluid_synth_api_enter(synth);
+    int i;
 
-    /* Find the exclusive class of this voice. If set, kill all voices
-     * that match the exclusive class and are younger than the first
-     * voice process created by this noteon event. */
-    fluid_synth_kill_by_exclusive_class_LOCAL(synth, voice);
+    if(synth->overflow_heap == NULL)
+    {
+        return;
+    }
 
-    fluid_voice_start(voice);     /* Start the new voice */
-    fluid_voice_lock_rvoice(voice);
-    fluid_rvoice_eventhandler_add_rvoice(synth->eventhandler, voice->rvoice);
-    fluid_synth_api_exit(synth);
+    for(i = synth->polyphony; i < synth->nvoice; i++)
+    {
+        synth->voice[i]->overflow_heap_index = -1;
+    }
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+        voice->overflow_prio = fluid_synth_get_overflow_heap_key(synth, voice);
+        fluid_synth_set_overflow_heap_entry(synth, i, voice);
+    }
+
+    for(i = synth->polyphony / 2 - 1; i >= 0; i--)
+    {
+        fluid_synth_overflow_heap_sift_down(synth, i);
+    }
 }
 
-/**
- * Add a SoundFont loader to the synth. This function takes ownership of \c loader
- * and frees it automatically upon \c synth destruction.
- * @param synth FluidSynth instance
- * @param loader Loader API structure
- *
- * SoundFont loaders are used to add custom instrument loading to FluidSynth.
- * The caller supplied functions for loading files, allocating presets,
- * retrieving information on them and synthesizing note-on events.  Using this
- * method even non SoundFont instruments can be synthesized, although limited
- * to the SoundFont synthesis model.
- *
- * @note Should only be called before any SoundFont files are loaded.
+/*
+ * Called whenever a voice has been started or stopped, right after the count of
+ * active voices has been updated, to queue it for fluid_synth_pop_voice_activity().
+ * It is lost if the queue is full, but the count of the next one tells the truth.
  */
 void
-fluid_synth_add_sfloader(fluid_synth_t *synth, fluid_sfloader_t *loader)
+fluid_synth_voice_activity_LOCAL(fluid_synth_t *synth, int type, int chan, int key, unsigned int id)
 {
-    fluid_return_if_fail(synth != NULL);
-    fluid_return_if_fail(loader != NULL);
-    fluid_synth_api_enter(synth);
+    fluid_voice_activity_t *activity;
 
-    /* Test if sfont is already loaded */
-    if(synth->sfont == NULL)
+    if(synth->voice_activity == NULL)
     {
-        synth->loaders = fluid_list_prepend(synth->loaders, loader);
+        return;
     }
 
-    fluid_synth_api_exit(synth);
+    activity = fluid_ringbuffer_get_inptr(synth->voice_activity, 0);
+
+    if(activity == NULL)
+    {
+        return;
+    }
+
+    activity->type = type;
+    activity->chan = chan;
+    activity->key = key;
+    activity->id = id;
+    activity->active_voices = synth->active_voice_count;
+    fluid_ringbuffer_next_inptr(synth->voice_activity, 1);
 }
 
-/**
- * Load a SoundFont file (filename is interpreted by SoundFont loaders).
- * The newly loaded SoundFont will be put on top of the SoundFont
- * stack. Presets are searched starting from the SoundFont on the
- * top of the stack, working the way down the stack until a preset is found.
- *
- * @param synth FluidSynth instance
- * @param filename File to load
- * @param reset_presets TRUE to re-assign presets for all MIDI channels (equivalent to calling fluid_synth_program_reset())
- * @return SoundFont ID on success, #FLUID_FAILED on error
+/*
+ * Called whenever the overflow priority of a voice may have changed, i.e. if
+ * the voice has been started, stopped, released, sustained or its attenuation
+ * has changed.
  */
-int
-fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets)
+void
+fluid_synth_update_overflow_prio_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice)
 {
-    fluid_sfont_t *sfont;
-    fluid_list_t *list;
-    fluid_sfloader_t *loader;
-    int sfont_id;
+    int i = voice->overflow_heap_index;
+    float old_prio;
 
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
-    fluid_synth_api_enter(synth);
+    /* voices above the polyphony are not part of the heap */
+    if(i < 0 || i >= synth->polyphony || synth->overflow_heap[i] != voice)
+    {
+        return;
+    }
 
-    sfont_id = synth->sfont_id;
+    old_prio = voice->overflow_prio;
+    voice->overflow_prio = fluid_synth_get_overflow_heap_key(synth, voice);
 
-    if(++sfont_id != FLUID_FAILED)
+    if(voice->overflow_prio < old_prio)
     {
-        /* MT NOTE: Loaders list should not change. */
-
-        for(list = synth->loaders; list; list = fluid_list_next(list))
-        {
-            loader = (fluid_sfloader_t *) fluid_list_get(list);
+        fluid_synth_overflow_heap_sift_up(synth, i);
+    }
+    else if(voice->overflow_prio > old_prio)
+    {
+        fluid_synth_overflow_heap_sift_down(synth, i);
+    }
+}
 
-            sfont = fluid_sfloader_load(loader, filename);
+/*
+ * Get a voice which can be reused right away, or NULL if all voices are busy.
+ * Available voices have the lowest key of all, so if there is any, one of them
+ * is at the top of the overflow heap.
+ */
+static fluid_voice_t *
+fluid_synth_get_available_voice_LOCAL(fluid_synth_t *synth)
+{
+    if(synth->polyphony > 0 && synth->overflow_heap[0]->overflow_prio == OVERFLOW_PRIO_AVAILABLE)
+    {
+        return synth->overflow_heap[0];
+    }
 
-            if(sfont != NULL)
-            {
-                sfont->refcount++;
-                synth->sfont_id = sfont->id = sfont_id;
+    return NULL;
+}
 
-                synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
+/* The voices fluid_synth_free_voice_by_kill_LOCAL() selects from, besides the ones of a channel */
+#define FLUID_KILL_ANY         (-1)  /* any voice */
+#define FLUID_KILL_OVER_QUOTA  (-2)  /* the voices of the channels playing more voices than their quota */
 
-                /* reset the presets for all channels if requested */
-                if(reset_presets)
-                {
-                    fluid_synth_program_reset(synth);
-                }
+/* Can the voice be selected for killing among the voices of chan? */
+static FLUID_INLINE int
+fluid_synth_may_kill_voice(fluid_voice_t *voice, int chan)
+{
+    if(chan == FLUID_KILL_ANY)
+    {
+        return TRUE;
+    }
 
-                FLUID_API_RETURN(sfont_id);
-            }
-        }
+    if(chan == FLUID_KILL_OVER_QUOTA)
+    {
+        return voice->channel->voice_count > voice->channel->voice_quota;
     }
 
-    FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
-    FLUID_API_RETURN(FLUID_FAILED);
+    return voice->chan == chan;
 }
 
-/**
- * Unload a SoundFont.
- * @param synth FluidSynth instance
- * @param id ID of SoundFont to unload
- * @param reset_presets TRUE to re-assign presets for all MIDI channels
- * @return #FLUID_OK on success, #FLUID_FAILED on error
+/*
+ * Selects a voice for killing, never one which is available already,
+ * among the voices of a channel, or see FLUID_KILL_ANY and FLUID_KILL_OVER_QUOTA.
  */
-int
-fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets)
+static fluid_voice_t *
+fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth, int chan)
 {
-    fluid_sfont_t *sfont = NULL;
-    fluid_list_t *list;
-
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_synth_api_enter(synth);
+    int stack[2 * OVERFLOW_HEAP_MAX_DEPTH + 2];
+    int i, sp = 0;
+    float best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
+    float this_voice_prio;
+    float min_age = 0;
+    fluid_voice_t *voice, *best_voice = NULL;
+    unsigned int ticks = fluid_synth_get_ticks(synth);
 
-    /* remove the SoundFont from the list */
-    for(list = synth->sfont; list; list = fluid_list_next(list))
+    if(synth->polyphony <= 0)
     {
-        sfont = fluid_list_get(list);
-
-        if(fluid_sfont_get_id(sfont) == id)
-        {
-            synth->sfont = fluid_list_remove(synth->sfont, sfont);
-            break;
-        }
+        return NULL;
     }
 
-    if(!list)
+    /* a negative age part is at its lowest for a voice started in this block */
+    if(synth->overflow.age < 0)
     {
-        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
-        FLUID_API_RETURN(FLUID_FAILED);
+        min_age = synth->overflow.age * synth->sample_rate;
     }
 
-    /* reset the presets for all channels (SoundFont will be freed when there are no more references) */
-    if(reset_presets)
-    {
-        fluid_synth_program_reset(synth);
-    }
-    else
-    {
-        fluid_synth_update_presets(synth);
-    }
+    /* Depth first search of the heap. The stack holds at most one sibling
+     * per level of the heap, plus the two children of the current node. */
+    stack[sp++] = 0;
 
-    /* -- Remove synth->sfont list's reference to SoundFont */
-    fluid_synth_sfont_unref(synth, sfont);
+    while(sp > 0)
+    {
+        i = stack[--sp];
+        voice = synth->overflow_heap[i];
 
-    FLUID_API_RETURN(FLUID_OK);
-}
+        /* neither this voice nor any voice below it can beat the current candidate */
+        if(voice->overflow_prio + min_age >= best_prio)
+        {
+            continue;
+        }
 
-/* Unref a SoundFont and destroy if no more references */
-void
-fluid_synth_sfont_unref(fluid_synth_t *synth, fluid_sfont_t *sfont)
-{
-    fluid_return_if_fail(sfont != NULL);     /* Shouldn't happen, programming error if so */
+        this_voice_prio = voice->overflow_prio
+                          + fluid_voice_get_overflow_prio_age(voice, &synth->overflow, ticks);
 
-    sfont->refcount--;             /* -- Remove the sfont list's reference */
+        /* check if this voice has less priority than the previous candidate.
+         * Available voices are skipped, the voices below them are not. Voices
+         * which cannot be killed stay so whatever their age part. */
+        if(this_voice_prio < best_prio && voice->overflow_prio != OVERFLOW_PRIO_AVAILABLE
+                && voice->overflow_prio < OVERFLOW_PRIO_CANNOT_KILL
+                && fluid_synth_may_kill_voice(voice, chan))
+        {
+            best_voice = voice;
+            best_prio = this_voice_prio;
+        }
 
-    if(sfont->refcount == 0)  /* No more references? - Attempt delete */
-    {
-        if(fluid_sfont_delete_internal(sfont) == 0)      /* SoundFont loader can block SoundFont unload */
+        if(2 * i + 2 < synth->polyphony)
         {
-            FLUID_LOG(FLUID_DBG, "Unloaded SoundFont");
-        } /* spin off a timer thread to unload the sfont later (SoundFont loader blocked unload) */
-        else
+            stack[sp++] = 2 * i + 2;
+        }
+
+        if(2 * i + 1 < synth->polyphony)
         {
-            new_fluid_timer(100, fluid_synth_sfunload_callback, sfont, TRUE, TRUE, FALSE);
+            stack[sp++] = 2 * i + 1;
         }
     }
+
+    if(best_voice == NULL)
+    {
+        return NULL;
+    }
+
+    voice = best_voice;
+    FLUID_LOG(FLUID_DBG, "Killing voice %d, chan %d, key %d ",
+              fluid_voice_get_id(voice), fluid_voice_get_channel(voice), fluid_voice_get_key(voice));
+    fluid_voice_off(voice);
+
+    return voice;
 }
 
-/* Callback to continually attempt to unload a SoundFont,
- * only if a SoundFont loader blocked the unload operation */
-static int
-fluid_synth_sfunload_callback(void *data, unsigned int msec)
+/*
+ * Selects a voice for killing to start a new one on a channel, once the polyphony is exhausted.
+ * With voice quotas, a channel playing as many voices as its quota, or more, gives up one
+ * of its own voices first. Otherwise the voices are taken back from the channels borrowing
+ * beyond their quota, and only a channel playing fewer voices than its quota takes one
+ * from any channel if there is none. Without quotas, all channels borrow.
+ */
+static fluid_voice_t *
+fluid_synth_free_voice_for_channel_LOCAL(fluid_synth_t *synth, int chan)
 {
-    fluid_sfont_t *sfont = data;
+    fluid_channel_t *channel = synth->channel[chan];
+    fluid_voice_t *voice = NULL;
 
-    if(fluid_sfont_delete_internal(sfont) == 0)
+    if(synth->voice_quota_channels == 0)
     {
-        FLUID_LOG(FLUID_DBG, "Unloaded SoundFont");
-        return FALSE;
+        return fluid_synth_free_voice_by_kill_LOCAL(synth, FLUID_KILL_ANY);
     }
-    else
+
+    if(channel->voice_quota > 0 && channel->voice_count >= channel->voice_quota)
     {
-        return TRUE;
+        voice = fluid_synth_free_voice_by_kill_LOCAL(synth, chan);
+    }
+
+    if(voice == NULL)
+    {
+        voice = fluid_synth_free_voice_by_kill_LOCAL(synth, FLUID_KILL_OVER_QUOTA);
+    }
+
+    if(voice == NULL && channel->voice_count < channel->voice_quota)
+    {
+        voice = fluid_synth_free_voice_by_kill_LOCAL(synth, FLUID_KILL_ANY);
+    }
+
+    return voice;
+}
+
+/* Kills the voices with the lowest overflow priority, until no more than limit are playing. */
+static void
+fluid_synth_kill_voices_LOCAL(fluid_synth_t *synth, int limit)
+{
+    int n = synth->active_voice_count - limit;
+    fluid_voice_t *voice;
+
+    while(n-- > 0 && (voice = fluid_synth_free_voice_by_kill_LOCAL(synth, FLUID_KILL_ANY)) != NULL)
+    {
+        /* the voice plays on until its rvoice has finished, it must not be picked again */
+        voice->overflow_prio = OVERFLOW_PRIO_CANNOT_KILL;
+        fluid_synth_overflow_heap_sift_down(synth, voice->overflow_heap_index);
     }
 }
 
+
 /**
- * Reload a SoundFont.  The SoundFont retains its ID and index on the SoundFont stack.
+ * Allocate a synthesis voice.
  * @param synth FluidSynth instance
- * @param id ID of SoundFont to reload
- * @return SoundFont ID on success, #FLUID_FAILED on error
+ * @param sample Sample to assign to the voice
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param key MIDI note number for the voice (0-127)
+ * @param vel MIDI velocity for the voice (0-127)
+ * @return Allocated synthesis voice or NULL on error
+ *
+ * This function is called by a SoundFont's preset in response to a noteon event.
+ * The returned voice comes with default modulators and generators.
+ * A single noteon event may create any number of voices, when the preset is layered.
+ *
+ * @note Should only be called from within synthesis thread, which includes
+ * SoundFont loader preset noteon method.
  */
-int
-fluid_synth_sfreload(fluid_synth_t *synth, int id)
+fluid_voice_t *
+fluid_synth_alloc_voice(fluid_synth_t *synth, fluid_sample_t *sample,
+                        int chan, int key, int vel)
 {
-    char *filename = NULL;
-    fluid_sfont_t *sfont;
-    fluid_sfloader_t *loader;
-    fluid_list_t *list;
-    int index, ret = FLUID_FAILED;
+    fluid_return_val_if_fail(sample != NULL, NULL);
+    FLUID_API_ENTRY_CHAN(NULL);
+    FLUID_API_RETURN(fluid_synth_alloc_voice_LOCAL(synth, sample, chan, key, vel, NULL));
 
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_synth_api_enter(synth);
+}
 
-    /* Search for SoundFont and get its index */
-    for(list = synth->sfont, index = 0; list; list = fluid_list_next(list), index++)
+fluid_voice_t *
+fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel, fluid_zone_range_t *zone_range)
+{
+    int i, k;
+    fluid_voice_t *voice = NULL;
+    fluid_channel_t *channel = NULL;
+    unsigned int ticks;
+    int voice_limit = fluid_atomic_int_get(&synth->voice_limit);
+
+    /* check if there's an available synthesis process, unless the synth is
+     * overloaded and plays as many voices as it currently can */
+    if(voice_limit == 0 || synth->active_voice_count < voice_limit)
     {
-        sfont = fluid_list_get(list);
+        voice = fluid_synth_get_available_voice_LOCAL(synth);
+    }
 
-        if(fluid_sfont_get_id(sfont) == id)
+    /* No success yet? Then stop a running voice. */
+    if(voice == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Polyphony exceeded, trying to kill a voice");
+        voice = fluid_synth_free_voice_for_channel_LOCAL(synth, chan);
+
+        if(voice != NULL)
         {
-            break;
+            fluid_atomic_int_inc(&synth->stolen_voices);
         }
     }
 
-    if(!list)
+    if(voice == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
-        goto exit;
+        FLUID_LOG(FLUID_WARN, "Failed to allocate a synthesis process. (chan=%d,key=%d)", chan, key);
+        return NULL;
     }
 
-    /* keep a copy of the SoundFont's filename */
-    filename = FLUID_STRDUP(fluid_sfont_get_name(sfont));
+    ticks = fluid_synth_get_ticks(synth);
 
-    if(filename == NULL || fluid_synth_sfunload(synth, id, FALSE) != FLUID_OK)
+    if(synth->verbose)
     {
-        goto exit;
+        k = 0;
+
+        for(i = 0; i < synth->polyphony; i++)
+        {
+            if(!_AVAILABLE(synth->voice[i]))
+            {
+                k++;
+            }
+        }
+
+        FLUID_LOG(FLUID_INFO, "noteon\t%d\t%d\t%d\t%05d\t%.3f\t%.3f\t%.3f\t%d",
+                  chan, key, vel, synth->storeid,
+                  (float) ticks / 44100.0f,
+                  (fluid_curtime() - synth->start) / 1000.0f,
+                  0.0f,
+                  k);
     }
 
-    /* MT Note: SoundFont loader list will not change */
+    channel = synth->channel[chan];
 
-    for(list = synth->loaders; list; list = fluid_list_next(list))
+    if(fluid_voice_init(voice, sample, zone_range, channel, key, vel,
+                        synth->storeid, ticks, synth->gain) != FLUID_OK)
     {
-        loader = (fluid_sfloader_t *) fluid_list_get(list);
+        FLUID_LOG(FLUID_WARN, "Failed to initialize voice");
+        return NULL;
+    }
 
-        sfont = fluid_sfloader_load(loader, filename);
+    /* add the default modulators to the synthesis process. */
+    /* custom_breath2att_modulator is not a default modulator specified in SF
+      it is intended to replace default_vel2att_mod for this channel on demand using
+      API fluid_synth_set_breath_mode() or shell command setbreathmode for this channel.
+    */
+    {
+        int mono = fluid_channel_is_playing_mono(channel);
+        fluid_mod_t *default_mod = synth->default_mod;
 
-        if(sfont != NULL)
+        while(default_mod != NULL)
         {
-            sfont->id = id;
-            sfont->refcount++;
-
-            synth->sfont = fluid_list_insert_at(synth->sfont, index, sfont);  /* insert the sfont at the same index */
+            if(
+                /* See if default_mod is the velocity_to_attenuation modulator */
+                fluid_mod_test_identity(default_mod, &default_vel2att_mod) &&
+                // See if a replacement by custom_breath2att_modulator has been demanded
+                // for this channel
+                ((!mono && (channel->mode &  FLUID_CHANNEL_BREATH_POLY)) ||
+                 (mono && (channel->mode &  FLUID_CHANNEL_BREATH_MONO)))
+            )
+            {
+                // Replacement of default_vel2att modulator by custom_breath2att_modulator
+                fluid_voice_add_mod_local(voice, &custom_breath2att_mod, FLUID_VOICE_DEFAULT, 0);
+            }
+            else
+            {
+                fluid_voice_add_mod_local(voice, default_mod, FLUID_VOICE_DEFAULT, 0);
+            }
 
-            /* reset the presets for all channels */
-            fluid_synth_update_presets(synth);
-            ret = id;
-            goto exit;
+            // Next default modulator to add to the voice
+            default_mod = default_mod->next;
         }
     }
 
-    FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
-
-exit:
-    FLUID_FREE(filename);
-    FLUID_API_RETURN(ret);
+    return voice;
 }
 
-/**
- * Add a SoundFont.  The SoundFont will be added to the top of the SoundFont stack.
- * @param synth FluidSynth instance
- * @param sfont SoundFont to add
- * @return New assigned SoundFont ID or #FLUID_FAILED on error
+/* Kill all voices on a given channel, which have the same exclusive class
+ * generator as new_voice, and add new_voice to the voices of its class.
  */
-int
-fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+static void
+fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
+        fluid_voice_t *new_voice)
 {
-    int sfont_id;
-
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(sfont != NULL, FLUID_FAILED);
-    fluid_synth_api_enter(synth);
+    int excl_class = fluid_voice_gen_value(new_voice, GEN_EXCLUSIVECLASS);
+    fluid_voice_t *existing_voice, *next;
 
-    sfont_id = synth->sfont_id;
+    /* Excl. class 0: No exclusive class */
+    if(excl_class == 0)
+    {
+        return;
+    }
 
-    if(++sfont_id != FLUID_FAILED)
+    /* Kill all notes on the same channel with the same exclusive class */
+    for(existing_voice = new_voice->channel->excl_voices[excl_class & 127]; existing_voice != NULL;
+            existing_voice = next)
     {
-        synth->sfont_id = sfont->id = sfont_id;
-        synth->sfont = fluid_list_prepend(synth->sfont, sfont);        /* prepend to list */
+        /* killing the voice unlinks it */
+        next = existing_voice->excl_next;
 
-        /* reset the presets for all channels */
-        fluid_synth_program_reset(synth);
+        /* If voice is playing, has same exclusive class and is not part
+         * of the same noteon event (voice group), then kill it */
+
+        if(fluid_voice_is_playing(existing_voice)
+                && existing_voice->excl_class == excl_class
+                && fluid_voice_get_id(existing_voice) != fluid_voice_get_id(new_voice))
+        {
+            fluid_voice_kill_excl(existing_voice);
+        }
     }
 
-    FLUID_API_RETURN(sfont_id);
+    fluid_voice_link_excl(new_voice);
 }
 
 /**
- * Remove a SoundFont from the SoundFont stack without deleting it.
+ * Activate a voice previously allocated with fluid_synth_alloc_voice().
  * @param synth FluidSynth instance
- * @param sfont SoundFont to remove
- * @return #FLUID_OK if \c sfont successfully removed, #FLUID_FAILED otherwise
+ * @param voice Voice to activate
  *
- * SoundFont is not freed and is left as the responsibility of the caller.
+ * This function is called by a SoundFont's preset in response to a noteon
+ * event.  Exclusive classes are processed here.
  *
- * @note The SoundFont should only be freed after there are no presets
- *   referencing it.  This can only be ensured by the SoundFont loader and
- *   therefore this function should not normally be used.
+ * @note Should only be called from within synthesis thread, which includes
+ * SoundFont loader preset noteon method.
  */
-int
-fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+void
+fluid_synth_start_voice(fluid_synth_t *synth, fluid_voice_t *voice)
 {
-    fluid_sfont_t *sfont_tmp;
-    fluid_list_t *list;
-    int ret = FLUID_FAILED;
-
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(sfont != NULL, FLUID_FAILED);
+    fluid_return_if_fail(synth != NULL);
+    fluid_return_if_fail(voice != NULL);
+//  fluid_return_if_fail (fluid_synth_is_synth_thread (synth));
     fluid_synth_api_enter(synth);
+    fluid_synth_start_voice_LOCAL(synth, voice);
+    fluid_rvoice_eventhandler_add_rvoice(synth->eventhandler, voice->rvoice);
+    fluid_synth_api_exit(synth);
+}
 
-    /* remove the SoundFont from the list */
-    for(list = synth->sfont; list; list = fluid_list_next(list))
+/* Starts a voice, except for adding its rvoice to the mixer */
+static void
+fluid_synth_start_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice)
+{
+    /* Find the exclusive class of this voice. If set, kill all voices
+     * that match the exclusive class and are younger than the first
+     * voice process created by this noteon event. */
+    fluid_synth_kill_by_exclusive_class_LOCAL(synth, voice);
+
+    fluid_voice_start(voice);     /* Start the new voice */
+
+    if(synth->voice_start_offset > 0)
     {
-        sfont_tmp = fluid_list_get(list);
+        /* The voice starts in the middle of the next block */
+        fluid_rvoice_eventhandler_push_int_real(synth->eventhandler, fluid_rvoice_set_start_offset,
+                                                voice->rvoice, synth->voice_start_offset, 0.0f);
+    }
 
-        if(sfont_tmp == sfont)
+    if(synth->sample_streamer != NULL)
+    {
+        /* Stream the rest of the sample while the voice plays its head. The rvoice
+         * isn't rendered yet, its ring buffer is set directly. */
+        if(voice->rvoice->dsp.stream != NULL)
         {
-            synth->sfont = fluid_list_remove(synth->sfont, sfont_tmp);
-            ret = FLUID_OK;
-            break;
+            fluid_sample_stream_release(voice->rvoice->dsp.stream);
         }
-    }
 
-    /* reset the presets for all channels */
-    fluid_synth_program_reset(synth);
+        voice->rvoice->dsp.stream = fluid_sample_streamer_start(synth->sample_streamer, voice->sample);
+    }
 
-    FLUID_API_RETURN(ret);
+    fluid_voice_lock_rvoice(voice);
 }
 
-/**
- * Count number of loaded SoundFont files.
- * @param synth FluidSynth instance
- * @return Count of loaded SoundFont files.
+/*
+ * Starts a voice like fluid_synth_start_voice(), but leaves adding its rvoice
+ * to the mixer to fluid_synth_commit_voice_batch_LOCAL(), which adds all the
+ * voices of the batch with a single event. All layers and stereo pairs of a
+ * noteon thereby start rendering with the same block. The rvoice stays locked
+ * until the mixer got it, so its voice cannot be reused in the meantime.
+ * Voices playing both samples of a stereo pair are rendered together.
  */
-int
-fluid_synth_sfcount(fluid_synth_t *synth)
+void
+fluid_synth_start_voice_batch_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice, fluid_voice_batch_t *batch)
 {
-    int count;
+    fluid_synth_start_voice_LOCAL(synth, voice);
 
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
-    count = fluid_list_size(synth->sfont);
-    FLUID_API_RETURN(count);
+    if(batch->count == MAX_EVENT_PARAMS)
+    {
+        fluid_synth_commit_voice_batch_LOCAL(synth, batch);
+    }
+
+    batch->voices[batch->count] = voice;
+    batch->rvoices[batch->count++] = voice->rvoice;
 }
 
-/**
- * Get SoundFont by index.
- * @param synth FluidSynth instance
- * @param num SoundFont index on the stack (starting from 0 for top of stack).
- * @return SoundFont instance or NULL if invalid index
- *
- * @note Caller should be certain that SoundFont is not deleted (unloaded) for
- * the duration of use of the returned pointer.
+/*
+ * Pairs the voices of the batch playing both samples of a stereo pair, whose
+ * rvoices are then rendered together, see fluid_rvoice_write_stereo().
+ * A voice stolen by a later voice of the same noteon does not play the rvoice
+ * it was started with anymore and is left alone.
  */
-fluid_sfont_t *
-fluid_synth_get_sfont(fluid_synth_t *synth, unsigned int num)
+static void
+fluid_synth_pair_voice_batch_LOCAL(fluid_synth_t *synth, fluid_voice_batch_t *batch)
 {
-    fluid_sfont_t *sfont = NULL;
-    fluid_list_t *list;
+    int paired[MAX_EVENT_PARAMS] = { 0 };
+    int i, k;
 
-    fluid_return_val_if_fail(synth != NULL, NULL);
-    fluid_synth_api_enter(synth);
-    list = fluid_list_nth(synth->sfont, num);
+    for(i = 0; i < batch->count; i++)
+    {
+        if(paired[i] || batch->voices[i]->rvoice != batch->rvoices[i])
+        {
+            continue;
+        }
 
-    if(list)
+        for(k = i + 1; k < batch->count; k++)
+        {
+            if(!paired[k] && batch->voices[k]->rvoice == batch->rvoices[k]
+                    && fluid_voice_is_stereo_pair(batch->voices[i], batch->voices[k]))
+            {
+                fluid_rvoice_eventhandler_push_ptr(synth->eventhandler, fluid_rvoice_set_stereo_follower,
+                                                   batch->rvoices[i], batch->rvoices[k]);
+                paired[i] = paired[k] = TRUE;
+                break;
+            }
+        }
+    }
+}
+
+/* Adds the rvoices of the batch to the mixer and empties it */
+void
+fluid_synth_commit_voice_batch_LOCAL(fluid_synth_t *synth, fluid_voice_batch_t *batch)
+{
+    fluid_synth_pair_voice_batch_LOCAL(synth, batch);
+
+    if(batch->count == 1)
     {
-        sfont = fluid_list_get(list);
+        fluid_rvoice_eventhandler_add_rvoice(synth->eventhandler, batch->rvoices[0]);
+    }
+    else if(batch->count > 1)
+    {
+        fluid_rvoice_eventhandler_add_rvoices(synth->eventhandler, batch->rvoices, batch->count);
     }
 
-    FLUID_API_RETURN(sfont);
+    batch->count = 0;
 }
 
 /**
- * Get SoundFont by ID.
+ * Add a SoundFont loader to the synth. This function takes ownership of \c loader
+ * and frees it automatically upon \c synth destruction.
  * @param synth FluidSynth instance
- * @param id SoundFont ID
- * @return SoundFont instance or NULL if invalid ID
+ * @param loader Loader API structure
  *
- * @note Caller should be certain that SoundFont is not deleted (unloaded) for
- * the duration of use of the returned pointer.
+ * SoundFont loaders are used to add custom instrument loading to FluidSynth.
+ * The caller supplied functions for loading files, allocating presets,
+ * retrieving information on them and synthesizing note-on events.  Using this
+ * method even non SoundFont instruments can be synthesized, although limited
+ * to the SoundFont synthesis model.
+ *
+ * @note Should only be called before any SoundFont files are loaded.
  */
-fluid_sfont_t *
-fluid_synth_get_sfont_by_id(fluid_synth_t *synth, int id)
+void
+fluid_synth_add_sfloader(fluid_synth_t *synth, fluid_sfloader_t *loader)
 {
-    fluid_sfont_t *sfont = NULL;
-    fluid_list_t *list;
-
-    fluid_return_val_if_fail(synth != NULL, NULL);
+    fluid_return_if_fail(synth != NULL);
+    fluid_return_if_fail(loader != NULL);
     fluid_synth_api_enter(synth);
 
-    for(list = synth->sfont; list; list = fluid_list_next(list))
+    /* Test if sfont is already loaded */
+    if(synth->sfont == NULL)
     {
-        sfont = fluid_list_get(list);
-
-        if(fluid_sfont_get_id(sfont) == id)
-        {
-            break;
-        }
+        synth->loaders = fluid_list_prepend(synth->loaders, loader);
     }
 
-    FLUID_API_RETURN(list ? sfont : NULL);
+    fluid_synth_api_exit(synth);
 }
 
-/**
- * Get SoundFont by name.
- * @param synth FluidSynth instance
- * @param name Name of SoundFont
- * @return SoundFont instance or NULL if invalid name
- * @since 1.1.0
- *
- * @note Caller should be certain that SoundFont is not deleted (unloaded) for
- * the duration of use of the returned pointer.
- */
-fluid_sfont_t *
-fluid_synth_get_sfont_by_name(fluid_synth_t *synth, const char *name)
+/* A SoundFont loaded by fluid_synth_sfload_async() */
+typedef struct
+{
+    fluid_synth_t *synth;
+    char *filename;
+    int reset_presets;
+    fluid_sfload_callback_t callback;
+    void *data;
+    fluid_thread_t *thread;
+    int finished;               /* set by the loader thread once it is done */
+} fluid_synth_sfload_job_t;
+
+/* Load a SoundFont with the first loader accepting it */
+static fluid_sfont_t *
+fluid_synth_load_sfont(fluid_synth_t *synth, const char *filename)
 {
     fluid_sfont_t *sfont = NULL;
     fluid_list_t *list;
+    fluid_sfloader_t *loader;
+    fluid_trace_ref_var(trace_ref);
 
-    fluid_return_val_if_fail(synth != NULL, NULL);
-    fluid_return_val_if_fail(name != NULL, NULL);
-    fluid_synth_api_enter(synth);
+    /* MT NOTE: Loaders list should not change. */
 
-    for(list = synth->sfont; list; list = fluid_list_next(list))
+    for(list = synth->loaders; list; list = fluid_list_next(list))
     {
-        sfont = fluid_list_get(list);
+        loader = (fluid_sfloader_t *) fluid_list_get(list);
 
-        if(FLUID_STRCMP(fluid_sfont_get_name(sfont), name) == 0)
+        sfont = fluid_sfloader_load(loader, filename);
+
+        if(sfont != NULL)
         {
             break;
         }
     }
 
-    FLUID_API_RETURN(list ? sfont : NULL);
+    fluid_trace("sfload", trace_ref);
+    return sfont;
 }
 
-/**
- * Get active preset on a MIDI channel.
- * @param synth FluidSynth instance
- * @param chan MIDI channel number (0 to MIDI channel count - 1)
- * @return Preset or NULL if no preset active on \c chan
- *
- * @note Should only be called from within synthesis thread, which includes
- * SoundFont loader preset noteon methods. Not thread safe otherwise.
- */
-fluid_preset_t *
-fluid_synth_get_channel_preset(fluid_synth_t *synth, int chan)
+/* Put a loaded SoundFont on top of the stack, the API lock must be held */
+static void
+fluid_synth_push_sfont_LOCAL(fluid_synth_t *synth, fluid_sfont_t *sfont, int sfont_id,
+                             int reset_presets)
 {
-    fluid_preset_t *result;
-    fluid_channel_t *channel;
-    FLUID_API_ENTRY_CHAN(NULL);
+    fluid_atomic_int_inc(&sfont->refcount);
+    synth->sfont_id = sfont->id = sfont_id;
 
-    channel = synth->channel[chan];
-    result = channel->preset;
-    fluid_synth_api_exit(synth);
-    return result;
+    synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
+    fluid_synth_preset_index_add_sfont(synth, sfont);
+
+    /* reset the presets for all channels if requested */
+    if(reset_presets)
+    {
+        fluid_synth_program_reset(synth);
+    }
 }
 
-/**
- * Get list of currently playing voices.
- * @param synth FluidSynth instance
- * @param buf Array to store voices to (NULL terminated if not filled completely)
- * @param bufsize Count of indexes in buf
- * @param id Voice ID to search for or < 0 to return list of all playing voices
- *
- * @note Should only be called from within synthesis thread, which includes
- * SoundFont loader preset noteon methods.  Voices are only guaranteed to remain
- * unchanged until next synthesis process iteration.
- */
-void
-fluid_synth_get_voicelist(fluid_synth_t *synth, fluid_voice_t *buf[], int bufsize,
-                          int id)
+/* Join and free the asynchronous loads that are done, or all of them */
+static void
+fluid_synth_join_sfload_jobs(fluid_synth_t *synth, int all)
 {
-    int count = 0;
-    int i;
+    fluid_list_t *list, *next;
+    fluid_synth_sfload_job_t *job;
 
-    fluid_return_if_fail(synth != NULL);
-    fluid_return_if_fail(buf != NULL);
-    fluid_synth_api_enter(synth);
+    for(list = synth->sfload_jobs; list; list = next)
+    {
+        next = fluid_list_next(list);
+        job = fluid_list_get(list);
 
-    for(i = 0; i < synth->polyphony && count < bufsize; i++)
+        if(all || fluid_atomic_int_get(&job->finished))
+        {
+            fluid_thread_join(job->thread);
+            delete_fluid_thread(job->thread);
+            synth->sfload_jobs = fluid_list_remove(synth->sfload_jobs, job);
+
+            FLUID_FREE(job->filename);
+            FLUID_FREE(job);
+        }
+    }
+}
+
+static fluid_thread_return_t
+fluid_synth_sfload_run(void *data)
+{
+    fluid_synth_sfload_job_t *job = data;
+    fluid_synth_t *synth = job->synth;
+    fluid_sfont_t *sfont;
+    int sfont_id = FLUID_FAILED;
+
+    /* parse the file and load the samples without holding the API lock */
+    sfont = fluid_synth_load_sfont(synth, job->filename);
+
+    if(sfont != NULL)
     {
-        fluid_voice_t *voice = synth->voice[i];
+        fluid_synth_api_enter(synth);
 
-        if(fluid_voice_is_playing(voice) && (id < 0 || (int)voice->id == id))
+        if(synth->sfont_id + 1 != FLUID_FAILED)
         {
-            buf[count++] = voice;
+            sfont_id = synth->sfont_id + 1;
+            fluid_synth_push_sfont_LOCAL(synth, sfont, sfont_id, job->reset_presets);
+        }
+
+        fluid_synth_api_exit(synth);
+
+        if(sfont_id == FLUID_FAILED)
+        {
+            fluid_sfont_delete_internal(sfont);
         }
     }
 
-    if(count < bufsize)
+    if(sfont_id == FLUID_FAILED)
     {
-        buf[count] = NULL;
+        FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", job->filename);
     }
 
-    fluid_synth_api_exit(synth);
+    if(job->callback != NULL)
+    {
+        job->callback(job->data, synth, sfont_id);
+    }
+
+    fluid_atomic_int_set(&job->finished, TRUE);
+
+    return FLUID_THREAD_RETURN_VALUE;
 }
 
 /**
- * Enable or disable reverb effect.
+ * Load a SoundFont file (filename is interpreted by SoundFont loaders).
+ * The newly loaded SoundFont will be put on top of the SoundFont
+ * stack. Presets are searched starting from the SoundFont on the
+ * top of the stack, working the way down the stack until a preset is found.
+ *
  * @param synth FluidSynth instance
- * @param on TRUE to enable reverb, FALSE to disable
+ * @param filename File to load
+ * @param reset_presets TRUE to re-assign presets for all MIDI channels (equivalent to calling fluid_synth_program_reset())
+ * @return SoundFont ID on success, #FLUID_FAILED on error
  */
-void
-fluid_synth_set_reverb_on(fluid_synth_t *synth, int on)
+int
+fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets)
 {
-    fluid_return_if_fail(synth != NULL);
+    fluid_sfont_t *sfont;
+    int sfont_id;
 
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
     fluid_synth_api_enter(synth);
 
-    synth->with_reverb = (on != 0);
-    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_reverb_enabled,
-                             on != 0, 0.0f);
-    fluid_synth_api_exit(synth);
+    sfont_id = synth->sfont_id;
+
+    if(++sfont_id != FLUID_FAILED)
+    {
+        sfont = fluid_synth_load_sfont(synth, filename);
+
+        if(sfont != NULL)
+        {
+            fluid_synth_push_sfont_LOCAL(synth, sfont, sfont_id, reset_presets);
+            FLUID_API_RETURN(sfont_id);
+        }
+    }
+
+    FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
+    FLUID_API_RETURN(FLUID_FAILED);
 }
 
 /**
- * Activate a reverb preset.
+ * Load a SoundFont file in the background.
+ *
+ * Just like fluid_synth_sfload(), but the file is parsed and its samples are loaded by
+ * a separate thread, without holding the lock of the synth. Other calls of the API and
+ * the rendering carry on meanwhile. Once loaded, the SoundFont is put on top of the
+ * SoundFont stack and \p callback is called from the loading thread with its ID, or
+ * with #FLUID_FAILED if it couldn't be loaded. The SoundFont ID is only assigned then,
+ * so several fonts loaded at once get their IDs in the order they finish loading.
+ *
+ * The callback may call any function of the API, except delete_fluid_synth(), which
+ * waits for the pending loads to finish.
+ *
  * @param synth FluidSynth instance
- * @param num Reverb preset number
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @param filename File to load
+ * @param reset_presets TRUE to re-assign presets for all MIDI channels once loaded
+ * @param callback Function to call when done, may be NULL
+ * @param data User data passed to \p callback
+ * @return #FLUID_OK if the load was started, #FLUID_FAILED otherwise
  *
- * @note Currently private to libfluidsynth.
+ * @note Requires the setting synth.threadsafe-api to be enabled.
+ * @since 2.2.0
  */
 int
-fluid_synth_set_reverb_preset(fluid_synth_t *synth, unsigned int num)
+fluid_synth_sfload_async(fluid_synth_t *synth, const char *filename, int reset_presets,
+                         fluid_sfload_callback_t callback, void *data)
 {
-    fluid_return_val_if_fail(
-        num < FLUID_N_ELEMENTS(revmodel_preset),
-        FLUID_FAILED
-    );
+    fluid_synth_sfload_job_t *job;
 
-    fluid_synth_set_reverb(synth, revmodel_preset[num].roomsize,
-                           revmodel_preset[num].damp, revmodel_preset[num].width,
-                           revmodel_preset[num].level);
-    return FLUID_OK;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
+
+    if(!synth->use_mutex)
+    {
+        FLUID_LOG(FLUID_ERR, "Loading SoundFonts in the background requires synth.threadsafe-api");
+        return FLUID_FAILED;
+    }
+
+    job = FLUID_NEW(fluid_synth_sfload_job_t);
+
+    if(job == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(job, 0, sizeof(*job));
+    job->synth = synth;
+    job->filename = FLUID_STRDUP(filename);
+    job->reset_presets = reset_presets;
+    job->callback = callback;
+    job->data = data;
+
+    if(job->filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(job);
+        return FLUID_FAILED;
+    }
+
+    fluid_synth_api_enter(synth);
+
+    /* clean up after the loads done so far */
+    fluid_synth_join_sfload_jobs(synth, FALSE);
+
+    job->thread = new_fluid_thread("sfload", fluid_synth_sfload_run, job, 0, FALSE);
+
+    if(job->thread == NULL)
+    {
+        FLUID_FREE(job->filename);
+        FLUID_FREE(job);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    synth->sfload_jobs = fluid_list_prepend(synth->sfload_jobs, job);
+
+    FLUID_API_RETURN(FLUID_OK);
 }
 
 /**
- * Set reverb parameters.
+ * Unload a SoundFont.
+ * @param synth FluidSynth instance
+ * @param id ID of SoundFont to unload
+ * @param reset_presets TRUE to re-assign presets for all MIDI channels
+ * @return #FLUID_OK on success, #FLUID_FAILED on error
+ */
+int
+fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets)
+{
+    fluid_sfont_t *sfont = NULL;
+    fluid_list_t *list;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    /* remove the SoundFont from the list */
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(fluid_sfont_get_id(sfont) == id)
+        {
+            synth->sfont = fluid_list_remove(synth->sfont, sfont);
+            fluid_synth_preset_index_remove_sfont(synth, sfont);
+            break;
+        }
+    }
+
+    if(!list)
+    {
+        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    /* reset the presets for all channels (SoundFont will be freed when there are no more references) */
+    if(reset_presets)
+    {
+        fluid_synth_program_reset(synth);
+    }
+    else
+    {
+        fluid_synth_update_presets(synth);
+    }
+
+    /* -- Remove synth->sfont list's reference to SoundFont */
+    fluid_synth_sfont_unref(synth, sfont);
+
+    FLUID_API_RETURN(FLUID_OK);
+}
+
+/* Unref a SoundFont and destroy if no more references */
+void
+fluid_synth_sfont_unref(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_return_if_fail(sfont != NULL);     /* Shouldn't happen, programming error if so */
+
+    /* -- Remove the sfont list's reference, attempt delete if there are no more references */
+    if(fluid_atomic_int_dec_and_test(&sfont->refcount))
+    {
+        /* the notes recorded from its samples are never played again */
+        fluid_rvoice_eventhandler_push_ptr(synth->eventhandler, fluid_rvoice_mixer_clear_note_cache,
+                                           synth->eventhandler->mixer, NULL);
+
+        if(fluid_sfont_delete_internal(sfont) == 0)      /* SoundFont loader can block SoundFont unload */
+        {
+            FLUID_LOG(FLUID_DBG, "Unloaded SoundFont");
+        } /* let the reclaimer unload the sfont once its voices are done (SoundFont loader blocked unload) */
+        else if(fluid_synth_reclaim_sfont(synth, sfont) != FLUID_OK)
+        {
+            new_fluid_timer(100, fluid_synth_sfunload_callback, sfont, TRUE, TRUE, FALSE);
+        }
+    }
+}
+
+/* Callback to continually attempt to unload a SoundFont,
+ * only if a SoundFont loader blocked the unload operation
+ * and the SoundFont couldn't be left to the reclaimer */
+static int
+fluid_synth_sfunload_callback(void *data, unsigned int msec)
+{
+    fluid_sfont_t *sfont = data;
+
+    if(fluid_sfont_delete_internal(sfont) == 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Unloaded SoundFont");
+        return FALSE;
+    }
+    else
+    {
+        return TRUE;
+    }
+}
+
+/* Hand a SoundFont still in use over to the reclaimer thread, which is started on the first one.
+ * The API lock must be held. */
+static int
+fluid_synth_reclaim_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_sfont_reclaimer_t *reclaimer = synth->sfont_reclaimer;
+
+    if(reclaimer == NULL)
+    {
+        reclaimer = FLUID_NEW(fluid_sfont_reclaimer_t);
+
+        if(reclaimer == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(reclaimer, 0, sizeof(*reclaimer));
+        reclaimer->mutex = new_fluid_cond_mutex();
+        reclaimer->cond = new_fluid_cond();
+
+        if(reclaimer->mutex == NULL || reclaimer->cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_fluid_sfont_reclaimer(reclaimer);
+            return FLUID_FAILED;
+        }
+
+        reclaimer->thread = new_fluid_thread("sfont-reclaimer", fluid_synth_sfont_reclaimer_run, reclaimer, 0, FALSE);
+
+        if(reclaimer->thread == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to create the SoundFont reclaimer thread");
+            delete_fluid_sfont_reclaimer(reclaimer);
+            return FLUID_FAILED;
+        }
+
+        synth->sfont_reclaimer = reclaimer;
+    }
+
+    fluid_cond_mutex_lock(reclaimer->mutex);
+    reclaimer->sfonts = fluid_list_prepend(reclaimer->sfonts, sfont);
+    fluid_atomic_int_inc(&reclaimer->pending);
+    fluid_cond_mutex_unlock(reclaimer->mutex);
+
+    return FLUID_OK;
+}
+
+/* Let the reclaimer try to free the SoundFonts pending, as voices have finished */
+static void
+fluid_synth_wake_sfont_reclaimer(fluid_synth_t *synth)
+{
+    fluid_sfont_reclaimer_t *reclaimer = synth->sfont_reclaimer;
+
+    if(reclaimer == NULL || fluid_atomic_int_get(&reclaimer->pending) == 0)
+    {
+        return;
+    }
+
+    fluid_cond_mutex_lock(reclaimer->mutex);
+    reclaimer->request = TRUE;
+    fluid_cond_signal(reclaimer->cond);
+    fluid_cond_mutex_unlock(reclaimer->mutex);
+}
+
+static fluid_thread_return_t
+fluid_synth_sfont_reclaimer_run(void *data)
+{
+    fluid_sfont_reclaimer_t *reclaimer = data;
+    fluid_list_t *sfonts, *kept, *list;
+    fluid_sfont_t *sfont;
+
+    fluid_cond_mutex_lock(reclaimer->mutex);
+
+    while(!reclaimer->quit)
+    {
+        if(!reclaimer->request)
+        {
+            fluid_cond_wait(reclaimer->cond, reclaimer->mutex);
+            continue;
+        }
+
+        reclaimer->request = FALSE;
+        sfonts = reclaimer->sfonts;
+        reclaimer->sfonts = NULL;
+        fluid_cond_mutex_unlock(reclaimer->mutex);
+
+        /* free them outside the lock, keeping the ones still in use */
+        kept = NULL;
+
+        for(list = sfonts; list; list = fluid_list_next(list))
+        {
+            sfont = fluid_list_get(list);
+
+            if(fluid_sfont_delete_internal(sfont) == 0)
+            {
+                FLUID_LOG(FLUID_DBG, "Unloaded SoundFont");
+                fluid_atomic_int_add(&reclaimer->pending, -1);
+            }
+            else
+            {
+                kept = fluid_list_prepend(kept, sfont);
+            }
+        }
+
+        delete_fluid_list(sfonts);
+        fluid_cond_mutex_lock(reclaimer->mutex);
+
+        for(list = kept; list; list = fluid_list_next(list))
+        {
+            reclaimer->sfonts = fluid_list_prepend(reclaimer->sfonts, fluid_list_get(list));
+        }
+
+        delete_fluid_list(kept);
+    }
+
+    fluid_cond_mutex_unlock(reclaimer->mutex);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Stop the reclaimer thread, and free the SoundFonts pending that aren't used
+ * by other synths anymore. The voices of the synth must have been stopped. */
+static void
+delete_fluid_sfont_reclaimer(fluid_sfont_reclaimer_t *reclaimer)
+{
+    fluid_list_t *list;
+    fluid_sfont_t *sfont;
+
+    fluid_return_if_fail(reclaimer != NULL);
+
+    if(reclaimer->thread != NULL)
+    {
+        fluid_cond_mutex_lock(reclaimer->mutex);
+        reclaimer->quit = TRUE;
+        fluid_cond_signal(reclaimer->cond);
+        fluid_cond_mutex_unlock(reclaimer->mutex);
+
+        fluid_thread_join(reclaimer->thread);
+        delete_fluid_thread(reclaimer->thread);
+    }
+
+    for(list = reclaimer->sfonts; list; list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(fluid_sfont_delete_internal(sfont) == 0)
+        {
+            FLUID_LOG(FLUID_DBG, "Unloaded SoundFont");
+        }
+        else
+        {
+            new_fluid_timer(100, fluid_synth_sfunload_callback, sfont, TRUE, TRUE, FALSE);
+        }
+    }
+
+    delete_fluid_list(reclaimer->sfonts);
+
+    if(reclaimer->cond != NULL)
+    {
+        delete_fluid_cond(reclaimer->cond);
+    }
+
+    if(reclaimer->mutex != NULL)
+    {
+        delete_fluid_cond_mutex(reclaimer->mutex);
+    }
+
+    FLUID_FREE(reclaimer);
+}
+
+/**
+ * Reload a SoundFont.  The SoundFont retains its ID and index on the SoundFont stack.
+ * @param synth FluidSynth instance
+ * @param id ID of SoundFont to reload
+ * @return SoundFont ID on success, #FLUID_FAILED on error
+ */
+int
+fluid_synth_sfreload(fluid_synth_t *synth, int id)
+{
+    char *filename = NULL;
+    fluid_sfont_t *sfont;
+    fluid_sfloader_t *loader;
+    fluid_list_t *list;
+    int index, ret = FLUID_FAILED;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    /* Search for SoundFont and get its index */
+    for(list = synth->sfont, index = 0; list; list = fluid_list_next(list), index++)
+    {
+        sfont = fluid_list_get(list);
+
+        if(fluid_sfont_get_id(sfont) == id)
+        {
+            break;
+        }
+    }
+
+    if(!list)
+    {
+        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
+        goto exit;
+    }
+
+    /* keep a copy of the SoundFont's filename */
+    filename = FLUID_STRDUP(fluid_sfont_get_name(sfont));
+
+    if(filename == NULL || fluid_synth_sfunload(synth, id, FALSE) != FLUID_OK)
+    {
+        goto exit;
+    }
+
+    /* MT Note: SoundFont loader list will not change */
+
+    for(list = synth->loaders; list; list = fluid_list_next(list))
+    {
+        loader = (fluid_sfloader_t *) fluid_list_get(list);
+
+        sfont = fluid_sfloader_load(loader, filename);
+
+        if(sfont != NULL)
+        {
+            sfont->id = id;
+            fluid_atomic_int_inc(&sfont->refcount);
+
+            synth->sfont = fluid_list_insert_at(synth->sfont, index, sfont);  /* insert the sfont at the same index */
+
+            /* it may hide presets of the SoundFonts below it */
+            fluid_hashtable_remove_all(synth->preset_index);
+
+            /* reset the presets for all channels */
+            fluid_synth_update_presets(synth);
+            ret = id;
+            goto exit;
+        }
+    }
+
+    FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
+
+exit:
+    FLUID_FREE(filename);
+    FLUID_API_RETURN(ret);
+}
+
+/**
+ * Add a SoundFont.  The SoundFont will be added to the top of the SoundFont stack.
+ * @param synth FluidSynth instance
+ * @param sfont SoundFont to add
+ * @return New assigned SoundFont ID or #FLUID_FAILED on error
+ */
+int
+fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    int sfont_id;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(sfont != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    sfont_id = synth->sfont_id;
+
+    if(++sfont_id != FLUID_FAILED)
+    {
+        synth->sfont_id = sfont->id = sfont_id;
+        synth->sfont = fluid_list_prepend(synth->sfont, sfont);        /* prepend to list */
+        fluid_synth_preset_index_add_sfont(synth, sfont);
+
+        /* reset the presets for all channels */
+        fluid_synth_program_reset(synth);
+    }
+
+    FLUID_API_RETURN(sfont_id);
+}
+
+/**
+ * Remove a SoundFont from the SoundFont stack without deleting it.
+ * @param synth FluidSynth instance
+ * @param sfont SoundFont to remove
+ * @return #FLUID_OK if \c sfont successfully removed, #FLUID_FAILED otherwise
+ *
+ * SoundFont is not freed and is left as the responsibility of the caller.
+ *
+ * @note The SoundFont should only be freed after there are no presets
+ *   referencing it.  This can only be ensured by the SoundFont loader and
+ *   therefore this function should not normally be used.
+ */
+int
+fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_sfont_t *sfont_tmp;
+    fluid_list_t *list;
+    int ret = FLUID_FAILED;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(sfont != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    /* remove the SoundFont from the list */
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        sfont_tmp = fluid_list_get(list);
+
+        if(sfont_tmp == sfont)
+        {
+            synth->sfont = fluid_list_remove(synth->sfont, sfont_tmp);
+            fluid_synth_preset_index_remove_sfont(synth, sfont);
+            ret = FLUID_OK;
+            break;
+        }
+    }
+
+    /* reset the presets for all channels */
+    fluid_synth_program_reset(synth);
+
+    FLUID_API_RETURN(ret);
+}
+
+/**
+ * Count number of loaded SoundFont files.
+ * @param synth FluidSynth instance
+ * @return Count of loaded SoundFont files.
+ */
+int
+fluid_synth_sfcount(fluid_synth_t *synth)
+{
+    int count;
+
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+    count = fluid_list_size(synth->sfont);
+    FLUID_API_RETURN(count);
+}
+
+/**
+ * Get SoundFont by index.
+ * @param synth FluidSynth instance
+ * @param num SoundFont index on the stack (starting from 0 for top of stack).
+ * @return SoundFont instance or NULL if invalid index
+ *
+ * @note Caller should be certain that SoundFont is not deleted (unloaded) for
+ * the duration of use of the returned pointer.
+ */
+fluid_sfont_t *
+fluid_synth_get_sfont(fluid_synth_t *synth, unsigned int num)
+{
+    fluid_sfont_t *sfont = NULL;
+    fluid_list_t *list;
+
+    fluid_return_val_if_fail(synth != NULL, NULL);
+    fluid_synth_api_enter(synth);
+    list = fluid_list_nth(synth->sfont, num);
+
+    if(list)
+    {
+        sfont = fluid_list_get(list);
+    }
+
+    FLUID_API_RETURN(sfont);
+}
+
+/**
+ * Get SoundFont by ID.
+ * @param synth FluidSynth instance
+ * @param id SoundFont ID
+ * @return SoundFont instance or NULL if invalid ID
+ *
+ * @note Caller should be certain that SoundFont is not deleted (unloaded) for
+ * the duration of use of the returned pointer.
+ */
+fluid_sfont_t *
+fluid_synth_get_sfont_by_id(fluid_synth_t *synth, int id)
+{
+    fluid_sfont_t *sfont = NULL;
+    fluid_list_t *list;
+
+    fluid_return_val_if_fail(synth != NULL, NULL);
+    fluid_synth_api_enter(synth);
+
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(fluid_sfont_get_id(sfont) == id)
+        {
+            break;
+        }
+    }
+
+    FLUID_API_RETURN(list ? sfont : NULL);
+}
+
+/**
+ * Get SoundFont by name.
+ * @param synth FluidSynth instance
+ * @param name Name of SoundFont
+ * @return SoundFont instance or NULL if invalid name
+ * @since 1.1.0
+ *
+ * @note Caller should be certain that SoundFont is not deleted (unloaded) for
+ * the duration of use of the returned pointer.
+ */
+fluid_sfont_t *
+fluid_synth_get_sfont_by_name(fluid_synth_t *synth, const char *name)
+{
+    fluid_sfont_t *sfont = NULL;
+    fluid_list_t *list;
+
+    fluid_return_val_if_fail(synth != NULL, NULL);
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_synth_api_enter(synth);
+
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(FLUID_STRCMP(fluid_sfont_get_name(sfont), name) == 0)
+        {
+            break;
+        }
+    }
+
+    FLUID_API_RETURN(list ? sfont : NULL);
+}
+
+/**
+ * Get active preset on a MIDI channel.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @return Preset or NULL if no preset active on \c chan
+ *
+ * @note Should only be called from within synthesis thread, which includes
+ * SoundFont loader preset noteon methods. Not thread safe otherwise.
+ */
+fluid_preset_t *
+fluid_synth_get_channel_preset(fluid_synth_t *synth, int chan)
+{
+    fluid_preset_t *result;
+    fluid_channel_t *channel;
+    FLUID_API_ENTRY_CHAN(NULL);
+
+    channel = synth->channel[chan];
+    result = channel->preset;
+    fluid_synth_api_exit(synth);
+    return result;
+}
+
+/**
+ * Get list of currently playing voices.
+ * @param synth FluidSynth instance
+ * @param buf Array to store voices to (NULL terminated if not filled completely)
+ * @param bufsize Count of indexes in buf
+ * @param id Voice ID to search for or < 0 to return list of all playing voices
+ *
+ * @note Should only be called from within synthesis thread, which includes
+ * SoundFont loader preset noteon methods.  Voices are only guaranteed to remain
+ * unchanged until next synthesis process iteration.
+ */
+void
+fluid_synth_get_voicelist(fluid_synth_t *synth, fluid_voice_t *buf[], int bufsize,
+                          int id)
+{
+    int count = 0;
+    int i;
+
+    fluid_return_if_fail(synth != NULL);
+    fluid_return_if_fail(buf != NULL);
+    fluid_synth_api_enter(synth);
+
+    for(i = 0; i < synth->polyphony && count < bufsize; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        if(fluid_voice_is_playing(voice) && (id < 0 || (int)voice->id == id))
+        {
+            buf[count++] = voice;
+        }
+    }
+
+    if(count < bufsize)
+    {
+        buf[count] = NULL;
+    }
+
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Enable or disable reverb effect.
+ * @param synth FluidSynth instance
+ * @param on TRUE to enable reverb, FALSE to disable
+ */
+void
+fluid_synth_set_reverb_on(fluid_synth_t *synth, int on)
+{
+    fluid_return_if_fail(synth != NULL);
+
+    fluid_synth_api_enter(synth);
+
+    if(synth->with_reverb && !on)
+    {
+        synth->reverb_off_time = fluid_curtime();
+    }
+
+    synth->with_reverb = (on != 0);
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_reverb_enabled,
+                             on != 0, 0.0f);
+    fluid_synth_update_fx_units(synth);
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Activate a reverb preset.
+ * @param synth FluidSynth instance
+ * @param num Reverb preset number
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * @note Currently private to libfluidsynth.
+ */
+int
+fluid_synth_set_reverb_preset(fluid_synth_t *synth, unsigned int num)
+{
+    fluid_return_val_if_fail(
+        num < FLUID_N_ELEMENTS(revmodel_preset),
+        FLUID_FAILED
+    );
+
+    fluid_synth_set_reverb(synth, revmodel_preset[num].roomsize,
+                           revmodel_preset[num].damp, revmodel_preset[num].width,
+                           revmodel_preset[num].level);
+    return FLUID_OK;
+}
+
+/**
+ * Set reverb parameters.
  * @param synth FluidSynth instance
  * @param roomsize Reverb room size value (0.0-1.0)
  * @param damping Reverb damping value (0.0-1.0)
@@ -5090,568 +8157,2056 @@ fluid_synth_set_reverb_preset(fluid_synth_t *synth, unsigned int num)
  * @param level Reverb level value (0.0-1.0)
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  *
- * @note Not realtime safe and therefore should not be called from synthesis
- * context at the risk of stalling audio output.
+ * @note Not realtime safe and therefore should not be called from synthesis
+ * context at the risk of stalling audio output.
+ */
+int
+fluid_synth_set_reverb(fluid_synth_t *synth, double roomsize, double damping,
+                       double width, double level)
+{
+    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_ALL,
+                                       roomsize, damping, width, level);
+}
+
+/**
+ * Set reverb roomsize. See fluid_synth_set_reverb() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_reverb_roomsize(fluid_synth_t *synth, double roomsize)
+{
+    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_ROOMSIZE, roomsize, 0, 0, 0);
+}
+
+/**
+ * Set reverb damping. See fluid_synth_set_reverb() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_reverb_damp(fluid_synth_t *synth, double damping)
+{
+    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_DAMPING, 0, damping, 0, 0);
+}
+
+/**
+ * Set reverb width. See fluid_synth_set_reverb() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_reverb_width(fluid_synth_t *synth, double width)
+{
+    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_WIDTH, 0, 0, width, 0);
+}
+
+/**
+ * Set reverb level. See fluid_synth_set_reverb() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_reverb_level(fluid_synth_t *synth, double level)
+{
+    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_LEVEL, 0, 0, 0, level);
+}
+
+/**
+ * Set one or more reverb parameters.
+ * @param synth FluidSynth instance
+ * @param set Flags indicating which parameters should be set (#fluid_revmodel_set_t)
+ * @param roomsize Reverb room size value (0.0-1.2)
+ * @param damping Reverb damping value (0.0-1.0)
+ * @param width Reverb width value (0.0-100.0)
+ * @param level Reverb level value (0.0-1.0)
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * @note Not realtime safe and therefore should not be called from synthesis
+ * context at the risk of stalling audio output.
+ */
+int
+fluid_synth_set_reverb_full(fluid_synth_t *synth, int set, double roomsize,
+                            double damping, double width, double level)
+{
+    int ret;
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    /* if non of the flags is set, fail */
+    fluid_return_val_if_fail(set & FLUID_REVMODEL_SET_ALL, FLUID_FAILED);
+
+    /* Synth shadow values are set here so that they will be returned if querried */
+
+    fluid_synth_api_enter(synth);
+
+    if(set & FLUID_REVMODEL_SET_ROOMSIZE)
+    {
+        synth->reverb_roomsize = roomsize;
+    }
+
+    if(set & FLUID_REVMODEL_SET_DAMPING)
+    {
+        synth->reverb_damping = damping;
+    }
+
+    if(set & FLUID_REVMODEL_SET_WIDTH)
+    {
+        synth->reverb_width = width;
+    }
+
+    if(set & FLUID_REVMODEL_SET_LEVEL)
+    {
+        synth->reverb_level = level;
+    }
+
+    param[0].i = set;
+    param[1].real = roomsize;
+    param[2].real = damping;
+    param[3].real = width;
+    param[4].real = level;
+    /* finally enqueue an rvoice event to the mixer to actual update reverb */
+    ret = fluid_rvoice_eventhandler_push(synth->eventhandler,
+                                         fluid_rvoice_mixer_set_reverb_params,
+                                         synth->eventhandler->mixer,
+                                         param, 5);
+    FLUID_API_RETURN(ret);
+}
+
+/**
+ * Get reverb room size.
+ * @param synth FluidSynth instance
+ * @return Reverb room size (0.0-1.2)
+ */
+double
+fluid_synth_get_reverb_roomsize(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+    result = synth->reverb_roomsize;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get reverb damping.
+ * @param synth FluidSynth instance
+ * @return Reverb damping value (0.0-1.0)
+ */
+double
+fluid_synth_get_reverb_damp(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->reverb_damping;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get reverb level.
+ * @param synth FluidSynth instance
+ * @return Reverb level value (0.0-1.0)
+ */
+double
+fluid_synth_get_reverb_level(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->reverb_level;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get reverb width.
+ * @param synth FluidSynth instance
+ * @return Reverb width value (0.0-100.0)
+ */
+double
+fluid_synth_get_reverb_width(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->reverb_width;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Replace the reverb of an effects group by a convolution reverb.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the effects group, -1 for all of them
+ * @param left Impulse response of the left channel
+ * @param right Impulse response of the right channel, NULL to use the left one for both
+ * @param frames Number of frames of the impulse response, 0 to go back to the built-in reverb
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The reverb input of the group is convolved with the impulse response, which has
+ * to be sampled at the sample-rate of the synth, and scaled by the reverb level.
+ * The other reverb parameters don't apply to it. The rendering thread convolves the
+ * start of the impulse response in blocks of 64 frames, a worker thread the rest
+ * in the larger partitions of <a href="fluidsettings.xml#synth.reverb.ir-tail-size">synth.reverb.ir-tail-size</a>.
+ *
+ * With <a href="fluidsettings.xml#synth.effects-shared">synth.effects-shared</a>, only the
+ * first effects group has a reverb, shared by all of them.
+ *
+ * The impulse response is copied. This function allocates memory and starts
+ * threads, it must not be called from the audio thread.
+ * @since 2.2.0
+ */
+int
+fluid_synth_set_reverb_group_ir(fluid_synth_t *synth, int fx_group, const float *left,
+                                const float *right, int frames)
+{
+    fluid_rvoice_mixer_ir_t *ir;
+    fluid_convolver_t *conv;
+    int i, units, tail_size, prio_level = 0, ret = FLUID_OK;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(frames >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(frames == 0 || left != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    /* the groups sharing the reverb of the first one have none of their own */
+    units = synth->effects_shared ? 1 : synth->effects_groups;
+
+    if(fx_group < -1 || fx_group >= units)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    /* free the convolution reverbs replaced by previous calls */
+    fluid_synth_free_replaced_irs(synth, FALSE);
+
+    fluid_settings_getint(synth->settings, "synth.reverb.ir-tail-size", &tail_size);
+    fluid_settings_getint(synth->settings, "audio.realtime-prio", &prio_level);
+
+    for(i = (fx_group < 0) ? 0 : fx_group; i < units; i++)
+    {
+        conv = NULL;
+
+        if(frames > 0)
+        {
+            conv = new_fluid_convolver(left, right, frames, tail_size, prio_level);
+
+            if(conv == NULL)
+            {
+                ret = FLUID_FAILED;
+                break;
+            }
+
+            fluid_convolver_set_level(conv, synth->reverb_level);
+        }
+
+        ir = new_fluid_rvoice_mixer_ir(i, conv);
+
+        if(ir == NULL)
+        {
+            delete_fluid_convolver(conv);
+            ret = FLUID_FAILED;
+            break;
+        }
+
+        synth->replaced_irs = fluid_list_prepend(synth->replaced_irs, ir);
+        fluid_rvoice_eventhandler_push_ptr(synth->eventhandler, fluid_rvoice_mixer_set_ir,
+                                           synth->eventhandler->mixer, ir);
+
+        if(fx_group >= 0)
+        {
+            break;
+        }
+    }
+
+    FLUID_API_RETURN(ret);
+}
+
+/**
+ * Load the impulse response of a convolution reverb for an effects group from an audio file.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the effects group, -1 for all of them
+ * @param filename Name of a mono or stereo audio file, only the first two channels
+ *   of files with more of them are used
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Impulse responses sampled at another rate than the synth are resampled by
+ * linear interpolation. See fluid_synth_set_reverb_group_ir(). Requires libsndfile.
+ * @since 2.2.0
+ */
+int
+fluid_synth_load_reverb_group_ir(fluid_synth_t *synth, int fx_group, const char *filename)
+{
+#if LIBSNDFILE_SUPPORT
+    SNDFILE *sndfile;
+    SF_INFO info;
+    sf_count_t count;
+    float *data, *left, *right;
+    double sample_rate, pos;
+    int i, k, frames, ir_frames, ret;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
+
+    FLUID_MEMSET(&info, 0, sizeof(info));
+    sndfile = sf_open(filename, SFM_READ, &info);
+
+    if(sndfile == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to open impulse response '%s': %s", filename, sf_strerror(NULL));
+        return FLUID_FAILED;
+    }
+
+    if(info.channels < 1 || info.samplerate < 1 || info.frames < 1 || info.frames > INT_MAX / info.channels)
+    {
+        FLUID_LOG(FLUID_ERR, "Impulse response '%s' is empty or too long", filename);
+        sf_close(sndfile);
+        return FLUID_FAILED;
+    }
+
+    data = FLUID_ARRAY(float, info.frames * info.channels);
+
+    if(data == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        sf_close(sndfile);
+        return FLUID_FAILED;
+    }
+
+    count = sf_readf_float(sndfile, data, info.frames);
+    sf_close(sndfile);
+    frames = (int)count;
+
+    fluid_synth_api_enter(synth);
+    sample_rate = synth->sample_rate;
+    fluid_synth_api_exit(synth);
+
+    ir_frames = (int)(frames * sample_rate / info.samplerate);
+    left = FLUID_ARRAY(float, ir_frames > 0 ? 2 * ir_frames : 1);
+
+    if(left == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(data);
+        return FLUID_FAILED;
+    }
+
+    right = left + ir_frames;
+
+    for(i = 0; i < ir_frames; i++)
+    {
+        pos = i * info.samplerate / sample_rate;
+        k = (int)pos;
+        pos -= k;
+
+        left[i] = data[k * info.channels];
+        right[i] = data[k * info.channels + (info.channels > 1)];
+
+        if(k + 1 < frames)
+        {
+            left[i] += (float)(pos * (data[(k + 1) * info.channels] - left[i]));
+            right[i] += (float)(pos * (data[(k + 1) * info.channels + (info.channels > 1)] - right[i]));
+        }
+    }
+
+    FLUID_FREE(data);
+
+    if(ir_frames > 0)
+    {
+        ret = fluid_synth_set_reverb_group_ir(synth, fx_group, left, right, ir_frames);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_ERR, "Impulse response '%s' is empty", filename);
+        ret = FLUID_FAILED;
+    }
+
+    FLUID_FREE(left);
+
+    return ret;
+#else
+    FLUID_LOG(FLUID_ERR, "Loading impulse responses requires libsndfile");
+    return FLUID_FAILED;
+#endif
+}
+
+static void
+fluid_synth_set_fx_send_LOCAL(fluid_synth_t *synth, int fx_group, int channel, double send)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    synth->fx_sends[2 * fx_group + channel] = send;
+
+    param[0].i = fx_group;
+    param[1].i = (channel == SYNTH_CHORUS_CHANNEL);
+    param[2].real = send;
+    fluid_rvoice_eventhandler_push(synth->eventhandler, fluid_rvoice_mixer_set_fx_send,
+                                   synth->eventhandler->mixer, param, 3);
+}
+
+static int
+fluid_synth_set_fx_send(fluid_synth_t *synth, int fx_group, int channel, double send)
+{
+    int i;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(send >= 0.0, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    if(fx_group < -1 || fx_group >= synth->effects_groups)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    for(i = (fx_group < 0) ? 0 : fx_group; i < synth->effects_groups; i++)
+    {
+        fluid_synth_set_fx_send_LOCAL(synth, i, channel, send);
+
+        if(fx_group >= 0)
+        {
+            break;
+        }
+    }
+
+    FLUID_API_RETURN(FLUID_OK);
+}
+
+static int
+fluid_synth_get_fx_send(fluid_synth_t *synth, int fx_group, int channel, double *send)
+{
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(send != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    if(fx_group < 0 || fx_group >= synth->effects_groups)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    *send = synth->fx_sends[2 * fx_group + channel];
+    FLUID_API_RETURN(FLUID_OK);
+}
+
+/**
+ * Set the gain of the reverb input of an effects group.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the effects group, -1 for all of them
+ * @param send Gain of the reverb input, 1.0 by default
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The reverb sends of the voices of the group are scaled by the gain before they
+ * reach the reverb of the group, or the one shared by all groups with
+ * <a href="fluidsettings.xml#synth.effects-shared">synth.effects-shared</a>.
+ * @since 2.2.0
+ */
+int
+fluid_synth_set_reverb_group_send(fluid_synth_t *synth, int fx_group, double send)
+{
+    return fluid_synth_set_fx_send(synth, fx_group, SYNTH_REVERB_CHANNEL, send);
+}
+
+/**
+ * Get the gain of the reverb input of an effects group.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the effects group
+ * @param send Location to store the gain
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.2.0
+ */
+int
+fluid_synth_get_reverb_group_send(fluid_synth_t *synth, int fx_group, double *send)
+{
+    return fluid_synth_get_fx_send(synth, fx_group, SYNTH_REVERB_CHANNEL, send);
+}
+
+/**
+ * Set the gain of the chorus input of an effects group.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the effects group, -1 for all of them
+ * @param send Gain of the chorus input, 1.0 by default
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The chorus sends of the voices of the group are scaled by the gain before they
+ * reach the chorus of the group, or the one shared by all groups with
+ * <a href="fluidsettings.xml#synth.effects-shared">synth.effects-shared</a>.
+ * @since 2.2.0
+ */
+int
+fluid_synth_set_chorus_group_send(fluid_synth_t *synth, int fx_group, double send)
+{
+    return fluid_synth_set_fx_send(synth, fx_group, SYNTH_CHORUS_CHANNEL, send);
+}
+
+/**
+ * Get the gain of the chorus input of an effects group.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the effects group
+ * @param send Location to store the gain
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.2.0
+ */
+int
+fluid_synth_get_chorus_group_send(fluid_synth_t *synth, int fx_group, double *send)
+{
+    return fluid_synth_get_fx_send(synth, fx_group, SYNTH_CHORUS_CHANNEL, send);
+}
+
+/**
+ * Enable or disable chorus effect.
+ * @param synth FluidSynth instance
+ * @param on TRUE to enable chorus, FALSE to disable
+ */
+void
+fluid_synth_set_chorus_on(fluid_synth_t *synth, int on)
+{
+    fluid_return_if_fail(synth != NULL);
+    fluid_synth_api_enter(synth);
+
+    if(synth->with_chorus && !on)
+    {
+        synth->chorus_off_time = fluid_curtime();
+    }
+
+    synth->with_chorus = (on != 0);
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_chorus_enabled,
+                             on != 0, 0.0f);
+    fluid_synth_update_fx_units(synth);
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Set chorus parameters. It should be turned on with fluid_synth_set_chorus_on().
+ * Keep in mind, that the needed CPU time is proportional to 'nr'.
+ * @param synth FluidSynth instance
+ * @param nr Chorus voice count (0-99, CPU time consumption proportional to
+ *   this value)
+ * @param level Chorus level (0.0-10.0)
+ * @param speed Chorus speed in Hz (0.1-5.0)
+ * @param depth_ms Chorus depth (max value depends on synth sample-rate,
+ *   0.0-21.0 is safe for sample-rate values up to 96KHz)
+ * @param type Chorus waveform type (#fluid_chorus_mod)
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_chorus(fluid_synth_t *synth, int nr, double level,
+                           double speed, double depth_ms, int type)
+{
+    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_ALL, nr, level, speed,
+                                       depth_ms, type);
+}
+
+/**
+ * Set the chorus voice count. See fluid_synth_set_chorus() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_chorus_nr(fluid_synth_t *synth, int nr)
+{
+    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_NR, nr, 0, 0, 0, 0);
+}
+
+/**
+ * Set the chorus level. See fluid_synth_set_chorus() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_chorus_level(fluid_synth_t *synth, double level)
+{
+    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_LEVEL, 0, level, 0, 0, 0);
+}
+
+/**
+ * Set the chorus speed. See fluid_synth_set_chorus() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_chorus_speed(fluid_synth_t *synth, double speed)
+{
+    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_SPEED, 0, 0, speed, 0, 0);
+}
+
+/**
+ * Set the chorus depth. See fluid_synth_set_chorus() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_chorus_depth(fluid_synth_t *synth, double depth_ms)
+{
+    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_DEPTH, 0, 0, 0, depth_ms, 0);
+}
+
+/**
+ * Set the chorus type. See fluid_synth_set_chorus() for further info.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_synth_set_chorus_type(fluid_synth_t *synth, int type)
+{
+    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_TYPE, 0, 0, 0, 0, type);
+}
+
+int
+fluid_synth_set_chorus_full(fluid_synth_t *synth, int set, int nr, double level,
+                            double speed, double depth_ms, int type)
+{
+    int ret;
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    /* if non of the flags is set, fail */
+    fluid_return_val_if_fail(set & FLUID_CHORUS_SET_ALL, FLUID_FAILED);
+
+    /* Synth shadow values are set here so that they will be returned if queried */
+    fluid_synth_api_enter(synth);
+
+    if(set & FLUID_CHORUS_SET_NR)
+    {
+        synth->chorus_nr = nr;
+    }
+
+    if(set & FLUID_CHORUS_SET_LEVEL)
+    {
+        synth->chorus_level = level;
+    }
+
+    if(set & FLUID_CHORUS_SET_SPEED)
+    {
+        synth->chorus_speed = speed;
+    }
+
+    if(set & FLUID_CHORUS_SET_DEPTH)
+    {
+        synth->chorus_depth = depth_ms;
+    }
+
+    if(set & FLUID_CHORUS_SET_TYPE)
+    {
+        synth->chorus_type = type;
+    }
+
+    param[0].i = set;
+    param[1].i = nr;
+    param[2].real = level;
+    param[3].real = speed;
+    param[4].real = depth_ms;
+    param[5].i = type;
+    ret = fluid_rvoice_eventhandler_push(synth->eventhandler,
+                                         fluid_rvoice_mixer_set_chorus_params,
+                                         synth->eventhandler->mixer,
+                                         param, 6);
+
+    FLUID_API_RETURN(ret);
+}
+
+/**
+ * Get chorus voice number (delay line count) value.
+ * @param synth FluidSynth instance
+ * @return Chorus voice count
+ */
+int
+fluid_synth_get_chorus_nr(fluid_synth_t *synth)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->chorus_nr;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get chorus level.
+ * @param synth FluidSynth instance
+ * @return Chorus level value
+ */
+double
+fluid_synth_get_chorus_level(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->chorus_level;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get chorus speed in Hz.
+ * @param synth FluidSynth instance
+ * @return Chorus speed in Hz
+ */
+double
+fluid_synth_get_chorus_speed(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->chorus_speed;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get chorus depth.
+ * @param synth FluidSynth instance
+ * @return Chorus depth
+ */
+double
+fluid_synth_get_chorus_depth(fluid_synth_t *synth)
+{
+    double result;
+    fluid_return_val_if_fail(synth != NULL, 0.0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->chorus_depth;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get chorus waveform type.
+ * @param synth FluidSynth instance
+ * @return Chorus waveform type (#fluid_chorus_mod)
+ */
+int
+fluid_synth_get_chorus_type(fluid_synth_t *synth)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->chorus_type;
+    FLUID_API_RETURN(result);
+}
+
+/*
+ * If the same note is hit twice on the same channel, then the older
+ * voice process is advanced to the release stage.  Using a mechanical
+ * MIDI controller, the only way this can happen is when the sustain
+ * pedal is held.  In this case the behaviour implemented here is
+ * natural for many instruments.  Note: One noteon event can trigger
+ * several voice processes, for example a stereo sample.  Don't
+ * release those...
+ */
+void
+fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan,
+        int key)
+{
+    fluid_voice_t *voice, *next;
+
+    /* storeid is a parameter for fluid_voice_init() */
+    synth->storeid = synth->noteid++;
+
+    /* for "monophonic playing" key is the previous sustained note
+      if it exists (0 to 127) or INVALID_NOTE otherwise */
+    if(key == INVALID_NOTE)
+    {
+        return;
+    }
+
+    for(voice = synth->channel[chan]->key_voices[key]; voice != NULL; voice = next)
+    {
+        next = voice->key_next;
+
+        if(fluid_voice_is_playing(voice)
+                && (fluid_voice_get_id(voice) != synth->noteid))
+        {
+            /* Id of voices that was sustained by sostenuto */
+            if(fluid_voice_is_sostenuto(voice))
+            {
+                synth->storeid = fluid_voice_get_id(voice);
+            }
+
+            /* Force the voice into release stage (pedaling is ignored) */
+            fluid_voice_release(voice);
+        }
+    }
+}
+
+/**
+ * Set synthesis interpolation method on one or all MIDI channels.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel to set interpolation method on or -1 for all channels
+ * @param interp_method Interpolation method (#fluid_interp)
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int
+fluid_synth_set_interp_method(fluid_synth_t *synth, int chan, int interp_method)
+{
+    int i;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    if(chan < -1 || chan >= synth->midi_channels)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    if(synth->channel[0] == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Channels don't exist (yet)!");
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    for(i = 0; i < synth->midi_channels; i++)
+    {
+        if(chan < 0 || fluid_channel_get_num(synth->channel[i]) == chan)
+        {
+            fluid_channel_set_interp_method(synth->channel[i], interp_method);
+        }
+    }
+
+    FLUID_API_RETURN(FLUID_OK);
+};
+
+/**
+ * Get the total count of MIDI channels.
+ * @param synth FluidSynth instance
+ * @return Count of MIDI channels
+ */
+int
+fluid_synth_count_midi_channels(fluid_synth_t *synth)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->midi_channels;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get the total count of audio channels.
+ * @param synth FluidSynth instance
+ * @return Count of audio channel stereo pairs (1 = 2 channels, 2 = 4, etc)
+ */
+int
+fluid_synth_count_audio_channels(fluid_synth_t *synth)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->audio_channels;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Get the total number of allocated audio channels.  Usually identical to the
+ * number of audio channels.  Can be employed by LADSPA effects subsystem.
+ *
+ * @param synth FluidSynth instance
+ * @return Count of audio group stereo pairs (1 = 2 channels, 2 = 4, etc)
  */
 int
-fluid_synth_set_reverb(fluid_synth_t *synth, double roomsize, double damping,
-                       double width, double level)
+fluid_synth_count_audio_groups(fluid_synth_t *synth)
 {
-    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_ALL,
-                                       roomsize, damping, width, level);
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->audio_groups;
+    FLUID_API_RETURN(result);
 }
 
 /**
- * Set reverb roomsize. See fluid_synth_set_reverb() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * Get the total number of allocated effects channels.
+ * @param synth FluidSynth instance
+ * @return Count of allocated effects channels
  */
-int fluid_synth_set_reverb_roomsize(fluid_synth_t *synth, double roomsize)
+int
+fluid_synth_count_effects_channels(fluid_synth_t *synth)
 {
-    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_ROOMSIZE, roomsize, 0, 0, 0);
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->effects_channels;
+    FLUID_API_RETURN(result);
 }
 
 /**
- * Set reverb damping. See fluid_synth_set_reverb() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * Get the total number of allocated effects units.
+ * @param synth FluidSynth instance
+ * @return Count of allocated effects units
  */
-int fluid_synth_set_reverb_damp(fluid_synth_t *synth, double damping)
+int
+fluid_synth_count_effects_groups(fluid_synth_t *synth)
 {
-    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_DAMPING, 0, damping, 0, 0);
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->effects_groups;
+    FLUID_API_RETURN(result);
 }
 
 /**
- * Set reverb width. See fluid_synth_set_reverb() for further info.
+ * Get the synth CPU load value.
+ * @param synth FluidSynth instance
+ * @return Estimated CPU load value in percent (0-100)
+ */
+double
+fluid_synth_get_cpu_load(fluid_synth_t *synth)
+{
+    fluid_return_val_if_fail(synth != NULL, 0);
+    return fluid_atomic_float_get(&synth->cpu_load);
+}
+
+/**
+ * Get statistics about the queue passing voice events to the audio rendering.
+ * @param synth FluidSynth instance
+ * @param capacity Returns the number of events the queue has allocated memory for (may be NULL)
+ * @param queued Returns the number of events currently waiting to be rendered (may be NULL)
+ * @param max_queued Returns the largest number of events that have been waiting at once (may be NULL)
+ *
+ * Events are queued until the next call to one of the synthesis functions,
+ * e.g. fluid_synth_write_float(). The queue initially holds 64 events per voice
+ * of <a href="fluidsettings.xml#synth.polyphony">synth.polyphony</a> and grows
+ * on demand, if \p max_queued exceeds that, consider increasing the polyphony
+ * to avoid allocating memory while playing.
+ * @since 2.2.0
+ */
+void
+fluid_synth_get_event_queue_stats(fluid_synth_t *synth, int *capacity, int *queued, int *max_queued)
+{
+    fluid_return_if_fail(synth != NULL);
+    fluid_synth_api_enter(synth);
+
+    fluid_rvoice_eventhandler_get_stats(synth->eventhandler, capacity, queued, max_queued);
+
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Get a statistic about the audio rendering of the synth.
+ * @param synth FluidSynth instance
+ * @param stat The statistic to get (#fluid_synth_stat)
+ * @return Value of the statistic, or -1 if \p stat is invalid
+ *
+ * Unlike fluid_synth_get_cpu_load(), the DSP load is not smoothed over the
+ * rendering calls. The statistics are updated by the rendering thread without
+ * locking, this function may be called from any thread at any time and
+ * doesn't block the synth. Peaks and counts accumulate until
+ * fluid_synth_reset_stats() is called.
+ * @since 2.2.0
+ */
+double
+fluid_synth_get_stat(fluid_synth_t *synth, int stat)
+{
+    fluid_return_val_if_fail(synth != NULL, -1);
+
+    switch(stat)
+    {
+    case FLUID_SYNTH_STAT_DSP_LOAD:
+        return fluid_atomic_float_get(&synth->dsp_load);
+
+    case FLUID_SYNTH_STAT_PEAK_DSP_LOAD:
+        return fluid_atomic_float_get(&synth->peak_dsp_load);
+
+    case FLUID_SYNTH_STAT_RENDER_CALLS:
+        return (unsigned int)fluid_atomic_int_get(&synth->render_calls);
+
+    case FLUID_SYNTH_STAT_XRUNS:
+        return (unsigned int)fluid_atomic_int_get(&synth->render_histogram[FLUID_SYNTH_RENDER_HISTOGRAM_SIZE - 1]);
+
+    case FLUID_SYNTH_STAT_PEAK_VOICES:
+        return fluid_atomic_int_get(&synth->peak_voices);
+
+    case FLUID_SYNTH_STAT_STOLEN_VOICES:
+        return (unsigned int)fluid_atomic_int_get(&synth->stolen_voices);
+
+    case FLUID_SYNTH_STAT_EVENT_QUEUE_DEPTH:
+        return fluid_rvoice_eventhandler_dispatch_count(synth->eventhandler);
+
+    case FLUID_SYNTH_STAT_PEAK_EVENT_QUEUE_DEPTH:
+        return fluid_atomic_int_get(&synth->eventhandler->max_queued);
+
+    case FLUID_SYNTH_STAT_MIXER_WAIT:
+        return fluid_atomic_float_get(&synth->mixer_wait);
+
+    case FLUID_SYNTH_STAT_VOICE_LIMIT:
+    {
+        int limit = fluid_atomic_int_get(&synth->voice_limit);
+        return (limit == 0 || limit > synth->polyphony) ? synth->polyphony : limit;
+    }
+
+    case FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS:
+    case FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES:
+    case FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE:
+    {
+        unsigned int hits, misses;
+        size_t unused_size;
+
+        fluid_samplecache_get_stats(&hits, &misses, &unused_size);
+
+        return (stat == FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS) ? hits
+               : (stat == FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES) ? misses : (double)unused_size;
+    }
+
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Get the histogram of the DSP load of the rendering calls.
+ * @param synth FluidSynth instance
+ * @param counts Array to store the number of rendering calls of each bucket to
+ * @param size Number of elements of \p counts, up to #FLUID_SYNTH_RENDER_HISTOGRAM_SIZE are used
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Bucket \c i counts the rendering calls with a DSP load of at least \c i*10
+ * percent and less than \c (i+1)*10 percent (see #FLUID_SYNTH_STAT_DSP_LOAD).
+ * The last bucket counts the calls with a load of 100 percent or more, i.e.
+ * the ones that took longer than the audio they rendered. May be called from
+ * any thread like fluid_synth_get_stat().
+ * @since 2.2.0
  */
-int fluid_synth_set_reverb_width(fluid_synth_t *synth, double width)
+int
+fluid_synth_get_render_histogram(fluid_synth_t *synth, unsigned int *counts, int size)
 {
-    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_WIDTH, 0, 0, width, 0);
+    int i;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(counts != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size >= 0, FLUID_FAILED);
+
+    for(i = 0; i < size && i < FLUID_SYNTH_RENDER_HISTOGRAM_SIZE; i++)
+    {
+        counts[i] = (unsigned int)fluid_atomic_int_get(&synth->render_histogram[i]);
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Reset the peaks and counts of the rendering statistics.
+ * @param synth FluidSynth instance
+ *
+ * See fluid_synth_get_stat() and fluid_synth_get_render_histogram().
+ * @since 2.2.0
+ */
+void
+fluid_synth_reset_stats(fluid_synth_t *synth)
+{
+    int i;
+
+    fluid_return_if_fail(synth != NULL);
+
+    fluid_atomic_float_set(&synth->peak_dsp_load, 0);
+    fluid_atomic_int_set(&synth->render_calls, 0);
+    fluid_atomic_int_set(&synth->peak_voices, 0);
+    fluid_atomic_int_set(&synth->stolen_voices, 0);
+    fluid_atomic_int_set(&synth->eventhandler->max_queued, 0);
+
+    for(i = 0; i < FLUID_SYNTH_RENDER_HISTOGRAM_SIZE; i++)
+    {
+        fluid_atomic_int_set(&synth->render_histogram[i], 0);
+    }
 }
 
-/**
- * Set reverb level. See fluid_synth_set_reverb() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int fluid_synth_set_reverb_level(fluid_synth_t *synth, double level)
-{
-    return fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_LEVEL, 0, 0, 0, level);
+/**
+ * Get the memory used by the synth, by kind.
+ * @param synth FluidSynth instance
+ * @param sfont_id ID of the SoundFont to count the sample data and structures of,
+ *   -1 for all SoundFonts loaded
+ * @param bytes Array to store the bytes of each #fluid_synth_memory to
+ * @param size Number of elements of \p bytes, up to #FLUID_SYNTH_MEMORY_LAST are used
+ * @return #FLUID_OK on success, #FLUID_FAILED if there is no SoundFont \p sfont_id
+ *
+ * The sample data a SoundFont shares with other SoundFonts, e.g. of other synths,
+ * are counted for each of them. Only the SoundFonts of the default loader are
+ * accounted for, the ones of other loaders take up 0 bytes. The bytes are the
+ * sizes of the allocations, not counting the overhead of the allocator, and the
+ * parsed files only as long as they are kept loaded for
+ * <a href="fluidsettings.xml#synth.lazy-preset-loading">synth.lazy-preset-loading</a> or
+ * dynamic sample loading.
+ * @since 2.2.0
+ */
+int
+fluid_synth_get_memory_stats(fluid_synth_t *synth, int sfont_id, size_t *bytes, int size)
+{
+    size_t memory[FLUID_SYNTH_MEMORY_LAST] = { 0 };
+    fluid_list_t *list;
+    int found = (sfont_id == -1);
+    int i;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(bytes != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size >= 0, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        fluid_sfont_t *sfont = fluid_list_get(list);
+
+        if(sfont_id != -1 && fluid_sfont_get_id(sfont) != sfont_id)
+        {
+            continue;
+        }
+
+        found = TRUE;
+
+        if(sfont->get_memory != NULL)
+        {
+            sfont->get_memory(sfont, memory);
+        }
+    }
+
+    if(!found)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    /* each voice has an rvoice, and another one for overflowing */
+    memory[FLUID_SYNTH_MEMORY_VOICES] += synth->nvoice * (sizeof(fluid_voice_t) + 2 * sizeof(fluid_rvoice_t)
+                                         + 2 * sizeof(fluid_voice_t *));
+    fluid_rvoice_mixer_get_memory(synth->eventhandler->mixer, memory);
+
+    if(synth->sample_streamer != NULL)
+    {
+        memory[FLUID_SYNTH_MEMORY_VOICES] += fluid_sample_streamer_get_memory(synth->sample_streamer);
+    }
+
+    for(i = 0; i < size && i < FLUID_SYNTH_MEMORY_LAST; i++)
+    {
+        bytes[i] = memory[i];
+    }
+
+    FLUID_API_RETURN(FLUID_OK);
 }
 
 /**
- * Set one or more reverb parameters.
+ * Get the time spent in each stage of loading SoundFonts, and the bytes processed by it.
+ *
+ * The SoundFonts are only timed with <a href="fluidsettings.xml#synth.sfont-load-stats">synth.sfont-load-stats</a>
+ * enabled when they are loaded, which also logs the breakdown at #FLUID_INFO level once a SoundFont
+ * is loaded, and whenever the samples of a preset are loaded by
+ * <a href="fluidsettings.xml#synth.dynamic-sample-loading">synth.dynamic-sample-loading</a>.
+ * The statistics of a SoundFont add up over its lifetime, these later loads included.
+ * The stages done by several threads at once, see <a href="fluidsettings.xml#synth.load-threads">synth.load-threads</a>,
+ * add up the time spent by each thread.
+ *
  * @param synth FluidSynth instance
- * @param set Flags indicating which parameters should be set (#fluid_revmodel_set_t)
- * @param roomsize Reverb room size value (0.0-1.2)
- * @param damping Reverb damping value (0.0-1.0)
- * @param width Reverb width value (0.0-100.0)
- * @param level Reverb level value (0.0-1.0)
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @param sfont_id ID of a SoundFont, or -1 for all of the SoundFonts of the synth
+ * @param msec Array receiving the milliseconds of each stage, indexed by #fluid_sfont_load_stage, may be NULL
+ * @param bytes Array receiving the bytes of each stage, indexed by #fluid_sfont_load_stage, may be NULL
+ * @param size Number of elements of \c msec and \c bytes, at most #FLUID_SFONT_LOAD_LAST of them are set
+ * @return #FLUID_OK on success, #FLUID_FAILED if there is no SoundFont with ID \c sfont_id
  *
- * @note Not realtime safe and therefore should not be called from synthesis
- * context at the risk of stalling audio output.
+ * SoundFonts of other loaders than the default one, and the ones loaded without
+ * synth.sfont-load-stats, count 0 milliseconds and 0 bytes.
+ *
+ * @since 2.2.0
  */
 int
-fluid_synth_set_reverb_full(fluid_synth_t *synth, int set, double roomsize,
-                            double damping, double width, double level)
+fluid_synth_get_sfont_load_stats(fluid_synth_t *synth, int sfont_id, double *msec, size_t *bytes, int size)
 {
-    int ret;
-    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    double stage_msec[FLUID_SFONT_LOAD_LAST] = { 0 };
+    size_t stage_bytes[FLUID_SFONT_LOAD_LAST] = { 0 };
+    fluid_list_t *list;
+    int found = (sfont_id == -1);
+    int i;
 
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    /* if non of the flags is set, fail */
-    fluid_return_val_if_fail(set & FLUID_REVMODEL_SET_ALL, FLUID_FAILED);
-
-    /* Synth shadow values are set here so that they will be returned if querried */
-
+    fluid_return_val_if_fail(size >= 0, FLUID_FAILED);
     fluid_synth_api_enter(synth);
 
-    if(set & FLUID_REVMODEL_SET_ROOMSIZE)
+    for(list = synth->sfont; list; list = fluid_list_next(list))
     {
-        synth->reverb_roomsize = roomsize;
+        fluid_sfont_t *sfont = fluid_list_get(list);
+
+        if(sfont_id != -1 && fluid_sfont_get_id(sfont) != sfont_id)
+        {
+            continue;
+        }
+
+        found = TRUE;
+
+        if(sfont->get_load_stats != NULL)
+        {
+            sfont->get_load_stats(sfont, stage_msec, stage_bytes);
+        }
     }
 
-    if(set & FLUID_REVMODEL_SET_DAMPING)
+    if(!found)
     {
-        synth->reverb_damping = damping;
+        FLUID_API_RETURN(FLUID_FAILED);
     }
 
-    if(set & FLUID_REVMODEL_SET_WIDTH)
+    for(i = 0; i < size && i < FLUID_SFONT_LOAD_LAST; i++)
     {
-        synth->reverb_width = width;
+        if(msec != NULL)
+        {
+            msec[i] = stage_msec[i];
+        }
+
+        if(bytes != NULL)
+        {
+            bytes[i] = stage_bytes[i];
+        }
     }
 
-    if(set & FLUID_REVMODEL_SET_LEVEL)
+    FLUID_API_RETURN(FLUID_OK);
+}
+
+/* Tells the states saved by fluid_synth_save_state() from other data */
+static const char fluid_synth_state_magic[4] = { 'F', 'S', 'S', 'T' };
+#define FLUID_SYNTH_STATE_VERSION 1
+
+/*
+ * The header of a state saved by fluid_synth_save_state(), followed by the
+ * channels, the send gains of the effects groups, the tunings, the voices and
+ * the effects units. The sizes of the records tell the builds apart, whose
+ * states can't be restored by each other.
+ */
+typedef struct
+{
+    char magic[4];
+    int version;
+    unsigned short real_size;
+    unsigned short channel_size;
+    unsigned short voice_size;
+    unsigned short tuning_size;
+    int midi_channels;
+    int effects_groups;
+    double sample_rate;
+    int tuning_count;
+    int voice_count;
+    unsigned int fx_size;
+
+    unsigned int ticks;
+    unsigned int noteid;
+    unsigned int storeid;
+    int fromkey_portamento;
+    float gain;
+
+    int with_reverb;
+    double reverb_roomsize;
+    double reverb_damping;
+    double reverb_width;
+    double reverb_level;
+
+    int with_chorus;
+    int chorus_nr;
+    double chorus_level;
+    double chorus_speed;
+    double chorus_depth;
+    int chorus_type;
+} fluid_synth_state_t;
+
+/* A channel, with its preset and tuning looked up again by the synth restoring it */
+typedef struct
+{
+    fluid_channel_state_t chan;
+    int bank_prog_sfont;   /* position in the SoundFont stack of the SoundFont selected, -1 if none */
+    int preset_sfont;      /* position of the SoundFont of the preset, -1 without preset */
+    int preset_bank;
+    int preset_num;
+    int tuning_bank;       /* the tuning of the channel, -1 without tuning */
+    int tuning_prog;
+} fluid_synth_channel_state_t;
+
+typedef struct
+{
+    int bank;
+    int prog;
+    char name[FLUID_TUNING_NAME_SIZE];
+    double pitch[128];
+} fluid_synth_tuning_state_t;
+
+/* A playing voice, with the sample identified by its position in its SoundFont */
+typedef struct
+{
+    fluid_voice_state_t voice;
+    fluid_rvoice_state_t rvoice;
+    int sfont;             /* position in the SoundFont stack of the SoundFont of the sample */
+    int sample;            /* see fluid_defsfont_sfont_get_sample_index() */
+    int stereo_leader;     /* index of the voice rendering this one in the state, -1 if none */
+} fluid_synth_voice_state_t;
+
+/* Add count records of size bytes to the size of a state, FALSE if count is negative or the size overflows */
+static int
+fluid_synth_state_add_size(size_t *total, int count, size_t size)
+{
+    if(count < 0 || (size_t)count > (SIZE_MAX - *total) / size)
     {
-        synth->reverb_level = level;
+        return FALSE;
     }
 
-    param[0].i = set;
-    param[1].real = roomsize;
-    param[2].real = damping;
-    param[3].real = width;
-    param[4].real = level;
-    /* finally enqueue an rvoice event to the mixer to actual update reverb */
-    ret = fluid_rvoice_eventhandler_push(synth->eventhandler,
-                                         fluid_rvoice_mixer_set_reverb_params,
-                                         synth->eventhandler->mixer,
-                                         param);
-    FLUID_API_RETURN(ret);
+    *total += (size_t)count * size;
+    return TRUE;
 }
 
-/**
- * Get reverb room size.
- * @param synth FluidSynth instance
- * @return Reverb room size (0.0-1.2)
+/*
+ * Check the records of a state whose fields index the channels, the tunings and the
+ * voices of the synth, before anything of the synth is replaced. The rvoices are
+ * checked once their voices are started again, against the samples they play.
  */
-double
-fluid_synth_get_reverb_roomsize(fluid_synth_t *synth)
+static int
+fluid_synth_check_state_LOCAL(fluid_synth_t *synth, const fluid_synth_state_t *header, const char *data)
 {
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
-    result = synth->reverb_roomsize;
-    FLUID_API_RETURN(result);
+    const char *pos = data + sizeof(*header);
+    int i;
+
+    for(i = 0; i < header->midi_channels; i++)
+    {
+        fluid_synth_channel_state_t state;
+
+        FLUID_MEMCPY(&state, pos, sizeof(state));
+        pos += sizeof(state);
+
+        if(fluid_channel_check_state(synth->channel[i], &state.chan) != FLUID_OK
+                || state.tuning_bank < -1 || state.tuning_bank > 127
+                || (state.tuning_bank >= 0 && (state.tuning_prog < 0 || state.tuning_prog > 127)))
+        {
+            FLUID_LOG(FLUID_ERR, "The synth state of channel %d is corrupted", i);
+            return FLUID_FAILED;
+        }
+    }
+
+    pos += 2 * header->effects_groups * sizeof(double);
+
+    for(i = 0; i < header->tuning_count; i++)
+    {
+        fluid_synth_tuning_state_t state;
+
+        FLUID_MEMCPY(&state, pos, sizeof(state));
+        pos += sizeof(state);
+
+        if(state.bank < 0 || state.bank > 127 || state.prog < 0 || state.prog > 127)
+        {
+            FLUID_LOG(FLUID_ERR, "The synth state of a tuning is corrupted");
+            return FLUID_FAILED;
+        }
+    }
+
+    for(i = 0; i < header->voice_count; i++)
+    {
+        fluid_synth_voice_state_t state;
+
+        FLUID_MEMCPY(&state, pos, sizeof(state));
+        pos += sizeof(state);
+
+        if(fluid_voice_check_state(&state.voice) != FLUID_OK || state.voice.chan >= synth->midi_channels
+                || state.sfont < 0 || state.sample < 0
+                || state.stereo_leader < -1 || state.stereo_leader >= header->voice_count || state.stereo_leader == i)
+        {
+            FLUID_LOG(FLUID_ERR, "The synth state of a voice is corrupted");
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
 }
 
-/**
- * Get reverb damping.
- * @param synth FluidSynth instance
- * @return Reverb damping value (0.0-1.0)
- */
-double
-fluid_synth_get_reverb_damp(fluid_synth_t *synth)
+/* Position of a SoundFont in the stack of the synth, -1 if not loaded */
+static int
+fluid_synth_get_sfont_position(fluid_synth_t *synth, fluid_sfont_t *sfont)
 {
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
+    fluid_list_t *list;
+    int pos = 0;
 
-    result = synth->reverb_damping;
-    FLUID_API_RETURN(result);
+    for(list = synth->sfont; list; list = fluid_list_next(list), pos++)
+    {
+        if(fluid_list_get(list) == sfont)
+        {
+            return pos;
+        }
+    }
+
+    return -1;
 }
 
-/**
- * Get reverb level.
- * @param synth FluidSynth instance
- * @return Reverb level value (0.0-1.0)
- */
-double
-fluid_synth_get_reverb_level(fluid_synth_t *synth)
+/* Position of the SoundFont holding the sample of a voice, -1 if not loaded by the default loader */
+static int
+fluid_synth_find_sample_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int *index)
 {
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
+    fluid_list_t *list;
+    int pos = 0;
 
-    result = synth->reverb_level;
-    FLUID_API_RETURN(result);
+    for(list = synth->sfont; list; list = fluid_list_next(list), pos++)
+    {
+        *index = fluid_defsfont_sfont_get_sample_index(fluid_list_get(list), sample);
+
+        if(*index != -1)
+        {
+            return pos;
+        }
+    }
+
+    return -1;
 }
 
-/**
- * Get reverb width.
- * @param synth FluidSynth instance
- * @return Reverb width value (0.0-100.0)
+/*
+ * Get the voice playing an rvoice of the mixer, if it is saved by fluid_synth_save_state():
+ * playing and not finished, with a sample of a SoundFont loaded by the default loader.
  */
-double
-fluid_synth_get_reverb_width(fluid_synth_t *synth)
+static fluid_voice_t *
+fluid_synth_get_state_voice_LOCAL(fluid_synth_t *synth, fluid_rvoice_t *rvoice, int *sfont, int *sample)
 {
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
+    int i;
 
-    result = synth->reverb_width;
-    FLUID_API_RETURN(result);
+    if(rvoice->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+    {
+        return NULL;
+    }
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        if(voice->rvoice == rvoice && fluid_voice_is_playing(voice))
+        {
+            *sfont = fluid_synth_find_sample_LOCAL(synth, voice->sample, sample);
+            return (*sfont != -1) ? voice : NULL;
+        }
+    }
+
+    return NULL;
 }
 
 /**
- * Enable or disable chorus effect.
+ * Save the musical state of a synth, to go on from it later by fluid_synth_restore_state(),
+ * on this synth or on another one, rather than by playing the MIDI events from the start again.
  * @param synth FluidSynth instance
- * @param on TRUE to enable chorus, FALSE to disable
+ * @param data Buffer to save the state to, NULL to query the size of the state only
+ * @param size Size of \p data in bytes, set to the size of the state on return
+ * @return #FLUID_OK on success, #FLUID_FAILED if \p data is too small or otherwise.
+ *
+ * The state is saved in a compact binary format: the controllers, programs, tunings
+ * and modes of the channels, the tunings of the synth, the voices playing with the
+ * state of their interpolation, envelopes, LFOs and filters, the gain and the
+ * parameters of the effects, and the delay lines of the reverb and chorus units.
+ * It is taken at the end of the last block rendered: the audio rendered but not
+ * read yet, see fluid_synth_get_buffered_frames(), isn't part of it, nor are the
+ * convolution reverbs, the LADSPA effects and the players and sequencers using
+ * the synth. Only the voices playing samples of SoundFonts loaded by the default
+ * loader are saved.
+ *
+ * The size of the state depends on the voices playing, so that a buffer large
+ * enough when querying the size may be too small by the time the state is saved.
+ *
+ * @note Must not be called while the synth is rendered by another thread, e.g. by an
+ * audio driver.
+ * @since 2.2.0
  */
-void
-fluid_synth_set_chorus_on(fluid_synth_t *synth, int on)
+int
+fluid_synth_save_state(fluid_synth_t *synth, void *data, size_t *size)
 {
-    fluid_return_if_fail(synth != NULL);
+    fluid_rvoice_mixer_t *mixer;
+    fluid_synth_state_t header;
+    fluid_rvoice_t **rvoices;
+    char *pos;
+    size_t total;
+    int i, k, sfont, sample, active;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size != NULL, FLUID_FAILED);
     fluid_synth_api_enter(synth);
 
-    synth->with_chorus = (on != 0);
-    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_chorus_enabled,
-                             on != 0, 0.0f);
-    fluid_synth_api_exit(synth);
+    /* the rvoices and the effects units as of the events sent so far */
+    fluid_rvoice_eventhandler_flush(synth->eventhandler);
+    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+    mixer = synth->eventhandler->mixer;
+    active = fluid_rvoice_mixer_get_active_voices(mixer);
+
+    /* the voices in the order the mixer renders them in, to be mixed in the same order */
+    rvoices = FLUID_ARRAY(fluid_rvoice_t *, active + 1);
+
+    if(rvoices == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    FLUID_MEMSET(&header, 0, sizeof(header));
+
+    for(i = 0; i < active; i++)
+    {
+        fluid_rvoice_t *rvoice = fluid_rvoice_mixer_get_voice(mixer, i);
+
+        if(fluid_synth_get_state_voice_LOCAL(synth, rvoice, &sfont, &sample) != NULL)
+        {
+            rvoices[header.voice_count++] = rvoice;
+        }
+    }
+
+    if(synth->tuning != NULL)
+    {
+        for(i = 0; i < 128 * 128; i++)
+        {
+            if(synth->tuning[i / 128] != NULL && synth->tuning[i / 128][i % 128] != NULL)
+            {
+                header.tuning_count++;
+            }
+        }
+    }
+
+    header.fx_size = (unsigned int)fluid_rvoice_mixer_get_fx_state_size(mixer);
+    total = sizeof(header)
+            + synth->midi_channels * sizeof(fluid_synth_channel_state_t)
+            + 2 * synth->effects_groups * sizeof(double)
+            + header.tuning_count * sizeof(fluid_synth_tuning_state_t)
+            + header.voice_count * sizeof(fluid_synth_voice_state_t)
+            + header.fx_size;
+
+    if(data == NULL || *size < total)
+    {
+        int ret = (data == NULL) ? FLUID_OK : FLUID_FAILED;
+
+        FLUID_FREE(rvoices);
+        *size = total;
+        FLUID_API_RETURN(ret);
+    }
+
+    FLUID_MEMCPY(header.magic, fluid_synth_state_magic, sizeof(header.magic));
+    header.version = FLUID_SYNTH_STATE_VERSION;
+    header.real_size = sizeof(fluid_real_t);
+    header.channel_size = sizeof(fluid_synth_channel_state_t);
+    header.voice_size = sizeof(fluid_synth_voice_state_t);
+    header.tuning_size = sizeof(fluid_synth_tuning_state_t);
+    header.midi_channels = synth->midi_channels;
+    header.effects_groups = synth->effects_groups;
+    header.sample_rate = synth->sample_rate;
+
+    header.ticks = fluid_synth_get_ticks(synth);
+    header.noteid = synth->noteid;
+    header.storeid = synth->storeid;
+    header.fromkey_portamento = synth->fromkey_portamento;
+    header.gain = synth->gain;
+
+    header.with_reverb = synth->with_reverb;
+    header.reverb_roomsize = synth->reverb_roomsize;
+    header.reverb_damping = synth->reverb_damping;
+    header.reverb_width = synth->reverb_width;
+    header.reverb_level = synth->reverb_level;
+
+    header.with_chorus = synth->with_chorus;
+    header.chorus_nr = synth->chorus_nr;
+    header.chorus_level = synth->chorus_level;
+    header.chorus_speed = synth->chorus_speed;
+    header.chorus_depth = synth->chorus_depth;
+    header.chorus_type = synth->chorus_type;
+
+    pos = data;
+    FLUID_MEMCPY(pos, &header, sizeof(header));
+    pos += sizeof(header);
+
+    for(i = 0; i < synth->midi_channels; i++)
+    {
+        fluid_channel_t *channel = synth->channel[i];
+        fluid_preset_t *preset = fluid_channel_get_preset(channel);
+        fluid_tuning_t *tuning = fluid_channel_get_tuning(channel);
+        fluid_synth_channel_state_t state;
+        int sfont_id;
+
+        FLUID_MEMSET(&state, 0, sizeof(state));
+        fluid_channel_save_state(channel, &state.chan);
+        fluid_channel_get_sfont_bank_prog(channel, &sfont_id, NULL, NULL);
+        state.bank_prog_sfont = fluid_synth_get_sfont_position(synth, fluid_synth_get_sfont_by_id(synth, sfont_id));
+        state.preset_sfont = -1;
+        state.tuning_bank = state.tuning_prog = -1;
+
+        if(preset != NULL)
+        {
+            state.preset_sfont = fluid_synth_get_sfont_position(synth, fluid_preset_get_sfont(preset));
+            state.preset_bank = fluid_preset_get_banknum(preset);
+            state.preset_num = fluid_preset_get_num(preset);
+        }
+
+        if(tuning != NULL)
+        {
+            state.tuning_bank = fluid_tuning_get_bank(tuning);
+            state.tuning_prog = fluid_tuning_get_prog(tuning);
+        }
+
+        FLUID_MEMCPY(pos, &state, sizeof(state));
+        pos += sizeof(state);
+    }
+
+    FLUID_MEMCPY(pos, synth->fx_sends, 2 * synth->effects_groups * sizeof(double));
+    pos += 2 * synth->effects_groups * sizeof(double);
+
+    for(i = 0; i < 128 * 128 && header.tuning_count > 0; i++)
+    {
+        fluid_tuning_t *tuning = fluid_synth_get_tuning(synth, i / 128, i % 128);
+        fluid_synth_tuning_state_t state;
+
+        if(tuning == NULL)
+        {
+            continue;
+        }
+
+        FLUID_MEMSET(&state, 0, sizeof(state));
+        state.bank = i / 128;
+        state.prog = i % 128;
+        FLUID_STRNCPY(state.name, fluid_tuning_get_name(tuning), sizeof(state.name));
+        FLUID_MEMCPY(state.pitch, fluid_tuning_get_all(tuning), sizeof(state.pitch));
+        FLUID_MEMCPY(pos, &state, sizeof(state));
+        pos += sizeof(state);
+    }
+
+    for(i = 0; i < header.voice_count; i++)
+    {
+        fluid_voice_t *voice = fluid_synth_get_state_voice_LOCAL(synth, rvoices[i], &sfont, &sample);
+        fluid_synth_voice_state_t state;
+
+        FLUID_MEMSET(&state, 0, sizeof(state));
+        fluid_voice_save_state(voice, &state.voice);
+        fluid_rvoice_save_state(rvoices[i], &state.rvoice);
+        state.sfont = sfont;
+        state.sample = sample;
+        state.stereo_leader = -1;
+
+        for(k = 0; k < header.voice_count; k++)
+        {
+            if(rvoices[k] == rvoices[i]->stereo_leader)
+            {
+                state.stereo_leader = k;
+            }
+        }
+
+        FLUID_MEMCPY(pos, &state, sizeof(state));
+        pos += sizeof(state);
+    }
+
+    fluid_rvoice_mixer_save_fx_state(mixer, pos);
+
+    FLUID_FREE(rvoices);
+    *size = total;
+    FLUID_API_RETURN(FLUID_OK);
 }
 
 /**
- * Set chorus parameters. It should be turned on with fluid_synth_set_chorus_on().
- * Keep in mind, that the needed CPU time is proportional to 'nr'.
+ * Restore the musical state of a synth saved by fluid_synth_save_state(), on this
+ * synth or on another one, to go on playing from it.
  * @param synth FluidSynth instance
- * @param nr Chorus voice count (0-99, CPU time consumption proportional to
- *   this value)
- * @param level Chorus level (0.0-10.0)
- * @param speed Chorus speed in Hz (0.1-5.0)
- * @param depth_ms Chorus depth (max value depends on synth sample-rate,
- *   0.0-21.0 is safe for sample-rate values up to 96KHz)
- * @param type Chorus waveform type (#fluid_chorus_mod)
+ * @param data The state
+ * @param size Size of the state in bytes
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The synth is reset to its initial state first, see fluid_synth_reset_to_initial_state(),
+ * so that nothing is left of the notes and the tunings it played before. The state
+ * must have been saved by the same build of FluidSynth, by a synth with the same
+ * count of MIDI channels and effects groups and the same sample rate, having the
+ * same SoundFonts loaded in the same order. The voices whose samples aren't loaded
+ * are left out.
+ *
+ * The state is checked before the synth is reset: a truncated state, or one with
+ * counts, notes, channels or indices out of range, is rejected with the synth left
+ * as it is. A voice whose saved playback state doesn't fit its sample is turned off.
+ *
+ * With the same settings, the synth renders the same audio as the synth saving
+ * the state would have from there on.
+ *
+ * @note Must not be called while the synth is rendered by another thread, e.g. by an
+ * audio driver. The players and sequencers using the synth should be stopped first.
+ * @since 2.2.0
  */
-int fluid_synth_set_chorus(fluid_synth_t *synth, int nr, double level,
-                           double speed, double depth_ms, int type)
+int
+fluid_synth_restore_state(fluid_synth_t *synth, const void *data, size_t size)
 {
-    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_ALL, nr, level, speed,
-                                       depth_ms, type);
-}
+    fluid_rvoice_mixer_t *mixer;
+    fluid_synth_state_t header;
+    fluid_sample_timer_t *st;
+    fluid_rvoice_t **rvoices;
+    const char *pos = data;
+    size_t total;
+    int i, finished = FALSE, ret = FLUID_OK;
 
-/**
- * Set the chorus voice count. See fluid_synth_set_chorus() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int fluid_synth_set_chorus_nr(fluid_synth_t *synth, int nr)
-{
-    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_NR, nr, 0, 0, 0, 0);
-}
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(data != NULL, FLUID_FAILED);
 
-/**
- * Set the chorus level. See fluid_synth_set_chorus() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int fluid_synth_set_chorus_level(fluid_synth_t *synth, double level)
-{
-    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_LEVEL, 0, level, 0, 0, 0);
-}
+    if(size < sizeof(header))
+    {
+        FLUID_LOG(FLUID_ERR, "The synth state is truncated");
+        return FLUID_FAILED;
+    }
 
-/**
- * Set the chorus speed. See fluid_synth_set_chorus() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int fluid_synth_set_chorus_speed(fluid_synth_t *synth, double speed)
-{
-    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_SPEED, 0, 0, speed, 0, 0);
-}
+    FLUID_MEMCPY(&header, pos, sizeof(header));
+    pos += sizeof(header);
 
-/**
- * Set the chorus depth. See fluid_synth_set_chorus() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int fluid_synth_set_chorus_depth(fluid_synth_t *synth, double depth_ms)
-{
-    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_DEPTH, 0, 0, 0, depth_ms, 0);
-}
+    if(FLUID_MEMCMP(header.magic, fluid_synth_state_magic, sizeof(header.magic)) != 0
+            || header.version != FLUID_SYNTH_STATE_VERSION
+            || header.real_size != sizeof(fluid_real_t)
+            || header.channel_size != sizeof(fluid_synth_channel_state_t)
+            || header.voice_size != sizeof(fluid_synth_voice_state_t)
+            || header.tuning_size != sizeof(fluid_synth_tuning_state_t))
+    {
+        FLUID_LOG(FLUID_ERR, "Not a synth state saved by this build of FluidSynth");
+        return FLUID_FAILED;
+    }
 
-/**
- * Set the chorus type. See fluid_synth_set_chorus() for further info.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- */
-int fluid_synth_set_chorus_type(fluid_synth_t *synth, int type)
-{
-    return fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_TYPE, 0, 0, 0, 0, type);
-}
+    /* the counts come from the buffer: none of them may overflow the size of the state */
+    total = sizeof(header);
 
-int
-fluid_synth_set_chorus_full(fluid_synth_t *synth, int set, int nr, double level,
-                            double speed, double depth_ms, int type)
-{
-    int ret;
-    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    if(!fluid_synth_state_add_size(&total, header.midi_channels, sizeof(fluid_synth_channel_state_t))
+            || !fluid_synth_state_add_size(&total, header.effects_groups, 2 * sizeof(double))
+            || !fluid_synth_state_add_size(&total, header.tuning_count, sizeof(fluid_synth_tuning_state_t))
+            || !fluid_synth_state_add_size(&total, header.voice_count, sizeof(fluid_synth_voice_state_t))
+            || header.fx_size > SIZE_MAX - total
+            || size != total + header.fx_size)
+    {
+        FLUID_LOG(FLUID_ERR, "The synth state is truncated");
+        return FLUID_FAILED;
+    }
 
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    /* if non of the flags is set, fail */
-    fluid_return_val_if_fail(set & FLUID_CHORUS_SET_ALL, FLUID_FAILED);
+    if(header.tuning_count > 128 * 128
+            || (header.fromkey_portamento != INVALID_NOTE
+                && (header.fromkey_portamento < 0 || header.fromkey_portamento > 127)))
+    {
+        FLUID_LOG(FLUID_ERR, "The synth state is corrupted");
+        return FLUID_FAILED;
+    }
 
-    /* Synth shadow values are set here so that they will be returned if queried */
     fluid_synth_api_enter(synth);
 
-    if(set & FLUID_CHORUS_SET_NR)
+    if(header.midi_channels != synth->midi_channels || header.effects_groups != synth->effects_groups
+            || header.sample_rate != synth->sample_rate)
     {
-        synth->chorus_nr = nr;
+        FLUID_LOG(FLUID_ERR, "The synth state was saved by a synth with other channels, effects groups or sample rate");
+        FLUID_API_RETURN(FLUID_FAILED);
     }
 
-    if(set & FLUID_CHORUS_SET_LEVEL)
+    if(fluid_synth_check_state_LOCAL(synth, &header, data) != FLUID_OK)
     {
-        synth->chorus_level = level;
+        FLUID_API_RETURN(FLUID_FAILED);
     }
 
-    if(set & FLUID_CHORUS_SET_SPEED)
+    rvoices = FLUID_ARRAY(fluid_rvoice_t *, header.voice_count + 1);
+
+    if(rvoices == NULL)
     {
-        synth->chorus_speed = speed;
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_API_RETURN(FLUID_FAILED);
     }
 
-    if(set & FLUID_CHORUS_SET_DEPTH)
+    fluid_synth_reset_to_initial_state(synth);
+    mixer = synth->eventhandler->mixer;
+
+    fluid_synth_set_gain(synth, header.gain);
+    fluid_synth_set_reverb_on(synth, header.with_reverb);
+    fluid_synth_set_reverb_full(synth, FLUID_REVMODEL_SET_ALL, header.reverb_roomsize, header.reverb_damping,
+                                header.reverb_width, header.reverb_level);
+    fluid_synth_set_chorus_on(synth, header.with_chorus);
+    fluid_synth_set_chorus_full(synth, FLUID_CHORUS_SET_ALL, header.chorus_nr, header.chorus_level,
+                                header.chorus_speed, header.chorus_depth, header.chorus_type);
+
+    /* the effects units swapped in, and the voices turned off by the reset done with */
+    fluid_rvoice_eventhandler_flush(synth->eventhandler);
+    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+    fluid_rvoice_mixer_remove_finished_voices(mixer);
+    fluid_synth_check_finished_voices(synth);
+
+    /* the channels after the tunings they refer to */
+    pos += synth->midi_channels * sizeof(fluid_synth_channel_state_t);
+
+    for(i = 0; i < 2 * synth->effects_groups; i++)
     {
-        synth->chorus_depth = depth_ms;
+        double send;
+
+        FLUID_MEMCPY(&send, pos, sizeof(send));
+        pos += sizeof(send);
+        fluid_synth_set_fx_send_LOCAL(synth, i / 2, i % 2, send);
     }
 
-    if(set & FLUID_CHORUS_SET_TYPE)
+    for(i = 0; i < header.tuning_count; i++)
     {
-        synth->chorus_type = type;
+        fluid_synth_tuning_state_t state;
+
+        FLUID_MEMCPY(&state, pos, sizeof(state));
+        pos += sizeof(state);
+        state.name[sizeof(state.name) - 1] = '\0';
+
+        if(fluid_synth_activate_key_tuning(synth, state.bank, state.prog, state.name, state.pitch, FALSE) != FLUID_OK)
+        {
+            ret = FLUID_FAILED;
+        }
     }
 
-    param[0].i = set;
-    param[1].i = nr;
-    param[2].real = level;
-    param[3].real = speed;
-    param[4].real = depth_ms;
-    param[5].i = type;
-    ret = fluid_rvoice_eventhandler_push(synth->eventhandler,
-                                         fluid_rvoice_mixer_set_chorus_params,
-                                         synth->eventhandler->mixer,
-                                         param);
+    for(i = 0; i < synth->midi_channels; i++)
+    {
+        const char *chan_pos = (const char *)data + sizeof(header) + i * sizeof(fluid_synth_channel_state_t);
+        fluid_channel_t *channel = synth->channel[i];
+        fluid_synth_channel_state_t state;
+        fluid_sfont_t *sfont;
+        fluid_preset_t *preset = NULL;
+        fluid_tuning_t *tuning;
+        int bank, prog;
 
-    FLUID_API_RETURN(ret);
-}
+        FLUID_MEMCPY(&state, chan_pos, sizeof(state));
 
-/**
- * Get chorus voice number (delay line count) value.
- * @param synth FluidSynth instance
- * @return Chorus voice count
- */
-int
-fluid_synth_get_chorus_nr(fluid_synth_t *synth)
-{
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
+        if(fluid_channel_load_state(channel, &state.chan) != FLUID_OK)
+        {
+            ret = FLUID_FAILED;
+        }
 
-    result = synth->chorus_nr;
-    FLUID_API_RETURN(result);
-}
+        /* the SoundFont IDs of the synth saving the state may not be the ones of this synth */
+        fluid_channel_get_sfont_bank_prog(channel, NULL, &bank, &prog);
+        sfont = (state.bank_prog_sfont >= 0) ? fluid_synth_get_sfont(synth, state.bank_prog_sfont) : NULL;
+        fluid_channel_set_sfont_bank_prog(channel, (sfont != NULL) ? fluid_sfont_get_id(sfont) : 0, bank, prog);
 
-/**
- * Get chorus level.
- * @param synth FluidSynth instance
- * @return Chorus level value
- */
-double
-fluid_synth_get_chorus_level(fluid_synth_t *synth)
-{
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
+        if(state.preset_sfont >= 0)
+        {
+            sfont = fluid_synth_get_sfont(synth, state.preset_sfont);
+            preset = (sfont != NULL) ? fluid_sfont_get_preset(sfont, state.preset_bank, state.preset_num) : NULL;
 
-    result = synth->chorus_level;
-    FLUID_API_RETURN(result);
-}
+            if(preset == NULL)
+            {
+                FLUID_LOG(FLUID_WARN, "The preset %d:%d of channel %d isn't loaded", state.preset_bank,
+                          state.preset_num, i);
+                ret = FLUID_FAILED;
+            }
+        }
 
-/**
- * Get chorus speed in Hz.
- * @param synth FluidSynth instance
- * @return Chorus speed in Hz
- */
-double
-fluid_synth_get_chorus_speed(fluid_synth_t *synth)
-{
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
+        fluid_channel_set_preset(channel, preset);
 
-    result = synth->chorus_speed;
-    FLUID_API_RETURN(result);
-}
+        tuning = (state.tuning_bank >= 0) ? fluid_synth_get_tuning(synth, state.tuning_bank, state.tuning_prog) : NULL;
 
-/**
- * Get chorus depth.
- * @param synth FluidSynth instance
- * @return Chorus depth
- */
-double
-fluid_synth_get_chorus_depth(fluid_synth_t *synth)
-{
-    double result;
-    fluid_return_val_if_fail(synth != NULL, 0.0);
-    fluid_synth_api_enter(synth);
+        if(tuning != NULL)
+        {
+            fluid_tuning_ref(tuning);
+            fluid_synth_set_tuning_LOCAL(synth, i, tuning, FALSE);
+        }
+    }
 
-    result = synth->chorus_depth;
-    FLUID_API_RETURN(result);
-}
+    /* the voices are started without portamento, their rvoices are restored below anyway */
+    synth->fromkey_portamento = INVALID_NOTE;
 
-/**
- * Get chorus waveform type.
- * @param synth FluidSynth instance
- * @return Chorus waveform type (#fluid_chorus_mod)
- */
-int
-fluid_synth_get_chorus_type(fluid_synth_t *synth)
-{
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
+    for(i = 0; i < header.voice_count; i++)
+    {
+        const char *voice_pos = pos + i * sizeof(fluid_synth_voice_state_t);
+        fluid_synth_voice_state_t state;
+        fluid_sfont_t *sfont;
+        fluid_sample_t *sample = NULL;
+        fluid_voice_t *voice = NULL;
 
-    result = synth->chorus_type;
-    FLUID_API_RETURN(result);
-}
+        FLUID_MEMCPY(&state, voice_pos, sizeof(state));
+        rvoices[i] = NULL;
 
-/*
- * If the same note is hit twice on the same channel, then the older
- * voice process is advanced to the release stage.  Using a mechanical
- * MIDI controller, the only way this can happen is when the sustain
- * pedal is held.  In this case the behaviour implemented here is
- * natural for many instruments.  Note: One noteon event can trigger
- * several voice processes, for example a stereo sample.  Don't
- * release those...
- */
-void
-fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan,
-        int key)
-{
-    int i;
-    fluid_voice_t *voice;
+        sfont = fluid_synth_get_sfont(synth, state.sfont);
 
-    /* storeid is a parameter for fluid_voice_init() */
-    synth->storeid = synth->noteid++;
+        if(sfont != NULL)
+        {
+            sample = fluid_defsfont_sfont_get_sample(sfont, state.sample);
+        }
+
+        if(sample == NULL || sample->data == NULL || state.voice.chan >= synth->midi_channels)
+        {
+            FLUID_LOG(FLUID_WARN, "The sample of a voice on channel %d isn't loaded", state.voice.chan);
+            ret = FLUID_FAILED;
+            continue;
+        }
+
+        voice = fluid_synth_alloc_voice_LOCAL(synth, sample, state.voice.chan, state.voice.key, state.voice.vel, NULL);
+
+        if(voice == NULL)
+        {
+            ret = FLUID_FAILED;
+            continue;
+        }
+
+        fluid_voice_load_state(voice, &state.voice);
+        fluid_synth_start_voice_LOCAL(synth, voice);
+        fluid_voice_resume_state(voice, &state.voice);
+        rvoices[i] = voice->rvoice;
+    }
+
+    /* the rvoices are updated by the events of their start, and then take over the saved state */
+    fluid_rvoice_eventhandler_flush(synth->eventhandler);
+    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+
+    for(i = 0; i < header.voice_count; i++)
+    {
+        fluid_synth_voice_state_t state;
+
+        if(rvoices[i] == NULL)
+        {
+            continue;
+        }
+
+        FLUID_MEMCPY(&state, pos + i * sizeof(fluid_synth_voice_state_t), sizeof(state));
 
-    /* for "monophonic playing" key is the previous sustained note
-      if it exists (0 to 127) or INVALID_NOTE otherwise */
-    if(key == INVALID_NOTE)
-    {
-        return;
+        if(fluid_rvoice_load_state(rvoices[i], &state.rvoice) != FLUID_OK)
+        {
+            fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+            /* turned off right away rather than played from a state it can't be in */
+            FLUID_LOG(FLUID_WARN, "The synth state of a voice on channel %d is corrupted", state.voice.chan);
+            fluid_rvoice_voiceoff(rvoices[i], param);
+            finished = TRUE;
+            ret = FLUID_FAILED;
+        }
     }
 
-    for(i = 0; i < synth->polyphony; i++)
+    /* the stereo pairs linked again once all rvoices are loaded, as loading one unlinks it */
+    for(i = 0; i < header.voice_count; i++)
     {
-        voice = synth->voice[i];
+        fluid_synth_voice_state_t state;
+        fluid_rvoice_t *leader;
 
-        if(fluid_voice_is_playing(voice)
-                && (fluid_voice_get_channel(voice) == chan)
-                && (fluid_voice_get_key(voice) == key)
-                && (fluid_voice_get_id(voice) != synth->noteid))
+        if(rvoices[i] == NULL || rvoices[i]->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
         {
-            /* Id of voices that was sustained by sostenuto */
-            if(fluid_voice_is_sostenuto(voice))
-            {
-                synth->storeid = fluid_voice_get_id(voice);
-            }
+            continue;
+        }
 
-            /* Force the voice into release stage (pedaling is ignored) */
-            fluid_voice_release(voice);
+        FLUID_MEMCPY(&state, pos + i * sizeof(fluid_synth_voice_state_t), sizeof(state));
+        leader = (state.stereo_leader >= 0) ? rvoices[state.stereo_leader] : NULL;
+
+        if(leader != NULL && leader->envlfo.volenv.section != FLUID_VOICE_ENVFINISHED)
+        {
+            fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+            param[0].ptr = rvoices[i];
+            fluid_rvoice_set_stereo_follower(leader, param);
         }
     }
+
+    fluid_rvoice_mixer_restore_voices(mixer, rvoices, header.voice_count);
+
+    if(finished)
+    {
+        fluid_rvoice_mixer_remove_finished_voices(mixer);
+        fluid_synth_check_finished_voices(synth);
+    }
+    pos += header.voice_count * sizeof(fluid_synth_voice_state_t);
+
+    if(fluid_rvoice_mixer_load_fx_state(mixer, pos, header.fx_size) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_WARN, "The state of the effects units doesn't match the ones of the synth");
+        ret = FLUID_FAILED;
+    }
+
+    synth->fromkey_portamento = header.fromkey_portamento;
+    synth->noteid = header.noteid;
+    synth->storeid = header.storeid;
+    fluid_atomic_int_set(&synth->ticks_since_start, header.ticks);
+
+    for(st = synth->sample_timers; st; st = st->next)
+    {
+        fluid_sample_timer_reset(synth, st);
+    }
+
+    FLUID_FREE(rvoices);
+    FLUID_API_RETURN(ret);
 }
 
 /**
- * Set synthesis interpolation method on one or all MIDI channels.
+ * Pop the oldest voice start or stop from the queue of
+ * <a href="fluidsettings.xml#synth.voice-activity-queue">synth.voice-activity-queue</a>.
  * @param synth FluidSynth instance
- * @param chan MIDI channel to set interpolation method on or -1 for all channels
- * @param interp_method Interpolation method (#fluid_interp)
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @param type Location to store the #fluid_voice_activity_type to, or NULL
+ * @param chan Location to store the MIDI channel of the voice to, or NULL
+ * @param key Location to store the MIDI note of the voice to, or NULL
+ * @param id Location to store the ID of the voice to (see fluid_voice_get_id()), or NULL
+ * @param active_voices Location to store the count of voices playing right after
+ *   the voice started or stopped to, or NULL
+ * @return #FLUID_OK if a voice start or stop has been popped, #FLUID_FAILED if there
+ *   is none or the queue is disabled
+ *
+ * The voices are queued by the synth whenever they start or stop, without waiting for
+ * anyone. This function doesn't enter the synth either, so that a monitor can follow
+ * the voices without polling fluid_synth_get_active_voice_count() or
+ * fluid_synth_get_voicelist(). It may be called from any thread, but only from one.
+ * If the queue is full, voices starting or stopping are not queued,
+ * \p active_voices of the next one is still the actual count.
+ * @since 2.2.0
  */
 int
-fluid_synth_set_interp_method(fluid_synth_t *synth, int chan, int interp_method)
+fluid_synth_pop_voice_activity(fluid_synth_t *synth, int *type, int *chan, int *key,
+                               unsigned int *id, int *active_voices)
 {
-    int i;
+    fluid_voice_activity_t *activity;
 
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_synth_api_enter(synth);
 
-    if(chan < -1 || chan >= synth->midi_channels)
+    if(synth->voice_activity == NULL)
     {
-        FLUID_API_RETURN(FLUID_FAILED);
+        return FLUID_FAILED;
     }
 
-    if(synth->channel[0] == NULL)
+    activity = fluid_ringbuffer_get_outptr(synth->voice_activity);
+
+    if(activity == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Channels don't exist (yet)!");
-        FLUID_API_RETURN(FLUID_FAILED);
+        return FLUID_FAILED;
     }
 
-    for(i = 0; i < synth->midi_channels; i++)
+    if(type != NULL)
     {
-        if(chan < 0 || fluid_channel_get_num(synth->channel[i]) == chan)
-        {
-            fluid_channel_set_interp_method(synth->channel[i], interp_method);
-        }
+        *type = activity->type;
     }
 
-    FLUID_API_RETURN(FLUID_OK);
-};
-
-/**
- * Get the total count of MIDI channels.
- * @param synth FluidSynth instance
- * @return Count of MIDI channels
- */
-int
-fluid_synth_count_midi_channels(fluid_synth_t *synth)
-{
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
+    if(chan != NULL)
+    {
+        *chan = activity->chan;
+    }
 
-    result = synth->midi_channels;
-    FLUID_API_RETURN(result);
-}
+    if(key != NULL)
+    {
+        *key = activity->key;
+    }
 
-/**
- * Get the total count of audio channels.
- * @param synth FluidSynth instance
- * @return Count of audio channel stereo pairs (1 = 2 channels, 2 = 4, etc)
- */
-int
-fluid_synth_count_audio_channels(fluid_synth_t *synth)
-{
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
+    if(id != NULL)
+    {
+        *id = activity->id;
+    }
 
-    result = synth->audio_channels;
-    FLUID_API_RETURN(result);
-}
+    if(active_voices != NULL)
+    {
+        *active_voices = activity->active_voices;
+    }
 
-/**
- * Get the total number of allocated audio channels.  Usually identical to the
- * number of audio channels.  Can be employed by LADSPA effects subsystem.
- *
- * @param synth FluidSynth instance
- * @return Count of audio group stereo pairs (1 = 2 channels, 2 = 4, etc)
- */
-int
-fluid_synth_count_audio_groups(fluid_synth_t *synth)
-{
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
+    fluid_ringbuffer_next_outptr(synth->voice_activity);
 
-    result = synth->audio_groups;
-    FLUID_API_RETURN(result);
+    return FLUID_OK;
 }
 
 /**
- * Get the total number of allocated effects channels.
+ * Get the voices playing after the latest rendering call, as published by the rendering thread
+ * with <a href="fluidsettings.xml#synth.voice-snapshot">synth.voice-snapshot</a>.
  * @param synth FluidSynth instance
- * @return Count of allocated effects channels
+ * @param voices Array to store the voices to
+ * @param size Length of \p voices
+ * @return Count of the voices stored, #FLUID_FAILED if the snapshot is disabled or if the rendering
+ *   thread kept overwriting it while it was copied
+ *
+ * Contrary to fluid_synth_get_voicelist(), this function neither enters the synth nor reads
+ * the voices themselves: after each rendering call, the rendering thread writes the voices to
+ * one of two arrays, which is copied here unless the rendering thread has started writing to it
+ * again in the meantime. It may therefore be called from any thread, e.g. by a user interface
+ * polling several synths at its frame rate. The snapshot holds at most as many voices as the
+ * <a href="fluidsettings.xml#synth.polyphony">synth.polyphony</a> the synth has been created with.
+ * @since 2.2.0
  */
 int
-fluid_synth_count_effects_channels(fluid_synth_t *synth)
+fluid_synth_get_voice_snapshot(fluid_synth_t *synth, fluid_voice_snapshot_t *voices, int size)
 {
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(voices != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size >= 0, FLUID_FAILED);
 
-    result = synth->effects_channels;
-    FLUID_API_RETURN(result);
+    return fluid_rvoice_mixer_get_snapshot(synth->eventhandler->mixer, voices, size);
 }
 
 /**
- * Get the total number of allocated effects units.
+ * Get the peak and RMS levels of an audio or effects channel, measured since
+ * the previous call for the channel.
  * @param synth FluidSynth instance
- * @return Count of allocated effects units
+ * @param fx FALSE for an audio channel, TRUE for an effects channel
+ * @param chan Channel to measure: twice the index of the audio channel (or effects
+ *   channel) for its left buffer, one more for its right one, like the buffers
+ *   of fluid_synth_process()
+ * @param peak Location to store the highest absolute sample value to
+ * @param rms Location to store the root mean square of the samples to
+ * @return #FLUID_OK on success, #FLUID_FAILED if <a href="fluidsettings.xml#synth.level-meters">
+ *   synth.level-meters</a> is disabled or \p chan is invalid
+ *
+ * The levels are measured by the rendering thread right after rendering, while the
+ * buffers are still in the cache, as linear sample values (1.0 being full scale).
+ * This function doesn't block the synth and may be called from any thread, e.g. by
+ * a meter of a user interface, but only by one thread at a time for each channel.
+ * If called again before anything has been rendered, it returns the same levels.
+ * @since 2.2.0
  */
 int
-fluid_synth_count_effects_groups(fluid_synth_t *synth)
+fluid_synth_get_level(fluid_synth_t *synth, int fx, int chan, float *peak, float *rms)
 {
-    int result;
-    fluid_return_val_if_fail(synth != NULL, 0);
-    fluid_synth_api_enter(synth);
-
-    result = synth->effects_groups;
-    FLUID_API_RETURN(result);
-}
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(peak != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(rms != NULL, FLUID_FAILED);
 
-/**
- * Get the synth CPU load value.
- * @param synth FluidSynth instance
- * @return Estimated CPU load value in percent (0-100)
- */
-double
-fluid_synth_get_cpu_load(fluid_synth_t *synth)
-{
-    fluid_return_val_if_fail(synth != NULL, 0);
-    return fluid_atomic_float_get(&synth->cpu_load);
+    return fluid_rvoice_mixer_get_level(synth->eventhandler->mixer, fx, chan, peak, rms);
 }
 
 /* Get tuning for a given bank:program */
@@ -5764,18 +10319,15 @@ fluid_synth_replace_tuning_LOCAL(fluid_synth_t *synth, fluid_tuning_t *old_tunin
     fluid_tuning_unref(new_tuning, 1);
 }
 
-/* Update voice tunings in realtime */
+/* Retune the voices of a channel to its current tuning */
 static void
-fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel)
+fluid_synth_retune_voices_LOCAL(fluid_channel_t *channel)
 {
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->voices; voice != NULL; voice = voice->chan_next)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_is_on(voice) && (voice->channel == channel))
+        if(fluid_voice_is_on(voice))
         {
             fluid_voice_calculate_gen_pitch(voice);
             fluid_voice_update_param(voice, GEN_PITCH);
@@ -5783,12 +10335,28 @@ fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth, fluid_channel_t *cha
     }
 }
 
+/* Update voice tunings in realtime. A burst of tuning changes, like MIDI Tuning
+ * Standard note changes, retunes the voices only once with the next block, if
+ * synth.coalesce-controllers is enabled. */
+static void
+fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel)
+{
+    if(synth->coalesce_controllers)
+    {
+        channel->pending_tuning = TRUE;
+        fluid_atomic_int_set(&synth->controllers_pending, 1);
+        return;
+    }
+
+    fluid_synth_retune_voices_LOCAL(channel);
+}
+
 /**
  * Set the tuning of the entire MIDI note scale.
  * @param synth FluidSynth instance
  * @param bank Tuning bank number (0-127), not related to MIDI instrument bank
  * @param prog Tuning preset number (0-127), not related to MIDI instrument program
- * @param name Label name for this tuning
+ * @param name Label name for this tuning (truncated to 63 characters)
  * @param pitch Array of pitch values (length of 128, each value is number of
  *   cents, for example normally note 0 is 0.0, 1 is 100.0, 60 is 6000.0, etc).
  *   Pass NULL to create a equal tempered (normal) scale.
@@ -5811,7 +10379,7 @@ fluid_synth_activate_key_tuning(fluid_synth_t *synth, int bank, int prog,
 
     fluid_synth_api_enter(synth);
 
-    tuning = new_fluid_tuning(name, bank, prog);
+    tuning = new_fluid_tuning(name, bank, prog, synth->tuning_pool);
 
     if(tuning)
     {
@@ -5840,7 +10408,7 @@ fluid_synth_activate_key_tuning(fluid_synth_t *synth, int bank, int prog,
  * @param synth FluidSynth instance
  * @param bank Tuning bank number (0-127), not related to MIDI instrument bank
  * @param prog Tuning preset number (0-127), not related to MIDI instrument program
- * @param name Label name for this tuning
+ * @param name Label name for this tuning (truncated to 63 characters)
  * @param pitch Array of pitch values (length of 12 for each note of an octave
  *   starting at note C, values are number of offset cents to add to the normal
  *   tuning amount)
@@ -5863,7 +10431,7 @@ fluid_synth_activate_octave_tuning(fluid_synth_t *synth, int bank, int prog,
     fluid_return_val_if_fail(pitch != NULL, FLUID_FAILED);
 
     fluid_synth_api_enter(synth);
-    tuning = new_fluid_tuning(name, bank, prog);
+    tuning = new_fluid_tuning(name, bank, prog, synth->tuning_pool);
 
     if(tuning)
     {
@@ -5921,11 +10489,11 @@ fluid_synth_tune_notes(fluid_synth_t *synth, int bank, int prog,
 
     if(old_tuning)
     {
-        new_tuning = fluid_tuning_duplicate(old_tuning);
+        new_tuning = fluid_tuning_duplicate(old_tuning, synth->tuning_pool);
     }
     else
     {
-        new_tuning = new_fluid_tuning("Unnamed", bank, prog);
+        new_tuning = new_fluid_tuning("Unnamed", bank, prog, synth->tuning_pool);
     }
 
     if(new_tuning)
@@ -5983,7 +10551,7 @@ fluid_synth_activate_tuning(fluid_synth_t *synth, int chan, int bank, int prog,
      * it can be replaced later, if any changes are made. */
     if(!tuning)
     {
-        tuning = new_fluid_tuning("Unnamed", bank, prog);
+        tuning = new_fluid_tuning("Unnamed", bank, prog, synth->tuning_pool);
 
         if(tuning)
         {
@@ -6213,18 +10781,12 @@ static void
 fluid_synth_set_gen_LOCAL(fluid_synth_t *synth, int chan, int param, float value)
 {
     fluid_voice_t *voice;
-    int i;
 
     fluid_channel_set_gen(synth->channel[chan], param, value);
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->voices; voice != NULL; voice = voice->chan_next)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_get_channel(voice) == chan)
-        {
-            fluid_voice_set_param(voice, param, value);
-        }
+        fluid_voice_set_param(voice, param, value);
     }
 }
 
@@ -6305,6 +10867,24 @@ fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event)
     return FLUID_FAILED;
 }
 
+/**
+ * Handle a batch of MIDI events, as fluid_synth_handle_midi_event() would one after the other.
+ *
+ * The synth is locked once for the whole batch rather than once per event, and the
+ * changes made by the events are handed to the rendering at once.
+ * @param synth FluidSynth instance
+ * @param events Array of @p n MIDI events to handle
+ * @param n Number of MIDI events
+ * @return #FLUID_OK on success, #FLUID_FAILED if any of the events failed
+ *   (the others are handled nonetheless)
+ * @since 2.2.0
+ */
+int
+fluid_synth_handle_midi_events(fluid_synth_t *synth, fluid_midi_event_t **events, int n)
+{
+    return fluid_synth_handle_midi_batch(synth, fluid_synth_handle_midi_event, synth, events, n);
+}
+
 /**
  * Create and start voices using a preset and a MIDI note on event.
  * @param synth FluidSynth instance
@@ -6397,6 +10977,7 @@ fluid_synth_set_bank_offset(fluid_synth_t *synth, int sfont_id, int offset)
         if(fluid_sfont_get_id(sfont) == sfont_id)
         {
             sfont->bankofs = offset;
+            fluid_hashtable_remove_all(synth->preset_index);
             break;
         }
     }
@@ -6460,6 +11041,135 @@ fluid_synth_api_enter(fluid_synth_t *synth)
     }
 
     synth->public_api_count++;
+
+    /* the units of the effects turned off are released once they have been off for long enough */
+    if(synth->public_api_count == 1 && synth->fx_units_pending)
+    {
+        fluid_synth_update_fx_units(synth);
+    }
+
+    /* Events queued by the lock-free API must be processed before anything
+     * else happens to the synth, so that they keep their order relative to
+     * the calls taking the mutex. */
+    if(synth->public_api_count == 1 && synth->api_queue != NULL)
+    {
+        fluid_synth_process_api_queue(synth);
+    }
+}
+
+/*
+ * Try to queue an event for later processing by the lock-free API.
+ * Returns TRUE if the event was queued, FALSE if the caller has to process
+ * it itself, i.e. if the lock-free API is disabled or the channel is out of
+ * range (so that the error is reported immediately).
+ */
+static int
+fluid_synth_queue_api_event(fluid_synth_t *synth, int type, int chan,
+                            int param1, int param2)
+{
+    fluid_synth_api_event_t event;
+
+    if(synth == NULL || synth->api_queue == NULL
+            || chan < 0 || chan >= synth->midi_channels)
+    {
+        return FALSE;
+    }
+
+    event.type = type;
+    event.chan = chan;
+    event.param1 = param1;
+    event.param2 = param2;
+
+    if(fluid_mpsc_queue_push(synth->api_queue, &event) == FLUID_OK)
+    {
+        return TRUE;
+    }
+
+    /* The queue is full. The event can't be processed right away, as events
+     * sent earlier by this thread might still be waiting in the queue behind
+     * one that another thread is just writing. So make room in the queue and
+     * keep the event behind them. */
+    while(1)
+    {
+        fluid_synth_api_enter(synth);
+        fluid_synth_process_api_queue(synth);
+        fluid_synth_api_exit(synth);
+
+        if(fluid_mpsc_queue_push(synth->api_queue, &event) == FLUID_OK)
+        {
+            return TRUE;
+        }
+
+        /* give the thread writing the oldest element a chance to finish, without
+         * holding up the rendering and the other threads calling the API */
+        fluid_msleep(1);
+    }
+}
+
+/* Process all events queued by the lock-free API, the API must have been entered */
+static void
+fluid_synth_process_api_queue(fluid_synth_t *synth)
+{
+    fluid_synth_api_event_t event;
+
+    while(fluid_mpsc_queue_pop(synth->api_queue, &event) == FLUID_OK)
+    {
+        fluid_synth_process_api_event(synth, event.type, event.chan, event.param1, event.param2, 0);
+    }
+}
+
+/*
+ * Process a channel message right away, checking its parameters like the
+ * public functions do, but without locking the synth or queuing the message
+ * for the lock-free API: the API must have been entered by the caller.
+ * Used by the sequencer binding to pass the events of a whole block under a
+ * single lock, see fluid_seqbind_timer_callback(). The voices of a note-on
+ * start offset frames into the next block, see fluid_synth_noteon_offset().
+ */
+int
+fluid_synth_process_api_event(fluid_synth_t *synth, int type, int chan,
+                              int param1, int param2, int offset)
+{
+    int result;
+
+    if(chan < 0 || chan >= synth->midi_channels)
+    {
+        return FLUID_FAILED;
+    }
+
+    switch(type)
+    {
+    case FLUID_API_EVENT_NOTEON:
+        fluid_return_val_if_fail(param1 >= 0 && param1 <= 127, FLUID_FAILED);
+        fluid_return_val_if_fail(param2 >= 0 && param2 <= 127, FLUID_FAILED);
+        fluid_return_val_if_fail(offset >= 0 && offset < FLUID_BUFSIZE, FLUID_FAILED);
+
+        synth->voice_start_offset = offset;
+        result = fluid_synth_process_noteon(synth, chan, param1, param2);
+        synth->voice_start_offset = 0;
+        return result;
+
+    case FLUID_API_EVENT_NOTEOFF:
+        fluid_return_val_if_fail(param1 >= 0 && param1 <= 127, FLUID_FAILED);
+        return fluid_synth_process_noteoff(synth, chan, param1);
+
+    case FLUID_API_EVENT_CC:
+        fluid_return_val_if_fail(param1 >= 0 && param1 <= 127, FLUID_FAILED);
+        fluid_return_val_if_fail(param2 >= 0 && param2 <= 127, FLUID_FAILED);
+        return fluid_synth_process_cc(synth, chan, param1, param2);
+
+    case FLUID_API_EVENT_PITCH_BEND:
+        fluid_return_val_if_fail(param1 >= 0 && param1 <= 16383, FLUID_FAILED);
+        return fluid_synth_process_pitch_bend(synth, chan, param1);
+
+    case FLUID_API_EVENT_PROGRAM_CHANGE:
+        fluid_return_val_if_fail(param1 >= 0 && param1 <= 128, FLUID_FAILED);
+        return fluid_synth_process_program_change(synth, chan, param1);
+
+    default:
+        FLUID_LOG(FLUID_ERR, "Unknown lock-free API event %d", type);
+        return FLUID_FAILED;
+    }
 }
 
 void fluid_synth_api_exit(fluid_synth_t *synth)
@@ -6492,6 +11202,7 @@ int fluid_synth_set_channel_type(fluid_synth_t *synth, int chan, int type)
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     synth->channel[chan]->channel_type = type;
+    fluid_synth_rebuild_overflow_heap_LOCAL(synth);
 
     FLUID_API_RETURN(FLUID_OK);
 }
@@ -6611,6 +11322,39 @@ exit:
     return retval;
 }
 
+/**
+ * Pin the rendering thread and the extra mixer threads to CPU cores.
+ *
+ * @param synth FluidSynth instance
+ * @param cores comma-separated list of CPU core numbers, may be empty
+ * @return #FLUID_OK on success, otherwise #FLUID_FAILED
+ */
+static int fluid_synth_set_cpu_affinity(fluid_synth_t *synth, const char *cores)
+{
+    int *values;
+    int count, retval;
+
+    if(cores[0] == '\0')
+    {
+        return FLUID_OK;
+    }
+
+    /* one core for the rendering thread, and one for each extra mixer thread */
+    values = FLUID_ARRAY(int, synth->cores);
+
+    if(values == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    count = fluid_settings_split_csv(cores, values, synth->cores);
+    retval = (count < 0) ? FLUID_FAILED : fluid_rvoice_mixer_set_affinity(synth->eventhandler->mixer, values, count);
+
+    FLUID_FREE(values);
+    return retval;
+}
+
 /*
  * Handler for synth.overflow.important-channels setting.
  */
@@ -6621,6 +11365,7 @@ static void fluid_synth_handle_important_channels(void *data, const char *name,
 
     fluid_synth_api_enter(synth);
     fluid_synth_set_important_channels(synth, value);
+    fluid_synth_rebuild_overflow_heap_LOCAL(synth);
     fluid_synth_api_exit(synth);
 }
 
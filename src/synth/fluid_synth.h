@@ -30,12 +30,16 @@
 
 #include "fluid_sys.h"
 #include "fluid_list.h"
+#include "fluid_hash.h"
+#include "fluid_mpsc_queue.h"
+#include "fluid_ringbuffer.h"
 #include "fluid_rev.h"
 #include "fluid_voice.h"
 #include "fluid_chorus.h"
 #include "fluid_ladspa.h"
 #include "fluid_midi_router.h"
 #include "fluid_rvoice_event.h"
+#include "fluid_samplestream.h"
 
 /***************************************************************
  *
@@ -94,24 +98,56 @@ enum fluid_synth_status
  *
  * ticks_since_start - atomic, set by rendering thread only
  * cpu_load - atomic, set by rendering thread only
+ * dsp_load, peak_dsp_load, mixer_wait, render_calls, render_histogram, peak_voices - atomic, set by rendering thread only
+ * stolen_voices - atomic
+ * dynamic_polyphony, dynamic_polyphony_high, dynamic_polyphony_low - atomic, read by rendering thread
+ * voice_limit - atomic, changed by rendering thread while holding the lock for public API
  * cur, curmax, dither_index - used by rendering thread only
  * ladspa_fx - same instance copied in rendering thread. Synchronising handled internally.
+ * api_queue - lockless, pushed to by any thread, drained by whoever enters the API.
+ * sfont_reclaimer - created and woken while holding the lock for public API, its list of SoundFonts has its own mutex.
  *
  */
 
+/* The SoundFonts unloaded while voices still use their samples, each of them
+ * tried to be freed again by a thread when voices have finished */
+typedef struct _fluid_sfont_reclaimer_t
+{
+    fluid_thread_t *thread;
+    fluid_cond_mutex_t *mutex;
+    fluid_cond_t *cond;
+    fluid_list_t *sfonts;           /* the SoundFonts pending, owned by the thread while it tries to free them */
+    fluid_atomic_int_t pending;     /* count of SoundFonts pending */
+    int request;                    /* voices have finished since the last try */
+    int quit;
+} fluid_sfont_reclaimer_t;
+
 struct _fluid_synth_t
 {
     fluid_rec_mutex_t mutex;           /**< Lock for public API */
     int use_mutex;                     /**< Use mutex for all public API functions? */
     int public_api_count;              /**< How many times the mutex is currently locked */
+    fluid_mpsc_queue_t *api_queue;     /**< Queue of note and CC events bypassing the mutex, NULL if synth.lock-free-api is off */
 
     fluid_settings_t *settings;        /**< the synthesizer settings */
     int device_id;                     /**< Device ID used for SYSEX messages */
     int polyphony;                     /**< Maximum polyphony */
+    int voice_quota_channels;          /**< Number of channels with a voice quota, see fluid_synth_set_voice_quota() */
+    int with_log_async;                /**< Is the synth holding a reference to the logger thread? */
+    int with_voice_snapshot;           /**< Are the voices published for fluid_synth_get_voice_snapshot()? */
     int with_reverb;                   /**< Should the synth use the built-in reverb unit? */
     int with_chorus;                   /**< Should the synth use the built-in chorus unit? */
+    int with_reverb_units;             /**< Have the reverb units been created? Only once the reverb is turned on */
+    int with_chorus_units;             /**< Have the chorus units been created? Only once the chorus is turned on */
+    unsigned int reverb_off_time;      /**< fluid_curtime() when the reverb was turned off */
+    unsigned int chorus_off_time;      /**< fluid_curtime() when the chorus was turned off */
+    int fx_release_time;               /**< Milliseconds the units of an effect turned off are kept */
+    int fx_units_pending;              /**< Are there units to release or to delete, see fluid_synth_update_fx_units()? */
     int verbose;                       /**< Turn verbose mode on? */
-    double sample_rate;                /**< The sample rate */
+    double sample_rate;                /**< The sample rate the voices and the effects are rendered at */
+    double output_rate;                /**< The sample rate of the output, see synth.internal-rate */
+    int upsample_num;                  /**< Output samples per upsample_den rendered samples, 1 if not upsampled */
+    int upsample_den;
     int midi_channels;                 /**< the number of MIDI channels (>= 16) */
     int bank_select;                   /**< the style of Bank Select MIDI messages */
     int audio_channels;                /**< the number of audio channels (1 channel=left+right) */
@@ -119,24 +155,36 @@ struct _fluid_synth_t
 					  Typically equal to audio_channels. */
     int effects_channels;              /**< the number of effects channels (>= 2) */
     int effects_groups;                /**< the number of effects units (>= 1) */
+    int effects_shared;                /**< do all effects groups feed the reverb and chorus of the first one? */
+    double *fx_sends;                  /**< Shadow of the reverb and chorus send gains, indexed by 2 * fx_group + SYNTH_CHORUS_CHANNEL etc. */
     int state;                         /**< the synthesizer state */
     fluid_atomic_uint_t ticks_since_start;    /**< the number of audio samples since the start */
     unsigned int start;                /**< the start in msec, as returned by system clock */
     fluid_overflow_prio_t overflow;    /**< parameters for overflow priority (aka voice-stealing) */
+    fluid_voice_t **overflow_heap;     /**< voice[0..polyphony-1] as binary min-heap on their overflow_prio, capacity nvoice */
 
     fluid_list_t *loaders;             /**< the SoundFont loaders */
     fluid_list_t *sfont;          /**< List of fluid_sfont_info_t for each loaded SoundFont (remains until SoundFont is unloaded) */
     int sfont_id;             /**< Incrementing ID assigned to each loaded SoundFont */
+    fluid_hashtable_t *preset_index; /**< Bank and program numbers to the preset found for them in the sfont list */
+    fluid_sfont_reclaimer_t *sfont_reclaimer; /**< Frees the unloaded SoundFonts once their voices are done, created on demand */
+    fluid_list_t *sfload_jobs;    /**< SoundFonts loading in the background by fluid_synth_sfload_async() */
+    fluid_sample_streamer_t *sample_streamer; /**< Reads streamed samples in the background, NULL if synth.sample-streaming is off */
+    int voice_start_offset;            /**< Frames into the next block, at which voices started now begin */
 
     float gain;                        /**< master gain */
     fluid_channel_t **channel;         /**< the channels */
     int nvoice;                        /**< the length of the synthesis process array (max polyphony allowed) */
     fluid_voice_t **voice;             /**< the synthesis voices */
+    fluid_list_t *rvoice_slabs;        /**< fluid_rvoice_slab_t holding the rvoices of the voices */
     int active_voice_count;            /**< count of active voices */
+    fluid_ringbuffer_t *voice_activity; /**< voices started and stopped for fluid_synth_pop_voice_activity(), or NULL */
     unsigned int noteid;               /**< the id is incremented for every new note. it's used for noteoff's  */
     unsigned int storeid;
     int fromkey_portamento;			 /**< fromkey portamento */
     fluid_rvoice_eventhandler_t *eventhandler;
+    fluid_list_t *replaced_rates;      /**< fluid_rvoice_mixer_rate_t of sample-rate changes, holding the units to free once swapped in */
+    fluid_list_t *replaced_irs;        /**< fluid_rvoice_mixer_ir_t of convolution reverb changes, holding the convolvers to free once swapped in */
 
     double reverb_roomsize;             /**< Shadow of reverb roomsize */
     double reverb_damping;              /**< Shadow of reverb damping */
@@ -154,11 +202,41 @@ struct _fluid_synth_t
     int dither_index;		     /**< current index in random dither value buffer: fluid_synth_(write_s16|dither_s16) */
 
     fluid_atomic_float_t cpu_load;                    /**< CPU load in percent (CPU time required / audio synthesized time * 100) */
+    fluid_atomic_float_t dsp_load;                    /**< Unsmoothed CPU load of the latest rendering call */
+    fluid_atomic_float_t peak_dsp_load;               /**< Highest dsp_load */
+    fluid_atomic_float_t mixer_wait;                  /**< Percentage of the latest rendering call spent waiting for the mixer threads */
+    fluid_atomic_int_t render_calls;                  /**< Number of rendering calls */
+    fluid_atomic_int_t render_histogram[FLUID_SYNTH_RENDER_HISTOGRAM_SIZE]; /**< Number of rendering calls per 10 percent of dsp_load */
+    fluid_atomic_int_t peak_voices;                   /**< Highest number of voices rendered at once */
+    fluid_atomic_int_t stolen_voices;                 /**< Number of voices killed because the polyphony was exhausted */
+
+    fluid_atomic_int_t dynamic_polyphony;             /**< Adapt the number of voices allowed at once to cpu_load? */
+    fluid_atomic_float_t dynamic_polyphony_high;      /**< cpu_load above which voices are killed and voice_limit lowered */
+    fluid_atomic_float_t dynamic_polyphony_low;       /**< cpu_load below which voice_limit is raised again */
+    fluid_atomic_int_t voice_limit;                   /**< Number of voices allowed at once if less than polyphony, otherwise 0 */
+    int interp_degraded;                              /**< Are voices rendered with at most 4th order interpolation, because voice_limit is set? */
+
+    int interp_qos;                                   /**< Are quiet and released voices rendered with linear interpolation? */
+    double interp_qos_attenuation;                    /**< Attenuation in cB, above which a voice is quiet */
+    double interp_qos_release_time;                   /**< Time in msec after the release, after which a voice is rendered with linear interpolation */
+
+    int dsp_single_precision;                         /**< Are the voices interpolated in single precision? */
+
+    int coalesce_controllers;                         /**< Are the voices modulated once per block for the controllers changed meanwhile? */
+    fluid_atomic_int_t controllers_pending;           /**< Did controllers change, whose voices are yet to be modulated? */
 
     fluid_tuning_t ***tuning;          /**< 128 banks of 128 programs for the tunings */
     fluid_private_t tuning_iter;       /**< Tuning iterators per each thread */
+    fluid_pool_t *tuning_pool;         /**< Preallocated tunings */
 
     fluid_sample_timer_t *sample_timers; /**< List of timers triggered before a block is processed */
+    unsigned int sample_timers_due;      /**< Synth ticks at which the earliest of the timers is due */
+    fluid_atomic_int_t sample_timers_woken; /**< Has a timer been woken up since the last block? */
+
+    fluid_atomic_int_t clock_users;    /**< Count of the users of the clock, which is only followed for them */
+    unsigned int clock_ticks;          /**< Synth ticks when the clock was last followed by the rendering */
+    double clock_usec;                 /**< Time of clock_ticks by fluid_utime(), smoothed, 0 until followed */
+    double clock_usec_per_tick;        /**< Duration of a tick, tracking the drift of the audio device */
     unsigned int min_note_length_ticks; /**< If note-offs are triggered just after a note-on, they will be delayed */
 
     int cores;                         /**< Number of CPU cores (1 by default) */
@@ -206,6 +284,36 @@ int fluid_synth_set_chorus_full(fluid_synth_t *synth, int set, int nr, double le
 fluid_sample_timer_t *new_fluid_sample_timer(fluid_synth_t *synth, fluid_timer_callback_t callback, void *data);
 void delete_fluid_sample_timer(fluid_synth_t *synth, fluid_sample_timer_t *timer);
 void fluid_sample_timer_reset(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+void fluid_sample_timer_wakeup(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+void fluid_sample_timer_set_due(fluid_synth_t *synth, fluid_sample_timer_t *timer, unsigned int ticks);
+unsigned int fluid_sample_timer_get_ticks(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+
+/* Channel messages passed to fluid_synth_process_api_event(), and queued by the lock-free API */
+enum fluid_synth_api_event_type
+{
+    FLUID_API_EVENT_NOTEON,
+    FLUID_API_EVENT_NOTEOFF,
+    FLUID_API_EVENT_CC,
+    FLUID_API_EVENT_PITCH_BEND,
+    FLUID_API_EVENT_PROGRAM_CHANGE
+};
+
+void fluid_synth_api_enter(fluid_synth_t *synth);
+void fluid_synth_api_exit(fluid_synth_t *synth);
+int fluid_synth_process_api_event(fluid_synth_t *synth, int type, int chan,
+                                  int param1, int param2, int offset);
+
+int fluid_synth_noteon_offset(fluid_synth_t *synth, int chan, int key, int vel, int offset);
+int fluid_synth_handle_midi_event_offset(fluid_synth_t *synth, handle_midi_event_func_t handler, void *data,
+                                        fluid_midi_event_t *event, int offset);
+int fluid_synth_handle_midi_batch(fluid_synth_t *synth, handle_midi_event_func_t handler, void *data,
+                                  fluid_midi_event_t **events, int n);
+int fluid_synth_get_buffered_frames(fluid_synth_t *synth);
+int fluid_synth_skip_silence(fluid_synth_t *synth, int len);
+void fluid_synth_use_clock(fluid_synth_t *synth, int use);
+int fluid_synth_utime_to_offset(fluid_synth_t *synth, double usec);
+fluid_preset_t *fluid_synth_preload_program(fluid_synth_t *synth, int chan, int bank_msb, int bank_lsb, int prognum);
+void fluid_synth_release_preloaded_preset(fluid_synth_t *synth, fluid_preset_t *preset, int chan);
 
 void fluid_synth_process_event_queue(fluid_synth_t *synth);
 
@@ -217,6 +325,9 @@ int
 fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
                     int nout, float *out[], int (*block_render_func)(fluid_synth_t *, int));
 int
+fluid_synth_write_float_channels(fluid_synth_t *synth, int len, int nfx, float *fx[],
+                                 int nout, float *out[]);
+int
 fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
                         void *lout, int loff, int lincr,
                         void *rout, int roff, int rincr,
@@ -238,5 +349,18 @@ int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key, char M
 fluid_voice_t *
 fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel, fluid_zone_range_t *zone_range);
 
+/* The voices started by one noteon, added to the mixer with a single event */
+typedef struct _fluid_voice_batch_t
+{
+    fluid_voice_t *voices[MAX_EVENT_PARAMS];
+    fluid_rvoice_t *rvoices[MAX_EVENT_PARAMS]; /* the rvoices of the voices when they were started */
+    int count;
+} fluid_voice_batch_t;
+
+void fluid_synth_start_voice_batch_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice, fluid_voice_batch_t *batch);
+void fluid_synth_commit_voice_batch_LOCAL(fluid_synth_t *synth, fluid_voice_batch_t *batch);
+
 void fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan, int key);
+void fluid_synth_update_overflow_prio_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice);
+void fluid_synth_voice_activity_LOCAL(fluid_synth_t *synth, int type, int chan, int key, unsigned int id);
 #endif  /* _FLUID_SYNTH_H */
@@ -0,0 +1,571 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_synth.h"
+#include "fluid_midi.h"
+#include "fluid_settings.h"
+#include "fluid_sys.h"
+
+/*
+ * A synth cluster spreads the MIDI channels of a large multi-timbral setup
+ * over several synths, the engines. Each engine owns a contiguous range of
+ * channels, has its own event queue, mixer and effects, and renders on its
+ * own thread; the cluster sums their output. The engines load the same
+ * SoundFont files, the sample data of which are shared by the sample cache.
+ */
+
+/* frames rendered by all engines between two synchronizations */
+#define FLUID_CLUSTER_CHUNK 1024
+
+struct _fluid_synth_cluster_t;
+
+typedef struct
+{
+    struct _fluid_synth_cluster_t *cluster;
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_thread_t *thread;     /* NULL for the first engine, rendered by the calling thread */
+    float *left;
+    float *right;
+    int generation;             /* last chunk rendered */
+} fluid_cluster_engine_t;
+
+struct _fluid_synth_cluster_t
+{
+    int engine_count;
+    int channels_per_engine;
+    int midi_channels;
+    fluid_cluster_engine_t *engines;
+
+    fluid_cond_mutex_t *wakeup_m;
+    fluid_cond_t *wakeup;
+    fluid_cond_mutex_t *done_m;
+    fluid_cond_t *done;
+    int generation;             /* chunk to render, protected by wakeup_m */
+    int chunk_len;
+    fluid_atomic_int_t pending; /* engines still rendering the chunk */
+    fluid_atomic_int_t should_terminate;
+};
+
+static void
+fluid_cluster_copy_setting(void *data, const char *name, int type)
+{
+    fluid_settings_t *src = ((fluid_settings_t **)data)[0];
+    fluid_settings_t *dst = ((fluid_settings_t **)data)[1];
+    double num;
+    int ival;
+    char *str;
+
+    switch(type)
+    {
+    case FLUID_NUM_TYPE:
+        if(fluid_settings_getnum(src, name, &num) == FLUID_OK)
+        {
+            fluid_settings_setnum(dst, name, num);
+        }
+
+        break;
+
+    case FLUID_INT_TYPE:
+        if(fluid_settings_getint(src, name, &ival) == FLUID_OK)
+        {
+            fluid_settings_setint(dst, name, ival);
+        }
+
+        break;
+
+    case FLUID_STR_TYPE:
+        if(fluid_settings_dupstr(src, name, &str) == FLUID_OK && str != NULL)
+        {
+            fluid_settings_setstr(dst, name, str);
+            FLUID_FREE(str);
+        }
+
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+fluid_cluster_render_engine(fluid_cluster_engine_t *engine, int len)
+{
+    fluid_synth_write_float(engine->synth, len, engine->left, 0, 1, engine->right, 0, 1);
+}
+
+static fluid_thread_return_t
+fluid_cluster_thread_func(void *data)
+{
+    fluid_cluster_engine_t *engine = data;
+    fluid_synth_cluster_t *cluster = engine->cluster;
+    int len;
+
+    while(1)
+    {
+        fluid_cond_mutex_lock(cluster->wakeup_m);
+
+        while(engine->generation == cluster->generation
+                && !fluid_atomic_int_get(&cluster->should_terminate))
+        {
+            fluid_cond_wait(cluster->wakeup, cluster->wakeup_m);
+        }
+
+        engine->generation = cluster->generation;
+        len = cluster->chunk_len;
+        fluid_cond_mutex_unlock(cluster->wakeup_m);
+
+        if(fluid_atomic_int_get(&cluster->should_terminate))
+        {
+            break;
+        }
+
+        fluid_rt_enter();
+        fluid_cluster_render_engine(engine, len);
+        fluid_rt_exit();
+
+        if(fluid_atomic_int_dec_and_test(&cluster->pending))
+        {
+            fluid_cond_mutex_lock(cluster->done_m);
+            fluid_cond_signal(cluster->done);
+            fluid_cond_mutex_unlock(cluster->done_m);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Create a synth cluster, spreading the MIDI channels over several synths.
+ * @param settings Configuration parameters to use, each engine is created with a copy of them
+ * @param engines Number of synths to spread the channels over, each rendered on its own thread
+ * @return New synth cluster or NULL on error
+ *
+ * The cluster has <a href="fluidsettings.xml#synth.midi-channels">synth.midi-channels</a>
+ * channels in total, each engine owning a range of them rounded up to a multiple of 16.
+ * Changing the settings after creation does not affect the engines, use
+ * fluid_synth_cluster_get_engine() to configure them.
+ * @since 2.2.0
+ */
+fluid_synth_cluster_t *
+new_fluid_synth_cluster(fluid_settings_t *settings, int engines)
+{
+    fluid_synth_cluster_t *cluster;
+    fluid_settings_t *copy[2];
+    int i, prio_level = 0;
+
+    fluid_return_val_if_fail(settings != NULL, NULL);
+    fluid_return_val_if_fail(engines > 0, NULL);
+
+    cluster = FLUID_NEW(fluid_synth_cluster_t);
+
+    if(cluster == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(cluster, 0, sizeof(*cluster));
+
+    fluid_settings_getint(settings, "synth.midi-channels", &cluster->midi_channels);
+
+    if(engines > cluster->midi_channels / 16)
+    {
+        FLUID_LOG(FLUID_WARN, "Requested %d engines for %d MIDI channels, using %d",
+                  engines, cluster->midi_channels, cluster->midi_channels / 16);
+        engines = cluster->midi_channels / 16;
+    }
+
+    cluster->channels_per_engine = (cluster->midi_channels + engines - 1) / engines;
+    cluster->channels_per_engine = (cluster->channels_per_engine + 15) / 16 * 16;
+    cluster->engine_count = (cluster->midi_channels + cluster->channels_per_engine - 1)
+                            / cluster->channels_per_engine;
+
+    cluster->engines = FLUID_ARRAY(fluid_cluster_engine_t, cluster->engine_count);
+    cluster->wakeup_m = new_fluid_cond_mutex();
+    cluster->wakeup = new_fluid_cond();
+    cluster->done_m = new_fluid_cond_mutex();
+    cluster->done = new_fluid_cond();
+
+    if(cluster->engines == NULL || cluster->wakeup_m == NULL || cluster->wakeup == NULL
+            || cluster->done_m == NULL || cluster->done == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(cluster->engines, 0, cluster->engine_count * sizeof(fluid_cluster_engine_t));
+    fluid_settings_getint(settings, "audio.realtime-prio", &prio_level);
+
+    for(i = 0; i < cluster->engine_count; i++)
+    {
+        fluid_cluster_engine_t *engine = &cluster->engines[i];
+
+        engine->cluster = cluster;
+        engine->settings = new_fluid_settings();
+        engine->left = FLUID_ARRAY(float, FLUID_CLUSTER_CHUNK);
+        engine->right = FLUID_ARRAY(float, FLUID_CLUSTER_CHUNK);
+
+        if(engine->settings == NULL || engine->left == NULL || engine->right == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+
+        copy[0] = settings;
+        copy[1] = engine->settings;
+        fluid_settings_foreach(settings, copy, fluid_cluster_copy_setting);
+        fluid_settings_setint(engine->settings, "synth.midi-channels", cluster->channels_per_engine);
+
+        engine->synth = new_fluid_synth(engine->settings);
+
+        if(engine->synth == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
+    for(i = 1; i < cluster->engine_count; i++)
+    {
+        fluid_cluster_engine_t *engine = &cluster->engines[i];
+        char name[32];
+
+        FLUID_SNPRINTF(name, sizeof(name), "engine%d", i);
+        engine->thread = new_fluid_thread(name, fluid_cluster_thread_func, engine, prio_level, FALSE);
+
+        if(engine->thread == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
+    return cluster;
+
+error_recovery:
+    delete_fluid_synth_cluster(cluster);
+    return NULL;
+}
+
+/**
+ * Delete a synth cluster, along with its engines and their SoundFonts.
+ * @param cluster Synth cluster to delete
+ * @since 2.2.0
+ */
+void
+delete_fluid_synth_cluster(fluid_synth_cluster_t *cluster)
+{
+    int i;
+
+    fluid_return_if_fail(cluster != NULL);
+
+    if(cluster->engines != NULL)
+    {
+        fluid_cond_mutex_lock(cluster->wakeup_m);
+        fluid_atomic_int_set(&cluster->should_terminate, 1);
+        fluid_cond_broadcast(cluster->wakeup);
+        fluid_cond_mutex_unlock(cluster->wakeup_m);
+
+        for(i = 0; i < cluster->engine_count; i++)
+        {
+            fluid_cluster_engine_t *engine = &cluster->engines[i];
+
+            if(engine->thread != NULL)
+            {
+                fluid_thread_join(engine->thread);
+                delete_fluid_thread(engine->thread);
+            }
+        }
+
+        for(i = 0; i < cluster->engine_count; i++)
+        {
+            fluid_cluster_engine_t *engine = &cluster->engines[i];
+
+            delete_fluid_synth(engine->synth);
+            delete_fluid_settings(engine->settings);
+            FLUID_FREE(engine->left);
+            FLUID_FREE(engine->right);
+        }
+
+        FLUID_FREE(cluster->engines);
+    }
+
+    delete_fluid_cond(cluster->done);
+    delete_fluid_cond_mutex(cluster->done_m);
+    delete_fluid_cond(cluster->wakeup);
+    delete_fluid_cond_mutex(cluster->wakeup_m);
+    FLUID_FREE(cluster);
+}
+
+/**
+ * Get the number of engines of a synth cluster.
+ * @param cluster Synth cluster
+ * @return Number of engines, which may be less than requested if there were not enough channels
+ * @since 2.2.0
+ */
+int
+fluid_synth_cluster_count_engines(fluid_synth_cluster_t *cluster)
+{
+    fluid_return_val_if_fail(cluster != NULL, 0);
+    return cluster->engine_count;
+}
+
+/**
+ * Get an engine of a synth cluster.
+ * @param cluster Synth cluster
+ * @param index Index of the engine, from 0 to fluid_synth_cluster_count_engines() - 1
+ * @return The synth of the engine, owned by the cluster, or NULL on error
+ *
+ * The engine can be configured with the regular synth functions, but must not
+ * be rendered directly.
+ * @since 2.2.0
+ */
+fluid_synth_t *
+fluid_synth_cluster_get_engine(fluid_synth_cluster_t *cluster, int index)
+{
+    fluid_return_val_if_fail(cluster != NULL, NULL);
+    fluid_return_val_if_fail(index >= 0 && index < cluster->engine_count, NULL);
+
+    return cluster->engines[index].synth;
+}
+
+/**
+ * Get the engine owning a MIDI channel of a synth cluster.
+ * @param cluster Synth cluster
+ * @param chan MIDI channel number of the cluster (0 to MIDI channel count - 1)
+ * @param engine_chan Location to store the channel number within the engine
+ * @return The synth of the engine, owned by the cluster, or NULL on error
+ * @since 2.2.0
+ */
+fluid_synth_t *
+fluid_synth_cluster_get_channel_engine(fluid_synth_cluster_t *cluster, int chan, int *engine_chan)
+{
+    fluid_return_val_if_fail(cluster != NULL, NULL);
+    fluid_return_val_if_fail(chan >= 0 && chan < cluster->midi_channels, NULL);
+    fluid_return_val_if_fail(engine_chan != NULL, NULL);
+
+    *engine_chan = chan % cluster->channels_per_engine;
+    return cluster->engines[chan / cluster->channels_per_engine].synth;
+}
+
+/**
+ * Handle MIDI event from MIDI router, used as a callback function.
+ * @param data Synth cluster
+ * @param event MIDI event to handle
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Channel messages are passed to the engine owning their channel, system
+ * messages to all engines.
+ * @since 2.2.0
+ */
+int
+fluid_synth_cluster_handle_midi_event(void *data, fluid_midi_event_t *event)
+{
+    fluid_synth_cluster_t *cluster = data;
+    int type, chan, result, i;
+
+    fluid_return_val_if_fail(cluster != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(event != NULL, FLUID_FAILED);
+
+    type = fluid_midi_event_get_type(event);
+
+    if(type >= MIDI_SYSEX)
+    {
+        result = FLUID_OK;
+
+        for(i = 0; i < cluster->engine_count; i++)
+        {
+            if(fluid_synth_handle_midi_event(cluster->engines[i].synth, event) != FLUID_OK)
+            {
+                result = FLUID_FAILED;
+            }
+        }
+
+        return result;
+    }
+
+    chan = fluid_midi_event_get_channel(event);
+
+    if(chan < 0 || chan >= cluster->midi_channels)
+    {
+        return FLUID_FAILED;
+    }
+
+    // hand the event over with the channel of the engine, the caller keeps its own
+    fluid_midi_event_set_channel(event, chan % cluster->channels_per_engine);
+    result = fluid_synth_handle_midi_event(cluster->engines[chan / cluster->channels_per_engine].synth, event);
+    fluid_midi_event_set_channel(event, chan);
+
+    return result;
+}
+
+/**
+ * Load a SoundFont file into all engines of a synth cluster.
+ * @param cluster Synth cluster
+ * @param filename File to load
+ * @param reset_presets TRUE to re-assign presets for all MIDI channels
+ * @return SoundFont ID on success, #FLUID_FAILED on error
+ *
+ * The engines load the file in the same order, so that the SoundFont
+ * gets the same ID in all of them. The sample data are only loaded once and
+ * shared through the sample cache.
+ * @since 2.2.0
+ */
+int
+fluid_synth_cluster_sfload(fluid_synth_cluster_t *cluster, const char *filename, int reset_presets)
+{
+    int i, id = FLUID_FAILED;
+
+    fluid_return_val_if_fail(cluster != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
+
+    for(i = 0; i < cluster->engine_count; i++)
+    {
+        int engine_id = fluid_synth_sfload(cluster->engines[i].synth, filename, reset_presets);
+
+        if(engine_id == FLUID_FAILED || (i > 0 && engine_id != id))
+        {
+            if(engine_id != FLUID_FAILED)
+            {
+                fluid_synth_sfunload(cluster->engines[i].synth, engine_id, reset_presets);
+            }
+
+            FLUID_LOG(FLUID_ERR, "Failed to load SoundFont '%s' into engine %d", filename, i);
+
+            while(--i >= 0)
+            {
+                fluid_synth_sfunload(cluster->engines[i].synth, id, reset_presets);
+            }
+
+            return FLUID_FAILED;
+        }
+
+        id = engine_id;
+    }
+
+    return id;
+}
+
+/**
+ * Unload a SoundFont from all engines of a synth cluster.
+ * @param cluster Synth cluster
+ * @param id ID of the SoundFont, as returned by fluid_synth_cluster_sfload()
+ * @param reset_presets TRUE to re-assign presets for all MIDI channels
+ * @return #FLUID_OK on success, #FLUID_FAILED on error
+ * @since 2.2.0
+ */
+int
+fluid_synth_cluster_sfunload(fluid_synth_cluster_t *cluster, int id, int reset_presets)
+{
+    int i, result = FLUID_OK;
+
+    fluid_return_val_if_fail(cluster != NULL, FLUID_FAILED);
+
+    for(i = 0; i < cluster->engine_count; i++)
+    {
+        if(fluid_synth_sfunload(cluster->engines[i].synth, id, reset_presets) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Synthesize a block of floating point audio with all engines of a synth
+ * cluster, and sum their output.
+ * @param cluster Synth cluster
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of floats to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of floats to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The engines render concurrently, on the calling thread and on one extra
+ * thread for each of the other engines.
+ * @since 2.2.0
+ */
+int
+fluid_synth_cluster_write_float(fluid_synth_cluster_t *cluster, int len,
+                                void *lout, int loff, int lincr,
+                                void *rout, int roff, int rincr)
+{
+    float *left_out = lout;
+    float *right_out = rout;
+    int i, k, n;
+
+    fluid_return_val_if_fail(cluster != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(lout != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(rout != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+
+    for(; len > 0; len -= n)
+    {
+        n = (len < FLUID_CLUSTER_CHUNK) ? len : FLUID_CLUSTER_CHUNK;
+
+        if(cluster->engine_count > 1)
+        {
+            fluid_atomic_int_set(&cluster->pending, cluster->engine_count - 1);
+
+            fluid_cond_mutex_lock(cluster->wakeup_m);
+            cluster->chunk_len = n;
+            cluster->generation++;
+            fluid_cond_broadcast(cluster->wakeup);
+            fluid_cond_mutex_unlock(cluster->wakeup_m);
+        }
+
+        fluid_cluster_render_engine(&cluster->engines[0], n);
+
+        if(cluster->engine_count > 1)
+        {
+            fluid_cond_mutex_lock(cluster->done_m);
+
+            while(fluid_atomic_int_get(&cluster->pending) > 0)
+            {
+                fluid_cond_wait(cluster->done, cluster->done_m);
+            }
+
+            fluid_cond_mutex_unlock(cluster->done_m);
+        }
+
+        // sum stage
+        for(i = 0; i < n; i++)
+        {
+            float left = cluster->engines[0].left[i];
+            float right = cluster->engines[0].right[i];
+
+            for(k = 1; k < cluster->engine_count; k++)
+            {
+                left += cluster->engines[k].left[i];
+                right += cluster->engines[k].right[i];
+            }
+
+            left_out[loff] = left;
+            right_out[roff] = right;
+            loff += lincr;
+            roff += rincr;
+        }
+    }
+
+    return FLUID_OK;
+}
@@ -162,7 +162,7 @@
  * - In mono staccato playing,default_fromkey must be INVALID_NOTE.
  * - In mono legato playing,default_fromkey must be valid.
  */
-static char fluid_synth_get_fromkey_portamento_legato(fluid_channel_t *chan,
+static unsigned char fluid_synth_get_fromkey_portamento_legato(fluid_channel_t *chan,
         int default_fromkey)
 {
     unsigned char ptc = fluid_channel_get_cc(chan, PORTAMENTO_CTRL);
@@ -542,8 +542,7 @@ int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key,
                                  char Mono)
 {
     int status = FLUID_FAILED;
-    fluid_voice_t *voice;
-    int i;
+    fluid_voice_t *voice, *next;
     fluid_channel_t *channel = synth->channel[chan];
 
     /* Key_sustained is prepared to return no note sustained (INVALID_NOTE) */
@@ -553,13 +552,11 @@ int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key,
     }
 
     /* noteoff for all voices with same chan and same key */
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->key_voices[key]; voice != NULL; voice = next)
     {
-        voice = synth->voice[i];
+        next = voice->key_next;
 
-        if(fluid_voice_is_on(voice) &&
-                fluid_voice_get_channel(voice) == chan &&
-                fluid_voice_get_key(voice) == key)
+        if(fluid_voice_is_on(voice))
         {
             if(synth->verbose)
             {
@@ -654,21 +651,19 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
 {
     fluid_channel_t *channel = synth->channel[chan];
     enum fluid_channel_legato_mode legatomode = channel->legatomode;
-    fluid_voice_t *voice;
-    int i ;
+    fluid_voice_t *voice, *next;
     /* Gets possible 'fromkey portamento' and possible 'fromkey legato' note  */
     fromkey = fluid_synth_get_fromkey_portamento_legato(channel, fromkey);
 
     if(fluid_channel_is_valid_note(fromkey))
     {
-        for(i = 0; i < synth->polyphony; i++)
+        for(voice = channel->key_voices[fromkey]; voice != NULL; voice = next)
         {
-            /* searching fromkey voices: only those who don't have 'note off' */
-            voice = synth->voice[i];
+            /* searching fromkey voices: only those who don't have 'note off',
+               a voice moved to tokey leaves the list of fromkey */
+            next = voice->key_next;
 
-            if(fluid_voice_is_on(voice) &&
-                    fluid_voice_get_channel(voice) == chan &&
-                    fluid_voice_get_key(voice) == fromkey)
+            if(fluid_voice_is_on(voice))
             {
                 fluid_zone_range_t *zone_range = voice->zone_range;
 
@@ -23,12 +23,13 @@
 #include "fluid_sys.h"
 
 
-fluid_tuning_t *new_fluid_tuning(const char *name, int bank, int prog)
+/* Allocate a tuning from the pool if given, from the heap otherwise */
+static fluid_tuning_t *
+fluid_tuning_alloc(fluid_pool_t *pool)
 {
     fluid_tuning_t *tuning;
-    int i;
 
-    tuning = FLUID_NEW(fluid_tuning_t);
+    tuning = (pool != NULL) ? fluid_pool_alloc(pool) : FLUID_NEW(fluid_tuning_t);
 
     if(tuning == NULL)
     {
@@ -37,13 +38,25 @@ fluid_tuning_t *new_fluid_tuning(const char *name, int bank, int prog)
     }
 
     FLUID_MEMSET(tuning, 0, sizeof(fluid_tuning_t));
+    tuning->pool = pool;
+
+    return tuning;
+}
+
+fluid_tuning_t *new_fluid_tuning(const char *name, int bank, int prog, fluid_pool_t *pool)
+{
+    fluid_tuning_t *tuning;
+    int i;
 
-    if(fluid_tuning_set_name(tuning, name) != FLUID_OK)
+    tuning = fluid_tuning_alloc(pool);
+
+    if(tuning == NULL)
     {
-        delete_fluid_tuning(tuning);
         return NULL;
     }
 
+    fluid_tuning_set_name(tuning, name);
+
     tuning->bank = bank;
     tuning->prog = prog;
 
@@ -59,26 +72,19 @@ fluid_tuning_t *new_fluid_tuning(const char *name, int bank, int prog)
 
 /* Duplicate a tuning */
 fluid_tuning_t *
-fluid_tuning_duplicate(fluid_tuning_t *tuning)
+fluid_tuning_duplicate(fluid_tuning_t *tuning, fluid_pool_t *pool)
 {
     fluid_tuning_t *new_tuning;
     int i;
 
-    new_tuning = FLUID_NEW(fluid_tuning_t);
+    new_tuning = fluid_tuning_alloc(pool);
 
     if(!new_tuning)
     {
-        FLUID_LOG(FLUID_PANIC, "Out of memory");
         return NULL;
     }
 
-    FLUID_MEMSET(new_tuning, 0, sizeof(fluid_tuning_t));
-
-    if(fluid_tuning_set_name(new_tuning, tuning->name) != FLUID_OK)
-    {
-        delete_fluid_tuning(new_tuning);
-        return NULL;
-    }
+    fluid_tuning_set_name(new_tuning, tuning->name);
 
     new_tuning->bank = tuning->bank;
     new_tuning->prog = tuning->prog;
@@ -98,8 +104,14 @@ delete_fluid_tuning(fluid_tuning_t *tuning)
 {
     fluid_return_if_fail(tuning != NULL);
 
-    FLUID_FREE(tuning->name);
-    FLUID_FREE(tuning);
+    if(tuning->pool != NULL)
+    {
+        fluid_pool_free(tuning->pool, tuning);
+    }
+    else
+    {
+        FLUID_FREE(tuning);
+    }
 }
 
 /* Add a reference to a tuning object */
@@ -134,26 +146,9 @@ fluid_tuning_unref(fluid_tuning_t *tuning, int count)
     }
 }
 
-int fluid_tuning_set_name(fluid_tuning_t *tuning, const char *name)
+void fluid_tuning_set_name(fluid_tuning_t *tuning, const char *name)
 {
-    if(tuning->name != NULL)
-    {
-        FLUID_FREE(tuning->name);
-        tuning->name = NULL;
-    }
-
-    if(name != NULL)
-    {
-        tuning->name = FLUID_STRDUP(name);
-
-        if(tuning->name == NULL)
-        {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            return FLUID_FAILED;
-        }
-    }
-
-    return FLUID_OK;
+    FLUID_SNPRINTF(tuning->name, sizeof(tuning->name), "%s", (name != NULL) ? name : "");
 }
 
 char *fluid_tuning_get_name(fluid_tuning_t *tuning)
@@ -34,22 +34,26 @@
 
 #include "fluidsynth_priv.h"
 
+/* Size of the name of a tuning, including the terminating zero, longer names are truncated */
+#define FLUID_TUNING_NAME_SIZE 64
+
 struct _fluid_tuning_t
 {
-    char *name;
+    char name[FLUID_TUNING_NAME_SIZE];
     int bank;
     int prog;
     double pitch[128];  /* the pitch of every key, in cents */
     fluid_atomic_int_t refcount;         /* Tuning reference count */
+    fluid_pool_t *pool;                  /* Pool the tuning was taken from, NULL if allocated from the heap */
 };
 
-fluid_tuning_t *new_fluid_tuning(const char *name, int bank, int prog);
+fluid_tuning_t *new_fluid_tuning(const char *name, int bank, int prog, fluid_pool_t *pool);
 void delete_fluid_tuning(fluid_tuning_t *tuning);
-fluid_tuning_t *fluid_tuning_duplicate(fluid_tuning_t *tuning);
+fluid_tuning_t *fluid_tuning_duplicate(fluid_tuning_t *tuning, fluid_pool_t *pool);
 void fluid_tuning_ref(fluid_tuning_t *tuning);
 int fluid_tuning_unref(fluid_tuning_t *tuning, int count);
 
-int fluid_tuning_set_name(fluid_tuning_t *tuning, const char *name);
+void fluid_tuning_set_name(fluid_tuning_t *tuning, const char *name);
 char *fluid_tuning_get_name(fluid_tuning_t *tuning);
 
 #define fluid_tuning_get_bank(_t) ((_t)->bank)
@@ -45,25 +45,27 @@ static int calculate_hold_decay_buffers(fluid_voice_t *voice, int gen_base,
                                         int gen_key2base, int is_decay);
 static fluid_real_t
 fluid_voice_get_lower_boundary_for_attenuation(fluid_voice_t *voice);
+static void fluid_voice_overflow_prio_changed(fluid_voice_t *voice);
+static void fluid_voice_compile_mods(fluid_voice_t *voice);
 
 #define UPDATE_RVOICE0(proc) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, voice->rvoice, param); \
+      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, voice->rvoice, param, 0); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_R1(proc, obj, rarg) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
       param[0].real = rarg; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param, 1); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_I1(proc, obj, iarg) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
       param[0].i = iarg; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param, 1); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_I2(proc, obj, iarg1, iarg2) \
@@ -71,7 +73,7 @@ fluid_voice_get_lower_boundary_for_attenuation(fluid_voice_t *voice);
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
       param[0].i = iarg1; \
       param[1].i = iarg2; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param, 2); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_IR(proc, obj, iarg, rarg) \
@@ -79,7 +81,7 @@ fluid_voice_get_lower_boundary_for_attenuation(fluid_voice_t *voice);
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
       param[0].i = iarg; \
       param[1].real = rarg; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param, 2); \
   } while (0)
 
 
@@ -90,6 +92,24 @@ fluid_voice_get_lower_boundary_for_attenuation(fluid_voice_t *voice);
 #define UPDATE_RVOICE_ENVLFO_R1(proc, envp, rarg) UPDATE_RVOICE_GENERIC_R1(proc, &voice->rvoice->envlfo.envp, rarg)
 #define UPDATE_RVOICE_ENVLFO_I1(proc, envp, iarg) UPDATE_RVOICE_GENERIC_I1(proc, &voice->rvoice->envlfo.envp, iarg)
 
+/* Tell the rvoice the note played, if the synth publishes it with fluid_synth_get_voice_snapshot() */
+static void
+fluid_voice_update_note(fluid_voice_t *voice)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    if(!voice->channel->synth->with_voice_snapshot)
+    {
+        return;
+    }
+
+    param[0].i = voice->chan;
+    param[1].i = voice->key;
+    param[2].i = voice->vel;
+    param[3].i = (int)voice->id;
+    fluid_rvoice_eventhandler_push(voice->eventhandler, fluid_rvoice_set_note, voice->rvoice, param, 4);
+}
+
 static FLUID_INLINE void
 fluid_voice_update_volenv(fluid_voice_t *voice,
                           int enqueue,
@@ -114,7 +134,7 @@ fluid_voice_update_volenv(fluid_voice_t *voice,
         fluid_rvoice_eventhandler_push(voice->eventhandler,
                                        fluid_adsr_env_set_data,
                                        &voice->rvoice->envlfo.volenv,
-                                       param);
+                                       param, 6);
     }
     else
     {
@@ -146,7 +166,7 @@ fluid_voice_update_modenv(fluid_voice_t *voice,
         fluid_rvoice_eventhandler_push(voice->eventhandler,
                                        fluid_adsr_env_set_data,
                                        &voice->rvoice->envlfo.modenv,
-                                       param);
+                                       param, 6);
     }
     else
     {
@@ -207,11 +227,167 @@ static void fluid_voice_initialize_rvoice(fluid_voice_t *voice, fluid_real_t out
     fluid_rvoice_set_output_rate(voice->rvoice, param);
 }
 
+/*
+ * Adds the voice to the voices of its key on its channel
+ */
+static void fluid_voice_link_key(fluid_voice_t *voice)
+{
+    fluid_voice_t **head = &voice->channel->key_voices[voice->key];
+
+    voice->key_prev = NULL;
+    voice->key_next = *head;
+
+    if(*head != NULL)
+    {
+        (*head)->key_prev = voice;
+    }
+
+    *head = voice;
+}
+
+/*
+ * Removes the voice from the voices of its key on its channel
+ */
+static void fluid_voice_unlink_key(fluid_voice_t *voice)
+{
+    if(voice->key_prev != NULL)
+    {
+        voice->key_prev->key_next = voice->key_next;
+    }
+    else if(voice->channel->key_voices[voice->key] == voice)
+    {
+        voice->channel->key_voices[voice->key] = voice->key_next;
+    }
+    else
+    {
+        return; /* not linked */
+    }
+
+    if(voice->key_next != NULL)
+    {
+        voice->key_next->key_prev = voice->key_prev;
+    }
+
+    voice->key_prev = voice->key_next = NULL;
+}
+
+/*
+ * Adds the voice to the voices started with its exclusive class on its channel, if it has one
+ */
+void fluid_voice_link_excl(fluid_voice_t *voice)
+{
+    int excl_class = fluid_voice_gen_value(voice, GEN_EXCLUSIVECLASS);
+    fluid_voice_t **head;
+
+    if(excl_class == 0 || voice->excl_class != 0)
+    {
+        return;
+    }
+
+    head = &voice->channel->excl_voices[excl_class & 127];
+    voice->excl_prev = NULL;
+    voice->excl_next = *head;
+
+    if(*head != NULL)
+    {
+        (*head)->excl_prev = voice;
+    }
+
+    *head = voice;
+    voice->excl_class = excl_class;
+}
+
+/*
+ * Removes the voice from the voices started with its exclusive class, if it is linked with one
+ */
+static void fluid_voice_unlink_excl(fluid_voice_t *voice)
+{
+    if(voice->excl_class == 0)
+    {
+        return;
+    }
+
+    if(voice->excl_prev != NULL)
+    {
+        voice->excl_prev->excl_next = voice->excl_next;
+    }
+    else
+    {
+        voice->channel->excl_voices[voice->excl_class & 127] = voice->excl_next;
+    }
+
+    if(voice->excl_next != NULL)
+    {
+        voice->excl_next->excl_prev = voice->excl_prev;
+    }
+
+    voice->excl_prev = voice->excl_next = NULL;
+    voice->excl_class = 0;
+}
+
+/*
+ * Adds the voice to the voices playing on its channel
+ */
+static void fluid_voice_link_channel(fluid_voice_t *voice)
+{
+    fluid_channel_t *channel = voice->channel;
+
+    voice->chan_prev = NULL;
+    voice->chan_next = channel->voices;
+
+    if(channel->voices != NULL)
+    {
+        channel->voices->chan_prev = voice;
+    }
+
+    channel->voices = voice;
+    channel->voice_count++;
+    fluid_voice_link_key(voice);
+}
+
+/*
+ * Removes the voice from the voices playing on its channel, if it is one of them
+ */
+static void fluid_voice_unlink_channel(fluid_voice_t *voice)
+{
+    if(voice->channel == NULL)
+    {
+        return;
+    }
+
+    if(voice->chan_prev != NULL)
+    {
+        voice->chan_prev->chan_next = voice->chan_next;
+    }
+    else if(voice->channel->voices == voice)
+    {
+        voice->channel->voices = voice->chan_next;
+    }
+    else
+    {
+        return; /* not linked */
+    }
+
+    if(voice->chan_next != NULL)
+    {
+        voice->chan_next->chan_prev = voice->chan_prev;
+    }
+
+    voice->chan_prev = voice->chan_next = NULL;
+    voice->channel->voice_count--;
+    fluid_voice_unlink_key(voice);
+    fluid_voice_unlink_excl(voice);
+}
+
 /*
  * new_fluid_voice
+ *
+ * The rvoices are provided by the caller, usually from a fluid_rvoice_slab_t,
+ * and outlive the voice.
  */
 fluid_voice_t *
-new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate)
+new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate,
+                fluid_rvoice_t *rvoice, fluid_rvoice_t *overflow_rvoice)
 {
     fluid_voice_t *voice;
     voice = FLUID_NEW(fluid_voice_t);
@@ -225,22 +401,20 @@ new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate)
     voice->can_access_rvoice = TRUE;
     voice->can_access_overflow_rvoice = TRUE;
 
-    voice->rvoice = FLUID_NEW(fluid_rvoice_t);
-    voice->overflow_rvoice = FLUID_NEW(fluid_rvoice_t);
-
-    if(voice->rvoice == NULL || voice->overflow_rvoice == NULL)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        delete_fluid_voice(voice);
-        return NULL;
-    }
+    voice->rvoice = rvoice;
+    voice->overflow_rvoice = overflow_rvoice;
 
     voice->status = FLUID_VOICE_CLEAN;
+    voice->overflow_heap_index = -1;
     voice->chan = NO_CHANNEL;
     voice->key = 0;
     voice->vel = 0;
     voice->eventhandler = handler;
     voice->channel = NULL;
+    voice->chan_prev = voice->chan_next = NULL;
+    voice->key_prev = voice->key_next = NULL;
+    voice->excl_prev = voice->excl_next = NULL;
+    voice->excl_class = 0;
     voice->sample = NULL;
     voice->output_rate = output_rate;
 
@@ -265,8 +439,6 @@ delete_fluid_voice(fluid_voice_t *voice)
         FLUID_LOG(FLUID_WARN, "Deleting voice %u which has locked rvoices!", voice->id);
     }
 
-    FLUID_FREE(voice->overflow_rvoice);
-    FLUID_FREE(voice->rvoice);
     FLUID_FREE(voice);
 }
 
@@ -310,16 +482,31 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
         fluid_voice_off(voice);
     }
 
+    /* A voice killed to start a new one is counted again when it is started */
+    if(fluid_voice_is_playing(voice))
+    {
+        voice->status = FLUID_VOICE_CLEAN;
+        voice->channel->synth->active_voice_count--;
+        fluid_synth_voice_activity_LOCAL(voice->channel->synth, FLUID_VOICE_ACTIVITY_STOP,
+                                         voice->chan, voice->key, voice->id);
+    }
+
+    fluid_voice_unlink_channel(voice);
+
     voice->zone_range = inst_zone_range; /* Instrument zone range for legato */
     voice->id = id;
     voice->chan = fluid_channel_get_num(channel);
     voice->key = (unsigned char) key;
     voice->vel = (unsigned char) vel;
     voice->channel = channel;
+    fluid_voice_link_channel(voice);
     voice->mod_count = 0;
+    voice->mod_dest_count = -1;
     voice->start_time = start_time;
     voice->has_noteoff = 0;
-    UPDATE_RVOICE0(fluid_rvoice_reset);
+    UPDATE_RVOICE_I1(fluid_rvoice_reset, voice->chan);
+
+    fluid_voice_update_note(voice);
 
     /* Increment the reference count of the sample to prevent the
        unloading of the soundfont while this voice is playing,
@@ -330,7 +517,43 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     voice->sample = sample;
 
     i = fluid_channel_get_interp_method(channel);
+
+    /* the synth is overloaded, see fluid_synth_update_voice_limit() */
+    if(i > FLUID_INTERP_4THORDER && channel->synth->interp_degraded)
+    {
+        i = FLUID_INTERP_4THORDER;
+    }
+
     UPDATE_RVOICE_I1(fluid_rvoice_set_interp_method, i);
+    UPDATE_RVOICE_I1(fluid_rvoice_set_dsp_precision, channel->synth->dsp_single_precision);
+
+    if(channel->synth->interp_qos)
+    {
+        fluid_synth_t *synth = channel->synth;
+        fluid_real_t blocks = synth->interp_qos_release_time * voice->output_rate / (1000 * FLUID_BUFSIZE);
+
+        UPDATE_RVOICE_GENERIC_IR(fluid_rvoice_set_interp_qos, voice->rvoice, (int)blocks,
+                                 fluid_cb2amp(synth->interp_qos_attenuation));
+    }
+    else
+    {
+        UPDATE_RVOICE_GENERIC_IR(fluid_rvoice_set_interp_qos, voice->rvoice, -1, 0);
+    }
+
+#ifdef WITH_PROFILING
+    /* the rendering time of the voice is charged to the preset it is started from */
+    i = -1;
+
+    if(channel->preset != NULL)
+    {
+        fluid_preset_t *preset = channel->preset;
+        i = fluid_profile_preset_index(fluid_sfont_get_id(fluid_preset_get_sfont(preset)),
+                                       fluid_preset_get_banknum(preset), fluid_preset_get_num(preset),
+                                       fluid_preset_get_name(preset));
+    }
+
+    UPDATE_RVOICE_I1(fluid_rvoice_set_profile_index, i);
+#endif
 
     /* Set all the generators to their default value, according to SF
      * 2.01 section 8.1.3 (page 48). The value of NRPN messages are
@@ -361,6 +584,8 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_buffers_set_mapping, &voice->rvoice->buffers, 0, i);
     UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_buffers_set_mapping, &voice->rvoice->buffers, 1, i + 1);
 
+    fluid_voice_overflow_prio_changed(voice);
+
     return FLUID_OK;
 }
 
@@ -450,6 +675,129 @@ void fluid_voice_start(fluid_voice_t *voice)
 
     /* Increment voice count */
     voice->channel->synth->active_voice_count++;
+    fluid_synth_voice_activity_LOCAL(voice->channel->synth, FLUID_VOICE_ACTIVITY_START,
+                                     voice->chan, voice->key, voice->id);
+
+    fluid_voice_overflow_prio_changed(voice);
+}
+
+/*
+ * Save the note and the generators and modulators of a playing voice, from which
+ * a voice playing the same sample is started again by fluid_voice_load_state().
+ */
+void fluid_voice_save_state(const fluid_voice_t *voice, fluid_voice_state_t *state)
+{
+    int i;
+
+    FLUID_MEMSET(state, 0, sizeof(*state));
+    state->id = voice->id;
+    state->start_time = voice->start_time;
+    state->status = voice->status;
+    state->chan = voice->chan;
+    state->key = voice->key;
+    state->vel = voice->vel;
+    state->has_noteoff = voice->has_noteoff;
+    state->mod_count = voice->mod_count;
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        state->mod[i].dest = voice->mod[i].dest;
+        state->mod[i].src1 = voice->mod[i].src1;
+        state->mod[i].flags1 = voice->mod[i].flags1;
+        state->mod[i].src2 = voice->mod[i].src2;
+        state->mod[i].flags2 = voice->mod[i].flags2;
+        state->mod[i].amount = voice->mod[i].amount;
+    }
+
+    FLUID_MEMCPY(state->gen, voice->gen, sizeof(state->gen));
+}
+
+/*
+ * Check the note, the status and the modulators of a saved voice, before a voice
+ * is started from it. Returns FLUID_OK if they are valid, FLUID_FAILED otherwise.
+ */
+int fluid_voice_check_state(const fluid_voice_state_t *state)
+{
+    static const int key_gens[] = { GEN_KEYNUM, GEN_VELOCITY, GEN_OVERRIDEROOTKEY };
+    unsigned int i;
+
+    if(state->key > 127 || state->vel > 127
+            || (state->status != FLUID_VOICE_ON && state->status != FLUID_VOICE_SUSTAINED
+                && state->status != FLUID_VOICE_HELD_BY_SOSTENUTO && state->status != FLUID_VOICE_OFF)
+            || state->mod_count < 0 || state->mod_count > FLUID_NUM_MOD)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < (unsigned int)state->mod_count; i++)
+    {
+        /* the sources index the controllers of the channel */
+        if(state->mod[i].dest >= GEN_LAST || state->mod[i].src1 > 127 || state->mod[i].src2 > 127)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    /* the generators standing for a key index the tunings, -1 if not set */
+    for(i = 0; i < FLUID_N_ELEMENTS(key_gens); i++)
+    {
+        float x = state->gen[key_gens[i]].val + state->gen[key_gens[i]].nrpn;
+
+        if(!(x >= -1 && x <= 127))
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Replace the generators and modulators of a voice initialized for the note of a
+ * state saved by fluid_voice_save_state() and checked by fluid_voice_check_state(),
+ * before the voice is started. The modulation is calculated again by fluid_voice_start().
+ */
+void fluid_voice_load_state(fluid_voice_t *voice, const fluid_voice_state_t *state)
+{
+    int i;
+
+    voice->id = state->id;
+    voice->start_time = state->start_time;
+    voice->mod_count = state->mod_count;
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        voice->mod[i].dest = state->mod[i].dest;
+        voice->mod[i].src1 = state->mod[i].src1;
+        voice->mod[i].flags1 = state->mod[i].flags1;
+        voice->mod[i].src2 = state->mod[i].src2;
+        voice->mod[i].flags2 = state->mod[i].flags2;
+        voice->mod[i].amount = state->mod[i].amount;
+        voice->mod[i].next = NULL;
+    }
+
+    FLUID_MEMCPY(voice->gen, state->gen, sizeof(voice->gen));
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        voice->gen[i].mod = 0;
+    }
+
+    /* the sample mode isn't recalculated by fluid_voice_start(), only passed on by fluid_voice_gen_set() */
+    UPDATE_RVOICE_I1(fluid_rvoice_set_samplemode, _SAMPLEMODE(voice));
+
+    voice->mod_dest_count = -1;
+}
+
+/*
+ * Put a voice started from a saved state back into the status it was saved in:
+ * released, sustained or held by the sostenuto pedal.
+ */
+void fluid_voice_resume_state(fluid_voice_t *voice, const fluid_voice_state_t *state)
+{
+    voice->status = state->status;
+    voice->has_noteoff = state->has_noteoff;
+    fluid_voice_overflow_prio_changed(voice);
 }
 
 /**
@@ -598,6 +946,8 @@ fluid_voice_calculate_runtime_synthesis_parameters(fluid_voice_t *voice)
      * fluid_gen_init().
      */
 
+    fluid_voice_compile_mods(voice);
+
     for(i = 0; i < voice->mod_count; i++)
     {
         fluid_mod_t *mod = &voice->mod[i];
@@ -776,6 +1126,7 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
          * OHPiano.SF2 sets initial attenuation to a whooping -96 dB */
         fluid_clip(voice->attenuation, 0.f, 1440.f);
         UPDATE_RVOICE_R1(fluid_rvoice_set_attenuation, voice->attenuation);
+        fluid_voice_overflow_prio_changed(voice);
         break;
 
     /* The pitch is calculated from three different generators.
@@ -1152,83 +1503,157 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
  * iteration of the audio cycle (which would probably be feasible if
  * the synth was made in silicon).
  *
- * The update is done in two steps:
+ * The modulators are compiled once, when the voice starts, into the list
+ * of their distinct destinations, with the modulators of each destination
+ * chained, and the list of their distinct sources, each with a bit for every
+ * destination it feeds (see fluid_voice_compile_mods()).
  *
- * - step 1: first, we look for all the modulators that have the changed
- * controller as a source. This will yield a generator that will be changed
- * because of the controller event.
+ * The update is then done in two steps:
  *
- * - step 2: For this generator, calculate its new value. This is the
- * sum of its original value plus the values of all the attached modulators.
- * The generator flag is set to indicate the parameters must be updated.
- * This avoid the risk to call 'fluid_voice_update_param' several
- * times for the same generator if several modulators have that generator as
- * destination. So every changed generators are updated only once.
+ * - step 1: first, we look up the changed controller among the sources.
+ * This yields the generators that will be changed because of the controller
+ * event, each of them once, regardless of how many of its modulators have
+ * the controller as source.
+ *
+ * - step 2: For each of these generators, calculate its new value. This is the
+ * sum of its original value plus the values of all the attached modulators,
+ * found through the chain of the destination. Then 'fluid_voice_update_param'
+ * is called once for the generator.
  */
 
- /* bit table for each generator being updated. The bits are packed in variables
-  Each variable have NBR_BIT_BY_VAR bits represented by NBR_BIT_BY_VAR_LN2.
-  The size of the table is the number of variables: SIZE_UPDATED_GEN_BIT.
- 
-  Note: In this implementation NBR_BIT_BY_VAR_LN2 is set to 5 (convenient for 32 bits cpu)
-  but this could be set to 6 for 64 bits cpu.
- */
+#define is_mod_dest_set(bits, d)  ((bits)[(d) >> 5] & (1u << ((d) & 31)))
+#define set_mod_dest(bits, d)     ((bits)[(d) >> 5] |= (1u << ((d) & 31)))
 
-#define NBR_BIT_BY_VAR_LN2 5	/* for 32 bits variables */
-#define NBR_BIT_BY_VAR  (1 << NBR_BIT_BY_VAR_LN2)
-#define NBR_BIT_BY_VAR_ANDMASK (NBR_BIT_BY_VAR - 1)
-#define	SIZE_UPDATED_GEN_BIT  ((GEN_LAST + NBR_BIT_BY_VAR_ANDMASK) / NBR_BIT_BY_VAR)
+/* Adds destination d to the destinations fed by a source of a modulator */
+static void
+fluid_voice_add_mod_src(fluid_voice_t *voice, unsigned char src, unsigned char flags, int d)
+{
+    unsigned char is_cc = (flags & FLUID_MOD_CC) != 0;
+    fluid_voice_mod_src_t *mod_src;
+    int i;
 
-#define is_gen_updated(bit,gen)  (bit[gen >> NBR_BIT_BY_VAR_LN2] &  (1 << (gen & NBR_BIT_BY_VAR_ANDMASK)))
-#define set_gen_updated(bit,gen) (bit[gen >> NBR_BIT_BY_VAR_LN2] |= (1 << (gen & NBR_BIT_BY_VAR_ANDMASK)))
+    for(i = 0; i < voice->mod_src_count; i++)
+    {
+        mod_src = &voice->mod_src[i];
 
-int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl)
+        if(mod_src->src == src && mod_src->is_cc == is_cc)
+        {
+            set_mod_dest(mod_src->dests, d);
+            return;
+        }
+    }
+
+    mod_src = &voice->mod_src[voice->mod_src_count++];
+    mod_src->src = src;
+    mod_src->is_cc = is_cc;
+    FLUID_MEMSET(mod_src->dests, 0, sizeof(mod_src->dests));
+    set_mod_dest(mod_src->dests, d);
+}
+
+/* Compiles the modulators of the voice into the lookup tables used by fluid_voice_modulate() */
+static void
+fluid_voice_compile_mods(fluid_voice_t *voice)
 {
-    int i, k;
-    fluid_mod_t *mod;
-    uint32_t gen;
-    fluid_real_t modval;
+    signed char dest_of_gen[GEN_LAST];
+    unsigned char last[FLUID_NUM_MOD];
+    int i, d;
 
-    /* Clears registered bits table of updated generators */
-    uint32_t updated_gen_bit[SIZE_UPDATED_GEN_BIT] = {0};
+    FLUID_MEMSET(dest_of_gen, -1, sizeof(dest_of_gen));
+    voice->mod_dest_count = 0;
+    voice->mod_src_count = 0;
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        fluid_mod_t *mod = &voice->mod[i];
+
+        d = dest_of_gen[mod->dest];
+
+        if(d < 0)
+        {
+            d = voice->mod_dest_count++;
+            dest_of_gen[mod->dest] = d;
+            voice->mod_dest[d] = mod->dest;
+            voice->mod_dest_first[d] = i;
+        }
+        else
+        {
+            voice->mod_next[last[d]] = i;
+        }
+
+        last[d] = i;
+        voice->mod_next[i] = FLUID_NUM_MOD;
+
+        fluid_voice_add_mod_src(voice, mod->src1, mod->flags1, d);
+        fluid_voice_add_mod_src(voice, mod->src2, mod->flags2, d);
+    }
+}
+
+/* Recalculates the modulation of the generator of destination d from all of its modulators */
+static void
+fluid_voice_modulate_dest(fluid_voice_t *voice, int d)
+{
+    int gen = voice->mod_dest[d];
+    fluid_real_t modval = 0.0;
+    int k;
+
+    for(k = voice->mod_dest_first[d]; k < FLUID_NUM_MOD; k = voice->mod_next[k])
+    {
+        modval += fluid_mod_get_value(&voice->mod[k], voice);
+    }
+
+    fluid_gen_set_mod(&voice->gen[gen], modval);
+
+    /* now recalculate the parameter values that are derived from the
+       generator */
+    fluid_voice_update_param(voice, gen);
+}
+
+int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl)
+{
+    const fluid_voice_mod_src_t *mod_src = NULL;
+    unsigned char is_cc = (cc != 0);
+    int i, d;
 
     /*    printf("Chan=%d, CC=%d, Src=%d, Val=%d\n", voice->channel->channum, cc, ctrl, val); */
 
-    for(i = 0; i < voice->mod_count; i++)
+    if(voice->mod_dest_count < 0)
     {
-        mod = &voice->mod[i];
+        fluid_voice_compile_mods(voice);
+    }
 
-        /* step 1: find all the modulators that have the changed controller
-           as input source. When ctrl is -1 all modulators destination
-           are updated */
-        if(ctrl < 0 || fluid_mod_has_source(mod, cc, ctrl))
+    /* When ctrl is -1 all modulators destination are updated */
+    if(ctrl < 0)
+    {
+        for(d = 0; d < voice->mod_dest_count; d++)
         {
-            gen = fluid_mod_get_dest(mod);
+            fluid_voice_modulate_dest(voice, d);
+        }
 
-            /* Skip if this generator has already been updated */
-            if(!is_gen_updated(updated_gen_bit, gen))
-            {
-                modval = 0.0;
-
-                /* step 2: for every attached modulator, calculate the modulation
-                 * value for the generator gen */
-                for(k = 0; k < voice->mod_count; k++)
-                {
-                    if(fluid_mod_has_dest(&voice->mod[k], gen))
-                    {
-                        modval += fluid_mod_get_value(&voice->mod[k], voice);
-                    }
-                }
-
-                fluid_gen_set_mod(&voice->gen[gen], modval);
-
-                /* now recalculate the parameter values that are derived from the
-                   generator */
-                fluid_voice_update_param(voice, gen);
-
-                /* set the bit that indicates this generator is updated */
-                set_gen_updated(updated_gen_bit, gen);
-            }
+        return FLUID_OK;
+    }
+
+    /* step 1: find the destinations of the modulators that have the changed
+       controller as input source */
+    for(i = 0; i < voice->mod_src_count; i++)
+    {
+        if(voice->mod_src[i].src == ctrl && voice->mod_src[i].is_cc == is_cc)
+        {
+            mod_src = &voice->mod_src[i];
+            break;
+        }
+    }
+
+    if(mod_src == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    /* step 2: recalculate each of them */
+    for(d = 0; d < voice->mod_dest_count; d++)
+    {
+        if(is_mod_dest_set(mod_src->dests, d))
+        {
+            fluid_voice_modulate_dest(voice, d);
         }
     }
 
@@ -1290,8 +1715,11 @@ void fluid_voice_update_portamento(fluid_voice_t *voice, int fromkey, int tokey)
 void fluid_voice_update_multi_retrigger_attack(fluid_voice_t *voice,
         int tokey, int vel)
 {
+    fluid_voice_unlink_key(voice);
     voice->key = tokey;  /* new note */
+    fluid_voice_link_key(voice);
     voice->vel = vel; /* new velocity */
+    fluid_voice_update_note(voice);
     /* Updates generators dependent of velocity */
     /* Modulates GEN_ATTENUATION (and others ) before calling
        fluid_rvoice_multi_retrigger_attack().*/
@@ -1325,6 +1753,7 @@ fluid_voice_release(fluid_voice_t *voice)
     unsigned int at_tick = fluid_channel_get_min_note_length_ticks(voice->channel);
     UPDATE_RVOICE_I1(fluid_rvoice_noteoff, at_tick);
     voice->has_noteoff = 1; // voice is marked as noteoff occurred
+    fluid_voice_overflow_prio_changed(voice);
 }
 
 /*
@@ -1348,11 +1777,13 @@ fluid_voice_noteoff(fluid_voice_t *voice)
     {
         // Sostenuto depressed after note
         voice->status = FLUID_VOICE_HELD_BY_SOSTENUTO;
+        fluid_voice_overflow_prio_changed(voice);
     }
     /* Or sustain a note under Sustain pedal */
     else if(fluid_channel_sustained(channel))
     {
         voice->status = FLUID_VOICE_SUSTAINED;
+        fluid_voice_overflow_prio_changed(voice);
     }
     /* Or force the voice to release stage */
     else
@@ -1361,6 +1792,76 @@ fluid_voice_noteoff(fluid_voice_t *voice)
     }
 }
 
+/*
+ * Whether two voices started by the same noteon play both samples of a stereo
+ * pair in the same way, so that they can be rendered with a shared phase,
+ * envelopes and LFOs (see fluid_rvoice_write_stereo()). Their samples must be
+ * laid out alike and all their generators and modulators must be the same,
+ * except for those only feeding their own filters and output buffers.
+ */
+int
+fluid_voice_is_stereo_pair(const fluid_voice_t *voice, const fluid_voice_t *other)
+{
+    const fluid_sample_t *sample = voice->sample;
+    const fluid_sample_t *other_sample = other->sample;
+    int i;
+
+    if(sample == NULL || other_sample == NULL
+            || !((sample->sampletype & FLUID_SAMPLETYPE_LEFT && other_sample->sampletype & FLUID_SAMPLETYPE_RIGHT)
+                 || (sample->sampletype & FLUID_SAMPLETYPE_RIGHT && other_sample->sampletype & FLUID_SAMPLETYPE_LEFT))
+            || sample->samplerate != other_sample->samplerate
+            || sample->origpitch != other_sample->origpitch
+            || sample->pitchadj != other_sample->pitchadj
+            || sample->end - sample->start != other_sample->end - other_sample->start
+            || sample->loopstart - sample->start != other_sample->loopstart - other_sample->start
+            || sample->loopend - sample->start != other_sample->loopend - other_sample->start)
+    {
+        return FALSE;
+    }
+
+    if(voice->chan != other->chan || voice->key != other->key || voice->vel != other->vel
+            || voice->mod_count != other->mod_count)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        switch(i)
+        {
+        case GEN_PAN:
+        case GEN_CUSTOM_BALANCE:
+        case GEN_CHORUSSEND:
+        case GEN_REVERBSEND:
+        case GEN_FILTERFC:
+        case GEN_FILTERQ:
+        case GEN_CUSTOM_FILTERFC:
+        case GEN_CUSTOM_FILTERQ:
+        case GEN_SAMPLEID:
+            continue;
+
+        default:
+            if(voice->gen[i].val != other->gen[i].val
+                    || voice->gen[i].mod != other->gen[i].mod
+                    || voice->gen[i].nrpn != other->gen[i].nrpn)
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        if(!fluid_mod_test_identity(&voice->mod[i], &other->mod[i])
+                || voice->mod[i].amount != other->mod[i].amount)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 /*
  * fluid_voice_kill_excl
  *
@@ -1388,6 +1889,7 @@ fluid_voice_kill_excl(fluid_voice_t *voice)
        so that it doesn't get killed twice
     */
     fluid_voice_gen_set(voice, GEN_EXCLUSIVECLASS, 0);
+    fluid_voice_unlink_excl(voice);
 
     /* Speed up the volume envelope */
     /* The value was found through listening tests with hi-hat samples. */
@@ -1412,6 +1914,7 @@ void fluid_voice_overflow_rvoice_finished(fluid_voice_t *voice)
 {
     voice->can_access_overflow_rvoice = 1;
     fluid_voice_sample_unref(&voice->overflow_rvoice->dsp.sample);
+    fluid_voice_overflow_prio_changed(voice);
 }
 
 /*
@@ -1435,8 +1938,11 @@ void fluid_voice_off(fluid_voice_t *voice)
 void
 fluid_voice_stop(fluid_voice_t *voice)
 {
+    int chan = voice->chan;
+
     fluid_profile(FLUID_PROF_VOICE_RELEASE, voice->ref, 0, 0);
 
+    fluid_voice_unlink_channel(voice);
     voice->chan = NO_CHANNEL;
 
     if(voice->can_access_rvoice)
@@ -1452,6 +1958,10 @@ fluid_voice_stop(fluid_voice_t *voice)
 
     /* Decrement voice count */
     voice->channel->synth->active_voice_count--;
+    fluid_synth_voice_activity_LOCAL(voice->channel->synth, FLUID_VOICE_ACTIVITY_STOP,
+                                     chan, voice->key, voice->id);
+
+    fluid_voice_overflow_prio_changed(voice);
 }
 
 /**
@@ -1534,6 +2044,7 @@ fluid_voice_add_mod_local(fluid_voice_t *voice, fluid_mod_t *mod, int mode, int
     if(voice->mod_count < FLUID_NUM_MOD)
     {
         fluid_mod_clone(&voice->mod[voice->mod_count++], mod);
+        voice->mod_dest_count = -1; /* compiled again when needed */
     }
     else
     {
@@ -1787,6 +2298,14 @@ int fluid_voice_set_param(fluid_voice_t *voice, int gen, fluid_real_t nrpn_value
     return FLUID_OK;
 }
 
+/*
+ * Change the interpolation method of a voice, which may be playing already.
+ */
+void fluid_voice_set_interp_method(fluid_voice_t *voice, int method)
+{
+    UPDATE_RVOICE_I1(fluid_rvoice_set_interp_method, method);
+}
+
 int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain)
 {
     fluid_real_t left, right, reverb, chorus;
@@ -1814,6 +2333,48 @@ int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain)
     return FLUID_OK;
 }
 
+/*
+ * Determine the lowest and highest values of the sample data between start and end,
+ * the same as fluid_rvoice_get_sample() would return them. The loops are kept
+ * branchless, so that the compiler turns them into vectorized min/max reductions.
+ */
+static void
+fluid_voice_scan_sample_peak(const short *FLUID_RESTRICT data, const char *FLUID_RESTRICT data24,
+                             unsigned int start, unsigned int end,
+                             int32_t *peak_min, int32_t *peak_max)
+{
+    int32_t lo = 0, hi = 0;
+    unsigned int i;
+
+    if(data24 == NULL)
+    {
+        /* 16 bit samples: find the limits on the raw data and scale them afterwards */
+        short lo16 = 0, hi16 = 0;
+
+        for(i = start; i < end; i++)
+        {
+            short val = data[i];
+            lo16 = (val < lo16) ? val : lo16;
+            hi16 = (val > hi16) ? val : hi16;
+        }
+
+        lo = (int32_t)((uint32_t)lo16 << 8);
+        hi = (int32_t)((uint32_t)hi16 << 8);
+    }
+    else
+    {
+        for(i = start; i < end; i++)
+        {
+            int32_t val = (int32_t)(((uint32_t)data[i] << 8) | (uint8_t)data24[i]);
+            lo = (val < lo) ? val : lo;
+            hi = (val > hi) ? val : hi;
+        }
+    }
+
+    *peak_min = lo;
+    *peak_max = hi;
+}
+
 /* - Scan the loop
  * - determine the peak level
  * - Calculate, what factor will make the loop inaudible
@@ -1838,7 +2399,6 @@ fluid_voice_optimize_sample(fluid_sample_t *s)
     int32_t peak;
     fluid_real_t normalized_amplitude_during_loop;
     double result;
-    unsigned int i;
 
     /* ignore disabled samples */
     if(s->start == s->end)
@@ -1849,19 +2409,7 @@ fluid_voice_optimize_sample(fluid_sample_t *s)
     if(!s->amplitude_that_reaches_noise_floor_is_valid)    /* Only once */
     {
         /* Scan the loop */
-        for(i = s->loopstart; i < s->loopend; i++)
-        {
-            int32_t val = fluid_rvoice_get_sample(s->data, s->data24, i);
-
-            if(val > peak_max)
-            {
-                peak_max = val;
-            }
-            else if(val < peak_min)
-            {
-                peak_min = val;
-            }
-        }
+        fluid_voice_scan_sample_peak(s->data, s->data24, s->loopstart, s->loopend, &peak_min, &peak_max);
 
         /* Determine the peak level */
         if(peak_max > -peak_min)
@@ -1901,20 +2449,19 @@ fluid_voice_optimize_sample(fluid_sample_t *s)
     return FLUID_OK;
 }
 
+/*
+ * Get the part of the overflow priority of a voice, which doesn't change
+ * while the voice is playing, unless the voice changes its state (noteoff,
+ * sustain, attenuation) or the overflow scores are changed. The complete
+ * priority is this value plus fluid_voice_get_overflow_prio_age().
+ */
 float
-fluid_voice_get_overflow_prio(fluid_voice_t *voice,
-                              fluid_overflow_prio_t *score,
-                              unsigned int cur_time)
+fluid_voice_get_overflow_prio_base(const fluid_voice_t *voice,
+                                   const fluid_overflow_prio_t *score)
 {
     float this_voice_prio = 0;
     int channel;
 
-    /* Are we already overflowing? */
-    if(!voice->can_access_overflow_rvoice)
-    {
-        return OVERFLOW_PRIO_CANNOT_KILL;
-    }
-
     /* Is this voice on the drum channel?
      * Then it is very important.
      * Also skip the released and sustained scores.
@@ -1939,21 +2486,6 @@ fluid_voice_get_overflow_prio(fluid_voice_t *voice,
         this_voice_prio += score->sustained;
     }
 
-    /* We are not enthusiastic about releasing voices, which have just been started.
-     * Otherwise hitting a chord may result in killing notes belonging to that very same
-     * chord. So give newer voices a higher score. */
-    if(score->age)
-    {
-        cur_time -= voice->start_time;
-
-        if(cur_time < 1)
-        {
-            cur_time = 1; // Avoid div by zero
-        }
-
-        this_voice_prio += (score->age * voice->output_rate) / cur_time;
-    }
-
     /* take a rough estimate of loudness into account. Louder voices are more important. */
     if(score->volume)
     {
@@ -1984,6 +2516,46 @@ fluid_voice_get_overflow_prio(fluid_voice_t *voice,
     return this_voice_prio;
 }
 
+/*
+ * Get the part of the overflow priority of a voice depending on its age.
+ * It has the sign of the age score, which may be negative, and shrinks
+ * towards zero as the voice gets older.
+ */
+float
+fluid_voice_get_overflow_prio_age(const fluid_voice_t *voice,
+                                  const fluid_overflow_prio_t *score,
+                                  unsigned int cur_time)
+{
+    /* We are not enthusiastic about releasing voices, which have just been started.
+     * Otherwise hitting a chord may result in killing notes belonging to that very same
+     * chord. So give newer voices a higher score. */
+    if(score->age)
+    {
+        cur_time -= voice->start_time;
+
+        if(cur_time < 1)
+        {
+            cur_time = 1; // Avoid div by zero
+        }
+
+        return (score->age * voice->output_rate) / cur_time;
+    }
+
+    return 0;
+}
+
+/*
+ * Let the synth know that the overflow priority of a voice may have changed.
+ */
+static void
+fluid_voice_overflow_prio_changed(fluid_voice_t *voice)
+{
+    if(voice->channel != NULL)
+    {
+        fluid_synth_update_overflow_prio_LOCAL(voice->channel->synth, voice);
+    }
+}
+
 
 void fluid_voice_set_custom_filter(fluid_voice_t *voice, enum fluid_iir_filter_type type, enum fluid_iir_filter_flags flags)
 {
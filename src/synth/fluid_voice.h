@@ -57,6 +57,16 @@ enum fluid_voice_status
 };
 
 
+/*
+ * A source of the modulators of a voice, with a bit for each destination it feeds
+ */
+typedef struct
+{
+    unsigned char src;
+    unsigned char is_cc;
+    uint32_t dests[FLUID_NUM_MOD / 32];
+} fluid_voice_mod_src_t;
+
 /*
  * fluid_voice_t
  */
@@ -76,6 +86,15 @@ struct _fluid_voice_t
     unsigned int start_time;
     int mod_count;
     fluid_mod_t mod[FLUID_NUM_MOD];
+
+    /* the modulators compiled for fluid_voice_modulate(): the generators they modulate,
+     * with the modulators of each one chained by index, and their distinct sources */
+    int mod_dest_count;                           /* -1 when the modulators need compiling */
+    unsigned char mod_dest[FLUID_NUM_MOD];        /* generator of each destination */
+    unsigned char mod_dest_first[FLUID_NUM_MOD];  /* first modulator of each destination */
+    unsigned char mod_next[FLUID_NUM_MOD];        /* next modulator of the same destination, FLUID_NUM_MOD at the end */
+    int mod_src_count;
+    fluid_voice_mod_src_t mod_src[2 * FLUID_NUM_MOD];
     fluid_gen_t gen[GEN_LAST];
 
     /* basic parameters */
@@ -108,6 +127,16 @@ struct _fluid_voice_t
     char can_access_overflow_rvoice; /* False if overflow_rvoice is being rendered in separate thread */
     char has_noteoff; /* Flag set when noteoff has been sent */
 
+    /* voice stealing */
+    float overflow_prio;             /* overflow priority without the age dependent part, see fluid_voice_get_overflow_prio_base() */
+    int overflow_heap_index;         /* position in the synth's overflow heap, -1 if not in the heap */
+
+    /* the lists of the voices on the same channel, and on the same key of it, see fluid_channel_t */
+    fluid_voice_t *chan_prev, *chan_next;
+    fluid_voice_t *key_prev, *key_next;
+    fluid_voice_t *excl_prev, *excl_next;
+    int excl_class;                  /* the exclusive class the voice is linked with, 0 if none */
+
 #ifdef WITH_PROFILING
     /* for debugging */
     double ref;
@@ -115,10 +144,41 @@ struct _fluid_voice_t
 };
 
 
-fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate);
+/*
+ * The part of a voice saved by fluid_synth_save_state(), the rest of it is
+ * calculated again when the voice is started from it, see fluid_voice_load_state()
+ */
+typedef struct
+{
+    unsigned int id;
+    unsigned int start_time;
+    unsigned char status;
+    unsigned char chan;
+    unsigned char key;
+    unsigned char vel;
+    char has_noteoff;
+    int mod_count;
+    struct
+    {
+        unsigned char dest;
+        unsigned char src1;
+        unsigned char flags1;
+        unsigned char src2;
+        unsigned char flags2;
+        double amount;
+    } mod[FLUID_NUM_MOD];
+    fluid_gen_t gen[GEN_LAST];
+} fluid_voice_state_t;
+
+fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate,
+                                fluid_rvoice_t *rvoice, fluid_rvoice_t *overflow_rvoice);
 void delete_fluid_voice(fluid_voice_t *voice);
 
 void fluid_voice_start(fluid_voice_t *voice);
+void fluid_voice_save_state(const fluid_voice_t *voice, fluid_voice_state_t *state);
+int fluid_voice_check_state(const fluid_voice_state_t *state);
+void fluid_voice_load_state(fluid_voice_t *voice, const fluid_voice_state_t *state);
+void fluid_voice_resume_state(fluid_voice_t *voice, const fluid_voice_state_t *state);
 void  fluid_voice_calculate_gen_pitch(fluid_voice_t *voice);
 
 int fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
@@ -135,6 +195,7 @@ int fluid_voice_set_param(fluid_voice_t *voice, int gen, fluid_real_t value);
 
 /** Set the gain. */
 int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain);
+void fluid_voice_set_interp_method(fluid_voice_t *voice, int method);
 
 void fluid_voice_set_output_rate(fluid_voice_t *voice, fluid_real_t value);
 
@@ -159,10 +220,14 @@ void fluid_voice_stop(fluid_voice_t *voice);
 void fluid_voice_add_mod_local(fluid_voice_t *voice, fluid_mod_t *mod, int mode, int check_limit_count);
 void fluid_voice_overflow_rvoice_finished(fluid_voice_t *voice);
 
+void fluid_voice_link_excl(fluid_voice_t *voice);
 int fluid_voice_kill_excl(fluid_voice_t *voice);
-float fluid_voice_get_overflow_prio(fluid_voice_t *voice,
-                                    fluid_overflow_prio_t *score,
-                                    unsigned int cur_time);
+int fluid_voice_is_stereo_pair(const fluid_voice_t *voice, const fluid_voice_t *other);
+float fluid_voice_get_overflow_prio_base(const fluid_voice_t *voice,
+                                         const fluid_overflow_prio_t *score);
+float fluid_voice_get_overflow_prio_age(const fluid_voice_t *voice,
+                                        const fluid_overflow_prio_t *score,
+                                        unsigned int cur_time);
 
 #define OVERFLOW_PRIO_CANNOT_KILL 999999.
 
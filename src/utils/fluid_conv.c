@@ -20,7 +20,12 @@
 
 #include "fluid_conv.h"
 #include "fluid_sys.h"
+
+#ifdef ENABLE_RUNTIME_TABLES
+#include "gentables/gen_conv.c"
+#else
 #include "fluid_conv_tables.c"
+#endif
 
 /*
  * Converts absolute cents to Hertz
@@ -76,6 +81,28 @@ fluid_ct2hz_real(fluid_real_t cents)
     }
 }
 
+/*
+ * Converts several absolute cents values to Hertz in place, the same as
+ * calling fluid_ct2hz_real() for each of them.
+ */
+void
+fluid_ct2hz_real_batch(fluid_real_t *cents, int count)
+{
+    int i;
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        /* the table lookup is done for all elements, so that there is nothing to branch on */
+        fluid_real_t c = cents[i];
+        unsigned int icents = (unsigned int)((c < 0) ? 0 : c) + 300u;
+        unsigned int mult = 1u << ((icents / 1200u) & (sizeof(mult) * 8u - 1u));
+        fluid_real_t val = mult * fluid_ct2hz_tab[icents % 1200u];
+
+        cents[i] = (c < 0) ? (fluid_real_t) 1.0 : val;
+    }
+}
+
 /*
  * fluid_ct2hz
  */
@@ -124,6 +151,27 @@ fluid_cb2amp(fluid_real_t cb)
     return fluid_cb2amp_tab[(int) cb];
 }
 
+/*
+ * Converts several attenuations in centibels to amplitudes in place, the same
+ * as calling fluid_cb2amp() for each of them.
+ */
+void
+fluid_cb2amp_batch(fluid_real_t *cb, int count)
+{
+    int i;
+
+    #pragma omp simd
+    for(i = 0; i < count; i++)
+    {
+        /* the table index is clamped, so that there is nothing to branch on */
+        fluid_real_t c = cb[i];
+        int index = (c < 0) ? 0 : ((c >= FLUID_CB_AMP_SIZE) ? FLUID_CB_AMP_SIZE - 1 : (int) c);
+        fluid_real_t val = fluid_cb2amp_tab[index];
+
+        cb[i] = (c >= FLUID_CB_AMP_SIZE) ? (fluid_real_t) 0.0 : val;
+    }
+}
+
 /*
  * fluid_tc2sec_delay
  */
@@ -223,18 +271,55 @@ fluid_tc2sec_release(fluid_real_t tc)
  * fluid_act2hz
  *
  * Convert from absolute cents to Hertz
- * 
- * The inverse operation, converting from Hertz to cents, was unused and implemented as
+ */
+fluid_real_t
+fluid_act2hz(fluid_real_t c)
+{
+    return 8.176f * FLUID_POW(2.f, c / 1200.f);
+}
+
+/*
+ * fluid_hz2ct
  *
+ * Convert from Hertz to absolute cents, the inverse of fluid_act2hz()
+ */
+fluid_real_t
 fluid_hz2ct(fluid_real_t f)
 {
-    return 6900.f + (1200.f / FLUID_M_LN2) * FLUID_LOGF(f / 440.0f));
+    return 6900.f + (1200.f / FLUID_M_LN2) * FLUID_LOGF(f / 440.0f);
 }
+
+/*
+ * fluid_nct2trig
+ *
+ * in: a frequency in cents relative to the sample rate, i.e. fluid_hz2ct(f) - fluid_hz2ct(sample rate)
+ * out: sin(omega) and 1 - cos(omega) of the angular frequency omega = 2 * PI * f / sample rate,
+ * interpolated between the FLUID_FILTER_NCT_STEP cents of the table
  */
-fluid_real_t
-fluid_act2hz(fluid_real_t c)
+void
+fluid_nct2trig(fluid_real_t nct, fluid_real_t *sin_omega, fluid_real_t *omc_omega)
 {
-    return 8.176f * FLUID_POW(2.f, c / 1200.f);
+    fluid_real_t pos = (nct - FLUID_FILTER_NCT_MIN) * (1.f / FLUID_FILTER_NCT_STEP);
+    int i;
+
+    if(pos <= 0.f)
+    {
+        i = 0;
+        pos = 0.f;
+    }
+    else if(pos >= FLUID_FILTER_TRIG_SIZE - 1)
+    {
+        i = FLUID_FILTER_TRIG_SIZE - 2;
+        pos = 1.f;
+    }
+    else
+    {
+        i = (int)pos;
+        pos -= i;
+    }
+
+    *sin_omega = fluid_filter_sin_tab[i] + pos * (fluid_filter_sin_tab[i + 1] - fluid_filter_sin_tab[i]);
+    *omc_omega = fluid_filter_omc_tab[i] + pos * (fluid_filter_omc_tab[i + 1] - fluid_filter_omc_tab[i]);
 }
 
 /*
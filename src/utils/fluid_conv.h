@@ -24,14 +24,22 @@
 #include "fluidsynth_priv.h"
 #include "utils/fluid_conv_tables.h"
 
+#ifdef ENABLE_RUNTIME_TABLES
+void fluid_conversion_config(void);
+#endif
+
 fluid_real_t fluid_ct2hz_real(fluid_real_t cents);
+void fluid_ct2hz_real_batch(fluid_real_t *cents, int count);
 fluid_real_t fluid_ct2hz(fluid_real_t cents);
 fluid_real_t fluid_cb2amp(fluid_real_t cb);
+void fluid_cb2amp_batch(fluid_real_t *cb, int count);
 fluid_real_t fluid_tc2sec(fluid_real_t tc);
 fluid_real_t fluid_tc2sec_delay(fluid_real_t tc);
 fluid_real_t fluid_tc2sec_attack(fluid_real_t tc);
 fluid_real_t fluid_tc2sec_release(fluid_real_t tc);
 fluid_real_t fluid_act2hz(fluid_real_t c);
+fluid_real_t fluid_hz2ct(fluid_real_t f);
+void fluid_nct2trig(fluid_real_t nct, fluid_real_t *sin_omega, fluid_real_t *omc_omega);
 fluid_real_t fluid_pan(fluid_real_t c, int left);
 fluid_real_t fluid_balance(fluid_real_t balance, int left);
 fluid_real_t fluid_concave(fluid_real_t val);
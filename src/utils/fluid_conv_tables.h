@@ -38,4 +38,11 @@
 #define FLUID_CB_AMP_SIZE       1441
 #define FLUID_PAN_SIZE          1002
 
+/* The sine and the cosine of the filter cutoff frequencies, looked up in steps of
+ * FLUID_FILTER_NCT_STEP cents relative to the sample rate, from FLUID_FILTER_NCT_MIN
+ * (5 Hz at 116 kHz) up to the Nyquist frequency (-1200 cents) */
+#define FLUID_FILTER_NCT_MIN    -17400
+#define FLUID_FILTER_NCT_STEP   4
+#define FLUID_FILTER_TRIG_SIZE  ((-1200 - FLUID_FILTER_NCT_MIN) / FLUID_FILTER_NCT_STEP + 1)
+
 #endif
@@ -36,216 +36,131 @@
 #include "fluid_list.h"
 
 
-#define HASH_TABLE_MIN_SIZE 11
-#define HASH_TABLE_MAX_SIZE 13845163
+#define HASH_TABLE_MIN_BITS 3
+#define HASH_TABLE_MAX_BITS 30
+
+/* Marks of the slots without an entry in the hashes array. The hashes of the
+ * keys are mapped to values above them. */
+#define UNUSED_HASH_VALUE 0
+#define TOMBSTONE_HASH_VALUE 1
+#define HASH_IS_REAL(h_) ((h_) >= 2)
 
 
 typedef struct
 {
     fluid_hashtable_t *hashtable;
-    fluid_hashnode_t *prev_node;
-    fluid_hashnode_t *node;
     int position;
-    int pre_advanced;	// Boolean
-    int version;
 } RealIter;
 
 
-/* Excerpt from glib gprimes.c */
-
-static const unsigned int primes[] =
-{
-    11,
-    19,
-    37,
-    73,
-    109,
-    163,
-    251,
-    367,
-    557,
-    823,
-    1237,
-    1861,
-    2777,
-    4177,
-    6247,
-    9371,
-    14057,
-    21089,
-    31627,
-    47431,
-    71143,
-    106721,
-    160073,
-    240101,
-    360163,
-    540217,
-    810343,
-    1215497,
-    1823231,
-    2734867,
-    4102283,
-    6153409,
-    9230113,
-    13845163,
-};
-
-static const unsigned int nprimes = FLUID_N_ELEMENTS(primes);
-
-static unsigned int
-spaced_primes_closest(unsigned int num)
+/*
+ * @hash: the hash value of a key
+ * @bits: log2 of the table size
+ * Return value: the slot to start probing at
+ *
+ * Multiplies the hash by the golden ratio and keeps the highest bits, so
+ * that keys whose hashes only differ in their high bits (pointers for
+ * fluid_direct_hash() for example) still get spread over the table.
+ */
+static FLUID_INLINE unsigned int
+fluid_hashtable_hash_to_index(unsigned int hash, int bits)
 {
-    unsigned int i;
-
-    for(i = 0; i < nprimes; i++)
-    {
-        if(primes[i] > num)
-        {
-            return primes[i];
-        }
-    }
-
-    return primes[nprimes - 1];
+    return (unsigned int)((uint32_t)(hash * 2654435769U) >> (32 - bits));
 }
 
-/* End excerpt from glib gprimes.c */
-
-
 /*
  * @hashtable: our #fluid_hashtable_t
  * @key: the key to lookup against
- * @hash_return: optional key hash return location
- * Return value: a pointer to the described #fluid_hashnode_t pointer
+ * @hash_return: key hash return location
+ * Return value: the index of the slot holding @key, or of the slot to insert it to
  *
  * Performs a lookup in the hash table.  Virtually all hash operations
  * will use this function internally.
  *
  * This function first computes the hash value of the key using the
- * user's hash function.
+ * user's hash function, then probes the slots linearly from the one
+ * the hash maps to, until finding an unused slot.
  *
  * If an entry in the table matching @key is found then this function
- * returns a pointer to the pointer to that entry in the table.  In
- * the case that the entry is at the head of a chain, this pointer
- * will be an item in the nodes[] array.  In the case that the entry
- * is not at the head of a chain, this pointer will be the ->next
- * pointer on the node that precedes it.
- *
- * In the case that no matching entry exists in the table, a pointer
- * to a %NULL pointer will be returned.  To insert a item, this %NULL
- * pointer should be updated to point to the new #fluid_hashnode_t.
- *
- * If @hash_return is a pass-by-reference parameter.  If it is
- * non-%NULL then the computed hash value is returned.  This is to
- * save insertions from having to compute the hash record again for
- * the new record.
+ * returns the index of its slot, which then holds a real hash value.
+ * Otherwise it returns the index of the first tombstone passed, or of
+ * the unused slot that ended the search, where @key can be inserted.
+ *
+ * As the full hash values are compared first, the key equality function
+ * is only called for the slots very likely to match.
  */
-static FLUID_INLINE fluid_hashnode_t **
+static FLUID_INLINE int
 fluid_hashtable_lookup_node(fluid_hashtable_t *hashtable, const void *key,
                             unsigned int *hash_return)
 {
-    fluid_hashnode_t **node_ptr, *node;
-    unsigned int hash_value;
+    unsigned int mask = hashtable->size - 1;
+    unsigned int hash_value, node_hash, index;
+    int first_tombstone = -1;
 
     hash_value = (* hashtable->hash_func)(key);
-    node_ptr = &hashtable->nodes[hash_value % hashtable->size];
 
-    if(hash_return)
+    if(!HASH_IS_REAL(hash_value))
     {
-        *hash_return = hash_value;
+        hash_value = 2;
     }
 
-    /* Hash table lookup needs to be fast.
-     *  We therefore remove the extra conditional of testing
-     *  whether to call the key_equal_func or not from
-     *  the inner loop.
-     *
-     *  Additional optimisation: first check if our full hash
-     *  values are equal so we can avoid calling the full-blown
-     *  key equality function in most cases.
-     */
-    if(hashtable->key_equal_func)
+    *hash_return = hash_value;
+    index = fluid_hashtable_hash_to_index(hash_value, hashtable->bits);
+
+    /* There is always at least one unused slot, which ends the probing */
+    while((node_hash = hashtable->hashes[index]) != UNUSED_HASH_VALUE)
     {
-        while((node = *node_ptr))
+        if(node_hash == hash_value)
         {
-            if(node->key_hash == hash_value &&
-                    hashtable->key_equal_func(node->key, key))
+            void *node_key = hashtable->keys[index];
+
+            if(hashtable->key_equal_func ? hashtable->key_equal_func(node_key, key) : node_key == key)
             {
-                break;
+                return index;
             }
-
-            node_ptr = &(*node_ptr)->next;
         }
-    }
-    else
-    {
-        while((node = *node_ptr))
+        else if(node_hash == TOMBSTONE_HASH_VALUE && first_tombstone < 0)
         {
-            if(node->key == key)
-            {
-                break;
-            }
-
-            node_ptr = &(*node_ptr)->next;
+            first_tombstone = index;
         }
+
+        index = (index + 1) & mask;
     }
 
-    return node_ptr;
+    return (first_tombstone >= 0) ? first_tombstone : (int)index;
 }
 
 /*
  * @hashtable: our #fluid_hashtable_t
- * @node_ptr_ptr: a pointer to the return value from
- *   fluid_hashtable_lookup_node()
+ * @index: the slot of the node to remove
  * @notify: %TRUE if the destroy notify handlers are to be called
  *
- * Removes a node from the hash table and updates the node count.  The
- * node is freed.  No table resize is performed.
+ * Removes a node from the hash table, leaving a tombstone in its slot so
+ * that the probing sequences of the other keys aren't interrupted.
  *
  * If @notify is %TRUE then the destroy notify functions are called
  * for the key and value of the hash node.
- *
- * @node_ptr_ptr is a pass-by-reference in/out parameter.  When the
- * function is called, it should point to the pointer to the node to
- * remove.  This level of indirection is required so that the pointer
- * may be updated appropriately once the node has been removed.
- *
- * Before the function returns, the pointer at @node_ptr_ptr will be
- * updated to point to the position in the table that contains the
- * pointer to the "next" node in the chain.  This makes this function
- * convenient to use from functions that iterate over the entire
- * table.  If there is no further item in the chain then the
- * #fluid_hashnode_t pointer will be %NULL (ie: **node_ptr_ptr == %NULL).
- *
- * Since the pointer in the table to the removed node is replaced with
- * either a pointer to the next node or a %NULL pointer as
- * appropriate, the pointer at the end of @node_ptr_ptr will never be
- * modified at all.  Stay tuned. :)
  */
 static void
-fluid_hashtable_remove_node(fluid_hashtable_t *hashtable,
-                            fluid_hashnode_t  ***node_ptr_ptr, int notify)
+fluid_hashtable_remove_node(fluid_hashtable_t *hashtable, int index, int notify)
 {
-    fluid_hashnode_t **node_ptr, *node;
-
-    node_ptr = *node_ptr_ptr;
-    node = *node_ptr;
+    void *key = hashtable->keys[index];
+    void *value = hashtable->values[index];
 
-    *node_ptr = node->next;
+    hashtable->hashes[index] = TOMBSTONE_HASH_VALUE;
+    hashtable->keys[index] = NULL;
+    hashtable->values[index] = NULL;
+    hashtable->nnodes--;
 
     if(notify && hashtable->key_destroy_func)
     {
-        hashtable->key_destroy_func(node->key);
+        hashtable->key_destroy_func(key);
     }
 
     if(notify && hashtable->value_destroy_func)
     {
-        hashtable->value_destroy_func(node->value);
+        hashtable->value_destroy_func(value);
     }
-
-    FLUID_FREE(node);
-
-    hashtable->nnodes--;
 }
 
 /*
@@ -262,18 +177,54 @@ fluid_hashtable_remove_node(fluid_hashtable_t *hashtable,
 static void
 fluid_hashtable_remove_all_nodes(fluid_hashtable_t *hashtable, int notify)
 {
-    fluid_hashnode_t **node_ptr;
     int i;
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node_ptr = &hashtable->nodes[i]; *node_ptr != NULL;)
+        if(HASH_IS_REAL(hashtable->hashes[i]))
         {
-            fluid_hashtable_remove_node(hashtable, &node_ptr, notify);
+            fluid_hashtable_remove_node(hashtable, i, notify);
         }
+
+        hashtable->hashes[i] = UNUSED_HASH_VALUE;
     }
 
     hashtable->nnodes = 0;
+    hashtable->noccupied = 0;
+}
+
+/*
+ * @hashtable: our #fluid_hashtable_t
+ * @bits: log2 of the number of slots
+ * Return value: %TRUE on success, %FALSE if out of memory
+ *
+ * Allocates the slots of the table, all unused.
+ */
+static int
+fluid_hashtable_alloc_nodes(fluid_hashtable_t *hashtable, int bits)
+{
+    int size = 1 << bits;
+
+    hashtable->hashes = FLUID_ARRAY(unsigned int, size);
+    hashtable->keys = FLUID_ARRAY(void *, size);
+    hashtable->values = FLUID_ARRAY(void *, size);
+
+    if(hashtable->hashes == NULL || hashtable->keys == NULL || hashtable->values == NULL)
+    {
+        FLUID_FREE(hashtable->hashes);
+        FLUID_FREE(hashtable->keys);
+        FLUID_FREE(hashtable->values);
+        return FALSE;
+    }
+
+    FLUID_MEMSET(hashtable->hashes, 0, size * sizeof(*hashtable->hashes));
+    FLUID_MEMSET(hashtable->keys, 0, size * sizeof(*hashtable->keys));
+    FLUID_MEMSET(hashtable->values, 0, size * sizeof(*hashtable->values));
+
+    hashtable->size = size;
+    hashtable->bits = bits;
+
+    return TRUE;
 }
 
 /*
@@ -281,50 +232,64 @@ fluid_hashtable_remove_all_nodes(fluid_hashtable_t *hashtable, int notify)
  * @hashtable: our #fluid_hashtable_t
  *
  * Resizes the hash table to the optimal size based on the number of
- * nodes currently held.  If you call this function then a resize will
- * occur, even if one does not need to occur.  Use
- * fluid_hashtable_maybe_resize() instead.
+ * nodes currently held, dropping all tombstones.  If you call this
+ * function then a resize will occur, even if one does not need to
+ * occur.  Use fluid_hashtable_maybe_resize() instead.
  */
 static void
 fluid_hashtable_resize(fluid_hashtable_t *hashtable)
 {
-    fluid_hashnode_t **new_nodes;
-    fluid_hashnode_t *node;
-    fluid_hashnode_t *next;
-    unsigned int hash_val;
-    int new_size;
-    int i;
-
-    new_size = spaced_primes_closest(hashtable->nnodes);
-    new_size = (new_size < HASH_TABLE_MIN_SIZE) ? HASH_TABLE_MIN_SIZE :
-               ((new_size > HASH_TABLE_MAX_SIZE) ? HASH_TABLE_MAX_SIZE : new_size);
-
-    new_nodes = FLUID_ARRAY(fluid_hashnode_t *, new_size);
+    unsigned int *old_hashes = hashtable->hashes;
+    void **old_keys = hashtable->keys;
+    void **old_values = hashtable->values;
+    int old_size = hashtable->size;
+    int old_bits = hashtable->bits;
+    unsigned int mask, index;
+    int bits, i;
+
+    /* at most half full afterwards */
+    for(bits = HASH_TABLE_MIN_BITS; bits < HASH_TABLE_MAX_BITS && (1 << (bits - 1)) < hashtable->nnodes; bits++)
+    {
+    }
 
-    if(!new_nodes)
+    if(!fluid_hashtable_alloc_nodes(hashtable, bits))
     {
         FLUID_LOG(FLUID_ERR, "Out of memory");
+        hashtable->hashes = old_hashes;
+        hashtable->keys = old_keys;
+        hashtable->values = old_values;
+        hashtable->size = old_size;
+        hashtable->bits = old_bits;
         return;
     }
 
-    FLUID_MEMSET(new_nodes, 0, new_size * sizeof(fluid_hashnode_t *));
+    mask = hashtable->size - 1;
 
-    for(i = 0; i < hashtable->size; i++)
+    for(i = 0; i < old_size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = next)
+        if(!HASH_IS_REAL(old_hashes[i]))
         {
-            next = node->next;
+            continue;
+        }
 
-            hash_val = node->key_hash % new_size;
+        /* the keys are all distinct, only look for a free slot */
+        index = fluid_hashtable_hash_to_index(old_hashes[i], bits);
 
-            node->next = new_nodes[hash_val];
-            new_nodes[hash_val] = node;
+        while(hashtable->hashes[index] != UNUSED_HASH_VALUE)
+        {
+            index = (index + 1) & mask;
         }
+
+        hashtable->hashes[index] = old_hashes[i];
+        hashtable->keys[index] = old_keys[i];
+        hashtable->values[index] = old_values[i];
     }
 
-    FLUID_FREE(hashtable->nodes);
-    hashtable->nodes = new_nodes;
-    hashtable->size = new_size;
+    hashtable->noccupied = hashtable->nnodes;
+
+    FLUID_FREE(old_hashes);
+    FLUID_FREE(old_keys);
+    FLUID_FREE(old_values);
 }
 
 /*
@@ -334,21 +299,22 @@ fluid_hashtable_resize(fluid_hashtable_t *hashtable)
  * Resizes the hash table, if needed.
  *
  * Essentially, calls fluid_hashtable_resize() if the table has strayed
- * too far from its ideal size for its number of nodes.
+ * too far from its ideal size for its number of nodes, or if the
+ * tombstones left by removed nodes start making lookups slow.
  */
 static FLUID_INLINE void
 fluid_hashtable_maybe_resize(fluid_hashtable_t *hashtable)
 {
-    int nnodes = hashtable->nnodes;
     int size = hashtable->size;
 
-    if((size >= 3 * nnodes && size > HASH_TABLE_MIN_SIZE) ||
-            (3 * size <= nnodes && size < HASH_TABLE_MAX_SIZE))
+    if((hashtable->nnodes * 8 < size && hashtable->bits > HASH_TABLE_MIN_BITS) ||
+            (hashtable->noccupied * 4 >= size * 3))
     {
         fluid_hashtable_resize(hashtable);
     }
 }
 
+
 /**
  * new_fluid_hashtable:
  * @hash_func: a function to create a hash value from a key.
@@ -407,21 +373,21 @@ new_fluid_hashtable_full(fluid_hash_func_t hash_func,
         return NULL;
     }
 
-    hashtable->size               = HASH_TABLE_MIN_SIZE;
     hashtable->nnodes             = 0;
+    hashtable->noccupied          = 0;
     hashtable->hash_func          = hash_func ? hash_func : fluid_direct_hash;
     hashtable->key_equal_func     = key_equal_func;
     fluid_atomic_int_set(&hashtable->ref_count, 1);
     hashtable->key_destroy_func   = key_destroy_func;
     hashtable->value_destroy_func = value_destroy_func;
-    hashtable->nodes              = FLUID_ARRAY(fluid_hashnode_t *, hashtable->size);
-    if(hashtable->nodes == NULL)
+    hashtable->prototype          = NULL;
+
+    if(!fluid_hashtable_alloc_nodes(hashtable, HASH_TABLE_MIN_BITS))
     {
-        delete_fluid_hashtable(hashtable);
+        FLUID_FREE(hashtable);
         FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
-    FLUID_MEMSET(hashtable->nodes, 0, hashtable->size * sizeof(*hashtable->nodes));
 
     return hashtable;
 }
@@ -457,10 +423,7 @@ fluid_hashtable_iter_init(fluid_hashtable_iter_t *iter,
     fluid_return_if_fail(hashtable != NULL);
 
     ri->hashtable = hashtable;
-    ri->prev_node = NULL;
-    ri->node = NULL;
     ri->position = -1;
-    ri->pre_advanced = FALSE;
 }
 
 /**
@@ -485,45 +448,25 @@ fluid_hashtable_iter_next(fluid_hashtable_iter_t *iter, void **key,
 
     fluid_return_val_if_fail(iter != NULL, FALSE);
 
-    if(ri->pre_advanced)
+    do
     {
-        ri->pre_advanced = FALSE;
+        ri->position++;
 
-        if(ri->node == NULL)
+        if(ri->position >= ri->hashtable->size)
         {
             return FALSE;
         }
     }
-    else
-    {
-        if(ri->node != NULL)
-        {
-            ri->prev_node = ri->node;
-            ri->node = ri->node->next;
-        }
-
-        while(ri->node == NULL)
-        {
-            ri->position++;
-
-            if(ri->position >= ri->hashtable->size)
-            {
-                return FALSE;
-            }
-
-            ri->prev_node = NULL;
-            ri->node = ri->hashtable->nodes[ri->position];
-        }
-    }
+    while(!HASH_IS_REAL(ri->hashtable->hashes[ri->position]));
 
     if(key != NULL)
     {
-        *key = ri->node->key;
+        *key = ri->hashtable->keys[ri->position];
     }
 
     if(value != NULL)
     {
-        *value = ri->node->value;
+        *value = ri->hashtable->values[ri->position];
     }
 
     return TRUE;
@@ -550,64 +493,13 @@ fluid_hashtable_iter_get_hash_table(fluid_hashtable_iter_t *iter)
 static void
 iter_remove_or_steal(RealIter *ri, int notify)
 {
-    fluid_hashnode_t *prev;
-    fluid_hashnode_t *node;
-    int position;
-
     fluid_return_if_fail(ri != NULL);
-    fluid_return_if_fail(ri->node != NULL);
-
-    prev = ri->prev_node;
-    node = ri->node;
-    position = ri->position;
-
-    /* pre-advance the iterator since we will remove the node */
-
-    ri->node = ri->node->next;
-    /* ri->prev_node is still the correct previous node */
-
-    while(ri->node == NULL)
-    {
-        ri->position++;
-
-        if(ri->position >= ri->hashtable->size)
-        {
-            break;
-        }
-
-        ri->prev_node = NULL;
-        ri->node = ri->hashtable->nodes[ri->position];
-    }
-
-    ri->pre_advanced = TRUE;
-
-    /* remove the node */
-
-    if(prev != NULL)
-    {
-        prev->next = node->next;
-    }
-    else
-    {
-        ri->hashtable->nodes[position] = node->next;
-    }
-
-    if(notify)
-    {
-        if(ri->hashtable->key_destroy_func)
-        {
-            ri->hashtable->key_destroy_func(node->key);
-        }
-
-        if(ri->hashtable->value_destroy_func)
-        {
-            ri->hashtable->value_destroy_func(node->value);
-        }
-    }
-
-    FLUID_FREE(node);
+    fluid_return_if_fail(ri->position >= 0 && ri->position < ri->hashtable->size);
+    fluid_return_if_fail(HASH_IS_REAL(ri->hashtable->hashes[ri->position]));
 
-    ri->hashtable->nnodes--;
+    /* the tombstone left keeps the other nodes in place, so the iteration
+     * simply continues with the next slot */
+    fluid_hashtable_remove_node(ri->hashtable, ri->position, notify);
 }
 
 /**
@@ -692,7 +584,9 @@ fluid_hashtable_unref(fluid_hashtable_t *hashtable)
     if(fluid_atomic_int_exchange_and_add(&hashtable->ref_count, -1) - 1 == 0)
     {
         fluid_hashtable_remove_all_nodes(hashtable, TRUE);
-        FLUID_FREE(hashtable->nodes);
+        FLUID_FREE(hashtable->hashes);
+        FLUID_FREE(hashtable->keys);
+        FLUID_FREE(hashtable->values);
         FLUID_FREE(hashtable);
     }
 }
@@ -733,13 +627,14 @@ delete_fluid_hashtable(fluid_hashtable_t *hashtable)
 void *
 fluid_hashtable_lookup(fluid_hashtable_t *hashtable, const void *key)
 {
-    fluid_hashnode_t *node;
+    unsigned int key_hash;
+    int index;
 
     fluid_return_val_if_fail(hashtable != NULL, NULL);
 
-    node = *fluid_hashtable_lookup_node(hashtable, key, NULL);
+    index = fluid_hashtable_lookup_node(hashtable, key, &key_hash);
 
-    return node ? node->value : NULL;
+    return HASH_IS_REAL(hashtable->hashes[index]) ? hashtable->values[index] : NULL;
 }
 
 /**
@@ -761,25 +656,26 @@ fluid_hashtable_lookup_extended(fluid_hashtable_t *hashtable,
                                 const void *lookup_key,
                                 void **orig_key, void **value)
 {
-    fluid_hashnode_t *node;
+    unsigned int key_hash;
+    int index;
 
     fluid_return_val_if_fail(hashtable != NULL, FALSE);
 
-    node = *fluid_hashtable_lookup_node(hashtable, lookup_key, NULL);
+    index = fluid_hashtable_lookup_node(hashtable, lookup_key, &key_hash);
 
-    if(node == NULL)
+    if(!HASH_IS_REAL(hashtable->hashes[index]))
     {
         return FALSE;
     }
 
     if(orig_key)
     {
-        *orig_key = node->key;
+        *orig_key = hashtable->keys[index];
     }
 
     if(value)
     {
-        *value = node->value;
+        *value = hashtable->values[index];
     }
 
     return TRUE;
@@ -805,24 +701,29 @@ static void
 fluid_hashtable_insert_internal(fluid_hashtable_t *hashtable, void *key,
                                 void *value, int keep_new_key)
 {
-    fluid_hashnode_t **node_ptr, *node;
-    unsigned int key_hash;
+    unsigned int key_hash, node_hash;
+    int index;
 
     fluid_return_if_fail(hashtable != NULL);
     fluid_return_if_fail(fluid_atomic_int_get(&hashtable->ref_count) > 0);
 
-    node_ptr = fluid_hashtable_lookup_node(hashtable, key, &key_hash);
+    index = fluid_hashtable_lookup_node(hashtable, key, &key_hash);
+    node_hash = hashtable->hashes[index];
 
-    if((node = *node_ptr))
+    if(HASH_IS_REAL(node_hash))
     {
+        void *old_value = hashtable->values[index];
+
         if(keep_new_key)
         {
+            void *old_key = hashtable->keys[index];
+
+            hashtable->keys[index] = key;
+
             if(hashtable->key_destroy_func)
             {
-                hashtable->key_destroy_func(node->key);
+                hashtable->key_destroy_func(old_key);
             }
-
-            node->key = key;
         }
         else
         {
@@ -832,31 +733,26 @@ fluid_hashtable_insert_internal(fluid_hashtable_t *hashtable, void *key,
             }
         }
 
+        hashtable->values[index] = value;
+
         if(hashtable->value_destroy_func)
         {
-            hashtable->value_destroy_func(node->value);
+            hashtable->value_destroy_func(old_value);
         }
-
-        node->value = value;
     }
     else
     {
-        node = FLUID_NEW(fluid_hashnode_t);
+        hashtable->hashes[index] = key_hash;
+        hashtable->keys[index] = key;
+        hashtable->values[index] = value;
+        hashtable->nnodes++;
 
-        if(!node)
+        /* reusing a tombstone doesn't take up another slot */
+        if(node_hash == UNUSED_HASH_VALUE)
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            return;
+            hashtable->noccupied++;
+            fluid_hashtable_maybe_resize(hashtable);
         }
-
-        node->key = key;
-        node->value = value;
-        node->key_hash = key_hash;
-        node->next = NULL;
-
-        *node_ptr = node;
-        hashtable->nnodes++;
-        fluid_hashtable_maybe_resize(hashtable);
     }
 }
 
@@ -916,18 +812,19 @@ static int
 fluid_hashtable_remove_internal(fluid_hashtable_t *hashtable, const void *key,
                                 int notify)
 {
-    fluid_hashnode_t **node_ptr;
+    unsigned int key_hash;
+    int index;
 
     fluid_return_val_if_fail(hashtable != NULL, FALSE);
 
-    node_ptr = fluid_hashtable_lookup_node(hashtable, key, NULL);
+    index = fluid_hashtable_lookup_node(hashtable, key, &key_hash);
 
-    if(*node_ptr == NULL)
+    if(!HASH_IS_REAL(hashtable->hashes[index]))
     {
         return FALSE;
     }
 
-    fluid_hashtable_remove_node(hashtable, &node_ptr, notify);
+    fluid_hashtable_remove_node(hashtable, index, notify);
     fluid_hashtable_maybe_resize(hashtable);
 
     return TRUE;
@@ -1031,23 +928,16 @@ fluid_hashtable_foreach_remove_or_steal(fluid_hashtable_t *hashtable,
                                         fluid_hr_func_t func, void *user_data,
                                         int notify)
 {
-    fluid_hashnode_t *node, **node_ptr;
     unsigned int deleted = 0;
     int i;
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node_ptr = &hashtable->nodes[i]; (node = *node_ptr) != NULL;)
+        if(HASH_IS_REAL(hashtable->hashes[i])
+                && (* func)(hashtable->keys[i], hashtable->values[i], user_data))
         {
-            if((* func)(node->key, node->value, user_data))
-            {
-                fluid_hashtable_remove_node(hashtable, &node_ptr, notify);
-                deleted++;
-            }
-            else
-            {
-                node_ptr = &node->next;
-            }
+            fluid_hashtable_remove_node(hashtable, i, notify);
+            deleted++;
         }
     }
 
@@ -1130,7 +1020,6 @@ void
 fluid_hashtable_foreach(fluid_hashtable_t *hashtable, fluid_hr_func_t func,
                         void *user_data)
 {
-    fluid_hashnode_t *node;
     int i;
 
     fluid_return_if_fail(hashtable != NULL);
@@ -1138,9 +1027,9 @@ fluid_hashtable_foreach(fluid_hashtable_t *hashtable, fluid_hr_func_t func,
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        if(HASH_IS_REAL(hashtable->hashes[i]))
         {
-            (* func)(node->key, node->value, user_data);
+            (* func)(hashtable->keys[i], hashtable->values[i], user_data);
         }
     }
 }
@@ -1175,7 +1064,6 @@ void *
 fluid_hashtable_find(fluid_hashtable_t *hashtable, fluid_hr_func_t predicate,
                      void *user_data)
 {
-    fluid_hashnode_t *node;
     int i;
 
     fluid_return_val_if_fail(hashtable != NULL, NULL);
@@ -1183,12 +1071,10 @@ fluid_hashtable_find(fluid_hashtable_t *hashtable, fluid_hr_func_t predicate,
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        if(HASH_IS_REAL(hashtable->hashes[i])
+                && predicate(hashtable->keys[i], hashtable->values[i], user_data))
         {
-            if(predicate(node->key, node->value, user_data))
-            {
-                return node->value;
-            }
+            return hashtable->values[i];
         }
     }
 
@@ -1228,7 +1114,6 @@ fluid_hashtable_size(fluid_hashtable_t *hashtable)
 fluid_list_t *
 fluid_hashtable_get_keys(fluid_hashtable_t *hashtable)
 {
-    fluid_hashnode_t *node;
     int i;
     fluid_list_t *retval;
 
@@ -1238,9 +1123,9 @@ fluid_hashtable_get_keys(fluid_hashtable_t *hashtable)
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        if(HASH_IS_REAL(hashtable->hashes[i]))
         {
-            retval = fluid_list_prepend(retval, node->key);
+            retval = fluid_list_prepend(retval, hashtable->keys[i]);
         }
     }
 
@@ -1264,7 +1149,6 @@ fluid_hashtable_get_keys(fluid_hashtable_t *hashtable)
 fluid_list_t *
 fluid_hashtable_get_values(fluid_hashtable_t *hashtable)
 {
-    fluid_hashnode_t *node;
     int i;
     fluid_list_t *retval;
 
@@ -1274,9 +1158,9 @@ fluid_hashtable_get_values(fluid_hashtable_t *hashtable)
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        if(HASH_IS_REAL(hashtable->hashes[i]))
         {
-            retval = fluid_list_prepend(retval, node->value);
+            retval = fluid_list_prepend(retval, hashtable->values[i]);
         }
     }
 
@@ -48,27 +48,24 @@ typedef int (*fluid_equal_func_t)(const void *a, const void *b);
 typedef int (*fluid_hr_func_t)(void *key, void *value, void *user_data);
 typedef struct _fluid_hashtable_iter_t fluid_hashtable_iter_t;
 
-typedef struct _fluid_hashnode_t      fluid_hashnode_t;
-
-struct _fluid_hashnode_t
-{
-    void *key;
-    void *value;
-    fluid_hashnode_t *next;
-    unsigned int key_hash;
-};
-
+/* The entries are stored by open addressing in three arrays of size slots,
+ * with the hash of each key kept next to it to skip most key comparisons. */
 struct _fluid_hashtable_t
 {
-    int size;
-    int nnodes;
-    fluid_hashnode_t **nodes;
+    int size;                         /* number of slots, a power of 2 */
+    int bits;                         /* log2 of size */
+    int nnodes;                       /* number of entries */
+    int noccupied;                    /* number of entries and tombstones */
+    unsigned int *hashes;             /* hash of each slot, or one of the unused or tombstone marks */
+    void **keys;
+    void **values;
     fluid_hash_func_t hash_func;
     fluid_equal_func_t key_equal_func;
     fluid_atomic_int_t ref_count;
     fluid_destroy_notify_t key_destroy_func;
     fluid_destroy_notify_t value_destroy_func;
     fluid_rec_mutex_t mutex;          // Optionally used in other modules (fluid_settings.c for example)
+    struct _fluid_hashtable_t *prototype; // Optionally used in other modules (the defaults shared by a settings object)
 };
 
 struct _fluid_hashtable_iter_t
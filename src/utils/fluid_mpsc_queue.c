@@ -0,0 +1,172 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_mpsc_queue.h"
+
+
+/**
+ * Create a lock free multi-producer, single-consumer queue.
+ * @param count Minimum count of elements in queue, rounded up to the next power of two
+ * @param elementsize Size of each element
+ * @return New lock free queue or NULL if out of memory (error message logged)
+ *
+ * Any number of threads may push to the queue concurrently, but there must
+ * only be one consumer thread at a time.
+ */
+fluid_mpsc_queue_t *
+new_fluid_mpsc_queue(int count, int elementsize)
+{
+    fluid_mpsc_queue_t *queue;
+    unsigned int size = 1, i;
+
+    fluid_return_val_if_fail(count > 0, NULL);
+    fluid_return_val_if_fail(elementsize > 0, NULL);
+
+    while(size < (unsigned int)count)
+    {
+        size <<= 1;
+    }
+
+    queue = FLUID_NEW(fluid_mpsc_queue_t);
+
+    if(queue == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(queue, 0, sizeof(*queue));
+
+    queue->array = FLUID_MALLOC(elementsize * size);
+    queue->sequence = FLUID_ARRAY(fluid_atomic_int_t, size);
+
+    if(queue->array == NULL || queue->sequence == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_mpsc_queue(queue);
+        return NULL;
+    }
+
+    for(i = 0; i < size; i++)
+    {
+        fluid_atomic_int_set(&queue->sequence[i], (int)i);
+    }
+
+    queue->mask = size - 1;
+    queue->elementsize = elementsize;
+    fluid_atomic_int_set(&queue->in, 0);
+    queue->out = 0;
+
+    return queue;
+}
+
+/**
+ * Free a queue.
+ * @param queue Lockless queue instance
+ *
+ * Care must be taken when freeing a queue, to ensure that the consumer and
+ * producer threads will no longer access it.
+ */
+void
+delete_fluid_mpsc_queue(fluid_mpsc_queue_t *queue)
+{
+    fluid_return_if_fail(queue != NULL);
+    FLUID_FREE(queue->array);
+    FLUID_FREE(queue->sequence);
+    FLUID_FREE(queue);
+}
+
+/**
+ * Push an element to the queue. May be called from any thread.
+ * @param queue Lockless queue instance
+ * @param element Pointer to the element to copy into the queue
+ * @return #FLUID_OK on success, #FLUID_FAILED if the queue is full
+ */
+int
+fluid_mpsc_queue_push(fluid_mpsc_queue_t *queue, const void *element)
+{
+    unsigned int pos = (unsigned int)fluid_atomic_int_get(&queue->in);
+    unsigned int slot;
+
+    while(1)
+    {
+        unsigned int seq;
+        int diff;
+
+        slot = pos & queue->mask;
+        seq = (unsigned int)fluid_atomic_int_get(&queue->sequence[slot]);
+        diff = (int)(seq - pos);
+
+        if(diff == 0)
+        {
+            /* slot is free, try to claim it */
+            if(fluid_atomic_int_compare_and_exchange(&queue->in, (int)pos, (int)(pos + 1)))
+            {
+                break;
+            }
+
+            pos = (unsigned int)fluid_atomic_int_get(&queue->in);
+        }
+        else if(diff < 0)
+        {
+            /* slot still holds an element of the previous round, i.e. queue is full */
+            return FLUID_FAILED;
+        }
+        else
+        {
+            /* another producer claimed this position in the meantime */
+            pos = (unsigned int)fluid_atomic_int_get(&queue->in);
+        }
+    }
+
+    FLUID_MEMCPY(queue->array + queue->elementsize * slot, element, queue->elementsize);
+
+    /* publish the element to the consumer */
+    fluid_atomic_int_set(&queue->sequence[slot], (int)(pos + 1));
+
+    return FLUID_OK;
+}
+
+/**
+ * Pop the oldest element from the queue. Must only be called by the consumer thread.
+ * @param queue Lockless queue instance
+ * @param element Location to copy the element to
+ * @return #FLUID_OK on success, #FLUID_FAILED if the queue is empty
+ */
+int
+fluid_mpsc_queue_pop(fluid_mpsc_queue_t *queue, void *element)
+{
+    unsigned int pos = queue->out;
+    unsigned int slot = pos & queue->mask;
+
+    if((unsigned int)fluid_atomic_int_get(&queue->sequence[slot]) != pos + 1)
+    {
+        /* nothing there yet, or the producer hasn't finished writing */
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(element, queue->array + queue->elementsize * slot, queue->elementsize);
+
+    /* release the slot for the producer of the next round */
+    fluid_atomic_int_set(&queue->sequence[slot], (int)(pos + queue->mask + 1));
+    queue->out = pos + 1;
+
+    return FLUID_OK;
+}
@@ -0,0 +1,53 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#ifndef _FLUID_MPSC_QUEUE_H
+#define _FLUID_MPSC_QUEUE_H
+
+#include "fluid_sys.h"
+
+/*
+ * Lockless multi-producer, single-consumer queue of fixed size elements.
+ *
+ * Every slot carries a sequence number telling whether it is free for the
+ * producer claiming position n (sequence == n) or filled and ready for the
+ * consumer (sequence == n + 1). Producers claim a position by incrementing
+ * the shared input position with a compare-and-exchange, so they never block
+ * each other, nor the consumer.
+ */
+struct _fluid_mpsc_queue_t
+{
+    char *array;                  /**< Queue array of elementsize elements */
+    fluid_atomic_int_t *sequence; /**< Sequence number of each slot */
+    unsigned int mask;            /**< Count of elements in array minus one (count is a power of two) */
+    int elementsize;              /**< Size of each element */
+    fluid_atomic_int_t in;        /**< Position to be claimed by the next producer */
+    unsigned int out;             /**< Position of the next element to pop, only accessed by the consumer */
+};
+
+typedef struct _fluid_mpsc_queue_t fluid_mpsc_queue_t;
+
+fluid_mpsc_queue_t *new_fluid_mpsc_queue(int count, int elementsize);
+void delete_fluid_mpsc_queue(fluid_mpsc_queue_t *queue);
+
+int fluid_mpsc_queue_push(fluid_mpsc_queue_t *queue, const void *element);
+int fluid_mpsc_queue_pop(fluid_mpsc_queue_t *queue, void *element);
+
+#endif /* _FLUID_MPSC_QUEUE_H */
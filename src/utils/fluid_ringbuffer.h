@@ -112,6 +112,22 @@ fluid_ringbuffer_get_outptr(fluid_ringbuffer_t *queue)
 }
 
 
+/**
+ * Get pointer to an output array element following the next one in queue.
+ * @param queue Lockless queue instance
+ * @param offset Zero for the next element, or more to peek at the ones after it
+ * @return Pointer to array element data in the queue or NULL if the queue holds
+ *   less elements, can only be used up until fluid_ringbuffer_next_outptr()
+ *   has been called for it.
+ */
+static FLUID_INLINE void *
+fluid_ringbuffer_get_outptr_at(fluid_ringbuffer_t *queue, int offset)
+{
+    return fluid_ringbuffer_get_count(queue) <= offset ? NULL
+           : queue->array + queue->elementsize * ((queue->out + offset) % queue->totalcount);
+}
+
+
 /**
  * Advance the output queue index to complete a "pop" operation.
  * @param queue Lockless queue instance
@@ -32,6 +32,7 @@
 #define MAX_SETTINGS_LABEL 256	/* max length of a settings variable label */
 
 static void fluid_settings_init(fluid_settings_t *settings);
+static int fluid_settings_share_table(fluid_hashtable_t *table, fluid_hashtable_t *shared);
 static void fluid_settings_key_destroy_func(void *value);
 static void fluid_settings_value_destroy_func(void *value);
 static int fluid_settings_tokenize(const char *s, char *buf, char **ptr);
@@ -50,6 +51,7 @@ typedef struct
 typedef struct
 {
     double value;
+    fluid_atomic_int_t seq;   /* odd while value is being written, see fluid_num_setting_get_value() */
     double def;
     double min;
     double max;
@@ -74,9 +76,12 @@ typedef struct
     fluid_hashtable_t *hashtable;
 } fluid_set_setting_t;
 
-typedef struct
+typedef struct _fluid_setting_node_t
 {
     int type;             /**< fluid_types_enum */
+    char *name;           /**< Full name of a value setting, passed to the update callback by handle setters */
+    int shared;           /**< TRUE for the nodes of the prototype, shared by all settings objects and never modified */
+    fluid_settings_t *owner; /**< Settings object of a setting resolved by fluid_settings_get_handle(), NULL before */
 
     union
     {
@@ -102,6 +107,9 @@ new_fluid_str_setting(const char *value, const char *def, int hints)
     }
 
     node->type = FLUID_STR_TYPE;
+    node->name = NULL;
+    node->shared = FALSE;
+    node->owner = NULL;
 
     str = &node->str;
     str->value = value ? FLUID_STRDUP(value) : NULL;
@@ -120,6 +128,7 @@ delete_fluid_str_setting(fluid_setting_node_t *node)
 
     FLUID_ASSERT(node->type == FLUID_STR_TYPE);
 
+    FLUID_FREE(node->name);
     FLUID_FREE(node->str.value);
     FLUID_FREE(node->str.def);
 
@@ -155,9 +164,13 @@ new_fluid_num_setting(double min, double max, double def, int hints)
     }
 
     node->type = FLUID_NUM_TYPE;
+    node->name = NULL;
+    node->shared = FALSE;
+    node->owner = NULL;
 
     num = &node->num;
     num->value = def;
+    num->seq = 0;
     num->def = def;
     num->min = min;
     num->max = max;
@@ -174,9 +187,50 @@ delete_fluid_num_setting(fluid_setting_node_t *node)
     fluid_return_if_fail(node != NULL);
 
     FLUID_ASSERT(node->type == FLUID_NUM_TYPE);
+    FLUID_FREE(node->name);
     FLUID_FREE(node);
 }
 
+/*
+ * The value of a numeric setting may be read without holding the settings mutex
+ * by handle getters. As doubles can't be accessed atomically everywhere, the
+ * value is guarded by a sequence counter, which is odd while a writer is busy.
+ * Readers retry until they have seen the same even count before and after.
+ */
+static double
+fluid_num_setting_get_value(fluid_num_setting_t *setting)
+{
+    double value;
+    int seq;
+
+    do
+    {
+        seq = fluid_atomic_int_get(&setting->seq);
+        value = *(volatile double *)&setting->value;
+    }
+    /* exchanging the count with itself is a full barrier, ordering the read of the value */
+    while((seq & 1) || !fluid_atomic_int_compare_and_exchange(&setting->seq, seq, seq));
+
+    return value;
+}
+
+static void
+fluid_num_setting_set_value(fluid_num_setting_t *setting, double value)
+{
+    int seq;
+
+    /* writers exclude each other by making the count odd */
+    do
+    {
+        seq = fluid_atomic_int_get(&setting->seq);
+    }
+    while((seq & 1) || !fluid_atomic_int_compare_and_exchange(&setting->seq, seq, seq + 1));
+
+    *(volatile double *)&setting->value = value;
+
+    fluid_atomic_int_inc(&setting->seq);
+}
+
 static fluid_setting_node_t *
 new_fluid_int_setting(int min, int max, int def, int hints)
 {
@@ -192,6 +246,9 @@ new_fluid_int_setting(int min, int max, int def, int hints)
     }
 
     node->type = FLUID_INT_TYPE;
+    node->name = NULL;
+    node->shared = FALSE;
+    node->owner = NULL;
 
     i = &node->i;
     i->value = def;
@@ -210,6 +267,7 @@ delete_fluid_int_setting(fluid_setting_node_t *node)
     fluid_return_if_fail(node != NULL);
 
     FLUID_ASSERT(node->type == FLUID_INT_TYPE);
+    FLUID_FREE(node->name);
     FLUID_FREE(node);
 }
 
@@ -228,6 +286,9 @@ new_fluid_set_setting(void)
     }
 
     node->type = FLUID_SET_TYPE;
+    node->name = NULL;
+    node->shared = FALSE;
+    node->owner = NULL;
     set = &node->set;
 
     set->hashtable = new_fluid_hashtable_full(fluid_str_hash, fluid_str_equal,
@@ -253,14 +314,202 @@ delete_fluid_set_setting(fluid_setting_node_t *node)
     FLUID_FREE(node);
 }
 
+/* A copy of a node of the prototype, for a settings object to modify */
+static fluid_setting_node_t *
+copy_fluid_setting(const fluid_setting_node_t *node)
+{
+    fluid_setting_node_t *copy;
+    fluid_list_t *list;
+
+    if(node->type == FLUID_SET_TYPE)
+    {
+        copy = new_fluid_set_setting();
+
+        if(copy != NULL && fluid_settings_share_table(copy->set.hashtable, node->set.hashtable) != FLUID_OK)
+        {
+            delete_fluid_set_setting(copy);
+            copy = NULL;
+        }
+
+        return copy;
+    }
+
+    copy = FLUID_NEW(fluid_setting_node_t);
+
+    if(copy == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    *copy = *node;
+    copy->shared = FALSE;
+    copy->owner = NULL;
+    copy->name = FLUID_STRDUP(node->name);
+
+    if(node->type == FLUID_STR_TYPE)
+    {
+        copy->str.value = node->str.value ? FLUID_STRDUP(node->str.value) : NULL;
+        copy->str.def = node->str.def ? FLUID_STRDUP(node->str.def) : NULL;
+        copy->str.options = NULL;
+
+        for(list = node->str.options; list; list = fluid_list_next(list))
+        {
+            copy->str.options = fluid_list_append(copy->str.options, FLUID_STRDUP((char *)list->data));
+        }
+    }
+
+    if(copy->name == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        fluid_settings_value_destroy_func(copy);
+        return NULL;
+    }
+
+    return copy;
+}
+
+/* Let table refer to all the nodes of the shared one, copying their names only */
+static int
+fluid_settings_share_table(fluid_hashtable_t *table, fluid_hashtable_t *shared)
+{
+    fluid_hashtable_iter_t iter;
+    void *key, *value;
+
+    fluid_hashtable_iter_init(&iter, shared);
+
+    while(fluid_hashtable_iter_next(&iter, &key, &value))
+    {
+        char *dupname = FLUID_STRDUP(key);
+
+        if(dupname == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        fluid_hashtable_insert(table, dupname, value);
+    }
+
+    return FLUID_OK;
+}
+
+/* Marks the nodes of the prototype as shared, or as owned by it again before freeing it */
+static int
+fluid_settings_mark_shared(void *key, void *value, void *data)
+{
+    fluid_setting_node_t *node = value;
+
+    node->shared = (data != NULL);
+
+    if(node->type == FLUID_SET_TYPE)
+    {
+        fluid_hashtable_foreach(node->set.hashtable, fluid_settings_mark_shared, data);
+    }
+
+    return 0;
+}
+
+/*
+ * The settings registered by fluid_settings_init(), once for all settings objects.
+ * A new settings object refers to the nodes of this prototype, and only copies
+ * those it modifies, see fluid_settings_get_writable(). Each settings object holds
+ * a reference to the prototype it was created from, which is freed along with the
+ * last one. A prototype outdated by fluid_settings_invalidate_prototype() is only
+ * used by the settings objects created before.
+ */
+static fluid_mutex_t fluid_settings_prototype_mutex = FLUID_MUTEX_INIT;
+static fluid_settings_t *fluid_settings_prototype = NULL;
+
+static fluid_settings_t *
+fluid_settings_acquire_prototype(void)
+{
+    fluid_settings_t *result;
+
+    fluid_mutex_lock(fluid_settings_prototype_mutex);
+
+    if(fluid_settings_prototype == NULL)
+    {
+        fluid_settings_prototype = new_fluid_hashtable_full(fluid_str_hash, fluid_str_equal,
+                                   fluid_settings_key_destroy_func,
+                                   fluid_settings_value_destroy_func);
+
+        if(fluid_settings_prototype != NULL)
+        {
+            fluid_rec_mutex_init(fluid_settings_prototype->mutex);
+            fluid_settings_init(fluid_settings_prototype);
+            fluid_hashtable_foreach(fluid_settings_prototype, fluid_settings_mark_shared, fluid_settings_prototype);
+        }
+    }
+    else
+    {
+        fluid_hashtable_ref(fluid_settings_prototype);
+    }
+
+    result = fluid_settings_prototype;
+    fluid_mutex_unlock(fluid_settings_prototype_mutex);
+
+    return result;
+}
+
+static void
+fluid_settings_release_prototype(fluid_settings_t *prototype)
+{
+    fluid_mutex_lock(fluid_settings_prototype_mutex);
+
+    /* the reference count only changes under the lock */
+    if(fluid_atomic_int_get(&prototype->ref_count) > 1)
+    {
+        fluid_hashtable_unref(prototype);
+        prototype = NULL;
+    }
+    else if(prototype == fluid_settings_prototype)
+    {
+        fluid_settings_prototype = NULL;
+    }
+
+    fluid_mutex_unlock(fluid_settings_prototype_mutex);
+
+    /* the last settings object using it is gone */
+    if(prototype != NULL)
+    {
+        fluid_hashtable_foreach(prototype, fluid_settings_mark_shared, NULL);
+        fluid_rec_mutex_destroy(prototype->mutex);
+        delete_fluid_hashtable(prototype);
+    }
+}
+
+/*
+ * Lets the settings objects created from now on register the default settings
+ * again, after they have changed, e.g. by fluid_audio_driver_register().
+ */
+void
+fluid_settings_invalidate_prototype(void)
+{
+    fluid_mutex_lock(fluid_settings_prototype_mutex);
+    fluid_settings_prototype = NULL;
+    fluid_mutex_unlock(fluid_settings_prototype_mutex);
+}
+
 /**
  * Create a new settings object
  * @return the pointer to the settings object
+ *
+ * The default settings are registered once for all settings objects alive at
+ * the same time, which share them until they change them. Creating a settings
+ * object is cheap.
  */
 fluid_settings_t *
 new_fluid_settings(void)
 {
-    fluid_settings_t *settings;
+    fluid_settings_t *settings, *prototype;
+
+    prototype = fluid_settings_acquire_prototype();
+
+    if(prototype == NULL)
+    {
+        return NULL;
+    }
 
     settings = new_fluid_hashtable_full(fluid_str_hash, fluid_str_equal,
                                         fluid_settings_key_destroy_func,
@@ -268,11 +517,19 @@ new_fluid_settings(void)
 
     if(settings == NULL)
     {
+        fluid_settings_release_prototype(prototype);
         return NULL;
     }
 
     fluid_rec_mutex_init(settings->mutex);
-    fluid_settings_init(settings);
+    settings->prototype = prototype;
+
+    if(fluid_settings_share_table(settings, prototype) != FLUID_OK)
+    {
+        delete_fluid_settings(settings);
+        return NULL;
+    }
+
     return settings;
 }
 
@@ -283,10 +540,18 @@ new_fluid_settings(void)
 void
 delete_fluid_settings(fluid_settings_t *settings)
 {
+    fluid_settings_t *prototype;
+
     fluid_return_if_fail(settings != NULL);
 
+    prototype = settings->prototype;
     fluid_rec_mutex_destroy(settings->mutex);
     delete_fluid_hashtable(settings);
+
+    if(prototype != NULL)
+    {
+        fluid_settings_release_prototype(prototype);
+    }
 }
 
 /* Settings hash key destroy function */
@@ -302,6 +567,12 @@ fluid_settings_value_destroy_func(void *value)
 {
     fluid_setting_node_t *node = value;
 
+    /* owned by the prototype */
+    if(node->shared)
+    {
+        return;
+    }
+
     switch(node->type)
     {
     case FLUID_NUM_TYPE:
@@ -415,6 +686,85 @@ fluid_settings_get(fluid_settings_t *settings, const char *name,
     return FLUID_OK;
 }
 
+/* Replace the node of key in table, shared with the prototype, by a copy of its own */
+static fluid_setting_node_t *
+fluid_settings_unshare(fluid_hashtable_t *table, const char *key, const fluid_setting_node_t *node)
+{
+    fluid_setting_node_t *copy;
+    char *dupname;
+
+    copy = copy_fluid_setting(node);
+    dupname = FLUID_STRDUP(key);
+
+    if(copy == NULL || dupname == NULL)
+    {
+        if(copy != NULL)
+        {
+            fluid_settings_value_destroy_func(copy);
+        }
+
+        FLUID_FREE(dupname);
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    fluid_hashtable_insert(table, dupname, copy);
+
+    return copy;
+}
+
+/**
+ * Get a setting node to modify, as fluid_settings_get(). The nodes on its path
+ * still shared with the prototype are replaced by copies first.
+ *
+ * @param settings a settings object
+ * @param name Settings name
+ * @param value Location to store setting node if found
+ * @return #FLUID_OK if the node exists, #FLUID_FAILED otherwise
+ */
+static int
+fluid_settings_get_writable(fluid_settings_t *settings, const char *name,
+                            fluid_setting_node_t **value)
+{
+    fluid_hashtable_t *table = settings;
+    fluid_setting_node_t *node = NULL;
+    char *tokens[MAX_SETTINGS_TOKENS];
+    char buf[MAX_SETTINGS_LABEL + 1];
+    int ntokens;
+    int n;
+
+    ntokens = fluid_settings_tokenize(name, buf, tokens);
+
+    if(table == NULL || ntokens <= 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(n = 0; n < ntokens; n++)
+    {
+        node = fluid_hashtable_lookup(table, tokens[n]);
+
+        if(node != NULL && node->shared)
+        {
+            node = fluid_settings_unshare(table, tokens[n], node);
+        }
+
+        if(!node)
+        {
+            return FLUID_FAILED;
+        }
+
+        table = (node->type == FLUID_SET_TYPE) ? node->set.hashtable : NULL;
+    }
+
+    if(value)
+    {
+        *value = node;
+    }
+
+    return FLUID_OK;
+}
+
 /**
  * Set a setting name, value and type, replacing it if already exists
  *
@@ -447,6 +797,16 @@ fluid_settings_set(fluid_settings_t *settings, const char *name, fluid_setting_n
 
         node = fluid_hashtable_lookup(table, tokens[n]);
 
+        if(node != NULL && node->shared && node->type == FLUID_SET_TYPE)
+        {
+            node = fluid_settings_unshare(table, tokens[n], node);
+
+            if(node == NULL)
+            {
+                return FLUID_FAILED;
+            }
+        }
+
         if(node)
         {
 
@@ -495,9 +855,13 @@ fluid_settings_set(fluid_settings_t *settings, const char *name, fluid_setting_n
     }
 
     dupname = FLUID_STRDUP(tokens[num]);
+    value->name = FLUID_STRDUP(name);
 
-    if(!dupname)
+    if(!dupname || !value->name)
     {
+        FLUID_FREE(dupname);
+        FLUID_FREE(value->name);
+        value->name = NULL;
         FLUID_LOG(FLUID_ERR, "Out of memory");
         return FLUID_FAILED;
     }
@@ -528,7 +892,7 @@ fluid_settings_register_str(fluid_settings_t *settings, const char *name, const
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if(fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
     {
         node = new_fluid_str_setting(def, def, hints);
         retval = fluid_settings_set(settings, name, node);
@@ -544,6 +908,7 @@ fluid_settings_register_str(fluid_settings_t *settings, const char *name, const
         if(node->type == FLUID_STR_TYPE)
         {
             fluid_str_setting_t *setting = &node->str;
+            FLUID_FREE(setting->def);
             setting->def = def ? FLUID_STRDUP(def) : NULL;
             setting->hints = hints;
             retval = FLUID_OK;
@@ -586,7 +951,7 @@ fluid_settings_register_num(fluid_settings_t *settings, const char *name, double
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if(fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
     {
         /* insert a new setting */
         node = new_fluid_num_setting(min, max, def, hints);
@@ -648,7 +1013,7 @@ fluid_settings_register_int(fluid_settings_t *settings, const char *name, int de
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if(fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
     {
         /* insert a new setting */
         node = new_fluid_int_setting(min, max, def, hints);
@@ -704,7 +1069,7 @@ int fluid_settings_callback_str(fluid_settings_t *settings, const char *name,
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
             || node->type != FLUID_STR_TYPE)
     {
         fluid_rec_mutex_unlock(settings->mutex);
@@ -740,7 +1105,7 @@ int fluid_settings_callback_num(fluid_settings_t *settings, const char *name,
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
             || node->type != FLUID_NUM_TYPE)
     {
         fluid_rec_mutex_unlock(settings->mutex);
@@ -776,7 +1141,7 @@ int fluid_settings_callback_int(fluid_settings_t *settings, const char *name,
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
             || node->type != FLUID_INT_TYPE)
     {
         fluid_rec_mutex_unlock(settings->mutex);
@@ -967,7 +1332,7 @@ fluid_settings_setstr(fluid_settings_t *settings, const char *name, const char *
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
             || (node->type != FLUID_STR_TYPE))
     {
         FLUID_LOG(FLUID_ERR, "Unknown string setting '%s'", name);
@@ -1260,7 +1625,7 @@ fluid_settings_add_option(fluid_settings_t *settings, const char *name, const ch
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) == FLUID_OK
+    if(fluid_settings_get_writable(settings, name, &node) == FLUID_OK
             && (node->type == FLUID_STR_TYPE))
     {
         fluid_str_setting_t *setting = &node->str;
@@ -1295,7 +1660,7 @@ fluid_settings_remove_option(fluid_settings_t *settings, const char *name, const
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) == FLUID_OK
+    if(fluid_settings_get_writable(settings, name, &node) == FLUID_OK
             && (node->type == FLUID_STR_TYPE))
     {
 
@@ -1345,7 +1710,7 @@ fluid_settings_setnum(fluid_settings_t *settings, const char *name, double val)
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
             || (node->type != FLUID_NUM_TYPE))
     {
         FLUID_LOG(FLUID_ERR, "Unknown numeric setting '%s'", name);
@@ -1360,7 +1725,7 @@ fluid_settings_setnum(fluid_settings_t *settings, const char *name, double val)
         goto error_recovery;
     }
 
-    setting->value = val;
+    fluid_num_setting_set_value(setting, val);
 
     callback = setting->update;
     data = setting->data;
@@ -1406,7 +1771,7 @@ fluid_settings_getnum(fluid_settings_t *settings, const char *name, double *val)
             && (node->type == FLUID_NUM_TYPE))
     {
         fluid_num_setting_t *setting = &node->num;
-        *val = setting->value;
+        *val = fluid_num_setting_get_value(setting);
         retval = FLUID_OK;
     }
 
@@ -1530,7 +1895,7 @@ fluid_settings_setint(fluid_settings_t *settings, const char *name, int val)
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_writable(settings, name, &node) != FLUID_OK)
             || (node->type != FLUID_INT_TYPE))
     {
         FLUID_LOG(FLUID_ERR, "Unknown integer parameter '%s'", name);
@@ -1545,7 +1910,7 @@ fluid_settings_setint(fluid_settings_t *settings, const char *name, int val)
         goto error_recovery;
     }
 
-    setting->value = val;
+    fluid_atomic_int_set(&setting->value, val);
 
     callback = setting->update;
     data = setting->data;
@@ -1591,7 +1956,7 @@ fluid_settings_getint(fluid_settings_t *settings, const char *name, int *val)
             && (node->type == FLUID_INT_TYPE))
     {
         fluid_int_setting_t *setting = &node->i;
-        *val = setting->value;
+        *val = fluid_atomic_int_get(&setting->value);
         retval = FLUID_OK;
     }
 
@@ -1946,6 +2311,180 @@ fluid_settings_foreach(fluid_settings_t *settings, void *data,
     delete_fluid_list(bag.names);         /* -- Free names list */
 }
 
+/**
+ * Resolve the name of a numeric or integer setting once, to access it
+ * quickly afterwards.
+ *
+ * @param settings a settings object
+ * @param name a setting's name
+ * @return the handle of the setting, or NULL if there is no numeric or integer setting of this name
+ *
+ * The settings accessed through the handle are neither looked up nor locked, which makes
+ * fluid_settings_handle_getnum() and fluid_settings_handle_getint() safe to call from
+ * realtime threads, as often as needed. The setters only lock the settings object to
+ * look up the update callback of the setting. The handle stays valid as long as the
+ * settings object exists and doesn't need to be freed.
+ *
+ * @since 2.2.0
+ */
+fluid_setting_handle_t *
+fluid_settings_get_handle(fluid_settings_t *settings, const char *name)
+{
+    fluid_setting_node_t *node;
+
+    fluid_return_val_if_fail(settings != NULL, NULL);
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_return_val_if_fail(name[0] != '\0', NULL);
+
+    fluid_rec_mutex_lock(settings->mutex);
+
+    if(fluid_settings_get_writable(settings, name, &node) != FLUID_OK
+            || (node->type != FLUID_NUM_TYPE && node->type != FLUID_INT_TYPE))
+    {
+        node = NULL;
+    }
+    else
+    {
+        node->owner = settings;
+    }
+
+    fluid_rec_mutex_unlock(settings->mutex);
+
+    return node;
+}
+
+/**
+ * Set the value of a numeric setting through its handle.
+ *
+ * @param handle a handle of a numeric setting, as returned by fluid_settings_get_handle()
+ * @param val new setting's value
+ * @return #FLUID_OK if the value has been set, #FLUID_FAILED otherwise
+ *
+ * The update callback of the setting is called as by fluid_settings_setnum().
+ *
+ * @since 2.2.0
+ */
+int
+fluid_settings_handle_setnum(fluid_setting_handle_t *handle, double val)
+{
+    fluid_num_setting_t *setting;
+    fluid_num_update_t callback;
+    void *data;
+
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->type == FLUID_NUM_TYPE, FLUID_FAILED);
+
+    setting = &handle->num;
+
+    if(val < setting->min || val > setting->max)
+    {
+        FLUID_LOG(FLUID_ERR, "requested set value for '%s' out of range", handle->name);
+        return FLUID_FAILED;
+    }
+
+    fluid_num_setting_set_value(setting, val);
+
+    /* only the value is stored without locking, the callback may be changed meanwhile */
+    fluid_rec_mutex_lock(handle->owner->mutex);
+    callback = setting->update;
+    data = setting->data;
+    fluid_rec_mutex_unlock(handle->owner->mutex);
+
+    if(callback)
+    {
+        (*callback)(data, handle->name, val);
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Get the value of a numeric setting through its handle, without locking.
+ *
+ * @param handle a handle of a numeric setting, as returned by fluid_settings_get_handle()
+ * @param val variable pointer to receive the setting's numeric value
+ * @return #FLUID_OK if the value exists, #FLUID_FAILED otherwise
+ *
+ * @since 2.2.0
+ */
+int
+fluid_settings_handle_getnum(fluid_setting_handle_t *handle, double *val)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->type == FLUID_NUM_TYPE, FLUID_FAILED);
+    fluid_return_val_if_fail(val != NULL, FLUID_FAILED);
+
+    *val = fluid_num_setting_get_value(&handle->num);
+
+    return FLUID_OK;
+}
+
+/**
+ * Set the value of an integer setting through its handle.
+ *
+ * @param handle a handle of an integer setting, as returned by fluid_settings_get_handle()
+ * @param val new setting's integer value
+ * @return #FLUID_OK if the value has been set, #FLUID_FAILED otherwise
+ *
+ * The update callback of the setting is called as by fluid_settings_setint().
+ *
+ * @since 2.2.0
+ */
+int
+fluid_settings_handle_setint(fluid_setting_handle_t *handle, int val)
+{
+    fluid_int_setting_t *setting;
+    fluid_int_update_t callback;
+    void *data;
+
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->type == FLUID_INT_TYPE, FLUID_FAILED);
+
+    setting = &handle->i;
+
+    if(val < setting->min || val > setting->max)
+    {
+        FLUID_LOG(FLUID_ERR, "requested set value for setting '%s' out of range", handle->name);
+        return FLUID_FAILED;
+    }
+
+    fluid_atomic_int_set(&setting->value, val);
+
+    /* only the value is stored without locking, the callback may be changed meanwhile */
+    fluid_rec_mutex_lock(handle->owner->mutex);
+    callback = setting->update;
+    data = setting->data;
+    fluid_rec_mutex_unlock(handle->owner->mutex);
+
+    if(callback)
+    {
+        (*callback)(data, handle->name, val);
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Get the value of an integer setting through its handle, without locking.
+ *
+ * @param handle a handle of an integer setting, as returned by fluid_settings_get_handle()
+ * @param val pointer to a variable to receive the setting's integer value
+ * @return #FLUID_OK if the value exists, #FLUID_FAILED otherwise
+ *
+ * @since 2.2.0
+ */
+int
+fluid_settings_handle_getint(fluid_setting_handle_t *handle, int *val)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->type == FLUID_INT_TYPE, FLUID_FAILED);
+    fluid_return_val_if_fail(val != NULL, FLUID_FAILED);
+
+    *val = fluid_atomic_int_get(&handle->i.value);
+
+    return FLUID_OK;
+}
+
 /**
  * Split a comma-separated list of integers and fill the passed
  * in buffer with the parsed values.
@@ -54,4 +54,6 @@ int fluid_settings_split_csv(const char *str, int *buf, int buf_len);
 
 void* fluid_settings_get_user_data(fluid_settings_t * settings, const char *name);
 
+void fluid_settings_invalidate_prototype(void);
+
 #endif /* _FLUID_SETTINGS_H */
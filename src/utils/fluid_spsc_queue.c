@@ -0,0 +1,89 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_spsc_queue.h"
+
+
+/**
+ * Create a lock free single-producer, single-consumer queue.
+ * @param count Minimum count of elements in queue, rounded up to the next power of two
+ * @param elementsize Size of each element
+ * @return New lock free queue or NULL if out of memory (error message logged)
+ *
+ * There must only be one producer thread and one consumer thread at a time.
+ */
+fluid_spsc_queue_t *
+new_fluid_spsc_queue(int count, int elementsize)
+{
+    fluid_spsc_queue_t *queue;
+    unsigned int size = 1;
+
+    fluid_return_val_if_fail(count > 0, NULL);
+    fluid_return_val_if_fail(elementsize > 0, NULL);
+
+    while(size < (unsigned int)count)
+    {
+        size <<= 1;
+    }
+
+    queue = FLUID_NEW(fluid_spsc_queue_t);
+
+    if(queue == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(queue, 0, sizeof(*queue));
+
+    queue->array = FLUID_MALLOC(elementsize * size);
+
+    if(queue->array == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_spsc_queue(queue);
+        return NULL;
+    }
+
+    /* Clear array, in case dynamic pointer reclaiming is being done */
+    FLUID_MEMSET(queue->array, 0, elementsize * size);
+
+    queue->mask = size - 1;
+    queue->elementsize = elementsize;
+    fluid_atomic_int_set(&queue->in, 0);
+    fluid_atomic_int_set(&queue->out, 0);
+
+    return queue;
+}
+
+/**
+ * Free a queue.
+ * @param queue Lockless queue instance
+ *
+ * Care must be taken when freeing a queue, to ensure that the consumer and
+ * producer threads will no longer access it.
+ */
+void
+delete_fluid_spsc_queue(fluid_spsc_queue_t *queue)
+{
+    fluid_return_if_fail(queue != NULL);
+    FLUID_FREE(queue->array);
+    FLUID_FREE(queue);
+}
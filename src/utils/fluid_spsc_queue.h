@@ -0,0 +1,174 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#ifndef _FLUID_SPSC_QUEUE_H
+#define _FLUID_SPSC_QUEUE_H
+
+#include "fluid_sys.h"
+
+/*
+ * Lockless single-producer, single-consumer queue of fixed size elements.
+ *
+ * Unlike fluid_ringbuffer_t, producer and consumer don't share a count of
+ * elements they both modify: the producer only writes the input position and
+ * the consumer only writes the output position, each on its own cache line.
+ * Both positions run freely and are masked to index the array, whose size is
+ * a power of two. Each side keeps the last position of the other one it has
+ * loaded, and only loads it again when that one tells the queue is full or
+ * empty, so that the cache line of the other side is rarely brought in.
+ */
+struct _fluid_spsc_queue_t
+{
+    char *array;                  /**< Queue array of elementsize elements */
+    unsigned int mask;            /**< Count of elements in array minus one (count is a power of two) */
+    int elementsize;              /**< Size of each element */
+
+    char pad_in[FLUID_DEFAULT_ALIGNMENT];
+    fluid_atomic_int_t in;        /**< Position of the next element to push, only written by the producer */
+    unsigned int out_cached;      /**< Output position last loaded by the producer */
+
+    char pad_out[FLUID_DEFAULT_ALIGNMENT];
+    fluid_atomic_int_t out;       /**< Position of the next element to pop, only written by the consumer */
+    unsigned int in_cached;       /**< Input position last loaded by the consumer */
+
+    char pad_end[FLUID_DEFAULT_ALIGNMENT];
+};
+
+typedef struct _fluid_spsc_queue_t fluid_spsc_queue_t;
+
+fluid_spsc_queue_t *new_fluid_spsc_queue(int count, int elementsize);
+void delete_fluid_spsc_queue(fluid_spsc_queue_t *queue);
+
+/**
+ * Get pointer to next input array element in queue. Must only be called by the producer.
+ * @param queue Lockless queue instance
+ * @param offset Normally zero, or more if you need to push several items at once
+ * @return Pointer to array element in queue to store data to or NULL if queue is full
+ *
+ * This function along with fluid_spsc_queue_next_inptr() form a queue "push"
+ * operation, like fluid_ringbuffer_get_inptr(). The returned array element may
+ * contain the data of a previous element if the queue has wrapped around.
+ */
+static FLUID_INLINE void *
+fluid_spsc_queue_get_inptr(fluid_spsc_queue_t *queue, int offset)
+{
+    unsigned int pos = (unsigned int)queue->in + (unsigned int)offset;
+
+    if(pos - queue->out_cached > queue->mask)
+    {
+        queue->out_cached = (unsigned int)fluid_atomic_int_get_acquire(&queue->out);
+
+        if(pos - queue->out_cached > queue->mask)
+        {
+            return NULL;
+        }
+    }
+
+    return queue->array + queue->elementsize * (pos & queue->mask);
+}
+
+/**
+ * Advance the input queue index to complete a "push" operation, publishing
+ * the elements stored to the consumer. Must only be called by the producer.
+ * @param queue Lockless queue instance
+ * @param count Normally one, or more if you need to push several items at once
+ */
+static FLUID_INLINE void
+fluid_spsc_queue_next_inptr(fluid_spsc_queue_t *queue, int count)
+{
+    fluid_atomic_int_set_release(&queue->in, (int)((unsigned int)queue->in + (unsigned int)count));
+}
+
+/**
+ * Get amount of items currently in queue. May be called from any thread.
+ * @param queue Lockless queue instance
+ * @return amount of items currently in queue
+ */
+static FLUID_INLINE int
+fluid_spsc_queue_get_count(fluid_spsc_queue_t *queue)
+{
+    /* the output position first, it never passes the input position loaded after it */
+    unsigned int out = (unsigned int)fluid_atomic_int_get_acquire(&queue->out);
+
+    return (int)((unsigned int)fluid_atomic_int_get_acquire(&queue->in) - out);
+}
+
+/**
+ * Get the count of elements the queue holds at most.
+ * @param queue Lockless queue instance
+ * @return Count of elements in array
+ */
+static FLUID_INLINE int
+fluid_spsc_queue_get_capacity(fluid_spsc_queue_t *queue)
+{
+    return (int)(queue->mask + 1);
+}
+
+/**
+ * Get pointer to an output array element in queue. Must only be called by the consumer.
+ * @param queue Lockless queue instance
+ * @param offset Zero for the next element, or more to peek at the ones after it
+ * @return Pointer to array element data in the queue or NULL if the queue holds
+ *   less elements, can only be used up until fluid_spsc_queue_next_outptr()
+ *   has been called for it.
+ */
+static FLUID_INLINE void *
+fluid_spsc_queue_get_outptr_at(fluid_spsc_queue_t *queue, int offset)
+{
+    unsigned int pos = (unsigned int)queue->out;
+
+    if(queue->in_cached - pos <= (unsigned int)offset)
+    {
+        queue->in_cached = (unsigned int)fluid_atomic_int_get_acquire(&queue->in);
+
+        if(queue->in_cached - pos <= (unsigned int)offset)
+        {
+            return NULL;
+        }
+    }
+
+    return queue->array + queue->elementsize * ((pos + (unsigned int)offset) & queue->mask);
+}
+
+/**
+ * Get pointer to next output array element in queue. Must only be called by the consumer.
+ * @param queue Lockless queue instance
+ * @return Pointer to array element data in the queue or NULL if empty, can only
+ *   be used up until fluid_spsc_queue_next_outptr() is called.
+ */
+static FLUID_INLINE void *
+fluid_spsc_queue_get_outptr(fluid_spsc_queue_t *queue)
+{
+    return fluid_spsc_queue_get_outptr_at(queue, 0);
+}
+
+/**
+ * Advance the output queue index to complete a "pop" operation, releasing
+ * the elements to the producer. Must only be called by the consumer.
+ * @param queue Lockless queue instance
+ * @param count Normally one, or more to pop several elements at once
+ */
+static FLUID_INLINE void
+fluid_spsc_queue_next_outptr(fluid_spsc_queue_t *queue, int count)
+{
+    fluid_atomic_int_set_release(&queue->out, (int)((unsigned int)queue->out + (unsigned int)count));
+}
+
+#endif /* _FLUID_SPSC_QUEUE_H */
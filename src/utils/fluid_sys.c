@@ -18,7 +18,13 @@
  * 02110-1301, USA
  */
 
+/* for pthread_setaffinity_np(), before any system header */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "fluid_sys.h"
+#include "fluid_mpsc_queue.h"
 
 
 #if WITH_READLINE
@@ -30,6 +36,29 @@
 #include "fluid_rtkit.h"
 #endif
 
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__APPLE__) && defined(__has_include)
+#if __has_include(<os/workgroup.h>)
+#include <os/workgroup.h>
+#define FLUID_HAVE_OS_WORKGROUP 1
+#endif
+#endif
+
+#if defined(__arm__) && defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/auxv.h>)
+#include <sys/auxv.h>
+#define FLUID_HAVE_GETAUXVAL 1
+#endif
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
 #if HAVE_PTHREAD_H && !defined(WIN32)
 // Do not include pthread on windows. It includes winsock.h, which collides with ws2tcpip.h from fluid_sys.h
 // It isn't need on Windows anyway.
@@ -73,6 +102,7 @@ struct _fluid_server_socket_t
     fluid_thread_t *thread;
     int cont;
     fluid_server_func_t func;
+    fluid_server_read_func_t read_func;
     void *data;
 };
 
@@ -164,12 +194,270 @@ fluid_default_log_function(int level, const char *message, void *data)
     fflush(out);
 }
 
+/* Messages logged while rendering audio are handed over to the logger thread
+ * in records of this size, longer ones are truncated */
+#define FLUID_LOG_RECORD_SIZE 256
+#define FLUID_LOG_RING_SIZE 128
+
+/* Period of the logger thread looking for records, in milliseconds */
+#define FLUID_LOG_INTERVAL 10
+
+/* Repetitions of a message within this time (in milliseconds) of its first
+ * occurrence are only counted, and reported by a single message */
+#define FLUID_LOG_REPEAT_INTERVAL 1000
+
+typedef struct
+{
+    int level;
+    char message[FLUID_LOG_RECORD_SIZE];
+} fluid_log_record_t;
+
+typedef struct
+{
+    fluid_mpsc_queue_t *ring;     /**< Records logged by the realtime threads */
+    fluid_thread_t *thread;
+    fluid_atomic_int_t terminate;
+    fluid_atomic_int_t dropped;   /**< Count of records lost because the ring was full */
+
+    /* Only accessed by the logger thread */
+    fluid_log_record_t last;      /**< Last message written, to count its repetitions */
+    int has_last;
+    int repeated;
+    unsigned int last_time;
+} fluid_log_async_t;
+
+static fluid_log_async_t *fluid_log_async = NULL;
+static int fluid_log_async_refcount = 0;
+static fluid_mutex_t fluid_log_async_mutex = FLUID_MUTEX_INIT;
+
+/* Nesting depth of the realtime sections of the calling thread */
+static fluid_private_t fluid_rt_depth;
+
+static int
+fluid_rt_get_depth(void)
+{
+    void *depth = fluid_private_get(fluid_rt_depth);
+    return FLUID_POINTER_TO_INT(depth);
+}
+
+static int
+fluid_log_async_push(int level, const char *fmt, va_list args)
+{
+    fluid_log_async_t *async;
+    fluid_log_record_t record;
+
+    /* a panic is about to end the program, it goes out right away */
+    if(level == FLUID_PANIC || fluid_rt_get_depth() <= 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    async = fluid_atomic_pointer_get(&fluid_log_async);
+
+    if(async == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    record.level = level;
+    FLUID_VSNPRINTF(record.message, sizeof(record.message), fmt, args);
+
+    if(fluid_mpsc_queue_push(async->ring, &record) != FLUID_OK)
+    {
+        fluid_atomic_int_inc(&async->dropped);
+    }
+
+    return FLUID_OK;
+}
+
+static void
+fluid_log_write(int level, const char *message)
+{
+    fluid_log_function_t fun = fluid_log_function[level];
+
+    if(fun != NULL)
+    {
+        (*fun)(level, message, fluid_log_user_data[level]);
+    }
+}
+
+/* Report the repetitions counted of the last message */
+static void
+fluid_log_async_flush_repeated(fluid_log_async_t *async)
+{
+    if(async->repeated > 0)
+    {
+        char buf[64];
+
+        FLUID_SNPRINTF(buf, sizeof(buf), "last message repeated %d times", async->repeated);
+        fluid_log_write(async->last.level, buf);
+    }
+
+    async->has_last = FALSE;
+    async->repeated = 0;
+}
+
+/* Write the records logged since the last call, called by the logger thread */
+static void
+fluid_log_async_drain(fluid_log_async_t *async)
+{
+    fluid_log_record_t record;
+    unsigned int now = fluid_curtime();
+    int dropped;
+
+    if(async->has_last && now - async->last_time >= FLUID_LOG_REPEAT_INTERVAL)
+    {
+        fluid_log_async_flush_repeated(async);
+    }
+
+    while(fluid_mpsc_queue_pop(async->ring, &record) == FLUID_OK)
+    {
+        if(async->has_last && record.level == async->last.level
+                && FLUID_STRCMP(record.message, async->last.message) == 0)
+        {
+            async->repeated++;
+            continue;
+        }
+
+        fluid_log_async_flush_repeated(async);
+        fluid_log_write(record.level, record.message);
+
+        async->last = record;
+        async->has_last = TRUE;
+        async->last_time = now;
+    }
+
+    dropped = fluid_atomic_int_get(&async->dropped);
+
+    if(dropped > 0)
+    {
+        char buf[64];
+
+        fluid_atomic_int_add(&async->dropped, -dropped);
+        FLUID_SNPRINTF(buf, sizeof(buf), "%d log messages dropped while rendering audio", dropped);
+        fluid_log_write(FLUID_WARN, buf);
+    }
+}
+
+static fluid_thread_return_t
+fluid_log_async_thread_func(void *data)
+{
+    fluid_log_async_t *async = data;
+
+    while(!fluid_atomic_int_get(&async->terminate))
+    {
+        fluid_log_async_drain(async);
+        fluid_msleep(FLUID_LOG_INTERVAL);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+static void
+delete_fluid_log_async(fluid_log_async_t *async)
+{
+    fluid_return_if_fail(async != NULL);
+
+    if(async->thread != NULL)
+    {
+        fluid_atomic_int_set(&async->terminate, TRUE);
+        fluid_thread_join(async->thread);
+        delete_fluid_thread(async->thread);
+
+        /* what the realtime threads logged last */
+        fluid_log_async_drain(async);
+        fluid_log_async_flush_repeated(async);
+    }
+
+    delete_fluid_mpsc_queue(async->ring);
+    FLUID_FREE(async);
+}
+
+/**
+ * Start handing the messages logged while rendering audio, i.e. within
+ * fluid_rt_enter() and fluid_rt_exit(), over to a logger thread, so that the
+ * realtime threads never wait for the log function. The logger thread is shared
+ * by all the callers and runs until the last of them calls fluid_log_async_unref().
+ * Repetitions of a message are counted rather than logged one by one.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise (messages are then
+ *   logged synchronously)
+ */
+int
+fluid_log_async_ref(void)
+{
+    int result = FLUID_OK;
+
+    fluid_mutex_lock(fluid_log_async_mutex);
+
+    if(fluid_log_async_refcount == 0)
+    {
+        fluid_log_async_t *async = FLUID_NEW(fluid_log_async_t);
+
+        if(async == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            result = FLUID_FAILED;
+            goto exit;
+        }
+
+        FLUID_MEMSET(async, 0, sizeof(*async));
+        async->ring = new_fluid_mpsc_queue(FLUID_LOG_RING_SIZE, sizeof(fluid_log_record_t));
+
+        if(async->ring != NULL)
+        {
+            async->thread = new_fluid_thread("fluid-logger", fluid_log_async_thread_func, async, 0, FALSE);
+        }
+
+        if(async->thread == NULL)
+        {
+            delete_fluid_log_async(async);
+            result = FLUID_FAILED;
+            goto exit;
+        }
+
+        fluid_atomic_pointer_set(&fluid_log_async, async);
+    }
+
+    fluid_log_async_refcount++;
+
+exit:
+    fluid_mutex_unlock(fluid_log_async_mutex);
+    return result;
+}
+
+/**
+ * Release the logger thread acquired with fluid_log_async_ref(). Once released
+ * by all of its users, the messages logged so far are written and the thread is stopped.
+ * The realtime threads must not log anything while this is going on.
+ */
+void
+fluid_log_async_unref(void)
+{
+    fluid_log_async_t *async = NULL;
+
+    fluid_mutex_lock(fluid_log_async_mutex);
+
+    if(fluid_log_async_refcount > 0 && --fluid_log_async_refcount == 0)
+    {
+        async = fluid_log_async;
+        fluid_atomic_pointer_set(&fluid_log_async, NULL);
+    }
+
+    fluid_mutex_unlock(fluid_log_async_mutex);
+
+    delete_fluid_log_async(async);
+}
+
 /**
  * Print a message to the log.
  * @param level Log level (#fluid_log_level).
  * @param fmt Printf style format string for log message
  * @param ... Arguments for printf 'fmt' message string
  * @return Always returns #FLUID_FAILED
+ *
+ * Messages logged by a thread rendering audio are written by a logger thread
+ * after a short delay, if a synthesizer instance exists, and repetitions of them
+ * are summarized. Panic messages are always written right away.
  */
 int
 fluid_log(int level, const char *fmt, ...)
@@ -180,23 +468,61 @@ fluid_log(int level, const char *fmt, ...)
 
         if(fun != NULL)
         {
-            char errbuf[1024];
-            
             va_list args;
             va_start(args, fmt);
-            FLUID_VSNPRINTF(errbuf, sizeof(errbuf), fmt, args);
+
+            if(fluid_log_async_push(level, fmt, args) != FLUID_OK)
+            {
+                char errbuf[1024];
+
+                FLUID_VSNPRINTF(errbuf, sizeof(errbuf), fmt, args);
+                (*fun)(level, errbuf, fluid_log_user_data[level]);
+            }
+
             va_end(args);
-        
-            (*fun)(level, errbuf, fluid_log_user_data[level]);
         }
     }
 
     return FLUID_FAILED;
 }
 
+/**
+ * Mark the calling thread as rendering audio until fluid_rt_exit() is called.
+ * Sections may be nested. Messages logged in between are handed over to the
+ * logger thread, see fluid_log_async_ref(). When built with enable-rt-alloc-check,
+ * any heap allocation made by the thread in between aborts the program.
+ */
+void fluid_rt_enter(void)
+{
+    int depth = fluid_rt_get_depth();
+    fluid_private_set(fluid_rt_depth, FLUID_INT_TO_POINTER(depth + 1));
+}
+
+void fluid_rt_exit(void)
+{
+    int depth = fluid_rt_get_depth();
+    fluid_private_set(fluid_rt_depth, FLUID_INT_TO_POINTER(depth - 1));
+}
+
+#ifdef RT_ALLOC_CHECK
+static void fluid_rt_check(const char *what)
+{
+    if(fluid_rt_get_depth() > 0)
+    {
+        FLUID_LOG(FLUID_PANIC, "Heap %s called while rendering audio", what);
+        abort();
+    }
+}
+#else
+#define fluid_rt_check(_what)
+#endif
+
 void* fluid_alloc(size_t len)
 {
-    void* ptr = malloc(len);
+    void* ptr;
+
+    fluid_rt_check("allocation");
+    ptr = malloc(len);
 
 #if defined(DEBUG) && !defined(_MSC_VER)
     // garbage initialize allocated memory for debug builds to ease reproducing
@@ -225,115 +551,452 @@ void* fluid_alloc(size_t len)
  */
 void fluid_free(void* ptr)
 {
+    if(ptr != NULL)
+    {
+        fluid_rt_check("free");
+    }
+
     free(ptr);
 }
 
+void* fluid_realloc(void *ptr, size_t len)
+{
+    fluid_rt_check("reallocation");
+    return realloc(ptr, len);
+}
+
+/* Lock-free pool of preallocated objects
+ *
+ * The free objects form a stack. Its head is an index into the pool (plus one,
+ * zero means empty) in the lower 16 bits and a tag in the upper 16 bits, which
+ * changes with every operation, so that a compare-and-exchange cannot succeed
+ * on a head that has been popped and pushed again in between.
+ */
+#define FLUID_POOL_INDEX_MASK 0xffffu
+#define FLUID_POOL_TAG_INCR 0x10000u
+#define FLUID_POOL_ALIGNMENT 16
+
+struct _fluid_pool_t
+{
+    char *data;                   /**< count objects of size bytes */
+    fluid_atomic_int_t *next;     /**< Next free object (index plus one) of each free object */
+    fluid_atomic_int_t head;      /**< First free object and tag */
+    int count;
+    int size;
+};
+
 /**
- * An improved strtok, still trashes the input string, but is portable and
- * thread safe.  Also skips token chars at beginning of token string and never
- * returns an empty token (will return NULL if source ends in token chars though).
- * NOTE: NOT part of public API
- * @internal
- * @param str Pointer to a string pointer of source to tokenize.  Pointer gets
- *   updated on each invocation to point to beginning of next token.  Note that
- *   token char gets overwritten with a 0 byte.  String pointer is set to NULL
- *   when final token is returned.
- * @param delim String of delimiter chars.
- * @return Pointer to the next token or NULL if no more tokens.
+ * Create a pool of preallocated objects.
+ * @param count Number of objects to preallocate (at most 65535)
+ * @param size Size of each object
+ * @return New object pool or NULL if out of memory (error message logged)
+ *
+ * Objects can be taken from and returned to the pool by any thread without
+ * locking or allocating memory, as long as the pool isn't exhausted.
  */
-char *fluid_strtok(char **str, char *delim)
+fluid_pool_t *
+new_fluid_pool(int count, int size)
 {
-    char *s, *d, *token;
-    char c;
+    fluid_pool_t *pool;
+    int i;
 
-    if(str == NULL || delim == NULL || !*delim)
-    {
-        FLUID_LOG(FLUID_ERR, "Null pointer");
-        return NULL;
-    }
+    fluid_return_val_if_fail(count > 0 && count <= (int)FLUID_POOL_INDEX_MASK, NULL);
+    fluid_return_val_if_fail(size > 0, NULL);
 
-    s = *str;
+    pool = FLUID_NEW(fluid_pool_t);
 
-    if(!s)
+    if(pool == NULL)
     {
-        return NULL;    /* str points to a NULL pointer? (tokenize already ended) */
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
     }
 
-    /* skip delimiter chars at beginning of token */
-    do
-    {
-        c = *s;
-
-        if(!c)	/* end of source string? */
-        {
-            *str = NULL;
-            return NULL;
-        }
+    FLUID_MEMSET(pool, 0, sizeof(*pool));
 
-        for(d = delim; *d; d++)	/* is source char a token char? */
-        {
-            if(c == *d)	/* token char match? */
-            {
-                s++;		/* advance to next source char */
-                break;
-            }
-        }
-    }
-    while(*d);		/* while token char match */
+    /* keep the objects aligned like memory returned by malloc() */
+    size = (size + FLUID_POOL_ALIGNMENT - 1) & ~(FLUID_POOL_ALIGNMENT - 1);
 
-    token = s;		/* start of token found */
+    pool->data = FLUID_ARRAY(char, count * size);
+    pool->next = FLUID_ARRAY(fluid_atomic_int_t, count);
 
-    /* search for next token char or end of source string */
-    for(s = s + 1; *s; s++)
+    if(pool->data == NULL || pool->next == NULL)
     {
-        c = *s;
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_pool(pool);
+        return NULL;
+    }
 
-        for(d = delim; *d; d++)	/* is source char a token char? */
-        {
-            if(c == *d)	/* token char match? */
-            {
-                *s = '\0';	/* overwrite token char with zero byte to terminate token */
-                *str = s + 1;	/* update str to point to beginning of next token */
-                return token;
-            }
-        }
+    for(i = 0; i < count; i++)
+    {
+        fluid_atomic_int_set(&pool->next[i], (i + 2 <= count) ? i + 2 : 0);
     }
 
-    /* we get here only if source string ended */
-    *str = NULL;
-    return token;
+    fluid_atomic_int_set(&pool->head, 1);
+    pool->count = count;
+    pool->size = size;
+
+    return pool;
 }
 
 /**
- * Suspend the execution of the current thread for the specified amount of time.
- * @param milliseconds to wait.
+ * Free a pool. All objects must have been returned to it.
+ * @param pool Object pool
  */
-void fluid_msleep(unsigned int msecs)
+void
+delete_fluid_pool(fluid_pool_t *pool)
 {
-    g_usleep(msecs * 1000);
+    fluid_return_if_fail(pool != NULL);
+    FLUID_FREE(pool->data);
+    FLUID_FREE(pool->next);
+    FLUID_FREE(pool);
 }
 
 /**
- * Get time in milliseconds to be used in relative timing operations.
- * @return Monotonic time in milliseconds.
+ * Take an object from the pool. May be called from any thread.
+ * @param pool Object pool
+ * @return Uninitialized object, or NULL if out of memory
+ *
+ * If the pool is exhausted, the object is allocated from the heap.
  */
-unsigned int fluid_curtime(void)
+void *
+fluid_pool_alloc(fluid_pool_t *pool)
 {
-    float now;
-    static float initial_time = 0;
+    unsigned int head, index, next;
 
-    if(initial_time == 0)
+    do
     {
-        initial_time = (float)fluid_utime();
-    }
+        head = (unsigned int)fluid_atomic_int_get(&pool->head);
+        index = head & FLUID_POOL_INDEX_MASK;
 
-    now = (float)fluid_utime();
+        if(index == 0)
+        {
+            FLUID_LOG(FLUID_DBG, "Object pool exhausted, allocating from the heap");
+            return FLUID_MALLOC(pool->size);
+        }
 
-    return (unsigned int)((now - initial_time) / 1000.0f);
+        next = (unsigned int)fluid_atomic_int_get(&pool->next[index - 1]);
+    }
+    while(!fluid_atomic_int_compare_and_exchange(&pool->head, (int)head,
+            (int)(((head & ~FLUID_POOL_INDEX_MASK) + FLUID_POOL_TAG_INCR) | next)));
+
+    return pool->data + (index - 1) * pool->size;
 }
 
 /**
- * Get time in microseconds to be used in relative timing operations.
+ * Return an object to the pool it was taken from. May be called from any thread.
+ * @param pool Object pool
+ * @param obj Object returned by fluid_pool_alloc() of this pool, may be NULL
+ */
+void
+fluid_pool_free(fluid_pool_t *pool, void *obj)
+{
+    char *data = pool->data;
+    unsigned int head, index;
+
+    if(obj == NULL)
+    {
+        return;
+    }
+
+    if((char *)obj < data || (char *)obj >= data + pool->count * pool->size)
+    {
+        /* allocated from the heap because the pool was exhausted */
+        FLUID_FREE(obj);
+        return;
+    }
+
+    index = (unsigned int)(((char *)obj - data) / pool->size) + 1;
+
+    do
+    {
+        head = (unsigned int)fluid_atomic_int_get(&pool->head);
+        fluid_atomic_int_set(&pool->next[index - 1], (int)(head & FLUID_POOL_INDEX_MASK));
+    }
+    while(!fluid_atomic_int_compare_and_exchange(&pool->head, (int)head,
+            (int)(((head & ~FLUID_POOL_INDEX_MASK) + FLUID_POOL_TAG_INCR) | index)));
+}
+
+/* Arena of objects freed all at once
+ *
+ * The objects are carved out of large blocks one after the other, so that objects
+ * allocated together are stored next to each other in memory.
+ */
+#define FLUID_ARENA_ALIGNMENT 16
+
+typedef struct _fluid_arena_block_t fluid_arena_block_t;
+
+struct _fluid_arena_block_t
+{
+    fluid_arena_block_t *next;    /**< Next block, allocated before this one */
+    size_t size;                  /**< Size of the objects of this block */
+    size_t used;                  /**< Bytes taken by the objects so far */
+};
+
+/* the objects of a block follow its header, keeping them aligned */
+#define FLUID_ARENA_BLOCK_HEADER \
+    ((sizeof(fluid_arena_block_t) + FLUID_ARENA_ALIGNMENT - 1) & ~(size_t)(FLUID_ARENA_ALIGNMENT - 1))
+
+struct _fluid_arena_t
+{
+    fluid_arena_block_t *blocks;  /**< Block the objects are taken from, followed by the full ones */
+    size_t block_size;
+};
+
+/**
+ * Create an arena of objects.
+ * @param block_size Size of the blocks the objects are taken from
+ * @return New arena or NULL if out of memory (error message logged)
+ *
+ * The objects of an arena cannot be freed on their own, they are freed together
+ * with the arena. An arena is not thread safe.
+ */
+fluid_arena_t *
+new_fluid_arena(int block_size)
+{
+    fluid_arena_t *arena;
+
+    fluid_return_val_if_fail(block_size > 0, NULL);
+
+    arena = FLUID_NEW(fluid_arena_t);
+
+    if(arena == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    arena->blocks = NULL;
+    arena->block_size = (size_t)block_size;
+
+    return arena;
+}
+
+/**
+ * Free an arena and all of its objects.
+ * @param arena Arena, may be NULL
+ */
+void
+delete_fluid_arena(fluid_arena_t *arena)
+{
+    fluid_arena_block_t *block;
+
+    fluid_return_if_fail(arena != NULL);
+
+    while(arena->blocks != NULL)
+    {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        FLUID_FREE(block);
+    }
+
+    FLUID_FREE(arena);
+}
+
+/**
+ * Take an object from an arena.
+ * @param arena Arena
+ * @param size Size of the object
+ * @return Uninitialized object, aligned like memory returned by malloc(), or NULL
+ *   if out of memory (error message logged)
+ */
+void *
+fluid_arena_alloc(fluid_arena_t *arena, size_t size)
+{
+    fluid_arena_block_t *block = arena->blocks;
+    void *obj;
+
+    size = (size + FLUID_ARENA_ALIGNMENT - 1) & ~(size_t)(FLUID_ARENA_ALIGNMENT - 1);
+
+    if(block == NULL || block->size - block->used < size)
+    {
+        /* objects larger than a quarter of a block get a block of their own,
+         * so that the rest of the current block isn't wasted */
+        size_t block_size = (size > arena->block_size / 4) ? size : arena->block_size;
+
+        block = FLUID_MALLOC(FLUID_ARENA_BLOCK_HEADER + block_size);
+
+        if(block == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
+
+        block->size = block_size;
+        block->used = 0;
+
+        if(block_size == arena->block_size || arena->blocks == NULL)
+        {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+        else
+        {
+            /* keep taking the next objects from the current block */
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+    }
+
+    obj = (char *)block + FLUID_ARENA_BLOCK_HEADER + block->used;
+    block->used += size;
+
+    return obj;
+}
+
+/**
+ * Copy a string into an arena.
+ * @param arena Arena
+ * @param str String to copy
+ * @return Copy of the string, or NULL if out of memory (error message logged)
+ */
+char *
+fluid_arena_strdup(fluid_arena_t *arena, const char *str)
+{
+    size_t size = FLUID_STRLEN(str) + 1;
+    char *copy = fluid_arena_alloc(arena, size);
+
+    if(copy != NULL)
+    {
+        FLUID_MEMCPY(copy, str, size);
+    }
+
+    return copy;
+}
+
+/**
+ * Get the memory taken by an arena.
+ * @param arena Arena
+ * @return Bytes of its blocks, including the ones not taken by objects yet
+ */
+size_t
+fluid_arena_get_size(const fluid_arena_t *arena)
+{
+    const fluid_arena_block_t *block;
+    size_t size = sizeof(*arena);
+
+    for(block = arena->blocks; block != NULL; block = block->next)
+    {
+        size += FLUID_ARENA_BLOCK_HEADER + block->size;
+    }
+
+    return size;
+}
+
+/**
+ * An improved strtok, still trashes the input string, but is portable and
+ * thread safe.  Also skips token chars at beginning of token string and never
+ * returns an empty token (will return NULL if source ends in token chars though).
+ * NOTE: NOT part of public API
+ * @internal
+ * @param str Pointer to a string pointer of source to tokenize.  Pointer gets
+ *   updated on each invocation to point to beginning of next token.  Note that
+ *   token char gets overwritten with a 0 byte.  String pointer is set to NULL
+ *   when final token is returned.
+ * @param delim String of delimiter chars.
+ * @return Pointer to the next token or NULL if no more tokens.
+ */
+char *fluid_strtok(char **str, char *delim)
+{
+    char *s, *d, *token;
+    char c;
+
+    if(str == NULL || delim == NULL || !*delim)
+    {
+        FLUID_LOG(FLUID_ERR, "Null pointer");
+        return NULL;
+    }
+
+    s = *str;
+
+    if(!s)
+    {
+        return NULL;    /* str points to a NULL pointer? (tokenize already ended) */
+    }
+
+    /* skip delimiter chars at beginning of token */
+    do
+    {
+        c = *s;
+
+        if(!c)	/* end of source string? */
+        {
+            *str = NULL;
+            return NULL;
+        }
+
+        for(d = delim; *d; d++)	/* is source char a token char? */
+        {
+            if(c == *d)	/* token char match? */
+            {
+                s++;		/* advance to next source char */
+                break;
+            }
+        }
+    }
+    while(*d);		/* while token char match */
+
+    token = s;		/* start of token found */
+
+    /* search for next token char or end of source string */
+    for(s = s + 1; *s; s++)
+    {
+        c = *s;
+
+        for(d = delim; *d; d++)	/* is source char a token char? */
+        {
+            if(c == *d)	/* token char match? */
+            {
+                *s = '\0';	/* overwrite token char with zero byte to terminate token */
+                *str = s + 1;	/* update str to point to beginning of next token */
+                return token;
+            }
+        }
+    }
+
+    /* we get here only if source string ended */
+    *str = NULL;
+    return token;
+}
+
+/**
+ * Suspend the execution of the current thread for the specified amount of time.
+ * @param milliseconds to wait.
+ */
+void fluid_msleep(unsigned int msecs)
+{
+    g_usleep(msecs * 1000);
+}
+
+/**
+ * Suspend the execution of the current thread for the specified amount of time.
+ * @param microseconds to wait.
+ */
+void fluid_usleep(unsigned int usecs)
+{
+    g_usleep(usecs);
+}
+
+/**
+ * Get time in milliseconds to be used in relative timing operations.
+ * @return Monotonic time in milliseconds.
+ */
+unsigned int fluid_curtime(void)
+{
+    float now;
+    static float initial_time = 0;
+
+    if(initial_time == 0)
+    {
+        initial_time = (float)fluid_utime();
+    }
+
+    now = (float)fluid_utime();
+
+    return (unsigned int)((now - initial_time) / 1000.0f);
+}
+
+/**
+ * Get time in microseconds to be used in relative timing operations.
  * @return time in microseconds.
  * Note: When used for profiling we need high precision clock given
  * by g_get_monotonic_time()if available (glib version >= 2.53.3).
@@ -392,6 +1055,19 @@ fluid_thread_self_set_prio(int prio_level)
     }
 }
 
+int
+fluid_thread_self_set_affinity(int core)
+{
+    if(core < 0 || core >= (int)(sizeof(DWORD_PTR) * 8)
+            || SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) == 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to pin thread to CPU core %d", core);
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
 
 #elif defined(__OS2__)  /* OS/2 specific stuff */
 
@@ -404,6 +1080,13 @@ fluid_thread_self_set_prio(int prio_level)
     }
 }
 
+int
+fluid_thread_self_set_affinity(int core)
+{
+    FLUID_LOG(FLUID_WARN, "Pinning threads to CPU cores is not supported on this platform");
+    return FLUID_FAILED;
+}
+
 #else   /* POSIX stuff..  Nice POSIX..  Good POSIX. */
 
 void
@@ -435,6 +1118,30 @@ fluid_thread_self_set_prio(int prio_level)
     }
 }
 
+int
+fluid_thread_self_set_affinity(int core)
+{
+#if defined(__linux__) && HAVE_PTHREAD_H
+    cpu_set_t cpus;
+
+    if(core >= 0 && core < CPU_SETSIZE)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0)
+        {
+            return FLUID_OK;
+        }
+    }
+
+    FLUID_LOG(FLUID_WARN, "Failed to pin thread to CPU core %d", core);
+#else
+    FLUID_LOG(FLUID_WARN, "Pinning threads to CPU cores is not supported on this platform");
+#endif
+    return FLUID_FAILED;
+}
+
 #ifdef FPE_CHECK
 
 /***************************************************************
@@ -510,32 +1217,375 @@ void fluid_clear_fpe_i386(void)
 
 /***************************************************************
  *
- *               Profiling (Linux, i586 only)
+ *               Denormals
  *
  */
 
-#if WITH_PROFILING
-/* Profiling interface between profiling command shell and audio rendering API
-  (FluidProfile_0004.pdf- 3.2.2).
-  Macros are in defined in fluid_sys.h.
-*/
-
-/*
-  -----------------------------------------------------------------------------
-  Shell task side |    Profiling interface              |  Audio task side
-  -----------------------------------------------------------------------------
-  profiling       |    Internal    |      |             |      Audio
-  command   <---> |<-- profling -->| Data |<--macros -->| <--> rendering
-  shell           |    API         |      |             |      API
+/* MXCSR flags: flush to zero, denormals are zero */
+#define FLUID_MXCSR_FTZ 0x8000
+#define FLUID_MXCSR_DAZ 0x0040
 
-*/
-/* default parameters for shell command "prof_start" in fluid_sys.c */
-unsigned short fluid_profile_notes = 0; /* number of generated notes */
-/* preset bank:0 prog:16 (organ) */
-unsigned char fluid_profile_bank = FLUID_PROFILE_DEFAULT_BANK;
-unsigned char fluid_profile_prog = FLUID_PROFILE_DEFAULT_PROG;
+/* FPCR flag: flush to zero */
+#define FLUID_FPCR_FZ (1 << 24)
 
-/* print mode */
+/**
+ * Make the floating point unit flush denormal numbers to zero for the calling
+ * thread, so that decaying signals don't slow down the processing once they
+ * get very close to zero. Sets the FTZ and DAZ flags of the SSE control
+ * register on x86, or the FZ flag of the FPCR on AArch64.
+ *
+ * @param enable TRUE to flush denormals to zero, FALSE for their regular handling
+ * @param state location to store the previous state, to pass to
+ *   fluid_thread_self_restore_denormals(), or NULL
+ * @return FLUID_OK, FLUID_FAILED if not supported on this platform
+ */
+int
+fluid_thread_self_flush_denormals(int enable, unsigned int *state)
+{
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    unsigned int csr = _mm_getcsr();
+
+    if(state != NULL)
+    {
+        *state = csr;
+    }
+
+    if(enable)
+    {
+        _mm_setcsr(csr | FLUID_MXCSR_FTZ | FLUID_MXCSR_DAZ);
+    }
+    else
+    {
+        _mm_setcsr(csr & ~(FLUID_MXCSR_FTZ | FLUID_MXCSR_DAZ));
+    }
+
+    return FLUID_OK;
+#elif defined(__aarch64__) && defined(__GNUC__)
+    uint64_t fpcr;
+
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+
+    if(state != NULL)
+    {
+        *state = (unsigned int)fpcr;
+    }
+
+    fpcr = enable ? (fpcr | FLUID_FPCR_FZ) : (fpcr & ~(uint64_t)FLUID_FPCR_FZ);
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+
+    return FLUID_OK;
+#else
+    return FLUID_FAILED;
+#endif
+}
+
+/**
+ * Restore the handling of denormal numbers of the calling thread.
+ * @param state state returned by fluid_thread_self_flush_denormals()
+ */
+void
+fluid_thread_self_restore_denormals(unsigned int state)
+{
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    _mm_setcsr(state);
+#elif defined(__aarch64__) && defined(__GNUC__)
+    uint64_t fpcr = state;
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+#endif
+}
+
+
+/***************************************************************
+ *
+ *               Audio workgroups
+ *
+ */
+
+/**
+ * Let the calling thread join an audio workgroup of the system, so that it is
+ * scheduled along with the realtime thread of the audio device, e.g. onto the
+ * performance cores of Apple Silicon. Only os_workgroup of macOS 11 and iOS 14
+ * is supported.
+ *
+ * @param workgroup os_workgroup_t of the device
+ * @param token location to store the token to pass to fluid_thread_self_leave_workgroup()
+ * @return FLUID_OK, FLUID_FAILED if not joined or not supported on this platform
+ */
+int
+fluid_thread_self_join_workgroup(void *workgroup, void **token)
+{
+#if FLUID_HAVE_OS_WORKGROUP
+
+    if(__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+    {
+        os_workgroup_join_token_s *join_token = FLUID_NEW(os_workgroup_join_token_s);
+
+        if(join_token == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        if(os_workgroup_join((os_workgroup_t) workgroup, join_token) == 0)
+        {
+            *token = join_token;
+            return FLUID_OK;
+        }
+
+        FLUID_FREE(join_token);
+    }
+
+#endif
+    return FLUID_FAILED;
+}
+
+/**
+ * Let the calling thread leave the audio workgroup it joined.
+ * @param workgroup the workgroup given to fluid_thread_self_join_workgroup()
+ * @param token the token returned by fluid_thread_self_join_workgroup()
+ */
+void
+fluid_thread_self_leave_workgroup(void *workgroup, void *token)
+{
+#if FLUID_HAVE_OS_WORKGROUP
+
+    if(__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+    {
+        os_workgroup_leave((os_workgroup_t) workgroup, (os_workgroup_join_token_t) token);
+    }
+
+    FLUID_FREE(token);
+#endif
+}
+
+
+/***************************************************************
+ *
+ *               CPU features
+ *
+ */
+
+/* Names of the CPU features, in the order of enum fluid_cpu_feature */
+static const char *const fluid_cpu_feature_names[] = { "sse2", "avx2", "avx512f", "neon", "simd128" };
+
+static unsigned int fluid_cpu_detected_features = 0;
+
+/* The CPU features detected, followed by the variants of the DSP kernels selected */
+static char fluid_cpu_dispatch_buf[256];
+
+static unsigned int
+fluid_cpu_detect(void)
+{
+    unsigned int features = 0;
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    /* cpuid, AVX only if the OS saves the YMM and ZMM registers */
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("sse2"))
+    {
+        features |= FLUID_CPU_SSE2;
+    }
+
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        features |= FLUID_CPU_AVX2;
+    }
+
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        features |= FLUID_CPU_AVX512F;
+    }
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+
+    __cpuid(info, 1);
+
+    if(info[3] & (1 << 26))
+    {
+        features |= FLUID_CPU_SSE2;
+    }
+
+    /* OSXSAVE, and the OS saves the XMM and YMM registers */
+    if((info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        int fma = info[2] & (1 << 12);
+
+        __cpuidex(info, 7, 0);
+
+        if(fma && (info[1] & (1 << 5)))
+        {
+            features |= FLUID_CPU_AVX2;
+        }
+
+        /* the ZMM registers and opmasks as well */
+        if((info[1] & (1 << 16)) && (_xgetbv(0) & 0xe6) == 0xe6)
+        {
+            features |= FLUID_CPU_AVX512F;
+        }
+    }
+
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    /* Advanced SIMD is part of ARMv8-A */
+    features |= FLUID_CPU_NEON;
+
+#elif defined(__ARM_NEON)
+    features |= FLUID_CPU_NEON;
+
+#elif defined(__wasm_simd128__)
+    /* a module using SIMD128 doesn't even validate without it */
+    features |= FLUID_CPU_SIMD128;
+
+#elif defined(FLUID_HAVE_GETAUXVAL)
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+
+    if(getauxval(AT_HWCAP) & HWCAP_NEON)
+    {
+        features |= FLUID_CPU_NEON;
+    }
+
+#endif
+
+    return features;
+}
+
+/*
+ * Restrict the features detected to those listed in the environment variable
+ * FLUID_CPU_FEATURES, comma separated, e.g. "sse2,avx2", or "none" for the
+ * generic kernels. Features the CPU lacks cannot be turned on.
+ */
+static unsigned int
+fluid_cpu_override(unsigned int features)
+{
+    const char *env = getenv("FLUID_CPU_FEATURES");
+    const char *item, *end;
+    unsigned int allowed = 0;
+    unsigned int i;
+
+    if(env == NULL)
+    {
+        return features;
+    }
+
+    for(item = env; *item != '\0'; item = (*end == ',') ? end + 1 : end)
+    {
+        end = FLUID_STRCHR(item, ',');
+
+        if(end == NULL)
+        {
+            end = item + FLUID_STRLEN(item);
+        }
+
+        for(i = 0; i < FLUID_N_ELEMENTS(fluid_cpu_feature_names); i++)
+        {
+            if(FLUID_STRLEN(fluid_cpu_feature_names[i]) == (size_t)(end - item)
+                    && FLUID_STRNCMP(item, fluid_cpu_feature_names[i], end - item) == 0)
+            {
+                allowed |= 1u << i;
+            }
+        }
+    }
+
+    FLUID_LOG(FLUID_INFO, "CPU features restricted to '%s' by FLUID_CPU_FEATURES", env);
+
+    return features & allowed;
+}
+
+/**
+ * Detect the features of the CPU the DSP kernels are selected for, once
+ * before any of them is selected. Called by fluid_synth_init().
+ */
+void
+fluid_cpu_dispatch_init(void)
+{
+    unsigned int i;
+    int len = 0;
+
+    fluid_cpu_detected_features = fluid_cpu_override(fluid_cpu_detect());
+
+    for(i = 0; i < FLUID_N_ELEMENTS(fluid_cpu_feature_names); i++)
+    {
+        if(fluid_cpu_detected_features & (1u << i))
+        {
+            len += FLUID_SNPRINTF(fluid_cpu_dispatch_buf + len, sizeof(fluid_cpu_dispatch_buf) - len,
+                                  "%s%s", (len == 0) ? "cpu=" : ",", fluid_cpu_feature_names[i]);
+        }
+    }
+
+    if(len == 0)
+    {
+        FLUID_STRCPY(fluid_cpu_dispatch_buf, "cpu=none");
+    }
+}
+
+/**
+ * Get the features of the CPU the DSP kernels may use, see #fluid_cpu_feature.
+ */
+unsigned int
+fluid_cpu_features(void)
+{
+    return fluid_cpu_detected_features;
+}
+
+/**
+ * Record the variant of a DSP kernel selected for the CPU, to be reported by
+ * fluid_cpu_dispatch_str(). Called by the DSP modules from fluid_synth_init().
+ *
+ * @param kernel name of the kernel, e.g. "mix"
+ * @param variant name of the variant, e.g. "avx2" or "generic"
+ */
+void
+fluid_cpu_dispatch_register(const char *kernel, const char *variant)
+{
+    size_t len = FLUID_STRLEN(fluid_cpu_dispatch_buf);
+
+    FLUID_LOG(FLUID_DBG, "Using the %s variant of the %s kernel", variant, kernel);
+    FLUID_SNPRINTF(fluid_cpu_dispatch_buf + len, sizeof(fluid_cpu_dispatch_buf) - len,
+                   " %s=%s", kernel, variant);
+}
+
+/**
+ * Get the CPU features detected and the variants of the DSP kernels selected,
+ * e.g. "cpu=sse2,avx2 mix=avx2 interp=avx2".
+ */
+const char *
+fluid_cpu_dispatch_str(void)
+{
+    return fluid_cpu_dispatch_buf;
+}
+
+
+/***************************************************************
+ *
+ *               Profiling (Linux, i586 only)
+ *
+ */
+
+#if WITH_PROFILING
+/* Profiling interface between profiling command shell and audio rendering API
+  (FluidProfile_0004.pdf- 3.2.2).
+  Macros are in defined in fluid_sys.h.
+*/
+
+/*
+  -----------------------------------------------------------------------------
+  Shell task side |    Profiling interface              |  Audio task side
+  -----------------------------------------------------------------------------
+  profiling       |    Internal    |      |             |      Audio
+  command   <---> |<-- profling -->| Data |<--macros -->| <--> rendering
+  shell           |    API         |      |             |      API
+
+*/
+/* default parameters for shell command "prof_start" in fluid_sys.c */
+unsigned short fluid_profile_notes = 0; /* number of generated notes */
+/* preset bank:0 prog:16 (organ) */
+unsigned char fluid_profile_bank = FLUID_PROFILE_DEFAULT_BANK;
+unsigned char fluid_profile_prog = FLUID_PROFILE_DEFAULT_PROG;
+
+/* print mode */
 unsigned char fluid_profile_print = FLUID_PROFILE_DEFAULT_PRINT;
 /* number of measures */
 unsigned short fluid_profile_n_prof = FLUID_PROFILE_DEFAULT_N_PROF;
@@ -563,6 +1613,10 @@ fluid_profile_data_t fluid_profile_data[] =        /* Data duration */
     {"voice:release ------------>", 1e10, 0.0, 0.0, 0, 0, 0}
 };
 
+/* Voices data per preset */
+fluid_profile_preset_t fluid_profile_preset_data[FLUID_PROFILE_PRESET_MAX];
+int fluid_profile_preset_count = 0;
+
 
 /*----------------------------------------------
   Internal profiling API
@@ -687,62 +1741,208 @@ static void fluid_profiling_print_load(double sample_rate, fluid_ostream_t out)
 }
 
 /*
-* prints profiling data (used by profile shell command: prof_start).
-* The function is an internal profiling API between the "profile" command
-* prof_start and audio rendering API (see FluidProfile_0004.pdf - 3.2.2).
-*
-* @param sample_rate the sample rate of audio output.
-* @param out output stream device.
+* Returns the index of a preset in the profiling data per preset, adding the
+* preset if it isn't known yet. Called when a voice is started, the time spent
+* rendering the voice is then charged to that preset.
 *
-* When print mode is 1, the function prints all the information (see below).
-* When print mode is 0, the function prints only the cpu loads.
-*
-* ------------------------------------------------------------------------------
-* Duration(microsecond) and cpu loads(%) (sr: 44100 Hz, sp: 22.68 microsecond)
-* ------------------------------------------------------------------------------
-* Code under profiling       |Voices|       Duration (microsecond)   |  Load(%)
-*                            |   nbr|       min|       avg|       max|
-* ---------------------------|------|--------------------------------|----------
-* synth_write_* ------------>|   250|      3.91|   2188.82|   3275.00|  41.544
-* synth_one_block ---------->|   250|   1150.70|   2273.56|   3241.47|  41.100
-* synth_one_block:clear ---->|   250|      3.07|      4.62|     61.18|   0.084
-* synth_one_block:one voice->|     1|      4.19|      9.02|   1044.27|   0.163
-* synth_one_block:all voices>|   250|   1138.41|   2259.11|   3217.73|  40.839
-* synth_one_block:reverb --->| no profiling available
-* synth_one_block:chorus --->| no profiling available
-* voice:note --------------->| no profiling available
-* voice:release ------------>| no profiling available
-* ------------------------------------------------------------------------------
-* Cpu loads(%) (sr: 44100 Hz, sp: 22.68 microsecond) and maximum voices
-* ------------------------------------------------------------------------------
-* nVoices| total(%)|voices(%)| reverb(%)|chorus(%)| voice(%)|estimated maxVoices
-* -------|---------|---------|----------|---------|---------|-------------------
-*     250|   41.544|   41.544|     0.000|    0.000|    0.163|              612
+* @return the index of the preset in fluid_profile_preset_data, -1 if there
+* is no room left for a new preset.
 */
-void fluid_profiling_print_data(double sample_rate, fluid_ostream_t out)
+int fluid_profile_preset_index(int sfont_id, int bank, int prog, const char *name)
 {
+    fluid_profile_preset_t *preset;
     int i;
 
-    if(fluid_profile_print)
+    if(name == NULL)
     {
-        /* print all details: Duration(microsecond) and cpu loads(%) */
-        fluid_ostream_printf(out,
-                             " ------------------------------------------------------------------------------\n");
-        fluid_ostream_printf(out,
-                             " Duration(microsecond) and cpu loads(%%) (sr:%6.0f Hz, sp:%6.2f microsecond)\n",
-                             sample_rate, 1000000.0 / sample_rate);
-        fluid_ostream_printf(out,
-                             " ------------------------------------------------------------------------------\n");
-        fluid_ostream_printf(out,
-                             " Code under profiling       |Voices|       Duration (microsecond)   |  Load(%%)\n");
-        fluid_ostream_printf(out,
-                             "                            |   nbr|       min|       avg|       max|\n");
-        fluid_ostream_printf(out,
-                             " ---------------------------|------|--------------------------------|----------\n");
+        name = "";
+    }
 
-        for(i = 0; i < FLUID_PROFILE_NBR; i++)
-        {
-            unsigned int count = fluid_profile_data[i].count;
+    for(i = 0; i < fluid_profile_preset_count; i++)
+    {
+        preset = &fluid_profile_preset_data[i];
+
+        if(preset->sfont_id == sfont_id && preset->bank == bank && preset->prog == prog
+                && FLUID_STRNCMP(preset->name, name, sizeof(preset->name) - 1) == 0)
+        {
+            return i;
+        }
+    }
+
+    if(fluid_profile_preset_count >= FLUID_PROFILE_PRESET_MAX)
+    {
+        return -1;
+    }
+
+    preset = &fluid_profile_preset_data[fluid_profile_preset_count];
+    FLUID_MEMSET(preset, 0, sizeof(*preset));
+    preset->sfont_id = sfont_id;
+    preset->bank = bank;
+    preset->prog = prog;
+    FLUID_STRNCPY(preset->name, name, sizeof(preset->name));
+
+    return fluid_profile_preset_count++;
+}
+
+/* Returns the voice load (%) of a preset for the given stages */
+static double fluid_profile_preset_load(const fluid_profile_preset_t *preset,
+                                        int first_stage, int last_stage,
+                                        double sample_rate)
+{
+    double total = 0;
+    int i;
+
+    for(i = first_stage; i <= last_stage; i++)
+    {
+        total += preset->total[i];
+    }
+
+    return fluid_profile_load(total, sample_rate, preset->n_samples);
+}
+
+/* prints the voice loads per preset, the most expensive preset first
+*
+* @param sample_rate the sample rate of audio output.
+* @param out output stream device.
+*
+* For each preset, the loads are those of one of its voices, i.e. the average
+* number of its voices that were playing at once is not taken into account.
+* Each stage of the rendering is printed separately: envelopes, LFOs and
+* amplitude (env), interpolation (interp), resonant filters (filter) and
+* mixing into the output buffers (mix).
+*
+* ------------------------------------------------------------------------------
+* Voice loads(%) per preset, voices: average number of voices playing at once
+* ------------------------------------------------------------------------------
+*  sf|bank|prog|preset              |voices|   env|interp|filter|   mix|voice(%)
+* ---|----|----|--------------------|------|------|------|------|------|--------
+*   1|   0|  16|Drawbar Organ       | 248.5| 0.012| 0.098| 0.036| 0.017|   0.163
+*/
+static void fluid_profiling_print_presets(double sample_rate, fluid_ostream_t out)
+{
+    int order[FLUID_PROFILE_PRESET_MAX];
+    const fluid_profile_preset_t *preset;
+    unsigned int n_samples;
+    int i, k, n = 0;
+
+    /* the presets with voices rendered, sorted by decreasing voice load */
+    for(i = 0; i < fluid_profile_preset_count; i++)
+    {
+        double load;
+
+        if(fluid_profile_preset_data[i].n_samples == 0)
+        {
+            continue;
+        }
+
+        load = fluid_profile_preset_load(&fluid_profile_preset_data[i], 0,
+                                         FLUID_PROF_STAGE_NBR - 1, sample_rate);
+
+        for(k = n++; k > 0 && fluid_profile_preset_load(&fluid_profile_preset_data[order[k - 1]], 0,
+                FLUID_PROF_STAGE_NBR - 1, sample_rate) < load; k--)
+        {
+            order[k] = order[k - 1];
+        }
+
+        order[k] = i;
+    }
+
+    if(n == 0)
+    {
+        return;
+    }
+
+    /* audio samples number of all the blocks rendered */
+    n_samples = fluid_profile_data[FLUID_PROF_ONE_BLOCK_VOICES].n_samples;
+
+    fluid_ostream_printf(out,
+                         " ------------------------------------------------------------------------------\n");
+    fluid_ostream_printf(out,
+                         " Voice loads(%%) per preset, voices: average number of voices playing at once\n");
+    fluid_ostream_printf(out,
+                         " ------------------------------------------------------------------------------\n");
+    fluid_ostream_printf(out,
+                         "  sf|bank|prog|preset              |voices|   env|interp|filter|   mix|voice(%%)\n");
+    fluid_ostream_printf(out,
+                         " ---|----|----|--------------------|------|------|------|------|------|--------\n");
+
+    for(i = 0; i < n; i++)
+    {
+        preset = &fluid_profile_preset_data[order[i]];
+        fluid_ostream_printf(out, " %3d|%4d|%4d|%-20.20s|%6.1f|%6.3f|%6.3f|%6.3f|%6.3f|%8.3f\n",
+                             preset->sfont_id, preset->bank, preset->prog, preset->name,
+                             n_samples ? (double)preset->n_samples / n_samples : 0.0,
+                             fluid_profile_preset_load(preset, FLUID_PROF_STAGE_ENV,
+                                                       FLUID_PROF_STAGE_ENV, sample_rate),
+                             fluid_profile_preset_load(preset, FLUID_PROF_STAGE_INTERP,
+                                                       FLUID_PROF_STAGE_INTERP, sample_rate),
+                             fluid_profile_preset_load(preset, FLUID_PROF_STAGE_FILTER,
+                                                       FLUID_PROF_STAGE_FILTER, sample_rate),
+                             fluid_profile_preset_load(preset, FLUID_PROF_STAGE_MIX,
+                                                       FLUID_PROF_STAGE_MIX, sample_rate),
+                             fluid_profile_preset_load(preset, 0, FLUID_PROF_STAGE_NBR - 1,
+                                                       sample_rate));
+    }
+}
+
+/*
+* prints profiling data (used by profile shell command: prof_start).
+* The function is an internal profiling API between the "profile" command
+* prof_start and audio rendering API (see FluidProfile_0004.pdf - 3.2.2).
+*
+* @param sample_rate the sample rate of audio output.
+* @param out output stream device.
+*
+* When print mode is 1, the function prints all the information (see below),
+* followed by the voice loads per preset (see fluid_profiling_print_presets()).
+* When print mode is 0, the function prints only the cpu loads.
+*
+* ------------------------------------------------------------------------------
+* Duration(microsecond) and cpu loads(%) (sr: 44100 Hz, sp: 22.68 microsecond)
+* ------------------------------------------------------------------------------
+* Code under profiling       |Voices|       Duration (microsecond)   |  Load(%)
+*                            |   nbr|       min|       avg|       max|
+* ---------------------------|------|--------------------------------|----------
+* synth_write_* ------------>|   250|      3.91|   2188.82|   3275.00|  41.544
+* synth_one_block ---------->|   250|   1150.70|   2273.56|   3241.47|  41.100
+* synth_one_block:clear ---->|   250|      3.07|      4.62|     61.18|   0.084
+* synth_one_block:one voice->|     1|      4.19|      9.02|   1044.27|   0.163
+* synth_one_block:all voices>|   250|   1138.41|   2259.11|   3217.73|  40.839
+* synth_one_block:reverb --->| no profiling available
+* synth_one_block:chorus --->| no profiling available
+* voice:note --------------->| no profiling available
+* voice:release ------------>| no profiling available
+* ------------------------------------------------------------------------------
+* Cpu loads(%) (sr: 44100 Hz, sp: 22.68 microsecond) and maximum voices
+* ------------------------------------------------------------------------------
+* nVoices| total(%)|voices(%)| reverb(%)|chorus(%)| voice(%)|estimated maxVoices
+* -------|---------|---------|----------|---------|---------|-------------------
+*     250|   41.544|   41.544|     0.000|    0.000|    0.163|              612
+*/
+void fluid_profiling_print_data(double sample_rate, fluid_ostream_t out)
+{
+    int i;
+
+    if(fluid_profile_print)
+    {
+        /* print all details: Duration(microsecond) and cpu loads(%) */
+        fluid_ostream_printf(out,
+                             " ------------------------------------------------------------------------------\n");
+        fluid_ostream_printf(out,
+                             " Duration(microsecond) and cpu loads(%%) (sr:%6.0f Hz, sp:%6.2f microsecond)\n",
+                             sample_rate, 1000000.0 / sample_rate);
+        fluid_ostream_printf(out,
+                             " ------------------------------------------------------------------------------\n");
+        fluid_ostream_printf(out,
+                             " Code under profiling       |Voices|       Duration (microsecond)   |  Load(%%)\n");
+        fluid_ostream_printf(out,
+                             "                            |   nbr|       min|       avg|       max|\n");
+        fluid_ostream_printf(out,
+                             " ---------------------------|------|--------------------------------|----------\n");
+
+        for(i = 0; i < FLUID_PROFILE_NBR; i++)
+        {
+            unsigned int count = fluid_profile_data[i].count;
 
             if(count > 0)
             {
@@ -778,6 +1978,9 @@ void fluid_profiling_print_data(double sample_rate, fluid_ostream_t out)
                                      " %s| no profiling available\n", fluid_profile_data[i].description);
             }
         }
+
+        /* print the voice loads per preset */
+        fluid_profiling_print_presets(sample_rate, out);
     }
 
     /* prints cpu loads only */
@@ -905,6 +2108,16 @@ void fluid_profile_start_stop(unsigned int end_ticks, short clear_data)
                     fluid_profile_data[i].n_samples = 0;/* audio samples number */
                 }
 
+            /* Clears the data per preset, the presets stay known to the
+               voices that are playing */
+            if(clear_data == 0)
+                for(i = 0; i < fluid_profile_preset_count; i++)
+                {
+                    FLUID_MEMSET(fluid_profile_preset_data[i].total, 0,
+                                 sizeof(fluid_profile_preset_data[i].total));
+                    fluid_profile_preset_data[i].n_samples = 0;
+                }
+
             fluid_profile_status = PROFILE_START;	/* starts profiling */
         }
 
@@ -1346,6 +2559,11 @@ fluid_ostream_printf(fluid_ostream_t out, const char *format, ...)
     va_list args;
     int len;
 
+    if(out == FLUID_NULL_OSTREAM)
+    {
+        return 0;
+    }
+
     va_start(args, format);
     len = FLUID_VSNPRINTF(buf, 4095, format, args);
     va_end(args);
@@ -1449,118 +2667,70 @@ void fluid_socket_close(fluid_socket_t sock)
     }
 }
 
-static fluid_thread_return_t fluid_server_socket_run(void *data)
+int fluid_socket_recv(fluid_socket_t sock, void *buf, int len)
 {
-    fluid_server_socket_t *server_socket = (fluid_server_socket_t *)data;
-    fluid_socket_t client_socket;
-#ifdef IPV6_SUPPORT
-    struct sockaddr_in6 addr;
-#else
-    struct sockaddr_in addr;
-#endif
+    int n = recv(sock, buf, len, 0);
 
-#ifdef HAVE_INETNTOP
-#ifdef IPV6_SUPPORT
-    char straddr[INET6_ADDRSTRLEN];
+    return (n == SOCKET_ERROR) ? -1 : n;
+}
+
+#ifdef _WIN32
+#define fluid_socket_poll(_fds, _nfds, _msec) WSAPoll(_fds, _nfds, _msec)
 #else
-    char straddr[INET_ADDRSTRLEN];
-#endif /* IPV6_SUPPORT */
-#endif /* HAVE_INETNTOP */
+#define fluid_socket_poll(_fds, _nfds, _msec) poll(_fds, _nfds, _msec)
+#endif
 
-    socklen_t addrlen = sizeof(addr);
+/* Waits up to msec milliseconds for the socket to become readable,
+   returns 1 if it is, 0 on timeout and -1 on error */
+int fluid_socket_wait(fluid_socket_t sock, int msec)
+{
+    struct pollfd fds;
     int r;
-    FLUID_MEMSET((char *)&addr, 0, sizeof(addr));
-
-    FLUID_LOG(FLUID_DBG, "Server listening for connections");
 
-    while(server_socket->cont)
-    {
-        client_socket = accept(server_socket->socket, (struct sockaddr *)&addr, &addrlen);
+    fds.fd = sock;
+    fds.events = POLLIN;
+    fds.revents = 0;
 
-        FLUID_LOG(FLUID_DBG, "New client connection");
+    r = fluid_socket_poll(&fds, 1, msec);
 
-        if(client_socket == INVALID_SOCKET)
+    if(r == SOCKET_ERROR)
+    {
+#ifndef _WIN32
+        if(errno == EINTR)
         {
-            if(server_socket->cont)
-            {
-                FLUID_LOG(FLUID_ERR, "Failed to accept connection: %d", fluid_socket_get_error());
-            }
-
-            server_socket->cont = 0;
-            return FLUID_THREAD_RETURN_VALUE;
+            return 0;
         }
-        else
-        {
-#ifdef HAVE_INETNTOP
-
-#ifdef IPV6_SUPPORT
-            inet_ntop(AF_INET6, &addr.sin6_addr, straddr, sizeof(straddr));
-#else
-            inet_ntop(AF_INET, &addr.sin_addr, straddr, sizeof(straddr));
 #endif
-
-            r = server_socket->func(server_socket->data, client_socket,
-                                    straddr);
-#else
-            r = server_socket->func(server_socket->data, client_socket,
-                                    inet_ntoa(addr.sin_addr));
-#endif
-
-            if(r != 0)
-            {
-                fluid_socket_close(client_socket);
-            }
-        }
+        FLUID_LOG(FLUID_ERR, "Failed to wait for socket input: %d", fluid_socket_get_error());
+        return -1;
     }
 
-    FLUID_LOG(FLUID_DBG, "Server closing");
-
-    return FLUID_THREAD_RETURN_VALUE;
+    return (r > 0) ? 1 : 0;
 }
 
-fluid_server_socket_t *
-new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
+/* Opens a datagram socket receiving on the given port of all interfaces */
+int fluid_udp_socket_open(int port, fluid_socket_t *sock)
 {
-    fluid_server_socket_t *server_socket;
 #ifdef IPV6_SUPPORT
     struct sockaddr_in6 addr;
 #else
     struct sockaddr_in addr;
 #endif
 
-    fluid_socket_t sock;
-
-    fluid_return_val_if_fail(func != NULL, NULL);
-
     if(fluid_socket_init() != FLUID_OK)
     {
-        return NULL;
+        return FLUID_FAILED;
     }
 
 #ifdef IPV6_SUPPORT
-    sock = socket(AF_INET6, SOCK_STREAM, 0);
-
-    if(sock == INVALID_SOCKET)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to create server socket: %d", fluid_socket_get_error());
-        fluid_socket_cleanup();
-        return NULL;
-    }
+    *sock = socket(AF_INET6, SOCK_DGRAM, 0);
 
     FLUID_MEMSET(&addr, 0, sizeof(addr));
     addr.sin6_family = AF_INET6;
     addr.sin6_port = htons((uint16_t)port);
     addr.sin6_addr = in6addr_any;
 #else
-
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-
-    if(sock == INVALID_SOCKET)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to create server socket: %d", fluid_socket_get_error());
-        fluid_socket_cleanup();
-        return NULL;
-    }
+    *sock = socket(AF_INET, SOCK_DGRAM, 0);
 
     FLUID_MEMSET(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -1568,81 +2738,337 @@ new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
 #endif
 
-    if(bind(sock, (const struct sockaddr *) &addr, sizeof(addr)) == SOCKET_ERROR)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to bind server socket: %d", fluid_socket_get_error());
-        fluid_socket_close(sock);
-        fluid_socket_cleanup();
-        return NULL;
-    }
-
-    if(listen(sock, SOMAXCONN) == SOCKET_ERROR)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to listen on server socket: %d", fluid_socket_get_error());
-        fluid_socket_close(sock);
-        fluid_socket_cleanup();
-        return NULL;
-    }
-
-    server_socket = FLUID_NEW(fluid_server_socket_t);
-
-    if(server_socket == NULL)
+    if(*sock == INVALID_SOCKET)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        fluid_socket_close(sock);
+        FLUID_LOG(FLUID_ERR, "Failed to create UDP socket: %d", fluid_socket_get_error());
         fluid_socket_cleanup();
-        return NULL;
+        return FLUID_FAILED;
     }
 
-    server_socket->socket = sock;
-    server_socket->func = func;
-    server_socket->data = data;
-    server_socket->cont = 1;
-
-    server_socket->thread = new_fluid_thread("server", fluid_server_socket_run, server_socket,
-                            0, FALSE);
-
-    if(server_socket->thread == NULL)
+    if(bind(*sock, (const struct sockaddr *) &addr, sizeof(addr)) == SOCKET_ERROR)
     {
-        FLUID_FREE(server_socket);
-        fluid_socket_close(sock);
+        FLUID_LOG(FLUID_ERR, "Failed to bind UDP socket to port %d: %d", port, fluid_socket_get_error());
+        fluid_socket_close(*sock);
         fluid_socket_cleanup();
-        return NULL;
+        return FLUID_FAILED;
     }
 
-    return server_socket;
+    return FLUID_OK;
 }
 
-void delete_fluid_server_socket(fluid_server_socket_t *server_socket)
+void fluid_udp_socket_close(fluid_socket_t sock)
 {
-    fluid_return_if_fail(server_socket != NULL);
-
-    server_socket->cont = 0;
-
-    if(server_socket->socket != INVALID_SOCKET)
-    {
-        fluid_socket_close(server_socket->socket);
-    }
-
-    if(server_socket->thread)
-    {
-        fluid_thread_join(server_socket->thread);
-        delete_fluid_thread(server_socket->thread);
-    }
-
-    FLUID_FREE(server_socket);
+    fluid_socket_close(sock);
 
     // Should be called the same number of times as fluid_socket_init()
     fluid_socket_cleanup();
 }
 
-#endif // NETWORK_SUPPORT
+/* Milliseconds after which the server thread checks whether to quit */
+#define FLUID_SERVER_POLL_MSEC 100
 
-FILE* fluid_file_open(const char* path, const char** errMsg)
+/* Accept a connection, returns the new client socket or INVALID_SOCKET if the server should stop */
+static fluid_socket_t fluid_server_socket_accept(fluid_server_socket_t *server_socket)
 {
-    static const char ErrExist[] = "File does not exist.";
-    static const char ErrRegular[] = "File is not regular, refusing to open it.";
-    static const char ErrNull[] = "File does not exists or insufficient permissions to open it.";
+    fluid_socket_t client_socket;
+#ifdef IPV6_SUPPORT
+    struct sockaddr_in6 addr;
+#else
+    struct sockaddr_in addr;
+#endif
+
+#ifdef HAVE_INETNTOP
+#ifdef IPV6_SUPPORT
+    char straddr[INET6_ADDRSTRLEN];
+#else
+    char straddr[INET_ADDRSTRLEN];
+#endif /* IPV6_SUPPORT */
+#endif /* HAVE_INETNTOP */
+
+    socklen_t addrlen = sizeof(addr);
+    int r;
+    FLUID_MEMSET((char *)&addr, 0, sizeof(addr));
+
+    client_socket = accept(server_socket->socket, (struct sockaddr *)&addr, &addrlen);
+
+    FLUID_LOG(FLUID_DBG, "New client connection");
+
+    if(client_socket == INVALID_SOCKET)
+    {
+        if(server_socket->cont)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to accept connection: %d", fluid_socket_get_error());
+        }
+
+        server_socket->cont = 0;
+        return INVALID_SOCKET;
+    }
+
+#ifdef HAVE_INETNTOP
+
+#ifdef IPV6_SUPPORT
+    inet_ntop(AF_INET6, &addr.sin6_addr, straddr, sizeof(straddr));
+#else
+    inet_ntop(AF_INET, &addr.sin_addr, straddr, sizeof(straddr));
+#endif
+
+    r = server_socket->func(server_socket->data, client_socket,
+                            straddr);
+#else
+    r = server_socket->func(server_socket->data, client_socket,
+                            inet_ntoa(addr.sin_addr));
+#endif
+
+    if(r != 0)
+    {
+        fluid_socket_close(client_socket);
+        return INVALID_SOCKET;
+    }
+
+    return client_socket;
+}
+
+/*
+ * The event loop of the server: waits for new connections and for input on
+ * all client sockets accepted before, and hands it over to read_func, all on
+ * this single thread.
+ */
+static fluid_thread_return_t fluid_server_socket_run(void *data)
+{
+    fluid_server_socket_t *server_socket = (fluid_server_socket_t *)data;
+    fluid_socket_t client_socket;
+    struct pollfd *fds, *new_fds;
+    int nfds = 1, size = 8;
+    int i, r;
+
+    fds = FLUID_ARRAY(struct pollfd, size);
+
+    if(fds == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        server_socket->cont = 0;
+        return FLUID_THREAD_RETURN_VALUE;
+    }
+
+    fds[0].fd = server_socket->socket;
+    fds[0].events = POLLIN;
+
+    FLUID_LOG(FLUID_DBG, "Server listening for connections");
+
+    while(server_socket->cont)
+    {
+        r = fluid_socket_poll(fds, nfds, FLUID_SERVER_POLL_MSEC);
+
+        if(r == SOCKET_ERROR)
+        {
+#ifndef _WIN32
+            if(errno == EINTR)
+            {
+                continue;
+            }
+#endif
+
+            if(server_socket->cont)
+            {
+                FLUID_LOG(FLUID_ERR, "Failed to wait for connections: %d", fluid_socket_get_error());
+            }
+
+            server_socket->cont = 0;
+            break;
+        }
+
+        /* the clients first, the ones accepted below have not been polled yet */
+        for(i = 1; i < nfds; i++)
+        {
+            if(fds[i].revents == 0)
+            {
+                continue;
+            }
+
+            if(server_socket->read_func(server_socket->data, fds[i].fd) != 0)
+            {
+                /* closed, stop watching it */
+                fds[i--] = fds[--nfds];
+            }
+        }
+
+        if(fds[0].revents == 0)
+        {
+            continue;
+        }
+
+        if(nfds == size)
+        {
+            new_fds = FLUID_REALLOC(fds, 2 * size * sizeof(struct pollfd));
+
+            if(new_fds == NULL)
+            {
+                /* leave the connection pending */
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+                continue;
+            }
+
+            fds = new_fds;
+            size *= 2;
+        }
+
+        client_socket = fluid_server_socket_accept(server_socket);
+
+        if(client_socket == INVALID_SOCKET)
+        {
+            continue;
+        }
+
+        fds[nfds].fd = client_socket;
+        fds[nfds].events = POLLIN;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+
+    FLUID_FREE(fds);
+
+    FLUID_LOG(FLUID_DBG, "Server closing");
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+fluid_server_socket_t *
+new_fluid_server_socket(int port, fluid_server_func_t func,
+                        fluid_server_read_func_t read_func, void *data)
+{
+    fluid_server_socket_t *server_socket;
+#ifdef IPV6_SUPPORT
+    struct sockaddr_in6 addr;
+#else
+    struct sockaddr_in addr;
+#endif
+
+    fluid_socket_t sock;
+
+    fluid_return_val_if_fail(func != NULL, NULL);
+    fluid_return_val_if_fail(read_func != NULL, NULL);
+
+    if(fluid_socket_init() != FLUID_OK)
+    {
+        return NULL;
+    }
+
+#ifdef IPV6_SUPPORT
+    sock = socket(AF_INET6, SOCK_STREAM, 0);
+
+    if(sock == INVALID_SOCKET)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create server socket: %d", fluid_socket_get_error());
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons((uint16_t)port);
+    addr.sin6_addr = in6addr_any;
+#else
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    if(sock == INVALID_SOCKET)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create server socket: %d", fluid_socket_get_error());
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+#endif
+
+#ifndef _WIN32
+    {
+        /* the connections closed by the server must not keep it from being restarted */
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+#endif
+
+    if(bind(sock, (const struct sockaddr *) &addr, sizeof(addr)) == SOCKET_ERROR)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to bind server socket: %d", fluid_socket_get_error());
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    if(listen(sock, SOMAXCONN) == SOCKET_ERROR)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to listen on server socket: %d", fluid_socket_get_error());
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    server_socket = FLUID_NEW(fluid_server_socket_t);
+
+    if(server_socket == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    server_socket->socket = sock;
+    server_socket->func = func;
+    server_socket->read_func = read_func;
+    server_socket->data = data;
+    server_socket->cont = 1;
+
+    server_socket->thread = new_fluid_thread("server", fluid_server_socket_run, server_socket,
+                            0, FALSE);
+
+    if(server_socket->thread == NULL)
+    {
+        FLUID_FREE(server_socket);
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    return server_socket;
+}
+
+void delete_fluid_server_socket(fluid_server_socket_t *server_socket)
+{
+    fluid_return_if_fail(server_socket != NULL);
+
+    server_socket->cont = 0;
+
+    /* the thread notices within FLUID_SERVER_POLL_MSEC, no client will be read from after that */
+    if(server_socket->thread)
+    {
+        fluid_thread_join(server_socket->thread);
+        delete_fluid_thread(server_socket->thread);
+    }
+
+    if(server_socket->socket != INVALID_SOCKET)
+    {
+        fluid_socket_close(server_socket->socket);
+    }
+
+    FLUID_FREE(server_socket);
+
+    // Should be called the same number of times as fluid_socket_init()
+    fluid_socket_cleanup();
+}
+
+#endif // NETWORK_SUPPORT
+
+FILE* fluid_file_open(const char* path, const char** errMsg)
+{
+    static const char ErrExist[] = "File does not exist.";
+    static const char ErrRegular[] = "File is not regular, refusing to open it.";
+    static const char ErrNull[] = "File does not exists or insufficient permissions to open it.";
     
     FILE* handle = NULL;
     
@@ -1670,3 +3096,712 @@ FILE* fluid_file_open(const char* path, const char** errMsg)
     
     return handle;
 }
+
+#if defined(HAVE_SYS_MMAN_H) && HAVE_FCNTL_H && HAVE_UNISTD_H && !defined(__OS2__)
+#define FLUID_HAVE_FILE_MAPPING 1
+#endif
+
+struct _fluid_file_mapping_t
+{
+    void *base;         /* start of the mapped pages */
+    size_t length;      /* length of the mapped pages */
+    void *data;         /* start of the requested part of the file, read-only */
+};
+
+#ifdef FLUID_HAVE_FILE_MAPPING
+/* Map a part of an open file descriptor, which may be closed afterwards */
+static fluid_file_mapping_t *
+fluid_file_mapping_map_fd(int fd, const char *name, unsigned long offset, unsigned long length, int prot, int flags)
+{
+    fluid_file_mapping_t *mapping;
+    unsigned long page_offset;
+    long page_size;
+    void *base;
+
+    page_size = sysconf(_SC_PAGESIZE);
+
+    if(page_size <= 0)
+    {
+        return NULL;
+    }
+
+    /* mmap() requires the file offset to be a multiple of the page size */
+    page_offset = offset % (unsigned long)page_size;
+
+    base = mmap(NULL, length + page_offset, prot, flags, fd, (off_t)(offset - page_offset));
+
+    if(base == MAP_FAILED)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to map %lu bytes of '%s' into memory", length, name);
+        return NULL;
+    }
+
+    mapping = FLUID_NEW(fluid_file_mapping_t);
+
+    if(mapping == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        munmap(base, length + page_offset);
+        return NULL;
+    }
+
+    mapping->base = base;
+    mapping->length = length + page_offset;
+    mapping->data = (char *)base + page_offset;
+
+    return mapping;
+}
+#endif
+
+/**
+ * Map a part of a file read-only into memory.
+ *
+ * @param path Name of the file to map
+ * @param offset Offset of the first byte to map within the file
+ * @param length Number of bytes to map
+ * @return The mapping, or NULL if the file couldn't be mapped
+ */
+fluid_file_mapping_t *new_fluid_file_mapping(const char *path, unsigned long offset, unsigned long length)
+{
+#ifdef FLUID_HAVE_FILE_MAPPING
+    fluid_file_mapping_t *mapping;
+    int fd;
+
+    fluid_return_val_if_fail(path != NULL, NULL);
+    fluid_return_val_if_fail(length > 0, NULL);
+
+    fd = open(path, O_RDONLY);
+
+    if(fd == -1)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to open '%s' for mapping", path);
+        return NULL;
+    }
+
+    mapping = fluid_file_mapping_map_fd(fd, path, offset, length, PROT_READ, MAP_PRIVATE);
+
+    /* the mapping stays valid after closing the file */
+    close(fd);
+
+    return mapping;
+#else
+    return NULL;
+#endif
+}
+
+#if defined(FLUID_HAVE_FILE_MAPPING) && defined(HAVE_SHM_OPEN)
+#define FLUID_HAVE_SHM 1
+#endif
+
+/**
+ * Map a part of an existing POSIX shared memory object read-only into memory.
+ *
+ * @param name Name of the object, starting with a slash
+ * @param offset Offset of the first byte to map within the object
+ * @param length Number of bytes to map
+ * @return The mapping, or NULL if there is no such object, it is too small or couldn't be mapped
+ */
+fluid_file_mapping_t *new_fluid_shm_mapping(const char *name, unsigned long offset, unsigned long length)
+{
+#ifdef FLUID_HAVE_SHM
+    fluid_file_mapping_t *mapping = NULL;
+    struct stat st;
+    int fd;
+
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_return_val_if_fail(length > 0, NULL);
+
+    fd = shm_open(name, O_RDONLY, 0);
+
+    if(fd == -1)
+    {
+        return NULL;
+    }
+
+    /* accessing the mapping beyond the end of the object would crash */
+    if(fstat(fd, &st) == 0 && st.st_size >= 0 && (unsigned long)st.st_size >= offset + length)
+    {
+        mapping = fluid_file_mapping_map_fd(fd, name, offset, length, PROT_READ, MAP_SHARED);
+    }
+
+    close(fd);
+
+    return mapping;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Create a new POSIX shared memory object and map it writable into memory. The
+ * memory is reserved up front, so that running out of it fails here rather than
+ * crashing once written to. The object outlives the process until it is unlinked.
+ *
+ * @param name Name of the object, starting with a slash
+ * @param length Size of the object in bytes
+ * @return The mapping of the whole object, initially zeroed, or NULL if the object
+ *   exists already or couldn't be created
+ */
+fluid_file_mapping_t *new_fluid_shm_object(const char *name, unsigned long length)
+{
+#ifdef FLUID_HAVE_SHM
+    fluid_file_mapping_t *mapping = NULL;
+    int fd;
+
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_return_val_if_fail(length > 0, NULL);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if(fd == -1)
+    {
+        return NULL;
+    }
+
+    if(posix_fallocate(fd, 0, (off_t)length) == 0)
+    {
+        mapping = fluid_file_mapping_map_fd(fd, name, 0, length, PROT_READ | PROT_WRITE, MAP_SHARED);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to reserve %lu bytes of shared memory for '%s'", length, name);
+    }
+
+    if(mapping == NULL)
+    {
+        shm_unlink(name);
+    }
+
+    close(fd);
+
+    return mapping;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Remove the name of a POSIX shared memory object, its memory is released
+ * once it isn't mapped anymore.
+ *
+ * @param name Name of the object, starting with a slash
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int fluid_shm_unlink(const char *name)
+{
+#ifdef FLUID_HAVE_SHM
+    fluid_return_val_if_fail(name != NULL, FLUID_FAILED);
+
+    return (shm_unlink(name) == 0) ? FLUID_OK : FLUID_FAILED;
+#else
+    return FLUID_FAILED;
+#endif
+}
+
+/**
+ * Unmap a part of a file mapped by new_fluid_file_mapping().
+ *
+ * @param mapping The mapping to delete
+ */
+void delete_fluid_file_mapping(fluid_file_mapping_t *mapping)
+{
+    fluid_return_if_fail(mapping != NULL);
+
+#ifdef FLUID_HAVE_FILE_MAPPING
+    munmap(mapping->base, mapping->length);
+#endif
+    FLUID_FREE(mapping);
+}
+
+/**
+ * Get the mapped part of a file.
+ *
+ * @param mapping The mapping
+ * @return Pointer to the first byte of the requested part of the file, which must not be written to
+ */
+void *fluid_file_mapping_get_data(const fluid_file_mapping_t *mapping)
+{
+    fluid_return_val_if_fail(mapping != NULL, NULL);
+
+    return mapping->data;
+}
+
+/**
+ * Tell the operating system that a part of mapped memory will be accessed soon,
+ * so that it starts reading it from the file in the background.
+ *
+ * This is only a hint, it is harmless if the memory isn't (or no longer) mapped.
+ *
+ * @param data Pointer to the first byte that will be accessed
+ * @param length Number of bytes that will be accessed
+ */
+void fluid_file_mapping_prefetch(const void *data, unsigned long length)
+{
+#ifdef FLUID_HAVE_FILE_MAPPING
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned long page_offset;
+
+    if(page_size <= 0 || data == NULL || length == 0)
+    {
+        return;
+    }
+
+    /* the address must be a multiple of the page size */
+    page_offset = (unsigned long)((uintptr_t)data % (unsigned long)page_size);
+    posix_madvise((void *)((uintptr_t)data - page_offset), length + page_offset, POSIX_MADV_WILLNEED);
+#endif
+}
+
+#if defined(__linux__) && defined(FLUID_HAVE_FILE_MAPPING) && defined(MADV_HUGEPAGE)
+#define FLUID_HAVE_HUGE_PAGES 1
+
+/* The size of the transparent huge pages, 2 MB on x86-64 */
+static unsigned long fluid_huge_page_size(void)
+{
+    static unsigned long size = 0;
+    FILE *file;
+
+    if(size == 0)
+    {
+        unsigned long value = 0;
+
+        file = FLUID_FOPEN("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+
+        if(file != NULL)
+        {
+            if(fscanf(file, "%lu", &value) != 1)
+            {
+                value = 0;
+            }
+
+            FLUID_FCLOSE(file);
+        }
+
+        size = (value > 0) ? value : 2 * 1024 * 1024;
+    }
+
+    return size;
+}
+#endif
+
+/**
+ * Advise the operating system to back the huge pages lying entirely inside a
+ * part of anonymous memory, e.g. allocated by FLUID_MALLOC(), with huge pages.
+ *
+ * Best called before the memory is written to, so that the huge pages are
+ * allocated right when it's first touched.
+ *
+ * @param data Pointer to the memory
+ * @param length Number of bytes of the memory
+ * @return Number of bytes advised, 0 if the memory is too small or on error
+ */
+unsigned long fluid_huge_pages_advise(void *data, unsigned long length)
+{
+#ifdef FLUID_HAVE_HUGE_PAGES
+    unsigned long page_size = fluid_huge_page_size();
+    uintptr_t start = ((uintptr_t)data + page_size - 1) / page_size * page_size;
+    uintptr_t end = ((uintptr_t)data + length) / page_size * page_size;
+
+    if(data == NULL || end <= start)
+    {
+        return 0;
+    }
+
+    if(madvise((void *)start, end - start, MADV_HUGEPAGE) != 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to advise huge pages (errno %d)", errno);
+        return 0;
+    }
+
+    return (unsigned long)(end - start);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Count the bytes of a part of memory the operating system backs with huge
+ * pages now, according to /proc/self/smaps on Linux.
+ *
+ * The kernel only tells the amount for each mapping, so the count is clipped
+ * to the part of the mapping covering the memory, and may include huge pages
+ * of that mapping just outside of it.
+ *
+ * @param data Pointer to the memory
+ * @param length Number of bytes of the memory
+ * @return Number of bytes in huge pages, 0 if unknown
+ */
+unsigned long fluid_huge_pages_get_size(const void *data, unsigned long length)
+{
+#ifdef FLUID_HAVE_HUGE_PAGES
+    uintptr_t start = (uintptr_t)data, end = (uintptr_t)data + length;
+    unsigned long vma_start, vma_end, overlap = 0, kb, total = 0;
+    char line[256];
+    FILE *file;
+
+    if(data == NULL || length == 0)
+    {
+        return 0;
+    }
+
+    file = FLUID_FOPEN("/proc/self/smaps", "r");
+
+    if(file == NULL)
+    {
+        return 0;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        if(sscanf(line, "%lx-%lx ", &vma_start, &vma_end) == 2)
+        {
+            /* the header of the next mapping */
+            overlap = 0;
+
+            if(vma_start < end && vma_end > start)
+            {
+                overlap = ((vma_end < end) ? vma_end : end) - ((vma_start > start) ? vma_start : start);
+            }
+        }
+        else if(overlap > 0 && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+        {
+            total += (kb * 1024 < overlap) ? kb * 1024 : overlap;
+        }
+    }
+
+    FLUID_FCLOSE(file);
+
+    return total;
+#else
+    return 0;
+#endif
+}
+
+#if HAVE_LINUX_IO_URING_H && defined(FLUID_HAVE_FILE_MAPPING) && defined(__NR_io_uring_setup) && defined(__GNUC__)
+#define FLUID_HAVE_IO_URING 1
+#endif
+
+#ifdef FLUID_HAVE_IO_URING
+struct _fluid_file_reader_t
+{
+    int fd;                     /* the file read */
+    int ring_fd;
+    unsigned int depth;         /* the most reads in flight */
+    unsigned int queued;        /* reads submitted, not passed to the kernel yet */
+    unsigned int in_flight;     /* reads submitted, not completed yet */
+
+    void *sq_ring;              /* the submission queue, shared with the kernel */
+    size_t sq_ring_size;
+    void *cq_ring;              /* the completion queue, the same mapping as sq_ring if possible */
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned int *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+#endif
+
+/**
+ * Open a file for batched asynchronous reads.
+ *
+ * @param path Name of the file to read
+ * @param depth The most reads in flight at once
+ * @return The reader, or NULL if the file can't be read that way
+ */
+fluid_file_reader_t *new_fluid_file_reader(const char *path, int depth)
+{
+#ifdef FLUID_HAVE_IO_URING
+    fluid_file_reader_t *reader;
+    struct io_uring_params params;
+    char *sq, *cq;
+
+    fluid_return_val_if_fail(path != NULL, NULL);
+    fluid_return_val_if_fail(depth > 0, NULL);
+
+    reader = FLUID_NEW(fluid_file_reader_t);
+
+    if(reader == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(reader, 0, sizeof(*reader));
+    reader->ring_fd = -1;
+    reader->sq_ring = reader->cq_ring = reader->sqes = MAP_FAILED;
+    reader->fd = open(path, O_RDONLY);
+
+    if(reader->fd == -1)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to open '%s' for batched reads", path);
+        goto error_exit;
+    }
+
+    FLUID_MEMSET(&params, 0, sizeof(params));
+    reader->ring_fd = (int)syscall(__NR_io_uring_setup, (unsigned int)depth, &params);
+
+    if(reader->ring_fd < 0)
+    {
+        FLUID_LOG(FLUID_DBG, "io_uring isn't available, reading '%s' synchronously", path);
+        goto error_exit;
+    }
+
+    /* rounded up to a power of two, the completion queue is even longer, so that it never overflows */
+    reader->depth = ((unsigned int)depth < params.sq_entries) ? (unsigned int)depth : params.sq_entries;
+    reader->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    reader->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(reader->cq_ring_size > reader->sq_ring_size)
+        {
+            reader->sq_ring_size = reader->cq_ring_size;
+        }
+
+        reader->cq_ring_size = 0;
+    }
+
+    reader->sq_ring = mmap(NULL, reader->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           reader->ring_fd, IORING_OFF_SQ_RING);
+
+    if(reader->sq_ring == MAP_FAILED)
+    {
+        goto error_exit;
+    }
+
+    if(reader->cq_ring_size > 0)
+    {
+        reader->cq_ring = mmap(NULL, reader->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                               reader->ring_fd, IORING_OFF_CQ_RING);
+
+        if(reader->cq_ring == MAP_FAILED)
+        {
+            goto error_exit;
+        }
+    }
+
+    reader->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    reader->sqes = mmap(NULL, reader->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        reader->ring_fd, IORING_OFF_SQES);
+
+    if(reader->sqes == MAP_FAILED)
+    {
+        goto error_exit;
+    }
+
+    sq = reader->sq_ring;
+    cq = (reader->cq_ring_size > 0) ? reader->cq_ring : reader->sq_ring;
+    reader->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    reader->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    reader->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    reader->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    reader->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    reader->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    reader->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return reader;
+
+error_exit:
+    delete_fluid_file_reader(reader);
+    return NULL;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Close a file opened by new_fluid_file_reader(), after waiting for the reads
+ * in flight, so that the buffers they read into can be freed afterwards.
+ *
+ * @param reader The reader to delete
+ */
+void delete_fluid_file_reader(fluid_file_reader_t *reader)
+{
+#ifdef FLUID_HAVE_IO_URING
+    void *data;
+
+    fluid_return_if_fail(reader != NULL);
+
+    if(reader->sqes != MAP_FAILED)
+    {
+        do
+        {
+            fluid_file_reader_complete(reader, &data);
+        }
+        while(data != NULL);
+
+        munmap(reader->sqes, reader->sqes_size);
+    }
+
+    if(reader->cq_ring != MAP_FAILED)
+    {
+        munmap(reader->cq_ring, reader->cq_ring_size);
+    }
+
+    if(reader->sq_ring != MAP_FAILED)
+    {
+        munmap(reader->sq_ring, reader->sq_ring_size);
+    }
+
+    if(reader->ring_fd >= 0)
+    {
+        close(reader->ring_fd);
+    }
+
+    if(reader->fd >= 0)
+    {
+        close(reader->fd);
+    }
+
+    FLUID_FREE(reader);
+#endif
+}
+
+/**
+ * Queue a read of a part of the file, passed to the kernel by the next call to
+ * fluid_file_reader_flush() along with the others queued meanwhile.
+ *
+ * @param reader The reader
+ * @param buf Where to read to, which must stay valid until the read has completed
+ * @param offset Offset of the first byte to read within the file
+ * @param length Number of bytes to read
+ * @param data Returned by fluid_file_reader_complete() for the read, not NULL
+ * @return #FLUID_OK, or #FLUID_FAILED if there are as many reads in flight as the reader allows
+ */
+int fluid_file_reader_submit(fluid_file_reader_t *reader, void *buf, unsigned long offset,
+                             unsigned int length, void *data)
+{
+#ifdef FLUID_HAVE_IO_URING
+    struct io_uring_sqe *sqe;
+    unsigned int tail, index;
+
+    fluid_return_val_if_fail(reader != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(data != NULL, FLUID_FAILED);
+
+    if(reader->in_flight >= reader->depth)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* only this thread writes the tail */
+    tail = *reader->sq_tail;
+    index = tail & *reader->sq_mask;
+    sqe = &reader->sqes[index];
+
+    FLUID_MEMSET(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = reader->fd;
+    sqe->off = offset;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = length;
+    sqe->user_data = (uintptr_t)data;
+    reader->sq_array[index] = index;
+
+    __atomic_store_n(reader->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    reader->queued++;
+    reader->in_flight++;
+
+    return FLUID_OK;
+#else
+    return FLUID_FAILED;
+#endif
+}
+
+/**
+ * Pass the reads queued by fluid_file_reader_submit() to the kernel, all at once.
+ *
+ * @param reader The reader
+ * @return #FLUID_OK or #FLUID_FAILED
+ */
+int fluid_file_reader_flush(fluid_file_reader_t *reader)
+{
+#ifdef FLUID_HAVE_IO_URING
+    int ret;
+
+    fluid_return_val_if_fail(reader != NULL, FLUID_FAILED);
+
+    while(reader->queued > 0)
+    {
+        ret = (int)syscall(__NR_io_uring_enter, reader->ring_fd, reader->queued, 0, 0, NULL, 0);
+
+        if(ret < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                continue;
+            }
+
+            FLUID_LOG(FLUID_ERR, "Failed to submit the reads of a file");
+            return FLUID_FAILED;
+        }
+
+        reader->queued -= ret;
+    }
+
+    return FLUID_OK;
+#else
+    return FLUID_FAILED;
+#endif
+}
+
+/**
+ * Wait for the next read to complete, flushing the reads queued before.
+ *
+ * @param reader The reader
+ * @param data Set to the data passed along with the read to fluid_file_reader_submit(),
+ *   NULL if there are no reads in flight
+ * @return The number of bytes read, -1 if the read failed or there are no reads in flight
+ */
+int fluid_file_reader_complete(fluid_file_reader_t *reader, void **data)
+{
+#ifdef FLUID_HAVE_IO_URING
+    struct io_uring_cqe *cqe;
+    unsigned int head;
+    int ret;
+
+    *data = NULL;
+    fluid_return_val_if_fail(reader != NULL, -1);
+
+    if(reader->in_flight == 0)
+    {
+        return -1;
+    }
+
+    /* the reads have to be passed to the kernel to ever complete */
+    if(fluid_file_reader_flush(reader) != FLUID_OK)
+    {
+        /* taken back, never seen by the kernel */
+        *reader->sq_tail -= reader->queued;
+        reader->in_flight -= reader->queued;
+        reader->queued = 0;
+
+        if(reader->in_flight == 0)
+        {
+            return -1;
+        }
+    }
+
+    while(1)
+    {
+        head = *reader->cq_head;
+
+        if(head != __atomic_load_n(reader->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            cqe = &reader->cqes[head & *reader->cq_mask];
+            *data = (void *)(uintptr_t)cqe->user_data;
+            ret = cqe->res;
+            __atomic_store_n(reader->cq_head, head + 1, __ATOMIC_RELEASE);
+            reader->in_flight--;
+
+            return (ret >= 0) ? ret : -1;
+        }
+
+        syscall(__NR_io_uring_enter, reader->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    }
+#else
+    *data = NULL;
+    return -1;
+#endif
+}
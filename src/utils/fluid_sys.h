@@ -93,6 +93,10 @@
 #include <arpa/inet.h>
 #endif
 
+#if HAVE_POLL_H
+#include <poll.h>
+#endif
+
 #if HAVE_LIMITS_H
 #include <limits.h>
 #endif
@@ -375,6 +379,17 @@ typedef GStaticPrivate fluid_private_t;
 #endif
 
 
+/* Hint to the CPU that the thread is busy waiting */
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <xmmintrin.h>
+#define fluid_cpu_relax()               _mm_pause()
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define fluid_cpu_relax()               __asm__ __volatile__("yield")
+#else
+#define fluid_cpu_relax()
+#endif
+
+
 /* Atomic operations */
 
 #define fluid_atomic_int_inc(_pi) g_atomic_int_inc(_pi)
@@ -401,6 +416,16 @@ typedef GStaticPrivate fluid_private_t;
 #define fluid_atomic_pointer_compare_and_exchange(_pp, _old, _new) \
   g_atomic_pointer_compare_and_exchange(_pp, _old, _new)
 
+/* Loads and stores only ordering the accesses of a single producer and consumer,
+ * falling back to the full barriers of glib where the compiler has no builtins */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define fluid_atomic_int_get_acquire(_pi)       __atomic_load_n(_pi, __ATOMIC_ACQUIRE)
+#define fluid_atomic_int_set_release(_pi, _val) __atomic_store_n(_pi, _val, __ATOMIC_RELEASE)
+#else
+#define fluid_atomic_int_get_acquire(_pi)       fluid_atomic_int_get(_pi)
+#define fluid_atomic_int_set_release(_pi, _val) fluid_atomic_int_set(_pi, _val)
+#endif
+
 static FLUID_INLINE void
 fluid_atomic_float_set(volatile float *fptr, float val)
 {
@@ -434,12 +459,54 @@ typedef fluid_thread_return_t (*fluid_thread_func_t)(void *data);
 #define fluid_thread_id_t               GThread *               /* Data type for a thread ID */
 #define fluid_thread_get_id()           g_thread_self()         /* Get unique "ID" for current thread */
 
+/* Creates and joins threads in place of new_fluid_thread() and fluid_thread_join(),
+ * e.g. through the API of an audio server, so that it schedules them as realtime threads */
+typedef struct
+{
+    /* Starts func(arg), returns the thread or NULL on failure */
+    void *(*create)(void *data, const char *name, fluid_thread_func_t func, void *arg);
+    /* Waits for the thread to exit and frees it */
+    void (*join)(void *data, void *thread);
+    void *data;
+} fluid_thread_factory_t;
+
 fluid_thread_t *new_fluid_thread(const char *name, fluid_thread_func_t func, void *data,
                                  int prio_level, int detach);
 void delete_fluid_thread(fluid_thread_t *thread);
 void fluid_thread_self_set_prio(int prio_level);
+int fluid_thread_self_set_affinity(int core);
+int fluid_thread_self_flush_denormals(int enable, unsigned int *state);
+void fluid_thread_self_restore_denormals(unsigned int state);
+int fluid_thread_self_join_workgroup(void *workgroup, void **token);
+void fluid_thread_self_leave_workgroup(void *workgroup, void *token);
 int fluid_thread_join(fluid_thread_t *thread);
 
+/* CPU features the DSP kernels have variants for, see fluid_cpu_features() */
+enum fluid_cpu_feature
+{
+    FLUID_CPU_SSE2 = 1 << 0,
+    FLUID_CPU_AVX2 = 1 << 1,     /**< AVX2 along with FMA */
+    FLUID_CPU_AVX512F = 1 << 2,
+    FLUID_CPU_NEON = 1 << 3,
+    FLUID_CPU_SIMD128 = 1 << 4   /**< WebAssembly SIMD, known at compile time */
+};
+
+/* Name of the generic variant of the DSP kernels, which is compiled for the baseline of the target */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FLUID_CPU_BASELINE "neon"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLUID_CPU_BASELINE "sse2"
+#elif defined(__wasm_simd128__)
+#define FLUID_CPU_BASELINE "simd128"
+#else
+#define FLUID_CPU_BASELINE "generic"
+#endif
+
+void fluid_cpu_dispatch_init(void);
+unsigned int fluid_cpu_features(void);
+void fluid_cpu_dispatch_register(const char *kernel, const char *variant);
+const char *fluid_cpu_dispatch_str(void);
+
 /* Dynamic Module Loading, currently only used by LADSPA subsystem */
 #ifdef LADSPA
 
@@ -455,6 +522,9 @@ typedef GModule fluid_module_t;
 
 /* Sockets and I/O */
 
+/* An output stream discarding everything printed to it */
+#define FLUID_NULL_OSTREAM ((fluid_ostream_t)-1)
+
 int fluid_istream_readline(fluid_istream_t in, fluid_ostream_t out, char *prompt, char *buf, int len);
 int fluid_ostream_printf(fluid_ostream_t out, const char *format, ...);
 
@@ -469,12 +539,22 @@ typedef int fluid_socket_t;
    closed by the server. */
 typedef int (*fluid_server_func_t)(void *data, fluid_socket_t client_socket, char *addr);
 
-fluid_server_socket_t *new_fluid_server_socket(int port, fluid_server_func_t func, void *data);
+/* Called by the server thread when a client socket accepted before is readable.
+   The function should return 0 to keep on watching the socket, or non-zero
+   after it closed the socket. */
+typedef int (*fluid_server_read_func_t)(void *data, fluid_socket_t client_socket);
+
+fluid_server_socket_t *new_fluid_server_socket(int port, fluid_server_func_t func,
+        fluid_server_read_func_t read_func, void *data);
 void delete_fluid_server_socket(fluid_server_socket_t *sock);
 int fluid_server_socket_join(fluid_server_socket_t *sock);
 void fluid_socket_close(fluid_socket_t sock);
 fluid_istream_t fluid_socket_get_istream(fluid_socket_t sock);
 fluid_ostream_t fluid_socket_get_ostream(fluid_socket_t sock);
+int fluid_socket_recv(fluid_socket_t sock, void *buf, int len);
+int fluid_socket_wait(fluid_socket_t sock, int msec);
+int fluid_udp_socket_open(int port, fluid_socket_t *sock);
+void fluid_udp_socket_close(fluid_socket_t sock);
 
 /* File access */
 #define fluid_stat(_filename, _statbuf)   g_stat((_filename), (_statbuf))
@@ -604,6 +684,42 @@ extern unsigned char fluid_profile_status ;       /* command and status */
 extern unsigned int fluid_profile_end_ticks;      /* ending position (in ticks) */
 extern fluid_profile_data_t fluid_profile_data[]; /* Profiling data */
 
+/*----------------------------------------------
+  Profiling data per preset (in fluid_sys.c)
+-----------------------------------------------*/
+#define FLUID_PROFILE_PRESET_MAX 128      /* presets profiled separately */
+#define FLUID_PROFILE_PRESET_NAME_SIZE 21 /* SoundFont preset names are 20 chars */
+
+/**
+ * Stages of the voice rendering. The time spent in each of them is charged to
+ * the presets the rendered voices have been started from.
+ */
+enum
+{
+    FLUID_PROF_STAGE_ENV,    /* envelopes, LFOs, amplitude and pitch */
+    FLUID_PROF_STAGE_INTERP, /* sample interpolation */
+    FLUID_PROF_STAGE_FILTER, /* resonant filters */
+    FLUID_PROF_STAGE_MIX,    /* mixing into the output buffers */
+    FLUID_PROF_STAGE_NBR     /* number of stages */
+};
+
+/** Profiling data of the voices of one preset */
+typedef struct _fluid_profile_preset_t
+{
+    int sfont_id;             /* SoundFont, bank and program of the preset */
+    int bank;
+    int prog;
+    char name[FLUID_PROFILE_PRESET_NAME_SIZE];
+    double total[FLUID_PROF_STAGE_NBR]; /* duration (microsecond) of each stage */
+    unsigned int n_samples;   /* audio samples number rendered by the voices */
+} fluid_profile_preset_t;
+
+extern fluid_profile_preset_t fluid_profile_preset_data[]; /* Profiling data per preset */
+extern int fluid_profile_preset_count;                     /* presets in use */
+
+/* Returns the index of a preset in fluid_profile_preset_data, -1 if the table is full */
+int fluid_profile_preset_index(int sfont_id, int bank, int prog, const char *name);
+
 /*----------------------------------------------
   Probes macros
 -----------------------------------------------*/
@@ -614,6 +730,10 @@ extern fluid_profile_data_t fluid_profile_data[]; /* Profiling data */
  * So we don't get unused variable warnings when profiling is disabled. */
 #define fluid_profile_ref_var(name)     double name = fluid_utime()
 
+/** Macro to assign the current reference time to a variable created by
+ * fluid_profile_ref_var(). */
+#define fluid_profile_ref_set(name)     name = fluid_utime()
+
 /**
  * Profile identifier numbers. List all the pieces of code you want to profile
  * here. Be sure to add an entry in the fluid_profile_data table in
@@ -661,6 +781,28 @@ enum
 	}\
 }
 
+/** Macro to charge the time spent since _ref to a stage of the voices of the
+    presets _presets[0.._count-1]. The time is evenly shared between the voices,
+    each of them rendered _samples audio samples. */
+#define fluid_profile_presets(_stage, _ref, _presets, _count, _samples)\
+{\
+	if(fluid_profile_status == PROFILE_START && (_count) > 0)\
+	{\
+		int _i;\
+		double _now = fluid_utime();\
+		double _share = (_now - _ref) / (_count);\
+		for(_i = 0; _i < (_count); _i++)\
+		{\
+			if((_presets)[_i] >= 0)\
+			{\
+				fluid_profile_preset_data[(_presets)[_i]].total[_stage] += _share;\
+				fluid_profile_preset_data[(_presets)[_i]].n_samples += _samples;\
+			}\
+		}\
+		_ref = _now;\
+	}\
+}
+
 /** Macro to collect data, called from audio rendering API (fluid_write_xxxx()).
  This macro control profiling ending position (in ticks).
 */
@@ -686,7 +828,9 @@ enum
 #define fluid_profiling_print()
 #define fluid_profile_ref()  0
 #define fluid_profile_ref_var(name)
+#define fluid_profile_ref_set(name)
 #define fluid_profile(_num,_ref,voices, samples)
+#define fluid_profile_presets(_stage,_ref,_presets,_count,_samples)
 #define fluid_profile_write(_num,_ref, voices, samples)
 #endif /* WITH_PROFILING */
 
@@ -706,6 +850,60 @@ enum
 #define fluid_munlock(_p,_n)
 #endif
 
+/**
+
+    File mapping
+
+    Read-only mapping of a part of a file into memory, so that its content
+    can be accessed without copying it. Returns NULL if the platform doesn't
+    support it, the caller is expected to fall back to reading the file.
+    POSIX shared memory objects are mapped the same way, by their name.
+ */
+
+typedef struct _fluid_file_mapping_t fluid_file_mapping_t;
+
+fluid_file_mapping_t *new_fluid_file_mapping(const char *path, unsigned long offset, unsigned long length);
+void delete_fluid_file_mapping(fluid_file_mapping_t *mapping);
+void *fluid_file_mapping_get_data(const fluid_file_mapping_t *mapping);
+void fluid_file_mapping_prefetch(const void *data, unsigned long length);
+fluid_file_mapping_t *new_fluid_shm_mapping(const char *name, unsigned long offset, unsigned long length);
+fluid_file_mapping_t *new_fluid_shm_object(const char *name, unsigned long length);
+int fluid_shm_unlink(const char *name);
+
+
+/**
+
+    Huge pages
+
+    Hints for the operating system to back large allocations with huge pages,
+    so that reading samples scattered over a lot of memory causes fewer TLB
+    misses. Only transparent huge pages on Linux are supported, elsewhere
+    nothing is advised.
+ */
+
+unsigned long fluid_huge_pages_advise(void *data, unsigned long length);
+unsigned long fluid_huge_pages_get_size(const void *data, unsigned long length);
+
+
+/**
+
+    Batched file reads
+
+    Asynchronous reads of parts of a file, submitted in batches and completed
+    in any order, so that many of them are in flight at once. Only implemented
+    with io_uring on Linux, returns NULL otherwise or if the kernel doesn't
+    allow it: the caller is expected to fall back to reading the file itself.
+ */
+
+typedef struct _fluid_file_reader_t fluid_file_reader_t;
+
+fluid_file_reader_t *new_fluid_file_reader(const char *path, int depth);
+void delete_fluid_file_reader(fluid_file_reader_t *reader);
+int fluid_file_reader_submit(fluid_file_reader_t *reader, void *buf, unsigned long offset,
+                             unsigned int length, void *data);
+int fluid_file_reader_flush(fluid_file_reader_t *reader);
+int fluid_file_reader_complete(fluid_file_reader_t *reader, void **data);
+
 
 /**
 
@@ -727,6 +925,30 @@ void fluid_clear_fpe_i386(void);
 
 /* System control */
 void fluid_msleep(unsigned int msecs);
+void fluid_usleep(unsigned int usecs);
+
+/* Realtime sections, messages logged inside of them are written by the logger
+ * thread, heap allocations inside of them abort the program when built with
+ * enable-rt-alloc-check */
+void fluid_rt_enter(void);
+void fluid_rt_exit(void);
+
+/* Logger thread writing the messages logged in realtime sections */
+int fluid_log_async_ref(void);
+void fluid_log_async_unref(void);
+
+/* Lock-free pool of preallocated objects, for allocations made while rendering audio */
+fluid_pool_t *new_fluid_pool(int count, int size);
+void delete_fluid_pool(fluid_pool_t *pool);
+void *fluid_pool_alloc(fluid_pool_t *pool);
+void fluid_pool_free(fluid_pool_t *pool, void *obj);
+
+/* Arena of small objects allocated one after the other and freed all at once */
+fluid_arena_t *new_fluid_arena(int block_size);
+void delete_fluid_arena(fluid_arena_t *arena);
+void *fluid_arena_alloc(fluid_arena_t *arena, size_t size);
+char *fluid_arena_strdup(fluid_arena_t *arena, const char *str);
+size_t fluid_arena_get_size(const fluid_arena_t *arena);
 
 /**
  * Advances the given \c ptr to the next \c alignment byte boundary.
@@ -0,0 +1,233 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#include "fluid_trace.h"
+
+#if WITH_TRACE
+
+/* Count of threads that can be traced at once */
+#define FLUID_TRACE_MAX_THREADS 32
+
+/* Spans kept per thread, a power of two */
+#define FLUID_TRACE_RING_SIZE 4096
+
+typedef struct
+{
+    const char *name;
+    double start;     /**< Time the span began (microseconds, as of fluid_utime()) */
+    double duration;  /**< In microseconds */
+} fluid_trace_span_t;
+
+typedef struct
+{
+    fluid_trace_span_t spans[FLUID_TRACE_RING_SIZE];
+    unsigned int count;  /**< Spans recorded since tracing was started, only the last ones are kept */
+} fluid_trace_ring_t;
+
+/* The rings are static, so that neither recording nor starting tracing again
+ * has to care about a thread still holding on to a ring being freed. */
+static fluid_trace_ring_t fluid_trace_rings[FLUID_TRACE_MAX_THREADS];
+static fluid_atomic_int_t fluid_trace_ring_count;  /* rings handed out to threads */
+static fluid_atomic_int_t fluid_trace_active;
+static double fluid_trace_start_time;
+
+/* Index plus one of the ring of the calling thread */
+static fluid_private_t fluid_trace_thread_ring;
+
+/*
+ * Get the reference time of a span, 0 if tracing isn't active.
+ */
+double
+fluid_trace_ref(void)
+{
+    return fluid_atomic_int_get(&fluid_trace_active) ? fluid_utime() : 0.0;
+}
+
+/*
+ * Record a span ending now in the ring of the calling thread.
+ * @param name Name of the span, a string literal
+ * @param ref Reference time got by fluid_trace_ref() when the span began
+ */
+void
+fluid_trace_add(const char *name, double ref)
+{
+    void *index;
+    int i;
+    fluid_trace_ring_t *ring;
+    fluid_trace_span_t *span;
+
+    if(ref <= 0.0 || !fluid_atomic_int_get(&fluid_trace_active))
+    {
+        return;
+    }
+
+    index = fluid_private_get(fluid_trace_thread_ring);
+    i = FLUID_POINTER_TO_INT(index) - 1;
+
+    if(i < 0)
+    {
+        /* first span of this thread, it keeps its ring for good */
+        i = fluid_atomic_int_exchange_and_add(&fluid_trace_ring_count, 1);
+
+        if(i >= FLUID_TRACE_MAX_THREADS)
+        {
+            i = FLUID_TRACE_MAX_THREADS;
+        }
+
+        fluid_private_set(fluid_trace_thread_ring, FLUID_INT_TO_POINTER(i + 1));
+    }
+
+    if(i >= FLUID_TRACE_MAX_THREADS)
+    {
+        /* out of rings, this thread isn't traced */
+        return;
+    }
+
+    ring = &fluid_trace_rings[i];
+    span = &ring->spans[ring->count & (FLUID_TRACE_RING_SIZE - 1)];
+    span->name = name;
+    span->start = ref;
+    span->duration = fluid_utime() - ref;
+    ring->count++;
+}
+
+#endif /* WITH_TRACE */
+
+/**
+ * Start recording the trace points of the rendering threads, forgetting the
+ * ones recorded before.
+ * @return #FLUID_OK on success, #FLUID_FAILED if fluidsynth was built without
+ *   trace points (cmake option enable-trace)
+ *
+ * Each thread keeps the last few thousand spans it went through, see
+ * fluid_trace_dump().
+ * @since 2.2.0
+ */
+int
+fluid_trace_start(void)
+{
+#if WITH_TRACE
+    int i;
+
+    fluid_atomic_int_set(&fluid_trace_active, FALSE);
+
+    for(i = 0; i < FLUID_TRACE_MAX_THREADS; i++)
+    {
+        fluid_trace_rings[i].count = 0;
+    }
+
+    fluid_trace_start_time = fluid_utime();
+    fluid_atomic_int_set(&fluid_trace_active, TRUE);
+
+    return FLUID_OK;
+#else
+    FLUID_LOG(FLUID_ERR, "fluidsynth was built without trace points");
+    return FLUID_FAILED;
+#endif
+}
+
+/**
+ * Stop recording the trace points, keeping the ones recorded so far for
+ * fluid_trace_dump().
+ * @since 2.2.0
+ */
+void
+fluid_trace_stop(void)
+{
+#if WITH_TRACE
+    fluid_atomic_int_set(&fluid_trace_active, FALSE);
+#endif
+}
+
+/**
+ * Stop recording the trace points and write the spans recorded since
+ * fluid_trace_start() to a file in the Chrome trace event format, which can be
+ * opened by chrome://tracing or https://ui.perfetto.dev.
+ * @param filename Name of the file to write
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The spans are the dispatching of the events, the rendering of the voices, the
+ * effects, LADSPA, the waiting for the mixer threads, the audio driver callbacks
+ * and the loading of SoundFonts. Each thread shows up as a track of its own.
+ * @since 2.2.0
+ */
+int
+fluid_trace_dump(const char *filename)
+{
+#if WITH_TRACE
+    FILE *file;
+    int i, count, first = TRUE;
+    unsigned int k;
+
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
+
+    fluid_trace_stop();
+
+    file = FLUID_FOPEN(filename, "w");
+
+    if(file == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Couldn't open trace file '%s'", filename);
+        return FLUID_FAILED;
+    }
+
+    FLUID_FPRINTF(file, "{\"traceEvents\":[\n");
+
+    count = fluid_atomic_int_get(&fluid_trace_ring_count);
+
+    if(count > FLUID_TRACE_MAX_THREADS)
+    {
+        count = FLUID_TRACE_MAX_THREADS;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_trace_ring_t *ring = &fluid_trace_rings[i];
+
+        FLUID_FPRINTF(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"name\":\"fluidsynth thread %d\"}}",
+                      first ? "" : ",\n", i + 1, i + 1);
+        first = FALSE;
+
+        k = (ring->count > FLUID_TRACE_RING_SIZE) ? ring->count - FLUID_TRACE_RING_SIZE : 0;
+
+        for(; k < ring->count; k++)
+        {
+            fluid_trace_span_t *span = &ring->spans[k & (FLUID_TRACE_RING_SIZE - 1)];
+
+            FLUID_FPRINTF(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                          span->name, i + 1, span->start - fluid_trace_start_time, span->duration);
+        }
+    }
+
+    FLUID_FPRINTF(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    if(FLUID_FCLOSE(file) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Couldn't write trace file '%s'", filename);
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+#else
+    FLUID_LOG(FLUID_ERR, "fluidsynth was built without trace points");
+    return FLUID_FAILED;
+#endif
+}
@@ -0,0 +1,60 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#ifndef _FLUID_TRACE_H
+#define _FLUID_TRACE_H
+
+#include "fluid_sys.h"
+
+/*
+ * Trace points of the rendering, for finding out where the time of a late
+ * block went. They only exist when built with enable-trace, and merely look at
+ * a flag until tracing is started with fluid_trace_start(). Each thread records
+ * the spans it went through in a ring buffer of its own, keeping the latest ones,
+ * which fluid_trace_dump() writes as a Chrome trace (to be opened by
+ * chrome://tracing or ui.perfetto.dev).
+ *
+ * A span is measured like the profiling data:
+ *
+ *   fluid_trace_ref_var(trace_ref);
+ *   ... the stage ...
+ *   fluid_trace("stage", trace_ref);
+ *
+ * The name must be a string literal, only its address is recorded.
+ */
+#if WITH_TRACE
+
+#define fluid_trace_ref_var(_ref)   double _ref = fluid_trace_ref()
+#define fluid_trace_ref_reset(_ref) _ref = fluid_trace_ref()
+#define fluid_trace(_name, _ref)    fluid_trace_add(_name, _ref)
+
+double fluid_trace_ref(void);
+void fluid_trace_add(const char *name, double ref);
+
+#else
+
+/* still a declaration, so that it can go anywhere among them */
+#define fluid_trace_ref_var(_ref)   double _ref = 0.0
+#define fluid_trace_ref_reset(_ref) (void)(_ref)
+#define fluid_trace(_name, _ref)    (void)(_ref)
+
+#endif /* WITH_TRACE */
+
+#endif /* _FLUID_TRACE_H */
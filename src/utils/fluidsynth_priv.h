@@ -89,6 +89,8 @@ typedef struct _fluid_server_socket_t fluid_server_socket_t;
 typedef struct _fluid_sample_timer_t fluid_sample_timer_t;
 typedef struct _fluid_zone_range_t fluid_zone_range_t;
 typedef struct _fluid_rvoice_eventhandler_t fluid_rvoice_eventhandler_t;
+typedef struct _fluid_pool_t fluid_pool_t;
+typedef struct _fluid_arena_t fluid_arena_t;
 
 /* Declare rvoice related typedefs here instead of fluid_rvoice.h, as it's needed
  * in fluid_lfo.c and fluid_adsr.c as well */
@@ -112,7 +114,9 @@ typedef void (*fluid_rvoice_function_t)(void *obj, const fluid_rvoice_param_t pa
  *                      CONSTANTS
  */
 
-#define FLUID_BUFSIZE                64         /**< FluidSynth internal buffer size (in samples) */
+#ifndef FLUID_BUFSIZE
+#define FLUID_BUFSIZE                64         /**< FluidSynth internal buffer size (in samples), see the block-size build option */
+#endif
 #define FLUID_MIXER_MAX_BUFFERS_DEFAULT (8192/FLUID_BUFSIZE) /**< Number of buffers that can be processed in one rendering run */
 #define FLUID_MAX_EVENTS_PER_BUFSIZE 1024       /**< Maximum queued MIDI events per #FLUID_BUFSIZE */
 #define FLUID_MAX_RETURN_EVENTS      1024       /**< Maximum queued synthesis thread return events */
@@ -182,13 +186,14 @@ typedef void (*fluid_rvoice_function_t)(void *obj, const fluid_rvoice_param_t pa
 
 /* Memory allocation */
 #define FLUID_MALLOC(_n)             fluid_alloc(_n)
-#define FLUID_REALLOC(_p,_n)         realloc(_p,_n)
+#define FLUID_REALLOC(_p,_n)         fluid_realloc(_p,_n)
 #define FLUID_FREE(_p)               fluid_free(_p)
 #define FLUID_NEW(_t)                (_t*)FLUID_MALLOC(sizeof(_t))
 #define FLUID_ARRAY_ALIGNED(_t,_n,_a) (_t*)FLUID_MALLOC((_n)*sizeof(_t) + ((unsigned int)_a - 1u))
 #define FLUID_ARRAY(_t,_n)           FLUID_ARRAY_ALIGNED(_t,_n,1u)
 
 void* fluid_alloc(size_t len);
+void* fluid_realloc(void *ptr, size_t len);
 
 /* File access */
 #define FLUID_FOPEN(_f,_m)           fopen(_f,_m)
@@ -199,7 +204,9 @@ void* fluid_alloc(size_t len);
 
 /* Memory functions */
 #define FLUID_MEMCPY(_dst,_src,_n)   memcpy(_dst,_src,_n)
+#define FLUID_MEMMOVE(_dst,_src,_n)  memmove(_dst,_src,_n)
 #define FLUID_MEMSET(_s,_c,_n)       memset(_s,_c,_n)
+#define FLUID_MEMCMP(_s1,_s2,_n)     memcmp(_s1,_s2,_n)
 
 /* String functions */
 #define FLUID_STRLEN(_s)             strlen(_s)
@@ -296,6 +303,16 @@ do { strncpy(_dst,_src,_n); \
 #define FLUID_RESTRICT
 #endif
 
+/* Start loading the cache line at an address, which needn't be valid */
+#if defined(__clang__) || defined(__GNUC__)
+#define FLUID_PREFETCH(_p) __builtin_prefetch(_p)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#define FLUID_PREFETCH(_p) _mm_prefetch((const char *)(_p), _MM_HINT_T0)
+#else
+#define FLUID_PREFETCH(_p) ((void)(_p))
+#endif
+
 #define FLUID_N_ELEMENTS(struct)  (sizeof (struct) / sizeof (struct[0]))
 #define FLUID_MEMBER_SIZE(struct, member)  ( sizeof (((struct *)0)->member) )
 
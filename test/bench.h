@@ -0,0 +1,83 @@
+#pragma once
+
+#include "test.h"
+#include "utils/fluid_sys.h"
+
+/*
+ * Micro-benchmarks, built and run by "make bench".
+ *
+ * Each measurement is printed as one line of comma-separated values:
+ *
+ *     benchmark,parameters,iterations,nanoseconds
+ *
+ * i.e. the name of the benchmark, its parameters as key=value pairs separated
+ * by spaces, the number of iterations timed in each run, and the median
+ * duration of one iteration over BENCH_RUNS runs. The inputs are fixed, so
+ * that the results can be compared from one build to the next.
+ */
+
+/* runs of each benchmark, the median of which is reported */
+#define BENCH_RUNS 5
+
+/* minimum duration of a run in microseconds, the iterations are calibrated to it */
+#define BENCH_MIN_TIME 50000.0
+
+typedef void (*bench_func_t)(void *data);
+
+static double bench_time(bench_func_t func, bench_func_t reset, void *data, int iterations)
+{
+    double start;
+    int i;
+
+    if(reset != NULL)
+    {
+        reset(data);
+    }
+
+    start = fluid_utime();
+
+    for(i = 0; i < iterations; i++)
+    {
+        func(data);
+    }
+
+    return fluid_utime() - start;
+}
+
+/**
+ * Time a benchmark and print its result.
+ * @param func function to time, called once per iteration
+ * @param reset function called before each run, not timed, or NULL
+ * @param max_iterations most iterations func can run between two resets, 0 for no limit
+ */
+static void bench_run(const char *name, const char *params, bench_func_t func, bench_func_t reset,
+                      void *data, int max_iterations)
+{
+    double runs[BENCH_RUNS], t;
+    int iterations = 1, i, k;
+
+    // warm up, then double the iterations until a run lasts long enough
+    bench_time(func, reset, data, 1);
+
+    while((t = bench_time(func, reset, data, iterations)) < BENCH_MIN_TIME
+            && (max_iterations == 0 || 2 * iterations <= max_iterations))
+    {
+        iterations *= 2;
+    }
+
+    for(i = 0; i < BENCH_RUNS; i++)
+    {
+        t = bench_time(func, reset, data, iterations);
+
+        // insertion sort, for the median
+        for(k = i; k > 0 && runs[k - 1] > t; k--)
+        {
+            runs[k] = runs[k - 1];
+        }
+
+        runs[k] = t;
+    }
+
+    printf("%s,%s,%d,%.1f\n", name, params, iterations, runs[BENCH_RUNS / 2] * 1000.0 / iterations);
+    fflush(stdout);
+}
@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_rev.h"
+#include "rvoice/fluid_chorus.h"
+
+// benchmarks of the reverb and chorus units, one block of FLUID_BUFSIZE frames per iteration
+
+#define SAMPLE_RATE 44100
+
+typedef struct
+{
+    fluid_revmodel_t *rev;
+    fluid_chorus_t *chorus;
+    fluid_real_t in[FLUID_BUFSIZE];
+    fluid_real_t left[FLUID_BUFSIZE];
+    fluid_real_t right[FLUID_BUFSIZE];
+} fx_bench_t;
+
+static void reverb(void *data)
+{
+    fx_bench_t *bench = data;
+
+    fluid_revmodel_processmix(bench->rev, bench->in, bench->left, bench->right);
+}
+
+static void chorus(void *data)
+{
+    fx_bench_t *bench = data;
+
+    fluid_chorus_processmix(bench->chorus, bench->in, bench->left, bench->right);
+}
+
+int main(void)
+{
+    static fx_bench_t bench;
+    static const int nrs[] = { 3, 10, 99 };
+    static const int decimations[] = { 1, 2, 4 };
+    char params[64];
+    unsigned int i;
+
+    for(i = 0; i < FLUID_BUFSIZE; i++)
+    {
+        bench.in[i] = (fluid_real_t)(0.3 * FLUID_SIN(0.1 * i));
+    }
+
+    bench.rev = new_fluid_revmodel(SAMPLE_RATE);
+    TEST_ASSERT(bench.rev != NULL);
+
+    for(i = 0; i < FLUID_N_ELEMENTS(decimations); i++)
+    {
+        TEST_SUCCESS(fluid_revmodel_set_decimation(bench.rev, decimations[i]));
+        fluid_revmodel_set(bench.rev, FLUID_REVMODEL_SET_ALL, 0.2f, 0.0f, 0.5f, 0.9f);
+
+        FLUID_SNPRINTF(params, sizeof(params), "rate=%d decimation=%d", SAMPLE_RATE, decimations[i]);
+        bench_run("revmodel_processmix", params, reverb, NULL, &bench, 0);
+    }
+
+    bench.chorus = new_fluid_chorus(SAMPLE_RATE);
+    TEST_ASSERT(bench.chorus != NULL);
+
+    for(i = 0; i < FLUID_N_ELEMENTS(nrs); i++)
+    {
+        fluid_chorus_set(bench.chorus, FLUID_CHORUS_SET_ALL, nrs[i], 2.0f, 0.3f, 8.0f, FLUID_CHORUS_MOD_SINE);
+
+        FLUID_SNPRINTF(params, sizeof(params), "rate=%d nr=%d", SAMPLE_RATE, nrs[i]);
+        bench_run("chorus_processmix", params, chorus, NULL, &bench, 0);
+    }
+
+    delete_fluid_chorus(bench.chorus);
+    delete_fluid_revmodel(bench.rev);
+
+    return EXIT_SUCCESS;
+}
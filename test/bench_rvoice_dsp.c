@@ -0,0 +1,171 @@
+#include "bench.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_phase.h"
+#include "rvoice/fluid_iir_filter.h"
+
+// benchmarks of the sample interpolators and of the IIR filter, one block of FLUID_BUFSIZE frames per iteration
+
+#define LOOP_START 64
+#define LOOP_LEN 4000
+#define LOOP_END (LOOP_START + LOOP_LEN)
+#define SAMPLE_LEN (LOOP_END + 8)
+#define NUM_FILTERS 64
+
+typedef struct
+{
+    int method;
+    fluid_rvoice_dsp_t voice;
+    fluid_real_t buf[FLUID_BUFSIZE];
+} interp_bench_t;
+
+typedef struct
+{
+    fluid_iir_filter_t filters[NUM_FILTERS];
+    fluid_iir_filter_t *filter_ptrs[NUM_FILTERS];
+    fluid_real_t buf[NUM_FILTERS][FLUID_BUFSIZE];
+    fluid_real_t *bufs[NUM_FILTERS];
+    int counts[NUM_FILTERS];
+} filter_bench_t;
+
+static short data[SAMPLE_LEN];
+
+static void interp(void *data)
+{
+    interp_bench_t *bench = data;
+
+    switch(bench->method)
+    {
+    case FLUID_INTERP_NONE:
+        fluid_rvoice_dsp_interpolate_none(&bench->voice, bench->buf, TRUE);
+        break;
+
+    case FLUID_INTERP_LINEAR:
+        fluid_rvoice_dsp_interpolate_linear(&bench->voice, bench->buf, TRUE);
+        break;
+
+    case FLUID_INTERP_4THORDER:
+        fluid_rvoice_dsp_interpolate_4th_order(&bench->voice, bench->buf, TRUE);
+        break;
+
+    default:
+        fluid_rvoice_dsp_interpolate_7th_order(&bench->voice, bench->buf, TRUE);
+        break;
+    }
+}
+
+static void bench_interp(const char *name, int method)
+{
+    static const double incrs[] = { 0.5, 1.0, 1.7 };
+    static fluid_sample_t sample;
+    static interp_bench_t bench;
+    char params[64];
+    unsigned int i;
+    int single;
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.start = 0;
+    sample.end = SAMPLE_LEN - 1;
+    sample.loopstart = LOOP_START;
+    sample.loopend = LOOP_END;
+
+    for(i = 0; i < FLUID_N_ELEMENTS(incrs) * 2; i++)
+    {
+        // each increment in double, then in single precision
+        single = (i >= FLUID_N_ELEMENTS(incrs));
+
+        FLUID_MEMSET(&bench, 0, sizeof(bench));
+        bench.method = method;
+        bench.voice.sample = &sample;
+        bench.voice.start = sample.start;
+        bench.voice.end = sample.end;
+        bench.voice.loopstart = sample.loopstart;
+        bench.voice.loopend = sample.loopend;
+        bench.voice.amp = 0.5;
+        bench.voice.phase_incr = incrs[i % FLUID_N_ELEMENTS(incrs)];
+        bench.voice.single_precision = single;
+        fluid_phase_set_int(bench.voice.phase, 8);
+
+        FLUID_SNPRINTF(params, sizeof(params), "incr=%.1f precision=%s",
+                       incrs[i % FLUID_N_ELEMENTS(incrs)], single ? "float" : "double");
+        bench_run(name, params, interp, NULL, &bench, 0);
+    }
+}
+
+static void init_filter(fluid_iir_filter_t *filter)
+{
+    FLUID_MEMSET(filter, 0, sizeof(*filter));
+
+    // a stable lowpass, with its coefficients settled
+    filter->type = FLUID_IIR_LOWPASS;
+    filter->q_lin = 1.5f;
+    filter->b02 = 0.02f;
+    filter->b1 = 0.04f;
+    filter->a1 = -1.8f;
+    filter->a2 = 0.82f;
+    filter->hist1 = 0.1f;
+}
+
+static void filter(void *data)
+{
+    filter_bench_t *bench = data;
+    int i;
+
+    for(i = 0; i < NUM_FILTERS; i++)
+    {
+        fluid_iir_filter_apply(&bench->filters[i], bench->buf[i], FLUID_BUFSIZE);
+    }
+}
+
+static void filter_batch(void *data)
+{
+    filter_bench_t *bench = data;
+
+    fluid_iir_filter_apply_batch(bench->filter_ptrs, bench->bufs, bench->counts, NUM_FILTERS);
+}
+
+// the filters are fed with their own output, which decays: restore the input each run to keep out denormals
+static void filter_reset(void *data)
+{
+    filter_bench_t *bench = data;
+    int i, k;
+
+    for(i = 0; i < NUM_FILTERS; i++)
+    {
+        init_filter(&bench->filters[i]);
+        bench->filter_ptrs[i] = &bench->filters[i];
+        bench->bufs[i] = bench->buf[i];
+        bench->counts[i] = FLUID_BUFSIZE;
+
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            bench->buf[i][k] = (fluid_real_t)FLUID_SIN(0.05 * (i + 1) * k);
+        }
+    }
+}
+
+int main(void)
+{
+    static filter_bench_t bench;
+    char params[32];
+    int i;
+
+    for(i = 0; i < SAMPLE_LEN; i++)
+    {
+        data[i] = (short)(20000 * FLUID_SIN(2 * M_PI * 7 * i / LOOP_LEN) + 5000 * FLUID_SIN(0.3 * i));
+    }
+
+    bench_interp("interpolate_none", FLUID_INTERP_NONE);
+    bench_interp("interpolate_linear", FLUID_INTERP_LINEAR);
+    bench_interp("interpolate_4th_order", FLUID_INTERP_4THORDER);
+    bench_interp("interpolate_7th_order", FLUID_INTERP_7THORDER);
+
+    // the filter output of a block is the input of the next one, keep the number of blocks in a run bounded
+    FLUID_SNPRINTF(params, sizeof(params), "filters=%d", NUM_FILTERS);
+    bench_run("iir_filter_apply", params, filter, filter_reset, &bench, 1024);
+    bench_run("iir_filter_apply_batch", params, filter_batch, filter_reset, &bench, 1024);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+#include "bench.h"
+#include "fluidsynth.h"
+
+// benchmarks of the synth: the mixer rendering a given number of voices with a given number of threads,
+// with and without prefetching the voices, the note-on latency, and the time it takes to load a SoundFont
+
+#define MAX_NOTES 128
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    int voices;
+    int key;
+    const char *filename;
+    float left[FLUID_BUFSIZE];
+    float right[FLUID_BUFSIZE];
+} synth_bench_t;
+
+// the settings of a synth must not be changed after deleting it, so create them with the synth
+static fluid_synth_t *create_synth(fluid_settings_t **settings, int cores, int prefetch)
+{
+    fluid_synth_t *synth;
+
+    *settings = new_fluid_settings();
+    TEST_ASSERT(*settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.cpu-cores", cores));
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.voice-prefetch", prefetch));
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.polyphony", 1024));
+
+    synth = new_fluid_synth(*settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+static void render(void *data)
+{
+    synth_bench_t *bench = data;
+
+    TEST_SUCCESS(fluid_synth_write_float(bench->synth, FLUID_BUFSIZE, bench->left, 0, 1, bench->right, 0, 1));
+}
+
+static void silence(void *data)
+{
+    synth_bench_t *bench = data;
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(bench->synth, -1));
+    render(bench);
+    bench->key = 0;
+}
+
+// start held notes over all channels until the requested number of voices are playing
+static void start_voices(void *data)
+{
+    synth_bench_t *bench = data;
+    int i;
+
+    silence(bench);
+
+    for(i = 0; i < 16 * MAX_NOTES && fluid_synth_get_active_voice_count(bench->synth) < bench->voices; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(bench->synth, i % 16, 36 + (i / 16) % 60, 100));
+    }
+}
+
+static void noteon(void *data)
+{
+    synth_bench_t *bench = data;
+
+    TEST_SUCCESS(fluid_synth_noteon(bench->synth, bench->key % 16, 36 + bench->key % 60, 100));
+    bench->key++;
+}
+
+static void load(void *data)
+{
+    synth_bench_t *bench = data;
+    int id = fluid_synth_sfload(bench->synth, bench->filename, 0);
+
+    TEST_ASSERT(id != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_sfunload(bench->synth, id, 0));
+}
+
+int main(void)
+{
+    static synth_bench_t bench;
+    static const int voices[] = { 1, 16, 64, 256 };
+    static const int cores[] = { 1, 2, 4 };
+    fluid_settings_t *settings;
+    char params[64];
+    unsigned int i, k;
+    int id;
+
+    for(k = 0; k < FLUID_N_ELEMENTS(cores); k++)
+    {
+        bench.synth = create_synth(&settings, cores[k], TRUE);
+
+        for(i = 0; i < FLUID_N_ELEMENTS(voices); i++)
+        {
+            bench.voices = voices[i];
+            FLUID_SNPRINTF(params, sizeof(params), "voices=%d threads=%d", voices[i], cores[k]);
+
+            // the notes are held, but don't render them long enough for the samples without loop to end
+            bench_run("synth_write_float", params, render, start_voices, &bench, 256);
+        }
+
+        silence(&bench);
+        delete_fluid_synth(bench.synth);
+        delete_fluid_settings(settings);
+    }
+
+    // the gain of prefetching the voices grows with their count
+    for(k = 0; k < 2; k++)
+    {
+        bench.synth = create_synth(&settings, 1, k);
+        bench.voices = 512;
+        FLUID_SNPRINTF(params, sizeof(params), "voices=512 prefetch=%u", k);
+        bench_run("synth_write_float", params, render, start_voices, &bench, 256);
+
+        silence(&bench);
+        delete_fluid_synth(bench.synth);
+        delete_fluid_settings(settings);
+    }
+
+    bench.synth = create_synth(&settings, 1, TRUE);
+    bench_run("synth_noteon", "", noteon, silence, &bench, MAX_NOTES);
+
+    bench.filename = TEST_SOUNDFONT;
+    bench_run("synth_sfload", "format=sf2", load, NULL, &bench, 16);
+
+    // SF3 files can only be loaded with libvorbisfile or libsndfile
+    id = fluid_synth_sfload(bench.synth, TEST_SOUNDFONT_SF3, 0);
+
+    if(id != FLUID_FAILED)
+    {
+        TEST_SUCCESS(fluid_synth_sfunload(bench.synth, id, 0));
+
+        bench.filename = TEST_SOUNDFONT_SF3;
+        bench_run("synth_sfload", "format=sf3", load, NULL, &bench, 16);
+    }
+
+    silence(&bench);
+    delete_fluid_synth(bench.synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
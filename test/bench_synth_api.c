@@ -0,0 +1,308 @@
+#include "bench.h"
+#include "fluidsynth.h"
+
+// benchmark of the contention on the synth.threadsafe-api lock: producer threads calling noteon, cc and
+// pitch_bend, and a sequencer timer thread, while the synth renders blocks as fast as it can.
+//
+// usage: bench_synth_api [max producers [milliseconds between two cycles of calls of a producer]]
+//
+// for each count of producers, the latency percentiles of their API calls and of the processing of the
+// sequencer are printed, followed by the ones of the rendering of an audio period, with their inflation
+// over the rendering without any other thread calling the synth, which includes the rendering of the
+// notes the producers start, e.g.
+//
+//     synth_api_call,producers=2 percentile=99,<calls>,<nanoseconds>
+//     synth_write_float,producers=2 percentile=99 inflation=1.42,<periods>,<nanoseconds>
+//
+// the clock only has a resolution of a microsecond, the cost of the calls without contention is measured
+// on its own. With 0 milliseconds between two cycles, the producers call the synth as fast as they can.
+
+#define PERIOD 1024             // frames rendered at once, as by an audio driver
+#define PERIODS 512             // rendered per count of producers
+#define NOTES 16                // played while rendering
+#define RETRIGGER 16            // periods after which they are started again, as the samples may not loop
+#define MAX_PRODUCERS 64
+#define MAX_CALLS 65536         // latencies kept per thread, later calls are made but not timed
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    fluid_sequencer_t *seq;
+    fluid_seq_id_t dest;
+    int chan;
+    unsigned int pause;
+    volatile int *stop;
+
+    int count;
+    double latencies[MAX_CALLS];
+} producer_t;
+
+static const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+
+static void add_latency(producer_t *producer, double start)
+{
+    if(producer->count < MAX_CALLS)
+    {
+        producer->latencies[producer->count++] = fluid_utime() - start;
+    }
+}
+
+// a MIDI thread cycling through the channel messages the synth handles the most
+static fluid_thread_return_t produce(void *data)
+{
+    producer_t *producer = data;
+    fluid_synth_t *synth = producer->synth;
+    int chan = producer->chan, key = 0;
+    double start;
+
+    while(!fluid_atomic_int_get(producer->stop))
+    {
+        // may run out of voices, which is fine
+        start = fluid_utime();
+        fluid_synth_noteon(synth, chan, 36 + key, 100);
+        add_latency(producer, start);
+
+        start = fluid_utime();
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 1, key));
+        add_latency(producer, start);
+
+        start = fluid_utime();
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, 8192 + 64 * key));
+        add_latency(producer, start);
+
+        start = fluid_utime();
+        fluid_synth_noteoff(synth, chan, 36 + key);
+        add_latency(producer, start);
+
+        key = (key + 1) % 60;
+
+        if(producer->pause > 0)
+        {
+            fluid_msleep(producer->pause);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+// the sequencer timer: schedules a note every millisecond and times the processing of the due events
+static fluid_thread_return_t sequence(void *data)
+{
+    producer_t *producer = data;
+    fluid_event_t *evt = new_fluid_event();
+    unsigned int now = 0;
+    double start;
+
+    TEST_ASSERT(evt != NULL);
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, producer->dest);
+
+    while(!fluid_atomic_int_get(producer->stop))
+    {
+        fluid_event_note(evt, producer->chan, 36 + now % 60, 100, 5);
+        TEST_SUCCESS(fluid_sequencer_send_at(producer->seq, evt, now + 1, TRUE));
+
+        start = fluid_utime();
+        fluid_sequencer_process(producer->seq, now);
+        add_latency(producer, start);
+
+        fluid_msleep(1);
+        now++;
+    }
+
+    delete_fluid_event(evt);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+// the calls of a producer, without any timing
+static void cycle(void *data)
+{
+    producer_t *producer = data;
+
+    fluid_synth_noteon(producer->synth, producer->chan, 60, 100);
+    TEST_SUCCESS(fluid_synth_cc(producer->synth, producer->chan, 1, 64));
+    TEST_SUCCESS(fluid_synth_pitch_bend(producer->synth, producer->chan, 8192));
+    fluid_synth_noteoff(producer->synth, producer->chan, 60);
+}
+
+// frees the voices of the cycles
+static void silence(void *data)
+{
+    producer_t *producer = data;
+    float buf[FLUID_BUFSIZE];
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(producer->synth, producer->chan));
+    TEST_SUCCESS(fluid_synth_write_float(producer->synth, FLUID_BUFSIZE, buf, 0, 1, buf, 0, 1));
+}
+
+// the load of the renderer, on the channels the producers don't use
+static void start_voices(fluid_synth_t *synth)
+{
+    int i;
+
+    for(i = 0; i < NOTES; i++)
+    {
+        fluid_synth_noteon(synth, 15 - i % 4, 36 + i % 60, 100);
+    }
+}
+
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// sorts the latencies in microseconds, and prints their percentiles in nanoseconds, along with their
+// inflation over a baseline if given, which is set by the run without producers
+static void print_percentiles(const char *name, int producers, double *latencies, int count, double *baseline)
+{
+    unsigned int i;
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    qsort(latencies, count, sizeof(*latencies), compare);
+
+    for(i = 0; i < FLUID_N_ELEMENTS(percentiles); i++)
+    {
+        int k = (int)(percentiles[i] / 100 * (count - 1) + 0.5);
+        double t = latencies[k];
+
+        if(baseline != NULL)
+        {
+            if(producers == 0)
+            {
+                baseline[i] = t;
+            }
+
+            printf("%s,producers=%d percentile=%g inflation=%.2f,%d,%.1f\n",
+                   name, producers, percentiles[i], (baseline[i] > 0) ? t / baseline[i] : 1.0,
+                   count, t * 1000.0);
+        }
+        else
+        {
+            printf("%s,producers=%d percentile=%g,%d,%.1f\n", name, producers, percentiles[i],
+                   count, t * 1000.0);
+        }
+    }
+
+    fflush(stdout);
+}
+
+static void run(int producers, unsigned int pause, double *render_baseline)
+{
+    static producer_t threads[MAX_PRODUCERS + 1];
+    static double periods[PERIODS], latencies[MAX_PRODUCERS * MAX_CALLS];
+    static float left[PERIOD], right[PERIOD];
+    fluid_thread_t *ids[MAX_PRODUCERS + 1];
+    volatile int stop = FALSE;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sequencer_t *seq;
+    fluid_seq_id_t dest;
+    int i, k, count, n = 0;
+    double start;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.threadsafe-api", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 1024));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // advanced by the timer thread rather than the system timer, so that its processing can be timed
+    seq = new_fluid_sequencer2(FALSE);
+    TEST_ASSERT(seq != NULL);
+    dest = fluid_sequencer_register_fluidsynth(seq, synth);
+    TEST_ASSERT(dest != FLUID_FAILED);
+
+    if(producers == 0)
+    {
+        threads[0].synth = synth;
+        threads[0].chan = 0;
+        bench_run("synth_api_cycle", "producers=0", cycle, silence, &threads[0], 64);
+    }
+
+    // the sequencer only runs along with producers, for the baseline to render undisturbed
+    count = (producers > 0) ? producers + 1 : 0;
+
+    for(i = 0; i < count; i++)
+    {
+        threads[i].synth = synth;
+        threads[i].seq = seq;
+        threads[i].dest = dest;
+        threads[i].chan = i % 12;
+        threads[i].pause = pause;
+        threads[i].stop = &stop;
+        threads[i].count = 0;
+
+        ids[i] = new_fluid_thread((i < producers) ? "producer" : "sequencer",
+                                  (i < producers) ? produce : sequence, &threads[i], 0, FALSE);
+        TEST_ASSERT(ids[i] != NULL);
+    }
+
+    for(i = 0; i < PERIODS; i++)
+    {
+        if(i % RETRIGGER == 0)
+        {
+            start_voices(synth);
+        }
+
+        start = fluid_utime();
+        TEST_SUCCESS(fluid_synth_write_float(synth, PERIOD, left, 0, 1, right, 0, 1));
+        periods[i] = fluid_utime() - start;
+    }
+
+    fluid_atomic_int_set(&stop, TRUE);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_SUCCESS(fluid_thread_join(ids[i]));
+        delete_fluid_thread(ids[i]);
+
+        if(i < producers)
+        {
+            for(k = 0; k < threads[i].count; k++)
+            {
+                latencies[n++] = threads[i].latencies[k];
+            }
+        }
+    }
+
+    print_percentiles("synth_api_call", producers, latencies, n, NULL);
+
+    if(count > 0)
+    {
+        print_percentiles("sequencer_process", producers, threads[producers].latencies, threads[producers].count,
+                          NULL);
+    }
+
+    print_percentiles("synth_write_float", producers, periods, PERIODS, render_baseline);
+
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(int argc, char *argv[])
+{
+    double render_baseline[FLUID_N_ELEMENTS(percentiles)] = { 0 };
+    int max_producers = (argc > 1) ? atoi(argv[1]) : 4;
+    unsigned int pause = (argc > 2) ? (unsigned int)atoi(argv[2]) : 1;
+    int producers;
+
+    TEST_ASSERT(max_producers >= 0 && max_producers <= MAX_PRODUCERS);
+
+    run(0, pause, render_baseline);
+
+    for(producers = 1; producers <= max_producers; producers *= 2)
+    {
+        run(producers, pause, render_baseline);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the objects of an arena are aligned and never overlap, also when
+// larger than its blocks, and that the presets of a SoundFont whose zones are taken from an
+// arena still play once others have been imported after them
+
+#define BLOCK_SIZE 256
+#define NUM_OBJECTS 1000
+
+int main(void)
+{
+    fluid_arena_t *arena;
+    unsigned char *obj[NUM_OBJECTS];
+    char *str;
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float buf[2 * 1024];
+    int i, k, size;
+
+    arena = new_fluid_arena(BLOCK_SIZE);
+    TEST_ASSERT(arena != NULL);
+
+    for(i = 0; i < NUM_OBJECTS; i++)
+    {
+        // mostly small objects, some larger than a quarter or all of a block
+        size = (i % 10 == 9) ? BLOCK_SIZE * (i % 3 + 1) - 1 : i % 50 + 1;
+        obj[i] = fluid_arena_alloc(arena, size);
+        TEST_ASSERT(obj[i] != NULL);
+        TEST_ASSERT(((uintptr_t)obj[i] % 16) == 0);
+        FLUID_MEMSET(obj[i], i & 0xff, size);
+    }
+
+    for(i = 0; i < NUM_OBJECTS; i++)
+    {
+        size = (i % 10 == 9) ? BLOCK_SIZE * (i % 3 + 1) - 1 : i % 50 + 1;
+
+        for(k = 0; k < size; k++)
+        {
+            TEST_ASSERT(obj[i][k] == (i & 0xff));
+        }
+    }
+
+    str = fluid_arena_strdup(arena, "pz:Piano/0");
+    TEST_ASSERT(str != NULL);
+    TEST_ASSERT(FLUID_STRCMP(str, "pz:Piano/0") == 0);
+
+    delete_fluid_arena(arena);
+    delete_fluid_arena(NULL);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lazy-preset-loading", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, i, i * 8));
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, 1024, buf, 0, 2, buf, 1, 2));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_chorus.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the chorus blocks, read along ramps computed once per block,
+// only read samples of the delay line that were written, and that processmix() equals
+// processreplace()
+
+#define BLOCKS 2000
+#define LEVEL 2.0
+
+// relative to the level of the output, the blocks summed up lose a few bits each
+#ifdef WITH_FLOAT
+#define EPS 1e-5
+#else
+#define EPS 1e-6
+#endif
+
+static void test_chorus(fluid_real_t sample_rate, int nr, fluid_real_t speed, fluid_real_t depth_ms, int type)
+{
+    fluid_chorus_t *chorus_replace = new_fluid_chorus(sample_rate);
+    fluid_chorus_t *chorus_mix = new_fluid_chorus(sample_rate);
+    fluid_real_t in[FLUID_BUFSIZE], left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    fluid_real_t mix_left[FLUID_BUFSIZE], mix_right[FLUID_BUFSIZE];
+    fluid_real_t expected, eps;
+    int b, k;
+
+    TEST_ASSERT(chorus_replace != NULL);
+    TEST_ASSERT(chorus_mix != NULL);
+    fluid_chorus_set(chorus_replace, FLUID_CHORUS_SET_ALL, nr, LEVEL, speed, depth_ms, type);
+    fluid_chorus_set(chorus_mix, FLUID_CHORUS_SET_ALL, nr, LEVEL, speed, depth_ms, type);
+
+    // with a constant input, each block outputs the same constant once the delay line is
+    // filled, the stereo unit sums them with the same weight to both outputs
+    expected = ((nr + 1) / 2) * LEVEL / 3.0;
+    eps = EPS * (expected + 1.0);
+
+    for(b = 0; b < BLOCKS; b++)
+    {
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            in[k] = 1.0;
+            mix_left[k] = mix_right[k] = 0.25;
+        }
+
+        fluid_chorus_processreplace(chorus_replace, in, left, right);
+        fluid_chorus_processmix(chorus_mix, in, mix_left, mix_right);
+
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            TEST_ASSERT(FLUID_FABS(mix_left[k] - 0.25 - left[k]) < eps);
+            TEST_ASSERT(FLUID_FABS(mix_right[k] - 0.25 - right[k]) < eps);
+
+            if(b >= BLOCKS / 2)
+            {
+                TEST_ASSERT(FLUID_FABS(left[k] - expected) < eps);
+                TEST_ASSERT(FLUID_FABS(right[k] - expected) < eps);
+            }
+        }
+    }
+
+    // a reset silences the chorus at once
+    fluid_chorus_reset(chorus_replace);
+    FLUID_MEMSET(in, 0, sizeof(in));
+
+    for(b = 0; b < 10; b++)
+    {
+        fluid_chorus_processreplace(chorus_replace, in, left, right);
+
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            TEST_ASSERT(left[k] == 0 && right[k] == 0);
+        }
+    }
+
+    delete_fluid_chorus(chorus_replace);
+    delete_fluid_chorus(chorus_mix);
+}
+
+int main(void)
+{
+    static const int nr[] = { 2, 3, 8, 99 };
+    unsigned int i;
+
+    for(i = 0; i < FLUID_N_ELEMENTS(nr); i++)
+    {
+        test_chorus(44100, nr[i], 0.3, 8.0, FLUID_CHORUS_MOD_SINE);
+        test_chorus(44100, nr[i], 5.0, 40.0, FLUID_CHORUS_MOD_TRIANGLE);
+        // the steepest ramps: max speed and max depth at a low sample rate
+        test_chorus(8000, nr[i], 5.0, 256.0, FLUID_CHORUS_MOD_SINE);
+        test_chorus(96000, nr[i], 5.0, 21.0, FLUID_CHORUS_MOD_TRIANGLE);
+    }
+
+    return EXIT_SUCCESS;
+}
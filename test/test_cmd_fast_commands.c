@@ -0,0 +1,90 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "bindings/fluid_cmd.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the most frequent commands, parsed without their regular handler,
+// have the same effect, and that anything unusual about them is still left to the handler
+
+static int custom_calls;
+
+static int custom_noteon(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    custom_calls++;
+    return FLUID_OK;
+}
+
+static int get_cc(fluid_synth_t *synth, int chan, int num)
+{
+    int value = -1;
+    TEST_SUCCESS(fluid_synth_get_cc(synth, chan, num, &value));
+    return value;
+}
+
+int main(void)
+{
+    const fluid_cmd_t custom = { "noteon", "event", custom_noteon, "noteon chan key vel" };
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_cmd_handler_t *handler;
+    fluid_ostream_t out = FLUID_NULL_OSTREAM;
+    float buf[FLUID_BUFSIZE];
+    int val;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    handler = new_fluid_cmd_handler(synth, NULL);
+    TEST_ASSERT(handler != NULL);
+
+    TEST_SUCCESS(fluid_command(handler, "noteon 0 60 100", out));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    TEST_SUCCESS(fluid_command(handler, "  noteoff\t0  60 ", out));
+    TEST_SUCCESS(fluid_command(handler, "cc 1 7 99", out));
+    TEST_ASSERT(get_cc(synth, 1, 7) == 99);
+    TEST_SUCCESS(fluid_command(handler, "pitch_bend 2 +1000", out));
+    TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, 2, &val));
+    TEST_ASSERT(val == 1000);
+    TEST_SUCCESS(fluid_command(handler, "prog 3 1", out));
+    TEST_SUCCESS(fluid_synth_get_program(synth, 3, &val, &val, &val));
+    TEST_ASSERT(val == 1);
+
+    // the synth rejects what's out of range
+    TEST_ASSERT(fluid_command(handler, "cc -1 7 99", out) == FLUID_FAILED);
+    TEST_ASSERT(fluid_command(handler, "noteon 0 60 1000000000000", out) == FLUID_FAILED);
+
+    // too few arguments, or arguments the regular handler accepts differently
+    TEST_ASSERT(fluid_command(handler, "noteon 0 60", out) == FLUID_FAILED);
+    TEST_ASSERT(fluid_command(handler, "cc 1 7 x", out) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_command(handler, "cc 1 7 12.7", out));
+    TEST_ASSERT(get_cc(synth, 1, 7) == 12);
+    TEST_SUCCESS(fluid_command(handler, "cc 1 7 13 extra", out));
+    TEST_ASSERT(get_cc(synth, 1, 7) == 13);
+    TEST_SUCCESS(fluid_command(handler, "cc \"1\" 7 14", out));
+    TEST_ASSERT(get_cc(synth, 1, 7) == 14);
+    TEST_ASSERT(fluid_command(handler, "ccc 1 7 15", out) == FLUID_FAILED);
+    TEST_ASSERT(get_cc(synth, 1, 7) == 14);
+
+    // a command registered again runs its new handler
+    TEST_SUCCESS(fluid_cmd_handler_register(handler, &custom));
+    TEST_SUCCESS(fluid_command(handler, "noteon 0 62 100", out));
+    TEST_ASSERT(custom_calls == 1);
+
+    TEST_ASSERT(fluid_cmd_handler_unregister(handler, "noteon"));
+    TEST_ASSERT(fluid_command(handler, "noteon 0 62 100", out) == FLUID_FAILED);
+    TEST_ASSERT(custom_calls == 1);
+
+    // nothing is written to the null stream
+    TEST_ASSERT(fluid_ostream_printf(FLUID_NULL_OSTREAM, "%s\n", "discarded") == 0);
+
+    // let the voices started finish
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 1, buf, 0, 1));
+
+    delete_fluid_cmd_handler(handler);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
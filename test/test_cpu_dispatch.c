@@ -0,0 +1,97 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice_mixer.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the variants of the DSP kernels selected for the CPU render the same
+// as the generic ones, and that FLUID_CPU_FEATURES restricts the features they are selected for
+
+#define FRAMES (16 * FLUID_BUFSIZE)
+
+// render a chord into left and right, using the interpolation method interp
+static void render(float *left, float *right, int interp)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 80));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 60));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// select the kernels again for the features allowed by env
+static void select_kernels(const char *env)
+{
+    TEST_ASSERT(g_setenv("FLUID_CPU_FEATURES", env, TRUE));
+    fluid_cpu_dispatch_init();
+    fluid_rvoice_mixer_dispatch_config();
+    fluid_rvoice_dsp_dispatch_config();
+}
+
+int main(void)
+{
+    static const int interps[] = { FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER };
+    static float left[3][FRAMES], right[3][FRAMES], generic_left[FRAMES], generic_right[FRAMES];
+    unsigned int detected;
+    const char *str;
+    int i, j;
+
+    str = fluid_version_dsp_str();
+    TEST_ASSERT(FLUID_STRNCMP(str, "cpu=", 4) == 0);
+    TEST_ASSERT(FLUID_STRCHR(str, ' ') != NULL && FLUID_STRNCMP(FLUID_STRCHR(str, ' '), " mix=", 5) == 0);
+    TEST_ASSERT(strstr(str, " interp=") != NULL);
+    detected = fluid_cpu_features();
+
+    for(j = 0; j < 3; j++)
+    {
+        render(left[j], right[j], interps[j]);
+    }
+
+    // the generic kernels only
+    select_kernels("none");
+    TEST_ASSERT(fluid_cpu_features() == 0);
+    TEST_ASSERT(FLUID_STRNCMP(fluid_version_dsp_str(), "cpu=none mix=", 13) == 0);
+    TEST_ASSERT(FLUID_STRNCMP(fluid_version_dsp_str(), "cpu=none mix=avx", 16) != 0);
+    TEST_ASSERT(strstr(fluid_version_dsp_str(), " interp=avx") == NULL);
+
+    // the same up to rounding, the variants of the mixer may fuse the multiply-add
+    for(j = 0; j < 3; j++)
+    {
+        render(generic_left, generic_right, interps[j]);
+
+        for(i = 0; i < FRAMES; i++)
+        {
+            TEST_ASSERT(fabs(left[j][i] - generic_left[i]) <= 1e-5);
+            TEST_ASSERT(fabs(right[j][i] - generic_right[i]) <= 1e-5);
+        }
+    }
+
+    // whole items only, and no feature the CPU lacks
+    select_kernels("avx512");
+    TEST_ASSERT(fluid_cpu_features() == 0);
+
+    select_kernels("sse2,bogus,neon");
+    TEST_ASSERT(fluid_cpu_features() == (detected & (FLUID_CPU_SSE2 | FLUID_CPU_NEON)));
+
+    select_kernels("avx2,avx512f,sse2,neon,simd128");
+    TEST_ASSERT(fluid_cpu_features() == detected);
+
+    g_unsetenv("FLUID_CPU_FEATURES");
+
+    return EXIT_SUCCESS;
+}
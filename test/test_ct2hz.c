@@ -14,10 +14,15 @@ int float_eq(fluid_real_t x, fluid_real_t y)
 
 int main(void)
 {
+#ifdef ENABLE_RUNTIME_TABLES
+    // without a synth, nobody else computes the tables
+    fluid_conversion_config();
+#endif
+
     // 440 * 2^((x-6900)/1200) where x is the cent value given to ct2hz()
 
 
-    TEST_ASSERT(float_eq(fluid_ct2hz_real(38099), 2.9510849101059895e10));
+    TEST_ASSERT(float_eq(fluid_ct2hz_real(38099), 2.9510849101059884e10));
 
     TEST_ASSERT(float_eq(fluid_ct2hz_real(13500), 19912.12696));
 
@@ -36,5 +41,35 @@ int main(void)
     TEST_ASSERT(float_eq(fluid_ct2hz_real(1), 8.180522806));
     TEST_ASSERT(float_eq(fluid_ct2hz_real(0), 8.175798916)); // often referred to as Absolute zero in the SF2 spec
 
+    // the batched conversion used by the voices gives the very same results, negative cents included
+    {
+        fluid_real_t cents[] = { 38099, 13500, 12899, 6900.5, 901, 1, 0, -0.5, -1200 };
+        fluid_real_t hz[FLUID_N_ELEMENTS(cents)];
+        unsigned int i;
+
+        FLUID_MEMCPY(hz, cents, sizeof(cents));
+        fluid_ct2hz_real_batch(hz, FLUID_N_ELEMENTS(hz));
+
+        for(i = 0; i < FLUID_N_ELEMENTS(cents); i++)
+        {
+            TEST_ASSERT(hz[i] == fluid_ct2hz_real(cents[i]));
+        }
+    }
+
+    // so does the batched conversion of attenuations, beyond both ends of the table too
+    {
+        fluid_real_t cb[] = { -100, -0.5, 0, 0.5, 1, 200.7, 1439.9, FLUID_CB_AMP_SIZE - 1, FLUID_CB_AMP_SIZE, 5000 };
+        fluid_real_t amp[FLUID_N_ELEMENTS(cb)];
+        unsigned int i;
+
+        FLUID_MEMCPY(amp, cb, sizeof(cb));
+        fluid_cb2amp_batch(amp, FLUID_N_ELEMENTS(amp));
+
+        for(i = 0; i < FLUID_N_ELEMENTS(cb); i++)
+        {
+            TEST_ASSERT(amp[i] == fluid_cb2amp(cb[i]));
+        }
+    }
+
     return EXIT_SUCCESS;
 }
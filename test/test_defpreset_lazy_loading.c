@@ -0,0 +1,115 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.lazy-preset-loading the zones of a preset are only imported
+// once the preset is used, that it then sounds the same as when imported at load, and that the
+// parsed file is freed once all presets have been imported
+
+#define BLOCKS 16
+
+static fluid_synth_t *new_test_synth(fluid_settings_t *settings, int lazy, int *id)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lazy-preset-loading", lazy));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT((*id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0)) != FLUID_FAILED);
+
+    return synth;
+}
+
+static void render_preset(fluid_synth_t *synth, int id, fluid_preset_t *preset, float *out)
+{
+    float right[FLUID_BUFSIZE];
+    int i;
+
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, fluid_preset_get_banknum(preset),
+                                            fluid_preset_get_num(preset)));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 40));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, out, i * FLUID_BUFSIZE, 1, right, 0, 1));
+    }
+}
+
+int main(void)
+{
+    static float eager_out[BLOCKS * FLUID_BUFSIZE], lazy_out[BLOCKS * FLUID_BUFSIZE];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *eager, *lazy;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset, *first = NULL;
+    fluid_defsfont_t *defsfont;
+    fluid_defpreset_t *defpreset;
+    int eager_id, lazy_id, count = 0, i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    eager = new_test_synth(settings, 0, &eager_id);
+    lazy = new_test_synth(settings, 1, &lazy_id);
+
+    TEST_ASSERT((sfont = fluid_synth_get_sfont_by_id(lazy, lazy_id)) != NULL);
+    defsfont = fluid_sfont_get_data(sfont);
+
+    // the presets are listed, but their zones aren't imported yet
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        defpreset = fluid_preset_get_data(preset);
+        TEST_ASSERT(defpreset->sfpreset != NULL);
+        TEST_ASSERT(defpreset->zone == NULL && defpreset->zone_table == NULL);
+
+        if(first == NULL)
+        {
+            first = preset;
+        }
+
+        count++;
+    }
+
+    TEST_ASSERT(count > 1);
+    TEST_ASSERT(defsfont->num_lazy_presets == count);
+    TEST_ASSERT(defsfont->sfdata != NULL);
+
+    // selecting a preset imports it, and only it
+    render_preset(lazy, lazy_id, first, lazy_out);
+    defpreset = fluid_preset_get_data(first);
+    TEST_ASSERT(defpreset->sfpreset == NULL);
+    TEST_ASSERT(defpreset->zone_table != NULL);
+    TEST_ASSERT(defsfont->num_lazy_presets == count - 1);
+
+    // sounding the same as when imported at load
+    render_preset(eager, eager_id, first, eager_out);
+
+    for(i = 0; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        TEST_ASSERT(eager_out[i] == lazy_out[i]);
+    }
+
+    // the parsed file is freed once every preset has been imported
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        TEST_ASSERT(fluid_sfont_get_preset(sfont, fluid_preset_get_banknum(preset),
+                                           fluid_preset_get_num(preset)) == preset);
+    }
+
+    TEST_ASSERT(defsfont->num_lazy_presets == 0);
+    TEST_ASSERT(defsfont->sfdata == NULL);
+
+    delete_fluid_synth(lazy);
+    delete_fluid_synth(eager);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the voices started from the generators precomputed for each voice zone
+// get the same generators as when merging the instrument and preset zones with their global zones
+
+#define MAX_ENTRIES 64
+
+// the generators of the voice started by a zone table entry, computed from the zones
+static void expected_gens(fluid_defpreset_t *defpreset, fluid_zone_table_entry_t *entry, fluid_gen_t *gen)
+{
+    fluid_preset_zone_t *preset_zone = entry->preset_zone;
+    fluid_inst_zone_t *inst_zone = entry->voice_zone->inst_zone;
+    fluid_inst_zone_t *global_inst_zone = fluid_inst_get_global_zone(fluid_preset_zone_get_inst(preset_zone));
+    fluid_preset_zone_t *global_preset_zone = fluid_defpreset_get_global_zone(defpreset);
+    int i;
+
+    fluid_gen_init(gen, NULL);
+
+    // the voice takes the values as floats
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(inst_zone->gen[i].flags)
+        {
+            gen[i].val = (float)inst_zone->gen[i].val;
+        }
+        else if(global_inst_zone != NULL && global_inst_zone->gen[i].flags)
+        {
+            gen[i].val = (float)global_inst_zone->gen[i].val;
+        }
+
+        if(preset_zone->gen[i].flags)
+        {
+            gen[i].val += (float)preset_zone->gen[i].val;
+        }
+        else if(global_preset_zone != NULL && global_preset_zone->gen[i].flags)
+        {
+            gen[i].val += (float)global_preset_zone->gen[i].val;
+        }
+    }
+}
+
+static int voice_has_gens(fluid_voice_t *voice, const fluid_gen_t *gen)
+{
+    int i;
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        // the pitch is computed by the voice from its key
+        if(i != GEN_PITCH && voice->gen[i].val != gen[i].val)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void verify_note(fluid_synth_t *synth, fluid_defpreset_t *defpreset, int key, int vel)
+{
+    static fluid_gen_t gen[MAX_ENTRIES][GEN_LAST];
+    int matched[MAX_ENTRIES];
+    int i, k, cell, entry, num_entries, playing = 0, num_default_mods = 0;
+    float buf[FLUID_BUFSIZE];
+    fluid_mod_t *mod;
+
+    for(mod = synth->default_mod; mod != NULL; mod = mod->next)
+    {
+        num_default_mods++;
+    }
+
+    cell = key * defpreset->num_vel_buckets + defpreset->vel_bucket[vel];
+    entry = defpreset->zone_table_index[cell];
+    num_entries = defpreset->zone_table_index[cell + 1] - entry;
+    TEST_ASSERT(num_entries <= MAX_ENTRIES);
+
+    for(k = 0; k < num_entries; k++)
+    {
+        expected_gens(defpreset, &defpreset->zone_table[entry + k], gen[k]);
+        matched[k] = FALSE;
+    }
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, key, vel));
+
+    // every voice started has the generators of a voice zone using its sample
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        if(!fluid_voice_is_playing(voice))
+        {
+            continue;
+        }
+
+        for(k = 0; k < num_entries; k++)
+        {
+            if(!matched[k] && defpreset->zone_table[entry + k].voice_zone->inst_zone->sample == voice->sample
+                    && voice_has_gens(voice, gen[k]))
+            {
+                matched[k] = TRUE;
+                break;
+            }
+        }
+
+        TEST_ASSERT(k < num_entries);
+
+        // the default modulators, and those of the zones in place of the identic ones
+        TEST_ASSERT(voice->mod_count >= num_default_mods);
+        playing++;
+    }
+
+    TEST_ASSERT(playing == num_entries);
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, 0));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 1, buf, 0, 1));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+}
+
+int main(void)
+{
+    int id, key, count = 0;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset;
+
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", MAX_ENTRIES));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_ASSERT((sfont = fluid_synth_get_sfont_by_id(synth, id)) != NULL);
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        fluid_defpreset_t *defpreset = fluid_preset_get_data(preset);
+
+        TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, fluid_preset_get_banknum(preset),
+                                                fluid_preset_get_num(preset)));
+
+        for(key = 0; key < 128; key += 5)
+        {
+            verify_note(synth, defpreset, key, 1 + (key * 31) % 127);
+        }
+
+        count++;
+    }
+
+    TEST_ASSERT(count > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
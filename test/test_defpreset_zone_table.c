@@ -0,0 +1,87 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the zone table of a preset lists exactly the zones
+// that used to be found by walking the zones of the preset, in the same order
+
+static void verify_zone_table(fluid_defpreset_t *defpreset)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+    int i, key, vel, cell, entry, last_entry;
+
+    for(key = 0; key < 128; key++)
+    {
+        for(vel = 0; vel < 128; vel++)
+        {
+            cell = key * defpreset->num_vel_buckets + defpreset->vel_bucket[vel];
+            entry = defpreset->zone_table_index[cell];
+            last_entry = defpreset->zone_table_index[cell + 1];
+
+            for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+            {
+                if(preset_zone->range.keylo > key || preset_zone->range.keyhi < key
+                        || preset_zone->range.vello > vel || preset_zone->range.velhi < vel)
+                {
+                    continue;
+                }
+
+                for(i = 0; i < preset_zone->num_voice_zones; i++)
+                {
+                    voice_zone = &preset_zone->voice_zone[i];
+
+                    if(voice_zone->range.keylo > key || voice_zone->range.keyhi < key
+                            || voice_zone->range.vello > vel || voice_zone->range.velhi < vel)
+                    {
+                        continue;
+                    }
+
+                    TEST_ASSERT(entry < last_entry);
+                    TEST_ASSERT(defpreset->zone_table[entry].preset_zone == preset_zone);
+                    TEST_ASSERT(defpreset->zone_table[entry].voice_zone == voice_zone);
+                    entry++;
+                }
+            }
+
+            TEST_ASSERT(entry == last_entry);
+        }
+    }
+}
+
+int main(void)
+{
+    int id, count = 0;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset;
+
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_ASSERT((sfont = fluid_synth_get_sfont_by_id(synth, id)) != NULL);
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        fluid_defpreset_t *defpreset = fluid_preset_get_data(preset);
+
+        TEST_ASSERT(defpreset->num_vel_buckets >= 1);
+        verify_zone_table(defpreset);
+        count++;
+    }
+
+    TEST_ASSERT(count > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that fluid_file_renderer_process_player() renders a MIDI file
+// completely, and that it writes all the audio to the file
+
+#define OUTPUT_FILE "test_file_renderer_player.raw"
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 13,
+    0x00, 0x90, 0x3c, 0x64,       // 0: note on
+    0x83, 0x60, 0x80, 0x3c, 0x00, // 480: note off
+    0x00, 0xff, 0x2f, 0x00,       // 480: end of track
+};
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    fluid_file_renderer_t *renderer;
+    FILE *file;
+    long size;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "audio.file.name", OUTPUT_FILE));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+
+    renderer = new_fluid_file_renderer(synth);
+    TEST_ASSERT(renderer != NULL);
+
+    TEST_SUCCESS(fluid_file_renderer_process_player(renderer, player));
+    TEST_ASSERT(fluid_player_get_status(player) == FLUID_PLAYER_DONE);
+
+    delete_fluid_file_renderer(renderer);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    // half a second of music, rendered as 16 bit stereo at least
+    file = FLUID_FOPEN(OUTPUT_FILE, "rb");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(fseek(file, 0, SEEK_END) == 0);
+    size = ftell(file);
+    fclose(file);
+    remove(OUTPUT_FILE);
+
+    TEST_ASSERT(size >= 44100 / 2 * 2 * (long)sizeof(short));
+    TEST_ASSERT(size % (2 * sizeof(short)) == 0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with audio.file.threaded fluid_file_renderer_process_block() writes
+// the same file as without, and that mixing it with fluid_file_renderer_process_player() keeps the order
+
+#define PLAIN_FILE "test_file_renderer_threaded_plain.raw"
+#define THREADED_FILE "test_file_renderer_threaded.raw"
+
+// not a multiple of the size of the blocks written at once by the thread
+#define BLOCKS 301
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 13,
+    0x00, 0x90, 0x3c, 0x64,       // 0: note on
+    0x83, 0x60, 0x80, 0x3c, 0x00, // 480: note off
+    0x00, 0xff, 0x2f, 0x00,       // 480: end of track
+};
+
+static void render(const char *filename, int threaded)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    fluid_file_renderer_t *renderer;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "audio.file.name", filename));
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.file.threaded", threaded));
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.period-size", 100));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    renderer = new_fluid_file_renderer(synth);
+    TEST_ASSERT(renderer != NULL);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_file_renderer_process_block(renderer));
+    }
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+    TEST_SUCCESS(fluid_file_renderer_process_player(renderer, player));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_file_renderer_process_block(renderer));
+    }
+
+    delete_fluid_file_renderer(renderer);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+static long file_size(FILE *file)
+{
+    long size;
+
+    TEST_ASSERT(fseek(file, 0, SEEK_END) == 0);
+    size = ftell(file);
+    TEST_ASSERT(fseek(file, 0, SEEK_SET) == 0);
+
+    return size;
+}
+
+int main(void)
+{
+    FILE *plain, *threaded;
+    long size;
+    int c;
+
+    render(PLAIN_FILE, 0);
+    render(THREADED_FILE, 1);
+
+    plain = FLUID_FOPEN(PLAIN_FILE, "rb");
+    TEST_ASSERT(plain != NULL);
+    threaded = FLUID_FOPEN(THREADED_FILE, "rb");
+    TEST_ASSERT(threaded != NULL);
+
+    // all the blocks, and half a second of music rendered as 16 bit stereo at least
+    size = file_size(plain);
+    TEST_ASSERT(size >= (2 * BLOCKS * 100 + 44100 / 2) * 2 * (long)sizeof(short));
+    TEST_ASSERT(file_size(threaded) == size);
+
+    while((c = fgetc(plain)) != EOF)
+    {
+        TEST_ASSERT(fgetc(threaded) == c);
+    }
+
+    fclose(plain);
+    fclose(threaded);
+    remove(PLAIN_FILE);
+    remove(THREADED_FILE);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+#include "test.h"
+#include "utils/fluid_hash.h"
+
+// this test makes sure that the hash table finds all of its entries again, after lots of
+// insertions and removals, and that it calls the destroy functions once for each of them
+
+#define COUNT 5000
+
+static int keys_destroyed, values_destroyed;
+
+static void key_destroy(void *key)
+{
+    keys_destroyed++;
+}
+
+static void value_destroy(void *value)
+{
+    values_destroyed++;
+}
+
+static int is_odd(void *key, void *value, void *data)
+{
+    return *(int *)key & 1;
+}
+
+int main(void)
+{
+    static int keys[COUNT], other_key;
+    fluid_hashtable_t *table;
+    fluid_hashtable_iter_t iter;
+    void *key, *value;
+    int i, count;
+
+    table = new_fluid_hashtable_full(fluid_int_hash, fluid_int_equal, key_destroy, value_destroy);
+    TEST_ASSERT(table != NULL);
+
+    for(i = 0; i < COUNT; i++)
+    {
+        keys[i] = i * 7919;
+        fluid_hashtable_insert(table, &keys[i], FLUID_INT_TO_POINTER(i + 1));
+    }
+
+    TEST_ASSERT(fluid_hashtable_size(table) == COUNT);
+
+    for(i = 0; i < COUNT; i++)
+    {
+        TEST_ASSERT(fluid_hashtable_lookup(table, &keys[i]) == FLUID_INT_TO_POINTER(i + 1));
+    }
+
+    other_key = -1;
+    TEST_ASSERT(fluid_hashtable_lookup(table, &other_key) == NULL);
+
+    // inserting an existing key keeps the old key, replacing it keeps the new one
+    other_key = keys[10];
+    fluid_hashtable_insert(table, &other_key, FLUID_INT_TO_POINTER(-1));
+    TEST_ASSERT(keys_destroyed == 1 && values_destroyed == 1);
+    TEST_ASSERT(fluid_hashtable_lookup_extended(table, &keys[10], &key, &value));
+    TEST_ASSERT(key == &keys[10] && value == FLUID_INT_TO_POINTER(-1));
+
+    fluid_hashtable_replace(table, &other_key, FLUID_INT_TO_POINTER(11));
+    TEST_ASSERT(keys_destroyed == 2 && values_destroyed == 2);
+    TEST_ASSERT(fluid_hashtable_lookup_extended(table, &keys[10], &key, &value));
+    TEST_ASSERT(key == &other_key && value == FLUID_INT_TO_POINTER(11));
+    TEST_ASSERT(fluid_hashtable_steal(table, &keys[10]));
+    fluid_hashtable_insert(table, &keys[10], FLUID_INT_TO_POINTER(11));
+    TEST_ASSERT(fluid_hashtable_size(table) == COUNT);
+
+    // remove every other entry, and insert them again, several times over
+    for(count = 0; count < 4; count++)
+    {
+        for(i = 0; i < COUNT; i += 2)
+        {
+            TEST_ASSERT(fluid_hashtable_remove(table, &keys[i]));
+            TEST_ASSERT(!fluid_hashtable_remove(table, &keys[i]));
+        }
+
+        TEST_ASSERT(fluid_hashtable_size(table) == COUNT / 2);
+
+        for(i = 0; i < COUNT; i++)
+        {
+            TEST_ASSERT(fluid_hashtable_lookup(table, &keys[i]) == ((i & 1) ? FLUID_INT_TO_POINTER(i + 1) : NULL));
+        }
+
+        for(i = 0; i < COUNT; i += 2)
+        {
+            fluid_hashtable_insert(table, &keys[i], FLUID_INT_TO_POINTER(i + 1));
+        }
+    }
+
+    TEST_ASSERT(keys_destroyed == 2 + 2 * COUNT && values_destroyed == 2 + 2 * COUNT);
+
+    // the iteration goes through every entry once, even when removing some on the way
+    count = 0;
+    fluid_hashtable_iter_init(&iter, table);
+
+    while(fluid_hashtable_iter_next(&iter, &key, &value))
+    {
+        TEST_ASSERT(value == FLUID_INT_TO_POINTER((int)(((int *)key - keys) + 1)));
+        count++;
+
+        if(count % 3 == 0)
+        {
+            fluid_hashtable_iter_remove(&iter);
+        }
+    }
+
+    TEST_ASSERT(count == COUNT);
+    TEST_ASSERT(fluid_hashtable_size(table) == COUNT - COUNT / 3);
+
+    // the entries left are still found after removing them by predicate
+    count = fluid_hashtable_size(table);
+    count -= fluid_hashtable_foreach_steal(table, is_odd, NULL);
+    TEST_ASSERT(fluid_hashtable_size(table) == (unsigned int)count);
+
+    for(i = 0; i < COUNT; i += 2)
+    {
+        value = fluid_hashtable_lookup(table, &keys[i]);
+        TEST_ASSERT(value == NULL || value == FLUID_INT_TO_POINTER(i + 1));
+    }
+
+    keys_destroyed = values_destroyed = 0;
+    delete_fluid_hashtable(table);
+    TEST_ASSERT(keys_destroyed == count && values_destroyed == count);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_iir_filter.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that filtering several voices side by side gives the same result
+// as filtering each voice on its own, also while the filter coefficients are ramping
+
+#define NUM_FILTERS 19
+#define NUM_BLOCKS 4
+#define EPS 1e-9
+
+static void init_filter(fluid_iir_filter_t *filter, int i)
+{
+    FLUID_MEMSET(filter, 0, sizeof(*filter));
+
+    // a few filters are disabled, one way or the other
+    filter->type = (i % 7 == 6) ? FLUID_IIR_DISABLED : FLUID_IIR_LOWPASS;
+    filter->q_lin = (i % 9 == 8) ? 0 : 1.5f;
+
+    // some stable lowpass coefficients, ramping towards other stable ones for a while
+    filter->b02 = 0.01f * (1 + i % 5);
+    filter->b1 = 2 * filter->b02;
+    filter->a1 = -1.8f + 0.02f * (i % 4);
+    filter->a2 = 0.82f - 0.01f * (i % 3);
+
+    filter->filter_coeff_incr_count = (i % 3 == 0) ? 0 : 17 * i;
+    filter->compensate_incr = (i % 2);
+    filter->b02_incr = 0.0004f * ((i % 2) ? 1 : -1);
+    filter->b1_incr = 2 * filter->b02_incr;
+    filter->a1_incr = -0.0001f;
+    filter->a2_incr = 0.0001f;
+
+    filter->hist1 = (i % 4 == 1) ? 1e-25f : 0.1f * i;
+    filter->hist2 = -0.05f * i;
+}
+
+int main(void)
+{
+    static fluid_real_t ref[NUM_FILTERS][FLUID_BUFSIZE], buf[NUM_FILTERS][FLUID_BUFSIZE];
+    fluid_iir_filter_t ref_filters[NUM_FILTERS], filters[NUM_FILTERS];
+    fluid_iir_filter_t *filter_ptrs[NUM_FILTERS];
+    fluid_real_t *bufs[NUM_FILTERS];
+    int counts[NUM_FILTERS];
+    int i, k, b;
+
+    for(i = 0; i < NUM_FILTERS; i++)
+    {
+        init_filter(&ref_filters[i], i);
+        init_filter(&filters[i], i);
+        filter_ptrs[i] = &filters[i];
+        bufs[i] = buf[i];
+    }
+
+    for(b = 0; b < NUM_BLOCKS; b++)
+    {
+        for(i = 0; i < NUM_FILTERS; i++)
+        {
+            // some voices finish in the middle of a block
+            counts[i] = (i % 5 == 4 && b == NUM_BLOCKS - 1) ? 13 * i % FLUID_BUFSIZE : FLUID_BUFSIZE;
+
+            for(k = 0; k < FLUID_BUFSIZE; k++)
+            {
+                ref[i][k] = buf[i][k] = (fluid_real_t)FLUID_SIN(0.05 * (i + 1) * (b * FLUID_BUFSIZE + k));
+            }
+
+            fluid_iir_filter_apply(&ref_filters[i], ref[i], counts[i]);
+        }
+
+        fluid_iir_filter_apply_batch(filter_ptrs, bufs, counts, NUM_FILTERS);
+
+        for(i = 0; i < NUM_FILTERS; i++)
+        {
+            for(k = 0; k < FLUID_BUFSIZE; k++)
+            {
+                TEST_ASSERT(FLUID_FABS(buf[i][k] - ref[i][k]) < EPS);
+            }
+
+            TEST_ASSERT(FLUID_FABS(filters[i].hist1 - ref_filters[i].hist1) < EPS);
+            TEST_ASSERT(FLUID_FABS(filters[i].hist2 - ref_filters[i].hist2) < EPS);
+            TEST_ASSERT(FLUID_FABS(filters[i].b02 - ref_filters[i].b02) < EPS);
+            TEST_ASSERT(FLUID_FABS(filters[i].a1 - ref_filters[i].a1) < EPS);
+            TEST_ASSERT(filters[i].filter_coeff_incr_count == ref_filters[i].filter_coeff_incr_count);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_iir_filter.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the filter coefficients looked up by the cutoff frequency relative to the
+// output rate match the ones of the cookbook formulae, over the whole range of cutoffs and rates
+
+// mostly the error of interpolating the table, the coefficients computed in floats add theirs
+#ifdef WITH_FLOAT
+#define EPS 3e-5
+#define EPS_B 3e-4          // relative, to 1 + cos(omega) of a highpass close to the Nyquist frequency
+#else
+#define EPS 1e-5
+#define EPS_B 1e-4
+#endif
+
+static void check(enum fluid_iir_filter_type type, double rate, double cents, double q)
+{
+    fluid_iir_filter_t filter;
+    double fres, omega, alpha, a0_inv, b1;
+
+    FLUID_MEMSET(&filter, 0, sizeof(filter));
+    filter.type = type;
+    filter.q_lin = (fluid_real_t)q;
+    filter.filter_gain = (fluid_real_t)(1 / sqrt(q));
+    filter.fres = (fluid_real_t)cents;
+    filter.last_fres = -1;
+    filter.filter_startup = 1;
+
+    fluid_iir_filter_calc(&filter, (fluid_real_t)rate, 0);
+
+    // the cutoff as clipped by the filter, in whole cents of the cutoff it got
+    cents = filter.fres;
+    cents = (cents < 1500) ? 1500 : (cents > 13500) ? 13500 : floor(cents);
+    fres = 440 * pow(2, (cents - 6900) / 1200);
+    fres = (fres > 0.45 * rate) ? 0.45 * rate : (fres < 5) ? 5 : fres;
+    TEST_ASSERT(fabs(filter.last_fres - fres) < 1e-3 * fres);
+
+    omega = 2 * M_PI * fres / rate;
+    alpha = sin(omega) / (2 * q);
+    a0_inv = 1 / (1 + alpha);
+    b1 = ((type == FLUID_IIR_LOWPASS) ? 1 - cos(omega) : -(1 + cos(omega))) * a0_inv / sqrt(q);
+
+    TEST_ASSERT(fabs(filter.a1 + 2 * cos(omega) * a0_inv) < EPS);
+    TEST_ASSERT(fabs(filter.a2 - (1 - alpha) * a0_inv) < EPS);
+    TEST_ASSERT(fabs(filter.b1 - b1) < EPS_B * fabs(b1));
+    TEST_ASSERT(fabs(filter.b02 - fabs(b1) / 2) < EPS_B * fabs(b1));
+}
+
+int main(void)
+{
+    static const double rates[] = { 8000, 22050, 44100, 48000, 96000, 192000 };
+    unsigned int r;
+    double cents;
+
+    for(r = 0; r < FLUID_N_ELEMENTS(rates); r++)
+    {
+        // beyond both ends of the SoundFont range, in odd steps to land between the table entries
+        for(cents = 1000; cents < 14000; cents += 7.3)
+        {
+            check(FLUID_IIR_LOWPASS, rates[r], cents, 0.7071);
+            check(FLUID_IIR_LOWPASS, rates[r], cents, 20);
+            check(FLUID_IIR_HIGHPASS, rates[r], cents, 2);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
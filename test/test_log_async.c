@@ -0,0 +1,123 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the messages logged in a realtime section are written by the logger thread,
+// with their repetitions counted, and that none of them get lost without being reported
+
+#define REPEATS 50
+#define FLOOD 1000
+
+static fluid_thread_id_t main_thread;
+static int from_main_thread;
+static int from_logger_thread;
+static int repeated_message;
+static int repeated;
+static int other_message;
+static int flood_messages;
+static int dropped;
+
+static void log_function(int level, const char *message, void *data)
+{
+    int n;
+
+    if(fluid_thread_get_id() == main_thread)
+    {
+        from_main_thread++;
+    }
+    else
+    {
+        from_logger_thread++;
+    }
+
+    if(FLUID_STRCMP(message, "repeated 42") == 0)
+    {
+        repeated_message++;
+    }
+    else if(FLUID_STRCMP(message, "other") == 0)
+    {
+        other_message++;
+    }
+    else if(sscanf(message, "last message repeated %d times", &n) == 1)
+    {
+        repeated += n;
+    }
+    else if(sscanf(message, "%d log messages dropped", &n) == 1)
+    {
+        TEST_ASSERT(level == FLUID_WARN);
+        dropped += n;
+    }
+    else if(FLUID_STRNCMP(message, "flood ", 6) == 0)
+    {
+        flood_messages++;
+    }
+}
+
+int main(void)
+{
+    int i;
+
+    main_thread = fluid_thread_get_id();
+    fluid_set_log_function(FLUID_PANIC, log_function, NULL);
+    fluid_set_log_function(FLUID_WARN, log_function, NULL);
+
+    // without the logger thread, messages are written right away
+    fluid_rt_enter();
+    FLUID_LOG(FLUID_WARN, "other");
+    fluid_rt_exit();
+    TEST_ASSERT(from_main_thread == 1 && other_message == 1);
+
+    TEST_SUCCESS(fluid_log_async_ref());
+    TEST_SUCCESS(fluid_log_async_ref());
+
+    // outside of a realtime section too
+    FLUID_LOG(FLUID_WARN, "other");
+    TEST_ASSERT(from_main_thread == 2 && other_message == 2);
+
+    fluid_rt_enter();
+
+    for(i = 0; i < REPEATS; i++)
+    {
+        FLUID_LOG(FLUID_WARN, "repeated %d", 42);
+    }
+
+    FLUID_LOG(FLUID_WARN, "other");
+
+    // a panic doesn't wait
+    FLUID_LOG(FLUID_PANIC, "panic");
+    TEST_ASSERT(from_main_thread == 3);
+
+    fluid_rt_exit();
+
+    // the logger thread writes the others after a short delay
+    fluid_msleep(200);
+    TEST_ASSERT(from_logger_thread > 0 && other_message == 3);
+
+    // the logger keeps running as long as it is referenced
+    fluid_log_async_unref();
+    fluid_rt_enter();
+
+    for(i = 0; i < FLOOD; i++)
+    {
+        FLUID_LOG(FLUID_WARN, "flood %d", i);
+    }
+
+    fluid_rt_exit();
+    TEST_ASSERT(from_main_thread == 3);
+
+    // what is left is written when releasing the logger
+    fluid_log_async_unref();
+
+    TEST_ASSERT(repeated_message >= 1);
+    TEST_ASSERT(repeated_message + repeated == REPEATS);
+    TEST_ASSERT(flood_messages + dropped == FLOOD);
+
+    // once released, messages are written right away again
+    fluid_rt_enter();
+    i = from_main_thread;
+    FLUID_LOG(FLUID_WARN, "other");
+    fluid_rt_exit();
+    TEST_ASSERT(from_main_thread == i + 1 && other_message == 4);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+
+// this test makes sure that parsing a MIDI stream buffer by buffer gives the same events as parsing it
+// byte by byte, whatever the size of the buffers, with running status, real-time messages in the middle
+// of other messages and SYSEX messages spanning several buffers
+
+#define MAX_EVENTS 64
+
+static const unsigned char stream[] =
+{
+    0x90, 0x3c, 0x7f,                   // note on
+    0x3e, 0x40,                         // running status
+    0x40, 0xf8, 0x20,                   // timing clock in the middle of a note on
+    0xb1, 0x07, 0x64,                   // control change
+    0xe2, 0x00, 0x40,                   // pitch bend
+    0xc3, 0x05,                         // program change
+    0x06,                               // running status
+    0xf0, 0x7e, 0x7f, 0x09, 0x01, 0xf7, // sysex
+    0xd4, 0x33,                         // channel pressure
+    0xf0, 0x41, 0x10, 0x42,             // sysex ended by the status of the next message
+    0x80, 0x3c, 0x00,                   // note off
+    0xa5, 0x3c,                         // incomplete key pressure, discarded by a system reset
+    0xff,
+    0x5c,                               // data byte without status, ignored
+    0x95, 0x3d, 0x70                    // note on
+};
+
+typedef struct
+{
+    int type;
+    int channel;
+    int param1;
+    int param2;
+    unsigned char sysex[8];
+} expected_event_t;
+
+static int store(expected_event_t *expected, fluid_midi_event_t *evt)
+{
+    expected->type = fluid_midi_event_get_type(evt);
+    expected->channel = fluid_midi_event_get_channel(evt);
+
+    if(expected->type == MIDI_SYSEX)
+    {
+        TEST_ASSERT(evt->param1 <= sizeof(expected->sysex));
+        TEST_ASSERT(!evt->param2);
+        FLUID_MEMCPY(expected->sysex, evt->paramptr, evt->param1);
+        expected->param1 = evt->param1;
+        expected->param2 = 0;
+    }
+    else
+    {
+        expected->param1 = evt->param1;
+        expected->param2 = evt->param2;
+    }
+
+    return 1;
+}
+
+int main(void)
+{
+    static expected_event_t expected[MAX_EVENTS], parsed[MAX_EVENTS];
+    fluid_midi_event_t events[MAX_EVENTS];
+    fluid_midi_parser_t *parser;
+    fluid_midi_event_t *evt;
+    int i, k, n, len, count, consumed, max_events, num_expected = 0;
+
+    // byte by byte
+    parser = new_fluid_midi_parser();
+    TEST_ASSERT(parser != NULL);
+
+    for(i = 0; i < (int)sizeof(stream); i++)
+    {
+        evt = fluid_midi_parser_parse(parser, stream[i]);
+
+        if(evt != NULL)
+        {
+            num_expected += store(&expected[num_expected], evt);
+        }
+    }
+
+    delete_fluid_midi_parser(parser);
+    TEST_ASSERT(num_expected == 13);
+
+    // in buffers of any length, into arrays of any size
+    for(len = 1; len <= (int)sizeof(stream); len++)
+    {
+        for(max_events = 1; max_events <= 3; max_events++)
+        {
+            parser = new_fluid_midi_parser();
+            TEST_ASSERT(parser != NULL);
+            n = 0;
+
+            for(i = 0; i < (int)sizeof(stream); i += len)
+            {
+                int size = ((int)sizeof(stream) - i < len) ? (int)sizeof(stream) - i : len;
+
+                for(k = 0; k < size; k += consumed)
+                {
+                    count = fluid_midi_parser_parse_buffer(parser, stream + i + k, size - k, events, max_events, &consumed);
+                    TEST_ASSERT(count <= max_events);
+                    TEST_ASSERT(consumed > 0 && consumed <= size - k);
+                    TEST_ASSERT(n + count <= num_expected);
+
+                    // the SYSEX data is only valid until the next call, it can only come last
+                    for(evt = events; evt < events + count; evt++)
+                    {
+                        TEST_ASSERT(evt == events + count - 1 || fluid_midi_event_get_type(evt) != MIDI_SYSEX);
+                        n += store(&parsed[n], evt);
+                    }
+                }
+            }
+
+            TEST_ASSERT(n == num_expected);
+            TEST_ASSERT(FLUID_MEMCMP(parsed, expected, sizeof(parsed)) == 0);
+
+            delete_fluid_midi_parser(parser);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "midi/fluid_midi.h"
+
+// this test makes sure that the MIDI router passes events through the rules matching them,
+// that rules removed while notes are held pass on their note offs, and that events handled
+// while the rules change are passed by either the old or the new rules
+
+#define MAX_EVENTS 64
+#define NUM_CC_EVENTS 20000
+
+typedef struct
+{
+    int type;
+    int channel;
+    int param1;
+    int param2;
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static int num_events;
+static fluid_atomic_int_t num_cc_events;
+
+static int handle_event(void *data, fluid_midi_event_t *evt)
+{
+    if(fluid_midi_event_get_type(evt) == CONTROL_CHANGE && fluid_midi_event_get_control(evt) == 7)
+    {
+        fluid_atomic_int_inc(&num_cc_events);
+        return FLUID_OK;
+    }
+
+    TEST_ASSERT(num_events < MAX_EVENTS);
+    events[num_events].type = fluid_midi_event_get_type(evt);
+    events[num_events].channel = fluid_midi_event_get_channel(evt);
+    events[num_events].param1 = fluid_midi_event_get_key(evt);
+    events[num_events].param2 = fluid_midi_event_get_velocity(evt);
+    num_events++;
+
+    return FLUID_OK;
+}
+
+static void send_event(fluid_midi_router_t *router, int type, int chan, int par1, int par2)
+{
+    fluid_midi_event_t *evt = new_fluid_midi_event();
+    TEST_ASSERT(evt != NULL);
+
+    fluid_midi_event_set_type(evt, type);
+    fluid_midi_event_set_channel(evt, chan);
+    fluid_midi_event_set_key(evt, par1);
+    fluid_midi_event_set_velocity(evt, par2);
+    TEST_SUCCESS(fluid_midi_router_handle_midi_event(router, evt));
+
+    delete_fluid_midi_event(evt);
+}
+
+static void check_event(int i, int type, int chan, int par1, int par2)
+{
+    TEST_ASSERT(i < num_events);
+    TEST_ASSERT(events[i].type == type);
+    TEST_ASSERT(events[i].channel == chan);
+    TEST_ASSERT(events[i].param1 == par1);
+    TEST_ASSERT(events[i].param2 == par2);
+}
+
+static void add_note_rule(fluid_midi_router_t *router, int key_min, int key_max, int chan)
+{
+    fluid_midi_router_rule_t *rule = new_fluid_midi_router_rule();
+    TEST_ASSERT(rule != NULL);
+
+    fluid_midi_router_rule_set_chan(rule, 0, 15, 0.0f, chan);
+    fluid_midi_router_rule_set_param1(rule, key_min, key_max, 1.0f, 0);
+    TEST_SUCCESS(fluid_midi_router_add_rule(router, rule, FLUID_MIDI_ROUTER_RULE_NOTE));
+}
+
+static fluid_thread_return_t send_cc_events(void *data)
+{
+    int i;
+
+    for(i = 0; i < NUM_CC_EVENTS; i++)
+    {
+        send_event(data, CONTROL_CHANGE, i % 16, 7, i % 128);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_midi_router_t *router;
+    fluid_midi_router_rule_t *rule;
+    fluid_thread_t *thread;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 16));
+    router = new_fluid_midi_router(settings, handle_event, NULL);
+    TEST_ASSERT(router != NULL);
+
+    // the default rules pass everything unmodified, channels beyond the synth's are limited
+    send_event(router, NOTE_ON, 3, 60, 100);
+    send_event(router, PROGRAM_CHANGE, 4, 5, 0);
+    send_event(router, NOTE_ON, 20, 61, 0);
+    send_event(router, NOTE_OFF, 3, 60, 0);
+    check_event(0, NOTE_ON, 3, 60, 100);
+    check_event(1, PROGRAM_CHANGE, 4, 5, 0);
+    check_event(2, NOTE_OFF, 15, 61, 127);
+    check_event(3, NOTE_OFF, 3, 60, 0);
+    TEST_ASSERT(num_events == 4);
+
+    // no rules, no events, the default rules are done as no notes are held
+    num_events = 0;
+    TEST_SUCCESS(fluid_midi_router_clear_rules(router));
+    send_event(router, NOTE_ON, 3, 62, 100);
+    send_event(router, CONTROL_CHANGE, 3, 10, 100);
+    TEST_ASSERT(num_events == 0);
+
+    // a keyboard split, and a layer above key 72 with an inverted velocity window
+    add_note_rule(router, 0, 59, 1);
+    add_note_rule(router, 60, 127, 2);
+    rule = new_fluid_midi_router_rule();
+    TEST_ASSERT(rule != NULL);
+    fluid_midi_router_rule_set_chan(rule, 5, 3, 1.0f, 8);
+    fluid_midi_router_rule_set_param1(rule, 72, 127, 1.0f, -12);
+    fluid_midi_router_rule_set_param2(rule, 100, 20, 2.0f, 0);
+    TEST_SUCCESS(fluid_midi_router_add_rule(router, rule, FLUID_MIDI_ROUTER_RULE_NOTE));
+
+    send_event(router, NOTE_ON, 0, 40, 100);
+    send_event(router, NOTE_ON, 0, 80, 110);
+    send_event(router, NOTE_ON, 0, 81, 50);
+    send_event(router, NOTE_ON, 6, 82, 110);
+    TEST_ASSERT(num_events == 6);
+    // the newest rule comes first
+    check_event(0, NOTE_ON, 1, 40, 100);
+    check_event(1, NOTE_ON, 8, 68, 127);
+    check_event(2, NOTE_ON, 2, 80, 110);
+    check_event(3, NOTE_ON, 2, 81, 50);
+    check_event(4, NOTE_ON, 14, 70, 127);
+    check_event(5, NOTE_ON, 2, 82, 110);
+
+    // the rules are removed, but pass the note offs of the notes held
+    num_events = 0;
+    TEST_SUCCESS(fluid_midi_router_clear_rules(router));
+    add_note_rule(router, 0, 127, 9);
+    send_event(router, NOTE_ON, 0, 30, 100);
+    send_event(router, NOTE_OFF, 0, 40, 0);
+    TEST_ASSERT(num_events == 3);
+    check_event(0, NOTE_ON, 9, 30, 100);
+    check_event(1, NOTE_OFF, 9, 40, 0);
+    check_event(2, NOTE_OFF, 1, 40, 0);
+
+    // once done, a removed rule passes nothing anymore
+    num_events = 0;
+    add_note_rule(router, 0, 127, 10);
+    send_event(router, NOTE_OFF, 0, 40, 0);
+    TEST_ASSERT(num_events == 2);
+    check_event(0, NOTE_OFF, 10, 40, 0);
+    check_event(1, NOTE_OFF, 9, 40, 0);
+
+    // every event handled while the rules change passes exactly one rule
+    TEST_SUCCESS(fluid_midi_router_set_default_rules(router));
+    fluid_atomic_int_set(&num_cc_events, 0);
+    thread = new_fluid_thread("midi-router-test", send_cc_events, router, 0, FALSE);
+    TEST_ASSERT(thread != NULL);
+
+    for(i = 0; i < 200; i++)
+    {
+        TEST_SUCCESS(fluid_midi_router_set_default_rules(router));
+    }
+
+    TEST_SUCCESS(fluid_thread_join(thread));
+    delete_fluid_thread(thread);
+    TEST_ASSERT(fluid_atomic_int_get(&num_cc_events) == NUM_CC_EVENTS);
+
+    delete_fluid_midi_router(router);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
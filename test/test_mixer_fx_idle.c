@@ -0,0 +1,102 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the effects are bypassed once their tails have decayed,
+// so that the output becomes silent, and that they pick up again with the next note
+
+#define FRAMES 4096
+#define SILENCE_SEC 30
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 127)); // reverb send
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 93, 127)); // chorus send
+    return synth;
+}
+
+static int is_silent(const float *buf, int len)
+{
+    int i;
+
+    for(i = 0; i < len; i++)
+    {
+        if(buf[i] != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+int main(void)
+{
+    static float ref[FRAMES * 2], buf[FRAMES * 2];
+    fluid_settings_t *settings, *dry_settings;
+    fluid_synth_t *synth;
+    double sample_rate;
+    double wet_energy = 0, dry_energy = 0;
+    int i, silent_frames = -1;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate));
+
+    // the reference: the note without any effects
+    dry_settings = new_fluid_settings();
+    TEST_ASSERT(dry_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(dry_settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(dry_settings, "synth.chorus.active", 0));
+    synth = create_synth(dry_settings);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, ref, 0, 2, ref, 1, 2));
+    delete_fluid_synth(synth);
+    delete_fluid_settings(dry_settings);
+    TEST_ASSERT(!is_silent(ref, FRAMES * 2));
+
+    synth = create_synth(settings);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    // the voice and the tails of the effects decay until the output is entirely silent
+    for(i = 0; i < SILENCE_SEC * sample_rate; i += FRAMES)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+        if(is_silent(buf, FRAMES * 2))
+        {
+            silent_frames = (silent_frames < 0) ? i : silent_frames;
+        }
+        else
+        {
+            // once silent, it stays silent
+            TEST_ASSERT(silent_frames < 0);
+        }
+    }
+
+    TEST_ASSERT(silent_frames > 0);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    // the effects pick up the next note
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    for(i = 0; i < FRAMES * 2; i++)
+    {
+        wet_energy += (buf[i] - ref[i]) * (buf[i] - ref[i]);
+        dry_energy += ref[i] * ref[i];
+    }
+
+    TEST_ASSERT(wet_energy > dry_energy / 10);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the effects units processed by the extra mixer threads render
+// the same audio as when processed by the synthesis thread alone, both when the effects are
+// mixed to the output and when they are rendered to separate effects buffers, also with the
+// threads spinning between the blocks and with the effects shared by all groups
+
+#if ENABLE_MIXER_THREADS
+
+#define FRAMES 4096
+#define GROUPS 16
+#define FX_BUFS (2 * 2 * GROUPS) // stereo reverb and chorus of each group
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, int cores)
+{
+    fluid_synth_t *synth;
+    int chan;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // one note per channel, each channel is routed to its own effects group
+    for(chan = 0; chan < GROUPS; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 91, 40 + 5 * chan)); // reverb send
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 93, 100 - 5 * chan)); // chorus send
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan, 100));
+    }
+
+    return synth;
+}
+
+static void render_mix(fluid_settings_t *settings, int cores, float *buf)
+{
+    fluid_synth_t *synth = create_synth(settings, cores);
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    delete_fluid_synth(synth);
+}
+
+static void render_fx(fluid_settings_t *settings, int cores, float *buf)
+{
+    fluid_synth_t *synth = create_synth(settings, cores);
+    float *fx[FX_BUFS];
+    int i;
+
+    FLUID_MEMSET(buf, 0, FX_BUFS * FRAMES * sizeof(float));
+
+    for(i = 0; i < FX_BUFS; i++)
+    {
+        fx[i] = &buf[i * FRAMES];
+    }
+
+    TEST_SUCCESS(fluid_synth_process(synth, FRAMES, FX_BUFS, fx, 0, NULL));
+    delete_fluid_synth(synth);
+}
+
+static void compare(const float *ref, const float *buf, int n)
+{
+    double energy = 0;
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        // the voices are mixed in another order by the threads
+        TEST_ASSERT(FLUID_FABS(ref[i] - buf[i]) < 1e-5);
+        energy += ref[i] * ref[i];
+    }
+
+    TEST_ASSERT(energy > 0);
+}
+
+int main(void)
+{
+    static float ref[FX_BUFS * FRAMES], buf[FX_BUFS * FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", GROUPS));
+
+    render_mix(settings, 1, ref);
+    render_mix(settings, 4, buf);
+    compare(ref, buf, 2 * FRAMES);
+
+    // one reverb mixed straight to the output by the synthesis thread, one chorus processed by a thread
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-shared", 1));
+    render_mix(settings, 1, ref);
+    render_mix(settings, 2, buf);
+    compare(ref, buf, 2 * FRAMES);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-shared", 0));
+
+    render_fx(settings, 1, ref);
+    render_fx(settings, 4, buf);
+    compare(ref, buf, FX_BUFS * FRAMES);
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-cores-scheduler", "work-stealing"));
+    render_fx(settings, 3, buf);
+    compare(ref, buf, FX_BUFS * FRAMES);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores-spin-time", 10));
+    render_fx(settings, 3, buf);
+    compare(ref, buf, FX_BUFS * FRAMES);
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-cores-scheduler", "shared"));
+    render_fx(settings, 4, buf);
+    compare(ref, buf, FX_BUFS * FRAMES);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int main(void)
+{
+    return EXIT_SUCCESS;
+}
+
+#endif
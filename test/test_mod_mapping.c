@@ -0,0 +1,144 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "synth/fluid_mod.h"
+#include "utils/fluid_conv.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the mapping functions of the modulator sources, looked up for the sources of
+// 7 bits, give the values of the SoundFont specification, as well as for the sources of other ranges
+
+#define MOD_CC 3
+#define EPS 1e-6
+
+// the mapping functions by the SoundFont specification, computed in the same precision as by the
+// modulators, as the concave and convex tables are looked up by truncating
+static double reference(int flags, int val, int range)
+{
+    int shape = flags & ~(FLUID_MOD_CC | FLUID_MOD_BIPOLAR | FLUID_MOD_NEGATIVE);
+    fluid_real_t norm = (fluid_real_t)val / range;
+    fluid_real_t x = (flags & FLUID_MOD_NEGATIVE) ? 1.0f - norm : norm;
+    fluid_real_t sign = (norm > 0.5f) ? 1.0f : -1.0f;
+    fluid_real_t dist = (norm > 0.5f) ? 2 * (norm - 0.5f) : 2 * (0.5f - norm);
+
+    sign = (flags & FLUID_MOD_NEGATIVE) ? -sign : sign;
+
+    if(flags & FLUID_MOD_BIPOLAR)
+    {
+        switch(shape)
+        {
+        case FLUID_MOD_LINEAR:
+            return 2 * x - 1;
+
+        case FLUID_MOD_CONCAVE:
+            return sign * fluid_concave(127 * dist);
+
+        case FLUID_MOD_CONVEX:
+            return sign * fluid_convex(127 * dist);
+
+        case FLUID_MOD_SWITCH:
+            return ((norm >= 0.5f) != !!(flags & FLUID_MOD_NEGATIVE)) ? 1 : -1;
+
+        default:
+            return sign * sin(M_PI * dist / 2);
+        }
+    }
+
+    switch(shape)
+    {
+    case FLUID_MOD_LINEAR:
+        return x;
+
+    case FLUID_MOD_CONCAVE:
+        return fluid_concave(127 * x);
+
+    case FLUID_MOD_CONVEX:
+        return fluid_convex(127 * x);
+
+    case FLUID_MOD_SWITCH:
+        return ((norm >= 0.5f) != !!(flags & FLUID_MOD_NEGATIVE)) ? 1 : 0;
+
+    default:
+        return sin(M_PI / 2 * 0.87 * x);
+    }
+}
+
+static fluid_real_t get_value(fluid_voice_t *voice, int src, int flags)
+{
+    fluid_mod_t mod;
+
+    FLUID_MEMSET(&mod, 0, sizeof(mod));
+    fluid_mod_set_source1(&mod, src, flags);
+    fluid_mod_set_source2(&mod, FLUID_MOD_NONE, FLUID_MOD_GC);
+    fluid_mod_set_dest(&mod, GEN_FILTERFC);
+    fluid_mod_set_amount(&mod, 1);
+
+    return fluid_mod_get_value(&mod, voice);
+}
+
+int main(void)
+{
+    static const int shapes[] = { FLUID_MOD_LINEAR, FLUID_MOD_CONCAVE, FLUID_MOD_CONVEX, FLUID_MOD_SWITCH, FLUID_MOD_SIN };
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_t *voice = NULL;
+    unsigned int s;
+    int i, polarity, val;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        if(fluid_voice_is_playing(synth->voice[i]))
+        {
+            voice = synth->voice[i];
+            break;
+        }
+    }
+
+    TEST_ASSERT(voice != NULL);
+
+    for(s = 0; s < FLUID_N_ELEMENTS(shapes); s++)
+    {
+        for(polarity = 0; polarity < 4; polarity++)
+        {
+            int flags = FLUID_MOD_CC | shapes[s] | polarity;
+
+            for(val = 0; val < 128; val++)
+            {
+                double expected = reference(flags, val, 127);
+
+                TEST_SUCCESS(fluid_synth_cc(synth, 0, MOD_CC, val));
+                TEST_ASSERT(fabs(get_value(voice, MOD_CC, flags) - expected) < EPS);
+
+                // the pan of 1 to 127
+                TEST_SUCCESS(fluid_synth_cc(synth, 0, PAN_MSB, val));
+                expected = reference(flags, (val > 0) ? val - 1 : 0, 126);
+                TEST_ASSERT(fabs(get_value(voice, PAN_MSB, flags) - expected) < EPS);
+            }
+
+            // the pitch wheel of 14 bits
+            for(val = 0; val < 0x4000; val += 0x3ff)
+            {
+                double expected = reference(flags, val, 0x4000);
+
+                TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, val));
+                TEST_ASSERT(fabs(get_value(voice, FLUID_MOD_PITCHWHEEL, flags & ~FLUID_MOD_CC) - expected) < EPS);
+            }
+        }
+    }
+
+    // the velocity of the voice
+    TEST_ASSERT(fabs(get_value(voice, FLUID_MOD_VELOCITY, FLUID_MOD_GC | FLUID_MOD_CONCAVE | FLUID_MOD_NEGATIVE)
+                     - reference(FLUID_MOD_CONCAVE | FLUID_MOD_NEGATIVE, 100, 127)) < EPS);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
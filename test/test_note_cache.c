@@ -0,0 +1,124 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice_event.h"
+#include "rvoice/fluid_rvoice_mixer.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.note-cache-size, repeated hits of an unlooped sample are played back
+// from the first one, sounding exactly the same as when rendered on their own, panned on their own, and that
+// a hit changed by a noteoff while being played back continues to render from its state at that time
+
+#define RATE 44100
+#define SAMPLE_FRAMES 4800
+#define HIT_FRAMES 8192
+#define HITS 4
+
+static short data[SAMPLE_FRAMES];
+
+static void start_voice(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key)
+{
+    fluid_voice_t *voice;
+
+    fluid_synth_api_enter(synth);
+    voice = fluid_synth_alloc_voice(synth, sample, chan, key, 100);
+    TEST_ASSERT(voice != NULL);
+    fluid_synth_start_voice(synth, voice);
+    fluid_synth_api_exit(synth);
+}
+
+static void render_hit(fluid_synth_t *synth, float *buf, int noteoff_frames)
+{
+    if(noteoff_frames > 0)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, noteoff_frames, buf, 0, 2, buf, 1, 2));
+        TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 64));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, HIT_FRAMES - noteoff_frames,
+                                         buf, 2 * noteoff_frames, 2, buf, 2 * noteoff_frames + 1, 2));
+}
+
+static float *render(fluid_sample_t *sample, int cache_size, unsigned int *hits)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float *buf = FLUID_ARRAY(float, 2 * HIT_FRAMES * HITS);
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", RATE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.note-cache-size", cache_size));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // recorded
+    start_voice(synth, sample, 0, 64);
+    render_hit(synth, buf, 0);
+
+    // played back, panned to the left
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, 10, 0));
+    start_voice(synth, sample, 1, 64);
+    render_hit(synth, &buf[2 * HIT_FRAMES], 0);
+
+    // played back until released
+    start_voice(synth, sample, 0, 64);
+    render_hit(synth, &buf[4 * HIT_FRAMES], 1000);
+
+    // another pitch
+    start_voice(synth, sample, 0, 65);
+    render_hit(synth, &buf[6 * HIT_FRAMES], 0);
+
+    *hits = fluid_rvoice_mixer_get_note_cache_hits(synth->eventhandler->mixer);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+int main(void)
+{
+    fluid_sample_t *sample = new_fluid_sample();
+    float *plain, *cached;
+    unsigned int hits;
+    double peak = 0;
+    int i;
+
+    for(i = 0; i < SAMPLE_FRAMES; i++)
+    {
+        data[i] = (short)(20000 * FLUID_SIN(2 * M_PI * i / 100) * (SAMPLE_FRAMES - i) / SAMPLE_FRAMES);
+    }
+
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, SAMPLE_FRAMES, RATE, FALSE));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    plain = render(sample, 0, &hits);
+    TEST_ASSERT(hits == 0);
+
+    cached = render(sample, 1, &hits);
+    TEST_ASSERT(hits == 2);
+
+    for(i = 0; i < 2 * HIT_FRAMES * HITS; i++)
+    {
+        TEST_ASSERT(cached[i] == plain[i]);
+        peak = (fabs(plain[i]) > peak) ? fabs(plain[i]) : peak;
+    }
+
+    TEST_ASSERT(peak > 0.01);
+
+    // the panned hit only sounds on the left
+    for(i = 0; i < HIT_FRAMES; i++)
+    {
+        TEST_ASSERT(fabs(plain[2 * (HIT_FRAMES + i) + 1]) < 1e-6);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(cached);
+    delete_fluid_sample(sample);
+
+    return EXIT_SUCCESS;
+}
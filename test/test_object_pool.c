@@ -0,0 +1,137 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_tuning.h"
+
+// this test makes sure that the objects of a pool are never handed out twice, also when taken
+// and returned by several threads at once, and that the synth's tunings work when taken from a pool
+
+#define POOL_SIZE 4
+#define NUM_THREADS 4
+#define NUM_LOOPS 20000
+
+typedef struct
+{
+    fluid_pool_t *pool;
+    int id;
+} worker_t;
+
+static fluid_thread_return_t take_and_return(void *data)
+{
+    worker_t *worker = data;
+    int i, *obj;
+
+    for(i = 0; i < NUM_LOOPS; i++)
+    {
+        obj = fluid_pool_alloc(worker->pool);
+        TEST_ASSERT(obj != NULL);
+
+        obj[0] = worker->id;
+        obj[1] = i;
+        TEST_ASSERT(obj[0] == worker->id);
+        TEST_ASSERT(obj[1] == i);
+
+        fluid_pool_free(worker->pool, obj);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_pool_t *pool;
+    fluid_thread_t *threads[NUM_THREADS];
+    worker_t workers[NUM_THREADS];
+    void *obj[POOL_SIZE + 1];
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    char name[FLUID_TUNING_NAME_SIZE * 2];
+    double pitch[128];
+    int key = 60;
+    int i, k;
+
+    pool = new_fluid_pool(POOL_SIZE, 24);
+    TEST_ASSERT(pool != NULL);
+
+    // more objects than preallocated, the last one comes from the heap
+    for(i = 0; i < POOL_SIZE + 1; i++)
+    {
+        obj[i] = fluid_pool_alloc(pool);
+        TEST_ASSERT(obj[i] != NULL);
+        TEST_ASSERT(((uintptr_t)obj[i] & (sizeof(double) - 1)) == 0);
+
+        for(k = 0; k < i; k++)
+        {
+            TEST_ASSERT(obj[i] != obj[k]);
+        }
+
+        FLUID_MEMSET(obj[i], i, 24);
+    }
+
+    for(i = 0; i < POOL_SIZE + 1; i++)
+    {
+        fluid_pool_free(pool, obj[i]);
+    }
+
+    fluid_pool_free(pool, NULL);
+
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        workers[i].pool = pool;
+        workers[i].id = i;
+        threads[i] = new_fluid_thread("object-pool-test", take_and_return, &workers[i], 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        TEST_SUCCESS(fluid_thread_join(threads[i]));
+        delete_fluid_thread(threads[i]);
+    }
+
+    // all objects are back in the pool
+    for(i = 0; i < POOL_SIZE; i++)
+    {
+        obj[i] = fluid_pool_alloc(pool);
+
+        for(k = 0; k < i; k++)
+        {
+            TEST_ASSERT(obj[i] != obj[k]);
+        }
+    }
+
+    for(i = 0; i < POOL_SIZE; i++)
+    {
+        fluid_pool_free(pool, obj[i]);
+    }
+
+    delete_fluid_pool(pool);
+
+    // tunings replaced many times, more often than tunings are preallocated
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    FLUID_MEMSET(name, 'x', sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+    TEST_SUCCESS(fluid_synth_activate_key_tuning(synth, 0, 0, name, NULL, FALSE));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 0, 0, 0, FALSE));
+
+    for(i = 0; i < 100; i++)
+    {
+        double cents = 6000.0 + i;
+        TEST_SUCCESS(fluid_synth_tune_notes(synth, 0, 0, 1, &key, &cents, TRUE));
+    }
+
+    TEST_SUCCESS(fluid_synth_tuning_dump(synth, 0, 0, name, sizeof(name), pitch));
+    TEST_ASSERT(FLUID_STRLEN(name) == FLUID_TUNING_NAME_SIZE - 1);
+    TEST_ASSERT(pitch[key] == 6099.0);
+    TEST_ASSERT(pitch[key + 1] == (key + 1) * 100.0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
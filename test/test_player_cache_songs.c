@@ -0,0 +1,118 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that player.cache-songs plays a looping playlist the same as without, loading each
+// file once only, and that the buffers added by fluid_player_add_mem_nocopy() are played without a copy
+
+#define CHUNK_FRAMES 1000
+#define MIDI_FILE_NAME "test_player_cache_songs.mid"
+
+#define MIDI_FILE(key) \
+{ \
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, \
+    'M', 'T', 'r', 'k', 0, 0, 0, 13, \
+    0x00, 0x90, key, 0x64, \
+    0x83, 0x60, 0x80, key, 0x00, \
+    0x00, 0xff, 0x2f, 0x00, \
+}
+
+static const unsigned char file_data[] = MIDI_FILE(0x3c);
+static unsigned char mem_data[] = MIDI_FILE(0x40);
+
+static void write_midi_file(void)
+{
+    FILE *file = FLUID_FOPEN(MIDI_FILE_NAME, "wb");
+
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(fwrite(file_data, 1, sizeof(file_data), file) == sizeof(file_data));
+    FLUID_FCLOSE(file);
+}
+
+static float *render(int cache, int *frames)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    fluid_list_t *p;
+    float *buf = NULL, *grown;
+    int changed = FALSE;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.cache-songs", cache));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    write_midi_file();
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add(player, MIDI_FILE_NAME));
+    TEST_SUCCESS(fluid_player_add_mem_nocopy(player, mem_data, sizeof(mem_data)));
+    TEST_ASSERT(((fluid_playlist_item *) player->playlist->next->data)->buffer == mem_data);
+    TEST_SUCCESS(fluid_player_set_loop(player, 3));
+
+    TEST_SUCCESS(fluid_player_play(player));
+    *frames = 0;
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        grown = FLUID_REALLOC(buf, 2 * (*frames + CHUNK_FRAMES) * sizeof(float));
+        TEST_ASSERT(grown != NULL);
+        buf = grown;
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, CHUNK_FRAMES, buf, 2 * *frames, 2, buf, 2 * *frames + 1, 2));
+        *frames += CHUNK_FRAMES;
+
+        // once both songs have been loaded, their files aren't read anymore
+        if(cache && !changed && player->currentfile == player->playlist->next)
+        {
+            for(p = player->playlist; p != NULL; p = p->next)
+            {
+                TEST_ASSERT(((fluid_playlist_item *) p->data)->song != NULL);
+            }
+
+            TEST_ASSERT(player->song_cached);
+            remove(MIDI_FILE_NAME);
+            FLUID_MEMSET(mem_data, 0, sizeof(mem_data));
+            changed = TRUE;
+        }
+    }
+
+    TEST_ASSERT(changed == cache);
+
+    fluid_player_stop(player);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    remove(MIDI_FILE_NAME);
+
+    return buf;
+}
+
+int main(void)
+{
+    float *plain, *cached;
+    int plain_frames, cached_frames, i;
+
+    plain = render(FALSE, &plain_frames);
+    cached = render(TRUE, &cached_frames);
+
+    // half a second of music per file and loop at least, sounding the same
+    TEST_ASSERT(plain_frames >= 3 * 2 * 44100 / 2);
+    TEST_ASSERT(cached_frames == plain_frames);
+
+    for(i = 0; i < 2 * plain_frames; i++)
+    {
+        TEST_ASSERT(cached[i] == plain[i]);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(cached);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the player sends the events of all tracks in the order of their ticks,
+// and that seeking backwards replays everything but the notes
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 2, 0x01, 0xe0, // format 1, 2 tracks, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 15,
+    0x00, 0xc0, 0x05,             // 0: program change
+    0x64, 0x90, 0x3c, 0x64,       // 100: note on
+    0x64, 0x80, 0x3c, 0x00,       // 200: note off
+    0x00, 0xff, 0x2f, 0x00,       // 200: end of track
+    'M', 'T', 'r', 'k', 0, 0, 0, 12,
+    0x32, 0xb1, 0x07, 0x64,       // 50: control change
+    0x64, 0x91, 0x40, 0x64,       // 150: note on
+    0x64, 0xff, 0x2f, 0x00,       // 250: end of track
+};
+
+static const int expected_types[] =
+{
+    PROGRAM_CHANGE, CONTROL_CHANGE, NOTE_ON, NOTE_ON,
+    // after seeking back to tick 10
+    PROGRAM_CHANGE, CONTROL_CHANGE, NOTE_ON, NOTE_ON, NOTE_OFF
+};
+
+static const int expected_channels[] = { 0, 1, 0, 1, 0, 1, 0, 1, 0 };
+
+static int received;
+
+static int playback_callback(void *data, fluid_midi_event_t *event)
+{
+    TEST_ASSERT(received < (int)FLUID_N_ELEMENTS(expected_types));
+    TEST_ASSERT(fluid_midi_event_get_type(event) == expected_types[received]);
+    TEST_ASSERT(fluid_midi_event_get_channel(event) == expected_channels[received]);
+    received++;
+
+    return FLUID_OK;
+}
+
+static void render_msec(fluid_synth_t *synth, int msec)
+{
+    float left[64], right[64];
+    int i;
+
+    for(i = 0; i < msec * 44100 / 1000; i += 64)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, left, 0, 1, right, 0, 1));
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", 44100));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+
+    TEST_SUCCESS(fluid_player_set_playback_callback(player, playback_callback, NULL));
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+
+    // 500000 usec per beat make 1.04 msec per tick, stop between tick 150 and 200
+    render_msec(synth, 180);
+    TEST_ASSERT(received == 4);
+    TEST_ASSERT(fluid_player_get_total_ticks(player) == 250);
+
+    // seeking beyond the end of the file fails
+    TEST_ASSERT(fluid_player_seek(player, 251) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_player_seek(player, 10));
+
+    render_msec(synth, 400);
+    TEST_ASSERT(received == (int)FLUID_N_ELEMENTS(expected_types));
+    TEST_ASSERT(fluid_player_get_status(player) == FLUID_PLAYER_DONE);
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
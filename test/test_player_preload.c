@@ -0,0 +1,129 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that player.preload plays a playlist the same as without, taking over the
+// songs loaded by the preload thread
+
+#define CHUNK_FRAMES 1000
+#define NUM_FILES 3
+
+#define MIDI_FILE(key) \
+{ \
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, \
+    'M', 'T', 'r', 'k', 0, 0, 0, 13, \
+    0x00, 0x90, key, 0x64, \
+    0x83, 0x60, 0x80, key, 0x00, \
+    0x00, 0xff, 0x2f, 0x00, \
+}
+
+static const unsigned char midi_files[NUM_FILES][35] =
+{
+    MIDI_FILE(0x3c),
+    MIDI_FILE(0x40),
+    MIDI_FILE(0x43),
+};
+
+// wait for the preload thread to have loaded the file after the current one
+static void wait_preloaded(fluid_player_t *player)
+{
+    fluid_list_t *next = fluid_list_next(player->currentfile);
+    fluid_list_t *item = NULL;
+    int i;
+
+    if(next == NULL)
+    {
+        return;
+    }
+
+    for(i = 0; i < 10000 && item != next; i++)
+    {
+        fluid_cond_mutex_lock(player->preload_mutex);
+        item = player->preload_item;
+        fluid_cond_mutex_unlock(player->preload_mutex);
+
+        if(item != next)
+        {
+            fluid_msleep(1);
+        }
+    }
+
+    TEST_ASSERT(item == next);
+}
+
+static float *render(int preload, int *frames)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    float *buf = NULL, *grown;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.preload", preload));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_ASSERT((player->preload_thread != NULL) == preload);
+
+    for(i = 0; i < NUM_FILES; i++)
+    {
+        TEST_SUCCESS(fluid_player_add_mem(player, midi_files[i], sizeof(midi_files[i])));
+    }
+
+    TEST_SUCCESS(fluid_player_play(player));
+    *frames = 0;
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        // once the first file is playing, the next one is always loaded before it is due
+        if(preload && player->currentfile != NULL)
+        {
+            wait_preloaded(player);
+        }
+
+        grown = FLUID_REALLOC(buf, 2 * (*frames + CHUNK_FRAMES) * sizeof(float));
+        TEST_ASSERT(grown != NULL);
+        buf = grown;
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, CHUNK_FRAMES, buf, 2 * *frames, 2, buf, 2 * *frames + 1, 2));
+        *frames += CHUNK_FRAMES;
+    }
+
+    fluid_player_stop(player);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+int main(void)
+{
+    float *plain, *preloaded;
+    int plain_frames, preloaded_frames, i;
+
+    plain = render(FALSE, &plain_frames);
+    preloaded = render(TRUE, &preloaded_frames);
+
+    // half a second of music per file at least, sounding the same
+    TEST_ASSERT(plain_frames >= NUM_FILES * 44100 / 2);
+    TEST_ASSERT(preloaded_frames == plain_frames);
+
+    for(i = 0; i < 2 * plain_frames; i++)
+    {
+        TEST_ASSERT(preloaded[i] == plain[i]);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(preloaded);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+#include "midi/fluid_midi.h"
+
+// this test makes sure that the player announces the program changes of player.program-lookahead ahead, so that
+// the samples of their presets are loaded with synth.dynamic-sample-loading before they are played, and that
+// the presets are released once played
+
+#define RATE 44100
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 18,
+    0x00, 0x90, 0x3c, 0x64,       // 0: note on
+    0x8f, 0x00, 0xc0, 0x05,       // 1920, two seconds: program change
+    0x83, 0x60, 0x80, 0x3c, 0x00, // 2400: note off
+    0x83, 0x60, 0xff, 0x2f, 0x00, // 2880: end of track
+};
+
+static int count_loaded(fluid_synth_t *synth)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        count += (((fluid_sample_t *)fluid_list_get(list))->data != NULL);
+    }
+
+    return count;
+}
+
+// waits for the lookahead thread of the player to carry out the requests queued
+static void wait_lookahead(fluid_player_t *player)
+{
+    int i;
+
+    for(i = 0; i < 1000 && fluid_player_lookahead_pending(player) > 0; i++)
+    {
+        fluid_msleep(10);
+    }
+
+    TEST_ASSERT(fluid_player_lookahead_pending(player) == 0);
+}
+
+// the number of samples loaded half a second and one and a half second into the file, and once played
+static void play(double lookahead, int *counts)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    float *buf = FLUID_ARRAY(float, 2 * RATE);
+    int i;
+
+    TEST_ASSERT(settings != NULL && buf != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "player.program-lookahead", lookahead));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", RATE));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+
+    for(i = 0; i < 4; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, RATE / 2, buf, 0, 2, buf, 1, 2));
+
+        if(i == 0 || i == 2)
+        {
+            wait_lookahead(player);
+            *counts++ = count_loaded(synth);
+        }
+    }
+
+    for(i = 0; i < 10 && fluid_player_get_status(player) == FLUID_PLAYER_PLAYING; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, RATE / 2, buf, 0, 2, buf, 1, 2));
+    }
+
+    TEST_ASSERT(fluid_player_get_status(player) == FLUID_PLAYER_DONE);
+    wait_lookahead(player);
+    *counts = count_loaded(synth);
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    FLUID_FREE(buf);
+}
+
+int main(void)
+{
+    int plain[3], lookahead[3];
+
+#ifdef RT_ALLOC_CHECK
+    // the program changes played load the samples of their presets while rendering
+    return EXIT_SUCCESS;
+#endif
+
+    play(0, plain);
+    play(1.0, lookahead);
+
+    // without lookahead, the samples of the program are loaded once it is played
+    TEST_ASSERT(plain[1] == plain[0]);
+    TEST_ASSERT(plain[2] > plain[0]);
+
+    // with a second of lookahead, a second before, and kept once played
+    TEST_ASSERT(lookahead[0] == plain[0]);
+    TEST_ASSERT(lookahead[1] == plain[2]);
+    TEST_ASSERT(lookahead[2] == plain[2]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that fluid_player_render() renders a MIDI file completely, chunk by chunk,
+// the same as calling fluid_synth_write_float() in a loop, and that the callback can stop it
+
+#define CHUNK_FRAMES 1000
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 13,
+    0x00, 0x90, 0x3c, 0x64,       // 0: note on
+    0x83, 0x60, 0x80, 0x3c, 0x00, // 480: note off
+    0x00, 0xff, 0x2f, 0x00,       // 480: end of track
+};
+
+// a growable buffer in memory
+typedef struct
+{
+    float *buf;
+    int frames;
+    int max_frames;                 // stop rendering beyond, 0 for no limit
+} chunks_t;
+
+static int store_chunk(void *data, const float *buf, int frames)
+{
+    chunks_t *chunks = data;
+    float *grown;
+
+    TEST_ASSERT(frames == CHUNK_FRAMES);
+
+    if(chunks->max_frames > 0 && chunks->frames >= chunks->max_frames)
+    {
+        return FLUID_FAILED;
+    }
+
+    grown = FLUID_REALLOC(chunks->buf, 2 * (chunks->frames + frames) * sizeof(float));
+    TEST_ASSERT(grown != NULL);
+    chunks->buf = grown;
+
+    FLUID_MEMCPY(chunks->buf + 2 * chunks->frames, buf, 2 * frames * sizeof(float));
+    chunks->frames += frames;
+
+    return FLUID_OK;
+}
+
+static int render(chunks_t *chunks, int use_callback)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    float buf[2 * CHUNK_FRAMES];
+    int result = FLUID_OK;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+
+    if(use_callback)
+    {
+        result = fluid_player_render(player, CHUNK_FRAMES, store_chunk, chunks);
+    }
+    else
+    {
+        while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+        {
+            TEST_SUCCESS(fluid_synth_write_float(synth, CHUNK_FRAMES, buf, 0, 2, buf, 1, 2));
+            TEST_SUCCESS(store_chunk(chunks, buf, CHUNK_FRAMES));
+        }
+    }
+
+    fluid_player_stop(player);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return result;
+}
+
+int main(void)
+{
+    chunks_t plain = { NULL, 0, 0 }, rendered = { NULL, 0, 0 }, stopped = { NULL, 0, 4 * CHUNK_FRAMES };
+    int i;
+
+    TEST_ASSERT(fluid_player_render(NULL, CHUNK_FRAMES, store_chunk, &rendered) == FLUID_FAILED);
+
+    render(&plain, FALSE);
+    TEST_SUCCESS(render(&rendered, TRUE));
+
+    // half a second of music at least, sounding the same
+    TEST_ASSERT(rendered.frames >= 44100 / 2);
+    TEST_ASSERT(rendered.frames == plain.frames);
+
+    for(i = 0; i < 2 * rendered.frames; i++)
+    {
+        TEST_ASSERT(rendered.buf[i] == plain.buf[i]);
+    }
+
+    // the callback stops rendering
+    TEST_ASSERT(render(&stopped, TRUE) == FLUID_FAILED);
+    TEST_ASSERT(stopped.frames == stopped.max_frames);
+
+    FLUID_FREE(plain.buf);
+    FLUID_FREE(rendered.buf);
+    FLUID_FREE(stopped.buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that fluid_player_render_segments() renders a MIDI file in segments of a second, with
+// the controllers replayed at their beginning, the same as fluid_player_render(), when every note has been
+// silenced before the pre-roll of the next segment, and that the callback can stop it
+
+#define CHUNK_FRAMES 1000
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 46,
+    0x00, 0x90, 0x3c, 0x64,       // 0: note on
+    0x64, 0xb0, 0x07, 0x40,       // 100: volume, replayed by the next segments
+    0x81, 0x0c, 0x80, 0x3c, 0x00, // 240: note off
+    0x78, 0xb0, 0x78, 0x00,       // 360: all sound off
+    0x81, 0x70, 0x90, 0x40, 0x64, // 600: note on, in the pre-roll of the second segment
+    0x84, 0x58, 0x80, 0x40, 0x00, // 1200: note off
+    0x78, 0xb0, 0x78, 0x00,       // 1320: all sound off
+    0x81, 0x34, 0x90, 0x43, 0x64, // 1500: note on, in the pre-roll of the third segment
+    0x85, 0x3c, 0x80, 0x43, 0x00, // 2200: note off
+    0x81, 0x48, 0xff, 0x2f, 0x00, // 2400: end of track
+};
+
+// a growable buffer in memory
+typedef struct
+{
+    float *buf;
+    int frames;
+    int max_frames;                 // stop rendering beyond, 0 for no limit
+} chunks_t;
+
+static int store_chunk(void *data, const float *buf, int frames)
+{
+    chunks_t *chunks = data;
+    float *grown;
+
+    TEST_ASSERT(frames > 0 && frames <= CHUNK_FRAMES);
+
+    if(chunks->max_frames > 0 && chunks->frames >= chunks->max_frames)
+    {
+        return FLUID_FAILED;
+    }
+
+    grown = FLUID_REALLOC(chunks->buf, 2 * (chunks->frames + frames) * sizeof(float));
+    TEST_ASSERT(grown != NULL);
+    chunks->buf = grown;
+
+    FLUID_MEMCPY(chunks->buf + 2 * chunks->frames, buf, 2 * frames * sizeof(float));
+    chunks->frames += frames;
+
+    return FLUID_OK;
+}
+
+// renders in segments with the given number of threads, or with fluid_player_render() if 0
+static int render(chunks_t *chunks, int jobs, int lazy)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    int result;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lazy-preset-loading", lazy));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "player.segment-length", 1.0));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "player.segment-pre-roll", 0.5));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+
+    if(jobs > 0)
+    {
+        result = fluid_player_render_segments(player, CHUNK_FRAMES, jobs, store_chunk, chunks);
+
+        // the player itself is left alone
+        TEST_ASSERT(fluid_player_get_status(player) == FLUID_PLAYER_READY);
+    }
+    else
+    {
+        TEST_SUCCESS(fluid_player_play(player));
+        result = fluid_player_render(player, CHUNK_FRAMES, store_chunk, chunks);
+        fluid_player_stop(player);
+    }
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return result;
+}
+
+static void compare(chunks_t *plain, int jobs)
+{
+    chunks_t segments = { NULL, 0, 0 };
+    int i;
+
+    TEST_SUCCESS(render(&segments, jobs, FALSE));
+
+    // the last segment is rendered in chunks of its own
+    TEST_ASSERT(segments.frames > 2 * 44100);
+    TEST_ASSERT(abs(segments.frames - plain->frames) <= 4096);
+
+    // crossfaded between the segments
+    for(i = 0; i < 2 * segments.frames && i < 2 * plain->frames; i++)
+    {
+        TEST_ASSERT(fabs(segments.buf[i] - plain->buf[i]) < 1e-6);
+    }
+
+    FLUID_FREE(segments.buf);
+}
+
+int main(void)
+{
+    chunks_t plain = { NULL, 0, 0 }, stopped = { NULL, 0, 4 * CHUNK_FRAMES }, lazy = { NULL, 0, 0 };
+
+    TEST_SUCCESS(render(&plain, 0, FALSE));
+
+    compare(&plain, 1);
+    compare(&plain, 3);
+
+    // the callback stops rendering
+    TEST_ASSERT(render(&stopped, 2, FALSE) == FLUID_FAILED);
+    TEST_ASSERT(stopped.frames == stopped.max_frames);
+
+    // the SoundFonts can't be shared if their presets are imported on demand
+    TEST_ASSERT(render(&lazy, 2, TRUE) == FLUID_FAILED);
+    TEST_ASSERT(lazy.frames == 0);
+
+    FLUID_FREE(plain.buf);
+    FLUID_FREE(stopped.buf);
+
+    return EXIT_SUCCESS;
+}
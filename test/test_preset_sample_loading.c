@@ -24,7 +24,7 @@ int main(void)
 
         TEST_ASSERT(id[0] != FLUID_FAILED);
 
-#if LIBSNDFILE_SUPPORT
+#if LIBSNDFILE_SUPPORT || LIBVORBIS_SUPPORT
         TEST_ASSERT(id[1] != FLUID_FAILED);
         TEST_ASSERT(sfcount == 2);
 #else
@@ -0,0 +1,110 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "drivers/fluid_render_ahead.h"
+#include <stdlib.h>
+
+// this test makes sure that audio rendered ahead by the render thread is read by the audio driver
+// in the order and with the content it was rendered, no matter how many frames are read at once
+
+#define PERIODS 4
+#define FRAMES 4000
+
+static fluid_settings_t *create_settings(int periods)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.render-ahead", periods));
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.period-size", 64));
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.realtime-prio", 0));
+
+    return settings;
+}
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    return synth;
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], out[2 * FRAMES];
+    static int16_t out16[2 * FRAMES];
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_render_ahead_t *ahead;
+    int i, len, pos, n = 0;
+
+    // disabled
+    settings = create_settings(0);
+    synth = create_synth(settings);
+    TEST_ASSERT(new_fluid_render_ahead(settings, synth) == NULL);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    // the reference, rendered synchronously
+    settings = create_settings(PERIODS);
+    synth = create_synth(settings);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, ref, 0, 2, ref, 1, 2));
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    settings = create_settings(PERIODS);
+    synth = create_synth(settings);
+    ahead = new_fluid_render_ahead(settings, synth);
+    TEST_ASSERT(ahead != NULL);
+    TEST_ASSERT(fluid_render_ahead_get_depth(ahead) == PERIODS);
+
+    // the first half as float, the second one as 16 bit, giving the render thread time to keep up
+    for(pos = 0; pos < FRAMES; pos += len)
+    {
+        len = 37 * (1 + n++ % 5);
+        len = (FRAMES - pos < len) ? FRAMES - pos : len;
+
+        if(pos < FRAMES / 2)
+        {
+            len = (FRAMES / 2 - pos < len) ? FRAMES / 2 - pos : len;
+            TEST_SUCCESS(fluid_render_ahead_write_float(ahead, len, out, 2 * pos, 2, out, 2 * pos + 1, 2));
+        }
+        else
+        {
+            TEST_SUCCESS(fluid_render_ahead_write_s16(ahead, len, out16, 2 * pos, 2, out16, 2 * pos + 1, 2));
+        }
+
+        fluid_msleep(1);
+    }
+
+    // an underrun gives silence rather than wrong audio, only compare if there wasn't any
+    if(fluid_render_ahead_get_underruns(ahead) == 0)
+    {
+        for(i = 0; i < FRAMES; i++)
+        {
+            TEST_ASSERT(out[i] == ref[i]);
+        }
+
+        for(i = FRAMES; i < 2 * FRAMES; i++)
+        {
+            long s = (long)(ref[i] * 32766.0f + ((ref[i] >= 0) ? 0.5f : -0.5f));
+
+            TEST_ASSERT(labs(out16[i] - s) <= 2);
+        }
+    }
+    else
+    {
+        FLUID_LOG(FLUID_WARN, "%d underruns, the render thread didn't keep up", fluid_render_ahead_get_underruns(ahead));
+    }
+
+    delete_fluid_render_ahead(ahead);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_convolver.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the convolution reverb matches a direct convolution with its impulse response,
+// whether the tail is convolved in larger partitions by a worker thread or not, and that it knows
+// when its output has decayed
+
+// the same durations whatever the block size: 2560 samples of input, rendered 12800 samples on
+#define IR_LENGTH 1500
+#define INPUT_BLOCKS (2560 / FLUID_BUFSIZE)
+#define BLOCKS (INPUT_BLOCKS + 12800 / FLUID_BUFSIZE)
+
+static float ir_left[IR_LENGTH];
+static float ir_right[IR_LENGTH];
+static fluid_real_t input[BLOCKS * FLUID_BUFSIZE];
+
+static void test_convolver(int tail_size, const float *right)
+{
+    fluid_convolver_t *conv = new_fluid_convolver(ir_left, right, IR_LENGTH, tail_size, 0);
+    fluid_real_t out_l[FLUID_BUFSIZE], out_r[FLUID_BUFSIZE];
+    int i, k, n, decayed = FALSE;
+
+    TEST_ASSERT(conv != NULL);
+    TEST_ASSERT(fluid_convolver_is_decayed(conv));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        fluid_convolver_processreplace(conv, &input[i * FLUID_BUFSIZE], out_l, out_r);
+
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            double expected_l = 0, expected_r = 0;
+
+            n = i * FLUID_BUFSIZE + k;
+
+            for(; n >= 0 && n > i * FLUID_BUFSIZE + k - IR_LENGTH; n--)
+            {
+                expected_l += input[n] * ir_left[i * FLUID_BUFSIZE + k - n];
+                expected_r += input[n] * ((right != NULL) ? right : ir_left)[i * FLUID_BUFSIZE + k - n];
+            }
+
+            TEST_ASSERT(fabs(out_l[k] - expected_l) < 1e-4);
+            TEST_ASSERT(fabs(out_r[k] - expected_r) < 1e-4);
+
+            // once decayed, the output stays silent
+            TEST_ASSERT(!decayed || (out_l[k] == 0 && out_r[k] == 0));
+        }
+
+        TEST_ASSERT(i >= INPUT_BLOCKS || !fluid_convolver_is_decayed(conv));
+        decayed = fluid_convolver_is_decayed(conv);
+    }
+
+    TEST_ASSERT(decayed);
+
+    // the level scales the output, which is added by processmix
+    fluid_convolver_reset(conv);
+    fluid_convolver_set_level(conv, 0.5f);
+    out_l[0] = out_r[0] = 1;
+    fluid_convolver_processmix(conv, input, out_l, out_r);
+    TEST_ASSERT(fabs(out_l[0] - 1 - 0.5 * input[0] * ir_left[0]) < 1e-4);
+
+    delete_fluid_convolver(conv);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float *buf;
+    int i;
+
+    // a decaying noise, a different one to the right
+    for(i = 0; i < IR_LENGTH; i++)
+    {
+        double decay = exp(-4.0 * i / IR_LENGTH);
+
+        ir_left[i] = (float)(decay * ((i * 7919 % 201) - 100) / 100.0);
+        ir_right[i] = (float)(decay * ((i * 104729 % 203) - 101) / 101.0);
+    }
+
+    for(i = 0; i < INPUT_BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        input[i] = (fluid_real_t)((i * 31337 % 199) - 99) / 99;
+    }
+
+    // all in the rendering thread, with a tail of a few partitions and a tail of one
+    test_convolver(0, ir_right);
+    test_convolver(0, NULL);
+    test_convolver(100, ir_right);
+    test_convolver(512, ir_right);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", 2));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    buf = FLUID_ARRAY(float, 2 * 44100);
+    TEST_ASSERT(buf != NULL);
+
+    // the groups are checked, the impulse response is copied
+    TEST_ASSERT(fluid_synth_set_reverb_group_ir(synth, 2, ir_left, ir_right, IR_LENGTH) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_set_reverb_group_ir(synth, 0, NULL, NULL, IR_LENGTH) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_reverb_group_ir(synth, -1, ir_left, ir_right, IR_LENGTH));
+    TEST_SUCCESS(fluid_synth_set_reverb_group_ir(synth, 1, ir_right, NULL, IR_LENGTH));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, 44100, buf, 0, 2, buf, 1, 2));
+
+    // back to the built-in reverb
+    TEST_SUCCESS(fluid_synth_set_reverb_group_ir(synth, -1, NULL, NULL, 0));
+    TEST_SUCCESS(fluid_synth_write_float(synth, 44100, buf, 0, 2, buf, 1, 2));
+    TEST_ASSERT(fluid_synth_load_reverb_group_ir(synth, 0, "/nonexistent.wav") == FLUID_FAILED);
+
+    FLUID_FREE(buf);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_rev.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the delay lines of the reverb, processed all at once, keep
+// processmix() equal to processreplace(), that a reset silences the reverb at once, and
+// that the network processed at a decimated rate gives a tail of about the same energy
+
+// durations in blocks of 64 frames, whatever the internal block size is
+#define BLOCKS (6000 * 64 / FLUID_BUFSIZE)
+#define NOISE_BLOCKS (100 * 64 / FLUID_BUFSIZE)
+
+static fluid_revmodel_t *create_reverb(fluid_real_t sample_rate, int decimation)
+{
+    fluid_revmodel_t *rev = new_fluid_revmodel(sample_rate);
+    TEST_ASSERT(rev != NULL);
+    TEST_SUCCESS(fluid_revmodel_set_decimation(rev, decimation));
+    fluid_revmodel_set(rev, FLUID_REVMODEL_SET_ALL, 0.7, 0.3, 0.8, 0.9);
+    return rev;
+}
+
+static void test_reverb(fluid_real_t sample_rate, int decimation)
+{
+    fluid_revmodel_t *rev_replace = create_reverb(sample_rate, decimation);
+    fluid_revmodel_t *rev_mix = create_reverb(sample_rate, decimation);
+    fluid_real_t in[FLUID_BUFSIZE], left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    fluid_real_t mix_left[FLUID_BUFSIZE], mix_right[FLUID_BUFSIZE];
+    fluid_real_t energy = 0, energy_reset = 0;
+    unsigned int rand = 12345;
+    int b, k;
+
+    for(b = 0; b < BLOCKS; b++)
+    {
+        // a noise burst followed by the reverb tail
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            rand = rand * 1103515245 + 12345;
+            in[k] = (b < NOISE_BLOCKS) ? (rand >> 16) / 32768.0 - 1.0 : 0.0;
+            mix_left[k] = mix_right[k] = 0.25;
+        }
+
+        fluid_revmodel_processreplace(rev_replace, in, left, right);
+        fluid_revmodel_processmix(rev_mix, in, mix_left, mix_right);
+
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            TEST_ASSERT(FLUID_FABS(mix_left[k] - 0.25 - left[k]) < 1e-6);
+            TEST_ASSERT(FLUID_FABS(mix_right[k] - 0.25 - right[k]) < 1e-6);
+
+            if(b >= NOISE_BLOCKS && b < 2 * NOISE_BLOCKS)
+            {
+                energy += left[k] * left[k] + right[k] * right[k];
+            }
+        }
+    }
+
+    // there was a reverb tail, and it faded out
+    TEST_ASSERT(energy > 1.0);
+    TEST_ASSERT(FLUID_FABS(left[0]) < 1e-3 && FLUID_FABS(right[0]) < 1e-3);
+
+    // a reset after the same noise burst clears the tail, but for the state of the filters
+    fluid_revmodel_reset(rev_mix);
+    rand = 12345;
+
+    for(b = 0; b < 2 * NOISE_BLOCKS; b++)
+    {
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            rand = rand * 1103515245 + 12345;
+            in[k] = (b < NOISE_BLOCKS) ? (rand >> 16) / 32768.0 - 1.0 : 0.0;
+        }
+
+        if(b == NOISE_BLOCKS)
+        {
+            fluid_revmodel_reset(rev_mix);
+        }
+
+        fluid_revmodel_processreplace(rev_mix, in, left, right);
+
+        for(k = 0; k < FLUID_BUFSIZE && b >= NOISE_BLOCKS; k++)
+        {
+            energy_reset += left[k] * left[k] + right[k] * right[k];
+        }
+    }
+
+    TEST_ASSERT(energy_reset < energy * 1e-3);
+
+    delete_fluid_revmodel(rev_replace);
+    delete_fluid_revmodel(rev_mix);
+}
+
+// returns the energy of the tail after a low pass filtered noise burst
+static fluid_real_t tail_energy(int decimation)
+{
+    fluid_revmodel_t *rev = create_reverb(44100, decimation);
+    fluid_real_t in[FLUID_BUFSIZE], left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    fluid_real_t energy = 0, lp = 0;
+    unsigned int rand = 12345;
+    int b, k;
+
+    for(b = 0; b < 10 * NOISE_BLOCKS; b++)
+    {
+        for(k = 0; k < FLUID_BUFSIZE; k++)
+        {
+            rand = rand * 1103515245 + 12345;
+            lp += 0.04f * ((rand >> 16) / 32768.0 - 1.0 - lp);
+            in[k] = (b < NOISE_BLOCKS) ? lp : 0.0;
+        }
+
+        fluid_revmodel_processreplace(rev, in, left, right);
+
+        for(k = 0; k < FLUID_BUFSIZE && b >= NOISE_BLOCKS; k++)
+        {
+            energy += left[k] * left[k] + right[k] * right[k];
+        }
+    }
+
+    delete_fluid_revmodel(rev);
+
+    return energy;
+}
+
+int main(void)
+{
+    fluid_revmodel_t *rev;
+    fluid_real_t in[FLUID_BUFSIZE] = { 0 }, left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    fluid_real_t energy;
+
+    test_reverb(44100, 1);
+    test_reverb(44100, 2);
+    test_reverb(44100, 4);
+    test_reverb(96000, 1);
+    test_reverb(96000, 4);
+
+    // the frequencies kept by the decimation reverberate as long
+    energy = tail_energy(1);
+    TEST_ASSERT(FLUID_FABS(tail_energy(2) / energy - 1) < 0.25);
+    TEST_ASSERT(FLUID_FABS(tail_energy(4) / energy - 1) < 0.25);
+
+    // the delay lines are reallocated on sample rate changes
+    rev = create_reverb(22050, 1);
+    TEST_SUCCESS(fluid_revmodel_samplerate_change(rev, 192000));
+    fluid_revmodel_processreplace(rev, in, left, right);
+    TEST_SUCCESS(fluid_revmodel_set_decimation(rev, 2));
+    fluid_revmodel_processreplace(rev, in, left, right);
+    TEST_ASSERT(fluid_revmodel_set_decimation(rev, 3) == FLUID_FAILED);
+    delete_fluid_revmodel(rev);
+
+    return EXIT_SUCCESS;
+}
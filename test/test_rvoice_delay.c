@@ -0,0 +1,125 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a voice in the delay section of its volume envelope stays silent and then sounds
+// exactly like the same voice started without a delay once it is over, and that a noteoff ends the delay
+
+#define RATE 44100
+#define SAMPLE_FRAMES 4800
+#define FRAMES 16384
+#define DELAY_TC -3986              // about 0.1 seconds
+
+static short data[SAMPLE_FRAMES];
+
+static float *render(fluid_sample_t *sample, int delay, int noteoff)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_t *voice;
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES);
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", RATE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    fluid_synth_api_enter(synth);
+    voice = fluid_synth_alloc_voice(synth, sample, 0, 60, 100);
+    TEST_ASSERT(voice != NULL);
+
+    if(delay)
+    {
+        fluid_voice_gen_set(voice, GEN_VOLENVDELAY, DELAY_TC);
+    }
+
+    fluid_synth_start_voice(synth, voice);
+    fluid_synth_api_exit(synth);
+
+    if(noteoff)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, 1024, buf, 0, 2, buf, 1, 2));
+        TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES - 1024, buf, 2048, 2, buf, 2049, 2));
+        TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    }
+    else
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+static int matches_at(const float *delayed, const float *plain, int offset)
+{
+    int i;
+
+    for(i = 0; i < 2 * (FRAMES - offset); i++)
+    {
+        if(delayed[2 * offset + i] != plain[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+int main(void)
+{
+    fluid_sample_t *sample = new_fluid_sample();
+    float *plain, *delayed;
+    int i, offset;
+
+    for(i = 0; i < SAMPLE_FRAMES; i++)
+    {
+        data[i] = (short)(20000 * FLUID_SIN(2 * M_PI * i / 100) * (SAMPLE_FRAMES - i) / SAMPLE_FRAMES);
+    }
+
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, SAMPLE_FRAMES, RATE, FALSE));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    plain = render(sample, FALSE, FALSE);
+    delayed = render(sample, TRUE, FALSE);
+
+    // the delay is over after a whole number of blocks
+    for(offset = 0; offset < FRAMES / 2; offset += FLUID_BUFSIZE)
+    {
+        if(matches_at(delayed, plain, offset))
+        {
+            break;
+        }
+    }
+
+    TEST_ASSERT(offset > RATE / 20 && offset < FRAMES / 2);
+
+    for(i = 0; i < 2 * offset; i++)
+    {
+        TEST_ASSERT(delayed[i] == 0);
+    }
+
+    FLUID_FREE(delayed);
+
+    // released before it has made a sound
+    delayed = render(sample, TRUE, TRUE);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(delayed[i] == 0);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(delayed);
+    delete_fluid_sample(sample);
+
+    return EXIT_SUCCESS;
+}
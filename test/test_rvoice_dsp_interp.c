@@ -0,0 +1,376 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_phase.h"
+#include "utils/fluid_sys.h"
+
+// this test verifies the sample interpolators against a straightforward reference implementation,
+// to make sure that the block kernels used internally don't change the rendered output
+
+#define LOOP_START 64
+#define LOOP_LEN 600
+#define LOOP_END (LOOP_START + LOOP_LEN)
+#define SAMPLE_LEN (LOOP_END + 8)
+#define NUM_BUFFERS (40 * 64 / FLUID_BUFSIZE)
+
+// allowed deviation relative to full scale of the 24 bit sample data
+#define EPS (1e-6 * 8388608.0)
+
+// allowed deviation of the single precision interpolation, see synth.dsp-precision
+#define EPS_SINGLE (1e-5 * 8388608.0)
+
+static short data[SAMPLE_LEN];
+static char data24[SAMPLE_LEN];
+static float data_float[SAMPLE_LEN];
+
+// whether the samples under test have their lower 8 bits in data24
+static int is_24bit;
+
+// whether the samples under test have been converted to float, see synth.sample-float
+static int is_float;
+
+// whether the interpolation of the loop uses its padded copy, see synth.sample-loop-padding
+static int is_padded;
+
+// the sample data are periodic within the loop, so that the reference can read them without any wrap around
+static double ref_point(long idx)
+{
+    idx = LOOP_START + ((idx - LOOP_START) % LOOP_LEN + LOOP_LEN) % LOOP_LEN;
+    return (double)((int32_t)(((uint32_t)data[idx] << 8) | (is_24bit ? (uint8_t)data24[idx] : 0U)));
+}
+
+static double ref_interp(int method, uint64_t phase)
+{
+    double x, v, sum = 0;
+    unsigned int row;
+    long idx;
+    int i;
+
+    switch(method)
+    {
+    case FLUID_INTERP_NONE:
+        return ref_point((long)((phase + 0x80000000) >> 32));
+
+    case FLUID_INTERP_LINEAR:
+        idx = (long)(phase >> 32);
+        x = (double)((phase >> FLUID_INTERP_BITS_SHIFT) & (FLUID_INTERP_MAX - 1)) / FLUID_INTERP_MAX;
+        return (1.0 - x) * ref_point(idx) + x * ref_point(idx + 1);
+
+    case FLUID_INTERP_4THORDER:
+        idx = (long)(phase >> 32);
+        x = (double)((phase >> FLUID_INTERP_BITS_SHIFT) & (FLUID_INTERP_MAX - 1)) / FLUID_INTERP_MAX;
+        return (x * (-0.5 + x * (1 - 0.5 * x))) * ref_point(idx - 1)
+               + (1.0 + x * x * (1.5 * x - 2.5)) * ref_point(idx)
+               + (x * (0.5 + x * (2.0 - 1.5 * x))) * ref_point(idx + 1)
+               + (0.5 * x * x * (x - 1.0)) * ref_point(idx + 2);
+
+    case FLUID_INTERP_7THORDER:
+        phase += 0x80000000;
+        idx = (long)(phase >> 32);
+        row = (unsigned int)((phase >> FLUID_SINC_INTERP_BITS_SHIFT) & (FLUID_SINC_INTERP_MAX - 1));
+
+        for(i = 0; i < 7; i++)
+        {
+            x = M_PI * ((double)i - 3.5 + (double)(FLUID_SINC_INTERP_MAX - 1 - row) / FLUID_SINC_INTERP_MAX);
+            v = (fabs(x) > 0.000001 * M_PI) ? sin(x) / x * 0.5 * (1.0 + cos(2.0 * x / 7.0)) : 1.0;
+            sum += v * ref_point(idx + i - 3);
+        }
+
+        return sum;
+    }
+
+    return 0;
+}
+
+static void test_interp(int method, double incr, int single_precision)
+{
+    fluid_sample_t sample;
+    fluid_rvoice_dsp_t voice;
+    fluid_real_t buf[FLUID_BUFSIZE];
+    uint64_t ref_phase, ref_incr;
+    fluid_real_t ref_amp;
+    double expected;
+    int i, n, count;
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.data24 = is_24bit ? data24 : NULL;
+    sample.float_data = is_float ? data_float : NULL;
+    sample.start = 0;
+    sample.end = SAMPLE_LEN - 1;
+    sample.loopstart = LOOP_START;
+    sample.loopend = LOOP_END;
+
+    if(is_padded)
+    {
+        fluid_sample_pad_loop(&sample);
+        TEST_ASSERT(sample.loop_data != NULL);
+    }
+
+    FLUID_MEMSET(&voice, 0, sizeof(voice));
+    voice.sample = &sample;
+    voice.start = sample.start;
+    voice.end = sample.end;
+    voice.loopstart = sample.loopstart;
+    voice.loopend = sample.loopend;
+    voice.amp = 0.5;
+    voice.amp_incr = 1e-5;
+    voice.phase_incr = incr;
+    voice.single_precision = single_precision;
+    fluid_phase_set_int(voice.phase, 8);
+
+    ref_phase = voice.phase;
+    fluid_phase_set_float(ref_incr, (fluid_real_t)incr);
+    ref_amp = voice.amp;
+
+    for(n = 0; n < NUM_BUFFERS; n++)
+    {
+        switch(method)
+        {
+        case FLUID_INTERP_NONE:
+            count = fluid_rvoice_dsp_interpolate_none(&voice, buf, TRUE);
+            break;
+
+        case FLUID_INTERP_LINEAR:
+            count = fluid_rvoice_dsp_interpolate_linear(&voice, buf, TRUE);
+            break;
+
+        case FLUID_INTERP_4THORDER:
+            count = fluid_rvoice_dsp_interpolate_4th_order(&voice, buf, TRUE);
+            break;
+
+        default:
+            count = fluid_rvoice_dsp_interpolate_7th_order(&voice, buf, TRUE);
+            break;
+        }
+
+        TEST_ASSERT(count == FLUID_BUFSIZE);
+
+        for(i = 0; i < count; i++)
+        {
+            expected = ref_amp * ref_interp(method, ref_phase);
+
+            if(fabs(buf[i] - expected) > (single_precision ? EPS_SINGLE : EPS))
+            {
+                FLUID_LOG(FLUID_ERR, "interp %d, incr %f, single %d, buffer %d, frame %d: got %f, expected %f",
+                          method, incr, single_precision, n, i, (double)buf[i], expected);
+                TEST_ASSERT(0);
+            }
+
+            ref_phase += ref_incr;
+            ref_amp += voice.amp_incr;
+        }
+    }
+
+    TEST_ASSERT(voice.has_looped);
+    fluid_sample_unpad_loop(&sample);
+}
+
+static int interp_single_looping(int method, fluid_rvoice_dsp_t *voice, fluid_real_t *buf, int looping)
+{
+    switch(method)
+    {
+    case FLUID_INTERP_NONE:
+        return fluid_rvoice_dsp_interpolate_none(voice, buf, looping);
+
+    case FLUID_INTERP_LINEAR:
+        return fluid_rvoice_dsp_interpolate_linear(voice, buf, looping);
+
+    case FLUID_INTERP_4THORDER:
+        return fluid_rvoice_dsp_interpolate_4th_order(voice, buf, looping);
+
+    default:
+        return fluid_rvoice_dsp_interpolate_7th_order(voice, buf, looping);
+    }
+}
+
+static int interp_single(int method, fluid_rvoice_dsp_t *voice, fluid_real_t *buf)
+{
+    return interp_single_looping(method, voice, buf, TRUE);
+}
+
+// interpolating several voices playing the same sample at once must give the same result as interpolating them one by one
+static void test_interp_batch(int method, double incr)
+{
+    fluid_sample_t sample;
+    fluid_rvoice_dsp_t voices[FLUID_RVOICE_BATCH_MAX], single[FLUID_RVOICE_BATCH_MAX];
+    fluid_rvoice_dsp_t *batch[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t buf[FLUID_RVOICE_BATCH_MAX][FLUID_BUFSIZE];
+    fluid_real_t *bufs[FLUID_RVOICE_BATCH_MAX];
+    fluid_real_t single_buf[FLUID_BUFSIZE];
+    int looping[FLUID_RVOICE_BATCH_MAX], counts[FLUID_RVOICE_BATCH_MAX];
+    int i, n, v;
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.data24 = is_24bit ? data24 : NULL;
+    sample.float_data = is_float ? data_float : NULL;
+    sample.start = 0;
+    sample.end = SAMPLE_LEN - 1;
+    sample.loopstart = LOOP_START;
+    sample.loopend = LOOP_END;
+
+    for(v = 0; v < FLUID_RVOICE_BATCH_MAX; v++)
+    {
+        FLUID_MEMSET(&voices[v], 0, sizeof(voices[v]));
+        voices[v].sample = &sample;
+        voices[v].interp_method = method;
+        voices[v].start = sample.start;
+        voices[v].end = sample.end;
+        voices[v].loopstart = sample.loopstart;
+        voices[v].loopend = sample.loopend;
+        voices[v].amp = 0.5 + 0.01 * v;
+        voices[v].amp_incr = 1e-5;
+        voices[v].phase_incr = incr * (1.0 + 0.1 * v);
+        // spread the voices over the sample, so that some of them hit the loop points while others don't
+        fluid_phase_set_int(voices[v].phase, 8 + 77 * v);
+
+        single[v] = voices[v];
+        batch[v] = &voices[v];
+        bufs[v] = buf[v];
+        looping[v] = TRUE;
+    }
+
+    for(n = 0; n < NUM_BUFFERS; n++)
+    {
+        fluid_rvoice_dsp_interpolate_batch(batch, bufs, looping, counts, FLUID_RVOICE_BATCH_MAX);
+
+        for(v = 0; v < FLUID_RVOICE_BATCH_MAX; v++)
+        {
+            TEST_ASSERT(counts[v] == interp_single(method, &single[v], single_buf));
+            TEST_ASSERT(voices[v].phase == single[v].phase);
+            TEST_ASSERT(voices[v].has_looped == single[v].has_looped);
+
+            for(i = 0; i < counts[v]; i++)
+            {
+                TEST_ASSERT(fabs(buf[v][i] - single_buf[i]) <= EPS);
+            }
+        }
+    }
+}
+
+// copying the sample frames of a voice at its original pitch must give the same result as interpolating them,
+// within the loop and up to the end of the sample
+static void test_copy(int method, int looping)
+{
+    fluid_sample_t sample;
+    fluid_rvoice_dsp_t voice, single;
+    fluid_real_t buf[FLUID_BUFSIZE], single_buf[FLUID_BUFSIZE];
+    int i, n, count;
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.data24 = is_24bit ? data24 : NULL;
+    sample.float_data = is_float ? data_float : NULL;
+    sample.start = 0;
+    sample.end = SAMPLE_LEN - 1;
+    sample.loopstart = LOOP_START;
+    sample.loopend = LOOP_END;
+
+    FLUID_MEMSET(&voice, 0, sizeof(voice));
+    voice.sample = &sample;
+    voice.start = sample.start;
+    voice.end = sample.end;
+    voice.loopstart = sample.loopstart;
+    voice.loopend = sample.loopend;
+    voice.amp = 0.5;
+    voice.amp_incr = 1e-5;
+    voice.phase_incr = 1.0;
+    voice.start_offset = 5;
+    fluid_phase_set_int(voice.phase, 8);
+    single = voice;
+
+    for(n = 0; n < NUM_BUFFERS; n++)
+    {
+        count = fluid_rvoice_dsp_copy(&voice, buf, looping);
+        TEST_ASSERT(count == interp_single_looping(method, &single, single_buf, looping));
+
+        TEST_ASSERT(voice.phase == single.phase);
+        TEST_ASSERT(voice.has_looped == single.has_looped);
+
+        for(i = voice.start_offset; i < count; i++)
+        {
+            TEST_ASSERT(fabs(buf[i] - single_buf[i]) <= EPS);
+        }
+
+        voice.start_offset = single.start_offset = 0;
+    }
+
+    TEST_ASSERT(voice.has_looped == looping);
+}
+
+int main(void)
+{
+    static const double incrs[] = { 0.37, 1.0, 1.4999, 2.71, 7.3 };
+    static const int methods[] =
+    {
+        FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER
+    };
+    unsigned int seed = 1;
+    unsigned int i, j;
+
+#ifdef ENABLE_RUNTIME_TABLES
+    // without a synth, nobody else computes the tables
+    fluid_rvoice_dsp_config();
+#endif
+
+    for(i = 0; i < SAMPLE_LEN; i++)
+    {
+        if(i < LOOP_END)
+        {
+            seed = seed * 1103515245 + 12345;
+            data[i] = (short)(seed >> 16);
+            data24[i] = (char)(seed >> 8);
+        }
+        else
+        {
+            data[i] = data[i - LOOP_LEN];
+            data24[i] = data24[i - LOOP_LEN];
+        }
+    }
+
+    // make the data in front of the loop periodic as well
+    for(i = 0; i < LOOP_START; i++)
+    {
+        data[i] = data[i + LOOP_LEN];
+        data24[i] = data24[i + LOOP_LEN];
+    }
+
+    // the kernels are specialized for 16 and 24 bit samples and for the ones converted to float, test all of them
+    for(is_24bit = FALSE; is_24bit <= TRUE; is_24bit++)
+    {
+        for(i = 0; i < SAMPLE_LEN; i++)
+        {
+            data_float[i] = (float)(int32_t)(((uint32_t)data[i] << 8) | (is_24bit ? (uint8_t)data24[i] : 0U));
+        }
+
+        for(is_float = FALSE; is_float <= TRUE; is_float++)
+        {
+            for(i = 0; i < FLUID_N_ELEMENTS(methods); i++)
+            {
+                for(j = 0; j < FLUID_N_ELEMENTS(incrs); j++)
+                {
+                    for(is_padded = FALSE; is_padded <= TRUE; is_padded++)
+                    {
+                        test_interp(methods[i], incrs[j], FALSE);
+                        test_interp(methods[i], incrs[j], TRUE);
+                    }
+
+                    is_padded = FALSE;
+                    test_interp_batch(methods[i], incrs[j]);
+                }
+
+                // the 7th order table rows are a fraction of a frame off the sample points
+                if(methods[i] != FLUID_INTERP_7THORDER)
+                {
+                    test_copy(methods[i], TRUE);
+                    test_copy(methods[i], FALSE);
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_rvoice_event.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the voice event queue grows instead of dropping events when it is full,
+// and that the events are dispatched in the order they were pushed, also while the renderer
+// dispatches them concurrently and the events taking up several slots are mixed with the others
+
+#define QUEUE_SIZE 16
+#define NUM_EVENTS 20000
+
+static int dispatched;
+
+static void count_event(void *obj, const fluid_rvoice_param_t param[MAX_EVENT_PARAMS])
+{
+    TEST_ASSERT(obj == &dispatched);
+    TEST_ASSERT(param[0].i == dispatched);
+    dispatched++;
+}
+
+static void count_long_event(void *obj, const fluid_rvoice_param_t param[MAX_EVENT_PARAMS])
+{
+    int i;
+
+    TEST_ASSERT(obj == &dispatched);
+
+    for(i = 0; i < MAX_EVENT_PARAMS; i++)
+    {
+        TEST_ASSERT(param[i].i == dispatched + i);
+    }
+
+    dispatched++;
+}
+
+// every third event has all params
+static void push_event(fluid_rvoice_eventhandler_t *handler, int i)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    int k;
+
+    if(i % 3 != 0)
+    {
+        TEST_SUCCESS(fluid_rvoice_eventhandler_push_int_real(handler, count_event, &dispatched, i, 0));
+        return;
+    }
+
+    for(k = 0; k < MAX_EVENT_PARAMS; k++)
+    {
+        param[k].i = i + k;
+    }
+
+    TEST_SUCCESS(fluid_rvoice_eventhandler_push(handler, count_long_event, &dispatched, param, MAX_EVENT_PARAMS));
+}
+
+static fluid_thread_return_t push_events(void *data)
+{
+    fluid_rvoice_eventhandler_t *handler = data;
+    int i;
+
+    for(i = 0; i < NUM_EVENTS; i++)
+    {
+        push_event(handler, i);
+
+        // groups of different sizes, some of them larger than the queue
+        if(i % 37 == 0 || i % 101 == 0)
+        {
+            fluid_rvoice_eventhandler_flush(handler);
+        }
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_rvoice_eventhandler_t *handler;
+    fluid_thread_t *thread;
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    int i, capacity, queued, max_queued;
+
+    handler = new_fluid_rvoice_eventhandler(QUEUE_SIZE, 16, 1, 1, 1, 0, 0);
+    TEST_ASSERT(handler != NULL);
+
+    fluid_rvoice_eventhandler_get_stats(handler, &capacity, &queued, &max_queued);
+    TEST_ASSERT(capacity == QUEUE_SIZE);
+    TEST_ASSERT(queued == 0);
+    TEST_ASSERT(max_queued == 0);
+
+    // pushed events are not dispatched before they are flushed
+    for(i = 0; i < 3 * QUEUE_SIZE; i++)
+    {
+        TEST_SUCCESS(fluid_rvoice_eventhandler_push_int_real(handler, count_event, &dispatched, i, 0));
+    }
+
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 0);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == 0);
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 3 * QUEUE_SIZE);
+
+    fluid_rvoice_eventhandler_get_stats(handler, &capacity, &queued, &max_queued);
+    TEST_ASSERT(capacity >= 3 * QUEUE_SIZE);
+    TEST_ASSERT(queued == 3 * QUEUE_SIZE);
+    TEST_ASSERT(max_queued == 3 * QUEUE_SIZE);
+
+    // events spilled while the queue is drained keep their order
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == 3 * QUEUE_SIZE);
+    TEST_ASSERT(dispatched == 3 * QUEUE_SIZE);
+
+    for(i = dispatched; i < 5 * QUEUE_SIZE; i++)
+    {
+        TEST_SUCCESS(fluid_rvoice_eventhandler_push_int_real(handler, count_event, &dispatched, i, 0));
+        fluid_rvoice_eventhandler_flush(handler);
+    }
+
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == 2 * QUEUE_SIZE);
+    TEST_ASSERT(dispatched == 5 * QUEUE_SIZE);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 0);
+
+    // long events wrapping around the end of the queue and spilled, counted by their slots while queued
+    dispatched = 0;
+
+    for(i = 0; i < 3 * QUEUE_SIZE; i++)
+    {
+        push_event(handler, i);
+
+        if(i % 5 == 0)
+        {
+            fluid_rvoice_eventhandler_flush(handler);
+            fluid_rvoice_eventhandler_dispatch_all(handler);
+        }
+    }
+
+    for(; i < 9 * QUEUE_SIZE; i++)
+    {
+        push_event(handler, i);
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) > 9 * QUEUE_SIZE - dispatched);
+    fluid_rvoice_eventhandler_dispatch_all(handler);
+    TEST_ASSERT(dispatched == 9 * QUEUE_SIZE);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 0);
+
+    // a producer and a renderer running concurrently
+    dispatched = 0;
+    thread = new_fluid_thread("rvoice-event-queue-test", push_events, handler, 0, FALSE);
+    TEST_ASSERT(thread != NULL);
+
+    for(i = 0; dispatched < NUM_EVENTS; i++)
+    {
+        fluid_rvoice_eventhandler_dispatch_all(handler);
+
+        if(i % 16 == 0)
+        {
+            fluid_msleep(1);
+        }
+    }
+
+    TEST_SUCCESS(fluid_thread_join(thread));
+    delete_fluid_thread(thread);
+
+    TEST_ASSERT(dispatched == NUM_EVENTS);
+    fluid_rvoice_eventhandler_get_stats(handler, &capacity, &queued, &max_queued);
+    TEST_ASSERT(queued == 0);
+    TEST_ASSERT(capacity >= max_queued);
+
+    delete_fluid_rvoice_eventhandler(handler);
+
+    // the statistics of the synth
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 16));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    fluid_synth_get_event_queue_stats(synth, &capacity, NULL, NULL);
+    TEST_ASSERT(capacity == 16 * 64);
+    fluid_synth_get_event_queue_stats(synth, NULL, NULL, NULL);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the voices playing both samples of a stereo pair are rendered together when
+// started in a batch, and that they sound exactly the same as when rendered on their own, also when one
+// of them is turned off before the other.
+
+#define FRAMES 1000
+#define PERIOD 100
+#define BLOCKS 200
+
+static short data[2 * FRAMES];
+
+static fluid_sample_t *new_sample(int channel)
+{
+    fluid_sample_t *sample = new_fluid_sample();
+
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, FRAMES, 44100, FALSE));
+    TEST_SUCCESS(fluid_sample_set_loop(sample, PERIOD, FRAMES - PERIOD));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    // both channels are stored in the same sample data, like the ones of a SoundFont
+    sample->start += channel * FRAMES;
+    sample->end += channel * FRAMES;
+    sample->loopstart += channel * FRAMES;
+    sample->loopend += channel * FRAMES;
+    sample->sampletype = channel ? FLUID_SAMPLETYPE_RIGHT : FLUID_SAMPLETYPE_LEFT;
+
+    return sample;
+}
+
+// renders a note of both samples, turning voice "off" off half way if not negative
+static float *render(fluid_sample_t **samples, int batched, int off)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_t *voices[2];
+    fluid_voice_batch_t batch;
+    float *buf = FLUID_ARRAY(float, 2 * BLOCKS * FLUID_BUFSIZE);
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    fluid_synth_api_enter(synth);
+    batch.count = 0;
+
+    for(i = 0; i < 2; i++)
+    {
+        voices[i] = fluid_synth_alloc_voice(synth, samples[i], 0, 64, 100);
+        TEST_ASSERT(voices[i] != NULL);
+        fluid_voice_gen_set(voices[i], GEN_PAN, i ? 500 : -500);
+        fluid_voice_gen_set(voices[i], GEN_SAMPLEMODE, FLUID_LOOP_DURING_RELEASE);
+        fluid_voice_gen_set(voices[i], GEN_VOLENVRELEASE, -12000);
+
+        if(batched)
+        {
+            fluid_synth_start_voice_batch_LOCAL(synth, voices[i], &batch);
+        }
+        else
+        {
+            fluid_synth_start_voice(synth, voices[i]);
+        }
+    }
+
+    fluid_synth_commit_voice_batch_LOCAL(synth, &batch);
+    fluid_synth_api_exit(synth);
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 2 * i * FLUID_BUFSIZE, 2,
+                                             buf, 2 * i * FLUID_BUFSIZE + 1, 2));
+
+        if(i == 0)
+        {
+            TEST_ASSERT((voices[0]->rvoice->stereo_follower == voices[1]->rvoice) == batched);
+            TEST_ASSERT((voices[1]->rvoice->stereo_leader == voices[0]->rvoice) == batched);
+        }
+
+        if(i == BLOCKS / 2)
+        {
+            if(off >= 0)
+            {
+                fluid_synth_api_enter(synth);
+                fluid_voice_off(voices[off]);
+                fluid_synth_api_exit(synth);
+            }
+            else
+            {
+                TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 64));
+            }
+        }
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == ((off >= 0) ? 1 : 0));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+static void compare(fluid_sample_t **samples, int off)
+{
+    float *plain = render(samples, FALSE, off);
+    float *paired = render(samples, TRUE, off);
+    int i;
+
+    for(i = 0; i < 2 * BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        TEST_ASSERT(paired[i] == plain[i]);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(paired);
+}
+
+int main(void)
+{
+    fluid_sample_t *samples[2];
+    int i;
+
+    // the right channel a quarter of a period behind the left one
+    for(i = 0; i < FRAMES; i++)
+    {
+        data[i] = (short)(10000 * FLUID_SIN(2 * M_PI * i / PERIOD));
+        data[FRAMES + i] = (short)(10000 * FLUID_SIN(2 * M_PI * (i - PERIOD / 4) / PERIOD));
+    }
+
+    samples[0] = new_sample(0);
+    samples[1] = new_sample(1);
+
+    compare(samples, -1);
+    compare(samples, 0);
+    compare(samples, 1);
+
+    delete_fluid_sample(samples[0]);
+    delete_fluid_sample(samples[1]);
+
+    return EXIT_SUCCESS;
+}
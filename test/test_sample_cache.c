@@ -5,7 +5,30 @@
 
 
 // this test aims to make sure that sample data used by multiple synths is not freed
-// once unloaded by its parent synth
+// once unloaded by its parent synth, also when synths load and unload it concurrently
+
+#define NUM_THREADS 4
+
+static fluid_thread_return_t load_unload(void *data)
+{
+    float buf[64 * 2];
+    int i;
+
+    for(i = 0; i < 5; i++)
+    {
+        fluid_synth_t *synth = new_fluid_synth(data);
+        TEST_ASSERT(synth != NULL);
+
+        TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60 + i, 127));
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+
+        delete_fluid_synth(synth);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
 int main(void)
 {
     enum { FRAMES = 1024 };
@@ -35,6 +58,26 @@ int main(void)
     // render again with the unloaded sfont and hope no segfault happens
     TEST_SUCCESS(fluid_synth_write_float(synth2, FRAMES, buf, 0, 2, buf, 1, 2));
 
+    // other synths share and release the cached sample data meanwhile
+    {
+        fluid_thread_t *threads[NUM_THREADS];
+        int i;
+
+        for(i = 0; i < NUM_THREADS; i++)
+        {
+            threads[i] = new_fluid_thread("sample-cache-test", load_unload, settings, 0, FALSE);
+            TEST_ASSERT(threads[i] != NULL);
+        }
+
+        for(i = 0; i < NUM_THREADS; i++)
+        {
+            TEST_SUCCESS(fluid_thread_join(threads[i]));
+            delete_fluid_thread(threads[i]);
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth2, FRAMES, buf, 0, 2, buf, 1, 2));
+
     delete_fluid_synth(synth2);
     delete_fluid_settings(settings);
 
@@ -0,0 +1,92 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.sample-cache-size the sample data of an unloaded
+// soundfont stay cached and are found again when loading it again, and that they are freed
+// once they don't fit into the cache anymore
+
+static double stat_delta(fluid_synth_t *synth, int stat, double *last)
+{
+    double value = fluid_synth_get_stat(synth, stat);
+    double delta = value - *last;
+
+    *last = value;
+    return delta;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *synth2;
+    double hits = 0, misses = 0;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-cache-size", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits);
+    stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE) == 0);
+
+    // read from the file the first time
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits) == 0);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses) > 0);
+
+    // kept cached once unloaded
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 1));
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE) > 0);
+
+    // and found again
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits) > 0);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE) == 0);
+
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 1));
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE) > 0);
+
+    // a synth without a cache shares the cached data, but frees them when done
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-cache-size", 0));
+    synth2 = new_fluid_synth(settings);
+    TEST_ASSERT(synth2 != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth2, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits) > 0);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses) == 0);
+
+    TEST_SUCCESS(fluid_synth_sfunload(synth2, id, 1));
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_UNUSED_SIZE) == 0);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth2, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits) == 0);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses) > 0);
+
+    // samples loaded on demand stay cached when switching programs
+    delete_fluid_synth(synth2);
+    delete_fluid_synth(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-cache-size", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits);
+    stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses);
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 1));
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS, &hits) > 0);
+    TEST_ASSERT(stat_delta(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_MISSES, &misses) == 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the sample data converted to float by synth.sample-float hold the same
+// sample points as the 16 and 24 bit data, and that they render exactly the same audio
+
+#define FRAMES 4096
+
+static void verify_float_data(fluid_sfont_t *sfont, int float_samples)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    fluid_sample_t *sample;
+    fluid_list_t *list;
+    unsigned int i;
+    int32_t point;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        if(sample->data == NULL || !float_samples)
+        {
+            // the ones not loaded by the dynamic sample loading have none either
+            TEST_ASSERT(sample->float_data == NULL);
+            continue;
+        }
+
+        TEST_ASSERT(sample->float_data != NULL);
+        TEST_ASSERT(((uintptr_t)sample->float_data & (FLUID_DEFAULT_ALIGNMENT - 1)) == 0);
+
+        for(i = sample->start; i <= sample->end; i++)
+        {
+            point = (int32_t)(((uint32_t)sample->data[i] << 8)
+                              | ((sample->data24 != NULL) ? (uint8_t)sample->data24[i] : 0U));
+            TEST_ASSERT(sample->float_data[i] == (float)point);
+        }
+    }
+}
+
+static void render(int float_samples, int dynamic_samples, int interp, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic_samples));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-float", float_samples));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    // at the original pitch, a fifth and an octave higher, and a bit lower
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 72, 90));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 58, 80));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    verify_float_data(fluid_synth_get_sfont_by_id(synth, id), float_samples);
+
+    // deleting the synth releases the sample data from the sample cache
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static const int interps[] =
+    {
+        FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER
+    };
+    static float ref[FRAMES * 2], buf[FRAMES * 2];
+    unsigned int j;
+    int i;
+
+    for(i = 0; i < 2; i++)
+    {
+        for(j = 0; j < FLUID_N_ELEMENTS(interps); j++)
+        {
+            render(FALSE, i, interps[j], ref);
+            render(TRUE, i, interps[j], buf);
+            TEST_ASSERT(memcmp(ref, buf, sizeof(ref)) == 0);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
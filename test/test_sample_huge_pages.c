@@ -0,0 +1,65 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that advising huge pages only covers the huge pages inside the memory given,
+// that the memory counted in huge pages doesn't exceed it, and that sample data read with
+// synth.huge-pages render the same audio
+
+#define FRAMES 4096
+#define MEMORY_SIZE (16 * 1024 * 1024)
+
+static void render(int huge_pages, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.huge-pages", huge_pages));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    char *memory = FLUID_MALLOC(MEMORY_SIZE);
+    float *plain = FLUID_ARRAY(float, 2 * FRAMES), *huge = FLUID_ARRAY(float, 2 * FRAMES);
+    unsigned long advised;
+    int i;
+
+    TEST_ASSERT(memory != NULL && plain != NULL && huge != NULL);
+
+    // whole huge pages, of at least 2 MB
+    advised = fluid_huge_pages_advise(memory, MEMORY_SIZE);
+    TEST_ASSERT(advised <= MEMORY_SIZE);
+    TEST_ASSERT(advised == 0 || advised >= 2 * 1024 * 1024);
+    TEST_ASSERT(fluid_huge_pages_advise(memory, 4096) == 0);
+    TEST_ASSERT(fluid_huge_pages_advise(NULL, MEMORY_SIZE) == 0);
+
+    FLUID_MEMSET(memory, 1, MEMORY_SIZE);
+    TEST_ASSERT(fluid_huge_pages_get_size(memory, MEMORY_SIZE) <= MEMORY_SIZE);
+    TEST_ASSERT(fluid_huge_pages_get_size(memory, 4096) <= 4096);
+    TEST_ASSERT(fluid_huge_pages_get_size(NULL, MEMORY_SIZE) == 0);
+    FLUID_FREE(memory);
+
+    render(FALSE, plain);
+    render(TRUE, huge);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(plain[i] == huge[i]);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(huge);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the loops copied by synth.sample-loop-padding hold the sample points of
+// the loop, wrapped around at both ends, and that the voices looping over them render exactly the same audio
+
+#define FRAMES 16384
+
+static float get_point(const fluid_sample_t *sample, unsigned int idx)
+{
+    return (float)(int32_t)(((uint32_t)sample->data[idx] << 8)
+                            | ((sample->data24 != NULL) ? (uint8_t)sample->data24[idx] : 0U));
+}
+
+static void verify_loop_data(fluid_sfont_t *sfont, int pad_loops)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    fluid_sample_t *sample;
+    fluid_list_t *list;
+    unsigned int loop_len, i;
+    int padded = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        if(sample->data == NULL || !pad_loops || sample->loopend < sample->loopstart + FLUID_SAMPLE_LOOP_PADDING)
+        {
+            // the ones not loaded by the dynamic sample loading have none either
+            TEST_ASSERT(sample->loop_data == NULL);
+            continue;
+        }
+
+        TEST_ASSERT(sample->loop_data != NULL);
+        loop_len = sample->loopend - sample->loopstart;
+
+        for(i = 0; i < loop_len; i++)
+        {
+            TEST_ASSERT(sample->loop_data[FLUID_SAMPLE_LOOP_PADDING + i] == get_point(sample, sample->loopstart + i));
+        }
+
+        for(i = 0; i < FLUID_SAMPLE_LOOP_PADDING; i++)
+        {
+            TEST_ASSERT(sample->loop_data[i] == get_point(sample, sample->loopend - FLUID_SAMPLE_LOOP_PADDING + i));
+            TEST_ASSERT(sample->loop_data[FLUID_SAMPLE_LOOP_PADDING + loop_len + i]
+                        == get_point(sample, sample->loopstart + i));
+        }
+
+        padded++;
+    }
+
+    TEST_ASSERT(!pad_loops || padded > 0);
+}
+
+static void render(int pad_loops, int dynamic_samples, int interp, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic_samples));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-loop-padding", pad_loops));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    // at the original pitch, a fifth and an octave higher, and a bit lower, long enough to loop
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 72, 90));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 58, 80));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    verify_loop_data(fluid_synth_get_sfont_by_id(synth, id), pad_loops);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static const int interps[] =
+    {
+        FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER
+    };
+    static float ref[FRAMES * 2], buf[FRAMES * 2];
+    unsigned int j;
+    int i;
+
+    for(i = 0; i < 2; i++)
+    {
+        for(j = 0; j < FLUID_N_ELEMENTS(interps); j++)
+        {
+            render(FALSE, i, interps[j], ref);
+            render(TRUE, i, interps[j], buf);
+            TEST_ASSERT(memcmp(ref, buf, sizeof(ref)) == 0);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
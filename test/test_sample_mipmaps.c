@@ -0,0 +1,130 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_phase.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the loops decimated by synth.sample-mipmaps keep the frequencies below the
+// Nyquist frequency of their octave, and drop the ones above, which would alias when playing the loop
+// several octaves higher
+
+#define LOOP_START 64
+#define LOOP_LEN 600
+#define LOOP_END (LOOP_START + LOOP_LEN)
+#define SAMPLE_LEN (LOOP_END + 8)
+#define NUM_BUFFERS (40 * 64 / FLUID_BUFSIZE)
+
+// periods of the frequencies in the loop, in frames, and their amplitude
+#define LOW_PERIOD 200.0
+#define HIGH_PERIOD 2.4
+#define AMPLITUDE 1000000.0
+
+static short data[SAMPLE_LEN];
+static char data24[SAMPLE_LEN];
+
+// the largest deviation of the voice played with the increment from the low frequency on its own
+static double max_error(fluid_sample_t *sample, int method, double incr)
+{
+    fluid_rvoice_dsp_t voice;
+    fluid_real_t buf[FLUID_BUFSIZE];
+    double phase, error = 0;
+    int i, n, count;
+
+    FLUID_MEMSET(&voice, 0, sizeof(voice));
+    voice.sample = sample;
+    voice.start = sample->start;
+    voice.end = sample->end;
+    voice.loopstart = sample->loopstart;
+    voice.loopend = sample->loopend;
+    voice.has_looped = 1;
+    voice.amp = 1.0;
+    voice.phase_incr = incr;
+    fluid_phase_set_int(voice.phase, LOOP_START);
+
+    for(n = 0; n < NUM_BUFFERS; n++)
+    {
+        switch(method)
+        {
+        case FLUID_INTERP_LINEAR:
+            count = fluid_rvoice_dsp_interpolate_linear(&voice, buf, TRUE);
+            break;
+
+        case FLUID_INTERP_4THORDER:
+            count = fluid_rvoice_dsp_interpolate_4th_order(&voice, buf, TRUE);
+            break;
+
+        default:
+            count = fluid_rvoice_dsp_interpolate_7th_order(&voice, buf, TRUE);
+            break;
+        }
+
+        TEST_ASSERT(count == FLUID_BUFSIZE);
+
+        for(i = 0; i < count; i++)
+        {
+            phase = (double)(n * FLUID_BUFSIZE + i) * incr;
+            phase = AMPLITUDE * sin(2.0 * M_PI * phase / LOW_PERIOD);
+            error = fmax(error, fabs(buf[i] - phase));
+        }
+    }
+
+    return error;
+}
+
+int main(void)
+{
+    static const int methods[] = { FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER };
+    fluid_sample_t sample;
+    unsigned int i;
+    int octave;
+
+#ifdef ENABLE_RUNTIME_TABLES
+    // without a synth, nobody else computes the tables
+    fluid_rvoice_dsp_config();
+#endif
+
+    // a loop holding a whole number of periods of a low and a high frequency
+    for(i = 0; i < SAMPLE_LEN; i++)
+    {
+        double x = (double)((int)i - LOOP_START);
+        int32_t point = (int32_t)(AMPLITUDE * (sin(2.0 * M_PI * x / LOW_PERIOD) + sin(2.0 * M_PI * x / HIGH_PERIOD)));
+
+        data[i] = (short)(point >> 8);
+        data24[i] = (char)(point & 0xff);
+    }
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.data24 = data24;
+    sample.start = 0;
+    sample.end = SAMPLE_LEN - 1;
+    sample.loopstart = LOOP_START;
+    sample.loopend = LOOP_END;
+
+    fluid_sample_decimate_loop(&sample);
+
+    for(octave = 0; octave < FLUID_SAMPLE_LOOP_MIPMAPS; octave++)
+    {
+        TEST_ASSERT(sample.loop_mipmaps[octave] != NULL);
+    }
+
+    for(i = 0; i < FLUID_N_ELEMENTS(methods); i++)
+    {
+        // the octave of the loop decimated by 4 passes the low frequency only
+        TEST_ASSERT(max_error(&sample, methods[i], 4.3) < 0.02 * AMPLITUDE);
+
+        // by 16, the low frequency still passes, even if the voice is a bit further up
+        TEST_ASSERT(max_error(&sample, methods[i], 20.1) < 0.05 * AMPLITUDE);
+    }
+
+    // the sample data themselves hold the high frequency, without the octaves it aliases
+    fluid_sample_unpad_loop(&sample);
+
+    for(i = 0; i < FLUID_N_ELEMENTS(methods); i++)
+    {
+        TEST_ASSERT(max_error(&sample, methods[i], 4.3) > 0.5 * AMPLITUDE);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_sffile.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that sample data mapped from the SoundFont file are the same as the
+// sample data read into memory, and that they render the same audio, also when streamed
+
+#define FRAMES 4096
+#define PRELOAD 256
+
+static void verify_stream_preload(fluid_sfont_t *sfont)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    fluid_sample_t *sample;
+    fluid_list_t *list;
+    unsigned int loop_count;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        if(sample->data == NULL)
+        {
+            // not loaded by the dynamic sample loading
+            TEST_ASSERT(sample->stream_preload == 0);
+            TEST_ASSERT(sample->stream_data == NULL);
+            continue;
+        }
+        else if(sample->end + 1 - sample->start >= PRELOAD)
+        {
+            TEST_ASSERT(sample->stream_preload == PRELOAD);
+        }
+        else
+        {
+            TEST_ASSERT(sample->stream_preload == sample->end + 1 - sample->start);
+        }
+
+        // the head and the loop are copied to memory, the voices read the mapped file for the rest only
+        TEST_ASSERT(sample->stream_data != NULL);
+        TEST_ASSERT((sample->stream_data24 == NULL) == (sample->data24 == NULL));
+        TEST_ASSERT(memcmp(sample->stream_data, sample->data + sample->start,
+                           sample->stream_preload * sizeof(short)) == 0);
+
+        loop_count = fluid_sample_get_stream_loop_count(sample);
+        TEST_ASSERT(memcmp(sample->stream_data + sample->stream_preload, sample->data + sample->loopstart,
+                           loop_count * sizeof(short)) == 0);
+        TEST_ASSERT(fluid_sample_get_stream_size(sample) >= (sample->stream_preload + loop_count) * sizeof(short));
+    }
+}
+
+// mapped sample data are not locked into memory, although synth.lock-memory is on by default
+static void verify_not_locked(fluid_sfont_t *sfont)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(sfont);
+    size_t size;
+    int shared, locked;
+
+    TEST_ASSERT(defsfont->mlock);
+    TEST_ASSERT(fluid_samplecache_is_mapped(defsfont->sampledata));
+    TEST_SUCCESS(fluid_samplecache_get_memory(defsfont->sampledata, &size, &shared, &locked));
+    TEST_ASSERT(!locked);
+}
+
+static void render(const char *setting, int dynamic_samples, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic_samples));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming-preload", PRELOAD));
+
+    if(setting != NULL)
+    {
+        TEST_SUCCESS(fluid_settings_setint(settings, setting, 1));
+    }
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+#if defined(HAVE_SYS_MMAN_H) && !defined(__OS2__)
+    if(setting != NULL && FLUID_STRCMP(setting, "synth.sample-streaming") == 0 && !FLUID_IS_BIG_ENDIAN)
+    {
+        TEST_ASSERT(synth->sample_streamer != NULL);
+        verify_stream_preload(fluid_synth_get_sfont_by_id(synth, id));
+    }
+
+    if(setting != NULL && FLUID_STRCMP(setting, "synth.sample-mmap") == 0 && !FLUID_IS_BIG_ENDIAN && !dynamic_samples)
+    {
+        verify_not_locked(fluid_synth_get_sfont_by_id(synth, id));
+    }
+#endif
+
+    // deleting the synth releases the sample data from the sample cache
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float ref[FRAMES * 2], buf[FRAMES * 2];
+    fluid_settings_t *settings;
+    fluid_sfloader_t *loader;
+    fluid_file_mapping_t *mapping, *mapping24;
+    short *data, *mapped_data;
+    char *data24, *mapped_data24;
+    SFData *sf;
+    int num_samples, i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    loader = new_fluid_defsfloader(settings);
+    TEST_ASSERT(loader != NULL);
+
+    sf = fluid_sffile_open(TEST_SOUNDFONT, &loader->file_callbacks);
+    TEST_ASSERT(sf != NULL);
+
+    num_samples = sf->samplesize / sizeof(short);
+    TEST_ASSERT(fluid_sffile_read_sample_data(sf, 0, num_samples - 1, 0, &data, &data24) == num_samples);
+
+    if(fluid_sffile_map_sample_data(sf, 0, num_samples - 1, 0, &mapped_data, &mapped_data24, &mapping, &mapping24) != -1)
+    {
+        TEST_ASSERT(mapping != NULL);
+        TEST_ASSERT((mapped_data24 == NULL) == (data24 == NULL));
+        TEST_ASSERT((mapping24 == NULL) == (data24 == NULL));
+
+        for(i = 0; i < num_samples; i++)
+        {
+            TEST_ASSERT(mapped_data[i] == data[i]);
+            TEST_ASSERT(data24 == NULL || mapped_data24[i] == data24[i]);
+        }
+
+        delete_fluid_file_mapping(mapping);
+        delete_fluid_file_mapping(mapping24);
+    }
+    else
+    {
+        // mapping is optional, but it must not leave anything behind when it isn't possible
+#if defined(HAVE_SYS_MMAN_H) && !defined(__OS2__)
+        TEST_ASSERT(FLUID_IS_BIG_ENDIAN);
+#endif
+        TEST_ASSERT(mapping == NULL);
+        TEST_ASSERT(mapping24 == NULL);
+    }
+
+    // compressed samples cannot be mapped
+    TEST_ASSERT(fluid_sffile_map_sample_data(sf, 0, num_samples - 1, FLUID_SAMPLETYPE_OGG_VORBIS,
+                &mapped_data, &mapped_data24, &mapping, &mapping24) == -1);
+    TEST_ASSERT(mapping == NULL);
+
+    // neither can sample data beyond the sample chunk
+    TEST_ASSERT(fluid_sffile_map_sample_data(sf, 0, num_samples + 1, 0,
+                &mapped_data, &mapped_data24, &mapping, &mapping24) == -1);
+    TEST_ASSERT(mapping == NULL);
+
+    FLUID_FREE(data);
+    FLUID_FREE(data24);
+    fluid_sffile_close(sf);
+    delete_fluid_sfloader(loader);
+    delete_fluid_settings(settings);
+
+    for(i = 0; i < 2; i++)
+    {
+        render(NULL, i, ref);
+        render("synth.sample-mmap", i, buf);
+        TEST_ASSERT(memcmp(ref, buf, sizeof(ref)) == 0);
+        render("synth.sample-streaming", i, buf);
+        TEST_ASSERT(memcmp(ref, buf, sizeof(ref)) == 0);
+    }
+
+    return EXIT_SUCCESS;
+}
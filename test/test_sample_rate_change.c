@@ -4,6 +4,7 @@
 #include "synth/fluid_synth.h"
 #include "synth/fluid_voice.h"
 #include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_rvoice_mixer.h"
 #include "utils/fluid_sys.h"
 
 static void verify_sample_rate(fluid_synth_t *synth, int expected_srate)
@@ -22,6 +23,17 @@ static void verify_sample_rate(fluid_synth_t *synth, int expected_srate)
     // TODO check fx, rvoice_mixer et. al.?
 }
 
+// the effects units of each change are held by the synth, until it is swapped in and the replaced units can be freed
+static void verify_replaced_rates(fluid_synth_t *synth, int count, int swapped)
+{
+    TEST_ASSERT(fluid_list_size(synth->replaced_rates) == count);
+
+    if(count > 0)
+    {
+        TEST_ASSERT(fluid_rvoice_mixer_rate_is_swapped(fluid_list_get(synth->replaced_rates)) == swapped);
+    }
+}
+
 // this test should make sure that sample rate changed are handled correctly
 int main(void)
 {
@@ -58,6 +70,16 @@ int main(void)
     fluid_synth_process_event_queue(synth);
 
     verify_sample_rate(synth, sample_rate);
+    verify_replaced_rates(synth, 1, TRUE);
+
+    // the same rate again changes nothing, but frees the units replaced before
+    fluid_synth_set_sample_rate(synth, sample_rate);
+    verify_replaced_rates(synth, 0, FALSE);
+
+    // a change not swapped in yet is freed by delete_fluid_synth()
+    sample_rate = 48000;
+    fluid_synth_set_sample_rate(synth, sample_rate);
+    verify_replaced_rates(synth, 1, FALSE);
 
     delete_fluid_synth(synth);
     delete_fluid_settings(settings);
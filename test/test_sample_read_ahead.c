@@ -0,0 +1,161 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_sffile.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the sample data read ahead in batches are the same as the sample data read one by
+// one, also when they are taken in another order or not at all, and that dynamic sample loading renders the
+// same audio reading the samples of the presets all at once
+
+#define FRAMES 4096
+#define RANGES 8
+#define DEPTH 6
+#define RANGE_LENGTH 1000
+
+// wait for the loader thread to be done with the samples queued
+static void wait_loaded(fluid_synth_t *synth, int id)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    fluid_list_t *list;
+    int loading = TRUE, i;
+
+    for(i = 0; i < 1000 && loading; i++)
+    {
+        loading = FALSE;
+
+        for(list = defsfont->sample; list; list = fluid_list_next(list))
+        {
+            loading |= fluid_atomic_int_get(&((fluid_sample_t *)fluid_list_get(list))->loading);
+        }
+
+        if(loading)
+        {
+            fluid_msleep(10);
+        }
+    }
+
+    TEST_ASSERT(!loading);
+}
+
+static void render(int reads, int async, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int chan, id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading-async", async));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading-reads", reads));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, 2 * chan));
+    }
+
+    if(async)
+    {
+        wait_loaded(synth, id);
+    }
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float ref[FRAMES * 2], buf[FRAMES * 2];
+    fluid_settings_t *settings;
+    fluid_sfloader_t *loader;
+    short *all_data, *data;
+    char *all_data24, *data24;
+    int read_ahead[RANGES];
+    SFData *sf;
+    int num_samples, i, k, start;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    loader = new_fluid_defsfloader(settings);
+    TEST_ASSERT(loader != NULL);
+
+    sf = fluid_sffile_open(TEST_SOUNDFONT, &loader->file_callbacks);
+    TEST_ASSERT(sf != NULL);
+
+    num_samples = sf->samplesize / sizeof(short);
+    TEST_ASSERT(num_samples > RANGES * RANGE_LENGTH);
+    TEST_ASSERT(fluid_sffile_read_sample_data(sf, 0, num_samples - 1, 0, &all_data, &all_data24) == num_samples);
+
+    // the reads beyond the depth aren't read ahead, the ones submitted twice only once
+    for(i = 0; i < RANGES; i++)
+    {
+        start = i * RANGE_LENGTH;
+        read_ahead[i] = fluid_sffile_read_ahead(sf, start, start + RANGE_LENGTH - 1, 0, DEPTH);
+        TEST_ASSERT(i >= DEPTH || read_ahead[i] == read_ahead[0]);
+        TEST_ASSERT(fluid_sffile_read_ahead(sf, start, start + RANGE_LENGTH - 1, 0, DEPTH) == read_ahead[i]);
+
+        if(i == DEPTH - 1)
+        {
+            fluid_sffile_flush_read_ahead(sf);
+        }
+    }
+
+    // compressed samples and sample data beyond the sample chunk can't be read ahead
+    TEST_ASSERT(fluid_sffile_read_ahead(sf, 0, RANGE_LENGTH - 1, FLUID_SAMPLETYPE_OGG_VORBIS, DEPTH) == FLUID_FAILED);
+    TEST_ASSERT(fluid_sffile_read_ahead(sf, 0, num_samples + 1, 0, DEPTH) == FLUID_FAILED);
+
+    // the first range is left for fluid_sffile_close()
+    for(i = RANGES - 1; i > 0; i--)
+    {
+        start = i * RANGE_LENGTH;
+        TEST_ASSERT(fluid_sffile_read_sample_data(sf, start, start + RANGE_LENGTH - 1, 0, &data, &data24) == RANGE_LENGTH);
+        TEST_ASSERT((data24 == NULL) == (all_data24 == NULL));
+
+        for(k = 0; k < RANGE_LENGTH; k++)
+        {
+            TEST_ASSERT(data[k] == all_data[start + k]);
+            TEST_ASSERT(data24 == NULL || data24[k] == all_data24[start + k]);
+        }
+
+        FLUID_FREE(data);
+        FLUID_FREE(data24);
+    }
+
+    TEST_ASSERT(read_ahead[DEPTH] == FLUID_FAILED);
+    TEST_ASSERT(fluid_list_size(sf->read_ahead) == (read_ahead[0] == FLUID_OK ? 1 : 0));
+
+    FLUID_FREE(all_data);
+    FLUID_FREE(all_data24);
+    fluid_sffile_close(sf);
+    delete_fluid_sfloader(loader);
+    delete_fluid_settings(settings);
+
+    render(1, FALSE, ref);
+    render(64, FALSE, buf);
+
+    for(i = 0; i < FRAMES * 2; i++)
+    {
+        TEST_ASSERT(buf[i] == ref[i]);
+    }
+
+    render(64, TRUE, buf);
+
+    for(i = 0; i < FRAMES * 2; i++)
+    {
+        TEST_ASSERT(buf[i] == ref[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_hash.h"
+#include "utils/fluid_sys.h"
+
+#if defined(HAVE_SHM_OPEN) && defined(__linux__)
+#include <dirent.h>
+#include <sys/wait.h>
+#define TEST_SHM_PROCESSES 1
+#endif
+
+// this test makes sure that the sample data stored into shared memory by the first load of a
+// SoundFont are mapped from there by the following ones, also by another process, and that
+// they render the same audio as sample data read into memory
+
+#define FRAMES 4096
+
+static int shared_samples_mapped(fluid_synth_t *synth, int id)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        // not loaded by the dynamic sample loading, or a ROM sample
+        if(sample->data == NULL)
+        {
+            continue;
+        }
+
+        TEST_ASSERT(fluid_samplecache_is_mapped(sample->data));
+        count++;
+    }
+
+    return count;
+}
+
+static void render(int shm, int dynamic_samples, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic_samples));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-shm", shm));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+#if defined(HAVE_SHM_OPEN) && defined(HAVE_SYS_MMAN_H) && !defined(__OS2__)
+    if(shm)
+    {
+        TEST_ASSERT(shared_samples_mapped(synth, id) > 0);
+    }
+#endif
+
+    // deleting the synth releases the sample data from the sample cache, which doesn't keep them
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+static void compare(const float *ref, const float *buf)
+{
+    int i;
+
+    for(i = 0; i < FRAMES * 2; i++)
+    {
+        TEST_ASSERT(ref[i] == buf[i]);
+    }
+}
+
+#ifdef TEST_SHM_PROCESSES
+// removes the shared memory objects of the test SoundFont, returns their number
+static int unlink_shared_samples(void)
+{
+    char prefix[32], name[300];
+    struct dirent *file;
+    DIR *dir = opendir("/dev/shm");
+    int count = 0;
+
+    if(dir == NULL)
+    {
+        return 0;
+    }
+
+    FLUID_SNPRINTF(prefix, sizeof(prefix), "fluidsynth-%08x-", fluid_str_hash(TEST_SOUNDFONT));
+
+    while((file = readdir(dir)) != NULL)
+    {
+        if(FLUID_STRNCMP(file->d_name, prefix, FLUID_STRLEN(prefix)) == 0)
+        {
+            FLUID_SNPRINTF(name, sizeof(name), "/%s", file->d_name);
+            TEST_SUCCESS(fluid_shm_unlink(name));
+            count++;
+        }
+    }
+
+    closedir(dir);
+    return count;
+}
+#endif
+
+int main(void)
+{
+    static float ref[FRAMES * 2], buf[FRAMES * 2];
+    int dynamic_samples;
+
+#ifdef TEST_SHM_PROCESSES
+    // start without the objects of a previous run
+    unlink_shared_samples();
+#endif
+
+    render(FALSE, FALSE, ref);
+
+    for(dynamic_samples = 0; dynamic_samples <= 1; dynamic_samples++)
+    {
+        // the first load stores the sample data, the next one maps them
+        render(TRUE, dynamic_samples, buf);
+        compare(ref, buf);
+        render(TRUE, dynamic_samples, buf);
+        compare(ref, buf);
+
+#ifdef TEST_SHM_PROCESSES
+        {
+            int status;
+            pid_t pid = fork();
+
+            TEST_ASSERT(pid != -1);
+
+            if(pid == 0)
+            {
+                render(TRUE, dynamic_samples, buf);
+                compare(ref, buf);
+                _exit(EXIT_SUCCESS);
+            }
+
+            TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+            TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+        }
+#endif
+    }
+
+#ifdef TEST_SHM_PROCESSES
+    TEST_ASSERT(unlink_shared_samples() > 0);
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_samplestream.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the ring buffer of a streamed sample holds the frames of the sample
+// following its head, that it never hands out frames it doesn't hold, and that the ring buffers
+// of the pool are given back along with the samples
+
+#define FRAMES 100000
+#define PRELOAD 4096
+
+// wait for the streamer thread to stream the frames, and check them against the sample
+static void verify_window(fluid_sample_stream_t *stream, const fluid_sample_t *sample,
+                          unsigned int first, unsigned int last)
+{
+    unsigned int base, count, i;
+    const short *data;
+    const char *data24;
+    int ok = FALSE, j;
+
+    for(j = 0; j < 1000 && !ok; j++)
+    {
+        ok = fluid_sample_stream_get_window(stream, first, last, &base, &count, &data, &data24);
+
+        if(!ok)
+        {
+            fluid_msleep(10);
+        }
+    }
+
+    TEST_ASSERT(ok);
+    TEST_ASSERT(base == first);
+    TEST_ASSERT(count > last - first);
+    TEST_ASSERT(data24 != NULL);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(data[i] == sample->data[base + i]);
+        TEST_ASSERT(data24[i] == sample->data24[base + i]);
+    }
+}
+
+int main(void)
+{
+    static short data[FRAMES];
+    static char data24[FRAMES];
+    fluid_sample_streamer_t *streamer;
+    fluid_sample_stream_t *stream;
+    fluid_sample_t *sample;
+    unsigned int base, count, first;
+    const short *window;
+    const char *window24;
+    int i;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        data[i] = (short)(i * 7);
+        data24[i] = (char)i;
+    }
+
+    sample = new_fluid_sample();
+    TEST_ASSERT(sample != NULL);
+    sample->data = data;
+    sample->data24 = data24;
+    sample->start = 0;
+    sample->end = FRAMES - 1;
+    TEST_SUCCESS(fluid_sample_copy_stream_data(sample, PRELOAD));
+    TEST_ASSERT(memcmp(sample->stream_data, data, PRELOAD * sizeof(short)) == 0);
+    TEST_ASSERT(memcmp(sample->stream_data24, data24, PRELOAD) == 0);
+
+    streamer = new_fluid_sample_streamer(1);
+    TEST_ASSERT(streamer != NULL);
+
+    stream = fluid_sample_streamer_start(streamer, sample);
+    TEST_ASSERT(stream != NULL);
+    TEST_ASSERT(fluid_atomic_int_get(&sample->refcount) == 1);
+
+    // the pool is bounded, further voices read the sample data
+    TEST_ASSERT(fluid_sample_streamer_start(streamer, sample) == NULL);
+
+    // the ring buffer starts within the head
+    first = PRELOAD - FLUID_SAMPLE_STREAM_GUARD;
+    TEST_ASSERT(!fluid_sample_stream_get_window(stream, first - 1, first + 64, &base, &count, &window, &window24));
+    verify_window(stream, sample, first, first + 64);
+
+    // no more frames are read in one piece than the guard repeats
+    TEST_ASSERT(!fluid_sample_stream_get_window(stream, first, first + FLUID_SAMPLE_STREAM_GUARD,
+                &base, &count, &window, &window24));
+
+    // through the whole sample, wrapping around the ring several times
+    for(; first + 64 < FRAMES; first += 1000)
+    {
+        verify_window(stream, sample, first, first + 64);
+    }
+
+    verify_window(stream, sample, FRAMES - 10, FRAMES - 1);
+
+    // the frames played may have been streamed over
+    TEST_ASSERT(!fluid_sample_stream_get_window(stream, FRAMES - 2000, FRAMES - 1990, &base, &count, &window, &window24));
+
+    // the ring buffer is given back once the streamer thread is done with it
+    fluid_sample_stream_release(stream);
+
+    for(i = 0; i < 1000 && fluid_atomic_int_get(&sample->refcount) != 0; i++)
+    {
+        fluid_msleep(10);
+        fluid_sample_streamer_collect(streamer);
+    }
+
+    TEST_ASSERT(fluid_atomic_int_get(&sample->refcount) == 0);
+
+    // and handed out again, deleting the streamer lets go of the sample
+    stream = fluid_sample_streamer_start(streamer, sample);
+    TEST_ASSERT(stream != NULL);
+    TEST_ASSERT(fluid_atomic_int_get(&sample->refcount) == 1);
+    delete_fluid_sample_streamer(streamer);
+    TEST_ASSERT(fluid_atomic_int_get(&sample->refcount) == 0);
+
+    // samples not streamed get no ring buffer
+    fluid_sample_free_stream_data(sample);
+    streamer = new_fluid_sample_streamer(1);
+    TEST_ASSERT(streamer != NULL);
+    TEST_ASSERT(fluid_sample_streamer_start(streamer, sample) == NULL);
+    delete_fluid_sample_streamer(streamer);
+
+    delete_fluid_sample(sample);
+
+    return EXIT_SUCCESS;
+}
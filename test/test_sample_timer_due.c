@@ -0,0 +1,102 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that the callback of a sample timer is only called by the blocks it is due,
+// by the next one by default, unless it is woken up meanwhile
+
+#define BLOCKS 64
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    fluid_sample_timer_t *timer;
+    unsigned int sleep;
+    int calls[BLOCKS];
+} timer_test_t;
+
+static int block;
+
+static int callback(void *data, unsigned int msec)
+{
+    timer_test_t *test = data;
+    unsigned int ticks = fluid_sample_timer_get_ticks(test->synth, test->timer);
+
+    test->calls[block]++;
+
+    if(test->sleep > 0)
+    {
+        fluid_sample_timer_set_due(test->synth, test->timer, ticks + test->sleep);
+    }
+
+    return 1;
+}
+
+static void render(fluid_synth_t *synth, int blocks)
+{
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int i;
+
+    for(i = 0; i < blocks; i++, block++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    }
+}
+
+int main(void)
+{
+    static timer_test_t every_block, sleeping;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    every_block.synth = sleeping.synth = synth;
+    every_block.timer = new_fluid_sample_timer(synth, callback, &every_block);
+    TEST_ASSERT(every_block.timer != NULL);
+
+    // called by the block containing the tick 4.5 blocks ahead, i.e. every fourth block
+    sleeping.sleep = 4 * FLUID_BUFSIZE + FLUID_BUFSIZE / 2;
+    sleeping.timer = new_fluid_sample_timer(synth, callback, &sleeping);
+    TEST_ASSERT(sleeping.timer != NULL);
+
+    render(synth, 14);
+
+    for(i = 0; i < 14; i++)
+    {
+        TEST_ASSERT(every_block.calls[i] == 1);
+        TEST_ASSERT(sleeping.calls[i] == (i % 4 == 0));
+    }
+
+    // woken up by the next block
+    fluid_sample_timer_wakeup(synth, sleeping.timer);
+    render(synth, 1);
+    TEST_ASSERT(sleeping.calls[14] == 1);
+
+    // none of the timers due, none called
+    delete_fluid_sample_timer(synth, every_block.timer);
+    sleeping.sleep = 100 * FLUID_BUFSIZE;
+    render(synth, 4);
+    TEST_ASSERT(sleeping.calls[15] + sleeping.calls[16] + sleeping.calls[17] == 0);
+    TEST_ASSERT(sleeping.calls[18] == 1);
+    render(synth, 16);
+
+    for(i = 19; i < 35; i++)
+    {
+        TEST_ASSERT(sleeping.calls[i] == 0);
+    }
+
+    // restarted right away
+    fluid_sample_timer_reset(synth, sleeping.timer);
+    render(synth, 1);
+    TEST_ASSERT(sleeping.calls[35] == 1);
+
+    delete_fluid_sample_timer(synth, sleeping.timer);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
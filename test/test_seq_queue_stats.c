@@ -0,0 +1,94 @@
+
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "fluid_event.h"
+
+// this test makes sure that events scheduled far in the future are sent in order,
+// that removed events are never sent and that the event pool grows as needed
+
+#define NUM_EVENTS 5000
+
+static unsigned int prev_time, received;
+void callback_far_future(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    if(fluid_event_get_type(event) == FLUID_SEQ_UNREGISTERING)
+    {
+        return;
+    }
+
+    // events of the removed client must not arrive
+    TEST_ASSERT(data == NULL);
+    TEST_ASSERT(fluid_event_get_type(event) == FLUID_SEQ_CONTROLCHANGE);
+    TEST_ASSERT(prev_time <= fluid_event_get_time(event));
+    TEST_ASSERT(fluid_event_get_time(event) <= time);
+    prev_time = fluid_event_get_time(event);
+    received++;
+}
+
+int main(void)
+{
+    int i, seqid, seqid_removed, capacity, queued, max_queued;
+    unsigned int t, rand = 12345, last = 0;
+    fluid_event_t *evt;
+    fluid_sequencer_t *seq = new_fluid_sequencer2(0 /*i.e. use sample timer*/);
+    TEST_ASSERT(seq != NULL);
+    evt = new_fluid_event();
+    TEST_ASSERT(evt != NULL);
+
+    fluid_sequencer_get_queue_stats(seq, &capacity, &queued, &max_queued);
+    TEST_ASSERT(capacity > 0);
+    TEST_ASSERT(queued == 0);
+    TEST_ASSERT(max_queued == 0);
+
+    seqid = fluid_sequencer_register_client(seq, "far future test", callback_far_future, NULL);
+    TEST_SUCCESS(seqid);
+    seqid_removed = fluid_sequencer_register_client(seq, "removed test", callback_far_future, &seqid);
+    TEST_SUCCESS(seqid_removed);
+
+    fluid_event_set_source(evt, -1);
+    fluid_event_control_change(evt, 0, 1, 127);
+
+    // more events than allocated in advance, spread over the whole range of ticks
+    for(i = 0; i < NUM_EVENTS; i++)
+    {
+        rand = rand * 1103515245 + 12345;
+        t = 1 + (rand >> 2);
+        last = (t > last) ? t : last;
+
+        fluid_event_set_dest(evt, (i % 2) ? seqid : seqid_removed);
+        TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, t, 1));
+    }
+
+    fluid_sequencer_get_queue_stats(seq, &capacity, &queued, &max_queued);
+    TEST_ASSERT(queued == NUM_EVENTS);
+    TEST_ASSERT(max_queued == NUM_EVENTS);
+    TEST_ASSERT(capacity >= max_queued);
+
+    fluid_sequencer_remove_events(seq, -1, seqid_removed, -1);
+
+    // the statistics may be queried with NULL pointers as well
+    fluid_sequencer_get_queue_stats(seq, NULL, NULL, NULL);
+
+    // advance in steps, so that events are sent from each bucket of the queue
+    for(t = 1; t < last; t = (t < last / 2) ? t * 2 : last)
+    {
+        fluid_sequencer_process(seq, t);
+        TEST_ASSERT(prev_time <= t);
+    }
+
+    fluid_sequencer_process(seq, last);
+    TEST_ASSERT(received == NUM_EVENTS / 2);
+    TEST_ASSERT(prev_time <= last);
+
+    fluid_sequencer_get_queue_stats(seq, NULL, &queued, &max_queued);
+    TEST_ASSERT(queued == 0);
+    TEST_ASSERT(max_queued >= NUM_EVENTS);
+
+    fluid_sequencer_unregister_client(seq, seqid);
+    fluid_sequencer_unregister_client(seq, seqid_removed);
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+
+    return EXIT_SUCCESS;
+}
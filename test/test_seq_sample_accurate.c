@@ -0,0 +1,208 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that notes scheduled by the sequencer are heard from their exact frame,
+// even if it lies in the middle of a block, and so are MIDI events dispatched by a driver between blocks
+// and the notes of a MIDI file played by the player
+
+#define FRAMES (64 * 64)
+#define NOTE_MSEC 11
+// in msec at the sample rate of 8000 Hz used below, a block and a bit, so that the note off
+// falls in a later block than the note on whatever the block size
+#define NOTE_DURATION (FLUID_BUFSIZE * 9 / 64)
+
+// 480 ticks per beat at the default tempo of 500000 usec per beat
+#define NOTE_TICKS 10
+#define TICK_MSEC (500.0 / 480)
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 12,
+    NOTE_TICKS, 0x90, 0x3c, 0x7f, // note on
+    0x7f, 0x80, 0x3c, 0x00,       // note off
+    0x00, 0xff, 0x2f, 0x00,       // end of track
+};
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    return synth;
+}
+
+// whether the note played by the synth hasn't received its note off yet
+static int is_note_on(fluid_synth_t *synth)
+{
+    fluid_voice_t *voices[4];
+    int i;
+
+    fluid_synth_get_voicelist(synth, voices, 4, -1);
+
+    for(i = 0; i < 4 && voices[i] != NULL; i++)
+    {
+        if(fluid_voice_is_on(voices[i]))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+// renders the output of the synth and returns the first frame that isn't silent
+static int render_first_sound(fluid_synth_t *synth)
+{
+    static float left[FRAMES], right[FRAMES];
+    int i, len, n = 0;
+
+    // render in chunks of different lengths, the timing must not depend on them
+    for(i = 0; i < FRAMES; i += len)
+    {
+        len = 64 * (1 + n++ % 3);
+        len = (FRAMES - i < len) ? FRAMES - i : len;
+        TEST_SUCCESS(fluid_synth_write_float(synth, len, left, i, 1, right, i, 1));
+    }
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        if(left[i] != 0 || right[i] != 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_sequencer_t *seq;
+    fluid_event_t *evt;
+    fluid_seq_id_t seqid;
+    double sample_rate;
+    fluid_midi_event_t *midi_evt;
+    fluid_player_t *player;
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int ref, first, note_frame, off_frame, late_frame, i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    // the envelopes advance block by block, at this rate the shortest volume envelope delay
+    // of 1 msec is below the block size, so that the attack starts in the block the note starts in
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", 8000));
+    TEST_SUCCESS(fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate));
+
+    // the reference: a note played from the very first frame
+    synth = create_synth(settings);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    ref = render_first_sound(synth);
+    TEST_ASSERT(ref >= 0 && ref < FLUID_BUFSIZE);
+    delete_fluid_synth(synth);
+
+    // the same note scheduled by the sequencer
+    note_frame = (int)(NOTE_MSEC * sample_rate / 1000);
+    TEST_ASSERT(note_frame % FLUID_BUFSIZE != 0);
+
+    synth = create_synth(settings);
+    seq = new_fluid_sequencer2(0);
+    TEST_ASSERT(seq != NULL);
+    TEST_SUCCESS(seqid = fluid_sequencer_register_fluidsynth(seq, synth));
+
+    evt = new_fluid_event();
+    TEST_ASSERT(evt != NULL);
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, seqid);
+    fluid_event_noteon(evt, 0, 60, 127);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, NOTE_MSEC, 1));
+
+    first = render_first_sound(synth);
+    TEST_ASSERT(first == note_frame + ref);
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+
+    // the same note with a duration, which ends the duration after it started and not after
+    // the end of the block it started in, which the sequencer had been processed up to
+    off_frame = (int)((NOTE_MSEC + NOTE_DURATION) * sample_rate / 1000);
+    late_frame = (note_frame / FLUID_BUFSIZE + 1) * FLUID_BUFSIZE + (int)(NOTE_DURATION * sample_rate / 1000);
+    TEST_ASSERT(off_frame / FLUID_BUFSIZE < late_frame / FLUID_BUFSIZE);
+
+    synth = create_synth(settings);
+    seq = new_fluid_sequencer2(0);
+    TEST_ASSERT(seq != NULL);
+    TEST_SUCCESS(seqid = fluid_sequencer_register_fluidsynth(seq, synth));
+
+    evt = new_fluid_event();
+    TEST_ASSERT(evt != NULL);
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, seqid);
+    fluid_event_note(evt, 0, 60, 127, NOTE_DURATION);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, NOTE_MSEC, 1));
+
+    for(i = 0; i < off_frame / FLUID_BUFSIZE; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        TEST_ASSERT(is_note_on(synth) == (i >= note_frame / FLUID_BUFSIZE));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    TEST_ASSERT(!is_note_on(synth));
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+
+    // the same note sent as MIDI event, after the frames of the block rendered already
+    synth = create_synth(settings);
+    TEST_ASSERT(fluid_synth_get_buffered_frames(synth) == 0);
+    TEST_SUCCESS(fluid_synth_write_float(synth, 10, left, 0, 1, right, 0, 1));
+    TEST_ASSERT(fluid_synth_get_buffered_frames(synth) == FLUID_BUFSIZE - 10);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE - 10, left, 0, 1, right, 0, 1));
+    TEST_ASSERT(fluid_synth_get_buffered_frames(synth) == 0);
+
+    midi_evt = new_fluid_midi_event();
+    TEST_ASSERT(midi_evt != NULL);
+    fluid_midi_event_set_type(midi_evt, NOTE_ON);
+    fluid_midi_event_set_channel(midi_evt, 0);
+    fluid_midi_event_set_key(midi_evt, 60);
+    fluid_midi_event_set_velocity(midi_evt, 127);
+    TEST_ASSERT(fluid_synth_handle_midi_event_offset(synth, fluid_synth_handle_midi_event, synth,
+                midi_evt, FLUID_BUFSIZE) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_handle_midi_event_offset(synth, fluid_synth_handle_midi_event, synth,
+                 midi_evt, note_frame % FLUID_BUFSIZE));
+
+    first = render_first_sound(synth);
+    TEST_ASSERT(first == note_frame % FLUID_BUFSIZE + ref);
+
+    delete_fluid_midi_event(midi_evt);
+    delete_fluid_synth(synth);
+
+    // the same note played from a MIDI file, timed by its ticks rather than by the milliseconds of the sample timer
+    note_frame = (int)(NOTE_TICKS * TICK_MSEC * sample_rate / 1000);
+    TEST_ASSERT(note_frame % FLUID_BUFSIZE != 0);
+
+    synth = create_synth(settings);
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+
+    first = render_first_sound(synth);
+    TEST_ASSERT(first == note_frame + ref);
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
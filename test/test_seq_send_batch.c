@@ -0,0 +1,118 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "fluid_event.h"
+
+// this test makes sure that a batch of events is sent the same as sending the events one by one,
+// that the events passed can be reused for the next batch, and that the event pool grows at once
+
+#define BATCH_SIZE 1000
+#define NUM_BATCHES 4
+
+static unsigned int prev_time, received;
+static int prev_value[2];
+
+void callback_batch(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    int value;
+
+    if(fluid_event_get_type(event) == FLUID_SEQ_UNREGISTERING)
+    {
+        return;
+    }
+
+    TEST_ASSERT(fluid_event_get_type(event) == FLUID_SEQ_CONTROLCHANGE);
+    TEST_ASSERT(prev_time <= fluid_event_get_time(event));
+    TEST_ASSERT(fluid_event_get_time(event) <= time);
+
+    // the events at the same time arrive in the order they have been sent, for both channels
+    value = fluid_event_get_value(event);
+
+    if(fluid_event_get_time(event) == prev_time)
+    {
+        TEST_ASSERT(value > prev_value[fluid_event_get_channel(event)]);
+    }
+    else
+    {
+        prev_value[0] = prev_value[1] = -1;
+    }
+
+    prev_value[fluid_event_get_channel(event)] = value;
+    prev_time = fluid_event_get_time(event);
+    received++;
+}
+
+int main(void)
+{
+    static fluid_event_t *events[BATCH_SIZE];
+    static unsigned int times[BATCH_SIZE];
+    int i, n, seqid, capacity, queued, max_queued;
+    unsigned int last = 0;
+    fluid_event_t *evt;
+    fluid_sequencer_t *seq = new_fluid_sequencer2(0 /*i.e. use sample timer*/);
+    TEST_ASSERT(seq != NULL);
+
+    seqid = fluid_sequencer_register_client(seq, "batch test", callback_batch, NULL);
+    TEST_SUCCESS(seqid);
+
+    for(i = 0; i < BATCH_SIZE; i++)
+    {
+        events[i] = new_fluid_event();
+        TEST_ASSERT(events[i] != NULL);
+        fluid_event_set_source(events[i], -1);
+        fluid_event_set_dest(events[i], seqid);
+    }
+
+    // an empty batch schedules nothing
+    TEST_SUCCESS(fluid_sequencer_send_batch(seq, events, times, 0, 1));
+    TEST_ASSERT(fluid_sequencer_send_batch(seq, NULL, times, 1, 1) == FLUID_FAILED);
+
+    evt = new_fluid_event();
+    TEST_ASSERT(evt != NULL);
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, seqid);
+
+    // the same events for each batch, at different times, some of them at the same times,
+    // interleaved with events sent one by one on the other channel
+    for(n = 0; n < NUM_BATCHES; n++)
+    {
+        for(i = 0; i < BATCH_SIZE; i++)
+        {
+            fluid_event_control_change(events[i], 0, 1, n * BATCH_SIZE + i);
+            times[i] = 10 + BATCH_SIZE - i / 3 + (n * 7919) % 101;
+            last = (times[i] > last) ? times[i] : last;
+        }
+
+        TEST_SUCCESS(fluid_sequencer_send_batch(seq, events, times, BATCH_SIZE, n % 2));
+
+        fluid_event_control_change(evt, 1, 1, n);
+        TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, last, 1));
+
+        // the time stamps of the events passed are left alone
+        TEST_ASSERT(fluid_event_get_time(events[0]) == 0);
+    }
+
+    fluid_sequencer_get_queue_stats(seq, &capacity, &queued, &max_queued);
+    TEST_ASSERT(queued == NUM_BATCHES * (BATCH_SIZE + 1));
+    TEST_ASSERT(capacity >= max_queued);
+
+    for(i = 0; i <= (int)last; i += 100)
+    {
+        fluid_sequencer_process(seq, i);
+    }
+
+    fluid_sequencer_process(seq, last);
+    TEST_ASSERT(received == NUM_BATCHES * (BATCH_SIZE + 1));
+
+    fluid_sequencer_get_queue_stats(seq, NULL, &queued, NULL);
+    TEST_ASSERT(queued == 0);
+
+    for(i = 0; i < BATCH_SIZE; i++)
+    {
+        delete_fluid_event(events[i]);
+    }
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that the events sent to the synth by the sample timer of the sequencer take effect
+// like the ones sent right away, while the API of the synth is entered only for the duration of a block
+
+#define FRAMES (16 * FLUID_BUFSIZE)
+
+static void render(fluid_synth_t *synth, int frames)
+{
+    static float left[FRAMES], right[FRAMES];
+    int i;
+
+    for(i = 0; i < frames; i += FLUID_BUFSIZE)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+
+        // left as it was by the timer callback
+        TEST_ASSERT(synth->public_api_count == 0);
+    }
+}
+
+static void test_events(int lock_free)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sequencer_t *seq;
+    fluid_event_t *evt;
+    fluid_seq_id_t seqid;
+    int value, pitch;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-free-api", lock_free));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    seq = new_fluid_sequencer2(0 /*i.e. use sample timer*/);
+    TEST_ASSERT(seq != NULL);
+    seqid = fluid_sequencer_register_fluidsynth(seq, synth);
+    TEST_SUCCESS(seqid);
+
+    evt = new_fluid_event();
+    TEST_ASSERT(evt != NULL);
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, seqid);
+
+    fluid_event_control_change(evt, 1, 7, 33);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 1, 0));
+    fluid_event_pan(evt, 1, 99);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 1, 0));
+    fluid_event_pitch_bend(evt, 1, 1000);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 2, 0));
+    fluid_event_program_change(evt, 1, 3);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 2, 0));
+    fluid_event_noteon(evt, 1, 60, 100);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 3, 0));
+
+    // the events of channels out of range are dropped
+    fluid_event_noteon(evt, 99, 60, 100);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 3, 0));
+
+    render(synth, FRAMES);
+
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 1, 7, &value));
+    TEST_ASSERT(value == 33);
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 1, 10, &value));
+    TEST_ASSERT(value == 99);
+    TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, 1, &pitch));
+    TEST_ASSERT(pitch == 1000);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    // the notes ended by the sequencer
+    fluid_event_note(evt, 2, 64, 100, 5);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 0, 0));
+    fluid_event_noteoff(evt, 1, 60);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 0, 0));
+    // and released
+    render(synth, 4 * 44100);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    // the events sent right away by this thread go through the public functions
+    fluid_event_control_change(evt, 1, 7, 44);
+    fluid_sequencer_send_now(seq, evt);
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 1, 7, &value));
+    TEST_ASSERT(value == 44);
+    TEST_ASSERT(synth->public_api_count == 0);
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    test_events(FALSE);
+    test_events(TRUE);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the server speaks the text shell and the binary protocol to
+// several clients at once, all of them served by a single thread
+
+#if defined(NETWORK_SUPPORT) && !defined(_WIN32)
+
+#define PORT 9811
+#define WAIT_MSEC 5000
+
+static int connect_client(void)
+{
+    struct sockaddr_in addr;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(sock >= 0);
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_SUCCESS(connect(sock, (struct sockaddr *)&addr, sizeof(addr)));
+
+    return sock;
+}
+
+static void send_bytes(int sock, const void *buf, int len)
+{
+    TEST_ASSERT(send(sock, buf, len, 0) == len);
+}
+
+static int get_cc(fluid_synth_t *synth, int chan, int num)
+{
+    int value = -1;
+    TEST_SUCCESS(fluid_synth_get_cc(synth, chan, num, &value));
+    return value;
+}
+
+static int get_pitch_bend(fluid_synth_t *synth, int chan)
+{
+    int value = -1;
+    TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, chan, &value));
+    return value;
+}
+
+// waits until the server has handled what was sent
+#define WAIT_FOR(cond) \
+    do { \
+        int _msec; \
+        for(_msec = 0; !(cond) && _msec < WAIT_MSEC; _msec++) fluid_msleep(1); \
+        TEST_ASSERT(cond); \
+    } while(0)
+
+// waits until the server has closed the connection
+static void wait_closed(int sock)
+{
+    char buf[256];
+    int n;
+
+    while((n = recv(sock, buf, sizeof(buf), 0)) > 0)
+    {
+    }
+
+    TEST_ASSERT(n == 0);
+    close(sock);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_server_t *server;
+    int text, binary, other;
+
+    static const unsigned char magic = 0xF5;
+    static const unsigned char events[] =
+    {
+        0xB0, 1, 7, 85,         // control change
+        0xE0, 3, 0x7F, 0x7F,    // pitch bend, LSB first
+        0xB0, 200, 10, 3        // control change on a channel above 15
+    };
+    static const unsigned char invalid[] = { 0x01 };
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 256));
+    TEST_SUCCESS(fluid_settings_setint(settings, "shell.port", PORT));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    server = new_fluid_server(settings, synth, NULL);
+    TEST_ASSERT(server != NULL);
+
+    text = connect_client();
+    binary = connect_client();
+
+    // a text command, handled once its line is complete
+    send_bytes(text, "cc 0 7 ", 7);
+    send_bytes(text, "33\r\n", 4);
+    WAIT_FOR(get_cc(synth, 0, 7) == 33);
+
+    // binary events, one of them split between two sends
+    send_bytes(binary, &magic, 1);
+    send_bytes(binary, events, 6);
+    WAIT_FOR(get_cc(synth, 1, 7) == 85);
+    send_bytes(binary, events + 6, sizeof(events) - 6);
+    WAIT_FOR(get_pitch_bend(synth, 3) == 16383);
+    WAIT_FOR(get_cc(synth, 200, 10) == 3);
+
+    // the text client is still served while the binary one is connected
+    send_bytes(text, "cc 0 7 44\n", 10);
+    WAIT_FOR(get_cc(synth, 0, 7) == 44);
+
+    // a client quitting, and a binary client sending garbage, are closed
+    send_bytes(text, "quit\n", 5);
+    wait_closed(text);
+    send_bytes(binary, invalid, sizeof(invalid));
+    wait_closed(binary);
+
+    // the remaining clients are closed with the server
+    other = connect_client();
+    send_bytes(other, "cc 0 7 55\n", 10);
+    WAIT_FOR(get_cc(synth, 0, 7) == 55);
+
+    delete_fluid_server(server);
+    wait_closed(other);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int main(void)
+{
+    return EXIT_SUCCESS;
+}
+
+#endif
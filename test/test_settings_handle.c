@@ -0,0 +1,103 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_settings.h"
+
+// this test makes sure that the settings accessed through their handles are the same as those
+// accessed by name, and that the numeric values are never read half written
+
+#define WRITES 100000
+
+static int updated_value;
+static const char *updated_name;
+
+static void int_updated(void *data, const char *name, int value)
+{
+    updated_name = name;
+    updated_value = value;
+}
+
+static fluid_thread_return_t write_num(void *data)
+{
+    fluid_setting_handle_t *handle = data;
+    int i;
+
+    for(i = 0; i < WRITES; i++)
+    {
+        TEST_SUCCESS(fluid_settings_handle_setnum(handle, (i & 1) ? 1.0 / 3.0 : -1e300));
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_setting_handle_t *gain, *polyphony, *toggle;
+    fluid_thread_t *thread;
+    double num;
+    int i, val;
+
+    TEST_ASSERT(settings != NULL);
+
+    // only numeric and integer settings have handles
+    TEST_ASSERT(fluid_settings_get_handle(settings, "synth.no-such-setting") == NULL);
+    TEST_ASSERT(fluid_settings_get_handle(settings, "synth") == NULL);
+    TEST_ASSERT(fluid_settings_get_handle(settings, "audio.driver") == NULL);
+    TEST_ASSERT((gain = fluid_settings_get_handle(settings, "synth.gain")) != NULL);
+    TEST_ASSERT((polyphony = fluid_settings_get_handle(settings, "synth.polyphony")) != NULL);
+
+    // the same value as by name, both ways
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 0.5));
+    TEST_SUCCESS(fluid_settings_handle_getnum(gain, &num));
+    TEST_ASSERT(num == 0.5);
+    TEST_SUCCESS(fluid_settings_handle_setnum(gain, 1.5));
+    TEST_SUCCESS(fluid_settings_getnum(settings, "synth.gain", &num));
+    TEST_ASSERT(num == 1.5);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 100));
+    TEST_SUCCESS(fluid_settings_handle_getint(polyphony, &val));
+    TEST_ASSERT(val == 100);
+    TEST_SUCCESS(fluid_settings_handle_setint(polyphony, 200));
+    TEST_SUCCESS(fluid_settings_getint(settings, "synth.polyphony", &val));
+    TEST_ASSERT(val == 200);
+
+    // with the same range and type checks
+    TEST_ASSERT(fluid_settings_handle_setnum(gain, 1000.0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_settings_handle_setint(polyphony, 0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_settings_handle_getint(gain, &val) == FLUID_FAILED);
+    TEST_ASSERT(fluid_settings_handle_getnum(polyphony, &num) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_settings_handle_getnum(gain, &num));
+    TEST_ASSERT(num == 1.5);
+
+    // and the same update callback
+    TEST_SUCCESS(fluid_settings_register_int(settings, "test.toggle", 0, 0, 1, FLUID_HINT_TOGGLED));
+    TEST_SUCCESS(fluid_settings_callback_int(settings, "test.toggle", int_updated, NULL));
+    TEST_ASSERT((toggle = fluid_settings_get_handle(settings, "test.toggle")) != NULL);
+    TEST_SUCCESS(fluid_settings_handle_setint(toggle, 1));
+    TEST_ASSERT(updated_value == 1);
+    TEST_ASSERT(FLUID_STRCMP(updated_name, "test.toggle") == 0);
+    TEST_ASSERT(fluid_settings_get_handle(settings, "test.toggle") == toggle);
+
+    // a numeric setting written concurrently reads either value, never a mix of both
+    TEST_SUCCESS(fluid_settings_register_num(settings, "test.num", 0.0, -1e300, 1e300, 0));
+    TEST_ASSERT((gain = fluid_settings_get_handle(settings, "test.num")) != NULL);
+    thread = new_fluid_thread("test-writer", write_num, gain, 0, FALSE);
+    TEST_ASSERT(thread != NULL);
+
+    for(i = 0; i < WRITES; i++)
+    {
+        TEST_SUCCESS(fluid_settings_handle_getnum(gain, &num));
+        TEST_ASSERT(num == 0.0 || num == 1.0 / 3.0 || num == -1e300);
+
+        TEST_SUCCESS(fluid_settings_getnum(settings, "test.num", &num));
+        TEST_ASSERT(num == 0.0 || num == 1.0 / 3.0 || num == -1e300);
+    }
+
+    TEST_SUCCESS(fluid_thread_join(thread));
+    delete_fluid_thread(thread);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
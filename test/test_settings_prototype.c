@@ -0,0 +1,93 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_settings.h"
+
+// this test makes sure that the settings objects sharing the default settings don't see the changes of
+// each other, whatever is changed
+
+static void count_setting(void *data, const char *name, int type)
+{
+    (*(int *)data)++;
+}
+
+static int count_settings(fluid_settings_t *settings)
+{
+    int count = 0;
+
+    fluid_settings_foreach(settings, &count, count_setting);
+
+    return count;
+}
+
+int main(void)
+{
+    fluid_settings_t *changed = new_fluid_settings(), *settings = new_fluid_settings();
+    const char *no_drivers[] = { NULL };
+    int count, val;
+    double num;
+    char *str;
+
+    TEST_ASSERT(changed != NULL && settings != NULL);
+
+    count = count_settings(settings);
+    TEST_ASSERT(count > 50);
+    TEST_ASSERT(count_settings(changed) == count);
+
+    // values, options and new settings, next to the shared ones
+    TEST_SUCCESS(fluid_settings_setnum(changed, "synth.gain", 0.5));
+    TEST_SUCCESS(fluid_settings_setint(changed, "synth.polyphony", 100));
+    TEST_SUCCESS(fluid_settings_setstr(changed, "synth.midi-bank-select", "xg"));
+    TEST_SUCCESS(fluid_settings_add_option(changed, "synth.midi-bank-select", "test"));
+    TEST_SUCCESS(fluid_settings_register_int(changed, "synth.test", 1, 0, 2, 0));
+    TEST_SUCCESS(fluid_settings_register_str(changed, "test.str", "a", 0));
+    TEST_ASSERT(fluid_settings_get_handle(changed, "synth.sample-rate") != NULL);
+
+    TEST_SUCCESS(fluid_settings_getnum(changed, "synth.gain", &num));
+    TEST_ASSERT(num == 0.5);
+    TEST_SUCCESS(fluid_settings_getint(changed, "synth.polyphony", &val));
+    TEST_ASSERT(val == 100);
+    TEST_ASSERT(fluid_settings_str_equal(changed, "synth.midi-bank-select", "xg"));
+    TEST_ASSERT(fluid_settings_option_count(changed, "synth.midi-bank-select") == 5);
+    TEST_ASSERT(count_settings(changed) == count + 2);
+
+    // left alone in the others, including those created later
+    TEST_SUCCESS(fluid_settings_getnum(settings, "synth.gain", &num));
+    TEST_ASSERT(num == 0.2f);
+    TEST_SUCCESS(fluid_settings_getint(settings, "synth.polyphony", &val));
+    TEST_ASSERT(val == 256);
+    TEST_ASSERT(fluid_settings_str_equal(settings, "synth.midi-bank-select", "gs"));
+    TEST_ASSERT(fluid_settings_option_count(settings, "synth.midi-bank-select") == 4);
+    TEST_ASSERT(fluid_settings_get_type(settings, "synth.test") == FLUID_NO_TYPE);
+    TEST_ASSERT(count_settings(settings) == count);
+
+    delete_fluid_settings(settings);
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_getnum(settings, "synth.gain", &num));
+    TEST_ASSERT(num == 0.2f);
+    TEST_ASSERT(fluid_settings_get_type(settings, "test.str") == FLUID_NO_TYPE);
+
+    // the copies are deleted with their settings object only
+    delete_fluid_settings(changed);
+    TEST_SUCCESS(fluid_settings_dupstr(settings, "synth.midi-bank-select", &str));
+    TEST_ASSERT(FLUID_STRCMP(str, "gs") == 0);
+    fluid_free(str);
+    delete_fluid_settings(settings);
+
+    // the default settings are registered again once the registered audio drivers
+    // have changed, here to none of them registering its settings
+    TEST_SUCCESS(fluid_audio_driver_register(no_drivers));
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(count_settings(settings) <= count);
+    delete_fluid_settings(settings);
+
+    TEST_SUCCESS(fluid_audio_driver_register(NULL));
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(count_settings(settings) == count);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
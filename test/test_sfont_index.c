@@ -0,0 +1,257 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_sffile.h"
+#include "utils/fluid_hash.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the presets, instruments and samples of a SoundFont rebuilt from its index
+// file in the cache directory are the same as the ones parsed from the SoundFont, that an invalid index
+// file is ignored and replaced, and that the synth renders the same with the index
+
+#define INDEX_DIR "."
+#define FRAMES 4410
+
+static const fluid_file_callbacks_t *fcbs;
+static char index_path[1024];
+
+static SFData *parse(const char *index_dir)
+{
+    SFData *sf = fluid_sffile_open(TEST_SOUNDFONT, fcbs);
+
+    TEST_ASSERT(sf != NULL);
+    TEST_SUCCESS(fluid_sffile_parse_presets(sf, index_dir));
+
+    return sf;
+}
+
+static int list_index(fluid_list_t *list, void *data)
+{
+    int i;
+
+    for(i = 0; list; list = fluid_list_next(list), i++)
+    {
+        if(fluid_list_get(list) == data)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void compare_zones(fluid_list_t *zones1, fluid_list_t *zones2, fluid_list_t *instsamp1, fluid_list_t *instsamp2)
+{
+    fluid_list_t *g1, *g2;
+
+    for(; zones1 && zones2; zones1 = fluid_list_next(zones1), zones2 = fluid_list_next(zones2))
+    {
+        SFZone *z1 = fluid_list_get(zones1), *z2 = fluid_list_get(zones2);
+
+        // the zones refer to the instruments or samples at the same positions
+        TEST_ASSERT((z1->instsamp == NULL) == (z2->instsamp == NULL));
+
+        if(z1->instsamp != NULL)
+        {
+            TEST_ASSERT(list_index(instsamp1, fluid_list_get(z1->instsamp)) >= 0);
+            TEST_ASSERT(list_index(instsamp1, fluid_list_get(z1->instsamp))
+                        == list_index(instsamp2, fluid_list_get(z2->instsamp)));
+        }
+
+        for(g1 = z1->gen, g2 = z2->gen; g1 && g2; g1 = fluid_list_next(g1), g2 = fluid_list_next(g2))
+        {
+            TEST_ASSERT(FLUID_MEMCMP(g1->data, g2->data, sizeof(SFGen)) == 0);
+        }
+
+        TEST_ASSERT(g1 == NULL && g2 == NULL);
+
+        for(g1 = z1->mod, g2 = z2->mod; g1 && g2; g1 = fluid_list_next(g1), g2 = fluid_list_next(g2))
+        {
+            TEST_ASSERT(FLUID_MEMCMP(g1->data, g2->data, sizeof(SFMod)) == 0);
+        }
+
+        TEST_ASSERT(g1 == NULL && g2 == NULL);
+    }
+
+    TEST_ASSERT(zones1 == NULL && zones2 == NULL);
+}
+
+static void compare(SFData *sf1, SFData *sf2)
+{
+    fluid_list_t *p1, *p2;
+
+    TEST_ASSERT(fluid_list_size(sf1->preset) > 0);
+
+    for(p1 = sf1->preset, p2 = sf2->preset; p1 && p2; p1 = fluid_list_next(p1), p2 = fluid_list_next(p2))
+    {
+        SFPreset *preset1 = fluid_list_get(p1), *preset2 = fluid_list_get(p2);
+
+        TEST_ASSERT(FLUID_STRCMP(preset1->name, preset2->name) == 0);
+        TEST_ASSERT(preset1->prenum == preset2->prenum);
+        TEST_ASSERT(preset1->bank == preset2->bank);
+        TEST_ASSERT(preset1->libr == preset2->libr);
+        compare_zones(preset1->zone, preset2->zone, sf1->inst, sf2->inst);
+    }
+
+    TEST_ASSERT(p1 == NULL && p2 == NULL);
+
+    for(p1 = sf1->inst, p2 = sf2->inst; p1 && p2; p1 = fluid_list_next(p1), p2 = fluid_list_next(p2))
+    {
+        SFInst *inst1 = fluid_list_get(p1), *inst2 = fluid_list_get(p2);
+
+        TEST_ASSERT(FLUID_STRCMP(inst1->name, inst2->name) == 0);
+        TEST_ASSERT(inst1->idx == inst2->idx);
+        compare_zones(inst1->zone, inst2->zone, sf1->sample, sf2->sample);
+    }
+
+    TEST_ASSERT(p1 == NULL && p2 == NULL);
+
+    for(p1 = sf1->sample, p2 = sf2->sample; p1 && p2; p1 = fluid_list_next(p1), p2 = fluid_list_next(p2))
+    {
+        SFSample *sample1 = fluid_list_get(p1), *sample2 = fluid_list_get(p2);
+
+        TEST_ASSERT(FLUID_STRCMP(sample1->name, sample2->name) == 0);
+        TEST_ASSERT(sample1->start == sample2->start);
+        TEST_ASSERT(sample1->end == sample2->end);
+        TEST_ASSERT(sample1->loopstart == sample2->loopstart);
+        TEST_ASSERT(sample1->loopend == sample2->loopend);
+        TEST_ASSERT(sample1->samplerate == sample2->samplerate);
+        TEST_ASSERT(sample1->origpitch == sample2->origpitch);
+        TEST_ASSERT(sample1->pitchadj == sample2->pitchadj);
+        TEST_ASSERT(sample1->sampletype == sample2->sampletype);
+    }
+
+    TEST_ASSERT(p1 == NULL && p2 == NULL);
+}
+
+static long index_size(void)
+{
+    FILE *file = FLUID_FOPEN(index_path, "rb");
+    long size;
+
+    if(file == NULL)
+    {
+        return -1;
+    }
+
+    TEST_ASSERT(FLUID_FSEEK(file, 0, SEEK_END) == 0);
+    size = FLUID_FTELL(file);
+    FLUID_FCLOSE(file);
+
+    return size;
+}
+
+static float *render(const char *index_dir)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES);
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.sample-cache-dir", index_dir));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, i, i * 7));
+        TEST_SUCCESS(fluid_synth_noteon(synth, i, 40 + i * 2, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_sfloader_t *loader;
+    SFData *parsed, *stored, *indexed;
+    float *plain, *buf;
+    char *data;
+    FILE *file;
+    long size;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    loader = new_fluid_defsfloader(settings);
+    TEST_ASSERT(loader != NULL);
+    fcbs = &loader->file_callbacks;
+
+    FLUID_SNPRINTF(index_path, sizeof(index_path), "%s/fluidsynth-%08x.sfi", INDEX_DIR,
+                   fluid_str_hash(TEST_SOUNDFONT));
+    remove(index_path);
+
+    // without a directory, nothing is stored
+    parsed = parse(NULL);
+    TEST_ASSERT(index_size() < 0);
+    fluid_sffile_close(parse(""));
+    TEST_ASSERT(index_size() < 0);
+
+    // parsed and stored, then rebuilt from the index
+    stored = parse(INDEX_DIR);
+    TEST_ASSERT((size = index_size()) > 0);
+    indexed = parse(INDEX_DIR);
+    compare(parsed, stored);
+    compare(parsed, indexed);
+
+    // the zones, generators and modulators were taken from the index in one array each,
+    // rather than in one per bag, modulator and generator sub-chunk
+    TEST_ASSERT(fluid_list_size(stored->records) == 6);
+    TEST_ASSERT(fluid_list_size(indexed->records) == 3);
+    fluid_sffile_close(stored);
+    fluid_sffile_close(indexed);
+
+    // a truncated index is ignored and replaced
+    data = FLUID_MALLOC(size);
+    TEST_ASSERT(data != NULL);
+    file = FLUID_FOPEN(index_path, "rb");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(FLUID_FREAD(data, 1, size, file) == (size_t)size);
+    FLUID_FCLOSE(file);
+    file = FLUID_FOPEN(index_path, "wb");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(fwrite(data, 1, size / 2, file) == (size_t)(size / 2));
+    FLUID_FCLOSE(file);
+    FLUID_FREE(data);
+    indexed = parse(INDEX_DIR);
+    compare(parsed, indexed);
+    TEST_ASSERT(fluid_list_size(indexed->records) == 6);
+    fluid_sffile_close(indexed);
+    TEST_ASSERT(index_size() == size);
+
+    // an index of another SoundFont by the same name is ignored, the modification time doesn't match
+    file = FLUID_FOPEN(index_path, "r+b");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(FLUID_FSEEK(file, 16, SEEK_SET) == 0);
+    TEST_ASSERT(fputc(0x55, file) != EOF);
+    FLUID_FCLOSE(file);
+    indexed = parse(INDEX_DIR);
+    compare(parsed, indexed);
+    TEST_ASSERT(fluid_list_size(indexed->records) == 6);
+    fluid_sffile_close(indexed);
+    fluid_sffile_close(parsed);
+
+    plain = render("");
+    buf = render(INDEX_DIR);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(buf[i] == plain[i]);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(buf);
+    remove(index_path);
+    delete_fluid_sfloader(loader);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
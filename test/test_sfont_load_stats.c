@@ -0,0 +1,94 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the stages of loading a SoundFont are only timed with synth.sfont-load-stats,
+// that they account for the sample data read, found in the sample cache and loaded dynamically, and that
+// they add up over the SoundFonts
+
+static fluid_synth_t *new_synth(fluid_settings_t *settings, int *id)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(*id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    return synth;
+}
+
+int main(void)
+{
+    double msec[FLUID_SFONT_LOAD_LAST], other_msec[FLUID_SFONT_LOAD_LAST], all_msec[FLUID_SFONT_LOAD_LAST];
+    size_t bytes[FLUID_SFONT_LOAD_LAST], other_bytes[FLUID_SFONT_LOAD_LAST], all_bytes[FLUID_SFONT_LOAD_LAST];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *other;
+    int i, id, other_id, sfont2_id;
+
+    TEST_ASSERT(settings != NULL);
+
+    // not timed by default
+    synth = new_synth(settings, &id);
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(synth, id, msec, bytes, FLUID_SFONT_LOAD_LAST));
+
+    for(i = 0; i < FLUID_SFONT_LOAD_LAST; i++)
+    {
+        TEST_ASSERT(msec[i] == 0.0);
+        TEST_ASSERT(bytes[i] == 0);
+    }
+
+    TEST_ASSERT(fluid_synth_get_sfont_load_stats(synth, id + 1, msec, bytes, FLUID_SFONT_LOAD_LAST) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sfont-load-stats", 1));
+    synth = new_synth(settings, &id);
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(synth, id, msec, bytes, FLUID_SFONT_LOAD_LAST));
+
+    for(i = 0; i < FLUID_SFONT_LOAD_LAST; i++)
+    {
+        TEST_ASSERT(msec[i] >= 0.0);
+    }
+
+    TEST_ASSERT(bytes[FLUID_SFONT_LOAD_PARSE] > 0);
+    TEST_ASSERT(bytes[FLUID_SFONT_LOAD_PRESETS] > 0);
+    TEST_ASSERT(bytes[FLUID_SFONT_LOAD_SAMPLE_IO] > 0);
+    TEST_ASSERT(bytes[FLUID_SFONT_LOAD_SF3_DECODE] == 0);
+    TEST_ASSERT(bytes[FLUID_SFONT_LOAD_SAMPLE_OPTIMIZE] > 0);
+    TEST_ASSERT(bytes[FLUID_SFONT_LOAD_SAMPLE_CACHE] == 0);
+
+    // the sample data are found in the cache as long as the first synth uses them
+    other = new_synth(settings, &other_id);
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(other, other_id, other_msec, other_bytes, FLUID_SFONT_LOAD_LAST));
+    TEST_ASSERT(other_bytes[FLUID_SFONT_LOAD_PARSE] == bytes[FLUID_SFONT_LOAD_PARSE]);
+    TEST_ASSERT(other_bytes[FLUID_SFONT_LOAD_SAMPLE_IO] == 0);
+    TEST_ASSERT(other_bytes[FLUID_SFONT_LOAD_SAMPLE_CACHE] == bytes[FLUID_SFONT_LOAD_SAMPLE_IO]);
+    delete_fluid_synth(other);
+
+    // all of the SoundFonts add up, without setting more than asked for
+    TEST_SUCCESS(sfont2_id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(synth, sfont2_id, other_msec, other_bytes, FLUID_SFONT_LOAD_LAST));
+    all_bytes[FLUID_SFONT_LOAD_SAMPLE_IO] = 12345;
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(synth, -1, all_msec, all_bytes, FLUID_SFONT_LOAD_SAMPLE_IO));
+    TEST_ASSERT(all_bytes[FLUID_SFONT_LOAD_SAMPLE_IO] == 12345);
+
+    for(i = 0; i < FLUID_SFONT_LOAD_SAMPLE_IO; i++)
+    {
+        TEST_ASSERT(all_bytes[i] == bytes[i] + other_bytes[i]);
+    }
+
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(synth, -1, NULL, all_bytes, FLUID_SFONT_LOAD_LAST));
+    delete_fluid_synth(synth);
+
+    // the samples loaded dynamically are timed once their presets are selected, by the program reset of sfload
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    synth = new_synth(settings, &id);
+    TEST_SUCCESS(fluid_synth_get_sfont_load_stats(synth, id, other_msec, other_bytes, FLUID_SFONT_LOAD_LAST));
+    TEST_ASSERT(other_bytes[FLUID_SFONT_LOAD_PARSE] == bytes[FLUID_SFONT_LOAD_PARSE]);
+    TEST_ASSERT(other_bytes[FLUID_SFONT_LOAD_SAMPLE_IO] > 0);
+    TEST_ASSERT(other_bytes[FLUID_SFONT_LOAD_SAMPLE_OPTIMIZE] > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that loading the samples of a soundfont with several threads
+// sets up the samples exactly like loading them with a single thread
+
+static fluid_synth_t *load(fluid_settings_t *settings, int threads, fluid_defsfont_t **defsfont)
+{
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.load-threads", threads));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+    *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+
+    return synth;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    fluid_defsfont_t *defsfont1, *defsfont2;
+    fluid_list_t *list1, *list2;
+    int count = 0;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth1 = load(settings, 1, &defsfont1);
+    synth2 = load(settings, 4, &defsfont2);
+
+    for(list1 = defsfont1->sample, list2 = defsfont2->sample; list1 && list2;
+            list1 = fluid_list_next(list1), list2 = fluid_list_next(list2))
+    {
+        fluid_sample_t *sample1 = fluid_list_get(list1);
+        fluid_sample_t *sample2 = fluid_list_get(list2);
+
+        TEST_ASSERT(FLUID_STRCMP(sample1->name, sample2->name) == 0);
+        TEST_ASSERT(sample2->data != NULL);
+        TEST_ASSERT(sample1->start == sample2->start);
+        TEST_ASSERT(sample1->end == sample2->end);
+        TEST_ASSERT(sample1->loopstart == sample2->loopstart);
+        TEST_ASSERT(sample1->loopend == sample2->loopend);
+        TEST_ASSERT(memcmp(sample1->data + sample1->start, sample2->data + sample2->start,
+                           (sample1->end + 1 - sample1->start) * sizeof(short)) == 0);
+        TEST_ASSERT(sample1->amplitude_that_reaches_noise_floor_is_valid == sample2->amplitude_that_reaches_noise_floor_is_valid);
+        TEST_ASSERT(sample1->amplitude_that_reaches_noise_floor == sample2->amplitude_that_reaches_noise_floor);
+        count++;
+    }
+
+    TEST_ASSERT(list1 == NULL && list2 == NULL);
+    TEST_ASSERT(count > 0);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
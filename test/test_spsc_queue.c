@@ -0,0 +1,113 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_spsc_queue.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the single-producer, single-consumer queue holds as many elements as its size rounded
+// up to a power of two, and that a consumer thread pops all elements pushed in batches in the order they were pushed,
+// also when the free running positions wrap around
+
+#define QUEUE_SIZE 100
+#define CAPACITY 128
+#define NUM_ELEMENTS 20000
+
+static fluid_thread_return_t push_elements(void *data)
+{
+    fluid_spsc_queue_t *queue = data;
+    int i = 0, k, batch;
+    int *element;
+
+    while(i < NUM_ELEMENTS)
+    {
+        // batches of 1 to 5 elements, published at once
+        batch = 1 + i % 5;
+
+        if(fluid_spsc_queue_get_inptr(queue, batch - 1) == NULL)
+        {
+            fluid_msleep(1);
+            continue;
+        }
+
+        for(k = 0; k < batch; k++)
+        {
+            element = fluid_spsc_queue_get_inptr(queue, k);
+            TEST_ASSERT(element != NULL);
+            *element = i + k;
+        }
+
+        fluid_spsc_queue_next_inptr(queue, batch);
+        i += batch;
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_spsc_queue_t *queue;
+    fluid_thread_t *thread;
+    int i, popped;
+    int *element;
+
+    queue = new_fluid_spsc_queue(QUEUE_SIZE, sizeof(int));
+    TEST_ASSERT(queue != NULL);
+    TEST_ASSERT(fluid_spsc_queue_get_capacity(queue) == CAPACITY);
+    TEST_ASSERT(fluid_spsc_queue_get_count(queue) == 0);
+    TEST_ASSERT(fluid_spsc_queue_get_outptr(queue) == NULL);
+
+    // full with CAPACITY elements, not published before being advanced
+    for(i = 0; i < CAPACITY; i++)
+    {
+        element = fluid_spsc_queue_get_inptr(queue, i);
+        TEST_ASSERT(element != NULL);
+        *element = i;
+    }
+
+    TEST_ASSERT(fluid_spsc_queue_get_inptr(queue, CAPACITY) == NULL);
+    TEST_ASSERT(fluid_spsc_queue_get_outptr(queue) == NULL);
+
+    fluid_spsc_queue_next_inptr(queue, CAPACITY);
+    TEST_ASSERT(fluid_spsc_queue_get_count(queue) == CAPACITY);
+    TEST_ASSERT(fluid_spsc_queue_get_inptr(queue, 0) == NULL);
+
+    // peeking doesn't pop
+    element = fluid_spsc_queue_get_outptr_at(queue, CAPACITY - 1);
+    TEST_ASSERT(element != NULL && *element == CAPACITY - 1);
+    TEST_ASSERT(fluid_spsc_queue_get_outptr_at(queue, CAPACITY) == NULL);
+
+    element = fluid_spsc_queue_get_outptr(queue);
+    TEST_ASSERT(element != NULL && *element == 0);
+    fluid_spsc_queue_next_outptr(queue, CAPACITY);
+    TEST_ASSERT(fluid_spsc_queue_get_count(queue) == 0);
+    TEST_ASSERT(fluid_spsc_queue_get_outptr(queue) == NULL);
+
+    // the positions wrap around in the middle of the concurrent run
+    queue->in = queue->out = INT_MAX - 1000;
+    queue->out_cached = queue->in_cached = INT_MAX - 1000;
+
+    thread = new_fluid_thread("spsc-producer", push_elements, queue, 0, FALSE);
+    TEST_ASSERT(thread != NULL);
+
+    for(popped = 0; popped < NUM_ELEMENTS;)
+    {
+        element = fluid_spsc_queue_get_outptr(queue);
+
+        if(element == NULL)
+        {
+            fluid_msleep(1);
+            continue;
+        }
+
+        TEST_ASSERT(*element == popped);
+        fluid_spsc_queue_next_outptr(queue, 1);
+        popped++;
+    }
+
+    TEST_SUCCESS(fluid_thread_join(thread));
+    delete_fluid_thread(thread);
+
+    TEST_ASSERT(fluid_spsc_queue_get_count(queue) == 0);
+    delete_fluid_spsc_queue(queue);
+
+    return EXIT_SUCCESS;
+}
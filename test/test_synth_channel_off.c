@@ -0,0 +1,103 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that all sounds off finishes the voices of the channel it is sent to, or of all the
+// channels, with the single event the mixer applies in one pass, and that reducing the polyphony finishes
+// the voices above the new limit
+
+#define POLYPHONY 64
+
+static void render(fluid_synth_t *synth)
+{
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+}
+
+static void play(fluid_synth_t *synth, int chan, int first_key, int n)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, first_key + i, 100));
+    }
+
+    render(synth);
+}
+
+// the voices playing on a channel, once the voices finished by the last block have been collected
+// by a call of the API
+static int channel_voices(fluid_synth_t *synth, int chan)
+{
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) >= 0);
+    return synth->channel[chan]->voice_count;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int voices;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    play(synth, 0, 40, 8);
+    play(synth, 1, 40, 8);
+    play(synth, 2, 40, 8);
+
+    voices = channel_voices(synth, 1);
+    TEST_ASSERT(voices > 0);
+    TEST_ASSERT(channel_voices(synth, 0) == voices);
+    TEST_ASSERT(channel_voices(synth, 2) == voices);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 3 * voices);
+
+    // a single channel, the others keep playing
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, 1));
+    render(synth);
+    TEST_ASSERT(channel_voices(synth, 1) == 0);
+    TEST_ASSERT(channel_voices(synth, 0) == voices);
+    TEST_ASSERT(channel_voices(synth, 2) == voices);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 2 * voices);
+
+    // nothing left to finish on that channel
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, 1));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 2 * voices);
+
+    // all of them
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    // the voices above the new polyphony, more of them than fit in one event
+    play(synth, 0, 40, 16);
+    voices = fluid_synth_get_active_voice_count(synth);
+    TEST_ASSERT(voices > 8 + MAX_EVENT_PARAMS);
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 8));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= 8);
+
+    // the voices are reused, with their channel, for new notes
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY));
+    TEST_SUCCESS(fluid_synth_system_reset(synth));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    play(synth, 3, 60, 2);
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, 0));
+    render(synth);
+    TEST_ASSERT(channel_voices(synth, 3) > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the lists of the voices playing on each channel, and on each key
+// of it, always hold exactly the voices playing there, so that channel messages reach all of them
+
+#define POLYPHONY 16
+#define CHANNELS 4
+
+static void verify_channel_voices(fluid_synth_t *synth)
+{
+    int i, chan, key, count = 0, linked = 0;
+
+    for(chan = 0; chan < synth->midi_channels; chan++)
+    {
+        fluid_channel_t *channel = synth->channel[chan];
+        fluid_voice_t *voice, *prev = NULL;
+        int chan_count = 0, key_count = 0;
+
+        for(voice = channel->voices; voice != NULL; prev = voice, voice = voice->chan_next)
+        {
+            TEST_ASSERT(voice->chan_prev == prev);
+            TEST_ASSERT(voice->channel == channel);
+            TEST_ASSERT(fluid_voice_get_channel(voice) == chan);
+            chan_count++;
+        }
+
+        for(key = 0; key < 128; key++)
+        {
+            for(prev = NULL, voice = channel->key_voices[key]; voice != NULL; prev = voice, voice = voice->key_next)
+            {
+                TEST_ASSERT(voice->key_prev == prev);
+                TEST_ASSERT(voice->channel == channel);
+                TEST_ASSERT(fluid_voice_get_key(voice) == key);
+                key_count++;
+            }
+        }
+
+        TEST_ASSERT(chan_count == key_count);
+        linked += chan_count;
+    }
+
+    for(i = 0; i < synth->nvoice; i++)
+    {
+        if(fluid_voice_get_channel(synth->voice[i]) != NO_CHANNEL)
+        {
+            count++;
+        }
+    }
+
+    TEST_ASSERT(count == linked);
+}
+
+// no voice of the key on the channel is on anymore after its noteoff
+static void verify_noteoff(fluid_synth_t *synth, int chan, int key)
+{
+    int i;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        if(fluid_voice_get_channel(voice) == chan && fluid_voice_get_key(voice) == key)
+        {
+            TEST_ASSERT(!fluid_voice_is_on(voice));
+        }
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int i, chan, key;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    verify_channel_voices(synth);
+
+    // channel 3 plays mono legato, moving its voices from one key to the next
+    TEST_SUCCESS(fluid_synth_set_legato_mode(synth, 3, FLUID_CHANNEL_LEGATO_MODE_MULTI_RETRIGGER));
+    TEST_SUCCESS(fluid_synth_cc(synth, 3, LEGATO_SWITCH, 127));
+
+    // play more notes than there are voices, some of them sustained or released,
+    // so that voices are stolen from one channel for another
+    for(i = 0; i < 40 * POLYPHONY; i++)
+    {
+        chan = i % CHANNELS;
+        key = 30 + (i * 7) % 60;
+
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 1 + (i * 13) % 127));
+        verify_channel_voices(synth);
+
+        if(i % 5 == 0)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, chan, SUSTAIN_SWITCH, (i % 10) ? 127 : 0));
+            verify_channel_voices(synth);
+        }
+
+        if(i % 7 == 0)
+        {
+            TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, (i * 97) % 16384));
+            TEST_SUCCESS(fluid_synth_key_pressure(synth, chan, key, (i * 31) % 128));
+            verify_channel_voices(synth);
+        }
+
+        if(i % 3 == 0)
+        {
+            fluid_synth_noteoff(synth, chan, key);
+            verify_channel_voices(synth);
+
+            if(fluid_channel_get_cc(synth->channel[chan], SUSTAIN_SWITCH) < 64)
+            {
+                verify_noteoff(synth, chan, key);
+            }
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        verify_channel_voices(synth);
+    }
+
+    // voices above a lowered polyphony leave their channels once they are finished
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY / 2));
+    verify_channel_voices(synth);
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    }
+
+    // the finished voices are stopped by the next call of the API
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    verify_channel_voices(synth);
+
+    for(chan = 0; chan < synth->midi_channels; chan++)
+    {
+        TEST_ASSERT(synth->channel[chan]->voices == NULL);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a synth cluster passes the events of each channel to the engine owning it,
+// and sounds the same as a single synth with as many channels
+
+#define FRAMES 3000
+
+static void send_event(handle_midi_event_func_t handler, void *data, int type, int chan, int param1, int param2)
+{
+    fluid_midi_event_t *event = new_fluid_midi_event();
+    TEST_ASSERT(event != NULL);
+
+    fluid_midi_event_set_type(event, type);
+    fluid_midi_event_set_channel(event, chan);
+    fluid_midi_event_set_key(event, param1);
+    fluid_midi_event_set_velocity(event, param2);
+    TEST_SUCCESS(handler(data, event));
+
+    // the event keeps its channel
+    TEST_ASSERT(fluid_midi_event_get_channel(event) == chan);
+    delete_fluid_midi_event(event);
+}
+
+static void play(handle_midi_event_func_t handler, void *data)
+{
+    send_event(handler, data, NOTE_ON, 3, 60, 100);
+    send_event(handler, data, CONTROL_CHANGE, 20, 7, 90);
+    send_event(handler, data, NOTE_ON, 20, 67, 80);
+    send_event(handler, data, NOTE_ON, 31, 72, 60);
+}
+
+int main(void)
+{
+    static float left[FRAMES], right[FRAMES], cluster_left[FRAMES], cluster_right[FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *engine;
+    fluid_synth_cluster_t *cluster;
+    double hits;
+    int i, chan, val;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 32));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // no more engines than groups of 16 channels
+    cluster = new_fluid_synth_cluster(settings, 4);
+    TEST_ASSERT(cluster != NULL);
+    TEST_ASSERT(fluid_synth_cluster_count_engines(cluster) == 2);
+
+    // the engines share the sample data
+    hits = fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS);
+    TEST_ASSERT(fluid_synth_cluster_sfload(cluster, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_SAMPLE_CACHE_HITS) >= hits + 2);
+
+    play(fluid_synth_handle_midi_event, synth);
+    play(fluid_synth_cluster_handle_midi_event, cluster);
+
+    TEST_ASSERT(fluid_synth_cluster_get_channel_engine(cluster, 20, &chan) == fluid_synth_cluster_get_engine(cluster, 1));
+    TEST_ASSERT(chan == 4);
+    TEST_SUCCESS(fluid_synth_get_cc(fluid_synth_cluster_get_engine(cluster, 1), 4, 7, &val));
+    TEST_ASSERT(val == 90);
+    TEST_ASSERT(fluid_synth_cluster_get_channel_engine(cluster, 32, &chan) == NULL);
+
+    engine = fluid_synth_cluster_get_engine(cluster, 0);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(engine) > 0);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(engine) + fluid_synth_get_active_voice_count(
+                    fluid_synth_cluster_get_engine(cluster, 1)) == fluid_synth_get_active_voice_count(synth));
+
+    // in several chunks, into interleaved buffers
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+    TEST_SUCCESS(fluid_synth_cluster_write_float(cluster, FRAMES / 2, cluster_left, 0, 2, cluster_left, 1, 2));
+    TEST_SUCCESS(fluid_synth_cluster_write_float(cluster, FRAMES / 2, cluster_right, 0, 2, cluster_right, 1, 2));
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        float *out = (i < FRAMES / 2) ? cluster_left : cluster_right;
+        int k = i % (FRAMES / 2);
+
+        TEST_ASSERT(FLUID_FABS(out[2 * k] - left[i]) < 1e-5);
+        TEST_ASSERT(FLUID_FABS(out[2 * k + 1] - right[i]) < 1e-5);
+    }
+
+    // system messages go to all engines
+    send_event(fluid_synth_cluster_handle_midi_event, cluster, MIDI_SYSTEM_RESET, 0, 0, 0);
+    TEST_SUCCESS(fluid_synth_get_cc(fluid_synth_cluster_get_engine(cluster, 1), 4, 7, &val));
+    TEST_ASSERT(val == 100);
+    TEST_SUCCESS(fluid_synth_cluster_write_float(cluster, FRAMES / 2, cluster_left, 0, 1, cluster_right, 0, 1));
+
+    delete_fluid_synth_cluster(cluster);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
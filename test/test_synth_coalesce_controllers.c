@@ -0,0 +1,102 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.coalesce-controllers the controller state and the tunings are
+// updated immediately, while the voices are modulated and retuned once per block, sounding the same as without
+
+#define BLOCKS 32
+
+static void render_with_controllers(int coalesce, float *out, int *queued)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float right[FLUID_BUFSIZE];
+    int i, j, val, key = 67;
+    double depth, pitch;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.coalesce-controllers", coalesce));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 1, 0, 0, FALSE));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 67, 100));
+    *queued = 0;
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        depth = fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_EVENT_QUEUE_DEPTH);
+
+        // a flood of controller changes between two blocks
+        for(j = 0; j < 20; j++)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, i % 2, 7, (i * 20 + j) % 128));
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, 10, (i * 7 + j) % 128));
+            TEST_SUCCESS(fluid_synth_pitch_bend(synth, 1, (i * 1000 + j * 37) % 16384));
+            TEST_SUCCESS(fluid_synth_channel_pressure(synth, 0, j));
+
+            // realtime single note tuning changes, as sent by MIDI Tuning Standard sysex messages
+            pitch = 6700.0 + (i * 20 + j) % 50;
+            TEST_SUCCESS(fluid_synth_tune_notes(synth, 0, 0, 1, &key, &pitch, TRUE));
+        }
+
+        // the controller state is always exact
+        TEST_SUCCESS(fluid_synth_get_cc(synth, i % 2, 7, &val));
+        TEST_ASSERT(val == (i * 20 + 19) % 128);
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, 1, &val));
+        TEST_ASSERT(val == (i * 1000 + 19 * 37) % 16384);
+        TEST_ASSERT(fluid_tuning_get_pitch(fluid_channel_get_tuning(synth->channel[1]), key) == pitch);
+
+        *queued += (int)(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_EVENT_QUEUE_DEPTH) - depth);
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, out, i * FLUID_BUFSIZE, 1, right, 0, 1));
+    }
+
+    // all controllers off is applied to the voices right away, dropping what's pending
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 0));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, ALL_CTRL_OFF, 0));
+
+    for(i = 0; i < 4; i++)
+    {
+        TEST_ASSERT(synth->channel[0]->pending_cc[i] == 0);
+    }
+
+    TEST_ASSERT(synth->channel[0]->pending_ctrl == 0);
+
+    // nothing left to retune after the last block
+    TEST_ASSERT(!synth->channel[1]->pending_tuning);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float plain[BLOCKS * FLUID_BUFSIZE], coalesced[BLOCKS * FLUID_BUFSIZE];
+    int plain_queued, coalesced_queued, i;
+
+    render_with_controllers(0, plain, &plain_queued);
+    render_with_controllers(1, coalesced, &coalesced_queued);
+
+    // the voices are modulated by the last value sent before each block in both cases
+    for(i = 0; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        TEST_ASSERT(plain[i] == coalesced[i]);
+    }
+
+    // without the voice events queued for every single change
+    TEST_ASSERT(coalesced_queued == 0);
+    TEST_ASSERT(plain_queued > 0);
+
+    return EXIT_SUCCESS;
+}
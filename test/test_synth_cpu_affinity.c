@@ -0,0 +1,73 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the extra mixer threads restarted with synth.cpu-affinity, having
+// allocated their own buffers, render the same as without (up to the order in which the
+// voices rendered by the threads are summed)
+
+#if ENABLE_MIXER_THREADS
+
+#define FRAMES (16 * FLUID_BUFSIZE)
+
+static void render(const char *affinity, float *left, float *right)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 3));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-affinity", affinity));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i, 40 + 3 * i, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float left[FRAMES], right[FRAMES], pinned_left[FRAMES], pinned_right[FRAMES];
+    int i;
+
+    render("", left, right);
+
+    // negative cores leave the threads unpinned: the threads are restarted without actually
+    // pinning them, which would depend on the cores available
+    render("-1,-1,-1,-1", pinned_left, pinned_right);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(left[i] - pinned_left[i]) < 1e-6);
+        TEST_ASSERT(FLUID_FABS(right[i] - pinned_right[i]) < 1e-6);
+    }
+
+    // fewer cores than threads
+    render("-1,-1", pinned_left, pinned_right);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(left[i] - pinned_left[i]) < 1e-6);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int main(void)
+{
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with the deterministic scheduler, rendering on several cores sounds exactly the
+// same every time, whichever thread happens to finish first
+
+#define FRAMES 4096
+#define RUNS 4
+
+static float *render(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES);
+    int chan, key;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // more voices than a single thread renders
+    for(chan = 0; chan < 8; chan++)
+    {
+        for(key = 0; key < 8; key++)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, 36 + 5 * key + chan, 80 + key));
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    delete_fluid_synth(synth);
+
+    return buf;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    float *ref, *buf;
+    double energy = 0;
+    int i, run;
+
+    TEST_ASSERT(settings != NULL);
+#if ENABLE_MIXER_THREADS
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 4));
+#endif
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-cores-scheduler", "deterministic"));
+
+    ref = render(settings);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        energy += ref[i] * ref[i];
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    for(run = 0; run < RUNS; run++)
+    {
+        buf = render(settings);
+
+        for(i = 0; i < 2 * FRAMES; i++)
+        {
+            TEST_ASSERT(buf[i] == ref[i]);
+        }
+
+        FLUID_FREE(buf);
+    }
+
+    FLUID_FREE(ref);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that synth.dynamic-polyphony kills voices while the CPU load is too high,
+// and that all the voices are allowed again once the load has dropped
+
+#define POLYPHONY 16
+#define FRAMES 1024
+
+static void render(fluid_synth_t *synth)
+{
+    static float left[FRAMES], right[FRAMES];
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    double limit;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-polyphony.active", 1));
+    // any load is too high
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.dynamic-polyphony.high-load", 0));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.dynamic-polyphony.low-load", 0));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // a note may start several voices
+    for(i = 0; fluid_synth_get_active_voice_count(synth) < POLYPHONY; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 40 + i, 100));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == POLYPHONY);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) == POLYPHONY);
+
+    // no more than half of the voices are killed at once
+    render(synth);
+    limit = fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT);
+    TEST_ASSERT(limit == POLYPHONY / 2);
+
+    // the killed voices have finished by the next call
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= limit);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) == POLYPHONY / 4);
+
+    for(i = 0; i < 10; i++)
+    {
+        render(synth);
+    }
+
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) == 1);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= 1);
+
+    // a new note takes the place of the playing one, it might not be able to start all of its voices
+    fluid_synth_noteon(synth, 0, 80, 100);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= 1);
+
+    // any load is low enough, so that the voices are allowed again step by step
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.dynamic-polyphony.high-load", 100));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.dynamic-polyphony.low-load", 100));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) == 2);
+
+    for(i = 0; i < POLYPHONY; i++)
+    {
+        render(synth);
+    }
+
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) == POLYPHONY);
+
+    for(i = 0; fluid_synth_get_active_voice_count(synth) < POLYPHONY; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 1, 40 + i, 100));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == POLYPHONY);
+
+    // turning it off allows all the voices right away
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.dynamic-polyphony.high-load", 0));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.dynamic-polyphony.low-load", 0));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) < POLYPHONY);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-polyphony.active", 0));
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_VOICE_LIMIT) == POLYPHONY);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
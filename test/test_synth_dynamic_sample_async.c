@@ -0,0 +1,115 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+// this test makes sure that with synth.dynamic-sample-loading-async the samples of the selected presets are
+// loaded and unloaded in the background as they would be right away, that notes play the same once they are
+// loaded, and that a synth can be deleted with samples still queued
+
+#define FRAMES 4096
+
+static fluid_synth_t *new_synth(fluid_settings_t *settings, int async, int *id)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading-async", async));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    *id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(*id != FLUID_FAILED);
+
+    return synth;
+}
+
+// the number of samples loaded once the loader is done
+static int wait_loaded(fluid_synth_t *synth, int id)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    fluid_list_t *list;
+    int count, loading, i;
+
+    for(i = 0; i < 1000; i++)
+    {
+        count = loading = 0;
+
+        for(list = defsfont->sample; list; list = fluid_list_next(list))
+        {
+            fluid_sample_t *sample = fluid_list_get(list);
+
+            loading |= fluid_atomic_int_get(&sample->loading);
+            count += (sample->data != NULL);
+        }
+
+        if(!loading)
+        {
+            return count;
+        }
+
+        fluid_msleep(10);
+    }
+
+    TEST_ASSERT(!"the samples never finished loading");
+    return 0;
+}
+
+static void program_changes(fluid_synth_t *synth, int prog)
+{
+    int chan;
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, prog + 3 * chan));
+    }
+}
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 64, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings(), *async_settings = new_fluid_settings();
+    fluid_synth_t *synth, *async_synth;
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES), *async_buf = FLUID_ARRAY(float, 2 * FRAMES);
+    int id, async_id, i;
+
+    TEST_ASSERT(settings != NULL && async_settings != NULL);
+    TEST_ASSERT(buf != NULL && async_buf != NULL);
+
+    synth = new_synth(settings, FALSE, &id);
+    async_synth = new_synth(async_settings, TRUE, &async_id);
+    TEST_ASSERT(wait_loaded(async_synth, async_id) == wait_loaded(synth, id));
+
+    // the preset selected last is loaded first, the ones unselected meanwhile are dropped or unloaded
+    program_changes(synth, 1);
+    program_changes(async_synth, 1);
+    program_changes(synth, 2);
+    program_changes(async_synth, 2);
+    TEST_ASSERT(wait_loaded(async_synth, async_id) == wait_loaded(synth, id));
+
+    render(synth, buf);
+    render(async_synth, async_buf);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(async_buf[i] == buf[i]);
+    }
+
+    // deleted while loading
+    program_changes(async_synth, 5);
+    delete_fluid_synth(async_synth);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(async_settings);
+    delete_fluid_settings(settings);
+    FLUID_FREE(buf);
+    FLUID_FREE(async_buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that starting a voice with an exclusive class kills exactly the voices of the same
+// class on the same channel, except for the ones of the same noteon, although only the voices of that
+// class are visited
+
+#define FRAMES 1000
+
+static short data[FRAMES];
+
+static fluid_voice_t *start(fluid_synth_t *synth, fluid_sample_t *sample, int chan, unsigned int id, int excl_class)
+{
+    fluid_voice_t *voice;
+
+    synth->storeid = id;
+    voice = fluid_synth_alloc_voice(synth, sample, chan, 60, 100);
+    TEST_ASSERT(voice != NULL);
+    fluid_voice_gen_set(voice, GEN_SAMPLEMODE, FLUID_LOOP_DURING_RELEASE);
+    fluid_voice_gen_set(voice, GEN_EXCLUSIVECLASS, excl_class);
+    fluid_synth_start_voice(synth, voice);
+
+    return voice;
+}
+
+// whether the voice has been killed for its exclusive class
+static int is_killed(fluid_voice_t *voice, int excl_class)
+{
+    TEST_ASSERT(fluid_voice_is_playing(voice));
+    return fluid_voice_gen_value(voice, GEN_EXCLUSIVECLASS) != excl_class;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sample_t *sample = new_fluid_sample();
+    fluid_voice_t *same_noteon[2], *other_class, *same_slot, *other_chan, *killer;
+    float buf[2 * FLUID_BUFSIZE];
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, FRAMES, 44100, FALSE));
+    TEST_SUCCESS(fluid_sample_set_loop(sample, 100, FRAMES - 100));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    fluid_synth_api_enter(synth);
+
+    same_noteon[0] = start(synth, sample, 0, 1, 5);
+    same_noteon[1] = start(synth, sample, 0, 1, 5);
+    other_class = start(synth, sample, 0, 1, 7);
+    same_slot = start(synth, sample, 0, 2, 5 + 128);
+    other_chan = start(synth, sample, 1, 2, 5);
+
+    // the voices of one noteon leave each other alone
+    TEST_ASSERT(!is_killed(same_noteon[0], 5));
+    TEST_ASSERT(!is_killed(same_noteon[1], 5));
+    TEST_ASSERT(synth->channel[0]->excl_voices[5] != NULL);
+
+    killer = start(synth, sample, 0, 3, 5);
+
+    TEST_ASSERT(is_killed(same_noteon[0], 5));
+    TEST_ASSERT(is_killed(same_noteon[1], 5));
+    TEST_ASSERT(!is_killed(other_class, 7));
+    TEST_ASSERT(!is_killed(same_slot, 5 + 128));
+    TEST_ASSERT(!is_killed(other_chan, 5));
+    TEST_ASSERT(!is_killed(killer, 5));
+
+    // the killed voices are no longer visited
+    TEST_ASSERT(same_noteon[0]->excl_class == 0 && same_noteon[1]->excl_class == 0);
+    TEST_ASSERT(killer->excl_class == 5);
+
+    // and the voices stopped are unlinked
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_off(synth->voice[i]);
+    }
+
+    fluid_synth_api_exit(synth);
+
+    for(i = 0; i < 4; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    }
+
+    fluid_synth_api_enter(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    for(i = 0; i < 128; i++)
+    {
+        TEST_ASSERT(synth->channel[0]->excl_voices[i] == NULL);
+        TEST_ASSERT(synth->channel[1]->excl_voices[i] == NULL);
+    }
+
+    fluid_synth_api_exit(synth);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    delete_fluid_sample(sample);
+
+    return EXIT_SUCCESS;
+}
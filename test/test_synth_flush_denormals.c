@@ -0,0 +1,67 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that synth.flush-denormals renders the same as without, and leaves the
+// floating point mode of the thread calling the synth as it was
+
+#define FRAMES (16 * FLUID_BUFSIZE)
+
+static void render(int flush, float *left, float *right)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+#if ENABLE_MIXER_THREADS
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 2));
+#endif
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.flush-denormals", flush));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i, 40 + 3 * i, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float left[FRAMES], right[FRAMES], flushed_left[FRAMES], flushed_right[FRAMES];
+    volatile double tiny = 1e-300;
+    unsigned int state;
+    int i;
+
+    if(fluid_thread_self_flush_denormals(TRUE, &state) == FLUID_OK)
+    {
+        // denormal results are flushed to zero while enabled
+        TEST_ASSERT(tiny * 1e-20 == 0);
+        fluid_thread_self_restore_denormals(state);
+        TEST_ASSERT(tiny * 1e-20 != 0);
+    }
+
+    render(FALSE, left, right);
+    render(TRUE, flushed_left, flushed_right);
+
+    // the calling thread still computes denormals, unless the synth made it trap on their underflow
+#ifndef TRAP_ON_FPE
+    TEST_ASSERT(tiny * 1e-20 != 0);
+#endif
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(left[i] - flushed_left[i]) < 1e-6);
+        TEST_ASSERT(FLUID_FABS(right[i] - flushed_right[i]) < 1e-6);
+    }
+
+    return EXIT_SUCCESS;
+}
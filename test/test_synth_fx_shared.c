@@ -0,0 +1,172 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.effects-shared, the effects groups feed the reverb of the first one by
+// their send gains, sounding like a single group, and that the effects channels of the other groups stay silent
+
+#define FRAMES 4096
+#define FX_BUFS 8                   // left and right of the reverb and the chorus of 2 groups
+
+static const float ir[2] = { 1.0f, 0.5f };
+
+static fluid_synth_t *new_synth(fluid_settings_t **settings, int groups, int shared)
+{
+    fluid_synth_t *synth;
+
+    *settings = new_fluid_settings();
+    TEST_ASSERT(*settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.effects-groups", groups));
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.effects-shared", shared));
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(*settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+// renders a note on the channels 0 and 1 with the effects mixed in
+static float *render(int groups, int shared)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth = new_synth(&settings, groups, shared);
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES);
+
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 67, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+// renders a note on channel 1, i.e. of the second group, to the effects channels only
+static void render_fx(int shared, double send, float *fx[FX_BUFS])
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth = new_synth(&settings, 2, shared);
+    int i;
+
+    for(i = 0; i < FX_BUFS; i++)
+    {
+        FLUID_MEMSET(fx[i], 0, FRAMES * sizeof(float));
+    }
+
+    TEST_SUCCESS(fluid_synth_set_reverb_group_send(synth, 1, send));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 60, 100));
+    TEST_SUCCESS(fluid_synth_process(synth, FRAMES, FX_BUFS, fx, 0, NULL));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// checks that all effects channels but the reverb of one group are silent, returns the peak of that reverb
+static double silent_but(float *fx[FX_BUFS], int used)
+{
+    double peak = 0;
+    int i, k;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        for(k = 0; k < FX_BUFS; k++)
+        {
+            if(k == used || k == used + 1)
+            {
+                peak = (fabs(fx[k][i]) > peak) ? fabs(fx[k][i]) : peak;
+            }
+            else
+            {
+                TEST_ASSERT(fx[k][i] == 0);
+            }
+        }
+    }
+
+    return peak;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float *single, *shared, *fx[FX_BUFS], *half[FX_BUFS];
+    double send, peak;
+    int i;
+
+    // all groups in one room
+    single = render(1, FALSE);
+    shared = render(4, TRUE);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(fabs(single[i] - shared[i]) < 1e-5);
+    }
+
+    FLUID_FREE(single);
+    FLUID_FREE(shared);
+
+    for(i = 0; i < FX_BUFS; i++)
+    {
+        fx[i] = FLUID_ARRAY(float, FRAMES);
+        half[i] = FLUID_ARRAY(float, FRAMES);
+        TEST_ASSERT(fx[i] != NULL && half[i] != NULL);
+    }
+
+    // the reverb of all groups comes out of the reverb channels of the first one, scaled by the send gain
+    render_fx(TRUE, 1.0, fx);
+    peak = silent_but(fx, 0);
+    TEST_ASSERT(peak > 1e-3);
+
+    render_fx(TRUE, 0.5, half);
+    TEST_ASSERT(fabs(silent_but(half, 0) - 0.5 * peak) < 1e-3 * peak);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(fabs(half[0][i] - 0.5 * fx[0][i]) < 1e-6);
+    }
+
+    render_fx(TRUE, 0.0, fx);
+    TEST_ASSERT(silent_but(fx, 0) == 0);
+
+    // groups with reverbs of their own use their send gains as well
+    render_fx(FALSE, 1.0, fx);
+    TEST_ASSERT(silent_but(fx, 4) > 1e-3);
+    render_fx(FALSE, 0.0, fx);
+    TEST_ASSERT(silent_but(fx, 4) == 0);
+
+    for(i = 0; i < FX_BUFS; i++)
+    {
+        FLUID_FREE(fx[i]);
+        FLUID_FREE(half[i]);
+    }
+
+    // the send gains
+    synth = new_synth(&settings, 2, TRUE);
+    TEST_SUCCESS(fluid_synth_get_reverb_group_send(synth, 1, &send));
+    TEST_ASSERT(send == 1.0);
+    TEST_SUCCESS(fluid_synth_set_chorus_group_send(synth, -1, 0.5));
+    TEST_SUCCESS(fluid_synth_get_chorus_group_send(synth, 0, &send));
+    TEST_ASSERT(send == 0.5);
+    TEST_SUCCESS(fluid_synth_get_chorus_group_send(synth, 1, &send));
+    TEST_ASSERT(send == 0.5);
+    TEST_ASSERT(fluid_synth_set_reverb_group_send(synth, 2, 0.5) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_set_reverb_group_send(synth, 0, -1.0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_reverb_group_send(synth, -1, &send) == FLUID_FAILED);
+
+    // reset along with the synth
+    TEST_SUCCESS(fluid_synth_reset_to_initial_state(synth));
+    TEST_SUCCESS(fluid_synth_get_chorus_group_send(synth, 1, &send));
+    TEST_ASSERT(send == 1.0);
+
+    // only the first group has a reverb to replace
+    TEST_ASSERT(fluid_synth_set_reverb_group_ir(synth, 1, ir, NULL, 2) == FLUID_FAILED);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the reverb and chorus units are only created once the effects are turned on,
+// sounding the same as if they had been on from the start, and that they are released once the effects
+// have been off for synth.effects-release-time
+
+#define FRAMES 8192
+
+// the settings of each synth are deleted along with it
+static fluid_settings_t *settings;
+
+static fluid_synth_t *new_synth(int active, int release_time)
+{
+    fluid_synth_t *synth;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", active));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", active));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-release-time", release_time));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(synth->with_reverb_units == active && synth->with_chorus_units == active);
+
+    return synth;
+}
+
+static void delete_synth(fluid_synth_t *synth)
+{
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+int main(void)
+{
+    fluid_synth_t *synth;
+    float *on = FLUID_ARRAY(float, 2 * FRAMES), *later = FLUID_ARRAY(float, 2 * FRAMES);
+    int i;
+
+    TEST_ASSERT(on != NULL && later != NULL);
+
+    synth = new_synth(TRUE, 0);
+    TEST_SUCCESS(fluid_synth_set_reverb_roomsize(synth, 0.9));
+    TEST_SUCCESS(fluid_synth_set_chorus_nr(synth, 5));
+    render(synth, on);
+    delete_synth(synth);
+
+    // turned on before rendering, with the parameters set while they were off
+    synth = new_synth(FALSE, 0);
+    TEST_SUCCESS(fluid_synth_set_reverb_roomsize(synth, 0.9));
+    TEST_SUCCESS(fluid_synth_set_chorus_nr(synth, 5));
+    fluid_synth_set_reverb_on(synth, TRUE);
+    fluid_synth_set_chorus_on(synth, TRUE);
+    TEST_ASSERT(synth->with_reverb_units && synth->with_chorus_units);
+    render(synth, later);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(later[i] == on[i]);
+    }
+
+    // released right away, deleted once swapped out
+    fluid_synth_set_reverb_on(synth, FALSE);
+    TEST_ASSERT(!synth->with_reverb_units && synth->with_chorus_units);
+    TEST_ASSERT(synth->fx_units_pending);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, later, 0, 2, later, 1, 2));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_ASSERT(!synth->fx_units_pending && synth->replaced_rates == NULL);
+    delete_synth(synth);
+
+    // after the release time, at the next call
+    synth = new_synth(TRUE, 100);
+    fluid_synth_set_chorus_on(synth, FALSE);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(synth->with_chorus_units);
+    fluid_msleep(200);
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_ASSERT(!synth->with_chorus_units && synth->with_reverb_units);
+
+    // turned on again before the release time, the units are kept
+    fluid_synth_set_reverb_on(synth, FALSE);
+    fluid_synth_set_reverb_on(synth, TRUE);
+    fluid_msleep(200);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 62, 100));
+    TEST_ASSERT(synth->with_reverb_units);
+    delete_synth(synth);
+
+    FLUID_FREE(on);
+    FLUID_FREE(later);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "midi/fluid_midi_router.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a batch of MIDI events is handled in order as if its events were handled one after
+// the other, directly or through a MIDI router, and that an event failing doesn't stop the others
+
+#define EVENTS 4
+
+static fluid_midi_event_t *new_event(int type, int chan, int param1, int param2)
+{
+    fluid_midi_event_t *event = new_fluid_midi_event();
+
+    TEST_ASSERT(event != NULL);
+    TEST_SUCCESS(fluid_midi_event_set_type(event, type));
+    TEST_SUCCESS(fluid_midi_event_set_channel(event, chan));
+    TEST_SUCCESS(fluid_midi_event_set_key(event, param1));
+    TEST_SUCCESS(fluid_midi_event_set_velocity(event, param2));
+
+    return event;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_midi_router_t *router;
+    fluid_midi_event_t *events[EVENTS];
+    int i, val;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    events[0] = new_event(CONTROL_CHANGE, 0, 7, 10);
+    events[1] = new_event(CONTROL_CHANGE, 0, 7, 20);
+    events[2] = new_event(NOTE_ON, 0, 60, 100);
+    events[3] = new_event(NOTE_ON, 1, 62, 100);
+
+    TEST_SUCCESS(fluid_synth_handle_midi_events(synth, events, 0));
+    TEST_SUCCESS(fluid_synth_handle_midi_events(synth, events, EVENTS));
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &val));
+    TEST_ASSERT(val == 20);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    TEST_SUCCESS(fluid_synth_all_notes_off(synth, -1));
+
+    // through a router passing the events on to the synth
+    router = new_fluid_midi_router(settings, fluid_synth_handle_midi_event, synth);
+    TEST_ASSERT(router != NULL);
+    fluid_midi_event_set_value(events[1], 30);
+    TEST_SUCCESS(fluid_midi_router_handle_midi_events(router, events, EVENTS));
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &val));
+    TEST_ASSERT(val == 30);
+
+    // a note on a channel the synth doesn't have fails, the events after it are still handled
+    fluid_midi_event_set_channel(events[2], 255);
+    fluid_midi_event_set_value(events[1], 40);
+    TEST_ASSERT(fluid_synth_handle_midi_events(synth, events + 1, EVENTS - 1) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &val));
+    TEST_ASSERT(val == 40);
+    TEST_ASSERT(fluid_synth_handle_midi_events(synth, NULL, 1) == FLUID_FAILED);
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        delete_fluid_midi_event(events[i]);
+    }
+
+    delete_fluid_midi_router(router);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
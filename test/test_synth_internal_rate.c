@@ -0,0 +1,127 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a synth rendering at synth.internal-rate outputs the same tone at the sample rate
+// as a synth rendering at the sample rate, without the images of the tone above the internal Nyquist frequency,
+// and that its voices and their timing run at the internal rate
+
+#define RATE 48000
+#define FRAMES 4800
+#define PERIOD 48                   // a tone of 1 kHz at the sample rate
+#define RENDER_FRAMES 24000
+#define WINDOW 4800                 // analyzed once the attack is over
+
+static short data[FRAMES];
+
+// the magnitude of the frequency in the left channel of the last WINDOW frames, by the Goertzel algorithm
+static double magnitude(const float *buf, double freq)
+{
+    double coef = 2 * cos(2 * M_PI * freq / RATE), s1 = 0, s2 = 0;
+    int i;
+
+    for(i = RENDER_FRAMES - WINDOW; i < RENDER_FRAMES; i++)
+    {
+        double s = buf[2 * i] + coef * s1 - s2;
+
+        s2 = s1;
+        s1 = s;
+    }
+
+    return sqrt(s1 * s1 + s2 * s2 - coef * s1 * s2) / WINDOW;
+}
+
+// renders the tone in chunks of odd lengths
+static float *render(fluid_sample_t *sample, double internal_rate, double expected_rate)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_t *voice;
+    float *buf = FLUID_ARRAY(float, 2 * RENDER_FRAMES);
+    int i, len;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", RATE));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.internal-rate", internal_rate));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(synth->sample_rate == expected_rate);
+    TEST_ASSERT(synth->output_rate == RATE);
+
+    fluid_synth_api_enter(synth);
+    voice = fluid_synth_alloc_voice(synth, sample, 0, 60, 100);
+    TEST_ASSERT(voice != NULL);
+    fluid_voice_gen_set(voice, GEN_SAMPLEMODE, FLUID_LOOP_DURING_RELEASE);
+    fluid_synth_start_voice(synth, voice);
+    fluid_synth_api_exit(synth);
+
+    for(i = 0; i < RENDER_FRAMES; i += len)
+    {
+        len = (RENDER_FRAMES - i < 999) ? RENDER_FRAMES - i : 999;
+        TEST_SUCCESS(fluid_synth_write_float(synth, len, buf, 2 * i, 2, buf, 2 * i + 1, 2));
+    }
+
+    // the ticks count the frames rendered internally, a few blocks ahead of the output at most
+    i = (int)(RENDER_FRAMES * expected_rate / RATE);
+    len = fluid_atomic_int_get(&synth->ticks_since_start);
+    TEST_ASSERT(len >= i && len <= i + 3 * FLUID_BUFSIZE);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+int main(void)
+{
+    fluid_sample_t *sample = new_fluid_sample();
+    float *plain, *upsampled, *rejected;
+    double tone;
+    int i;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        data[i] = (short)(10000 * FLUID_SIN(2 * M_PI * i / PERIOD));
+    }
+
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, FRAMES, RATE, FALSE));
+    TEST_SUCCESS(fluid_sample_set_loop(sample, PERIOD, FRAMES - PERIOD));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    plain = render(sample, 0, RATE);
+    upsampled = render(sample, 24000, 24000);
+
+    // about 0.01, just make sure there is a tone to compare with
+    tone = magnitude(plain, 1000);
+    TEST_ASSERT(tone > 1e-3);
+    TEST_ASSERT(fabs(magnitude(upsampled, 1000) - tone) < 0.02 * tone);
+
+    // the image of the tone mirrored at 12 kHz is filtered out
+    TEST_ASSERT(magnitude(upsampled, 23000) < 1e-3 * tone);
+    FLUID_FREE(upsampled);
+
+    // by a ratio of 3 / 2, the image mirrored at 16 kHz to 31 kHz shows up at 17 kHz of the output
+    upsampled = render(sample, 32000, 32000);
+    TEST_ASSERT(fabs(magnitude(upsampled, 1000) - tone) < 0.02 * tone);
+    TEST_ASSERT(magnitude(upsampled, 17000) < 1e-3 * tone);
+
+    // a ratio of 48000 / 47999 isn't upsampled
+    rejected = render(sample, 47999, RATE);
+
+    for(i = 0; i < 2 * RENDER_FRAMES; i++)
+    {
+        TEST_ASSERT(rejected[i] == plain[i]);
+    }
+
+    FLUID_FREE(plain);
+    FLUID_FREE(upsampled);
+    FLUID_FREE(rejected);
+    delete_fluid_sample(sample);
+
+    return EXIT_SUCCESS;
+}
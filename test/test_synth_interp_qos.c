@@ -0,0 +1,85 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that quiet and released voices are rendered with linear interpolation
+// if synth.interp-qos.active is on, and that nothing changes for the other voices
+
+#define BLOCKS 64
+#define FRAMES (BLOCKS * FLUID_BUFSIZE)
+#define NOTEOFF_BLOCK 32
+
+static float left[3][FRAMES], right[3][FRAMES];
+
+// renders a note of a new synth playing with the given interpolation method,
+// a new synth for new settings, as it keeps being notified of their changes
+static void render(int qos, double attenuation, double release_time, int interp, float *l, float *r)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.interp-qos.active", qos));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.interp-qos.attenuation", attenuation));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.interp-qos.release-time", release_time));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        if(i == NOTEOFF_BLOCK)
+        {
+            TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, l, i * FLUID_BUFSIZE, 1,
+                                             r, i * FLUID_BUFSIZE, 1));
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+static int same(int a, int b, int from, int to)
+{
+    return memcmp(&left[a][from], &left[b][from], (to - from) * sizeof(float)) == 0
+           && memcmp(&right[a][from], &right[b][from], (to - from) * sizeof(float)) == 0;
+}
+
+int main(void)
+{
+    int i;
+
+    render(0, 600, 100, FLUID_INTERP_HIGHEST, left[0], right[0]);
+
+    // no voice is quiet enough to be downgraded
+    render(1, 1440, 10000, FLUID_INTERP_HIGHEST, left[1], right[1]);
+    TEST_ASSERT(same(0, 1, 0, FRAMES));
+
+    // every voice is quiet enough, from its very first block
+    render(1, 0, 10000, FLUID_INTERP_HIGHEST, left[1], right[1]);
+    render(0, 600, 100, FLUID_INTERP_LINEAR, left[2], right[2]);
+    TEST_ASSERT(same(1, 2, 0, FRAMES));
+    TEST_ASSERT(!same(0, 2, 0, FRAMES));
+
+    // the voices switch to linear interpolation with the release, crossfading to it
+    render(1, 1440, 0, FLUID_INTERP_HIGHEST, left[1], right[1]);
+    TEST_ASSERT(same(0, 1, 0, NOTEOFF_BLOCK * FLUID_BUFSIZE));
+    TEST_ASSERT(!same(0, 1, NOTEOFF_BLOCK * FLUID_BUFSIZE, FRAMES));
+
+    for(i = NOTEOFF_BLOCK * FLUID_BUFSIZE; i < FRAMES; i++)
+    {
+        TEST_ASSERT(left[1][i] - left[0][i] < 0.01f && left[0][i] - left[1][i] < 0.01f);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the levels measured by the meters of the mixer are the ones of the rendered
+// audio, and that they are measured anew after each call of fluid_synth_get_level()
+
+#define FRAMES 4096
+
+static void measure(const float *buf, double *peak, double *rms)
+{
+    double sum = 0;
+    int i;
+
+    *peak = 0;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        double x = fabs(buf[2 * i]);
+
+        *peak = (x > *peak) ? x : *peak;
+        sum += x * x;
+    }
+
+    *rms = sqrt(sum / FRAMES);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float *buf;
+    float peak, rms;
+    double expected_peak, expected_rms;
+    int chan;
+
+    buf = FLUID_ARRAY(float, 2 * FRAMES);
+    TEST_ASSERT(buf != NULL);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    // no meters by default
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_get_level(synth, FALSE, 0, &peak, &rms) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.level-meters", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_ASSERT(fluid_synth_get_level(synth, FALSE, -1, &peak, &rms) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_level(synth, FALSE, 2 * fluid_synth_count_audio_groups(synth), &peak, &rms) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_level(synth, TRUE, 2 * fluid_synth_count_effects_channels(synth) * fluid_synth_count_effects_groups(synth), &peak, &rms) == FLUID_FAILED);
+
+    // silence
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_SUCCESS(fluid_synth_get_level(synth, FALSE, 0, &peak, &rms));
+    TEST_ASSERT(peak == 0 && rms == 0);
+
+    for(chan = 0; chan < 2; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_get_level(synth, FALSE, chan, &peak, &rms));
+    }
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    for(chan = 0; chan < 2; chan++)
+    {
+        measure(buf + chan, &expected_peak, &expected_rms);
+        TEST_ASSERT(expected_rms > 0.001);
+
+        TEST_SUCCESS(fluid_synth_get_level(synth, FALSE, chan, &peak, &rms));
+        TEST_ASSERT(fabs(peak - expected_peak) < 1e-6);
+        TEST_ASSERT(fabs(rms - expected_rms) < 1e-6);
+
+        // nothing rendered since, the same levels
+        TEST_SUCCESS(fluid_synth_get_level(synth, FALSE, chan, &peak, &rms));
+        TEST_ASSERT(fabs(peak - expected_peak) < 1e-6);
+        TEST_ASSERT(fabs(rms - expected_rms) < 1e-6);
+    }
+
+    // the reverb send of the voice
+    TEST_SUCCESS(fluid_synth_get_level(synth, TRUE, 0, &peak, &rms));
+    TEST_ASSERT(peak > 0 && rms > 0 && rms <= peak);
+
+    // measured anew after a read
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    measure(buf, &expected_peak, &expected_rms);
+    TEST_SUCCESS(fluid_synth_get_level(synth, FALSE, 0, &peak, &rms));
+    TEST_ASSERT(fabs(peak - expected_peak) < 1e-6);
+    TEST_ASSERT(fabs(rms - expected_rms) < 1e-6);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    FLUID_FREE(buf);
+
+    return EXIT_SUCCESS;
+}
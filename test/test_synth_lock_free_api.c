@@ -0,0 +1,105 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that events sent through the lock-free API are processed in order and none of them get lost
+
+#define NUM_THREADS 4
+#define NUM_EVENTS 5000
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    int chan;
+} sender_t;
+
+static fluid_thread_return_t send_events(void *data)
+{
+    sender_t *sender = data;
+    int i;
+
+    for(i = 0; i < NUM_EVENTS; i++)
+    {
+        // more events than the queue can hold, so that sending falls back to the mutex from time to time
+        TEST_SUCCESS(fluid_synth_cc(sender->synth, sender->chan, 10, i % 128));
+        TEST_SUCCESS(fluid_synth_pitch_bend(sender->synth, sender->chan, i % 16384));
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_thread_t *threads[NUM_THREADS];
+    sender_t senders[NUM_THREADS];
+    float left[1024], right[1024];
+    int i, val;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-free-api", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(synth->api_queue != NULL);
+
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    // errors in the arguments are still reported immediately
+    TEST_ASSERT(fluid_synth_cc(synth, 0, 128, 0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_noteon(synth, -1, 60, 100) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_noteon(synth, fluid_synth_count_midi_channels(synth), 60, 100) == FLUID_FAILED);
+
+    // queued events are visible to any subsequent call of the API
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 42));
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &val));
+    TEST_ASSERT(val == 42);
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_SUCCESS(fluid_synth_write_float(synth, 1024, left, 0, 1, right, 0, 1));
+
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        senders[i].synth = synth;
+        senders[i].chan = i + 1;
+        threads[i] = new_fluid_thread("lock-free-api-test", send_events, &senders[i], 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        TEST_SUCCESS(fluid_thread_join(threads[i]));
+        delete_fluid_thread(threads[i]);
+    }
+
+    // each channel has been sent to by a single thread only, so it must end up with the last values sent
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_get_cc(synth, i + 1, 10, &val));
+        TEST_ASSERT(val == (NUM_EVENTS - 1) % 128);
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, i + 1, &val));
+        TEST_ASSERT(val == (NUM_EVENTS - 1) % 16384);
+    }
+
+    delete_fluid_synth(synth);
+
+    // without the mutex, the events are processed right away
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.threadsafe-api", 0));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(synth->api_queue == NULL);
+    TEST_ASSERT(fluid_synth_noteon(synth, 0, 60, 100) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the memory statistics account for the SoundFonts, telling the sample data shared
+// with the ones of another synth from the private ones, and for the voices, the mixer and the effects units
+
+static fluid_synth_t *create_synth(fluid_settings_t **settings, int polyphony, int cores)
+{
+    fluid_synth_t *synth;
+
+    *settings = new_fluid_settings();
+    TEST_ASSERT(*settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.polyphony", polyphony));
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.cpu-cores", cores));
+    synth = new_fluid_synth(*settings);
+    TEST_ASSERT(synth != NULL);
+
+    return synth;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings, *other_settings;
+    fluid_synth_t *synth, *other;
+    size_t bytes[FLUID_SYNTH_MEMORY_LAST + 1], all[FLUID_SYNTH_MEMORY_LAST], samples;
+    int id, i;
+
+    synth = create_synth(&settings, 64, 1);
+
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, -1, bytes, FLUID_SYNTH_MEMORY_LAST));
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SAMPLES_SHARED] == 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE] == 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SOUNDFONTS] == 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_VOICES] > 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_MIXER] > 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_MIXER_THREADS] == 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_REVERB] > 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_CHORUS] > 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_LADSPA] == 0);
+
+    // no such SoundFont yet
+    TEST_ASSERT(fluid_synth_get_memory_stats(synth, 1, bytes, FLUID_SYNTH_MEMORY_LAST) == FLUID_FAILED);
+
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, -1, all, FLUID_SYNTH_MEMORY_LAST));
+    samples = all[FLUID_SYNTH_MEMORY_SAMPLES_SHARED] + all[FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE];
+    TEST_ASSERT(all[FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE] > 0);
+    TEST_ASSERT(all[FLUID_SYNTH_MEMORY_SAMPLES_LOCKED] <= samples);
+    TEST_ASSERT(all[FLUID_SYNTH_MEMORY_SOUNDFONTS] > 0);
+
+    // the only SoundFont
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, id, bytes, FLUID_SYNTH_MEMORY_LAST));
+
+    for(i = 0; i < FLUID_SYNTH_MEMORY_LAST; i++)
+    {
+        TEST_ASSERT(bytes[i] == all[i]);
+    }
+
+    // only as many as asked for
+    bytes[2] = 42;
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, id, bytes, 2));
+    TEST_ASSERT(bytes[2] == 42);
+
+    // more voices, the same SoundFont loaded by another synth shares the sample data
+#if ENABLE_MIXER_THREADS
+    other = create_synth(&other_settings, 256, 2);
+#else
+    other = create_synth(&other_settings, 256, 1);
+#endif
+    TEST_ASSERT(fluid_synth_sfload(other, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, -1, bytes, FLUID_SYNTH_MEMORY_LAST));
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SAMPLES_SHARED] > 0);
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SAMPLES_SHARED] + bytes[FLUID_SYNTH_MEMORY_SAMPLES_PRIVATE] == samples);
+
+    TEST_SUCCESS(fluid_synth_get_memory_stats(other, -1, bytes, FLUID_SYNTH_MEMORY_LAST));
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_VOICES] > all[FLUID_SYNTH_MEMORY_VOICES]);
+#if ENABLE_MIXER_THREADS
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_MIXER_THREADS] > 0);
+#endif
+
+    delete_fluid_synth(other);
+    delete_fluid_settings(other_settings);
+
+    // private again
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, -1, bytes, FLUID_SYNTH_MEMORY_LAST));
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SAMPLES_SHARED] == all[FLUID_SYNTH_MEMORY_SAMPLES_SHARED]);
+
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 1));
+    TEST_SUCCESS(fluid_synth_get_memory_stats(synth, -1, bytes, FLUID_SYNTH_MEMORY_LAST));
+    TEST_ASSERT(bytes[FLUID_SYNTH_MEMORY_SOUNDFONTS] == 0);
+    TEST_ASSERT(fluid_synth_get_memory_stats(synth, id, bytes, FLUID_SYNTH_MEMORY_LAST) == FLUID_FAILED);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
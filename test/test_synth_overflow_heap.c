@@ -0,0 +1,208 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the heap used for voice stealing is kept up to date,
+// so that the voice with the lowest overflow priority is found without scanning all voices
+
+#define POLYPHONY 16
+
+static void verify_overflow_heap(fluid_synth_t *synth)
+{
+    int i;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->overflow_heap[i];
+
+        TEST_ASSERT(voice->overflow_heap_index == i);
+
+        // the heap property
+        if(i > 0)
+        {
+            TEST_ASSERT(synth->overflow_heap[(i - 1) / 2]->overflow_prio <= voice->overflow_prio);
+        }
+
+        // the key must match the current state of the voice
+        if(_AVAILABLE(voice))
+        {
+            TEST_ASSERT(voice->overflow_prio < -OVERFLOW_PRIO_CANNOT_KILL + 1);
+        }
+        else if(!voice->can_access_overflow_rvoice)
+        {
+            TEST_ASSERT(voice->overflow_prio == (float)OVERFLOW_PRIO_CANNOT_KILL);
+        }
+        else
+        {
+            TEST_ASSERT(voice->overflow_prio == fluid_voice_get_overflow_prio_base(voice, &synth->overflow));
+        }
+    }
+}
+
+// finds the lowest overflow priority among the voices which may be stolen by scanning all of them,
+// also storing the priority of each voice
+static float lowest_overflow_prio(fluid_synth_t *synth, float *prios, int *available)
+{
+    int i;
+    float prio, lowest = OVERFLOW_PRIO_CANNOT_KILL;
+    unsigned int ticks = fluid_atomic_int_get(&synth->ticks_since_start);
+
+    *available = 0;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        prios[i] = OVERFLOW_PRIO_CANNOT_KILL;
+
+        if(_AVAILABLE(voice))
+        {
+            (*available)++;
+            continue;
+        }
+
+        if(voice->overflow_prio >= OVERFLOW_PRIO_CANNOT_KILL)
+        {
+            continue;
+        }
+
+        prio = voice->overflow_prio + fluid_voice_get_overflow_prio_age(voice, &synth->overflow, ticks);
+        prios[i] = prio;
+
+        if(prio < lowest)
+        {
+            lowest = prio;
+        }
+    }
+
+    return lowest;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    unsigned int ids[2 * POLYPHONY];
+    float prios[2 * POLYPHONY];
+    int i, j, key, available, started, stolen;
+    float lowest;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    verify_overflow_heap(synth);
+
+    // play many more notes than there are voices, some of them sustained,
+    // released or attenuated, so that voices are constantly being stolen
+    for(i = 0; i < 40 * POLYPHONY; i++)
+    {
+        int chan = i % 3;
+        key = 30 + (i * 7) % 60;
+
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 1 + (i * 13) % 127));
+        verify_overflow_heap(synth);
+
+        if(i % 5 == 0)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, chan, 64, (i % 10) ? 127 : 0));
+            verify_overflow_heap(synth);
+        }
+
+        if(i % 7 == 0)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, chan, 7, (i * 31) % 128));
+            verify_overflow_heap(synth);
+        }
+
+        if(i % 3 == 0)
+        {
+            fluid_synth_noteoff(synth, chan, key);
+            verify_overflow_heap(synth);
+        }
+
+        if(i % 50 == 0)
+        {
+            TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.sustained", -(double)i));
+            verify_overflow_heap(synth);
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        verify_overflow_heap(synth);
+    }
+
+    // changing the polyphony rebuilds the heap
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY / 2));
+    verify_overflow_heap(synth);
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 2 * POLYPHONY));
+    verify_overflow_heap(synth);
+
+    for(i = 0; i < 4 * POLYPHONY; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 30 + i % 60, 100));
+        verify_overflow_heap(synth);
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        verify_overflow_heap(synth);
+    }
+
+    // a negative age score prefers stealing the newest voices, whose age part
+    // may take their priority well below the key of the heap's root
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.age", -10000));
+    verify_overflow_heap(synth);
+
+    for(i = 0; i < 8 * POLYPHONY; i++)
+    {
+        // the voices finished by the last block are only collected when the API is entered
+        TEST_ASSERT(fluid_synth_get_active_voice_count(synth) >= 0);
+        lowest = lowest_overflow_prio(synth, prios, &available);
+
+        for(j = 0; j < synth->polyphony; j++)
+        {
+            ids[j] = fluid_voice_get_id(synth->voice[j]);
+        }
+
+        // no note is repeated, which would release the voices playing it before stealing one
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 8, 20 + i % 90, 1 + (i * 13) % 127));
+        verify_overflow_heap(synth);
+
+        if(i % 4 == 0)
+        {
+            fluid_synth_noteoff(synth, i % 8, 20 + i % 90);
+            verify_overflow_heap(synth);
+        }
+
+        // once all voices are busy, one of those with the lowest priority must have been stolen,
+        // if the note started any voice at all
+        if(available == 0)
+        {
+            started = stolen = 0;
+
+            for(j = 0; j < synth->polyphony; j++)
+            {
+                if(fluid_voice_get_id(synth->voice[j]) != ids[j])
+                {
+                    started = 1;
+                    stolen |= (prios[j] == lowest);
+                }
+            }
+
+            TEST_ASSERT(!started || stolen);
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        verify_overflow_heap(synth);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that synth.polyphony-max allocates all the voices up front, and that raising the
+// polyphony up to it plays as many voices without growing the voice array. The rvoices are stored
+// contiguously, each of them on its own cache line.
+
+#define POLYPHONY 16
+#define POLYPHONY_MAX 64
+#define FRAMES 1024
+
+static void render(fluid_synth_t *synth)
+{
+    static float left[FRAMES], right[FRAMES];
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+}
+
+static void play(fluid_synth_t *synth, int voices)
+{
+    int i;
+
+    // a note may start several voices
+    for(i = 0; fluid_synth_get_active_voice_count(synth) < voices; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 16, 40 + i / 16, 100));
+    }
+
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == voices);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_voice_t **voices;
+    char *last = NULL;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony-max", POLYPHONY_MAX));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_ASSERT(synth->nvoice == POLYPHONY_MAX);
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == POLYPHONY);
+
+    // the rvoice and overflow rvoice of a voice may have been swapped, but are next to each other
+    for(i = 0; i < synth->nvoice; i++)
+    {
+        fluid_rvoice_t *rvoice = synth->voice[i]->rvoice;
+        fluid_rvoice_t *overflow_rvoice = synth->voice[i]->overflow_rvoice;
+        char *first = (char *)(rvoice < overflow_rvoice ? rvoice : overflow_rvoice);
+        char *second = (char *)(rvoice < overflow_rvoice ? overflow_rvoice : rvoice);
+
+        TEST_ASSERT(fluid_align_ptr(first, FLUID_DEFAULT_ALIGNMENT) == first);
+        TEST_ASSERT(fluid_align_ptr(second, FLUID_DEFAULT_ALIGNMENT) == second);
+        TEST_ASSERT((size_t)(second - first) < sizeof(fluid_rvoice_t) + FLUID_DEFAULT_ALIGNMENT);
+
+        if(i > 0)
+        {
+            TEST_ASSERT(first > last);
+        }
+
+        last = second;
+    }
+    play(synth, POLYPHONY);
+
+    // within the reservation, the voices are the ones allocated before
+    voices = synth->voice;
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY_MAX));
+    TEST_ASSERT(synth->voice == voices);
+    TEST_ASSERT(synth->nvoice == POLYPHONY_MAX);
+    play(synth, POLYPHONY_MAX);
+
+    // lowering and raising it again turns voices off, but frees nothing
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= POLYPHONY);
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY_MAX));
+    TEST_ASSERT(synth->voice == voices);
+
+    // beyond the reservation, the polyphony still grows
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 2 * POLYPHONY_MAX));
+    TEST_ASSERT(synth->nvoice == 2 * POLYPHONY_MAX);
+    play(synth, 2 * POLYPHONY_MAX);
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    render(synth);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    // without reservation, only synth.polyphony voices are allocated
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(synth->nvoice == POLYPHONY);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
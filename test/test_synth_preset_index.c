@@ -0,0 +1,142 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the presets found by bank and program numbers follow the SoundFonts being
+// loaded, unloaded, added and removed, and their bank offsets, although they are taken from the index
+
+#define CUSTOM_BANK 5
+
+static fluid_preset_t *custom_preset;
+
+static const char *custom_get_name(fluid_sfont_t *sfont)
+{
+    return "custom";
+}
+
+static const char *custom_preset_get_name(fluid_preset_t *preset)
+{
+    return "custom preset";
+}
+
+static int custom_preset_get_banknum(fluid_preset_t *preset)
+{
+    return CUSTOM_BANK;
+}
+
+static int custom_preset_get_num(fluid_preset_t *preset)
+{
+    return 0;
+}
+
+static int custom_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key, int vel)
+{
+    return FLUID_OK;
+}
+
+static void custom_preset_free(fluid_preset_t *preset)
+{
+    delete_fluid_preset(preset);
+}
+
+static fluid_preset_t *custom_get_preset(fluid_sfont_t *sfont, int bank, int prenum)
+{
+    return (bank == CUSTOM_BANK && prenum == 0) ? custom_preset : NULL;
+}
+
+static int custom_free(fluid_sfont_t *sfont)
+{
+    delete_fluid_preset(custom_preset);
+    return delete_fluid_sfont(sfont);
+}
+
+// the ID of the SoundFont of the preset found, FLUID_FAILED for none
+static int find(fluid_synth_t *synth, int bank, int prog)
+{
+    fluid_preset_t *preset;
+    int id;
+
+    fluid_synth_api_enter(synth);
+    preset = fluid_synth_find_preset(synth, bank, prog);
+    id = (preset != NULL) ? fluid_sfont_get_id(fluid_preset_get_sfont(preset)) : FLUID_FAILED;
+    fluid_synth_api_exit(synth);
+
+    return id;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfont_t *custom;
+    int id1, id2, id3;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // nothing is found before loading a SoundFont, and the misses are forgotten on load
+    TEST_ASSERT(find(synth, 0, 0) == FLUID_FAILED);
+
+    id1 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id1 != FLUID_FAILED);
+    TEST_ASSERT(find(synth, 0, 0) == id1);
+    TEST_ASSERT(find(synth, 0, 0) == id1);
+
+    // the SoundFont on top hides the one below
+    id2 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id2 != FLUID_FAILED);
+    TEST_ASSERT(find(synth, 0, 0) == id2);
+
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id1, 0, 0));
+    TEST_ASSERT(fluid_sfont_get_id(fluid_preset_get_sfont(fluid_synth_get_channel_preset(synth, 0))) == id1);
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id2, 0, 0));
+    TEST_ASSERT(fluid_sfont_get_id(fluid_preset_get_sfont(fluid_synth_get_channel_preset(synth, 0))) == id2);
+
+    // moving the presets of the SoundFont on top uncovers the ones below
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id2, 100));
+    TEST_ASSERT(find(synth, 0, 0) == id1);
+    TEST_ASSERT(find(synth, 100, 0) == id2);
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id2, 0));
+    TEST_ASSERT(find(synth, 0, 0) == id2);
+
+    // a SoundFont reloaded keeps its place
+    TEST_ASSERT(fluid_synth_sfreload(synth, id1) == id1);
+    TEST_ASSERT(find(synth, 0, 0) == id2);
+    TEST_ASSERT(fluid_synth_sfreload(synth, id2) == id2);
+    TEST_ASSERT(find(synth, 0, 0) == id2);
+
+    // unloading the SoundFont on top uncovers the one below
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id2, 1));
+    TEST_ASSERT(find(synth, 0, 0) == id1);
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(fluid_sfont_get_id(fluid_preset_get_sfont(fluid_synth_get_channel_preset(synth, 0))) == id1);
+
+    // a SoundFont without preset iteration added on top of the missing preset
+    TEST_ASSERT(find(synth, CUSTOM_BANK, 0) == FLUID_FAILED);
+
+    custom = new_fluid_sfont(custom_get_name, custom_get_preset, NULL, NULL, custom_free);
+    TEST_ASSERT(custom != NULL);
+    custom_preset = new_fluid_preset(custom, custom_preset_get_name, custom_preset_get_banknum,
+                                     custom_preset_get_num, custom_preset_noteon, custom_preset_free);
+    TEST_ASSERT(custom_preset != NULL);
+
+    id3 = fluid_synth_add_sfont(synth, custom);
+    TEST_ASSERT(id3 != FLUID_FAILED);
+    TEST_ASSERT(find(synth, CUSTOM_BANK, 0) == id3);
+    TEST_ASSERT(find(synth, 0, 0) == id1);
+
+    TEST_SUCCESS(fluid_synth_remove_sfont(synth, custom));
+    TEST_ASSERT(find(synth, CUSTOM_BANK, 0) == FLUID_FAILED);
+    TEST_ASSERT(find(synth, 0, 0) == id1);
+
+    // the synth only frees the SoundFonts on its stack
+    TEST_ASSERT(fluid_synth_add_sfont(synth, custom) != FLUID_FAILED);
+    TEST_ASSERT(find(synth, CUSTOM_BANK, 0) != FLUID_FAILED);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
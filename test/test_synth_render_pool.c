@@ -0,0 +1,131 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that synths sharing the workers of the render pool render the same
+// audio as a synth rendering on its own, also when rendered concurrently by several threads
+// and when joining the pool after it has been started with another number of workers
+
+#define FRAMES 4096
+#define GROUPS 8
+#define SYNTHS 4
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    float buf[2 * FRAMES];
+} render_job_t;
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    int chan, key;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // enough voices for all workers, each channel routed to its own effects group
+    for(chan = 0; chan < GROUPS; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 91, 40 + 5 * chan));
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 93, 100 - 5 * chan));
+
+        for(key = 0; key < 6; key++)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, 36 + 7 * key + chan, 100));
+        }
+    }
+
+    return synth;
+}
+
+static fluid_thread_return_t render(void *data)
+{
+    render_job_t *job = data;
+
+    TEST_SUCCESS(fluid_synth_write_float(job->synth, FRAMES, job->buf, 0, 2, job->buf, 1, 2));
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+static void compare(const float *ref, const float *buf)
+{
+    double energy = 0;
+    int i;
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        // the voices are mixed in another order by the workers
+        TEST_ASSERT(FLUID_FABS(ref[i] - buf[i]) < 1e-5);
+        energy += ref[i] * ref[i];
+    }
+
+    TEST_ASSERT(energy > 0);
+}
+
+int main(void)
+{
+    static render_job_t ref, jobs[SYNTHS];
+    fluid_thread_t *threads[SYNTHS];
+    fluid_settings_t *settings = new_fluid_settings();
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", GROUPS));
+
+    ref.synth = create_synth(settings);
+    render(&ref);
+    delete_fluid_synth(ref.synth);
+
+    // the last synths join the pool started by the first one, without mixer threads they render on their own
+#if ENABLE_MIXER_THREADS
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.render-pool", 3));
+#endif
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+#if ENABLE_MIXER_THREADS
+        if(i == SYNTHS / 2)
+        {
+            TEST_SUCCESS(fluid_settings_setint(settings, "synth.render-pool", 1));
+            TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-cores-scheduler", "work-stealing"));
+        }
+#endif
+
+        jobs[i].synth = create_synth(settings);
+    }
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+        threads[i] = new_fluid_thread("render", render, &jobs[i], 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+        compare(ref.buf, jobs[i].buf);
+    }
+
+    // a synth joins the pool while the others are still in it
+    delete_fluid_synth(jobs[0].synth);
+    jobs[0].synth = create_synth(settings);
+    render(&jobs[0]);
+    compare(ref.buf, jobs[0].buf);
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+        delete_fluid_synth(jobs[i].synth);
+    }
+
+    // the pool was stopped along with its last synth, a new one is started
+    jobs[0].synth = create_synth(settings);
+    render(&jobs[0]);
+    compare(ref.buf, jobs[0].buf);
+    delete_fluid_synth(jobs[0].synth);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
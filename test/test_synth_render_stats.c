@@ -0,0 +1,108 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the rendering statistics count every rendering call,
+// the voices that had to be stolen and the voice events queued, and that they can be reset
+
+#define POLYPHONY 4
+#define NUM_CALLS 100
+
+// the blocks after which a voice is old enough to be stolen: the age part of its overflow priority
+// stays above OVERFLOW_PRIO_CANNOT_KILL for the first 45 samples with the default scores
+#define NOTE_BLOCKS ((64 + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE)
+
+static void test_stats(int cores)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    unsigned int histogram[FLUID_SYNTH_RENDER_HISTOGRAM_SIZE + 1];
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    unsigned int sum;
+    int i, calls = 0;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_RENDER_CALLS) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_STOLEN_VOICES) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, -1) == -1);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_LAST) == -1);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_EVENT_QUEUE_DEPTH) > 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_EVENT_QUEUE_DEPTH) > 0);
+
+    // more notes than the polyphony allows, a voice can only be stolen once it is old enough
+    for(i = 1; i < 2 * POLYPHONY; i++)
+    {
+        for(; calls < i * NOTE_BLOCKS; calls++)
+        {
+            TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        }
+
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60 + i, 100));
+    }
+
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_STOLEN_VOICES) >= POLYPHONY);
+
+    for(; calls < NUM_CALLS; calls++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_RENDER_CALLS) == NUM_CALLS);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_EVENT_QUEUE_DEPTH) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_VOICES) > 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_VOICES) <= POLYPHONY);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_DSP_LOAD) >= 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_DSP_LOAD)
+                >= fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_DSP_LOAD));
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_MIXER_WAIT) >= 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_MIXER_WAIT) <= 100);
+
+    // every call is counted in exactly one bucket, the last one holds the xruns
+    histogram[FLUID_SYNTH_RENDER_HISTOGRAM_SIZE] = 12345;
+    TEST_SUCCESS(fluid_synth_get_render_histogram(synth, histogram, FLUID_SYNTH_RENDER_HISTOGRAM_SIZE + 1));
+    TEST_ASSERT(histogram[FLUID_SYNTH_RENDER_HISTOGRAM_SIZE] == 12345);
+
+    for(i = 0, sum = 0; i < FLUID_SYNTH_RENDER_HISTOGRAM_SIZE; i++)
+    {
+        sum += histogram[i];
+    }
+
+    TEST_ASSERT(sum == NUM_CALLS);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_XRUNS) == histogram[FLUID_SYNTH_RENDER_HISTOGRAM_SIZE - 1]);
+
+    fluid_synth_reset_stats(synth);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_RENDER_CALLS) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_DSP_LOAD) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_VOICES) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_STOLEN_VOICES) == 0);
+    TEST_ASSERT(fluid_synth_get_stat(synth, FLUID_SYNTH_STAT_PEAK_EVENT_QUEUE_DEPTH) == 0);
+    TEST_SUCCESS(fluid_synth_get_render_histogram(synth, histogram, FLUID_SYNTH_RENDER_HISTOGRAM_SIZE));
+
+    for(i = 0; i < FLUID_SYNTH_RENDER_HISTOGRAM_SIZE; i++)
+    {
+        TEST_ASSERT(histogram[i] == 0);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    test_stats(1);
+#if ENABLE_MIXER_THREADS
+    test_stats(2);
+#endif
+
+    return EXIT_SUCCESS;
+}
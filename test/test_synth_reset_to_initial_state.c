@@ -0,0 +1,87 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that a synth reset by fluid_synth_reset_to_initial_state() sounds the same as
+// a synth just created, whatever was changed on it before
+
+#define FRAMES 8192
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 36, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *fresh, *synth;
+    fluid_mod_t *mod = new_fluid_mod();
+    float *expected = FLUID_ARRAY(float, 2 * FRAMES), *buf = FLUID_ARRAY(float, 2 * FRAMES);
+    double pitch[12] = { 0 };
+    int i, bank, prog;
+
+    TEST_ASSERT(settings != NULL && mod != NULL);
+    TEST_ASSERT(expected != NULL && buf != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 0.5));
+
+    fresh = new_fluid_synth(settings);
+    TEST_ASSERT(fresh != NULL);
+    TEST_ASSERT(fluid_synth_sfload(fresh, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    render(fresh, expected);
+    delete_fluid_synth(fresh);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // changes all around, the notes still sounding
+    TEST_SUCCESS(fluid_synth_activate_octave_tuning(synth, 0, 0, "quarter", pitch, TRUE));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 0, 0, 0, TRUE));
+    TEST_SUCCESS(fluid_synth_set_channel_type(synth, 1, CHANNEL_TYPE_DRUM));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 5));
+    TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, 0));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 20));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, 6000));
+    TEST_SUCCESS(fluid_synth_reset_basic_channel(synth, -1));
+    TEST_SUCCESS(fluid_synth_set_basic_channel(synth, 0, FLUID_CHANNEL_MODE_OMNIOFF_MONO, 4));
+    fluid_mod_set_source1(mod, FLUID_MOD_VELOCITY, FLUID_MOD_GC | FLUID_MOD_CONCAVE | FLUID_MOD_UNIPOLAR | FLUID_MOD_NEGATIVE);
+    fluid_mod_set_source2(mod, 0, 0);
+    fluid_mod_set_dest(mod, GEN_ATTENUATION);
+    TEST_SUCCESS(fluid_synth_remove_default_mod(synth, mod));
+    fluid_synth_set_gain(synth, 2.0f);
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 16));
+    TEST_SUCCESS(fluid_synth_set_reverb_roomsize(synth, 0.9));
+    TEST_SUCCESS(fluid_synth_set_chorus_nr(synth, 7));
+    fluid_synth_set_chorus_on(synth, FALSE);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 36, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_SUCCESS(fluid_synth_write_float(synth, 100, buf, 0, 2, buf, 1, 2));
+
+    TEST_SUCCESS(fluid_synth_reset_to_initial_state(synth));
+    TEST_ASSERT(fluid_atomic_int_get(&synth->ticks_since_start) == 0);
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == 256);
+    TEST_ASSERT(fluid_synth_get_gain(synth) == 0.5f);
+    fluid_synth_tuning_iteration_start(synth);
+    TEST_ASSERT(fluid_synth_tuning_iteration_next(synth, &bank, &prog) == 0);
+    TEST_SUCCESS(fluid_synth_get_program(synth, 0, &i, &bank, &prog));
+    TEST_ASSERT(bank == 0 && prog == 0);
+
+    render(synth, buf);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(buf[i] == expected[i]);
+    }
+
+    delete_fluid_mod(mod);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    FLUID_FREE(expected);
+    FLUID_FREE(buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a synth restoring the state saved by another one renders exactly the same
+// audio from there on as the synth saving it, with the voices, tunings, controllers and effects it had
+
+#define FRAMES 8192
+#define BLOCK 64
+
+// the leading fields of the header of a state, see fluid_synth_state_t
+typedef struct
+{
+    char magic[4];
+    int version;
+    unsigned short real_size;
+    unsigned short channel_size;
+    unsigned short voice_size;
+    unsigned short tuning_size;
+    int midi_channels;
+    int effects_groups;
+    double sample_rate;
+    int tuning_count;
+    int voice_count;
+    unsigned int fx_size;
+} state_header_t;
+
+static fluid_synth_t *create_synth(fluid_settings_t **settings)
+{
+    fluid_synth_t *synth;
+
+    *settings = new_fluid_settings();
+    TEST_ASSERT(*settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.reverb.active", 1));
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.chorus.active", 1));
+    synth = new_fluid_synth(*settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+// a state with a field of its header or of a record replaced is rejected, leaving the synth alone
+static void expect_corrupted(fluid_synth_t *synth, const char *state, size_t size, size_t offset,
+                             const void *value, size_t len)
+{
+    int voices = fluid_synth_get_active_voice_count(synth);
+    char *copy = FLUID_ARRAY(char, size);
+
+    TEST_ASSERT(copy != NULL);
+    FLUID_MEMCPY(copy, state, size);
+    FLUID_MEMCPY(copy + offset, value, len);
+    TEST_ASSERT(fluid_synth_restore_state(synth, copy, size) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == voices);
+    FLUID_FREE(copy);
+}
+
+static void expect_corrupted_int(fluid_synth_t *synth, const char *state, size_t size, size_t offset, int value)
+{
+    expect_corrupted(synth, state, size, offset, &value, sizeof(value));
+}
+
+static void expect_corrupted_byte(fluid_synth_t *synth, const char *state, size_t size, size_t offset,
+                                  unsigned char value)
+{
+    expect_corrupted(synth, state, size, offset, &value, sizeof(value));
+}
+
+static void check_corrupted_states(fluid_synth_t *synth, const char *state, size_t size)
+{
+    state_header_t header;
+    size_t header_size, tunings, voices;
+
+    FLUID_MEMCPY(&header, state, sizeof(header));
+    TEST_ASSERT(header.tuning_count > 0 && header.voice_count > 0);
+    header_size = size - header.midi_channels * header.channel_size - 2 * header.effects_groups * sizeof(double)
+                  - header.tuning_count * header.tuning_size - header.voice_count * header.voice_size
+                  - header.fx_size;
+    tunings = header_size + header.midi_channels * header.channel_size + 2 * header.effects_groups * sizeof(double);
+    voices = tunings + header.tuning_count * header.tuning_size;
+
+    // truncated
+    TEST_ASSERT(fluid_synth_restore_state(synth, state, 0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_restore_state(synth, state, header_size - 1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_restore_state(synth, state, header_size) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_restore_state(synth, state, size - 1) == FLUID_FAILED);
+
+    // counts overflowing the size of the state, negative or out of range
+    expect_corrupted_int(synth, state, size, offsetof(state_header_t, voice_count), 0x7FFFFFFF);
+    expect_corrupted_int(synth, state, size, offsetof(state_header_t, voice_count), -1);
+    expect_corrupted_int(synth, state, size, offsetof(state_header_t, tuning_count), 0x40000000);
+    expect_corrupted_int(synth, state, size, offsetof(state_header_t, tuning_count), -header.tuning_count);
+    expect_corrupted_int(synth, state, size, offsetof(state_header_t, midi_channels), -header.midi_channels);
+    expect_corrupted_int(synth, state, size, offsetof(state_header_t, fx_size), -1);
+
+    // records with fields indexing the synth out of range: the monophonic list of
+    // channel 0, the bank of the first tuning, the channel and the key of the first voice
+    expect_corrupted_byte(synth, state, size, header_size + 2 * sizeof(int), 200);
+    expect_corrupted_int(synth, state, size, tunings, 300);
+    expect_corrupted_byte(synth, state, size, voices + 2 * sizeof(int) + 1, 200);
+    expect_corrupted_byte(synth, state, size, voices + 2 * sizeof(int) + 2, 200);
+}
+
+// the rest of the song, played the same way by both synths
+static void render(fluid_synth_t *synth, float *buf)
+{
+    int pos;
+
+    for(pos = 0; pos < FRAMES; pos += BLOCK)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, buf, 2 * pos, 2, buf, 2 * pos + 1, 2));
+
+        if(pos == FRAMES / 4)
+        {
+            fluid_synth_noteoff(synth, 0, 60);
+            TEST_SUCCESS(fluid_synth_pitch_bend(synth, 1, 10000));
+        }
+
+        if(pos == FRAMES / 2)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, 2, 72, 90));
+            TEST_SUCCESS(fluid_synth_cc(synth, 1, 7, 60));
+        }
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings, *other_settings;
+    fluid_synth_t *synth, *other;
+    float *expected, *restored;
+    double pitch[128], peak = 0;
+    char *state;
+    size_t size, small;
+    int i;
+
+    synth = create_synth(&settings);
+    other = create_synth(&other_settings);
+    expected = FLUID_ARRAY(float, 2 * FRAMES);
+    restored = FLUID_ARRAY(float, 2 * FRAMES);
+    TEST_ASSERT(expected != NULL && restored != NULL);
+
+    for(i = 0; i < 128; i++)
+    {
+        pitch[i] = i * 100.0 + (i % 12) * 7.0;
+    }
+
+    TEST_SUCCESS(fluid_synth_activate_key_tuning(synth, 1, 2, "stretched", pitch, FALSE));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 1, 1, 2, FALSE));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 1, 5));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 10, 20));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 127));
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, 93, 100));
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, 1, 80));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 64, 80));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 67, 70));
+
+    // into the notes, the delay lines of the effects filled
+    render(synth, expected);
+
+    // the size only, then too small a buffer
+    TEST_SUCCESS(fluid_synth_save_state(synth, NULL, &size));
+    TEST_ASSERT(size > 0);
+    state = FLUID_ARRAY(char, size);
+    TEST_ASSERT(state != NULL);
+    small = size - 1;
+    TEST_ASSERT(fluid_synth_save_state(synth, state, &small) == FLUID_FAILED);
+    TEST_ASSERT(small == size);
+
+    TEST_SUCCESS(fluid_synth_save_state(synth, state, &size));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    // neither truncated nor corrupted states are restored
+    TEST_ASSERT(fluid_synth_restore_state(other, state, size - 1) == FLUID_FAILED);
+    state[0] ^= 1;
+    TEST_ASSERT(fluid_synth_restore_state(other, state, size) == FLUID_FAILED);
+    state[0] ^= 1;
+
+    // the other synth played something else before
+    TEST_SUCCESS(fluid_synth_noteon(other, 3, 40, 127));
+    render(other, restored);
+    check_corrupted_states(other, state, size);
+
+    TEST_SUCCESS(fluid_synth_restore_state(other, state, size));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(other) == fluid_synth_get_active_voice_count(synth));
+
+    render(synth, expected);
+    render(other, restored);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(restored[i] == expected[i]);
+        peak = (fabs(expected[i]) > peak) ? fabs(expected[i]) : peak;
+    }
+
+    TEST_ASSERT(peak > 0.01);
+
+    // the same synth goes back to the state as well
+    TEST_SUCCESS(fluid_synth_restore_state(synth, state, size));
+    render(synth, restored);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(restored[i] == expected[i]);
+    }
+
+    FLUID_FREE(state);
+    FLUID_FREE(expected);
+    FLUID_FREE(restored);
+    delete_fluid_synth(other);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(other_settings);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a SoundFont loaded by fluid_synth_sfload_async() is put on the
+// SoundFont stack once loaded, while the API can be used meanwhile, and that the callback is
+// called with its ID, or with FLUID_FAILED if it can't be loaded
+
+typedef struct
+{
+    int done;
+    int sfont_id;
+    int sfcount;
+} load_result_t;
+
+static void on_loaded(void *data, fluid_synth_t *synth, int sfont_id)
+{
+    load_result_t *result = data;
+
+    // the API can be called from the callback
+    result->sfcount = fluid_synth_sfcount(synth);
+    result->sfont_id = sfont_id;
+    fluid_atomic_int_set(&result->done, TRUE);
+}
+
+static void wait_loaded(fluid_synth_t *synth, load_result_t *result)
+{
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int i = 0;
+
+    // keep playing while loading
+    while(!fluid_atomic_int_get(&result->done))
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60 + i % 12, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+        TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60 + i % 12));
+        TEST_ASSERT(i++ < 100000);
+        fluid_msleep(1);
+    }
+}
+
+int main(void)
+{
+    load_result_t result;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_ASSERT((id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1)) != FLUID_FAILED);
+
+    FLUID_MEMSET(&result, 0, sizeof(result));
+    TEST_SUCCESS(fluid_synth_sfload_async(synth, TEST_SOUNDFONT, 1, on_loaded, &result));
+    wait_loaded(synth, &result);
+
+    // on top of the stack, with the next ID
+    TEST_ASSERT(result.sfont_id == id + 1);
+    TEST_ASSERT(result.sfcount == 2);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 2);
+    TEST_ASSERT(fluid_sfont_get_id(fluid_synth_get_sfont(synth, 0)) == result.sfont_id);
+    TEST_ASSERT(fluid_synth_get_sfont_by_id(synth, result.sfont_id) != NULL);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    // a file that can't be loaded
+    FLUID_MEMSET(&result, 0, sizeof(result));
+    TEST_SUCCESS(fluid_synth_sfload_async(synth, "does-not-exist.sf2", 1, on_loaded, &result));
+    wait_loaded(synth, &result);
+    TEST_ASSERT(result.sfont_id == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 2);
+
+    // deleting the synth waits for the loads still pending
+    TEST_SUCCESS(fluid_synth_sfload_async(synth, TEST_SOUNDFONT, 0, NULL, NULL));
+    delete_fluid_synth(synth);
+
+    // not available without the mutex of the synth
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.threadsafe-api", 0));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload_async(synth, TEST_SOUNDFONT, 1, NULL, NULL) == FLUID_FAILED);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a SoundFont unloaded while voices are playing it is freed by the reclaimer
+// thread once the voices have finished, and by delete_fluid_synth() if they haven't
+
+#define FRAMES 4096
+
+static void render(fluid_synth_t *synth)
+{
+    static float left[FRAMES], right[FRAMES];
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+}
+
+static fluid_synth_t *play(fluid_settings_t **settings, int *id)
+{
+    fluid_synth_t *synth;
+
+    *settings = new_fluid_settings();
+    TEST_ASSERT(*settings != NULL);
+    synth = new_fluid_synth(*settings);
+    TEST_ASSERT(synth != NULL);
+
+    *id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(*id != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    // the voices keep the samples of the SoundFont
+    TEST_SUCCESS(fluid_synth_sfunload(synth, *id, 1));
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 0);
+    TEST_ASSERT(synth->sfont_reclaimer != NULL);
+
+    return synth;
+}
+
+static int pending(fluid_synth_t *synth)
+{
+    return fluid_atomic_int_get(&synth->sfont_reclaimer->pending);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    int i, id;
+
+    synth = play(&settings, &id);
+    TEST_ASSERT(pending(synth) == 1);
+
+    // the SoundFont stays pending while the voices are playing
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    TEST_ASSERT(pending(synth) == 1);
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    // the finished voices wake the reclaimer
+    for(i = 0; i < 10000 && pending(synth) > 0; i++)
+    {
+        fluid_msleep(1);
+    }
+
+    TEST_ASSERT(pending(synth) == 0);
+
+    // a SoundFont loaded again gets a new ID
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) > id);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    // deleting the synth frees the SoundFont pending
+    synth = play(&settings, &id);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that fluid_synth_skip_silence() skips the rest between two notes of a MIDI file only
+// once the reverb and chorus tails have decayed, and that the audio comes out exactly as when rendering the rest
+
+#define FRAMES (12 * 44100)
+#define CHUNK 4096
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0, // format 0, 1 track, 480 ticks per beat
+    'M', 'T', 'r', 'k', 0, 0, 0, 23,
+    0x00, 0x90, 0x3c, 0x64,       // 0: note on
+    0x81, 0x70, 0x80, 0x3c, 0x00, // 240: note off
+    0xc9, 0x10, 0x90, 0x43, 0x70, // 9600: note on, 10 seconds later
+    0x81, 0x70, 0x80, 0x43, 0x00, // 9840: note off
+    0x00, 0xff, 0x2f, 0x00,       // 9840: end of track
+};
+
+static float *render(int skip, int *skipped)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES);
+    int pos, n, i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    TEST_SUCCESS(fluid_player_play(player));
+
+    *skipped = 0;
+
+    for(pos = 0; pos < FRAMES; pos += n)
+    {
+        n = (FRAMES - pos < CHUNK) ? FRAMES - pos : CHUNK;
+
+        if(skip)
+        {
+            int s = fluid_synth_skip_silence(synth, n);
+
+            TEST_ASSERT(s >= 0 && s <= n && s % FLUID_BUFSIZE == 0);
+
+            for(i = 0; i < 2 * s; i++)
+            {
+                buf[2 * pos + i] = 0;
+            }
+
+            *skipped += s;
+            pos += s;
+            n -= s;
+
+            if(n == 0)
+            {
+                continue;
+            }
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, n, buf, 2 * pos, 2, buf, 2 * pos + 1, 2));
+    }
+
+    TEST_ASSERT(fluid_player_get_status(player) == FLUID_PLAYER_DONE);
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+int main(void)
+{
+    float *plain, *skipped;
+    int frames, i, first = -1, last = -1;
+
+    plain = render(FALSE, &frames);
+    TEST_ASSERT(frames == 0);
+
+    skipped = render(TRUE, &frames);
+
+    // most of the rest, but not the tails
+    TEST_ASSERT(frames > 5 * 44100);
+    TEST_ASSERT(frames < 10 * 44100);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(skipped[i] == plain[i]);
+
+        if(plain[i] != 0)
+        {
+            first = (first < 0) ? i : first;
+            last = i;
+        }
+    }
+
+    // both notes sound
+    TEST_ASSERT(first >= 0 && first < 2 * 44100);
+    TEST_ASSERT(last > 2 * 10 * 44100);
+
+    FLUID_FREE(plain);
+    FLUID_FREE(skipped);
+
+    return EXIT_SUCCESS;
+}
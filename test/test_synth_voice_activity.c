@@ -0,0 +1,95 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that every voice started and stopped is queued with the count of active voices,
+// and that the queue drops them rather than blocking the synth when it is full
+
+#define FRAMES 44100
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float *buf;
+    int i, type, chan, key, active_voices, started = 0, stopped = 0;
+    unsigned int id;
+
+    buf = FLUID_ARRAY(float, 2 * FRAMES);
+    TEST_ASSERT(buf != NULL);
+
+    // disabled by default
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_pop_voice_activity(synth, &type, &chan, &key, &id, &active_voices) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-activity-queue", 256));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_pop_voice_activity(synth, NULL, NULL, NULL, NULL, NULL) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 3, 60, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    while(fluid_synth_pop_voice_activity(synth, &type, &chan, &key, &id, &active_voices) == FLUID_OK)
+    {
+        TEST_ASSERT(type == FLUID_VOICE_ACTIVITY_START);
+        TEST_ASSERT(chan == 3);
+        TEST_ASSERT(key == 60);
+        TEST_ASSERT(active_voices == ++started);
+    }
+
+    TEST_ASSERT(started == fluid_synth_get_active_voice_count(synth));
+
+    // the voices are stopped by the rendering once released
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 3, 60));
+
+    for(i = 0; i < 30 && fluid_synth_get_active_voice_count(synth) > 0; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    while(fluid_synth_pop_voice_activity(synth, &type, &chan, &key, NULL, &active_voices) == FLUID_OK)
+    {
+        TEST_ASSERT(type == FLUID_VOICE_ACTIVITY_STOP);
+        TEST_ASSERT(chan == 3);
+        TEST_ASSERT(key == 60);
+        TEST_ASSERT(active_voices == started - ++stopped);
+    }
+
+    TEST_ASSERT(stopped == started);
+    delete_fluid_synth(synth);
+
+    // a full queue drops the voices, the count of the queued ones is still the one when they started
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-activity-queue", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 100));
+    TEST_SUCCESS(fluid_synth_pop_voice_activity(synth, &type, NULL, &key, NULL, &active_voices));
+    TEST_ASSERT(type == FLUID_VOICE_ACTIVITY_START);
+    TEST_ASSERT(key == 60);
+    TEST_ASSERT(active_voices == 1);
+    TEST_ASSERT(fluid_synth_pop_voice_activity(synth, NULL, NULL, NULL, NULL, NULL) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 100));
+    TEST_SUCCESS(fluid_synth_pop_voice_activity(synth, NULL, NULL, &key, NULL, &active_voices));
+    TEST_ASSERT(key == 67);
+    TEST_ASSERT(active_voices > 2);
+    TEST_ASSERT(active_voices <= fluid_synth_get_active_voice_count(synth));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    FLUID_FREE(buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the voices reserved to a channel by fluid_synth_set_voice_quota() are not stolen
+// by the other channels once the polyphony is exhausted, and that a channel borrowing beyond its quota gives
+// the voices back first
+
+#define POLYPHONY 16
+#define QUOTA 4
+
+// the voices of a note of the test SoundFont, a stereo pair
+#define NOTE_VOICES 2
+
+static int count_voices(fluid_synth_t *synth, int chan)
+{
+    fluid_voice_t *voice;
+    int count = 0;
+
+    for(voice = synth->channel[chan]->voices; voice != NULL; voice = voice->chan_next)
+    {
+        count++;
+    }
+
+    TEST_ASSERT(count == synth->channel[chan]->voice_count);
+
+    return count;
+}
+
+// the blocks after which a voice is old enough to be killed: the age part of its overflow priority
+// stays above OVERFLOW_PRIO_CANNOT_KILL for the first 45 samples with the default scores
+#define NOTE_BLOCKS ((64 + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE)
+
+static void render(fluid_synth_t *synth)
+{
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int i;
+
+    for(i = 0; i < NOTE_BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    }
+}
+
+// a note after the other, so that the voices started before are old enough to be killed
+static void play(fluid_synth_t *synth, int chan, int first_key, int n)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, first_key + i, 100));
+        render(synth);
+    }
+}
+
+// all notes off, and their voices finished by rendering
+static void reset(fluid_synth_t *synth)
+{
+    TEST_SUCCESS(fluid_synth_system_reset(synth));
+    render(synth);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // a stereo pair of voices per note
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 2);
+    reset(synth);
+
+    TEST_ASSERT(fluid_synth_get_voice_quota(synth, 1) == 0);
+    TEST_ASSERT(fluid_synth_set_voice_quota(synth, 16, 1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_set_voice_quota(synth, 1, -1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_voice_quota(synth, 16) == FLUID_FAILED);
+
+    // without quotas, the oldest voices are stolen from any channel
+    play(synth, 1, 30, QUOTA / NOTE_VOICES);
+    play(synth, 0, 40, POLYPHONY / NOTE_VOICES);
+    TEST_ASSERT(count_voices(synth, 1) == 0);
+    TEST_ASSERT(count_voices(synth, 0) == POLYPHONY);
+    reset(synth);
+
+    // the voices of a channel within its quota are left alone
+    TEST_SUCCESS(fluid_synth_set_voice_quota(synth, 1, QUOTA));
+    TEST_ASSERT(fluid_synth_get_voice_quota(synth, 1) == QUOTA);
+    play(synth, 1, 30, QUOTA / NOTE_VOICES);
+    play(synth, 0, 40, 3 * POLYPHONY / NOTE_VOICES);
+    TEST_ASSERT(count_voices(synth, 1) == QUOTA);
+    TEST_ASSERT(count_voices(synth, 0) == POLYPHONY - QUOTA);
+
+    // playing its quota, the channel kills its own voices
+    play(synth, 1, 50, 5);
+    TEST_ASSERT(count_voices(synth, 1) == QUOTA);
+    TEST_ASSERT(count_voices(synth, 0) == POLYPHONY - QUOTA);
+
+    // with a quota of its own, another channel takes the voices back from the borrowers only
+    TEST_SUCCESS(fluid_synth_set_voice_quota(synth, 2, QUOTA));
+    play(synth, 2, 30, 2 * QUOTA / NOTE_VOICES);
+    TEST_ASSERT(count_voices(synth, 1) == QUOTA);
+    TEST_ASSERT(count_voices(synth, 2) == QUOTA);
+    TEST_ASSERT(count_voices(synth, 0) == POLYPHONY - 2 * QUOTA);
+    reset(synth);
+
+    // the quotas are kept, voices are borrowed while available and given back first
+    TEST_ASSERT(fluid_synth_get_voice_quota(synth, 1) == QUOTA);
+    play(synth, 1, 30, POLYPHONY / NOTE_VOICES - 1);
+    TEST_ASSERT(count_voices(synth, 1) == POLYPHONY - NOTE_VOICES);
+    play(synth, 0, 40, POLYPHONY / NOTE_VOICES);
+    TEST_ASSERT(count_voices(synth, 1) == QUOTA);
+    TEST_ASSERT(count_voices(synth, 0) == POLYPHONY - QUOTA);
+    reset(synth);
+
+    // all channels at once, those playing their quota keep it
+    TEST_SUCCESS(fluid_synth_set_voice_quota(synth, -1, NOTE_VOICES));
+
+    for(i = 0; i < POLYPHONY / NOTE_VOICES; i++)
+    {
+        TEST_ASSERT(fluid_synth_get_voice_quota(synth, i) == NOTE_VOICES);
+        play(synth, i, 40, 1);
+    }
+
+    play(synth, 3, 50, 5);
+
+    for(i = 0; i < POLYPHONY / NOTE_VOICES; i++)
+    {
+        TEST_ASSERT(count_voices(synth, i) == NOTE_VOICES);
+    }
+
+    TEST_SUCCESS(fluid_synth_set_voice_quota(synth, -1, 0));
+    TEST_ASSERT(synth->voice_quota_channels == 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the snapshot of the voices published after each rendering call holds the
+// voices playing, with the stage of their volume envelope, and that it can be read while rendering
+
+#define FRAMES 4410
+#define SIZE 64
+
+static fluid_synth_t *synth;
+static fluid_atomic_int_t done;
+
+static fluid_thread_return_t read_snapshots(void *data)
+{
+    fluid_voice_snapshot_t voices[SIZE];
+    int i, count;
+
+    while(!fluid_atomic_int_get(&done))
+    {
+        count = fluid_synth_get_voice_snapshot(synth, voices, SIZE);
+
+        for(i = 0; i < count; i++)
+        {
+            // every note is played on the channel of its key
+            TEST_ASSERT(voices[i].chan == voices[i].key % 16);
+            TEST_ASSERT(voices[i].vel == 100);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_thread_t *thread;
+    fluid_voice_snapshot_t voices[SIZE];
+    float *buf;
+    int i, count;
+
+    buf = FLUID_ARRAY(float, 2 * FRAMES);
+    TEST_ASSERT(buf != NULL);
+
+    // disabled by default
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_get_voice_snapshot(synth, voices, SIZE) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-snapshot", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_voice_snapshot(synth, voices, SIZE) == 0);
+
+    // published by the rendering only
+    TEST_SUCCESS(fluid_synth_noteon(synth, 5, 69, 100));
+    TEST_ASSERT(fluid_synth_get_voice_snapshot(synth, voices, SIZE) == 0);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    count = fluid_synth_get_voice_snapshot(synth, voices, SIZE);
+    TEST_ASSERT(count == fluid_synth_get_active_voice_count(synth));
+    TEST_ASSERT(count > 0);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(voices[i].chan == 5);
+        TEST_ASSERT(voices[i].key == 69);
+        TEST_ASSERT(voices[i].vel == 100);
+        TEST_ASSERT(voices[i].stage > FLUID_VOICE_ENVELOPE_DELAY);
+        TEST_ASSERT(voices[i].stage < FLUID_VOICE_ENVELOPE_RELEASE);
+    }
+
+    TEST_ASSERT(fluid_synth_get_voice_snapshot(synth, voices, 1) == 1);
+
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 5, 69));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    count = fluid_synth_get_voice_snapshot(synth, voices, SIZE);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(voices[i].stage == FLUID_VOICE_ENVELOPE_RELEASE);
+    }
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_ASSERT(fluid_synth_get_voice_snapshot(synth, voices, SIZE) == 0);
+
+    // read by another thread while notes come and go
+    thread = new_fluid_thread("snapshot", read_snapshots, NULL, 0, FALSE);
+    TEST_ASSERT(thread != NULL);
+
+    for(i = 0; i < 200; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, (40 + i % 40) % 16, 40 + i % 40, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+
+        if(i % 3 == 0)
+        {
+            TEST_SUCCESS(fluid_synth_all_notes_off(synth, -1));
+        }
+    }
+
+    fluid_atomic_int_set(&done, TRUE);
+    fluid_thread_join(thread);
+    delete_fluid_thread(thread);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    FLUID_FREE(buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that writing every audio and effects channel to its own buffer, or interleaved
+// to a single buffer, gives the same audio as mixing it with fluid_synth_process(), without having
+// to clear the buffers before
+
+#define AUDIO_CHANNELS 3
+#define FX_CHANNELS (2 * 2)
+#define FRAMES 2000
+
+static fluid_synth_t *create_synth(int audio_channels)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-channels", audio_channels));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-groups", audio_channels));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", FX_CHANNELS / 2));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 64, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 67, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 3, 72, 100));
+
+    return synth;
+}
+
+static void delete_synth(fluid_synth_t *synth)
+{
+    fluid_settings_t *settings = fluid_synth_get_settings(synth);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float mixed[2 * (AUDIO_CHANNELS + FX_CHANNELS)][FRAMES];
+    static float written[2 * (AUDIO_CHANNELS + FX_CHANNELS)][FRAMES];
+    static float interleaved[FRAMES][2 * (AUDIO_CHANNELS + FX_CHANNELS)];
+    static float stereo[2][FRAMES], stereo_interleaved[2 * FRAMES];
+    float *mixed_out[2 * AUDIO_CHANNELS], *mixed_fx[2 * FX_CHANNELS];
+    float *written_out[2 * AUDIO_CHANNELS], *written_fx[2 * FX_CHANNELS];
+    float *fx_none[2 * FX_CHANNELS] = { NULL };
+    fluid_synth_t *mixing, *writing;
+    int i, k, len, pos, n = 0, sound = 0;
+
+    mixing = create_synth(AUDIO_CHANNELS);
+    writing = create_synth(AUDIO_CHANNELS);
+
+    TEST_ASSERT(fluid_synth_count_audio_channels(writing) == AUDIO_CHANNELS);
+    TEST_ASSERT(fluid_synth_count_effects_channels(writing) * fluid_synth_count_effects_groups(writing) == FX_CHANNELS);
+
+    FLUID_MEMSET(mixed, 0, sizeof(mixed));
+
+    for(i = 0; i < 2 * (AUDIO_CHANNELS + FX_CHANNELS); i++)
+    {
+        // garbage, the buffers are overwritten
+        for(k = 0; k < FRAMES; k++)
+        {
+            written[i][k] = 1000.0f + k;
+        }
+    }
+
+    // the buffer counts must match the channels
+    for(i = 0; i < 2 * AUDIO_CHANNELS; i++)
+    {
+        written_out[i] = written[i];
+    }
+
+    TEST_ASSERT(fluid_synth_write_float_channels(writing, 64, 0, NULL, 2, written_out) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_write_float_channels(writing, 64, 2, fx_none, 2 * AUDIO_CHANNELS, written_out) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_write_float_channels(writing, 0, 0, NULL, 2 * AUDIO_CHANNELS, written_out));
+
+    // render in chunks of different lengths, also ones not ending at a block boundary
+    for(pos = 0; pos < FRAMES; pos += len)
+    {
+        len = 37 * (1 + n++ % 5);
+        len = (FRAMES - pos < len) ? FRAMES - pos : len;
+
+        for(i = 0; i < 2 * AUDIO_CHANNELS; i++)
+        {
+            mixed_out[i] = mixed[i] + pos;
+            written_out[i] = written[i] + pos;
+        }
+
+        for(i = 0; i < 2 * FX_CHANNELS; i++)
+        {
+            mixed_fx[i] = mixed[2 * AUDIO_CHANNELS + i] + pos;
+            written_fx[i] = written[2 * AUDIO_CHANNELS + i] + pos;
+        }
+
+        TEST_SUCCESS(fluid_synth_process(mixing, len, 2 * FX_CHANNELS, mixed_fx, 2 * AUDIO_CHANNELS, mixed_out));
+        TEST_SUCCESS(fluid_synth_write_float_channels(writing, len, 2 * FX_CHANNELS, written_fx, 2 * AUDIO_CHANNELS, written_out));
+    }
+
+    for(i = 0; i < 2 * (AUDIO_CHANNELS + FX_CHANNELS); i++)
+    {
+        for(k = 0; k < FRAMES; k++)
+        {
+            TEST_ASSERT(written[i][k] == mixed[i][k]);
+            sound |= (mixed[i][k] != 0);
+        }
+    }
+
+    TEST_ASSERT(sound);
+
+    delete_synth(mixing);
+    delete_synth(writing);
+
+    // all channels interleaved, the same frames as above
+    writing = create_synth(AUDIO_CHANNELS);
+    FLUID_MEMSET(interleaved, 0xff, sizeof(interleaved));
+
+    TEST_ASSERT(fluid_synth_write_interleaved(writing, 64, 2, interleaved[0]) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_write_interleaved(writing, 64, 2 * AUDIO_CHANNELS + 2, interleaved[0]) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_write_interleaved(writing, 64, 2 * AUDIO_CHANNELS, NULL) == FLUID_FAILED);
+
+    for(pos = 0, n = 0; pos < FRAMES; pos += len)
+    {
+        len = 37 * (1 + n++ % 5);
+        len = (FRAMES - pos < len) ? FRAMES - pos : len;
+
+        TEST_SUCCESS(fluid_synth_write_interleaved(writing, len, 2 * (AUDIO_CHANNELS + FX_CHANNELS), interleaved[pos]));
+    }
+
+    for(i = 0; i < 2 * (AUDIO_CHANNELS + FX_CHANNELS); i++)
+    {
+        for(k = 0; k < FRAMES; k++)
+        {
+            TEST_ASSERT(interleaved[k][i] == mixed[i][k]);
+        }
+    }
+
+    delete_synth(writing);
+
+    // a single stereo channel with reverb and chorus mixed to it, like fluid_synth_write_float()
+    mixing = create_synth(1);
+    writing = create_synth(1);
+
+    for(pos = 0, n = 0; pos < FRAMES; pos += len)
+    {
+        len = 37 * (1 + n++ % 5);
+        len = (FRAMES - pos < len) ? FRAMES - pos : len;
+
+        TEST_SUCCESS(fluid_synth_write_float(mixing, len, stereo[0], pos, 1, stereo[1], pos, 1));
+        TEST_SUCCESS(fluid_synth_write_interleaved(writing, len, 2, stereo_interleaved + 2 * pos));
+    }
+
+    for(k = 0; k < FRAMES; k++)
+    {
+        TEST_ASSERT(stereo_interleaved[2 * k] == stereo[0][k]);
+        TEST_ASSERT(stereo_interleaved[2 * k + 1] == stereo[1][k]);
+    }
+
+    delete_synth(mixing);
+    delete_synth(writing);
+
+    return EXIT_SUCCESS;
+}
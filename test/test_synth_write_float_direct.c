@@ -0,0 +1,97 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice_mixer.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that fluid_synth_write_float() renders the same samples into aligned buffers of whole
+// blocks, which the mixer renders straight into with float samples, as into interleaved buffers, which it copies
+// to, also when the calls taking whole blocks follow and precede calls that don't
+
+#define FRAMES (64 * FLUID_BUFSIZE)
+#define ALIGN_SLACK (FLUID_DEFAULT_ALIGNMENT / sizeof(float))
+
+static const int calls[] = { 100, 156, 4 * FLUID_BUFSIZE, 8 * FLUID_BUFSIZE, 3, 4 * FLUID_BUFSIZE - 3 };
+
+static fluid_synth_t *create_synth(fluid_settings_t **settings, int cores)
+{
+    fluid_synth_t *synth;
+    int i;
+
+    *settings = new_fluid_settings();
+    TEST_ASSERT(*settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(*settings, "synth.cpu-cores", cores));
+    synth = new_fluid_synth(*settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // dry and wet signals
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 127));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 93, 127));
+
+    for(i = 0; i < 8; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 2, 48 + 5 * i, 100));
+    }
+
+    return synth;
+}
+
+static void test_direct(int cores)
+{
+    static float left_store[FRAMES + ALIGN_SLACK], right_store[FRAMES + ALIGN_SLACK], interleaved[2 * FRAMES];
+    fluid_settings_t *settings, *ref_settings;
+    fluid_synth_t *synth, *ref;
+    float *left = fluid_align_ptr(left_store, FLUID_DEFAULT_ALIGNMENT);
+    float *right = fluid_align_ptr(right_store, FLUID_DEFAULT_ALIGNMENT);
+    int i, n, pos = 0;
+    double peak = 0;
+
+    synth = create_synth(&settings, cores);
+    ref = create_synth(&ref_settings, cores);
+
+    for(n = 0; pos < FRAMES; n++)
+    {
+        int len = calls[n % FLUID_N_ELEMENTS(calls)];
+
+        len = (pos + len > FRAMES) ? FRAMES - pos : len;
+        TEST_SUCCESS(fluid_synth_write_float(synth, len, left, pos, 1, right, pos, 1));
+
+#if defined(WITH_FLOAT)
+
+        // nothing is left of the calls before the ones of whole blocks
+        if(n % FLUID_N_ELEMENTS(calls) == 2 || n % FLUID_N_ELEMENTS(calls) == 3)
+        {
+            TEST_ASSERT(fluid_rvoice_mixer_is_output_used(synth->eventhandler->mixer));
+        }
+
+#endif
+        pos += len;
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(ref, FRAMES, interleaved, 0, 2, interleaved, 1, 2));
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(left[i] == interleaved[2 * i]);
+        TEST_ASSERT(right[i] == interleaved[2 * i + 1]);
+        peak = (fabs(left[i]) > peak) ? fabs(left[i]) : peak;
+    }
+
+    TEST_ASSERT(peak > 0.01);
+
+    delete_fluid_synth(ref);
+    delete_fluid_settings(ref_settings);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    test_direct(1);
+#if ENABLE_MIXER_THREADS
+    test_direct(2);
+#endif
+
+    return EXIT_SUCCESS;
+}
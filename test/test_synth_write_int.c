@@ -0,0 +1,148 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include <stdlib.h>
+
+// this test makes sure that the 16, 24 and 32 bit audio written by the synth is the rounded and
+// clipped floating point audio, interleaved as well as planar, and that 16 bit audio is dithered
+
+#define FRAMES 3000
+
+static fluid_synth_t *create_synth(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    // loud enough to clip
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 10.0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 127));
+
+    return synth;
+}
+
+static void delete_synth(fluid_synth_t *synth)
+{
+    fluid_settings_t *settings = fluid_synth_get_settings(synth);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+static long round_clip(double x, double max)
+{
+    x = (x >= 0) ? x + 0.5 : x - 0.5;
+    x = (x > max) ? max : x;
+    x = (x < -max - 1) ? -max - 1 : x;
+    return (long)x;
+}
+
+static void write_audio(fluid_synth_t *synth, int bits, int len, void *buf, int loff, int roff, int incr)
+{
+    switch(bits)
+    {
+    case 16:
+        TEST_SUCCESS(fluid_synth_write_s16(synth, len, buf, loff, incr, buf, roff, incr));
+        break;
+
+    case 24:
+        TEST_SUCCESS(fluid_synth_write_s24(synth, len, buf, loff, incr, buf, roff, incr));
+        break;
+
+    case 32:
+        TEST_SUCCESS(fluid_synth_write_s32(synth, len, buf, loff, incr, buf, roff, incr));
+        break;
+
+    default:
+        TEST_SUCCESS(fluid_synth_write_float(synth, len, buf, loff, incr, buf, roff, incr));
+    }
+}
+
+// renders in chunks of different lengths, alternating between the interleaved first half
+// of the buffer and the planar second half
+static void render(fluid_synth_t *synth, int bits, void *buf)
+{
+    int i, len, n = 0;
+
+    for(i = 0; i < FRAMES; i += len, n++)
+    {
+        len = 45 * (1 + n % 4);
+        len = (FRAMES - i < len) ? FRAMES - i : len;
+
+        if(n % 2 == 0)
+        {
+            write_audio(synth, bits, len, buf, 2 * i, 2 * i + 1, 2);
+        }
+        else
+        {
+            write_audio(synth, bits, len, buf, 2 * FRAMES + i, 3 * FRAMES + i, 1);
+        }
+    }
+}
+
+int main(void)
+{
+    static float ref[4 * FRAMES];
+    static int16_t s16[4 * FRAMES];
+    static int32_t s32[4 * FRAMES];
+    fluid_synth_t *synth;
+    int i, clipped = 0, dithered = 0;
+
+    synth = create_synth();
+    render(synth, 0, ref);
+    delete_synth(synth);
+
+    for(i = 0; i < 4 * FRAMES; i++)
+    {
+        clipped |= (ref[i] > 1.0f);
+    }
+
+    TEST_ASSERT(clipped);
+
+    // the synth may render in double precision, the tolerances cover the rounding of the reference to float
+    synth = create_synth();
+    render(synth, 32, s32);
+    delete_synth(synth);
+
+    for(i = 0; i < 4 * FRAMES; i++)
+    {
+        long s = round_clip(ref[i] * 2147483647.0, 2147483647.0);
+
+        TEST_ASSERT(labs(s32[i] - s) <= 256);
+    }
+
+    synth = create_synth();
+    render(synth, 24, s32);
+    delete_synth(synth);
+
+    for(i = 0; i < 4 * FRAMES; i++)
+    {
+        long s = round_clip(ref[i] * 8388607.0, 8388607.0);
+
+        TEST_ASSERT(labs(s32[i] - s) <= 1);
+    }
+
+    // the dither noise is within one LSB, plus one for the reference
+    synth = create_synth();
+    render(synth, 16, s16);
+    delete_synth(synth);
+
+    for(i = 0; i < 4 * FRAMES; i++)
+    {
+        long s = round_clip(ref[i] * 32766.0, 32767.0);
+
+        TEST_ASSERT(labs(s16[i] - s) <= 2);
+        dithered |= (s16[i] != s);
+    }
+
+    TEST_ASSERT(dithered);
+
+    return EXIT_SUCCESS;
+}
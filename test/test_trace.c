@@ -0,0 +1,99 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the trace points of the rendering are dumped as a Chrome trace,
+// or that tracing fails when built without them
+
+#define TRACE_FILE "test_trace.json"
+
+#if WITH_TRACE
+static int count_spans(const char *text, const char *name)
+{
+    char pattern[64];
+    int n = 0;
+
+    FLUID_SNPRINTF(pattern, sizeof(pattern), "{\"name\":\"%s\",\"ph\":\"X\"", name);
+
+    for(text = strstr(text, pattern); text != NULL; text = strstr(text + 1, pattern))
+    {
+        n++;
+    }
+
+    return n;
+}
+
+static void test_trace(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float buf[2 * 1024];
+    char *text;
+    FILE *file;
+    long size;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // nothing is recorded before tracing is started
+    TEST_SUCCESS(fluid_synth_write_float(synth, 1024, buf, 0, 2, buf, 1, 2));
+
+    TEST_SUCCESS(fluid_trace_start());
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(i = 0; i < 10; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, 1024, buf, 0, 2, buf, 1, 2));
+    }
+
+    TEST_SUCCESS(fluid_trace_dump(TRACE_FILE));
+
+    // nor after it is stopped
+    TEST_SUCCESS(fluid_synth_write_float(synth, 1024, buf, 0, 2, buf, 1, 2));
+
+    file = FLUID_FOPEN(TRACE_FILE, "rb");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(FLUID_FSEEK(file, 0, SEEK_END) == 0);
+    size = FLUID_FTELL(file);
+    TEST_ASSERT(size > 0);
+    TEST_ASSERT(FLUID_FSEEK(file, 0, SEEK_SET) == 0);
+    text = FLUID_MALLOC(size + 1);
+    TEST_ASSERT(text != NULL);
+    TEST_ASSERT(FLUID_FREAD(text, 1, size, file) == (size_t)size);
+    text[size] = 0;
+    FLUID_FCLOSE(file);
+
+    TEST_ASSERT(FLUID_STRNCMP(text, "{\"traceEvents\":[", 16) == 0);
+    TEST_ASSERT(strstr(text, "\"name\":\"thread_name\"") != NULL);
+    TEST_ASSERT(count_spans(text, "sfload") == 1);
+
+    // each write needs blocks rendered
+    TEST_ASSERT(count_spans(text, "render_blocks") >= 10);
+    TEST_ASSERT(count_spans(text, "render_blocks") == count_spans(text, "render_voices"));
+    TEST_ASSERT(count_spans(text, "render_blocks") == count_spans(text, "process_fx"));
+    TEST_ASSERT(count_spans(text, "dispatch") >= count_spans(text, "render_blocks"));
+
+    FLUID_FREE(text);
+    remove(TRACE_FILE);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+#endif
+
+int main(void)
+{
+#if WITH_TRACE
+    test_trace();
+#else
+    TEST_ASSERT(fluid_trace_start() == FLUID_FAILED);
+    TEST_ASSERT(fluid_trace_dump(TRACE_FILE) == FLUID_FAILED);
+    fluid_trace_stop();
+#endif
+
+    return EXIT_SUCCESS;
+}
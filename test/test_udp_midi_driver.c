@@ -0,0 +1,236 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "midi/fluid_midi.h"
+
+// this test makes sure that the udp MIDI driver passes on the events received as raw MIDI bytes
+// and in RTP-MIDI packets, in order and with running status, and drops RTP packets arriving late,
+// and that with midi.timestamp-latency the events reach the synth by its rendering, after the latency
+
+#if defined(NETWORK_SUPPORT) && !defined(_WIN32)
+
+#define PORT 9812
+#define MAX_EVENTS 16
+#define WAIT_MSEC 5000
+
+typedef struct
+{
+    int type;
+    int channel;
+    int param1;
+    int param2;
+    double time;
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static fluid_atomic_int_t num_events;
+
+static int handle_event(void *data, fluid_midi_event_t *evt)
+{
+    int i = fluid_atomic_int_get(&num_events);
+    TEST_ASSERT(data == events);
+    TEST_ASSERT(i < MAX_EVENTS);
+
+    events[i].type = fluid_midi_event_get_type(evt);
+    events[i].channel = fluid_midi_event_get_channel(evt);
+    events[i].param1 = fluid_midi_event_get_key(evt);
+    events[i].param2 = fluid_midi_event_get_velocity(evt);
+
+    if(events[i].type == PROGRAM_CHANGE)
+    {
+        events[i].param1 = fluid_midi_event_get_program(evt);
+        events[i].param2 = 0;
+    }
+    else if(events[i].type == PITCH_BEND)
+    {
+        events[i].param1 = fluid_midi_event_get_pitch(evt);
+        events[i].param2 = 0;
+    }
+    events[i].time = fluid_utime();
+
+    fluid_atomic_int_inc(&num_events);
+    return FLUID_OK;
+}
+
+static void wait_events(int n)
+{
+    int msec;
+
+    for(msec = 0; fluid_atomic_int_get(&num_events) < n && msec < WAIT_MSEC; msec++)
+    {
+        fluid_msleep(1);
+    }
+
+    // nothing more than expected
+    fluid_msleep(20);
+    TEST_ASSERT(fluid_atomic_int_get(&num_events) == n);
+}
+
+static void check_event(int i, int type, int channel, int param1, int param2)
+{
+    TEST_ASSERT(events[i].type == type);
+    TEST_ASSERT(events[i].channel == channel);
+    TEST_ASSERT(events[i].param1 == param1);
+    TEST_ASSERT(events[i].param2 == param2);
+}
+
+static void send_packet(int sock, const unsigned char *buf, int len)
+{
+    struct sockaddr_in addr;
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT(sendto(sock, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr)) == len);
+}
+
+static fluid_midi_driver_t *create_driver(fluid_settings_t *settings, int rtp)
+{
+    fluid_midi_driver_t *driver;
+
+    fluid_atomic_int_set(&num_events, 0);
+    TEST_SUCCESS(fluid_settings_setint(settings, "midi.udp.rtp", rtp));
+    driver = new_fluid_midi_driver(settings, handle_event, events);
+    TEST_ASSERT(driver != NULL);
+
+    return driver;
+}
+
+// renders a block at about the pace of the audio until the synth plays a voice, returns the time it took
+static double render_until_voice(fluid_synth_t *synth, double start)
+{
+    float buf[2 * FLUID_BUFSIZE];
+    int msec;
+
+    for(msec = 0; fluid_synth_get_active_voice_count(synth) == 0 && msec < WAIT_MSEC; msec++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+        fluid_msleep(1 + FLUID_BUFSIZE * 1000 / 44100);
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    return (fluid_utime() - start) / 1000.0;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_midi_driver_t *driver;
+    fluid_synth_t *synth;
+    float buf[2 * FLUID_BUFSIZE];
+    double start;
+    int sock;
+
+    // raw MIDI, running status continued in the next packet
+    static const unsigned char raw1[] = { 0x91, 60, 100, 62 };
+    static const unsigned char raw2[] = { 90, 0xB2, 7, 64 };
+
+    // RTP header, sequence number 7, then a command list with B = 0 J = 0 Z = 0 P = 0:
+    // a note on, a note on with running status after a delta time of 0,
+    // and a pitch bend after a delta time of 300 ticks at 10 kHz
+    static const unsigned char rtp1[] =
+    {
+        0x80, 0x61, 0x00, 0x07, 0, 0, 0, 0, 1, 2, 3, 4,
+        11, 0x93, 64, 80, 0x00, 65, 81, 0x82, 0x2C, 0xE4, 0x00, 0x40
+    };
+    // the same sequence number again: dropped
+    static const unsigned char rtp_dup[] =
+    {
+        0x80, 0x61, 0x00, 0x07, 0, 0, 0, 0, 1, 2, 3, 4,
+        3, 0x95, 64, 80
+    };
+    // the next packet, with the long form of the header, Z = 1 and a delta time for the first
+    // command, followed by a SysEx message and a command lacking its status byte after the SysEx
+    static const unsigned char rtp2[] =
+    {
+        0x80, 0x61, 0x00, 0x08, 0, 0, 0, 0, 1, 2, 3, 4,
+        0xA0, 11, 0x00, 0xC6, 5, 0x00, 0xF0, 0x7E, 0x7F, 0xF7, 0x00, 0x01, 0x02
+    };
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "midi.driver", "udp"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "midi.udp.port", PORT));
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    TEST_ASSERT(sock >= 0);
+
+    driver = create_driver(settings, 0);
+    send_packet(sock, raw1, sizeof(raw1));
+    send_packet(sock, raw2, sizeof(raw2));
+    wait_events(3);
+    check_event(0, NOTE_ON, 1, 60, 100);
+    check_event(1, NOTE_ON, 1, 62, 90);
+    check_event(2, CONTROL_CHANGE, 2, 7, 64);
+    delete_fluid_midi_driver(driver);
+
+    driver = create_driver(settings, 1);
+
+    // not an RTP packet
+    send_packet(sock, raw1, sizeof(raw1));
+
+    start = fluid_utime();
+    send_packet(sock, rtp1, sizeof(rtp1));
+    wait_events(3);
+    check_event(0, NOTE_ON, 3, 64, 80);
+    check_event(1, NOTE_ON, 3, 65, 81);
+    check_event(2, PITCH_BEND, 4, 8192, 0);
+
+    // held back for its delta time of 30 msec
+    TEST_ASSERT(events[2].time - start >= 29000);
+
+    send_packet(sock, rtp_dup, sizeof(rtp_dup));
+    send_packet(sock, rtp2, sizeof(rtp2));
+    wait_events(5);
+    check_event(3, PROGRAM_CHANGE, 6, 5, 0);
+    TEST_ASSERT(events[4].type == MIDI_SYSEX);
+    delete_fluid_midi_driver(driver);
+
+    // played by the rendering, 100 msec after arrival
+    TEST_SUCCESS(fluid_settings_setint(settings, "midi.udp.rtp", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "midi.timestamp-latency", 100));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    driver = new_fluid_midi_driver(settings, fluid_synth_handle_midi_event, synth);
+    TEST_ASSERT(driver != NULL);
+
+    start = fluid_utime();
+    send_packet(sock, raw1, sizeof(raw1));
+    TEST_ASSERT(render_until_voice(synth, start) >= 50);
+
+    // the events still queued are played once the driver is deleted
+    TEST_SUCCESS(fluid_synth_system_reset(synth));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    send_packet(sock, raw1, sizeof(raw1));
+    fluid_msleep(50);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    delete_fluid_midi_driver(driver);
+    render_until_voice(synth, fluid_utime());
+
+    // not sent to a synth, the events are passed on as they arrive
+    driver = create_driver(settings, 0);
+    send_packet(sock, raw1, sizeof(raw1));
+    wait_events(1);
+    check_event(0, NOTE_ON, 1, 60, 100);
+    delete_fluid_midi_driver(driver);
+    delete_fluid_synth(synth);
+
+    close(sock);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int main(void)
+{
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,121 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the voices rendered on their own, filtered and mixed in one pass with
+// synth.voice-fused-mixing, sound exactly the same as when filtered and mixed along with the other voices,
+// while their filters change, some of them are released and the reverb and chorus are sent to
+
+#define RATE 44100
+#define FRAMES 44100
+#define SAMPLE_FRAMES 30000
+#define CHANNELS 8
+
+static short data[CHANNELS][SAMPLE_FRAMES];
+
+static void start_voice(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel)
+{
+    fluid_voice_t *voice;
+
+    fluid_synth_api_enter(synth);
+    voice = fluid_synth_alloc_voice(synth, sample, chan, key, vel);
+    TEST_ASSERT(voice != NULL);
+    fluid_synth_start_voice(synth, voice);
+    fluid_synth_api_exit(synth);
+}
+
+static float *render(int fused, fluid_sample_t **samples)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float *buf = FLUID_ARRAY(float, 2 * FRAMES);
+    int chan, pos, len;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(buf != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", RATE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-fused-mixing", fused));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // another sample on each channel, so that the voices are rendered on their own
+    for(chan = 0; chan < CHANNELS; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 10, chan * 16));
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 91, 127 - chan * 10));
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 93, chan * 10));
+        start_voice(synth, samples[chan], chan, 48 + chan * 5, 40 + chan * 10);
+    }
+
+    // in uneven parts, while the filters of the voices move
+    for(pos = 0, len = 37; pos < FRAMES; pos += len, len = (len * 7) % 1001 + 1)
+    {
+        if(pos + len > FRAMES)
+        {
+            len = FRAMES - pos;
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, len, buf, 2 * pos, 2, buf, 2 * pos + 1, 2));
+
+        chan = pos % CHANNELS;
+        TEST_SUCCESS(fluid_synth_set_gen(synth, chan, GEN_FILTERFC, 3000 + (pos % 9000)));
+        TEST_SUCCESS(fluid_synth_set_gen(synth, chan, GEN_FILTERQ, (pos % 7) * 30));
+
+        if(pos > FRAMES / 2)
+        {
+            fluid_synth_noteoff(synth, chan, 48 + chan * 5);
+        }
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return buf;
+}
+
+int main(void)
+{
+    fluid_sample_t *samples[CHANNELS];
+    float *plain, *fused;
+    double peak = 0;
+    int i, chan;
+
+    for(chan = 0; chan < CHANNELS; chan++)
+    {
+        // short ones finish while being rendered
+        int frames = SAMPLE_FRAMES / (chan % 3 + 1);
+
+        for(i = 0; i < frames; i++)
+        {
+            data[chan][i] = (short)(20000 * FLUID_SIN(2 * M_PI * i / (30 + 7 * chan)) * (frames - i) / frames);
+        }
+
+        samples[chan] = new_fluid_sample();
+        TEST_ASSERT(samples[chan] != NULL);
+        TEST_SUCCESS(fluid_sample_set_sound_data(samples[chan], data[chan], NULL, frames, RATE, FALSE));
+        TEST_SUCCESS(fluid_sample_set_pitch(samples[chan], 60, 0));
+    }
+
+    plain = render(0, samples);
+    fused = render(1, samples);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(fused[i] == plain[i]);
+        peak = (fabs(plain[i]) > peak) ? fabs(plain[i]) : peak;
+    }
+
+    TEST_ASSERT(peak > 0.01);
+
+    FLUID_FREE(plain);
+    FLUID_FREE(fused);
+
+    for(chan = 0; chan < CHANNELS; chan++)
+    {
+        delete_fluid_sample(samples[chan]);
+    }
+
+    return EXIT_SUCCESS;
+}
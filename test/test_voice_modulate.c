@@ -0,0 +1,137 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "synth/fluid_mod.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that updating the voices after a controller change, through the lookup
+// tables of their modulators, modulates every generator by the sum of all of its modulators
+
+#define MOD_CC 3
+#define MOD_CC2 9
+
+static void add_mod(fluid_synth_t *synth, int src1, int flags1, int src2, int flags2, int dest, double amount)
+{
+    fluid_mod_t *mod = new_fluid_mod();
+    TEST_ASSERT(mod != NULL);
+
+    fluid_mod_set_source1(mod, src1, flags1);
+    fluid_mod_set_source2(mod, src2, flags2);
+    fluid_mod_set_dest(mod, dest);
+    fluid_mod_set_amount(mod, amount);
+    TEST_SUCCESS(fluid_synth_add_default_mod(synth, mod, FLUID_SYNTH_ADD));
+
+    delete_fluid_mod(mod);
+}
+
+static void verify_voices(fluid_synth_t *synth)
+{
+    int i, k, gen, playing = 0;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        if(!fluid_voice_is_playing(voice))
+        {
+            continue;
+        }
+
+        playing++;
+
+        // one source entry per distinct source, none unused
+        TEST_ASSERT(voice->mod_dest_count >= 0 && voice->mod_dest_count <= voice->mod_count);
+        TEST_ASSERT(voice->mod_src_count <= 2 * voice->mod_count);
+
+        for(gen = 0; gen < GEN_LAST; gen++)
+        {
+            fluid_real_t modval = 0;
+            int has_mod = FALSE;
+
+            for(k = 0; k < voice->mod_count; k++)
+            {
+                if(fluid_mod_has_dest(&voice->mod[k], gen))
+                {
+                    modval += fluid_mod_get_value(&voice->mod[k], voice);
+                    has_mod = TRUE;
+                }
+            }
+
+            if(has_mod)
+            {
+                TEST_ASSERT(FLUID_FABS(voice->gen[gen].mod - modval) < 1e-3);
+            }
+        }
+    }
+
+    TEST_ASSERT(playing > 0);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    // several modulators sharing a destination or a source, one of them with a CC as second source
+    add_mod(synth, MOD_CC, FLUID_MOD_CC | FLUID_MOD_UNIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE,
+            FLUID_MOD_NONE, FLUID_MOD_GC, GEN_FILTERFC, -2400);
+    add_mod(synth, MOD_CC, FLUID_MOD_CC | FLUID_MOD_UNIPOLAR | FLUID_MOD_CONCAVE | FLUID_MOD_NEGATIVE,
+            FLUID_MOD_NONE, FLUID_MOD_GC, GEN_ATTENUATION, 200);
+    add_mod(synth, FLUID_MOD_VELOCITY, FLUID_MOD_GC | FLUID_MOD_UNIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE,
+            MOD_CC2, FLUID_MOD_CC | FLUID_MOD_UNIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE, GEN_FILTERFC, 1200);
+    add_mod(synth, MOD_CC2, FLUID_MOD_CC | FLUID_MOD_BIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE,
+            FLUID_MOD_NONE, FLUID_MOD_GC, GEN_PAN, 500);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 30));
+    verify_voices(synth);
+
+    for(i = 0; i < 200; i++)
+    {
+        switch(i % 6)
+        {
+        case 0:
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, MOD_CC, (i * 37) % 128));
+            break;
+
+        case 1:
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, MOD_CC2, (i * 53) % 128));
+            break;
+
+        case 2:
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, MODULATION_MSB, (i * 11) % 128));
+            break;
+
+        case 3:
+            TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, (i * 997) % 16384));
+            break;
+
+        case 4:
+            TEST_SUCCESS(fluid_synth_channel_pressure(synth, 0, (i * 7) % 128));
+            break;
+
+        default:
+            // all controllers off updates every destination
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, ALL_CTRL_OFF, 0));
+            break;
+        }
+
+        verify_voices(synth);
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
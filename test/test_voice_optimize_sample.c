@@ -0,0 +1,94 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "rvoice/fluid_rvoice.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the peak level used for the voice off optimization is the one of the
+// loop of the sample, for 16 bit samples as well as for 24 bit samples
+
+#define SAMPLE_COUNT 1000
+
+// the same as in fluid_voice.c
+static const int32_t INT24_MAX = (1 << (16 + 8 - 1));
+
+// the amplitude expected, scanning the loop one sample point at a time
+static double expected_amplitude(const fluid_sample_t *sample)
+{
+    int32_t peak = 0;
+    unsigned int i;
+
+    for(i = sample->loopstart; i < sample->loopend; i++)
+    {
+        int32_t val = fluid_rvoice_get_sample(sample->data, sample->data24, i);
+
+        if(val > peak)
+        {
+            peak = val;
+        }
+        else if(-val > peak)
+        {
+            peak = -val;
+        }
+    }
+
+    if(peak == 0)
+    {
+        peak = 1;
+    }
+
+    return FLUID_NOISE_FLOOR / (((fluid_real_t)peak) / (INT24_MAX * 1.0f));
+}
+
+static void verify_sample(short *data, char *data24, unsigned int loopstart, unsigned int loopend)
+{
+    fluid_sample_t sample;
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.data24 = data24;
+    sample.start = 0;
+    sample.end = SAMPLE_COUNT - 1;
+    sample.loopstart = loopstart;
+    sample.loopend = loopend;
+
+    TEST_SUCCESS(fluid_voice_optimize_sample(&sample));
+    TEST_ASSERT(sample.amplitude_that_reaches_noise_floor_is_valid);
+    TEST_ASSERT(sample.amplitude_that_reaches_noise_floor == expected_amplitude(&sample));
+}
+
+int main(void)
+{
+    static short data[SAMPLE_COUNT];
+    static char data24[SAMPLE_COUNT];
+    unsigned int i, seed = 1;
+
+    for(i = 0; i < SAMPLE_COUNT; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (short)((seed >> 8) % 20000) - 10000;
+        data24[i] = (char)(seed >> 3);
+    }
+
+    // the loudest points outside of the loop must not count
+    data[10] = 32767;
+    data[SAMPLE_COUNT - 10] = -32768;
+
+    verify_sample(data, NULL, 100, 900);
+    verify_sample(data, data24, 100, 900);
+
+    // a negative peak, and the lowest 24 bit value
+    data[500] = -32768;
+    data24[500] = 0;
+    verify_sample(data, NULL, 100, 900);
+    verify_sample(data, data24, 100, 900);
+
+    // silent and empty loops
+    FLUID_MEMSET(data + 100, 0, 800 * sizeof(short));
+    FLUID_MEMSET(data24 + 100, 0, 800);
+    verify_sample(data, NULL, 100, 900);
+    verify_sample(data, data24, 100, 101);
+    verify_sample(data, data24, 200, 200);
+
+    return EXIT_SUCCESS;
+}